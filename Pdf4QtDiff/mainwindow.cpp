@@ -178,6 +178,7 @@ MainWindow::MainWindow(QWidget* parent) :
     m_diff.setProgress(m_progress);
     m_diff.setOption(pdf::PDFDiff::Asynchronous, true);
     connect(&m_diff, &pdf::PDFDiff::comparationFinished, this, &MainWindow::onComparationFinished);
+    connect(&m_diff, &pdf::PDFDiff::partialResultAvailable, this, &MainWindow::onPartialComparationResult);
 
     m_diff.setLeftDocument(&m_leftDocument);
     m_diff.setRightDocument(&m_rightDocument);
@@ -259,6 +260,14 @@ void MainWindow::onComparationFinished()
     updateAll(true);
 }
 
+void MainWindow::onPartialComparationResult()
+{
+    // Differences found so far are displayed, document view is
+    // updated, when comparation is finished.
+    m_diffResult = m_diff.getPartialResult();
+    updateFilteredResult();
+}
+
 void MainWindow::onColorsChanged()
 {
     updateFilteredResult();
@@ -542,6 +551,25 @@ void MainWindow::performOperation(Operation operation)
             m_diff.setPagesForLeftDocument(std::move(leftPageIndices));
             m_diff.setPagesForRightDocument(std::move(rightPageIndices));
 
+            // Pages currently displayed are compared first
+            std::vector<pdf::PDFInteger> leftPriorityPages;
+            std::vector<pdf::PDFInteger> rightPriorityPages;
+            for (pdf::PDFInteger pageIndex : m_pdfWidget->getDrawWidget()->getCurrentPages())
+            {
+                const pdf::PDFInteger leftPageIndex = m_documentMapper.getLeftPageIndex(pageIndex);
+                const pdf::PDFInteger rightPageIndex = m_documentMapper.getRightPageIndex(pageIndex);
+
+                if (leftPageIndex != -1)
+                {
+                    leftPriorityPages.push_back(leftPageIndex);
+                }
+                if (rightPageIndex != -1)
+                {
+                    rightPriorityPages.push_back(rightPageIndex);
+                }
+            }
+            m_diff.setPriorityPages(std::move(leftPriorityPages), std::move(rightPriorityPages));
+
             m_diff.start();
             break;
         }
@@ -91,6 +91,7 @@ private slots:
 private:
     void onMappedActionTriggered(int actionId);
     void onComparationFinished();
+    void onPartialComparationResult();
     void onColorsChanged();
 
     void onProgressStarted(pdf::ProgressStartupInfo info);
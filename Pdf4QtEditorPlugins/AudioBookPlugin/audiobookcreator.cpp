@@ -16,6 +16,12 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "audiobookcreator.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfexception.h"
+
+#include <QFile>
+
+#include <limits>
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -28,6 +34,142 @@
 namespace pdfplugin
 {
 
+#ifdef Q_OS_WIN
+
+/// Maximal length of the text synthesized at once. Text is divided into
+/// chunks on line boundaries, which are synthesized in parallel.
+static constexpr qsizetype MAX_CHUNK_LENGTH = 4096;
+
+/// Audio format of the synthesized speech (mono, 22.05 kHz, 16 bits per sample)
+static WAVEFORMATEX getAudioFormat()
+{
+    WAVEFORMATEX format = { };
+    format.wFormatTag = WAVE_FORMAT_PCM;
+    format.nChannels = 1;
+    format.nSamplesPerSec = 22050;
+    format.wBitsPerSample = 16;
+    format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+    format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+    format.cbSize = 0;
+    return format;
+}
+
+/// Returns header of the wave file with PCM data of given size
+static QByteArray getWaveFileHeader(const WAVEFORMATEX& format, quint32 dataSize)
+{
+    auto appendUInt16 = [](QByteArray& data, quint16 value)
+    {
+        data.append(char(value & 0xFF));
+        data.append(char((value >> 8) & 0xFF));
+    };
+    auto appendUInt32 = [&](QByteArray& data, quint32 value)
+    {
+        appendUInt16(data, quint16(value & 0xFFFF));
+        appendUInt16(data, quint16(value >> 16));
+    };
+
+    QByteArray header;
+    header.append("RIFF");
+    appendUInt32(header, 36 + dataSize);
+    header.append("WAVEfmt ");
+    appendUInt32(header, 16);
+    appendUInt16(header, format.wFormatTag);
+    appendUInt16(header, format.nChannels);
+    appendUInt32(header, format.nSamplesPerSec);
+    appendUInt32(header, format.nAvgBytesPerSec);
+    appendUInt16(header, format.nBlockAlign);
+    appendUInt16(header, format.wBitsPerSample);
+    header.append("data");
+    appendUInt32(header, dataSize);
+    return header;
+}
+
+/// Synthesizes text into PCM data of given format. Function can be called
+/// from any thread, it uses its own COM objects (voice is created from
+/// the token identifier, so token is not shared between threads).
+static QByteArray synthesizeSpeech(const QString& voiceId,
+                                   const QString& text,
+                                   const AudioBookCreator::Settings& settings,
+                                   WAVEFORMATEX format,
+                                   QString& errorMessage)
+{
+    QByteArray data;
+
+    const HRESULT comResult = ::CoInitialize(nullptr);
+
+    ISpObjectToken* voiceToken = nullptr;
+    IStream* memoryStream = nullptr;
+    ISpStream* stream = nullptr;
+    ISpVoice* voice = nullptr;
+
+    auto release = [](auto*& object)
+    {
+        if (object)
+        {
+            object->Release();
+            object = nullptr;
+        }
+    };
+
+    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpObjectToken, NULL, CLSCTX_ALL, __uuidof(ISpObjectToken), (LPVOID*)&voiceToken)) ||
+        !SUCCEEDED(voiceToken->SetId(NULL, (LPCWSTR)voiceId.utf16(), FALSE)))
+    {
+        errorMessage = AudioBookCreator::tr("No suitable voice found.");
+    }
+    else if (!SUCCEEDED(::CreateStreamOnHGlobal(NULL, TRUE, &memoryStream)) ||
+             !SUCCEEDED(::CoCreateInstance(CLSID_SpStream, NULL, CLSCTX_ALL, __uuidof(ISpStream), (LPVOID*)&stream)) ||
+             !SUCCEEDED(stream->SetBaseStream(memoryStream, SPDFID_WaveFormatEx, &format)))
+    {
+        errorMessage = AudioBookCreator::tr("Cannot create audio stream.");
+    }
+    else if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
+    {
+        errorMessage = AudioBookCreator::tr("Cannot create voice.");
+    }
+    else if (!SUCCEEDED(voice->SetVoice(voiceToken)))
+    {
+        errorMessage = AudioBookCreator::tr("Failed to set requested voice.");
+    }
+    else
+    {
+        LPCWSTR stringToSpeak = (LPCWSTR)text.utf16();
+
+        voice->SetOutput(stream, FALSE);
+        voice->SetRate(settings.rate * 10.0);
+        voice->SetVolume(settings.volume * 100.0);
+
+        if (SUCCEEDED(voice->Speak(stringToSpeak, SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL)))
+        {
+            LARGE_INTEGER zero = { };
+            ULARGE_INTEGER size = { };
+            ULONG bytesRead = 0;
+            memoryStream->Seek(zero, STREAM_SEEK_END, &size);
+            memoryStream->Seek(zero, STREAM_SEEK_SET, nullptr);
+            data.resize(qsizetype(size.QuadPart));
+            memoryStream->Read(data.data(), ULONG(data.size()), &bytesRead);
+            data.resize(qsizetype(bytesRead));
+        }
+        else
+        {
+            errorMessage = AudioBookCreator::tr("Speech synthesis failed.");
+        }
+    }
+
+    release(voice);
+    release(stream);
+    release(memoryStream);
+    release(voiceToken);
+
+    if (SUCCEEDED(comResult))
+    {
+        ::CoUninitialize();
+    }
+
+    return data;
+}
+
+#endif
+
 AudioBookCreator::AudioBookCreator() :
     m_initialized(false)
 {
@@ -50,18 +192,31 @@ AudioBookCreator::~AudioBookCreator()
 pdf::PDFOperationResult AudioBookCreator::createAudioBook(const Settings& settings, pdf::PDFDocumentTextFlow& flow)
 {
 #ifdef Q_OS_WIN
-    QString audioString;
-    QTextStream textStream(&audioString);
+    // Divide text into chunks, which can be synthesized independently
+    std::vector<QString> chunks;
+    QString chunk;
 
     for (const pdf::PDFDocumentTextFlow::Item& item : flow.getItems())
     {
         QString trimmedText = item.text.trimmed();
         if (!trimmedText.isEmpty())
         {
-            textStream << trimmedText << Qt::endl;
+            chunk += trimmedText;
+            chunk += QChar('\n');
+
+            if (chunk.size() >= MAX_CHUNK_LENGTH)
+            {
+                chunks.push_back(qMove(chunk));
+                chunk.clear();
+            }
         }
     }
 
+    if (!chunk.isEmpty())
+    {
+        chunks.push_back(qMove(chunk));
+    }
+
     auto getVoiceToken = [](const Settings& settings)
     {
         ISpObjectToken* token = nullptr;
@@ -125,50 +280,83 @@ pdf::PDFOperationResult AudioBookCreator::createAudioBook(const Settings& settin
         return tr("No suitable voice found.");
     }
 
-    QString outputFile = settings.audioFileName;
-    BSTR outputFileName = (BSTR)outputFile.utf16();
-
-    ISpeechFileStream* stream = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpFileStream, NULL, CLSCTX_ALL, __uuidof(ISpeechFileStream), (LPVOID*)&stream)))
+    // Voices are created in the worker threads from the token identifier
+    QString voiceId;
+    LPWSTR voiceIdString = nullptr;
+    if (SUCCEEDED(voiceToken->GetId(&voiceIdString)))
     {
-        voiceToken->Release();
-        return tr("Cannot create output stream '%1'.").arg(outputFile);
+        voiceId = QString::fromWCharArray(voiceIdString);
+        ::CoTaskMemFree(voiceIdString);
     }
+    voiceToken->Release();
 
-    ISpVoice* voice = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
+    if (voiceId.isEmpty())
     {
-        voiceToken->Release();
-        stream->Release();
-        return tr("Cannot create voice.");
+        return tr("No suitable voice found.");
     }
 
-    if (!SUCCEEDED(stream->Open(outputFileName, SSFMCreateForWrite)))
+    QString outputFile = settings.audioFileName;
+    QFile file(outputFile);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
     {
-        voiceToken->Release();
-        voice->Release();
-        stream->Release();
         return tr("Cannot create output stream '%1'.").arg(outputFile);
     }
 
-    if (!SUCCEEDED(voice->SetVoice(voiceToken)))
+    // Chunks are synthesized in parallel and written to the file in order. Only
+    // limited number of synthesized chunks waits for writing, so memory consumption
+    // doesn't depend on the length of the book.
+    const WAVEFORMATEX format = getAudioFormat();
+    file.write(getWaveFileHeader(format, 0));
+    quint64 dataSize = 0;
+
+    struct SynthesizedChunk
     {
-        voiceToken->Release();
-        voice->Release();
-        stream->Release();
-        return tr("Failed to set requested voice.");
-    }
+        QByteArray data;
+        QString errorMessage;
+    };
 
-    LPCWSTR stringToSpeak = (LPCWSTR)audioString.utf16();
+    auto synthesizeChunk = [&](size_t index)
+    {
+        SynthesizedChunk result;
+        result.data = synthesizeSpeech(voiceId, chunks[index], settings, format, result.errorMessage);
+        chunks[index].clear();
+        return result;
+    };
 
-    voice->SetOutput(stream, FALSE);
-    voice->SetRate(settings.rate * 10.0);
-    voice->SetVolume(settings.volume * 100.0);
-    voice->Speak(stringToSpeak, SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL);
+    auto writeChunk = [&](size_t, SynthesizedChunk result)
+    {
+        if (!result.errorMessage.isEmpty())
+        {
+            throw pdf::PDFException(result.errorMessage);
+        }
 
-    voice->Release();
-    stream->Release();
-    voiceToken->Release();
+        if (file.write(result.data) != result.data.size())
+        {
+            throw pdf::PDFException(tr("Cannot write to the output stream '%1'.").arg(outputFile));
+        }
+        dataSize += result.data.size();
+    };
+
+    const size_t maxPendingChunks = 2 * pdf::PDFExecutionPolicy::getIdealThreadCount(pdf::PDFExecutionPolicy::Scope::Page);
+
+    try
+    {
+        pdf::PDFExecutionPolicy::executeOrdered(pdf::PDFExecutionPolicy::Scope::Page, chunks.size(), maxPendingChunks, synthesizeChunk, writeChunk);
+    }
+    catch (const pdf::PDFException& exception)
+    {
+        file.close();
+        return exception.getMessage();
+    }
+
+    if (dataSize > std::numeric_limits<quint32>::max() - 36)
+    {
+        return tr("Audio book is too long for the wave format.");
+    }
+
+    file.seek(0);
+    file.write(getWaveFileHeader(format, quint32(dataSize)));
+    file.close();
 
     return true;
 #else
@@ -185,9 +185,7 @@ void AudioBookPlugin::drawPage(QPainter* painter,
     for (auto it = range.first; it != range.second; ++it)
     {
         const size_t itemIndex = it->second;
-        const pdf::PDFDocumentTextFlowEditor::EditedItem* item = m_textFlowEditor.getEditedItem(itemIndex);
-
-        QRectF boundingRect = item->boundingRect;
+        QRectF boundingRect = m_textFlowEditor.getBoundingRect(itemIndex);
 
         QColor color(Qt::green);
         if (m_textFlowEditor.isSelected(itemIndex))
@@ -394,13 +392,16 @@ void AudioBookPlugin::onTextStreamTableSelectionChanged()
         }
     }
 
-    m_textFlowEditor.deselect();
+    std::vector<size_t> rows;
+    rows.reserve(indices.size());
 
     for (const QModelIndex& index : indices)
     {
-        m_textFlowEditor.select(index.row(), true);
+        rows.push_back(index.row());
     }
 
+    m_textFlowEditor.setSelection(rows);
+
     m_audioTextStreamEditorModel->notifyDataChanged();
 }
 
@@ -495,8 +496,7 @@ std::optional<size_t> AudioBookPlugin::getItemIndexForPagePoint(QPoint pos) cons
 
     for (auto it = itemRange.first; it != itemRange.second; ++it)
     {
-        const pdf::PDFDocumentTextFlowEditor::EditedItem* item = m_textFlowEditor.getEditedItem(it->second);
-        if (item->boundingRect.contains(pagePoint))
+        if (m_textFlowEditor.getBoundingRect(it->second).contains(pagePoint))
         {
             return it->second;
         }
@@ -22,6 +22,7 @@
 #include "pdfobjectinspectortreeitemmodel.h"
 
 #include <QSplitter>
+#include <QtConcurrent/QtConcurrent>
 
 namespace pdfplugin
 {
@@ -31,61 +32,18 @@ ObjectInspectorDialog::ObjectInspectorDialog(const pdf::PDFCMS* cms, const pdf::
     ui(new Ui::ObjectInspectorDialog),
     m_cms(cms),
     m_document(document),
+    m_classificationFutureWatcher(nullptr),
     m_model(nullptr),
     m_viewerWidget(new ObjectViewerWidget(this))
 {
     ui->setupUi(this);
 
-    m_objectClassifier.classify(document);
-
     m_viewerWidget->setCms(cms);
     m_viewerWidget->setDocument(document);
     ui->currentObjectTabLayout->addWidget(m_viewerWidget);
 
     ui->modeComboBox->addItem(tr("Document"), int(PDFObjectInspectorTreeItemModel::Document));
     ui->modeComboBox->addItem(tr("Pages"), int(PDFObjectInspectorTreeItemModel::Page));
-
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::ContentStream))
-    {
-        ui->modeComboBox->addItem(tr("Content streams"), int(PDFObjectInspectorTreeItemModel::ContentStream));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::GraphicState))
-    {
-        ui->modeComboBox->addItem(tr("Graphic states"), int(PDFObjectInspectorTreeItemModel::GraphicState));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::ColorSpace))
-    {
-        ui->modeComboBox->addItem(tr("Color spaces"), int(PDFObjectInspectorTreeItemModel::ColorSpace));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::Pattern))
-    {
-        ui->modeComboBox->addItem(tr("Patterns"), int(PDFObjectInspectorTreeItemModel::Pattern));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::Shading))
-    {
-        ui->modeComboBox->addItem(tr("Shadings"), int(PDFObjectInspectorTreeItemModel::Shading));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::Image))
-    {
-        ui->modeComboBox->addItem(tr("Images"), int(PDFObjectInspectorTreeItemModel::Image));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::Form))
-    {
-        ui->modeComboBox->addItem(tr("Forms"), int(PDFObjectInspectorTreeItemModel::Form));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::Font))
-    {
-        ui->modeComboBox->addItem(tr("Fonts"), int(PDFObjectInspectorTreeItemModel::Font));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::Action))
-    {
-        ui->modeComboBox->addItem(tr("Actions"), int(PDFObjectInspectorTreeItemModel::Action));
-    }
-    if (m_objectClassifier.hasType(pdf::PDFObjectClassifier::Annotation))
-    {
-        ui->modeComboBox->addItem(tr("Annotations"), int(PDFObjectInspectorTreeItemModel::Annotation));
-    }
-
     ui->modeComboBox->addItem(tr("Object List"), int(PDFObjectInspectorTreeItemModel::List));
 
     ui->modeComboBox->setCurrentIndex(ui->modeComboBox->findData(int(PDFObjectInspectorTreeItemModel::Document)));
@@ -108,6 +66,14 @@ ObjectInspectorDialog::ObjectInspectorDialog(const pdf::PDFCMS* cms, const pdf::
     connect(m_viewerWidget, &ObjectViewerWidget::pinRequest, this, &ObjectInspectorDialog::onPinRequest);
     connect(m_viewerWidget, &ObjectViewerWidget::unpinRequest, this, &ObjectInspectorDialog::onUnpinRequest);
 
+    // Jakub Melka: Classification of objects can take a long time for large documents,
+    // so it is performed in the background. Modes displaying objects of some class
+    // are added, when classification is finished.
+    m_classificationFuture = QtConcurrent::run([this, document]() { m_objectClassifier.classify(document); });
+    m_classificationFutureWatcher = new QFutureWatcher<void>(this);
+    connect(m_classificationFutureWatcher, &QFutureWatcher<void>::finished, this, &ObjectInspectorDialog::onClassificationFinished);
+    m_classificationFutureWatcher->setFuture(m_classificationFuture);
+
     ui->objectTreeView->setMinimumWidth(pdf::PDFWidgetUtils::scaleDPI_x(this, 200));
     setMinimumSize(pdf::PDFWidgetUtils::scaleDPI(this, QSize(800, 600)));
     pdf::PDFWidgetUtils::style(this);
@@ -115,6 +81,7 @@ ObjectInspectorDialog::ObjectInspectorDialog(const pdf::PDFCMS* cms, const pdf::
 
 ObjectInspectorDialog::~ObjectInspectorDialog()
 {
+    m_classificationFuture.waitForFinished();
     delete ui;
 }
 
@@ -170,4 +137,31 @@ void ObjectInspectorDialog::onCurrentIndexChanged(const QModelIndex& current, co
     m_viewerWidget->setData(reference, qMove(object), isRoot);
 }
 
+void ObjectInspectorDialog::onClassificationFinished()
+{
+    m_classificationFutureWatcher->deleteLater();
+    m_classificationFutureWatcher = nullptr;
+
+    // Modes are inserted before the object list mode
+    int index = ui->modeComboBox->findData(int(PDFObjectInspectorTreeItemModel::List));
+    auto addMode = [this, &index](pdf::PDFObjectClassifier::Type type, PDFObjectInspectorTreeItemModel::Mode mode, QString text)
+    {
+        if (m_objectClassifier.hasType(type))
+        {
+            ui->modeComboBox->insertItem(index++, text, int(mode));
+        }
+    };
+
+    addMode(pdf::PDFObjectClassifier::ContentStream, PDFObjectInspectorTreeItemModel::ContentStream, tr("Content streams"));
+    addMode(pdf::PDFObjectClassifier::GraphicState, PDFObjectInspectorTreeItemModel::GraphicState, tr("Graphic states"));
+    addMode(pdf::PDFObjectClassifier::ColorSpace, PDFObjectInspectorTreeItemModel::ColorSpace, tr("Color spaces"));
+    addMode(pdf::PDFObjectClassifier::Pattern, PDFObjectInspectorTreeItemModel::Pattern, tr("Patterns"));
+    addMode(pdf::PDFObjectClassifier::Shading, PDFObjectInspectorTreeItemModel::Shading, tr("Shadings"));
+    addMode(pdf::PDFObjectClassifier::Image, PDFObjectInspectorTreeItemModel::Image, tr("Images"));
+    addMode(pdf::PDFObjectClassifier::Form, PDFObjectInspectorTreeItemModel::Form, tr("Forms"));
+    addMode(pdf::PDFObjectClassifier::Font, PDFObjectInspectorTreeItemModel::Font, tr("Fonts"));
+    addMode(pdf::PDFObjectClassifier::Action, PDFObjectInspectorTreeItemModel::Action, tr("Actions"));
+    addMode(pdf::PDFObjectClassifier::Annotation, PDFObjectInspectorTreeItemModel::Annotation, tr("Annotations"));
+}
+
 }   // namespace pdfplugin
@@ -24,6 +24,8 @@
 #include "objectviewerwidget.h"
 
 #include <QDialog>
+#include <QFuture>
+#include <QFutureWatcher>
 
 namespace Ui
 {
@@ -47,11 +49,14 @@ private:
     void onPinRequest();
     void onUnpinRequest();
     void onCurrentIndexChanged(const QModelIndex& current, const QModelIndex& previous);
+    void onClassificationFinished();
 
     Ui::ObjectInspectorDialog* ui;
     const pdf::PDFCMS* m_cms;
     const pdf::PDFDocument* m_document;
     pdf::PDFObjectClassifier m_objectClassifier;
+    QFuture<void> m_classificationFuture;
+    QFutureWatcher<void>* m_classificationFutureWatcher;
     PDFObjectInspectorTreeItemModel* m_model;
     ObjectViewerWidget* m_viewerWidget;
 };
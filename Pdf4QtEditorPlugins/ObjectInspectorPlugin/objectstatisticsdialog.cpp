@@ -20,6 +20,8 @@
 
 #include "pdfwidgetutils.h"
 
+#include <QtConcurrent/QtConcurrent>
+
 namespace pdfplugin
 {
 
@@ -27,7 +29,8 @@ ObjectStatisticsDialog::ObjectStatisticsDialog(const pdf::PDFDocument* document,
     QDialog(parent, Qt::Dialog | Qt::WindowMaximizeButtonHint | Qt::WindowCloseButtonHint),
     ui(new Ui::ObjectStatisticsDialog),
     m_document(document),
-    m_statisticsGraphWidget(new StatisticsGraphWidget(this))
+    m_statisticsGraphWidget(new StatisticsGraphWidget(this)),
+    m_futureWatcher(nullptr)
 {
     ui->setupUi(this);
 
@@ -38,9 +41,21 @@ ObjectStatisticsDialog::ObjectStatisticsDialog(const pdf::PDFDocument* document,
     ui->comboBox->setCurrentIndex(ui->comboBox->findData(int(ByObjectClass), Qt::UserRole, Qt::MatchExactly));
     connect(ui->comboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ObjectStatisticsDialog::updateStatisticsWidget);
 
-    pdf::PDFObjectClassifier classifier;
-    classifier.classify(document);
-    m_statistics = classifier.calculateStatistics(document);
+    // Jakub Melka: Statistics of large documents can take a long time to
+    // calculate, so they are calculated in the background, and dialog
+    // is responsive in the meantime.
+    auto calculateStatistics = [this, document]()
+    {
+        pdf::PDFObjectClassifier classifier;
+        classifier.classify(document);
+        m_statistics = classifier.calculateStatistics(document);
+    };
+
+    ui->comboBox->setEnabled(false);
+    m_future = QtConcurrent::run(calculateStatistics);
+    m_futureWatcher = new QFutureWatcher<void>(this);
+    connect(m_futureWatcher, &QFutureWatcher<void>::finished, this, &ObjectStatisticsDialog::onStatisticsCalculated);
+    m_futureWatcher->setFuture(m_future);
 
     updateStatisticsWidget();
     pdf::PDFWidgetUtils::style(this);
@@ -48,13 +63,31 @@ ObjectStatisticsDialog::ObjectStatisticsDialog(const pdf::PDFDocument* document,
 
 ObjectStatisticsDialog::~ObjectStatisticsDialog()
 {
+    m_future.waitForFinished();
     delete ui;
 }
 
+void ObjectStatisticsDialog::onStatisticsCalculated()
+{
+    m_futureWatcher->deleteLater();
+    m_futureWatcher = nullptr;
+
+    ui->comboBox->setEnabled(true);
+    updateStatisticsWidget();
+}
+
 void ObjectStatisticsDialog::updateStatisticsWidget()
 {
     StatisticsGraphWidget::Statistics statistics;
 
+    if (m_futureWatcher)
+    {
+        // Statistics are being calculated
+        statistics.title = tr("Calculating statistics...");
+        m_statisticsGraphWidget->setStatistics(qMove(statistics));
+        return;
+    }
+
     QLocale locale;
 
     std::array colors = {
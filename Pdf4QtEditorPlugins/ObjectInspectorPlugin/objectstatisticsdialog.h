@@ -23,6 +23,8 @@
 #include "statisticsgraphwidget.h"
 
 #include <QDialog>
+#include <QFuture>
+#include <QFutureWatcher>
 
 namespace Ui
 {
@@ -50,10 +52,13 @@ private:
     };
 
     void updateStatisticsWidget();
+    void onStatisticsCalculated();
 
     const pdf::PDFDocument* m_document;
     pdf::PDFObjectClassifier::Statistics m_statistics;
     StatisticsGraphWidget* m_statisticsGraphWidget;
+    QFuture<void> m_future;
+    QFutureWatcher<void>* m_futureWatcher;
 };
 
 }   // namespace pdfplugin
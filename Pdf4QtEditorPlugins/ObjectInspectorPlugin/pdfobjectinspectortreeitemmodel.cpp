@@ -17,11 +17,8 @@
 
 #include "pdfobjectinspectortreeitemmodel.h"
 #include "pdfdocument.h"
-#include "pdfvisitor.h"
 #include "pdfencoding.h"
 
-#include <stack>
-
 #include <QLocale>
 
 namespace pdfplugin
@@ -36,6 +33,7 @@ public:
     inline explicit PDFObjectInspectorTreeItem(pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_object(std::move(object)) { }
     inline explicit PDFObjectInspectorTreeItem(QByteArray dictionaryKey, pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_dictionaryKey(std::move(dictionaryKey)), m_object(std::move(object)) { }
     inline explicit PDFObjectInspectorTreeItem(pdf::PDFObjectReference reference, pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_reference(std::move(reference)), m_object(std::move(object)) { }
+    inline explicit PDFObjectInspectorTreeItem(pdf::PDFObjectReference reference, QByteArray dictionaryKey, pdf::PDFObject object, PDFObjectInspectorTreeItem* parent) : pdf::PDFTreeItem(parent), m_dictionaryKey(std::move(dictionaryKey)), m_reference(std::move(reference)), m_object(std::move(object)) { }
 
     virtual ~PDFObjectInspectorTreeItem() override { }
 
@@ -49,10 +47,15 @@ public:
     const pdf::PDFObject& getObject() const;
     void setObject(const pdf::PDFObject& object);
 
+    /// Returns true, if children of this item were already created
+    bool isFetched() const { return m_isFetched; }
+    void setFetched(bool isFetched) { m_isFetched = isFetched; }
+
 private:
     QByteArray m_dictionaryKey;
     pdf::PDFObjectReference m_reference;
     pdf::PDFObject m_object;
+    bool m_isFetched = false;
 };
 
 QByteArray PDFObjectInspectorTreeItem::getDictionaryKey() const
@@ -187,49 +190,89 @@ QVariant PDFObjectInspectorTreeItemModel::data(const QModelIndex& index, int rol
     return data.join(" ");
 }
 
+bool PDFObjectInspectorTreeItemModel::hasChildren(const QModelIndex& parent) const
+{
+    if (!parent.isValid())
+    {
+        return getRootItem() && (getRootItem()->getChildCount() > 0 || m_rootReferencesFetched < m_rootReferences.size());
+    }
+
+    const PDFObjectInspectorTreeItem* item = static_cast<const PDFObjectInspectorTreeItem*>(parent.internalPointer());
+    return item->isFetched() ? item->getChildCount() > 0 : getChildCountToFetch(item) > 0;
+}
+
+bool PDFObjectInspectorTreeItemModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (!parent.isValid())
+    {
+        return getRootItem() && m_rootReferencesFetched < m_rootReferences.size();
+    }
+
+    const PDFObjectInspectorTreeItem* item = static_cast<const PDFObjectInspectorTreeItem*>(parent.internalPointer());
+    return !item->isFetched() && getChildCountToFetch(item) > 0;
+}
+
+void PDFObjectInspectorTreeItemModel::fetchMore(const QModelIndex& parent)
+{
+    if (!canFetchMore(parent))
+    {
+        return;
+    }
+
+    if (!parent.isValid())
+    {
+        const size_t count = qMin(ROOT_OBJECTS_FETCH_COUNT, m_rootReferences.size() - m_rootReferencesFetched);
+        const int firstRow = getRootItem()->getChildCount();
+
+        beginInsertRows(parent, firstRow, firstRow + int(count) - 1);
+        createRootItems(count);
+        endInsertRows();
+        return;
+    }
+
+    PDFObjectInspectorTreeItem* item = static_cast<PDFObjectInspectorTreeItem*>(parent.internalPointer());
+    const int count = getChildCountToFetch(item);
+
+    beginInsertRows(parent, 0, count - 1);
+    createChildItems(item);
+    endInsertRows();
+}
+
 void PDFObjectInspectorTreeItemModel::update()
 {
     beginResetModel();
 
     m_rootItem.reset();
+    m_rootReferences.clear();
+    m_rootReferencesFetched = 0;
+    m_followReferences = m_mode != List;
 
+    // Jakub Melka: Tree is created lazily. Only root items are created here (and
+    // in large documents, only the first part of them), children are created,
+    // when parent item is expanded. So we do not traverse whole document here.
     if (m_document)
     {
-        std::set<pdf::PDFObjectReference> usedReferences;
-
-        auto createObjectsFromClassifier = [this, &usedReferences](pdf::PDFObjectClassifier::Type type)
-        {
-            m_rootItem.reset(new PDFObjectInspectorTreeItem());
-
-            for (pdf::PDFObjectReference reference : m_classifier->getObjectsByType(type))
-            {
-                pdf::PDFObject object = m_document->getStorage().getObjectByReference(reference);
-                createObjectItem(getRootItem(), reference, object, true, usedReferences);
-            }
-        };
+        m_rootItem.reset(new PDFObjectInspectorTreeItem());
+        const pdf::PDFObjectStorage& storage = m_document->getStorage();
 
         switch (m_mode)
         {
             case pdfplugin::PDFObjectInspectorTreeItemModel::Document:
             {
-                m_rootItem.reset(new PDFObjectInspectorTreeItem());
-                const pdf::PDFObjectStorage& storage = m_document->getStorage();
-                createObjectItem(getRootItem(), pdf::PDFObjectReference(), storage.getTrailerDictionary(), true, usedReferences);
+                getRootItem()->addCreatedChild(new PDFObjectInspectorTreeItem(pdf::PDFObjectReference(), storage.getTrailerDictionary(), getRootItem()));
                 break;
             }
 
             case pdfplugin::PDFObjectInspectorTreeItemModel::Page:
             {
-                m_rootItem.reset(new PDFObjectInspectorTreeItem());
-
                 const size_t pageCount = m_document->getCatalog()->getPageCount();
+                m_rootReferences.reserve(pageCount);
+
                 for (size_t i = 0; i < pageCount; ++i)
                 {
                     if (const pdf::PDFPage* page = m_document->getCatalog()->getPage(i))
                     {
-                        pdf::PDFObjectReference reference = page->getPageReference();
-                        pdf::PDFObject object = m_document->getStorage().getObjectByReference(reference);
-                        createObjectItem(getRootItem(), reference, object, true, usedReferences);
+                        m_rootReferences.push_back(page->getPageReference());
                     }
                 }
 
@@ -237,64 +280,59 @@ void PDFObjectInspectorTreeItemModel::update()
             }
 
             case ContentStream:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::ContentStream);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::ContentStream);
                 break;
 
             case GraphicState:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::GraphicState);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::GraphicState);
                 break;
 
             case ColorSpace:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::ColorSpace);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::ColorSpace);
                 break;
 
             case Pattern:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::Pattern);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::Pattern);
                 break;
 
             case Shading:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::Shading);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::Shading);
                 break;
 
             case Image:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::Image);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::Image);
                 break;
 
             case Form:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::Form);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::Form);
                 break;
 
             case Font:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::Font);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::Font);
                 break;
 
             case Action:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::Action);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::Action);
                 break;
 
             case Annotation:
-                createObjectsFromClassifier(pdf::PDFObjectClassifier::Annotation);
+                m_rootReferences = m_classifier->getObjectsByType(pdf::PDFObjectClassifier::Annotation);
                 break;
 
             case pdfplugin::PDFObjectInspectorTreeItemModel::List:
             {
-                m_rootItem.reset(new PDFObjectInspectorTreeItem());
+                getRootItem()->addCreatedChild(new PDFObjectInspectorTreeItem(pdf::PDFObjectReference(), storage.getTrailerDictionary(), getRootItem()));
 
-                const pdf::PDFObjectStorage& storage = m_document->getStorage();
-                createObjectItem(getRootItem(), pdf::PDFObjectReference(), storage.getTrailerDictionary(), false, usedReferences);
                 const pdf::PDFObjectStorage::PDFObjects& objects = storage.getObjects();
                 for (size_t i = 0; i < objects.size(); ++i)
                 {
-                    pdf::PDFObjectReference reference(i, objects[i].generation);
-                    pdf::PDFObject object = objects[i].object;
-
-                    if (object.isNull())
+                    if (objects[i].object.isNull())
                     {
                         // We skip null objects
                         continue;
                     }
 
-                    createObjectItem(getRootItem(), reference, object, false, usedReferences);
+                    m_rootReferences.emplace_back(i, objects[i].generation);
                 }
 
                 break;
@@ -304,6 +342,8 @@ void PDFObjectInspectorTreeItemModel::update()
                 Q_ASSERT(false);
                 break;
         }
+
+        createRootItems(qMin(ROOT_OBJECTS_FETCH_COUNT, m_rootReferences.size()));
     }
 
     endResetModel();
@@ -345,155 +385,124 @@ bool PDFObjectInspectorTreeItemModel::isRootObject(const QModelIndex& index) con
     return index.isValid() && !index.parent().isValid();
 }
 
-class PDFCreateObjectInspectorTreeItemFromObjectVisitor : public pdf::PDFAbstractVisitor
+int PDFObjectInspectorTreeItemModel::getChildCountToFetch(const PDFObjectInspectorTreeItem* item) const
 {
-public:
-    explicit PDFCreateObjectInspectorTreeItemFromObjectVisitor(std::set<pdf::PDFObjectReference>* usedReferences,
-                                                               const pdf::PDFDocument* document,
-                                                               bool followReferences,
-                                                               pdf::PDFObjectReference reference,
-                                                               PDFObjectInspectorTreeItem* parent) :
-        m_usedReferences(usedReferences),
-        m_document(document),
-        m_followReferences(followReferences),
-        m_reference(reference)
-    {
-        m_parents.push(parent);
-    }
-
-    virtual ~PDFCreateObjectInspectorTreeItemFromObjectVisitor() override
+    const pdf::PDFObject& object = item->getObject();
+    switch (object.getType())
     {
-        m_parents.pop();
-        Q_ASSERT(m_parents.empty());
-    }
-
-    virtual void visitNull() override;
-    virtual void visitBool(bool value) override;
-    virtual void visitInt(pdf::PDFInteger value) override;
-    virtual void visitReal(pdf::PDFReal value) override;
-    virtual void visitString(pdf::PDFStringRef string) override;
-    virtual void visitName(pdf::PDFStringRef name) override;
-    virtual void visitArray(const pdf::PDFArray* array) override;
-    virtual void visitDictionary(const pdf::PDFDictionary* dictionary) override;
-    virtual void visitStream(const pdf::PDFStream* stream) override;
-    virtual void visitReference(const pdf::PDFObjectReference reference) override;
-
-private:
-    std::set<pdf::PDFObjectReference>* m_usedReferences;
-    const pdf::PDFDocument* m_document;
-    bool m_followReferences;
-    pdf::PDFObjectReference m_reference;
-    std::stack<PDFObjectInspectorTreeItem*> m_parents;
-};
-
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitNull()
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createNull(), m_parents.top()));
-}
-
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitBool(bool value)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createBool(value), m_parents.top()));
-}
+        case pdf::PDFObject::Type::Array:
+            return int(object.getArray()->getCount());
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitInt(pdf::PDFInteger value)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createInteger(value), m_parents.top()));
-}
+        case pdf::PDFObject::Type::Dictionary:
+            return int(object.getDictionary()->getCount());
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitReal(pdf::PDFReal value)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createReal(value), m_parents.top()));
-}
+        case pdf::PDFObject::Type::Stream:
+            return int(object.getStream()->getDictionary()->getCount());
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitString(pdf::PDFStringRef string)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createString(string.getString()), m_parents.top()));
-}
+        case pdf::PDFObject::Type::Reference:
+            return isReferenceFollowed(item) ? 1 : 0;
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitName(pdf::PDFStringRef name)
-{
-    m_parents.top()->addCreatedChild(new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createName(name), m_parents.top()));
-}
+        default:
+            break;
+    }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitArray(const pdf::PDFArray* array)
-{
-    PDFObjectInspectorTreeItem* arrayRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(*array)), m_parents.top());
-    m_parents.top()->addCreatedChild(arrayRoot);
-    m_parents.push(arrayRoot);
-    acceptArray(array);
-    m_parents.pop();
+    return 0;
 }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitDictionary(const pdf::PDFDictionary* dictionary)
+bool PDFObjectInspectorTreeItemModel::isReferenceFollowed(const PDFObjectInspectorTreeItem* item) const
 {
-    PDFObjectInspectorTreeItem* dictionaryRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(*dictionary)), m_parents.top());
-    m_parents.top()->addCreatedChild(dictionaryRoot);
-    m_parents.push(dictionaryRoot);
+    const pdf::PDFObject& object = item->getObject();
+    if (!m_followReferences || !object.isReference() || !object.getReference().isValid())
+    {
+        return false;
+    }
 
-    acceptDictionary(dictionary);
+    // Items have reference of the root object, so this check
+    // also handles references to the root object itself.
+    const pdf::PDFObjectReference reference = object.getReference();
+    if (item->getReference() == reference)
+    {
+        return false;
+    }
 
-    Q_ASSERT(dictionaryRoot->getChildCount() == dictionary->getCount());
-    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    // Check, if reference was already followed on the path from the root
+    for (const pdf::PDFTreeItem* parent = item->getParent(); parent; parent = parent->getParent())
     {
-        PDFObjectInspectorTreeItem* child = static_cast<PDFObjectInspectorTreeItem*>(dictionaryRoot->getChild(int(i)));
-        child->setDictionaryKey(dictionary->getKey(i).getString());
+        const PDFObjectInspectorTreeItem* parentItem = static_cast<const PDFObjectInspectorTreeItem*>(parent);
+        const pdf::PDFObject& parentObject = parentItem->getObject();
+        if (parentObject.isReference() && parentObject.getReference() == reference)
+        {
+            return false;
+        }
     }
 
-    m_parents.pop();
+    return true;
 }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitStream(const pdf::PDFStream* stream)
+void PDFObjectInspectorTreeItemModel::createChildItems(PDFObjectInspectorTreeItem* item) const
 {
-    PDFObjectInspectorTreeItem* streamRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(*stream)), m_parents.top());
-    m_parents.top()->addCreatedChild(streamRoot);
-    m_parents.push(streamRoot);
+    Q_ASSERT(!item->isFetched());
+    item->setFetched(true);
 
-    const pdf::PDFDictionary* dictionary = stream->getDictionary();
-    acceptDictionary(dictionary);
+    // Jakub Melka: Child items share the data of the objects with their parent,
+    // and stream data are accessed only when the item is displayed.
+    const pdf::PDFObjectReference reference = item->getReference();
+    const pdf::PDFObject& object = item->getObject();
 
-    Q_ASSERT(streamRoot->getChildCount() == dictionary->getCount());
-    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    auto addDictionaryItems = [item, &reference](const pdf::PDFDictionary* dictionary)
     {
-        PDFObjectInspectorTreeItem* child = static_cast<PDFObjectInspectorTreeItem*>(streamRoot->getChild(int(i)));
-        child->setDictionaryKey(dictionary->getKey(i).getString());
-    }
+        for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+        {
+            item->addCreatedChild(new PDFObjectInspectorTreeItem(reference, dictionary->getKey(i).getString(), dictionary->getValue(i), item));
+        }
+    };
 
-    m_parents.pop();
-}
+    switch (object.getType())
+    {
+        case pdf::PDFObject::Type::Array:
+        {
+            const pdf::PDFArray* array = object.getArray();
+            for (size_t i = 0, count = array->getCount(); i < count; ++i)
+            {
+                item->addCreatedChild(new PDFObjectInspectorTreeItem(reference, array->getItem(i), item));
+            }
+            break;
+        }
 
-void PDFCreateObjectInspectorTreeItemFromObjectVisitor::visitReference(const pdf::PDFObjectReference reference)
-{
-    PDFObjectInspectorTreeItem* referenceRoot = new PDFObjectInspectorTreeItem(m_reference, pdf::PDFObject::createReference(reference), m_parents.top());
-    m_parents.top()->addCreatedChild(referenceRoot);
+        case pdf::PDFObject::Type::Dictionary:
+            addDictionaryItems(object.getDictionary());
+            break;
 
-    if (m_followReferences && reference.isValid())
-    {
-        Q_ASSERT(m_usedReferences);
+        case pdf::PDFObject::Type::Stream:
+            addDictionaryItems(object.getStream()->getDictionary());
+            break;
 
-        if (m_usedReferences->count(reference))
+        case pdf::PDFObject::Type::Reference:
         {
-            // Reference already followed
-            return;
+            if (isReferenceFollowed(item))
+            {
+                item->addCreatedChild(new PDFObjectInspectorTreeItem(reference, m_document->getObjectByReference(object.getReference()), item));
+            }
+            break;
         }
 
-        m_usedReferences->insert(reference);
-
-        m_parents.push(referenceRoot);
-        const pdf::PDFObject& object = m_document->getObjectByReference(reference);
-        object.accept(this);
-        m_parents.pop();
+        default:
+            break;
     }
 }
 
-void PDFObjectInspectorTreeItemModel::createObjectItem(PDFObjectInspectorTreeItem* parent,
-                                                       pdf::PDFObjectReference reference,
-                                                       pdf::PDFObject object,
-                                                       bool followRef,
-                                                       std::set<pdf::PDFObjectReference>& usedReferences) const
+void PDFObjectInspectorTreeItemModel::createRootItems(size_t count)
 {
-    PDFCreateObjectInspectorTreeItemFromObjectVisitor visitor(&usedReferences, m_document, followRef, reference, parent);
-    object.accept(&visitor);
+    Q_ASSERT(m_rootReferencesFetched + count <= m_rootReferences.size());
+
+    const pdf::PDFObjectStorage& storage = m_document->getStorage();
+    PDFObjectInspectorTreeItem* rootItem = getRootItem();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const pdf::PDFObjectReference reference = m_rootReferences[m_rootReferencesFetched++];
+        rootItem->addCreatedChild(new PDFObjectInspectorTreeItem(reference, storage.getObjectByReference(reference), rootItem));
+    }
 }
 
 PDFObjectInspectorTreeItem* PDFObjectInspectorTreeItemModel::getRootItem()
@@ -501,4 +510,9 @@ PDFObjectInspectorTreeItem* PDFObjectInspectorTreeItemModel::getRootItem()
     return static_cast<PDFObjectInspectorTreeItem*>(m_rootItem.get());
 }
 
+const PDFObjectInspectorTreeItem* PDFObjectInspectorTreeItemModel::getRootItem() const
+{
+    return static_cast<const PDFObjectInspectorTreeItem*>(m_rootItem.get());
+}
+
 }   // namespace pdfplugin
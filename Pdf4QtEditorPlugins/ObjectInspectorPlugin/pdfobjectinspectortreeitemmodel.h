@@ -21,7 +21,7 @@
 #include "pdfitemmodels.h"
 #include "pdfobjectutils.h"
 
-#include <set>
+#include <vector>
 
 namespace pdfplugin
 {
@@ -56,6 +56,9 @@ public:
     virtual QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     virtual int columnCount(const QModelIndex& parent) const override;
     virtual QVariant data(const QModelIndex& index, int role) const override;
+    virtual bool hasChildren(const QModelIndex& parent) const override;
+    virtual bool canFetchMore(const QModelIndex& parent) const override;
+    virtual void fetchMore(const QModelIndex& parent) override;
     virtual void update() override;
 
     void setMode(Mode mode);
@@ -65,16 +68,39 @@ public:
     bool isRootObject(const QModelIndex& index) const;
 
 private:
-    void createObjectItem(PDFObjectInspectorTreeItem* parent,
-                          pdf::PDFObjectReference reference,
-                          pdf::PDFObject object,
-                          bool followRef,
-                          std::set<pdf::PDFObjectReference>& usedReferences) const;
+    /// Count of root objects, which are created at once, when
+    /// view requests more root objects (for example, when scrolling)
+    static constexpr size_t ROOT_OBJECTS_FETCH_COUNT = 1024;
+
+    /// Returns count of children, which will be created for the item,
+    /// when it is expanded. Children are not created.
+    /// \param item Item
+    int getChildCountToFetch(const PDFObjectInspectorTreeItem* item) const;
+
+    /// Returns true, if reference object of the item is followed (i.e., referenced
+    /// object is displayed as its child). References are not followed in the list
+    /// mode, and also references creating a cycle are not followed.
+    /// \param item Item
+    bool isReferenceFollowed(const PDFObjectInspectorTreeItem* item) const;
+
+    /// Creates children of the item (does not notify views)
+    /// \param item Item
+    void createChildItems(PDFObjectInspectorTreeItem* item) const;
+
+    /// Creates root items for next root objects (does not notify views)
+    /// \param count Count of root objects
+    void createRootItems(size_t count);
 
     PDFObjectInspectorTreeItem* getRootItem();
+    const PDFObjectInspectorTreeItem* getRootItem() const;
 
     const pdf::PDFObjectClassifier* m_classifier;
     Mode m_mode = List;
+    bool m_followReferences = false;
+
+    /// Root objects, for which root items are not yet created
+    std::vector<pdf::PDFObjectReference> m_rootReferences;
+    size_t m_rootReferencesFetched = 0;
 };
 
 }   // namespace pdfplugin
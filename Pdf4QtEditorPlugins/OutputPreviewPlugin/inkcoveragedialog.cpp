@@ -40,6 +40,14 @@ InkCoverageDialog::InkCoverageDialog(const pdf::PDFDocument* document, pdf::PDFW
 
     m_inkMapper.createSpotColors(true);
 
+    connect(ui->fastEstimateCheckBox, &QCheckBox::toggled, this, [this]()
+    {
+        if (isInkCoverageCalculated())
+        {
+            updateInkCoverage();
+        }
+    });
+
     m_model = new InkCoverageStatisticsModel(this);
     ui->coverageTableView->setModel(m_model);
     ui->coverageTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
@@ -59,10 +67,13 @@ void InkCoverageDialog::updateInkCoverage()
     Q_ASSERT(!m_future.isRunning());
     Q_ASSERT(!m_futureWatcher);
 
-    auto calculateInkCoverage = [this]() -> InkCoverageResults
-    {
-        InkCoverageResults results;
+    m_pageCoverage.clear();
+    m_model->setInkCoverageResults(InkCoverageResults());
+    ui->fastEstimateCheckBox->setEnabled(false);
 
+    const bool fastEstimate = ui->fastEstimateCheckBox->isChecked();
+    auto calculateInkCoverage = [this, fastEstimate]() -> InkCoverageResults
+    {
         pdf::PDFTransparencyRendererSettings settings;
 
         // Jakub Melka: debug is very slow, use multithreading
@@ -81,42 +92,24 @@ void InkCoverageDialog::updateInkCoverage()
                                                  &m_inkMapper,
                                                  m_widget->getDrawWidgetProxy()->getProgress(),
                                                  settings);
+        calculator.setFastEstimate(fastEstimate);
+
+        // Pages are calculated in parallel, show them in the table as soon
+        // as they are finished. Dialog can't be closed during calculation.
+        calculator.setPageCoverageCallback([this](pdf::PDFInteger pageIndex, const CoverageInfo& coverageInfo)
+        {
+            QMetaObject::invokeMethod(this, [this, pageIndex, coverageInfo]() { onPageCoverageCalculated(pageIndex, coverageInfo); }, Qt::QueuedConnection);
+        });
 
         std::vector<pdf::PDFInteger> pageIndices;
         pageIndices.resize(m_document->getCatalog()->getPageCount(), 0);
         std::iota(pageIndices.begin(), pageIndices.end(), 0);
         calculator.perform(QSize(RESOLUTION, RESOLUTION), pageIndices);
 
-        CoverageInfo coverageInfo;
-
-        for (const pdf::PDFInteger pageIndex : pageIndices)
-        {
-            const std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>* coverage = calculator.getInkCoverage(pageIndex);
-
-            if (!coverage)
-            {
-                // Jakub Melka: Something bad happened?
-                continue;
-            }
-
-            for (const auto& info : *coverage)
-            {
-                if (!pdf::PDFInkCoverageCalculator::findCoverageInfoByName(coverageInfo,  info.name))
-                {
-                    coverageInfo.push_back(info);
-                    coverageInfo.back().coveredArea = 0.0;
-                    coverageInfo.back().ratio = 0.0;
-                }
-            }
-        }
-
-        CoverageInfo templateInfo = coverageInfo;
-        CoverageInfo sumInfo = coverageInfo;
-
+        std::map<pdf::PDFInteger, CoverageInfo> pageCoverage;
         for (const pdf::PDFInteger pageIndex : pageIndices)
         {
             const std::vector<pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo>* coverage = calculator.getInkCoverage(pageIndex);
-            results.pageInfo.push_back(templateInfo);
 
             if (!coverage)
             {
@@ -124,21 +117,10 @@ void InkCoverageDialog::updateInkCoverage()
                 continue;
             }
 
-            CoverageInfo& currentInfo = results.pageInfo.back();
-
-            for (const auto& info : *coverage)
-            {
-                pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* channelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(currentInfo, info.name);
-                pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* sumChannelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(sumInfo, info.name);
-                channelInfo->coveredArea = info.coveredArea;
-                channelInfo->ratio = info.ratio;
-                sumChannelInfo->coveredArea += info.coveredArea;
-            }
+            pageCoverage[pageIndex] = *coverage;
         }
 
-        results.sumInfo = qMove(sumInfo);
-
-        return results;
+        return createInkCoverageResults(pageCoverage);
     };
 
     m_future = QtConcurrent::run(calculateInkCoverage);
@@ -183,6 +165,68 @@ void InkCoverageDialog::onInkCoverageCalculated()
     Q_ASSERT(m_future.isFinished());
     InkCoverageResults results = m_future.result();
     m_model->setInkCoverageResults(qMove(results));
+
+    m_futureWatcher->deleteLater();
+    m_futureWatcher = nullptr;
+    ui->fastEstimateCheckBox->setEnabled(true);
+}
+
+void InkCoverageDialog::onPageCoverageCalculated(pdf::PDFInteger pageIndex, CoverageInfo coverageInfo)
+{
+    if (!m_futureWatcher)
+    {
+        // Calculation is already finished, we have complete results
+        return;
+    }
+
+    m_pageCoverage[pageIndex] = qMove(coverageInfo);
+    m_model->setInkCoverageResults(createInkCoverageResults(m_pageCoverage));
+}
+
+InkCoverageResults InkCoverageDialog::createInkCoverageResults(const std::map<pdf::PDFInteger, CoverageInfo>& pageCoverage)
+{
+    InkCoverageResults results;
+    CoverageInfo coverageInfo;
+
+    for (const auto& pageCoverageItem : pageCoverage)
+    {
+        for (const auto& info : pageCoverageItem.second)
+        {
+            if (!pdf::PDFInkCoverageCalculator::findCoverageInfoByName(coverageInfo,  info.name))
+            {
+                coverageInfo.push_back(info);
+                coverageInfo.back().coveredArea = 0.0;
+                coverageInfo.back().ratio = 0.0;
+                coverageInfo.back().coveredAreaError = 0.0;
+                coverageInfo.back().ratioError = 0.0;
+            }
+        }
+    }
+
+    CoverageInfo templateInfo = coverageInfo;
+    CoverageInfo sumInfo = coverageInfo;
+
+    for (const auto& pageCoverageItem : pageCoverage)
+    {
+        results.pageIndices.push_back(pageCoverageItem.first);
+        results.pageInfo.push_back(templateInfo);
+        CoverageInfo& currentInfo = results.pageInfo.back();
+
+        for (const auto& info : pageCoverageItem.second)
+        {
+            pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* channelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(currentInfo, info.name);
+            pdf::PDFInkCoverageCalculator::InkCoverageChannelInfo* sumChannelInfo = pdf::PDFInkCoverageCalculator::findCoverageInfoByName(sumInfo, info.name);
+            channelInfo->coveredArea = info.coveredArea;
+            channelInfo->ratio = info.ratio;
+            channelInfo->coveredAreaError = info.coveredAreaError;
+            channelInfo->ratioError = info.ratioError;
+            sumChannelInfo->coveredArea += info.coveredArea;
+            sumChannelInfo->coveredAreaError += info.coveredAreaError;
+        }
+    }
+
+    results.sumInfo = qMove(sumInfo);
+    return results;
 }
 
 bool InkCoverageDialog::isInkCoverageCalculated() const
@@ -249,7 +293,7 @@ QVariant InkCoverageStatisticsModel::data(const QModelIndex& index, int role) co
                 {
                     return tr("Total");
                 }
-                return locale.toString(row + 1);
+                return locale.toString(m_inkCoverageResults.pageIndices.at(row) + 1);
             }
 
             Q_ASSERT(index.column() >= LastStandardColumn);
@@ -273,9 +317,21 @@ QVariant InkCoverageStatisticsModel::data(const QModelIndex& index, int role) co
                 case pdfplugin::InkCoverageStatisticsModel::ChannelColumnColorant:
                     return QString();
                 case pdfplugin::InkCoverageStatisticsModel::ChannelColumnCoverageArea:
+                    if (channelInfo.coveredAreaError > 0.0)
+                    {
+                        return tr("%1 ± %2").arg(locale.toString(channelInfo.coveredArea, 'f', 2), locale.toString(channelInfo.coveredAreaError, 'f', 2));
+                    }
                     return locale.toString(channelInfo.coveredArea, 'f', 2);
                 case pdfplugin::InkCoverageStatisticsModel::ChannelColumnCoverageRatio:
-                    return !isTotalRow ? locale.toString(channelInfo.ratio * 100.0, 'f', 0) : QString();
+                    if (isTotalRow)
+                    {
+                        return QString();
+                    }
+                    if (channelInfo.ratioError > 0.0)
+                    {
+                        return tr("%1 ± %2").arg(locale.toString(channelInfo.ratio * 100.0, 'f', 0), locale.toString(channelInfo.ratioError * 100.0, 'f', 1));
+                    }
+                    return locale.toString(channelInfo.ratio * 100.0, 'f', 0);
 
                 default:
                     Q_ASSERT(false);
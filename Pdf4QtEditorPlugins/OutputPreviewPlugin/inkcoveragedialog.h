@@ -41,6 +41,7 @@ using CoverageInfo = std::vector<ChannelCoverageInfo>;
 
 struct InkCoverageResults
 {
+    std::vector<pdf::PDFInteger> pageIndices;
     std::vector<CoverageInfo> pageInfo;
     CoverageInfo sumInfo;
 };
@@ -69,13 +70,22 @@ private:
     static constexpr int RESOLUTION = 1920;
 
     void onInkCoverageCalculated();
+    void onPageCoverageCalculated(pdf::PDFInteger pageIndex, CoverageInfo coverageInfo);
     bool isInkCoverageCalculated() const;
 
+    /// Creates results (table rows) from calculated page coverages, pages
+    /// are sorted by page index and sum of all pages is calculated.
+    /// \param pageCoverage Coverage of calculated pages
+    static InkCoverageResults createInkCoverageResults(const std::map<pdf::PDFInteger, CoverageInfo>& pageCoverage);
+
     pdf::PDFInkMapper m_inkMapper;
     const pdf::PDFDocument* m_document;
     pdf::PDFWidget* m_widget;
     InkCoverageStatisticsModel* m_model;
 
+    /// Coverage of pages calculated so far (streamed from the calculation)
+    std::map<pdf::PDFInteger, CoverageInfo> m_pageCoverage;
+
     QFuture<InkCoverageResults> m_future;
     QFutureWatcher<InkCoverageResults>* m_futureWatcher;
 };
@@ -22,11 +22,18 @@
 #include "pdfrenderer.h"
 #include "pdfwidgetutils.h"
 #include "pdfdrawspacecontroller.h"
+#include "pdfexecutionpolicy.h"
 
+#include <QDir>
 #include <QCloseEvent>
+#include <QFileDialog>
+#include <QMessageBox>
 #include <QColorDialog>
+#include <QRegularExpression>
 #include <QtConcurrent/QtConcurrent>
 
+#include <algorithm>
+
 namespace pdfplugin
 {
 
@@ -35,6 +42,7 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
     ui(new Ui::OutputPreviewDialog),
     m_inkMapper(widget->getCMSManager(), document),
     m_inkMapperForRendering(widget->getCMSManager(), document),
+    m_inkMapperForPageImage(widget->getCMSManager(), document),
     m_document(document),
     m_widget(widget),
     m_needUpdateImage(false),
@@ -57,7 +65,7 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
     ui->displayModeComboBox->addItem(tr("Opacity Channel"), OutputPreviewWidget::OpacityChannel);
     ui->displayModeComboBox->setCurrentIndex(0);
 
-    m_outputPreviewWidget->setInkMapper(&m_inkMapper);
+    m_outputPreviewWidget->setInkMapper(&m_inkMapperForPageImage);
     ui->inksTreeWidget->setMinimumHeight(pdf::PDFWidgetUtils::scaleDPI_y(ui->inksTreeWidget, 150));
 
     m_inkMapper.createSpotColors(ui->simulateSeparationsCheckBox->isChecked());
@@ -77,6 +85,7 @@ OutputPreviewDialog::OutputPreviewDialog(const pdf::PDFDocument* document, pdf::
     connect(ui->displayModeComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &OutputPreviewDialog::onDisplayModeChanged);
     connect(ui->inkCoverageLimitEdit, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &OutputPreviewDialog::onInkCoverageLimitChanged);
     connect(ui->richBlackLimitEdit, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &OutputPreviewDialog::onRichBlackLimtiChanged);
+    connect(ui->exportSeparationsButton, &QPushButton::clicked, this, &OutputPreviewDialog::onExportSeparationsClicked);
 
     updatePageImage();
     updateInks();
@@ -258,6 +267,91 @@ void OutputPreviewDialog::onRichBlackLimtiChanged(double value)
     m_outputPreviewWidget->setRichBlackLimit(value / 100.0);
 }
 
+void OutputPreviewDialog::onExportSeparationsClicked()
+{
+    if (!isRenderingDone())
+    {
+        return;
+    }
+
+    const pdf::PDFInteger pageIndex = ui->pageIndexScrollBar->value() - 1;
+    const pdf::PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        return;
+    }
+
+    QString directory = QFileDialog::getExistingDirectory(this, tr("Select Directory for Separations"));
+    if (directory.isEmpty())
+    {
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    // All separations are rendered at once, plates are then extracted from
+    // the original process image, so page is rendered only once.
+    const int resolution = ui->exportResolutionEdit->value();
+    const QSizeF pageSizeMM = page->getRotatedMediaBoxMM().size();
+    const QSize renderSize = (pageSizeMM * resolution / 25.4).toSize();
+    const pdf::PDFRGB paperColor = pdf::PDFRGB{ 1.0f, 1.0f, 1.0f };
+
+    m_inkMapperForRendering = m_inkMapper.createPageInkMapper(page);
+    RenderedImage renderedImage = renderPage(page, renderSize, paperColor, pdf::PDFPixelFormat::getAllColorsMask(), getDisplayFlags());
+
+    const pdf::PDFPixelFormat pixelFormat = renderedImage.originalProcessImage.getPixelFormat();
+    std::vector<pdf::PDFInkMapper::ColorInfo> separations = m_inkMapperForRendering.getSeparations(pixelFormat.getProcessColorChannelCount(), true);
+    std::vector<QImage> plates = renderedImage.originalProcessImage.getSeparationImages();
+    Q_ASSERT(plates.size() == separations.size() || plates.empty());
+
+    const size_t plateCount = qMin(plates.size(), separations.size());
+    const int dotsPerMeter = qRound(resolution / 0.0254);
+    QDir outputDirectory(directory);
+    std::vector<int> failedPlates(plateCount, 0);
+
+    auto savePlate = [&](size_t i)
+    {
+        QImage& plate = plates[i];
+        plate.setDotsPerMeterX(dotsPerMeter);
+        plate.setDotsPerMeterY(dotsPerMeter);
+
+        QString name = separations[i].textName;
+        name.replace(QRegularExpression("[^\\w\\-]+"), "_");
+        QString fileName = outputDirectory.filePath(QString("page%1-%2.png").arg(pageIndex + 1).arg(name));
+        failedPlates[i] = plate.save(fileName) ? 0 : 1;
+    };
+
+    pdf::PDFIntegerRange<size_t> indices(0, plateCount);
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, indices.begin(), indices.end(), savePlate);
+
+    QApplication::restoreOverrideCursor();
+
+    // Ink mapper for rendering must correspond to the displayed page image
+    m_inkMapperForRendering = m_inkMapperForPageImage;
+
+    const auto failedPlateCount = std::count(failedPlates.cbegin(), failedPlates.cend(), 1);
+    if (plateCount == 0)
+    {
+        QMessageBox::critical(this, tr("Error"), tr("No separation was rendered."));
+    }
+    else if (failedPlateCount > 0)
+    {
+        QMessageBox::critical(this, tr("Error"), tr("Failed to save %1 of %2 separations.").arg(failedPlateCount).arg(plateCount));
+    }
+}
+
+pdf::PDFTransparencyRendererSettings::Flags OutputPreviewDialog::getDisplayFlags() const
+{
+    pdf::PDFTransparencyRendererSettings::Flags flags = pdf::PDFTransparencyRendererSettings::None;
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayImages, ui->displayImagesCheckBox->isChecked());
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayText, ui->displayTextCheckBox->isChecked());
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayVectorGraphics, ui->displayVectorGraphicsCheckBox->isChecked());
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayShadings, ui->displayShadingCheckBox->isChecked());
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayTilingPatterns, ui->displayTilingPatternsCheckBox->isChecked());
+    flags.setFlag(pdf::PDFTransparencyRendererSettings::SaveOriginalProcessImage, true);
+    return flags;
+}
+
 void OutputPreviewDialog::updatePageImage()
 {
     if (!isRenderingDone())
@@ -312,15 +406,11 @@ void OutputPreviewDialog::updatePageImage()
         paperColor[2] = ui->bluePaperColorEdit->value();
     }
 
-    pdf::PDFTransparencyRendererSettings::Flags flags = pdf::PDFTransparencyRendererSettings::None;
-    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayImages, ui->displayImagesCheckBox->isChecked());
-    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayText, ui->displayTextCheckBox->isChecked());
-    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayVectorGraphics, ui->displayVectorGraphicsCheckBox->isChecked());
-    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayShadings, ui->displayShadingCheckBox->isChecked());
-    flags.setFlag(pdf::PDFTransparencyRendererSettings::DisplayTilingPatterns, ui->displayTilingPatternsCheckBox->isChecked());
-    flags.setFlag(pdf::PDFTransparencyRendererSettings::SaveOriginalProcessImage, true);
+    pdf::PDFTransparencyRendererSettings::Flags flags = getDisplayFlags();
 
-    m_inkMapperForRendering = m_inkMapper;
+    // Render only spot colors used on the page, inks in the tree are indexed by separations of the document
+    m_inkMapperForRendering = m_inkMapper.createPageInkMapper(page);
+    activeColorMask = m_inkMapperForRendering.mapActiveColorMask(m_inkMapper, 4, activeColorMask);
     QSize renderSize = m_outputPreviewWidget->getPageImageSizeHint();
     auto renderImage = [this, page, renderSize, paperColor, activeColorMask, flags]() -> RenderedImage
     {
@@ -366,12 +456,10 @@ OutputPreviewDialog::RenderedImage OutputPreviewDialog::renderPage(const pdf::PD
     QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
     pdf::PDFDrawWidgetProxy* proxy = m_widget->getDrawWidgetProxy();
     pdf::PDFCMSPointer cms = proxy->getCMSManager()->getCurrentCMS();
-    pdf::PDFTransparencyRenderer renderer(page, m_document, proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(),
-                                          &m_inkMapperForRendering, settings, pagePointToDevicePoint);
+    pdf::PDFTiledTransparencyRenderer renderer(page, m_document, proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(),
+                                               &m_inkMapperForRendering, settings, pagePointToDevicePoint);
 
-    renderer.beginPaint(imageSize);
-    result.errors = renderer.processContents();
-    renderer.endPaint();
+    result.errors = renderer.render(imageSize);
 
     QImage image = renderer.toImage(false, true, paperColor);
 
@@ -392,6 +480,7 @@ void OutputPreviewDialog::onPageImageRendered()
         m_futureWatcher->deleteLater();
         m_futureWatcher = nullptr;
 
+        m_inkMapperForPageImage = m_inkMapperForRendering;
         m_outputPreviewWidget->setPageImage(qMove(result.image), qMove(result.originalProcessImage), result.pageSize);
 
         if (m_needUpdateImage)
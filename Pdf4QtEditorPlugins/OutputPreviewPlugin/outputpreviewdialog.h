@@ -63,6 +63,7 @@ private:
     void onInksChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QVector<int>& roles);
     void onInkCoverageLimitChanged(double value);
     void onRichBlackLimtiChanged(double value);
+    void onExportSeparationsClicked();
 
     struct RenderedImage
     {
@@ -72,6 +73,7 @@ private:
         QList<pdf::PDFRenderError> errors;
     };
 
+    pdf::PDFTransparencyRendererSettings::Flags getDisplayFlags() const;
     void updatePageImage();
     void onPageImageRendered();
     RenderedImage renderPage(const pdf::PDFPage* page,
@@ -84,6 +86,7 @@ private:
     Ui::OutputPreviewDialog* ui;
     pdf::PDFInkMapper m_inkMapper;
     pdf::PDFInkMapper m_inkMapperForRendering;
+    pdf::PDFInkMapper m_inkMapperForPageImage; ///< Ink mapper used to render the displayed page image
     const pdf::PDFDocument* m_document;
     pdf::PDFWidget* m_widget;
     bool m_needUpdateImage;
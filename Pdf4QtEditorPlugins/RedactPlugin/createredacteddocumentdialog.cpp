@@ -78,6 +78,11 @@ bool CreateRedactedDocumentDialog::isCopyingOutline() const
     return ui->copyOutlineCheckBox->isChecked();
 }
 
+bool CreateRedactedDocumentDialog::isEditingContentStreams() const
+{
+    return ui->editContentStreamsCheckBox->isChecked();
+}
+
 void CreateRedactedDocumentDialog::on_selectDirectoryButton_clicked()
 {
     QString fileName = QFileDialog::getSaveFileName(this, tr("File Name"), ui->fileNameEdit->text());
@@ -44,6 +44,7 @@ public:
     bool isCopyingTitle() const;
     bool isCopyingMetadata() const;
     bool isCopyingOutline() const;
+    bool isEditingContentStreams() const;
 
 private slots:
     void on_selectDirectoryButton_clicked();
@@ -139,7 +139,7 @@ void RedactPlugin::onRedactTextSelectionTriggered()
 
     if (modifier.finalize())
     {
-        Q_EMIT m_widget->getToolManager()->documentModified(pdf::PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+        Q_EMIT m_widget->getToolManager()->documentModified(modifier.getModifiedDocument());
     }
 }
 
@@ -170,7 +170,7 @@ void RedactPlugin::onRedactPageTriggered()
 
         if (modifier.finalize())
         {
-            Q_EMIT m_widget->getToolManager()->documentModified(pdf::PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT m_widget->getToolManager()->documentModified(modifier.getModifiedDocument());
         }
     }
 }
@@ -192,6 +192,7 @@ void RedactPlugin::onCreateRedactedDocumentTriggered()
         options.setFlag(pdf::PDFRedact::CopyTitle, dialog.isCopyingTitle());
         options.setFlag(pdf::PDFRedact::CopyMetadata, dialog.isCopyingMetadata());
         options.setFlag(pdf::PDFRedact::CopyOutline, dialog.isCopyingOutline());
+        options.setFlag(pdf::PDFRedact::EditContentStreams, dialog.isEditingContentStreams());
 
         pdf::PDFDocument redactedDocument = redactProcessor.perform(options);
         pdf::PDFDocumentWriter writer(m_widget->getDrawWidgetProxy()->getProgress());
@@ -279,7 +279,8 @@ void SignaturePlugin::onSceneEditElement(const std::set<pdf::PDFInteger>& elemen
 
     if (pdf::PDFPageContentEditorStyleSettings::showEditElementStyleDialog(m_dataExchangeInterface->getMainWindow(), element))
     {
-        updateGraphics();
+        // Replace the element, so scene updates its index of elements
+        m_scene.replaceElement(element->clone());
     }
 }
 
@@ -310,7 +311,7 @@ void SignaturePlugin::onSignElectronically()
 
         if (modifier.finalize())
         {
-            Q_EMIT m_widget->getToolManager()->documentModified(pdf::PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT m_widget->getToolManager()->documentModified(modifier.getModifiedDocument());
         }
     }
 }
@@ -20,6 +20,10 @@
 
 #include "pdfglobal.h"
 
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
 namespace pdf
 {
 
@@ -92,8 +96,11 @@ public:
 
 /// Algorithm for computing longest common subsequence, on two sequences
 /// of objects, which are implementing operator "==" (equal operator).
-/// Constructor takes bidirectional iterators to the sequence. So, iterators
-/// are requred to be bidirectional.
+/// Constructor takes iterators to the sequence. Random access iterators
+/// are strongly recommended, as items are accessed by index. Algorithm
+/// uses Myers' O(ND) difference algorithm with linear space refinement
+/// (divide and conquer using middle snake), small subproblems are solved
+/// by dynamic programming.
 template<typename Iterator, typename Comparator>
 class PDFAlgorithmLongestCommonSubsequence : public PDFAlgorithmLongestCommonSubsequenceBase
 {
@@ -110,6 +117,29 @@ public:
     const Sequence& getSequence() const { return m_sequence; }
 
 private:
+    /// Subproblems with matrix size lower or equal to this
+    /// value are solved by dynamic programming
+    static constexpr size_t SMALL_PROBLEM_SIZE = 256 * 256;
+
+    bool isEqual(size_t index1, size_t index2) const { return m_comparator(*std::next(m_it1, index1), *std::next(m_it2, index2)); }
+
+    /// Computes subsequence of items [offset1, offset1 + size1) and
+    /// [offset2, offset2 + size2) and appends it to the result sequence.
+    void performRange(size_t offset1, size_t size1, size_t offset2, size_t size2);
+
+    /// Solves subproblem by dynamic programming, using O(size1 * size2) memory
+    void performDynamicProgramming(size_t offset1, size_t size1, size_t offset2, size_t size2);
+
+    /// Finds the middle snake of the shortest edit script of the subproblem
+    /// using Myers' algorithm. Returns false, if items have no common item.
+    /// \param[out] split1 Split position in the first sequence
+    /// \param[out] split2 Split position in the second sequence
+    bool findMiddleSnake(size_t offset1, size_t size1, size_t offset2, size_t size2, size_t& split1, size_t& split2) const;
+
+    void addMatch(size_t index1, size_t index2);
+    void addLeft(size_t index1);
+    void addRight(size_t index2);
+
     Iterator m_it1;
     Iterator m_it1End;
     Iterator m_it2;
@@ -117,11 +147,9 @@ private:
 
     size_t m_size1;
     size_t m_size2;
-    size_t m_matrixSize;
 
     Comparator m_comparator;
 
-    std::vector<bool> m_backtrackData;
     Sequence m_sequence;
 };
 
@@ -137,34 +165,245 @@ PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::PDFAlgorithmLongestC
     m_it2End(std::move(it2End)),
     m_size1(0),
     m_size2(0),
-    m_matrixSize(0),
     m_comparator(std::move(comparator))
 {
-    m_size1 = std::distance(m_it1, m_it1End) + 1;
-    m_size2 = std::distance(m_it2, m_it2End) + 1;
-    m_matrixSize = m_size1 * m_size2;
+    m_size1 = std::distance(m_it1, m_it1End);
+    m_size2 = std::distance(m_it2, m_it2End);
 }
 
 template<typename Iterator, typename Comparator>
 void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
 {
-    m_backtrackData.resize(m_matrixSize);
     m_sequence.clear();
+    m_sequence.reserve(m_size1 + m_size2);
+    performRange(0, m_size1, 0, m_size2);
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::performRange(size_t offset1, size_t size1, size_t offset2, size_t size2)
+{
+    // Common prefix is always a part of some longest common subsequence
+    size_t prefixSize = 0;
+    while (prefixSize < size1 && prefixSize < size2 && isEqual(offset1 + prefixSize, offset2 + prefixSize))
+    {
+        addMatch(offset1 + prefixSize, offset2 + prefixSize);
+        ++prefixSize;
+    }
+
+    offset1 += prefixSize;
+    offset2 += prefixSize;
+    size1 -= prefixSize;
+    size2 -= prefixSize;
+
+    // The same holds for common suffix, we will add it at the end
+    size_t suffixSize = 0;
+    while (suffixSize < size1 && suffixSize < size2 && isEqual(offset1 + size1 - suffixSize - 1, offset2 + size2 - suffixSize - 1))
+    {
+        ++suffixSize;
+    }
+
+    size1 -= suffixSize;
+    size2 -= suffixSize;
+
+    if (size1 == 0 || size2 == 0)
+    {
+        for (size_t i = 0; i < size1; ++i)
+        {
+            addLeft(offset1 + i);
+        }
+
+        for (size_t i = 0; i < size2; ++i)
+        {
+            addRight(offset2 + i);
+        }
+    }
+    else if ((size1 + 1) * (size2 + 1) <= SMALL_PROBLEM_SIZE)
+    {
+        performDynamicProgramming(offset1, size1, offset2, size2);
+    }
+    else
+    {
+        size_t split1 = 0;
+        size_t split2 = 0;
+
+        // Split must divide the problem into two smaller problems
+        if (findMiddleSnake(offset1, size1, offset2, size2, split1, split2) &&
+            (split1 > 0 || split2 > 0) && (split1 < size1 || split2 < size2))
+        {
+            performRange(offset1, split1, offset2, split2);
+            performRange(offset1 + split1, size1 - split1, offset2 + split2, size2 - split2);
+        }
+        else
+        {
+            // Sequences do not have any common item
+            for (size_t i = 0; i < size1; ++i)
+            {
+                addLeft(offset1 + i);
+            }
+
+            for (size_t i = 0; i < size2; ++i)
+            {
+                addRight(offset2 + i);
+            }
+        }
+    }
+
+    for (size_t i = suffixSize; i > 0; --i)
+    {
+        addMatch(offset1 + size1 + suffixSize - i, offset2 + size2 + suffixSize - i);
+    }
+}
+
+template<typename Iterator, typename Comparator>
+bool PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::findMiddleSnake(size_t offset1,
+                                                                                 size_t size1,
+                                                                                 size_t offset2,
+                                                                                 size_t size2,
+                                                                                 size_t& split1,
+                                                                                 size_t& split2) const
+{
+    // Jakub Melka: we search the shortest edit script simultaneously from
+    // the start and from the end of the sequences. Vector forward[k] contains
+    // furthest x-position on diagonal k (k = x - y) reached from the start,
+    // vector backward[k] contains furthest x-position on diagonal k reached
+    // from the end (in reversed coordinates). When paths overlap, we have
+    // found the middle snake and we can split the problem into two halves.
+
+    const ptrdiff_t n = static_cast<ptrdiff_t>(size1);
+    const ptrdiff_t m = static_cast<ptrdiff_t>(size2);
+    const ptrdiff_t maxD = (n + m + 1) / 2;
+    const ptrdiff_t vOffset = maxD;
+    const ptrdiff_t vLength = 2 * maxD + 2;
+    const ptrdiff_t delta = n - m;
+    const bool isDeltaOdd = (delta % 2) != 0;
+
+    std::vector<ptrdiff_t> forward(vLength, -1);
+    std::vector<ptrdiff_t> backward(vLength, -1);
+    forward[vOffset + 1] = 0;
+    backward[vOffset + 1] = 0;
+
+    // Diagonals, which went out of the edit graph, are skipped
+    ptrdiff_t k1Start = 0;
+    ptrdiff_t k1End = 0;
+    ptrdiff_t k2Start = 0;
+    ptrdiff_t k2End = 0;
+
+    for (ptrdiff_t d = 0; d < maxD; ++d)
+    {
+        for (ptrdiff_t k1 = -d + k1Start; k1 <= d - k1End; k1 += 2)
+        {
+            const ptrdiff_t k1Offset = vOffset + k1;
+            ptrdiff_t x1 = 0;
+            if (k1 == -d || (k1 != d && forward[k1Offset - 1] < forward[k1Offset + 1]))
+            {
+                x1 = forward[k1Offset + 1];
+            }
+            else
+            {
+                x1 = forward[k1Offset - 1] + 1;
+            }
 
-    std::vector<size_t> rowTop(m_size1, size_t());
-    std::vector<size_t> rowBottom(m_size1, size_t());
+            ptrdiff_t y1 = x1 - k1;
+            while (x1 < n && y1 < m && isEqual(offset1 + x1, offset2 + y1))
+            {
+                ++x1;
+                ++y1;
+            }
+
+            forward[k1Offset] = x1;
+            if (x1 > n)
+            {
+                k1End += 2;
+            }
+            else if (y1 > m)
+            {
+                k1Start += 2;
+            }
+            else if (isDeltaOdd)
+            {
+                const ptrdiff_t k2Offset = vOffset + delta - k1;
+                if (k2Offset >= 0 && k2Offset < vLength && backward[k2Offset] != -1)
+                {
+                    const ptrdiff_t x2 = n - backward[k2Offset];
+                    if (x1 >= x2)
+                    {
+                        split1 = x1;
+                        split2 = y1;
+                        return true;
+                    }
+                }
+            }
+        }
+
+        for (ptrdiff_t k2 = -d + k2Start; k2 <= d - k2End; k2 += 2)
+        {
+            const ptrdiff_t k2Offset = vOffset + k2;
+            ptrdiff_t x2 = 0;
+            if (k2 == -d || (k2 != d && backward[k2Offset - 1] < backward[k2Offset + 1]))
+            {
+                x2 = backward[k2Offset + 1];
+            }
+            else
+            {
+                x2 = backward[k2Offset - 1] + 1;
+            }
+
+            ptrdiff_t y2 = x2 - k2;
+            while (x2 < n && y2 < m && isEqual(offset1 + n - x2 - 1, offset2 + m - y2 - 1))
+            {
+                ++x2;
+                ++y2;
+            }
+
+            backward[k2Offset] = x2;
+            if (x2 > n)
+            {
+                k2End += 2;
+            }
+            else if (y2 > m)
+            {
+                k2Start += 2;
+            }
+            else if (!isDeltaOdd)
+            {
+                const ptrdiff_t k1Offset = vOffset + delta - k2;
+                if (k1Offset >= 0 && k1Offset < vLength && forward[k1Offset] != -1)
+                {
+                    const ptrdiff_t x1 = forward[k1Offset];
+                    const ptrdiff_t y1 = vOffset + x1 - k1Offset;
+                    if (x1 >= n - x2)
+                    {
+                        split1 = x1;
+                        split2 = y1;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::performDynamicProgramming(size_t offset1, size_t size1, size_t offset2, size_t size2)
+{
+    const size_t matrixSize1 = size1 + 1;
+    const size_t matrixSize2 = size2 + 1;
+
+    std::vector<bool> backtrackData(matrixSize1 * matrixSize2, false);
+    std::vector<size_t> rowTop(matrixSize1, size_t());
+    std::vector<size_t> rowBottom(matrixSize1, size_t());
 
     // Jakub Melka: we will have columns consisting of it1...it1End
     // and rows consisting of it2...it2End. We iterate trough rows,
     // and for each row, we update longest common subsequence data.
 
-    auto it2 = m_it2;
-    for (size_t i2 = 1; i2 < m_size2; ++i2, ++it2)
+    for (size_t i2 = 1; i2 < matrixSize2; ++i2)
     {
-        auto it1 = m_it1;
-        for (size_t i1 = 1; i1 < m_size1; ++i1, ++it1)
+        for (size_t i1 = 1; i1 < matrixSize1; ++i1)
         {
-            if (m_comparator(*it1, *it2))
+            if (isEqual(offset1 + i1 - 1, offset2 + i2 - 1))
             {
                 // We have match
                 rowBottom[i1] = rowTop[i1 - 1] + 1;
@@ -178,12 +417,12 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
                 if (isLeftBigger)
                 {
                     rowBottom[i1] = leftCellValue;
-                    m_backtrackData[i2 * m_size1 + i1] = true;
+                    backtrackData[i2 * matrixSize1 + i1] = true;
                 }
                 else
                 {
                     rowBottom[i1] = upperCellValue;
-                    m_backtrackData[i2 * m_size1 + i1] = false;
+                    backtrackData[i2 * matrixSize1 + i1] = false;
                 }
             }
         }
@@ -192,20 +431,20 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
         std::swap(rowTop, rowBottom);
     }
 
-    size_t i1 = m_size1 - 1;
-    size_t i2 = m_size2 - 1;
+    Sequence sequence;
+    sequence.reserve(size1 + size2);
+
+    size_t i1 = size1;
+    size_t i2 = size2;
 
     while (i1 > 0 && i2 > 0)
     {
         SequenceItem item;
 
-        const size_t index1 = i1 - 1;
-        const size_t index2 = i2 - 1;
-
-        auto cit1 = std::next(m_it1, index1);
-        auto cit2 = std::next(m_it2, index2);
+        const size_t index1 = offset1 + i1 - 1;
+        const size_t index2 = offset2 + i2 - 1;
 
-        if (m_comparator(*cit1, *cit2))
+        if (isEqual(index1, index2))
         {
             item.index1 = index1;
             item.index2 = index2;
@@ -215,7 +454,7 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
         }
         else
         {
-            if (m_backtrackData[i2 * m_size1 + i1])
+            if (backtrackData[i2 * matrixSize1 + i1])
             {
                 item.index1 = index1;
                 --i1;
@@ -227,32 +466,53 @@ void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::perform()
             }
         }
 
-        m_sequence.push_back(item);
+        sequence.push_back(item);
     }
 
     while (i1 > 0)
     {
         SequenceItem item;
-
-        const size_t index1 = i1 - 1;
-        item.index1 = index1;
+        item.index1 = offset1 + i1 - 1;
         --i1;
 
-        m_sequence.push_back(item);
+        sequence.push_back(item);
     }
 
     while (i2 > 0)
     {
         SequenceItem item;
-
-        const size_t index2 = i2 - 1;
-        item.index2 = index2;
+        item.index2 = offset2 + i2 - 1;
         --i2;
 
-        m_sequence.push_back(item);
+        sequence.push_back(item);
     }
 
-    std::reverse(m_sequence.begin(), m_sequence.end());
+    m_sequence.insert(m_sequence.end(), sequence.crbegin(), sequence.crend());
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::addMatch(size_t index1, size_t index2)
+{
+    SequenceItem item;
+    item.index1 = index1;
+    item.index2 = index2;
+    m_sequence.push_back(item);
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::addLeft(size_t index1)
+{
+    SequenceItem item;
+    item.index1 = index1;
+    m_sequence.push_back(item);
+}
+
+template<typename Iterator, typename Comparator>
+void PDFAlgorithmLongestCommonSubsequence<Iterator, Comparator>::addRight(size_t index2)
+{
+    SequenceItem item;
+    item.index2 = index2;
+    m_sequence.push_back(item);
 }
 
 }   // namespace pdf
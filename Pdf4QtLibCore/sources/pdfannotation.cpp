@@ -28,6 +28,8 @@
 
 #include <QtMath>
 #include <QIcon>
+#include <QPicture>
+#include <QGuiApplication>
 
 #include "pdfdbgheap.h"
 
@@ -303,6 +305,36 @@ void PDFAnnotation::draw(AnnotationDrawParameters& parameters) const
     Q_UNUSED(parameters);
 }
 
+bool PDFAnnotation::isDrawnUsingSystemFonts() const
+{
+    switch (getType())
+    {
+        case AnnotationType::Text:
+        case AnnotationType::FreeText:
+        case AnnotationType::Stamp:
+        case AnnotationType::FileAttachment:
+        case AnnotationType::Sound:
+        case AnnotationType::Widget:
+            return true;
+
+        case AnnotationType::Line:
+            // Contents of the line annotation are drawn as caption
+            return !getContents().isEmpty();
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+bool PDFAnnotation::isSystemFontAvailable()
+{
+    // Font database requires platform integration, which
+    // is created only by the QGuiApplication.
+    return qobject_cast<QGuiApplication*>(QCoreApplication::instance()) != nullptr;
+}
+
 std::vector<PDFAppeareanceStreams::Key> PDFAnnotation::getDrawKeys(const PDFFormManager* formManager) const
 {
     Q_UNUSED(formManager);
@@ -1453,6 +1485,17 @@ void PDFAnnotationManager::drawPage(QPainter* painter,
         const PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
         m_fontCache->setCacheShrinkEnabled(&fontCacheLock, false);
 
+        {
+            // Compiled appearances are valid only for color management system,
+            // with which they were compiled.
+            QMutexLocker lock(&m_mutex);
+            if (m_compiledAppearancesCMS != cms)
+            {
+                m_compiledAppearancesCMS = cms;
+                ++m_settingsRevision;
+            }
+        }
+
         const PageAnnotation* annotationDrawnByEditor = nullptr;
         for (const PageAnnotation& annotation : annotations.annotations)
         {
@@ -1505,6 +1548,12 @@ void PDFAnnotationManager::drawAnnotation(const PageAnnotation& annotation,
             // We do not draw annotation, if it is not ignored and annotation
             // has reference to optional content.
 
+            if (annotation.annotation->isDrawnUsingSystemFonts() && !PDFAnnotation::isSystemFontAvailable())
+            {
+                errors.push_back(PDFRenderError(RenderErrorType::NotSupported, PDFTranslationContext::tr("Annotation without appearance stream can't be drawn, system fonts are not available.")));
+                return;
+            }
+
             drawAnnotationDirect(annotation, pagePointToDevicePointMatrix, page, cms, isEditorDrawEnabled, painter);
         }
         else
@@ -1564,12 +1613,11 @@ void PDFAnnotationManager::drawAnnotationDirect(const PageAnnotation& annotation
     }
 
     QRectF annotationRectangle = annotation.annotation->getRectangle();
+
+    auto drawAnnotationToPainter = [&](QPainter* targetPainter)
     {
-        PDFPainterStateGuard guard(painter);
-        painter->setRenderHint(QPainter::Antialiasing, true);
-        painter->setWorldTransform(QTransform(pagePointToDevicePointMatrix), true);
         AnnotationDrawParameters parameters;
-        parameters.painter = painter;
+        parameters.painter = targetPainter;
         parameters.annotation = annotation.annotation.data();
         parameters.formManager = m_formManager;
         parameters.key = std::make_pair(annotation.appearance, annotation.annotation->getAppearanceState());
@@ -1577,10 +1625,52 @@ void PDFAnnotationManager::drawAnnotationDirect(const PageAnnotation& annotation
         PDFRenderer::applyFeaturesToColorConvertor(m_features, parameters.colorConvertor);
 
         annotation.annotation->draw(parameters);
+        return parameters.boundingRectangle;
+    };
+
+    // Widget annotations are drawn using form field values, which can be changed
+    // without annotation modification, so we do not cache them. Also, appearance
+    // drawn by the editor is always drawn directly.
+    const bool isCacheable = m_target == Target::View && !isEditorDrawEnabled && annotation.annotation->getType() != AnnotationType::Widget;
+
+    if (isCacheable)
+    {
+        CompiledAppearancePointer compiledAppearance = findCompiledAppearance(annotation);
+        if (!compiledAppearance)
+        {
+            std::shared_ptr<CompiledAppearance> newCompiledAppearance = createCompiledAppearance(annotation);
+            newCompiledAppearance->picture = std::make_shared<QPicture>();
+
+            // Picture is recorded in page space
+            QPainter picturePainter(newCompiledAppearance->picture.get());
+            picturePainter.setRenderHint(QPainter::Antialiasing, true);
+            newCompiledAppearance->boundingRectangle = drawAnnotationToPainter(&picturePainter);
+            picturePainter.end();
+
+            compiledAppearance = newCompiledAppearance;
+            storeCompiledAppearance(annotation, compiledAppearance);
+        }
+
+        PDFPainterStateGuard guard(painter);
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->setWorldTransform(QTransform(pagePointToDevicePointMatrix), true);
+        painter->drawPicture(QPointF(0, 0), *compiledAppearance->picture);
+
+        if (compiledAppearance->boundingRectangle.isValid())
+        {
+            annotationRectangle = compiledAppearance->boundingRectangle;
+        }
+    }
+    else
+    {
+        PDFPainterStateGuard guard(painter);
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->setWorldTransform(QTransform(pagePointToDevicePointMatrix), true);
 
-        if (parameters.boundingRectangle.isValid())
+        QRectF boundingRectangle = drawAnnotationToPainter(painter);
+        if (boundingRectangle.isValid())
         {
-            annotationRectangle = parameters.boundingRectangle;
+            annotationRectangle = boundingRectangle;
         }
     }
 
@@ -1609,10 +1699,6 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     QRectF annotationRectangle = annotation.annotation->getRectangle();
     QRectF formBoundingBox = loader.readRectangle(formDictionary->get("BBox"), QRectF());
     QTransform formMatrix = loader.readMatrixFromDictionary(formDictionary, "Matrix", QTransform());
-    QByteArray content = m_document->getDecodedStream(formStream);
-    PDFObject resources = m_document->getObject(formDictionary->get("Resources"));
-    PDFObject transparencyGroup = m_document->getObject(formDictionary->get("Group"));
-    const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(formDictionary, "StructParent", page->getStructureParentKey());
 
     if (formBoundingBox.isEmpty() || annotationRectangle.isEmpty())
     {
@@ -1646,22 +1732,36 @@ void PDFAnnotationManager::drawAnnotationUsingAppearanceStream(const PageAnnotat
     // Step 3) - compute final matrix AA
     QTransform AA = formMatrix * A;
 
-    bool isContentVisible = false;
+    // Appearance stream is compiled only once, then precompiled content
+    // is drawn with actual transformation (it can differ due to zoom).
+    CompiledAppearancePointer compiledAppearance = findCompiledAppearance(annotation);
+    if (!compiledAppearance)
+    {
+        compiledAppearance = compileAppearanceStream(annotation, appearanceStreamObject, page, cms);
+        storeCompiledAppearance(annotation, compiledAppearance);
+    }
+
+    const bool isContentVisible = compiledAppearance->isContentVisible;
+    const QTransform formSpaceToDeviceSpace = AA * userSpaceToDeviceSpace;
 
     // Draw annotation
+    if (isContentVisible && formSpaceToDeviceSpace.isInvertible())
     {
         PDFPainterStateGuard guard(painter);
-        PDFPainter pdfPainter(painter, features, userSpaceToDeviceSpace, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
-        pdfPainter.initializeProcessor();
 
-        // Jakub Melka: we must check, that we do not display annotation disabled by optional content
-        PDFObjectReference oc = annotation.annotation->getOptionalContent();
-        isContentVisible = !oc.isValid() || !pdfPainter.isContentSuppressedByOC(oc);
-
-        if (isContentVisible)
+        if (features.testFlag(PDFRenderer::ClipToCropBox))
         {
-            pdfPainter.processForm(AA, formBoundingBox, resources, transparencyGroup, content, formStructuralParentKey);
+            const QRectF cropBox = page->getCropBox();
+            if (cropBox.isValid())
+            {
+                QPainterPath path;
+                path.addPolygon(userSpaceToDeviceSpace.map(cropBox));
+                painter->setWorldTransform(QTransform());
+                painter->setClipPath(path, Qt::IntersectClip);
+            }
         }
+
+        compiledAppearance->precompiledPage->draw(painter, QRectF(), formSpaceToDeviceSpace, features, painter->opacity());
     }
 
     // Draw highlighting of fields, but only, if target is View,
@@ -1680,11 +1780,47 @@ void PDFAnnotationManager::setDocument(const PDFModifiedDocument& document)
     if (m_document != document)
     {
         m_document = document;
-        m_optionalActivity = document.getOptionalContentActivity();
+
+        if (m_optionalActivity != document.getOptionalContentActivity())
+        {
+            m_optionalActivity = document.getOptionalContentActivity();
+            invalidateCompiledAppearances();
+        }
 
         if (document.hasReset() || document.hasFlag(PDFModifiedDocument::Annotation))
         {
-            m_pageAnnotations.clear();
+            if (document.hasAffectedPages())
+            {
+                // Annotations of other pages were not changed
+                for (PDFInteger pageIndex : document.getAffectedPages())
+                {
+                    m_pageAnnotations.erase(pageIndex);
+                }
+            }
+            else
+            {
+                m_pageAnnotations.clear();
+            }
+        }
+        else if (document.hasAffectedPages())
+        {
+            // Resources used by appearances of annotations on affected pages can be changed
+            QMutexLocker lock(&m_mutex);
+            for (PDFInteger pageIndex : document.getAffectedPages())
+            {
+                auto it = m_pageAnnotations.find(pageIndex);
+                if (it != m_pageAnnotations.end())
+                {
+                    for (PageAnnotation& pageAnnotation : it->second.annotations)
+                    {
+                        pageAnnotation.compiledAppearances.clear();
+                    }
+                }
+            }
+        }
+        else
+        {
+            invalidateCompiledAppearances();
         }
     }
 }
@@ -1732,6 +1868,7 @@ PDFAnnotationManager::PageAnnotations& PDFAnnotationManager::getPageAnnotations(
             }
         }
 
+        annotations.buildSpatialIndex();
         it = m_pageAnnotations.insert(std::make_pair(pageIndex, qMove(annotations))).first;
     }
 
@@ -1784,7 +1921,11 @@ PDFRenderer::Features PDFAnnotationManager::getFeatures() const
 
 void PDFAnnotationManager::setFeatures(PDFRenderer::Features features)
 {
-    m_features = features;
+    if (m_features != features)
+    {
+        m_features = features;
+        invalidateCompiledAppearances();
+    }
 }
 
 PDFMeshQualitySettings PDFAnnotationManager::getMeshQualitySettings() const
@@ -1795,6 +1936,7 @@ PDFMeshQualitySettings PDFAnnotationManager::getMeshQualitySettings() const
 void PDFAnnotationManager::setMeshQualitySettings(const PDFMeshQualitySettings& meshQualitySettings)
 {
     m_meshQualitySettings = meshQualitySettings;
+    invalidateCompiledAppearances();
 }
 
 PDFFontCache* PDFAnnotationManager::getFontCache() const
@@ -1805,6 +1947,7 @@ PDFFontCache* PDFAnnotationManager::getFontCache() const
 void PDFAnnotationManager::setFontCache(PDFFontCache* fontCache)
 {
     m_fontCache = fontCache;
+    invalidateCompiledAppearances();
 }
 
 const PDFOptionalContentActivity* PDFAnnotationManager::getOptionalActivity() const
@@ -1815,6 +1958,7 @@ const PDFOptionalContentActivity* PDFAnnotationManager::getOptionalActivity() co
 void PDFAnnotationManager::setOptionalActivity(const PDFOptionalContentActivity* optionalActivity)
 {
     m_optionalActivity = optionalActivity;
+    invalidateCompiledAppearances();
 }
 
 PDFAnnotationManager::Target PDFAnnotationManager::getTarget() const
@@ -1825,6 +1969,109 @@ PDFAnnotationManager::Target PDFAnnotationManager::getTarget() const
 void PDFAnnotationManager::setTarget(Target target)
 {
     m_target = target;
+    invalidateCompiledAppearances();
+}
+
+PDFAnnotationManager::CompiledAppearancePointer PDFAnnotationManager::findCompiledAppearance(const PageAnnotation& annotation) const
+{
+    const PDFAppeareanceStreams::Key key(annotation.appearance, annotation.annotation->getAppearanceState());
+    const quint64 optionalContentRevision = m_optionalActivity ? m_optionalActivity->getStateRevision() : 0;
+
+    QMutexLocker lock(&m_mutex);
+    for (const CompiledAppearancePointer& compiledAppearance : annotation.compiledAppearances)
+    {
+        if (compiledAppearance->key == key &&
+            compiledAppearance->settingsRevision == m_settingsRevision &&
+            compiledAppearance->optionalContentRevision == optionalContentRevision)
+        {
+            return compiledAppearance;
+        }
+    }
+
+    return nullptr;
+}
+
+void PDFAnnotationManager::storeCompiledAppearance(const PageAnnotation& annotation, CompiledAppearancePointer compiledAppearance) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto isObsolete = [this, &compiledAppearance](const CompiledAppearancePointer& item)
+    {
+        return item->key == compiledAppearance->key ||
+               item->settingsRevision != m_settingsRevision ||
+               item->optionalContentRevision != compiledAppearance->optionalContentRevision;
+    };
+
+    std::vector<CompiledAppearancePointer>& compiledAppearances = annotation.compiledAppearances;
+    compiledAppearances.erase(std::remove_if(compiledAppearances.begin(), compiledAppearances.end(), isObsolete), compiledAppearances.end());
+
+    if (compiledAppearance->settingsRevision == m_settingsRevision)
+    {
+        compiledAppearances.emplace_back(qMove(compiledAppearance));
+    }
+}
+
+std::shared_ptr<PDFAnnotationManager::CompiledAppearance> PDFAnnotationManager::createCompiledAppearance(const PageAnnotation& annotation) const
+{
+    std::shared_ptr<CompiledAppearance> compiledAppearance = std::make_shared<CompiledAppearance>();
+    compiledAppearance->key = PDFAppeareanceStreams::Key(annotation.appearance, annotation.annotation->getAppearanceState());
+    compiledAppearance->optionalContentRevision = m_optionalActivity ? m_optionalActivity->getStateRevision() : 0;
+
+    QMutexLocker lock(&m_mutex);
+    compiledAppearance->settingsRevision = m_settingsRevision;
+    return compiledAppearance;
+}
+
+PDFAnnotationManager::CompiledAppearancePointer PDFAnnotationManager::compileAppearanceStream(const PageAnnotation& annotation,
+                                                                                              const PDFObject& appearanceStreamObject,
+                                                                                              const PDFPage* page,
+                                                                                              const PDFCMS* cms) const
+{
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFStream* formStream = appearanceStreamObject.getStream();
+    const PDFDictionary* formDictionary = formStream->getDictionary();
+
+    QRectF formBoundingBox = loader.readRectangle(formDictionary->get("BBox"), QRectF());
+    QByteArray content = m_document->getDecodedStream(formStream);
+    PDFObject resources = m_document->getObject(formDictionary->get("Resources"));
+    PDFObject transparencyGroup = m_document->getObject(formDictionary->get("Group"));
+    const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(formDictionary, "StructParent", page->getStructureParentKey());
+
+    std::shared_ptr<CompiledAppearance> compiledAppearance = createCompiledAppearance(annotation);
+    compiledAppearance->precompiledPage = std::make_shared<PDFPrecompiledPage>();
+
+    // Appearance is compiled in form space (form matrix isn't applied), because
+    // mapping to the annotation rectangle can depend on the zoom (NoZoom flag).
+    // Clipping to the crop box is performed, when appearance is drawn.
+    PDFRenderer::Features features = m_features;
+    features.setFlag(PDFRenderer::ClipToCropBox, false);
+
+    PDFPrecompiledPage* precompiledPage = compiledAppearance->precompiledPage.get();
+    PDFPrecompiledPageGenerator generator(precompiledPage, features, page, m_document, m_fontCache, cms, m_optionalActivity, m_meshQualitySettings);
+    generator.initializeProcessor();
+
+    // Jakub Melka: we must check, that we do not display annotation disabled by optional content
+    PDFObjectReference oc = annotation.annotation->getOptionalContent();
+    compiledAppearance->isContentVisible = !oc.isValid() || !generator.isContentSuppressedByOC(oc);
+
+    if (compiledAppearance->isContentVisible)
+    {
+        generator.processForm(QTransform(), formBoundingBox, resources, transparencyGroup, content, formStructuralParentKey);
+    }
+
+    PDFColorConvertor colorConvertor = cms->getColorConvertor();
+    PDFRenderer::applyFeaturesToColorConvertor(m_features, colorConvertor);
+    precompiledPage->convertColors(colorConvertor);
+    precompiledPage->optimize();
+    precompiledPage->finalize(0, QList<PDFRenderError>());
+
+    return compiledAppearance;
+}
+
+void PDFAnnotationManager::invalidateCompiledAppearances()
+{
+    QMutexLocker lock(&m_mutex);
+    ++m_settingsRevision;
 }
 
 
@@ -3190,6 +3437,107 @@ const PDFAnnotationManager::PageAnnotation* PDFAnnotationManager::PageAnnotation
     return nullptr;
 }
 
+std::vector<size_t> PDFAnnotationManager::PageAnnotations::getAnnotationsAtPoint(const QPointF& point) const
+{
+    std::vector<size_t> result(spatialIndex.alwaysTested.cbegin(), spatialIndex.alwaysTested.cend());
+
+    if (spatialIndex.columns > 0 && spatialIndex.rows > 0 && spatialIndex.bounds.contains(point))
+    {
+        const PDFReal cellWidth = spatialIndex.bounds.width() / spatialIndex.columns;
+        const PDFReal cellHeight = spatialIndex.bounds.height() / spatialIndex.rows;
+        const int column = qBound(0, int((point.x() - spatialIndex.bounds.left()) / cellWidth), spatialIndex.columns - 1);
+        const int row = qBound(0, int((point.y() - spatialIndex.bounds.top()) / cellHeight), spatialIndex.rows - 1);
+        const size_t cell = size_t(row) * spatialIndex.columns + column;
+
+        const uint32_t begin = spatialIndex.cellOffsets[cell];
+        const uint32_t end = spatialIndex.cellOffsets[cell + 1];
+        result.insert(result.end(), spatialIndex.cellItems.cbegin() + begin, spatialIndex.cellItems.cbegin() + end);
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void PDFAnnotationManager::PageAnnotations::buildSpatialIndex()
+{
+    spatialIndex = SpatialIndex();
+
+    // Jakub Melka: rectangles of annotations are enlarged by small epsilon,
+    // so degenerate rectangles and hit tests at the border are handled
+    // correctly (exact hit test is performed by the caller anyway).
+    constexpr PDFReal epsilon = 0.01;
+    std::vector<std::pair<uint32_t, QRectF>> rectangles;
+    rectangles.reserve(annotations.size());
+
+    for (size_t i = 0, count = annotations.size(); i < count; ++i)
+    {
+        const PDFAnnotation* annotation = annotations[i].annotation.data();
+        const PDFAnnotation::Flags flags = annotation->getEffectiveFlags();
+        QRectF rectangle = annotation->getRectangle();
+
+        if (flags.testFlag(PDFAnnotation::NoZoom) || flags.testFlag(PDFAnnotation::NoRotate) || !rectangle.isValid())
+        {
+            spatialIndex.alwaysTested.push_back(uint32_t(i));
+            continue;
+        }
+
+        rectangle.adjust(-epsilon, -epsilon, epsilon, epsilon);
+        rectangles.emplace_back(uint32_t(i), rectangle);
+        spatialIndex.bounds = spatialIndex.bounds.united(rectangle);
+    }
+
+    if (rectangles.empty())
+    {
+        return;
+    }
+
+    // Grid has approximately one annotation per cell
+    const int gridSize = qBound(1, int(std::ceil(std::sqrt(PDFReal(rectangles.size())))), 64);
+    spatialIndex.columns = gridSize;
+    spatialIndex.rows = gridSize;
+
+    const PDFReal cellWidth = spatialIndex.bounds.width() / spatialIndex.columns;
+    const PDFReal cellHeight = spatialIndex.bounds.height() / spatialIndex.rows;
+    const size_t cellCount = size_t(spatialIndex.columns) * spatialIndex.rows;
+
+    auto forEachCell = [&](const QRectF& rectangle, auto function)
+    {
+        const int left = qBound(0, int((rectangle.left() - spatialIndex.bounds.left()) / cellWidth), spatialIndex.columns - 1);
+        const int right = qBound(0, int((rectangle.right() - spatialIndex.bounds.left()) / cellWidth), spatialIndex.columns - 1);
+        const int top = qBound(0, int((rectangle.top() - spatialIndex.bounds.top()) / cellHeight), spatialIndex.rows - 1);
+        const int bottom = qBound(0, int((rectangle.bottom() - spatialIndex.bounds.top()) / cellHeight), spatialIndex.rows - 1);
+
+        for (int row = top; row <= bottom; ++row)
+        {
+            for (int column = left; column <= right; ++column)
+            {
+                function(size_t(row) * spatialIndex.columns + column);
+            }
+        }
+    };
+
+    // Count items in the cells, then fill them (items in each cell are in increasing order)
+    std::vector<uint32_t> cellCounts(cellCount, 0);
+    for (const auto& item : rectangles)
+    {
+        forEachCell(item.second, [&cellCounts](size_t cell) { ++cellCounts[cell]; });
+    }
+
+    spatialIndex.cellOffsets.resize(cellCount + 1, 0);
+    for (size_t i = 0; i < cellCount; ++i)
+    {
+        spatialIndex.cellOffsets[i + 1] = spatialIndex.cellOffsets[i] + cellCounts[i];
+    }
+
+    std::vector<uint32_t> cellPositions(spatialIndex.cellOffsets.cbegin(), std::prev(spatialIndex.cellOffsets.cend()));
+    spatialIndex.cellItems.resize(spatialIndex.cellOffsets.back(), 0);
+    for (const auto& item : rectangles)
+    {
+        const uint32_t index = item.first;
+        forEachCell(item.second, [this, &cellPositions, index](size_t cell) { spatialIndex.cellItems[cellPositions[cell]++] = index; });
+    }
+}
+
 std::vector<const PDFAnnotationManager::PageAnnotation*> PDFAnnotationManager::PageAnnotations::getReplies(const PageAnnotation& pageAnnotation) const
 {
     std::vector<const PageAnnotation*> result;
@@ -36,6 +36,7 @@
 
 #include <array>
 
+class QPicture;
 class QKeyEvent;
 class QMouseEvent;
 class QWheelEvent;
@@ -520,6 +521,16 @@ public:
     /// \param parameters Graphics parameters
     virtual void draw(AnnotationDrawParameters& parameters) const;
 
+    /// Returns true, if annotation's default appearance (drawn by function \p draw,
+    /// when annotation has no appearance stream) uses system fonts, for example,
+    /// to draw annotation's text or icon.
+    bool isDrawnUsingSystemFonts() const;
+
+    /// Returns true, if system fonts can be used for drawing. System fonts
+    /// are not available in headless applications, which are not using
+    /// QGuiApplication (for example, render servers).
+    static bool isSystemFontAvailable();
+
     /// Returns a list of appearance states, which must be created for this annotation
     virtual std::vector<PDFAppeareanceStreams::Key> getDrawKeys(const PDFFormManager* formManager) const;
 
@@ -1498,6 +1509,23 @@ public:
     PDFFormManager* getFormManager() const;
     void setFormManager(PDFFormManager* formManager);
 
+    /// Appearance of the annotation compiled for drawing. Appearance stream is
+    /// compiled to precompiled page (in form space), annotation without appearance
+    /// stream is recorded to picture (in page space). Compiled appearance is valid
+    /// only for the settings, with which it was compiled (see revisions).
+    struct CompiledAppearance
+    {
+        PDFAppeareanceStreams::Key key;
+        quint64 settingsRevision = 0;
+        quint64 optionalContentRevision = 0;
+        bool isContentVisible = true;
+        std::shared_ptr<PDFPrecompiledPage> precompiledPage;
+        std::shared_ptr<QPicture> picture;
+        QRectF boundingRectangle;
+    };
+
+    using CompiledAppearancePointer = std::shared_ptr<const CompiledAppearance>;
+
     struct PageAnnotation
     {
         PDFAppeareanceStreams::Appearance appearance = PDFAppeareanceStreams::Appearance::Normal;
@@ -1506,6 +1534,11 @@ public:
 
         /// This mutable appearance stream is protected by main mutex
         mutable PDFCachedItem<PDFObject> appearanceStream;
+
+        /// Compiled appearances (for different appearance states), they are
+        /// protected by main mutex. Page annotation is created again, when
+        /// annotation is changed, so compiled appearances are discarded.
+        mutable std::vector<CompiledAppearancePointer> compiledAppearances;
     };
 
     struct PDF4QTLIBCORESHARED_EXPORT PageAnnotations
@@ -1525,7 +1558,33 @@ public:
         /// \returns List of replies
         std::vector<const PageAnnotation*> getReplies(const PageAnnotation& pageAnnotation) const;
 
+        /// Returns indices of annotations, whose rectangle can contain given point
+        /// (in page coordinates). Indices are sorted in increasing order, so annotations
+        /// are in the same order, as in \p annotations. Annotations, whose rectangle
+        /// depends on the zoom or page rotation (NoZoom or NoRotate flag), are always
+        /// returned. Caller must perform exact hit test for each returned annotation.
+        /// \param point Point in page coordinates
+        std::vector<size_t> getAnnotationsAtPoint(const QPointF& point) const;
+
+        /// Builds spatial index of annotation rectangles. Must be called,
+        /// when annotations are changed.
+        void buildSpatialIndex();
+
+        /// Spatial index of annotation rectangles. Page area covered by annotations
+        /// is divided into uniform grid of cells, each cell contains indices of
+        /// annotations, whose rectangle intersects the cell.
+        struct SpatialIndex
+        {
+            QRectF bounds;
+            int columns = 0;
+            int rows = 0;
+            std::vector<uint32_t> cellOffsets;  ///< Offsets into cellItems, one per cell plus end offset
+            std::vector<uint32_t> cellItems;    ///< Annotation indices of the cells
+            std::vector<uint32_t> alwaysTested; ///< Annotations, which must be always hit tested
+        };
+
         std::vector<PageAnnotation> annotations;
+        SpatialIndex spatialIndex;
     };
 
     /// Prepares annotation transformations for rendering
@@ -1622,6 +1681,35 @@ protected:
                                              const PDFCMS* cms,
                                              QPainter* painter) const;
 
+    /// Returns compiled appearance of the annotation from the cache, or nullptr,
+    /// if annotation has no valid compiled appearance for current settings.
+    /// \param annotation Page annotation
+    CompiledAppearancePointer findCompiledAppearance(const PageAnnotation& annotation) const;
+
+    /// Stores compiled appearance of the annotation into the cache, compiled
+    /// appearances, which are not valid anymore, are removed.
+    /// \param annotation Page annotation
+    /// \param compiledAppearance Compiled appearance
+    void storeCompiledAppearance(const PageAnnotation& annotation, CompiledAppearancePointer compiledAppearance) const;
+
+    /// Creates empty compiled appearance for current appearance of the
+    /// annotation and current settings.
+    /// \param annotation Page annotation
+    std::shared_ptr<CompiledAppearance> createCompiledAppearance(const PageAnnotation& annotation) const;
+
+    /// Compiles appearance stream of the annotation to the precompiled page
+    /// \param pageAnnotation Page annotation
+    /// \param appearanceStreamObject Object with appearance stream
+    /// \param page Page
+    /// \param cms Color management system
+    CompiledAppearancePointer compileAppearanceStream(const PageAnnotation& annotation,
+                                                      const PDFObject& appearanceStreamObject,
+                                                      const PDFPage* page,
+                                                      const PDFCMS* cms) const;
+
+    /// Invalidates all compiled appearances (settings were changed)
+    void invalidateCompiledAppearances();
+
     const PDFDocument* m_document;
 
     PDFFontCache* m_fontCache;
@@ -1634,6 +1722,13 @@ protected:
     mutable QMutex m_mutex;
     mutable std::map<PDFInteger, PageAnnotations> m_pageAnnotations;
     Target m_target = Target::View;
+
+    /// Revision of the settings, which affect compiled appearances, and color
+    /// management system, with which appearances were compiled (both are protected
+    /// by main mutex). Color management system is held, so new color management
+    /// system can't be allocated at the same address.
+    mutable quint64 m_settingsRevision = 0;
+    mutable PDFCMSPointer m_compiledAppearancesCMS;
 };
 
 }   // namespace pdf
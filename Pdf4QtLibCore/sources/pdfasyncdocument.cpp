@@ -0,0 +1,227 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfasyncdocument.h"
+#include "pdftextlayoutgenerator.h"
+#include "pdfoperationcontrol.h"
+#include "pdfconstants.h"
+
+#include <QPromise>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+/// Operation control, which reports cancellation of the future of the promise
+template<typename T>
+class PDFPromiseOperationControl : public PDFOperationControl
+{
+public:
+    explicit PDFPromiseOperationControl(const QPromise<T>* promise) :
+        m_promise(promise)
+    {
+
+    }
+
+    virtual bool isOperationCancelled() const override { return m_promise->isCanceled(); }
+
+private:
+    const QPromise<T>* m_promise;
+};
+
+PDFAsyncDocument::PDFAsyncDocument(PDFDocument document, const PDFAsyncDocumentSettings& settings, QThread* thread) :
+    m_document(qMove(document)),
+    m_settings(settings),
+    m_fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT)
+{
+    m_optionalContentActivity = std::make_unique<PDFOptionalContentActivity>(&m_document, OCUsage::Export, nullptr);
+    m_cmsManager = std::make_unique<PDFCMSManager>(nullptr);
+    m_cmsManager->setDocument(&m_document);
+    m_cmsManager->setSettings(m_settings.cmsSettings);
+
+    PDFModifiedDocument modifiedDocument(&m_document, m_optionalContentActivity.get());
+    m_fontCache.setDocument(modifiedDocument);
+
+    m_rasterizerPool = std::make_unique<PDFRasterizerPool>(&m_document, &m_fontCache, m_cmsManager.get(),
+                                                           m_optionalContentActivity.get(), m_settings.features, m_meshQualitySettings,
+                                                           PDFRasterizerPool::getCorrectedRasterizerCount(m_settings.rasterizerCount),
+                                                           m_settings.rendererEngine, nullptr);
+    m_rasterizerPool->setDiskCache(m_settings.diskCache);
+
+    // Document is created in the worker thread, but it is used by many threads
+    // and it is usually destroyed in the thread, which has opened it.
+    if (thread)
+    {
+        m_optionalContentActivity->moveToThread(thread);
+        m_cmsManager->moveToThread(thread);
+        m_rasterizerPool->moveToThread(thread);
+    }
+}
+
+PDFAsyncDocumentProcessor::PDFAsyncDocumentProcessor(int threadCount) :
+    m_thread(QThread::currentThread())
+{
+    m_threadPool.setMaxThreadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount());
+}
+
+PDFAsyncDocumentProcessor::~PDFAsyncDocumentProcessor()
+{
+    // Removed tasks destroy their promises, which cancels their futures
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
+
+template<typename T, typename Function>
+QFuture<T> PDFAsyncDocumentProcessor::run(Priority priority, Function function)
+{
+    auto promise = std::make_shared<QPromise<T>>();
+    QFuture<T> future = promise->future();
+
+    auto task = [promise, function]()
+    {
+        promise->start();
+
+        if (!promise->isCanceled())
+        {
+            try
+            {
+                PDFPromiseOperationControl<T> operationControl(promise.get());
+                T result = function(&operationControl);
+
+                if (!promise->isCanceled())
+                {
+                    promise->addResult(qMove(result));
+                }
+            }
+            catch (...)
+            {
+                promise->setException(std::current_exception());
+            }
+        }
+
+        promise->finish();
+    };
+
+    m_threadPool.start(task, int(priority));
+    return future;
+}
+
+QFuture<PDFAsyncOpenResult> PDFAsyncDocumentProcessor::openAsync(const QString& fileName,
+                                                                 const PDFAsyncDocumentSettings& settings,
+                                                                 const QString& password,
+                                                                 Priority priority)
+{
+    QThread* thread = m_thread;
+    auto openDocument = [fileName, settings, password, thread](const PDFOperationControl*)
+    {
+        bool isFirstPasswordAttempt = true;
+        auto passwordCallback = [&password, &isFirstPasswordAttempt](bool* ok) -> QString
+        {
+            *ok = isFirstPasswordAttempt;
+            isFirstPasswordAttempt = false;
+            return password;
+        };
+
+        PDFDocumentReader reader(nullptr, passwordCallback, settings.permissive, false);
+        PDFDocument document = reader.readFromFile(fileName);
+
+        PDFAsyncOpenResult result;
+        result.result = reader.getReadingResult();
+        result.errorMessage = reader.getErrorMessage();
+        result.warnings = reader.getWarnings();
+
+        if (result.result == PDFDocumentReader::Result::OK)
+        {
+            result.document = std::make_shared<PDFAsyncDocument>(qMove(document), settings, thread);
+        }
+
+        return result;
+    };
+
+    return run<PDFAsyncOpenResult>(priority, qMove(openDocument));
+}
+
+QFuture<PDFAsyncRenderResult> PDFAsyncDocumentProcessor::renderPageAsync(PDFAsyncDocumentPointer document,
+                                                                         PDFInteger pageIndex,
+                                                                         QSize imageSize,
+                                                                         Priority priority)
+{
+    Q_ASSERT(document);
+
+    auto renderPage = [document, pageIndex, imageSize](const PDFOperationControl*)
+    {
+        PDFAsyncRenderResult result;
+        result.pageIndex = pageIndex;
+
+        // Rasterizer pool is shared by all tasks of the document, so
+        // we take only errors of the page rendered by this task.
+        QMutex resultMutex;
+        auto onRenderError = [&](PDFInteger errorPageIndex, PDFRenderError error)
+        {
+            if (errorPageIndex == pageIndex)
+            {
+                QMutexLocker lock(&resultMutex);
+                result.errors.append(qMove(error));
+            }
+        };
+
+        auto processImage = [&](PDFRenderedPageImage& renderedPageImage)
+        {
+            QMutexLocker lock(&resultMutex);
+            result.image = qMove(renderedPageImage.pageImage);
+        };
+
+        auto imageSizeGetter = [imageSize](const PDFPage*) { return imageSize; };
+
+        QObject holder;
+        QObject::connect(document->m_rasterizerPool.get(), &PDFRasterizerPool::renderError, &holder, onRenderError, Qt::DirectConnection);
+        document->m_rasterizerPool->render({ pageIndex }, imageSizeGetter, processImage, nullptr);
+
+        return result;
+    };
+
+    return run<PDFAsyncRenderResult>(priority, qMove(renderPage));
+}
+
+QFuture<PDFTextLayout> PDFAsyncDocumentProcessor::extractTextAsync(PDFAsyncDocumentPointer document,
+                                                                   PDFInteger pageIndex,
+                                                                   Priority priority)
+{
+    Q_ASSERT(document);
+
+    auto extractText = [document, pageIndex](const PDFOperationControl* operationControl)
+    {
+        const PDFPage* page = document->m_document.getCatalog()->getPage(pageIndex);
+        if (!page)
+        {
+            return PDFTextLayout();
+        }
+
+        PDFCMSPointer cms = document->m_cmsManager->getCurrentCMS();
+        PDFTextLayoutGenerator generator(PDFRenderer::IgnoreOptionalContent, page, &document->m_document, &document->m_fontCache, cms.data(),
+                                         document->m_optionalContentActivity.get(), QTransform(), document->m_meshQualitySettings);
+        generator.setOperationControl(operationControl);
+        generator.processContents();
+        return generator.createTextLayout();
+    };
+
+    return run<PDFTextLayout>(priority, qMove(extractText));
+}
+
+}   // namespace pdf
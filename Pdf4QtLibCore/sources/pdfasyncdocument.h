@@ -0,0 +1,175 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFASYNCDOCUMENT_H
+#define PDFASYNCDOCUMENT_H
+
+#include "pdfdocument.h"
+#include "pdfrenderer.h"
+#include "pdfdocumentreader.h"
+#include "pdftextlayout.h"
+#include "pdfoptionalcontent.h"
+#include "pdfcms.h"
+#include "pdffont.h"
+
+#include <QFuture>
+#include <QThreadPool>
+
+#include <memory>
+
+namespace pdf
+{
+class PDFDiskCache;
+
+/// Settings of the documents opened by asynchronous document processor
+struct PDFAsyncDocumentSettings
+{
+    PDFRenderer::Features features = PDFRenderer::getDefaultFeatures();
+    PDFCMSSettings cmsSettings;
+    RendererEngine rendererEngine = RendererEngine::Blend2D_SingleThread;
+
+    /// Count of pages of one document, which can be rasterized at the same time
+    int rasterizerCount = PDFRasterizerPool::getDefaultRasterizerCount();
+
+    /// Disk cache of rendered page images (can be nullptr), it must
+    /// outlive all documents opened with these settings
+    PDFDiskCache* diskCache = nullptr;
+
+    /// Read documents in permissive mode (some errors are tolerated)
+    bool permissive = false;
+};
+
+/// Document opened by asynchronous document processor, together with objects
+/// needed to render it (font cache, color management system, optional content
+/// activity and rasterizers). Only const access to the document is performed,
+/// so it can be rendered in many threads at once.
+class PDF4QTLIBCORESHARED_EXPORT PDFAsyncDocument
+{
+public:
+    /// Creates document. Objects of the document are moved
+    /// to the given thread (if it is not nullptr).
+    /// \param document Document
+    /// \param settings Settings
+    /// \param thread Thread, to which objects are moved
+    explicit PDFAsyncDocument(PDFDocument document, const PDFAsyncDocumentSettings& settings, QThread* thread);
+
+    const PDFDocument* getDocument() const { return &m_document; }
+    const PDFAsyncDocumentSettings& getSettings() const { return m_settings; }
+    const PDFOptionalContentActivity* getOptionalContentActivity() const { return m_optionalContentActivity.get(); }
+
+private:
+    friend class PDFAsyncDocumentProcessor;
+
+    PDFDocument m_document;
+    PDFAsyncDocumentSettings m_settings;
+    PDFFontCache m_fontCache;
+    PDFMeshQualitySettings m_meshQualitySettings;
+    std::unique_ptr<PDFOptionalContentActivity> m_optionalContentActivity;
+    std::unique_ptr<PDFCMSManager> m_cmsManager;
+    std::unique_ptr<PDFRasterizerPool> m_rasterizerPool;
+};
+
+using PDFAsyncDocumentPointer = std::shared_ptr<PDFAsyncDocument>;
+
+/// Result of asynchronous opening of the document
+struct PDFAsyncOpenResult
+{
+    PDFDocumentReader::Result result = PDFDocumentReader::Result::Failed;
+    QString errorMessage;
+    QStringList warnings;
+    PDFAsyncDocumentPointer document;   ///< Opened document (nullptr, if document can't be opened)
+};
+
+/// Result of asynchronous rendering of the page
+struct PDFAsyncRenderResult
+{
+    PDFInteger pageIndex = -1;
+    QImage image;                       ///< Page image (null, if page can't be rendered)
+    QList<PDFRenderError> errors;
+};
+
+/// Future-based API for embedding of the library into applications and services.
+/// Documents are opened, pages are rendered and text is extracted in the thread pool
+/// of the processor. Functions return immediately, results are available through
+/// the returned futures (use QFutureWatcher to get notified in the event loop).
+/// Tasks with higher priority are started first. Task can be cancelled using
+/// QFuture::cancel(), queued tasks are then not started at all, running tasks
+/// are stopped as soon as possible and their results are discarded. Class is thread
+/// safe. Destructor cancels queued tasks and waits for running ones.
+class PDF4QTLIBCORESHARED_EXPORT PDFAsyncDocumentProcessor
+{
+public:
+    /// Priority of the task, tasks with higher priority are started first
+    enum class Priority
+    {
+        Low = 0,
+        Normal = 1,
+        High = 2
+    };
+
+    /// Creates processor with given number of threads
+    /// \param threadCount Thread count (if it is zero or negative, ideal thread count is used)
+    explicit PDFAsyncDocumentProcessor(int threadCount = 0);
+    ~PDFAsyncDocumentProcessor();
+
+    /// Opens document from the file. Objects of the document live
+    /// in the thread, in which the processor was created.
+    /// \param fileName File name
+    /// \param settings Settings of the document
+    /// \param password Password (used, if document is encrypted)
+    /// \param priority Priority
+    QFuture<PDFAsyncOpenResult> openAsync(const QString& fileName,
+                                          const PDFAsyncDocumentSettings& settings = PDFAsyncDocumentSettings(),
+                                          const QString& password = QString(),
+                                          Priority priority = Priority::Normal);
+
+    /// Renders page to the image of given size
+    /// \param document Document
+    /// \param pageIndex Page index
+    /// \param imageSize Image size
+    /// \param priority Priority
+    QFuture<PDFAsyncRenderResult> renderPageAsync(PDFAsyncDocumentPointer document,
+                                                  PDFInteger pageIndex,
+                                                  QSize imageSize,
+                                                  Priority priority = Priority::Normal);
+
+    /// Creates text layout of the page. If page doesn't exist,
+    /// empty text layout is returned.
+    /// \param document Document
+    /// \param pageIndex Page index
+    /// \param priority Priority
+    QFuture<PDFTextLayout> extractTextAsync(PDFAsyncDocumentPointer document,
+                                            PDFInteger pageIndex,
+                                            Priority priority = Priority::Normal);
+
+    /// Returns thread pool of the processor
+    QThreadPool* getThreadPool() { return &m_threadPool; }
+
+private:
+    /// Starts task in the thread pool. Task function gets operation control,
+    /// which reports cancellation of the returned future.
+    template<typename T, typename Function>
+    QFuture<T> run(Priority priority, Function function);
+
+    QThread* m_thread;
+    QThreadPool m_threadPool;
+};
+
+}   // namespace pdf
+
+#endif // PDFASYNCDOCUMENT_H
@@ -0,0 +1,237 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfbitonaldocumentconvertor.h"
+#include "pdfccittfaxdecoder.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfstreamfilters.h"
+#include "pdfobjectutils.h"
+#include "pdfexception.h"
+#include "pdfprogress.h"
+#include "pdfimage.h"
+#include "pdfcms.h"
+
+#include <numeric>
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFBitonalDocumentConvertor::PDFBitonalDocumentConvertor(const PDFDocument* document) :
+    m_document(document)
+{
+
+}
+
+std::vector<PDFObjectReference> PDFBitonalDocumentConvertor::getImageReferences() const
+{
+    PDFObjectClassifier classifier;
+    classifier.classify(m_document);
+    return classifier.getObjectsByType(PDFObjectClassifier::Image);
+}
+
+QImage PDFBitonalDocumentConvertor::getImage(PDFObjectReference reference, QSize maximalSize) const
+{
+    PDFObject imageObject = m_document->getObjectByReference(reference);
+    if (!imageObject.isStream())
+    {
+        // Image is not stream
+        return QImage();
+    }
+
+    const PDFStream* stream = imageObject.getStream();
+    const PDFDictionary* streamDictionary = stream->getDictionary();
+    PDFRenderErrorReporterDummy errorReporter;
+
+    try
+    {
+        PDFColorSpacePointer colorSpace;
+        if (streamDictionary->hasKey("ColorSpace"))
+        {
+            const PDFObject& colorSpaceObject = m_document->getObject(streamDictionary->get("ColorSpace"));
+            if (colorSpaceObject.isName() || colorSpaceObject.isArray())
+            {
+                PDFDictionary dummyDictionary;
+                colorSpace = PDFAbstractColorSpace::createColorSpace(&dummyDictionary, m_document, colorSpaceObject);
+            }
+        }
+
+        // Preview can be decoded in reduced resolution
+        int resolutionReduction = 0;
+        if (maximalSize.isValid())
+        {
+            PDFDocumentDataLoaderDecorator loader(m_document);
+            const PDFInteger width = loader.readIntegerFromDictionary(streamDictionary, "Width", 0);
+            const PDFInteger height = loader.readIntegerFromDictionary(streamDictionary, "Height", 0);
+
+            while (resolutionReduction < 3 &&
+                   (width >> (resolutionReduction + 1)) >= maximalSize.width() &&
+                   (height >> (resolutionReduction + 1)) >= maximalSize.height())
+            {
+                ++resolutionReduction;
+            }
+        }
+
+        PDFImage pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, RenderingIntent::Perceptual, &errorReporter, nullptr, resolutionReduction);
+
+        PDFCMSGeneric genericCms;
+        return pdfImage.getImage(&genericCms, &errorReporter, nullptr);
+    }
+    catch (const PDFException&)
+    {
+        // Image can't be decoded
+    }
+
+    return QImage();
+}
+
+QImage PDFBitonalDocumentConvertor::convertImage(QImage image, const Settings& settings)
+{
+    PDFImageConversion imageConversion;
+    imageConversion.setConversionMethod(settings.conversionMethod);
+    imageConversion.setThreshold(settings.threshold);
+    imageConversion.setImage(qMove(image));
+
+    if (imageConversion.convert())
+    {
+        QImage bitonalImage = imageConversion.getConvertedImage();
+        Q_ASSERT(bitonalImage.format() == QImage::Format_Mono);
+        return bitonalImage;
+    }
+
+    return QImage();
+}
+
+PDFObject PDFBitonalDocumentConvertor::createImageObject(const QImage& bitonalImage, Compression compression)
+{
+    Q_ASSERT(bitonalImage.format() == QImage::Format_Mono);
+
+    const int width = bitonalImage.width();
+    const int height = bitonalImage.height();
+
+    PDFDictionary dictionary;
+    dictionary.addEntry(PDFInplaceOrMemoryString("Type"), PDFObject::createName("XObject"));
+    dictionary.addEntry(PDFInplaceOrMemoryString("Subtype"), PDFObject::createName("Image"));
+    dictionary.addEntry(PDFInplaceOrMemoryString("Width"), PDFObject::createInteger(width));
+    dictionary.addEntry(PDFInplaceOrMemoryString("Height"), PDFObject::createInteger(height));
+    dictionary.addEntry(PDFInplaceOrMemoryString("ColorSpace"), PDFObject::createName("DeviceGray"));
+    dictionary.addEntry(PDFInplaceOrMemoryString("BitsPerComponent"), PDFObject::createInteger(1));
+
+    QByteArray compressedData;
+
+    switch (compression)
+    {
+        case Compression::Flate:
+        {
+            // Monochrome image has the same layout as 1-bit gray image, only
+            // scan lines are aligned to 32 bits, so we copy bytes of each line.
+            const int bytesPerLine = (width + 7) / 8;
+            const bool isInverted = bitonalImage.colorCount() == 2 && qGray(bitonalImage.color(0)) > qGray(bitonalImage.color(1));
+
+            QByteArray imageData;
+            imageData.reserve(bytesPerLine * height);
+            for (int row = 0; row < height; ++row)
+            {
+                imageData.append(reinterpret_cast<const char*>(bitonalImage.constScanLine(row)), bytesPerLine);
+            }
+
+            if (isInverted)
+            {
+                std::transform(imageData.begin(), imageData.end(), imageData.begin(), [](char value) { return char(~value); });
+            }
+
+            compressedData = PDFFlateDecodeFilter::compress(imageData);
+            dictionary.addEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+            break;
+        }
+
+        case Compression::CCITTGroup4:
+        {
+            compressedData = PDFCCITTFaxEncoder::encodeG4(bitonalImage);
+
+            PDFDictionary decodeParameters;
+            decodeParameters.addEntry(PDFInplaceOrMemoryString("K"), PDFObject::createInteger(-1));
+            decodeParameters.addEntry(PDFInplaceOrMemoryString("Columns"), PDFObject::createInteger(width));
+            decodeParameters.addEntry(PDFInplaceOrMemoryString("Rows"), PDFObject::createInteger(height));
+
+            dictionary.addEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("CCITTFaxDecode"));
+            dictionary.addEntry(PDFInplaceOrMemoryString("DecodeParms"), PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(decodeParameters))));
+            break;
+        }
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    dictionary.addEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(compressedData.size()));
+    return PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), qMove(compressedData)));
+}
+
+PDFDocument PDFBitonalDocumentConvertor::convert(const std::vector<PDFObjectReference>& images, const Settings& settings, PDFProgress* progress) const
+{
+    if (progress && !images.empty())
+    {
+        ProgressStartupInfo info;
+        info.showDialog = true;
+        info.text = PDFTranslationContext::tr("Converting images...");
+        progress->start(images.size(), qMove(info));
+    }
+
+    // Images are decoded, converted and encoded in parallel, objects
+    // are then put into the storage in the calling thread.
+    std::vector<PDFObject> imageObjects(images.size());
+    std::vector<size_t> indices(images.size(), 0);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    auto convertImageObject = [&](size_t index)
+    {
+        QImage bitonalImage = convertImage(getImage(images[index]), settings);
+        if (!bitonalImage.isNull())
+        {
+            imageObjects[index] = createImageObject(bitonalImage, settings.compression);
+        }
+
+        if (progress)
+        {
+            progress->step();
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, indices.cbegin(), indices.cend(), convertImageObject);
+
+    PDFObjectStorage storage = m_document->getStorage();
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        if (!imageObjects[i].isNull())
+        {
+            storage.setObject(images[i], qMove(imageObjects[i]));
+        }
+    }
+
+    if (progress && !images.empty())
+    {
+        progress->finish();
+    }
+
+    return PDFDocument(qMove(storage), m_document->getInfo()->version, QByteArray());
+}
+
+}   // namespace pdf
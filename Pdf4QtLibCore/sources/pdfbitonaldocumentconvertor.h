@@ -0,0 +1,88 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFBITONALDOCUMENTCONVERTOR_H
+#define PDFBITONALDOCUMENTCONVERTOR_H
+
+#include "pdfdocument.h"
+#include "pdfimageconversion.h"
+
+#include <QImage>
+
+namespace pdf
+{
+class PDFProgress;
+
+/// Converts images of the document to bitonal (black and white) images. Images
+/// are converted in parallel and re-encoded using CCITT Group 4 encoding (or Flate
+/// compression). Objects of the converted images are replaced, other objects
+/// of the document remain unchanged.
+class PDF4QTLIBCORESHARED_EXPORT PDFBitonalDocumentConvertor
+{
+public:
+    explicit PDFBitonalDocumentConvertor(const PDFDocument* document);
+
+    enum class Compression
+    {
+        Flate,          ///< Image data are compressed by Flate compression
+        CCITTGroup4     ///< Image data are encoded using CCITT Group 4 encoding
+    };
+
+    struct Settings
+    {
+        PDFImageConversion::ConversionMethod conversionMethod = PDFImageConversion::ConversionMethod::Automatic;
+        int threshold = 128;
+        Compression compression = Compression::CCITTGroup4;
+    };
+
+    /// Returns references of all images of the document
+    std::vector<PDFObjectReference> getImageReferences() const;
+
+    /// Decodes image. If maximal size is valid, image can be decoded in reduced
+    /// resolution (if decoder supports it), but it can still be larger than
+    /// maximal size. If image can't be decoded, null image is returned.
+    /// Function can be called from multiple threads.
+    /// \param reference Reference of the image
+    /// \param maximalSize Maximal size of the image (used for previews)
+    QImage getImage(PDFObjectReference reference, QSize maximalSize = QSize()) const;
+
+    /// Converts image to bitonal image (format QImage::Format_Mono). If image
+    /// can't be converted, null image is returned.
+    /// \param image Image
+    /// \param settings Settings
+    static QImage convertImage(QImage image, const Settings& settings);
+
+    /// Creates image object (stream) from bitonal image
+    /// \param bitonalImage Bitonal image (created by \p convertImage)
+    /// \param compression Compression of the image data
+    static PDFObject createImageObject(const QImage& bitonalImage, Compression compression);
+
+    /// Converts images to bitonal images in parallel and returns document
+    /// with converted images. Images, which can't be decoded, are kept.
+    /// \param images References of images to be converted
+    /// \param settings Settings
+    /// \param progress Progress (can be nullptr)
+    PDFDocument convert(const std::vector<PDFObjectReference>& images, const Settings& settings, PDFProgress* progress) const;
+
+private:
+    const PDFDocument* m_document;
+};
+
+}   // namespace pdf
+
+#endif // PDFBITONALDOCUMENTCONVERTOR_H
@@ -20,9 +20,75 @@
 
 #include <algorithm>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDF4QT_BLEND_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PDF4QT_BLEND_USE_NEON
+#include <arm_neon.h>
+#endif
+
 namespace pdf
 {
 
+// Vectorized blending of planar color values. Each operation is defined both for
+// scalar values and for vectors, so the same kernel is used for processing
+// of 4 values at once and for the remaining values.
+
+static inline PDFColorComponent blendVectorAdd(PDFColorComponent a, PDFColorComponent b) { return a + b; }
+static inline PDFColorComponent blendVectorSub(PDFColorComponent a, PDFColorComponent b) { return a - b; }
+static inline PDFColorComponent blendVectorMul(PDFColorComponent a, PDFColorComponent b) { return a * b; }
+static inline PDFColorComponent blendVectorMin(PDFColorComponent a, PDFColorComponent b) { return qMin(a, b); }
+static inline PDFColorComponent blendVectorMax(PDFColorComponent a, PDFColorComponent b) { return qMax(a, b); }
+
+#if defined(PDF4QT_BLEND_USE_SSE2)
+using PDFBlendVector = __m128;
+
+static inline PDFBlendVector blendVectorLoad(const PDFColorComponent* data) { return _mm_loadu_ps(data); }
+static inline void blendVectorStore(PDFColorComponent* data, PDFBlendVector value) { _mm_storeu_ps(data, value); }
+static inline PDFBlendVector blendVectorAdd(PDFBlendVector a, PDFBlendVector b) { return _mm_add_ps(a, b); }
+static inline PDFBlendVector blendVectorSub(PDFBlendVector a, PDFBlendVector b) { return _mm_sub_ps(a, b); }
+static inline PDFBlendVector blendVectorMul(PDFBlendVector a, PDFBlendVector b) { return _mm_mul_ps(a, b); }
+static inline PDFBlendVector blendVectorMin(PDFBlendVector a, PDFBlendVector b) { return _mm_min_ps(a, b); }
+static inline PDFBlendVector blendVectorMax(PDFBlendVector a, PDFBlendVector b) { return _mm_max_ps(a, b); }
+#elif defined(PDF4QT_BLEND_USE_NEON)
+using PDFBlendVector = float32x4_t;
+
+static inline PDFBlendVector blendVectorLoad(const PDFColorComponent* data) { return vld1q_f32(data); }
+static inline void blendVectorStore(PDFColorComponent* data, PDFBlendVector value) { vst1q_f32(data, value); }
+static inline PDFBlendVector blendVectorAdd(PDFBlendVector a, PDFBlendVector b) { return vaddq_f32(a, b); }
+static inline PDFBlendVector blendVectorSub(PDFBlendVector a, PDFBlendVector b) { return vsubq_f32(a, b); }
+static inline PDFBlendVector blendVectorMul(PDFBlendVector a, PDFBlendVector b) { return vmulq_f32(a, b); }
+static inline PDFBlendVector blendVectorMin(PDFBlendVector a, PDFBlendVector b) { return vminq_f32(a, b); }
+static inline PDFBlendVector blendVectorMax(PDFBlendVector a, PDFBlendVector b) { return vmaxq_f32(a, b); }
+#endif
+
+#if defined(PDF4QT_BLEND_USE_SSE2) || defined(PDF4QT_BLEND_USE_NEON)
+#define PDF4QT_BLEND_USE_SIMD
+
+static constexpr const size_t BLEND_VECTOR_SIZE = 4;
+#endif
+
+/// Applies kernel to the arrays of backdrop and source values,
+/// kernel must be callable both with scalars and vectors.
+template<typename Kernel>
+static inline void blendArrays(const PDFColorComponent* Cb, const PDFColorComponent* Cs, PDFColorComponent* B, size_t count, Kernel kernel)
+{
+    size_t i = 0;
+
+#if defined(PDF4QT_BLEND_USE_SIMD)
+    for (; i + BLEND_VECTOR_SIZE <= count; i += BLEND_VECTOR_SIZE)
+    {
+        blendVectorStore(B + i, kernel(blendVectorLoad(Cb + i), blendVectorLoad(Cs + i)));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        B[i] = kernel(Cb[i], Cs[i]);
+    }
+}
+
 constexpr const std::pair<const char*, BlendMode> BLEND_MODE_INFOS[] =
 {
     { "Normal", BlendMode::Normal },
@@ -376,6 +442,117 @@ PDFColorComponent PDFBlendFunction::blend(BlendMode mode, PDFColorComponent Cb,
     return Cs;
 }
 
+void PDFBlendFunction::blend(BlendMode mode,
+                             const PDFColorComponent* Cb,
+                             const PDFColorComponent* Cs,
+                             PDFColorComponent* B,
+                             size_t count,
+                             bool subtractive)
+{
+    // Subtractive colors are blended as complements, i.e. B = 1 - blend(1 - Cb, 1 - Cs).
+    // For vectorized blend modes, complement of the blend mode is used instead.
+    if (subtractive)
+    {
+        switch (mode)
+        {
+            case BlendMode::Multiply:
+                mode = BlendMode::Screen;
+                break;
+
+            case BlendMode::Screen:
+                mode = BlendMode::Multiply;
+                break;
+
+            case BlendMode::Darken:
+                mode = BlendMode::Lighten;
+                break;
+
+            case BlendMode::Lighten:
+                mode = BlendMode::Darken;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    switch (mode)
+    {
+        case BlendMode::Normal:
+        case BlendMode::Compatible:
+            std::copy(Cs, Cs + count, B);
+            return;
+
+        case BlendMode::Multiply:
+            blendArrays(Cb, Cs, B, count, [](auto b, auto s) { return blendVectorMul(b, s); });
+            return;
+
+        case BlendMode::Screen:
+            blendArrays(Cb, Cs, B, count, [](auto b, auto s) { return blendVectorSub(blendVectorAdd(b, s), blendVectorMul(b, s)); });
+            return;
+
+        case BlendMode::Darken:
+            blendArrays(Cb, Cs, B, count, [](auto b, auto s) { return blendVectorMin(b, s); });
+            return;
+
+        case BlendMode::Lighten:
+            blendArrays(Cb, Cs, B, count, [](auto b, auto s) { return blendVectorMax(b, s); });
+            return;
+
+        default:
+            break;
+    }
+
+    Q_ASSERT(PDFBlendModeInfo::isSeparable(mode));
+
+    if (!subtractive)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            B[i] = blend(mode, Cb[i], Cs[i]);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            B[i] = 1.0f - blend(mode, 1.0f - Cb[i], 1.0f - Cs[i]);
+        }
+    }
+}
+
+void PDFBlendFunction::composite(const PDFColorComponent* C_i_1,
+                                 const PDFColorComponent* Cb,
+                                 const PDFColorComponent* Cs,
+                                 const PDFColorComponent* B,
+                                 const PDFColorComponent* const* weights,
+                                 PDFColorComponent* C_i,
+                                 size_t count)
+{
+    const PDFColorComponent* w_C_i_1 = weights[0];
+    const PDFColorComponent* w_Cb = weights[1];
+    const PDFColorComponent* w_Cs = weights[2];
+    const PDFColorComponent* w_B = weights[3];
+
+    size_t i = 0;
+
+#if defined(PDF4QT_BLEND_USE_SIMD)
+    for (; i + BLEND_VECTOR_SIZE <= count; i += BLEND_VECTOR_SIZE)
+    {
+        PDFBlendVector value = blendVectorMul(blendVectorLoad(w_C_i_1 + i), blendVectorLoad(C_i_1 + i));
+        value = blendVectorAdd(value, blendVectorMul(blendVectorLoad(w_Cb + i), blendVectorLoad(Cb + i)));
+        value = blendVectorAdd(value, blendVectorMul(blendVectorLoad(w_Cs + i), blendVectorLoad(Cs + i)));
+        value = blendVectorAdd(value, blendVectorMul(blendVectorLoad(w_B + i), blendVectorLoad(B + i)));
+        blendVectorStore(C_i + i, value);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        C_i[i] = w_C_i_1[i] * C_i_1[i] + w_Cb[i] * Cb[i] + w_Cs[i] * Cs[i] + w_B[i] * B[i];
+    }
+}
+
 PDFRGB PDFBlendFunction::blend_Hue(PDFRGB Cb, PDFRGB Cs)
 {
     return nonseparable_SetLum(nonseparable_SetSat(Cs, nonseparable_Sat(Cb)), nonseparable_Lum(Cb));
@@ -111,6 +111,40 @@ public:
     /// \param Cs Source color
     static PDFColorComponent blend(BlendMode mode, PDFColorComponent Cb, PDFColorComponent Cs);
 
+    /// Blend function used to blend arrays of values of one color channel (planar
+    /// layout) using separable blend mode. Normal, Multiply, Screen, Darken and
+    /// Lighten blend modes are vectorized, other modes are blended value by value.
+    /// \param mode Separable blend mode
+    /// \param Cb Backdrop colors
+    /// \param Cs Source colors
+    /// \param[out] B Blended colors
+    /// \param count Count of values
+    /// \param subtractive Are colors subtractive (blended are complements of colors)?
+    static void blend(BlendMode mode,
+                      const PDFColorComponent* Cb,
+                      const PDFColorComponent* Cs,
+                      PDFColorComponent* B,
+                      size_t count,
+                      bool subtractive);
+
+    /// Composites arrays of values of one color channel as weighted sum
+    /// C_i = w0 * C_i_1 + w1 * Cb + w2 * Cs + w3 * B. Result array
+    /// can be the same as the array of immediate colors.
+    /// \param C_i_1 Immediate colors
+    /// \param Cb Backdrop colors
+    /// \param Cs Source colors
+    /// \param B Blended colors
+    /// \param weights Four arrays of weights (for C_i_1, Cb, Cs and B)
+    /// \param[out] C_i Result colors
+    /// \param count Count of values
+    static void composite(const PDFColorComponent* C_i_1,
+                          const PDFColorComponent* Cb,
+                          const PDFColorComponent* Cs,
+                          const PDFColorComponent* B,
+                          const PDFColorComponent* const* weights,
+                          PDFColorComponent* C_i,
+                          size_t count);
+
     /// Blend non-separable hue function
     /// \param Cb Backdrop color
     /// \param Cs Source color
@@ -17,6 +17,7 @@
 
 #include "pdfblpainter.h"
 #include "pdffont.h"
+#include "pdfpainter.h"
 
 #include <QThread>
 #include <QRawFont>
@@ -24,6 +25,8 @@
 #include <QPaintEngine>
 #include <QPainterPathStroker>
 
+#include <algorithm>
+
 #ifdef Q_OS_WIN
 #include <Blend2d.h>
 #else
@@ -61,6 +64,7 @@ public:
     static PaintEngineFeatures getStaticFeatures();
 
 private:
+    friend class PDFBLPageRenderer;
 
     /// Get BL matrix from transformation
     static BLMatrix2D getBLMatrix(QTransform transform);
@@ -1035,6 +1039,30 @@ void PDFBLPaintEngine::setBLBrush(BLContext& context, const QBrush& brush)
             }
             break;
         }
+        case Qt::TexturePattern:
+        {
+            QImage image = brush.textureImage();
+            if (image.isNull())
+            {
+                break;
+            }
+
+            if (image.format() != QImage::Format_ARGB32_Premultiplied)
+            {
+                image.convertTo(QImage::Format_ARGB32_Premultiplied);
+            }
+
+            BLImage blImage;
+            blImage.createFromData(image.width(), image.height(), BL_FORMAT_PRGB32, image.bits(), image.bytesPerLine());
+
+            // Pattern must own image data, because image is destroyed at the end of this scope
+            BLImage blPatternImage;
+            blPatternImage.assignDeep(blImage);
+
+            BLPattern blPattern(blPatternImage, BL_EXTEND_MODE_REPEAT, getBLMatrix(brush.transform()));
+            context.setFillStyle(blPattern);
+            break;
+        }
     }
 }
 
@@ -1321,4 +1349,370 @@ void PDFBLPaintEngine::setFillRule(Qt::FillRule fillRule)
     m_blContext->setFillRule(blFillRule);
 }
 
+bool PDFBLPageRenderer::render(QImage& image,
+                               bool isMultithreaded,
+                               const PDFPrecompiledPage* compiledPage,
+                               const QRectF& cropBox,
+                               const QTransform& pagePointToDevicePointMatrix,
+                               PDFRenderer::Features features,
+                               PDFReal opacity)
+{
+    Q_ASSERT(compiledPage);
+    Q_ASSERT(pagePointToDevicePointMatrix.isInvertible());
+
+    using InstructionType = PDFPrecompiledPage::InstructionType;
+
+    // Meshes are painted using QPainter, so we can't render such page directly
+    const auto& instructions = compiledPage->m_instructions;
+    auto isMesh = [](const PDFPrecompiledPage::Instruction& instruction) { return instruction.type == InstructionType::DrawMesh; };
+    if (std::any_of(instructions.cbegin(), instructions.cend(), isMesh))
+    {
+        return false;
+    }
+
+    if (image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        image.convertTo(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    BLImage blOffscreenBuffer;
+    blOffscreenBuffer.createFromData(image.width(), image.height(), BL_FORMAT_PRGB32, image.bits(), image.bytesPerLine());
+
+    BLContextCreateInfo info{};
+
+    if (isMultithreaded)
+    {
+        info.flags = BL_CONTEXT_CREATE_FLAG_FALLBACK_TO_SYNC;
+        info.threadCount = QThread::idealThreadCount();
+    }
+
+    BLContext context;
+    if (context.begin(blOffscreenBuffer, info) != BL_SUCCESS)
+    {
+        return false;
+    }
+
+    context.setHint(BL_CONTEXT_HINT_RENDERING_QUALITY, BL_RENDERING_QUALITY_MAX_VALUE);
+    context.setHint(BL_CONTEXT_HINT_PATTERN_QUALITY, features.testFlag(PDFRenderer::SmoothImages) ? BL_PATTERN_QUALITY_BILINEAR : BL_PATTERN_QUALITY_NEAREST);
+    context.clearAll();
+    context.scale(image.devicePixelRatioF());
+    context.userToMeta();
+    context.setGlobalAlpha(opacity);
+
+    // Clip path is stored in device coordinates. If clip path is a single
+    // rectangle, then Blend2D clipping is used, otherwise painted graphics
+    // is intersected with the clip path.
+    struct State
+    {
+        QTransform matrix;
+        std::optional<QPainterPath> clipPath;
+        QRectF clipPathBoundingBox;
+        bool isClipSingleRect = false;
+    };
+
+    std::vector<State> stateStack;
+    State state;
+
+    auto intersectClip = [&](const QPainterPath& path)
+    {
+        QPainterPath deviceClipPath = state.matrix.map(path);
+        state.clipPath = state.clipPath.has_value() ? state.clipPath->intersected(deviceClipPath) : qMove(deviceClipPath);
+        state.clipPathBoundingBox = state.clipPath->controlPointRect();
+        state.isClipSingleRect = false;
+
+        if (state.clipPath->elementCount() == 5)
+        {
+            QRectF testRect = state.clipPathBoundingBox.adjusted(1.0, 1.0, -2.0, -2.0);
+            state.isClipSingleRect = state.clipPath->contains(testRect);
+        }
+
+        if (state.isClipSingleRect)
+        {
+            // Graphics state is saved, so clipping is restored with it
+            context.resetMatrix();
+            context.clipToRect(PDFBLPaintEngine::getBLRect(state.clipPath->boundingRect()));
+            context.setMatrix(PDFBLPaintEngine::getBLMatrix(state.matrix));
+        }
+    };
+
+    // Returns true, if graphics with given bounding box (in device
+    // coordinates) must be intersected with the clip path.
+    auto needsClipping = [&state](const QRectF& boundingBox, bool& isVisible)
+    {
+        isVisible = true;
+
+        if (!state.clipPath.has_value() || state.isClipSingleRect)
+        {
+            return false;
+        }
+
+        isVisible = !state.clipPath->isEmpty() && boundingBox.intersects(state.clipPathBoundingBox);
+        return isVisible;
+    };
+
+    if (features.testFlag(PDFRenderer::ClipToCropBox) && cropBox.isValid())
+    {
+        QPainterPath path;
+        path.addPolygon(pagePointToDevicePointMatrix.map(cropBox));
+        intersectClip(path);
+    }
+
+    // Determine visible draw instructions using spatial index
+    std::vector<bool> visibleInstructions;
+    if (compiledPage->m_spatialIndex.isValid())
+    {
+        QRectF deviceRect(QPointF(0, 0), image.deviceIndependentSize());
+        if (state.clipPath.has_value())
+        {
+            deviceRect = deviceRect.intersected(state.clipPathBoundingBox);
+        }
+
+        constexpr PDFReal deviceMargin = 2.0;
+        deviceRect.adjust(-deviceMargin, -deviceMargin, deviceMargin, deviceMargin);
+
+        const QRectF pageRect = pagePointToDevicePointMatrix.inverted().mapRect(deviceRect);
+        if (!pageRect.contains(compiledPage->m_spatialIndex.bounds))
+        {
+            visibleInstructions = compiledPage->m_spatialIndex.query(pageRect, instructions.size());
+        }
+    }
+
+    // Images must remain valid, until context is finished, because
+    // commands can be processed asynchronously. Images of the page are
+    // valid, images converted here are kept in this array.
+    std::vector<QImage> temporaryImages;
+
+    // Pen and brush are set only, if they are changed, paths often share them
+    const QPen* currentPen = nullptr;
+    const QBrush* currentBrush = nullptr;
+
+    // Glyph outlines are converted to Blend2D paths only once, when glyph is painted
+    // for the first time. Filled glyphs are then painted using the glyph matrix,
+    // so paths of individual glyphs on the page need not to be converted.
+    std::vector<std::optional<BLPath>> glyphPaths(compiledPage->m_glyphs.size());
+
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        const PDFPrecompiledPage::Instruction& instruction = instructions[i];
+
+        if (!visibleInstructions.empty() && !visibleInstructions[i] &&
+            (instruction.type == InstructionType::DrawPath || instruction.type == InstructionType::DrawImage))
+        {
+            // Instruction is outside of visible area, skip it
+            continue;
+        }
+
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+            {
+                const PDFPrecompiledPage::PathPaintData& data = compiledPage->m_paths[instruction.dataIndex];
+
+                const bool isStrokeActive = data.pen.style() != Qt::NoPen;
+                const bool isFillActive = data.brush.style() != Qt::NoBrush;
+
+                if (!isStrokeActive && !isFillActive)
+                {
+                    break;
+                }
+
+                if (isStrokeActive && (!currentPen || *currentPen != data.pen))
+                {
+                    PDFBLPaintEngine::setBLPen(context, data.pen);
+                    currentPen = &data.pen;
+                }
+
+                if (isFillActive && (!currentBrush || *currentBrush != data.brush))
+                {
+                    PDFBLPaintEngine::setBLBrush(context, data.brush);
+                    currentBrush = &data.brush;
+                }
+
+                context.setFillRule(data.path.fillRule() == Qt::OddEvenFill ? BL_FILL_RULE_EVEN_ODD : BL_FILL_RULE_NON_ZERO);
+
+                bool isVisible = true;
+                if (needsClipping(state.matrix.mapRect(data.path.controlPointRect()), isVisible))
+                {
+                    context.save();
+                    context.resetMatrix();
+
+                    if (isFillActive)
+                    {
+                        QPainterPath fillPath = state.matrix.map(data.path).intersected(state.clipPath.value());
+                        if (!fillPath.isEmpty())
+                        {
+                            if (data.brush.style() == Qt::TexturePattern)
+                            {
+                                // Texture is defined in user space, but path is filled in device space
+                                QBrush deviceBrush = data.brush;
+                                deviceBrush.setTransform(data.brush.transform() * state.matrix);
+                                PDFBLPaintEngine::setBLBrush(context, deviceBrush);
+                            }
+
+                            context.fillPath(PDFBLPaintEngine::getBLPath(fillPath));
+                        }
+                    }
+
+                    if (isStrokeActive)
+                    {
+                        QPainterPathStroker stroker(data.pen);
+                        QPainterPath strokedPath = state.matrix.map(stroker.createStroke(data.path)).intersected(state.clipPath.value());
+                        if (!strokedPath.isEmpty())
+                        {
+                            PDFBLPaintEngine::setBLBrush(context, data.pen.brush());
+                            context.setFillRule(BL_FILL_RULE_NON_ZERO);
+                            context.fillPath(PDFBLPaintEngine::getBLPath(strokedPath));
+                        }
+                    }
+
+                    context.restore();
+                    break;
+                }
+
+                if (!isVisible)
+                {
+                    break;
+                }
+
+                if (data.glyphIndex >= 0 && isFillActive && !isStrokeActive)
+                {
+                    std::optional<BLPath>& glyphPath = glyphPaths[data.glyphIndex];
+                    if (!glyphPath.has_value())
+                    {
+                        glyphPath = PDFBLPaintEngine::getBLPath(compiledPage->m_glyphs[data.glyphIndex]);
+                    }
+
+                    context.setMatrix(PDFBLPaintEngine::getBLMatrix(data.glyphMatrix * state.matrix));
+                    context.fillPath(glyphPath.value());
+                    context.setMatrix(PDFBLPaintEngine::getBLMatrix(state.matrix));
+                    break;
+                }
+
+                BLPath blPath = PDFBLPaintEngine::getBLPath(data.path);
+
+                if (isFillActive)
+                {
+                    context.fillPath(blPath);
+                }
+
+                if (isStrokeActive)
+                {
+                    context.strokePath(blPath);
+                }
+                break;
+            }
+
+            case InstructionType::DrawImage:
+            {
+                const QImage& pageImage = compiledPage->m_images[instruction.dataIndex].image;
+                if (pageImage.isNull())
+                {
+                    break;
+                }
+
+                QTransform imageTransform(1.0 / pageImage.width(), 0, 0, 1.0 / pageImage.height(), 0, 0);
+                QTransform worldTransform = imageTransform * state.matrix;
+
+                // Jakub Melka: Because Qt uses opposite axis direction than PDF, then we must transform the y-axis
+                // to the opposite (so the image is then unchanged)
+                worldTransform.translate(0, pageImage.height());
+                worldTransform.scale(1, -1);
+
+                bool isVisible = true;
+                const bool isClipped = needsClipping(worldTransform.mapRect(QRectF(QPointF(0, 0), pageImage.size())), isVisible);
+
+                if (!isVisible)
+                {
+                    break;
+                }
+
+                const QImage* drawnImage = &pageImage;
+                if (isClipped || pageImage.format() != QImage::Format_ARGB32_Premultiplied)
+                {
+                    QImage convertedImage = pageImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+                    if (isClipped)
+                    {
+                        QImage mask(convertedImage.size(), QImage::Format_ARGB32_Premultiplied);
+                        mask.fill(Qt::transparent);
+
+                        QPainter maskPainter(&mask);
+                        maskPainter.fillPath(worldTransform.inverted().map(state.clipPath.value()), Qt::white);
+                        maskPainter.end();
+
+                        QPainter imagePainter(&convertedImage);
+                        imagePainter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+                        imagePainter.drawImage(0, 0, mask);
+                        imagePainter.end();
+                    }
+
+                    temporaryImages.emplace_back(qMove(convertedImage));
+                    drawnImage = &temporaryImages.back();
+                }
+
+                BLImage blImage;
+                blImage.createFromData(drawnImage->width(), drawnImage->height(), BL_FORMAT_PRGB32, const_cast<uchar*>(drawnImage->constBits()), drawnImage->bytesPerLine());
+
+                context.save();
+                context.setMatrix(PDFBLPaintEngine::getBLMatrix(worldTransform));
+                context.blitImage(BLPoint(0, 0), blImage);
+                context.restore();
+                break;
+            }
+
+            case InstructionType::Clip:
+            {
+                intersectClip(compiledPage->m_clips[instruction.dataIndex].clipPath);
+                break;
+            }
+
+            case InstructionType::SaveGraphicState:
+            {
+                stateStack.push_back(state);
+                context.save();
+                break;
+            }
+
+            case InstructionType::RestoreGraphicState:
+            {
+                if (!stateStack.empty())
+                {
+                    state = qMove(stateStack.back());
+                    stateStack.pop_back();
+                    context.restore();
+
+                    // Stroke and fill options are part of the restored state
+                    currentPen = nullptr;
+                    currentBrush = nullptr;
+                }
+                break;
+            }
+
+            case InstructionType::SetWorldMatrix:
+            {
+                state.matrix = QTransform(compiledPage->m_matrices[instruction.dataIndex] * pagePointToDevicePointMatrix);
+                context.setMatrix(PDFBLPaintEngine::getBLMatrix(state.matrix));
+                break;
+            }
+
+            case InstructionType::SetCompositionMode:
+            {
+                context.setCompOp(PDFBLPaintEngine::getBLCompOp(compiledPage->m_compositionModes[instruction.dataIndex]));
+                break;
+            }
+
+            default:
+            {
+                Q_ASSERT(false);
+                break;
+            }
+        }
+    }
+
+    // Wait for all commands to be processed (in multithreaded mode,
+    // commands are rasterized asynchronously by Blend2D worker threads).
+    context.end();
+    return true;
+}
+
 }   // namespace pdf
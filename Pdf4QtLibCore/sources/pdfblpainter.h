@@ -19,6 +19,7 @@
 #define PDFBLPAINTER_H
 
 #include "pdfglobal.h"
+#include "pdfrenderer.h"
 
 #include <QImage>
 #include <QPaintDevice>
@@ -46,6 +47,33 @@ private:
     PDFBLPaintEngine* m_paintEngine;
 };
 
+/// Renders precompiled pages directly using Blend2D, without QPainter and
+/// QPaintEngine translation layer. Whole page is submitted into one Blend2D
+/// context at once, so in multithreaded mode, Blend2D worker threads can
+/// rasterize the commands asynchronously, while next commands are submitted.
+class PDF4QTLIBCORESHARED_EXPORT PDFBLPageRenderer
+{
+public:
+    /// Renders precompiled page into the image, image contents are cleared.
+    /// Returns false, if page contains instructions, which can't be rendered
+    /// directly (for example, shading meshes), in that case, page must
+    /// be rendered using painter on \p PDFBLPaintDevice.
+    /// \param image Target image
+    /// \param isMultithreaded Use multithreaded rendering
+    /// \param compiledPage Compiled page contents
+    /// \param cropBox Crop box of the page
+    /// \param pagePointToDevicePointMatrix Page point to image point matrix
+    /// \param features Renderer features
+    /// \param opacity Opacity
+    static bool render(QImage& image,
+                       bool isMultithreaded,
+                       const PDFPrecompiledPage* compiledPage,
+                       const QRectF& cropBox,
+                       const QTransform& pagePointToDevicePointMatrix,
+                       PDFRenderer::Features features,
+                       PDFReal opacity);
+};
+
 }   // namespace pdf
 
 #endif // PDFBLPAINTER_H
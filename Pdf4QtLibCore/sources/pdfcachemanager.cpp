@@ -0,0 +1,226 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfcachemanager.h"
+#include "pdfconstants.h"
+
+#include <QFile>
+
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+std::atomic<quint64> PDFCacheManager::s_accessStamp = 0;
+
+PDFCacheManager::PDFCacheManager() :
+    m_memoryBudget(qint64(DEFAULT_CACHE_MEMORY_BUDGET)),
+    m_effectiveMemoryBudget(qint64(DEFAULT_CACHE_MEMORY_BUDGET))
+{
+
+}
+
+PDFCacheManager* PDFCacheManager::getInstance()
+{
+    static PDFCacheManager manager;
+    return &manager;
+}
+
+void PDFCacheManager::registerCache(PDFManagedCache* cache)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (std::find(m_caches.cbegin(), m_caches.cend(), cache) == m_caches.cend())
+    {
+        m_caches.push_back(cache);
+    }
+}
+
+void PDFCacheManager::unregisterCache(PDFManagedCache* cache)
+{
+    QMutexLocker lock(&m_mutex);
+    m_caches.erase(std::remove(m_caches.begin(), m_caches.end(), cache), m_caches.end());
+}
+
+void PDFCacheManager::setMemoryBudget(qint64 memoryBudget)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_memoryBudget = memoryBudget;
+    }
+
+    trim();
+}
+
+qint64 PDFCacheManager::getMemoryBudget() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_memoryBudget;
+}
+
+qint64 PDFCacheManager::getEffectiveMemoryBudget() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_effectiveMemoryBudget;
+}
+
+qint64 PDFCacheManager::getTotalCacheSize() const
+{
+    QMutexLocker lock(&m_mutex);
+    return getTotalCacheSizeImpl();
+}
+
+void PDFCacheManager::trim()
+{
+    QMutexLocker lock(&m_mutex);
+
+    const MemoryInfo memoryInfo = getMemoryInfo();
+    const bool isUnderMemoryPressure = memoryInfo.isValid() && memoryInfo.availableMemory * MEMORY_PRESSURE_RATIO < memoryInfo.totalMemory;
+
+    qint64 totalSize = getTotalCacheSizeImpl();
+    qint64 budget = m_memoryBudget;
+
+    if (memoryInfo.isValid())
+    {
+        budget = qMin(budget, memoryInfo.totalMemory / MEMORY_BUDGET_RATIO);
+    }
+
+    if (isUnderMemoryPressure)
+    {
+        // Jakub Melka: System is running out of memory. Each time we are called
+        // under memory pressure, we release half of the cached data, until minimal
+        // budget is reached. Cached data can be recreated, memory of other
+        // processes can't.
+        budget = qMin(budget, qMax(MINIMAL_MEMORY_BUDGET, totalSize / 2));
+    }
+
+    m_effectiveMemoryBudget = budget;
+    m_isUnderMemoryPressure = isUnderMemoryPressure;
+
+    std::vector<PDFManagedCache*> candidates = m_caches;
+    while (totalSize > budget && !candidates.empty())
+    {
+        // Select the cache, whose least recently used item is the best candidate
+        // for eviction. Older items and items, which are cheap to recreate, are
+        // evicted first.
+        const quint64 currentStamp = s_accessStamp.load();
+        auto selectedIt = candidates.end();
+        PDFReal selectedScore = 0.0;
+
+        for (auto it = candidates.begin(); it != candidates.end();)
+        {
+            const quint64 stamp = (*it)->getLeastRecentAccessStamp();
+            if (stamp == 0)
+            {
+                // Nothing can be evicted from this cache
+                it = candidates.erase(it);
+                continue;
+            }
+
+            const PDFReal age = PDFReal(currentStamp - qMin(stamp, currentStamp)) + 1.0;
+            const PDFReal score = age / qMax((*it)->getRecreationCost(), 1);
+            if (selectedIt == candidates.end() || score > selectedScore)
+            {
+                selectedIt = it;
+                selectedScore = score;
+            }
+
+            ++it;
+        }
+
+        if (selectedIt == candidates.end())
+        {
+            break;
+        }
+
+        const qint64 freed = (*selectedIt)->evict(qMin(totalSize - budget, EVICTION_CHUNK_SIZE));
+        if (freed <= 0)
+        {
+            candidates.erase(selectedIt);
+            continue;
+        }
+
+        totalSize -= freed;
+    }
+}
+
+PDFCacheManager::MemoryInfo PDFCacheManager::getMemoryInfo()
+{
+    MemoryInfo memoryInfo;
+
+#if defined(Q_OS_WIN)
+    MEMORYSTATUSEX status = { };
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+    {
+        memoryInfo.totalMemory = qint64(status.ullTotalPhys);
+        memoryInfo.availableMemory = qint64(status.ullAvailPhys);
+    }
+#elif defined(Q_OS_LINUX)
+    QFile file("/proc/meminfo");
+    if (file.open(QFile::ReadOnly | QFile::Text))
+    {
+        // Lines have format "MemTotal:       16314888 kB"
+        auto readValue = [](const QByteArray& line)
+        {
+            const QList<QByteArray> items = line.simplified().split(' ');
+            return items.size() >= 2 ? items[1].toLongLong() * 1024 : qint64(-1);
+        };
+
+        while (!file.atEnd())
+        {
+            const QByteArray line = file.readLine();
+            if (line.startsWith("MemTotal:"))
+            {
+                memoryInfo.totalMemory = readValue(line);
+            }
+            else if (line.startsWith("MemAvailable:"))
+            {
+                memoryInfo.availableMemory = readValue(line);
+            }
+
+            if (memoryInfo.isValid())
+            {
+                break;
+            }
+        }
+    }
+#endif
+
+    return memoryInfo;
+}
+
+qint64 PDFCacheManager::getTotalCacheSizeImpl() const
+{
+    qint64 totalSize = 0;
+    for (const PDFManagedCache* cache : m_caches)
+    {
+        totalSize += cache->getManagedCacheSize();
+    }
+    return totalSize;
+}
+
+}   // namespace pdf
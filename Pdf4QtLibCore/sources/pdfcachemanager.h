@@ -0,0 +1,148 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFCACHEMANAGER_H
+#define PDFCACHEMANAGER_H
+
+#include "pdfglobal.h"
+
+#include <QMutex>
+
+#include <atomic>
+#include <vector>
+
+namespace pdf
+{
+
+/// Cache, whose memory consumption is managed by the cache manager. Cache
+/// stamps its items by access stamps (see PDFCacheManager::getAccessStamp),
+/// so recency of items can be compared across different caches. Functions
+/// of the interface are called by the cache manager, cache must implement
+/// them in thread safe manner.
+class PDF4QTLIBCORESHARED_EXPORT PDFManagedCache
+{
+public:
+    virtual ~PDFManagedCache() = default;
+
+    /// Returns memory consumed by the cached items in bytes
+    virtual qint64 getManagedCacheSize() const = 0;
+
+    /// Returns access stamp of the least recently used item, which
+    /// can be evicted. If no such item exists, zero is returned.
+    virtual quint64 getLeastRecentAccessStamp() const = 0;
+
+    /// Returns relative cost of recreation of the cached data (per byte).
+    /// Caches with expensive data are evicted later than caches with cheap data.
+    virtual int getRecreationCost() const = 0;
+
+    /// Evicts least recently used items, until at least \p bytes bytes are freed,
+    /// or no item can be evicted. Returns count of bytes freed.
+    /// \param bytes Bytes to be freed
+    virtual qint64 evict(qint64 bytes) = 0;
+};
+
+/// Process-wide manager of the memory budget of the caches. Each cache has its own
+/// limit, but total memory consumed by all registered caches is also bounded
+/// by the memory budget. If budget is exceeded, items are evicted across
+/// the caches - least recently used items of the caches with cheap data are
+/// evicted first. Manager also watches available physical memory of the system,
+/// and when system is running out of memory, budget is reduced, so memory
+/// can be used by other processes. Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFCacheManager
+{
+public:
+    /// Returns instance of the cache manager
+    static PDFCacheManager* getInstance();
+
+    /// Returns new access stamp. Access stamps are increasing in all threads,
+    /// so they can be used to compare recency of items in different caches.
+    static quint64 getAccessStamp() { return ++s_accessStamp; }
+
+    /// Registers cache to the manager
+    /// \param cache Cache
+    void registerCache(PDFManagedCache* cache);
+
+    /// Unregisters cache from the manager. Call this function
+    /// before the cache is destroyed.
+    /// \param cache Cache
+    void unregisterCache(PDFManagedCache* cache);
+
+    /// Sets memory budget of all registered caches (in bytes)
+    void setMemoryBudget(qint64 memoryBudget);
+
+    /// Returns memory budget of all registered caches (in bytes)
+    qint64 getMemoryBudget() const;
+
+    /// Returns effective memory budget (in bytes), i.e. memory budget
+    /// reduced according to the physical memory of the system.
+    qint64 getEffectiveMemoryBudget() const;
+
+    /// Returns memory consumed by all registered caches (in bytes)
+    qint64 getTotalCacheSize() const;
+
+    /// Returns true, if system is running out of physical memory
+    bool isUnderMemoryPressure() const { return m_isUnderMemoryPressure; }
+
+    /// Updates memory pressure state from available physical memory
+    /// of the system and evicts cached items, so total size of the caches
+    /// is within the effective memory budget. Call this function periodically
+    /// from the main thread.
+    void trim();
+
+private:
+    explicit PDFCacheManager();
+
+    /// Memory pressure is reported, if available physical memory falls
+    /// below this fraction of total physical memory.
+    static constexpr qint64 MEMORY_PRESSURE_RATIO = 10;
+
+    /// Caches do not consume more than this fraction of total physical memory
+    static constexpr qint64 MEMORY_BUDGET_RATIO = 4;
+
+    /// Caches are not reduced below this size under memory pressure [bytes]
+    static constexpr qint64 MINIMAL_MEMORY_BUDGET = 32 * 1024 * 1024;
+
+    /// Maximal amount of data evicted from one cache at once [bytes]
+    static constexpr qint64 EVICTION_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    struct MemoryInfo
+    {
+        qint64 totalMemory = -1;
+        qint64 availableMemory = -1;
+
+        bool isValid() const { return totalMemory > 0 && availableMemory >= 0; }
+    };
+
+    /// Returns physical memory info of the system. If it can't
+    /// be determined, invalid memory info is returned.
+    static MemoryInfo getMemoryInfo();
+
+    /// Returns total size of the caches. Mutex must be locked.
+    qint64 getTotalCacheSizeImpl() const;
+
+    static std::atomic<quint64> s_accessStamp;
+
+    mutable QMutex m_mutex;
+    std::vector<PDFManagedCache*> m_caches;
+    qint64 m_memoryBudget;
+    qint64 m_effectiveMemoryBudget;
+    std::atomic_bool m_isUnderMemoryPressure = false;
+};
+
+}   // namespace pdf
+
+#endif // PDFCACHEMANAGER_H
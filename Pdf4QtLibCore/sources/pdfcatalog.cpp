@@ -70,15 +70,51 @@ size_t PDFCatalog::getPageIndexFromPageReference(PDFObjectReference reference) c
     return INVALID_PAGE_INDEX;
 }
 
-const PDFDestination* PDFCatalog::getNamedDestination(const QByteArray& key) const
+static PDFDestination parseNamedDestination(const PDFObjectStorage* storage, PDFObject object)
 {
-    auto it = m_namedDestinations.find(key);
-    if (it != m_namedDestinations.cend())
+    object = storage->getObject(object);
+    if (object.isDictionary())
     {
-        return &it->second;
+        object = object.getDictionary()->get("D");
     }
 
-    return nullptr;
+    return PDFDestination::parse(storage, qMove(object));
+}
+
+std::optional<PDFDestination> PDFCatalog::getNamedDestination(const QByteArray& key, const PDFObjectStorage* storage) const
+{
+    // Destinations from "Dests" dictionary have precedence over the name tree
+    if (const PDFDictionary* destsDictionary = storage->getDictionaryFromObject(m_namedDestinationsDictionary))
+    {
+        if (destsDictionary->hasKey(key))
+        {
+            return PDFDestination::parse(storage, destsDictionary->get(key));
+        }
+    }
+
+    PDFObject object = PDFNameTreeLoader<PDFDestination>::find(storage, m_namedDestinationsTree, key);
+    if (!object.isNull())
+    {
+        return parseNamedDestination(storage, qMove(object));
+    }
+
+    return std::nullopt;
+}
+
+std::map<QByteArray, PDFDestination> PDFCatalog::getNamedDestinations(const PDFObjectStorage* storage) const
+{
+    std::map<QByteArray, PDFDestination> namedDestinations = PDFNameTreeLoader<PDFDestination>::parse(storage, m_namedDestinationsTree, &parseNamedDestination);
+
+    if (const PDFDictionary* destsDictionary = storage->getDictionaryFromObject(m_namedDestinationsDictionary))
+    {
+        const size_t count = destsDictionary->getCount();
+        for (size_t i = 0; i < count; ++i)
+        {
+            namedDestinations[destsDictionary->getKey(i).getString()] = PDFDestination::parse(storage, destsDictionary->getValue(i));
+        }
+    }
+
+    return namedDestinations;
 }
 
 PDFActionPtr PDFCatalog::getNamedJavaScriptAction(const QByteArray& key) const
@@ -249,23 +285,12 @@ PDFCatalog PDFCatalog::parse(const PDFObject& catalog, const PDFDocument* docume
 
     if (const PDFDictionary* namesDictionary = document->getDictionaryFromObject(catalogDictionary->get("Names")))
     {
-        auto parseDestination = [](const PDFObjectStorage* storage, PDFObject object)
-        {
-            object = storage->getObject(object);
-            if (object.isDictionary())
-            {
-                object = object.getDictionary()->get("D");
-            }
-
-            return PDFDestination::parse(storage, qMove(object));
-        };
-
         auto getObject = [](const PDFObjectStorage*, PDFObject object)
         {
             return object;
         };
 
-        catalogObject.m_namedDestinations = PDFNameTreeLoader<PDFDestination>::parse(&document->getStorage(), namesDictionary->get("Dests"), parseDestination);
+        catalogObject.m_namedDestinationsTree = namesDictionary->get("Dests");
         catalogObject.m_namedAppearanceStreams = PDFNameTreeLoader<PDFObject>::parse(&document->getStorage(), namesDictionary->get("AP"), getObject);
         catalogObject.m_namedJavaScriptActions = PDFNameTreeLoader<PDFActionPtr>::parse(&document->getStorage(), namesDictionary->get("JavaScript"), &PDFAction::parse);
         catalogObject.m_namedPages = PDFNameTreeLoader<PDFObject>::parse(&document->getStorage(), namesDictionary->get("Pages"), getObject);
@@ -277,15 +302,8 @@ PDFCatalog PDFCatalog::parse(const PDFObject& catalog, const PDFDocument* docume
         catalogObject.m_namedRenditions = PDFNameTreeLoader<PDFObject>::parse(&document->getStorage(), namesDictionary->get("Renditions"), getObject);
     }
 
-    // Examine "Dests" dictionary
-    if (const PDFDictionary* destsDictionary = document->getDictionaryFromObject(catalogDictionary->get("Dests")))
-    {
-        const size_t count = destsDictionary->getCount();
-        for (size_t i = 0; i < count; ++i)
-        {
-            catalogObject.m_namedDestinations[destsDictionary->getKey(i).getString()] = PDFDestination::parse(&document->getStorage(), destsDictionary->getValue(i));
-        }
-    }
+    // Named destinations from "Dests" dictionary are resolved on demand
+    catalogObject.m_namedDestinationsDictionary = catalogDictionary->get("Dests");
 
     // Examine "URI" dictionary
     if (const PDFDictionary* URIDictionary = document->getDictionaryFromObject(catalogDictionary->get("URI")))
@@ -25,6 +25,7 @@
 #include "pdfaction.h"
 
 #include <array>
+#include <optional>
 #include <vector>
 #include <utility>
 
@@ -632,7 +633,12 @@ public:
     bool isXFANeedsRendering() const { return m_xfaNeedsRendering; }
     const PDFObject& getAssociatedFiles() const { return m_associatedFiles; }
     const PDFObject& getDocumentPartRoot() const { return m_documentPartRoot; }
-    const std::map<QByteArray, PDFDestination>& getNamedDestinations() const { return m_namedDestinations; }
+
+    /// Returns all named destinations. Named destinations are not stored in the catalog
+    /// (documents can contain hundreds of thousands of them), so they are parsed
+    /// from the document each time this function is called.
+    /// \param storage Object storage
+    std::map<QByteArray, PDFDestination> getNamedDestinations(const PDFObjectStorage* storage) const;
 
     /// Is document marked to have structure tree conforming to tagged document convention?
     bool isLogicalStructureMarked() const { return m_markInfoFlags.testFlag(MarkInfo_Marked); }
@@ -643,11 +649,13 @@ public:
     /// Is document marked to have structure tree not completely conforming to standard?
     bool isLogicalStructureSuspects() const { return m_markInfoFlags.testFlag(MarkInfo_Suspects); }
 
-    /// Returns destination using the key. If destination with the key is not found,
-    /// then nullptr is returned.
+    /// Returns destination using the key. Destination is looked up in the name
+    /// tree, the tree is not loaded. If destination with the key is not found,
+    /// then empty optional is returned.
     /// \param key Destination key
-    /// \returns Pointer to the destination, or nullptr
-    const PDFDestination* getNamedDestination(const QByteArray& key) const;
+    /// \param storage Object storage
+    /// \returns Destination, or empty optional
+    std::optional<PDFDestination> getNamedDestination(const QByteArray& key, const PDFObjectStorage* storage) const;
 
     /// Returns javascript action using the key. If javascript action is not found,
     /// then nullptr is returned.
@@ -747,8 +755,11 @@ private:
     PDFObject m_associatedFiles;
     PDFObject m_documentPartRoot;
 
+    // Named destinations are resolved on demand
+    PDFObject m_namedDestinationsTree;
+    PDFObject m_namedDestinationsDictionary;
+
     // Maps from Names dictionary
-    std::map<QByteArray, PDFDestination> m_namedDestinations;
     std::map<QByteArray, PDFObject> m_namedAppearanceStreams;
     std::map<QByteArray, PDFActionPtr> m_namedJavaScriptActions;
     std::map<QByteArray, PDFObject> m_namedPages;
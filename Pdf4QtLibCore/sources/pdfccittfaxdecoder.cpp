@@ -18,6 +18,9 @@
 
 #include "pdfccittfaxdecoder.h"
 #include "pdfexception.h"
+
+#include <array>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -284,6 +287,68 @@ static constexpr PDFCCITTCode CCITT_BLACK_CODES[] = {
     { 2560,    0b000000011111,     000000011111_bitlength }
 };
 
+/// Lookup table of prefix codes. Table is indexed by next \p LookupBits bits
+/// of the stream and contains decoded value and length of the code word,
+/// so code word is decoded by single lookup instead of reading bit by bit.
+template<uint8_t LookupBits, typename Value>
+class PDFCCITTCodeLookupTable
+{
+public:
+    struct Entry
+    {
+        Value value = Value();
+        uint8_t bits = 0;   ///< Length of the code word (zero, if code word is invalid)
+    };
+
+    static constexpr uint8_t LOOKUP_BITS = LookupBits;
+
+    template<typename Code, typename GetValue>
+    explicit PDFCCITTCodeLookupTable(const Code* codes, size_t codeCount, GetValue getValue)
+    {
+        for (size_t i = 0; i < codeCount; ++i)
+        {
+            const Code& code = codes[i];
+            Q_ASSERT(code.bits > 0 && code.bits <= LookupBits);
+
+            // Fill all entries, which have the code word as a prefix
+            const size_t unusedBits = LookupBits - code.bits;
+            const size_t first = size_t(code.code) << unusedBits;
+            const size_t last = first + (size_t(1) << unusedBits);
+            for (size_t index = first; index < last; ++index)
+            {
+                m_entries[index].value = getValue(code);
+                m_entries[index].bits = code.bits;
+            }
+        }
+    }
+
+    const Entry& operator[](size_t index) const { return m_entries[index]; }
+
+private:
+    std::array<Entry, size_t(1) << LookupBits> m_entries;
+};
+
+static_assert(PDFCCITTRunLengthLookupTable::LOOKUP_BITS == MAX_CODE_BIT_LENGTH + 1, "Run length lookup table must cover all code words.");
+using PDFCCITT2DModeLookupTable = PDFCCITTCodeLookupTable<MAX_2D_MODE_BIT_LENGTH, CCITT_2D_Code_Mode>;
+
+static const PDFCCITTRunLengthLookupTable& getWhiteCodeLookupTable()
+{
+    static const PDFCCITTRunLengthLookupTable table(CCITT_WHITE_CODES, std::size(CCITT_WHITE_CODES), [](const PDFCCITTCode& code) { return code.length; });
+    return table;
+}
+
+static const PDFCCITTRunLengthLookupTable& getBlackCodeLookupTable()
+{
+    static const PDFCCITTRunLengthLookupTable table(CCITT_BLACK_CODES, std::size(CCITT_BLACK_CODES), [](const PDFCCITTCode& code) { return code.length; });
+    return table;
+}
+
+static const PDFCCITT2DModeLookupTable& get2DModeLookupTable()
+{
+    static const PDFCCITT2DModeLookupTable table(CCITT_2D_CODE_MODES, std::size(CCITT_2D_CODE_MODES), [](const PDFCCITT2DModeInfo& info) { return info.mode; });
+    return table;
+}
+
 PDFCCITTFaxDecoder::PDFCCITTFaxDecoder(const QByteArray* stream, const PDFCCITTFaxDecoderParameters& parameters) :
     m_reader(stream, 1),
     m_parameters(parameters)
@@ -453,18 +518,36 @@ PDFImageData PDFCCITTFaxDecoder::decode()
             }
         }
 
-        // Write the line to the output buffer
+        // Write the line to the output buffer. Pixels are written by whole
+        // runs of the same color, instead of pixel by pixel.
         isCurrentPixelBlack = false;
         int index = 0;
-        for (int i = 0; i < m_parameters.columns; ++i)
+        int position = 0;
+        const int columns = static_cast<int>(m_parameters.columns);
+        const int codingLineSize = static_cast<int>(codingLine.size());
+        while (position < columns)
         {
-            if (i == codingLine[index])
+            if (index < codingLineSize && codingLine[index] == position)
             {
                 isCurrentPixelBlack = !isCurrentPixelBlack;
                 ++index;
             }
 
-            writer.write(isCurrentPixelBlack ? 0 : 1);
+            int runEnd = columns;
+            if (index < codingLineSize && codingLine[index] > position)
+            {
+                runEnd = qMin(codingLine[index], columns);
+            }
+
+            const PDFBitWriter::Value value = isCurrentPixelBlack ? 0 : ~PDFBitWriter::Value(0);
+            for (int runLength = runEnd - position; runLength > 0;)
+            {
+                const int bits = qMin(runLength, 56);
+                writer.write(value, bits);
+                runLength -= bits;
+            }
+
+            position = runEnd;
         }
         writer.finishLine();
 
@@ -564,9 +647,9 @@ void PDFCCITTFaxDecoder::skipFill()
     // This functions skips zero bits (because codewords have at most 12 bits,
     // we use 12 bit lookahead to ensure, that we do not broke data sequence).
 
-    while (!m_reader.isAtEnd() && m_reader.look(12) == 0)
+    while (!m_reader.isAtEnd() && m_reader.peek(12) == 0)
     {
-        m_reader.read(1);
+        m_reader.skip(1);
     }
 }
 
@@ -640,57 +723,191 @@ uint32_t PDFCCITTFaxDecoder::getRunLength(bool white)
 
 uint32_t PDFCCITTFaxDecoder::getWhiteCode()
 {
-    return getCode(CCITT_WHITE_CODES, std::size(CCITT_WHITE_CODES));
+    return getCode(getWhiteCodeLookupTable());
 }
 
 uint32_t PDFCCITTFaxDecoder::getBlackCode()
 {
-    return getCode(CCITT_BLACK_CODES, std::size(CCITT_BLACK_CODES));
+    return getCode(getBlackCodeLookupTable());
 }
 
-uint32_t PDFCCITTFaxDecoder::getCode(const PDFCCITTCode* codes, size_t codeCount)
+uint32_t PDFCCITTFaxDecoder::getCode(const PDFCCITTRunLengthLookupTable& table)
 {
-    uint32_t code = 0;
-    uint8_t bits = 0;
+    // Bits after the end of the stream are treated as zero, so if code word
+    // is longer than remaining data, then reading of the code word fails.
+    const PDFCCITTRunLengthLookupTable::Entry& entry = table[m_reader.peek(PDFCCITTRunLengthLookupTable::LOOKUP_BITS)];
 
-    while (bits <= MAX_CODE_BIT_LENGTH)
+    if (entry.bits == 0)
     {
-        code = (code << 1) + m_reader.read(1);
-        ++bits;
+        throw PDFException(PDFTranslationContext::tr("Invalid CCITT run length code word."));
+    }
 
-        for (size_t i = 0; i < codeCount; ++i)
+    m_reader.skip(entry.bits);
+    return entry.value;
+}
+
+CCITT_2D_Code_Mode PDFCCITTFaxDecoder::get2DMode()
+{
+    const PDFCCITT2DModeLookupTable& table = get2DModeLookupTable();
+    const PDFCCITT2DModeLookupTable::Entry& entry = table[m_reader.peek(PDFCCITT2DModeLookupTable::LOOKUP_BITS)];
+
+    if (entry.bits == 0)
+    {
+        throw PDFException(PDFTranslationContext::tr("Invalid CCITT 2D mode."));
+    }
+
+    m_reader.skip(entry.bits);
+    return entry.value;
+}
+
+/// Code words of the run lengths used in encoding. Terminating code words
+/// are indexed by run length, makeup code words by run length divided by 64.
+struct PDFCCITTRunLengthEncodeTable
+{
+    explicit PDFCCITTRunLengthEncodeTable(const PDFCCITTCode* codes, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
         {
-            const PDFCCITTCode& currentCode = codes[i];
-            if (currentCode.bits == bits && currentCode.code == code)
+            const PDFCCITTCode& code = codes[i];
+            if (code.length < terminating.size())
             {
-                return currentCode.length;
+                terminating[code.length] = code;
+            }
+            else
+            {
+                Q_ASSERT(code.length % 64 == 0 && code.length / 64 < makeup.size());
+                makeup[code.length / 64] = code;
             }
         }
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid CCITT run length code word."));
-}
+    static constexpr uint16_t MAX_MAKEUP_LENGTH = 2560;
 
-CCITT_2D_Code_Mode PDFCCITTFaxDecoder::get2DMode()
+    std::array<PDFCCITTCode, 64> terminating = { };
+    std::array<PDFCCITTCode, MAX_MAKEUP_LENGTH / 64 + 1> makeup = { };
+};
+
+QByteArray PDFCCITTFaxEncoder::encodeG4(const QImage& image)
 {
-    uint32_t code = 0;
-    uint8_t bits = 0;
+    static const PDFCCITTRunLengthEncodeTable whiteTable(CCITT_WHITE_CODES, std::size(CCITT_WHITE_CODES));
+    static const PDFCCITTRunLengthEncodeTable blackTable(CCITT_BLACK_CODES, std::size(CCITT_BLACK_CODES));
+
+    const QImage monoImage = (image.format() == QImage::Format_Mono) ? image : image.convertToFormat(QImage::Format_Mono, Qt::ThresholdDither);
+    const int width = monoImage.width();
+    const int height = monoImage.height();
+    const uchar blackBit = (monoImage.colorCount() == 2 && qGray(monoImage.color(0)) > qGray(monoImage.color(1))) ? 1 : 0;
+
+    PDFBitWriter writer(1);
+    writer.reserve(width * height / 64 + 16);
+
+    auto writeCode = [&writer](uint16_t code, uint8_t bits)
+    {
+        writer.write(code, bits);
+    };
+
+    auto writeMode = [&writeCode](CCITT_2D_Code_Mode mode)
+    {
+        const PDFCCITT2DModeInfo& info = CCITT_2D_CODE_MODES[mode];
+        Q_ASSERT(info.mode == mode);
+        writeCode(info.code, info.bits);
+    };
+
+    auto writeRunLength = [&writeCode](const PDFCCITTRunLengthEncodeTable& table, int runLength)
+    {
+        while (runLength >= PDFCCITTRunLengthEncodeTable::MAX_MAKEUP_LENGTH)
+        {
+            const PDFCCITTCode& code = table.makeup.back();
+            writeCode(code.code, code.bits);
+            runLength -= PDFCCITTRunLengthEncodeTable::MAX_MAKEUP_LENGTH;
+        }
+
+        if (runLength >= 64)
+        {
+            const PDFCCITTCode& code = table.makeup[runLength / 64];
+            writeCode(code.code, code.bits);
+            runLength %= 64;
+        }
+
+        const PDFCCITTCode& code = table.terminating[runLength];
+        writeCode(code.code, code.bits);
+    };
+
+    // Lines contain 1 for black pixels and 0 for white pixels. Reference
+    // line of the first line is imaginary white line.
+    std::vector<uint8_t> referenceLine(width, 0);
+    std::vector<uint8_t> codingLine(width, 0);
 
-    while (bits <= MAX_2D_MODE_BIT_LENGTH)
+    // Returns first position at or after start, where pixel differs from the color
+    auto findDifferent = [width](const std::vector<uint8_t>& line, int start, uint8_t color)
     {
-        code = (code << 1) + m_reader.read(1);
-        ++bits;
+        int position = start;
+        while (position < width && line[position] == color)
+        {
+            ++position;
+        }
+        return position;
+    };
+
+    for (int y = 0; y < height; ++y)
+    {
+        const uchar* scanLine = monoImage.constScanLine(y);
+        for (int x = 0; x < width; ++x)
+        {
+            codingLine[x] = (((scanLine[x >> 3] >> (7 - (x & 7))) & 1) == blackBit) ? 1 : 0;
+        }
 
-        for (const PDFCCITT2DModeInfo& info : CCITT_2D_CODE_MODES)
+        if (width > 0)
         {
-            if (info.bits == bits && info.code == code)
+            int a0 = 0;
+            int a1 = codingLine[0] ? 0 : findDifferent(codingLine, 0, 0);
+            int b1 = referenceLine[0] ? 0 : findDifferent(referenceLine, 0, 0);
+
+            while (true)
             {
-                return info.mode;
+                const int b2 = b1 < width ? findDifferent(referenceLine, b1, referenceLine[b1]) : width;
+
+                if (b2 < a1)
+                {
+                    writeMode(Pass);
+                    a0 = b2;
+                }
+                else if (const int delta = a1 - b1; delta >= -3 && delta <= 3)
+                {
+                    writeMode(static_cast<CCITT_2D_Code_Mode>(Vertical_0 + delta));
+                    a0 = a1;
+                }
+                else
+                {
+                    const int a2 = a1 < width ? findDifferent(codingLine, a1, codingLine[a1]) : width;
+                    const bool isWhite = (a0 + a1 == 0) || !codingLine[a0];
+
+                    writeMode(Horizontal);
+                    writeRunLength(isWhite ? whiteTable : blackTable, a1 - a0);
+                    writeRunLength(isWhite ? blackTable : whiteTable, a2 - a1);
+                    a0 = a2;
+                }
+
+                if (a0 >= width)
+                {
+                    break;
+                }
+
+                const uint8_t color = codingLine[a0];
+                a1 = findDifferent(codingLine, a0, color);
+                b1 = findDifferent(referenceLine, a0, !color);
+                b1 = findDifferent(referenceLine, b1, color);
             }
         }
+
+        std::swap(referenceLine, codingLine);
     }
 
-    throw PDFException(PDFTranslationContext::tr("Invalid CCITT 2D mode."));
+    // End of facsimile block
+    writeCode(0b000000000001, 12);
+    writeCode(0b000000000001, 12);
+    writer.finishLine();
+
+    return writer.takeByteArray();
 }
 
 }   // namespace pdf
@@ -24,7 +24,10 @@
 namespace pdf
 {
 
-struct PDFCCITTCode;
+template<uint8_t LookupBits, typename Value>
+class PDFCCITTCodeLookupTable;
+
+using PDFCCITTRunLengthLookupTable = PDFCCITTCodeLookupTable<13, uint16_t>;
 
 struct PDFCCITTFaxDecoderParameters
 {
@@ -122,12 +125,26 @@ private:
     uint32_t getWhiteCode();
     uint32_t getBlackCode();
 
-    uint32_t getCode(const PDFCCITTCode* codes, size_t codeCount);
+    /// Decodes run length code word using the lookup table
+    uint32_t getCode(const PDFCCITTRunLengthLookupTable& table);
 
     PDFBitReader m_reader;
     PDFCCITTFaxDecoderParameters m_parameters;
 };
 
+/// Encoder of bitonal images using pure two dimensional encoding (Group 4).
+/// Encoded data are terminated by end of facsimile block, so they can be
+/// decoded using decode parameters K = -1, Columns = width, Rows = height.
+class PDF4QTLIBCORESHARED_EXPORT PDFCCITTFaxEncoder
+{
+public:
+    /// Encodes monochrome image. If image is not in QImage::Format_Mono format,
+    /// it is converted. Darker color of the color table is encoded as black.
+    /// Bit 0 means black pixel in the decoded data (BlackIs1 is false).
+    /// \param image Image
+    static QByteArray encodeG4(const QImage& image);
+};
+
 }   // namespace pdf
 
 #endif // PDFCCITTFAXDECODER_H
@@ -384,6 +384,7 @@ void PDFCertificateStore::deserialize(QDataStream& stream)
     int persistVersionDeserialized = 0;
     stream >> persistVersionDeserialized;
     stream >> m_certificates;
+    clearValidationCache();
 }
 
 bool PDFCertificateStore::add(PDFCertificateEntry::EntryType type, const QByteArray& certificate)
@@ -402,6 +403,7 @@ bool PDFCertificateStore::add(PDFCertificateEntry::EntryType type, PDFCertificat
     if (it == m_certificates.cend())
     {
         m_certificates.push_back({ type, qMove(info), QByteArray(), QString() });
+        clearValidationCache();
     }
 
     return true;
@@ -412,6 +414,25 @@ bool PDFCertificateStore::contains(const PDFCertificateInfo& info)
     return std::find_if(m_certificates.cbegin(), m_certificates.cend(), [&info](const auto& entry) { return entry.info == info; }) != m_certificates.cend();
 }
 
+std::optional<PDFCertificateStore::ValidationResult> PDFCertificateStore::getCachedValidationResult(const QByteArray& fingerprint) const
+{
+    QMutexLocker locker(&m_validationCache->mutex);
+
+    auto it = m_validationCache->results.find(fingerprint);
+    if (it != m_validationCache->results.cend())
+    {
+        return it->second;
+    }
+
+    return std::nullopt;
+}
+
+void PDFCertificateStore::setCachedValidationResult(QByteArray fingerprint, ValidationResult result) const
+{
+    QMutexLocker locker(&m_validationCache->mutex);
+    m_validationCache->results[qMove(fingerprint)] = qMove(result);
+}
+
 QString PDFCertificateStore::getDefaultCertificateStoreFileName() const
 {
     return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/TrustedCertStorage.bin";
@@ -22,9 +22,14 @@
 
 #include <QFlags>
 #include <QDateTime>
+#include <QMutex>
 #include <QRecursiveMutex>
 #include <QMutexLocker>
 
+#include <map>
+#include <memory>
+#include <optional>
+
 class QDataStream;
 struct x509_st;
 
@@ -38,6 +43,14 @@ public:
     explicit PDFOpenSSLGlobalLock();
     inline ~PDFOpenSSLGlobalLock() = default;
 
+    /// Temporarily unlocks the global lock, so other threads can use OpenSSL,
+    /// while this thread performs long computation, which doesn't use
+    /// shared OpenSSL objects. Lock must be relocked using \p relock.
+    void unlock() { m_mutexLocker.unlock(); }
+
+    /// Relocks the lock unlocked by \p unlock
+    void relock() { m_mutexLocker.relock(); }
+
 private:
     QMutexLocker<QRecursiveMutex> m_mutexLocker;
     static QRecursiveMutex s_globalOpenSSLMutex;
@@ -224,7 +237,26 @@ public:
     const PDFCertificateEntries& getCertificates() const { return m_certificates; }
 
     /// Set certificates
-    void setCertificates(PDFCertificateEntries certificates) { m_certificates = qMove(certificates); }
+    void setCertificates(PDFCertificateEntries certificates) { m_certificates = qMove(certificates); clearValidationCache(); }
+
+    /// Result of the certificate chain validation
+    struct ValidationResult
+    {
+        bool isValid = false;               ///< Certificate chain is valid
+        int error = 0;                      ///< OpenSSL verification error, if chain is not valid
+        PDFCertificateInfos certificates;   ///< Valid chain, or all available certificates, if chain is not valid
+    };
+
+    /// Returns cached result of the certificate chain validation. Function
+    /// is thread safe. If result is not in the cache, std::nullopt is returned.
+    /// \param fingerprint Fingerprint of the validated certificate chain
+    std::optional<ValidationResult> getCachedValidationResult(const QByteArray& fingerprint) const;
+
+    /// Stores result of the certificate chain validation to the cache. Function
+    /// is thread safe. Cache is cleared, when certificates in the store are changed.
+    /// \param fingerprint Fingerprint of the validated certificate chain
+    /// \param result Validation result
+    void setCachedValidationResult(QByteArray fingerprint, ValidationResult result) const;
 
     /// Returns default certificate store file name
     QString getDefaultCertificateStoreFileName() const;
@@ -247,7 +279,19 @@ public:
 private:
     static constexpr int persist_version = 1;
 
+    struct ValidationCache
+    {
+        QMutex mutex;
+        std::map<QByteArray, ValidationResult> results;
+    };
+
+    void clearValidationCache() { m_validationCache = std::make_shared<ValidationCache>(); }
+
     PDFCertificateEntries m_certificates;
+
+    /// Cache is shared between copies of the store, because they
+    /// contain the same certificates (unless certificates are changed).
+    std::shared_ptr<ValidationCache> m_validationCache = std::make_shared<ValidationCache>();
 };
 
 }   // namespace pdf
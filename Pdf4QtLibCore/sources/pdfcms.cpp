@@ -18,12 +18,13 @@
 #include "pdfcms.h"
 #include "pdfdocument.h"
 #include "pdfexecutionpolicy.h"
+#include "pdftrace.h"
 
 #include <QDir>
 #include <QFile>
 #include <QBuffer>
 #include <QCoreApplication>
-#include <QReadWriteLock>
+#include <QMutex>
 
 #include "pdfdbgheap.h"
 
@@ -60,11 +61,90 @@
 #endif
 #endif
 
-#include <unordered_map>
+#include <map>
+#include <atomic>
+#include <memory>
 
 namespace pdf
 {
 
+/// Cache with lock-free lookups. Items are stored in the immutable map, readers
+/// only load pointer to the current map, so they never wait for each other or
+/// for the writers. When item is inserted, writer creates copy of the map with
+/// the new item and publishes it. Old maps are kept until cache is destroyed,
+/// because readers can still use them. Items are never removed, so cache is
+/// suitable only for small count of items, which are created once and read
+/// frequently (for example, color transforms).
+template<typename Key, typename Value>
+class PDFSnapshotCache
+{
+public:
+    using Map = std::map<Key, Value>;
+
+    explicit PDFSnapshotCache() :
+        m_map(nullptr)
+    {
+        m_maps.emplace_back(std::make_unique<Map>());
+        m_map.store(m_maps.back().get(), std::memory_order_release);
+    }
+
+    /// Returns value for given key. If value doesn't exist, then
+    /// it is created by the factory and inserted into the cache.
+    /// Factory is called at most once for each key.
+    /// \param key Key
+    /// \param factory Factory, which creates value for the key
+    template<typename Factory>
+    Value get(const Key& key, Factory factory)
+    {
+        const Map* map = m_map.load(std::memory_order_acquire);
+        auto it = map->find(key);
+        if (it != map->cend())
+        {
+            return it->second;
+        }
+
+        QMutexLocker lock(&m_mutex);
+
+        // Now, we have locked cache for writing. We must find out,
+        // if some other thread doesn't created the value already.
+        map = m_map.load(std::memory_order_acquire);
+        it = map->find(key);
+        if (it != map->cend())
+        {
+            return it->second;
+        }
+
+        Value value = factory();
+        std::unique_ptr<Map> newMap = std::make_unique<Map>(*map);
+        newMap->emplace(key, value);
+        m_map.store(newMap.get(), std::memory_order_release);
+        m_maps.emplace_back(qMove(newMap));
+        return value;
+    }
+
+    /// Returns count of cached items
+    size_t getCount() const
+    {
+        return m_map.load(std::memory_order_acquire)->size();
+    }
+
+    /// Calls function for each stored value. Must not be
+    /// called concurrently with insertion of the values.
+    template<typename Function>
+    void forEachValue(Function function) const
+    {
+        for (const auto& item : *m_map.load(std::memory_order_acquire))
+        {
+            function(item.second);
+        }
+    }
+
+private:
+    std::atomic<const Map*> m_map;
+    QMutex m_mutex;
+    std::vector<std::unique_ptr<const Map>> m_maps;
+};
+
 class PDFLittleCMS : public PDFCMS
 {
 public:
@@ -75,6 +155,7 @@ public:
 
     virtual bool isCompatible(const PDFCMSSettings& settings) const override;
     virtual QColor getPaperColor() const override;
+    virtual void collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const override;
     virtual QColor getColorFromDeviceGray(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const override;
     virtual QColor getColorFromDeviceRGB(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const override;
     virtual QColor getColorFromDeviceCMYK(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const override;
@@ -165,20 +246,23 @@ private:
 
     cmsHTRANSFORM getTransformBetweenColorSpaces(const ColorSpaceTransformParams& params) const;
 
+    /// Gets color lookup table of the transform from cache. If lookup table doesn't
+    /// exist, then it is created by sampling the transform. Transform must have
+    /// FLOAT RGB output buffer. If lookup tables are not used, or transform
+    /// can't be tabulated (for example, input is not RGB or CMYK), nullptr is returned.
+    /// \param transform Transform
+    const PDFColorLookupTable* getLookupTable(cmsHTRANSFORM transform) const;
+
     const PDFCMSManager* m_manager;
     PDFCMSSettings m_settings;
     QColor m_paperColor;
     std::array<cmsHPROFILE, ProfileCount> m_profiles;
     PDFColorConvertor m_colorConvertor;
 
-    mutable QReadWriteLock m_transformationCacheLock;
-    mutable std::unordered_map<int, cmsHTRANSFORM> m_transformationCache;
-
-    mutable QReadWriteLock m_customIccProfileCacheLock;
-    mutable std::map<std::pair<QByteArray, RenderingIntent>, cmsHTRANSFORM> m_customIccProfileCache;
-
-    mutable QReadWriteLock m_transformColorSpaceCacheLock;
-    mutable std::map<QByteArray, cmsHTRANSFORM> m_transformColorSpaceCache;
+    mutable PDFSnapshotCache<int, cmsHTRANSFORM> m_transformationCache;
+    mutable PDFSnapshotCache<std::pair<QByteArray, RenderingIntent>, cmsHTRANSFORM> m_customIccProfileCache;
+    mutable PDFSnapshotCache<QByteArray, cmsHTRANSFORM> m_transformColorSpaceCache;
+    mutable PDFSnapshotCache<cmsHTRANSFORM, std::shared_ptr<const PDFColorLookupTable>> m_lookupTableCache;
 };
 
 bool PDFLittleCMS::fillRGBBufferFromDeviceGray(const std::vector<float>& colors,
@@ -186,6 +270,7 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceGray(const std::vector<float>& colors,
                                                unsigned char* outputBuffer,
                                                PDFRenderErrorReporter* reporter) const
 {
+    PDF_TRACE_SPAN("cms", "Transform gray buffer");
     cmsHTRANSFORM transform = getTransform(Gray, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -210,6 +295,7 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceGray(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromDeviceRGB(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    PDF_TRACE_SPAN("cms", "Transform RGB buffer");
     cmsHTRANSFORM transform = getTransform(RGB, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -222,6 +308,13 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceRGB(const std::vector<float>& colors,
     if (inputFormat == TYPE_RGB_FLT && (colors.size()) % T_CHANNELS(inputFormat) == 0)
     {
         Q_ASSERT(cmsGetTransformOutputFormat(transform) == TYPE_RGB_8);
+
+        if (const PDFColorLookupTable* lookupTable = getLookupTable(getTransform(RGB, getEffectiveRenderingIntent(intent), false)))
+        {
+            lookupTable->fillRGBBuffer(colors, outputBuffer);
+            return true;
+        }
+
         cmsDoTransform(transform, colors.data(), outputBuffer, static_cast<cmsUInt32Number>(colors.size()) / T_CHANNELS(inputFormat));
         return true;
     }
@@ -235,6 +328,7 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceRGB(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    PDF_TRACE_SPAN("cms", "Transform CMYK buffer");
     cmsHTRANSFORM transform = getTransform(CMYK, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -247,6 +341,13 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors,
     if (inputFormat == TYPE_CMYK_FLT && (colors.size()) % T_CHANNELS(inputFormat) == 0)
     {
         Q_ASSERT(cmsGetTransformOutputFormat(transform) == TYPE_RGB_8);
+
+        if (const PDFColorLookupTable* lookupTable = getLookupTable(getTransform(CMYK, getEffectiveRenderingIntent(intent), false)))
+        {
+            lookupTable->fillRGBBuffer(colors, outputBuffer);
+            return true;
+        }
+
         std::vector<float> fixedColors = colors;
         for (size_t i = 0, count = fixedColors.size(); i < count; ++i)
         {
@@ -265,6 +366,7 @@ bool PDFLittleCMS::fillRGBBufferFromDeviceCMYK(const std::vector<float>& colors,
 
 bool PDFLittleCMS::fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::vector<float>& colors, RenderingIntent intent, unsigned char* outputBuffer, PDFRenderErrorReporter* reporter) const
 {
+    PDF_TRACE_SPAN("cms", "Transform XYZ buffer");
     cmsHTRANSFORM transform = getTransform(XYZ, getEffectiveRenderingIntent(intent), true);
 
     if (!transform)
@@ -307,6 +409,7 @@ bool PDFLittleCMS::fillRGBBufferFromXYZ(const PDFColor3& whitePoint, const std::
 
 bool PDFLittleCMS::fillRGBBufferFromICC(const std::vector<float>& colors, RenderingIntent renderingIntent, unsigned char* outputBuffer, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
 {
+    PDF_TRACE_SPAN("cms", "Transform ICC buffer");
     cmsHTRANSFORM transform = getTransformFromICCProfile(iccData, iccID, renderingIntent, true);
 
     if (!transform)
@@ -322,6 +425,15 @@ bool PDFLittleCMS::fillRGBBufferFromICC(const std::vector<float>& colors, Render
     const float* inputColors = colors.data();
     std::vector<float> cmykColors;
 
+    if (colors.size() % channels == 0)
+    {
+        if (const PDFColorLookupTable* lookupTable = getLookupTable(getTransformFromICCProfile(iccData, iccID, renderingIntent, false)))
+        {
+            lookupTable->fillRGBBuffer(colors, outputBuffer);
+            return true;
+        }
+    }
+
     if (isCMYK)
     {
         cmykColors = colors;
@@ -348,6 +460,7 @@ bool PDFLittleCMS::fillRGBBufferFromICC(const std::vector<float>& colors, Render
 
 bool PDFLittleCMS::transformColorSpace(const PDFCMS::ColorSpaceTransformParams& params) const
 {
+    PDF_TRACE_SPAN("cms", "Transform color space");
     PDFCMS::ColorSpaceTransformParams transformedParams = params;
     transformedParams.intent = getEffectiveRenderingIntent(transformedParams.intent);
 
@@ -475,32 +588,17 @@ PDFLittleCMS::PDFLittleCMS(const PDFCMSManager* manager,
 
 PDFLittleCMS::~PDFLittleCMS()
 {
-    for (const auto& transformItem : m_transformationCache)
-    {
-        cmsHTRANSFORM transform = transformItem.second;
-        if (transform)
-        {
-            cmsDeleteTransform(transform);
-        }
-    }
-
-    for (const auto& transformItem : m_customIccProfileCache)
+    auto deleteTransform = [](cmsHTRANSFORM transform)
     {
-        cmsHTRANSFORM transform = transformItem.second;
         if (transform)
         {
             cmsDeleteTransform(transform);
         }
-    }
+    };
 
-    for (const auto& transformItem : m_transformColorSpaceCache)
-    {
-        cmsHTRANSFORM transform = transformItem.second;
-        if (transform)
-        {
-            cmsDeleteTransform(transform);
-        }
-    }
+    m_transformationCache.forEachValue(deleteTransform);
+    m_customIccProfileCache.forEachValue(deleteTransform);
+    m_transformColorSpaceCache.forEachValue(deleteTransform);
 
     for (cmsHPROFILE profile : m_profiles)
     {
@@ -521,6 +619,14 @@ QColor PDFLittleCMS::getPaperColor() const
     return m_paperColor;
 }
 
+void PDFLittleCMS::collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const
+{
+    collector->addGauge(PDFTranslationContext::tr("Cached device transforms"), m_transformationCache.getCount());
+    collector->addGauge(PDFTranslationContext::tr("Cached ICC profile transforms"), m_customIccProfileCache.getCount());
+    collector->addGauge(PDFTranslationContext::tr("Cached color space transforms"), m_transformColorSpaceCache.getCount());
+    collector->addGauge(PDFTranslationContext::tr("Cached lookup tables"), m_lookupTableCache.getCount());
+}
+
 QColor PDFLittleCMS::getColorFromDeviceGray(const PDFColor& color, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
 {
     cmsHTRANSFORM transform = getTransform(Gray, getEffectiveRenderingIntent(intent), false);
@@ -634,57 +740,38 @@ cmsHTRANSFORM PDFLittleCMS::getTransformFromICCProfile(const QByteArray& iccData
 {
     RenderingIntent effectiveRenderingIntent = getEffectiveRenderingIntent(renderingIntent);
     const auto key = std::make_pair(iccID + (isRGB888Buffer ? "RGB_888" : "FLT"), effectiveRenderingIntent);
-    QReadLocker lock(&m_customIccProfileCacheLock);
-    auto it = m_customIccProfileCache.find(key);
-    if (it == m_customIccProfileCache.cend())
+    return m_customIccProfileCache.get(key, [&]()
     {
-        lock.unlock();
-        QWriteLocker writeLock(&m_customIccProfileCacheLock);
-
-        // Now, we have locked cache for writing. We must find out,
-        // if some other thread doesn't created the transformation already.
-        it = m_customIccProfileCache.find(key);
-        if (it == m_customIccProfileCache.cend())
+        cmsHTRANSFORM transform = cmsHTRANSFORM();
+        cmsHPROFILE profile = cmsOpenProfileFromMem(iccData.data(), iccData.size());
+        if (profile)
         {
-            cmsHTRANSFORM transform = cmsHTRANSFORM();
-            cmsHPROFILE profile = cmsOpenProfileFromMem(iccData.data(), iccData.size());
-            if (profile)
+            if (const cmsUInt32Number inputDataFormat = getProfileDataFormat(profile))
             {
-                if (const cmsUInt32Number inputDataFormat = getProfileDataFormat(profile))
-                {
-                    cmsUInt32Number lcmsIntent = getLittleCMSRenderingIntent(effectiveRenderingIntent);
+                cmsUInt32Number lcmsIntent = getLittleCMSRenderingIntent(effectiveRenderingIntent);
 
-                    if (isSoftProofing())
-                    {
-                        cmsHPROFILE proofingProfile = m_profiles[SoftProofing];
-                        RenderingIntent proofingIntent = m_settings.proofingIntent;
-                        if (m_settings.proofingIntent == RenderingIntent::Auto)
-                        {
-                            proofingIntent = effectiveRenderingIntent;
-                        }
-
-                        transform = cmsCreateProofingTransform(profile, inputDataFormat, m_profiles[Output], isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
-                                                               lcmsIntent, getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
-                    }
-                    else
+                if (isSoftProofing())
+                {
+                    cmsHPROFILE proofingProfile = m_profiles[SoftProofing];
+                    RenderingIntent proofingIntent = m_settings.proofingIntent;
+                    if (m_settings.proofingIntent == RenderingIntent::Auto)
                     {
-                        transform = cmsCreateTransform(profile, inputDataFormat, m_profiles[Output], isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, lcmsIntent, getTransformationFlags());
+                        proofingIntent = effectiveRenderingIntent;
                     }
+
+                    transform = cmsCreateProofingTransform(profile, inputDataFormat, m_profiles[Output], isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
+                                                           lcmsIntent, getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
+                }
+                else
+                {
+                    transform = cmsCreateTransform(profile, inputDataFormat, m_profiles[Output], isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, lcmsIntent, getTransformationFlags());
                 }
-                cmsCloseProfile(profile);
             }
-
-            it = m_customIccProfileCache.insert(std::make_pair(key, transform)).first;
+            cmsCloseProfile(profile);
         }
 
-        return it->second;
-    }
-    else
-    {
-        return it->second;
-    }
-
-    return cmsHTRANSFORM();
+        return transform;
+    });
 }
 
 QColor PDFLittleCMS::getColorFromICC(const PDFColor& color, RenderingIntent renderingIntent, const QByteArray& iccID, const QByteArray& iccData, PDFRenderErrorReporter* reporter) const
@@ -748,11 +835,6 @@ void PDFLittleCMS::init()
             m_paperColor = QColor(Qt::white);
         }
     }
-
-    // 64 should be enough, because we can have 4 input color spaces (gray, RGB, CMYK and XYZ),
-    // and 4 rendering intents. We have 4 * 4 = 16 input tables, so 64 will suffice enough
-    // (because we then have 25% load factor).
-    m_transformationCache.reserve(64);
 }
 
 int PDFLittleCMS::installCmsPlugins()
@@ -954,52 +1036,34 @@ cmsHPROFILE PDFLittleCMS::createProfile(const QString& id, const PDFColorProfile
 cmsHTRANSFORM PDFLittleCMS::getTransform(Profile profile, RenderingIntent intent, bool isRGB888Buffer) const
 {
     const int key = getCacheKey(profile, intent, isRGB888Buffer);
-
-    QReadLocker lock(&m_transformationCacheLock);
-    auto it = m_transformationCache.find(key);
-    if (it == m_transformationCache.cend())
+    return m_transformationCache.get(key, [&]()
     {
-        lock.unlock();
-        QWriteLocker writeLock(&m_transformationCacheLock);
+        cmsHTRANSFORM transform = cmsHTRANSFORM();
+        cmsHPROFILE input = m_profiles[profile];
+        cmsHPROFILE output = m_profiles[Output];
 
-        // Now, we have locked cache for writing. We must find out,
-        // if some other thread doesn't created the transformation already.
-        it = m_transformationCache.find(key);
-        if (it == m_transformationCache.cend())
+        if (input && output)
         {
-            cmsHTRANSFORM transform = cmsHTRANSFORM();
-            cmsHPROFILE input = m_profiles[profile];
-            cmsHPROFILE output = m_profiles[Output];
-
-            if (input && output)
+            if (isSoftProofing())
             {
-                if (isSoftProofing())
+                cmsHPROFILE proofingProfile = m_profiles[SoftProofing];
+                RenderingIntent proofingIntent = m_settings.proofingIntent;
+                if (m_settings.proofingIntent == RenderingIntent::Auto)
                 {
-                    cmsHPROFILE proofingProfile = m_profiles[SoftProofing];
-                    RenderingIntent proofingIntent = m_settings.proofingIntent;
-                    if (m_settings.proofingIntent == RenderingIntent::Auto)
-                    {
-                        proofingIntent = intent;
-                    }
-
-                    transform = cmsCreateProofingTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
-                                                           getLittleCMSRenderingIntent(intent), getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
+                    proofingIntent = intent;
                 }
-                else
-                {
-                    transform = cmsCreateTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, getLittleCMSRenderingIntent(intent), getTransformationFlags());
-                }
-            }
 
-            it = m_transformationCache.insert(std::make_pair(key, transform)).first;
+                transform = cmsCreateProofingTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, proofingProfile,
+                                                       getLittleCMSRenderingIntent(intent), getLittleCMSRenderingIntent(proofingIntent), getTransformationFlags());
+            }
+            else
+            {
+                transform = cmsCreateTransform(input, getProfileDataFormat(input), output, isRGB888Buffer ? TYPE_RGB_8 : TYPE_RGB_FLT, getLittleCMSRenderingIntent(intent), getTransformationFlags());
+            }
         }
 
-        // We must return it here to avoid race condition (after current block,
-        // lock is not locked, because we unlocked lock for reading).
-        return it->second;
-    }
-
-    return it->second;
+        return transform;
+    });
 }
 
 cmsUInt32Number PDFLittleCMS::getTransformationFlags() const
@@ -1131,102 +1195,133 @@ QByteArray PDFLittleCMS::getTransformColorSpaceKey(const PDFCMS::ColorSpaceTrans
 cmsHTRANSFORM PDFLittleCMS::getTransformBetweenColorSpaces(const PDFCMS::ColorSpaceTransformParams& params) const
 {
     QByteArray key = getTransformColorSpaceKey(params);
-    QReadLocker lock(&m_transformColorSpaceCacheLock);
-    auto it = m_transformColorSpaceCache.find(key);
-    if (it == m_transformColorSpaceCache.cend())
+    return m_transformColorSpaceCache.get(key, [&]()
     {
-        lock.unlock();
-        QWriteLocker writeLock(&m_transformColorSpaceCacheLock);
+        cmsHPROFILE inputProfile = cmsHPROFILE();
+        cmsHPROFILE outputProfile = cmsHPROFILE();
+        cmsHTRANSFORM transform = cmsHTRANSFORM();
 
-        // Now, we have locked cache for writing. We must find out,
-        // if some other thread doesn't created the transformation already.
-        it = m_transformColorSpaceCache.find(key);
-        if (it == m_transformColorSpaceCache.cend())
+        switch (params.sourceType)
         {
-            cmsHPROFILE inputProfile = cmsHPROFILE();
-            cmsHPROFILE outputProfile = cmsHPROFILE();
-            cmsHTRANSFORM transform = cmsHTRANSFORM();
+            case ColorSpaceType::DeviceGray:
+                inputProfile = m_profiles[Gray];
+                break;
 
-            switch (params.sourceType)
-            {
-                case ColorSpaceType::DeviceGray:
-                    inputProfile = m_profiles[Gray];
-                    break;
+            case ColorSpaceType::DeviceRGB:
+                inputProfile = m_profiles[RGB];
+                break;
 
-                case ColorSpaceType::DeviceRGB:
-                    inputProfile = m_profiles[RGB];
-                    break;
+            case ColorSpaceType::DeviceCMYK:
+                inputProfile = m_profiles[CMYK];
+                break;
 
-                case ColorSpaceType::DeviceCMYK:
-                    inputProfile = m_profiles[CMYK];
-                    break;
+            case ColorSpaceType::XYZ:
+                inputProfile = m_profiles[XYZ];
+                break;
 
-                case ColorSpaceType::XYZ:
-                    inputProfile = m_profiles[XYZ];
-                    break;
+            case ColorSpaceType::ICC:
+                inputProfile = cmsOpenProfileFromMem(params.sourceIccData.data(), params.sourceIccData.size());
+                break;
 
-                case ColorSpaceType::ICC:
-                    inputProfile = cmsOpenProfileFromMem(params.sourceIccData.data(), params.sourceIccData.size());
-                    break;
+            default:
+                Q_ASSERT(false);
+                break;
+        }
 
-                default:
-                    Q_ASSERT(false);
-                    break;
-            }
+        switch (params.targetType)
+        {
+            case ColorSpaceType::DeviceGray:
+                outputProfile = m_profiles[Gray];
+                break;
 
-            switch (params.targetType)
-            {
-                case ColorSpaceType::DeviceGray:
-                    outputProfile = m_profiles[Gray];
-                    break;
+            case ColorSpaceType::DeviceRGB:
+                outputProfile = m_profiles[RGB];
+                break;
 
-                case ColorSpaceType::DeviceRGB:
-                    outputProfile = m_profiles[RGB];
-                    break;
+            case ColorSpaceType::DeviceCMYK:
+                outputProfile = m_profiles[CMYK];
+                break;
 
-                case ColorSpaceType::DeviceCMYK:
-                    outputProfile = m_profiles[CMYK];
-                    break;
+            case ColorSpaceType::XYZ:
+                outputProfile = m_profiles[XYZ];
+                break;
 
-                case ColorSpaceType::XYZ:
-                    outputProfile = m_profiles[XYZ];
-                    break;
+            case ColorSpaceType::ICC:
+                outputProfile = cmsOpenProfileFromMem(params.targetIccData.data(), params.targetIccData.size());
+                break;
 
-                case ColorSpaceType::ICC:
-                    outputProfile = cmsOpenProfileFromMem(params.targetIccData.data(), params.targetIccData.size());
-                    break;
+            default:
+                Q_ASSERT(false);
+                break;
+        }
 
-                default:
-                    Q_ASSERT(false);
-                    break;
-            }
+        if (inputProfile && outputProfile)
+        {
+            transform = cmsCreateTransform(inputProfile, getProfileDataFormat(inputProfile), outputProfile, getProfileDataFormat(outputProfile), getLittleCMSRenderingIntent(params.intent), getTransformationFlags());
+        }
 
-            if (inputProfile && outputProfile)
-            {
-                transform = cmsCreateTransform(inputProfile, getProfileDataFormat(inputProfile), outputProfile, getProfileDataFormat(outputProfile), getLittleCMSRenderingIntent(params.intent), getTransformationFlags());
-            }
+        if (params.sourceType == ColorSpaceType::ICC)
+        {
+            cmsCloseProfile(inputProfile);
+        }
+
+        if (params.targetType == ColorSpaceType::ICC)
+        {
+            cmsCloseProfile(outputProfile);
+        }
+
+        return transform;
+    });
+}
 
-            if (params.sourceType == ColorSpaceType::ICC)
+const PDFColorLookupTable* PDFLittleCMS::getLookupTable(cmsHTRANSFORM transform) const
+{
+    if (!transform || !m_settings.isColorLookupTableUsed || m_settings.isGamutChecking)
+    {
+        // Gamut alarm colors would be blended with neighbouring colors
+        // by the interpolation, so lookup table is not used.
+        return nullptr;
+    }
+
+    return m_lookupTableCache.get(transform, [&]()
+    {
+        std::shared_ptr<const PDFColorLookupTable> lookupTable;
+        const cmsUInt32Number inputFormat = cmsGetTransformInputFormat(transform);
+        const cmsUInt32Number outputFormat = cmsGetTransformOutputFormat(transform);
+
+        if (outputFormat == TYPE_RGB_FLT && (inputFormat == TYPE_RGB_FLT || inputFormat == TYPE_CMYK_FLT))
+        {
+            const bool isCMYK = inputFormat == TYPE_CMYK_FLT;
+            auto sampler = [transform, isCMYK](const std::vector<float>& input, std::vector<float>& output)
             {
-                cmsCloseProfile(inputProfile);
-            }
+                const size_t channels = isCMYK ? 4 : 3;
+                const size_t pixelCount = input.size() / channels;
+
+                // Little CMS uses range [0, 100] for CMYK float values
+                std::vector<float> fixedInput = input;
+                if (isCMYK)
+                {
+                    for (float& value : fixedInput)
+                    {
+                        value *= 100.0f;
+                    }
+                }
+
+                output.resize(pixelCount * 3, 0.0f);
+                cmsDoTransform(transform, fixedInput.data(), output.data(), static_cast<cmsUInt32Number>(pixelCount));
+            };
+
+            const int channels = T_CHANNELS(inputFormat);
+            auto table = std::make_shared<const PDFColorLookupTable>(channels, PDFColorLookupTable::getGridPointCount(m_settings.accuracy, channels), sampler);
 
-            if (params.targetType == ColorSpaceType::ICC)
+            if (table->isValid())
             {
-                cmsCloseProfile(outputProfile);
+                lookupTable = qMove(table);
             }
-
-            it = m_transformColorSpaceCache.insert(std::make_pair(key, transform)).first;
         }
 
-        return it->second;
-    }
-    else
-    {
-        return it->second;
-    }
-
-    return cmsHTRANSFORM();
+        return lookupTable;
+    }).get();
 }
 
 QString getInfoFromProfile(cmsHPROFILE profile, cmsInfoType infoType)
@@ -1269,6 +1364,191 @@ QString getInfoFromProfile(cmsHPROFILE profile, cmsInfoType infoType)
     return QString();
 }
 
+PDFColorLookupTable::PDFColorLookupTable(int inputChannels, int gridPointCount, const Sampler& sampler) :
+    m_inputChannels(inputChannels),
+    m_gridPointCount(gridPointCount),
+    m_strides()
+{
+    Q_ASSERT(inputChannels == 3 || inputChannels == 4);
+    Q_ASSERT(gridPointCount >= 2);
+
+    size_t pointCount = 1;
+    for (int channel = m_inputChannels - 1; channel >= 0; --channel)
+    {
+        m_strides[channel] = pointCount * 3;
+        pointCount *= m_gridPointCount;
+    }
+
+    std::vector<float> input(pointCount * m_inputChannels, 0.0f);
+    const float coefficient = 1.0f / float(m_gridPointCount - 1);
+    for (size_t i = 0; i < pointCount; ++i)
+    {
+        size_t index = i;
+        for (int channel = m_inputChannels - 1; channel >= 0; --channel)
+        {
+            input[i * m_inputChannels + channel] = float(index % m_gridPointCount) * coefficient;
+            index /= m_gridPointCount;
+        }
+    }
+
+    std::vector<float> output;
+    sampler(input, output);
+
+    if (output.size() == pointCount * 3)
+    {
+        m_table = qMove(output);
+    }
+}
+
+/// Interpolates RGB color in the cube of grid points using tetrahedral
+/// interpolation. Cube is divided into six tetrahedrons by the main
+/// diagonal, tetrahedron is selected by the ordering of the fractions.
+/// \param cube Color of the cube origin
+/// \param strides Offsets of the next grid point in each channel
+/// \param fractions Fractions of the position in the cube
+/// \param[out] rgb Interpolated color
+static inline void interpolateTetrahedral(const float* cube,
+                                          const std::array<size_t, 4>& strides,
+                                          const std::array<float, 4>& fractions,
+                                          float* rgb)
+{
+    const float fx = fractions[0];
+    const float fy = fractions[1];
+    const float fz = fractions[2];
+    const size_t sx = strides[0];
+    const size_t sy = strides[1];
+    const size_t sz = strides[2];
+
+    // Tetrahedron vertices are ordered from cube origin to opposite vertex,
+    // w1 >= w2 >= w3 are weights of the edges between them.
+    size_t v1 = 0;
+    size_t v2 = 0;
+    float w1 = 0.0f;
+    float w2 = 0.0f;
+    float w3 = 0.0f;
+
+    if (fx >= fy)
+    {
+        if (fy >= fz)
+        {
+            v1 = sx; v2 = sx + sy; w1 = fx; w2 = fy; w3 = fz;
+        }
+        else if (fx >= fz)
+        {
+            v1 = sx; v2 = sx + sz; w1 = fx; w2 = fz; w3 = fy;
+        }
+        else
+        {
+            v1 = sz; v2 = sx + sz; w1 = fz; w2 = fx; w3 = fy;
+        }
+    }
+    else
+    {
+        if (fz >= fy)
+        {
+            v1 = sz; v2 = sy + sz; w1 = fz; w2 = fy; w3 = fx;
+        }
+        else if (fz >= fx)
+        {
+            v1 = sy; v2 = sy + sz; w1 = fy; w2 = fz; w3 = fx;
+        }
+        else
+        {
+            v1 = sy; v2 = sx + sy; w1 = fy; w2 = fx; w3 = fz;
+        }
+    }
+
+    const float* c0 = cube;
+    const float* c1 = cube + v1;
+    const float* c2 = cube + v2;
+    const float* c3 = cube + sx + sy + sz;
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        rgb[i] = c0[i] + w1 * (c1[i] - c0[i]) + w2 * (c2[i] - c1[i]) + w3 * (c3[i] - c2[i]);
+    }
+}
+
+void PDFColorLookupTable::fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer) const
+{
+    Q_ASSERT(isValid());
+    Q_ASSERT(colors.size() % m_inputChannels == 0);
+
+    const size_t pixelCount = colors.size() / m_inputChannels;
+    const float maxIndex = float(m_gridPointCount - 1);
+    const int maxCubeIndex = m_gridPointCount - 2;
+    const float* table = m_table.data();
+    const float* color = colors.data();
+
+    std::array<float, 4> fractions = { };
+    std::array<float, 3> rgb = { };
+    std::array<float, 3> rgbNext = { };
+
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        size_t offset = 0;
+        for (int channel = 0; channel < m_inputChannels; ++channel)
+        {
+            const float position = qBound(0.0f, *color++, 1.0f) * maxIndex;
+            const int index = qMin(static_cast<int>(position), maxCubeIndex);
+            fractions[channel] = position - index;
+            offset += index * m_strides[channel];
+        }
+
+        interpolateTetrahedral(table + offset, m_strides, fractions, rgb.data());
+
+        if (m_inputChannels == 4)
+        {
+            interpolateTetrahedral(table + offset + m_strides[3], m_strides, fractions, rgbNext.data());
+
+            const float fw = fractions[3];
+            for (size_t j = 0; j < rgb.size(); ++j)
+            {
+                rgb[j] += fw * (rgbNext[j] - rgb[j]);
+            }
+        }
+
+        for (size_t j = 0; j < rgb.size(); ++j)
+        {
+            *outputBuffer++ = static_cast<unsigned char>(qBound(0.0f, rgb[j], 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+int PDFColorLookupTable::getGridPointCount(PDFCMSSettings::Accuracy accuracy, int inputChannels)
+{
+    const bool isFourChannels = inputChannels == 4;
+
+    switch (accuracy)
+    {
+        case PDFCMSSettings::Accuracy::Low:
+            return isFourChannels ? 11 : 17;
+
+        case PDFCMSSettings::Accuracy::Medium:
+            return isFourChannels ? 17 : 33;
+
+        case PDFCMSSettings::Accuracy::High:
+            return isFourChannels ? 23 : 49;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return isFourChannels ? 17 : 33;
+}
+
+PDFCMS::PDFCMS()
+{
+    static std::atomic<quint64> lastId = 0;
+    m_id = ++lastId;
+}
+
+void PDFCMS::collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const
+{
+    Q_UNUSED(collector);
+}
+
 PDFCMSGeneric::PDFCMSGeneric(const PDFColorConvertor& colorConvertor) :
     m_colorConvertor(colorConvertor)
 {
@@ -1399,6 +1679,14 @@ PDFCMSManager::PDFCMSManager(QObject* parent) :
 
 }
 
+void PDFCMSManager::collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const
+{
+    if (PDFCMSPointer cms = getCurrentCMS())
+    {
+        cms->collectRuntimeStatistics(collector);
+    }
+}
+
 void PDFCMSManager::finalize()
 {
     cmsUnregisterPlugins();
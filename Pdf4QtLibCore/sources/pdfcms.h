@@ -23,11 +23,13 @@
 #include "pdfexception.h"
 #include "pdfutils.h"
 #include "pdfcolorconvertor.h"
+#include "pdfruntimestatistics.h"
 
 #include <QRecursiveMutex>
 #include <QSharedPointer>
 
 #include <compare>
+#include <functional>
 
 namespace pdf
 {
@@ -77,6 +79,7 @@ struct PDFCMSSettings
     bool isGamutChecking = false;
     bool isSoftProofing = false;
     bool isConsiderOutputIntent = true;
+    bool isColorLookupTableUsed = false; ///< Use precomputed color lookup tables for RGB and CMYK transforms
     QColor outOfGamutColor = Qt::red; ///< Color, which marks out-of-gamut when soft-proofing is proceeded
     QString outputCS;               ///< Output (rendering) color space
     QString deviceGray;             ///< Identifiers for color space (device gray)
@@ -92,15 +95,72 @@ struct PDFCMSSettings
     double sigmoidSlopeFactor = 10.0;
 };
 
+/// Color lookup table, which contains precomputed RGB output colors of the color
+/// transform in the regular grid of input colors. Table has three input channels
+/// (for example, RGB) or four input channels (for example, CMYK), input values
+/// are in range [0, 1]. Colors are computed using tetrahedral interpolation in the
+/// first three channels, the fourth channel is interpolated linearly between
+/// two tetrahedral interpolations.
+class PDF4QTLIBCORESHARED_EXPORT PDFColorLookupTable
+{
+public:
+    /// Function, which transforms input colors (interleaved channels of all
+    /// grid points) to the output RGB colors in range [0, 1].
+    using Sampler = std::function<void(const std::vector<float>& input, std::vector<float>& output)>;
+
+    /// Creates lookup table by sampling the transform in the grid points
+    /// \param inputChannels Input channel count (3 or 4)
+    /// \param gridPointCount Grid point count in each input channel
+    /// \param sampler Color transform sampler
+    explicit PDFColorLookupTable(int inputChannels, int gridPointCount, const Sampler& sampler);
+
+    /// Returns true, if lookup table was successfully created
+    bool isValid() const { return !m_table.empty(); }
+
+    /// Returns input channel count
+    int getInputChannels() const { return m_inputChannels; }
+
+    /// Transforms colors to the 8-bit RGB output buffer. Count of colors
+    /// must be divisible by input channel count.
+    /// \param colors Input colors (interleaved channels)
+    /// \param outputBuffer Output buffer
+    void fillRGBBuffer(const std::vector<float>& colors, unsigned char* outputBuffer) const;
+
+    /// Returns grid point count used for given accuracy
+    /// \param accuracy Accuracy
+    /// \param inputChannels Input channel count
+    static int getGridPointCount(PDFCMSSettings::Accuracy accuracy, int inputChannels);
+
+private:
+    int m_inputChannels;
+    int m_gridPointCount;
+
+    /// Offsets of next grid point in each channel (in floats)
+    std::array<size_t, 4> m_strides;
+
+    /// Table of RGB colors of the grid points, first channel
+    /// is the most significant one.
+    std::vector<float> m_table;
+};
+
 /// Color management system base class. It contains functions to transform
 /// colors from various color system to device color system. If color management
 /// system can't handle color transform, it should return invalid color.
-class PDFCMS
+class PDFCMS : public PDFRuntimeStatisticsProvider
 {
 public:
-    explicit inline PDFCMS() = default;
+    explicit PDFCMS();
     virtual ~PDFCMS() = default;
 
+    /// Adds statistics of the color management system (for example,
+    /// count of cached color transforms). Default implementation
+    /// does not add any statistics.
+    virtual void collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const override;
+
+    /// Returns unique identifier of the color management system. Identifiers
+    /// are never reused, so they can be part of the keys of the caches.
+    quint64 getId() const { return m_id; }
+
     /// This function should decide, if color management system is compatible with these
     /// settings (so, it transforms colors according to this setting). If this
     /// function returns false, then this color management system should be replaced
@@ -260,6 +320,9 @@ public:
 
     /// Get D50 white point for XYZ color space
     static PDFColor3 getDefaultXYZWhitepoint();
+
+private:
+    quint64 m_id;
 };
 
 using PDFCMSPointer = QSharedPointer<PDFCMS>;
@@ -356,7 +419,7 @@ using PDFColorProfileIdentifiers = std::vector<PDFColorProfileIdentifier>;
 /// It also handles settings, and it's changes. Constant functions
 /// is save to call from multiple threads, this also holds for some
 /// non-constant functions - manager is protected by mutexes.
-class PDF4QTLIBCORESHARED_EXPORT PDFCMSManager : public QObject
+class PDF4QTLIBCORESHARED_EXPORT PDFCMSManager : public QObject, public PDFRuntimeStatisticsProvider
 {
     Q_OBJECT
 
@@ -366,6 +429,9 @@ private:
 public:
     explicit PDFCMSManager(QObject* parent);
 
+    /// Adds statistics of the current color management system
+    virtual void collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const override;
+
     /// Finalizes cms manager. Call this function
     /// only at program exit. Frees all allocated
     /// resources. Function is not thread-safe.
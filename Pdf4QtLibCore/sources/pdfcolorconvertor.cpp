@@ -18,13 +18,115 @@
 #include "pdfcolorconvertor.h"
 #include "pdfimageconversion.h"
 #include "pdfutils.h"
-#include "pdfdbgheap.h"
 
 #include <cmath>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDF4QT_COLORCONVERTOR_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PDF4QT_COLORCONVERTOR_USE_NEON
+#include <arm_neon.h>
+#endif
+
+#include "pdfdbgheap.h"
+
 namespace pdf
 {
 
+/// Inverts colors of the row of premultiplied pixels, color
+/// components are subtracted from alpha (for opaque pixels, it is
+/// the same as subtraction from 255).
+static void invertPremultipliedRow(QRgb* pixels, int count)
+{
+    int i = 0;
+
+#if defined(PDF4QT_COLORCONVERTOR_USE_SSE2)
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i pixel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+        __m128i alpha = _mm_srli_epi32(pixel, 24);
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        const __m128i inverted = _mm_or_si128(_mm_sub_epi8(alpha, pixel), _mm_and_si128(pixel, alphaMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), inverted);
+    }
+#elif defined(PDF4QT_COLORCONVERTOR_USE_NEON)
+    const uint32x4_t alphaMask = vdupq_n_u32(0xFF000000);
+    for (; i + 4 <= count; i += 4)
+    {
+        const uint32x4_t pixel = vld1q_u32(reinterpret_cast<const uint32_t*>(pixels + i));
+        uint32x4_t alpha = vshrq_n_u32(pixel, 24);
+        alpha = vorrq_u32(alpha, vshlq_n_u32(alpha, 8));
+        alpha = vorrq_u32(alpha, vshlq_n_u32(alpha, 16));
+        const uint32x4_t difference = vreinterpretq_u32_u8(vsubq_u8(vreinterpretq_u8_u32(alpha), vreinterpretq_u8_u32(pixel)));
+        vst1q_u32(reinterpret_cast<uint32_t*>(pixels + i), vorrq_u32(difference, vandq_u32(pixel, alphaMask)));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        const QRgb pixel = pixels[i];
+        const int alpha = qAlpha(pixel);
+        pixels[i] = qRgba(alpha - qRed(pixel), alpha - qGreen(pixel), alpha - qBlue(pixel), alpha);
+    }
+}
+
+/// Converts row of pixels to grayscale using the same weights as qGray.
+/// Conversion is linear, so it can be used for premultiplied pixels too.
+static void grayscaleRow(QRgb* pixels, int count)
+{
+    int i = 0;
+
+#if defined(PDF4QT_COLORCONVERTOR_USE_SSE2)
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+    const __m128i componentMask = _mm_set1_epi32(0xFF);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i pixel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+        const __m128i red = _mm_and_si128(_mm_srli_epi32(pixel, 16), componentMask);
+        const __m128i green = _mm_and_si128(_mm_srli_epi32(pixel, 8), componentMask);
+        const __m128i blue = _mm_and_si128(pixel, componentMask);
+
+        // Components are in the low 16 bits of 32-bit lanes, and weighted
+        // sum fits into 16 bits, so 16-bit multiplication can be used.
+        __m128i gray = _mm_mullo_epi16(red, _mm_set1_epi32(11));
+        gray = _mm_add_epi32(gray, _mm_slli_epi32(green, 4));
+        gray = _mm_add_epi32(gray, _mm_mullo_epi16(blue, _mm_set1_epi32(5)));
+        gray = _mm_srli_epi32(gray, 5);
+        gray = _mm_or_si128(gray, _mm_slli_epi32(gray, 8));
+        gray = _mm_or_si128(gray, _mm_slli_epi32(gray, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_or_si128(gray, _mm_and_si128(pixel, alphaMask)));
+    }
+#elif defined(PDF4QT_COLORCONVERTOR_USE_NEON)
+    const uint32x4_t alphaMask = vdupq_n_u32(0xFF000000);
+    const uint32x4_t componentMask = vdupq_n_u32(0xFF);
+    for (; i + 4 <= count; i += 4)
+    {
+        const uint32x4_t pixel = vld1q_u32(reinterpret_cast<const uint32_t*>(pixels + i));
+        const uint32x4_t red = vandq_u32(vshrq_n_u32(pixel, 16), componentMask);
+        const uint32x4_t green = vandq_u32(vshrq_n_u32(pixel, 8), componentMask);
+        const uint32x4_t blue = vandq_u32(pixel, componentMask);
+
+        uint32x4_t gray = vmulq_n_u32(red, 11);
+        gray = vmlaq_n_u32(gray, green, 16);
+        gray = vmlaq_n_u32(gray, blue, 5);
+        gray = vshrq_n_u32(gray, 5);
+        gray = vorrq_u32(gray, vshlq_n_u32(gray, 8));
+        gray = vorrq_u32(gray, vshlq_n_u32(gray, 8));
+        vst1q_u32(reinterpret_cast<uint32_t*>(pixels + i), vorrq_u32(gray, vandq_u32(pixel, alphaMask)));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        const QRgb pixel = pixels[i];
+        const int gray = qGray(pixel);
+        pixels[i] = qRgba(gray, gray, gray, qAlpha(pixel));
+    }
+}
+
 PDFColorConvertor::PDFColorConvertor()
 {
     calculateSigmoidParams();
@@ -180,6 +282,61 @@ QImage PDFColorConvertor::convert(QImage image) const
     return image;
 }
 
+bool PDFColorConvertor::isRasterConversionEquivalent() const
+{
+    switch (m_mode)
+    {
+        case Mode::Normal:
+        case Mode::InvertedColors:
+        case Mode::Grayscale:
+            return true;
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+void PDFColorConvertor::convertRasterImage(QImage& image) const
+{
+    if (!isActive() || image.isNull())
+    {
+        return;
+    }
+
+    const QImage::Format format = image.format();
+    const bool isFormatSupported = format == QImage::Format_ARGB32_Premultiplied || format == QImage::Format_RGB32;
+    if (!isFormatSupported || !isRasterConversionEquivalent())
+    {
+        image = convert(qMove(image));
+        return;
+    }
+
+    const int width = image.width();
+    const int height = image.height();
+
+    for (int row = 0; row < height; ++row)
+    {
+        QRgb* pixels = reinterpret_cast<QRgb*>(image.scanLine(row));
+
+        switch (m_mode)
+        {
+            case Mode::InvertedColors:
+                invertPremultipliedRow(pixels, width);
+                break;
+
+            case Mode::Grayscale:
+                grayscaleRow(pixels, width);
+                break;
+
+            default:
+                Q_ASSERT(false);
+                break;
+        }
+    }
+}
+
 void PDFColorConvertor::setHighContrastBrightnessFactor(float factor)
 {
     m_sigmoidParamC = factor;
@@ -72,6 +72,20 @@ public:
     /// \return The converted image
     QImage convert(QImage image) const;
 
+    /// Returns true, if conversion in the current mode gives the same result
+    /// when it is applied to the rasterized page instead of to the colors
+    /// of the page content. This holds for conversions, which are linear
+    /// in color components (inverted colors, grayscale), because they
+    /// commute with blending and antialiasing.
+    bool isRasterConversionEquivalent() const;
+
+    /// Converts rasterized image in place, using fast per-pixel pass (with SIMD
+    /// instructions, if available). Images in other formats than (premultiplied)
+    /// ARGB32 / RGB32, or in modes, for which raster conversion is not
+    /// equivalent, are converted by the \p convert function.
+    /// \param image Image to be converted
+    void convertRasterImage(QImage& image) const;
+
     /// Sets the correction factor for enhancing contrast in high contrast mode.
     /// This factor determines the level of contrast enhancement:
     /// - For subtle enhancement, set the factor between 5 and 10.
@@ -33,6 +33,9 @@
 namespace pdf
 {
 
+/// Count of colors, for which tint transform function is evaluated at once
+static constexpr std::size_t TINT_TRANSFORM_CHUNK_SIZE = 4096;
+
 PDFColorComponentMatrix_3x3 getInverseMatrix(const PDFColorComponentMatrix_3x3& matrix)
 {
     const PDFColorComponent a_11 = matrix.getValue(0, 0);
@@ -200,6 +203,205 @@ QColor PDFAbstractColorSpace::getDefaultColor(const PDFCMS* cms, RenderingIntent
     return getColor(getDefaultColorOriginal(), cms, intent, reporter, true);
 }
 
+/// Reader of the image samples. Reads whole line of the image and converts
+/// samples to the color components (decode array is applied). For bit depths
+/// up to 8 bits, samples are converted by lookup table which is precomputed
+/// for all possible sample values, so conversion loops are simple and can be
+/// vectorized by the compiler. Other bit depths are read by the bit reader.
+class PDFImageSampleReader
+{
+public:
+    explicit PDFImageSampleReader(const PDFImageData& imageData);
+
+    /// Reads line of the image and stores converted color components
+    /// into the output buffer. Buffer must have space for width * components
+    /// values. If image hasn't enough data, then exception is thrown.
+    /// \param line Line index
+    /// \param outputBuffer Output buffer
+    void readLine(unsigned int line, float* outputBuffer) const;
+
+private:
+    /// Reads line using the bit reader (slow path)
+    void readLineGeneric(unsigned int line, float* outputBuffer) const;
+
+    const PDFImageData& m_imageData;
+    unsigned int m_bitsPerComponent;
+    unsigned int m_componentCount;
+    unsigned int m_sampleCount;
+    size_t m_lineByteCount;
+
+    /// Lookup table, values of k-th component are stored
+    /// at offset k * (1 << bpc). Empty for bit depths above 8 bits.
+    std::vector<float> m_lookupTable;
+};
+
+PDFImageSampleReader::PDFImageSampleReader(const PDFImageData& imageData) :
+    m_imageData(imageData),
+    m_bitsPerComponent(imageData.getBitsPerComponent()),
+    m_componentCount(imageData.getComponents()),
+    m_sampleCount(imageData.getWidth() * imageData.getComponents()),
+    m_lineByteCount((size_t(m_sampleCount) * m_bitsPerComponent + 7) / 8)
+{
+    switch (m_bitsPerComponent)
+    {
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        {
+            const unsigned int valueCount = 1 << m_bitsPerComponent;
+            const PDFReal max = valueCount - 1;
+            const std::vector<PDFReal>& decode = imageData.getDecode();
+            m_lookupTable.resize(valueCount * m_componentCount, 0.0f);
+
+            for (unsigned int k = 0; k < m_componentCount; ++k)
+            {
+                float* table = m_lookupTable.data() + k * valueCount;
+                for (unsigned int value = 0; value < valueCount; ++value)
+                {
+                    if (!decode.empty())
+                    {
+                        table[value] = interpolate(value, 0.0, max, decode[2 * k], decode[2 * k + 1]);
+                    }
+                    else
+                    {
+                        table[value] = value * (1.0 / max);
+                    }
+                }
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void PDFImageSampleReader::readLine(unsigned int line, float* outputBuffer) const
+{
+    const QByteArray& data = m_imageData.getData();
+    const size_t lineOffset = size_t(line) * m_imageData.getStride();
+
+    if (m_lookupTable.empty() || lineOffset + m_lineByteCount > size_t(data.size()))
+    {
+        // Bit reader reports an error, if image hasn't enough data
+        readLineGeneric(line, outputBuffer);
+        return;
+    }
+
+    const uint8_t* input = reinterpret_cast<const uint8_t*>(data.constData()) + lineOffset;
+    const float* table = m_lookupTable.data();
+    const unsigned int valueCount = 1 << m_bitsPerComponent;
+
+    if (m_bitsPerComponent == 8)
+    {
+        switch (m_componentCount)
+        {
+            case 1:
+            {
+                for (unsigned int j = 0; j < m_sampleCount; ++j)
+                {
+                    outputBuffer[j] = table[input[j]];
+                }
+                break;
+            }
+
+            case 3:
+            {
+                const float* table0 = table;
+                const float* table1 = table + 256;
+                const float* table2 = table + 512;
+                for (unsigned int j = 0; j < m_sampleCount; j += 3)
+                {
+                    outputBuffer[j + 0] = table0[input[j + 0]];
+                    outputBuffer[j + 1] = table1[input[j + 1]];
+                    outputBuffer[j + 2] = table2[input[j + 2]];
+                }
+                break;
+            }
+
+            case 4:
+            {
+                const float* table0 = table;
+                const float* table1 = table + 256;
+                const float* table2 = table + 512;
+                const float* table3 = table + 768;
+                for (unsigned int j = 0; j < m_sampleCount; j += 4)
+                {
+                    outputBuffer[j + 0] = table0[input[j + 0]];
+                    outputBuffer[j + 1] = table1[input[j + 1]];
+                    outputBuffer[j + 2] = table2[input[j + 2]];
+                    outputBuffer[j + 3] = table3[input[j + 3]];
+                }
+                break;
+            }
+
+            default:
+            {
+                for (unsigned int j = 0, k = 0; j < m_sampleCount; ++j)
+                {
+                    outputBuffer[j] = table[k * valueCount + input[j]];
+
+                    if (++k == m_componentCount)
+                    {
+                        k = 0;
+                    }
+                }
+                break;
+            }
+        }
+    }
+    else
+    {
+        // Samples with 1, 2 or 4 bits are packed in the bytes, first
+        // sample is stored in the most significant bits of the byte.
+        const unsigned int samplesPerByte = 8 / m_bitsPerComponent;
+        const unsigned int mask = valueCount - 1;
+
+        for (unsigned int j = 0, k = 0; j < m_sampleCount; ++j)
+        {
+            const unsigned int shift = 8 - m_bitsPerComponent * (j % samplesPerByte + 1);
+            const unsigned int value = (input[j / samplesPerByte] >> shift) & mask;
+            outputBuffer[j] = table[k * valueCount + value];
+
+            if (++k == m_componentCount)
+            {
+                k = 0;
+            }
+        }
+    }
+}
+
+void PDFImageSampleReader::readLineGeneric(unsigned int line, float* outputBuffer) const
+{
+    PDFBitReader reader(&m_imageData.getData(), m_bitsPerComponent);
+    reader.seek(line * m_imageData.getStride());
+
+    const std::vector<PDFReal>& decode = m_imageData.getDecode();
+    const double max = reader.max();
+    const double coefficient = 1.0 / max;
+
+    for (unsigned int j = 0, k = 0; j < m_sampleCount; ++j)
+    {
+        PDFReal value = reader.read();
+
+        // Interpolate value, if it is not empty
+        if (!decode.empty())
+        {
+            outputBuffer[j] = interpolate(value, 0.0, max, decode[2 * k], decode[2 * k + 1]);
+        }
+        else
+        {
+            outputBuffer[j] = value * coefficient;
+        }
+
+        if (++k == m_componentCount)
+        {
+            k = 0;
+        }
+    }
+}
+
 QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
                                        const PDFImageData& softMask,
                                        const PDFCMS* cms,
@@ -231,6 +433,8 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
                 const unsigned int imageWidth = imageData.getWidth();
                 const unsigned int imageHeight = imageData.getHeight();
 
+                const PDFImageSampleReader sampleReader(imageData);
+
                 QMutex exceptionMutex;
                 std::optional<PDFException> exception;
 
@@ -244,38 +448,10 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
 
                     try
                     {
-                        PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
-                        reader.seek(i * imageData.getStride());
-
-                        const double max = reader.max();
-                        const double coefficient = 1.0 / max;
                         unsigned char* outputLine = image.scanLine(i);
 
                         std::vector<float> inputColors(imageWidth * componentCount, 0.0f);
-                        auto itInputColor = inputColors.begin();
-
-                        if (!decode.empty())
-                        {
-                            // Interpolate value
-                            for (unsigned int j = 0; j < imageData.getWidth(); ++j)
-                            {
-                                for (unsigned int k = 0; k < componentCount; ++k)
-                                {
-                                    PDFReal value = reader.read();
-                                    *itInputColor++ = interpolate(value, 0.0, max, decode[2 * k], decode[2 * k + 1]);
-                                }
-                            }
-                        }
-                        else
-                        {
-                            // Just read all values and multiply them with coefficient
-                            const unsigned int pixelCount = imageData.getWidth() * componentCount;
-                            for (unsigned int j = 0; j < pixelCount; ++j)
-                            {
-                                PDFReal value = reader.read();
-                                *itInputColor++ = value * coefficient;
-                            }
-                        }
+                        sampleReader.readLine(i, inputColors.data());
 
                         fillRGBBuffer(inputColors, outputLine, intent, cms, reporter);
                     }
@@ -328,6 +504,8 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
                     alphaMask = alphaMask.scaled(image.size());
                 }
 
+                const PDFImageSampleReader sampleReader(imageData);
+
                 QMutex exceptionMutex;
                 std::optional<PDFException> exception;
 
@@ -341,35 +519,12 @@ QImage PDFAbstractColorSpace::getImage(const PDFImageData& imageData,
 
                     try
                     {
-                        PDFBitReader reader(&imageData.getData(), imageData.getBitsPerComponent());
-                        reader.seek(i * imageData.getStride());
-
-                        const double max = reader.max();
-                        const double coefficient = 1.0 / max;
                         unsigned char* outputLine = image.scanLine(i);
                         unsigned char* alphaLine = alphaMask.scanLine(i);
 
                         std::vector<float> inputColors(imageWidth * componentCount, 0.0f);
                         std::vector<unsigned char> outputColors(imageWidth * 3, 0);
-
-                        auto itInputColor = inputColors.begin();
-                        for (unsigned int j = 0; j < imageData.getWidth(); ++j)
-                        {
-                            for (unsigned int k = 0; k < componentCount; ++k)
-                            {
-                                PDFReal value = reader.read();
-
-                                // Interpolate value, if it is not empty
-                                if (!decode.empty())
-                                {
-                                    *itInputColor++ = interpolate(value, 0.0, max, decode[2 * k], decode[2 * k + 1]);
-                                }
-                                else
-                                {
-                                    *itInputColor++ = value * coefficient;
-                                }
-                            }
-                        }
+                        sampleReader.readLine(i, inputColors.data());
 
                         fillRGBBuffer(inputColors, outputColors.data(), intent, cms, reporter);
 
@@ -527,6 +682,45 @@ QColor PDFAbstractColorSpace::getCheckedColor(const PDFColor& color, const PDFCM
     return getColor(color, cms, intent, reporter, true);
 }
 
+std::vector<QRgb> PDFAbstractColorSpace::getRgbColors(const std::vector<PDFColor>& colors, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+{
+    std::vector<QRgb> result;
+
+    if (colors.empty())
+    {
+        return result;
+    }
+
+    const size_t colorComponentCount = getColorComponentCount();
+    std::vector<float> inputColors;
+    inputColors.reserve(colors.size() * colorComponentCount);
+
+    for (const PDFColor& color : colors)
+    {
+        if (color.size() != colorComponentCount)
+        {
+            throw PDFException(PDFTranslationContext::tr("Invalid number of color components. Expected number is %1, actual number is %2.").arg(static_cast<int>(colorComponentCount)).arg(static_cast<int>(color.size())));
+        }
+
+        for (size_t i = 0; i < colorComponentCount; ++i)
+        {
+            inputColors.push_back(color[i]);
+        }
+    }
+
+    std::vector<unsigned char> outputColors(colors.size() * 3, 0);
+    fillRGBBuffer(inputColors, outputColors.data(), intent, cms, reporter);
+
+    result.reserve(colors.size());
+    for (size_t i = 0; i < colors.size(); ++i)
+    {
+        const unsigned char* rgb = outputColors.data() + i * 3;
+        result.push_back(qRgb(rgb[0], rgb[1], rgb[2]));
+    }
+
+    return result;
+}
+
 QImage PDFAbstractColorSpace::createAlphaMask(const PDFImageData& softMask)
 {
     if (softMask.getMaskingType() != PDFImageData::MaskingType::None)
@@ -1871,6 +2065,23 @@ size_t PDFIndexedColorSpace::getColorComponentCount() const
     return 1;
 }
 
+std::vector<QRgb> PDFIndexedColorSpace::createPalette(const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter) const
+{
+    std::vector<QRgb> palette;
+    palette.reserve(m_maxValue + 1);
+
+    PDFColor color;
+    color.resize(1);
+
+    for (int i = MIN_VALUE; i <= m_maxValue; ++i)
+    {
+        color[0] = i;
+        palette.push_back(getColor(color, cms, intent, reporter, false).rgb());
+    }
+
+    return palette;
+}
+
 QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
                                       const PDFImageData& softMask,
                                       const PDFCMS* cms,
@@ -1897,8 +2108,8 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
 
                 Q_ASSERT(componentCount == 1);
 
-                PDFColor color;
-                color.resize(1);
+                const std::vector<QRgb> palette = createPalette(cms, intent, reporter);
+                const PDFBitReader::Value maxIndex = palette.size() - 1;
 
                 for (unsigned int i = 0, rowCount = imageData.getHeight(); i < rowCount; ++i)
                 {
@@ -1913,11 +2124,8 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
 
                     for (unsigned int j = 0; j < imageData.getWidth(); ++j)
                     {
-                        PDFBitReader::Value index = reader.read();
-                        color[0] = index;
-
-                        QColor transformedColor = getColor(color, cms, intent, reporter, false);
-                        QRgb rgb = transformedColor.rgb();
+                        const PDFBitReader::Value index = qMin<PDFBitReader::Value>(reader.read(), maxIndex);
+                        const QRgb rgb = palette[index];
 
                         *outputLine++ = qRed(rgb);
                         *outputLine++ = qGreen(rgb);
@@ -1943,8 +2151,8 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
 
                 Q_ASSERT(componentCount == 1);
 
-                PDFColor color;
-                color.resize(1);
+                const std::vector<QRgb> palette = createPalette(cms, intent, reporter);
+                const PDFBitReader::Value maxIndex = palette.size() - 1;
 
                 QImage alphaMask = createAlphaMask(softMask);
                 if (alphaMask.size() != image.size())
@@ -1967,11 +2175,8 @@ QImage PDFIndexedColorSpace::getImage(const PDFImageData& imageData,
 
                     for (unsigned int j = 0; j < imageData.getWidth(); ++j)
                     {
-                        PDFBitReader::Value index = reader.read();
-                        color[0] = index;
-
-                        QColor transformedColor = getColor(color, cms, intent, reporter, false);
-                        QRgb rgb = transformedColor.rgb();
+                        const PDFBitReader::Value index = qMin<PDFBitReader::Value>(reader.read(), maxIndex);
+                        const QRgb rgb = palette[index];
 
                         *outputLine++ = qRed(rgb);
                         *outputLine++ = qGreen(rgb);
@@ -2248,31 +2453,35 @@ std::vector<PDFColorComponent> PDFSeparationColorSpace::transformColorsToBaseCol
     const std::size_t colorComponentCount = m_alternateColorSpace->getColorComponentCount();
     std::vector<PDFColorComponent> result(buffer.size() * colorComponentCount, 0.0f);
 
-    std::vector<double> outputColor;
-    outputColor.resize(colorComponentCount, 0.0);
-
-    auto outputIt = result.begin();
-    for (PDFColorComponent input : buffer)
+    if (m_isAll)
     {
-        // Input value
-        double tint = input;
-
-        Q_ASSERT(outputIt + (colorComponentCount - 1) != result.cend());
-
-        if (m_isAll)
+        auto outputIt = result.begin();
+        for (PDFColorComponent input : buffer)
         {
-            const double inversedTint = qBound(0.0, 1.0 - tint, 1.0);
+            Q_ASSERT(outputIt + (colorComponentCount - 1) != result.cend());
+
+            const double inversedTint = qBound(0.0, 1.0 - double(input), 1.0);
             std::fill(outputIt, outputIt + colorComponentCount, inversedTint);
+            outputIt = std::next(outputIt, colorComponentCount);
         }
-        else
+        Q_ASSERT(outputIt == result.cend());
+    }
+    else
+    {
+        // Evaluate tint transform in chunks, so virtual function call
+        // and argument checks are not performed for each color.
+        const std::size_t chunkSize = std::min<std::size_t>(buffer.size(), TINT_TRANSFORM_CHUNK_SIZE);
+        std::vector<double> inputColors(chunkSize, 0.0);
+        std::vector<double> outputColors(chunkSize * colorComponentCount, 0.0);
+
+        for (std::size_t offset = 0; offset < buffer.size(); offset += chunkSize)
         {
-            m_tintTransform->apply(&tint, &tint + 1, outputColor.data(), outputColor.data() + outputColor.size());
-            std::copy(outputColor.cbegin(), outputColor.cend(), outputIt);
+            const std::size_t count = std::min(chunkSize, buffer.size() - offset);
+            std::copy(buffer.begin() + offset, buffer.begin() + offset + count, inputColors.begin());
+            m_tintTransform->applyBatch(inputColors.data(), outputColors.data(), count);
+            std::copy(outputColors.cbegin(), outputColors.cbegin() + count * colorComponentCount, result.begin() + offset * colorComponentCount);
         }
-
-        outputIt = std::next(outputIt, colorComponentCount);
     }
-    Q_ASSERT(outputIt == result.cend());
 
     return result;
 }
@@ -2489,18 +2698,20 @@ std::vector<PDFColorComponent> PDFDeviceNColorSpace::transformColorsToBaseColorS
         const std::size_t alternateColorSpaceComponentCount = m_alternateColorSpace->getColorComponentCount();
         result.resize(inputColorCount * alternateColorSpaceComponentCount, 0.0f);
 
-        std::vector<double> inputColor(colorantCount, 0.0);
-        std::vector<double> outputColor(alternateColorSpaceComponentCount, 0.0);
+        // Evaluate tint transform in chunks, so virtual function call
+        // and argument checks are not performed for each color.
+        const std::size_t chunkSize = std::min<std::size_t>(inputColorCount, TINT_TRANSFORM_CHUNK_SIZE);
+        std::vector<double> inputColors(chunkSize * colorantCount, 0.0);
+        std::vector<double> outputColors(chunkSize * alternateColorSpaceComponentCount, 0.0);
 
-        auto outputIt = result.begin();
-        for (auto it = buffer.begin(); it != buffer.end(); it = std::next(it, colorantCount))
+        for (std::size_t offset = 0; offset < inputColorCount; offset += chunkSize)
         {
-            std::copy(it, it + colorantCount, inputColor.begin());
-            m_tintTransform->apply(inputColor.data(), inputColor.data() + inputColor.size(), outputColor.data(), outputColor.data() + outputColor.size());
-            std::copy(outputColor.cbegin(), outputColor.cend(), outputIt);
-            outputIt = std::next(outputIt, alternateColorSpaceComponentCount);
+            const std::size_t count = std::min(chunkSize, inputColorCount - offset);
+            auto inputIt = buffer.begin() + offset * colorantCount;
+            std::copy(inputIt, inputIt + count * colorantCount, inputColors.begin());
+            m_tintTransform->applyBatch(inputColors.data(), outputColors.data(), count);
+            std::copy(outputColors.cbegin(), outputColors.cbegin() + count * alternateColorSpaceComponentCount, result.begin() + offset * alternateColorSpaceComponentCount);
         }
-        Q_ASSERT(outputIt == result.cend());
     }
 
     return result;
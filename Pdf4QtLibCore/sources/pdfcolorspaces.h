@@ -399,6 +399,16 @@ public:
     /// \param reporter Error reporter
     QColor getCheckedColor(const PDFColor& color, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter) const;
 
+    /// Converts array of colors to the RGB colors. All colors are converted at once,
+    /// so color management system can transform them in one call. Number of color
+    /// components of each color must be equal to the color space component count,
+    /// otherwise exception is thrown.
+    /// \param colors Input colors
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param reporter Error reporter
+    std::vector<QRgb> getRgbColors(const std::vector<PDFColor>& colors, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter) const;
+
     /// Creates alpha mask from soft image data. Exception is thrown, if something fails.
     /// \param softMask Soft mask
     static QImage createAlphaMask(const PDFImageData& softMask);
@@ -783,6 +793,14 @@ private:
     static constexpr const int MIN_VALUE = 0;
     static constexpr const int MAX_VALUE = 255;
 
+    /// Converts all colors of the color table to RGB, so image pixels
+    /// can be converted by simple table lookup. Index of the palette
+    /// is color index, palette has getMaxValue() + 1 entries.
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    /// \param reporter Error reporter
+    std::vector<QRgb> createPalette(const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter) const;
+
     PDFColorSpacePointer m_baseColorSpace;
     QByteArray m_colors;
     int m_maxValue;
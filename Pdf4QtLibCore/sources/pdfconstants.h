@@ -74,6 +74,20 @@ static constexpr const int PDF_MAX_COLOR_COMPONENTS = 32;
 // Cache limits
 static constexpr size_t DEFAULT_FONT_CACHE_LIMIT = 32;
 static constexpr size_t DEFAULT_REALIZED_FONT_CACHE_LIMIT = 128;
+static constexpr size_t DEFAULT_IMAGE_CACHE_LIMIT = 512 * 1024 * 1024;
+static constexpr size_t DEFAULT_MESH_CACHE_LIMIT = 128 * 1024 * 1024;
+static constexpr size_t DEFAULT_CONTENT_STREAM_CACHE_LIMIT = 64 * 1024 * 1024;
+static constexpr size_t DEFAULT_CACHE_MEMORY_BUDGET = 512 * 1024 * 1024;
+
+// Mesh cache - scale of the meshes is divided into buckets, meshes are
+// reused only within the bucket. Meshing area can exceed cached area
+// by the tolerance (relative to the size of the cached area).
+static constexpr const int MESH_CACHE_SCALE_BUCKETS_PER_OCTAVE = 2;
+static constexpr const double MESH_CACHE_AREA_TOLERANCE = 0.001;
+
+// Tiling pattern cells are painted using cell images only, if cell image
+// has at most given count of pixels, otherwise cells are painted as vector graphics.
+static constexpr const int TILING_PATTERN_CELL_IMAGE_MAX_PIXELS = 1024 * 1024;
 
 }   // namespace pdf
 
@@ -24,14 +24,88 @@
 #include "pdfconstants.h"
 #include "pdfalgorithmlcs.h"
 #include "pdfpainter.h"
+#include "pdfdiskcache.h"
+#include "pdfpagecontenthash.h"
 
+#include <QDataStream>
 #include <QtConcurrent/QtConcurrent>
 
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDF4QT_DIFF_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PDF4QT_DIFF_USE_NEON
+#include <arm_neon.h>
+#endif
+
 #include "pdfdbgheap.h"
 
 namespace pdf
 {
 
+/// Maximal difference of color channel values of two pixels, so pixels
+/// are still considered equal (differences caused by antialiasing).
+static constexpr const int RASTER_PIXEL_TOLERANCE = 32;
+
+/// Size of the tile in pixels, differing pixels are grouped
+/// into tiles before regions of differences are found.
+static constexpr const int RASTER_TILE_SIZE = 8;
+
+#if defined(PDF4QT_DIFF_USE_SSE2) || defined(PDF4QT_DIFF_USE_NEON)
+#define PDF4QT_DIFF_USE_SIMD
+
+static constexpr const int RASTER_VECTOR_SIZE = 16;
+#endif
+
+/// Returns true, if some color channel of the pixels differs more,
+/// than is the tolerance. Pixels must have the same format.
+/// \param left Left pixels
+/// \param right Right pixels
+/// \param byteCount Byte count of the pixels
+static inline bool hasRasterDifference(const uchar* left, const uchar* right, int byteCount)
+{
+    int i = 0;
+
+#if defined(PDF4QT_DIFF_USE_SSE2)
+    const __m128i tolerance = _mm_set1_epi8(char(RASTER_PIXEL_TOLERANCE));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + RASTER_VECTOR_SIZE <= byteCount; i += RASTER_VECTOR_SIZE)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+        const __m128i difference = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        const __m128i exceeded = _mm_subs_epu8(difference, tolerance);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(exceeded, zero)) != 0xFFFF)
+        {
+            return true;
+        }
+    }
+#elif defined(PDF4QT_DIFF_USE_NEON)
+    const uint8x16_t tolerance = vdupq_n_u8(uint8_t(RASTER_PIXEL_TOLERANCE));
+    for (; i + RASTER_VECTOR_SIZE <= byteCount; i += RASTER_VECTOR_SIZE)
+    {
+        const uint8x16_t exceeded = vcgtq_u8(vabdq_u8(vld1q_u8(left + i), vld1q_u8(right + i)), tolerance);
+        const uint8x8_t folded = vorr_u8(vget_low_u8(exceeded), vget_high_u8(exceeded));
+        if (vget_lane_u64(vreinterpret_u64_u8(folded), 0) != 0)
+        {
+            return true;
+        }
+    }
+#endif
+
+    for (; i < byteCount; ++i)
+    {
+        if (std::abs(int(left[i]) - int(right[i])) > RASTER_PIXEL_TOLERANCE)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 class PDFDiffHelper
 {
 public:
@@ -54,6 +128,7 @@ public:
         PDFDocumentTextFlow rightTextFlow;
         QString leftText;
         QString rightText;
+        bool isPriority = false; ///< Contains pages, which should be compared first
     };
 
     struct TextCompareItem
@@ -62,9 +137,26 @@ public:
         int charIndex = 0;
         int charCount = 0;
         bool left = false;
+        size_t hash = 0; ///< Hash of the item text, used to speed up comparison
     };
 
     static Differences calculateDifferences(const GraphicPieceInfos& left, const GraphicPieceInfos& right, PDFReal epsilon);
+
+    /// Returns regions (in pixels), in which page images differ. Differing pixels
+    /// are grouped into tiles, and regions are bounding rectangles of connected
+    /// components of the differing tiles. Area, which is covered only by one
+    /// of the images, is always different. Images must have 32-bit format.
+    /// \param leftImage Left page image
+    /// \param rightImage Right page image
+    static std::vector<QRect> calculateRasterDifferences(const QImage& leftImage, const QImage& rightImage);
+
+    /// Returns signature of the page used to find candidates for page matching.
+    /// If differences of two pages are empty, then pages have the same signature,
+    /// so only pages with the same signature must be compared. Signature is sorted
+    /// set of piece keys (type, element count and image hash), which are not
+    /// affected by small numerical differences of piece coordinates.
+    /// \param pieces Graphic pieces of the page
+    static std::vector<quint64> getPageMatchingSignature(const GraphicPieceInfos& pieces);
     static std::vector<size_t> getLeftUnmatched(const PageSequence& sequence);
     static std::vector<size_t> getRightUnmatched(const PageSequence& sequence);
     static void matchPage(PageSequence& sequence, size_t leftPage, size_t rightPage);
@@ -72,6 +164,8 @@ public:
                                                                 bool isWordsComparingMode,
                                                                 bool isLeft);
     static void refineTextRectangles(PDFDiffResult::RectInfos& items);
+    static QByteArray serializeGraphicPieces(const GraphicPieceInfos& pieces);
+    static bool deserializeGraphicPieces(const QByteArray& data, GraphicPieceInfos& pieces);
 };
 
 PDFDiff::PDFDiff(QObject* parent) :
@@ -81,8 +175,10 @@ PDFDiff::PDFDiff(QObject* parent) :
     m_rightDocument(nullptr),
     m_options(Asynchronous | PC_Text | PC_VectorGraphics | PC_Images | CompareWords),
     m_epsilon(0.001),
+    m_rasterResolution(100.0),
     m_cancelled(false),
-    m_textAnalysisAlgorithm(PDFDocumentTextFlowFactory::Algorithm::Layout)
+    m_textAnalysisAlgorithm(PDFDocumentTextFlowFactory::Algorithm::Layout),
+    m_diskCache(nullptr)
 {
 
 }
@@ -131,6 +227,12 @@ void PDFDiff::start()
 
     m_cancelled = false;
 
+    {
+        QMutexLocker lock(&m_partialResultMutex);
+        m_partialResult = PDFDiffResult();
+        m_partialResultTimer.invalidate();
+    }
+
     if (m_options.testFlag(Asynchronous))
     {
         m_futureWatcher = std::nullopt;
@@ -159,6 +261,47 @@ void PDFDiff::stop()
     }
 }
 
+void PDFDiff::setPriorityPages(std::vector<PDFInteger> leftPages, std::vector<PDFInteger> rightPages)
+{
+    stop();
+
+    std::sort(leftPages.begin(), leftPages.end());
+    std::sort(rightPages.begin(), rightPages.end());
+    m_priorityLeftPages = std::move(leftPages);
+    m_priorityRightPages = std::move(rightPages);
+}
+
+PDFDiffResult PDFDiff::getPartialResult() const
+{
+    QMutexLocker lock(&m_partialResultMutex);
+    return m_partialResult;
+}
+
+void PDFDiff::publishPartialResult(const PDFDiffResult& result, bool force)
+{
+    if (!m_options.testFlag(Asynchronous) || m_cancelled)
+    {
+        return;
+    }
+
+    {
+        QMutexLocker lock(&m_partialResultMutex);
+
+        if (!force && m_partialResultTimer.isValid() && m_partialResultTimer.elapsed() < PARTIAL_RESULT_INTERVAL)
+        {
+            return;
+        }
+
+        m_partialResult = result;
+        m_partialResult.finalize();
+        m_partialResultTimer.start();
+    }
+
+    // Signal is emitted from the worker thread, so it is delivered
+    // to the receivers in the main thread using queued connection.
+    Q_EMIT partialResultAvailable();
+}
+
 PDFDiffResult PDFDiff::perform()
 {
     PDFDiffResult result;
@@ -267,22 +410,48 @@ void PDFDiff::performPageMatching(const std::vector<PDFDiffPageContext>& leftPre
         matchedPages[index] = std::vector<size_t>();
     }
 
+    // Unmatched right pages are distributed into buckets by their signatures,
+    // so each left page is compared only with candidates from its bucket,
+    // instead of all unmatched right pages.
+    std::vector<std::vector<quint64>> leftSignatures(leftPreparedPages.size());
+    std::vector<std::vector<quint64>> rightSignatures(rightPreparedPages.size());
+
+    auto calculateLeftSignature = [&](size_t leftIndex)
+    {
+        leftSignatures[leftIndex] = PDFDiffHelper::getPageMatchingSignature(leftPreparedPages[leftIndex].graphicPieces);
+    };
+    auto calculateRightSignature = [&](size_t rightIndex)
+    {
+        rightSignatures[rightIndex] = PDFDiffHelper::getPageMatchingSignature(rightPreparedPages[rightIndex].graphicPieces);
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, leftUnmatched.begin(), leftUnmatched.end(), calculateLeftSignature);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, rightUnmatched.begin(), rightUnmatched.end(), calculateRightSignature);
+
+    using SignatureKey = std::pair<size_t, std::vector<quint64>>;
+    std::map<SignatureKey, std::vector<size_t>> rightBuckets;
+    for (const size_t rightIndex : rightUnmatched)
+    {
+        SignatureKey key(rightPreparedPages[rightIndex].graphicPieces.size(), qMove(rightSignatures[rightIndex]));
+        rightBuckets[qMove(key)].push_back(rightIndex);
+    }
+
     auto matchLeftPage = [&, this](size_t leftIndex)
     {
         const PDFDiffPageContext& leftPageContext = leftPreparedPages[leftIndex];
 
+        auto it = rightBuckets.find(SignatureKey(leftPageContext.graphicPieces.size(), leftSignatures[leftIndex]));
+        if (it == rightBuckets.cend())
+        {
+            // Match cannot exist, no right page has the same signature
+            return;
+        }
+
         auto page = m_leftDocument->getCatalog()->getPage(leftPageContext.pageIndex);
         PDFReal epsilon = calculateEpsilonForPage(page);
 
-        for (const size_t rightIndex : rightUnmatched)
+        for (const size_t rightIndex : it->second)
         {
             const PDFDiffPageContext& rightPageContext = rightPreparedPages[rightIndex];
-            if (leftPageContext.graphicPieces.size() != rightPageContext.graphicPieces.size())
-            {
-                // Match cannot exist, graphic pieces have different size
-                continue;
-            }
-
             PDFDiffHelper::Differences differences = PDFDiffHelper::calculateDifferences(leftPageContext.graphicPieces, rightPageContext.graphicPieces, epsilon);
 
             if (differences.isEmpty())
@@ -361,15 +530,7 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
 
         auto fillPageContext = [&, this](PDFDiffPageContext& context)
         {
-            PDFPrecompiledPage compiledPage;
-            constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
-            PDFRenderer renderer(m_leftDocument, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
-            renderer.compile(&compiledPage, context.pageIndex);
-
-            auto page = m_leftDocument->getCatalog()->getPage(context.pageIndex);
-            PDFReal epsilon = calculateEpsilonForPage(page);
-            context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
-
+            calculateGraphicsPieces(context, m_leftDocument, &fontCache, cms.data(), &optionalContentActivity);
             finalizeGraphicsPieces(context);
         };
         PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, leftPreparedPages.begin(), leftPreparedPages.end(), fillPageContext);
@@ -389,15 +550,7 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
 
         auto fillPageContext = [&, this](PDFDiffPageContext& context)
         {
-            PDFPrecompiledPage compiledPage;
-            constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
-            PDFRenderer renderer(m_rightDocument, &fontCache, cms.data(), &optionalContentActivity, features, pdf::PDFMeshQualitySettings());
-            renderer.compile(&compiledPage, context.pageIndex);
-
-            const PDFPage* page = m_rightDocument->getCatalog()->getPage(context.pageIndex);
-            PDFReal epsilon = calculateEpsilonForPage(page);
-            context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
-
+            calculateGraphicsPieces(context, m_rightDocument, &fontCache, cms.data(), &optionalContentActivity);
             finalizeGraphicsPieces(context);
         };
 
@@ -409,6 +562,11 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
     if (!m_cancelled)
     {
         performPageMatching(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches);
+
+        // Page movements and graphics differences do not depend on the text,
+        // so they are available before text is extracted from the documents.
+        performCompareGraphics(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches, result);
+        publishPartialResult(result, true);
         stepProgress();
     }
 
@@ -417,6 +575,7 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
     {
         pdf::PDFDocumentTextFlowFactory factoryLeftDocumentTextFlow;
         factoryLeftDocumentTextFlow.setCalculateBoundingBoxes(true);
+        factoryLeftDocumentTextFlow.setDiskCache(m_diskCache);
         PDFDocumentTextFlow leftTextFlow = factoryLeftDocumentTextFlow.create(m_leftDocument, leftPages, m_textAnalysisAlgorithm);
         std::map<PDFInteger, PDFDocumentTextFlow> splittedText = leftTextFlow.split(PDFDocumentTextFlow::Text);
         for (PDFDiffPageContext& leftContext : leftPreparedPages)
@@ -436,6 +595,7 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
     {
         pdf::PDFDocumentTextFlowFactory factoryRightDocumentTextFlow;
         factoryRightDocumentTextFlow.setCalculateBoundingBoxes(true);
+        factoryRightDocumentTextFlow.setDiskCache(m_diskCache);
         PDFDocumentTextFlow rightTextFlow = factoryRightDocumentTextFlow.create(m_rightDocument, rightPages, m_textAnalysisAlgorithm);
         std::map<PDFInteger, PDFDocumentTextFlow> splittedText = rightTextFlow.split(PDFDocumentTextFlow::Text);
         for (PDFDiffPageContext& rightContext : rightPreparedPages)
@@ -453,16 +613,16 @@ void PDFDiff::performSteps(const std::vector<PDFInteger>& leftPages,
     // StepCompare
     if (!m_cancelled)
     {
-        performCompare(leftPreparedPages, rightPreparedPages, pageSequence, pageMatches, result);
+        performCompareTexts(leftPreparedPages, rightPreparedPages, pageSequence, result);
         stepProgress();
     }
 }
 
-void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPreparedPages,
-                             const std::vector<PDFDiffPageContext>& rightPreparedPages,
-                             PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
-                             const std::map<size_t, size_t>& pageMatches,
-                             PDFDiffResult& result)
+void PDFDiff::performCompareGraphics(const std::vector<PDFDiffPageContext>& leftPreparedPages,
+                                     const std::vector<PDFDiffPageContext>& rightPreparedPages,
+                                     PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
+                                     const std::map<size_t, size_t>& pageMatches,
+                                     PDFDiffResult& result)
 {
     using AlgorithmLCS = PDFAlgorithmLongestCommonSubsequenceBase;
 
@@ -500,7 +660,10 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
     }
     result.setPageSequence(std::move(resultPageSequence));
 
-    std::vector<PDFDiffHelper::TextFlowDifferences> textFlowDifferences;
+    // In raster compare mode, replaced pages are compared after all
+    // modified ranges are processed, using rendered page images.
+    const bool isRasterCompare = m_options.testFlag(RasterCompare);
+    std::vector<std::pair<PDFInteger, PDFInteger>> rasterComparedPages;
 
     for (const auto& range : modifiedRanges)
     {
@@ -516,25 +679,20 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
         // page range was added, or page range was removed.
         if (isReplaced)
         {
-            PDFDocumentTextFlow leftTextFlow;
-            PDFDocumentTextFlow rightTextFlow;
-
             const bool isTextComparedAsVectorGraphics = m_options.testFlag(CompareTextsAsVector);
 
             for (auto it = range.first; it != range.second; ++it)
             {
                 const AlgorithmLCS::SequenceItem& item = *it;
-                if (item.isReplaced() && item.isMatch())
+                if (item.isReplaced() && item.isMatch() && isRasterCompare)
+                {
+                    rasterComparedPages.emplace_back(leftPreparedPages[item.index1].pageIndex, rightPreparedPages[item.index2].pageIndex);
+                }
+                else if (item.isReplaced() && item.isMatch())
                 {
                     const PDFDiffPageContext& leftPageContext = leftPreparedPages[item.index1];
                     const PDFDiffPageContext& rightPageContext = rightPreparedPages[item.index2];
 
-                    if (!isTextComparedAsVectorGraphics)
-                    {
-                        leftTextFlow.append(leftPageContext.text);
-                        rightTextFlow.append(rightPageContext.text);
-                    }
-
                     auto pageLeft = m_leftDocument->getCatalog()->getPage(leftPageContext.pageIndex);
                     auto pageRight = m_rightDocument->getCatalog()->getPage(rightPageContext.pageIndex);
                     PDFReal epsilon = (calculateEpsilonForPage(pageLeft) + calculateEpsilonForPage(pageRight)) * 0.5;
@@ -602,43 +760,13 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
 
                 if (item.isAdded())
                 {
-                    const PDFDiffPageContext& rightPageContext = rightPreparedPages[item.index2];
-
-                    if (!isTextComparedAsVectorGraphics)
-                    {
-                        rightTextFlow.append(rightPageContext.text);
-                    }
-
-                    result.addPageAdded(rightPageContext.pageIndex);
+                    result.addPageAdded(rightPreparedPages[item.index2].pageIndex);
                 }
                 if (item.isRemoved())
                 {
-                    const PDFDiffPageContext& leftPageContext = leftPreparedPages[item.index1];
-
-                    if (!isTextComparedAsVectorGraphics)
-                    {
-                        leftTextFlow.append(leftPageContext.text);
-                    }
-
-                    result.addPageRemoved(leftPageContext.pageIndex);
+                    result.addPageRemoved(leftPreparedPages[item.index1].pageIndex);
                 }
             }
-
-            textFlowDifferences.emplace_back();
-            PDFDiffHelper::TextFlowDifferences& addedDifferences = textFlowDifferences.back();
-            addedDifferences.leftText = leftTextFlow.getText();
-            addedDifferences.rightText = rightTextFlow.getText();
-
-            if (addedDifferences.leftText == addedDifferences.rightText)
-            {
-                // Text is the same, no difference is found
-                textFlowDifferences.pop_back();
-            }
-            else
-            {
-                addedDifferences.leftTextFlow = std::move(leftTextFlow);
-                addedDifferences.rightTextFlow = std::move(rightTextFlow);
-            }
         }
         else
         {
@@ -659,6 +787,243 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
         }
     }
 
+    performRasterCompare(rasterComparedPages, result);
+}
+
+void PDFDiff::performRasterCompare(const std::vector<std::pair<PDFInteger, PDFInteger>>& pagePairs,
+                                   PDFDiffResult& result)
+{
+    if (pagePairs.empty() || m_cancelled)
+    {
+        return;
+    }
+
+    // Annotations are not compared (as in graphic pieces comparation)
+    constexpr PDFRenderer::Features features = PDFRenderer::Antialiasing | PDFRenderer::TextAntialiasing | PDFRenderer::IgnoreOptionalContent;
+    const int rasterizerCount = PDFRasterizerPool::getDefaultRasterizerCount();
+
+    PDFFontCache leftFontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    PDFOptionalContentActivity leftOptionalContentActivity(m_leftDocument, pdf::OCUsage::View, nullptr);
+    leftFontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(m_leftDocument), &leftOptionalContentActivity));
+    PDFCMSManager leftCmsManager(nullptr);
+    leftCmsManager.setDocument(m_leftDocument);
+    PDFRasterizerPool leftRasterizerPool(m_leftDocument, &leftFontCache, &leftCmsManager, &leftOptionalContentActivity,
+                                         features, PDFMeshQualitySettings(), rasterizerCount, RendererEngine::Blend2D_SingleThread, nullptr);
+    leftRasterizerPool.setDiskCache(m_diskCache);
+
+    PDFFontCache rightFontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    PDFOptionalContentActivity rightOptionalContentActivity(m_rightDocument, pdf::OCUsage::View, nullptr);
+    rightFontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(m_rightDocument), &rightOptionalContentActivity));
+    PDFCMSManager rightCmsManager(nullptr);
+    rightCmsManager.setDocument(m_rightDocument);
+    PDFRasterizerPool rightRasterizerPool(m_rightDocument, &rightFontCache, &rightCmsManager, &rightOptionalContentActivity,
+                                          features, PDFMeshQualitySettings(), rasterizerCount, RendererEngine::Blend2D_SingleThread, nullptr);
+    rightRasterizerPool.setDiskCache(m_diskCache);
+
+    const PDFReal rasterResolution = m_rasterResolution;
+    auto imageSizeGetter = [rasterResolution](const PDFPage* page) -> QSize
+    {
+        QSizeF size = page->getRotatedMediaBox().size() * PDF_POINT_TO_INCH * rasterResolution;
+        return size.toSize().expandedTo(QSize(1, 1));
+    };
+
+    // Maps region of the page image to the page coordinate system
+    auto mapRegionToPage = [](const PDFPage* page, const QImage& image, const QRect& region)
+    {
+        const QRect imageRegion = region.intersected(image.rect());
+        if (!page || imageRegion.isEmpty())
+        {
+            return QRectF();
+        }
+
+        QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRectF(image.rect())).inverted();
+        return matrix.mapRect(QRectF(imageRegion));
+    };
+
+    struct RasterCompareItem
+    {
+        PDFInteger leftPageIndex = -1;
+        PDFInteger rightPageIndex = -1;
+        QImage leftImage;
+        QImage rightImage;
+        std::vector<QRectF> leftRegions;
+        std::vector<QRectF> rightRegions;
+    };
+
+    // Page images are rendered in batches, so only few images
+    // are held in the memory at once.
+    const size_t batchSize = size_t(rasterizerCount) * 2;
+    for (size_t batchStart = 0; batchStart < pagePairs.size() && !m_cancelled; batchStart += batchSize)
+    {
+        const size_t batchEnd = qMin(batchStart + batchSize, pagePairs.size());
+
+        std::vector<RasterCompareItem> items;
+        std::vector<PDFInteger> leftPageIndices;
+        std::vector<PDFInteger> rightPageIndices;
+        items.reserve(batchEnd - batchStart);
+        for (size_t i = batchStart; i < batchEnd; ++i)
+        {
+            RasterCompareItem item;
+            item.leftPageIndex = pagePairs[i].first;
+            item.rightPageIndex = pagePairs[i].second;
+            items.emplace_back(qMove(item));
+            leftPageIndices.push_back(pagePairs[i].first);
+            rightPageIndices.push_back(pagePairs[i].second);
+        }
+
+        // Page can be contained in the batch only once in each document
+        QMutex mutex;
+        auto storeLeftImage = [&items, &mutex](PDFRenderedPageImage& renderedPageImage)
+        {
+            QMutexLocker locker(&mutex);
+            auto it = std::find_if(items.begin(), items.end(), [&renderedPageImage](const RasterCompareItem& item) { return item.leftPageIndex == renderedPageImage.pageIndex; });
+            if (it != items.end())
+            {
+                it->leftImage = renderedPageImage.pageImage.copy();
+            }
+        };
+        auto storeRightImage = [&items, &mutex](PDFRenderedPageImage& renderedPageImage)
+        {
+            QMutexLocker locker(&mutex);
+            auto it = std::find_if(items.begin(), items.end(), [&renderedPageImage](const RasterCompareItem& item) { return item.rightPageIndex == renderedPageImage.pageIndex; });
+            if (it != items.end())
+            {
+                it->rightImage = renderedPageImage.pageImage.copy();
+            }
+        };
+
+        leftRasterizerPool.render(leftPageIndices, imageSizeGetter, storeLeftImage, nullptr);
+        rightRasterizerPool.render(rightPageIndices, imageSizeGetter, storeRightImage, nullptr);
+
+        if (m_cancelled)
+        {
+            break;
+        }
+
+        auto compareItem = [&, this](RasterCompareItem& item)
+        {
+            if (item.leftImage.isNull() || item.rightImage.isNull())
+            {
+                return;
+            }
+
+            if (item.leftImage.format() != QImage::Format_ARGB32_Premultiplied)
+            {
+                item.leftImage.convertTo(QImage::Format_ARGB32_Premultiplied);
+            }
+            if (item.rightImage.format() != QImage::Format_ARGB32_Premultiplied)
+            {
+                item.rightImage.convertTo(QImage::Format_ARGB32_Premultiplied);
+            }
+
+            const PDFPage* leftPage = m_leftDocument->getCatalog()->getPage(item.leftPageIndex);
+            const PDFPage* rightPage = m_rightDocument->getCatalog()->getPage(item.rightPageIndex);
+
+            for (const QRect& region : PDFDiffHelper::calculateRasterDifferences(item.leftImage, item.rightImage))
+            {
+                item.leftRegions.push_back(mapRegionToPage(leftPage, item.leftImage, region));
+                item.rightRegions.push_back(mapRegionToPage(rightPage, item.rightImage, region));
+            }
+
+            item.leftImage = QImage();
+            item.rightImage = QImage();
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, items.begin(), items.end(), compareItem);
+
+        for (const RasterCompareItem& item : items)
+        {
+            for (size_t i = 0; i < item.leftRegions.size(); ++i)
+            {
+                result.addGraphicsReplaced(item.leftPageIndex, item.rightPageIndex, item.leftRegions[i], item.rightRegions[i]);
+            }
+        }
+    }
+}
+
+void PDFDiff::performCompareTexts(const std::vector<PDFDiffPageContext>& leftPreparedPages,
+                                  const std::vector<PDFDiffPageContext>& rightPreparedPages,
+                                  PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
+                                  PDFDiffResult& result)
+{
+    using AlgorithmLCS = PDFAlgorithmLongestCommonSubsequenceBase;
+
+    std::vector<PDFDiffHelper::TextFlowDifferences> textFlowDifferences;
+    const bool isTextComparedAsVectorGraphics = m_options.testFlag(CompareTextsAsVector);
+
+    auto isPriorityPage = [](const std::vector<PDFInteger>& priorityPages, PDFInteger pageIndex)
+    {
+        return std::binary_search(priorityPages.cbegin(), priorityPages.cend(), pageIndex);
+    };
+
+    for (const auto& range : AlgorithmLCS::getModifiedRanges(pageSequence))
+    {
+        AlgorithmLCS::SequenceItemFlags flags = AlgorithmLCS::collectFlags(range);
+
+        // Texts are compared only in ranges, where some page content was replaced
+        if (!flags.testFlag(AlgorithmLCS::Replaced))
+        {
+            continue;
+        }
+
+        PDFDocumentTextFlow leftTextFlow;
+        PDFDocumentTextFlow rightTextFlow;
+        bool isPriority = false;
+
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const AlgorithmLCS::SequenceItem& item = *it;
+
+            if (item.isLeftValid())
+            {
+                isPriority = isPriority || isPriorityPage(m_priorityLeftPages, leftPreparedPages[item.index1].pageIndex);
+            }
+            if (item.isRightValid())
+            {
+                isPriority = isPriority || isPriorityPage(m_priorityRightPages, rightPreparedPages[item.index2].pageIndex);
+            }
+
+            if (isTextComparedAsVectorGraphics)
+            {
+                continue;
+            }
+
+            if (item.isReplaced() && item.isMatch())
+            {
+                leftTextFlow.append(leftPreparedPages[item.index1].text);
+                rightTextFlow.append(rightPreparedPages[item.index2].text);
+            }
+
+            if (item.isAdded())
+            {
+                rightTextFlow.append(rightPreparedPages[item.index2].text);
+            }
+            if (item.isRemoved())
+            {
+                leftTextFlow.append(leftPreparedPages[item.index1].text);
+            }
+        }
+
+        textFlowDifferences.emplace_back();
+        PDFDiffHelper::TextFlowDifferences& addedDifferences = textFlowDifferences.back();
+        addedDifferences.leftText = leftTextFlow.getText();
+        addedDifferences.rightText = rightTextFlow.getText();
+
+        if (addedDifferences.leftText == addedDifferences.rightText)
+        {
+            // Text is the same, no difference is found
+            textFlowDifferences.pop_back();
+        }
+        else
+        {
+            addedDifferences.leftTextFlow = std::move(leftTextFlow);
+            addedDifferences.rightTextFlow = std::move(rightTextFlow);
+            addedDifferences.isPriority = isPriority;
+        }
+    }
+
+    // Pages, which are displayed to the user, are compared first
+    std::stable_partition(textFlowDifferences.begin(), textFlowDifferences.end(), [](const auto& context) { return context.isPriority; });
+
     QMutex mutex;
 
     // Jakub Melka: try to compare text differences
@@ -675,6 +1040,11 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
 
         auto compareCharacters = [&](const TextCompareItem& a, const TextCompareItem& b)
         {
+            if (a.hash != b.hash)
+            {
+                return false;
+            }
+
             const auto& aItem = a.left ? context.leftTextFlow : context.rightTextFlow;
             const auto& bItem = b.left ? context.leftTextFlow : context.rightTextFlow;
 
@@ -849,6 +1219,9 @@ void PDFDiff::performCompare(const std::vector<PDFDiffPageContext>& leftPrepared
                 }
             }
         }
+
+        QMutexLocker locker(&mutex);
+        publishPartialResult(result, false);
     };
 
     PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, textFlowDifferences.begin(), textFlowDifferences.end(), compareTexts);
@@ -895,6 +1268,50 @@ void PDFDiff::finalizeGraphicsPieces(PDFDiffPageContext& context)
     std::copy(hash.data(), hash.data() + size, context.pageHash.data());
 }
 
+void PDFDiff::calculateGraphicsPieces(PDFDiffPageContext& context,
+                                      const PDFDocument* document,
+                                      const PDFFontCache* fontCache,
+                                      const PDFCMS* cms,
+                                      const PDFOptionalContentActivity* optionalContentActivity) const
+{
+    constexpr PDFRenderer::Features features = PDFRenderer::IgnoreOptionalContent;
+
+    const PDFPage* page = document->getCatalog()->getPage(context.pageIndex);
+    PDFReal epsilon = calculateEpsilonForPage(page);
+
+    QByteArray diskCacheKey;
+    if (m_diskCache)
+    {
+        const QByteArray pageContentHash = PDFPageContentHash::compute(document, context.pageIndex);
+        if (!pageContentHash.isEmpty())
+        {
+            QByteArray parameters;
+
+            {
+                QDataStream stream(&parameters, QIODevice::WriteOnly);
+                stream << int(features) << epsilon;
+            }
+
+            diskCacheKey = PDFDiskCache::createPageKey(pageContentHash, "diffpieces", parameters);
+            if (PDFDiffHelper::deserializeGraphicPieces(m_diskCache->read(diskCacheKey), context.graphicPieces))
+            {
+                return;
+            }
+        }
+    }
+
+    PDFPrecompiledPage compiledPage;
+    PDFRenderer renderer(document, fontCache, cms, optionalContentActivity, features, pdf::PDFMeshQualitySettings());
+    renderer.compile(&compiledPage, context.pageIndex);
+
+    context.graphicPieces = compiledPage.calculateGraphicPieceInfos(page->getMediaBox(), epsilon);
+
+    if (!diskCacheKey.isEmpty())
+    {
+        m_diskCache->write(diskCacheKey, PDFDiffHelper::serializeGraphicPieces(context.graphicPieces));
+    }
+}
+
 void PDFDiff::onComparationPerformed()
 {
     m_cancelled = false;
@@ -1086,6 +1503,27 @@ void PDFDiffResult::addTextReplaced(PDFInteger pageIndex1,
     m_differences.emplace_back(std::move(difference));
 }
 
+void PDFDiffResult::addGraphicsReplaced(PDFInteger pageIndex1, PDFInteger pageIndex2, QRectF rect1, QRectF rect2)
+{
+    Difference difference;
+
+    difference.type = Type::GraphicsReplaced;
+    difference.pageIndex1 = pageIndex1;
+    difference.pageIndex2 = pageIndex2;
+
+    if (rect1.isValid())
+    {
+        addRectLeft(difference, rect1);
+    }
+
+    if (rect2.isValid())
+    {
+        addRectRight(difference, rect2);
+    }
+
+    m_differences.emplace_back(std::move(difference));
+}
+
 void PDFDiffResult::saveToStream(QXmlStreamWriter* stream) const
 {
     stream->setAutoFormatting(true);
@@ -1159,6 +1597,10 @@ void PDFDiffResult::saveToStream(QXmlStreamWriter* stream) const
                 type = "text-replaced";
                 break;
 
+            case Type::GraphicsReplaced:
+                type = "graphics-replaced";
+                break;
+
             default:
                 Q_ASSERT(false);
                 break;
@@ -1286,6 +1728,9 @@ QString PDFDiffResult::getMessage(size_t index) const
         case Type::TextReplaced:
             return PDFDiff::tr("Text '%1' on page %2 has been replaced by text '%3' on page %4.").arg(m_strings[difference.textRemovedIndex]).arg(difference.pageIndex1 + 1).arg(m_strings[difference.textAddedIndex]).arg(difference.pageIndex2 + 1);
 
+        case Type::GraphicsReplaced:
+            return PDFDiff::tr("Graphics on page %1 has been replaced by graphics on page %2.").arg(difference.pageIndex1 + 1).arg(difference.pageIndex2 + 1);
+
         default:
             Q_ASSERT(false);
             break;
@@ -1358,6 +1803,8 @@ QString PDFDiffResult::getTypeDescription(size_t index) const
             return PDFDiff::tr("Text removed");
         case Type::TextReplaced:
             return PDFDiff::tr("Text replaced");
+        case Type::GraphicsReplaced:
+            return PDFDiff::tr("Graphics replaced");
 
         default:
             Q_ASSERT(false);
@@ -1632,6 +2079,136 @@ PDFDiffHelper::Differences PDFDiffHelper::calculateDifferences(const GraphicPiec
     return differences;
 }
 
+std::vector<QRect> PDFDiffHelper::calculateRasterDifferences(const QImage& leftImage, const QImage& rightImage)
+{
+    Q_ASSERT(leftImage.depth() == 32 && rightImage.depth() == 32);
+
+    const int width = qMax(leftImage.width(), rightImage.width());
+    const int height = qMax(leftImage.height(), rightImage.height());
+    const int commonWidth = qMin(leftImage.width(), rightImage.width());
+    const int commonHeight = qMin(leftImage.height(), rightImage.height());
+    const int tileCountX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    const int tileCountY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    constexpr uint8_t TILE_EQUAL = 0;
+    constexpr uint8_t TILE_DIFFERENT = 1;
+    constexpr uint8_t TILE_VISITED = 2;
+
+    // Mark tiles, which contain different pixels. When tile is
+    // marked as different, its remaining pixels are not compared.
+    std::vector<uint8_t> tiles(size_t(tileCountX) * size_t(tileCountY), TILE_EQUAL);
+    for (int tileY = 0; tileY < tileCountY; ++tileY)
+    {
+        uint8_t* tileRow = tiles.data() + size_t(tileY) * size_t(tileCountX);
+        const int yMin = tileY * RASTER_TILE_SIZE;
+        const int yMax = qMin(yMin + RASTER_TILE_SIZE, height);
+
+        for (int tileX = 0; tileX < tileCountX; ++tileX)
+        {
+            const int xMax = qMin((tileX + 1) * RASTER_TILE_SIZE, width);
+            if (xMax > commonWidth || yMax > commonHeight)
+            {
+                tileRow[tileX] = TILE_DIFFERENT;
+            }
+        }
+
+        for (int y = yMin; y < yMax && y < commonHeight; ++y)
+        {
+            const uchar* leftScanLine = leftImage.constScanLine(y);
+            const uchar* rightScanLine = rightImage.constScanLine(y);
+
+            for (int tileX = 0; tileX < tileCountX; ++tileX)
+            {
+                if (tileRow[tileX] == TILE_DIFFERENT)
+                {
+                    continue;
+                }
+
+                const int x = tileX * RASTER_TILE_SIZE;
+                const int pixelCount = qMin(RASTER_TILE_SIZE, commonWidth - x);
+                if (hasRasterDifference(leftScanLine + x * 4, rightScanLine + x * 4, pixelCount * 4))
+                {
+                    tileRow[tileX] = TILE_DIFFERENT;
+                }
+            }
+        }
+    }
+
+    // Find connected components (using 8-neighbourhood) of different tiles
+    std::vector<QRect> regions;
+    std::vector<size_t> stack;
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        if (tiles[i] != TILE_DIFFERENT)
+        {
+            continue;
+        }
+
+        int minX = tileCountX;
+        int minY = tileCountY;
+        int maxX = -1;
+        int maxY = -1;
+
+        tiles[i] = TILE_VISITED;
+        stack.push_back(i);
+
+        while (!stack.empty())
+        {
+            const size_t index = stack.back();
+            stack.pop_back();
+
+            const int tileX = int(index % size_t(tileCountX));
+            const int tileY = int(index / size_t(tileCountX));
+            minX = qMin(minX, tileX);
+            minY = qMin(minY, tileY);
+            maxX = qMax(maxX, tileX);
+            maxY = qMax(maxY, tileY);
+
+            for (int neighbourY = qMax(tileY - 1, 0); neighbourY <= qMin(tileY + 1, tileCountY - 1); ++neighbourY)
+            {
+                for (int neighbourX = qMax(tileX - 1, 0); neighbourX <= qMin(tileX + 1, tileCountX - 1); ++neighbourX)
+                {
+                    const size_t neighbourIndex = size_t(neighbourY) * size_t(tileCountX) + size_t(neighbourX);
+                    if (tiles[neighbourIndex] == TILE_DIFFERENT)
+                    {
+                        tiles[neighbourIndex] = TILE_VISITED;
+                        stack.push_back(neighbourIndex);
+                    }
+                }
+            }
+        }
+
+        QRect region(minX * RASTER_TILE_SIZE, minY * RASTER_TILE_SIZE, (maxX - minX + 1) * RASTER_TILE_SIZE, (maxY - minY + 1) * RASTER_TILE_SIZE);
+        regions.push_back(region.intersected(QRect(0, 0, width, height)));
+    }
+
+    return regions;
+}
+
+std::vector<quint64> PDFDiffHelper::getPageMatchingSignature(const GraphicPieceInfos& pieces)
+{
+    std::vector<quint64> signature;
+    signature.reserve(pieces.size());
+
+    for (const GraphicPieceInfo& info : pieces)
+    {
+        quint64 key = (quint64(info.type) << 56) ^ quint64(info.pagePath.elementCount());
+
+        if (info.isImage())
+        {
+            quint64 imageHash = 0;
+            std::memcpy(&imageHash, info.imageHash.data(), sizeof(imageHash));
+            key ^= imageHash << 8;
+        }
+
+        signature.push_back(key);
+    }
+
+    std::sort(signature.begin(), signature.end());
+    signature.erase(std::unique(signature.begin(), signature.end()), signature.end());
+    return signature;
+}
+
 std::vector<size_t> PDFDiffHelper::getLeftUnmatched(const PageSequence& sequence)
 {
     std::vector<size_t> result;
@@ -1738,6 +2315,12 @@ std::vector<PDFDiffHelper::TextCompareItem> PDFDiffHelper::prepareTextCompareIte
         }
     }
 
+    for (TextCompareItem& item : items)
+    {
+        QStringView text(textFlow.getItem(item.index)->text);
+        item.hash = qHash(text.mid(item.charIndex, item.charCount));
+    }
+
     return items;
 }
 
@@ -1789,6 +2372,64 @@ void PDFDiffHelper::refineTextRectangles(PDFDiffResult::RectInfos& items)
     items = std::move(refinedItems);
 }
 
+QByteArray PDFDiffHelper::serializeGraphicPieces(const GraphicPieceInfos& pieces)
+{
+    QByteArray data;
+
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+
+        stream << quint64(pieces.size());
+        for (const GraphicPieceInfo& info : pieces)
+        {
+            stream << int(info.type);
+            stream << info.boundingRect;
+            stream.writeRawData(reinterpret_cast<const char*>(info.hash.data()), int(info.hash.size()));
+            stream.writeRawData(reinterpret_cast<const char*>(info.imageHash.data()), int(info.imageHash.size()));
+            stream << info.pagePath;
+        }
+    }
+
+    return data;
+}
+
+bool PDFDiffHelper::deserializeGraphicPieces(const QByteArray& data, GraphicPieceInfos& pieces)
+{
+    if (data.isEmpty())
+    {
+        return false;
+    }
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint64 count = 0;
+    stream >> count;
+
+    GraphicPieceInfos result;
+    for (quint64 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        GraphicPieceInfo info;
+        int type = 0;
+        stream >> type;
+        stream >> info.boundingRect;
+        stream.readRawData(reinterpret_cast<char*>(info.hash.data()), int(info.hash.size()));
+        stream.readRawData(reinterpret_cast<char*>(info.imageHash.data()), int(info.imageHash.size()));
+        stream >> info.pagePath;
+        info.type = static_cast<GraphicPieceInfo::Type>(type);
+        result.push_back(qMove(info));
+    }
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        return false;
+    }
+
+    pieces = qMove(result);
+    return true;
+}
+
 PDFDiffResultNavigator::PDFDiffResultNavigator(QObject* parent) :
     QObject(parent),
     m_diffResult(nullptr),
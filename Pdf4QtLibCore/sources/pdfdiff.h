@@ -27,6 +27,8 @@
 #include <QObject>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QMutex>
+#include <QElapsedTimer>
 
 #include <atomic>
 
@@ -36,6 +38,10 @@ class QXmlStreamWriter;
 namespace pdf
 {
 
+class PDFCMS;
+class PDFFontCache;
+class PDFDiskCache;
+class PDFOptionalContentActivity;
 struct PDFDiffPageContext;
 
 class PDF4QTLIBCORESHARED_EXPORT PDFDiffResult
@@ -60,6 +66,7 @@ public:
         TextReplaced                    = 0x0800,
         TextAdded                       = 0x1000,
         TextRemoved                     = 0x2000,
+        GraphicsReplaced                = 0x4000,
     };
 
     struct PageSequenceItem
@@ -164,7 +171,7 @@ private:
 
     static constexpr uint32_t FLAGS_PAGE_MOVE = uint32_t(Type::PageMoved) | uint32_t(Type::PageAdded) | uint32_t(Type::PageRemoved);
     static constexpr uint32_t FLAGS_TEXT = uint32_t(Type::RemovedTextCharContent) | uint32_t(Type::AddedTextCharContent) | uint32_t(Type::TextReplaced) | uint32_t(Type::TextAdded) | uint32_t(Type::TextRemoved);
-    static constexpr uint32_t FLAGS_VECTOR_GRAPHICS = uint32_t(Type::RemovedVectorGraphicContent) | uint32_t(Type::AddedVectorGraphicContent);
+    static constexpr uint32_t FLAGS_VECTOR_GRAPHICS = uint32_t(Type::RemovedVectorGraphicContent) | uint32_t(Type::AddedVectorGraphicContent) | uint32_t(Type::GraphicsReplaced);
     static constexpr uint32_t FLAGS_IMAGE = uint32_t(Type::RemovedImageContent) | uint32_t(Type::AddedImageContent);
     static constexpr uint32_t FLAGS_SHADING = uint32_t(Type::RemovedShadingContent) | uint32_t(Type::AddedShadingContent);
 
@@ -172,7 +179,7 @@ private:
     static constexpr uint32_t FLAGS_TYPE_PAGE_MOVE_ADD_REMOVE = uint32_t(Type::PageMoved) | uint32_t(Type::PageAdded) | uint32_t(Type::PageRemoved);
     static constexpr uint32_t FLAGS_TYPE_ADD = uint32_t(Type::PageAdded) | uint32_t(Type::AddedTextCharContent) | uint32_t(Type::AddedVectorGraphicContent) | uint32_t(Type::AddedImageContent) | uint32_t(Type::AddedShadingContent) | uint32_t(Type::TextAdded);
     static constexpr uint32_t FLAGS_TYPE_REMOVE = uint32_t(Type::PageRemoved) | uint32_t(Type::RemovedTextCharContent) | uint32_t(Type::RemovedVectorGraphicContent) | uint32_t(Type::RemovedImageContent) | uint32_t(Type::RemovedShadingContent) | uint32_t(Type::TextRemoved);
-    static constexpr uint32_t FLAGS_TYPE_REPLACE = uint32_t(Type::TextReplaced);
+    static constexpr uint32_t FLAGS_TYPE_REPLACE = uint32_t(Type::TextReplaced) | uint32_t(Type::GraphicsReplaced);
 
     void addPageMoved(PDFInteger pageIndex1, PDFInteger pageIndex2);
     void addPageAdded(PDFInteger pageIndex);
@@ -197,6 +204,8 @@ private:
                          const RectInfos& rectInfos1,
                          const RectInfos& rectInfos2);
 
+    void addGraphicsReplaced(PDFInteger pageIndex1, PDFInteger pageIndex2, QRectF rect1, QRectF rect2);
+
     void saveToStream(QXmlStreamWriter* stream) const;
 
     void finalize();
@@ -304,6 +313,7 @@ public:
         PC_Mesh                 = 0x0010,   ///< Use mesh to compare pages (determine, which pages correspond to each other)
         CompareTextsAsVector    = 0x0020,   ///< Compare texts as vector graphics
         CompareWords            = 0x0040,   ///< Compare words, not just characters
+        RasterCompare           = 0x0080,   ///< Compare graphics of replaced pages pixel by pixel, using rendered page images
     };
     Q_DECLARE_FLAGS(Options, Option)
 
@@ -332,6 +342,13 @@ public:
     /// \param enable Enable or disable option?
     void setOption(Option option, bool enable) { m_options.setFlag(option, enable); }
 
+    /// Returns resolution of page images used in raster compare mode [DPI]
+    PDFReal getRasterResolution() const { return m_rasterResolution; }
+
+    /// Sets resolution of page images used in raster compare mode (option \p RasterCompare)
+    /// \param rasterResolution Resolution [DPI]
+    void setRasterResolution(PDFReal rasterResolution) { m_rasterResolution = rasterResolution; }
+
     /// Starts comparator engine. If asynchronous engine option
     /// is enabled, then separate thread is started, in which two
     /// document is compared, and then signal \p comparationFinished,
@@ -345,12 +362,35 @@ public:
     /// Returns result of a comparation process
     const PDFDiffResult& getResult() const { return m_result; }
 
+    /// Returns partial result of running comparation process (asynchronous mode
+    /// only). Differences are added to the partial result as they are found,
+    /// signal \p partialResultAvailable is emitted when it is updated.
+    /// Function is thread safe.
+    PDFDiffResult getPartialResult() const;
+
+    /// Sets pages, which should be compared first (for example, pages
+    /// displayed to the user), so their differences are available early
+    /// in the partial result.
+    /// \param leftPages Page indices of the left document
+    /// \param rightPages Page indices of the right document
+    void setPriorityPages(std::vector<PDFInteger> leftPages, std::vector<PDFInteger> rightPages);
+
     PDFDocumentTextFlowFactory::Algorithm getTextAnalysisAlgorithm() const;
     void setTextAnalysisAlgorithm(PDFDocumentTextFlowFactory::Algorithm textAnalysisAlgorithm);
 
+    /// Sets disk cache, in which prepared page contents (graphic pieces and text
+    /// layouts) are stored. Items are keyed by the canonical hash of the page
+    /// content, so identical pages (also in different documents) are prepared
+    /// only once. Cache must outlive the comparation process.
+    /// \param diskCache Disk cache (can be nullptr, then cache isn't used)
+    void setDiskCache(PDFDiskCache* diskCache) { m_diskCache = diskCache; }
+
 signals:
     void comparationFinished();
 
+    /// Emitted from the worker thread, when partial result was updated
+    void partialResultAvailable();
+
 private:
 
     enum Steps
@@ -373,13 +413,50 @@ private:
                              const std::vector<PDFDiffPageContext>& rightPreparedPages,
                              PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
                              std::map<size_t, size_t>& pageMatches);
-    void performCompare(const std::vector<PDFDiffPageContext>& leftPreparedPages,
-                        const std::vector<PDFDiffPageContext>& rightPreparedPages,
-                        PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
-                        const std::map<size_t, size_t>& pageMatches,
-                        PDFDiffResult& result);
+
+    /// Adds page movements, added/removed pages and graphics
+    /// differences of replaced pages to the result.
+    void performCompareGraphics(const std::vector<PDFDiffPageContext>& leftPreparedPages,
+                                const std::vector<PDFDiffPageContext>& rightPreparedPages,
+                                PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
+                                const std::map<size_t, size_t>& pageMatches,
+                                PDFDiffResult& result);
+
+    /// Renders page pairs and adds differing regions of page images
+    /// to the result (used in raster compare mode).
+    /// \param pagePairs Pairs of left and right page indices
+    /// \param result Result
+    void performRasterCompare(const std::vector<std::pair<PDFInteger, PDFInteger>>& pagePairs,
+                              PDFDiffResult& result);
+
+    /// Adds text differences of replaced pages to the result and finalizes it.
+    /// Text differences containing priority pages are compared first.
+    void performCompareTexts(const std::vector<PDFDiffPageContext>& leftPreparedPages,
+                             const std::vector<PDFDiffPageContext>& rightPreparedPages,
+                             PDFAlgorithmLongestCommonSubsequenceBase::Sequence& pageSequence,
+                             PDFDiffResult& result);
+
+    /// Stores copy of the result as partial result and emits signal \p partialResultAvailable.
+    /// Partial result is not updated more often, than once per \p PARTIAL_RESULT_INTERVAL,
+    /// unless \p force is true. Result must not be modified during this call.
+    /// \param result Result
+    /// \param force Update partial result immediately
+    void publishPartialResult(const PDFDiffResult& result, bool force);
     void finalizeGraphicsPieces(PDFDiffPageContext& context);
 
+    /// Calculates graphic pieces of the page (not finalized). If disk cache
+    /// is set, graphic pieces are read from the cache, if possible.
+    /// \param context Page context
+    /// \param document Document
+    /// \param fontCache Font cache
+    /// \param cms Color management system
+    /// \param optionalContentActivity Optional content activity
+    void calculateGraphicsPieces(PDFDiffPageContext& context,
+                                 const PDFDocument* document,
+                                 const PDFFontCache* fontCache,
+                                 const PDFCMS* cms,
+                                 const PDFOptionalContentActivity* optionalContentActivity) const;
+
     void onComparationPerformed();
 
     /// Calculates real epsilon for a page. Epsilon is used in page
@@ -395,9 +472,21 @@ private:
     PDFClosedIntervalSet m_pagesForRightDocument;
     Options m_options;
     PDFReal m_epsilon;
+    PDFReal m_rasterResolution;
     std::atomic_bool m_cancelled;
     PDFDiffResult m_result;
     PDFDocumentTextFlowFactory::Algorithm m_textAnalysisAlgorithm;
+    PDFDiskCache* m_diskCache;
+
+    /// Minimal interval between partial result updates [msec]
+    static constexpr qint64 PARTIAL_RESULT_INTERVAL = 250;
+
+    std::vector<PDFInteger> m_priorityLeftPages;
+    std::vector<PDFInteger> m_priorityRightPages;
+
+    mutable QMutex m_partialResultMutex;
+    PDFDiffResult m_partialResult;
+    QElapsedTimer m_partialResultTimer;
 
     QFuture<PDFDiffResult> m_future;
     std::optional<QFutureWatcher<PDFDiffResult>> m_futureWatcher;
@@ -0,0 +1,206 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfdiskcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFDiskCache::PDFDiskCache(QString directory, qint64 sizeLimit) :
+    m_directory(qMove(directory)),
+    m_sizeLimit(sizeLimit)
+{
+    QDir().mkpath(m_directory);
+}
+
+QString PDFDiskCache::getDefaultDirectory()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("pdf4qt");
+}
+
+QByteArray PDFDiskCache::createKey(const QByteArray& documentHash, const char* type, PDFInteger pageIndex, const QByteArray& parameters)
+{
+    QByteArray key;
+
+    {
+        QDataStream stream(&key, QIODevice::WriteOnly);
+        stream << documentHash;
+        stream << QByteArray(type);
+        stream << pageIndex;
+        stream << parameters;
+    }
+
+    return key;
+}
+
+QByteArray PDFDiskCache::createPageKey(const QByteArray& pageContentHash, const char* type, const QByteArray& parameters)
+{
+    QByteArray key;
+
+    {
+        QDataStream stream(&key, QIODevice::WriteOnly);
+        stream << QByteArray("page-content");
+        stream << pageContentHash;
+        stream << QByteArray(type);
+        stream << parameters;
+    }
+
+    return key;
+}
+
+QByteArray PDFDiskCache::read(const QByteArray& key) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    QFile file(getFileName(key));
+    if (!file.open(QFile::ReadOnly))
+    {
+        return QByteArray();
+    }
+
+    // Full key is stored in the file, so hash collisions are detected
+    QByteArray storedKey;
+    QByteArray data;
+
+    QDataStream stream(&file);
+    stream >> storedKey;
+    stream >> data;
+
+    if (stream.status() != QDataStream::Ok || storedKey != key)
+    {
+        return QByteArray();
+    }
+
+    // Mark item as recently used
+    file.close();
+    if (file.open(QFile::ReadWrite))
+    {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+
+    return data;
+}
+
+void PDFDiskCache::write(const QByteArray& key, const QByteArray& data)
+{
+    QMutexLocker lock(&m_mutex);
+
+    const QString fileName = getFileName(key);
+    const qint64 oldSize = QFileInfo(fileName).exists() ? QFileInfo(fileName).size() : 0;
+
+    // Write the file atomically, so other processes reading
+    // the cache never see partially written item.
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly))
+    {
+        return;
+    }
+
+    {
+        QDataStream stream(&file);
+        stream << key;
+        stream << data;
+    }
+
+    if (!file.commit())
+    {
+        return;
+    }
+
+    if (m_size >= 0)
+    {
+        m_size += QFileInfo(fileName).size() - oldSize;
+    }
+
+    trim();
+}
+
+void PDFDiskCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+
+    QDir directory(m_directory);
+    const QStringList fileNames = directory.entryList({ QString("*%1").arg(FILE_SUFFIX) }, QDir::Files);
+    for (const QString& fileName : fileNames)
+    {
+        directory.remove(fileName);
+    }
+
+    m_size = 0;
+}
+
+QString PDFDiskCache::getFileName(const QByteArray& key) const
+{
+    QByteArray hash = QCryptographicHash::hash(key, QCryptographicHash::Sha256).toHex();
+    return QDir(m_directory).filePath(QString::fromLatin1(hash) + FILE_SUFFIX);
+}
+
+void PDFDiskCache::trim()
+{
+    QDir directory(m_directory);
+
+    if (m_size < 0)
+    {
+        m_size = 0;
+        const QFileInfoList fileInfos = directory.entryInfoList({ QString("*%1").arg(FILE_SUFFIX) }, QDir::Files);
+        for (const QFileInfo& fileInfo : fileInfos)
+        {
+            m_size += fileInfo.size();
+        }
+    }
+
+    if (m_size <= m_sizeLimit)
+    {
+        return;
+    }
+
+    // Remove least recently used items, until the cache is reduced to 90 % of
+    // the limit, so trimming isn't performed after each write.
+    const qint64 targetSize = m_sizeLimit / 10 * 9;
+    QFileInfoList fileInfos = directory.entryInfoList({ QString("*%1").arg(FILE_SUFFIX) }, QDir::Files, QDir::Time | QDir::Reversed);
+
+    m_size = 0;
+    for (const QFileInfo& fileInfo : fileInfos)
+    {
+        m_size += fileInfo.size();
+    }
+
+    for (const QFileInfo& fileInfo : fileInfos)
+    {
+        if (m_size <= targetSize)
+        {
+            break;
+        }
+
+        if (QFile::remove(fileInfo.filePath()))
+        {
+            m_size -= fileInfo.size();
+        }
+    }
+}
+
+}   // namespace pdf
@@ -0,0 +1,99 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFDISKCACHE_H
+#define PDFDISKCACHE_H
+
+#include "pdfglobal.h"
+
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+
+namespace pdf
+{
+
+/// Persistent cache of data items stored as files in the cache directory.
+/// Each item is identified by a key, file name is created from the hash
+/// of the key. When total size of the cache exceeds the limit, least recently
+/// used items are removed. Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFDiskCache
+{
+public:
+    /// Creates disk cache in the given directory
+    /// \param directory Cache directory (it is created, if it doesn't exist)
+    /// \param sizeLimit Size limit of the cache [bytes]
+    explicit PDFDiskCache(QString directory, qint64 sizeLimit);
+
+    /// Returns default cache directory
+    static QString getDefaultDirectory();
+
+    /// Creates key of the item. Key is composed of the document hash, item
+    /// type, page index and parameters, which affect the item (for example,
+    /// rendering settings).
+    /// \param documentHash Hash of the document data
+    /// \param type Item type
+    /// \param pageIndex Page index
+    /// \param parameters Parameters affecting the item
+    static QByteArray createKey(const QByteArray& documentHash, const char* type, PDFInteger pageIndex, const QByteArray& parameters);
+
+    /// Creates key of the page item, which doesn't depend on the document,
+    /// so it can be shared by identical pages in different documents.
+    /// \param pageContentHash Canonical hash of the page (see PDFPageContentHash)
+    /// \param type Item type
+    /// \param parameters Parameters affecting the item
+    static QByteArray createPageKey(const QByteArray& pageContentHash, const char* type, const QByteArray& parameters);
+
+    /// Reads item with given key. If item is not found, or it can't
+    /// be read, then empty byte array is returned.
+    /// \param key Key of the item
+    QByteArray read(const QByteArray& key) const;
+
+    /// Writes item with given key to the cache. If item already
+    /// exists, it is replaced.
+    /// \param key Key of the item
+    /// \param data Item data
+    void write(const QByteArray& key, const QByteArray& data);
+
+    /// Removes all items from the cache
+    void clear();
+
+    const QString& getDirectory() const { return m_directory; }
+    qint64 getSizeLimit() const { return m_sizeLimit; }
+
+private:
+    /// Returns name of the file of the item with given key
+    QString getFileName(const QByteArray& key) const;
+
+    /// Removes least recently used items, so cache size fits
+    /// into the size limit. Mutex must be locked.
+    void trim();
+
+    static constexpr const char* FILE_SUFFIX = ".pdfcache";
+
+    QString m_directory;
+    qint64 m_sizeLimit;
+
+    mutable QMutex m_mutex;
+
+    /// Total size of the cache items, -1, if it was not determined yet
+    qint64 m_size = -1;
+};
+
+}   // namespace pdf
+
+#endif // PDFDISKCACHE_H
@@ -19,6 +19,9 @@
 #include "pdfdocument.h"
 #include "pdfencoding.h"
 #include "pdfexception.h"
+#include "pdfimage.h"
+#include "pdfpattern.h"
+#include "pdfpagecontentprocessor.h"
 #include "pdfstreamfilters.h"
 #include "pdfconstants.h"
 #include "pdfdbgheap.h"
@@ -28,14 +31,266 @@ namespace pdf
 
 static constexpr const char* PDF_DOCUMENT_INFO_ENTRY = "Info";
 
+PDFDecodedStreamCache::PDFDecodedStreamCache(const PDFDecodedStreamCache& other)
+{
+    *this = other;
+}
+
+PDFDecodedStreamCache& PDFDecodedStreamCache::operator=(const PDFDecodedStreamCache& other)
+{
+    if (this != &other)
+    {
+        // Storage is copied often (for example, when document is modified),
+        // so only settings are copied. Copy starts with empty cache, index
+        // of streams is rebuilt and streams are decoded again on demand.
+        const qint64 sizeLimit = other.getStatistics().sizeLimit;
+
+        QMutexLocker lock(&m_mutex);
+        m_items.clear();
+        m_itemMap.clear();
+        m_index.clear();
+        m_indexBuilt = false;
+        m_size = 0;
+        m_sizeLimit = sizeLimit;
+    }
+
+    return *this;
+}
+
+PDFDecodedStreamCache::Statistics PDFDecodedStreamCache::getStatistics() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    Statistics statistics;
+    statistics.hitCount = m_hitCount;
+    statistics.missCount = m_missCount;
+    statistics.itemCount = static_cast<qint64>(m_items.size());
+    statistics.size = m_size;
+    statistics.sizeLimit = m_sizeLimit;
+    return statistics;
+}
+
+void PDFDecodedStreamCache::setSizeLimit(qint64 sizeLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_sizeLimit = qMax(sizeLimit, qint64(0));
+    shrink();
+}
+
+bool PDFDecodedStreamCache::isIndexBuilt() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_indexBuilt;
+}
+
+void PDFDecodedStreamCache::setIndex(const std::unordered_map<const PDFStream*, PDFObjectReference>& index)
+{
+    QMutexLocker lock(&m_mutex);
+    m_index.insert(index.cbegin(), index.cend());
+    m_indexBuilt = true;
+}
+
+void PDFDecodedStreamCache::addStream(const PDFStream* stream, PDFObjectReference reference)
+{
+    QMutexLocker lock(&m_mutex);
+    m_index[stream] = reference;
+}
+
+void PDFDecodedStreamCache::removeStream(const PDFStream* stream)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto indexIt = m_index.find(stream);
+    if (indexIt != m_index.end())
+    {
+        auto itemIt = m_itemMap.find(indexIt->second);
+        if (itemIt != m_itemMap.end() && itemIt->second->stream == stream)
+        {
+            removeItem(itemIt->second);
+        }
+
+        m_index.erase(indexIt);
+    }
+}
+
+PDFObjectReference PDFDecodedStreamCache::getReference(const PDFStream* stream) const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_index.find(stream);
+    if (it != m_index.cend())
+    {
+        return it->second;
+    }
+
+    return PDFObjectReference();
+}
+
+bool PDFDecodedStreamCache::find(PDFObjectReference reference, const PDFStream* stream, QByteArray& data)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_itemMap.find(reference);
+    if (it != m_itemMap.end())
+    {
+        if (it->second->stream == stream)
+        {
+            // Move the item to the front, it is the most recently used item now
+            m_items.splice(m_items.begin(), m_items, it->second);
+            data = it->second->data;
+            ++m_hitCount;
+            return true;
+        }
+
+        // Object was replaced by another stream, decoded data are obsolete
+        removeItem(it->second);
+    }
+
+    ++m_missCount;
+    return false;
+}
+
+void PDFDecodedStreamCache::insert(PDFObjectReference reference, const PDFStream* stream, QByteArray data)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (data.size() > m_sizeLimit)
+    {
+        return;
+    }
+
+    auto it = m_itemMap.find(reference);
+    if (it != m_itemMap.end())
+    {
+        // Other thread was faster and decoded the stream too
+        removeItem(it->second);
+    }
+
+    m_size += data.size();
+    m_items.push_front(Item{ reference, stream, qMove(data) });
+    m_itemMap[reference] = m_items.begin();
+    shrink();
+}
+
+void PDFDecodedStreamCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_size = 0;
+    m_indexBuilt = false;
+    m_items.clear();
+    m_itemMap.clear();
+    m_index.clear();
+}
+
+void PDFDecodedStreamCache::removeItem(Items::iterator it)
+{
+    m_size -= it->data.size();
+    m_itemMap.erase(it->reference);
+    m_items.erase(it);
+}
+
+void PDFDecodedStreamCache::shrink()
+{
+    while (m_size > m_sizeLimit && !m_items.empty())
+    {
+        removeItem(std::prev(m_items.end()));
+    }
+}
+
 QByteArray PDFObjectStorage::getDecodedStream(const PDFStream* stream) const
 {
-    return PDFStreamFilterStorage::getDecodedStream(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), this, std::placeholders::_1), getSecurityHandler());
+    const PDFObjectReference reference = getStreamReference(stream);
+
+    QByteArray decodedStream;
+    if (reference.isValid() && m_decodedStreamCache.find(reference, stream, decodedStream))
+    {
+        return decodedStream;
+    }
+
+    decodedStream = PDFStreamFilterStorage::getDecodedStream(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), this, std::placeholders::_1), getSecurityHandler());
+
+    if (reference.isValid())
+    {
+        m_decodedStreamCache.insert(reference, stream, decodedStream);
+    }
+
+    return decodedStream;
+}
+
+PDFObjectReference PDFObjectStorage::getStreamReference(const PDFStream* stream) const
+{
+    if (!m_decodedStreamCache.isIndexBuilt())
+    {
+        std::unordered_map<const PDFStream*, PDFObjectReference> index;
+        for (size_t i = 0; i < m_objects.size(); ++i)
+        {
+            const Entry& entry = m_objects[i];
+            if (entry.isLoaded() && entry.object.isStream())
+            {
+                index[entry.object.getStream()] = PDFObjectReference(static_cast<PDFInteger>(i), entry.generation);
+            }
+        }
+        m_decodedStreamCache.setIndex(index);
+    }
+
+    const PDFObjectReference reference = m_decodedStreamCache.getReference(stream);
+    if (!reference.isValid())
+    {
+        return PDFObjectReference();
+    }
+
+    // Objects can be modified directly (see getObjects), so we must check, that
+    // the stream is still stored in this storage. If it is, then stream is kept
+    // alive by the storage and it can't be confused with another stream.
+    if (reference.objectNumber < static_cast<PDFInteger>(m_objects.size()))
+    {
+        const Entry& entry = m_objects[reference.objectNumber];
+        if (entry.generation == reference.generation && entry.isLoaded() && entry.object.isStream() && entry.object.getStream() == stream)
+        {
+            return reference;
+        }
+    }
+
+    m_decodedStreamCache.removeStream(stream);
+    return PDFObjectReference();
+}
+
+static quint64 createDocumentId()
+{
+    static std::atomic<quint64> lastId = 0;
+    return ++lastId;
+}
+
+PDFDocumentId::PDFDocumentId() :
+    m_id(createDocumentId())
+{
+
+}
+
+PDFDocumentId::PDFDocumentId(const PDFDocumentId&) :
+    m_id(createDocumentId())
+{
+
+}
+
+PDFDocumentId::~PDFDocumentId()
+{
+    release(m_id);
 }
 
-PDFDocument::~PDFDocument()
+PDFDocumentId& PDFDocumentId::operator=(const PDFDocumentId&)
 {
+    // Content of the document is replaced, so cached items are no longer valid
+    release(m_id);
+    m_id = createDocumentId();
+    return *this;
+}
 
+void PDFDocumentId::release(quint64 id)
+{
+    PDFImageCache::getInstance()->removeDocument(id);
+    PDFMeshCache::getInstance()->removeDocument(id);
+    PDFContentStreamCache::getInstance()->removeDocument(id);
 }
 
 bool PDFDocument::operator==(const PDFDocument& other) const
@@ -125,6 +380,9 @@ void PDFDocument::initInfo()
 bool PDFObjectStorage::operator==(const PDFObjectStorage& other) const
 {
     // We compare just content. Security handler just defines encryption behavior.
+    loadAllObjects();
+    other.loadAllObjects();
+
     return m_objects == other.m_objects &&
            m_trailerDictionary == other.m_trailerDictionary;
 }
@@ -135,7 +393,14 @@ const PDFObject& PDFObjectStorage::getObject(PDFObjectReference reference) const
         reference.objectNumber < static_cast<PDFInteger>(m_objects.size()) &&
         m_objects[reference.objectNumber].generation == reference.generation)
     {
-        return m_objects[reference.objectNumber].object;
+        const Entry& entry = m_objects[reference.objectNumber];
+
+        if (!entry.isLoaded())
+        {
+            loadEntry(reference.objectNumber);
+        }
+
+        return entry.object;
     }
     else
     {
@@ -144,16 +409,296 @@ const PDFObject& PDFObjectStorage::getObject(PDFObjectReference reference) const
     }
 }
 
+void PDFObjectStorage::loadAllObjects() const
+{
+    if (!m_loader)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < m_objects.size(); ++i)
+    {
+        if (!m_objects[i].isLoaded())
+        {
+            loadEntry(i);
+        }
+    }
+}
+
+std::vector<PDFObjectReference> PDFObjectStorage::getObjectReferences() const
+{
+    std::vector<PDFObjectReference> references;
+    references.reserve(m_objects.size());
+
+    for (size_t i = 0; i < m_objects.size(); ++i)
+    {
+        const Entry& entry = m_objects[i];
+        if (!entry.isLoaded() || !entry.object.isNull())
+        {
+            references.emplace_back(static_cast<PDFInteger>(i), entry.generation);
+        }
+    }
+
+    return references;
+}
+
+std::vector<PDFObjectReference> PDFObjectStorage::getChangedObjects(const PDFObjectStorage& other) const
+{
+    std::vector<PDFObjectReference> references;
+
+    const size_t count = qMax(m_objects.size(), other.m_objects.size());
+    size_t i = 0;
+    while (i < count)
+    {
+        if (m_objects.isSharedWith(other.m_objects, i))
+        {
+            // Whole chunk is shared, so objects are the same
+            i = (i / PDFObjects::CHUNK_SIZE + 1) * PDFObjects::CHUNK_SIZE;
+            continue;
+        }
+
+        const PDFInteger objectNumber = static_cast<PDFInteger>(i);
+        if (i >= m_objects.size() || i >= other.m_objects.size())
+        {
+            // Object was added or removed
+            const Entry& entry = i < m_objects.size() ? m_objects[i] : other.m_objects[i];
+            if (!entry.isLoaded() || !entry.object.isNull())
+            {
+                references.emplace_back(objectNumber, entry.generation);
+            }
+        }
+        else
+        {
+            const Entry& entry = m_objects[i];
+            const Entry& otherEntry = other.m_objects[i];
+
+            if (entry.generation != otherEntry.generation)
+            {
+                references.emplace_back(objectNumber, entry.generation);
+            }
+            else if (entry.isLoaded() || otherEntry.isLoaded())
+            {
+                // Entry, which is not loaded, is loaded from the same source as the
+                // other entry was loaded, so we must compare objects only, if at
+                // least one entry is loaded.
+                const PDFObjectReference reference(objectNumber, entry.generation);
+                if (getObject(reference) != other.getObject(reference))
+                {
+                    references.push_back(reference);
+                }
+            }
+        }
+
+        ++i;
+    }
+
+    return references;
+}
+
+PDFObjectStorage::PDFObjects& PDFObjectStorage::getObjects()
+{
+    loadAllObjects();
+    m_decodedStreamCache.clear();
+
+    // Objects can be modified through returned array, without us knowing. So we
+    // keep objects as they are now, and modified objects are found by comparison.
+    // Arrays share chunks, so objects are not copied, until they are modified.
+    if (!m_allObjectsModified && !m_unmodifiedObjects)
+    {
+        m_unmodifiedObjects = m_objects;
+    }
+
+    return m_objects;
+}
+
+bool PDFObjectStorage::isObjectModified(PDFInteger objectNumber) const
+{
+    return m_allObjectsModified ||
+           m_modifiedObjects.count(objectNumber) ||
+           (objectNumber >= 0 && isEntryChanged(static_cast<size_t>(objectNumber)));
+}
+
+std::vector<PDFObjectReference> PDFObjectStorage::getModifiedObjects() const
+{
+    std::vector<PDFObjectReference> references;
+
+    if (m_allObjectsModified)
+    {
+        references.reserve(m_objects.size());
+        for (size_t i = 0; i < m_objects.size(); ++i)
+        {
+            references.emplace_back(static_cast<PDFInteger>(i), m_objects[i].generation);
+        }
+
+        return references;
+    }
+
+    std::set<PDFInteger> objectNumbers = m_modifiedObjects;
+    if (m_unmodifiedObjects)
+    {
+        size_t i = 0;
+        while (i < m_objects.size())
+        {
+            if (m_objects.isSharedWith(*m_unmodifiedObjects, i))
+            {
+                // Whole chunk is shared, so objects are not modified
+                i = (i / PDFObjects::CHUNK_SIZE + 1) * PDFObjects::CHUNK_SIZE;
+                continue;
+            }
+
+            if (isEntryChanged(i))
+            {
+                objectNumbers.insert(static_cast<PDFInteger>(i));
+            }
+
+            ++i;
+        }
+    }
+
+    references.reserve(objectNumbers.size());
+    for (const PDFInteger objectNumber : objectNumbers)
+    {
+        if (objectNumber >= 0 && objectNumber < static_cast<PDFInteger>(m_objects.size()))
+        {
+            references.emplace_back(objectNumber, m_objects[objectNumber].generation);
+        }
+    }
+
+    return references;
+}
+
+bool PDFObjectStorage::isEntryChanged(size_t objectNumber) const
+{
+    if (!m_unmodifiedObjects || objectNumber >= m_objects.size() || m_objects.isSharedWith(*m_unmodifiedObjects, objectNumber))
+    {
+        return false;
+    }
+
+    if (objectNumber >= m_unmodifiedObjects->size())
+    {
+        // Object was added
+        return true;
+    }
+
+    const Entry& entry = m_objects[objectNumber];
+    const Entry& unmodifiedEntry = (*m_unmodifiedObjects)[objectNumber];
+
+    // All objects were loaded, when unmodified objects were stored. Entry, which
+    // is not loaded, was released, so it contains unmodified object.
+    return entry.generation != unmodifiedEntry.generation ||
+           (entry.isLoaded() && unmodifiedEntry.isLoaded() && entry.object != unmodifiedEntry.object);
+}
+
+QByteArray PDFObjectStorage::getUnmodifiedObjectData(PDFObjectReference reference) const
+{
+    if (!m_objectSource ||
+        reference.objectNumber < 0 ||
+        reference.objectNumber >= static_cast<PDFInteger>(m_objects.size()) ||
+        m_objects[reference.objectNumber].generation != reference.generation ||
+        isObjectModified(reference.objectNumber))
+    {
+        return QByteArray();
+    }
+
+    return m_objectSource->getObjectData(reference);
+}
+
+void PDFObjectStorage::releaseObject(PDFObjectReference reference)
+{
+    if (!m_loader ||
+        reference.objectNumber < 0 ||
+        reference.objectNumber >= static_cast<PDFInteger>(m_objects.size()) ||
+        m_objects[reference.objectNumber].generation != reference.generation ||
+        m_objects.isShared(reference.objectNumber) ||
+        isObjectModified(reference.objectNumber))
+    {
+        // Object shared with other storage can't be released, because it can be
+        // used by the other storage.
+        return;
+    }
+
+    Entry& entry = m_objects.getSharedItem(reference.objectNumber);
+
+    QMutexLocker lock(m_loader->getMutex());
+    if (entry.isLoaded())
+    {
+        if (entry.object.isStream())
+        {
+            m_decodedStreamCache.removeStream(entry.object.getStream());
+        }
+
+        entry.loaded.store(false, std::memory_order_release);
+        entry.object = PDFObject();
+    }
+}
+
+void PDFObjectStorage::loadEntry(size_t objectNumber) const
+{
+    Entry& entry = m_objects.getSharedItem(objectNumber);
+
+    if (!m_loader)
+    {
+        // We have nothing to load the object with, so treat it as null object
+        entry.loaded.store(true, std::memory_order_release);
+        return;
+    }
+
+    // Object is parsed outside of the lock, so more objects can be loaded in parallel.
+    // If some other thread was faster, then we simply discard our result.
+    PDFObject object = m_loader->loadObject(PDFObjectReference(static_cast<PDFInteger>(objectNumber), entry.generation));
+
+    QMutexLocker lock(m_loader->getMutex());
+    if (!entry.isLoaded())
+    {
+        entry.object = qMove(object);
+        entry.loaded.store(true, std::memory_order_release);
+
+        if (entry.object.isStream())
+        {
+            m_decodedStreamCache.addStream(entry.object.getStream(), PDFObjectReference(static_cast<PDFInteger>(objectNumber), entry.generation));
+        }
+    }
+}
+
 PDFObjectReference PDFObjectStorage::addObject(PDFObject object)
 {
     PDFObjectReference reference(m_objects.size(), 0);
     m_objects.emplace_back(0, qMove(object));
+
+    const PDFObject& addedObject = m_objects.back().object;
+    if (addedObject.isStream())
+    {
+        m_decodedStreamCache.addStream(addedObject.getStream(), reference);
+    }
+
+    if (!m_allObjectsModified)
+    {
+        m_modifiedObjects.insert(reference.objectNumber);
+    }
+
     return reference;
 }
 
 void PDFObjectStorage::setObject(PDFObjectReference reference, PDFObject object)
 {
+    const Entry& oldEntry = m_objects[reference.objectNumber];
+    if (oldEntry.isLoaded() && oldEntry.object.isStream())
+    {
+        m_decodedStreamCache.removeStream(oldEntry.object.getStream());
+    }
+
     m_objects[reference.objectNumber] = Entry(reference.generation, qMove(object));
+
+    const PDFObject& newObject = m_objects[reference.objectNumber].object;
+    if (newObject.isStream())
+    {
+        m_decodedStreamCache.addStream(newObject.getStream(), reference);
+    }
+
+    if (!m_allObjectsModified)
+    {
+        m_modifiedObjects.insert(reference.objectNumber);
+    }
 }
 
 void PDFObjectStorage::updateTrailerDictionary(PDFObject trailerDictionary)
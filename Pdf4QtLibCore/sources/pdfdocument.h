@@ -22,20 +22,178 @@
 #include "pdfobject.h"
 #include "pdfcatalog.h"
 #include "pdfsecurityhandler.h"
+#include "pdfutils.h"
 
 #include <QColor>
+#include <QMutex>
 #include <QTransform>
 #include <QDateTime>
 
+#include <map>
+#include <list>
+#include <atomic>
+#include <memory>
 #include <optional>
+#include <set>
+#include <unordered_map>
 
 namespace pdf
 {
 class PDFDocument;
 class PDFDocumentBuilder;
 
+/// Loader of objects on demand. Object storage can contain entries, which are
+/// not loaded yet. Such entries are loaded using the loader, when they are
+/// accessed for the first time. Loader is shared between copies of object storage,
+/// so implementation must be thread safe and must not modify its source data.
+class PDF4QTLIBCORESHARED_EXPORT PDFObjectStorageLoader
+{
+public:
+    explicit PDFObjectStorageLoader() = default;
+    virtual ~PDFObjectStorageLoader() = default;
+
+    /// Loads object with given reference. If object cannot be loaded,
+    /// then null object is returned (no exception is thrown).
+    /// \param reference Reference to the object
+    virtual PDFObject loadObject(PDFObjectReference reference) const = 0;
+
+    /// Returns mutex used to guard population of entries in object storage
+    QMutex* getMutex() const { return &m_mutex; }
+
+private:
+    mutable QMutex m_mutex;
+};
+
+using PDFObjectStorageLoaderPointer = std::shared_ptr<const PDFObjectStorageLoader>;
+
+/// Original data of objects, which were read from the document. Object, which was
+/// not modified since it was read, can be written using its original data, so it
+/// doesn't need to be serialized again. Data of objects of encrypted document are
+/// encrypted, so they can be written only using the same security handler, with
+/// which they were read. Implementation must be thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFObjectStorageSource
+{
+public:
+    explicit PDFObjectStorageSource() = default;
+    virtual ~PDFObjectStorageSource() = default;
+
+    /// Returns original data of the object, including object header and footer
+    /// (i.e. from the object number to the 'endobj' keyword). If original data
+    /// of the object are not available, then empty byte array is returned.
+    /// \param reference Reference to the object
+    virtual QByteArray getObjectData(PDFObjectReference reference) const = 0;
+};
+
+using PDFObjectStorageSourcePointer = std::shared_ptr<const PDFObjectStorageSource>;
+
+/// Size-bounded cache of decoded stream data, keyed by object reference of the stream.
+/// Least recently used streams are removed, when size limit is exceeded. Cache also
+/// contains index of streams of the object storage (to find reference of the stream),
+/// each cached item also remembers its stream, so it can be validated, that
+/// the object storage still contains the same stream. Copy of the cache is empty,
+/// only size limit is copied, so copying of the object storage is cheap. This class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFDecodedStreamCache
+{
+public:
+    explicit PDFDecodedStreamCache() = default;
+
+    PDFDecodedStreamCache(const PDFDecodedStreamCache& other);
+    PDFDecodedStreamCache& operator=(const PDFDecodedStreamCache& other);
+
+    /// Default size limit of the cache in bytes
+    static constexpr qint64 DEFAULT_SIZE_LIMIT = 64 * 1024 * 1024;
+
+    struct Statistics
+    {
+        qint64 hitCount = 0;
+        qint64 missCount = 0;
+        qint64 itemCount = 0;
+        qint64 size = 0;
+        qint64 sizeLimit = 0;
+    };
+
+    /// Returns statistics of the cache
+    Statistics getStatistics() const;
+
+    /// Sets size limit of the cache in bytes. If limit is zero, then caching
+    /// is disabled. Items exceeding the new limit are removed.
+    /// \param sizeLimit Size limit in bytes
+    void setSizeLimit(qint64 sizeLimit);
+
+    /// Returns true, if index of streams was built
+    bool isIndexBuilt() const;
+
+    /// Sets index of streams (streams added to the index
+    /// before are preserved)
+    /// \param index Index of streams
+    void setIndex(const std::unordered_map<const PDFStream*, PDFObjectReference>& index);
+
+    /// Adds stream to the index of streams
+    /// \param stream Stream
+    /// \param reference Reference of the stream
+    void addStream(const PDFStream* stream, PDFObjectReference reference);
+
+    /// Removes stream from the index, and its decoded data from the cache
+    /// \param stream Stream
+    void removeStream(const PDFStream* stream);
+
+    /// Returns reference of the stream, or invalid reference,
+    /// if stream is not in the index.
+    /// \param stream Stream
+    PDFObjectReference getReference(const PDFStream* stream) const;
+
+    /// Finds decoded data of the stream. Hit or miss is recorded in statistics.
+    /// Returns true, if data were found.
+    /// \param reference Reference of the stream
+    /// \param stream Stream
+    /// \param[out] data Decoded data
+    bool find(PDFObjectReference reference, const PDFStream* stream, QByteArray& data);
+
+    /// Inserts decoded data of the stream into the cache
+    /// \param reference Reference of the stream
+    /// \param stream Stream
+    /// \param data Decoded data
+    void insert(PDFObjectReference reference, const PDFStream* stream, QByteArray data);
+
+    /// Clears the cache and the index of streams (statistics are preserved)
+    void clear();
+
+private:
+    struct Item
+    {
+        PDFObjectReference reference;
+        const PDFStream* stream = nullptr;
+        QByteArray data;
+    };
+
+    using Items = std::list<Item>;
+
+    /// Removes item from the cache, mutex must be locked
+    void removeItem(Items::iterator it);
+
+    /// Removes least recently used items, until size
+    /// limit is satisfied, mutex must be locked
+    void shrink();
+
+    mutable QMutex m_mutex;
+    qint64 m_sizeLimit = DEFAULT_SIZE_LIMIT;
+    qint64 m_size = 0;
+    qint64 m_hitCount = 0;
+    qint64 m_missCount = 0;
+    bool m_indexBuilt = false;
+
+    /// Items ordered from most recently used to least recently used
+    Items m_items;
+    std::map<PDFObjectReference, Items::iterator> m_itemMap;
+    std::unordered_map<const PDFStream*, PDFObjectReference> m_index;
+};
+
 /// Storage for objects. This class is not thread safe for writing (calling non-const functions). Caller must ensure
-/// locking, if this object is used from multiple threads. Calling const functions should be thread safe.
+/// locking, if this object is used from multiple threads. Const functions can be called from multiple threads
+/// at the same time, as long as no thread calls non-const function (for example, setObject or releaseObject)
+/// on this storage. Non-const functions can invalidate references returned by const functions. Storage can
+/// contain entries, which are loaded on demand by the object loader, when they are dereferenced for the first
+/// time. Loading of these entries (including decryption) and the decoded stream cache are synchronized.
 class PDF4QTLIBCORESHARED_EXPORT PDFObjectStorage
 {
 public:
@@ -53,21 +211,55 @@ public:
     struct Entry
     {
         constexpr inline explicit Entry() = default;
-        inline explicit Entry(PDFInteger generation, PDFObject object) : generation(generation), object(std::move(object)) { }
+        inline explicit Entry(PDFInteger generation, PDFObject object) : object(std::move(object)), generation(static_cast<qint32>(generation)) { }
+
+        // Object of entry, which is not loaded, can be concurrently populated by
+        // other thread, so we copy the object only, if entry is already loaded.
+        inline Entry(const Entry& other) : generation(other.generation), loaded(other.loaded.load(std::memory_order_acquire)) { if (loaded) { object = other.object; } }
+        inline Entry(Entry&& other) : generation(other.generation), loaded(other.loaded.load(std::memory_order_acquire)) { if (loaded) { object = std::move(other.object); } }
+
+        inline Entry& operator=(const Entry& other) { if (this != &other) { *this = Entry(other); } return *this; }
+        inline Entry& operator=(Entry&& other) { generation = other.generation; object = other.isLoaded() ? std::move(other.object) : PDFObject(); loaded.store(other.isLoaded(), std::memory_order_release); return *this; }
 
         inline bool operator==(const Entry& other) const { return generation == other.generation && object == other.object; }
         inline bool operator!=(const Entry& other) const { return !(*this == other); }
 
-        PDFInteger generation = 0;
+        /// Creates entry, which is loaded on demand (using object loader) when
+        /// accessed for the first time.
+        static inline Entry createUnloaded(PDFInteger generation) { Entry entry(generation, PDFObject()); entry.loaded = false; return entry; }
+
+        /// Returns true, if object of this entry is loaded
+        inline bool isLoaded() const { return loaded.load(std::memory_order_acquire); }
+
+        // Jakub Melka: Generation number is stored as 32-bit integer (valid generation
+        // numbers are at most 65535) after the object, together with the loaded flag
+        // it fits into one 8 byte slot. There is one entry for each object number,
+        // so this matters for documents with millions of objects.
         PDFObject object;
+        qint32 generation = 0;
+        std::atomic_bool loaded{ true };
     };
 
-    using PDFObjects = std::vector<Entry>;
+    /// Objects are stored in copy-on-write chunked vector, so copies of the storage
+    /// (for example, snapshots of the document used by undo/redo) share chunks
+    /// of objects, which were not modified.
+    using PDFObjects = PDFChunkedVector<Entry>;
 
     explicit PDFObjectStorage(PDFObjects&& objects, PDFObject&& trailerDictionary, PDFSecurityHandlerPointer&& securityHandler) :
         m_objects(std::move(objects)),
         m_trailerDictionary(std::move(trailerDictionary)),
-        m_securityHandler(std::move(securityHandler))
+        m_securityHandler(std::move(securityHandler)),
+        m_allObjectsModified(false)
+    {
+
+    }
+
+    explicit PDFObjectStorage(PDFObjects&& objects, PDFObject&& trailerDictionary, PDFSecurityHandlerPointer&& securityHandler, PDFObjectStorageLoaderPointer loader) :
+        m_objects(std::move(objects)),
+        m_trailerDictionary(std::move(trailerDictionary)),
+        m_securityHandler(std::move(securityHandler)),
+        m_loader(std::move(loader)),
+        m_allObjectsModified(false)
     {
 
     }
@@ -90,14 +282,52 @@ public:
     /// is returned (no exception is thrown).
     const PDFObject& getObjectByReference(PDFObjectReference reference) const;
 
-    /// Returns array of objects stored in this storage
-    const PDFObjects& getObjects() const { return m_objects; }
-
-    /// Returns array of objects stored in this storage
-    PDFObjects& getObjects() { return m_objects; }
-
-    /// Sets array of objects
-    void setObjects(PDFObjects&& objects) { m_objects = qMove(objects); }
+    /// Returns array of objects stored in this storage. Objects, which
+    /// are not loaded yet, are loaded before the array is returned.
+    const PDFObjects& getObjects() const { loadAllObjects(); return m_objects; }
+
+    /// Returns array of objects stored in this storage. Objects, which
+    /// are not loaded yet, are loaded before the array is returned. Objects
+    /// can be modified, so decoded stream cache is cleared. Objects modified
+    /// through returned array are detected by comparison with objects, as they
+    /// were before the first call of this function (see \p isObjectModified).
+    PDFObjects& getObjects();
+
+    /// Returns count of entries (including free entries) of this storage.
+    /// Objects, which are not loaded yet, are not loaded by this function.
+    size_t getObjectCount() const { return m_objects.size(); }
+
+    /// Returns references of all entries, which are not free, i.e. entries,
+    /// which contain non-null object, or which are not loaded yet. Objects,
+    /// which are not loaded yet, are not loaded by this function.
+    std::vector<PDFObjectReference> getObjectReferences() const;
+
+    /// Returns references of objects, which differ from objects of the other storage
+    /// (objects were added, removed or changed). Chunks of entries shared by both
+    /// storages (for example, storage is modified copy of the other storage)
+    /// are skipped, so only objects in modified chunks are compared. Entries,
+    /// which are not loaded in both storages, are considered equal.
+    /// \param other Other storage
+    std::vector<PDFObjectReference> getChangedObjects(const PDFObjectStorage& other) const;
+
+    /// Returns true, if storage has object loader, i.e. some objects
+    /// can be loaded on demand, when accessed for the first time.
+    bool hasObjectLoader() const { return m_loader != nullptr; }
+
+    /// Loads all objects, which are not loaded yet. This function is thread safe.
+    void loadAllObjects() const;
+
+    /// Releases loaded object, so memory occupied by the object is freed. Object
+    /// is loaded again using object loader, when it is accessed. Function has
+    /// effect only, if storage has object loader and object was not modified.
+    /// This function invalidates all references to the object returned by
+    /// the getObject functions (and pointers to its contents, such as dictionaries
+    /// and streams). Object must not be accessed by other threads during the call.
+    /// \param reference Reference to the object
+    void releaseObject(PDFObjectReference reference);
+
+    /// Sets array of objects. All objects are then considered modified.
+    void setObjects(PDFObjects&& objects) { m_objects = qMove(objects); m_decodedStreamCache.clear(); setAllObjectsModified(); }
 
     /// Returns trailer dictionary
     const PDFObject& getTrailerDictionary() const { return m_trailerDictionary; }
@@ -105,8 +335,38 @@ public:
     /// Returns security handler associated with these objects
     const PDFSecurityHandler* getSecurityHandler() const { return m_securityHandler.data(); }
 
-    /// Sets security handler associated with these objects
-    void setSecurityHandler(PDFSecurityHandlerPointer handler) { m_securityHandler = qMove(handler); }
+    /// Sets security handler associated with these objects. All objects
+    /// are then considered modified, because they must be encrypted again.
+    void setSecurityHandler(PDFSecurityHandlerPointer handler) { m_securityHandler = qMove(handler); setAllObjectsModified(); }
+
+    /// Returns true, if object was added or modified since the storage was loaded
+    /// from the document. Objects of storage, which was not loaded from the
+    /// document (for example, new document), are all considered modified.
+    /// \param objectNumber Object number
+    bool isObjectModified(PDFInteger objectNumber) const;
+
+    /// Returns true, if all objects are considered modified (for example,
+    /// objects were replaced using \p setObjects function)
+    bool isAllObjectsModified() const { return m_allObjectsModified; }
+
+    /// Returns references of objects modified since the storage was loaded, sorted
+    /// by object number. If \p isAllObjectsModified returns true, then references
+    /// of all entries are returned. Objects, which are not loaded yet, are not
+    /// loaded by this function.
+    std::vector<PDFObjectReference> getModifiedObjects() const;
+
+    /// Clears information about modified objects, all objects are then considered unmodified.
+    /// Original data of objects are discarded, because they don't correspond to objects anymore.
+    void clearModifiedObjects() { m_modifiedObjects.clear(); m_unmodifiedObjects.reset(); m_allObjectsModified = false; m_objectSource.reset(); }
+
+    /// Sets original data of objects, which were read from the document
+    /// \param objectSource Original data of objects
+    void setObjectSource(PDFObjectStorageSourcePointer objectSource) { m_objectSource = qMove(objectSource); }
+
+    /// Returns original data of the object (see PDFObjectStorageSource), if object was not
+    /// modified since it was read from the document. Otherwise empty byte array is returned.
+    /// \param reference Reference to the object
+    QByteArray getUnmodifiedObjectData(PDFObjectReference reference) const;
 
     /// Adds a new object to the object list. This function
     /// is not thread safe, do not call it from multiple threads.
@@ -126,18 +386,59 @@ public:
     void updateTrailerDictionary(PDFObject trailerDictionary);
 
     /// Returns the decoded stream. If stream data cannot be decoded,
-    /// then empty byte array is returned.
+    /// then empty byte array is returned. Decoded data of streams
+    /// stored in this storage are cached.
     /// \param stream Stream to be decoded
     QByteArray getDecodedStream(const PDFStream* stream) const;
 
+    /// Returns statistics of the decoded stream cache
+    PDFDecodedStreamCache::Statistics getDecodedStreamCacheStatistics() const { return m_decodedStreamCache.getStatistics(); }
+
+    /// Sets size limit of the decoded stream cache in bytes. If limit
+    /// is zero, then decoded streams are not cached.
+    /// \param sizeLimit Size limit in bytes
+    void setDecodedStreamCacheSizeLimit(qint64 sizeLimit) { m_decodedStreamCache.setSizeLimit(sizeLimit); }
+
     /// Set trailer dictionary
     /// \param object Object defining trailer dictionary
     void setTrailerDictionary(const PDFObject& object) { m_trailerDictionary = object; }
 
 private:
+    /// Loads entry with given object number using object loader. Entry
+    /// is populated only once, even if accessed from multiple threads.
+    void loadEntry(size_t objectNumber) const;
+
+    void setAllObjectsModified() { m_modifiedObjects.clear(); m_unmodifiedObjects.reset(); m_allObjectsModified = true; }
+
+    /// Returns true, if entry differs from the entry of unmodified objects
+    /// (i.e. it was modified through array returned by \p getObjects)
+    bool isEntryChanged(size_t objectNumber) const;
+
+    /// Returns reference of the stream, if stream is stored in this storage,
+    /// otherwise invalid reference is returned.
+    PDFObjectReference getStreamReference(const PDFStream* stream) const;
+
+    /// Entries, which are not loaded, are populated on demand using the object
+    /// loader, even in const functions. Entries are populated in place (see
+    /// PDFChunkedVector::getSharedItem), because populated entry has the same value,
+    /// so storages sharing the chunk of entries can share the loaded object too.
     PDFObjects m_objects;
     PDFObject m_trailerDictionary;
     PDFSecurityHandlerPointer m_securityHandler;
+    PDFObjectStorageLoaderPointer m_loader;
+    PDFObjectStorageSourcePointer m_objectSource;
+
+    /// Objects modified since the storage was loaded (used by incremental update)
+    std::set<PDFInteger> m_modifiedObjects;
+
+    /// Objects before the non-const \p getObjects was called for the first time.
+    /// They share unmodified chunks with current objects, so only modified
+    /// chunks are compared, when looking for modified objects.
+    std::optional<PDFObjects> m_unmodifiedObjects;
+    bool m_allObjectsModified = true;
+
+    /// Cache of decoded streams
+    mutable PDFDecodedStreamCache m_decodedStreamCache;
 };
 
 /// Loads data from the object contained in the PDF document, such as integers,
@@ -400,14 +701,39 @@ private:
     const PDFObjectStorage* m_storage;
 };
 
-/// PDF document main class.
+/// Unique identifier of the document in the process. Identifiers are never reused,
+/// new identifier is created, when document is created, copied or assigned to.
+/// Objects of the document can't change during the lifetime of the identifier,
+/// so process-wide caches (for example, cache of decoded images)
+/// use it to identify the document (address of the document can be reused by another
+/// document). When identifier is released, its items are removed from these caches.
+class PDF4QTLIBCORESHARED_EXPORT PDFDocumentId
+{
+public:
+    explicit PDFDocumentId();
+    PDFDocumentId(const PDFDocumentId&);
+    ~PDFDocumentId();
+
+    PDFDocumentId& operator=(const PDFDocumentId&);
+
+    quint64 getId() const { return m_id; }
+
+private:
+    /// Removes items of the identifier from process-wide caches
+    static void release(quint64 id);
+
+    quint64 m_id = 0;
+};
+
+/// PDF document main class. One document can be shared between multiple threads,
+/// which are rendering pages or extracting text (i.e. calling only const functions),
+/// as long as no thread is modifying the document or its storage.
 class PDF4QTLIBCORESHARED_EXPORT PDFDocument
 {
     Q_DECLARE_TR_FUNCTIONS(pdf::PDFDocument)
 
 public:
     explicit PDFDocument() = default;
-    ~PDFDocument();
 
     bool operator==(const PDFDocument& other) const;
     bool operator!=(const PDFDocument& other) const { return !(*this == other); }
@@ -417,6 +743,10 @@ public:
     /// Returns info about the document (title, author, etc.)
     const PDFDocumentInfo* getInfo() const { return &m_info; }
 
+    /// Returns unique identifier of the document in the process. New identifier
+    /// is assigned, when document is copied or assigned to (see PDFDocumentId).
+    quint64 getUniqueId() const { return m_uniqueId.getId(); }
+
     /// Returns document id part with given index. If index is invalid,
     /// then empty id is returned.
     QByteArray getIdPart(size_t index) const;
@@ -474,6 +804,7 @@ private:
     friend class PDFDocumentReader;
     friend class PDFDocumentBuilder;
     friend class PDFOptimizer;
+    friend class PDFStreamingDocumentAssembler;
 
     /// Initialize data based on object in the storage.
     /// Can throw exception if error is detected.
@@ -496,6 +827,10 @@ private:
     /// Hash of the source byte array's data,
     /// from which the document was created.
     QByteArray m_sourceDataHash;
+
+    /// Unique identifier of the document, it is declared last, so items
+    /// of the document are removed from caches before objects are destroyed.
+    PDFDocumentId m_uniqueId;
 };
 
 using PDFDocumentPointer = QSharedPointer<PDFDocument>;
@@ -572,6 +907,38 @@ public:
     bool hasFlag(ModificationFlag flag) const { return m_flags.testFlag(flag); }
     bool hasPreserveView() const { return m_flags.testFlag(PreserveView); }
 
+    /// Returns references of objects changed by the modification. References
+    /// are known only, if modification was performed by document modifier.
+    const std::vector<PDFObjectReference>& getChangedObjects() const { return m_changedObjects; }
+
+    /// Sets references of objects changed by the modification
+    /// \param changedObjects Changed objects
+    void setChangedObjects(std::vector<PDFObjectReference> changedObjects) { m_changedObjects = qMove(changedObjects); }
+
+    /// Returns true, if pages affected by the modification are known, so consumers
+    /// can invalidate only data of affected pages. If this function returns false,
+    /// then any page can be affected.
+    bool hasAffectedPages() const { return m_hasAffectedPages && !hasReset(); }
+
+    /// Returns sorted indices of pages affected by the modification. Result
+    /// is valid only, if \p hasAffectedPages returns true.
+    const std::vector<PDFInteger>& getAffectedPages() const { return m_affectedPages; }
+
+    /// Sets pages affected by the modification. Page indices must be valid
+    /// in the modified document.
+    /// \param affectedPages Indices of affected pages
+    void setAffectedPages(std::vector<PDFInteger> affectedPages)
+    {
+        std::sort(affectedPages.begin(), affectedPages.end());
+        affectedPages.erase(std::unique(affectedPages.begin(), affectedPages.end()), affectedPages.end());
+        m_affectedPages = qMove(affectedPages);
+        m_hasAffectedPages = true;
+    }
+
+    /// Returns true, if page with given index can be affected by the modification
+    /// \param pageIndex Page index
+    bool isPageAffected(PDFInteger pageIndex) const { return !hasAffectedPages() || std::binary_search(m_affectedPages.cbegin(), m_affectedPages.cend(), pageIndex); }
+
     operator PDFDocument*() const { return m_document; }
     operator PDFDocumentPointer() const { return m_documentPointer; }
 
@@ -580,6 +947,9 @@ private:
     PDFDocument* m_document = nullptr;
     PDFOptionalContentActivity* m_optionalContentActivity = nullptr;
     ModificationFlags m_flags = Reset;
+    std::vector<PDFObjectReference> m_changedObjects;
+    std::vector<PDFInteger> m_affectedPages;
+    bool m_hasAffectedPages = false;
 };
 
 // Implementation
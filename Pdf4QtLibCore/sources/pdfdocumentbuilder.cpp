@@ -23,6 +23,7 @@
 #include "pdfnametreeloader.h"
 #include "pdfparser.h"
 #include "pdfstreamfilters.h"
+#include "pdfdocumentwriter.h"
 
 #include <QBuffer>
 #include <QPainter>
@@ -1445,6 +1446,134 @@ void PDFDocumentBuilder::setSecurityHandler(PDFSecurityHandlerPointer handler)
     m_storage.setSecurityHandler(qMove(handler));
 }
 
+void PDFDocumentBuilder::beginStreaming(PDFStreamingDocumentWriter* writer)
+{
+    Q_ASSERT(writer);
+    Q_ASSERT(!m_streamingWriter);
+
+    m_streamingWriter = writer;
+    m_flushedObjects.clear();
+}
+
+void PDFDocumentBuilder::flushPage(PDFObjectReference pageReference)
+{
+    Q_ASSERT(m_streamingWriter);
+
+    PDFDocumentDataLoaderDecorator loader(&m_storage);
+
+    std::vector<PDFObjectReference> references;
+    std::set<PDFObjectReference> visitedReferences;
+    std::vector<PDFObjectReference> stack = { pageReference };
+
+    while (!stack.empty())
+    {
+        PDFObjectReference reference = stack.back();
+        stack.pop_back();
+
+        if (!visitedReferences.insert(reference).second || isFlushed(reference))
+        {
+            continue;
+        }
+
+        const PDFObject& object = m_storage.getObject(reference);
+        if (object.isNull())
+        {
+            continue;
+        }
+
+        if (reference != pageReference)
+        {
+            // Do not flush page tree and other pages
+            if (const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(object))
+            {
+                const QByteArray type = loader.readNameFromDictionary(dictionary, "Type");
+                if (type == "Page" || type == "Pages")
+                {
+                    continue;
+                }
+            }
+        }
+
+        references.push_back(reference);
+
+        std::set<PDFObjectReference> directReferences = PDFObjectUtils::getDirectReferences(object);
+        stack.insert(stack.end(), directReferences.cbegin(), directReferences.cend());
+    }
+
+    flushObjects(references);
+}
+
+void PDFDocumentBuilder::flushObjects(const std::vector<PDFObjectReference>& references)
+{
+    Q_ASSERT(m_streamingWriter);
+
+    for (const PDFObjectReference& reference : references)
+    {
+        if (!reference.isValid() || isFlushed(reference))
+        {
+            continue;
+        }
+
+        const PDFObject& object = m_storage.getObject(reference);
+        if (object.isNull())
+        {
+            continue;
+        }
+
+        m_streamingWriter->reserveReference(reference);
+        m_streamingWriter->writeObject(reference, object);
+
+        if (reference.objectNumber >= PDFInteger(m_flushedObjects.size()))
+        {
+            m_flushedObjects.resize(reference.objectNumber + 1, false);
+        }
+        m_flushedObjects[reference.objectNumber] = true;
+
+        // Release the object, only its offset is kept in the writer
+        m_storage.setObject(reference, PDFObject());
+    }
+}
+
+PDFOperationResult PDFDocumentBuilder::finishStreaming()
+{
+    if (!m_streamingWriter)
+    {
+        return PDFTranslationContext::tr("Document is not being streamed.");
+    }
+
+    PDFOperationResult result = true;
+
+    try
+    {
+        const PDFObjectStorage::PDFObjects& objects = m_storage.getObjects();
+        updateTrailerDictionary(objects.size());
+
+        std::vector<PDFObjectReference> references;
+        for (size_t i = 1; i < objects.size(); ++i)
+        {
+            references.emplace_back(PDFInteger(i), objects[i].generation);
+        }
+        flushObjects(references);
+
+        result = m_streamingWriter->finish(getCatalogReference(), getDocumentInfo());
+    }
+    catch (const PDFException& exception)
+    {
+        result = exception.getMessage();
+    }
+
+    m_streamingWriter = nullptr;
+    m_flushedObjects.clear();
+    return result;
+}
+
+bool PDFDocumentBuilder::isFlushed(PDFObjectReference reference) const
+{
+    return reference.objectNumber >= 0 &&
+           reference.objectNumber < PDFInteger(m_flushedObjects.size()) &&
+           m_flushedObjects[reference.objectNumber];
+}
+
 PDFObjectReference PDFDocumentBuilder::getCatalogReference() const
 {
     if (const PDFDictionary* trailerDictionary = getDictionaryFromObject(m_storage.getTrailerDictionary()))
@@ -1929,12 +2058,46 @@ bool PDFDocumentModifier::finalize()
     if (document != *m_originalDocument)
     {
         m_modifiedDocument.reset(new PDFDocument(qMove(document)));
+
+        // Determine pages affected by the modification. Storage of the builder
+        // is modified copy of the original storage, so it shares chunks of
+        // unmodified objects and they need not to be compared.
+        m_changedObjects = m_modifiedDocument->getStorage().getChangedObjects(m_originalDocument->getStorage());
+        m_affectedPages = std::nullopt;
+
+        const PDFCatalog* originalCatalog = m_originalDocument->getCatalog();
+        const PDFCatalog* modifiedCatalog = m_modifiedDocument->getCatalog();
+        bool isPageTreeSame = originalCatalog->getPageCount() == modifiedCatalog->getPageCount();
+        for (size_t i = 0, pageCount = modifiedCatalog->getPageCount(); isPageTreeSame && i < pageCount; ++i)
+        {
+            isPageTreeSame = originalCatalog->getPage(i)->getPageReference() == modifiedCatalog->getPage(i)->getPageReference();
+        }
+
+        if (isPageTreeSame && !m_modificationFlags.testFlag(PDFModifiedDocument::Reset))
+        {
+            std::set<PDFObjectReference> changedObjects(m_changedObjects.cbegin(), m_changedObjects.cend());
+            m_affectedPages = PDFObjectUtils::getDependentPages(m_modifiedDocument.data(), changedObjects);
+        }
+
         return true;
     }
 
     return false;
 }
 
+PDFModifiedDocument PDFDocumentModifier::getModifiedDocument() const
+{
+    PDFModifiedDocument modifiedDocument(m_modifiedDocument, nullptr, m_modificationFlags);
+    modifiedDocument.setChangedObjects(m_changedObjects);
+
+    if (m_affectedPages)
+    {
+        modifiedDocument.setAffectedPages(*m_affectedPages);
+    }
+
+    return modifiedDocument;
+}
+
 /* START GENERATED CODE */
 
 PDFObjectReference PDFDocumentBuilder::appendPage(QRectF mediaBox)
@@ -27,6 +27,7 @@ class QPdfWriter;
 
 namespace pdf
 {
+class PDFStreamingDocumentWriter;
 
 using PDFIntegerVector = std::vector<PDFInteger>;
 using PDFObjectReferenceVector = std::vector<PDFObjectReference>;
@@ -462,6 +463,39 @@ public:
     /// Returns document info reference
     PDFObjectReference getDocumentInfo() const;
 
+    /// Starts streaming of the document to the writer. In streaming mode, objects
+    /// are written to the writer, when they are flushed (see \p flushPage and
+    /// \p flushObjects), and they are released from the memory. So, when very large
+    /// document is generated, only the page tree, the catalog and objects, which
+    /// were not flushed yet, are kept in the memory. Flushed objects can't be read
+    /// or modified afterwards. Writer must not be used by anyone else until
+    /// streaming is finished, because object numbers are assigned by the builder.
+    /// \param writer Streaming writer
+    void beginStreaming(PDFStreamingDocumentWriter* writer);
+
+    /// Returns true, if document is streamed to the writer
+    bool isStreaming() const { return m_streamingWriter; }
+
+    /// Flushes page and all objects used by the page (content streams, resources,
+    /// annotations, ...), which were not flushed yet. Page tree nodes and other pages
+    /// (for example, destinations of the links) are not flushed. Objects shared
+    /// with other pages (for example, fonts) are flushed with the first page using
+    /// them, so they must be complete at that time. Exception is thrown, if object
+    /// can't be written.
+    /// \param pageReference Page reference
+    void flushPage(PDFObjectReference pageReference);
+
+    /// Writes objects to the streaming writer and releases them from the memory.
+    /// Objects, which were already flushed, are skipped. Exception is thrown,
+    /// if object can't be written.
+    /// \param references References of objects to be flushed
+    void flushObjects(const std::vector<PDFObjectReference>& references);
+
+    /// Writes all remaining objects, cross-reference table and trailer to the streaming
+    /// writer and ends streaming. Builder contains only objects, which were not flushed,
+    /// so it should be reset afterwards.
+    PDFOperationResult finishStreaming();
+
     /// Copies existing annotation to another page
     /// \param pageReference Page reference (onto which is annotation copied)
     /// \param annotationReference Annotation reference
@@ -1581,9 +1615,13 @@ private:
     QRectF getPolygonsBoundingRect(const Polygons& Polygons) const;
     PDFObjectReference createOutlineItem(const PDFOutlineItem* root, bool writeOutlineData);
 
+    bool isFlushed(PDFObjectReference reference) const;
+
     PDFObjectStorage m_storage;
     PDFVersion m_version;
     const PDFFormManager* m_formManager = nullptr;
+    PDFStreamingDocumentWriter* m_streamingWriter = nullptr;
+    std::vector<bool> m_flushedObjects;
 };
 
 /// This class serves for document modification. While document is modified,
@@ -1607,6 +1645,11 @@ public:
     PDFDocumentPointer getDocument() const { return m_modifiedDocument; }
     PDFModifiedDocument::ModificationFlags getFlags() const { return m_modificationFlags; }
 
+    /// Returns modified document (created by \p finalize), together with modification
+    /// flags, changed objects and pages affected by the modification, so consumers
+    /// of the document can invalidate only data of affected pages.
+    PDFModifiedDocument getModifiedDocument() const;
+
     void markReset() { m_modificationFlags.setFlag(PDFModifiedDocument::Reset); }
     void markPageContentsChanged() { m_modificationFlags.setFlag(PDFModifiedDocument::PageContents); }
     void markAnnotationsChanged() { m_modificationFlags.setFlag(PDFModifiedDocument::Annotation); }
@@ -1618,6 +1661,8 @@ private:
     PDFDocumentBuilder m_builder;
     PDFDocumentPointer m_modifiedDocument;
     PDFModifiedDocument::ModificationFlags m_modificationFlags;
+    std::vector<PDFObjectReference> m_changedObjects;
+    std::optional<std::vector<PDFInteger>> m_affectedPages;
 };
 
 // Implementation
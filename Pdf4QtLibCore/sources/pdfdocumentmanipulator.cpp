@@ -18,8 +18,12 @@
 #include "pdfdocumentmanipulator.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfoptimizer.h"
+#include "pdfobjectutils.h"
+#include "pdfexecutionpolicy.h"
 #include "pdfdbgheap.h"
 
+#include <numeric>
+
 namespace pdf
 {
 
@@ -249,6 +253,24 @@ PDFDocumentManipulator::ProcessedPages PDFDocumentManipulator::collectObjectsAnd
         }
     }
 
+    // Jakub Melka: input documents are processed in parallel. For each document, we collect
+    // objects, which must be copied, then reference range is reserved for each document
+    // in the target document builder, and objects with rewritten references are created
+    // in parallel again. Finally, objects are merged into the target document builder.
+    struct DocumentCopy
+    {
+        PDFInteger documentIndex = -1;
+        std::map<std::pair<int, int>, PDFObjectReference>::iterator it;
+        std::map<std::pair<int, int>, PDFObjectReference>::iterator itEnd;
+        std::unique_ptr<PDFDocumentBuilder> temporaryBuilder;
+        std::vector<PDFObjectReference> objectsToMerge;
+        std::vector<PDFObjectReference> references;
+        std::map<PDFObjectReference, PDFObjectReference> referenceMapping;
+        std::vector<PDFObject> copiedObjects;
+        QString errorMessage;
+    };
+
+    std::vector<DocumentCopy> documentCopies;
     for (auto it = documentPages.begin(); it != documentPages.end();)
     {
         const int documentIndex = it->first.first;
@@ -267,24 +289,35 @@ PDFDocumentManipulator::ProcessedPages PDFDocumentManipulator::collectObjectsAnd
             {
                 throw PDFException(tr("Invalid document."));
             }
-            const PDFDocument* document = m_documents.at(documentIndex);
 
-            // Copy the pages into the target document builder
-            std::vector<PDFInteger> pageIndices;
-            for (auto currentIt = it; currentIt != itEnd; ++currentIt)
-            {
-                pageIndices.push_back(currentIt->first.second);
-            }
+            DocumentCopy documentCopy;
+            documentCopy.documentIndex = documentIndex;
+            documentCopy.it = it;
+            documentCopy.itEnd = itEnd;
+            documentCopies.push_back(qMove(documentCopy));
+        }
 
-            pdf::PDFDocumentBuilder temporaryBuilder(document);
+        // Advance the index
+        it = itEnd;
+    }
+
+    auto collectObjects = [this](DocumentCopy& documentCopy)
+    {
+        try
+        {
+            const PDFDocument* document = m_documents.at(documentCopy.documentIndex);
+
+            documentCopy.temporaryBuilder = std::make_unique<PDFDocumentBuilder>(document);
+            PDFDocumentBuilder& temporaryBuilder = *documentCopy.temporaryBuilder;
             temporaryBuilder.flattenPageTree();
 
             std::vector<pdf::PDFObjectReference> currentPages = temporaryBuilder.getPages();
-            std::vector<pdf::PDFObjectReference> objectsToMerge;
-            objectsToMerge.reserve(std::distance(it, itEnd));
+            std::vector<pdf::PDFObjectReference>& objectsToMerge = documentCopy.objectsToMerge;
+            objectsToMerge.reserve(std::distance(documentCopy.it, documentCopy.itEnd) + 4);
 
-            for (PDFInteger pageIndex : pageIndices)
+            for (auto currentIt = documentCopy.it; currentIt != documentCopy.itEnd; ++currentIt)
             {
+                const PDFInteger pageIndex = currentIt->first.second;
                 if (pageIndex < 0 || pageIndex >= static_cast< PDFInteger >(currentPages.size()))
                 {
                     throw PDFException(tr("Missing page (%1) in a document.").arg(pageIndex));
@@ -346,34 +379,83 @@ PDFDocumentManipulator::ProcessedPages PDFDocumentManipulator::collectObjectsAnd
 
             objectsToMerge.insert(objectsToMerge.end(), { acroFormReference, namesReference, ocPropertiesReference, outlineReference });
 
-            // Now, we are ready to merge objects into target document builder
-            std::vector<pdf::PDFObjectReference> references = pdf::PDFDocumentBuilder::createReferencesFromObjects(documentBuilder.copyFrom(pdf::PDFDocumentBuilder::createObjectsFromReferences(objectsToMerge), *temporaryBuilder.getStorage(), true));
+            // Collect all references, which we must copy (including transitively referenced objects)
+            std::set<PDFObjectReference> references = PDFObjectUtils::getReferences(PDFDocumentBuilder::createObjectsFromReferences(objectsToMerge), *temporaryBuilder.getStorage());
+            documentCopy.references.assign(references.cbegin(), references.cend());
+        }
+        catch (const PDFException& exception)
+        {
+            documentCopy.errorMessage = exception.getMessage();
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, documentCopies.begin(), documentCopies.end(), collectObjects);
+
+    // Reserve reference ranges in the target document
+    for (DocumentCopy& documentCopy : documentCopies)
+    {
+        if (!documentCopy.errorMessage.isEmpty())
+        {
+            throw PDFException(documentCopy.errorMessage);
+        }
 
-            outlineReference = references.back();
-            references.pop_back();
-            ocPropertiesReference = references.back();
-            references.pop_back();
-            namesReference = references.back();
-            references.pop_back();
-            acroFormReference = references.back();
-            references.pop_back();
+        for (const PDFObjectReference& reference : documentCopy.references)
+        {
+            documentCopy.referenceMapping[reference] = documentBuilder.addObject(PDFObject::createNull());
+        }
+    }
 
-            documentBuilder.appendTo(m_mergedObjects[MOT_OCProperties], documentBuilder.getObjectByReference(ocPropertiesReference));
-            documentBuilder.appendTo(m_mergedObjects[MOT_Form], documentBuilder.getObjectByReference(acroFormReference));
-            documentBuilder.mergeNames(m_mergedObjects[MOT_Names], namesReference);
-            m_outlines[documentIndex] = outlineReference;
+    auto copyObjects = [](DocumentCopy& documentCopy)
+    {
+        const PDFObjectStorage* storage = documentCopy.temporaryBuilder->getStorage();
 
-            Q_ASSERT(references.size() == size_t(std::distance(it, itEnd)));
+        documentCopy.copiedObjects.reserve(documentCopy.references.size());
+        for (const PDFObjectReference& reference : documentCopy.references)
+        {
+            documentCopy.copiedObjects.push_back(PDFObjectUtils::replaceReferences(storage->getObject(reference), documentCopy.referenceMapping));
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, documentCopies.begin(), documentCopies.end(), copyObjects);
 
-            auto referenceIt = references.begin();
-            for (auto currentIt = it; currentIt != itEnd; ++currentIt, ++referenceIt)
-            {
-                currentIt->second = *referenceIt;
-            }
+    // Merge objects into the target document
+    for (DocumentCopy& documentCopy : documentCopies)
+    {
+        for (size_t i = 0; i < documentCopy.references.size(); ++i)
+        {
+            documentBuilder.setObject(documentCopy.referenceMapping.at(documentCopy.references[i]), qMove(documentCopy.copiedObjects[i]));
         }
 
-        // Advance the index
-        it = itEnd;
+        std::vector<pdf::PDFObjectReference> references;
+        references.reserve(documentCopy.objectsToMerge.size());
+        for (const PDFObjectReference& reference : documentCopy.objectsToMerge)
+        {
+            references.push_back(documentCopy.referenceMapping.at(reference));
+        }
+
+        pdf::PDFObjectReference outlineReference = references.back();
+        references.pop_back();
+        pdf::PDFObjectReference ocPropertiesReference = references.back();
+        references.pop_back();
+        pdf::PDFObjectReference namesReference = references.back();
+        references.pop_back();
+        pdf::PDFObjectReference acroFormReference = references.back();
+        references.pop_back();
+
+        documentBuilder.appendTo(m_mergedObjects[MOT_OCProperties], documentBuilder.getObjectByReference(ocPropertiesReference));
+        documentBuilder.appendTo(m_mergedObjects[MOT_Form], documentBuilder.getObjectByReference(acroFormReference));
+        documentBuilder.mergeNames(m_mergedObjects[MOT_Names], namesReference);
+        m_outlines[documentCopy.documentIndex] = outlineReference;
+
+        Q_ASSERT(references.size() == size_t(std::distance(documentCopy.it, documentCopy.itEnd)));
+
+        auto referenceIt = references.begin();
+        for (auto currentIt = documentCopy.it; currentIt != documentCopy.itEnd; ++currentIt, ++referenceIt)
+        {
+            currentIt->second = *referenceIt;
+        }
+
+        // Release the temporary copy of the document
+        documentCopy.temporaryBuilder.reset();
+        documentCopy.copiedObjects.clear();
     }
 
     std::set<PDFObjectReference> usedReferences;
@@ -626,4 +708,645 @@ void PDFDocumentManipulator::setOutlineMode(OutlineMode outlineMode)
     m_outlineMode = outlineMode;
 }
 
+
+/// Returns page object, which contains inheritable attributes
+/// of the page (so page tree is not needed) and doesn't contain
+/// the reference to the parent page tree node.
+/// \param storage Storage
+/// \param pageDictionary Dictionary of the page
+static PDFObject getPageObjectWithInheritedAttributes(const PDFObjectStorage& storage, const PDFDictionary* pageDictionary)
+{
+    PDFDictionary dictionary = *pageDictionary;
+    for (const char* key : { "Resources", "MediaBox", "CropBox", "Rotate" })
+    {
+        std::set<PDFObjectReference> visitedNodes;
+        PDFObject parent = pageDictionary->get("Parent");
+        while (!dictionary.hasKey(key) && parent.isReference() && visitedNodes.insert(parent.getReference()).second)
+        {
+            const PDFDictionary* parentDictionary = storage.getDictionaryFromObject(storage.getObject(parent));
+            if (!parentDictionary)
+            {
+                break;
+            }
+
+            if (parentDictionary->hasKey(key))
+            {
+                dictionary.addEntry(PDFInplaceOrMemoryString(key), parentDictionary->get(key));
+            }
+
+            parent = parentDictionary->get("Parent");
+        }
+    }
+    dictionary.removeEntry("Parent");
+
+    return PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(dictionary)));
+}
+
+PDFStreamingDocumentAssembler::PDFStreamingDocumentAssembler(QIODevice* device) :
+    m_writer(device, PDFVersion(2, 0))
+{
+    m_catalogReference = m_writer.reserveReference();
+    m_pagesReference = m_writer.reserveReference();
+    m_documentPartRootReference = m_writer.reserveReference();
+    m_documentPartRootNodeReference = m_writer.reserveReference();
+    m_nullReference = m_writer.reserveReference();
+}
+
+PDFOperationResult PDFStreamingDocumentAssembler::addDocument(PDFDocument* document, const std::vector<PDFInteger>& pageIndices)
+{
+    try
+    {
+        // Written objects are released from the storage, so storage is modified
+        PDFObjectStorage& storage = document->m_pdfObjectStorage;
+        const PDFCatalog* catalog = document->getCatalog();
+        const PDFInteger pageCount = catalog->getPageCount();
+
+        std::vector<PDFInteger> indices = pageIndices;
+        if (indices.empty())
+        {
+            indices.resize(pageCount);
+            std::iota(indices.begin(), indices.end(), PDFInteger(0));
+        }
+
+        for (PDFInteger pageIndex : indices)
+        {
+            if (pageIndex < 0 || pageIndex >= pageCount)
+            {
+                throw PDFException(tr("Missing page (%1) in a document.").arg(pageIndex));
+            }
+        }
+
+        if (indices.empty())
+        {
+            // Document has no pages, nothing to append
+            return true;
+        }
+
+        // Source references of objects, which are written to the target document,
+        // and objects, whose references were mapped, but which are not written yet.
+        std::map<PDFObjectReference, PDFObjectReference> mapping;
+        std::vector<PDFObjectReference> pendingObjects;
+
+        // Jakub Melka: references of pages (and page tree nodes) are mapped in advance,
+        // so objects referring to other pages (for example, destinations of links)
+        // don't cause copying of the pages, which are not assembled, or page tree.
+        const PDFObject rootObject = document->getTrailerDictionary()->get("Root");
+        if (rootObject.isReference())
+        {
+            mapping[rootObject.getReference()] = m_catalogReference;
+        }
+
+        for (PDFInteger i = 0; i < pageCount; ++i)
+        {
+            const PDFObjectReference pageReference = catalog->getPage(i)->getPageReference();
+            mapping[pageReference] = m_nullReference;
+
+            const PDFDictionary* pageDictionary = storage.getDictionaryFromObject(storage.getObject(pageReference));
+            PDFObject parent = pageDictionary ? pageDictionary->get("Parent") : PDFObject();
+            std::set<PDFObjectReference> visitedNodes;
+            while (parent.isReference() && visitedNodes.insert(parent.getReference()).second)
+            {
+                mapping[parent.getReference()] = m_pagesReference;
+                const PDFDictionary* parentDictionary = storage.getDictionaryFromObject(storage.getObject(parent));
+                parent = parentDictionary ? parentDictionary->get("Parent") : PDFObject();
+            }
+        }
+
+        std::vector<std::pair<PDFObjectReference, PDFObjectReference>> pages;
+        std::set<PDFObjectReference> assembledPages;
+        for (PDFInteger pageIndex : indices)
+        {
+            const PDFObjectReference pageReference = catalog->getPage(pageIndex)->getPageReference();
+            const PDFObjectReference targetReference = m_writer.reserveReference();
+            pages.emplace_back(pageReference, targetReference);
+
+            // If page is assembled more than once, references point to the first copy
+            if (assembledPages.insert(pageReference).second)
+            {
+                mapping[pageReference] = targetReference;
+            }
+        }
+
+        auto mapReference = [&](PDFObjectReference reference)
+        {
+            auto it = mapping.find(reference);
+            if (it == mapping.cend())
+            {
+                it = mapping.insert(std::make_pair(reference, m_writer.reserveReference())).first;
+                pendingObjects.push_back(reference);
+            }
+
+            return it->second;
+        };
+
+        auto mapObject = [&](const PDFObject& object)
+        {
+            std::map<PDFObjectReference, PDFObjectReference> objectMapping;
+            for (const PDFObjectReference& reference : PDFObjectUtils::getDirectReferences(object))
+            {
+                objectMapping[reference] = mapReference(reference);
+            }
+
+            return PDFObjectUtils::replaceReferences(object, objectMapping);
+        };
+
+        // Objects are written immediately and released from the source storage
+        auto writePendingObjects = [&]()
+        {
+            while (!pendingObjects.empty())
+            {
+                const PDFObjectReference reference = pendingObjects.back();
+                pendingObjects.pop_back();
+
+                m_writer.writeObject(mapping.at(reference), mapObject(storage.getObject(reference)));
+                storage.releaseObject(reference);
+            }
+        };
+
+        const PDFObjectReference documentPartReference = m_writer.reserveReference();
+        for (const auto& [pageReference, targetReference] : pages)
+        {
+            const PDFDictionary* pageDictionary = storage.getDictionaryFromObject(storage.getObject(pageReference));
+            if (!pageDictionary)
+            {
+                throw PDFException(tr("Invalid page object %1 %2 R.").arg(pageReference.objectNumber).arg(pageReference.generation));
+            }
+
+            // Inheritable attributes must be stored in the page, because page tree is not copied
+            PDFObject mappedPageObject = mapObject(getPageObjectWithInheritedAttributes(storage, pageDictionary));
+            PDFDictionary mappedPageDictionary = *mappedPageObject.getDictionary();
+            mappedPageDictionary.setEntry(PDFInplaceOrMemoryString("Parent"), PDFObject::createReference(m_pagesReference));
+            mappedPageDictionary.setEntry(PDFInplaceOrMemoryString("DPart"), PDFObject::createReference(documentPartReference));
+            m_writer.writeObject(targetReference, PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(mappedPageDictionary))));
+            m_pages.push_back(targetReference);
+
+            writePendingObjects();
+        }
+
+        for (const auto& page : pages)
+        {
+            storage.releaseObject(page.first);
+        }
+
+        // Copy optional content groups, so they are not ignored
+        const PDFDictionary* catalogDictionary = storage.getDictionaryFromObject(storage.getObject(rootObject));
+        const PDFDictionary* ocProperties = catalogDictionary ? storage.getDictionaryFromObject(catalogDictionary->get("OCProperties")) : nullptr;
+        if (ocProperties)
+        {
+            auto addGroups = [&](const PDFObject& object, std::vector<PDFObjectReference>& groups)
+            {
+                if (const PDFObject& groupsObject = storage.getObject(object); groupsObject.isArray())
+                {
+                    for (const PDFObject& item : *groupsObject.getArray())
+                    {
+                        if (item.isReference())
+                        {
+                            groups.push_back(mapReference(item.getReference()));
+                        }
+                    }
+                }
+            };
+
+            addGroups(ocProperties->get("OCGs"), m_optionalContentGroups);
+            if (const PDFDictionary* defaultConfiguration = storage.getDictionaryFromObject(ocProperties->get("D")))
+            {
+                addGroups(defaultConfiguration->get("OFF"), m_optionalContentGroupsOff);
+            }
+
+            writePendingObjects();
+        }
+
+        PDFObjectFactory objectFactory;
+        objectFactory.beginDictionary();
+        objectFactory.beginDictionaryItem("Type");
+        objectFactory << WrapName("DPart");
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Parent");
+        objectFactory << m_documentPartRootNodeReference;
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Start");
+        objectFactory << pages.front().second;
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("End");
+        objectFactory << pages.back().second;
+        objectFactory.endDictionaryItem();
+        objectFactory.endDictionary();
+        m_writer.writeObject(documentPartReference, objectFactory.takeObject());
+        m_documentParts.push_back(documentPartReference);
+    }
+    catch (const PDFException& exception)
+    {
+        return exception.getMessage();
+    }
+
+    return true;
+}
+
+PDFOperationResult PDFStreamingDocumentAssembler::finish()
+{
+    try
+    {
+        PDFObjectFactory objectFactory;
+
+        // Page tree
+        objectFactory.beginDictionary();
+        objectFactory.beginDictionaryItem("Type");
+        objectFactory << WrapName("Pages");
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Kids");
+        objectFactory.beginArray();
+        for (const PDFObjectReference& page : m_pages)
+        {
+            objectFactory << page;
+        }
+        objectFactory.endArray();
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Count");
+        objectFactory << PDFInteger(m_pages.size());
+        objectFactory.endDictionaryItem();
+        objectFactory.endDictionary();
+        m_writer.writeObject(m_pagesReference, objectFactory.takeObject());
+
+        // Catalog
+        objectFactory.beginDictionary();
+        objectFactory.beginDictionaryItem("Type");
+        objectFactory << WrapName("Catalog");
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Pages");
+        objectFactory << m_pagesReference;
+        objectFactory.endDictionaryItem();
+
+        if (!m_documentParts.empty())
+        {
+            objectFactory.beginDictionaryItem("DPartRoot");
+            objectFactory << m_documentPartRootReference;
+            objectFactory.endDictionaryItem();
+        }
+
+        if (!m_optionalContentGroups.empty())
+        {
+            objectFactory.beginDictionaryItem("OCProperties");
+            objectFactory.beginDictionary();
+            objectFactory.beginDictionaryItem("OCGs");
+            objectFactory.beginArray();
+            for (const PDFObjectReference& group : m_optionalContentGroups)
+            {
+                objectFactory << group;
+            }
+            objectFactory.endArray();
+            objectFactory.endDictionaryItem();
+            objectFactory.beginDictionaryItem("D");
+            objectFactory.beginDictionary();
+            objectFactory.beginDictionaryItem("OFF");
+            objectFactory.beginArray();
+            for (const PDFObjectReference& group : m_optionalContentGroupsOff)
+            {
+                objectFactory << group;
+            }
+            objectFactory.endArray();
+            objectFactory.endDictionaryItem();
+            objectFactory.endDictionary();
+            objectFactory.endDictionaryItem();
+            objectFactory.endDictionary();
+            objectFactory.endDictionaryItem();
+        }
+
+        objectFactory.endDictionary();
+        m_writer.writeObject(m_catalogReference, objectFactory.takeObject());
+
+        // Document parts
+        if (!m_documentParts.empty())
+        {
+            objectFactory.beginDictionary();
+            objectFactory.beginDictionaryItem("Type");
+            objectFactory << WrapName("DPartRoot");
+            objectFactory.endDictionaryItem();
+            objectFactory.beginDictionaryItem("DPartRootNode");
+            objectFactory << m_documentPartRootNodeReference;
+            objectFactory.endDictionaryItem();
+            objectFactory.endDictionary();
+            m_writer.writeObject(m_documentPartRootReference, objectFactory.takeObject());
+
+            objectFactory.beginDictionary();
+            objectFactory.beginDictionaryItem("Type");
+            objectFactory << WrapName("DPart");
+            objectFactory.endDictionaryItem();
+            objectFactory.beginDictionaryItem("Parent");
+            objectFactory << m_documentPartRootReference;
+            objectFactory.endDictionaryItem();
+            objectFactory.beginDictionaryItem("DParts");
+            objectFactory.beginArray();
+            for (const PDFObjectReference& documentPart : m_documentParts)
+            {
+                objectFactory.beginArray();
+                objectFactory << documentPart;
+                objectFactory.endArray();
+            }
+            objectFactory.endArray();
+            objectFactory.endDictionaryItem();
+            objectFactory.endDictionary();
+            m_writer.writeObject(m_documentPartRootNodeReference, objectFactory.takeObject());
+        }
+    }
+    catch (const PDFException& exception)
+    {
+        return exception.getMessage();
+    }
+
+    return m_writer.finish(m_catalogReference, PDFObjectReference());
+}
+
+PDFDocumentPageSplitter::PDFDocumentPageSplitter(const PDFDocument* document) :
+    m_document(document)
+{
+
+}
+
+PDFOperationResult PDFDocumentPageSplitter::prepare(const std::vector<PDFInteger>& pageIndices)
+{
+    try
+    {
+        const PDFObjectStorage& storage = m_document->getStorage();
+        const PDFCatalog* catalog = m_document->getCatalog();
+        const PDFInteger pageCount = catalog->getPageCount();
+
+        // Jakub Melka: references of pages, page tree nodes and catalog are not
+        // followed, when closures are computed, so objects referring to other
+        // pages (for example, destinations of links) don't cause copying of
+        // the whole document.
+        const PDFObject rootObject = m_document->getTrailerDictionary()->get("Root");
+        if (rootObject.isReference())
+        {
+            m_stopReferences.insert(rootObject.getReference());
+        }
+
+        for (PDFInteger i = 0; i < pageCount; ++i)
+        {
+            const PDFObjectReference pageReference = catalog->getPage(i)->getPageReference();
+            m_stopReferences.insert(pageReference);
+
+            const PDFDictionary* pageDictionary = storage.getDictionaryFromObject(storage.getObject(pageReference));
+            PDFObject parent = pageDictionary ? pageDictionary->get("Parent") : PDFObject();
+            while (parent.isReference() && m_stopReferences.insert(parent.getReference()).second)
+            {
+                const PDFDictionary* parentDictionary = storage.getDictionaryFromObject(storage.getObject(parent));
+                parent = parentDictionary ? parentDictionary->get("Parent") : PDFObject();
+            }
+        }
+
+        // Collect objects directly referenced from pages
+        std::map<PDFObjectReference, ClosurePointer> closures;
+        for (PDFInteger pageIndex : pageIndices)
+        {
+            if (pageIndex < 0 || pageIndex >= pageCount)
+            {
+                throw PDFException(tr("Missing page (%1) in a document.").arg(pageIndex));
+            }
+
+            if (m_pages.count(pageIndex))
+            {
+                continue;
+            }
+
+            const PDFObjectReference pageReference = catalog->getPage(pageIndex)->getPageReference();
+            const PDFDictionary* pageDictionary = storage.getDictionaryFromObject(storage.getObject(pageReference));
+            if (!pageDictionary)
+            {
+                throw PDFException(tr("Invalid page object %1 %2 R.").arg(pageReference.objectNumber).arg(pageReference.generation));
+            }
+
+            PageInfo& pageInfo = m_pages[pageIndex];
+            pageInfo.pageReference = pageReference;
+            pageInfo.pageObject = getPageObjectWithInheritedAttributes(storage, pageDictionary);
+
+            for (const PDFObjectReference& reference : PDFObjectUtils::getDirectReferences(pageInfo.pageObject))
+            {
+                if (!m_stopReferences.count(reference))
+                {
+                    closures[reference] = nullptr;
+                }
+            }
+        }
+
+        // Compute closures of directly referenced objects, each only once
+        std::vector<PDFObjectReference> closureReferences;
+        closureReferences.reserve(closures.size());
+        for (const auto& item : closures)
+        {
+            closureReferences.push_back(item.first);
+        }
+
+        QMutex errorMutex;
+        QString errorMessage;
+        auto setErrorMessage = [&](const QString& message)
+        {
+            QMutexLocker lock(&errorMutex);
+            errorMessage = message;
+        };
+
+        std::vector<ClosurePointer> computedClosures(closureReferences.size());
+        auto computeClosure = [&](size_t index)
+        {
+            try
+            {
+                computedClosures[index] = std::make_shared<const Closure>(getClosure(closureReferences[index]));
+            }
+            catch (const PDFException& exception)
+            {
+                setErrorMessage(exception.getMessage());
+            }
+        };
+        PDFIntegerRange<size_t> closureRange(0, closureReferences.size());
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, closureRange.begin(), closureRange.end(), computeClosure);
+
+        if (!errorMessage.isEmpty())
+        {
+            throw PDFException(errorMessage);
+        }
+
+        for (size_t i = 0; i < closureReferences.size(); ++i)
+        {
+            closures[closureReferences[i]] = computedClosures[i];
+        }
+
+        // Find objects shared by more pages
+        std::map<PDFObjectReference, PDFInteger> usageCount;
+        for (auto& [pageIndex, pageInfo] : m_pages)
+        {
+            for (const PDFObjectReference& reference : PDFObjectUtils::getDirectReferences(pageInfo.pageObject))
+            {
+                auto it = closures.find(reference);
+                if (it != closures.cend())
+                {
+                    pageInfo.closures.push_back(it->second);
+                }
+            }
+
+            for (const PDFObjectReference& reference : getPageObjects(pageInfo))
+            {
+                ++usageCount[reference];
+            }
+        }
+
+        std::vector<PDFObjectReference> sharedReferences;
+        for (const auto& [reference, count] : usageCount)
+        {
+            if (count > 1)
+            {
+                sharedReferences.push_back(reference);
+            }
+        }
+
+        // Serialize shared objects, so each of them is serialized only once
+        std::vector<QByteArray> serializedObjects(sharedReferences.size());
+        auto serializeObject = [&](size_t index)
+        {
+            try
+            {
+                serializedObjects[index] = PDFDocumentWriter::getSerializedObject(storage.getObject(sharedReferences[index]));
+            }
+            catch (const PDFException& exception)
+            {
+                setErrorMessage(exception.getMessage());
+            }
+        };
+        PDFIntegerRange<size_t> serializeRange(0, sharedReferences.size());
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, serializeRange.begin(), serializeRange.end(), serializeObject);
+
+        if (!errorMessage.isEmpty())
+        {
+            throw PDFException(errorMessage);
+        }
+
+        for (size_t i = 0; i < sharedReferences.size(); ++i)
+        {
+            m_serializedObjects[sharedReferences[i]] = qMove(serializedObjects[i]);
+        }
+    }
+    catch (const PDFException& exception)
+    {
+        return exception.getMessage();
+    }
+
+    return true;
+}
+
+PDFOperationResult PDFDocumentPageSplitter::writePage(PDFInteger pageIndex, QIODevice* device) const
+{
+    auto it = m_pages.find(pageIndex);
+    if (it == m_pages.cend())
+    {
+        return tr("Page %1 is not prepared.").arg(pageIndex + 1);
+    }
+
+    try
+    {
+        const PDFObjectStorage& storage = m_document->getStorage();
+        const PageInfo& pageInfo = it->second;
+        const Closure objects = getPageObjects(pageInfo);
+
+        PDFStreamingDocumentWriter writer(device, m_document->getInfo()->version);
+        for (const PDFObjectReference& reference : objects)
+        {
+            writer.reserveReference(reference);
+        }
+        writer.reserveReference(pageInfo.pageReference);
+
+        // New objects are reserved after the copied ones, so they don't collide
+        const PDFObjectReference pagesReference = writer.reserveReference();
+        const PDFObjectReference catalogReference = writer.reserveReference();
+
+        for (const PDFObjectReference& reference : objects)
+        {
+            auto itSerialized = m_serializedObjects.find(reference);
+            if (itSerialized != m_serializedObjects.cend())
+            {
+                writer.writeSerializedObject(reference, itSerialized->second);
+            }
+            else
+            {
+                writer.writeObject(reference, storage.getObject(reference));
+            }
+        }
+
+        PDFDictionary pageDictionary = *pageInfo.pageObject.getDictionary();
+        pageDictionary.setEntry(PDFInplaceOrMemoryString("Parent"), PDFObject::createReference(pagesReference));
+        writer.writeObject(pageInfo.pageReference, PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(pageDictionary))));
+
+        PDFObjectFactory objectFactory;
+        objectFactory.beginDictionary();
+        objectFactory.beginDictionaryItem("Type");
+        objectFactory << WrapName("Pages");
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Kids");
+        objectFactory.beginArray();
+        objectFactory << pageInfo.pageReference;
+        objectFactory.endArray();
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Count");
+        objectFactory << PDFInteger(1);
+        objectFactory.endDictionaryItem();
+        objectFactory.endDictionary();
+        writer.writeObject(pagesReference, objectFactory.takeObject());
+
+        objectFactory.beginDictionary();
+        objectFactory.beginDictionaryItem("Type");
+        objectFactory << WrapName("Catalog");
+        objectFactory.endDictionaryItem();
+        objectFactory.beginDictionaryItem("Pages");
+        objectFactory << pagesReference;
+        objectFactory.endDictionaryItem();
+        objectFactory.endDictionary();
+        writer.writeObject(catalogReference, objectFactory.takeObject());
+
+        return writer.finish(catalogReference, PDFObjectReference());
+    }
+    catch (const PDFException& exception)
+    {
+        return exception.getMessage();
+    }
+}
+
+PDFDocumentPageSplitter::Closure PDFDocumentPageSplitter::getClosure(PDFObjectReference reference) const
+{
+    const PDFObjectStorage& storage = m_document->getStorage();
+
+    std::set<PDFObjectReference> visited;
+    std::vector<PDFObjectReference> stack = { reference };
+    while (!stack.empty())
+    {
+        const PDFObjectReference current = stack.back();
+        stack.pop_back();
+
+        if (m_stopReferences.count(current) || !visited.insert(current).second)
+        {
+            continue;
+        }
+
+        for (const PDFObjectReference& directReference : PDFObjectUtils::getDirectReferences(storage.getObject(current)))
+        {
+            if (!visited.count(directReference))
+            {
+                stack.push_back(directReference);
+            }
+        }
+    }
+
+    return Closure(visited.cbegin(), visited.cend());
+}
+
+PDFDocumentPageSplitter::Closure PDFDocumentPageSplitter::getPageObjects(const PageInfo& pageInfo)
+{
+    Closure objects;
+    for (const ClosurePointer& closure : pageInfo.closures)
+    {
+        Closure merged;
+        merged.reserve(objects.size() + closure->size());
+        std::set_union(objects.cbegin(), objects.cend(), closure->cbegin(), closure->cend(), std::back_inserter(merged));
+        objects = qMove(merged);
+    }
+
+    return objects;
+}
+
 }   // namespace pdf
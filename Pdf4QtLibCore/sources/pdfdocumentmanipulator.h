@@ -19,6 +19,7 @@
 #define PDFDOCUMENTMANIPULATOR_H
 
 #include "pdfdocument.h"
+#include "pdfdocumentwriter.h"
 #include "pdfutils.h"
 
 #include <QImage>
@@ -155,6 +156,111 @@ private:
     std::map<PDFInteger, PDFObjectReference> m_outlines;
 };
 
+/// Assembles pages of documents into a new document, which is written directly
+/// to the output device. Objects of pages are copied from the source documents
+/// one by one, they are written immediately and then released from the source
+/// document storage, so memory consumption is bounded by objects of a single
+/// page, if source documents are loaded lazily. Objects shared by pages of the
+/// same document are written only once. Only pages (with their resources and
+/// annotations) and optional content groups are copied, other document level
+/// objects (outlines, names, interactive forms, ...) are not merged. Each added
+/// document creates a document part.
+class PDF4QTLIBCORESHARED_EXPORT PDFStreamingDocumentAssembler
+{
+    Q_DECLARE_TR_FUNCTIONS(pdf::PDFStreamingDocumentAssembler)
+
+public:
+    /// Constructs assembler, device must be writable (i.e. opened for writing)
+    /// during the assembly.
+    /// \param device Output device
+    explicit PDFStreamingDocumentAssembler(QIODevice* device);
+
+    /// Appends pages of the document to the assembled document. Document must not
+    /// be accessed by other threads during this function call. Written objects
+    /// are released from the document storage (see PDFObjectStorage::releaseObject),
+    /// so references to objects of the document obtained before this call are
+    /// invalid. Document can be destroyed after this function returns.
+    /// \param document Document
+    /// \param pageIndices Indices of pages to be appended (if empty, all pages are appended)
+    PDFOperationResult addDocument(PDFDocument* document, const std::vector<PDFInteger>& pageIndices = std::vector<PDFInteger>());
+
+    /// Writes page tree, document parts and catalog and finishes the document.
+    /// No more documents can be added after this function is called.
+    PDFOperationResult finish();
+
+private:
+    PDFStreamingDocumentWriter m_writer;
+    PDFObjectReference m_catalogReference;
+    PDFObjectReference m_pagesReference;
+    PDFObjectReference m_documentPartRootReference;
+    PDFObjectReference m_documentPartRootNodeReference;
+
+    /// Reference, which is never written, objects referring to pages, which are
+    /// not assembled, refer to this reference (i.e. to the null object).
+    PDFObjectReference m_nullReference;
+
+    std::vector<PDFObjectReference> m_pages;
+    std::vector<PDFObjectReference> m_documentParts;
+    std::vector<PDFObjectReference> m_optionalContentGroups;
+    std::vector<PDFObjectReference> m_optionalContentGroupsOff;
+};
+
+/// Splits document into single page documents, which are written directly to
+/// the output devices. Objects keep their object numbers and generations in the
+/// split documents, so object shared by more pages (fonts, images, ...) is serialized
+/// only once, when splitter is prepared, and its data are then copied to each
+/// document. Closures of objects referenced from pages are also computed only once
+/// and shared by pages. Objects referring to other pages or to the page tree refer
+/// to free objects (i.e. null objects) in split documents. Only pages (with their
+/// resources and annotations) are copied, document level objects are not copied.
+class PDF4QTLIBCORESHARED_EXPORT PDFDocumentPageSplitter
+{
+    Q_DECLARE_TR_FUNCTIONS(pdf::PDFDocumentPageSplitter)
+
+public:
+    /// Constructs splitter, document must be valid during the lifetime of the splitter
+    /// \param document Document
+    explicit PDFDocumentPageSplitter(const PDFDocument* document);
+
+    /// Computes closures of objects of given pages, and serializes objects
+    /// shared by more pages. Pages are processed in parallel. This function must
+    /// be called before pages are written.
+    /// \param pageIndices Indices of pages
+    PDFOperationResult prepare(const std::vector<PDFInteger>& pageIndices);
+
+    /// Writes single page document containing given page to the device. Page
+    /// must be prepared. Function is thread safe, so more pages can be written
+    /// in parallel (each to its own device).
+    /// \param pageIndex Page index
+    /// \param device Output device (opened for writing)
+    PDFOperationResult writePage(PDFInteger pageIndex, QIODevice* device) const;
+
+private:
+    using Closure = std::vector<PDFObjectReference>;
+    using ClosurePointer = std::shared_ptr<const Closure>;
+
+    struct PageInfo
+    {
+        PDFObjectReference pageReference;
+        PDFObject pageObject;
+        std::vector<ClosurePointer> closures;
+    };
+
+    /// Computes sorted closure of object with given reference, references
+    /// of pages, page tree nodes and catalog are not followed.
+    /// \param reference Reference
+    Closure getClosure(PDFObjectReference reference) const;
+
+    /// Returns sorted references of all objects referenced from the page
+    /// \param pageInfo Page info
+    static Closure getPageObjects(const PageInfo& pageInfo);
+
+    const PDFDocument* m_document;
+    std::set<PDFObjectReference> m_stopReferences;
+    std::map<PDFInteger, PageInfo> m_pages;
+    std::map<PDFObjectReference, QByteArray> m_serializedObjects;
+};
+
 }   // namespace pdf
 
 #endif // PDFDOCUMENTMANIPULATOR_H
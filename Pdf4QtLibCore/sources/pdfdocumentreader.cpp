@@ -23,20 +23,608 @@
 #include "pdfparser.h"
 #include "pdfstreamfilters.h"
 #include "pdfexecutionpolicy.h"
+#include "pdfrandomaccesssource.h"
+#include "pdfutils.h"
+#include "pdftrace.h"
 
+#include <QDir>
 #include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
 #include <QCryptographicHash>
 
 #include "pdfdbgheap.h"
 
+#include <set>
 #include <regex>
 #include <cctype>
+#include <cstring>
+#include <limits>
+#include <mutex>
 #include <algorithm>
 #include <execution>
 
 namespace pdf
 {
 
+/// Returns original data of the object from the source data. If range of
+/// the object is not known, then empty byte array is returned.
+/// \param source Source data of the document
+/// \param ranges Ranges of objects' data (indexed by object number)
+/// \param reference Reference of the object
+static QByteArray getObjectDataFromRange(const QByteArray& source, const std::vector<PDFObjectDataRange>& ranges, PDFObjectReference reference)
+{
+    if (reference.objectNumber < 0 || reference.objectNumber >= static_cast<PDFInteger>(ranges.size()))
+    {
+        return QByteArray();
+    }
+
+    const PDFObjectDataRange& range = ranges[reference.objectNumber];
+    if (range.length <= 0 || range.generation != reference.generation || range.offset + range.length > source.size())
+    {
+        return QByteArray();
+    }
+
+    return source.mid(range.offset, range.length);
+}
+
+/// Original data of objects of the document, which was not loaded lazily. Source
+/// data (and memory mapped file, if source data are mapped) are held by this object.
+class PDFDocumentReaderObjectSource : public PDFObjectStorageSource
+{
+public:
+    explicit PDFDocumentReaderObjectSource(QByteArray source, std::shared_ptr<QFile> mappedFile, std::vector<PDFObjectDataRange> ranges) :
+        m_source(qMove(source)),
+        m_mappedFile(qMove(mappedFile)),
+        m_ranges(qMove(ranges))
+    {
+
+    }
+
+    virtual QByteArray getObjectData(PDFObjectReference reference) const override { return getObjectDataFromRange(m_source, m_ranges, reference); }
+
+private:
+    QByteArray m_source;
+    std::shared_ptr<QFile> m_mappedFile;
+    std::vector<PDFObjectDataRange> m_ranges;
+};
+
+/// Object loader, which loads objects from the source data of the document on demand,
+/// using the cross-reference table. Objects in object streams are also supported,
+/// object stream is decoded only once and then it is cached. If source cache
+/// is used, then data of the object are fetched from the source before the
+/// object is parsed. Loader also provides original data of loaded objects.
+class PDFDocumentReaderObjectLoader : public PDFObjectStorageLoader, public PDFObjectStorageSource
+{
+public:
+    explicit PDFDocumentReaderObjectLoader(QByteArray source,
+                                           std::shared_ptr<QFile> mappedFile,
+                                           PDFRandomAccessSourceCachePointer sourceCache,
+                                           PDFXRefTable xrefTable);
+
+    virtual PDFObject loadObject(PDFObjectReference reference) const override;
+    virtual QByteArray getObjectData(PDFObjectReference reference) const override;
+
+    /// Sets security handler used to decrypt loaded objects. This function
+    /// must be called before the loader is shared with object storage.
+    /// \param securityHandler Security handler
+    void setSecurityHandler(PDFSecurityHandlerPointer securityHandler);
+
+    /// Reads object from the source at given offset. Can throw exception.
+    /// \param source Source data of the document
+    /// \param context Parsing context
+    /// \param offset Offset of the object in the source data
+    /// \param reference Reference of the object
+    /// \param[out] range Range of object's data in the source data (can be nullptr)
+    static PDFObject readObject(const QByteArray& source, PDFParsingContext* context, PDFInteger offset, PDFObjectReference reference, PDFObjectDataRange* range = nullptr);
+
+    /// Fetches data of given objects from the source concurrently. Does
+    /// nothing, if source cache is not used. Can throw exception.
+    /// \param references References of objects
+    void fetchObjects(const std::vector<PDFObjectReference>& references) const;
+
+    /// Fetches page tree of the document from the source. Each level of the page
+    /// tree is fetched at once, so number of blocking fetches is given by depth
+    /// of the page tree, not by number of pages. Does nothing, if source cache
+    /// is not used.
+    /// \param trailerDictionary Trailer dictionary
+    void prefetchPageTree(const PDFObject& trailerDictionary) const;
+
+private:
+    struct ObjectStream
+    {
+        QByteArray data;
+        std::map<PDFInteger, PDFInteger> offsets;
+    };
+
+    using ObjectStreamPointer = std::shared_ptr<const ObjectStream>;
+
+    /// Fetch object from reference table (without decryption), can throw exception
+    PDFObject getObjectFromXrefTable(PDFParsingContext* context, PDFObjectReference reference) const;
+
+    /// Returns decoded object stream, can throw exception
+    ObjectStreamPointer getObjectStream(PDFObjectReference reference) const;
+
+    /// Returns range (offset, length) of the source data, where object
+    /// is stored. Object in object stream is stored in the object stream.
+    /// If object doesn't exist, then empty range is returned.
+    PDFRandomAccessSourceCache::Range getObjectRange(PDFObjectReference reference) const;
+
+    /// Returns range of the object starting at given offset
+    PDFRandomAccessSourceCache::Range getObjectRange(PDFInteger offset) const;
+
+    /// Ensures, that data of object at given offset are fetched
+    /// from the source. Can throw exception.
+    void ensureObjectData(PDFInteger offset) const;
+
+    QByteArray m_source;
+
+    /// Memory mapped file (can be nullptr), source data can
+    /// be stored in the memory mapped from this file.
+    std::shared_ptr<QFile> m_mappedFile;
+
+    /// Cache of the random access source (can be nullptr),
+    /// source data are then stored in this cache.
+    PDFRandomAccessSourceCachePointer m_sourceCache;
+
+    /// Sorted offsets of occupied objects, they are used to determine
+    /// ranges of objects, when source cache is used.
+    std::vector<PDFInteger> m_objectOffsets;
+
+    PDFXRefTable m_xrefTable;
+    PDFSecurityHandlerPointer m_securityHandler;
+    PDFObjectReference m_encryptObjectReference;
+
+    mutable QMutex m_objectStreamMutex;
+    mutable std::map<PDFObjectReference, ObjectStreamPointer> m_objectStreams;
+
+    /// Ranges of data of loaded objects (indexed by object number)
+    mutable QMutex m_objectRangeMutex;
+    mutable std::vector<PDFObjectDataRange> m_objectRanges;
+};
+
+PDFDocumentReaderObjectLoader::PDFDocumentReaderObjectLoader(QByteArray source,
+                                                             std::shared_ptr<QFile> mappedFile,
+                                                             PDFRandomAccessSourceCachePointer sourceCache,
+                                                             PDFXRefTable xrefTable) :
+    m_source(qMove(source)),
+    m_mappedFile(qMove(mappedFile)),
+    m_sourceCache(qMove(sourceCache)),
+    m_xrefTable(qMove(xrefTable)),
+    m_objectRanges(m_xrefTable.getSize())
+{
+    if (m_sourceCache)
+    {
+        for (const PDFXRefTable::Entry& entry : m_xrefTable.getOccupiedEntries())
+        {
+            m_objectOffsets.push_back(entry.offset);
+        }
+
+        std::sort(m_objectOffsets.begin(), m_objectOffsets.end());
+        m_objectOffsets.erase(std::unique(m_objectOffsets.begin(), m_objectOffsets.end()), m_objectOffsets.end());
+    }
+}
+
+PDFObject PDFDocumentReaderObjectLoader::loadObject(PDFObjectReference reference) const
+{
+    try
+    {
+        const PDFXRefTable::Entry& entry = m_xrefTable.getEntry(reference);
+        switch (entry.type)
+        {
+            case PDFXRefTable::EntryType::Occupied:
+            {
+                ensureObjectData(entry.offset);
+
+                auto objectFetcher = [this](PDFParsingContext* context, PDFObjectReference reference) { return getObjectFromXrefTable(context, reference); };
+                PDFParsingContext context(objectFetcher);
+                PDFObjectDataRange range;
+                PDFObject object = readObject(m_source, &context, entry.offset, reference, &range);
+
+                {
+                    QMutexLocker lock(&m_objectRangeMutex);
+                    m_objectRanges[reference.objectNumber] = range;
+                }
+
+                // Encrypt dictionary is not encrypted (see processSecurityHandler)
+                if (m_securityHandler && m_securityHandler->getMode() != EncryptionMode::None && !(m_encryptObjectReference.objectNumber != 0 && m_encryptObjectReference == reference))
+                {
+                    object = m_securityHandler->decryptObject(object, reference);
+                }
+
+                return object;
+            }
+
+            case PDFXRefTable::EntryType::InObjectStream:
+            {
+                ObjectStreamPointer objectStream = getObjectStream(entry.objectStream);
+
+                auto it = objectStream->offsets.find(reference.objectNumber);
+                if (it == objectStream->offsets.cend())
+                {
+                    return PDFObject();
+                }
+
+                auto objectFetcher = [this](PDFParsingContext* context, PDFObjectReference reference) { return getObjectFromXrefTable(context, reference); };
+                PDFParsingContext context(objectFetcher);
+                PDFParsingContext::PDFParsingContextGuard guard(&context, entry.objectStream);
+                PDFParser parser(objectStream->data, &context, PDFParser::AllowStreams);
+                parser.seek(it->second);
+                return parser.getObject();
+            }
+
+            default:
+                break;
+        }
+    }
+    catch (const PDFException&)
+    {
+        // Object is invalid, so we treat it as null object
+    }
+
+    return PDFObject();
+}
+
+QByteArray PDFDocumentReaderObjectLoader::getObjectData(PDFObjectReference reference) const
+{
+    QMutexLocker lock(&m_objectRangeMutex);
+    return getObjectDataFromRange(m_source, m_objectRanges, reference);
+}
+
+void PDFDocumentReaderObjectLoader::setSecurityHandler(PDFSecurityHandlerPointer securityHandler)
+{
+    m_securityHandler = qMove(securityHandler);
+
+    const PDFObject& trailerDictionaryObject = m_xrefTable.getTrailerDictionary();
+    const PDFDictionary* trailerDictionary = nullptr;
+    if (trailerDictionaryObject.isDictionary())
+    {
+        trailerDictionary = trailerDictionaryObject.getDictionary();
+    }
+    else if (trailerDictionaryObject.isStream())
+    {
+        trailerDictionary = trailerDictionaryObject.getStream()->getDictionary();
+    }
+
+    if (trailerDictionary)
+    {
+        const PDFObject& encryptObject = trailerDictionary->get("Encrypt");
+        if (encryptObject.isReference())
+        {
+            m_encryptObjectReference = encryptObject.getReference();
+        }
+    }
+}
+
+PDFObject PDFDocumentReaderObjectLoader::readObject(const QByteArray& source, PDFParsingContext* context, PDFInteger offset, PDFObjectReference reference, PDFObjectDataRange* range)
+{
+    PDFParsingContext::PDFParsingContextGuard guard(context, reference);
+
+    PDFParser parser(source, context, PDFParser::AllowStreams);
+    parser.seek(offset);
+
+    PDFObject objectNumber = parser.getObject();
+    PDFObject generation = parser.getObject();
+
+    if (!objectNumber.isInt() || !generation.isInt())
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    if (!parser.fetchCommand(PDF_OBJECT_START_MARK))
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    PDFObject object = parser.getObject();
+    const PDFInteger endPosition = parser.lookaheadEndPosition();
+
+    if (!parser.fetchCommand(PDF_OBJECT_END_MARK))
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    PDFObjectReference scannedReference(objectNumber.getInteger(), generation.getInteger());
+    if (scannedReference != reference)
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't read object at position %1.").arg(offset));
+    }
+
+    if (range)
+    {
+        // Offset in the cross-reference table can point to whitespaces before the object
+        PDFInteger startPosition = offset;
+        while (startPosition < endPosition && PDFLexicalAnalyzer::isWhitespace(source[startPosition]))
+        {
+            ++startPosition;
+        }
+
+        range->offset = startPosition;
+        range->length = qMax(endPosition - startPosition, PDFInteger(0));
+        range->generation = reference.generation;
+    }
+
+    return object;
+}
+
+PDFObject PDFDocumentReaderObjectLoader::getObjectFromXrefTable(PDFParsingContext* context, PDFObjectReference reference) const
+{
+    const PDFXRefTable::Entry& entry = m_xrefTable.getEntry(reference);
+    if (entry.type == PDFXRefTable::EntryType::Occupied)
+    {
+        ensureObjectData(entry.offset);
+        return readObject(m_source, context, entry.offset, reference);
+    }
+
+    return PDFObject();
+}
+
+void PDFDocumentReaderObjectLoader::fetchObjects(const std::vector<PDFObjectReference>& references) const
+{
+    if (!m_sourceCache)
+    {
+        return;
+    }
+
+    std::vector<PDFRandomAccessSourceCache::Range> ranges;
+    ranges.reserve(references.size());
+
+    for (const PDFObjectReference& reference : references)
+    {
+        PDFRandomAccessSourceCache::Range range = getObjectRange(reference);
+        if (range.second > 0)
+        {
+            ranges.push_back(range);
+        }
+    }
+
+    if (!m_sourceCache->ensureRanges(ranges))
+    {
+        throw PDFException(PDFDocumentReader::tr("Can't fetch data of objects from the source."));
+    }
+}
+
+void PDFDocumentReaderObjectLoader::prefetchPageTree(const PDFObject& trailerDictionaryObject) const
+{
+    const PDFDictionary* trailerDictionary = nullptr;
+    if (trailerDictionaryObject.isDictionary())
+    {
+        trailerDictionary = trailerDictionaryObject.getDictionary();
+    }
+    else if (trailerDictionaryObject.isStream())
+    {
+        trailerDictionary = trailerDictionaryObject.getStream()->getDictionary();
+    }
+
+    if (!m_sourceCache || !trailerDictionary)
+    {
+        return;
+    }
+
+    // Returns references stored under the key of the dictionary
+    // (key can contain single reference or array of references).
+    auto addReferences = [](const PDFDictionary* dictionary, const char* key, std::vector<PDFObjectReference>& references)
+    {
+        const PDFObject& object = dictionary->get(key);
+        if (object.isReference())
+        {
+            references.push_back(object.getReference());
+        }
+        else if (object.isArray())
+        {
+            const PDFArray* array = object.getArray();
+            for (size_t i = 0, count = array->getCount(); i < count; ++i)
+            {
+                const PDFObject& item = array->getItem(i);
+                if (item.isReference())
+                {
+                    references.push_back(item.getReference());
+                }
+            }
+        }
+    };
+
+    std::set<PDFObjectReference> visited;
+    std::vector<PDFObjectReference> level;
+    addReferences(trailerDictionary, "Root", level);
+
+    while (!level.empty())
+    {
+        fetchObjects(level);
+
+        std::vector<PDFObjectReference> nextLevel;
+        for (const PDFObjectReference& reference : level)
+        {
+            if (!visited.insert(reference).second)
+            {
+                continue;
+            }
+
+            PDFObject object = loadObject(reference);
+            if (object.isDictionary())
+            {
+                // Catalog refers to the root of the page tree, page tree nodes to their kids
+                const PDFDictionary* dictionary = object.getDictionary();
+                addReferences(dictionary, "Pages", nextLevel);
+                addReferences(dictionary, "Kids", nextLevel);
+            }
+        }
+
+        nextLevel.erase(std::remove_if(nextLevel.begin(), nextLevel.end(), [&visited](const PDFObjectReference& reference) { return visited.count(reference); }), nextLevel.end());
+        level = qMove(nextLevel);
+    }
+}
+
+PDFRandomAccessSourceCache::Range PDFDocumentReaderObjectLoader::getObjectRange(PDFObjectReference reference) const
+{
+    const PDFXRefTable::Entry& entry = m_xrefTable.getEntry(reference);
+    switch (entry.type)
+    {
+        case PDFXRefTable::EntryType::Occupied:
+            return getObjectRange(entry.offset);
+
+        case PDFXRefTable::EntryType::InObjectStream:
+        {
+            const PDFXRefTable::Entry& objectStreamEntry = m_xrefTable.getEntry(entry.objectStream);
+            if (objectStreamEntry.type == PDFXRefTable::EntryType::Occupied)
+            {
+                return getObjectRange(objectStreamEntry.offset);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return PDFRandomAccessSourceCache::Range(0, 0);
+}
+
+PDFRandomAccessSourceCache::Range PDFDocumentReaderObjectLoader::getObjectRange(PDFInteger offset) const
+{
+    // Object ends, where next object starts (or at the end of the source data)
+    PDFInteger end = m_sourceCache->getSize();
+    auto it = std::upper_bound(m_objectOffsets.cbegin(), m_objectOffsets.cend(), offset);
+    if (it != m_objectOffsets.cend())
+    {
+        end = *it;
+    }
+
+    return PDFRandomAccessSourceCache::Range(offset, qMax(end - offset, PDFInteger(0)));
+}
+
+void PDFDocumentReaderObjectLoader::ensureObjectData(PDFInteger offset) const
+{
+    if (m_sourceCache)
+    {
+        const PDFRandomAccessSourceCache::Range range = getObjectRange(offset);
+        if (!m_sourceCache->ensureRange(range.first, range.second))
+        {
+            throw PDFException(PDFDocumentReader::tr("Can't fetch data of object at position %1 from the source.").arg(offset));
+        }
+    }
+}
+
+PDFDocumentReaderObjectLoader::ObjectStreamPointer PDFDocumentReaderObjectLoader::getObjectStream(PDFObjectReference reference) const
+{
+    {
+        QMutexLocker lock(&m_objectStreamMutex);
+        auto it = m_objectStreams.find(reference);
+        if (it != m_objectStreams.cend())
+        {
+            return it->second;
+        }
+    }
+
+    std::shared_ptr<ObjectStream> objectStream = std::make_shared<ObjectStream>();
+
+    PDFObject object = loadObject(reference);
+    if (!object.isStream())
+    {
+        throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(reference.objectNumber));
+    }
+
+    const PDFStream* stream = object.getStream();
+    const PDFDictionary* streamDictionary = stream->getDictionary();
+
+    const PDFObject& objectStreamType = streamDictionary->get("Type");
+    const PDFObject& nObject = streamDictionary->get("N");
+    const PDFObject& firstObject = streamDictionary->get("First");
+    if (!objectStreamType.isName() || objectStreamType.getString() != "ObjStm" || !nObject.isInt() || !firstObject.isInt())
+    {
+        throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(reference.objectNumber));
+    }
+
+    const PDFInteger n = nObject.getInteger();
+    const PDFInteger first = firstObject.getInteger();
+
+    objectStream->data = PDFStreamFilterStorage::getDecodedStream(stream, m_securityHandler.data());
+
+    PDFParsingContext context([](PDFParsingContext*, PDFObjectReference) { return PDFObject(); });
+    PDFParser parser(objectStream->data, &context, PDFParser::None);
+    for (PDFInteger i = 0; i < n; ++i)
+    {
+        PDFObject currentObjectNumber = parser.getObject();
+        PDFObject currentOffset = parser.getObject();
+
+        if (!currentObjectNumber.isInt() || !currentOffset.isInt())
+        {
+            throw PDFException(PDFTranslationContext::tr("Object stream %1 is invalid.").arg(reference.objectNumber));
+        }
+
+        objectStream->offsets.emplace(currentObjectNumber.getInteger(), currentOffset.getInteger() + first);
+    }
+
+    QMutexLocker lock(&m_objectStreamMutex);
+    auto it = m_objectStreams.emplace(reference, qMove(objectStream)).first;
+    return it->second;
+}
+
+/// Object loader of encrypted document, which was not loaded lazily. Objects are
+/// already parsed, but they are decrypted, when they are accessed for the first time,
+/// so time spent by decryption is proportional to objects, which are actually used.
+/// Each object is decrypted only once, decrypted object then replaces the encrypted one.
+class PDFDocumentReaderDecryptingObjectLoader : public PDFObjectStorageLoader
+{
+public:
+    /// Takes objects of given entries for decryption, entries of storage are
+    /// then marked as unloaded.
+    /// \param objects Objects of the storage
+    /// \param entries Entries to be decrypted on demand
+    /// \param securityHandler Security handler
+    explicit PDFDocumentReaderDecryptingObjectLoader(PDFObjectStorage::PDFObjects& objects,
+                                                     const std::vector<PDFXRefTable::Entry>& entries,
+                                                     PDFSecurityHandlerPointer securityHandler) :
+        m_entries(objects.size()),
+        m_securityHandler(qMove(securityHandler))
+    {
+        for (const PDFXRefTable::Entry& entry : entries)
+        {
+            PDFObjectStorage::Entry& storageEntry = objects[entry.reference.objectNumber];
+            m_entries[entry.reference.objectNumber].generation = storageEntry.generation;
+            m_entries[entry.reference.objectNumber].object = qMove(storageEntry.object);
+            storageEntry = PDFObjectStorage::Entry::createUnloaded(storageEntry.generation);
+        }
+    }
+
+    virtual PDFObject loadObject(PDFObjectReference reference) const override
+    {
+        if (reference.objectNumber < 0 || reference.objectNumber >= static_cast<PDFInteger>(m_entries.size()))
+        {
+            return PDFObject();
+        }
+
+        Entry& entry = m_entries[reference.objectNumber];
+        if (entry.generation != reference.generation)
+        {
+            return PDFObject();
+        }
+
+        try
+        {
+            std::call_once(entry.decrypted, [&]() { entry.object = m_securityHandler->decryptObject(entry.object, reference); });
+        }
+        catch (const PDFException&)
+        {
+            // Object can't be decrypted, so we treat it as null object
+            return PDFObject();
+        }
+
+        return entry.object;
+    }
+
+private:
+    struct Entry
+    {
+        PDFInteger generation = 0;
+        PDFObject object;
+        std::once_flag decrypted;
+    };
+
+    mutable std::vector<Entry> m_entries;
+    PDFSecurityHandlerPointer m_securityHandler;
+};
+
 PDFDocumentReader::PDFDocumentReader(PDFProgress* progress, const std::function<QString(bool*)>& getPasswordCallback, bool permissive, bool authorizeOwnerOnly) :
     m_result(Result::OK),
     m_getPasswordCallback(getPasswordCallback),
@@ -49,22 +637,32 @@ PDFDocumentReader::PDFDocumentReader(PDFProgress* progress, const std::function<
 
 PDFDocument PDFDocumentReader::readFromFile(const QString& fileName)
 {
-    QFile file(fileName);
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(fileName);
 
     reset();
 
-    if (file.exists())
+    if (file->exists())
     {
-        if (file.open(QFile::ReadOnly))
+        if (file->open(QFile::ReadOnly))
         {
-            PDFDocument document = readFromDevice(&file);
-            file.close();
+            const qint64 size = file->size();
+            uchar* data = (m_memoryMapping && size > 0) ? file->map(0, size) : nullptr;
+
+            if (data)
+            {
+                // File must remain open, closing it would also unmap the memory
+                m_mappedFile = file;
+                return readFromBuffer(QByteArray::fromRawData(reinterpret_cast<const char*>(data), size));
+            }
+
+            PDFDocument document = readFromDevice(file.get());
+            file->close();
             return document;
         }
         else
         {
             m_result = Result::Failed;
-            m_errorMessage = tr("File '%1' cannot be opened for reading. %1").arg(file.errorString());
+            m_errorMessage = tr("File '%1' cannot be opened for reading. %1").arg(file->errorString());
         }
     }
     else
@@ -108,6 +706,164 @@ PDFDocument PDFDocumentReader::readFromDevice(QIODevice* device)
     return PDFDocument();
 }
 
+PDFDocument PDFDocumentReader::readFromSource(PDFRandomAccessSourcePointer source)
+{
+    PDF_TRACE_SPAN("load", "Read document source");
+    reset();
+
+    const qint64 size = source ? source->getSize() : -1;
+    if (size <= 0)
+    {
+        m_result = Result::Failed;
+        m_errorMessage = tr("Size of the document source can't be determined.");
+        return PDFDocument();
+    }
+
+    try
+    {
+        m_sourceCache = std::make_shared<PDFRandomAccessSourceCache>(qMove(source), size);
+        if (m_sourceCache->getSize() != size)
+        {
+            throw PDFException(tr("Can't create temporary file for data of the document source."));
+        }
+
+        fetchSourceCrossReferenceData();
+    }
+    catch (const PDFException& exception)
+    {
+        m_result = Result::Failed;
+        m_errorMessage = exception.getMessage();
+        m_sourceCache.reset();
+        return PDFDocument();
+    }
+
+    // Objects must be loaded lazily, otherwise whole source would be fetched
+    PDFTemporaryValueChange<bool> lazyLoadingGuard(&m_lazyLoading, true);
+    return readFromBuffer(m_sourceCache->getData());
+}
+
+void PDFDocumentReader::fetchSourceCrossReferenceData()
+{
+    using Range = PDFRandomAccessSourceCache::Range;
+
+    const qint64 size = m_sourceCache->getSize();
+    const qint64 headerSize = qMin<qint64>(size, PDF_HEADER_SCAN_LIMIT);
+    const qint64 footerSize = qMin<qint64>(size, PDF_FOOTER_SCAN_LIMIT);
+
+    if (!m_sourceCache->ensureRanges({ Range(0, headerSize), Range(size - footerSize, footerSize) }))
+    {
+        throw PDFException(tr("Can't fetch data from the document source."));
+    }
+
+    const QByteArray buffer = m_sourceCache->getData();
+    const PDFInteger xrefTableOffset = findXrefTableOffset(buffer);
+    std::vector<Range> ranges;
+
+    // Linearization dictionary must be the first object in the file. If document
+    // is linearized, then first page section (containing first page cross-reference
+    // table) is at the beginning of the file and main cross-reference table
+    // is at the end of the file.
+    const QByteArray header = buffer.left(headerSize);
+    const int linearizedPosition = header.indexOf("/Linearized");
+    const int dictionaryStart = linearizedPosition != -1 ? header.lastIndexOf("<<", linearizedPosition) : -1;
+    if (dictionaryStart != -1)
+    {
+        try
+        {
+            PDFParsingContext context([](PDFParsingContext*, PDFObjectReference) { return PDFObject(); });
+            PDFParser parser(header, &context, PDFParser::None);
+            parser.seek(dictionaryStart);
+            PDFObject linearizationDictionaryObject = parser.getObject();
+
+            if (linearizationDictionaryObject.isDictionary())
+            {
+                const PDFDictionary* linearizationDictionary = linearizationDictionaryObject.getDictionary();
+                const PDFObject& fileLength = linearizationDictionary->get("L");
+                const PDFObject& firstPageEnd = linearizationDictionary->get("E");
+                const PDFObject& mainXRefTableOffset = linearizationDictionary->get("T");
+
+                // If file length doesn't match, then document was updated and
+                // linearization is no longer valid.
+                if (fileLength.isInt() && fileLength.getInteger() == size &&
+                    firstPageEnd.isInt() && firstPageEnd.getInteger() > 0 && firstPageEnd.getInteger() <= size &&
+                    mainXRefTableOffset.isInt() && mainXRefTableOffset.getInteger() > 0 && mainXRefTableOffset.getInteger() < size)
+                {
+                    ranges.emplace_back(0, firstPageEnd.getInteger());
+                    ranges.emplace_back(mainXRefTableOffset.getInteger(), size - mainXRefTableOffset.getInteger());
+                }
+            }
+        }
+        catch (const PDFException&)
+        {
+            // Linearization dictionary is invalid, document is treated as non-linearized
+        }
+    }
+
+    if (ranges.empty() && xrefTableOffset >= 0 && xrefTableOffset < size)
+    {
+        ranges.emplace_back(xrefTableOffset, size - xrefTableOffset);
+    }
+
+    if (!m_sourceCache->ensureRanges(ranges))
+    {
+        throw PDFException(tr("Can't fetch data from the document source."));
+    }
+
+    // Previous cross-reference tables can be anywhere in the file. We try to read
+    // cross-reference table, and if it fails, we must fetch whole document.
+    try
+    {
+        PDFXRefTable xrefTable;
+        xrefTable.readXRefTable(nullptr, buffer, xrefTableOffset);
+    }
+    catch (const PDFException&)
+    {
+        if (!m_sourceCache->ensureRange(0, size))
+        {
+            throw PDFException(tr("Can't fetch data from the document source."));
+        }
+    }
+}
+
+QByteArray PDFDocumentReader::getSourceHash(const QByteArray& buffer, const PDFXRefTable& xrefTable) const
+{
+    if (m_sourceCache && !m_sourceCache->isRangeAvailable(0, m_sourceCache->getSize()))
+    {
+        // Source data are not available completely. Without identity of the source
+        // we can't tell, if data in the middle of the file have changed, so we
+        // do not return any hash (and persistent caches are not used).
+        const QByteArray identity = m_sourceCache->getIdentity();
+        if (identity.isEmpty())
+        {
+            return QByteArray();
+        }
+
+        const int headerSize = qMin(buffer.size(), PDF_HEADER_SCAN_LIMIT);
+        const int footerSize = qMin(buffer.size(), PDF_FOOTER_SCAN_LIMIT);
+
+        QCryptographicHash sourceHash(QCryptographicHash::Sha256);
+        sourceHash.addData(QByteArray::number(buffer.size()));
+        sourceHash.addData(identity);
+        sourceHash.addData(buffer.left(headerSize));
+        sourceHash.addData(buffer.right(footerSize));
+
+        auto addEntries = [&sourceHash](const std::vector<PDFXRefTable::Entry>& entries)
+        {
+            for (const PDFXRefTable::Entry& entry : entries)
+            {
+                const PDFInteger values[] = { entry.reference.objectNumber, entry.reference.generation,
+                                              entry.objectStream.objectNumber, entry.offset, entry.indexInObjectStream };
+                sourceHash.addData(QByteArrayView(reinterpret_cast<const char*>(values), sizeof(values)));
+            }
+        };
+        addEntries(xrefTable.getOccupiedEntries());
+        addEntries(xrefTable.getObjectStreamEntries());
+        return sourceHash.result();
+    }
+
+    return hash(buffer);
+}
+
 void PDFDocumentReader::checkFooter(const QByteArray& buffer)
 {
     if (findFromEnd(PDF_END_OF_FILE_MARK, buffer, PDF_FOOTER_SCAN_LIMIT) == FIND_NOT_FOUND_RESULT)
@@ -185,106 +941,229 @@ PDFInteger PDFDocumentReader::findXrefTableOffset(const QByteArray& buffer)
     return firstXrefTableOffset;
 }
 
-PDFObject PDFDocumentReader::getObject(PDFParsingContext* context, PDFInteger offset, PDFObjectReference reference) const
+PDFObject PDFDocumentReader::getObject(PDFParsingContext* context, PDFInteger offset, PDFObjectReference reference, PDFObjectDataRange* range) const
 {
-    PDFParsingContext::PDFParsingContextGuard guard(context, reference);
+    return PDFDocumentReaderObjectLoader::readObject(m_source, context, offset, reference, range);
+}
 
-    PDFParser parser(m_source, context, PDFParser::AllowStreams);
-    parser.seek(offset);
+PDFObject PDFDocumentReader::getObjectFromXrefTable(PDFXRefTable* xrefTable, PDFParsingContext* context, PDFObjectReference reference) const
+{
+    const PDFXRefTable::Entry& entry = xrefTable->getEntry(reference);
+    switch (entry.type)
+    {
+        case PDFXRefTable::EntryType::Free:
+            return PDFObject();
 
-    PDFObject objectNumber = parser.getObject();
-    PDFObject generation = parser.getObject();
+        case PDFXRefTable::EntryType::Occupied:
+        {
+            Q_ASSERT(entry.reference == reference);
+            return getObject(context, entry.offset, reference);
+        }
 
-    if (!objectNumber.isInt() || !generation.isInt())
+        default:
+        {
+            Q_ASSERT(false);
+            break;
+        }
+    }
+
+    return PDFObject();
+}
+
+PDFObject PDFDocumentReader::readDamagedTrailerDictionary(const std::vector<int>& trailerOffsets) const
+{
+    PDFObject object = PDFObject::createDictionary(std::make_shared<PDFDictionary>(PDFDictionary()));
+    PDFParsingContext context([](PDFParsingContext*, PDFObjectReference){ return PDFObject(); });
+
+    for (const int offset : trailerOffsets)
+    {
+        // Try to read trailer dictioanry
+        try
+        {
+            PDFParser parser(m_source, &context, PDFParser::None);
+            parser.seek(offset);
+
+            PDFObject trailerDictionaryObject = parser.getObject();
+            if (trailerDictionaryObject.isDictionary())
+            {
+                object = PDFObjectManipulator::merge(object, trailerDictionaryObject, PDFObjectManipulator::RemoveNullObjects);
+            }
+        }
+        catch (const PDFException&)
+        {
+            // Do nothing...
+        }
+    }
+
+    return object;
+}
+
+std::vector<int> PDFDocumentReader::findTrailerOffsets() const
+{
+    std::vector<int> offsets;
+
+    int offset = 0;
+    while (offset < m_source.size())
     {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
+        offset = m_source.indexOf(PDF_XREF_TRAILER, offset);
+
+        if (offset == -1)
+        {
+            break;
+        }
+
+        offset += static_cast<int>(std::strlen(PDF_XREF_TRAILER));
+        offsets.push_back(offset);
     }
 
-    if (!parser.fetchCommand(PDF_OBJECT_START_MARK))
+    return offsets;
+}
+
+QString PDFDocumentReader::getDamagedDocumentIndexFileName(const QByteArray& sourceHash) const
+{
+    return QString("%1/%2-%3.idx").arg(m_indexCacheDirectory, QString::fromLatin1(sourceHash.toHex())).arg(m_source.size());
+}
+
+bool PDFDocumentReader::readDamagedDocumentIndex(const QByteArray& sourceHash, DamagedDocumentIndex& index) const
+{
+    if (m_indexCacheDirectory.isEmpty())
+    {
+        return false;
+    }
+
+    QFile file(getDamagedDocumentIndexFileName(sourceHash));
+    if (!file.open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+
+    int persistVersion = 0;
+    QByteArray storedHash;
+    qint64 sourceSize = 0;
+    stream >> persistVersion;
+    stream >> storedHash;
+    stream >> sourceSize;
+
+    if (persistVersion != DAMAGED_DOCUMENT_INDEX_PERSIST_VERSION || storedHash != sourceHash || sourceSize != m_source.size())
     {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
+        return false;
     }
 
-    PDFObject object = parser.getObject();
+    quint32 entryCount = 0;
+    stream >> entryCount;
+    index.entries.reserve(qMin(entryCount, quint32(m_source.size())));
+    for (quint32 i = 0; i < entryCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        quint8 type = 0;
+        qint64 objectNumber = 0;
+        qint64 value = 0;
+        qint64 generationOrIndex = 0;
+        stream >> type >> objectNumber >> value >> generationOrIndex;
+
+        // Index is an external data, so we must check the entries
+        if (objectNumber < 0 || objectNumber > DAMAGED_DOCUMENT_MAX_OBJECT_NUMBER || generationOrIndex < 0)
+        {
+            return false;
+        }
+
+        PDFXRefTable::Entry entry;
+        switch (static_cast<PDFXRefTable::EntryType>(type))
+        {
+            case PDFXRefTable::EntryType::Occupied:
+            {
+                if (value < 0 || value >= m_source.size() || generationOrIndex > PDF_MAX_OBJECT_GENERATION)
+                {
+                    return false;
+                }
+
+                entry.type = PDFXRefTable::EntryType::Occupied;
+                entry.reference = PDFObjectReference(objectNumber, generationOrIndex);
+                entry.offset = value;
+                break;
+            }
+
+            case PDFXRefTable::EntryType::InObjectStream:
+            {
+                if (value < 0 || value > DAMAGED_DOCUMENT_MAX_OBJECT_NUMBER || generationOrIndex > std::numeric_limits<quint32>::max())
+                {
+                    return false;
+                }
+
+                entry.type = PDFXRefTable::EntryType::InObjectStream;
+                entry.reference = PDFObjectReference(objectNumber, 0);
+                entry.objectStream = PDFObjectReference(value, 0);
+                entry.indexInObjectStream = generationOrIndex;
+                break;
+            }
 
-    if (!parser.fetchCommand(PDF_OBJECT_END_MARK))
-    {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
-    }
+            default:
+                return false;
+        }
 
-    PDFObjectReference scannedReference(objectNumber.getInteger(), generation.getInteger());
-    if (scannedReference != reference)
-    {
-        throw PDFException(tr("Can't read object at position %1.").arg(offset));
+        index.entries.push_back(entry);
     }
 
-    return object;
-}
-
-PDFObject PDFDocumentReader::getObjectFromXrefTable(PDFXRefTable* xrefTable, PDFParsingContext* context, PDFObjectReference reference) const
-{
-    const PDFXRefTable::Entry& entry = xrefTable->getEntry(reference);
-    switch (entry.type)
+    quint32 trailerOffsetCount = 0;
+    stream >> trailerOffsetCount;
+    index.trailerOffsets.reserve(trailerOffsetCount);
+    for (quint32 i = 0; i < trailerOffsetCount && stream.status() == QDataStream::Ok; ++i)
     {
-        case PDFXRefTable::EntryType::Free:
-            return PDFObject();
+        qint32 offset = 0;
+        stream >> offset;
 
-        case PDFXRefTable::EntryType::Occupied:
+        if (offset < 0 || offset > m_source.size())
         {
-            Q_ASSERT(entry.reference == reference);
-            return getObject(context, entry.offset, reference);
+            return false;
         }
 
-        default:
-        {
-            Q_ASSERT(false);
-            break;
-        }
+        index.trailerOffsets.push_back(offset);
     }
 
-    return PDFObject();
+    return stream.status() == QDataStream::Ok;
 }
 
-PDFObject PDFDocumentReader::readDamagedTrailerDictionary() const
+void PDFDocumentReader::writeDamagedDocumentIndex(const QByteArray& sourceHash, const DamagedDocumentIndex& index) const
 {
-    PDFObject object = PDFObject::createDictionary(std::make_shared<PDFDictionary>(PDFDictionary()));
-    PDFParsingContext context([](PDFParsingContext*, PDFObjectReference){ return PDFObject(); });
-
-    int offset = 0;
-    while (offset < m_source.size())
+    if (m_indexCacheDirectory.isEmpty())
     {
-        offset = m_source.indexOf(PDF_XREF_TRAILER, offset);
+        return;
+    }
 
-        if (offset == -1)
-        {
-            break;
-        }
+    QDir().mkpath(m_indexCacheDirectory);
 
-        offset += static_cast<int>(std::strlen(PDF_XREF_TRAILER));
+    QSaveFile file(getDamagedDocumentIndexFileName(sourceHash));
+    if (file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        QDataStream stream(&file);
+        stream << DAMAGED_DOCUMENT_INDEX_PERSIST_VERSION;
+        stream << sourceHash;
+        stream << qint64(m_source.size());
 
-        // Try to read trailer dictioanry
-        try
+        stream << quint32(index.entries.size());
+        for (const PDFXRefTable::Entry& entry : index.entries)
         {
-            PDFParser parser(m_source, &context, PDFParser::None);
-            parser.seek(offset);
-
-            PDFObject trailerDictionaryObject = parser.getObject();
-            if (trailerDictionaryObject.isDictionary())
-            {
-                object = PDFObjectManipulator::merge(object, trailerDictionaryObject, PDFObjectManipulator::RemoveNullObjects);
-            }
+            const bool isOccupied = entry.type == PDFXRefTable::EntryType::Occupied;
+            stream << quint8(entry.type);
+            stream << qint64(entry.reference.objectNumber);
+            stream << qint64(isOccupied ? entry.offset : entry.objectStream.objectNumber);
+            stream << qint64(isOccupied ? entry.reference.generation : entry.indexInObjectStream);
         }
-        catch (const PDFException&)
+
+        stream << quint32(index.trailerOffsets.size());
+        for (const int offset : index.trailerOffsets)
         {
-            // Do nothing...
+            stream << qint32(offset);
         }
-    }
 
-    return object;
+        file.commit();
+    }
 }
 
 PDFDocumentReader::Result PDFDocumentReader::processReferenceTableEntries(PDFXRefTable* xrefTable, const std::vector<PDFXRefTable::Entry>& occupiedEntries, PDFObjectStorage::PDFObjects& objects)
 {
+    PDF_TRACE_SPAN("load", "Read objects");
     auto objectFetcher = [this, xrefTable](PDFParsingContext* context, PDFObjectReference reference) { return getObjectFromXrefTable(xrefTable, context, reference); };
     auto processEntry = [this, &objectFetcher, &objects](const PDFXRefTable::Entry& entry)
     {
@@ -295,12 +1174,15 @@ PDFDocumentReader::Result PDFDocumentReader::processReferenceTableEntries(PDFXRe
             try
             {
                 PDFParsingContext context(objectFetcher);
-                PDFObject object = getObject(&context, entry.offset, entry.reference);
+                PDFObjectDataRange range;
+                PDFObject object = getObject(&context, entry.offset, entry.reference, &range);
 
                 progressStep();
 
-                QMutexLocker lock(&m_mutex);
-                objects[entry.reference.objectNumber] = PDFObjectStorage::Entry(entry.reference.generation, object);
+                // Each entry has unique object number and object array is already
+                // allocated, so we do not need to lock the mutex here.
+                objects[entry.reference.objectNumber] = PDFObjectStorage::Entry(entry.reference.generation, qMove(object));
+                m_objectRanges[entry.reference.objectNumber] = range;
             }
             catch (const PDFException& exception)
             {
@@ -319,6 +1201,8 @@ PDFDocumentReader::Result PDFDocumentReader::processReferenceTableEntries(PDFXRe
         }
     };
 
+    m_objectRanges.assign(objects.size(), PDFObjectDataRange());
+
     // Now, we are ready to scan all objects
     if (!occupiedEntries.empty())
     {
@@ -334,6 +1218,7 @@ PDFDocumentReader::Result PDFDocumentReader::processSecurityHandler(const PDFObj
                                                                     const std::vector<PDFXRefTable::Entry>& occupiedEntries,
                                                                     PDFObjectStorage::PDFObjects& objects)
 {
+    PDF_TRACE_SPAN("load", "Initialize security handler");
     const PDFDictionary* trailerDictionary = nullptr;
     if (trailerDictionaryObject.isDictionary())
     {
@@ -372,7 +1257,14 @@ PDFDocumentReader::Result PDFDocumentReader::processSecurityHandler(const PDFObj
         encryptObjectReference = encryptObject.getReference();
         if (static_cast<size_t>(encryptObjectReference.objectNumber) < objects.size() && objects[encryptObjectReference.objectNumber].generation == encryptObjectReference.generation)
         {
-            encryptObject = objects[encryptObjectReference.objectNumber].object;
+            PDFObjectStorage::Entry& encryptEntry = objects[encryptObjectReference.objectNumber];
+            if (!encryptEntry.isLoaded() && m_objectLoader)
+            {
+                // Encrypt dictionary is needed immediately, so we load it now
+                encryptEntry = PDFObjectStorage::Entry(encryptEntry.generation, m_objectLoader->loadObject(encryptObjectReference));
+            }
+
+            encryptObject = encryptEntry.object;
         }
     }
 
@@ -428,17 +1320,30 @@ PDFDocumentReader::Result PDFDocumentReader::processSecurityHandler(const PDFObj
 
 void PDFDocumentReader::processObjectStreams(PDFXRefTable* xrefTable, PDFObjectStorage::PDFObjects& objects)
 {
+    PDF_TRACE_SPAN("load", "Read object streams");
     // Then process object streams
     std::vector<PDFXRefTable::Entry> objectStreamEntries = xrefTable->getObjectStreamEntries();
-    std::set<PDFObjectReference> objectStreams;
+    std::set<PDFObjectReference> objectStreamSet;
+
+    // For each object number, we store object stream, in which object resides. So
+    // we can quickly check, if object in the object stream is valid.
+    std::vector<PDFObjectReference> objectStreamOfObject(objects.size(), PDFObjectReference());
     for (const PDFXRefTable::Entry& entry : objectStreamEntries)
     {
         Q_ASSERT(entry.type == PDFXRefTable::EntryType::InObjectStream);
-        objectStreams.insert(entry.objectStream);
+        objectStreamSet.insert(entry.objectStream);
+
+        if (entry.reference.objectNumber >= 0 && entry.reference.objectNumber < static_cast<PDFInteger>(objectStreamOfObject.size()))
+        {
+            objectStreamOfObject[entry.reference.objectNumber] = entry.objectStream;
+        }
     }
 
+    // Each object stream is decoded only once, object streams are processed in parallel
+    std::vector<PDFObjectReference> objectStreams(objectStreamSet.cbegin(), objectStreamSet.cend());
+
     auto objectFetcher = [this, xrefTable](PDFParsingContext* context, PDFObjectReference reference) { return getObjectFromXrefTable(xrefTable, context, reference); };
-    auto processObjectStream = [this, &objectFetcher, &objects, &objectStreamEntries] (const PDFObjectReference& objectStreamReference)
+    auto processObjectStream = [this, &objectFetcher, &objects, &objectStreamOfObject] (const PDFObjectReference& objectStreamReference)
     {
         if (m_result != Result::OK)
         {
@@ -508,10 +1413,10 @@ void PDFDocumentReader::processObjectStreams(PDFXRefTable* xrefTable, PDFObjectS
                 parser.seek(offset);
 
                 PDFObject currentObject = parser.getObject();
-                auto predicate = [objectNumber, objectStreamReference](const PDFXRefTable::Entry& entry) -> bool { return entry.reference.objectNumber == objectNumber && entry.objectStream == objectStreamReference; };
-                if (std::find_if(objectStreamEntries.cbegin(), objectStreamEntries.cend(), predicate) != objectStreamEntries.cend())
+                if (objectNumber >= 0 && objectNumber < static_cast<PDFInteger>(objectStreamOfObject.size()) && objectStreamOfObject[objectNumber] == objectStreamReference)
                 {
-                    QMutexLocker lock(&m_mutex);
+                    // Object can reside only in one object stream, so
+                    // no other thread writes to this entry.
                     objects[objectNumber].object = qMove(currentObject);
                 }
                 else
@@ -529,11 +1434,17 @@ void PDFDocumentReader::processObjectStreams(PDFXRefTable* xrefTable, PDFObjectS
     };
 
     // Now, we are ready to scan all object streams
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectStreams.cbegin(), objectStreams.cend(), processObjectStream);
+    if (!objectStreams.empty())
+    {
+        progressStart(objectStreams.size(), PDFTranslationContext::tr("Reading object streams..."));
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectStreams.cbegin(), objectStreams.cend(), [&](const PDFObjectReference& reference) { processObjectStream(reference); progressStep(); });
+        progressFinish();
+    }
 }
 
 PDFDocument PDFDocumentReader::readFromBuffer(const QByteArray& buffer)
 {
+    PDF_TRACE_SPAN("load", "Read document");
     bool shouldTryPermissiveReading = true;
 
     try
@@ -553,52 +1464,254 @@ PDFDocument PDFDocumentReader::readFromBuffer(const QByteArray& buffer)
 
         // Now, we are ready to scan xref table
         PDFXRefTable xrefTable;
-        xrefTable.readXRefTable(nullptr, buffer, firstXrefTableOffset);
+        {
+            PDF_TRACE_SPAN("load", "Read cross-reference table");
+            xrefTable.readXRefTable(nullptr, buffer, firstXrefTableOffset);
+        }
+
+        return readDocument(qMove(xrefTable), buffer, shouldTryPermissiveReading);
+    }
+    catch (const PDFException &parserException)
+    {
+        m_result = Result::Failed;
+        m_errorMessage = parserException.getMessage();
+        m_warnings << m_errorMessage;
+    }
 
-        if (xrefTable.getSize() == 0)
+    if (m_result == Result::Failed && m_permissive && shouldTryPermissiveReading)
+    {
+        // Damaged document is restored by scanning of the whole source data
+        if (m_sourceCache && !m_sourceCache->ensureRange(0, m_sourceCache->getSize()))
         {
-            throw PDFException(tr("Empty xref table."));
+            return PDFDocument();
         }
 
-        PDFObjectStorage::PDFObjects objects;
-        objects.resize(xrefTable.getSize());
+        return readDamagedDocumentFromBuffer(buffer);
+    }
+
+    return PDFDocument();
+}
+
+PDFDocument PDFDocumentReader::readDocument(PDFXRefTable xrefTable, const QByteArray& buffer, bool& shouldTryPermissiveReading)
+{
+    if (xrefTable.getSize() == 0)
+    {
+        throw PDFException(tr("Empty xref table."));
+    }
 
-        std::vector<PDFXRefTable::Entry> occupiedEntries = xrefTable.getOccupiedEntries();
+    PDFObjectStorage::PDFObjects objects;
+    objects.resize(xrefTable.getSize());
 
-        // First, process regular objects
-        if (processReferenceTableEntries(&xrefTable, occupiedEntries, objects) != Result::OK)
+    std::vector<PDFXRefTable::Entry> occupiedEntries = xrefTable.getOccupiedEntries();
+
+    if (m_lazyLoading)
+    {
+        return readLazyDocument(qMove(xrefTable), qMove(objects), occupiedEntries, buffer, shouldTryPermissiveReading);
+    }
+
+    // First, process regular objects
+    if (processReferenceTableEntries(&xrefTable, occupiedEntries, objects) != Result::OK)
+    {
+        // Do not proceed further, if document loading failed
+        return PDFDocument();
+    }
+
+    // Jakub Melka: if decryption is deferred, only object streams are decrypted
+    // now, because objects stored in them are needed immediately. Other objects
+    // are decrypted on demand, when they are accessed for the first time.
+    const PDFObject& trailerDictionaryObject = xrefTable.getTrailerDictionary();
+    const PDFDictionary* trailerDictionary = trailerDictionaryObject.isStream() ? trailerDictionaryObject.getStream()->getDictionary() : (trailerDictionaryObject.isDictionary() ? trailerDictionaryObject.getDictionary() : nullptr);
+    const PDFObject encryptObject = trailerDictionary ? trailerDictionary->get("Encrypt") : PDFObject();
+
+    std::vector<PDFXRefTable::Entry> decryptedEntries;
+    std::vector<PDFXRefTable::Entry> deferredEntries;
+    if (m_deferredDecryption && !encryptObject.isNull())
+    {
+        std::set<PDFObjectReference> objectStreams;
+        for (const PDFXRefTable::Entry& entry : xrefTable.getObjectStreamEntries())
         {
-            // Do not proceed further, if document loading failed
-            return PDFDocument();
+            objectStreams.insert(entry.objectStream);
         }
 
-        if (processSecurityHandler(xrefTable.getTrailerDictionary(), occupiedEntries, objects) == Result::Cancelled)
+        const PDFObjectReference encryptObjectReference = encryptObject.isReference() ? encryptObject.getReference() : PDFObjectReference();
+        for (const PDFXRefTable::Entry& entry : occupiedEntries)
         {
-            return PDFDocument();
+            if (objectStreams.count(entry.reference))
+            {
+                decryptedEntries.push_back(entry);
+            }
+            else if (entry.reference != encryptObjectReference && !objects[entry.reference.objectNumber].object.isNull())
+            {
+                deferredEntries.push_back(entry);
+            }
         }
+    }
+    else
+    {
+        decryptedEntries = occupiedEntries;
+    }
 
-        // We are past security inicialization. Do not attempt to restore damaged document from
-        // this point. After this point, security is decrypted. If something fails here,
-        // then document can't be restored (user can't be asked multiple times for password).
-        shouldTryPermissiveReading = !m_securityHandler || m_securityHandler->getMode() == EncryptionMode::None;
-        processObjectStreams(&xrefTable, objects);
+    if (processSecurityHandler(xrefTable.getTrailerDictionary(), decryptedEntries, objects) == Result::Cancelled)
+    {
+        return PDFDocument();
+    }
 
-        PDFObjectStorage storage(std::move(objects), PDFObject(xrefTable.getTrailerDictionary()), qMove(m_securityHandler));
-        return PDFDocument(std::move(storage), m_version, hash(buffer));
+    // We are past security inicialization. Do not attempt to restore damaged document from
+    // this point. After this point, security is decrypted. If something fails here,
+    // then document can't be restored (user can't be asked multiple times for password).
+    shouldTryPermissiveReading = !m_securityHandler || m_securityHandler->getMode() == EncryptionMode::None;
+    processObjectStreams(&xrefTable, objects);
+
+    PDFObjectStorageLoaderPointer objectLoader;
+    if (!deferredEntries.empty() && m_securityHandler && m_securityHandler->getMode() != EncryptionMode::None)
+    {
+        objectLoader = std::make_shared<PDFDocumentReaderDecryptingObjectLoader>(objects, deferredEntries, m_securityHandler);
     }
-    catch (const PDFException &parserException)
+
+    PDFObjectStorage storage(std::move(objects), PDFObject(xrefTable.getTrailerDictionary()), qMove(m_securityHandler), qMove(objectLoader));
+    if (m_objectSourceKept)
     {
-        m_result = Result::Failed;
-        m_errorMessage = parserException.getMessage();
-        m_warnings << m_errorMessage;
+        storage.setObjectSource(std::make_shared<PDFDocumentReaderObjectSource>(buffer, m_mappedFile, qMove(m_objectRanges)));
     }
+    m_objectRanges.clear();
+    return PDFDocument(std::move(storage), m_version, getSourceHash(buffer, xrefTable));
+}
 
-    if (m_result == Result::Failed && m_permissive && shouldTryPermissiveReading)
+PDFDocument PDFDocumentReader::readLazyDocument(PDFXRefTable xrefTable,
+                                                PDFObjectStorage::PDFObjects objects,
+                                                const std::vector<PDFXRefTable::Entry>& occupiedEntries,
+                                                const QByteArray& buffer,
+                                                bool& shouldTryPermissiveReading)
+{
+    PDF_TRACE_SPAN("load", "Read document lazily");
+    PDFObject trailerDictionary = xrefTable.getTrailerDictionary();
+
+    // Objects are not parsed now, so invalid entries would be silently loaded
+    // as null objects later. Damaged document must be detected here, so it can
+    // be restored (exception is handled by caller).
+    checkReferenceTableEntries(xrefTable, occupiedEntries, buffer);
+    QByteArray sourceHash = getSourceHash(buffer, xrefTable);
+
+    // Objects are not parsed now, they are parsed on demand, when they are
+    // dereferenced for the first time. We just mark them as not loaded.
+    for (const PDFXRefTable::Entry& entry : occupiedEntries)
     {
-        return readDamagedDocumentFromBuffer(buffer);
+        objects[entry.reference.objectNumber] = PDFObjectStorage::Entry::createUnloaded(entry.reference.generation);
     }
 
-    return PDFDocument();
+    for (const PDFXRefTable::Entry& entry : xrefTable.getObjectStreamEntries())
+    {
+        objects[entry.reference.objectNumber] = PDFObjectStorage::Entry::createUnloaded(entry.reference.generation);
+    }
+
+    std::shared_ptr<PDFDocumentReaderObjectLoader> objectLoader = std::make_shared<PDFDocumentReaderObjectLoader>(m_source, m_mappedFile, m_sourceCache, qMove(xrefTable));
+    m_objectLoader = objectLoader;
+
+    // Objects are decrypted by the object loader, so we do not pass occupied entries here
+    if (processSecurityHandler(trailerDictionary, std::vector<PDFXRefTable::Entry>(), objects) == Result::Cancelled)
+    {
+        m_objectLoader.reset();
+        return PDFDocument();
+    }
+
+    // Same as in regular reading, do not attempt to restore damaged document
+    // after the security handler has been initialized.
+    shouldTryPermissiveReading = !m_securityHandler || m_securityHandler->getMode() == EncryptionMode::None;
+    objectLoader->setSecurityHandler(m_securityHandler);
+    m_objectLoader.reset();
+
+    // Catalog reads the whole page tree, so fetch it in advance
+    objectLoader->prefetchPageTree(trailerDictionary);
+
+    PDFObjectStorageSourcePointer objectSource = m_objectSourceKept ? objectLoader : nullptr;
+    PDFObjectStorage storage(std::move(objects), qMove(trailerDictionary), qMove(m_securityHandler), qMove(objectLoader));
+    storage.setObjectSource(qMove(objectSource));
+    return PDFDocument(std::move(storage), m_version, qMove(sourceHash));
+}
+
+void PDFDocumentReader::checkReferenceTableEntries(const PDFXRefTable& xrefTable, const std::vector<PDFXRefTable::Entry>& occupiedEntries, const QByteArray& buffer) const
+{
+    PDF_TRACE_SPAN("load", "Check cross-reference table");
+    constexpr PDFInteger OBJECT_HEADER_SIZE = 64;
+    const PDFInteger size = buffer.size();
+
+    auto isEntryValid = [this, &buffer, size, OBJECT_HEADER_SIZE](const PDFXRefTable::Entry& entry)
+    {
+        if (entry.offset < 0 || entry.offset >= size)
+        {
+            return false;
+        }
+
+        // Data of objects are fetched from the source on demand
+        if (m_sourceCache && !m_sourceCache->isRangeAvailable(entry.offset, qMin(size - entry.offset, OBJECT_HEADER_SIZE)))
+        {
+            return true;
+        }
+
+        return isObjectHeaderValid(buffer, entry.offset, entry.reference);
+    };
+
+    for (const PDFXRefTable::Entry& entry : occupiedEntries)
+    {
+        if (!isEntryValid(entry))
+        {
+            throw PDFException(tr("Cross-reference table entry of object %1 %2 R is invalid.").arg(entry.reference.objectNumber).arg(entry.reference.generation));
+        }
+    }
+
+    for (const PDFXRefTable::Entry& entry : xrefTable.getObjectStreamEntries())
+    {
+        if (xrefTable.getEntry(entry.objectStream).type != PDFXRefTable::EntryType::Occupied)
+        {
+            throw PDFException(tr("Cross-reference table entry of object %1 %2 R is invalid.").arg(entry.reference.objectNumber).arg(entry.reference.generation));
+        }
+    }
+}
+
+bool PDFDocumentReader::isObjectHeaderValid(const QByteArray& buffer, PDFInteger offset, PDFObjectReference reference)
+{
+    const char* it = buffer.constData() + offset;
+    const char* end = buffer.constData() + buffer.size();
+
+    auto skipWhitespace = [&it, end]()
+    {
+        const char* begin = it;
+        while (it != end && PDFLexicalAnalyzer::isWhitespace(*it))
+        {
+            ++it;
+        }
+        return it != begin;
+    };
+
+    auto readNumber = [&it, end](PDFInteger& number)
+    {
+        const char* begin = it;
+        number = 0;
+        while (it != end && std::isdigit(static_cast<unsigned char>(*it)) && it - begin < 20)
+        {
+            number = number * 10 + (*it - '0');
+            ++it;
+        }
+        return it != begin;
+    };
+
+    // Offset in the cross-reference table can point to whitespaces before the object
+    PDFInteger objectNumber = 0;
+    PDFInteger generation = 0;
+    skipWhitespace();
+    if (!readNumber(objectNumber) || !skipWhitespace() || !readNumber(generation))
+    {
+        return false;
+    }
+
+    skipWhitespace();
+    const size_t objectStartMarkLength = std::strlen(PDF_OBJECT_START_MARK);
+    if (size_t(end - it) < objectStartMarkLength || std::strncmp(it, PDF_OBJECT_START_MARK, objectStartMarkLength) != 0)
+    {
+        return false;
+    }
+
+    return PDFObjectReference(objectNumber, generation) == reference;
 }
 
 QByteArray PDFDocumentReader::hash(const QByteArray& sourceData)
@@ -666,7 +1779,9 @@ std::vector<std::pair<int, int>> PDFDocumentReader::findObjectByteOffsets(const
     return offsets;
 }
 
-bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>& restoredObjects, const std::vector<std::pair<int, int>>& offsets)
+bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>& restoredObjects,
+                                       std::map<PDFObjectReference, int>& restoredObjectOffsets,
+                                       const std::vector<std::pair<int, int>>& offsets)
 {
     QMutex restoredObjectsMutex;
     std::atomic_bool succesfull = true;
@@ -710,10 +1825,14 @@ bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>&
                 PDFObjectReference reference(objectNumberObject.getInteger(), objectGenerationObject.getInteger());
                 if (reference.isValid())
                 {
+                    // If object is defined multiple times (document was updated incrementally),
+                    // then last definition is used (same object is also parsed by second pass).
                     QMutexLocker lock(&restoredObjectsMutex);
-                    if (!restoredObjects.count(reference))
+                    auto it = restoredObjectOffsets.find(reference);
+                    if (it == restoredObjectOffsets.end() || it->second <= startOffset)
                     {
                         restoredObjects[reference] = qMove(object);
+                        restoredObjectOffsets[reference] = startOffset;
                     }
                 }
             }
@@ -728,16 +1847,154 @@ bool PDFDocumentReader::restoreObjects(std::map<PDFObjectReference, PDFObject>&
     return succesfull;
 }
 
+std::vector<PDFXRefTable::Entry> PDFDocumentReader::createRestoredReferenceTableEntries(const std::map<PDFObjectReference, PDFObject>& restoredObjects,
+                                                                                         const std::map<PDFObjectReference, int>& restoredObjectOffsets,
+                                                                                         bool scanObjectStreams) const
+{
+    // Offsets of the definitions of objects. Objects stored in object streams
+    // have offset of their object stream, so the last definition wins.
+    std::map<PDFInteger, std::pair<int, PDFXRefTable::Entry>> entries;
+
+    for (const auto& item : restoredObjectOffsets)
+    {
+        PDFXRefTable::Entry entry;
+        entry.type = PDFXRefTable::EntryType::Occupied;
+        entry.reference = item.first;
+        entry.offset = item.second;
+
+        auto it = entries.find(entry.reference.objectNumber);
+        if (it == entries.end() || it->second.first <= item.second)
+        {
+            entries[entry.reference.objectNumber] = std::make_pair(item.second, entry);
+        }
+    }
+
+    if (scanObjectStreams)
+    {
+        PDFParsingContext context([](PDFParsingContext*, PDFObjectReference){ return PDFObject(); });
+
+        for (const auto& item : restoredObjects)
+        {
+            const PDFObject& object = item.second;
+            if (!object.isStream() || item.first.generation != 0)
+            {
+                continue;
+            }
+
+            const PDFStream* objectStream = object.getStream();
+            const PDFDictionary* objectStreamDictionary = objectStream->getDictionary();
+            const PDFObject& objectStreamType = objectStreamDictionary->get("Type");
+            const PDFObject& nObject = objectStreamDictionary->get("N");
+            if (!objectStreamType.isName() || objectStreamType.getString() != "ObjStm" || !nObject.isInt())
+            {
+                continue;
+            }
+
+            // Object stream contains pairs of object number and offset at the beginning
+            try
+            {
+                const int objectStreamOffset = restoredObjectOffsets.at(item.first);
+                QByteArray objectStreamData = PDFStreamFilterStorage::getDecodedStream(objectStream, nullptr);
+                PDFParser parser(objectStreamData, &context, PDFParser::None);
+
+                const PDFInteger n = nObject.getInteger();
+                for (PDFInteger i = 0; i < n; ++i)
+                {
+                    PDFObject currentObjectNumber = parser.getObject();
+                    PDFObject currentOffset = parser.getObject();
+
+                    if (!currentObjectNumber.isInt() || !currentOffset.isInt())
+                    {
+                        break;
+                    }
+
+                    const PDFInteger objectNumber = currentObjectNumber.getInteger();
+                    if (objectNumber < 0 || objectNumber > DAMAGED_DOCUMENT_MAX_OBJECT_NUMBER)
+                    {
+                        continue;
+                    }
+
+                    PDFXRefTable::Entry entry;
+                    entry.type = PDFXRefTable::EntryType::InObjectStream;
+                    entry.reference = PDFObjectReference(objectNumber, 0);
+                    entry.objectStream = item.first;
+                    entry.indexInObjectStream = i;
+
+                    auto it = entries.find(objectNumber);
+                    if (it == entries.end() || it->second.first < objectStreamOffset)
+                    {
+                        entries[objectNumber] = std::make_pair(objectStreamOffset, entry);
+                    }
+                }
+            }
+            catch (const PDFException&)
+            {
+                // Object stream is damaged, objects stored in it can't be restored
+            }
+        }
+    }
+
+    std::vector<PDFXRefTable::Entry> result;
+    result.reserve(entries.size());
+    for (const auto& item : entries)
+    {
+        result.push_back(item.second.second);
+    }
+
+    return result;
+}
+
 PDFDocument PDFDocumentReader::readDamagedDocumentFromBuffer(const QByteArray& buffer)
 {
+    PDF_TRACE_SPAN("load", "Restore damaged document");
+
+    // Try to use index of the document from previous restoration, if it exists.
+    // It contains reference table rebuilt from the objects, so document is read
+    // as a regular document (lazily, if lazy loading is enabled), no scan is needed.
+    const QByteArray sourceHash = !m_indexCacheDirectory.isEmpty() ? hash(buffer) : QByteArray();
+
+    DamagedDocumentIndex index;
+    if (readDamagedDocumentIndex(sourceHash, index))
+    {
+        bool shouldTryPermissiveReading = true;
+
+        try
+        {
+            m_result = Result::OK;
+
+            PDFObject trailerDictionaryObject = readDamagedTrailerDictionary(index.trailerOffsets);
+            PDFDocument document = readDocument(PDFXRefTable::createFromEntries(index.entries, qMove(trailerDictionaryObject)), buffer, shouldTryPermissiveReading);
+
+            if (m_result != Result::Failed)
+            {
+                return document;
+            }
+        }
+        catch (const PDFException &parserException)
+        {
+            m_result = Result::Failed;
+            m_warnings << parserException.getMessage();
+        }
+
+        if (!shouldTryPermissiveReading)
+        {
+            // Security handler was already initialized, user can't be asked for password again
+            return PDFDocument();
+        }
+
+        m_securityHandler.reset();
+    }
+
     try
     {
         m_result = Result::OK;
 
         // Try to reconstruct trailer dictionary
         std::map<PDFObjectReference, PDFObject> restoredObjects;
+        std::map<PDFObjectReference, int> restoredObjectOffsets;
 
-        PDFObject trailerDictionaryObject = readDamagedTrailerDictionary();
+        index.trailerOffsets = findTrailerOffsets();
+        PDFObject trailerDictionaryObject = readDamagedTrailerDictionary(index.trailerOffsets);
         if (!trailerDictionaryObject.isDictionary())
         {
             throw PDFException(PDFTranslationContext::tr("Trailer dictionary is not valid."));
@@ -745,26 +2002,36 @@ PDFDocument PDFDocumentReader::readDamagedDocumentFromBuffer(const QByteArray& b
 
         // Jakub Melka: Try to parse objects - read offsets of objects. We must probably
         // try second pass, if some streams have referenced objects.
-        std::vector<std::pair<int, int>> offsets = findObjectByteOffsets(buffer);
-        if (!restoreObjects(restoredObjects, offsets))
+        const std::vector<std::pair<int, int>> offsets = findObjectByteOffsets(buffer);
+        if (!restoreObjects(restoredObjects, restoredObjectOffsets, offsets))
         {
-            restoreObjects(restoredObjects, offsets);
+            restoreObjects(restoredObjects, restoredObjectOffsets, offsets);
         }
 
+        // Rebuild reference table from restored objects, so next time the document
+        // can be read without the scan. Object streams of encrypted document
+        // can't be decoded before security handler is initialized, so objects
+        // stored in them are not restored.
+        const bool isEncrypted = trailerDictionaryObject.getDictionary()->hasKey("Encrypt");
+        index.entries = createRestoredReferenceTableEntries(restoredObjects, restoredObjectOffsets, !isEncrypted);
+        writeDamagedDocumentIndex(sourceHash, index);
+
         // We will create security handler.
         PDFObjectStorage::PDFObjects objects;
         std::vector<PDFXRefTable::Entry> occupiedEntries;
 
-        if (!restoredObjects.empty())
+        if (!index.entries.empty())
         {
-            objects.resize(restoredObjects.rbegin()->first.objectNumber + 1);
+            objects.resize(index.entries.back().reference.objectNumber + 1);
 
-            for (auto& objectItem : restoredObjects)
+            for (const PDFXRefTable::Entry& xrefEntry : index.entries)
             {
-                PDFObjectReference reference = objectItem.first;
-                PDFObjectStorage::Entry& entry = objects[reference.objectNumber];
-                entry.generation = reference.generation;
-                entry.object = qMove(objectItem.second);
+                if (xrefEntry.type == PDFXRefTable::EntryType::Occupied)
+                {
+                    PDFObjectStorage::Entry& entry = objects[xrefEntry.reference.objectNumber];
+                    entry.generation = xrefEntry.reference.generation;
+                    entry.object = qMove(restoredObjects[xrefEntry.reference]);
+                }
             }
         }
 
@@ -773,6 +2040,17 @@ PDFDocument PDFDocumentReader::readDamagedDocumentFromBuffer(const QByteArray& b
             return PDFDocument();
         }
 
+        // Objects stored in object streams are read from restored object streams
+        PDFXRefTable xrefTable = PDFXRefTable::createFromEntries(index.entries, trailerDictionaryObject);
+        processObjectStreams(&xrefTable, objects);
+        if (m_result == Result::Failed)
+        {
+            // Damaged object stream is not a reason to fail restoration of the document
+            m_warnings << m_errorMessage;
+            m_errorMessage.clear();
+            m_result = Result::OK;
+        }
+
         PDFObjectStorage storage(std::move(objects), PDFObject(trailerDictionaryObject), qMove(m_securityHandler));
         return PDFDocument(std::move(storage), m_version, QByteArray());
     }
@@ -792,6 +2070,10 @@ void PDFDocumentReader::reset()
     m_version = PDFVersion();
     m_source = QByteArray();
     m_securityHandler = nullptr;
+    m_objectLoader.reset();
+    m_mappedFile.reset();
+    m_sourceCache.reset();
+    m_objectRanges.clear();
 }
 
 int PDFDocumentReader::findFromEnd(const char* what, const QByteArray& byteArray, int limit)
@@ -23,15 +23,26 @@
 #include "pdfdocument.h"
 #include "pdfprogress.h"
 #include "pdfxreftable.h"
+#include "pdfrandomaccesssource.h"
 
 #include <QMutex>
 #include <QIODevice>
 
+class QFile;
+
 namespace pdf
 {
 class PDFXRefTable;
 class PDFParsingContext;
 
+/// Range of the original data of the object in the source data of the document
+struct PDFObjectDataRange
+{
+    PDFInteger offset = 0;
+    PDFInteger length = 0;
+    PDFInteger generation = 0;
+};
+
 /// This class is a reader of PDF document from various devices (file, io device,
 /// byte buffer). This class doesn't throw exceptions, to check errors, use
 /// appropriate functions.
@@ -69,22 +80,97 @@ public:
     /// PDF is read, then empty PDF document is returned. No exception is thrown.
     PDFDocument readFromBuffer(const QByteArray& buffer);
 
+    /// Reads a PDF document from the random access source. Source data are
+    /// not read at once, but they are fetched on demand. Objects are always
+    /// loaded lazily, their data are fetched from the source before they are
+    /// parsed. If document is linearized, then first page section is fetched
+    /// at once. If incorrect PDF is read, then empty PDF document is returned.
+    /// No exception is thrown.
+    /// \param source Random access source
+    PDFDocument readFromSource(PDFRandomAccessSourcePointer source);
+
     /// Returns result code for reading document from the device
     Result getReadingResult() const { return m_result; }
 
     /// Returns error message, if document reading was unsuccessfull
     const QString& getErrorMessage() const { return m_errorMessage; }
 
-    /// Get source data of the document
+    /// Get source data of the document. If memory mapping is used, then
+    /// returned data are valid only during the lifetime of the reader (or
+    /// of the document, if lazy loading is used). Call QByteArray::detach
+    /// to obtain a deep copy of the data.
     const QByteArray& getSource() const { return m_source; }
 
     /// Returns warning messages
     const QStringList& getWarnings() const { return m_warnings; }
 
+    /// Returns true, if lazy loading is enabled
+    bool isLazyLoading() const { return m_lazyLoading; }
+
+    /// Enables or disables lazy loading. If lazy loading is enabled, then objects
+    /// are not parsed when document is being read, but they are parsed on demand,
+    /// when they are dereferenced for the first time. Errors in objects are not
+    /// reported as warnings in this mode, invalid objects are treated as null objects.
+    /// \param lazyLoading Enable lazy loading
+    void setLazyLoading(bool lazyLoading) { m_lazyLoading = lazyLoading; }
+
+    /// Returns true, if memory mapping of files is enabled
+    bool isMemoryMapping() const { return m_memoryMapping; }
+
+    /// Enables or disables memory mapping of files. If memory mapping is enabled,
+    /// then file being read is mapped into memory instead of reading its content
+    /// into the heap. File is held open and mapped until the reader is destroyed,
+    /// or until the document is destroyed (if lazy loading is used). File must
+    /// not be modified during this time. If file can't be mapped, then it is read
+    /// as usual.
+    /// \param memoryMapping Enable memory mapping
+    void setMemoryMapping(bool memoryMapping) { m_memoryMapping = memoryMapping; }
+
+    /// Returns true, if decryption of objects is deferred
+    bool isDeferredDecryption() const { return m_deferredDecryption; }
+
+    /// Enables or disables deferred decryption of objects of encrypted document. If
+    /// enabled, objects (strings and streams) are not decrypted when document is being
+    /// read, but they are decrypted on demand, when they are accessed for the first time.
+    /// Errors in decryption are not reported in this mode, objects, which can't be
+    /// decrypted, are treated as null objects. Lazily loaded objects are always
+    /// decrypted on demand.
+    /// \param deferredDecryption Enable deferred decryption
+    void setDeferredDecryption(bool deferredDecryption) { m_deferredDecryption = deferredDecryption; }
+
+    /// Returns true, if original data of objects are kept with the document
+    bool isObjectSourceKept() const { return m_objectSourceKept; }
+
+    /// Enables or disables keeping of original data of objects with the document.
+    /// If enabled, objects, which are not modified, are written using their original
+    /// data, without being serialized again. Source data of the document are then
+    /// held by the document, so memory consumption is higher, unless the file is
+    /// memory mapped or lazy loading is used (then source data are held anyway).
+    /// \param objectSourceKept Keep original data of objects
+    void setObjectSourceKept(bool objectSourceKept) { m_objectSourceKept = objectSourceKept; }
+
+    /// Returns directory, where indices of damaged documents are stored
+    const QString& getIndexCacheDirectory() const { return m_indexCacheDirectory; }
+
+    /// Sets directory, where indices of damaged documents are stored. When damaged
+    /// document is being restored, objects and trailer dictionaries are found by
+    /// scanning the whole document. Reference table rebuilt from this scan (including
+    /// objects stored in object streams) is stored in the index cache directory, keyed
+    /// by hash and size of the document, so repeated opening of the same document skips
+    /// the scan and document is read as a regular one. If directory is empty,
+    /// then index cache is not used.
+    /// \param indexCacheDirectory Index cache directory
+    void setIndexCacheDirectory(const QString& indexCacheDirectory) { m_indexCacheDirectory = indexCacheDirectory; }
+
     static QByteArray hash(const QByteArray& sourceData);
 
 private:
     static constexpr const int FIND_NOT_FOUND_RESULT = -1;
+    static constexpr const int DAMAGED_DOCUMENT_INDEX_PERSIST_VERSION = 2;
+
+    /// Maximal object number of restored objects (implementation limit of PDF 1.7),
+    /// it protects against huge allocations caused by garbage in damaged documents.
+    static constexpr const PDFInteger DAMAGED_DOCUMENT_MAX_OBJECT_NUMBER = 8388607;
 
     /// Resets the internal state and prepares it for new reading cycle
     void reset();
@@ -98,6 +184,18 @@ private:
     /// \returns Position of string, or FIND_NOT_FOUND_RESULT
     int findFromEnd(const char* what, const QByteArray& byteArray, int limit);
 
+    /// Returns hash of the source data. If source cache is used and source
+    /// data are not fetched completely, then identity of the source, header,
+    /// footer and all cross-reference table entries are hashed. If source
+    /// has no identity, empty hash is returned.
+    /// \param buffer Source data
+    /// \param xrefTable Cross-reference table of the document
+    QByteArray getSourceHash(const QByteArray& buffer, const PDFXRefTable& xrefTable) const;
+
+    /// Fetches data of the document from the source cache, which are needed to read
+    /// cross-reference table. Can throw exception.
+    void fetchSourceCrossReferenceData();
+
     void checkFooter(const QByteArray& buffer);
     void checkHeader(const QByteArray& buffer);
     PDFInteger findXrefTableOffset(const QByteArray& buffer);
@@ -105,25 +203,106 @@ private:
     Result processSecurityHandler(const PDFObject& trailerDictionaryObject, const std::vector<PDFXRefTable::Entry>& occupiedEntries, PDFObjectStorage::PDFObjects& objects);
     void processObjectStreams(PDFXRefTable* xrefTable, PDFObjectStorage::PDFObjects& objects);
 
+    /// Creates document from the cross-reference table (objects are read from the source
+    /// data, or they are loaded on demand, if lazy loading is enabled). Can throw exception.
+    /// \param xrefTable Cross-reference table
+    /// \param buffer Source data
+    /// \param[out] shouldTryPermissiveReading Can damaged document be restored, if error occurs?
+    PDFDocument readDocument(PDFXRefTable xrefTable, const QByteArray& buffer, bool& shouldTryPermissiveReading);
+
+    /// Creates document, whose objects are loaded on demand from the source data.
+    /// Only security handler is processed immediately. Can throw exception.
+    /// \param xrefTable Cross-reference table
+    /// \param objects Object entries (resized to the size of xref table)
+    /// \param occupiedEntries Occupied entries of the xref table
+    /// \param buffer Source data
+    /// \param[out] shouldTryPermissiveReading Can damaged document be restored, if error occurs?
+    PDFDocument readLazyDocument(PDFXRefTable xrefTable,
+                                 PDFObjectStorage::PDFObjects objects,
+                                 const std::vector<PDFXRefTable::Entry>& occupiedEntries,
+                                 const QByteArray& buffer,
+                                 bool& shouldTryPermissiveReading);
+
+    /// Checks, that occupied entries of the cross-reference table point to the
+    /// objects in the source data, so damaged documents are detected, even if
+    /// objects are loaded lazily. Offsets of objects, whose data are not fetched
+    /// yet (source cache is used), are only checked to be in range. Throws
+    /// exception, if some entry is invalid.
+    /// \param xrefTable Cross-reference table
+    /// \param occupiedEntries Occupied entries of the xref table
+    /// \param buffer Source data
+    void checkReferenceTableEntries(const PDFXRefTable& xrefTable, const std::vector<PDFXRefTable::Entry>& occupiedEntries, const QByteArray& buffer) const;
+
+    /// Returns true, if object header of the object (object number, generation
+    /// number and keyword obj) is at given offset of the source data.
+    /// \param buffer Source data
+    /// \param offset Offset of the object
+    /// \param reference Reference of the object
+    static bool isObjectHeaderValid(const QByteArray& buffer, PDFInteger offset, PDFObjectReference reference);
+
     /// This function fetches object from the buffer from the specified offset.
     /// Can throw exception, returns a pair of scanned reference and object content.
     /// \param context Context
     /// \param offset Offset
     /// \param reference Reference to parsed object
-    PDFObject getObject(PDFParsingContext* context, PDFInteger offset, PDFObjectReference reference) const;
+    /// \param[out] range Range of object's data in the source data (can be nullptr)
+    PDFObject getObject(PDFParsingContext* context, PDFInteger offset, PDFObjectReference reference, PDFObjectDataRange* range = nullptr) const;
 
     /// Tries to restore objects from object list. This function can be used in multiple pass, because
     /// for example streams, can have length defined in referred object. If such is the case, then
     /// second pass is needed. Returns true, if all object were correctly read.
+    /// If object is defined multiple times, the last definition is used.
     /// \param restoredObjects Map of restored objects
+    /// \param restoredObjectOffsets Offsets of restored objects
     /// \param offsets Offsets, from which are objects being read
-    bool restoreObjects(std::map<PDFObjectReference, PDFObject>& restoredObjects, const std::vector<std::pair<int, int>>& offsets);
+    bool restoreObjects(std::map<PDFObjectReference, PDFObject>& restoredObjects,
+                        std::map<PDFObjectReference, int>& restoredObjectOffsets,
+                        const std::vector<std::pair<int, int>>& offsets);
+
+    /// Rebuilds entries of the cross-reference table from restored objects. Objects
+    /// stored in object streams are found by scanning of restored object streams.
+    /// If object is defined multiple times, the last definition is used.
+    /// \param restoredObjects Map of restored objects
+    /// \param restoredObjectOffsets Offsets of restored objects
+    /// \param scanObjectStreams Find objects stored in object streams
+    std::vector<PDFXRefTable::Entry> createRestoredReferenceTableEntries(const std::map<PDFObjectReference, PDFObject>& restoredObjects,
+                                                                        const std::map<PDFObjectReference, int>& restoredObjectOffsets,
+                                                                        bool scanObjectStreams) const;
 
     /// Fetch object from reference table
     PDFObject getObjectFromXrefTable(PDFXRefTable* xrefTable, PDFParsingContext* context, PDFObjectReference reference) const;
 
     /// Tries to read damaged trailer dictionary
-    PDFObject readDamagedTrailerDictionary() const;
+    /// \param trailerOffsets Offsets of trailer dictionaries
+    PDFObject readDamagedTrailerDictionary(const std::vector<int>& trailerOffsets) const;
+
+    /// Finds offsets of all trailer dictionaries (i.e. offsets just
+    /// after the trailer keyword) in the source data.
+    std::vector<int> findTrailerOffsets() const;
+
+    /// Index of damaged document, it contains reference table rebuilt from
+    /// the objects and offsets of trailer dictionaries found during scan
+    /// of the document.
+    struct DamagedDocumentIndex
+    {
+        std::vector<PDFXRefTable::Entry> entries;
+        std::vector<int> trailerOffsets;
+    };
+
+    /// Returns file name of the damaged document index
+    /// \param sourceHash Hash of the document source data
+    QString getDamagedDocumentIndexFileName(const QByteArray& sourceHash) const;
+
+    /// Tries to read index of damaged document from the index cache directory.
+    /// Returns true, if index was found and is valid for the source data.
+    /// \param sourceHash Hash of the document source data
+    /// \param index Index
+    bool readDamagedDocumentIndex(const QByteArray& sourceHash, DamagedDocumentIndex& index) const;
+
+    /// Writes index of damaged document to the index cache directory
+    /// \param sourceHash Hash of the document source data
+    /// \param index Index
+    void writeDamagedDocumentIndex(const QByteArray& sourceHash, const DamagedDocumentIndex& index) const;
 
     /// Attempts to read a damaged PDF document from the specified buffer (byte array). If incorrect
     /// PDF is read, then empty PDF document is returned. No exception is thrown.
@@ -174,6 +353,33 @@ private:
 
     /// Warnings
     QStringList m_warnings;
+
+    /// Load objects on demand, when they are dereferenced for the first time
+    bool m_lazyLoading = false;
+
+    /// Object loader used during lazy document reading
+    std::shared_ptr<PDFObjectStorageLoader> m_objectLoader;
+
+    /// Map files into memory instead of reading them
+    bool m_memoryMapping = false;
+
+    /// Decrypt objects on demand, when they are accessed for the first time
+    bool m_deferredDecryption = true;
+
+    /// Keep original data of objects with the document
+    bool m_objectSourceKept = false;
+
+    /// Ranges of objects' data in the source data (indexed by object number)
+    std::vector<PDFObjectDataRange> m_objectRanges;
+
+    /// File, which is memory mapped and whose data are used as source data
+    std::shared_ptr<QFile> m_mappedFile;
+
+    /// Cache of the random access source, whose data are used as source data
+    PDFRandomAccessSourceCachePointer m_sourceCache;
+
+    /// Directory for storing indices of damaged documents
+    QString m_indexCacheDirectory;
 };
 
 }   // namespace pdf
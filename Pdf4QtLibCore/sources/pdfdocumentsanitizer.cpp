@@ -18,8 +18,11 @@
 #include "pdfdocumentsanitizer.h"
 #include "pdfvisitor.h"
 #include "pdfexecutionpolicy.h"
-#include "pdfoptimizer.h"
 #include "pdfdocumentbuilder.h"
+#include "pdfobjectutils.h"
+#include "pdfannotation.h"
+#include "pdfutils.h"
+#include "pdfpage.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -112,11 +115,9 @@ void PDFDocumentSanitizer::sanitize()
         performSanitizePageThumbnails();
     }
 
-    // Optimize - remove unused objects
-    PDFOptimizer optimizer(PDFOptimizer::OptimizationFlags(PDFOptimizer::RemoveUnusedObjects | PDFOptimizer::ShrinkObjectStorage | PDFOptimizer::RemoveNullObjects), nullptr);
-    optimizer.setStorage(m_storage);
-    optimizer.optimize();
-    m_storage = optimizer.takeStorage();
+    // Removed content can still be present in objects, which are no longer
+    // referenced (for example, metadata streams), so remove unused objects.
+    performRemoveUnusedObjects();
 
     Q_EMIT sanitizationFinished();
 }
@@ -133,49 +134,74 @@ void PDFDocumentSanitizer::setFlags(SanitizationFlags flags)
 
 void PDFDocumentSanitizer::performSanitizeDocumentInfo()
 {
-    PDFObjectReference emptyDocumentInfoReference = m_storage.addObject(PDFObject());
-
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    const bool hasDocumentInfo = builder.getDocumentInfo().isValid();
-    builder.setDocumentInfo(emptyDocumentInfoReference);
-    PDFDocument document = builder.build();
-    m_storage = document.getStorage();
+    const PDFDictionary* trailerDictionary = m_storage.getDictionaryFromObject(m_storage.getTrailerDictionary());
+    const bool hasDocumentInfo = trailerDictionary && trailerDictionary->hasKey("Info");
 
     if (hasDocumentInfo)
     {
+        PDFObjectFactory factory;
+        factory.beginDictionary();
+        factory.beginDictionaryItem("Info");
+        factory << PDFObject();
+        factory.endDictionaryItem();
+        factory.endDictionary();
+        m_storage.updateTrailerDictionary(factory.takeObject());
         Q_EMIT sanitizationProgress(tr("Document info was removed."));
     }
 }
 
 void PDFDocumentSanitizer::performSanitizeMetadata()
 {
+    // Unused objects are removed anyway, so we process only used objects,
+    // and objects of lazily loaded document, which are not used, are not loaded.
+    std::set<PDFObjectReference> usedReferences = PDFObjectUtils::getReferences({ m_storage.getTrailerDictionary() }, m_storage);
+    std::vector<PDFObjectReference> references(usedReferences.cbegin(), usedReferences.cend());
+    std::vector<PDFObject> updatedObjects(references.size());
     std::atomic<PDFInteger> counter = 0;
 
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
+    auto processObject = [this, &references, &updatedObjects, &counter](size_t i)
     {
-        PDFRemoveMetadataVisitor visitor(&m_storage, &counter);
-        entry.object.accept(&visitor);
-        entry.object = visitor.getObject();
+        std::atomic<PDFInteger> objectCounter = 0;
+        PDFRemoveMetadataVisitor visitor(&m_storage, &objectCounter);
+        m_storage.getObjectByReference(references[i]).accept(&visitor);
+
+        if (objectCounter > 0)
+        {
+            updatedObjects[i] = visitor.getObject();
+            counter += objectCounter;
+        }
     };
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
+    PDFIntegerRange<size_t> indices(0, references.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, indices.begin(), indices.end(), processObject);
+
+    // Only objects, from which metadata were removed, are modified
+    for (size_t i = 0; i < references.size(); ++i)
+    {
+        if (!updatedObjects[i].isNull())
+        {
+            m_storage.setObject(references[i], qMove(updatedObjects[i]));
+        }
+    }
+
     Q_EMIT sanitizationProgress(tr("Metadata streams removed: %1").arg(counter));
 }
 
 void PDFDocumentSanitizer::performSanitizeOutline()
 {
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    PDFObject catalogObject = builder.getObjectByReference(builder.getCatalogReference());
-    const PDFDictionary* catalogDictionary = builder.getDictionaryFromObject(catalogObject);
+    const PDFObjectReference catalogReference = getCatalogReference();
+    const PDFDictionary* catalogDictionary = m_storage.getDictionaryFromObject(m_storage.getObjectByReference(catalogReference));
     const bool hasOutline = catalogDictionary && catalogDictionary->hasKey("Outlines");
 
     if (hasOutline)
     {
-        builder.removeOutline();
-        PDFDocument document = builder.build();
-        m_storage = document.getStorage();
+        PDFObjectFactory factory;
+        factory.beginDictionary();
+        factory.beginDictionaryItem("Outlines");
+        factory << PDFObject();
+        factory.endDictionaryItem();
+        factory.endDictionary();
+        mergeTo(catalogReference, factory.takeObject());
         Q_EMIT sanitizationProgress(tr("Outline was removed."));
     }
 }
@@ -189,65 +215,17 @@ void PDFDocumentSanitizer::performSanitizeFileAttachments()
     removeAnnotations(filter, tr("File attachments removed: %1."));
 
     // Remove files in name tree
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    PDFObject catalogObject = builder.getObjectByReference(builder.getCatalogReference());
-    const PDFDictionary* catalogDictionary = builder.getDictionaryFromObject(catalogObject);
-    const bool hasNames = catalogDictionary && catalogDictionary->hasKey("Names");
-
-    if (hasNames)
+    if (removeCatalogSubdictionaryEntry("Names", "EmbeddedFiles"))
     {
-        PDFObject namesObject = builder.getObject(catalogDictionary->get("Names"));
-        const PDFDictionary* namesDictionary = builder.getDictionaryFromObject(namesObject);
-        if (namesDictionary->hasKey("EmbeddedFiles"))
-        {
-            PDFDictionary dictionaryCopy = *namesDictionary;
-            dictionaryCopy.setEntry(PDFInplaceOrMemoryString("EmbeddedFiles"), PDFObject());
-            namesObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(dictionaryCopy)));
-
-            PDFObjectFactory factory;
-            factory.beginDictionary();
-            factory.beginDictionaryItem("Names");
-            factory << namesObject;
-            factory.endDictionaryItem();
-            factory.endDictionary();
-            PDFObject newCatalog = factory.takeObject();
-            builder.mergeTo(builder.getCatalogReference(), std::move(newCatalog));
-            PDFDocument document = builder.build();
-            m_storage = document.getStorage();
-            Q_EMIT sanitizationProgress(tr("Embedded files were removed."));
-        }
+        Q_EMIT sanitizationProgress(tr("Embedded files were removed."));
     }
 }
 
 void PDFDocumentSanitizer::performSanitizeEmbeddedSearchIndex()
 {
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    PDFObject catalogObject = builder.getObjectByReference(builder.getCatalogReference());
-    const PDFDictionary* catalogDictionary = builder.getDictionaryFromObject(catalogObject);
-    const bool hasPieceInfo = catalogDictionary && catalogDictionary->hasKey("PieceInfo");
-
-    if (hasPieceInfo)
+    if (removeCatalogSubdictionaryEntry("PieceInfo", "SearchIndex"))
     {
-        PDFObject pieceInfoObject = builder.getObject(catalogDictionary->get("PieceInfo"));
-        const PDFDictionary* pieceInfoDictionary = builder.getDictionaryFromObject(pieceInfoObject);
-        if (pieceInfoDictionary->hasKey("SearchIndex"))
-        {
-            PDFDictionary dictionaryCopy = *pieceInfoDictionary;
-            dictionaryCopy.setEntry(PDFInplaceOrMemoryString("SearchIndex"), PDFObject());
-            pieceInfoObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(dictionaryCopy)));
-
-            PDFObjectFactory factory;
-            factory.beginDictionary();
-            factory.beginDictionaryItem("PieceInfo");
-            factory << pieceInfoObject;
-            factory.endDictionaryItem();
-            factory.endDictionary();
-            PDFObject newCatalog = factory.takeObject();
-            builder.mergeTo(builder.getCatalogReference(), std::move(newCatalog));
-            PDFDocument document = builder.build();
-            m_storage = document.getStorage();
-            Q_EMIT sanitizationProgress(tr("Search index was removed."));
-        }
+        Q_EMIT sanitizationProgress(tr("Search index was removed."));
     }
 }
 
@@ -262,76 +240,215 @@ void PDFDocumentSanitizer::performSanitizeMarkupAnnotations()
 
 void PDFDocumentSanitizer::performSanitizePageThumbnails()
 {
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    builder.flattenPageTree();
-    std::vector<PDFObjectReference> pageReferences = builder.getPages();
-    std::vector<PDFObjectReference> pagesWithThumbnail;
+    size_t removedThumbnailCount = 0;
 
-    for (const PDFObjectReference& pageReference : pageReferences)
+    for (const PDFObjectReference& pageReference : getPageReferences())
     {
-        const PDFDictionary* pageDictionary = builder.getDictionaryFromObject(builder.getObjectByReference(pageReference));
+        const PDFDictionary* pageDictionary = m_storage.getDictionaryFromObject(m_storage.getObjectByReference(pageReference));
         if (pageDictionary && pageDictionary->hasKey("Thumb"))
         {
-            pagesWithThumbnail.push_back(pageReference);
+            PDFObjectFactory factory;
+            factory.beginDictionary();
+            factory.beginDictionaryItem("Thumb");
+            factory << PDFObject();
+            factory.endDictionaryItem();
+            factory.endDictionary();
+            mergeTo(pageReference, factory.takeObject());
+            ++removedThumbnailCount;
         }
     }
 
-    if (!pagesWithThumbnail.empty())
+    if (removedThumbnailCount > 0)
+    {
+        Q_EMIT sanitizationProgress(tr("Page thumbnails removed: %1.").arg(removedThumbnailCount));
+    }
+}
+
+void PDFDocumentSanitizer::performRemoveUnusedObjects()
+{
+    // Jakub Melka: we do not renumber objects (as optimizer does, when shrinking
+    // object storage), because then all objects would be modified, and they
+    // couldn't be written using their original data.
+    std::set<PDFObjectReference> usedReferences = PDFObjectUtils::getReferences({ m_storage.getTrailerDictionary() }, m_storage);
+
+    for (const PDFObjectReference& reference : m_storage.getObjectReferences())
     {
-        for (const auto& pageReference : pagesWithThumbnail)
+        if (!usedReferences.count(reference))
         {
-            builder.removePageThumbnail(pageReference);
+            m_storage.setObject(reference, PDFObject());
         }
-
-        PDFDocument document = builder.build();
-        m_storage = document.getStorage();
-        Q_EMIT sanitizationProgress(tr("Page thumbnails removed: %1.").arg(pagesWithThumbnail.size()));
     }
 }
 
 void PDFDocumentSanitizer::removeAnnotations(const std::function<bool (const PDFAnnotation*)>& filter,
                                              QString message)
 {
-    PDFDocumentBuilder builder(m_storage, PDFVersion(2, 0));
-    builder.flattenPageTree();
-    std::vector<PDFObjectReference> pageReferences = builder.getPages();
-    std::vector<std::pair<PDFObjectReference, PDFObjectReference>> annotationsToBeRemoved;
+    struct PageEdit
+    {
+        PDFObject pageObject;
+        std::vector<PDFObjectReference> annotationsToBeRemoved;
+    };
 
-    PDFDocumentDataLoaderDecorator loader(&m_storage);
-    for (const PDFObjectReference pageReference : pageReferences)
+    const std::vector<PDFObjectReference> pageReferences = getPageReferences();
+    std::vector<PageEdit> pageEdits(pageReferences.size());
+
+    // Pages are processed in parallel, storage is only read here. Pages
+    // without removed annotations are left untouched (edit remains empty).
+    auto processPage = [this, &filter, &pageReferences, &pageEdits](size_t pageIndex)
     {
+        const PDFObjectReference pageReference = pageReferences[pageIndex];
         const PDFObject& pageObject = m_storage.getObjectByReference(pageReference);
         const PDFDictionary* pageDictionary = m_storage.getDictionaryFromObject(pageObject);
 
         if (!pageDictionary)
         {
-            continue;
+            return;
         }
 
-        std::vector<PDFObjectReference> annotationReferences = loader.readReferenceArrayFromDictionary(pageDictionary, "Annots");
-        for (const PDFObjectReference& annotationReference : annotationReferences)
+        const PDFObject& annotationsObject = m_storage.getObject(pageDictionary->get("Annots"));
+        if (!annotationsObject.isArray())
         {
-            PDFAnnotationPtr annotation = PDFAnnotation::parse(&m_storage, annotationReference);
-            if (filter(annotation.get()))
+            return;
+        }
+
+        const PDFArray* annotationsArray = annotationsObject.getArray();
+        std::vector<PDFObject> annotations;
+        std::vector<PDFObjectReference> annotationsToBeRemoved;
+        annotations.reserve(annotationsArray->getCount());
+
+        for (size_t i = 0, count = annotationsArray->getCount(); i < count; ++i)
+        {
+            const PDFObject& annotationObject = annotationsArray->getItem(i);
+            if (annotationObject.isReference())
             {
-                annotationsToBeRemoved.emplace_back(pageReference, annotationReference);
+                PDFAnnotationPtr annotation = PDFAnnotation::parse(&m_storage, annotationObject.getReference());
+                if (annotation && filter(annotation.get()))
+                {
+                    annotationsToBeRemoved.push_back(annotationObject.getReference());
+                    continue;
+                }
             }
+
+            annotations.push_back(annotationObject);
+        }
+
+        if (annotationsToBeRemoved.empty())
+        {
+            return;
+        }
+
+        PDFObjectFactory factory;
+        factory.beginDictionary();
+        factory.beginDictionaryItem("Annots");
+        if (!annotations.empty())
+        {
+            factory << PDFObject::createArray(std::make_shared<PDFArray>(qMove(annotations)));
+        }
+        else
+        {
+            factory << PDFObject();
+        }
+        factory.endDictionaryItem();
+        factory.endDictionary();
+
+        PageEdit& pageEdit = pageEdits[pageIndex];
+        pageEdit.pageObject = PDFObjectManipulator::merge(pageObject, factory.takeObject(), PDFObjectManipulator::RemoveNullObjects);
+        pageEdit.annotationsToBeRemoved = qMove(annotationsToBeRemoved);
+    };
+
+    PDFIntegerRange<size_t> indices(0, pageReferences.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), processPage);
+
+    // Apply all edits at once, only modified pages are stored
+    size_t removedAnnotationCount = 0;
+    for (size_t pageIndex = 0; pageIndex < pageReferences.size(); ++pageIndex)
+    {
+        PageEdit& pageEdit = pageEdits[pageIndex];
+        if (pageEdit.annotationsToBeRemoved.empty())
+        {
+            continue;
+        }
+
+        m_storage.setObject(pageReferences[pageIndex], qMove(pageEdit.pageObject));
+
+        // Removed annotation can be still referenced (for example, by its popup
+        // annotation), so we remove removed annotations explicitly.
+        for (const PDFObjectReference& annotationReference : pageEdit.annotationsToBeRemoved)
+        {
+            m_storage.setObject(annotationReference, PDFObject());
         }
+
+        removedAnnotationCount += pageEdit.annotationsToBeRemoved.size();
     }
 
-    if (!annotationsToBeRemoved.empty())
+    if (removedAnnotationCount > 0)
     {
-        for (const auto& item : annotationsToBeRemoved)
+        Q_EMIT sanitizationProgress(message.arg(removedAnnotationCount));
+    }
+}
+
+bool PDFDocumentSanitizer::removeCatalogSubdictionaryEntry(const char* dictionaryKey, const char* key)
+{
+    const PDFObjectReference catalogReference = getCatalogReference();
+    const PDFDictionary* catalogDictionary = m_storage.getDictionaryFromObject(m_storage.getObjectByReference(catalogReference));
+    if (!catalogDictionary)
+    {
+        return false;
+    }
+
+    const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(catalogDictionary->get(dictionaryKey));
+    if (!dictionary || !dictionary->hasKey(key))
+    {
+        return false;
+    }
+
+    PDFDictionary dictionaryCopy = *dictionary;
+    dictionaryCopy.setEntry(PDFInplaceOrMemoryString(key), PDFObject());
+    PDFObject dictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(dictionaryCopy)));
+
+    PDFObjectFactory factory;
+    factory.beginDictionary();
+    factory.beginDictionaryItem(dictionaryKey);
+    factory << dictionaryObject;
+    factory.endDictionaryItem();
+    factory.endDictionary();
+    mergeTo(catalogReference, factory.takeObject());
+    return true;
+}
+
+void PDFDocumentSanitizer::mergeTo(PDFObjectReference reference, PDFObject object)
+{
+    m_storage.setObject(reference, PDFObjectManipulator::merge(m_storage.getObjectByReference(reference), qMove(object), PDFObjectManipulator::RemoveNullObjects));
+}
+
+PDFObjectReference PDFDocumentSanitizer::getCatalogReference() const
+{
+    if (const PDFDictionary* trailerDictionary = m_storage.getDictionaryFromObject(m_storage.getTrailerDictionary()))
+    {
+        const PDFObject& catalogObject = trailerDictionary->get("Root");
+        if (catalogObject.isReference())
         {
-            const PDFObjectReference pageReference = item.first;
-            const PDFObjectReference annotationReference = item.second;
-            builder.removeAnnotation(pageReference, annotationReference);
+            return catalogObject.getReference();
         }
+    }
 
-        PDFDocument document = builder.build();
-        m_storage = document.getStorage();
-        Q_EMIT sanitizationProgress(message.arg(annotationsToBeRemoved.size()));
+    return PDFObjectReference();
+}
+
+std::vector<PDFObjectReference> PDFDocumentSanitizer::getPageReferences() const
+{
+    std::vector<PDFObjectReference> pageReferences;
+
+    const PDFDictionary* catalogDictionary = m_storage.getDictionaryFromObject(m_storage.getObjectByReference(getCatalogReference()));
+    if (catalogDictionary)
+    {
+        for (const PDFPage& page : PDFPage::parse(&m_storage, catalogDictionary->get("Pages")))
+        {
+            pageReferences.push_back(page.getPageReference());
+        }
     }
+
+    return pageReferences;
 }
 
 }   // namespace pdf
@@ -26,7 +26,11 @@ class PDFAnnotation;
 
 /// Class for sanitizing documents. Can remove sensitive content from the document,
 /// except the content streams. Sanitization is configurable, user can specify,
-/// which content should be removed.
+/// which content should be removed. Only objects containing removed content
+/// are modified, and objects are not renumbered (unused objects are just removed).
+/// So, if the document was read with object source kept, unmodified objects
+/// can be written using their original data, and objects of lazily loaded
+/// document, which are not used, are never loaded.
 class PDF4QTLIBCORESHARED_EXPORT PDFDocumentSanitizer : public QObject
 {
     Q_OBJECT
@@ -88,8 +92,21 @@ private:
     void performSanitizeMarkupAnnotations();
     void performSanitizePageThumbnails();
 
+    void performRemoveUnusedObjects();
+
     void removeAnnotations(const std::function<bool(const PDFAnnotation*)>& filter, QString message);
 
+    /// Removes entry \p key from the catalog subdictionary \p dictionaryKey.
+    /// Returns true, if entry was present and it was removed.
+    bool removeCatalogSubdictionaryEntry(const char* dictionaryKey, const char* key);
+
+    /// Merges \p object to the object with given reference, null
+    /// entries of dictionaries are removed.
+    void mergeTo(PDFObjectReference reference, PDFObject object);
+
+    PDFObjectReference getCatalogReference() const;
+    std::vector<PDFObjectReference> getPageReferences() const;
+
     SanitizationFlags m_flags;
     PDFObjectStorage m_storage;
 };
@@ -23,6 +23,11 @@
 #include "pdfcms.h"
 #include "pdftextlayoutgenerator.h"
 #include "pdfpagecontentprocessor.h"
+#include "pdfpagecontenthash.h"
+#include "pdfdiskcache.h"
+
+#include <QDataStream>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -204,6 +209,7 @@ public:
 protected:
     virtual bool isContentSuppressedByOC(PDFObjectReference ocgOrOcmd) override;
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
+    virtual bool isTextOnlyProcessing() const override;
     virtual void performOutputCharacter(const PDFTextCharacterInfo& info) override;
     virtual void performMarkedContentBegin(const QByteArray& tag, const PDFObject& properties) override;
     virtual void performMarkedContentEnd() override;
@@ -390,6 +396,12 @@ bool PDFStructureTreeTextContentProcessor::isContentKindSuppressed(ContentKind k
     return false;
 }
 
+bool PDFStructureTreeTextContentProcessor::isTextOnlyProcessing() const
+{
+    // Only characters and marked content are needed for the structure tree text
+    return true;
+}
+
 void PDFStructureTreeTextContentProcessor::performOutputCharacter(const PDFTextCharacterInfo& info)
 {
     if (!isContentSuppressed())
@@ -648,7 +660,11 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
     PDFStructureTree structureTree;
 
     const PDFCatalog* catalog = document->getCatalog();
-    if (algorithm != Algorithm::Layout)
+
+    // Structure tree can be very large, so do not parse it, when it is
+    // not used (automatic algorithm uses it only for tagged documents).
+    const bool isStructureTreeUsed = algorithm != Algorithm::Layout && (algorithm != Algorithm::Auto || catalog->isLogicalStructureMarked());
+    if (isStructureTreeUsed)
     {
         structureTree = PDFStructureTree::parse(&document->getStorage(), catalog->getStructureTreeRoot());
     }
@@ -696,9 +712,50 @@ PDFDocumentTextFlow PDFDocumentTextFlowFactory::create(const PDFDocument* docume
                 const PDFPage* page = catalog->getPage(pageIndex);
                 Q_ASSERT(page);
 
-                PDFTextLayoutGenerator generator(PDFRenderer::IgnoreOptionalContent, page, document, &fontCache, &cms, &oca, QTransform(), mqs);
-                QList<PDFRenderError> errors = generator.processContents();
-                PDFTextLayout textLayout = generator.createTextLayout();
+                QByteArray diskCacheKey;
+                if (m_diskCache)
+                {
+                    const QByteArray pageContentHash = PDFPageContentHash::compute(document, pageIndex);
+                    if (!pageContentHash.isEmpty())
+                    {
+                        diskCacheKey = PDFDiskCache::createPageKey(pageContentHash, "textlayout", QByteArray::number(int(PDFRenderer::IgnoreOptionalContent)));
+                    }
+                }
+
+                QList<PDFRenderError> errors;
+                PDFTextLayout textLayout;
+                bool isTextLayoutCached = false;
+
+                if (!diskCacheKey.isEmpty())
+                {
+                    QByteArray data = m_diskCache->read(diskCacheKey);
+                    if (!data.isEmpty())
+                    {
+                        QDataStream stream(&data, QIODevice::ReadOnly);
+                        stream >> textLayout;
+                        isTextLayoutCached = stream.status() == QDataStream::Ok;
+                    }
+                }
+
+                if (!isTextLayoutCached)
+                {
+                    PDFTextLayoutGenerator generator(PDFRenderer::IgnoreOptionalContent, page, document, &fontCache, &cms, &oca, QTransform(), mqs);
+                    errors = generator.processContents();
+                    textLayout = generator.createTextLayout();
+
+                    if (!diskCacheKey.isEmpty())
+                    {
+                        QByteArray data;
+
+                        {
+                            QDataStream stream(&data, QIODevice::WriteOnly);
+                            stream << textLayout;
+                        }
+
+                        m_diskCache->write(diskCacheKey, data);
+                    }
+                }
+
                 PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, PDFTextFlow::FlowFlags(PDFTextFlow::SeparateBlocks) | PDFTextFlow::RemoveSoftHyphen, pageIndex);
 
                 PDFDocumentTextFlow::Items flowItems;
@@ -806,180 +863,222 @@ void PDFDocumentTextFlowEditor::setTextFlow(PDFDocumentTextFlow textFlow)
 
 void PDFDocumentTextFlowEditor::setSelectionActive(bool active)
 {
-    for (auto& item : m_editedTextFlow)
+    for (EditedItemFlags& flags : m_editedItemFlags)
     {
-        if (item.editedItemFlags.testFlag(Selected))
+        if (flags.testFlag(Selected))
         {
-            item.editedItemFlags.setFlag(Removed, !active);
+            flags.setFlag(Removed, !active);
         }
     }
 }
 
 void PDFDocumentTextFlowEditor::select(size_t index, bool select)
 {
-    getEditedItem(index)->editedItemFlags.setFlag(Selected, select);
+    m_editedItemFlags.at(index).setFlag(Selected, select);
 }
 
 void PDFDocumentTextFlowEditor::deselect()
 {
-    for (auto& item : m_editedTextFlow)
+    for (EditedItemFlags& flags : m_editedItemFlags)
+    {
+        flags.setFlag(Selected, false);
+    }
+}
+
+void PDFDocumentTextFlowEditor::setSelection(const std::vector<size_t>& indices)
+{
+    deselect();
+
+    for (size_t index : indices)
     {
-        item.editedItemFlags.setFlag(Selected, false);
+        select(index, true);
+    }
+}
+
+void PDFDocumentTextFlowEditor::setSelectionMask(const SelectionMask& mask)
+{
+    Q_ASSERT(mask.size() == m_editedItemFlags.size());
+
+    const size_t count = qMin(mask.size(), m_editedItemFlags.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_editedItemFlags[i].setFlag(Selected, mask[i]);
     }
 }
 
 void PDFDocumentTextFlowEditor::removeItem(size_t index)
 {
-    getEditedItem(index)->editedItemFlags.setFlag(Removed, true);
+    m_editedItemFlags.at(index).setFlag(Removed, true);
 }
 
 void PDFDocumentTextFlowEditor::addItem(size_t index)
 {
-    getEditedItem(index)->editedItemFlags.setFlag(Removed, false);
+    m_editedItemFlags.at(index).setFlag(Removed, false);
 }
 
 void PDFDocumentTextFlowEditor::clear()
 {
     m_originalTextFlow = PDFDocumentTextFlow();
-    m_editedTextFlow.clear();
+    m_originalIndices.clear();
+    m_editedItemFlags.clear();
+    m_editedTexts.clear();
     m_pageIndicesMapping.clear();
 }
 
 void PDFDocumentTextFlowEditor::setText(const QString& text, size_t index)
 {
-    EditedItem* item = getEditedItem(index);
-    item->text = text;
+    m_editedTexts.at(index) = text;
     updateModifiedFlag(index);
 }
 
 bool PDFDocumentTextFlowEditor::isSelectionEmpty() const
 {
-    return std::all_of(m_editedTextFlow.cbegin(), m_editedTextFlow.cend(), [](const auto& item) { return !item.editedItemFlags.testFlag(Selected); });
+    return std::none_of(m_editedItemFlags.cbegin(), m_editedItemFlags.cend(), [](const EditedItemFlags& flags) { return flags.testFlag(Selected); });
 }
 
 bool PDFDocumentTextFlowEditor::isSelectionModified() const
 {
-    return std::any_of(m_editedTextFlow.cbegin(), m_editedTextFlow.cend(), [](const auto& item) { return item.editedItemFlags.testFlag(Selected) && item.editedItemFlags.testFlag(Modified); });
+    return std::any_of(m_editedItemFlags.cbegin(), m_editedItemFlags.cend(), [](const EditedItemFlags& flags) { return flags.testFlag(Selected) && flags.testFlag(Modified); });
 }
 
 void PDFDocumentTextFlowEditor::selectByRectangle(QRectF rectangle)
 {
-    for (auto& item : m_editedTextFlow)
-    {
-        const QRectF& boundingRectangle = item.boundingRect;
+    setSelectionMask(getSelectionMaskByRectangle(rectangle));
+}
 
-        if (boundingRectangle.isEmpty())
-        {
-            item.editedItemFlags.setFlag(Selected, false);
-            continue;
-        }
+void PDFDocumentTextFlowEditor::selectByContainedText(QString text)
+{
+    setSelectionMask(getSelectionMaskByContainedText(text));
+}
+
+void PDFDocumentTextFlowEditor::selectByRegularExpression(const QRegularExpression& expression)
+{
+    setSelectionMask(getSelectionMaskByRegularExpression(expression));
+}
 
-        const bool isContained = rectangle.contains(boundingRectangle);
-        item.editedItemFlags.setFlag(Selected, isContained);
+void PDFDocumentTextFlowEditor::selectByPageIndices(const pdf::PDFClosedIntervalSet& indices)
+{
+    std::vector<PDFInteger> pageIndices = indices.unfold();
+    std::sort(pageIndices.begin(), pageIndices.end());
+
+    const size_t count = getItemCount();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const bool isPageValid = std::binary_search(pageIndices.begin(), pageIndices.end(), getPageIndex(i) + 1);
+        m_editedItemFlags[i].setFlag(Selected, isPageValid);
     }
 }
 
-void PDFDocumentTextFlowEditor::selectByContainedText(QString text)
+PDFDocumentTextFlowEditor::SelectionMask PDFDocumentTextFlowEditor::getSelectionMaskByRectangle(QRectF rectangle) const
 {
-    for (auto& item : m_editedTextFlow)
+    const size_t count = getItemCount();
+    SelectionMask mask(count, 0);
+
+    for (size_t i = 0; i < count; ++i)
     {
-        const bool isContained = item.text.contains(text, Qt::CaseSensitive);
-        item.editedItemFlags.setFlag(Selected, isContained);
+        const QRectF& boundingRectangle = getBoundingRect(i);
+        mask[i] = !boundingRectangle.isEmpty() && rectangle.contains(boundingRectangle);
     }
+
+    return mask;
 }
 
-void PDFDocumentTextFlowEditor::selectByRegularExpression(const QRegularExpression& expression)
+PDFDocumentTextFlowEditor::SelectionMask PDFDocumentTextFlowEditor::getSelectionMaskByContainedText(const QString& text) const
 {
-    for (auto& item : m_editedTextFlow)
+    const size_t count = getItemCount();
+    SelectionMask mask(count, 0);
+
+    for (size_t i = 0; i < count; ++i)
     {
-        QRegularExpressionMatch match = expression.match(item.text, 0, QRegularExpression::NormalMatch, QRegularExpression::NoMatchOption);
-        const bool hasMatch = match.hasMatch();
-        item.editedItemFlags.setFlag(Selected, hasMatch);
+        mask[i] = m_editedTexts[i].contains(text, Qt::CaseSensitive);
     }
+
+    return mask;
 }
 
-void PDFDocumentTextFlowEditor::selectByPageIndices(const pdf::PDFClosedIntervalSet& indices)
+PDFDocumentTextFlowEditor::SelectionMask PDFDocumentTextFlowEditor::getSelectionMaskByRegularExpression(const QRegularExpression& expression) const
 {
-    std::vector<PDFInteger> pageIndices = indices.unfold();
-    std::sort(pageIndices.begin(), pageIndices.end());
+    const size_t count = getItemCount();
+    SelectionMask mask(count, 0);
 
-    for (auto& item : m_editedTextFlow)
+    for (size_t i = 0; i < count; ++i)
     {
-        const bool isPageValid = std::binary_search(pageIndices.begin(), pageIndices.end(), item.pageIndex + 1);
-        item.editedItemFlags.setFlag(Selected, isPageValid);
+        QRegularExpressionMatch match = expression.match(m_editedTexts[i], 0, QRegularExpression::NormalMatch, QRegularExpression::NoMatchOption);
+        mask[i] = match.hasMatch();
     }
+
+    return mask;
 }
 
 void PDFDocumentTextFlowEditor::restoreOriginalTexts()
 {
-    for (auto& item : m_editedTextFlow)
+    const size_t count = getItemCount();
+    for (size_t i = 0; i < count; ++i)
     {
-        if (item.editedItemFlags.testFlag(Selected))
+        if (m_editedItemFlags[i].testFlag(Selected))
         {
-            item.text = m_originalTextFlow.getItem(item.originalIndex)->text;
-            item.editedItemFlags.setFlag(Modified, false);
+            m_editedTexts[i] = getOriginalItemOfEditedItem(i)->text;
+            m_editedItemFlags[i].setFlag(Modified, false);
         }
     }
 }
 
 void PDFDocumentTextFlowEditor::moveSelectionUp()
 {
-    size_t originalSize = m_editedTextFlow.size();
-    size_t firstSelectedIndex = originalSize;
+    std::vector<size_t> selectedIndices;
+    std::vector<size_t> unselectedIndices;
 
-    EditedItems selectedItems;
-    for (auto it = m_editedTextFlow.begin(); it != m_editedTextFlow.end();)
+    const size_t count = getItemCount();
+    for (size_t i = 0; i < count; ++i)
     {
-        if (it->editedItemFlags.testFlag(Selected))
-        {
-            if (firstSelectedIndex == originalSize)
-            {
-                firstSelectedIndex = std::distance(m_editedTextFlow.begin(), it);
-            }
+        (isSelected(i) ? selectedIndices : unselectedIndices).push_back(i);
+    }
 
-            selectedItems.emplace_back(std::move(*it));
-            it = m_editedTextFlow.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
+    if (selectedIndices.empty())
+    {
+        return;
     }
 
-    if (firstSelectedIndex > 0)
+    // Items before the first selected item are not selected, so selected
+    // items are inserted one position before the first selected item.
+    size_t insertPosition = selectedIndices.front();
+    if (insertPosition > 0)
     {
-        --firstSelectedIndex;
+        --insertPosition;
     }
 
-    m_editedTextFlow.insert(std::next(m_editedTextFlow.begin(), firstSelectedIndex), std::make_move_iterator(selectedItems.begin()), std::make_move_iterator(selectedItems.end()));
+    std::vector<size_t> order(unselectedIndices.cbegin(), unselectedIndices.cend());
+    order.insert(std::next(order.begin(), insertPosition), selectedIndices.cbegin(), selectedIndices.cend());
+    reorderItems(order);
 }
 
 void PDFDocumentTextFlowEditor::moveSelectionDown()
 {
-    size_t originalSize = m_editedTextFlow.size();
-    size_t lastSelectedIndex = originalSize;
+    std::vector<size_t> selectedIndices;
+    std::vector<size_t> unselectedIndices;
 
-    EditedItems selectedItems;
-    for (auto it = m_editedTextFlow.begin(); it != m_editedTextFlow.end();)
+    const size_t count = getItemCount();
+    for (size_t i = 0; i < count; ++i)
     {
-        if (it->editedItemFlags.testFlag(Selected))
-        {
-            lastSelectedIndex = std::distance(m_editedTextFlow.begin(), it);
-            selectedItems.emplace_back(std::move(*it));
-            it = m_editedTextFlow.erase(it);
-        }
-        else
-        {
-            ++it;
-        }
+        (isSelected(i) ? selectedIndices : unselectedIndices).push_back(i);
     }
 
-    if (lastSelectedIndex < m_editedTextFlow.size())
+    if (selectedIndices.empty())
     {
-        ++lastSelectedIndex;
+        return;
     }
 
-    m_editedTextFlow.insert(std::next(m_editedTextFlow.begin(), lastSelectedIndex), std::make_move_iterator(selectedItems.begin()), std::make_move_iterator(selectedItems.end()));
+    // Selected items are inserted one position after the last selected
+    // item (position is counted in unselected items only).
+    size_t insertPosition = selectedIndices.back() - (selectedIndices.size() - 1);
+    if (insertPosition < unselectedIndices.size())
+    {
+        ++insertPosition;
+    }
+
+    std::vector<size_t> order(unselectedIndices.cbegin(), unselectedIndices.cend());
+    order.insert(std::next(order.begin(), insertPosition), selectedIndices.cbegin(), selectedIndices.cend());
+    reorderItems(order);
 }
 
 PDFDocumentTextFlowEditor::PageIndicesMappingRange PDFDocumentTextFlowEditor::getItemsForPageIndex(PDFInteger pageIndex) const
@@ -1004,7 +1103,7 @@ PDFDocumentTextFlow PDFDocumentTextFlowEditor::createEditedTextFlow() const
             continue;
         }
 
-        PDFDocumentTextFlow::Item item = *getOriginalItem(i);
+        PDFDocumentTextFlow::Item item = *getOriginalItemOfEditedItem(i);
         item.text = getText(i);
         items.emplace_back(std::move(item));
     }
@@ -1015,11 +1114,11 @@ PDFDocumentTextFlow PDFDocumentTextFlowEditor::createEditedTextFlow() const
 void PDFDocumentTextFlowEditor::createPageMapping()
 {
     m_pageIndicesMapping.clear();
-    m_pageIndicesMapping.reserve(m_editedTextFlow.size());
+    m_pageIndicesMapping.reserve(getItemCount());
 
-    for (size_t i = 0; i < m_editedTextFlow.size(); ++i)
+    for (size_t i = 0; i < getItemCount(); ++i)
     {
-        m_pageIndicesMapping.emplace_back(m_editedTextFlow[i].pageIndex, i);
+        m_pageIndicesMapping.emplace_back(getPageIndex(i), i);
     }
 
     std::sort(m_pageIndicesMapping.begin(), m_pageIndicesMapping.end());
@@ -1028,7 +1127,13 @@ void PDFDocumentTextFlowEditor::createPageMapping()
 void PDFDocumentTextFlowEditor::createEditedFromOriginalTextFlow()
 {
     const size_t count = m_originalTextFlow.getSize();
-    m_editedTextFlow.reserve(count);
+
+    m_originalIndices.clear();
+    m_editedItemFlags.clear();
+    m_editedTexts.clear();
+    m_originalIndices.reserve(count);
+    m_editedItemFlags.reserve(count);
+    m_editedTexts.reserve(count);
 
     for (size_t i = 0; i < count; ++i)
     {
@@ -1039,11 +1144,9 @@ void PDFDocumentTextFlowEditor::createEditedFromOriginalTextFlow()
             continue;
         }
 
-        EditedItem editedItem;
-        static_cast<PDFDocumentTextFlow::Item&>(editedItem) = *originalItem;
-        editedItem.originalIndex = i;
-        editedItem.editedItemFlags = originalItem->isText() ? None : Removed;
-        m_editedTextFlow.emplace_back(std::move(editedItem));
+        m_originalIndices.push_back(i);
+        m_editedItemFlags.push_back(originalItem->isText() ? None : Removed);
+        m_editedTexts.push_back(originalItem->text);
     }
 
     createPageMapping();
@@ -1051,10 +1154,34 @@ void PDFDocumentTextFlowEditor::createEditedFromOriginalTextFlow()
 
 void PDFDocumentTextFlowEditor::updateModifiedFlag(size_t index)
 {
-    const bool isModified = getText(index) != getOriginalItem(index)->text;
+    const bool isModified = getText(index) != getOriginalItemOfEditedItem(index)->text;
+    m_editedItemFlags.at(index).setFlag(Modified, isModified);
+}
+
+void PDFDocumentTextFlowEditor::reorderItems(const std::vector<size_t>& order)
+{
+    Q_ASSERT(order.size() == getItemCount());
 
-    EditedItem* item = getEditedItem(index);
-    item->editedItemFlags.setFlag(Modified, isModified);
+    std::vector<size_t> originalIndices;
+    std::vector<EditedItemFlags> editedItemFlags;
+    std::vector<QString> editedTexts;
+    originalIndices.reserve(order.size());
+    editedItemFlags.reserve(order.size());
+    editedTexts.reserve(order.size());
+
+    for (size_t index : order)
+    {
+        originalIndices.push_back(m_originalIndices[index]);
+        editedItemFlags.push_back(m_editedItemFlags[index]);
+        editedTexts.push_back(std::move(m_editedTexts[index]));
+    }
+
+    m_originalIndices = std::move(originalIndices);
+    m_editedItemFlags = std::move(editedItemFlags);
+    m_editedTexts = std::move(editedTexts);
+
+    // Page mapping contains item indices, which were changed
+    createPageMapping();
 }
 
 std::map<PDFInteger, PDFDocumentTextFlow> PDFDocumentTextFlow::split(Flags mask) const
@@ -25,6 +25,7 @@
 namespace pdf
 {
 class PDFDocument;
+class PDFDiskCache;
 
 /// Text flow extracted from document. Text flow can be created \p PDFDocumentTextFlowFactory.
 /// Flow can contain various items, not just text ones. Also, some manipulation functions
@@ -142,9 +143,18 @@ public:
     /// \param calculateBoundingBoxes Perform bounding box calculation?
     void setCalculateBoundingBoxes(bool calculateBoundingBoxes);
 
+    /// Sets disk cache of page text layouts, which is used by layout
+    /// algorithm. Text layouts are keyed by the canonical hash of the page
+    /// content, so they are shared by identical pages of different documents.
+    /// Errors of the text layout creation are reported only, when
+    /// page is actually processed.
+    /// \param diskCache Disk cache (can be nullptr, then cache isn't used)
+    void setDiskCache(PDFDiskCache* diskCache) { m_diskCache = diskCache; }
+
 private:
     QList<PDFRenderError> m_errors;
     bool m_calculateBoundingBoxes = false;
+    PDFDiskCache* m_diskCache = nullptr;
 };
 
 /// Editor which can edit document text flow, modify user text,
@@ -171,6 +181,18 @@ public:
     /// Deselects all selected items
     void deselect();
 
+    /// Selection flag for each item (nonzero, if item is selected)
+    using SelectionMask = std::vector<uint8_t>;
+
+    /// Replaces selection by items with given indices
+    /// \param indices Indices of selected items
+    void setSelection(const std::vector<size_t>& indices);
+
+    /// Replaces selection by selection mask. Mask must have
+    /// the same size as is item count.
+    /// \param mask Selection mask
+    void setSelectionMask(const SelectionMask& mask);
+
     void removeItem(size_t index);
     void addItem(size_t index);
 
@@ -185,20 +207,13 @@ public:
     };
     Q_DECLARE_FLAGS(EditedItemFlags, EditedItemFlag)
 
-    struct EditedItem : public PDFDocumentTextFlow::Item
-    {
-        size_t originalIndex = 0; ///< Index of original item
-        EditedItemFlags editedItemFlags = None;
-    };
-
-    using EditedItems = std::vector<EditedItem>;
     using PageIndicesMapping = std::vector<std::pair<PDFInteger, size_t>>;
     using PageIndicesMappingIterator = PageIndicesMapping::const_iterator;
     using PageIndicesMappingRange = std::pair<PageIndicesMappingIterator, PageIndicesMappingIterator>;
 
     /// Returns true, if item is active
     /// \param index Index
-    bool isActive(size_t index) const { return !getEditedItem(index)->editedItemFlags.testFlag(Removed); }
+    bool isActive(size_t index) const { return !m_editedItemFlags.at(index).testFlag(Removed); }
 
     /// Returns true, if item is removed
     /// \param index Index
@@ -206,16 +221,16 @@ public:
 
     /// Returns true, if item is modified
     /// \param index Index
-    bool isModified(size_t index) const { return getEditedItem(index)->editedItemFlags.testFlag(Modified); }
+    bool isModified(size_t index) const { return m_editedItemFlags.at(index).testFlag(Modified); }
 
     /// Returns true, if item is selected
     /// \param index Index
-    bool isSelected(size_t index) const { return getEditedItem(index)->editedItemFlags.testFlag(Selected); }
+    bool isSelected(size_t index) const { return m_editedItemFlags.at(index).testFlag(Selected); }
 
     /// Returns edited text (or original, if edited text is not modified)
     /// for a given index.
     /// \param index Index
-    const QString& getText(size_t index) const { return getEditedItem(index)->text; }
+    const QString& getText(size_t index) const { return m_editedTexts.at(index); }
 
     /// Sets edited text for a given index
     void setText(const QString& text, size_t index);
@@ -230,16 +245,20 @@ public:
     bool isSelectionModified() const;
 
     /// Returns item count in edited text flow
-    size_t getItemCount() const { return m_editedTextFlow.size(); }
+    size_t getItemCount() const { return m_originalIndices.size(); }
 
     /// Returns page index for given item
     /// \param index Index
-    PDFInteger getPageIndex(size_t index) const { return getEditedItem(index)->pageIndex; }
+    PDFInteger getPageIndex(size_t index) const { return getOriginalItemOfEditedItem(index)->pageIndex; }
 
-    bool isItemTypeText(size_t index) const { return getEditedItem(index)->isText(); }
-    bool isItemTypeSpecial(size_t index) const { return getEditedItem(index)->isSpecial(); }
-    bool isItemTypeTitle(size_t index) const { return getEditedItem(index)->isTitle(); }
-    bool isItemTypeLanguage(size_t index) const { return getEditedItem(index)->isLanguage(); }
+    /// Returns bounding rectangle (in page coordinates) of given item
+    /// \param index Index
+    const QRectF& getBoundingRect(size_t index) const { return getOriginalItemOfEditedItem(index)->boundingRect; }
+
+    bool isItemTypeText(size_t index) const { return getOriginalItemOfEditedItem(index)->isText(); }
+    bool isItemTypeSpecial(size_t index) const { return getOriginalItemOfEditedItem(index)->isSpecial(); }
+    bool isItemTypeTitle(size_t index) const { return getOriginalItemOfEditedItem(index)->isTitle(); }
+    bool isItemTypeLanguage(size_t index) const { return getOriginalItemOfEditedItem(index)->isLanguage(); }
 
     /// Selects items contained in a rectangle
     /// \param rectangle Selection rectangle
@@ -257,6 +276,24 @@ public:
     /// \param indices Indices
     void selectByPageIndices(const PDFClosedIntervalSet& indices);
 
+    /// Returns selection mask of items contained in a rectangle. Selection
+    /// flags are not accessed, so this function can be called in another
+    /// thread, while selection is being changed.
+    /// \param rectangle Selection rectangle
+    SelectionMask getSelectionMaskByRectangle(QRectF rectangle) const;
+
+    /// Returns selection mask of items which contains text. Selection
+    /// flags are not accessed, so this function can be called in another
+    /// thread, while selection is being changed.
+    /// \param text Text
+    SelectionMask getSelectionMaskByContainedText(const QString& text) const;
+
+    /// Returns selection mask of items which matches regular expression.
+    /// Selection flags are not accessed, so this function can be called
+    /// in another thread, while selection is being changed.
+    /// \param expression Regular expression
+    SelectionMask getSelectionMaskByRegularExpression(const QRegularExpression& expression) const;
+
     /// Restores original texts in selected items
     void restoreOriginalTexts();
 
@@ -275,8 +312,6 @@ public:
     /// \param pageIndex Page index
     PageIndicesMappingRange getItemsForPageIndex(PDFInteger pageIndex) const;
 
-    const EditedItem* getEditedItem(size_t index) const { return &m_editedTextFlow.at(index); }
-
     /// Creates text flow from active edited items. If item is removed,
     /// then it is not added into this text flow. User text modification
     /// is applied to a text flow.
@@ -287,11 +322,24 @@ private:
     void createEditedFromOriginalTextFlow();
     void updateModifiedFlag(size_t index);
 
+    /// Reorders edited items, item at position i will be
+    /// item, which was at position order[i].
+    /// \param order New order of items
+    void reorderItems(const std::vector<size_t>& order);
+
     const PDFDocumentTextFlow::Item* getOriginalItem(size_t index) const { return m_originalTextFlow.getItem(index); }
-    EditedItem* getEditedItem(size_t index) { return &m_editedTextFlow.at(index); }
+    const PDFDocumentTextFlow::Item* getOriginalItemOfEditedItem(size_t index) const { return getOriginalItem(m_originalIndices.at(index)); }
 
     PDFDocumentTextFlow m_originalTextFlow;
-    EditedItems m_editedTextFlow;
+
+    // Edited items are stored in columns. Properties, which can't be
+    // edited (page index, bounding rectangle, item type), are taken
+    // from the original item, so edited items are cheap even for
+    // very large text flows, and bulk operations touch only one column.
+    std::vector<size_t> m_originalIndices;
+    std::vector<EditedItemFlags> m_editedItemFlags;
+    std::vector<QString> m_editedTexts;
+
     PageIndicesMapping m_pageIndicesMapping;
 };
 
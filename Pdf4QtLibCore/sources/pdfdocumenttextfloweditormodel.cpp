@@ -20,6 +20,7 @@
 
 #include <QColor>
 #include <QBrush>
+#include <QtConcurrent/QtConcurrent>
 
 #include "pdfdbgheap.h"
 
@@ -28,14 +29,16 @@ namespace pdf
 
 PDFDocumentTextFlowEditorModel::PDFDocumentTextFlowEditorModel(QObject* parent) :
     BaseClass(parent),
-    m_editor(nullptr)
+    m_editor(nullptr),
+    m_isSelectionRunning(false)
 {
-
+    connect(&m_selectionFutureWatcher, &QFutureWatcher<SelectionMask>::finished, this, &PDFDocumentTextFlowEditorModel::onSelectionFinished);
 }
 
 PDFDocumentTextFlowEditorModel::~PDFDocumentTextFlowEditorModel()
 {
-
+    m_isSelectionRunning = false;
+    m_selectionFutureWatcher.waitForFinished();
 }
 
 QVariant PDFDocumentTextFlowEditorModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -177,6 +180,7 @@ bool PDFDocumentTextFlowEditorModel::setData(const QModelIndex& index, const QVa
 {
     if (role == Qt::EditRole && index.column() == ColumnText)
     {
+        finishSelection();
         m_editor->setText(value.toString(), index.row());
         return true;
     }
@@ -215,6 +219,7 @@ void PDFDocumentTextFlowEditorModel::setEditor(PDFDocumentTextFlowEditor* editor
 {
     if (m_editor != editor)
     {
+        finishSelection();
         beginResetModel();
         m_editor = editor;
         endResetModel();
@@ -223,6 +228,7 @@ void PDFDocumentTextFlowEditorModel::setEditor(PDFDocumentTextFlowEditor* editor
 
 void PDFDocumentTextFlowEditorModel::beginFlowChange()
 {
+    finishSelection();
     beginResetModel();
 }
 
@@ -250,9 +256,10 @@ void PDFDocumentTextFlowEditorModel::setSelectionActivated(bool activate)
         return;
     }
 
+    finishSelection();
     m_editor->setSelectionActive(activate);
     m_editor->deselect();
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::selectByRectangle(QRectF rectangle)
@@ -262,8 +269,8 @@ void PDFDocumentTextFlowEditorModel::selectByRectangle(QRectF rectangle)
         return;
     }
 
-    m_editor->selectByRectangle(rectangle);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    PDFDocumentTextFlowEditor* editor = m_editor;
+    startSelection([editor, rectangle]() { return editor->getSelectionMaskByRectangle(rectangle); });
 }
 
 void PDFDocumentTextFlowEditorModel::selectByContainedText(QString text)
@@ -273,8 +280,8 @@ void PDFDocumentTextFlowEditorModel::selectByContainedText(QString text)
         return;
     }
 
-    m_editor->selectByContainedText(text);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    PDFDocumentTextFlowEditor* editor = m_editor;
+    startSelection([editor, text]() { return editor->getSelectionMaskByContainedText(text); });
 }
 
 void PDFDocumentTextFlowEditorModel::selectByRegularExpression(const QRegularExpression& expression)
@@ -284,8 +291,8 @@ void PDFDocumentTextFlowEditorModel::selectByRegularExpression(const QRegularExp
         return;
     }
 
-    m_editor->selectByRegularExpression(expression);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    PDFDocumentTextFlowEditor* editor = m_editor;
+    startSelection([editor, expression]() { return editor->getSelectionMaskByRegularExpression(expression); });
 }
 
 void PDFDocumentTextFlowEditorModel::selectByPageIndices(const PDFClosedIntervalSet& indices)
@@ -295,8 +302,9 @@ void PDFDocumentTextFlowEditorModel::selectByPageIndices(const PDFClosedInterval
         return;
     }
 
+    finishSelection();
     m_editor->selectByPageIndices(indices);
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::restoreOriginalTexts()
@@ -306,9 +314,10 @@ void PDFDocumentTextFlowEditorModel::restoreOriginalTexts()
         return;
     }
 
+    finishSelection();
     m_editor->restoreOriginalTexts();
     m_editor->deselect();
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    notifyDataChanged();
 }
 
 void PDFDocumentTextFlowEditorModel::moveSelectionUp()
@@ -318,6 +327,7 @@ void PDFDocumentTextFlowEditorModel::moveSelectionUp()
         return;
     }
 
+    finishSelection();
     m_editor->moveSelectionUp();
     notifyDataChanged();
 }
@@ -329,6 +339,7 @@ void PDFDocumentTextFlowEditorModel::moveSelectionDown()
         return;
     }
 
+    finishSelection();
     m_editor->moveSelectionDown();
     notifyDataChanged();
 }
@@ -340,7 +351,43 @@ void PDFDocumentTextFlowEditorModel::notifyDataChanged()
         return;
     }
 
-    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast));
+    Q_EMIT dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, ColumnLast - 1));
+}
+
+void PDFDocumentTextFlowEditorModel::startSelection(std::function<SelectionMask()> function)
+{
+    finishSelection();
+
+    m_isSelectionRunning = true;
+    m_selectionFuture = QtConcurrent::run(qMove(function));
+    m_selectionFutureWatcher.setFuture(m_selectionFuture);
+}
+
+void PDFDocumentTextFlowEditorModel::finishSelection()
+{
+    if (m_isSelectionRunning)
+    {
+        m_selectionFutureWatcher.waitForFinished();
+        onSelectionFinished();
+    }
+}
+
+void PDFDocumentTextFlowEditorModel::onSelectionFinished()
+{
+    if (!m_isSelectionRunning)
+    {
+        // Selection was already applied (finishSelection was called)
+        return;
+    }
+
+    m_isSelectionRunning = false;
+    SelectionMask mask = m_selectionFuture.result();
+
+    if (m_editor && mask.size() == m_editor->getItemCount())
+    {
+        m_editor->setSelectionMask(mask);
+        notifyDataChanged();
+    }
 }
 
 }   // namespace pdf
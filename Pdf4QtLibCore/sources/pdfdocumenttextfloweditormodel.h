@@ -20,12 +20,16 @@
 
 #include "pdfglobal.h"
 #include "pdfutils.h"
+#include "pdfdocumenttextflow.h"
 
 #include <QAbstractTableModel>
+#include <QFuture>
+#include <QFutureWatcher>
+
+#include <functional>
 
 namespace pdf
 {
-class PDFDocumentTextFlowEditor;
 
 class PDF4QTLIBCORESHARED_EXPORT PDFDocumentTextFlowEditorModel : public QAbstractTableModel
 {
@@ -74,7 +78,26 @@ public:
     void notifyDataChanged();
 
 private:
+    using SelectionMask = PDFDocumentTextFlowEditor::SelectionMask;
+
+    /// Starts computation of the selection mask in a background thread. Running
+    /// selection is finished first. Mask function must not access selection
+    /// flags or modify the editor, text of the items can't be changed
+    /// until the selection is finished.
+    /// \param function Function computing selection mask
+    void startSelection(std::function<SelectionMask()> function);
+
+    /// Waits for running selection (if any) and applies it. Call
+    /// this function before the editor is modified.
+    void finishSelection();
+
+    /// Applies selection mask computed in the background thread
+    void onSelectionFinished();
+
     PDFDocumentTextFlowEditor* m_editor;
+    bool m_isSelectionRunning;
+    QFuture<SelectionMask> m_selectionFuture;
+    QFutureWatcher<SelectionMask> m_selectionFutureWatcher;
 };
 
 }   // namespace pdf
@@ -19,11 +19,20 @@
 #include "pdfconstants.h"
 #include "pdfvisitor.h"
 #include "pdfparser.h"
+#include "pdfstreamfilters.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfobjectutils.h"
+#include "pdfcatalog.h"
 
 #include <QFile>
 #include <QBuffer>
 #include <QSaveFile>
 
+#include <bit>
+#include <set>
+#include <numeric>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -244,29 +253,25 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
     const PDFObjectStorage& storage = document->getStorage();
     const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
     const size_t objectCount = objects.size();
-    const bool isEncrypted = storage.getSecurityHandler()->getMode() != EncryptionMode::None;
     if (!storage.getSecurityHandler()->isEncryptionAllowed())
     {
         return tr("Writing of encrypted documents is not supported.");
     }
 
-    // Write header
-    PDFVersion version = document->getInfo()->version;
-    device->write(QString("%PDF-%1.%2").arg(version.major).arg(version.minor).toLatin1());
-    writeCRLF(device);
-    device->write("% PDF producer: ");
-    device->write(PDF_LIBRARY_NAME);
-    writeCRLF(device);
-    writeCRLF(device);
-    writeCRLF(device);
+    if (m_linearize && document->getCatalog()->getPageCount() > 0)
+    {
+        return writeLinearized(device, document);
+    }
 
-    PDFObjectReference encryptObjectReference;
-    PDFObject encryptObject = document->getTrailerDictionary()->get("Encrypt");
-    if (encryptObject.isReference())
+    if (m_useObjectStreams)
     {
-        encryptObjectReference = encryptObject.getReference();
+        return writeWithObjectStreams(device, document);
     }
 
+    writeHeader(device, document->getInfo()->version);
+
+    const PDFObjectReference encryptObjectReference = getEncryptObjectReference(document);
+
     // Write objects
     std::vector<PDFInteger> offsets(objectCount, -1);
     for (size_t i = 0; i < objectCount; ++i)
@@ -279,29 +284,7 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
 
         // Jakub Melka: we must mark actual position of object
         offsets[i] = device->pos();
-
-        if (isEncrypted)
-        {
-            PDFObjectReference reference(i, entry.generation);
-            PDFObject objectToWrite = entry.object;
-
-            if (reference != encryptObjectReference)
-            {
-                objectToWrite = storage.getSecurityHandler()->encryptObject(objectToWrite, reference);
-            }
-
-            PDFWriteObjectVisitor visitor(device);
-            writeObjectHeader(device, reference);
-            objectToWrite.accept(&visitor);
-            writeObjectFooter(device);
-        }
-        else
-        {
-            PDFWriteObjectVisitor visitor(device);
-            writeObjectHeader(device, PDFObjectReference(i, entry.generation));
-            entry.object.accept(&visitor);
-            writeObjectFooter(device);
-        }
+        writeStorageObject(device, storage, PDFObjectReference(i, entry.generation), entry.object, encryptObjectReference);
     }
 
     // Write cross-reference table
@@ -327,222 +310,1366 @@ PDFOperationResult PDFDocumentWriter::write(QIODevice* device, const PDFDocument
             offset = 0;
         }
 
-        QString offsetString = QString::number(offset).rightJustified(10, QChar('0'), true);
-        QString generationString = QString::number(generation).rightJustified(5, QChar('0'), true);
+        writeCrossReferenceEntry(device, offset, generation, !entry.object.isNull());
+    }
 
-        device->write(offsetString.toLatin1());
-        device->write(" ");
-        device->write(generationString.toLatin1());
-        device->write(" ");
-        device->write(entry.object.isNull() ? "f" : "n");
-        writeCRLF(device);
+    writeTrailer(device, document, xrefOffset, -1);
+    return true;
+}
+
+PDFOperationResult PDFDocumentWriter::writeWithObjectStreams(QIODevice* device, const PDFDocument* document)
+{
+    const PDFObjectStorage& storage = document->getStorage();
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    const PDFInteger objectCount = static_cast<PDFInteger>(objects.size());
+    const PDFObjectReference encryptObjectReference = getEncryptObjectReference(document);
+
+    // Cross-reference streams and object streams are available since PDF 1.5
+    PDFVersion version = document->getInfo()->version;
+    if (version.major < 1 || (version.major == 1 && version.minor < 5))
+    {
+        version = PDFVersion(1, 5);
     }
 
-    // Jakub Melka: Adjust trailer dictionary, to be really dictionary, not a stream
-    PDFDictionary trailerDictionary = *document->getTrailerDictionary();
-    PDFDictionary newTrailerDictionary;
+    writeHeader(device, version);
 
-    for (const char* entry : { "Size", "Root", "Encrypt", "Info", "ID"})
+    // Objects used as length of the stream are written as standalone objects,
+    // so stream can be read without decoding of the object streams.
+    std::set<PDFInteger> lengthObjects;
+    for (const PDFObjectStorage::Entry& entry : objects)
     {
-        PDFObject object = trailerDictionary.get(entry);
-        if (!object.isNull())
+        if (entry.object.isStream())
         {
-            newTrailerDictionary.addEntry(PDFInplaceOrMemoryString(entry), qMove(object));
+            const PDFObject& lengthObject = entry.object.getStream()->getDictionary()->get("Length");
+            if (lengthObject.isReference())
+            {
+                lengthObjects.insert(lengthObject.getReference().objectNumber);
+            }
         }
     }
 
-    PDFObject trailerDictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(newTrailerDictionary)));
+    // Write standalone objects, other objects are collected for object streams
+    std::vector<XRefEntry> xrefEntries(objectCount);
+    std::vector<PDFInteger> compressedObjects;
+    for (PDFInteger i = 0; i < objectCount; ++i)
+    {
+        const PDFObjectStorage::Entry& entry = objects[i];
+        const PDFObjectReference reference(i, entry.generation);
 
-    device->write("trailer");
-    writeCRLF(device);
-    PDFWriteObjectVisitor trailerVisitor(device);
-    trailerDictionaryObject.accept(&trailerVisitor);
-    writeCRLF(device);
-    device->write("startxref");
-    writeCRLF(device);
-    device->write(QString::number(xrefOffset).toLatin1());
-    writeCRLF(device);
+        if (entry.object.isNull())
+        {
+            xrefEntries[i] = { 0, 0, i == 0 ? 65535 : entry.generation };
+            continue;
+        }
 
-    // Write footer
-    device->write("%%EOF");
+        // According to the PDF specification, streams, objects with nonzero generation
+        // number and the encryption dictionary can't be stored in the object stream.
+        if (!entry.object.isStream() && entry.generation == 0 && reference != encryptObjectReference && !lengthObjects.count(i))
+        {
+            compressedObjects.push_back(i);
+            continue;
+        }
 
-    return true;
-}
+        xrefEntries[i] = { 1, device->pos(), entry.generation };
+        writeStorageObject(device, storage, reference, entry.object, encryptObjectReference);
+    }
 
-void PDFDocumentWriter::writeCRLF(QIODevice* device)
-{
-    device->write("\x0D\x0A");
-}
+    // Prepare object streams. Object streams are independent on each other,
+    // so they can be compressed in parallel.
+    struct ObjectStreamData
+    {
+        PDFObjectReference reference;
+        PDFInteger objectCount = 0;
+        PDFInteger firstOffset = 0;
+        QByteArray data;
+    };
+
+    std::vector<ObjectStreamData> objectStreams;
+    objectStreams.reserve((compressedObjects.size() + OBJECT_STREAM_MAX_OBJECT_COUNT - 1) / OBJECT_STREAM_MAX_OBJECT_COUNT);
+    for (size_t first = 0; first < compressedObjects.size(); first += OBJECT_STREAM_MAX_OBJECT_COUNT)
+    {
+        const size_t last = qMin(first + OBJECT_STREAM_MAX_OBJECT_COUNT, compressedObjects.size());
+        const PDFObjectReference objectStreamReference(static_cast<PDFInteger>(objectCount + objectStreams.size()), 0);
 
-void PDFDocumentWriter::writeObjectHeader(QIODevice* device, PDFObjectReference reference)
-{
-    QString objectHeader = QString("%1 %2 obj").arg(QString::number(reference.objectNumber), QString::number(reference.generation));
-    device->write(objectHeader.toLatin1());
-    writeCRLF(device);
-}
+        QByteArray offsetTable;
+        QByteArray objectData;
+        for (size_t i = first; i < last; ++i)
+        {
+            const PDFInteger objectNumber = compressedObjects[i];
+            offsetTable.append(QByteArray::number(objectNumber));
+            offsetTable.append(' ');
+            offsetTable.append(QByteArray::number(objectData.size()));
+            offsetTable.append(' ');
+            objectData.append(getSerializedObject(objects[objectNumber].object));
+            objectData.append('\n');
+
+            xrefEntries[objectNumber] = { 2, objectStreamReference.objectNumber, static_cast<PDFInteger>(i - first) };
+        }
 
-void PDFDocumentWriter::writeObjectFooter(QIODevice* device)
-{
-    device->write("endobj");
-    writeCRLF(device);
-}
+        ObjectStreamData objectStreamData;
+        objectStreamData.reference = objectStreamReference;
+        objectStreamData.objectCount = static_cast<PDFInteger>(last - first);
+        objectStreamData.firstOffset = offsetTable.size();
+        objectStreamData.data = offsetTable + objectData;
+        objectStreams.push_back(qMove(objectStreamData));
+    }
 
-class PDFSizeCounterIODevice : public QIODevice
-{
-public:
-    explicit PDFSizeCounterIODevice(QObject* parent) :
-        QIODevice(parent)
+    const PDFFlateDecodeFilter::CompressionLevel compressionLevel = m_compressionLevel;
+    auto compressObjectStream = [compressionLevel](ObjectStreamData& objectStreamData)
     {
+        objectStreamData.data = PDFFlateDecodeFilter::compress(objectStreamData.data, compressionLevel);
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectStreams.begin(), objectStreams.end(), compressObjectStream);
 
+    // Write object streams
+    for (ObjectStreamData& objectStreamData : objectStreams)
+    {
+        PDFDictionary dictionary;
+        dictionary.addEntry(PDFInplaceOrMemoryString("Type"), PDFObject::createName("ObjStm"));
+        dictionary.addEntry(PDFInplaceOrMemoryString("N"), PDFObject::createInteger(objectStreamData.objectCount));
+        dictionary.addEntry(PDFInplaceOrMemoryString("First"), PDFObject::createInteger(objectStreamData.firstOffset));
+        dictionary.addEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+        dictionary.addEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(objectStreamData.data.size()));
+        PDFObject objectStream = PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), qMove(objectStreamData.data)));
+
+        xrefEntries.push_back({ 1, device->pos(), 0 });
+        writeObject(device, storage, objectStreamData.reference, objectStream, encryptObjectReference);
     }
 
-    virtual bool isSequential() const override;
-    virtual bool open(OpenMode mode) override;
-    virtual void close() override;
-    virtual qint64 pos() const override;
-    virtual qint64 size() const override;
-    virtual bool seek(qint64 pos) override;
-    virtual bool atEnd() const override;
-    virtual bool reset() override;
-    virtual qint64 bytesAvailable() const override;
-    virtual qint64 bytesToWrite() const override;
-    virtual bool canReadLine() const override;
-    virtual bool waitForReadyRead(int msecs) override;
-    virtual bool waitForBytesWritten(int msecs) override;
+    // Write cross-reference stream, it is also an entry of itself
+    const PDFObjectReference xrefStreamReference(static_cast<PDFInteger>(xrefEntries.size()), 0);
+    const PDFInteger xrefOffset = device->pos();
+    xrefEntries.push_back({ 1, xrefOffset, 0 });
 
-protected:
-    virtual qint64 readData(char* data, qint64 maxlen) override;
-    virtual qint64 readLineData(char* data, qint64 maxlen) override;
-    virtual qint64 writeData(const char* data, qint64 len) override;
+    PDFDictionary xrefDictionary = createTrailerDictionary(document);
+    xrefDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(static_cast<PDFInteger>(xrefEntries.size())));
+    writeCrossReferenceStream(device, qMove(xrefDictionary), xrefStreamReference, xrefEntries, { });
 
-private:
-    OpenMode m_openMode = NotOpen;
-    qint64 m_fileSize = 0;
-};
+    device->write("startxref");
+    writeCRLF(device);
+    device->write(QString::number(xrefOffset).toLatin1());
+    writeCRLF(device);
+    device->write("%%EOF");
 
-bool PDFSizeCounterIODevice::isSequential() const
-{
     return true;
 }
 
-bool PDFSizeCounterIODevice::open(OpenMode mode)
+void PDFDocumentWriter::writeCrossReferenceStream(QIODevice* device,
+                                                  PDFDictionary dictionary,
+                                                  PDFObjectReference reference,
+                                                  const std::vector<XRefEntry>& entries,
+                                                  const std::vector<PDFInteger>& index)
 {
-    if (m_openMode == NotOpen)
+    PDFInteger maxField2 = 0;
+    for (const XRefEntry& entry : entries)
     {
-        setOpenMode(mode);
-        return true;
+        maxField2 = qMax(maxField2, entry.field2);
     }
-    else
+
+    int field2Width = 1;
+    while (field2Width < 8 && (maxField2 >> (8 * field2Width)) > 0)
     {
-        return false;
+        ++field2Width;
     }
-}
-
-void PDFSizeCounterIODevice::close()
-{
-    setOpenMode(NotOpen);
-}
-
-qint64 PDFSizeCounterIODevice::pos() const
-{
-    return m_fileSize;
-}
 
-qint64 PDFSizeCounterIODevice::size() const
-{
-    return m_fileSize;
-}
-
-bool PDFSizeCounterIODevice::seek(qint64 pos)
-{
-    Q_UNUSED(pos);
-
-    return false;
-}
+    constexpr int FIELD3_WIDTH = 2;
+    QByteArray xrefData;
+    xrefData.reserve(entries.size() * (1 + field2Width + FIELD3_WIDTH));
+    for (const XRefEntry& entry : entries)
+    {
+        xrefData.append(static_cast<char>(entry.type));
 
-bool PDFSizeCounterIODevice::atEnd() const
-{
-    return true;
-}
+        for (int i = field2Width - 1; i >= 0; --i)
+        {
+            xrefData.append(static_cast<char>((entry.field2 >> (8 * i)) & 0xFF));
+        }
 
-bool PDFSizeCounterIODevice::reset()
-{
-    return false;
-}
+        const PDFInteger field3 = qBound(PDFInteger(0), entry.field3, PDFInteger(65535));
+        xrefData.append(static_cast<char>((field3 >> 8) & 0xFF));
+        xrefData.append(static_cast<char>(field3 & 0xFF));
+    }
 
-qint64 PDFSizeCounterIODevice::bytesAvailable() const
-{
-    return 0;
-}
+    QByteArray compressedXRefData = PDFFlateDecodeFilter::compress(xrefData, m_compressionLevel);
 
-qint64 PDFSizeCounterIODevice::bytesToWrite() const
-{
-    return 0;
-}
+    std::vector<PDFObject> widths = { PDFObject::createInteger(1), PDFObject::createInteger(field2Width), PDFObject::createInteger(FIELD3_WIDTH) };
+    dictionary.addEntry(PDFInplaceOrMemoryString("Type"), PDFObject::createName("XRef"));
+    dictionary.addEntry(PDFInplaceOrMemoryString("W"), PDFObject::createArray(std::make_shared<PDFArray>(qMove(widths))));
 
-bool PDFSizeCounterIODevice::canReadLine() const
-{
-    return false;
-}
+    if (!index.empty())
+    {
+        std::vector<PDFObject> indexItems;
+        indexItems.reserve(index.size());
+        for (const PDFInteger value : index)
+        {
+            indexItems.push_back(PDFObject::createInteger(value));
+        }
+        dictionary.addEntry(PDFInplaceOrMemoryString("Index"), PDFObject::createArray(std::make_shared<PDFArray>(qMove(indexItems))));
+    }
 
-bool PDFSizeCounterIODevice::waitForReadyRead(int msecs)
-{
-    Q_UNUSED(msecs);
+    dictionary.addEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createName("FlateDecode"));
+    dictionary.addEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(compressedXRefData.size()));
+    PDFObject xrefStream = PDFObject::createStream(std::make_shared<PDFStream>(qMove(dictionary), qMove(compressedXRefData)));
 
-    return false;
+    // Cross-reference stream is never encrypted
+    PDFWriteObjectVisitor visitor(device);
+    writeObjectHeader(device, reference);
+    xrefStream.accept(&visitor);
+    writeObjectFooter(device);
 }
 
-bool PDFSizeCounterIODevice::waitForBytesWritten(int msecs)
+PDFOperationResult PDFDocumentWriter::writeLinearized(QIODevice* device, const PDFDocument* document)
 {
-    Q_UNUSED(msecs);
+    const PDFObjectStorage& storage = document->getStorage();
+    const PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    const PDFInteger objectCount = static_cast<PDFInteger>(objects.size());
+    const PDFCatalog* catalog = document->getCatalog();
+    const size_t pageCount = catalog->getPageCount();
 
-    return false;
-}
+    auto isValidReference = [&objects, objectCount](PDFObjectReference reference)
+    {
+        return reference.objectNumber > 0 &&
+               reference.objectNumber < objectCount &&
+               objects[reference.objectNumber].generation == reference.generation &&
+               !objects[reference.objectNumber].object.isNull();
+    };
+
+    const PDFObject& rootObject = document->getTrailerDictionary()->get("Root");
+    if (!rootObject.isReference() || !isValidReference(rootObject.getReference()))
+    {
+        return tr("Document catalog is not an indirect object, document can't be linearized.");
+    }
 
-qint64 PDFSizeCounterIODevice::readData(char* data, qint64 maxlen)
-{
-    Q_UNUSED(data);
-    Q_UNUSED(maxlen);
+    // Collect direct references of all objects, we will traverse reference graph many times
+    std::vector<std::vector<PDFObjectReference>> references(objectCount);
+    std::vector<PDFInteger> objectNumbers(objectCount, 0);
+    std::iota(objectNumbers.begin(), objectNumbers.end(), PDFInteger(0));
+    auto collectReferences = [&objects, &references](PDFInteger objectNumber)
+    {
+        std::set<PDFObjectReference> directReferences = PDFObjectUtils::getDirectReferences(objects[objectNumber].object);
+        references[objectNumber].assign(directReferences.cbegin(), directReferences.cend());
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectNumbers.begin(), objectNumbers.end(), collectReferences);
+
+    // Page objects and page tree nodes are never traversed from other pages
+    // (for example, by /Parent entry, or by link destination).
+    std::vector<bool> isPageTreeObject(objectCount, false);
+    std::vector<PDFInteger> pageObjects(pageCount, 0);
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        const PDFObjectReference pageReference = catalog->getPage(i)->getPageReference();
+        if (!isValidReference(pageReference))
+        {
+            return tr("Page %1 is not an indirect object, document can't be linearized.").arg(i + 1);
+        }
 
-    return 0;
-}
+        if (isPageTreeObject[pageReference.objectNumber])
+        {
+            return tr("Page %1 is used more than once in the page tree, document can't be linearized.").arg(i + 1);
+        }
 
-qint64 PDFSizeCounterIODevice::readLineData(char* data, qint64 maxlen)
-{
-    Q_UNUSED(data);
-    Q_UNUSED(maxlen);
+        pageObjects[i] = pageReference.objectNumber;
+        isPageTreeObject[pageReference.objectNumber] = true;
+    }
 
-    return 0;
-}
+    const PDFDictionary* catalogDictionary = storage.getDictionaryFromObject(rootObject);
+    if (!catalogDictionary)
+    {
+        return tr("Document catalog is not a dictionary, document can't be linearized.");
+    }
 
-qint64 PDFSizeCounterIODevice::writeData(const char* data, qint64 len)
-{
-    Q_UNUSED(data);
+    std::vector<PDFObject> pageTreeNodes = { catalogDictionary->get("Pages") };
+    while (!pageTreeNodes.empty())
+    {
+        PDFObject pageTreeNode = qMove(pageTreeNodes.back());
+        pageTreeNodes.pop_back();
 
-    m_fileSize += len;
-    return len;
-}
+        if (!pageTreeNode.isReference() || !isValidReference(pageTreeNode.getReference()) || isPageTreeObject[pageTreeNode.getReference().objectNumber])
+        {
+            continue;
+        }
 
-qint64 PDFDocumentWriter::getDocumentFileSize(const PDFDocument* document)
-{
-    PDFSizeCounterIODevice device(nullptr);
-    PDFDocumentWriter writer(nullptr);
+        isPageTreeObject[pageTreeNode.getReference().objectNumber] = true;
+        if (const PDFDictionary* pageTreeNodeDictionary = storage.getDictionaryFromObject(pageTreeNode))
+        {
+            const PDFObject& kids = storage.getObject(pageTreeNodeDictionary->get("Kids"));
+            if (kids.isArray())
+            {
+                for (const PDFObject& kid : *kids.getArray())
+                {
+                    pageTreeNodes.push_back(kid);
+                }
+            }
+        }
+    }
 
-    device.open(QIODevice::WriteOnly);
+    enum class Part : uint8_t
+    {
+        None,           ///< Object was not yet assigned
+        DocumentLevel,  ///< Catalog and objects needed to open the document
+        FirstPage,      ///< Objects needed to display first page
+        Page,           ///< Objects used only by single page (except first page)
+        Shared,         ///< Objects shared by more pages (except first page)
+        Other           ///< Remaining objects
+    };
+
+    std::vector<Part> parts(objectCount, Part::None);
+
+    // Document level objects: catalog, objects needed to open the document and encryption dictionary
+    std::vector<PDFInteger> documentLevelObjects;
+    auto addDocumentLevelObject = [&](const PDFObject& object)
+    {
+        if (object.isReference() && isValidReference(object.getReference()))
+        {
+            const PDFInteger objectNumber = object.getReference().objectNumber;
+            if (parts[objectNumber] == Part::None && !isPageTreeObject[objectNumber])
+            {
+                parts[objectNumber] = Part::DocumentLevel;
+                documentLevelObjects.push_back(objectNumber);
+            }
+        }
+    };
 
-    if (writer.write(&device, document))
+    addDocumentLevelObject(rootObject);
+    for (const char* key : { "ViewerPreferences", "Threads", "OpenAction", "AcroForm" })
     {
-        device.close();
-        return device.pos();
+        addDocumentLevelObject(catalogDictionary->get(key));
     }
+    addDocumentLevelObject(document->getTrailerDictionary()->get("Encrypt"));
+
+    // Traverse objects of each page. Page object is always first.
+    std::vector<std::vector<PDFInteger>> pageObjectLists(pageCount);
+    std::vector<size_t> visitedByPage(objectCount, 0);
+    std::vector<PDFInteger> pageUsageCount(objectCount, 0);
+    std::vector<bool> isUsedByFirstPage(objectCount, false);
+    for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+    {
+        std::vector<PDFInteger>& pageObjectList = pageObjectLists[pageIndex];
+        std::vector<PDFInteger> stack = { pageObjects[pageIndex] };
+        visitedByPage[pageObjects[pageIndex]] = pageIndex + 1;
 
-    device.close();
-    return -1;
-}
+        while (!stack.empty())
+        {
+            const PDFInteger objectNumber = stack.back();
+            stack.pop_back();
 
-qint64 PDFDocumentWriter::getObjectSize(const PDFDocument* document, PDFObjectReference reference)
-{
-    const PDFObject& object = document->getObjectByReference(reference);
+            pageObjectList.push_back(objectNumber);
+            if (pageIndex == 0)
+            {
+                isUsedByFirstPage[objectNumber] = true;
+            }
+            else
+            {
+                ++pageUsageCount[objectNumber];
+            }
+
+            const std::vector<PDFObjectReference>& objectReferences = references[objectNumber];
+            for (auto it = objectReferences.crbegin(); it != objectReferences.crend(); ++it)
+            {
+                const PDFObjectReference reference = *it;
+                if (!isValidReference(reference))
+                {
+                    continue;
+                }
+
+                const PDFInteger referencedObjectNumber = reference.objectNumber;
+                if (visitedByPage[referencedObjectNumber] == pageIndex + 1 ||
+                    isPageTreeObject[referencedObjectNumber] ||
+                    parts[referencedObjectNumber] == Part::DocumentLevel)
+                {
+                    continue;
+                }
+
+                visitedByPage[referencedObjectNumber] = pageIndex + 1;
+                stack.push_back(referencedObjectNumber);
+            }
+        }
+    }
+
+    // Classify objects. Objects needed by the first page are in the first page
+    // section, even if they are shared with other pages.
+    const std::vector<PDFInteger>& firstPageObjects = pageObjectLists.front();
+    for (const PDFInteger objectNumber : firstPageObjects)
+    {
+        parts[objectNumber] = Part::FirstPage;
+    }
+
+    std::vector<std::vector<PDFInteger>> pagePrivateObjects(pageCount);
+    std::vector<PDFInteger> sharedObjects;
+    for (size_t pageIndex = 1; pageIndex < pageCount; ++pageIndex)
+    {
+        for (const PDFInteger objectNumber : pageObjectLists[pageIndex])
+        {
+            if (parts[objectNumber] != Part::None)
+            {
+                continue;
+            }
+
+            if (pageUsageCount[objectNumber] == 1)
+            {
+                parts[objectNumber] = Part::Page;
+                pagePrivateObjects[pageIndex].push_back(objectNumber);
+            }
+            else
+            {
+                parts[objectNumber] = Part::Shared;
+                sharedObjects.push_back(objectNumber);
+            }
+        }
+    }
+
+    std::vector<PDFInteger> otherObjects;
+    for (PDFInteger objectNumber = 1; objectNumber < objectCount; ++objectNumber)
+    {
+        if (parts[objectNumber] == Part::None && !objects[objectNumber].object.isNull())
+        {
+            parts[objectNumber] = Part::Other;
+            otherObjects.push_back(objectNumber);
+        }
+    }
+
+    // Renumber objects. Objects of the main section (remaining pages, shared
+    // objects and other objects) have lower object numbers, than objects
+    // of the first page section, which are at the beginning of the file.
+    std::vector<PDFInteger> mainSectionObjects;
+    mainSectionObjects.reserve(objectCount);
+    for (const std::vector<PDFInteger>& pageObjectList : pagePrivateObjects)
+    {
+        mainSectionObjects.insert(mainSectionObjects.end(), pageObjectList.cbegin(), pageObjectList.cend());
+    }
+    mainSectionObjects.insert(mainSectionObjects.end(), sharedObjects.cbegin(), sharedObjects.cend());
+    mainSectionObjects.insert(mainSectionObjects.end(), otherObjects.cbegin(), otherObjects.cend());
+
+    const PDFInteger mainSectionSize = static_cast<PDFInteger>(mainSectionObjects.size()) + 1;
+    const PDFInteger linearizationDictionaryObjectNumber = mainSectionSize;
+    const PDFInteger firstDocumentLevelObjectNumber = linearizationDictionaryObjectNumber + 1;
+    const PDFInteger hintStreamObjectNumber = firstDocumentLevelObjectNumber + static_cast<PDFInteger>(documentLevelObjects.size());
+    const PDFInteger firstPageObjectNumber = hintStreamObjectNumber + 1;
+    const PDFInteger totalObjectCount = firstPageObjectNumber + static_cast<PDFInteger>(firstPageObjects.size());
+
+    std::vector<PDFInteger> newObjectNumbers(objectCount, 0);
+    std::vector<PDFInteger> oldObjectNumbers(totalObjectCount, 0);
+    auto assignObjectNumbers = [&](const std::vector<PDFInteger>& objectList, PDFInteger firstObjectNumber)
+    {
+        for (size_t i = 0; i < objectList.size(); ++i)
+        {
+            const PDFInteger newObjectNumber = firstObjectNumber + static_cast<PDFInteger>(i);
+            newObjectNumbers[objectList[i]] = newObjectNumber;
+            oldObjectNumbers[newObjectNumber] = objectList[i];
+        }
+    };
+    assignObjectNumbers(mainSectionObjects, 1);
+    assignObjectNumbers(documentLevelObjects, firstDocumentLevelObjectNumber);
+    assignObjectNumbers(firstPageObjects, firstPageObjectNumber);
+
+    // References to non-existing objects are redirected to the object number
+    // beyond the cross-reference table, so they are still treated as null.
+    std::map<PDFObjectReference, PDFObjectReference> referenceMapping;
+    for (PDFInteger objectNumber = 1; objectNumber < objectCount; ++objectNumber)
+    {
+        const PDFObjectStorage::Entry& entry = objects[objectNumber];
+        if (!entry.object.isNull())
+        {
+            referenceMapping[PDFObjectReference(objectNumber, entry.generation)] = PDFObjectReference(newObjectNumbers[objectNumber], 0);
+        }
+
+        for (const PDFObjectReference& reference : references[objectNumber])
+        {
+            if (!isValidReference(reference))
+            {
+                referenceMapping[reference] = PDFObjectReference(totalObjectCount, 0);
+            }
+        }
+    }
+
+    PDFObjectReference encryptObjectReference = getEncryptObjectReference(document);
+    auto encryptObjectReferenceIt = referenceMapping.find(encryptObjectReference);
+    if (encryptObjectReferenceIt != referenceMapping.cend())
+    {
+        encryptObjectReference = encryptObjectReferenceIt->second;
+    }
+
+    // Serialize renumbered objects, each object is independent on the others
+    std::vector<QByteArray> serializedObjects(totalObjectCount);
+    std::vector<PDFInteger> serializedObjectNumbers;
+    serializedObjectNumbers.reserve(totalObjectCount);
+    for (PDFInteger newObjectNumber = 1; newObjectNumber < totalObjectCount; ++newObjectNumber)
+    {
+        if (newObjectNumber != linearizationDictionaryObjectNumber && newObjectNumber != hintStreamObjectNumber)
+        {
+            serializedObjectNumbers.push_back(newObjectNumber);
+        }
+    }
+
+    auto serializeObject = [&](PDFInteger newObjectNumber)
+    {
+        PDFObject object = PDFObjectUtils::replaceReferences(objects[oldObjectNumbers[newObjectNumber]].object, referenceMapping);
+
+        QBuffer buffer(&serializedObjects[newObjectNumber]);
+        buffer.open(QBuffer::WriteOnly);
+        writeObject(&buffer, storage, PDFObjectReference(newObjectNumber, 0), object, encryptObjectReference);
+        buffer.close();
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, serializedObjectNumbers.begin(), serializedObjectNumbers.end(), serializeObject);
+
+    PDFObject trailerDictionaryObject = PDFObjectUtils::replaceReferences(PDFObject::createDictionary(std::make_shared<PDFDictionary>(createTrailerDictionary(document))), referenceMapping);
+    PDFDictionary trailerDictionary = *trailerDictionaryObject.getDictionary();
+    trailerDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(totalObjectCount));
+
+    QByteArray header;
+    {
+        QBuffer buffer(&header);
+        buffer.open(QBuffer::WriteOnly);
+        writeHeader(&buffer, document->getInfo()->version);
+        buffer.close();
+    }
+
+    auto getBitCount = [](PDFInteger value) -> PDFBitWriter::Value
+    {
+        return static_cast<PDFBitWriter::Value>(std::bit_width(static_cast<uint64_t>(qMax(value, PDFInteger(0)))));
+    };
+
+    auto getMinMax = [](const std::vector<PDFInteger>& values) -> std::pair<PDFInteger, PDFInteger>
+    {
+        if (values.empty())
+        {
+            return std::make_pair(PDFInteger(0), PDFInteger(0));
+        }
+
+        auto [minIt, maxIt] = std::minmax_element(values.cbegin(), values.cend());
+        return std::make_pair(*minIt, *maxIt);
+    };
+
+    // Index of objects in the shared object hint table. First page
+    // objects are at the beginning, followed by the shared objects.
+    std::vector<PDFInteger> sharedObjectIdentifiers(objectCount, -1);
+    for (size_t i = 0; i < firstPageObjects.size(); ++i)
+    {
+        sharedObjectIdentifiers[firstPageObjects[i]] = static_cast<PDFInteger>(i);
+    }
+    for (size_t i = 0; i < sharedObjects.size(); ++i)
+    {
+        sharedObjectIdentifiers[sharedObjects[i]] = static_cast<PDFInteger>(firstPageObjects.size() + i);
+    }
+
+    std::vector<std::vector<PDFInteger>> pageSharedIdentifiers(pageCount);
+    for (size_t pageIndex = 1; pageIndex < pageCount; ++pageIndex)
+    {
+        for (const PDFInteger objectNumber : pageObjectLists[pageIndex])
+        {
+            if (parts[objectNumber] == Part::FirstPage || parts[objectNumber] == Part::Shared)
+            {
+                pageSharedIdentifiers[pageIndex].push_back(sharedObjectIdentifiers[objectNumber]);
+            }
+        }
+    }
+
+    // Creates hint stream data. Offsets in the hint tables are offsets
+    // in the file as if the hint stream was not present.
+    auto createHintStreamData = [&](const std::vector<PDFInteger>& offsets, PDFInteger* sharedObjectHintTableOffset) -> QByteArray
+    {
+        auto getObjectLength = [&serializedObjects](PDFInteger newObjectNumber) { return static_cast<PDFInteger>(serializedObjects[newObjectNumber].size()); };
+        auto getGroupLength = [&](const std::vector<PDFInteger>& objectList)
+        {
+            const PDFInteger firstObject = newObjectNumbers[objectList.front()];
+            const PDFInteger lastObject = newObjectNumbers[objectList.back()];
+            return offsets[lastObject] + getObjectLength(lastObject) - offsets[firstObject];
+        };
+
+        std::vector<PDFInteger> pageObjectCounts(pageCount, 0);
+        std::vector<PDFInteger> pageLengths(pageCount, 0);
+        std::vector<PDFInteger> pageSharedObjectCounts(pageCount, 0);
+        PDFInteger maxSharedIdentifier = 0;
+        for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+        {
+            const std::vector<PDFInteger>& pageObjectList = (pageIndex == 0) ? firstPageObjects : pagePrivateObjects[pageIndex];
+            pageObjectCounts[pageIndex] = static_cast<PDFInteger>(pageObjectList.size());
+            pageLengths[pageIndex] = getGroupLength(pageObjectList);
+            pageSharedObjectCounts[pageIndex] = static_cast<PDFInteger>(pageSharedIdentifiers[pageIndex].size());
+
+            for (const PDFInteger identifier : pageSharedIdentifiers[pageIndex])
+            {
+                maxSharedIdentifier = qMax(maxSharedIdentifier, identifier);
+            }
+        }
+
+        const auto [minObjectCount, maxObjectCount] = getMinMax(pageObjectCounts);
+        const auto [minPageLength, maxPageLength] = getMinMax(pageLengths);
+        const auto [minSharedObjectCount, maxSharedObjectCount] = getMinMax(pageSharedObjectCounts);
+        Q_UNUSED(minSharedObjectCount);
+
+        const PDFBitWriter::Value objectCountBits = getBitCount(maxObjectCount - minObjectCount);
+        const PDFBitWriter::Value pageLengthBits = getBitCount(maxPageLength - minPageLength);
+        const PDFBitWriter::Value sharedObjectCountBits = getBitCount(maxSharedObjectCount);
+        const PDFBitWriter::Value sharedIdentifierBits = getBitCount(maxSharedIdentifier);
+
+        // Page offset hint table. Content stream offsets and lengths are
+        // not tracked separately, whole page is treated as its content.
+        PDFBitWriter writer(8);
+        writer.write(minObjectCount, 32);
+        writer.write(offsets[firstPageObjectNumber], 32);
+        writer.write(objectCountBits, 16);
+        writer.write(minPageLength, 32);
+        writer.write(pageLengthBits, 16);
+        writer.write(0, 32);
+        writer.write(0, 16);
+        writer.write(minPageLength, 32);
+        writer.write(pageLengthBits, 16);
+        writer.write(sharedObjectCountBits, 16);
+        writer.write(sharedIdentifierBits, 16);
+        writer.write(0, 16);
+        writer.write(1, 16);
+
+        for (const PDFInteger value : pageObjectCounts)
+        {
+            writer.write(value - minObjectCount, objectCountBits);
+        }
+        writer.finishLine();
+
+        for (const PDFInteger value : pageLengths)
+        {
+            writer.write(value - minPageLength, pageLengthBits);
+        }
+        writer.finishLine();
+
+        for (const PDFInteger value : pageSharedObjectCounts)
+        {
+            writer.write(value, sharedObjectCountBits);
+        }
+        writer.finishLine();
+
+        for (const std::vector<PDFInteger>& identifiers : pageSharedIdentifiers)
+        {
+            for (const PDFInteger identifier : identifiers)
+            {
+                writer.write(identifier, sharedIdentifierBits);
+            }
+        }
+        writer.finishLine();
+
+        for (const PDFInteger value : pageLengths)
+        {
+            writer.write(value - minPageLength, pageLengthBits);
+        }
+        writer.finishLine();
+
+        QByteArray hintStreamData = writer.takeByteArray();
+        *sharedObjectHintTableOffset = hintStreamData.size();
+
+        // Shared object hint table, each object forms its own group
+        std::vector<PDFInteger> groupLengths;
+        groupLengths.reserve(firstPageObjects.size() + sharedObjects.size());
+        for (const std::vector<PDFInteger>* objectList : { &firstPageObjects, &sharedObjects })
+        {
+            for (const PDFInteger objectNumber : *objectList)
+            {
+                groupLengths.push_back(getObjectLength(newObjectNumbers[objectNumber]));
+            }
+        }
+
+        const auto [minGroupLength, maxGroupLength] = getMinMax(groupLengths);
+        const PDFBitWriter::Value groupLengthBits = getBitCount(maxGroupLength - minGroupLength);
+        const PDFInteger firstSharedObjectNumber = !sharedObjects.empty() ? newObjectNumbers[sharedObjects.front()] : 0;
+
+        writer.write(firstSharedObjectNumber, 32);
+        writer.write(firstSharedObjectNumber > 0 ? offsets[firstSharedObjectNumber] : 0, 32);
+        writer.write(static_cast<PDFInteger>(firstPageObjects.size()), 32);
+        writer.write(static_cast<PDFInteger>(groupLengths.size()), 32);
+        writer.write(0, 16);
+        writer.write(minGroupLength, 32);
+        writer.write(groupLengthBits, 16);
+
+        for (const PDFInteger value : groupLengths)
+        {
+            writer.write(value - minGroupLength, groupLengthBits);
+        }
+        writer.finishLine();
+
+        // Signatures of shared object groups are not present
+        for (size_t i = 0; i < groupLengths.size(); ++i)
+        {
+            writer.write(0, 1);
+        }
+        writer.finishLine();
+
+        hintStreamData.append(writer.takeByteArray());
+        return hintStreamData;
+    };
+
+    // Compute the layout of the file. Sizes of the linearization dictionary
+    // and first page cross-reference section depend on offsets, which depend
+    // on these sizes, so the layout is computed repeatedly until it is stable.
+    std::vector<PDFInteger> offsets(totalObjectCount, 0);
+    QByteArray linearizationDictionaryData;
+    QByteArray firstPageCrossReferenceData;
+    QByteArray hintStreamObjectData;
+    QByteArray mainCrossReferenceData;
+
+    constexpr int MAX_LAYOUT_ITERATIONS = 16;
+    bool isLayoutStable = false;
+    for (int iteration = 0; iteration < MAX_LAYOUT_ITERATIONS && !isLayoutStable; ++iteration)
+    {
+        // Offsets as if hint stream was not present
+        PDFInteger position = header.size() + linearizationDictionaryData.size() + firstPageCrossReferenceData.size();
+        const PDFInteger firstPageCrossReferenceOffset = header.size() + linearizationDictionaryData.size();
+
+        auto layoutObjects = [&](PDFInteger firstObjectNumber, PDFInteger lastObjectNumber)
+        {
+            for (PDFInteger newObjectNumber = firstObjectNumber; newObjectNumber < lastObjectNumber; ++newObjectNumber)
+            {
+                offsets[newObjectNumber] = position;
+                position += serializedObjects[newObjectNumber].size();
+            }
+        };
+
+        layoutObjects(firstDocumentLevelObjectNumber, hintStreamObjectNumber);
+        const PDFInteger hintStreamOffset = position;
+        layoutObjects(firstPageObjectNumber, totalObjectCount);
+        const PDFInteger endOfFirstPageSectionOffset = position;
+        layoutObjects(1, mainSectionSize);
+
+        PDFInteger sharedObjectHintTableOffset = 0;
+        QByteArray hintStreamData = createHintStreamData(offsets, &sharedObjectHintTableOffset);
+
+        PDFDictionary hintStreamDictionary;
+        hintStreamDictionary.addEntry(PDFInplaceOrMemoryString("S"), PDFObject::createInteger(sharedObjectHintTableOffset));
+        hintStreamDictionary.addEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(hintStreamData.size()));
+        PDFObject hintStream = PDFObject::createStream(std::make_shared<PDFStream>(qMove(hintStreamDictionary), qMove(hintStreamData)));
+
+        hintStreamObjectData.clear();
+        {
+            QBuffer buffer(&hintStreamObjectData);
+            buffer.open(QBuffer::WriteOnly);
+            writeObject(&buffer, storage, PDFObjectReference(hintStreamObjectNumber, 0), hintStream, encryptObjectReference);
+            buffer.close();
+        }
+
+        // Now shift offsets of objects after the hint stream to real offsets
+        const PDFInteger hintStreamSize = hintStreamObjectData.size();
+        std::vector<PDFInteger> realOffsets = offsets;
+        for (PDFInteger newObjectNumber = 1; newObjectNumber < totalObjectCount; ++newObjectNumber)
+        {
+            if (newObjectNumber < linearizationDictionaryObjectNumber || newObjectNumber >= firstPageObjectNumber)
+            {
+                realOffsets[newObjectNumber] += hintStreamSize;
+            }
+        }
+        realOffsets[linearizationDictionaryObjectNumber] = header.size();
+        realOffsets[hintStreamObjectNumber] = hintStreamOffset;
+
+        const PDFInteger endOfFirstPageOffset = endOfFirstPageSectionOffset + hintStreamSize;
+        const PDFInteger mainCrossReferenceOffset = position + hintStreamSize;
+
+        // Main cross-reference table, it is referenced from first page trailer dictionary
+        QByteArray newMainCrossReferenceData;
+        PDFInteger firstEntryOffset = 0;
+        {
+            QBuffer buffer(&newMainCrossReferenceData);
+            buffer.open(QBuffer::WriteOnly);
+            buffer.write("xref");
+            writeCRLF(&buffer);
+            buffer.write(QString("0 %1").arg(mainSectionSize).toLatin1());
+            writeCRLF(&buffer);
+            firstEntryOffset = mainCrossReferenceOffset + buffer.pos();
+
+            writeCrossReferenceEntry(&buffer, 0, 65535, false);
+            for (PDFInteger newObjectNumber = 1; newObjectNumber < mainSectionSize; ++newObjectNumber)
+            {
+                writeCrossReferenceEntry(&buffer, realOffsets[newObjectNumber], 0, true);
+            }
+
+            PDFDictionary mainTrailerDictionary;
+            mainTrailerDictionary.addEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(mainSectionSize));
+
+            buffer.write("trailer");
+            writeCRLF(&buffer);
+            buffer.write(getSerializedObject(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(mainTrailerDictionary)))));
+            writeCRLF(&buffer);
+            buffer.write("startxref");
+            writeCRLF(&buffer);
+            buffer.write(QString::number(firstPageCrossReferenceOffset).toLatin1());
+            writeCRLF(&buffer);
+            buffer.write("%%EOF");
+            buffer.close();
+        }
+
+        const PDFInteger fileLength = mainCrossReferenceOffset + newMainCrossReferenceData.size();
+
+        // Linearization parameter dictionary
+        QByteArray newLinearizationDictionaryData;
+        {
+            std::vector<PDFObject> hintStreamLocation = { PDFObject::createInteger(hintStreamOffset), PDFObject::createInteger(hintStreamSize) };
+
+            PDFDictionary linearizationDictionary;
+            linearizationDictionary.addEntry(PDFInplaceOrMemoryString("Linearized"), PDFObject::createReal(1.0));
+            linearizationDictionary.addEntry(PDFInplaceOrMemoryString("L"), PDFObject::createInteger(fileLength));
+            linearizationDictionary.addEntry(PDFInplaceOrMemoryString("H"), PDFObject::createArray(std::make_shared<PDFArray>(qMove(hintStreamLocation))));
+            linearizationDictionary.addEntry(PDFInplaceOrMemoryString("O"), PDFObject::createInteger(firstPageObjectNumber));
+            linearizationDictionary.addEntry(PDFInplaceOrMemoryString("E"), PDFObject::createInteger(endOfFirstPageOffset));
+            linearizationDictionary.addEntry(PDFInplaceOrMemoryString("N"), PDFObject::createInteger(static_cast<PDFInteger>(pageCount)));
+            linearizationDictionary.addEntry(PDFInplaceOrMemoryString("T"), PDFObject::createInteger(firstEntryOffset - 1));
+            PDFObject linearizationDictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(linearizationDictionary)));
+
+            // Linearization dictionary is never encrypted
+            QBuffer buffer(&newLinearizationDictionaryData);
+            buffer.open(QBuffer::WriteOnly);
+            PDFWriteObjectVisitor visitor(&buffer);
+            writeObjectHeader(&buffer, PDFObjectReference(linearizationDictionaryObjectNumber, 0));
+            linearizationDictionaryObject.accept(&visitor);
+            writeObjectFooter(&buffer);
+            buffer.close();
+        }
+
+        // First page cross-reference table and trailer
+        QByteArray newFirstPageCrossReferenceData;
+        {
+            QBuffer buffer(&newFirstPageCrossReferenceData);
+            buffer.open(QBuffer::WriteOnly);
+            buffer.write("xref");
+            writeCRLF(&buffer);
+            buffer.write(QString("%1 %2").arg(linearizationDictionaryObjectNumber).arg(totalObjectCount - linearizationDictionaryObjectNumber).toLatin1());
+            writeCRLF(&buffer);
+
+            for (PDFInteger newObjectNumber = linearizationDictionaryObjectNumber; newObjectNumber < totalObjectCount; ++newObjectNumber)
+            {
+                writeCrossReferenceEntry(&buffer, realOffsets[newObjectNumber], 0, true);
+            }
+
+            PDFDictionary firstPageTrailerDictionary = trailerDictionary;
+            firstPageTrailerDictionary.setEntry(PDFInplaceOrMemoryString("Prev"), PDFObject::createInteger(mainCrossReferenceOffset));
+
+            buffer.write("trailer");
+            writeCRLF(&buffer);
+            buffer.write(getSerializedObject(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(firstPageTrailerDictionary)))));
+            writeCRLF(&buffer);
+            buffer.write("startxref");
+            writeCRLF(&buffer);
+            buffer.write("0");
+            writeCRLF(&buffer);
+            buffer.write("%%EOF");
+            writeCRLF(&buffer);
+            buffer.close();
+        }
+
+        isLayoutStable = newLinearizationDictionaryData.size() == linearizationDictionaryData.size() &&
+                         newFirstPageCrossReferenceData.size() == firstPageCrossReferenceData.size();
+
+        linearizationDictionaryData = qMove(newLinearizationDictionaryData);
+        firstPageCrossReferenceData = qMove(newFirstPageCrossReferenceData);
+        mainCrossReferenceData = qMove(newMainCrossReferenceData);
+    }
+
+    if (!isLayoutStable)
+    {
+        return tr("Layout of linearized document can't be determined.");
+    }
+
+    device->write(header);
+    device->write(linearizationDictionaryData);
+    device->write(firstPageCrossReferenceData);
+
+    for (PDFInteger newObjectNumber = firstDocumentLevelObjectNumber; newObjectNumber < hintStreamObjectNumber; ++newObjectNumber)
+    {
+        device->write(serializedObjects[newObjectNumber]);
+    }
+
+    device->write(hintStreamObjectData);
+
+    for (PDFInteger newObjectNumber = firstPageObjectNumber; newObjectNumber < totalObjectCount; ++newObjectNumber)
+    {
+        device->write(serializedObjects[newObjectNumber]);
+    }
+
+    for (PDFInteger newObjectNumber = 1; newObjectNumber < mainSectionSize; ++newObjectNumber)
+    {
+        device->write(serializedObjects[newObjectNumber]);
+    }
+
+    device->write(mainCrossReferenceData);
+    return true;
+}
+
+PDFOperationResult PDFDocumentWriter::writeIncrementalUpdate(const QString& fileName, const PDFDocument* document)
+{
+    const PDFObjectStorage& storage = document->getStorage();
+    if (!storage.getSecurityHandler()->isEncryptionAllowed())
+    {
+        return tr("Writing of encrypted documents is not supported.");
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadWrite))
+    {
+        return tr("File '%1' can't be opened for writing. %2").arg(fileName, file.errorString());
+    }
+
+    const qint64 originalSize = file.size();
+
+    // Offset of the last cross-reference section is at the end of the file
+    constexpr qint64 TAIL_SIZE = 1024;
+    const qint64 tailOffset = qMax(originalSize - TAIL_SIZE, qint64(0));
+    file.seek(tailOffset);
+    const PDFInteger previousXRefOffset = findLastXRefOffset(file.read(TAIL_SIZE));
+
+    if (previousXRefOffset < 0 || previousXRefOffset >= originalSize)
+    {
+        return tr("File '%1' doesn't contain valid cross-reference section, incremental update is not possible.").arg(fileName);
+    }
+
+    // Cross-reference table starts with 'xref' keyword, otherwise it is a cross-reference stream
+    file.seek(previousXRefOffset);
+    const bool useXRefStream = !file.read(32).trimmed().startsWith("xref");
+
+    PDFOperationResult result = file.seek(originalSize) ? writeIncrementalUpdate(&file, document, previousXRefOffset, useXRefStream) : PDFOperationResult(file.errorString());
+    if (result && (!file.flush() || file.error() != QFile::NoError))
+    {
+        result = tr("File '%1' can't be written. %2").arg(fileName, file.errorString());
+    }
+
+    if (!result)
+    {
+        // Restore original content of the file
+        file.resize(originalSize);
+    }
+
+    file.close();
+    return result;
+}
+
+PDFOperationResult PDFDocumentWriter::writeIncrementalUpdate(QIODevice* device, const PDFDocument* document, PDFInteger previousXRefOffset, bool useXRefStream)
+{
+    if (!device->isWritable())
+    {
+        return tr("Device is not writable.");
+    }
+
+    const PDFObjectStorage& storage = document->getStorage();
+    if (!storage.getSecurityHandler()->isEncryptionAllowed())
+    {
+        return tr("Writing of encrypted documents is not supported.");
+    }
+
+    const PDFInteger objectCount = static_cast<PDFInteger>(storage.getObjectCount());
+    const PDFObjectReference encryptObjectReference = getEncryptObjectReference(document);
+
+    // Collect modified objects. If all objects are modified, then incremental
+    // update contains whole document. Unmodified objects are not loaded at all.
+    std::vector<PDFObjectReference> modifiedObjects = storage.getModifiedObjects();
+    if (!storage.isAllObjectsModified())
+    {
+        auto isHeadOfFreeEntries = [](PDFObjectReference reference) { return reference.objectNumber == 0; };
+        modifiedObjects.erase(std::remove_if(modifiedObjects.begin(), modifiedObjects.end(), isHeadOfFreeEntries), modifiedObjects.end());
+    }
+
+    // Incremental update starts on a new line
+    writeCRLF(device);
+
+    std::vector<PDFInteger> objectNumbers;
+    std::vector<XRefEntry> xrefEntries;
+    objectNumbers.reserve(modifiedObjects.size() + 1);
+    xrefEntries.reserve(modifiedObjects.size() + 1);
+
+    for (const PDFObjectReference reference : modifiedObjects)
+    {
+        objectNumbers.push_back(reference.objectNumber);
+
+        const PDFObject& object = storage.getObject(reference);
+        if (reference.objectNumber == 0)
+        {
+            xrefEntries.push_back({ 0, 0, 65535 });
+        }
+        else if (!object.isNull())
+        {
+            xrefEntries.push_back({ 1, device->pos(), reference.generation });
+            writeObject(device, storage, reference, object, encryptObjectReference);
+        }
+        else
+        {
+            // Object was deleted, next generation number is used
+            xrefEntries.push_back({ 0, 0, qMin(reference.generation + 1, PDFInteger(65535)) });
+        }
+    }
+
+    // Cross-reference stream is also an entry of itself, it gets new object number
+    const PDFObjectReference xrefStreamReference(objectCount, 0);
+    const PDFInteger xrefOffset = device->pos();
+    if (useXRefStream)
+    {
+        objectNumbers.push_back(xrefStreamReference.objectNumber);
+        xrefEntries.push_back({ 1, xrefOffset, 0 });
+    }
+
+    // Consecutive object numbers form subsections (pairs of first object number and object count)
+    std::vector<PDFInteger> subsections;
+    for (size_t i = 0; i < objectNumbers.size();)
+    {
+        size_t subsectionEnd = i + 1;
+        while (subsectionEnd < objectNumbers.size() && objectNumbers[subsectionEnd] == objectNumbers[subsectionEnd - 1] + 1)
+        {
+            ++subsectionEnd;
+        }
+
+        subsections.push_back(objectNumbers[i]);
+        subsections.push_back(static_cast<PDFInteger>(subsectionEnd - i));
+        i = subsectionEnd;
+    }
+
+    if (useXRefStream)
+    {
+        PDFDictionary xrefDictionary = createTrailerDictionary(document);
+        xrefDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(objectCount + 1));
+        xrefDictionary.addEntry(PDFInplaceOrMemoryString("Prev"), PDFObject::createInteger(previousXRefOffset));
+        writeCrossReferenceStream(device, qMove(xrefDictionary), xrefStreamReference, xrefEntries, subsections);
+
+        device->write("startxref");
+        writeCRLF(device);
+        device->write(QString::number(xrefOffset).toLatin1());
+        writeCRLF(device);
+        device->write("%%EOF");
+        return true;
+    }
+
+    device->write("xref");
+    writeCRLF(device);
+
+    auto xrefEntryIt = xrefEntries.cbegin();
+    for (size_t i = 0; i < subsections.size(); i += 2)
+    {
+        device->write(QString("%1 %2").arg(subsections[i]).arg(subsections[i + 1]).toLatin1());
+        writeCRLF(device);
+
+        for (PDFInteger j = 0; j < subsections[i + 1]; ++j, ++xrefEntryIt)
+        {
+            writeCrossReferenceEntry(device, xrefEntryIt->field2, xrefEntryIt->field3, xrefEntryIt->type == 1);
+        }
+    }
+
+    writeTrailer(device, document, xrefOffset, previousXRefOffset);
+    return true;
+}
+
+PDFInteger PDFDocumentWriter::findLastXRefOffset(const QByteArray& data)
+{
+    const int index = data.lastIndexOf(PDF_START_OF_XREF_MARK);
+    if (index == -1)
+    {
+        return -1;
+    }
+
+    PDFLexicalAnalyzer analyzer(data.constData() + index + int(std::strlen(PDF_START_OF_XREF_MARK)), data.constData() + data.size());
+
+    try
+    {
+        PDFLexicalAnalyzer::Token token = analyzer.fetch();
+        if (token.type == PDFLexicalAnalyzer::TokenType::Integer)
+        {
+            return token.data.toLongLong();
+        }
+    }
+    catch (const PDFException&)
+    {
+        // Invalid data, offset can't be found
+    }
+
+    return -1;
+}
+
+PDFObjectReference PDFDocumentWriter::getEncryptObjectReference(const PDFDocument* document)
+{
+    PDFObjectReference encryptObjectReference;
+    PDFObject encryptObject = document->getTrailerDictionary()->get("Encrypt");
+    if (encryptObject.isReference())
+    {
+        encryptObjectReference = encryptObject.getReference();
+    }
+
+    return encryptObjectReference;
+}
+
+void PDFDocumentWriter::writeObject(QIODevice* device,
+                                    const PDFObjectStorage& storage,
+                                    PDFObjectReference reference,
+                                    const PDFObject& object,
+                                    PDFObjectReference encryptObjectReference)
+{
+    const bool isEncrypted = storage.getSecurityHandler()->getMode() != EncryptionMode::None;
+
+    PDFWriteObjectVisitor visitor(device);
+    writeObjectHeader(device, reference);
+
+    if (isEncrypted && reference != encryptObjectReference)
+    {
+        PDFObject objectToWrite = storage.getSecurityHandler()->encryptObject(object, reference);
+        objectToWrite.accept(&visitor);
+    }
+    else
+    {
+        object.accept(&visitor);
+    }
+
+    writeObjectFooter(device);
+}
+
+void PDFDocumentWriter::writeStorageObject(QIODevice* device,
+                                           const PDFObjectStorage& storage,
+                                           PDFObjectReference reference,
+                                           const PDFObject& object,
+                                           PDFObjectReference encryptObjectReference)
+{
+    // Original data are already encrypted using the same security handler
+    // (security handler can't be changed without modification of all objects)
+    QByteArray data = storage.getUnmodifiedObjectData(reference);
+    if (!data.isEmpty())
+    {
+        device->write(data);
+        writeCRLF(device);
+        return;
+    }
+
+    writeObject(device, storage, reference, object, encryptObjectReference);
+}
+
+void PDFDocumentWriter::writeCrossReferenceEntry(QIODevice* device, PDFInteger offset, PDFInteger generation, bool isOccupied)
+{
+    QString offsetString = QString::number(offset).rightJustified(10, QChar('0'), true);
+    QString generationString = QString::number(generation).rightJustified(5, QChar('0'), true);
+
+    device->write(offsetString.toLatin1());
+    device->write(" ");
+    device->write(generationString.toLatin1());
+    device->write(" ");
+    device->write(isOccupied ? "n" : "f");
+    writeCRLF(device);
+}
+
+void PDFDocumentWriter::writeHeader(QIODevice* device, PDFVersion version)
+{
+    device->write(QString("%PDF-%1.%2").arg(version.major).arg(version.minor).toLatin1());
+    writeCRLF(device);
+    device->write("% PDF producer: ");
+    device->write(PDF_LIBRARY_NAME);
+    writeCRLF(device);
+    writeCRLF(device);
+    writeCRLF(device);
+}
+
+PDFDictionary PDFDocumentWriter::createTrailerDictionary(const PDFDocument* document)
+{
+    // Jakub Melka: Adjust trailer dictionary, to be really dictionary, not a stream
+    PDFDictionary trailerDictionary = *document->getTrailerDictionary();
+    PDFDictionary newTrailerDictionary;
+
+    for (const char* entry : { "Size", "Root", "Encrypt", "Info", "ID"})
+    {
+        PDFObject object = trailerDictionary.get(entry);
+        if (!object.isNull())
+        {
+            newTrailerDictionary.addEntry(PDFInplaceOrMemoryString(entry), qMove(object));
+        }
+    }
+
+    return newTrailerDictionary;
+}
+
+void PDFDocumentWriter::writeTrailer(QIODevice* device, const PDFDocument* document, PDFInteger xrefOffset, PDFInteger previousXRefOffset)
+{
+    PDFDictionary newTrailerDictionary = createTrailerDictionary(document);
+
+    if (previousXRefOffset >= 0)
+    {
+        newTrailerDictionary.setEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(document->getStorage().getObjectCount()));
+        newTrailerDictionary.addEntry(PDFInplaceOrMemoryString("Prev"), PDFObject::createInteger(previousXRefOffset));
+    }
+
+    PDFObject trailerDictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(newTrailerDictionary)));
+
+    device->write("trailer");
+    writeCRLF(device);
+    PDFWriteObjectVisitor trailerVisitor(device);
+    trailerDictionaryObject.accept(&trailerVisitor);
+    writeCRLF(device);
+    device->write("startxref");
+    writeCRLF(device);
+    device->write(QString::number(xrefOffset).toLatin1());
+    writeCRLF(device);
+
+    // Write footer
+    device->write("%%EOF");
+}
+
+void PDFDocumentWriter::writeCRLF(QIODevice* device)
+{
+    device->write("\x0D\x0A");
+}
+
+void PDFDocumentWriter::writeObjectHeader(QIODevice* device, PDFObjectReference reference)
+{
+    QString objectHeader = QString("%1 %2 obj").arg(QString::number(reference.objectNumber), QString::number(reference.generation));
+    device->write(objectHeader.toLatin1());
+    writeCRLF(device);
+}
+
+void PDFDocumentWriter::writeObjectFooter(QIODevice* device)
+{
+    device->write("endobj");
+    writeCRLF(device);
+}
+
+class PDFSizeCounterIODevice : public QIODevice
+{
+public:
+    explicit PDFSizeCounterIODevice(QObject* parent) :
+        QIODevice(parent)
+    {
+
+    }
+
+    virtual bool isSequential() const override;
+    virtual bool open(OpenMode mode) override;
+    virtual void close() override;
+    virtual qint64 pos() const override;
+    virtual qint64 size() const override;
+    virtual bool seek(qint64 pos) override;
+    virtual bool atEnd() const override;
+    virtual bool reset() override;
+    virtual qint64 bytesAvailable() const override;
+    virtual qint64 bytesToWrite() const override;
+    virtual bool canReadLine() const override;
+    virtual bool waitForReadyRead(int msecs) override;
+    virtual bool waitForBytesWritten(int msecs) override;
+
+protected:
+    virtual qint64 readData(char* data, qint64 maxlen) override;
+    virtual qint64 readLineData(char* data, qint64 maxlen) override;
+    virtual qint64 writeData(const char* data, qint64 len) override;
+
+private:
+    OpenMode m_openMode = NotOpen;
+    qint64 m_fileSize = 0;
+};
+
+bool PDFSizeCounterIODevice::isSequential() const
+{
+    return true;
+}
+
+bool PDFSizeCounterIODevice::open(OpenMode mode)
+{
+    if (m_openMode == NotOpen)
+    {
+        setOpenMode(mode);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+void PDFSizeCounterIODevice::close()
+{
+    setOpenMode(NotOpen);
+}
+
+qint64 PDFSizeCounterIODevice::pos() const
+{
+    return m_fileSize;
+}
+
+qint64 PDFSizeCounterIODevice::size() const
+{
+    return m_fileSize;
+}
+
+bool PDFSizeCounterIODevice::seek(qint64 pos)
+{
+    Q_UNUSED(pos);
+
+    return false;
+}
+
+bool PDFSizeCounterIODevice::atEnd() const
+{
+    return true;
+}
+
+bool PDFSizeCounterIODevice::reset()
+{
+    return false;
+}
+
+qint64 PDFSizeCounterIODevice::bytesAvailable() const
+{
+    return 0;
+}
+
+qint64 PDFSizeCounterIODevice::bytesToWrite() const
+{
+    return 0;
+}
+
+bool PDFSizeCounterIODevice::canReadLine() const
+{
+    return false;
+}
+
+bool PDFSizeCounterIODevice::waitForReadyRead(int msecs)
+{
+    Q_UNUSED(msecs);
+
+    return false;
+}
+
+bool PDFSizeCounterIODevice::waitForBytesWritten(int msecs)
+{
+    Q_UNUSED(msecs);
+
+    return false;
+}
+
+qint64 PDFSizeCounterIODevice::readData(char* data, qint64 maxlen)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxlen);
+
+    return 0;
+}
+
+qint64 PDFSizeCounterIODevice::readLineData(char* data, qint64 maxlen)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxlen);
+
+    return 0;
+}
+
+qint64 PDFSizeCounterIODevice::writeData(const char* data, qint64 len)
+{
+    Q_UNUSED(data);
+
+    m_fileSize += len;
+    return len;
+}
+
+qint64 PDFDocumentWriter::getDocumentFileSize(const PDFDocument* document)
+{
+    PDFSizeCounterIODevice device(nullptr);
+    PDFDocumentWriter writer(nullptr);
+
+    device.open(QIODevice::WriteOnly);
+
+    if (writer.write(&device, document))
+    {
+        device.close();
+        return device.pos();
+    }
+
+    device.close();
+    return -1;
+}
+
+qint64 PDFDocumentWriter::getObjectSize(const PDFDocument* document, PDFObjectReference reference)
+{
+    const PDFObject& object = document->getObjectByReference(reference);
 
     if (object.isNull())
     {
@@ -577,4 +1704,135 @@ QByteArray PDFDocumentWriter::getSerializedObject(const PDFObject& object)
     return buffer.data();
 }
 
+PDFStreamingDocumentWriter::PDFStreamingDocumentWriter(QIODevice* device, PDFVersion version) :
+    m_device(device),
+    m_entries(1)
+{
+    if (m_device->isWritable())
+    {
+        PDFDocumentWriter::writeHeader(m_device, version);
+    }
+}
+
+PDFObjectReference PDFStreamingDocumentWriter::reserveReference()
+{
+    Entry entry;
+    entry.reserved = true;
+    m_entries.push_back(entry);
+    return PDFObjectReference(PDFInteger(m_entries.size()) - 1, 0);
+}
+
+void PDFStreamingDocumentWriter::reserveReference(PDFObjectReference reference)
+{
+    if (reference.objectNumber <= 0 || reference.generation < 0)
+    {
+        throw PDFException(tr("Invalid reference %1 %2 R.").arg(reference.objectNumber).arg(reference.generation));
+    }
+
+    if (reference.objectNumber >= PDFInteger(m_entries.size()))
+    {
+        m_entries.resize(reference.objectNumber + 1);
+    }
+
+    Entry& entry = m_entries[reference.objectNumber];
+    if (entry.reserved)
+    {
+        throw PDFException(tr("Reference %1 %2 R is already reserved.").arg(reference.objectNumber).arg(reference.generation));
+    }
+
+    entry.generation = reference.generation;
+    entry.reserved = true;
+}
+
+void PDFStreamingDocumentWriter::beginWriteObject(PDFObjectReference reference)
+{
+    if (reference.objectNumber <= 0 ||
+        reference.objectNumber >= PDFInteger(m_entries.size()) ||
+        !m_entries[reference.objectNumber].reserved ||
+        m_entries[reference.objectNumber].generation != reference.generation)
+    {
+        throw PDFException(tr("Invalid reference %1 %2 R.").arg(reference.objectNumber).arg(reference.generation));
+    }
+
+    Entry& entry = m_entries[reference.objectNumber];
+    if (m_isFinished || entry.offset != -1)
+    {
+        throw PDFException(tr("Object %1 %2 R is already written.").arg(reference.objectNumber).arg(reference.generation));
+    }
+
+    entry.offset = m_device->pos();
+    ++m_writtenObjectCount;
+}
+
+void PDFStreamingDocumentWriter::writeObject(PDFObjectReference reference, const PDFObject& object)
+{
+    beginWriteObject(reference);
+
+    PDFWriteObjectVisitor visitor(m_device);
+    PDFDocumentWriter::writeObjectHeader(m_device, reference);
+    object.accept(&visitor);
+    PDFDocumentWriter::writeObjectFooter(m_device);
+}
+
+void PDFStreamingDocumentWriter::writeSerializedObject(PDFObjectReference reference, const QByteArray& serializedObject)
+{
+    beginWriteObject(reference);
+
+    PDFDocumentWriter::writeObjectHeader(m_device, reference);
+    m_device->write(serializedObject);
+    PDFDocumentWriter::writeObjectFooter(m_device);
+}
+
+PDFOperationResult PDFStreamingDocumentWriter::finish(PDFObjectReference catalogReference, PDFObjectReference infoReference)
+{
+    if (!m_device->isWritable())
+    {
+        return tr("Device is not writable.");
+    }
+
+    if (m_isFinished)
+    {
+        return tr("Document is already finished.");
+    }
+
+    m_isFinished = true;
+
+    // Write cross-reference table
+    const size_t objectCount = m_entries.size();
+    PDFInteger xrefOffset = m_device->pos();
+    m_device->write("xref");
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write(QString("0 %1").arg(objectCount).toLatin1());
+    PDFDocumentWriter::writeCRLF(m_device);
+
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        const Entry& entry = m_entries[i];
+        const PDFInteger generation = (i == 0) ? 65535 : (entry.offset != -1 ? entry.generation : 0);
+        PDFDocumentWriter::writeCrossReferenceEntry(m_device, qMax(entry.offset, PDFInteger(0)), generation, entry.offset != -1);
+    }
+
+    PDFDictionary trailerDictionary;
+    trailerDictionary.addEntry(PDFInplaceOrMemoryString("Size"), PDFObject::createInteger(objectCount));
+    trailerDictionary.addEntry(PDFInplaceOrMemoryString("Root"), PDFObject::createReference(catalogReference));
+    if (infoReference.isValid())
+    {
+        trailerDictionary.addEntry(PDFInplaceOrMemoryString("Info"), PDFObject::createReference(infoReference));
+    }
+    PDFObject trailerDictionaryObject = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(trailerDictionary)));
+
+    m_device->write("trailer");
+    PDFDocumentWriter::writeCRLF(m_device);
+    PDFWriteObjectVisitor trailerVisitor(m_device);
+    trailerDictionaryObject.accept(&trailerVisitor);
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write("startxref");
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write(QString::number(xrefOffset).toLatin1());
+    PDFDocumentWriter::writeCRLF(m_device);
+    m_device->write("%%EOF");
+
+    return true;
+}
+
 }   // namespace pdf
@@ -21,6 +21,7 @@
 #include "pdfdocument.h"
 #include "pdfprogress.h"
 #include "pdfutils.h"
+#include "pdfstreamfilters.h"
 
 #include <QIODevice>
 
@@ -33,6 +34,8 @@ class PDF4QTLIBCORESHARED_EXPORT PDFDocumentWriter
 {
     Q_DECLARE_TR_FUNCTIONS(pdf::PDFDocumentWriter)
 
+    friend class PDFStreamingDocumentWriter;
+
 public:
     explicit inline PDFDocumentWriter(PDFProgress* progress) :
         m_progress(progress)
@@ -56,6 +59,64 @@ public:
     /// \param document Document
     PDFOperationResult write(QIODevice* device, const PDFDocument* document);
 
+    /// Appends incremental update of the document to the file, from which the
+    /// document was loaded. Only objects modified since the document was loaded
+    /// are written, followed by new cross-reference section and trailer with
+    /// /Prev entry, which points to the last cross-reference section of the file.
+    /// Original content of the file isn't changed, so existing digital signatures
+    /// remain valid. If writing fails, then file is restored to its original size.
+    /// \param fileName File name of the original document
+    /// \param document Document
+    PDFOperationResult writeIncrementalUpdate(const QString& fileName, const PDFDocument* document);
+
+    /// Appends incremental update of the document to the output device. Device
+    /// must be writable and positioned at the end of original document data.
+    /// Cross-reference stream should be used, if the last cross-reference section
+    /// of original document is a stream, because cross-reference table can't
+    /// precede cross-reference stream in the chain of cross-reference sections.
+    /// \param device Output device
+    /// \param document Document
+    /// \param previousXRefOffset Offset of the last cross-reference section of original document
+    /// \param useXRefStream Write cross-reference stream instead of cross-reference table
+    PDFOperationResult writeIncrementalUpdate(QIODevice* device, const PDFDocument* document, PDFInteger previousXRefOffset, bool useXRefStream);
+
+    /// Returns offset of the last cross-reference section, i.e. the value
+    /// after the last 'startxref' keyword. If it is not found, -1 is returned.
+    /// \param data Data of the document (or its tail)
+    static PDFInteger findLastXRefOffset(const QByteArray& data);
+
+    /// Returns true, if objects are packed into compressed object streams
+    /// and cross-reference stream is written instead of cross-reference table.
+    bool isObjectStreamsUsed() const { return m_useObjectStreams; }
+
+    /// Enables or disables compact layout of the written document (PDF 1.5).
+    /// If enabled, objects which are not streams are packed into compressed
+    /// object streams and cross-reference stream is written instead of
+    /// cross-reference table. Incremental updates are not affected.
+    /// \param useObjectStreams Use object streams and cross-reference stream
+    void setObjectStreamsUsed(bool useObjectStreams) { m_useObjectStreams = useObjectStreams; }
+
+    /// Returns true, if document is written linearized (fast web view)
+    bool isLinearized() const { return m_linearize; }
+
+    /// Enables or disables linearized layout of the written document
+    /// (fast web view). Objects of the first page are written at the
+    /// beginning of the file, followed by the objects of the remaining
+    /// pages, with hint streams describing the layout. Linearized document
+    /// always uses cross-reference tables, object streams are not used.
+    /// If document has no pages, it is written as usual.
+    /// \param linearize Write linearized document
+    void setLinearized(bool linearize) { m_linearize = linearize; }
+
+    /// Returns compression level used for compressing object streams
+    /// and cross-reference stream.
+    PDFFlateDecodeFilter::CompressionLevel getCompressionLevel() const { return m_compressionLevel; }
+
+    /// Sets compression level used for compressing object streams
+    /// and cross-reference stream.
+    /// \param compressionLevel Compression level
+    void setCompressionLevel(PDFFlateDecodeFilter::CompressionLevel compressionLevel) { m_compressionLevel = compressionLevel; }
+
     /// Calculates document file size, as if it is written to the disk.
     /// No file is accessed by this function; document is written
     /// to fake stream, which counts operations. If error occurs, and
@@ -73,12 +134,141 @@ public:
     static QByteArray getSerializedObject(const PDFObject& object);
 
 private:
+    /// Maximal count of objects in one object stream
+    static constexpr const size_t OBJECT_STREAM_MAX_OBJECT_COUNT = 100;
+
+    /// Entry of the cross-reference stream (type, and two fields, whose
+    /// meaning depends on the type, see PDF specification)
+    struct XRefEntry
+    {
+        uint8_t type = 0;
+        PDFInteger field2 = 0;
+        PDFInteger field3 = 0;
+    };
+
+    /// Writes cross-reference stream object. Entries are written in the order
+    /// of subsections in \p index (pairs of first object number and object count).
+    /// If \p index is empty, then entries are for all objects, starting from zero.
+    /// \param device Output device
+    /// \param dictionary Trailer dictionary, to which stream entries are added
+    /// \param reference Reference of the cross-reference stream
+    /// \param entries Cross-reference entries
+    /// \param index Subsections of the cross-reference stream
+    void writeCrossReferenceStream(QIODevice* device,
+                                   PDFDictionary dictionary,
+                                   PDFObjectReference reference,
+                                   const std::vector<XRefEntry>& entries,
+                                   const std::vector<PDFInteger>& index);
+
+    /// Writes document using object streams and cross-reference stream
+    PDFOperationResult writeWithObjectStreams(QIODevice* device, const PDFDocument* document);
+
+    /// Writes linearized document (fast web view)
+    PDFOperationResult writeLinearized(QIODevice* device, const PDFDocument* document);
+
     static void writeCRLF(QIODevice* device);
+    static void writeHeader(QIODevice* device, PDFVersion version);
+    static PDFDictionary createTrailerDictionary(const PDFDocument* document);
     static void writeObjectHeader(QIODevice* device, PDFObjectReference reference);
     static void writeObjectFooter(QIODevice* device);
+    static void writeCrossReferenceEntry(QIODevice* device, PDFInteger offset, PDFInteger generation, bool isOccupied);
+    static void writeTrailer(QIODevice* device, const PDFDocument* document, PDFInteger xrefOffset, PDFInteger previousXRefOffset);
+
+    /// Writes object (including object header and footer). If storage
+    /// is encrypted, object is encrypted (except encryption dictionary).
+    static void writeObject(QIODevice* device,
+                            const PDFObjectStorage& storage,
+                            PDFObjectReference reference,
+                            const PDFObject& object,
+                            PDFObjectReference encryptObjectReference);
+
+    /// Writes object stored in the storage under given reference. If object was not
+    /// modified since it was read from the document, then its original data are
+    /// written as they are, otherwise object is written using \p writeObject.
+    static void writeStorageObject(QIODevice* device,
+                                   const PDFObjectStorage& storage,
+                                   PDFObjectReference reference,
+                                   const PDFObject& object,
+                                   PDFObjectReference encryptObjectReference);
+
+    /// Returns reference of the encryption dictionary (or invalid reference, if document is not encrypted)
+    static PDFObjectReference getEncryptObjectReference(const PDFDocument* document);
 
     /// Progress indicator
     PDFProgress* m_progress;
+
+    /// Use object streams and cross-reference stream
+    bool m_useObjectStreams = false;
+
+    /// Write linearized document
+    bool m_linearize = false;
+
+    /// Compression level of object streams and cross-reference stream
+    PDFFlateDecodeFilter::CompressionLevel m_compressionLevel = PDFFlateDecodeFilter::CompressionLevel::Maximum;
+};
+
+/// Writes document to the output device object by object, so whole document
+/// isn't held in memory, only offsets of written objects are stored. References
+/// of objects can be reserved in advance, so objects can refer to objects, which
+/// are not written yet. Reserved objects, which are not written, when document
+/// is finished, are written as free objects. Objects are written unencrypted.
+class PDF4QTLIBCORESHARED_EXPORT PDFStreamingDocumentWriter
+{
+    Q_DECLARE_TR_FUNCTIONS(pdf::PDFStreamingDocumentWriter)
+
+public:
+    /// Constructs writer and writes document header. Device must
+    /// be writable (i.e. opened for writing).
+    /// \param device Output device
+    /// \param version Version of the document
+    explicit PDFStreamingDocumentWriter(QIODevice* device, PDFVersion version);
+
+    /// Reserves reference of a new object
+    PDFObjectReference reserveReference();
+
+    /// Reserves given reference, so object can keep its object number and
+    /// generation (for example, when it is copied from other document).
+    /// Object numbers, which are not reserved, are written as free objects.
+    /// \param reference Reference to be reserved
+    void reserveReference(PDFObjectReference reference);
+
+    /// Writes object with reserved reference. Each object can be written only once.
+    /// \param reference Reserved reference
+    /// \param object Object
+    void writeObject(PDFObjectReference reference, const PDFObject& object);
+
+    /// Writes already serialized object with reserved reference (object data
+    /// are written as they are). Each object can be written only once.
+    /// \param reference Reserved reference
+    /// \param serializedObject Serialized object, see PDFDocumentWriter::getSerializedObject
+    void writeSerializedObject(PDFObjectReference reference, const QByteArray& serializedObject);
+
+    /// Writes cross-reference table and trailer, no more objects
+    /// can be written after this function is called.
+    /// \param catalogReference Reference of the document catalog
+    /// \param infoReference Reference of the document information dictionary (can be invalid)
+    PDFOperationResult finish(PDFObjectReference catalogReference, PDFObjectReference infoReference);
+
+    /// Returns count of written objects
+    PDFInteger getWrittenObjectCount() const { return m_writtenObjectCount; }
+
+private:
+    struct Entry
+    {
+        /// Offset of object, -1 means that object was not written
+        PDFInteger offset = -1;
+        PDFInteger generation = 0;
+        bool reserved = false;
+    };
+
+    /// Checks, that object with given reference can be written, and
+    /// marks it as written at current position of the device.
+    void beginWriteObject(PDFObjectReference reference);
+
+    QIODevice* m_device;
+    std::vector<Entry> m_entries;
+    PDFInteger m_writtenObjectCount = 0;
+    bool m_isFinished = false;
 };
 
 }   // namespace pdf
@@ -89,6 +89,11 @@ int PDFExecutionPolicy::getMaxThreadCount(Scope scope)
     return getThreadPool(scope)->maxThreadCount();
 }
 
+int PDFExecutionPolicy::getQueuedTaskCount(Scope scope)
+{
+    return getQueuedTaskCounter(scope)->load(std::memory_order_relaxed);
+}
+
 void PDFExecutionPolicy::setMaxThreadCount(Scope scope, int count)
 {
     // Sanitize value!
@@ -102,6 +107,18 @@ int PDFExecutionPolicy::getIdealThreadCount(Scope scope)
     return QThread::idealThreadCount();
 }
 
+int PDFExecutionPolicy::getThreadBudget(Scope scope)
+{
+    if (!isParallelizing(scope))
+    {
+        return 1;
+    }
+
+    const int idealThreadCount = getIdealThreadCount(scope);
+    const int contentStreamCount = qMax(getContentStreamCount(), 1);
+    return qMax(idealThreadCount / contentStreamCount, 1);
+}
+
 int PDFExecutionPolicy::getContentStreamCount()
 {
     return s_execution_policy.policy.m_contentStreamsCount.load(std::memory_order_relaxed);
@@ -142,8 +159,29 @@ QThreadPool* PDFExecutionPolicy::getThreadPool(PDFExecutionPolicy::Scope scope)
     return nullptr;
 }
 
+std::atomic<int>* PDFExecutionPolicy::getQueuedTaskCounter(Scope scope)
+{
+    switch (scope)
+    {
+        case Scope::Page:
+        case Scope::Unknown:
+            return &s_execution_policy.policy.m_queuedPrimaryTaskCount;
+
+        case Scope::Content:
+            return &s_execution_policy.policy.m_queuedAuxiliaryTaskCount;
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return nullptr;
+}
+
 PDFExecutionPolicy::PDFExecutionPolicy() :
     m_contentStreamsCount(0),
+    m_queuedPrimaryTaskCount(0),
+    m_queuedAuxiliaryTaskCount(0),
     m_strategy(Strategy::PageMultithreaded)
 {
 
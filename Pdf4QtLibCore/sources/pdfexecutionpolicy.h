@@ -20,10 +20,19 @@
 
 #include "pdfglobal.h"
 
+#include <QThread>
 #include <QSemaphore>
 #include <QThreadPool>
 
+#include <map>
+#include <mutex>
+#include <memory>
 #include <atomic>
+#include <vector>
+#include <condition_variable>
+#include <numeric>
+#include <algorithm>
+#include <exception>
 #include <execution>
 
 namespace pdf
@@ -59,46 +68,21 @@ public:
     /// \param scope Scope for which we want to determine execution policy
     static bool isParallelizing(Scope scope);
 
-    template<typename ForwardIt, typename UnaryFunction>
-    class Runnable : public QRunnable
-    {
-    public:
-        explicit inline Runnable(ForwardIt it, ForwardIt itEnd, UnaryFunction* function, QSemaphore* semaphore) :
-            m_forwardIt(qMove(it)),
-            m_forwardItEnd(qMove(itEnd)),
-            m_function(function),
-            m_semaphore(semaphore),
-            m_packSize(static_cast<int>(std::distance(m_forwardIt, m_forwardItEnd)))
-        {
-            setAutoDelete(true);
-        }
-
-        virtual void run() override
-        {
-            QSemaphoreReleaser semaphoreReleaser(m_semaphore, m_packSize);
-            for (auto it = m_forwardIt; it != m_forwardItEnd; ++it)
-            {
-                (*m_function)(*it);
-            }
-        }
-
-    private:
-        ForwardIt m_forwardIt;
-        ForwardIt m_forwardItEnd;
-        UnaryFunction* m_function;
-        QSemaphore* m_semaphore;
-        int m_packSize;
-    };
-
+    /// Executes function \p f for each item in range [first, last). If we are
+    /// parallelizing for given scope, the range is divided into buckets, which
+    /// are processed by helper threads from the thread pool and also by calling
+    /// thread. Calling thread doesn't block while waiting for the helpers, it
+    /// claims buckets and executes them itself, so nested parallel execution
+    /// (for example, content scope inside page scope) always makes progress,
+    /// even if all pool threads are busy. Function returns, when all items
+    /// are processed. If function \p f throws an exception in the calling
+    /// thread, remaining buckets are abandoned and exception is rethrown.
     template<typename ForwardIt, typename UnaryFunction>
     static void execute(Scope scope, ForwardIt first, ForwardIt last, UnaryFunction f)
     {
-        if (isParallelizing(scope))
+        const int count = static_cast<int>(std::distance(first, last));
+        if (count > 1 && isParallelizing(scope))
         {
-            QSemaphore semaphore(0);
-            int count = static_cast<int>(std::distance(first, last));
-            int remainder = count;
-
             int bucketSize = 1;
 
             // For page scope, we do not divide the tasks into buckets, i.e.
@@ -111,25 +95,38 @@ public:
                 bucketSize = qMax(1, count / buckets);
             }
 
-            QThreadPool* pool = getThreadPool(scope);
+            auto task = std::make_shared<ForkJoinTask<ForwardIt, UnaryFunction>>(first, last, count, bucketSize, &f);
 
-            // Divide tasks into buckets with given bucket size
-            auto it = first;
-            while (remainder > 0)
+            // Start helpers. Helpers, which are started by the pool after all buckets
+            // were claimed, do nothing. They hold shared pointer to the task, so task
+            // remains valid, but function is never called after this function returns.
+            QThreadPool* pool = getThreadPool(scope);
+            const int helperCount = qMin(task->bucketCount - 1, pool->maxThreadCount());
+            for (int i = 0; i < helperCount; ++i)
             {
-                const int currentSize = qMin(remainder, bucketSize);
-
-                auto itStart = it;
-                auto itEnd = std::next(it, currentSize);
-                pool->start(new Runnable(itStart, itEnd, &f, &semaphore));
+                onTaskQueued(scope);
+                pool->start([task, scope]() { onTaskStarted(scope); task->process(); });
+            }
 
-                remainder -= currentSize;
-                std::advance(it, currentSize);
+            std::exception_ptr exception;
+            try
+            {
+                task->process();
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
             }
 
-            Q_ASSERT(it == last);
+            // Wait for buckets being processed by the helpers. All buckets
+            // are claimed now (claiming is stopped, if exception occured).
+            const int claimedBuckets = qMin(task->nextBucket.exchange(task->bucketCount), task->bucketCount);
+            task->finishedBuckets.acquire(claimedBuckets);
 
-            semaphore.acquire(count);
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
         }
         else
         {
@@ -137,13 +134,137 @@ public:
         }
     }
 
-    template<typename ForwardIt, typename Comparator>
-    static void sort(Scope scope, ForwardIt first, ForwardIt last, Comparator f)
+    /// Sorts range [first, last) using comparator \p f. If we are parallelizing
+    /// for given scope and range is large enough, the range is divided into
+    /// chunks, which are sorted in parallel and then merged pairwise (merges
+    /// of each round are also performed in parallel). Otherwise, range is
+    /// sorted by single thread.
+    template<typename RandomIt, typename Comparator>
+    static void sort(Scope scope, RandomIt first, RandomIt last, Comparator f)
+    {
+        const std::ptrdiff_t count = std::distance(first, last);
+        const int chunkCount = qMin(QThread::idealThreadCount(), static_cast<int>(count / MIN_PARALLEL_SORT_CHUNK_SIZE));
+
+        if (chunkCount < 2 || !isParallelizing(scope))
+        {
+            std::sort(std::execution::seq, first, last, f);
+            return;
+        }
+
+        // Chunk boundaries, chunk i is [boundaries[i], boundaries[i + 1])
+        std::vector<RandomIt> boundaries;
+        boundaries.reserve(chunkCount + 1);
+        for (int i = 0; i < chunkCount; ++i)
+        {
+            boundaries.push_back(std::next(first, count * i / chunkCount));
+        }
+        boundaries.push_back(last);
+
+        std::vector<size_t> chunks(chunkCount, 0);
+        std::iota(chunks.begin(), chunks.end(), 0);
+        execute(scope, chunks.cbegin(), chunks.cend(), [&](size_t chunk) { std::sort(boundaries[chunk], boundaries[chunk + 1], f); });
+
+        // Merge sorted chunks pairwise, until single chunk remains
+        while (boundaries.size() > 2)
+        {
+            const size_t mergeCount = (boundaries.size() - 1) / 2;
+            std::vector<size_t> merges(mergeCount, 0);
+            std::iota(merges.begin(), merges.end(), 0);
+            execute(scope, merges.cbegin(), merges.cend(), [&](size_t merge) { std::inplace_merge(boundaries[2 * merge], boundaries[2 * merge + 1], boundaries[2 * merge + 2], f); });
+
+            std::vector<RandomIt> mergedBoundaries;
+            mergedBoundaries.reserve(mergeCount + 2);
+            for (size_t i = 0; i < boundaries.size(); i += 2)
+            {
+                mergedBoundaries.push_back(boundaries[i]);
+            }
+            if (mergedBoundaries.back() != last)
+            {
+                mergedBoundaries.push_back(last);
+            }
+            boundaries = qMove(mergedBoundaries);
+        }
+    }
+
+    /// Executes function \p produce for each index in range [0, count) and passes
+    /// the results to function \p consume in order of the indices. If we are
+    /// parallelizing for given scope, results are produced by helper threads from
+    /// the thread pool, while calling thread consumes them (and produces the next
+    /// consumed result itself, if no helper has claimed it yet). At most
+    /// \p maxPendingResults results are produced ahead of the consumer, so memory
+    /// consumption is bounded, even if consumer is slower than producers. Consumer
+    /// is always called from the calling thread. If some of the functions throws
+    /// an exception, remaining indices are abandoned and exception is rethrown.
+    template<typename ProduceFunction, typename ConsumeFunction>
+    static void executeOrdered(Scope scope, size_t count, size_t maxPendingResults, ProduceFunction produce, ConsumeFunction consume)
     {
-        Q_UNUSED(scope);
+        using Result = decltype(produce(size_t()));
+
+        if (count < 2 || !isParallelizing(scope))
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                consume(i, produce(i));
+            }
+            return;
+        }
+
+        auto task = std::make_shared<OrderedTask<Result, ProduceFunction>>(count, qMax(maxPendingResults, size_t(1)), &produce);
+
+        QThreadPool* pool = getThreadPool(scope);
+        const int helperCount = qMin(static_cast<int>(qMin(count, task->maxPendingResults)), pool->maxThreadCount());
+        for (int i = 0; i < helperCount; ++i)
+        {
+            onTaskQueued(scope);
+            pool->start([task, scope]() { onTaskStarted(scope); task->process(); });
+        }
+
+        std::unique_lock<std::mutex> lock(task->mutex);
+        while (task->nextConsumedIndex < count && !task->isStopped)
+        {
+            auto it = task->results.find(task->nextConsumedIndex);
+            if (it != task->results.end())
+            {
+                Result result = qMove(it->second);
+                const size_t index = it->first;
+                task->results.erase(it);
+                ++task->nextConsumedIndex;
+                task->condition.notify_all();
+
+                lock.unlock();
+                try
+                {
+                    consume(index, qMove(result));
+                }
+                catch (...)
+                {
+                    lock.lock();
+                    task->stop(std::current_exception());
+                    break;
+                }
+                lock.lock();
+            }
+            else if (task->nextProducedIndex == task->nextConsumedIndex)
+            {
+                // Nobody is producing the result we are waiting for, produce it ourselves
+                task->produceNext(lock);
+            }
+            else
+            {
+                task->condition.wait(lock);
+            }
+        }
+
+        // Wait for helpers, which are producing results. Helpers, which are
+        // started by the pool after this, do nothing. They hold shared pointer
+        // to the task, so task remains valid, but function is never called.
+        task->stop(nullptr);
+        task->condition.wait(lock, [&task]() { return task->activeProducerCount == 0; });
 
-        // We always sort by single thread
-        std::sort(std::execution::seq, first, last, f);
+        if (task->exception)
+        {
+            std::rethrow_exception(task->exception);
+        }
     }
 
     /// Returns number of active threads for given scope
@@ -152,12 +273,22 @@ public:
     /// Returns maximal number of threads for given scope
     static int getMaxThreadCount(Scope scope);
 
+    /// Returns number of tasks of given scope, which are waiting
+    /// in the queue of the thread pool for a free thread
+    static int getQueuedTaskCount(Scope scope);
+
     /// Sets maximal number of threads for given scope
     static void setMaxThreadCount(Scope scope, int count);
 
     /// Returns ideal thread count for given scope
     static int getIdealThreadCount(Scope scope);
 
+    /// Returns number of threads, which can be used by a single task of given
+    /// scope, which is parallelized internally (for example, by external library
+    /// decoding an image). Threads are divided between currently processed
+    /// content streams, so the threads are not oversubscribed.
+    static int getThreadBudget(Scope scope);
+
     /// Returns number of currently processed content streams
     static int getContentStreamCount();
 
@@ -173,12 +304,148 @@ public:
 private:
     friend struct PDFExecutionPolicyHolder;
 
+    /// Minimal size of the chunk sorted by single thread in parallel sort
+    static constexpr std::ptrdiff_t MIN_PARALLEL_SORT_CHUNK_SIZE = 4096;
+
+    /// Shared state of parallel execution. Buckets are claimed by atomic
+    /// counter, so each bucket is processed exactly once, either by helper
+    /// thread, or by the thread, which started the execution.
+    template<typename ForwardIt, typename UnaryFunction>
+    struct ForkJoinTask
+    {
+        explicit ForkJoinTask(ForwardIt first, ForwardIt last, int count, int bucketSize, UnaryFunction* function) :
+            bucketCount((count + bucketSize - 1) / bucketSize),
+            function(function)
+        {
+            bucketStarts.reserve(bucketCount + 1);
+            for (int i = 0; i < bucketCount; ++i)
+            {
+                bucketStarts.push_back(first);
+                std::advance(first, qMin(bucketSize, count - i * bucketSize));
+            }
+            bucketStarts.push_back(last);
+        }
+
+        /// Claims and executes buckets, until there is no bucket left
+        void process()
+        {
+            int bucket = nextBucket.fetch_add(1, std::memory_order_relaxed);
+            while (bucket < bucketCount)
+            {
+                QSemaphoreReleaser semaphoreReleaser(&finishedBuckets, 1);
+                for (auto it = bucketStarts[bucket]; it != bucketStarts[bucket + 1]; ++it)
+                {
+                    (*function)(*it);
+                }
+
+                bucket = nextBucket.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        const int bucketCount;
+        UnaryFunction* function;
+        std::vector<ForwardIt> bucketStarts;
+        std::atomic<int> nextBucket = 0;
+        QSemaphore finishedBuckets;
+    };
+
+    /// Shared state of ordered parallel execution. Indices are claimed in order,
+    /// results are stored in the map until they are consumed. All members
+    /// are guarded by the mutex.
+    template<typename Result, typename ProduceFunction>
+    struct OrderedTask
+    {
+        explicit OrderedTask(size_t count, size_t maxPendingResults, ProduceFunction* function) :
+            count(count),
+            maxPendingResults(maxPendingResults),
+            function(function)
+        {
+
+        }
+
+        /// Returns true, if next index can be claimed by producer
+        bool canProduce() const { return !isStopped && nextProducedIndex < count && nextProducedIndex < nextConsumedIndex + maxPendingResults; }
+
+        /// Stops the execution, no more indices are claimed
+        void stop(std::exception_ptr stopException)
+        {
+            if (stopException && !exception)
+            {
+                exception = qMove(stopException);
+            }
+            isStopped = true;
+            condition.notify_all();
+        }
+
+        /// Claims next index and produces its result. Lock is released
+        /// during the call of the function.
+        void produceNext(std::unique_lock<std::mutex>& lock)
+        {
+            const size_t index = nextProducedIndex++;
+            ++activeProducerCount;
+            lock.unlock();
+
+            try
+            {
+                Result result = (*function)(index);
+                lock.lock();
+                results.emplace(index, qMove(result));
+            }
+            catch (...)
+            {
+                lock.lock();
+                stop(std::current_exception());
+            }
+
+            --activeProducerCount;
+            condition.notify_all();
+        }
+
+        /// Produces results, until there is no index left (helper thread)
+        void process()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                condition.wait(lock, [this]() { return canProduce() || isStopped || nextProducedIndex >= count; });
+                if (!canProduce())
+                {
+                    break;
+                }
+                produceNext(lock);
+            }
+        }
+
+        const size_t count;
+        const size_t maxPendingResults;
+        ProduceFunction* function;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::map<size_t, Result> results;
+        std::exception_ptr exception;
+        size_t nextProducedIndex = 0;
+        size_t nextConsumedIndex = 0;
+        size_t activeProducerCount = 0;
+        bool isStopped = false;
+    };
+
     /// Returns thread pool based on scope
     static QThreadPool* getThreadPool(Scope scope);
 
+    /// Returns counter of queued tasks based on scope
+    static std::atomic<int>* getQueuedTaskCounter(Scope scope);
+
+    /// Called, when task is queued to the thread pool
+    static void onTaskQueued(Scope scope) { getQueuedTaskCounter(scope)->fetch_add(1, std::memory_order_relaxed); }
+
+    /// Called, when queued task is started by the thread pool
+    static void onTaskStarted(Scope scope) { getQueuedTaskCounter(scope)->fetch_sub(1, std::memory_order_relaxed); }
+
     explicit PDFExecutionPolicy();
 
     std::atomic<int> m_contentStreamsCount;
+    std::atomic<int> m_queuedPrimaryTaskCount;
+    std::atomic<int> m_queuedAuxiliaryTaskCount;
     std::atomic<Strategy> m_strategy;
 };
 
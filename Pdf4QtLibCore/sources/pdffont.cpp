@@ -21,6 +21,8 @@
 #include "pdfnametounicode.h"
 #include "pdfexception.h"
 #include "pdfutils.h"
+#include "pdfdiskcache.h"
+#include "pdftrace.h"
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
@@ -29,12 +31,20 @@
 #include <freetype/ftoutln.h>
 #include <freetype/t1tables.h>
 
+#include <QDir>
 #include <QFile>
 #include <QMutex>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QReadWriteLock>
 #include <QPainterPath>
 #include <QDataStream>
 
+#include <map>
+#include <optional>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 #if defined(Q_OS_WIN)
@@ -128,6 +138,13 @@ public:
 private:
     explicit PDFSystemFontInfoStorage();
 
+    /// Loads font from descriptor, result is not cached
+    /// \param descriptor Descriptor describing the font
+    QByteArray loadFontUncached(const CIDSystemInfo* cidSystemInfo,
+                                const FontDescriptor* descriptor,
+                                StandardFontType standardFontType,
+                                PDFRenderErrorReporter* reporter) const;
+
     /// Loads font from descriptor
     /// \param descriptor Descriptor describing the font
     QByteArray loadFontImpl(const FontDescriptor* descriptor,
@@ -166,6 +183,130 @@ private:
 
     std::vector<FontInfo> m_fontInfos;
 #endif
+
+#ifdef Q_OS_UNIX
+    /// Loads font file. Font files are cached, so each file is read only once.
+    /// \param fileName File name
+    QByteArray loadFontFile(const QString& fileName) const;
+
+    /// Entry of the system font index
+    struct FontIndexEntry
+    {
+        QString family;
+        QString familyAdjusted;
+        QString style;
+        QString fileName;
+        int weight = FC_WEIGHT_NORMAL;
+        int width = FC_WIDTH_NORMAL;
+        int slant = FC_SLANT_ROMAN;
+
+        /// Coverage of the basic multilingual plane, one bit for
+        /// each page of 256 characters.
+        QByteArray coverage;
+
+        bool isCovered(char32_t character) const;
+    };
+
+    /// Compact index of the system fonts, it is persisted on the disk, so
+    /// the platform font database doesn't have to be queried, when font is
+    /// being substituted. Index is valid, until some of font directories
+    /// is modified.
+    struct FontIndex
+    {
+        /// Font directories and their modification times
+        std::vector<std::pair<QString, qint64>> directories;
+
+        /// Indexed fonts
+        std::vector<FontIndexEntry> entries;
+
+        /// Results of font matching by fontconfig (font request, file name),
+        /// for requests, which can't be resolved by font index.
+        std::map<QByteArray, QString> matches;
+    };
+
+    /// Returns font index. Index is loaded from disk, if it is valid,
+    /// otherwise it is built using fontconfig. Index mutex must be locked.
+    FontIndex* getFontIndex() const;
+
+    /// Builds font index using fontconfig
+    static FontIndex buildFontIndex();
+
+    /// Loads font index from the file, returns false, if index
+    /// can't be loaded or it is not valid anymore.
+    static bool loadFontIndex(const QString& fileName, FontIndex& index);
+
+    /// Saves font index to the file
+    static void saveFontIndex(const QString& fileName, const FontIndex& index);
+
+    /// Returns file name of the font index
+    static QString getFontIndexFileName();
+
+    /// Finds font file for given font request
+    /// \param fontName Font name
+    /// \param weight Fontconfig weight
+    /// \param width Fontconfig width, or -1, if width is not specified
+    /// \param slant Fontconfig slant
+    QString findFontFile(const QString& fontName, int weight, int width, int slant) const;
+
+    /// Finds font file for font covering given character, returns empty string,
+    /// if no such font exists.
+    /// \param character Unicode character
+    /// \param isSerif Prefer serif fonts
+    QString findFontFileByCoverage(char32_t character, bool isSerif) const;
+
+    /// Finds font file using fontconfig font matching
+    static QString matchFontFile(const QString& fontName, int weight, int width, int slant);
+
+    static constexpr const quint32 FONT_INDEX_MAGIC = 0x50444649; // 'PDFI'
+    static constexpr const quint32 FONT_INDEX_VERSION = 1;
+
+    /// Mutex for accessing the font index
+    mutable QMutex m_indexMutex;
+
+    /// Font index, it is created on demand
+    mutable std::optional<FontIndex> m_fontIndex;
+#endif
+
+    struct CachedFont
+    {
+        QByteArray fontData;
+        std::vector<std::pair<RenderErrorType, QString>> errors;
+    };
+
+    /// Mutex for accessing the caches below
+    mutable QMutex m_cacheMutex;
+
+    /// Results of font substitution, key is the font request. Errors reported
+    /// during the substitution are stored too, so they can be reported again.
+    mutable std::map<QByteArray, CachedFont> m_fontCache;
+
+    /// Font file data (key is file name)
+    mutable std::map<QString, QByteArray> m_fontFileCache;
+};
+
+/// Error reporter, which forwards errors to another reporter and records them
+class PDFRecordingRenderErrorReporter : public PDFRenderErrorReporter
+{
+public:
+    explicit PDFRecordingRenderErrorReporter(PDFRenderErrorReporter* reporter) : m_reporter(reporter) { }
+
+    virtual void reportRenderError(RenderErrorType type, QString message) override
+    {
+        m_errors.emplace_back(type, message);
+        m_reporter->reportRenderError(type, qMove(message));
+    }
+
+    virtual void reportRenderErrorOnce(RenderErrorType type, QString message) override
+    {
+        m_errors.emplace_back(type, message);
+        m_reporter->reportRenderErrorOnce(type, qMove(message));
+    }
+
+    std::vector<std::pair<RenderErrorType, QString>> takeErrors() { return qMove(m_errors); }
+
+private:
+    PDFRenderErrorReporter* m_reporter;
+    std::vector<std::pair<RenderErrorType, QString>> m_errors;
 };
 
 const PDFSystemFontInfoStorage* PDFSystemFontInfoStorage::getInstance()
@@ -178,6 +319,44 @@ QByteArray PDFSystemFontInfoStorage::loadFont(const CIDSystemInfo* cidSystemInfo
                                               const FontDescriptor* descriptor,
                                               StandardFontType standardFontType,
                                               PDFRenderErrorReporter* reporter) const
+{
+    // Font substitution depends only on these properties, so result can be
+    // shared between all documents requesting the same font.
+    QByteArray key;
+    {
+        QDataStream stream(&key, QIODevice::WriteOnly);
+        stream << cidSystemInfo->registry << cidSystemInfo->ordering;
+        stream << descriptor->fontName << descriptor->fontFamily;
+        stream << int(descriptor->fontStretch) << descriptor->fontWeight << descriptor->italicAngle << descriptor->isSerif();
+        stream << int(standardFontType);
+    }
+
+    {
+        QMutexLocker lock(&m_cacheMutex);
+        auto it = m_fontCache.find(key);
+        if (it != m_fontCache.cend())
+        {
+            for (const auto& error : it->second.errors)
+            {
+                reporter->reportRenderError(error.first, error.second);
+            }
+
+            return it->second.fontData;
+        }
+    }
+
+    PDFRecordingRenderErrorReporter recordingReporter(reporter);
+    QByteArray fontData = loadFontUncached(cidSystemInfo, descriptor, standardFontType, &recordingReporter);
+
+    QMutexLocker lock(&m_cacheMutex);
+    m_fontCache[key] = CachedFont{ fontData, recordingReporter.takeErrors() };
+    return fontData;
+}
+
+QByteArray PDFSystemFontInfoStorage::loadFontUncached(const CIDSystemInfo* cidSystemInfo,
+                                                      const FontDescriptor* descriptor,
+                                                      StandardFontType standardFontType,
+                                                      PDFRenderErrorReporter* reporter) const
 {
     QString fontName;
 
@@ -264,6 +443,36 @@ QByteArray PDFSystemFontInfoStorage::loadFont(const CIDSystemInfo* cidSystemInfo
                     }
                 }
             }
+
+#ifdef Q_OS_UNIX
+            // Default fonts are not present, try to find any font covering the script
+            char32_t character = U'\u4E00';
+            switch (cjkDefaultFontType)
+            {
+                case ECjkDefaultFontType::AdobeJapan:
+                    character = U'\u3042';
+                    break;
+
+                case ECjkDefaultFontType::AdobeKorea:
+                    character = U'\uAC00';
+                    break;
+
+                default:
+                    break;
+            }
+
+            QString fileName = findFontFileByCoverage(character, descriptor->isSerif());
+            if (!fileName.isEmpty())
+            {
+                fontData = loadFontFile(fileName);
+
+                if (!fontData.isEmpty())
+                {
+                    reporter->reportRenderError(RenderErrorType::Warning, PDFTranslationContext::tr("Inexact font substitution: font %1 replaced by font %2 covering the character set.").arg(fontName, fileName));
+                    return fontData;
+                }
+            }
+#endif
         }
     }
 
@@ -404,12 +613,6 @@ QByteArray PDFSystemFontInfoStorage::loadFontImpl(const FontDescriptor* descript
     ReleaseDC(NULL, hdc);
     return result;
 #elif defined(Q_OS_UNIX)
-    FcPattern* p = FcPatternBuild(nullptr, FC_FAMILY, FcTypeString, fontName.constData(), nullptr);
-    if (!p)
-    {
-        throw PDFException(PDFTranslationContext::tr("FontConfig error building pattern for font %1").arg(fontName));
-    }
-
     constexpr const std::array<std::pair<PDFReal, int>, 9> weights{
             std::pair<PDFReal, int>{100, FC_WEIGHT_EXTRALIGHT},
             std::pair<PDFReal, int>{200, FC_WEIGHT_LIGHT},
@@ -420,10 +623,11 @@ QByteArray PDFSystemFontInfoStorage::loadFontImpl(const FontDescriptor* descript
             std::pair<PDFReal, int>{700, FC_WEIGHT_BOLD},
             std::pair<PDFReal, int>{800, FC_WEIGHT_EXTRABOLD},
             std::pair<PDFReal, int>{900, FC_WEIGHT_EXTRABOLD}};
+    int weight = FC_WEIGHT_EXTRABOLD;
     auto wit = std::lower_bound(weights.cbegin(), weights.cend(), descriptor->fontWeight, [](const std::pair<PDFReal, int>& data, PDFReal key) { return data.first < key; });
     if (wit != weights.cend())
     {
-        checkFontConfigError(FcPatternAddInteger(p, FC_WEIGHT, wit->second));
+        weight = wit->second;
     }
 
     constexpr const std::array<std::pair<QFont::Stretch, int>, 9> stretches{
@@ -437,10 +641,386 @@ QByteArray PDFSystemFontInfoStorage::loadFontImpl(const FontDescriptor* descript
         std::pair<QFont::Stretch, int>{QFont::ExtraExpanded, FC_WIDTH_EXTRAEXPANDED},
         std::pair<QFont::Stretch, int>{QFont::UltraExpanded, FC_WIDTH_ULTRAEXPANDED}};
 
+    int width = -1;
     auto sit = std::find_if(stretches.cbegin(), stretches.cend(), [&](const std::pair<QFont::Stretch, int>& item) { return item.first == descriptor->fontStretch; });
     if (sit != stretches.cend())
     {
-        checkFontConfigError(FcPatternAddInteger(p, FC_WIDTH, sit->second));
+        width = sit->second;
+    }
+
+    const int slant = (descriptor->italicAngle != 0.0 || descriptor->isItalic()) ? FC_SLANT_ITALIC : FC_SLANT_ROMAN;
+
+    QString fileName = findFontFile(fontName, weight, width, slant);
+    if (!fileName.isEmpty())
+    {
+        result = loadFontFile(fileName);
+    }
+
+    if (result.isEmpty() && standardFontType == StandardFontType::Invalid)
+    {
+        reporter->reportRenderError(RenderErrorType::Warning, PDFTranslationContext::tr("Inexact font substitution: font %1 replaced by standard font Times New Roman.").arg(fontName));
+        result = loadFontImpl(descriptor, fontName, StandardFontType::TimesRoman, reporter);
+    }
+
+    return result;
+#endif
+}
+
+#ifdef Q_OS_UNIX
+QByteArray PDFSystemFontInfoStorage::loadFontFile(const QString& fileName) const
+{
+    {
+        QMutexLocker lock(&m_cacheMutex);
+        auto it = m_fontFileCache.find(fileName);
+        if (it != m_fontFileCache.cend())
+        {
+            return it->second;
+        }
+    }
+
+    QByteArray data;
+    QFile f(fileName);
+    if (f.open(QIODevice::ReadOnly))
+    {
+        data = f.readAll();
+        f.close();
+    }
+
+    QMutexLocker lock(&m_cacheMutex);
+    m_fontFileCache[fileName] = data;
+    return data;
+}
+
+bool PDFSystemFontInfoStorage::FontIndexEntry::isCovered(char32_t character) const
+{
+    const int page = character >> 8;
+    const int byteIndex = page >> 3;
+
+    if (byteIndex >= coverage.size())
+    {
+        return false;
+    }
+
+    return coverage[byteIndex] & (1 << (page & 7));
+}
+
+QString PDFSystemFontInfoStorage::getFontIndexFileName()
+{
+    return QDir(PDFDiskCache::getDefaultDirectory()).filePath("systemfontindex.bin");
+}
+
+PDFSystemFontInfoStorage::FontIndex* PDFSystemFontInfoStorage::getFontIndex() const
+{
+    if (!m_fontIndex)
+    {
+        FontIndex index;
+
+        const QString fileName = getFontIndexFileName();
+        if (!loadFontIndex(fileName, index))
+        {
+            index = buildFontIndex();
+            saveFontIndex(fileName, index);
+        }
+
+        m_fontIndex = qMove(index);
+    }
+
+    return &m_fontIndex.value();
+}
+
+PDFSystemFontInfoStorage::FontIndex PDFSystemFontInfoStorage::buildFontIndex()
+{
+    FontIndex index;
+
+    if (!FcInit())
+    {
+        return index;
+    }
+
+    if (FcStrList* directories = FcConfigGetFontDirs(nullptr))
+    {
+        while (FcChar8* directory = FcStrListNext(directories))
+        {
+            QString directoryName = QString::fromUtf8(reinterpret_cast<const char*>(directory));
+            QFileInfo fileInfo(directoryName);
+            index.directories.emplace_back(directoryName, fileInfo.exists() ? fileInfo.lastModified().toMSecsSinceEpoch() : -1);
+        }
+        FcStrListDone(directories);
+    }
+
+    FcPattern* pattern = FcPatternCreate();
+    FcObjectSet* objectSet = FcObjectSetBuild(FC_FAMILY, FC_STYLE, FC_FILE, FC_WEIGHT, FC_WIDTH, FC_SLANT, FC_CHARSET, nullptr);
+    FcFontSet* fontSet = (pattern && objectSet) ? FcFontList(nullptr, pattern, objectSet) : nullptr;
+
+    if (fontSet)
+    {
+        index.entries.reserve(fontSet->nfont);
+        for (int i = 0; i < fontSet->nfont; ++i)
+        {
+            FcPattern* font = fontSet->fonts[i];
+
+            FcChar8* family = nullptr;
+            FcChar8* file = nullptr;
+            if (FcPatternGetString(font, FC_FAMILY, 0, &family) != FcResultMatch ||
+                FcPatternGetString(font, FC_FILE, 0, &file) != FcResultMatch)
+            {
+                continue;
+            }
+
+            FontIndexEntry entry;
+            entry.family = QString::fromUtf8(reinterpret_cast<const char*>(family));
+            entry.familyAdjusted = getFontPostscriptName(entry.family);
+            entry.fileName = QString::fromUtf8(reinterpret_cast<const char*>(file));
+
+            FcChar8* style = nullptr;
+            if (FcPatternGetString(font, FC_STYLE, 0, &style) == FcResultMatch)
+            {
+                entry.style = QString::fromUtf8(reinterpret_cast<const char*>(style));
+            }
+
+            FcPatternGetInteger(font, FC_WEIGHT, 0, &entry.weight);
+            FcPatternGetInteger(font, FC_WIDTH, 0, &entry.width);
+            FcPatternGetInteger(font, FC_SLANT, 0, &entry.slant);
+
+            entry.coverage = QByteArray(32, 0);
+            FcCharSet* charset = nullptr;
+            if (FcPatternGetCharSet(font, FC_CHARSET, 0, &charset) == FcResultMatch)
+            {
+                FcChar32 map[FC_CHARSET_MAP_SIZE];
+                FcChar32 next = 0;
+                for (FcChar32 base = FcCharSetFirstPage(charset, map, &next); base != FC_CHARSET_DONE && base < 0x10000; base = FcCharSetNextPage(charset, map, &next))
+                {
+                    if (std::any_of(std::begin(map), std::end(map), [](FcChar32 value) { return value != 0; }))
+                    {
+                        const int page = base >> 8;
+                        entry.coverage[page >> 3] |= char(1 << (page & 7));
+                    }
+                }
+            }
+
+            index.entries.emplace_back(qMove(entry));
+        }
+
+        FcFontSetDestroy(fontSet);
+    }
+
+    if (objectSet)
+    {
+        FcObjectSetDestroy(objectSet);
+    }
+
+    if (pattern)
+    {
+        FcPatternDestroy(pattern);
+    }
+
+    return index;
+}
+
+bool PDFSystemFontInfoStorage::loadFontIndex(const QString& fileName, FontIndex& index)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic;
+    stream >> version;
+
+    if (magic != FONT_INDEX_MAGIC || version != FONT_INDEX_VERSION)
+    {
+        return false;
+    }
+
+    quint32 directoryCount = 0;
+    stream >> directoryCount;
+    for (quint32 i = 0; i < directoryCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString directoryName;
+        qint64 modified = 0;
+        stream >> directoryName >> modified;
+
+        // If some font directory was modified, then index is not valid anymore
+        QFileInfo fileInfo(directoryName);
+        if (modified != (fileInfo.exists() ? fileInfo.lastModified().toMSecsSinceEpoch() : -1))
+        {
+            return false;
+        }
+
+        index.directories.emplace_back(qMove(directoryName), modified);
+    }
+
+    quint32 entryCount = 0;
+    stream >> entryCount;
+    for (quint32 i = 0; i < entryCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        FontIndexEntry entry;
+        qint32 weight = 0;
+        qint32 width = 0;
+        qint32 slant = 0;
+        stream >> entry.family >> entry.style >> entry.fileName >> weight >> width >> slant >> entry.coverage;
+        entry.familyAdjusted = getFontPostscriptName(entry.family);
+        entry.weight = weight;
+        entry.width = width;
+        entry.slant = slant;
+        index.entries.emplace_back(qMove(entry));
+    }
+
+    quint32 matchCount = 0;
+    stream >> matchCount;
+    for (quint32 i = 0; i < matchCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        QByteArray key;
+        QString matchedFileName;
+        stream >> key >> matchedFileName;
+        index.matches[key] = qMove(matchedFileName);
+    }
+
+    return stream.status() == QDataStream::Ok && !index.directories.empty();
+}
+
+void PDFSystemFontInfoStorage::saveFontIndex(const QString& fileName, const FontIndex& index)
+{
+    QDir().mkpath(QFileInfo(fileName).path());
+
+    // Write to the temporary file first, so other processes
+    // never see partially written index.
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << FONT_INDEX_MAGIC;
+    stream << FONT_INDEX_VERSION;
+
+    stream << quint32(index.directories.size());
+    for (const auto& directory : index.directories)
+    {
+        stream << directory.first << directory.second;
+    }
+
+    stream << quint32(index.entries.size());
+    for (const FontIndexEntry& entry : index.entries)
+    {
+        stream << entry.family << entry.style << entry.fileName << qint32(entry.weight) << qint32(entry.width) << qint32(entry.slant) << entry.coverage;
+    }
+
+    stream << quint32(index.matches.size());
+    for (const auto& match : index.matches)
+    {
+        stream << match.first << match.second;
+    }
+
+    file.commit();
+}
+
+QString PDFSystemFontInfoStorage::findFontFile(const QString& fontName, int weight, int width, int slant) const
+{
+    QMutexLocker lock(&m_indexMutex);
+    FontIndex* index = getFontIndex();
+
+    // Exact family match using font index. Select font with best matching
+    // style in the family.
+    const FontIndexEntry* bestEntry = nullptr;
+    int bestScore = std::numeric_limits<int>::max();
+    for (const FontIndexEntry& entry : index->entries)
+    {
+        if (entry.familyAdjusted.compare(fontName, Qt::CaseInsensitive) != 0)
+        {
+            continue;
+        }
+
+        int score = qAbs(entry.weight - weight);
+        score += (width != -1) ? qAbs(entry.width - width) : qAbs(entry.width - FC_WIDTH_NORMAL);
+        score += (entry.slant != slant) ? 1000 : 0;
+
+        if (score < bestScore)
+        {
+            bestScore = score;
+            bestEntry = &entry;
+        }
+    }
+
+    if (bestEntry)
+    {
+        return bestEntry->fileName;
+    }
+
+    // Family is not present, we must use fontconfig substitution rules,
+    // results are stored in the index, so it is done only once.
+    QByteArray key;
+    {
+        QDataStream stream(&key, QIODevice::WriteOnly);
+        stream << fontName << qint32(weight) << qint32(width) << qint32(slant);
+    }
+
+    auto it = index->matches.find(key);
+    if (it != index->matches.cend())
+    {
+        return it->second;
+    }
+
+    QString fileName = matchFontFile(fontName, weight, width, slant);
+    index->matches[key] = fileName;
+    saveFontIndex(getFontIndexFileName(), *index);
+    return fileName;
+}
+
+QString PDFSystemFontInfoStorage::findFontFileByCoverage(char32_t character, bool isSerif) const
+{
+    QMutexLocker lock(&m_indexMutex);
+    FontIndex* index = getFontIndex();
+
+    QString fileName;
+    for (const FontIndexEntry& entry : index->entries)
+    {
+        if (!entry.isCovered(character))
+        {
+            continue;
+        }
+
+        const bool isEntrySerif = entry.family.contains(QLatin1String("Serif"), Qt::CaseInsensitive) &&
+                                  !entry.family.contains(QLatin1String("Sans"), Qt::CaseInsensitive);
+        if (entry.weight == FC_WEIGHT_NORMAL && entry.slant == FC_SLANT_ROMAN && isEntrySerif == isSerif)
+        {
+            return entry.fileName;
+        }
+
+        if (fileName.isEmpty())
+        {
+            fileName = entry.fileName;
+        }
+    }
+
+    return fileName;
+}
+
+QString PDFSystemFontInfoStorage::matchFontFile(const QString& fontName, int weight, int width, int slant)
+{
+    QString fileName;
+
+    QByteArray family = fontName.toUtf8();
+    FcPattern* p = FcPatternBuild(nullptr, FC_FAMILY, FcTypeString, family.constData(), nullptr);
+    if (!p)
+    {
+        throw PDFException(PDFTranslationContext::tr("FontConfig error building pattern for font %1").arg(fontName));
+    }
+
+    checkFontConfigError(FcPatternAddInteger(p, FC_WEIGHT, weight));
+    checkFontConfigError(FcPatternAddInteger(p, FC_SLANT, slant));
+
+    if (width != -1)
+    {
+        checkFontConfigError(FcPatternAddInteger(p, FC_WIDTH, width));
     }
 
     checkFontConfigError(FcConfigSubstitute(nullptr, p, FcMatchPattern));
@@ -452,22 +1032,15 @@ QByteArray PDFSystemFontInfoStorage::loadFontImpl(const FontDescriptor* descript
         FcChar8* s = nullptr;
         if (FcPatternGetString(match, FC_FILE, 0, &s) == FcResultMatch)
         {
-            QFile f(QString::fromUtf8(reinterpret_cast<char*>(s)));
-            f.open(QIODevice::ReadOnly);
-            result = f.readAll();
-            f.close();
+            fileName = QString::fromUtf8(reinterpret_cast<char*>(s));
         }
+        FcPatternDestroy(match);
     }
+    FcPatternDestroy(p);
 
-    if (result.isEmpty() && standardFontType == StandardFontType::Invalid)
-    {
-        reporter->reportRenderError(RenderErrorType::Warning, PDFTranslationContext::tr("Inexact font substitution: font %1 replaced by standard font Times New Roman.").arg(fontName));
-        result = loadFontImpl(descriptor, fontName, StandardFontType::TimesRoman, reporter);
-    }
-
-    return result;
-#endif
+    return fileName;
 }
+#endif
 
 PDFSystemFontInfoStorage::PDFSystemFontInfoStorage()
 {
@@ -613,66 +1186,125 @@ private:
     /// Pixel size of the font
     PDFReal m_pixelSize = 0.0;
 
-    /// Parent font
-    PDFFontPointer m_parentFont;
-};
+    /// Parent font
+    PDFFontPointer m_parentFont;
+};
+
+/// FreeType face of the font program. Faces are shared process-wide between
+/// all realized fonts using the same font program data (even from different
+/// documents), so font program is parsed only once and glyph outlines are
+/// loaded only once. Face is thread safe.
+class PDFFontFace
+{
+public:
+    explicit PDFFontFace(QByteArray fontData, PDFReal pixelSize);
+    ~PDFFontFace();
+
+    PDFFontFace(const PDFFontFace&) = delete;
+    PDFFontFace& operator=(const PDFFontFace&) = delete;
+
+    struct Glyph
+    {
+        QPainterPath glyph;
+        PDFReal advance = 0.0;
+    };
+
+    /// Returns face for given font program data and pixel size. Faces are
+    /// cached, so when face for the same font program data already exists,
+    /// it is reused. If face can't be created, then exception is thrown.
+    /// \param fontData Font program data
+    /// \param pixelSize Pixel size
+    static QSharedPointer<PDFFontFace> getCachedFace(const QByteArray& fontData, PDFReal pixelSize);
+
+    /// Get glyph for glyph index
+    /// \param glyphIndex Glyph index
+    /// \param isVertical Use vertical advance instead of horizontal advance
+    const Glyph& getGlyph(unsigned int glyphIndex, bool isVertical);
+
+    /// Returns glyph index for unicode character, if face has unicode
+    /// character map, otherwise zero is returned.
+    /// \param character Unicode character
+    GID getUnicodeGlyphIndex(char32_t character);
+
+    /// Returns FreeType face. Face must be accessed only under the lock.
+    FT_Face getFace() const { return m_face; }
+
+    /// Returns lock, which must be locked for writing, when face is accessed
+    QReadWriteLock* getLock() { return &m_readWriteLock; }
+
+    /// Returns font program data
+    const QByteArray& getFontData() const { return m_fontData; }
 
-/// Implementation of the PDFRealizedFont class using PIMPL pattern
-class PDFRealizedFontImpl : public IRealizedFontImpl
-{
-public:
-    explicit PDFRealizedFontImpl();
-    virtual ~PDFRealizedFontImpl();
+    /// Returns pixel size
+    PDFReal getPixelSize() const { return m_pixelSize; }
 
-    virtual void fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter) override;
-    virtual bool isHorizontalWritingSystem() const override { return !m_isVertical; }
-    virtual void dumpFontToTreeItem(ITreeFactory* treeFactory) const override;
-    virtual QString getPostScriptName() const override { return m_postScriptName; }
-    virtual CharacterInfos getCharacterInfos() const override;
+    /// Function checks, if error occured, and if yes, then exception is thrown
+    static void checkFreeTypeError(FT_Error error);
 
-    static constexpr const PDFReal PIXEL_SIZE_MULTIPLIER = 100.0;
+    /// Pixel size multiplier used, when setting face size. Fonts are realized
+    /// at canonical size (see PDFRealizedFont::CANONICAL_FONT_SIZE), so this
+    /// multiplier determines precision of the glyph outlines.
+    static constexpr const PDFReal PIXEL_SIZE_MULTIPLIER = 1000.0;
 
 private:
-    friend class PDFRealizedFont;
-
-    static constexpr const PDFReal FONT_WIDTH_MULTIPLIER = 1.0 / 1000.0;
     static constexpr const PDFReal FORMAT_26_6_MULTIPLIER = 1 / 64.0;
     static constexpr const PDFReal FONT_MULTIPLIER = FORMAT_26_6_MULTIPLIER / PIXEL_SIZE_MULTIPLIER;
 
-    struct Glyph
-    {
-        QPainterPath glyph;
-        PDFReal advance = 0.0;
-    };
+    /// Maximal count of cached faces, which are not used by any realized font
+    static constexpr const size_t FACE_CACHE_LIMIT = 64;
 
     static int outlineMoveTo(const FT_Vector* to, void* user);
     static int outlineLineTo(const FT_Vector* to, void* user);
     static int outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user);
     static int outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user);
 
-    /// Get glyph for glyph index
-    const Glyph& getGlyph(unsigned int glyphIndex);
-
-    /// Function checks, if error occured, and if yes, then exception is thrown
-    static void checkFreeTypeError(FT_Error error);
+    /// Releases FreeType face and library
+    void release();
 
-    /// Read/write lock for accessing the glyph data
+    /// Read/write lock for accessing the face and glyph data
     QReadWriteLock m_readWriteLock;
 
-    /// Glyph cache, must be protected by the mutex above
-    std::unordered_map<unsigned int, Glyph> m_glyphCache;
+    /// Glyph cache for horizontal and vertical advances, must be protected by the lock above
+    std::array<std::unordered_map<unsigned int, Glyph>, 2> m_glyphCache;
 
-    /// For embedded fonts, this byte array contains embedded font data
-    QByteArray m_embeddedFontData;
+    /// Font program data, must be valid during the lifetime of the face
+    QByteArray m_fontData;
 
-    /// For system fonts, this byte array contains system font data
-    QByteArray m_systemFontData;
+    /// Pixel size of the face
+    PDFReal m_pixelSize;
 
-    /// Instance of FreeType library assigned to this font
+    /// Instance of FreeType library assigned to this face
     FT_Library m_library;
 
     /// Face of the font
     FT_Face m_face;
+};
+
+using PDFFontFacePointer = QSharedPointer<PDFFontFace>;
+
+/// Implementation of the PDFRealizedFont class using PIMPL pattern
+class PDFRealizedFontImpl : public IRealizedFontImpl
+{
+public:
+    explicit PDFRealizedFontImpl();
+    virtual ~PDFRealizedFontImpl() = default;
+
+    virtual void fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter) override;
+    virtual bool isHorizontalWritingSystem() const override { return !m_isVertical; }
+    virtual void dumpFontToTreeItem(ITreeFactory* treeFactory) const override;
+    virtual QString getPostScriptName() const override { return m_postScriptName; }
+    virtual CharacterInfos getCharacterInfos() const override;
+
+private:
+    friend class PDFRealizedFont;
+
+    using Glyph = PDFFontFace::Glyph;
+
+    /// Get glyph for glyph index
+    const Glyph& getGlyph(unsigned int glyphIndex) { return m_face->getGlyph(glyphIndex, m_isVertical); }
+
+    /// Face of the font, shared between realized fonts with same font program
+    PDFFontFacePointer m_face;
 
     /// Pixel size of the font
     PDFReal m_pixelSize;
@@ -690,18 +1322,33 @@ private:
     QString m_postScriptName;
 };
 
-PDFRealizedFontImpl::PDFRealizedFontImpl() :
+PDFFontFace::PDFFontFace(QByteArray fontData, PDFReal pixelSize) :
+    m_fontData(qMove(fontData)),
+    m_pixelSize(pixelSize),
     m_library(nullptr),
-    m_face(nullptr),
-    m_pixelSize(0.0),
-    m_parentFont(nullptr),
-    m_isEmbedded(false),
-    m_isVertical(false)
+    m_face(nullptr)
 {
+    try
+    {
+        checkFreeTypeError(FT_Init_FreeType(&m_library));
+        checkFreeTypeError(FT_New_Memory_Face(m_library, reinterpret_cast<const FT_Byte*>(m_fontData.constData()), m_fontData.size(), 0, &m_face));
+        FT_Select_Charmap(m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
+        checkFreeTypeError(FT_Set_Pixel_Sizes(m_face, 0, qRound(pixelSize * PIXEL_SIZE_MULTIPLIER)));
+    }
+    catch (const PDFException&)
+    {
+        // Destructor is not called, when constructor throws
+        release();
+        throw;
+    }
+}
 
+PDFFontFace::~PDFFontFace()
+{
+    release();
 }
 
-PDFRealizedFontImpl::~PDFRealizedFontImpl()
+void PDFFontFace::release()
 {
     if (m_face)
     {
@@ -716,6 +1363,86 @@ PDFRealizedFontImpl::~PDFRealizedFontImpl()
     }
 }
 
+PDFFontFacePointer PDFFontFace::getCachedFace(const QByteArray& fontData, PDFReal pixelSize)
+{
+    struct CacheItem
+    {
+        size_t hash = 0;
+        PDFFontFacePointer face;
+    };
+
+    static QMutex mutex;
+    static std::vector<CacheItem> cache;
+
+    auto isSameFace = [&fontData, pixelSize](const PDFFontFacePointer& face)
+    {
+        return face->getPixelSize() == pixelSize && face->getFontData() == fontData;
+    };
+
+    const size_t hash = qHash(fontData);
+
+    {
+        QMutexLocker lock(&mutex);
+
+        // Cache is sorted in most recently used order
+        for (auto it = cache.begin(); it != cache.end(); ++it)
+        {
+            if (it->hash == hash && isSameFace(it->face))
+            {
+                std::rotate(cache.begin(), it, std::next(it));
+                return cache.front().face;
+            }
+        }
+    }
+
+    // Face is created outside the lock, because parsing of the font
+    // program can take a long time.
+    PDFFontFacePointer face(new PDFFontFace(fontData, pixelSize));
+
+    QMutexLocker lock(&mutex);
+
+    // Other thread may have created the same face meanwhile
+    for (auto it = cache.begin(); it != cache.end(); ++it)
+    {
+        if (it->hash == hash && isSameFace(it->face))
+        {
+            std::rotate(cache.begin(), it, std::next(it));
+            return cache.front().face;
+        }
+    }
+
+    if (cache.size() >= FACE_CACHE_LIMIT)
+    {
+        // Drop least recently used faces. Faces still used by some
+        // realized font are kept alive by the realized font.
+        cache.pop_back();
+    }
+
+    cache.insert(cache.begin(), CacheItem{ hash, face });
+    return face;
+}
+
+GID PDFFontFace::getUnicodeGlyphIndex(char32_t character)
+{
+    QWriteLocker writeLock(&m_readWriteLock);
+
+    if (m_face->charmap && m_face->charmap->encoding == FT_ENCODING_UNICODE)
+    {
+        return FT_Get_Char_Index(m_face, character);
+    }
+
+    return 0;
+}
+
+PDFRealizedFontImpl::PDFRealizedFontImpl() :
+    m_pixelSize(0.0),
+    m_parentFont(nullptr),
+    m_isEmbedded(false),
+    m_isVertical(false)
+{
+
+}
+
 void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequence& textSequence, PDFRenderErrorReporter* reporter)
 {
     switch (m_parentFont->getFontType())
@@ -738,10 +1465,7 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
                 if (!glyphIndex)
                 {
                     // Try to obtain glyph index from unicode
-                    if (m_face->charmap && m_face->charmap->encoding == FT_ENCODING_UNICODE)
-                    {
-                        glyphIndex = FT_Get_Char_Index(m_face, (*encoding)[static_cast<uint8_t>(byteArray[i])].unicode());
-                    }
+                    glyphIndex = m_face->getUnicodeGlyphIndex((*encoding)[static_cast<uint8_t>(byteArray[i])].unicode());
                 }
 
                 const PDFReal glyphWidth = font->getGlyphAdvance(static_cast<uint8_t>(byteArray[i]));
@@ -756,8 +1480,10 @@ void PDFRealizedFontImpl::fillTextSequence(const QByteArray& byteArray, TextSequ
                     reporter->reportRenderError(RenderErrorType::Warning, PDFTranslationContext::tr("Glyph for simple font character code '%1' not found.").arg(static_cast<uint8_t>(byteArray[i])));
                     if (glyphWidth > 0)
                     {
+                        // Advance item is treated as in font space (in thousandths of the
+                        // text space unit), so it doesn't depend on the font size.
                         const QPainterPath* nullpath = nullptr;
-                        textSequence.items.emplace_back(nullpath, QChar(), glyphWidth * m_pixelSize * FONT_WIDTH_MULTIPLIER);
+                        textSequence.items.emplace_back(nullpath, QChar(), -glyphWidth);
                     }
                 }
             }
@@ -840,10 +1566,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                 if (!glyphIndex)
                 {
                     // Try to obtain glyph index from unicode
-                    if (m_face->charmap && m_face->charmap->encoding == FT_ENCODING_UNICODE)
-                    {
-                        glyphIndex = FT_Get_Char_Index(m_face, character.unicode());
-                    }
+                    glyphIndex = m_face->getUnicodeGlyphIndex(character.unicode());
                 }
 
                 if (glyphIndex)
@@ -866,8 +1589,11 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
             const PDFFontCMap* toUnicode = font->getToUnicode();
             const PDFCIDtoGIDMapper* CIDtoGIDmapper = font->getCIDtoGIDMapper();
 
+            QWriteLocker writeLock(m_face->getLock());
+            FT_Face face = m_face->getFace();
+
             FT_UInt index = 0;
-            FT_ULong character = FT_Get_First_Char(m_face, &index);
+            FT_ULong character = FT_Get_First_Char(face, &index);
             while (index != 0)
             {
                 const GID gid = index;
@@ -878,7 +1604,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                 info.character = toUnicode->getToUnicode(cid);
                 result.emplace_back(qMove(info));
 
-                character = FT_Get_Next_Char(m_face, character, &index);
+                character = FT_Get_Next_Char(face, character, &index);
             }
 
             if (result.empty())
@@ -893,7 +1619,7 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
                         continue;
                     }
 
-                    if (!FT_Load_Glyph(m_face, gid, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING))
+                    if (!FT_Load_Glyph(face, gid, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING))
                     {
                         CharacterInfo info;
                         info.gid = gid;
@@ -919,34 +1645,37 @@ CharacterInfos PDFRealizedFontImpl::getCharacterInfos() const
 
 void PDFRealizedFontImpl::dumpFontToTreeItem(ITreeFactory* treeFactory) const
 {
+    QWriteLocker writeLock(face->getLock());
+    FT_Face face = face->getFace();
+
     treeFactory->pushItem({ PDFTranslationContext::tr("Details") });
 
-    if (m_face->family_name)
+    if (face->family_name)
     {
-        treeFactory->addItem({ PDFTranslationContext::tr("Font"), QString::fromLatin1(m_face->family_name) });
+        treeFactory->addItem({ PDFTranslationContext::tr("Font"), QString::fromLatin1(face->family_name) });
     }
-    if (m_face->style_name)
+    if (face->style_name)
     {
-        treeFactory->addItem({ PDFTranslationContext::tr("Style"), QString::fromLatin1(m_face->style_name) });
+        treeFactory->addItem({ PDFTranslationContext::tr("Style"), QString::fromLatin1(face->style_name) });
     }
 
     QString yesString = PDFTranslationContext::tr("Yes");
     QString noString = PDFTranslationContext::tr("No");
 
-    treeFactory->addItem( { PDFTranslationContext::tr("Glyph count"), QString::number(m_face->num_glyphs) });
-    treeFactory->addItem( { PDFTranslationContext::tr("Is CID keyed"), (m_face->face_flags & FT_FACE_FLAG_CID_KEYED) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Is bold"), (m_face->style_flags & FT_STYLE_FLAG_BOLD) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Is italics"), (m_face->style_flags & FT_STYLE_FLAG_ITALIC) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Has vertical writing system"), (m_face->face_flags & FT_FACE_FLAG_VERTICAL) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Has SFNT storage scheme"), (m_face->face_flags & FT_FACE_FLAG_SFNT) ? yesString : noString });
-    treeFactory->addItem( { PDFTranslationContext::tr("Has glyph names"), (m_face->face_flags & FT_FACE_FLAG_GLYPH_NAMES) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Glyph count"), QString::number(face->num_glyphs) });
+    treeFactory->addItem( { PDFTranslationContext::tr("Is CID keyed"), (face->face_flags & FT_FACE_FLAG_CID_KEYED) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Is bold"), (face->style_flags & FT_STYLE_FLAG_BOLD) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Is italics"), (face->style_flags & FT_STYLE_FLAG_ITALIC) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Has vertical writing system"), (face->face_flags & FT_FACE_FLAG_VERTICAL) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Has SFNT storage scheme"), (face->face_flags & FT_FACE_FLAG_SFNT) ? yesString : noString });
+    treeFactory->addItem( { PDFTranslationContext::tr("Has glyph names"), (face->face_flags & FT_FACE_FLAG_GLYPH_NAMES) ? yesString : noString });
 
-    if (m_face->num_charmaps > 0)
+    if (face->num_charmaps > 0)
     {
         treeFactory->pushItem({ PDFTranslationContext::tr("Encoding") });
-        for (FT_Int i = 0; i < m_face->num_charmaps; ++i)
+        for (FT_Int i = 0; i < face->num_charmaps; ++i)
         {
-            FT_CharMap charMap = m_face->charmaps[i];
+            FT_CharMap charMap = face->charmaps[i];
 
             const FT_Encoding encoding = charMap->encoding;
             QString encodingName;
@@ -1021,44 +1750,46 @@ void PDFRealizedFontImpl::dumpFontToTreeItem(ITreeFactory* treeFactory) const
     treeFactory->popItem();
 }
 
-int PDFRealizedFontImpl::outlineMoveTo(const FT_Vector* to, void* user)
+int PDFFontFace::outlineMoveTo(const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.moveTo(to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineLineTo(const FT_Vector* to, void* user)
+int PDFFontFace::outlineLineTo(const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.lineTo(to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
+int PDFFontFace::outlineConicTo(const FT_Vector* control, const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.quadTo(control->x * FONT_MULTIPLIER, control->y * FONT_MULTIPLIER, to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
-int PDFRealizedFontImpl::outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+int PDFFontFace::outlineCubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
 {
     Glyph* glyph = reinterpret_cast<Glyph*>(user);
     glyph->glyph.cubicTo(control1->x * FONT_MULTIPLIER, control1->y * FONT_MULTIPLIER, control2->x * FONT_MULTIPLIER, control2->y * FONT_MULTIPLIER, to->x * FONT_MULTIPLIER, to->y * FONT_MULTIPLIER);
     return 0;
 }
 
-const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int glyphIndex)
+const PDFFontFace::Glyph& PDFFontFace::getGlyph(unsigned int glyphIndex, bool isVertical)
 {
     if (glyphIndex)
     {
+        std::unordered_map<unsigned int, Glyph>& glyphCache = m_glyphCache[isVertical ? 1 : 0];
+
         {
             QReadLocker readLock(&m_readWriteLock);
 
             // First look into cache
-            auto it = m_glyphCache.find(glyphIndex);
-            if (it != m_glyphCache.cend())
+            auto it = glyphCache.find(glyphIndex);
+            if (it != glyphCache.cend())
             {
                 return it->second;
             }
@@ -1070,21 +1801,21 @@ const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int gly
         FT_Outline_Funcs glyphOutlineInterface;
         glyphOutlineInterface.delta = 0;
         glyphOutlineInterface.shift = 0;
-        glyphOutlineInterface.move_to = PDFRealizedFontImpl::outlineMoveTo;
-        glyphOutlineInterface.line_to = PDFRealizedFontImpl::outlineLineTo;
-        glyphOutlineInterface.conic_to = PDFRealizedFontImpl::outlineConicTo;
-        glyphOutlineInterface.cubic_to = PDFRealizedFontImpl::outlineCubicTo;
+        glyphOutlineInterface.move_to = PDFFontFace::outlineMoveTo;
+        glyphOutlineInterface.line_to = PDFFontFace::outlineLineTo;
+        glyphOutlineInterface.conic_to = PDFFontFace::outlineConicTo;
+        glyphOutlineInterface.cubic_to = PDFFontFace::outlineCubicTo;
 
         checkFreeTypeError(FT_Load_Glyph(m_face, glyphIndex, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING));
         checkFreeTypeError(FT_Outline_Decompose(&m_face->glyph->outline, &glyphOutlineInterface, &glyph));
         glyph.glyph.closeSubpath();
-        glyph.advance = !m_isVertical ? m_face->glyph->advance.x : m_face->glyph->advance.y;
+        glyph.advance = !isVertical ? m_face->glyph->advance.x : m_face->glyph->advance.y;
         glyph.advance *= FONT_MULTIPLIER;
 
-        auto it = m_glyphCache.find(glyphIndex);
-        if (it == m_glyphCache.cend())
+        auto it = glyphCache.find(glyphIndex);
+        if (it == glyphCache.cend())
         {
-            it = m_glyphCache.insert(std::make_pair(glyphIndex, qMove(glyph))).first;
+            it = glyphCache.insert(std::make_pair(glyphIndex, qMove(glyph))).first;
         }
         return it->second;
     }
@@ -1093,7 +1824,7 @@ const PDFRealizedFontImpl::Glyph& PDFRealizedFontImpl::getGlyph(unsigned int gly
     return dummy;
 }
 
-void PDFRealizedFontImpl::checkFreeTypeError(FT_Error error)
+void PDFFontFace::checkFreeTypeError(FT_Error error)
 {
     if (error)
     {
@@ -1162,17 +1893,13 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
         const FontDescriptor* descriptor = font->getFontDescriptor();
         if (descriptor->isEmbedded())
         {
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
             const QByteArray* embeddedFontData = descriptor->getEmbeddedFontData();
             Q_ASSERT(embeddedFontData);
-            impl->m_embeddedFontData = *embeddedFontData;
 
             // At this time, embedded font data should not be empty!
-            Q_ASSERT(!impl->m_embeddedFontData.isEmpty());
+            Q_ASSERT(!embeddedFontData->isEmpty());
 
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_embeddedFontData.constData()), impl->m_embeddedFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
+            impl->m_face = PDFFontFace::getCachedFace(*embeddedFontData, pixelSize);
             impl->m_isVertical = cmap ? cmap->isVertical() : false;
             impl->m_isEmbedded = true;
             result.reset(new PDFRealizedFont(implPtr.release()));
@@ -1188,20 +1915,18 @@ PDFRealizedFontPointer PDFRealizedFont::createRealizedFont(PDFFontPointer font,
             }
 
             const PDFSystemFontInfoStorage* fontStorage = PDFSystemFontInfoStorage::getInstance();
-            impl->m_systemFontData = fontStorage->loadFont(font->getCIDSystemInfo(), descriptor, standardFontType, reporter);
+            QByteArray systemFontData = fontStorage->loadFont(font->getCIDSystemInfo(), descriptor, standardFontType, reporter);
 
-            if (impl->m_systemFontData.isEmpty())
+            if (systemFontData.isEmpty())
             {
                 throw PDFException(PDFTranslationContext::tr("Can't load system font '%1'.").arg(QString::fromLatin1(descriptor->fontName)));
             }
 
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Init_FreeType(&impl->m_library));
-            PDFRealizedFontImpl::checkFreeTypeError(FT_New_Memory_Face(impl->m_library, reinterpret_cast<const FT_Byte*>(impl->m_systemFontData.constData()), impl->m_systemFontData.size(), 0, &impl->m_face));
-            FT_Select_Charmap(impl->m_face, FT_ENCODING_UNICODE); // We try to select unicode encoding, but if it fails, we don't do anything (use glyph indices instead)
-            PDFRealizedFontImpl::checkFreeTypeError(FT_Set_Pixel_Sizes(impl->m_face, 0, qRound(pixelSize * PDFRealizedFontImpl::PIXEL_SIZE_MULTIPLIER)));
+            impl->m_face = PDFFontFace::getCachedFace(systemFontData, pixelSize);
             impl->m_isVertical = cmap ? cmap->isVertical() : false;
             impl->m_isEmbedded = false;
-            if (const char* postScriptName = FT_Get_Postscript_Name(impl->m_face))
+            QWriteLocker writeLock(impl->m_face->getLock());
+            if (const char* postScriptName = FT_Get_Postscript_Name(impl->m_face->getFace()))
             {
                 impl->m_postScriptName = QString::fromLatin1(postScriptName);
             }
@@ -2053,70 +2778,111 @@ FontType PDFTrueTypeFont::getFontType() const
 
 void PDFFontCache::setDocument(const PDFModifiedDocument& document)
 {
-    QMutexLocker lock(&m_mutex);
-    if (m_document != document)
+    const PDFDocument* newDocument = document.getDocument();
+    if (m_document.load() != newDocument)
     {
-        m_document = document;
+        m_document = newDocument;
 
         // Jakub Melka: If document has not reset flag, then fonts of the
         // document remains the same. So it is not needed to clear font cache.
         if (document.hasReset() || document.hasPageContentsChanged())
         {
-            m_fontCache.clear();
-            m_realizedFontCache.clear();
+            for (FontCacheShard& shard : m_fontCacheShards)
+            {
+                QWriteLocker lock(&shard.lock);
+                shard.fonts.clear();
+            }
+
+            for (RealizedFontCacheShard& shard : m_realizedFontCacheShards)
+            {
+                QWriteLocker lock(&shard.lock);
+                shard.realizedFonts.clear();
+            }
         }
     }
 }
 
 PDFFontPointer PDFFontCache::getFont(const PDFObject& fontObject) const
 {
+    PDF_TRACE_SPAN("cache", "Font cache lookup");
     if (fontObject.isReference())
     {
         // Font is object reference. Look in the cache, if we have it, then return it.
-
-        QMutexLocker lock(&m_mutex);
         PDFObjectReference reference = fontObject.getReference();
+        FontCacheShard& shard = m_fontCacheShards[FontKeyHash()(reference) % SHARD_COUNT];
 
-        auto it = m_fontCache.find(reference);
-        if (it == m_fontCache.cend())
         {
-            // We must create the font
-            PDFFontPointer font = PDFFont::createFont(fontObject, m_document);
+            QReadLocker readLock(&shard.lock);
+            auto it = shard.fonts.find(reference);
+            if (it != shard.fonts.cend())
+            {
+                m_fontHits.fetch_add(1, std::memory_order_relaxed);
+                return it->second;
+            }
+        }
 
-            if (m_fontCacheShrinkDisabledObjects.empty() && m_fontCache.size() >= m_fontCacheLimit)
+        m_fontMisses.fetch_add(1, std::memory_order_relaxed);
+
+        // We must create the font. Font is created without the lock, so another
+        // thread may create the same font concurrently, in that case, the font
+        // inserted first is used.
+        PDFFontPointer font = PDFFont::createFont(fontObject, m_document.load());
+
+        QWriteLocker writeLock(&shard.lock);
+        auto it = shard.fonts.find(reference);
+        if (it == shard.fonts.cend())
+        {
+            if (shard.fonts.size() >= getShardLimit(m_fontCacheLimit))
             {
-                // We have exceeded the cache limit. Clear the cache.
-                m_fontCache.clear();
+                // We have exceeded the cache limit. Clear the shard.
+                shard.fonts.clear();
             }
 
-            it = m_fontCache.insert(std::make_pair(reference, qMove(font))).first;
+            it = shard.fonts.insert(std::make_pair(reference, qMove(font))).first;
         }
         return it->second;
     }
     else
     {
         // Object is not a reference. Create font directly and return it.
-        return PDFFont::createFont(fontObject, m_document);
+        m_fontMisses.fetch_add(1, std::memory_order_relaxed);
+        return PDFFont::createFont(fontObject, m_document.load());
     }
 }
 
 PDFRealizedFontPointer PDFFontCache::getRealizedFont(const PDFFontPointer& font, PDFReal size, PDFRenderErrorReporter* reporter) const
 {
+    PDF_TRACE_SPAN("cache", "Realized font cache lookup");
     Q_ASSERT(font);
 
-    QMutexLocker lock(&m_mutex);
-    auto it = m_realizedFontCache.find(std::make_pair(font, size));
-    if (it == m_realizedFontCache.cend())
+    RealizedFontKey key(font, size);
+    RealizedFontCacheShard& shard = m_realizedFontCacheShards[RealizedFontKeyHash()(key) % SHARD_COUNT];
+
     {
-        // We must create the realized font
-        PDFRealizedFontPointer realizedFont = PDFRealizedFont::createRealizedFont(font, size, reporter);
+        QReadLocker readLock(&shard.lock);
+        auto it = shard.realizedFonts.find(key);
+        if (it != shard.realizedFonts.cend())
+        {
+            m_realizedFontHits.fetch_add(1, std::memory_order_relaxed);
+            return it->second;
+        }
+    }
+
+    m_realizedFontMisses.fetch_add(1, std::memory_order_relaxed);
 
-        if (m_fontCacheShrinkDisabledObjects.empty() && m_realizedFontCache.size() >= m_realizedFontCacheLimit)
+    // We must create the realized font
+    PDFRealizedFontPointer realizedFont = PDFRealizedFont::createRealizedFont(font, size, reporter);
+
+    QWriteLocker writeLock(&shard.lock);
+    auto it = shard.realizedFonts.find(key);
+    if (it == shard.realizedFonts.cend())
+    {
+        if (shard.realizedFonts.size() >= getShardLimit(m_realizedFontCacheLimit))
         {
-            m_realizedFontCache.clear();
+            shard.realizedFonts.clear();
         }
 
-        it = m_realizedFontCache.insert(std::make_pair(std::make_pair(font, size), qMove(realizedFont))).first;
+        it = shard.realizedFonts.insert(std::make_pair(qMove(key), qMove(realizedFont))).first;
     }
 
     return it->second;
@@ -2124,17 +2890,12 @@ PDFRealizedFontPointer PDFFontCache::getRealizedFont(const PDFFontPointer& font,
 
 void PDFFontCache::setCacheShrinkEnabled(const void* source, bool enabled)
 {
-    QMutexLocker lock(&m_mutex);
+    Q_UNUSED(source);
+
     if (enabled)
     {
-        m_fontCacheShrinkDisabledObjects.erase(source);
-        lock.unlock();
         shrink();
     }
-    else
-    {
-        m_fontCacheShrinkDisabledObjects.insert(source);
-    }
 }
 
 void PDFFontCache::setCacheLimits(std::size_t fontCacheLimit, std::size_t instancedFontCacheLimit)
@@ -2149,20 +2910,59 @@ void PDFFontCache::setCacheLimits(std::size_t fontCacheLimit, std::size_t instan
 
 void PDFFontCache::shrink()
 {
-    QMutexLocker lock(&m_mutex);
-    if (m_fontCacheShrinkDisabledObjects.empty())
+    const size_t fontShardLimit = getShardLimit(m_fontCacheLimit);
+    for (FontCacheShard& shard : m_fontCacheShards)
     {
-        if (m_fontCache.size() >= m_fontCacheLimit)
+        QWriteLocker lock(&shard.lock);
+        if (shard.fonts.size() >= fontShardLimit)
         {
-            m_fontCache.clear();
+            shard.fonts.clear();
         }
-        if (m_realizedFontCache.size() >= m_realizedFontCacheLimit)
+    }
+
+    const size_t realizedFontShardLimit = getShardLimit(m_realizedFontCacheLimit);
+    for (RealizedFontCacheShard& shard : m_realizedFontCacheShards)
+    {
+        QWriteLocker lock(&shard.lock);
+        if (shard.realizedFonts.size() >= realizedFontShardLimit)
         {
-            m_realizedFontCache.clear();
+            shard.realizedFonts.clear();
         }
     }
 }
 
+size_t PDFFontCache::getFontCount() const
+{
+    size_t count = 0;
+    for (FontCacheShard& shard : m_fontCacheShards)
+    {
+        QReadLocker lock(&shard.lock);
+        count += shard.fonts.size();
+    }
+    return count;
+}
+
+size_t PDFFontCache::getRealizedFontCount() const
+{
+    size_t count = 0;
+    for (RealizedFontCacheShard& shard : m_realizedFontCacheShards)
+    {
+        QReadLocker lock(&shard.lock);
+        count += shard.realizedFonts.size();
+    }
+    return count;
+}
+
+void PDFFontCache::collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const
+{
+    collector->addGauge(PDFTranslationContext::tr("Fonts"), getFontCount());
+    collector->addGauge(PDFTranslationContext::tr("Font limit"), m_fontCacheLimit.load());
+    collector->addHitRate(PDFTranslationContext::tr("Font"), m_fontHits.load(std::memory_order_relaxed), m_fontMisses.load(std::memory_order_relaxed));
+    collector->addGauge(PDFTranslationContext::tr("Realized fonts"), getRealizedFontCount());
+    collector->addGauge(PDFTranslationContext::tr("Realized font limit"), m_realizedFontCacheLimit.load());
+    collector->addHitRate(PDFTranslationContext::tr("Realized font"), m_realizedFontHits.load(std::memory_order_relaxed), m_realizedFontMisses.load(std::memory_order_relaxed));
+}
+
 const QByteArray* FontDescriptor::getEmbeddedFontData() const
 {
     if (!fontFile.isEmpty())
@@ -2183,6 +2983,19 @@ const QByteArray* FontDescriptor::getEmbeddedFontData() const
 
 PDFFontCMap PDFFontCMap::createFromName(const QByteArray& name)
 {
+    // Predefined mappings never change, so they are cached forever
+    static QMutex mutex;
+    static std::map<QByteArray, PDFFontCMap> cache;
+
+    {
+        QMutexLocker lock(&mutex);
+        auto it = cache.find(name);
+        if (it != cache.cend())
+        {
+            return it->second;
+        }
+    }
+
     QFile file(QString(":/cmaps/%1").arg(QString::fromLatin1(name)));
     if (file.exists())
     {
@@ -2193,13 +3006,60 @@ PDFFontCMap PDFFontCMap::createFromName(const QByteArray& name)
             file.close();
         }
 
-        return createFromData(data);
+        // Mutex is not locked during parsing, because mapping
+        // can use other predefined mapping (usecmap operator).
+        PDFFontCMap cmap = parse(data);
+
+        QMutexLocker lock(&mutex);
+        cache[name] = cmap;
+        return cmap;
     }
 
     throw PDFException(PDFTranslationContext::tr("Can't load CID font mapping named '%1'.").arg(QString::fromLatin1(name)));
 }
 
 PDFFontCMap PDFFontCMap::createFromData(const QByteArray& data)
+{
+    struct CacheItem
+    {
+        size_t hash = 0;
+        QByteArray data;
+        PDFFontCMap cmap;
+    };
+
+    static QMutex mutex;
+    static std::vector<CacheItem> cache;
+
+    const size_t hash = qHash(data);
+
+    {
+        QMutexLocker lock(&mutex);
+
+        // Cache is sorted in most recently used order
+        for (auto it = cache.begin(); it != cache.end(); ++it)
+        {
+            if (it->hash == hash && it->data == data)
+            {
+                std::rotate(cache.begin(), it, std::next(it));
+                return cache.front().cmap;
+            }
+        }
+    }
+
+    PDFFontCMap cmap = parse(data);
+
+    QMutexLocker lock(&mutex);
+    cache.insert(cache.begin(), CacheItem{ hash, data, cmap });
+
+    if (cache.size() > CMAP_CACHE_LIMIT)
+    {
+        cache.resize(CMAP_CACHE_LIMIT);
+    }
+
+    return cmap;
+}
+
+PDFFontCMap PDFFontCMap::parse(const QByteArray& data)
 {
     Entries entries;
     entries.reserve(1024); // Arbitrary number, we have enough memory, better than perform reallocation each time
@@ -2449,6 +3309,7 @@ PDFFontCMap PDFFontCMap::deserialize(const QByteArray& byteArray)
         result.m_entries.push_back(entry);
     }
 
+    result.buildLookupIntervals();
     return result;
 }
 
@@ -2466,11 +3327,10 @@ std::vector<CID> PDFFontCMap::interpret(const QByteArray& byteArray) const
         ++scannedBytes;
 
         // Find suitable mapping
-        auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [value, scannedBytes](const Entry& entry) { return entry.from <= value && entry.to >= value && entry.byteCount == scannedBytes; });
-        if (it != m_entries.cend())
+        const Interval* interval = scannedBytes < m_codeIntervals.size() ? findInterval(m_codeIntervals[scannedBytes], value) : nullptr;
+        if (interval)
         {
-            const Entry& entry = *it;
-            const CID cid = value - entry.from + entry.cid;
+            const CID cid = value - interval->from + interval->cid;
             result.push_back(cid);
 
             value = 0;
@@ -2488,15 +3348,42 @@ std::vector<CID> PDFFontCMap::interpret(const QByteArray& byteArray) const
     return result;
 }
 
+std::vector<std::pair<QByteArray, CID>> PDFFontCMap::interpretCodes(const QByteArray& byteArray) const
+{
+    std::vector<std::pair<QByteArray, CID>> result;
+    result.reserve(byteArray.size() / m_maxKeyLength);
+
+    unsigned int value = 0;
+    unsigned int scannedBytes = 0;
+
+    for (int i = 0, size = byteArray.size(); i < size; ++i)
+    {
+        value = (value << 8) + static_cast<unsigned char>(byteArray[i]);
+        ++scannedBytes;
+
+        // Find suitable mapping
+        const Interval* interval = scannedBytes < m_codeIntervals.size() ? findInterval(m_codeIntervals[scannedBytes], value) : nullptr;
+        if (interval || scannedBytes == m_maxKeyLength)
+        {
+            // If mapping is not found, then error occured - use empty CID
+            const CID cid = interval ? value - interval->from + interval->cid : 0;
+            result.emplace_back(byteArray.mid(i + 1 - scannedBytes, scannedBytes), cid);
+
+            value = 0;
+            scannedBytes = 0;
+        }
+    }
+
+    return result;
+}
+
 QChar PDFFontCMap::getToUnicode(CID cid) const
 {
     if (isValid())
     {
-        auto it = std::find_if(m_entries.cbegin(), m_entries.cend(), [cid](const Entry& entry) { return entry.from <= cid && entry.to >= cid; });
-        if (it != m_entries.cend())
+        if (const Interval* interval = findInterval(m_unicodeIntervals, cid))
         {
-            const Entry& entry = *it;
-            const CID unicodeCID = cid - entry.from + entry.cid;
+            const CID unicodeCID = cid - interval->from + interval->cid;
             return QChar(unicodeCID);
         }
     }
@@ -2510,6 +3397,105 @@ PDFFontCMap::PDFFontCMap(Entries&& entries, bool vertical) :
     m_vertical(vertical)
 {
     m_maxKeyLength = std::accumulate(m_entries.cbegin(), m_entries.cend(), 0, [](unsigned int a, const Entry& b) { return qMax(a, b.byteCount); });
+    buildLookupIntervals();
+}
+
+PDFFontCMap::Intervals PDFFontCMap::createIntervals(unsigned int byteCount) const
+{
+    // Covered intervals, key is start of the interval
+    std::map<unsigned int, Interval> covered;
+
+    for (const Entry& entry : m_entries)
+    {
+        if ((byteCount != 0 && entry.byteCount != byteCount) || entry.from > entry.to)
+        {
+            continue;
+        }
+
+        // Find first covered interval, which can intersect the entry
+        auto it = covered.upper_bound(entry.from);
+        if (it != covered.begin() && std::prev(it)->second.to >= entry.from)
+        {
+            --it;
+        }
+
+        // Only parts of the entry, which are not covered yet, are inserted,
+        // because preceding entries take precedence.
+        unsigned int current = entry.from;
+        while (true)
+        {
+            if (it != covered.end() && it->second.from <= current)
+            {
+                if (it->second.to >= entry.to)
+                {
+                    break;
+                }
+
+                current = it->second.to + 1;
+                ++it;
+                continue;
+            }
+
+            const unsigned int last = (it != covered.end()) ? qMin(entry.to, it->second.from - 1) : entry.to;
+            covered.emplace_hint(it, current, Interval{ current, last, entry.cid + (current - entry.from) });
+
+            if (last == entry.to)
+            {
+                break;
+            }
+
+            current = last + 1;
+        }
+    }
+
+    // Merge adjacent intervals with consecutive CIDs
+    Intervals intervals;
+    intervals.reserve(covered.size());
+    for (const auto& item : covered)
+    {
+        const Interval& interval = item.second;
+        if (!intervals.empty())
+        {
+            Interval& lastInterval = intervals.back();
+            if (lastInterval.to + 1 == interval.from && lastInterval.cid + (interval.from - lastInterval.from) == interval.cid)
+            {
+                lastInterval.to = interval.to;
+                continue;
+            }
+        }
+
+        intervals.push_back(interval);
+    }
+
+    intervals.shrink_to_fit();
+    return intervals;
+}
+
+void PDFFontCMap::buildLookupIntervals()
+{
+    m_codeIntervals.clear();
+    m_codeIntervals.resize(m_maxKeyLength + 1);
+    for (unsigned int byteCount = 1; byteCount <= m_maxKeyLength; ++byteCount)
+    {
+        m_codeIntervals[byteCount] = createIntervals(byteCount);
+    }
+
+    m_unicodeIntervals = createIntervals(0);
+}
+
+const PDFFontCMap::Interval* PDFFontCMap::findInterval(const Intervals& intervals, unsigned int value)
+{
+    auto it = std::upper_bound(intervals.cbegin(), intervals.cend(), value, [](unsigned int currentValue, const Interval& interval) { return currentValue < interval.from; });
+    if (it != intervals.cbegin())
+    {
+        --it;
+        if (it->to >= value)
+        {
+            return &*it;
+        }
+    }
+
+    return nullptr;
 }
 
 PDFFontCMap::Entries PDFFontCMap::optimize(const PDFFontCMap::Entries& entries)
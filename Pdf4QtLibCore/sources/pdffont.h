@@ -21,13 +21,17 @@
 #include "pdfglobal.h"
 #include "pdfencoding.h"
 #include "pdfobject.h"
+#include "pdfruntimestatistics.h"
 
 #include <QFont>
 #include <QMutex>
 #include <QTransform>
+#include <QReadWriteLock>
 #include <QSharedPointer>
 
 #include <set>
+#include <array>
+#include <atomic>
 #include <unordered_map>
 
 class QPainterPath;
@@ -279,6 +283,11 @@ public:
     /// Returns character info
     CharacterInfos getCharacterInfos() const;
 
+    /// Canonical size, at which fonts are realized for rendering. Glyph outlines
+    /// and advances are then scaled by the text font size, so one realized
+    /// font is shared between all font sizes (Type 3 fonts are not affected).
+    static constexpr const PDFReal CANONICAL_FONT_SIZE = 1.0;
+
     /// Creates new realized font from the standard font. If font can't be created,
     /// then exception is thrown.
     static PDFRealizedFontPointer createRealizedFont(PDFFontPointer font, PDFReal pixelSize, PDFRenderErrorReporter* reporter);
@@ -412,9 +421,12 @@ public:
     virtual FontType getFontType() const override;
 };
 
-/// Font cache which caches both fonts, and realized fonts. Cache has individual limit
-/// for fonts, and realized fonts.
-class PDF4QTLIBCORESHARED_EXPORT PDFFontCache
+/// Cache of fonts and realized fonts. Cache is divided into shards (by hash
+/// of the key), each shard has its own read/write lock, so threads compiling
+/// pages lock only the shard they need, and cache hits take only shared lock.
+/// Fonts are reference counted, so shrinking of the cache is always safe -
+/// font removed from the cache is deleted, when its last user releases it.
+class PDF4QTLIBCORESHARED_EXPORT PDFFontCache : public PDFRuntimeStatisticsProvider
 {
 public:
     inline explicit PDFFontCache(size_t fontCacheLimit, size_t realizedFontCacheLimit) :
@@ -442,11 +454,9 @@ public:
     /// \param reporter Error reporter
     PDFRealizedFontPointer getRealizedFont(const PDFFontPointer& font, PDFReal size, PDFRenderErrorReporter* reporter) const;
 
-    /// Sets or unsets font shrinking (i.e. font can be deleted from the cache). In multithreading environment,
-    /// font deletion is not thread safe. For this reason, disable font deletion by calling this function.
-    /// First parameter, \p source determines which object enables cache shrinking (so some objects can
-    /// enable shrinking, while some objects will disable it). Only if all objects enables cache shrinking,
-    /// then cache can shrink.
+    /// Sets or unsets font shrinking. This function is obsolete, because fonts are
+    /// reference counted and can be removed from the cache at any time, even when
+    /// they are used in another thread. Enabling shrinking just shrinks the cache.
     /// \param source Source object
     /// \param enabled Enable or disable cache shrinking
     void setCacheShrinkEnabled(const void* source, bool enabled);
@@ -454,17 +464,64 @@ public:
     /// Set font cache limits
     void setCacheLimits(std::size_t fontCacheLimit, std::size_t instancedFontCacheLimit);
 
-    /// If shrinking is enabled, then erase font, if cache limit is exceeded.
+    /// Erase fonts, if cache limit is exceeded.
     void shrink();
 
+    /// Returns count of cached fonts
+    size_t getFontCount() const;
+
+    /// Returns count of cached realized fonts
+    size_t getRealizedFontCount() const;
+
+    /// Adds sizes, limits and hit rates of the cache
+    virtual void collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const override;
+
 private:
-    size_t m_fontCacheLimit;
-    size_t m_realizedFontCacheLimit;
-    mutable QMutex m_mutex;
-    const PDFDocument* m_document;
-    mutable std::map<PDFObjectReference, PDFFontPointer> m_fontCache;
-    mutable std::map<std::pair<PDFFontPointer, PDFReal>, PDFRealizedFontPointer> m_realizedFontCache;
-    mutable std::set<const void*> m_fontCacheShrinkDisabledObjects;
+    static constexpr size_t SHARD_COUNT = 16;
+
+    using RealizedFontKey = std::pair<PDFFontPointer, PDFReal>;
+
+    struct FontKeyHash
+    {
+        size_t operator()(const PDFObjectReference& reference) const
+        {
+            return std::hash<PDFInteger>()(reference.objectNumber) ^ (std::hash<PDFInteger>()(reference.generation) << 1);
+        }
+    };
+
+    struct RealizedFontKeyHash
+    {
+        size_t operator()(const RealizedFontKey& key) const
+        {
+            return std::hash<const PDFFont*>()(key.first.data()) ^ (std::hash<PDFReal>()(key.second) << 1);
+        }
+    };
+
+    struct FontCacheShard
+    {
+        QReadWriteLock lock;
+        std::unordered_map<PDFObjectReference, PDFFontPointer, FontKeyHash> fonts;
+    };
+
+    struct RealizedFontCacheShard
+    {
+        QReadWriteLock lock;
+        std::unordered_map<RealizedFontKey, PDFRealizedFontPointer, RealizedFontKeyHash> realizedFonts;
+    };
+
+    /// Returns maximal item count in one shard for given cache limit
+    static size_t getShardLimit(size_t cacheLimit) { return qMax(cacheLimit / SHARD_COUNT, size_t(1)); }
+
+    std::atomic<size_t> m_fontCacheLimit;
+    std::atomic<size_t> m_realizedFontCacheLimit;
+    std::atomic<const PDFDocument*> m_document;
+    mutable std::array<FontCacheShard, SHARD_COUNT> m_fontCacheShards;
+    mutable std::array<RealizedFontCacheShard, SHARD_COUNT> m_realizedFontCacheShards;
+
+    mutable std::atomic<quint64> m_fontHits = 0;
+    mutable std::atomic<quint64> m_fontMisses = 0;
+    mutable std::atomic<quint64> m_realizedFontHits = 0;
+    mutable std::atomic<quint64> m_realizedFontMisses = 0;
 };
 
 /// Performs mapping from CID to GID (even identity mapping, if byte array is empty)
@@ -532,10 +589,13 @@ public:
     /// Returns true, if vertical writing mode is on
     bool isVertical() const { return m_vertical; }
 
-    /// Creates mapping from name (name must be one of predefined names)
+    /// Creates mapping from name (name must be one of predefined names). Parsed
+    /// predefined mappings are cached process-wide, so they are parsed only once.
     static PDFFontCMap createFromName(const QByteArray& name);
 
-    /// Creates mapping from data (data must be a byte array containing the CMap)
+    /// Creates mapping from data (data must be a byte array containing the CMap).
+    /// Parsed mappings are cached process-wide by content of the data, so
+    /// the same mapping used in more fonts (or documents) is parsed only once.
     static PDFFontCMap createFromData(const QByteArray& data);
 
     /// Serializes the CMap to the byte array
@@ -547,6 +607,11 @@ public:
     /// Converts byte array to array of CIDs
     std::vector<CID> interpret(const QByteArray& byteArray) const;
 
+    /// Converts byte array to array of character codes with their CIDs. Each
+    /// character code is a byte sequence of the byte array, which is mapped to
+    /// a single CID. Incomplete code at the end of the byte array is ignored.
+    std::vector<std::pair<QByteArray, CID>> interpretCodes(const QByteArray& byteArray) const;
+
     /// Converts CID to QChar, use only on ToUnicode CMaps
     QChar getToUnicode(CID cid) const;
 
@@ -584,15 +649,52 @@ private:
 
     using Entries = std::vector<Entry>;
 
+    /// Interval of codes mapped to consecutive CIDs (or unicode characters)
+    struct Interval
+    {
+        unsigned int from = 0;
+        unsigned int to = 0;
+        CID cid = 0;
+    };
+
+    /// Sorted disjoint intervals, they are searched using binary search
+    using Intervals = std::vector<Interval>;
+
+    /// Maximal count of cached mappings created from data
+    static constexpr const size_t CMAP_CACHE_LIMIT = 128;
+
     explicit PDFFontCMap(Entries&& entries, bool vertical);
 
+    /// Parses mapping from data (data must be a byte array containing the CMap)
+    static PDFFontCMap parse(const QByteArray& data);
+
     /// Optimizes the entries - merges entries, which can be merged. This function
     /// requires, that entries are sorted.
     static Entries optimize(const Entries& entries);
 
+    /// Creates lookup intervals from the entries. Entries can overlap, in that
+    /// case, entry, which is first in the entry list, takes precedence.
+    /// If \p byteCount is zero, then entries of all byte counts are used.
+    /// \param byteCount Byte count of the entries
+    Intervals createIntervals(unsigned int byteCount) const;
+
+    /// Creates lookup intervals for all byte counts and for unicode mapping
+    void buildLookupIntervals();
+
+    /// Returns interval containing the value, or nullptr, if such interval doesn't exist
+    /// \param intervals Intervals
+    /// \param value Value
+    static const Interval* findInterval(const Intervals& intervals, unsigned int value);
+
     Entries m_entries;
     unsigned int m_maxKeyLength = 0;
     bool m_vertical = false;
+
+    /// Lookup intervals for codes of given byte count (index is byte count)
+    std::vector<Intervals> m_codeIntervals;
+
+    /// Lookup intervals of codes of any byte count (used for unicode mapping)
+    Intervals m_unicodeIntervals;
 };
 
 class PDFType3Font : public PDFFont
@@ -56,7 +56,7 @@ PDFForm PDFForm::parse(const PDFDocument* document, PDFObject object)
 
         // As post-processing, delete all form fields, which are nullptr (are incorrectly defined)
         form.m_formFields.erase(std::remove_if(form.m_formFields.begin(), form.m_formFields.end(), [](const auto& field){ return !field; }), form.m_formFields.end());
-        form.updateWidgetToFormFieldMapping();
+        form.updateFormFieldMappings();
 
         // If we have form, then we must also look for 'rogue' form fields, which are
         // incorrectly not in the 'Fields' entry of this form. We do this by iterating
@@ -90,22 +90,33 @@ PDFForm PDFForm::parse(const PDFDocument* document, PDFObject object)
 
         if (rogueFieldFound)
         {
-            form.updateWidgetToFormFieldMapping();
+            form.updateFormFieldMappings();
         }
     }
 
     return form;
 }
 
-void PDFForm::updateWidgetToFormFieldMapping()
+void PDFForm::updateFormFieldMappings()
 {
     m_widgetToFormField.clear();
+    m_nameToFormFields.clear();
 
     if (isAcroForm() || isXFAForm())
     {
+        auto addFormField = [this](PDFFormField* formField)
+        {
+            const QString& qualifiedName = formField->getName(PDFFormField::NameType::FullyQualified);
+            if (!qualifiedName.isEmpty())
+            {
+                m_nameToFormFields.emplace(qualifiedName, formField);
+            }
+        };
+
         for (const PDFFormFieldPointer& formFieldPtr : getFormFields())
         {
             formFieldPtr->fillWidgetToFormFieldMapping(m_widgetToFormField);
+            formFieldPtr->modify(addFormField);
         }
     }
 }
@@ -155,6 +166,19 @@ PDFFormField* PDFForm::getFormFieldForWidget(PDFObjectReference widget)
     return nullptr;
 }
 
+std::vector<PDFFormField*> PDFForm::getFormFieldsByName(const QString& fullyQualifiedName) const
+{
+    std::vector<PDFFormField*> result;
+
+    auto range = m_nameToFormFields.equal_range(fullyQualifiedName);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        result.push_back(it->second);
+    }
+
+    return result;
+}
+
 void PDFForm::apply(const std::function<void (const PDFFormField*)>& functor) const
 {
     for (const PDFFormFieldPointer& childField : getFormFields())
@@ -663,8 +687,11 @@ void PDFFormManager::setDocument(const PDFModifiedDocument& document)
         }
         else if (document.hasFlag(PDFModifiedDocument::FormField))
         {
-            // Just update field values
-            updateFieldValues();
+            // Just update field values. Only changed form fields are reloaded,
+            // so typing into a large form doesn't reload all form fields.
+            std::vector<PDFObjectReference> changedObjects = document.getChangedObjects();
+            std::sort(changedObjects.begin(), changedObjects.end());
+            updateFieldValues(changedObjects);
         }
 
         m_xfaEngine.setDocument(document, &m_form);
@@ -769,30 +796,28 @@ void PDFFormManager::setFormFieldValue(PDFFormField::SetValueParameters paramete
 
     if (parameters.invokingFormField->setValue(parameters))
     {
-        // We must also set dependent fields with same name
+        // We must also set dependent fields with same name. All of them are
+        // changed by the same modifier, so one document modification is
+        // created for the whole user action.
         QString qualifiedFormFieldName = parameters.invokingFormField->getName(PDFFormField::NameType::FullyQualified);
         if (!qualifiedFormFieldName.isEmpty())
         {
             parameters.scope = PDFFormField::SetValueParameters::Scope::Internal;
-            auto updateDependentField = [&parameters, &qualifiedFormFieldName](PDFFormField* formField)
+            for (PDFFormField* formField : m_form.getFormFieldsByName(qualifiedFormFieldName))
             {
                 if (parameters.invokingFormField == formField)
                 {
                     // Do not update self
-                    return;
+                    continue;
                 }
 
-                if (qualifiedFormFieldName == formField->getName(PDFFormField::NameType::FullyQualified))
-                {
-                    formField->setValue(parameters);
-                }
-            };
-            modify(updateDependentField);
+                formField->setValue(parameters);
+            }
         }
 
         if (modifier.finalize())
         {
-            Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT documentModified(modifier.getModifiedDocument());
         }
     }
 }
@@ -883,7 +908,7 @@ void PDFFormManager::performPaging()
 
         if (modifier.finalize())
         {
-            Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT documentModified(modifier.getModifiedDocument());
         }
     }
 }
@@ -913,15 +938,59 @@ void PDFFormManager::drawFormField(const PDFFormField* formField, AnnotationDraw
     Q_UNUSED(edit);
 }
 
-void PDFFormManager::updateFieldValues()
+void PDFFormManager::updateFieldValues(const std::vector<PDFObjectReference>& changedObjects)
 {
-    if (m_document)
+    if (!m_document)
+    {
+        return;
+    }
+
+    const PDFObjectStorage* storage = &m_document->getStorage();
+
+    if (changedObjects.empty())
     {
         for (const PDFFormFieldPointer& childField : m_form.getFormFields())
         {
-            childField->reloadValue(&m_document->getStorage(), PDFObject());
+            childField->reloadValue(storage, PDFObject());
         }
+
+        return;
     }
+
+    // Jakub Melka: Value can be inherited by the children, so we reload the topmost
+    // changed form field, its children are reloaded together with it. Unchanged
+    // subtrees are skipped.
+    std::function<void(PDFFormField*, const PDFObject&)> reloadChangedValues = [&](PDFFormField* formField, const PDFObject& parentValue)
+    {
+        if (std::binary_search(changedObjects.cbegin(), changedObjects.cend(), formField->getSelfReference()))
+        {
+            formField->reloadValue(storage, parentValue);
+            return;
+        }
+
+        for (const PDFFormFieldPointer& childField : formField->getChildFields())
+        {
+            reloadChangedValues(childField.data(), formField->getValue());
+        }
+    };
+
+    for (const PDFFormFieldPointer& childField : m_form.getFormFields())
+    {
+        reloadChangedValues(childField.data(), PDFObject());
+    }
+}
+
+bool PDFFormManager::isFormFieldChanged(const PDFFormField* formField, const std::vector<PDFObjectReference>& changedObjects)
+{
+    for (; formField; formField = formField->getParentField())
+    {
+        if (std::binary_search(changedObjects.cbegin(), changedObjects.cend(), formField->getSelfReference()))
+        {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 void PDFFormManager::performResetAction(const PDFActionResetForm* action)
@@ -971,7 +1040,7 @@ void PDFFormManager::performResetAction(const PDFActionResetForm* action)
 
     if (modifier.finalize())
     {
-        Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+        Q_EMIT documentModified(modifier.getModifiedDocument());
     }
 }
 
@@ -457,6 +457,12 @@ public:
     /// \param widget Widget annotation
     PDFFormField* getFormFieldForWidget(PDFObjectReference widget);
 
+    /// Returns form fields with given fully qualified name. Form fields
+    /// with the same fully qualified name share the value, so if value of one
+    /// of them is changed, values of the others must be changed too.
+    /// \param fullyQualifiedName Fully qualified name of the form field
+    std::vector<PDFFormField*> getFormFieldsByName(const QString& fullyQualifiedName) const;
+
     /// Applies function to all form fields present in the form,
     /// in pre-order (first application is to the parent, following
     /// calls to apply for children).
@@ -470,7 +476,7 @@ public:
     static PDFForm parse(const PDFDocument* document, PDFObject object);
 
 private:
-    void updateWidgetToFormFieldMapping();
+    void updateFormFieldMappings();
 
     FormType m_formType = FormType::None;
     PDFFormFields m_formFields;
@@ -482,6 +488,7 @@ private:
     std::optional<PDFInteger> m_quadding;
     PDFObject m_xfa;
     PDFWidgetToFormFieldMapping m_widgetToFormField;
+    std::multimap<QString, PDFFormField*> m_nameToFormFields;
 };
 
 /// Form manager. Manages all form widgets functionality - triggers actions,
@@ -604,9 +611,19 @@ public:
     virtual void drawFormField(const PDFFormField* formField, AnnotationDrawParameters& parameters, bool edit) const;
 
 protected:
-    virtual void updateFieldValues();
+    /// Reloads values of the form fields from the document. If changed
+    /// objects are known, only values of the changed form fields (and of their
+    /// children, which can inherit the value) are reloaded.
+    /// \param changedObjects Sorted references of changed objects (empty, if unknown)
+    virtual void updateFieldValues(const std::vector<PDFObjectReference>& changedObjects);
     virtual void onDocumentReset() { }
 
+    /// Returns true, if value of the form field can be affected by the change of
+    /// the objects, i.e. form field or some of its parents has been changed.
+    /// \param formField Form field
+    /// \param changedObjects Sorted references of changed objects
+    static bool isFormFieldChanged(const PDFFormField* formField, const std::vector<PDFObjectReference>& changedObjects);
+
 signals:
     void actionTriggered(const pdf::PDFAction* action);
     void documentModified(pdf::PDFModifiedDocument document);
@@ -0,0 +1,610 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfformfiller.h"
+#include "pdfform.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfdocumentwriter.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfexception.h"
+#include "pdfencoding.h"
+#include "pdfparser.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <set>
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+/// Form manager used by the form filler. Each worker has its own form manager,
+/// so form of the template is parsed once per worker. Form fields are
+/// changed, when record is filled, so their values are restored from
+/// the template document afterwards.
+class PDFFormFillerFormManager : public PDFFormManager
+{
+public:
+    explicit PDFFormFillerFormManager(const PDFDocument* document);
+
+    /// Fills the form with values of the record and returns filled document.
+    /// If error occurs, exception is thrown.
+    /// \param record Record
+    PDFDocument fill(const PDFFormFillerRecord& record);
+
+private:
+    /// Sets value to the form field. If value can't be set, exception is thrown.
+    /// \param formField Form field
+    /// \param value Value
+    /// \param modifier Document modifier
+    void setValue(PDFFormField* formField, const QString& value, PDFDocumentModifier* modifier);
+
+    const PDFDocument* m_templateDocument;
+};
+
+PDFFormFillerFormManager::PDFFormFillerFormManager(const PDFDocument* document) :
+    PDFFormManager(nullptr),
+    m_templateDocument(document)
+{
+    setDocument(PDFModifiedDocument(const_cast<PDFDocument*>(document), nullptr));
+}
+
+PDFDocument PDFFormFillerFormManager::fill(const PDFFormFillerRecord& record)
+{
+    if (!hasAcroForm())
+    {
+        throw PDFException(PDFTranslationContext::tr("Document doesn't contain interactive form."));
+    }
+
+    PDFDocumentModifier modifier(m_templateDocument);
+    modifier.getBuilder()->setFormManager(this);
+
+    PDFDocument document;
+    try
+    {
+        for (const auto& item : record)
+        {
+            std::vector<PDFFormField*> formFields = getForm()->getFormFieldsByName(item.first);
+            if (formFields.empty())
+            {
+                throw PDFException(PDFTranslationContext::tr("Form field '%1' not found.").arg(item.first));
+            }
+
+            for (PDFFormField* formField : formFields)
+            {
+                setValue(formField, item.second, &modifier);
+            }
+        }
+
+        // Jakub Melka: we do not finalize the modifier, because we don't need
+        // to determine pages affected by the modification. Changed objects are
+        // found quickly, because storage of the builder shares unmodified chunks
+        // of objects with the storage of the template.
+        document = modifier.getBuilder()->build();
+    }
+    catch (const PDFException&)
+    {
+        // Values of some form fields could have been changed, reload all of them
+        updateFieldValues(std::vector<PDFObjectReference>());
+        throw;
+    }
+
+    // Restore values of changed form fields, so next record
+    // starts with values of the template document.
+    std::vector<PDFObjectReference> changedObjects = document.getStorage().getChangedObjects(m_templateDocument->getStorage());
+    std::sort(changedObjects.begin(), changedObjects.end());
+    updateFieldValues(changedObjects);
+
+    return document;
+}
+
+void PDFFormFillerFormManager::setValue(PDFFormField* formField, const QString& value, PDFDocumentModifier* modifier)
+{
+    PDFFormField::SetValueParameters parameters;
+    parameters.invokingFormField = formField;
+    parameters.modifier = modifier;
+    parameters.formManager = this;
+    parameters.scope = PDFFormField::SetValueParameters::Scope::Internal;
+
+    switch (formField->getFieldType())
+    {
+        case PDFFormField::FieldType::Text:
+        {
+            parameters.value = PDFObjectFactory::createTextString(value);
+            break;
+        }
+
+        case PDFFormField::FieldType::Button:
+        {
+            const PDFFormFieldButton* button = dynamic_cast<const PDFFormFieldButton*>(formField);
+            Q_ASSERT(button);
+
+            if (button->getButtonType() == PDFFormFieldButton::ButtonType::PushButton)
+            {
+                throw PDFException(PDFTranslationContext::tr("Value can't be set to push button '%1'.").arg(formField->getName(PDFFormField::NameType::FullyQualified)));
+            }
+
+            const QString lowerCaseValue = value.trimmed().toLower();
+            const bool isOff = lowerCaseValue.isEmpty() || lowerCaseValue == "off" || lowerCaseValue == "false" || lowerCaseValue == "0" || lowerCaseValue == "no";
+            const bool isOn = lowerCaseValue == "true" || lowerCaseValue == "1" || lowerCaseValue == "yes" || lowerCaseValue == "on";
+
+            // Appearance states of buttons with options are indices to the options
+            QByteArray state = value.toLatin1();
+            const qsizetype optionIndex = button->getOptions().indexOf(value);
+            if (optionIndex >= 0)
+            {
+                state = QByteArray::number(optionIndex);
+            }
+
+            for (const PDFFormWidget& widget : formField->getWidgets())
+            {
+                const QByteArray onState = PDFFormFieldButton::getOnAppearanceState(this, &widget);
+                const bool isCheckBox = button->getButtonType() == PDFFormFieldButton::ButtonType::CheckBox;
+
+                if (isOff)
+                {
+                    state = PDFFormFieldButton::getOffAppearanceState(this, &widget);
+                    parameters.invokingWidget = widget.getWidget();
+                    break;
+                }
+
+                if ((isOn && isCheckBox && optionIndex < 0) || onState == state)
+                {
+                    state = onState;
+                    parameters.invokingWidget = widget.getWidget();
+                    break;
+                }
+            }
+
+            if (isOff && state.isEmpty())
+            {
+                state = "Off";
+            }
+
+            if (!formField->getWidgets().empty() && !parameters.invokingWidget.isValid())
+            {
+                throw PDFException(PDFTranslationContext::tr("Invalid value '%1' of button '%2'.").arg(value, formField->getName(PDFFormField::NameType::FullyQualified)));
+            }
+
+            parameters.value = PDFObject::createName(qMove(state));
+            break;
+        }
+
+        case PDFFormField::FieldType::Choice:
+        {
+            const PDFFormFieldChoice* choice = dynamic_cast<const PDFFormFieldChoice*>(formField);
+            Q_ASSERT(choice);
+
+            parameters.value = PDFObjectFactory::createTextString(value);
+
+            if (choice->isListBox())
+            {
+                const PDFFormFieldChoice::Options& options = choice->getOptions();
+                auto it = std::find_if(options.cbegin(), options.cend(), [&value](const PDFFormFieldChoice::Option& option) { return option.exportString == value || option.userString == value; });
+
+                if (it != options.cend())
+                {
+                    parameters.listboxChoices.push_back(std::distance(options.cbegin(), it));
+                }
+                else if (!value.isEmpty())
+                {
+                    throw PDFException(PDFTranslationContext::tr("Invalid value '%1' of list box '%2'.").arg(value, formField->getName(PDFFormField::NameType::FullyQualified)));
+                }
+
+                parameters.listboxTopIndex = choice->getTopIndex();
+            }
+            break;
+        }
+
+        default:
+            throw PDFException(PDFTranslationContext::tr("Value can't be set to form field '%1'.").arg(formField->getName(PDFFormField::NameType::FullyQualified)));
+    }
+
+    if (!formField->setValue(parameters))
+    {
+        throw PDFException(PDFTranslationContext::tr("Value '%1' can't be set to form field '%2'.").arg(value, formField->getName(PDFFormField::NameType::FullyQualified)));
+    }
+}
+
+PDFFormFiller::PDFFormFiller(const PDFDocument* document) :
+    m_document(document)
+{
+
+}
+
+PDFDocument PDFFormFiller::fill(const PDFFormFillerRecord& record) const
+{
+    PDFFormFillerFormManager formManager(m_document);
+    return formManager.fill(record);
+}
+
+std::vector<PDFOperationResult> PDFFormFiller::fillAndWrite(const PDFFormFillerRecords& records, const FileNameGetter& getFileName) const
+{
+    std::vector<PDFOperationResult> results(records.size(), true);
+
+    // Records are divided into batches, each batch is processed by one worker,
+    // which parses the form only once and then fills all records of the batch.
+    const size_t batchCount = qBound<size_t>(1, PDFExecutionPolicy::getMaxThreadCount(PDFExecutionPolicy::Scope::Page), qMax<size_t>(records.size(), 1));
+    const size_t batchSize = (records.size() + batchCount - 1) / batchCount;
+
+    auto processBatch = [&](size_t batchIndex)
+    {
+        const size_t first = batchIndex * batchSize;
+        const size_t last = qMin(first + batchSize, records.size());
+
+        if (first >= last)
+        {
+            return;
+        }
+
+        PDFFormFillerFormManager formManager(m_document);
+        for (size_t i = first; i < last; ++i)
+        {
+            const QString fileName = getFileName(i);
+
+            try
+            {
+                PDFDocument document = formManager.fill(records[i]);
+
+                PDFDocumentWriter writer(nullptr);
+                results[i] = writer.write(fileName, &document, true);
+            }
+            catch (const PDFException& exception)
+            {
+                results[i] = exception.getMessage();
+            }
+        }
+    };
+
+    PDFIntegerRange<size_t> batches(0, batchCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, batches.begin(), batches.end(), processBatch);
+
+    return results;
+}
+
+PDFOperationResult PDFFormFiller::readRecords(const QString& fileName, PDFFormFillerRecords& records)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+    {
+        return PDFTranslationContext::tr("Can't open file '%1' for reading.").arg(fileName);
+    }
+
+    const QByteArray data = file.readAll();
+    file.close();
+
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "csv")
+    {
+        return readCsv(data, records);
+    }
+    else if (suffix == "json")
+    {
+        return readJson(data, records);
+    }
+    else if (suffix == "fdf")
+    {
+        return readFdf(data, records);
+    }
+
+    return PDFTranslationContext::tr("Unknown format of data file '%1' (valid formats: csv|json|fdf).").arg(fileName);
+}
+
+PDFOperationResult PDFFormFiller::readCsv(const QByteArray& data, PDFFormFillerRecords& records)
+{
+    QString text = QString::fromUtf8(data);
+    if (text.startsWith(QChar(0xFEFF)))
+    {
+        text.remove(0, 1);
+    }
+
+    // Parse rows, quoted values can contain separators, quotes and line breaks
+    std::vector<QStringList> rows;
+    QStringList row;
+    QString value;
+    bool isQuoted = false;
+    bool isRowEmpty = true;
+
+    for (qsizetype i = 0; i < text.size(); ++i)
+    {
+        const QChar character = text[i];
+
+        if (isQuoted)
+        {
+            if (character == '"')
+            {
+                if (i + 1 < text.size() && text[i + 1] == '"')
+                {
+                    value += character;
+                    ++i;
+                }
+                else
+                {
+                    isQuoted = false;
+                }
+            }
+            else
+            {
+                value += character;
+            }
+            continue;
+        }
+
+        switch (character.unicode())
+        {
+            case '"':
+                isQuoted = true;
+                isRowEmpty = false;
+                break;
+
+            case ',':
+                row << qMove(value);
+                value = QString();
+                isRowEmpty = false;
+                break;
+
+            case '\r':
+                break;
+
+            case '\n':
+                if (!isRowEmpty)
+                {
+                    row << qMove(value);
+                    rows.push_back(qMove(row));
+                }
+                value = QString();
+                row = QStringList();
+                isRowEmpty = true;
+                break;
+
+            default:
+                value += character;
+                isRowEmpty = false;
+                break;
+        }
+    }
+
+    if (isQuoted)
+    {
+        return PDFTranslationContext::tr("Unterminated quoted value in CSV data.");
+    }
+
+    if (!isRowEmpty)
+    {
+        row << qMove(value);
+        rows.push_back(qMove(row));
+    }
+
+    if (rows.empty())
+    {
+        return PDFTranslationContext::tr("CSV data doesn't contain header with names of form fields.");
+    }
+
+    const QStringList& header = rows.front();
+    for (size_t i = 1; i < rows.size(); ++i)
+    {
+        const QStringList& values = rows[i];
+        if (values.size() != header.size())
+        {
+            return PDFTranslationContext::tr("Row %1 of CSV data has %2 values, but header has %3 values.").arg(i + 1).arg(values.size()).arg(header.size());
+        }
+
+        PDFFormFillerRecord record;
+        for (qsizetype j = 0; j < header.size(); ++j)
+        {
+            record[header[j]] = values[j];
+        }
+        records.push_back(qMove(record));
+    }
+
+    return true;
+}
+
+PDFOperationResult PDFFormFiller::readJson(const QByteArray& data, PDFFormFillerRecords& records)
+{
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(data, &error);
+    if (document.isNull())
+    {
+        return PDFTranslationContext::tr("Invalid JSON data. %1").arg(error.errorString());
+    }
+
+    QJsonArray objects;
+    if (document.isArray())
+    {
+        objects = document.array();
+    }
+    else
+    {
+        objects.append(document.object());
+    }
+
+    for (const QJsonValue& objectValue : objects)
+    {
+        if (!objectValue.isObject())
+        {
+            return PDFTranslationContext::tr("Record of JSON data must be an object.");
+        }
+
+        PDFFormFillerRecord record;
+        const QJsonObject object = objectValue.toObject();
+        for (auto it = object.begin(); it != object.end(); ++it)
+        {
+            const QJsonValue value = it.value();
+            switch (value.type())
+            {
+                case QJsonValue::String:
+                case QJsonValue::Double:
+                    record[it.key()] = value.toVariant().toString();
+                    break;
+
+                case QJsonValue::Bool:
+                    record[it.key()] = value.toBool() ? QString("true") : QString("false");
+                    break;
+
+                case QJsonValue::Null:
+                    record[it.key()] = QString();
+                    break;
+
+                default:
+                    return PDFTranslationContext::tr("Invalid value of form field '%1' in JSON data.").arg(it.key());
+            }
+        }
+        records.push_back(qMove(record));
+    }
+
+    return true;
+}
+
+PDFOperationResult PDFFormFiller::readFdf(const QByteArray& data, PDFFormFillerRecords& records)
+{
+    if (!data.startsWith("%FDF-"))
+    {
+        return PDFTranslationContext::tr("Header of FDF file was not found.");
+    }
+
+    try
+    {
+        // FDF has the same syntax as PDF, but doesn't need to have
+        // a cross reference table, so objects are read sequentially.
+        std::map<PDFObjectReference, PDFObject> objects;
+        PDFObject trailer;
+
+        PDFParser parser(data, nullptr, PDFParser::AllowStreams);
+        while (parser.lookahead().type != PDFLexicalAnalyzer::TokenType::EndOfFile)
+        {
+            if (parser.lookahead().type == PDFLexicalAnalyzer::TokenType::Command)
+            {
+                const QByteArray command = parser.lookahead().data.toByteArray();
+                parser.fetchCommand(command.constData());
+
+                if (command == "trailer")
+                {
+                    trailer = parser.getObject();
+                }
+                continue;
+            }
+
+            PDFObject objectNumber = parser.getObject();
+            if (objectNumber.isInt() && parser.lookahead().type == PDFLexicalAnalyzer::TokenType::Integer)
+            {
+                PDFObject generation = parser.getObject();
+                if (generation.isInt() && parser.fetchCommand("obj"))
+                {
+                    objects[PDFObjectReference(objectNumber.getInteger(), generation.getInteger())] = parser.getObject();
+                    parser.fetchCommand("endobj");
+                }
+            }
+        }
+
+        auto dereference = [&objects](const PDFObject& object) -> PDFObject
+        {
+            if (object.isReference())
+            {
+                auto it = objects.find(object.getReference());
+                return it != objects.cend() ? it->second : PDFObject();
+            }
+            return object;
+        };
+
+        auto getDictionary = [](const PDFObject& object) -> const PDFDictionary*
+        {
+            return object.isDictionary() ? object.getDictionary() : nullptr;
+        };
+
+        PDFObject trailerObject = dereference(trailer);
+        const PDFDictionary* trailerDictionary = getDictionary(trailerObject);
+        PDFObject catalogObject = trailerDictionary ? dereference(trailerDictionary->get("Root")) : PDFObject();
+        const PDFDictionary* catalogDictionary = getDictionary(catalogObject);
+        PDFObject fdfObject = catalogDictionary ? dereference(catalogDictionary->get("FDF")) : PDFObject();
+        const PDFDictionary* fdfDictionary = getDictionary(fdfObject);
+
+        if (!fdfDictionary)
+        {
+            return PDFTranslationContext::tr("FDF dictionary was not found.");
+        }
+
+        PDFFormFillerRecord record;
+        std::set<PDFObjectReference> visitedFields;
+        std::function<void(const PDFObject&, const QString&)> readFields = [&](const PDFObject& fieldsObject, const QString& parentName)
+        {
+            PDFObject fieldsArrayObject = dereference(fieldsObject);
+            if (!fieldsArrayObject.isArray())
+            {
+                return;
+            }
+
+            const PDFArray* fieldsArray = fieldsArrayObject.getArray();
+            for (size_t i = 0; i < fieldsArray->getCount(); ++i)
+            {
+                const PDFObject& fieldReference = fieldsArray->getItem(i);
+                if (fieldReference.isReference() && !visitedFields.insert(fieldReference.getReference()).second)
+                {
+                    // Cyclic reference
+                    continue;
+                }
+
+                PDFObject fieldObject = dereference(fieldReference);
+                const PDFDictionary* fieldDictionary = getDictionary(fieldObject);
+                if (!fieldDictionary)
+                {
+                    continue;
+                }
+
+                PDFObject partialNameObject = dereference(fieldDictionary->get("T"));
+                QString partialName = partialNameObject.isString() ? PDFEncoding::convertTextString(partialNameObject.getString()) : QString();
+                QString name = parentName.isEmpty() ? partialName : (partialName.isEmpty() ? parentName : QString("%1.%2").arg(parentName, partialName));
+
+                PDFObject value = dereference(fieldDictionary->get("V"));
+                if (value.isArray() && value.getArray()->getCount() > 0)
+                {
+                    // Multiple selection of list box isn't supported, first value is used
+                    value = dereference(value.getArray()->getItem(0));
+                }
+
+                if (value.isString())
+                {
+                    record[name] = PDFEncoding::convertTextString(value.getString());
+                }
+                else if (value.isName())
+                {
+                    record[name] = QString::fromLatin1(value.getString());
+                }
+
+                readFields(fieldDictionary->get("Kids"), name);
+            }
+        };
+        readFields(fdfDictionary->get("Fields"), QString());
+
+        records.push_back(qMove(record));
+    }
+    catch (const PDFException& exception)
+    {
+        return PDFTranslationContext::tr("Invalid FDF data. %1").arg(exception.getMessage());
+    }
+
+    return true;
+}
+
+}   // namespace pdf
@@ -0,0 +1,103 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFFORMFILLER_H
+#define PDFFORMFILLER_H
+
+#include "pdfdocument.h"
+#include "pdfutils.h"
+
+#include <map>
+#include <vector>
+#include <functional>
+
+namespace pdf
+{
+
+/// Data record used to fill the form. Maps fully qualified names
+/// of form fields to their values.
+using PDFFormFillerRecord = std::map<QString, QString>;
+using PDFFormFillerRecords = std::vector<PDFFormFillerRecord>;
+
+/// Fills AcroForm of the template document with values of data records (mail-merge).
+/// Template document is loaded (and its form is parsed) only once. For each record,
+/// object storage of the template is copied (which is cheap, as unmodified objects
+/// are shared), values are set to the form fields and only appearance streams of
+/// widgets of the changed form fields are regenerated. So, if template was read with
+/// object source kept, unchanged objects are written using their original data.
+///
+/// Values of text fields and combo boxes are set as text. Value of the check box
+/// or radio button is name of its 'On' appearance state, or export value. Values 'Off',
+/// 'false', '0', 'no' and empty value unchecks the button, values 'true', '1', 'yes'
+/// and 'on' checks the check box. Value of the list box is one of its options.
+/// Class is thread safe, template document must not be modified during the lifetime
+/// of the filler.
+class PDF4QTLIBCORESHARED_EXPORT PDFFormFiller
+{
+public:
+    explicit PDFFormFiller(const PDFDocument* document);
+
+    /// Returns file name of the filled document of the record with given index
+    using FileNameGetter = std::function<QString(size_t)>;
+
+    /// Fills the form with values of the record and returns filled document.
+    /// Form of the template is parsed in each call, so use \p fillAndWrite
+    /// for many records. If error occurs, exception is thrown.
+    /// \param record Record
+    PDFDocument fill(const PDFFormFillerRecord& record) const;
+
+    /// Fills the form with values of each record and writes filled documents
+    /// to the files. Records are processed in parallel, each worker parses
+    /// form of the template only once. Returns results of the records.
+    /// \param records Records
+    /// \param getFileName Returns file name of the filled document of the record
+    std::vector<PDFOperationResult> fillAndWrite(const PDFFormFillerRecords& records, const FileNameGetter& getFileName) const;
+
+    /// Reads records from the file. Format is determined by the extension
+    /// of the file (csv, json or fdf).
+    /// \param fileName File name
+    /// \param[out] records Records (read records are appended)
+    static PDFOperationResult readRecords(const QString& fileName, PDFFormFillerRecords& records);
+
+    /// Reads records from the CSV data (comma separated values, UTF-8 encoded).
+    /// First row contains names of the form fields, each following row is a record.
+    /// Values can be quoted, quotes are escaped by doubling them.
+    /// \param data CSV data
+    /// \param[out] records Records (read records are appended)
+    static PDFOperationResult readCsv(const QByteArray& data, PDFFormFillerRecords& records);
+
+    /// Reads records from the JSON data. Data must be an array of objects,
+    /// or single object, each object is a record. Keys of the object are names
+    /// of the form fields, values are strings, numbers or booleans.
+    /// \param data JSON data
+    /// \param[out] records Records (read records are appended)
+    static PDFOperationResult readJson(const QByteArray& data, PDFFormFillerRecords& records);
+
+    /// Reads record from the FDF data (forms data format). FDF contains
+    /// single record, values of fields of the FDF are read recursively.
+    /// \param data FDF data
+    /// \param[out] records Records (read record is appended)
+    static PDFOperationResult readFdf(const QByteArray& data, PDFFormFillerRecords& records);
+
+private:
+    const PDFDocument* m_document;
+};
+
+}   // namespace pdf
+
+#endif // PDFFORMFILLER_H
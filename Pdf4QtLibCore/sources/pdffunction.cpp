@@ -27,6 +27,7 @@
 
 #include "pdfdbgheap.h"
 
+#include <array>
 #include <stack>
 #include <iterator>
 #include <type_traits>
@@ -43,6 +44,20 @@ PDFFunction::PDFFunction(uint32_t m, uint32_t n, std::vector<PDFReal>&& domain,
 
 }
 
+PDFFunction::FunctionResult PDFFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    for (size_t i = 0; i < count; ++i, x += m_m, y += m_n)
+    {
+        FunctionResult result = apply(x, x + m_m, y, y + m_n);
+        if (!result)
+        {
+            return result;
+        }
+    }
+
+    return true;
+}
+
 PDFFunctionPtr PDFFunction::createFunction(const PDFDocument* document, const PDFObject& object)
 {
     PDFParsingContext context(nullptr);
@@ -498,6 +513,52 @@ PDFFunction::FunctionResult PDFSampledFunction::apply(const_iterator x_1,
     return true;
 }
 
+PDFFunction::FunctionResult PDFSampledFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    if (m_m != 1)
+    {
+        // Multilinear interpolation in more dimensions is performed point by point
+        return PDFFunction::applyBatch(x, y, count);
+    }
+
+    // Function of single input variable (for example, tint transform of separation
+    // color space), it is linear interpolation between two neighbouring samples.
+    const uint32_t size = m_size[0];
+    const uint32_t secondNodeOffset = m_hypercubeNodeOffsets[1];
+    const size_t sampleCount = m_samples.size();
+    const PDFReal* samples = m_samples.data();
+
+    for (size_t i = 0; i < count; ++i, y += m_n)
+    {
+        const PDFReal xClamped = clampInput(0, x[i]);
+        const PDFReal xEncoded = interpolate(xClamped, m_domain[0], m_domain[1], m_encoder[0], m_encoder[1]);
+        const PDFReal xClampedToSamples = qBound<PDFReal>(0, xEncoded, size);
+
+        uint32_t xRounded = static_cast<uint32_t>(xClampedToSamples);
+        if (xRounded == size && size > 1)
+        {
+            // We want one value before the end (so we can interpolate)
+            xRounded = size - 2;
+        }
+
+        const PDFReal x1 = xClampedToSamples - static_cast<PDFReal>(xRounded);
+        const PDFReal x0 = 1.0 - x1;
+        const size_t offset0 = xRounded * m_n;
+        const size_t offset1 = offset0 + secondNodeOffset;
+
+        for (uint32_t outputIndex = 0; outputIndex < m_n; ++outputIndex)
+        {
+            const PDFReal sample0 = (offset0 + outputIndex < sampleCount) ? samples[offset0 + outputIndex] : 0.0;
+            const PDFReal sample1 = (offset1 + outputIndex < sampleCount) ? samples[offset1 + outputIndex] : 0.0;
+            const PDFReal outputValue = x0 * sample0 + x1 * sample1;
+            const PDFReal outputValueDecoded = interpolate(outputValue, 0.0, m_sampleMaximalValue, m_decoder[2 * outputIndex], m_decoder[2 * outputIndex + 1]);
+            y[outputIndex] = clampOutput(outputIndex, outputValueDecoded);
+        }
+    }
+
+    return true;
+}
+
 PDFExponentialFunction::PDFExponentialFunction(uint32_t m, uint32_t n,
                                                std::vector<PDFReal>&& domain,
                                                std::vector<PDFReal>&& range,
@@ -566,6 +627,46 @@ PDFFunction::FunctionResult PDFExponentialFunction::apply(PDFFunction::const_ite
     return true;
 }
 
+PDFFunction::FunctionResult PDFExponentialFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    const PDFReal* c0 = m_c0.data();
+    const PDFReal* c1 = m_c1.data();
+    const bool isClamped = hasRange();
+
+    for (size_t i = 0; i < count; ++i, y += m_n)
+    {
+        const PDFReal xClamped = clampInput(0, x[i]);
+
+        if (!m_isLinear)
+        {
+            // Perform exponential interpolation, power is same for all outputs
+            const PDFReal xPower = std::pow(xClamped, m_exponent);
+            for (uint32_t index = 0; index < m_n; ++index)
+            {
+                y[index] = c0[index] + xPower * (c1[index] - c0[index]);
+            }
+        }
+        else
+        {
+            // Perform linear interpolation
+            for (uint32_t index = 0; index < m_n; ++index)
+            {
+                y[index] = mix(xClamped, c0[index], c1[index]);
+            }
+        }
+
+        if (isClamped)
+        {
+            for (uint32_t index = 0; index < m_n; ++index)
+            {
+                y[index] = clampOutput(index, y[index]);
+            }
+        }
+    }
+
+    return true;
+}
+
 PDFStitchingFunction::PDFStitchingFunction(uint32_t m, uint32_t n,
                                            std::vector<PDFReal>&& domain,
                                            std::vector<PDFReal>&& range,
@@ -600,15 +701,7 @@ PDFFunction::FunctionResult PDFStitchingFunction::apply(const_iterator x_1,
 
     Q_ASSERT(m == 1);
     const PDFReal x = clampInput(0, *x_1);
-
-    // First search for partial function, which defines our range. Use algorithm
-    // similar to the std::lower_bound.
-    auto it = std::lower_bound(m_partialFunctions.cbegin(), m_partialFunctions.cend(), x, [](const auto& partialFunction, PDFReal value) { return partialFunction.bound1 < value; });
-    if (it == m_partialFunctions.cend())
-    {
-        --it;
-    }
-    const PartialFunction& function = *it;
+    const PartialFunction& function = getPartialFunction(x);
 
     // Encode the value into the input range of the function
     const PDFReal xEncoded = interpolate(x, function.bound0, function.bound1, function.encode0, function.encode1);
@@ -626,6 +719,69 @@ PDFFunction::FunctionResult PDFStitchingFunction::apply(const_iterator x_1,
     return result;
 }
 
+PDFFunction::FunctionResult PDFStitchingFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    std::vector<PDFReal> encoded(count, 0.0);
+
+    size_t i = 0;
+    while (i < count)
+    {
+        // Find run of points, which are evaluated by the same partial
+        // function, and evaluate them by single call.
+        const PartialFunction& function = getPartialFunction(clampInput(0, x[i]));
+        if (function.function->getInputVariableCount() != 1)
+        {
+            // Invalid partial function, error is reported by the apply function
+            return PDFFunction::applyBatch(x, y, count);
+        }
+
+        size_t runEnd = i;
+        for (; runEnd < count; ++runEnd)
+        {
+            const PDFReal xClamped = clampInput(0, x[runEnd]);
+            if (&getPartialFunction(xClamped) != &function)
+            {
+                break;
+            }
+
+            encoded[runEnd] = interpolate(xClamped, function.bound0, function.bound1, function.encode0, function.encode1);
+        }
+
+        FunctionResult result = function.function->applyBatch(encoded.data() + i, y + i * m_n, runEnd - i);
+        if (!result)
+        {
+            return result;
+        }
+
+        i = runEnd;
+    }
+
+    if (hasRange())
+    {
+        for (size_t point = 0; point < count; ++point, y += m_n)
+        {
+            for (uint32_t index = 0; index < m_n; ++index)
+            {
+                y[index] = clampOutput(index, y[index]);
+            }
+        }
+    }
+
+    return true;
+}
+
+const PDFStitchingFunction::PartialFunction& PDFStitchingFunction::getPartialFunction(PDFReal x) const
+{
+    // Search for partial function, which defines our range. Use algorithm
+    // similar to the std::lower_bound.
+    auto it = std::lower_bound(m_partialFunctions.cbegin(), m_partialFunctions.cend(), x, [](const auto& partialFunction, PDFReal value) { return partialFunction.bound1 < value; });
+    if (it == m_partialFunctions.cend())
+    {
+        --it;
+    }
+    return *it;
+}
+
 PDFIdentityFunction::PDFIdentityFunction() :
     PDFFunction(0, 0, std::vector<PDFReal>(), std::vector<PDFReal>())
 {
@@ -1580,153 +1736,1440 @@ void PDFPostScriptFunctionStack::checkUnderflow(size_t n) const
     }
 }
 
-PDFPostScriptFunction::Code PDFPostScriptFunction::getCode(const QByteArray& byteArray)
+/// Register based bytecode of the postscript program. Stack of the postscript
+/// program is resolved at compile time, each stack value is assigned to the
+/// register, so stack operators (exch, dup, index, roll ...) doesn't generate
+/// any code. Types of the values are also determined at compile time, so
+/// instructions are specialized for the operand types. Registers are initialized
+/// with input values and constants, expressions with constant operands are
+/// evaluated at compile time.
+class PDFPostScriptFunctionBytecode
 {
-    static constexpr const std::pair<Code, const  char*> codes[] =
-    {
-        // B.1 Arithmetic operators
-        std::pair<Code, const  char*>{ Code::Add, "add" },
-        std::pair<Code, const  char*>{ Code::Sub, "sub" },
-        std::pair<Code, const  char*>{ Code::Mul, "mul" },
-        std::pair<Code, const  char*>{ Code::Div, "div" },
-        std::pair<Code, const  char*>{ Code::Idiv, "idiv" },
-        std::pair<Code, const  char*>{ Code::Mod, "mod" },
-        std::pair<Code, const  char*>{ Code::Neg, "neg" },
-        std::pair<Code, const  char*>{ Code::Abs, "abs" },
-        std::pair<Code, const  char*>{ Code::Ceiling, "ceiling" },
-        std::pair<Code, const  char*>{ Code::Floor, "floor" },
-        std::pair<Code, const  char*>{ Code::Round, "round" },
-        std::pair<Code, const  char*>{ Code::Truncate, "truncate" },
-        std::pair<Code, const  char*>{ Code::Sqrt, "sqrt" },
-        std::pair<Code, const  char*>{ Code::Sin, "sin" },
-        std::pair<Code, const  char*>{ Code::Cos, "cos" },
-        std::pair<Code, const  char*>{ Code::Atan, "atan" },
-        std::pair<Code, const  char*>{ Code::Exp, "exp" },
-        std::pair<Code, const  char*>{ Code::Ln, "ln" },
-        std::pair<Code, const  char*>{ Code::Log, "log" },
-        std::pair<Code, const  char*>{ Code::Cvi, "cvi" },
-        std::pair<Code, const  char*>{ Code::Cvr, "cvr" },
+public:
+    using Program = PDFPostScriptFunction::Program;
+    using CodeObject = PDFPostScriptFunction::CodeObject;
+    using InstructionPointer = PDFPostScriptFunction::InstructionPointer;
+    using PDFIntegerUnsigned = std::make_unsigned<PDFInteger>::type;
 
-        // B.2 Relational, Boolean and Bitwise operators
-        std::pair<Code, const  char*>{ Code::Eq, "eq" },
-        std::pair<Code, const  char*>{ Code::Ne, "ne" },
-        std::pair<Code, const  char*>{ Code::Gt, "gt" },
-        std::pair<Code, const  char*>{ Code::Ge, "ge" },
-        std::pair<Code, const  char*>{ Code::Lt, "lt" },
-        std::pair<Code, const  char*>{ Code::Le, "le" },
-        std::pair<Code, const  char*>{ Code::And, "and" },
-        std::pair<Code, const  char*>{ Code::Or, "or" },
-        std::pair<Code, const  char*>{ Code::Xor, "xor" },
-        std::pair<Code, const  char*>{ Code::Not, "not" },
-        std::pair<Code, const  char*>{ Code::Bitshift, "bitshift" },
-        std::pair<Code, const  char*>{ Code::True, "true" },
-        std::pair<Code, const  char*>{ Code::False, "false" },
+    /// Register of the bytecode. Boolean values are stored as integers 0 or 1.
+    union Register
+    {
+        PDFReal real;
+        PDFInteger integer;
+    };
 
-        // B.3 Conditional operators
-        std::pair<Code, const  char*>{ Code::If, "if" },
-        std::pair<Code, const  char*>{ Code::IfElse, "ifelse" },
+    enum class Operation : uint32_t
+    {
+        Move,
+        IntegerToReal,
+        AddInteger,
+        AddReal,
+        SubInteger,
+        SubReal,
+        MulInteger,
+        MulReal,
+        Div,
+        Idiv,
+        Mod,
+        NegInteger,
+        NegReal,
+        AbsInteger,
+        AbsReal,
+        Ceiling,
+        Floor,
+        Round,
+        Truncate,
+        Sqrt,
+        Sin,
+        Cos,
+        Atan,
+        Exp,
+        Ln,
+        Log,
+        Cvi,
+        EqInteger,
+        EqReal,
+        NeInteger,
+        NeReal,
+        GtInteger,
+        GtReal,
+        GeInteger,
+        GeReal,
+        LtInteger,
+        LtReal,
+        LeInteger,
+        LeReal,
+        And,
+        Or,
+        Xor,
+        NotInteger,
+        NotBoolean,
+        Bitshift,
+        Jump,           ///< Jumps to the instruction given by result
+        JumpIfFalse     ///< Jumps to the instruction given by result, if register a is false
+    };
 
-        // B.4 Stack operators
-        std::pair<Code, const  char*>{ Code::Pop, "pop" },
-        std::pair<Code, const  char*>{ Code::Exch, "exch" },
-        std::pair<Code, const  char*>{ Code::Dup, "dup" },
-        std::pair<Code, const  char*>{ Code::Copy, "copy" },
-        std::pair<Code, const  char*>{ Code::Index, "index" },
-        std::pair<Code, const  char*>{ Code::Roll, "roll" }
+    struct Instruction
+    {
+        Operation operation = Operation::Move;
+        uint32_t result = 0;
+        uint32_t a = 0;
+        uint32_t b = 0;
     };
 
-    for (const std::pair<Code, const  char*>& codeItem : codes)
+    struct Output
     {
-        if (byteArray == codeItem.second)
-        {
-            return codeItem.first;
-        }
-    }
+        uint32_t reg = 0;
+        bool isInteger = false;
+    };
 
-    throw PDFException(PDFTranslationContext::tr("Invalid operator (PostScript function) '%1'.").arg(QString::fromLatin1(byteArray)));
-}
+    /// Compiles the program to the bytecode. If program can't be compiled,
+    /// then nullptr is returned and program must be interpreted.
+    /// \param program Program
+    /// \param m Number of input variables
+    /// \param n Number of output variables
+    static std::unique_ptr<const PDFPostScriptFunctionBytecode> compile(const Program& program, uint32_t m, uint32_t n);
 
-PDFPostScriptFunction::PDFPostScriptFunction(uint32_t m, uint32_t n, std::vector<PDFReal>&& domain, std::vector<PDFReal>&& range, PDFPostScriptFunction::Program&& program) :
-    PDFFunction(m, n, std::move(domain), std::move(range)),
-    m_program(std::move(program))
-{
-    Q_ASSERT(!m_program.empty());
-}
+    /// Executes the bytecode. Registers must be initialized by initial
+    /// registers and input values. Can throw PDFPostScriptFunctionException.
+    /// \param registers Registers
+    void execute(Register* registers) const;
 
-PDFPostScriptFunction::~PDFPostScriptFunction()
-{
+    /// Executes single instruction (which is not a jump)
+    static inline void executeInstruction(const Instruction& instruction, Register* registers);
 
-}
+    const std::vector<Register>& getInitialRegisters() const { return m_registers; }
+    const std::vector<Output>& getOutputs() const { return m_outputs; }
 
-PDFPostScriptFunction::Program PDFPostScriptFunction::parseProgram(const QByteArray& byteArray)
-{
-    // Lexical analyzer can't handle when '{' or '}' is near next token (for example '{0' etc.)
-    QByteArray adjustedArray = byteArray;
-    adjustedArray.replace('{', " { ").replace('}', " } ");
+private:
+    friend class PDFPostScriptFunctionCompiler;
 
-    Program result;
-    PDFLexicalAnalyzer parser(adjustedArray.constBegin(), adjustedArray.constEnd());
-    parser.setTokenizingPostScriptFunction();
+    std::vector<Instruction> m_instructions;
+    std::vector<Register> m_registers;
+    std::vector<Output> m_outputs;
+};
 
-    std::stack<InstructionPointer> blockCallStack;
-    while (true)
+void PDFPostScriptFunctionBytecode::executeInstruction(const Instruction& instruction, Register* registers)
+{
+    Register& result = registers[instruction.result];
+    const Register a = registers[instruction.a];
+    const Register b = registers[instruction.b];
+
+    switch (instruction.operation)
     {
-        PDFLexicalAnalyzer::Token token = parser.fetch();
-        if (token.type == PDFLexicalAnalyzer::TokenType::EndOfFile)
-        {
-            // We are at end, stop the parsing
+        case Operation::Move:
+            result = a;
             break;
-        }
 
-        switch (token.type)
+        case Operation::IntegerToReal:
+            result.real = a.integer;
+            break;
+
+        case Operation::AddInteger:
+            result.integer = a.integer + b.integer;
+            break;
+
+        case Operation::AddReal:
+            result.real = a.real + b.real;
+            break;
+
+        case Operation::SubInteger:
+            result.integer = a.integer - b.integer;
+            break;
+
+        case Operation::SubReal:
+            result.real = a.real - b.real;
+            break;
+
+        case Operation::MulInteger:
+            result.integer = a.integer * b.integer;
+            break;
+
+        case Operation::MulReal:
+            result.real = a.real * b.real;
+            break;
+
+        case Operation::Div:
         {
-            case PDFLexicalAnalyzer::TokenType::Boolean:
+            if (qFuzzyIsNull(b.real))
             {
-                result.emplace_back(OperandObject::createBoolean(token.data.toBool()), result.size() + 1);
-                break;
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
             }
 
-            case PDFLexicalAnalyzer::TokenType::Integer:
+            result.real = a.real / b.real;
+            break;
+        }
+
+        case Operation::Idiv:
+        {
+            if (b.integer == 0)
             {
-                result.emplace_back(OperandObject::createInteger(token.data.toLongLong()), result.size() + 1);
-                break;
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
             }
 
-            case PDFLexicalAnalyzer::TokenType::Real:
+            result.integer = a.integer / b.integer;
+            break;
+        }
+
+        case Operation::Mod:
+        {
+            if (b.integer == 0)
             {
-                result.emplace_back(OperandObject::createReal(token.data.toDouble()), result.size() + 1);
-                break;
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Division by zero (PostScript engine)."));
             }
 
-            case PDFLexicalAnalyzer::TokenType::Command:
-            {
-                QByteArray command = token.data.toByteArray();
-                if (command == "{")
-                {
-                    // Opening bracket - means start of block
-                    blockCallStack.push(result.size());
-                    result.emplace_back(Code::Call, INVALID_INSTRUCTION_POINTER);
-                    result.back().operand = OperandObject::createInstructionPointer(result.size());
-                }
-                else if (command == "}")
-                {
-                    // Closing bracket - means end of block
-                    if (blockCallStack.empty())
-                    {
-                        throw PDFException(PDFTranslationContext::tr("Invalid program - bad enclosing brackets (PostScript function)."));
-                    }
+            result.integer = a.integer % b.integer;
+            break;
+        }
 
-                    result[blockCallStack.top()].next = result.size() + 1;
-                    blockCallStack.pop();
-                    result.emplace_back(Code::Return, INVALID_INSTRUCTION_POINTER);
-                }
-                else
-                {
-                    result.emplace_back(getCode(command), result.size() + 1);
-                }
+        case Operation::NegInteger:
+            result.integer = -a.integer;
+            break;
 
-                break;
-            }
+        case Operation::NegReal:
+            result.real = -a.real;
+            break;
+
+        case Operation::AbsInteger:
+            result.integer = qAbs(a.integer);
+            break;
+
+        case Operation::AbsReal:
+            result.real = qAbs(a.real);
+            break;
+
+        case Operation::Ceiling:
+            result.real = std::ceil(a.real);
+            break;
+
+        case Operation::Floor:
+            result.real = std::floor(a.real);
+            break;
+
+        case Operation::Round:
+            result.real = qRound(a.real);
+            break;
+
+        case Operation::Truncate:
+            result.real = std::trunc(a.real);
+            break;
+
+        case Operation::Sqrt:
+        {
+            if (a.real < 0.0)
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Square root of negative value can't be computed (PostScript engine)."));
+            }
+
+            result.real = std::sqrt(a.real);
+            break;
+        }
+
+        case Operation::Sin:
+            result.real = qSin(qDegreesToRadians(a.real));
+            break;
+
+        case Operation::Cos:
+            result.real = qCos(qDegreesToRadians(a.real));
+            break;
+
+        case Operation::Atan:
+        {
+            const PDFReal angles = qRadiansToDegrees(qAtan2(a.real, b.real));
+            result.real = angles < 0.0 ? (angles + 360.0) : angles;
+            break;
+        }
+
+        case Operation::Exp:
+            result.real = qPow(a.real, b.real);
+            break;
+
+        case Operation::Ln:
+        {
+            if (a.real < 0.0 || qFuzzyIsNull(a.real))
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Logarithm's input should be positive value  (PostScript engine)."));
+            }
+
+            result.real = qLn(a.real);
+            break;
+        }
+
+        case Operation::Log:
+        {
+            if (a.real < 0.0 || qFuzzyIsNull(a.real))
+            {
+                throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Logarithm's input should be positive value (PostScript engine)."));
+            }
+
+            result.real = std::log10(a.real);
+            break;
+        }
+
+        case Operation::Cvi:
+            result.integer = static_cast<PDFInteger>(a.real);
+            break;
+
+        case Operation::EqInteger:
+            result.integer = a.integer == b.integer;
+            break;
+
+        case Operation::EqReal:
+            result.integer = a.real == b.real;
+            break;
+
+        case Operation::NeInteger:
+            result.integer = a.integer != b.integer;
+            break;
+
+        case Operation::NeReal:
+            result.integer = a.real != b.real;
+            break;
+
+        case Operation::GtInteger:
+            result.integer = a.integer > b.integer;
+            break;
+
+        case Operation::GtReal:
+            result.integer = a.real > b.real;
+            break;
+
+        case Operation::GeInteger:
+            result.integer = a.integer >= b.integer;
+            break;
+
+        case Operation::GeReal:
+            result.integer = a.real >= b.real;
+            break;
+
+        case Operation::LtInteger:
+            result.integer = a.integer < b.integer;
+            break;
+
+        case Operation::LtReal:
+            result.integer = a.real < b.real;
+            break;
+
+        case Operation::LeInteger:
+            result.integer = a.integer <= b.integer;
+            break;
+
+        case Operation::LeReal:
+            result.integer = a.real <= b.real;
+            break;
+
+        // Boolean values are 0 or 1, so bitwise operations give correct boolean results
+        case Operation::And:
+            result.integer = static_cast<PDFIntegerUnsigned>(a.integer) & static_cast<PDFIntegerUnsigned>(b.integer);
+            break;
+
+        case Operation::Or:
+            result.integer = static_cast<PDFIntegerUnsigned>(a.integer) | static_cast<PDFIntegerUnsigned>(b.integer);
+            break;
+
+        case Operation::Xor:
+            result.integer = static_cast<PDFIntegerUnsigned>(a.integer) ^ static_cast<PDFIntegerUnsigned>(b.integer);
+            break;
+
+        case Operation::NotInteger:
+            result.integer = ~static_cast<PDFIntegerUnsigned>(a.integer);
+            break;
+
+        case Operation::NotBoolean:
+            result.integer = a.integer ? 0 : 1;
+            break;
+
+        case Operation::Bitshift:
+        {
+            const PDFInteger shift = b.integer;
+            const PDFIntegerUnsigned value = static_cast<PDFIntegerUnsigned>(a.integer);
+            PDFIntegerUnsigned shiftedValue = value;
+
+            if (shift > 0)
+            {
+                // Positive is left
+                shiftedValue = value << shift;
+            }
+            else if (shift < 0)
+            {
+                // Negative is right
+                shiftedValue = value >> -shift;
+            }
+
+            result.integer = shiftedValue;
+            break;
+        }
+
+        case Operation::Jump:
+        case Operation::JumpIfFalse:
+            Q_ASSERT(false);
+            break;
+    }
+}
+
+void PDFPostScriptFunctionBytecode::execute(Register* registers) const
+{
+    const Instruction* instructions = m_instructions.data();
+    const size_t instructionCount = m_instructions.size();
+
+    size_t ip = 0;
+    while (ip < instructionCount)
+    {
+        const Instruction& instruction = instructions[ip++];
+        switch (instruction.operation)
+        {
+            case Operation::Jump:
+                ip = instruction.result;
+                break;
+
+            case Operation::JumpIfFalse:
+            {
+                if (!registers[instruction.a].integer)
+                {
+                    ip = instruction.result;
+                }
+                break;
+            }
+
+            default:
+                executeInstruction(instruction, registers);
+                break;
+        }
+    }
+}
+
+/// Compiles the postscript program to the bytecode. Program is executed
+/// symbolically on the stack of values (registers), so maximal stack depth
+/// and types of the values are determined. If it fails (stack depth or
+/// types depend on input values, or program is invalid), then program
+/// can't be compiled.
+class PDFPostScriptFunctionCompiler
+{
+public:
+    using Bytecode = PDFPostScriptFunctionBytecode;
+    using Operation = Bytecode::Operation;
+    using Instruction = Bytecode::Instruction;
+    using Register = Bytecode::Register;
+    using Program = PDFPostScriptFunction::Program;
+    using CodeObject = PDFPostScriptFunction::CodeObject;
+    using InstructionPointer = PDFPostScriptFunction::InstructionPointer;
+    using Code = PDFPostScriptFunction::Code;
+
+    explicit inline PDFPostScriptFunctionCompiler(const Program& program, Bytecode* bytecode) :
+        m_program(program),
+        m_bytecode(bytecode)
+    {
+
+    }
+
+    /// Compiles the program. Throws PDFPostScriptFunctionException, if program can't be compiled.
+    /// \param m Number of input variables
+    /// \param n Number of output variables
+    void compile(uint32_t m, uint32_t n);
+
+private:
+    enum class ValueType
+    {
+        Real,
+        Integer,
+        Boolean,
+        Block
+    };
+
+    struct Value
+    {
+        ValueType type = ValueType::Real;
+        bool isConstant = false;
+        uint32_t reg = 0;
+        InstructionPointer block = PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER;
+
+        bool operator==(const Value& other) const
+        {
+            return type == other.type && (type == ValueType::Block ? block == other.block : reg == other.reg);
+        }
+    };
+
+    using Stack = std::vector<Value>;
+
+    /// Maximal number of registers and instructions
+    static constexpr size_t MAX_SIZE = 65536;
+
+    /// Maximal nesting of executed blocks
+    static constexpr size_t MAX_BLOCK_DEPTH = 64;
+
+    /// Maximal stack size (according to the PDF 1.7 specification)
+    static constexpr size_t MAX_STACK_SIZE = 100;
+
+    [[noreturn]] static void fail() { throw PDFPostScriptFunction::PDFPostScriptFunctionException(PDFTranslationContext::tr("Program can't be compiled (PostScript engine).")); }
+
+    /// Compiles the block of the program starting at given instruction pointer
+    /// \param ip Instruction pointer of the block
+    /// \param stack Stack of values
+    /// \param depth Nesting depth of the block (zero is the main program)
+    void compileBlock(InstructionPointer ip, Stack& stack, size_t depth);
+
+    /// Compiles the condition. Both branches are compiled and stacks
+    /// of the branches are merged, so they use the same registers.
+    /// \param stack Stack of values
+    /// \param condition Condition value
+    /// \param trueBlock Block executed, if condition is true
+    /// \param falseBlock Block executed, if condition is false (can be invalid instruction pointer)
+    /// \param depth Nesting depth of the condition
+    void compileCondition(Stack& stack, const Value& condition, InstructionPointer trueBlock, InstructionPointer falseBlock, size_t depth);
+
+    uint32_t allocateRegister(Register value);
+    Value createConstant(ValueType type, Register value);
+    void addInstruction(const Instruction& instruction);
+    Value emit(Operation operation, ValueType type, const Value& a);
+    Value emit(Operation operation, ValueType type, const Value& a, const Value& b);
+
+    void push(Stack& stack, const Value& value);
+    Value pop(Stack& stack);
+    Value pop(Stack& stack, ValueType type);
+    Value popNumber(Stack& stack);
+    PDFInteger popConstantInteger(Stack& stack);
+    static bool isBinaryOperationType(const Stack& stack, ValueType type);
+    static bool isTopType(const Stack& stack, ValueType type);
+
+    const Program& m_program;
+    Bytecode* m_bytecode;
+};
+
+void PDFPostScriptFunctionCompiler::compile(uint32_t m, uint32_t n)
+{
+    Stack stack;
+
+    // Input values are in the first registers
+    for (uint32_t i = 0; i < m; ++i)
+    {
+        Value value;
+        value.type = ValueType::Real;
+        value.reg = allocateRegister(Register());
+        push(stack, value);
+    }
+
+    compileBlock(0, stack, 0);
+
+    if (stack.size() != n)
+    {
+        fail();
+    }
+
+    for (const Value& value : stack)
+    {
+        if (value.type != ValueType::Real && value.type != ValueType::Integer)
+        {
+            fail();
+        }
+
+        Bytecode::Output output;
+        output.reg = value.reg;
+        output.isInteger = value.type == ValueType::Integer;
+        m_bytecode->m_outputs.push_back(output);
+    }
+
+    m_bytecode->m_instructions.shrink_to_fit();
+    m_bytecode->m_registers.shrink_to_fit();
+}
+
+void PDFPostScriptFunctionCompiler::compileBlock(InstructionPointer ip, Stack& stack, size_t depth)
+{
+    if (depth > MAX_BLOCK_DEPTH)
+    {
+        fail();
+    }
+
+    while (ip != PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER)
+    {
+        if (ip >= m_program.size())
+        {
+            fail();
+        }
+
+        const CodeObject& instruction = m_program[ip];
+        switch (instruction.code)
+        {
+            case Code::Add:
+            case Code::Sub:
+            case Code::Mul:
+            {
+                Operation integerOperation = Operation::AddInteger;
+                Operation realOperation = Operation::AddReal;
+
+                if (instruction.code == Code::Sub)
+                {
+                    integerOperation = Operation::SubInteger;
+                    realOperation = Operation::SubReal;
+                }
+                else if (instruction.code == Code::Mul)
+                {
+                    integerOperation = Operation::MulInteger;
+                    realOperation = Operation::MulReal;
+                }
+
+                if (isBinaryOperationType(stack, ValueType::Integer))
+                {
+                    const Value b = pop(stack);
+                    const Value a = pop(stack);
+                    push(stack, emit(integerOperation, ValueType::Integer, a, b));
+                }
+                else
+                {
+                    const Value b = popNumber(stack);
+                    const Value a = popNumber(stack);
+                    push(stack, emit(realOperation, ValueType::Real, a, b));
+                }
+                break;
+            }
+
+            case Code::Div:
+            case Code::Atan:
+            case Code::Exp:
+            {
+                Operation operation = Operation::Div;
+
+                if (instruction.code == Code::Atan)
+                {
+                    operation = Operation::Atan;
+                }
+                else if (instruction.code == Code::Exp)
+                {
+                    operation = Operation::Exp;
+                }
+
+                const Value b = popNumber(stack);
+                const Value a = popNumber(stack);
+                push(stack, emit(operation, ValueType::Real, a, b));
+                break;
+            }
+
+            case Code::Idiv:
+            case Code::Mod:
+            case Code::Bitshift:
+            {
+                Operation operation = Operation::Idiv;
+
+                if (instruction.code == Code::Mod)
+                {
+                    operation = Operation::Mod;
+                }
+                else if (instruction.code == Code::Bitshift)
+                {
+                    operation = Operation::Bitshift;
+                }
+
+                const Value b = pop(stack, ValueType::Integer);
+                const Value a = pop(stack, ValueType::Integer);
+                push(stack, emit(operation, ValueType::Integer, a, b));
+                break;
+            }
+
+            case Code::Neg:
+            case Code::Abs:
+            {
+                const bool isNeg = instruction.code == Code::Neg;
+
+                if (isTopType(stack, ValueType::Integer))
+                {
+                    push(stack, emit(isNeg ? Operation::NegInteger : Operation::AbsInteger, ValueType::Integer, pop(stack)));
+                }
+                else
+                {
+                    push(stack, emit(isNeg ? Operation::NegReal : Operation::AbsReal, ValueType::Real, pop(stack, ValueType::Real)));
+                }
+                break;
+            }
+
+            case Code::Ceiling:
+            case Code::Floor:
+            case Code::Round:
+            case Code::Truncate:
+            {
+                if (isTopType(stack, ValueType::Real))
+                {
+                    Operation operation = Operation::Ceiling;
+
+                    switch (instruction.code)
+                    {
+                        case Code::Floor:
+                            operation = Operation::Floor;
+                            break;
+
+                        case Code::Round:
+                            operation = Operation::Round;
+                            break;
+
+                        case Code::Truncate:
+                            operation = Operation::Truncate;
+                            break;
+
+                        default:
+                            break;
+                    }
+
+                    push(stack, emit(operation, ValueType::Real, pop(stack)));
+                }
+                else if (!isTopType(stack, ValueType::Integer))
+                {
+                    fail();
+                }
+                break;
+            }
+
+            case Code::Sqrt:
+            case Code::Sin:
+            case Code::Cos:
+            case Code::Ln:
+            case Code::Log:
+            {
+                Operation operation = Operation::Sqrt;
+
+                switch (instruction.code)
+                {
+                    case Code::Sin:
+                        operation = Operation::Sin;
+                        break;
+
+                    case Code::Cos:
+                        operation = Operation::Cos;
+                        break;
+
+                    case Code::Ln:
+                        operation = Operation::Ln;
+                        break;
+
+                    case Code::Log:
+                        operation = Operation::Log;
+                        break;
+
+                    default:
+                        break;
+                }
+
+                push(stack, emit(operation, ValueType::Real, popNumber(stack)));
+                break;
+            }
+
+            case Code::Cvi:
+            {
+                if (isTopType(stack, ValueType::Real))
+                {
+                    push(stack, emit(Operation::Cvi, ValueType::Integer, pop(stack)));
+                }
+                else if (!isTopType(stack, ValueType::Integer))
+                {
+                    fail();
+                }
+                break;
+            }
+
+            case Code::Cvr:
+            {
+                if (isTopType(stack, ValueType::Integer))
+                {
+                    push(stack, emit(Operation::IntegerToReal, ValueType::Real, pop(stack)));
+                }
+                else if (!isTopType(stack, ValueType::Real))
+                {
+                    fail();
+                }
+                break;
+            }
+
+            case Code::Eq:
+            case Code::Ne:
+            {
+                const bool isEq = instruction.code == Code::Eq;
+
+                if (isBinaryOperationType(stack, ValueType::Integer) || isBinaryOperationType(stack, ValueType::Boolean))
+                {
+                    const Value b = pop(stack);
+                    const Value a = pop(stack);
+                    push(stack, emit(isEq ? Operation::EqInteger : Operation::NeInteger, ValueType::Boolean, a, b));
+                }
+                else
+                {
+                    const Value b = popNumber(stack);
+                    const Value a = popNumber(stack);
+                    push(stack, emit(isEq ? Operation::EqReal : Operation::NeReal, ValueType::Boolean, a, b));
+                }
+                break;
+            }
+
+            case Code::Gt:
+            case Code::Ge:
+            case Code::Lt:
+            case Code::Le:
+            {
+                Operation integerOperation = Operation::GtInteger;
+                Operation realOperation = Operation::GtReal;
+
+                switch (instruction.code)
+                {
+                    case Code::Ge:
+                        integerOperation = Operation::GeInteger;
+                        realOperation = Operation::GeReal;
+                        break;
+
+                    case Code::Lt:
+                        integerOperation = Operation::LtInteger;
+                        realOperation = Operation::LtReal;
+                        break;
+
+                    case Code::Le:
+                        integerOperation = Operation::LeInteger;
+                        realOperation = Operation::LeReal;
+                        break;
+
+                    default:
+                        break;
+                }
+
+                if (isBinaryOperationType(stack, ValueType::Integer))
+                {
+                    const Value b = pop(stack);
+                    const Value a = pop(stack);
+                    push(stack, emit(integerOperation, ValueType::Boolean, a, b));
+                }
+                else
+                {
+                    const Value b = popNumber(stack);
+                    const Value a = popNumber(stack);
+                    push(stack, emit(realOperation, ValueType::Boolean, a, b));
+                }
+                break;
+            }
+
+            case Code::And:
+            case Code::Or:
+            case Code::Xor:
+            {
+                Operation operation = Operation::And;
+
+                if (instruction.code == Code::Or)
+                {
+                    operation = Operation::Or;
+                }
+                else if (instruction.code == Code::Xor)
+                {
+                    operation = Operation::Xor;
+                }
+
+                const ValueType type = isBinaryOperationType(stack, ValueType::Boolean) ? ValueType::Boolean : ValueType::Integer;
+                const Value b = pop(stack, type);
+                const Value a = pop(stack, type);
+                push(stack, emit(operation, type, a, b));
+                break;
+            }
+
+            case Code::Not:
+            {
+                if (isTopType(stack, ValueType::Integer))
+                {
+                    push(stack, emit(Operation::NotInteger, ValueType::Integer, pop(stack)));
+                }
+                else
+                {
+                    push(stack, emit(Operation::NotBoolean, ValueType::Boolean, pop(stack, ValueType::Boolean)));
+                }
+                break;
+            }
+
+            case Code::True:
+            case Code::False:
+            {
+                Register value;
+                value.integer = instruction.code == Code::True ? 1 : 0;
+                push(stack, createConstant(ValueType::Boolean, value));
+                break;
+            }
+
+            case Code::Execute:
+            {
+                const Value block = pop(stack, ValueType::Block);
+                compileBlock(block.block, stack, depth + 1);
+                break;
+            }
+
+            case Code::If:
+            {
+                const Value block = pop(stack, ValueType::Block);
+                const Value condition = pop(stack, ValueType::Boolean);
+                compileCondition(stack, condition, block.block, PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER, depth + 1);
+                break;
+            }
+
+            case Code::IfElse:
+            {
+                const Value falseBlock = pop(stack, ValueType::Block);
+                const Value trueBlock = pop(stack, ValueType::Block);
+                const Value condition = pop(stack, ValueType::Boolean);
+                compileCondition(stack, condition, trueBlock.block, falseBlock.block, depth + 1);
+                break;
+            }
+
+            case Code::Pop:
+            {
+                pop(stack);
+                break;
+            }
+
+            case Code::Exch:
+            {
+                const Value b = pop(stack);
+                const Value a = pop(stack);
+                push(stack, b);
+                push(stack, a);
+                break;
+            }
+
+            case Code::Dup:
+            {
+                const Value value = pop(stack);
+                push(stack, value);
+                push(stack, value);
+                break;
+            }
+
+            case Code::Copy:
+            {
+                const PDFInteger n = popConstantInteger(stack);
+
+                if (n < 0 || static_cast<size_t>(n) > stack.size())
+                {
+                    fail();
+                }
+
+                const size_t startIndex = stack.size() - n;
+                for (size_t i = 0; i < static_cast<size_t>(n); ++i)
+                {
+                    push(stack, stack[startIndex + i]);
+                }
+                break;
+            }
+
+            case Code::Index:
+            {
+                const PDFInteger n = popConstantInteger(stack);
+
+                if (n < 0 || static_cast<size_t>(n) >= stack.size())
+                {
+                    fail();
+                }
+
+                push(stack, stack[stack.size() - 1 - n]);
+                break;
+            }
+
+            case Code::Roll:
+            {
+                PDFInteger j = popConstantInteger(stack);
+                const PDFInteger n = popConstantInteger(stack);
+
+                if (n < 0)
+                {
+                    fail();
+                }
+
+                if (n == 0)
+                {
+                    break;
+                }
+
+                j = j % n;
+                if (j == 0)
+                {
+                    break;
+                }
+
+                if (static_cast<size_t>(n) > stack.size())
+                {
+                    fail();
+                }
+
+                auto first = std::next(stack.begin(), stack.size() - n);
+                if (j > 0)
+                {
+                    std::rotate(first, stack.end() - j, stack.end());
+                }
+                else
+                {
+                    std::rotate(first, first - j, stack.end());
+                }
+                break;
+            }
+
+            case Code::Call:
+            {
+                Value value;
+                value.type = ValueType::Block;
+                value.block = instruction.operand.instructionPointer;
+                push(stack, value);
+                break;
+            }
+
+            case Code::Return:
+            {
+                if (depth == 0)
+                {
+                    fail();
+                }
+
+                return;
+            }
+
+            case Code::Push:
+            {
+                Register value;
+
+                switch (instruction.operand.type)
+                {
+                    case PDFPostScriptFunction::OperandType::Real:
+                        value.real = instruction.operand.realNumber;
+                        push(stack, createConstant(ValueType::Real, value));
+                        break;
+
+                    case PDFPostScriptFunction::OperandType::Integer:
+                        value.integer = instruction.operand.integerNumber;
+                        push(stack, createConstant(ValueType::Integer, value));
+                        break;
+
+                    case PDFPostScriptFunction::OperandType::Boolean:
+                        value.integer = instruction.operand.boolean ? 1 : 0;
+                        push(stack, createConstant(ValueType::Boolean, value));
+                        break;
+
+                    case PDFPostScriptFunction::OperandType::InstructionPointer:
+                        fail();
+                }
+                break;
+            }
+        }
+
+        ip = instruction.next;
+    }
+
+    // Block must be terminated by return instruction
+    if (depth > 0)
+    {
+        fail();
+    }
+}
+
+void PDFPostScriptFunctionCompiler::compileCondition(Stack& stack, const Value& condition, InstructionPointer trueBlock, InstructionPointer falseBlock, size_t depth)
+{
+    if (condition.isConstant)
+    {
+        // Condition is known at compile time, compile only the executed block
+        const InstructionPointer block = m_bytecode->m_registers[condition.reg].integer ? trueBlock : falseBlock;
+        if (block != PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER)
+        {
+            compileBlock(block, stack, depth);
+        }
+        return;
+    }
+
+    std::vector<Instruction> instructions;
+    std::swap(instructions, m_bytecode->m_instructions);
+
+    // Compile both branches into separate instruction lists
+    Stack trueStack = stack;
+    compileBlock(trueBlock, trueStack, depth);
+    std::vector<Instruction> trueInstructions;
+    std::swap(trueInstructions, m_bytecode->m_instructions);
+
+    Stack falseStack = stack;
+    if (falseBlock != PDFPostScriptFunction::INVALID_INSTRUCTION_POINTER)
+    {
+        compileBlock(falseBlock, falseStack, depth);
+    }
+    std::vector<Instruction> falseInstructions;
+    std::swap(falseInstructions, m_bytecode->m_instructions);
+    std::swap(instructions, m_bytecode->m_instructions);
+
+    // Merge the stacks. Both branches must produce stacks of the same size
+    // and types, values, which differ, are moved to the new registers.
+    if (trueStack.size() != falseStack.size())
+    {
+        fail();
+    }
+
+    stack.resize(trueStack.size());
+    for (size_t i = 0; i < trueStack.size(); ++i)
+    {
+        const Value& trueValue = trueStack[i];
+        const Value& falseValue = falseStack[i];
+
+        if (trueValue == falseValue)
+        {
+            stack[i] = trueValue;
+            continue;
+        }
+
+        if (trueValue.type != falseValue.type || trueValue.type == ValueType::Block)
+        {
+            fail();
+        }
+
+        Value value;
+        value.type = trueValue.type;
+        value.reg = allocateRegister(Register());
+
+        Instruction trueMove;
+        trueMove.operation = Operation::Move;
+        trueMove.result = value.reg;
+        trueMove.a = trueValue.reg;
+        trueInstructions.push_back(trueMove);
+
+        Instruction falseMove = trueMove;
+        falseMove.a = falseValue.reg;
+        falseInstructions.push_back(falseMove);
+
+        stack[i] = value;
+    }
+
+    // Instruction layout is following:
+    //      JumpIfFalse condition, false branch
+    //      true branch instructions
+    //      Jump end (only if false branch is not empty)
+    //      false branch instructions
+    auto appendBranch = [this](const std::vector<Instruction>& branchInstructions)
+    {
+        const uint32_t offset = static_cast<uint32_t>(m_bytecode->m_instructions.size());
+        for (Instruction instruction : branchInstructions)
+        {
+            if (instruction.operation == Operation::Jump || instruction.operation == Operation::JumpIfFalse)
+            {
+                instruction.result += offset;
+            }
+            addInstruction(instruction);
+        }
+    };
+
+    const size_t conditionJumpIndex = m_bytecode->m_instructions.size();
+    Instruction conditionJump;
+    conditionJump.operation = Operation::JumpIfFalse;
+    conditionJump.a = condition.reg;
+    addInstruction(conditionJump);
+    appendBranch(trueInstructions);
+
+    if (!falseInstructions.empty())
+    {
+        const size_t endJumpIndex = m_bytecode->m_instructions.size();
+        Instruction endJump;
+        endJump.operation = Operation::Jump;
+        addInstruction(endJump);
+
+        m_bytecode->m_instructions[conditionJumpIndex].result = static_cast<uint32_t>(m_bytecode->m_instructions.size());
+        appendBranch(falseInstructions);
+        m_bytecode->m_instructions[endJumpIndex].result = static_cast<uint32_t>(m_bytecode->m_instructions.size());
+    }
+    else
+    {
+        m_bytecode->m_instructions[conditionJumpIndex].result = static_cast<uint32_t>(m_bytecode->m_instructions.size());
+    }
+}
+
+uint32_t PDFPostScriptFunctionCompiler::allocateRegister(Register value)
+{
+    if (m_bytecode->m_registers.size() >= MAX_SIZE)
+    {
+        fail();
+    }
+
+    m_bytecode->m_registers.push_back(value);
+    return static_cast<uint32_t>(m_bytecode->m_registers.size() - 1);
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::createConstant(ValueType type, Register value)
+{
+    Value result;
+    result.type = type;
+    result.isConstant = true;
+    result.reg = allocateRegister(value);
+    return result;
+}
+
+void PDFPostScriptFunctionCompiler::addInstruction(const Instruction& instruction)
+{
+    if (m_bytecode->m_instructions.size() >= MAX_SIZE)
+    {
+        fail();
+    }
+
+    m_bytecode->m_instructions.push_back(instruction);
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::emit(Operation operation, ValueType type, const Value& a)
+{
+    return emit(operation, type, a, a);
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::emit(Operation operation, ValueType type, const Value& a, const Value& b)
+{
+    Value result;
+    result.type = type;
+    result.reg = allocateRegister(Register());
+
+    Instruction instruction;
+    instruction.operation = operation;
+    instruction.result = result.reg;
+    instruction.a = a.reg;
+    instruction.b = b.reg;
+
+    if (a.isConstant && b.isConstant)
+    {
+        // Constant folding - evaluate the instruction at compile time. If evaluation
+        // fails, then instruction is emitted, so error is reported at runtime,
+        // when instruction is executed.
+        try
+        {
+            Bytecode::executeInstruction(instruction, m_bytecode->m_registers.data());
+            result.isConstant = true;
+            return result;
+        }
+        catch (const PDFPostScriptFunction::PDFPostScriptFunctionException&)
+        {
+
+        }
+    }
+
+    addInstruction(instruction);
+    return result;
+}
+
+void PDFPostScriptFunctionCompiler::push(Stack& stack, const Value& value)
+{
+    if (stack.size() >= MAX_STACK_SIZE)
+    {
+        fail();
+    }
+
+    stack.push_back(value);
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::pop(Stack& stack)
+{
+    if (stack.empty())
+    {
+        fail();
+    }
+
+    Value value = stack.back();
+    stack.pop_back();
+    return value;
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::pop(Stack& stack, ValueType type)
+{
+    if (!isTopType(stack, type))
+    {
+        fail();
+    }
+
+    return pop(stack);
+}
+
+PDFPostScriptFunctionCompiler::Value PDFPostScriptFunctionCompiler::popNumber(Stack& stack)
+{
+    if (isTopType(stack, ValueType::Integer))
+    {
+        return emit(Operation::IntegerToReal, ValueType::Real, pop(stack));
+    }
+
+    return pop(stack, ValueType::Real);
+}
+
+PDFInteger PDFPostScriptFunctionCompiler::popConstantInteger(Stack& stack)
+{
+    const Value value = pop(stack, ValueType::Integer);
+
+    if (!value.isConstant)
+    {
+        // Stack layout depends on input values
+        fail();
+    }
+
+    return m_bytecode->m_registers[value.reg].integer;
+}
+
+bool PDFPostScriptFunctionCompiler::isBinaryOperationType(const Stack& stack, ValueType type)
+{
+    const size_t size = stack.size();
+    return size >= 2 && stack[size - 1].type == type && stack[size - 2].type == type;
+}
+
+bool PDFPostScriptFunctionCompiler::isTopType(const Stack& stack, ValueType type)
+{
+    return !stack.empty() && stack.back().type == type;
+}
+
+std::unique_ptr<const PDFPostScriptFunctionBytecode> PDFPostScriptFunctionBytecode::compile(const Program& program, uint32_t m, uint32_t n)
+{
+    std::unique_ptr<PDFPostScriptFunctionBytecode> bytecode = std::make_unique<PDFPostScriptFunctionBytecode>();
+
+    try
+    {
+        PDFPostScriptFunctionCompiler compiler(program, bytecode.get());
+        compiler.compile(m, n);
+    }
+    catch (const PDFPostScriptFunction::PDFPostScriptFunctionException&)
+    {
+        // Program can't be compiled, it will be interpreted
+        return nullptr;
+    }
+
+    return bytecode;
+}
+
+PDFPostScriptFunction::Code PDFPostScriptFunction::getCode(const QByteArray& byteArray)
+{
+    static constexpr const std::pair<Code, const  char*> codes[] =
+    {
+        // B.1 Arithmetic operators
+        std::pair<Code, const  char*>{ Code::Add, "add" },
+        std::pair<Code, const  char*>{ Code::Sub, "sub" },
+        std::pair<Code, const  char*>{ Code::Mul, "mul" },
+        std::pair<Code, const  char*>{ Code::Div, "div" },
+        std::pair<Code, const  char*>{ Code::Idiv, "idiv" },
+        std::pair<Code, const  char*>{ Code::Mod, "mod" },
+        std::pair<Code, const  char*>{ Code::Neg, "neg" },
+        std::pair<Code, const  char*>{ Code::Abs, "abs" },
+        std::pair<Code, const  char*>{ Code::Ceiling, "ceiling" },
+        std::pair<Code, const  char*>{ Code::Floor, "floor" },
+        std::pair<Code, const  char*>{ Code::Round, "round" },
+        std::pair<Code, const  char*>{ Code::Truncate, "truncate" },
+        std::pair<Code, const  char*>{ Code::Sqrt, "sqrt" },
+        std::pair<Code, const  char*>{ Code::Sin, "sin" },
+        std::pair<Code, const  char*>{ Code::Cos, "cos" },
+        std::pair<Code, const  char*>{ Code::Atan, "atan" },
+        std::pair<Code, const  char*>{ Code::Exp, "exp" },
+        std::pair<Code, const  char*>{ Code::Ln, "ln" },
+        std::pair<Code, const  char*>{ Code::Log, "log" },
+        std::pair<Code, const  char*>{ Code::Cvi, "cvi" },
+        std::pair<Code, const  char*>{ Code::Cvr, "cvr" },
+
+        // B.2 Relational, Boolean and Bitwise operators
+        std::pair<Code, const  char*>{ Code::Eq, "eq" },
+        std::pair<Code, const  char*>{ Code::Ne, "ne" },
+        std::pair<Code, const  char*>{ Code::Gt, "gt" },
+        std::pair<Code, const  char*>{ Code::Ge, "ge" },
+        std::pair<Code, const  char*>{ Code::Lt, "lt" },
+        std::pair<Code, const  char*>{ Code::Le, "le" },
+        std::pair<Code, const  char*>{ Code::And, "and" },
+        std::pair<Code, const  char*>{ Code::Or, "or" },
+        std::pair<Code, const  char*>{ Code::Xor, "xor" },
+        std::pair<Code, const  char*>{ Code::Not, "not" },
+        std::pair<Code, const  char*>{ Code::Bitshift, "bitshift" },
+        std::pair<Code, const  char*>{ Code::True, "true" },
+        std::pair<Code, const  char*>{ Code::False, "false" },
+
+        // B.3 Conditional operators
+        std::pair<Code, const  char*>{ Code::If, "if" },
+        std::pair<Code, const  char*>{ Code::IfElse, "ifelse" },
+
+        // B.4 Stack operators
+        std::pair<Code, const  char*>{ Code::Pop, "pop" },
+        std::pair<Code, const  char*>{ Code::Exch, "exch" },
+        std::pair<Code, const  char*>{ Code::Dup, "dup" },
+        std::pair<Code, const  char*>{ Code::Copy, "copy" },
+        std::pair<Code, const  char*>{ Code::Index, "index" },
+        std::pair<Code, const  char*>{ Code::Roll, "roll" }
+    };
+
+    for (const std::pair<Code, const  char*>& codeItem : codes)
+    {
+        if (byteArray == codeItem.second)
+        {
+            return codeItem.first;
+        }
+    }
+
+    throw PDFException(PDFTranslationContext::tr("Invalid operator (PostScript function) '%1'.").arg(QString::fromLatin1(byteArray)));
+}
+
+PDFPostScriptFunction::PDFPostScriptFunction(uint32_t m, uint32_t n, std::vector<PDFReal>&& domain, std::vector<PDFReal>&& range, PDFPostScriptFunction::Program&& program) :
+    PDFFunction(m, n, std::move(domain), std::move(range)),
+    m_program(std::move(program))
+{
+    Q_ASSERT(!m_program.empty());
+    m_bytecode = PDFPostScriptFunctionBytecode::compile(m_program, m_m, m_n);
+}
+
+PDFPostScriptFunction::~PDFPostScriptFunction()
+{
+
+}
+
+PDFPostScriptFunction::Program PDFPostScriptFunction::parseProgram(const QByteArray& byteArray)
+{
+    // Lexical analyzer can't handle when '{' or '}' is near next token (for example '{0' etc.)
+    QByteArray adjustedArray = byteArray;
+    adjustedArray.replace('{', " { ").replace('}', " } ");
+
+    Program result;
+    PDFLexicalAnalyzer parser(adjustedArray.constBegin(), adjustedArray.constEnd());
+    parser.setTokenizingPostScriptFunction();
+
+    std::stack<InstructionPointer> blockCallStack;
+    while (true)
+    {
+        PDFLexicalAnalyzer::Token token = parser.fetch();
+        if (token.type == PDFLexicalAnalyzer::TokenType::EndOfFile)
+        {
+            // We are at end, stop the parsing
+            break;
+        }
+
+        switch (token.type)
+        {
+            case PDFLexicalAnalyzer::TokenType::Boolean:
+            {
+                result.emplace_back(OperandObject::createBoolean(token.data.toBool()), result.size() + 1);
+                break;
+            }
+
+            case PDFLexicalAnalyzer::TokenType::Integer:
+            {
+                result.emplace_back(OperandObject::createInteger(token.data.toLongLong()), result.size() + 1);
+                break;
+            }
+
+            case PDFLexicalAnalyzer::TokenType::Real:
+            {
+                result.emplace_back(OperandObject::createReal(token.data.toDouble()), result.size() + 1);
+                break;
+            }
+
+            case PDFLexicalAnalyzer::TokenType::Command:
+            {
+                QByteArray command = token.data.toByteArray();
+                if (command == "{")
+                {
+                    // Opening bracket - means start of block
+                    blockCallStack.push(result.size());
+                    result.emplace_back(Code::Call, INVALID_INSTRUCTION_POINTER);
+                    result.back().operand = OperandObject::createInstructionPointer(result.size());
+                }
+                else if (command == "}")
+                {
+                    // Closing bracket - means end of block
+                    if (blockCallStack.empty())
+                    {
+                        throw PDFException(PDFTranslationContext::tr("Invalid program - bad enclosing brackets (PostScript function)."));
+                    }
+
+                    result[blockCallStack.top()].next = result.size() + 1;
+                    blockCallStack.pop();
+                    result.emplace_back(Code::Return, INVALID_INSTRUCTION_POINTER);
+                }
+                else
+                {
+                    result.emplace_back(getCode(command), result.size() + 1);
+                }
+
+                break;
+            }
 
             default:
             {
@@ -1838,6 +3281,11 @@ PDFFunction::FunctionResult PDFPostScriptFunction::apply(const_iterator x_1, con
         return PDFTranslationContext::tr("Invalid number of output variables for function. Expected %1, provided %2.").arg(m_n).arg(n);
     }
 
+    if (m_bytecode)
+    {
+        return applyBatch(x_1, y_1, 1);
+    }
+
     try
     {
         PDFPostScriptFunctionStack stack;
@@ -1876,4 +3324,182 @@ PDFFunction::FunctionResult PDFPostScriptFunction::apply(const_iterator x_1, con
     return true;
 }
 
+PDFFunction::FunctionResult PDFPostScriptFunction::applyBatch(const_iterator x, iterator y, size_t count) const
+{
+    if (!m_bytecode)
+    {
+        return PDFFunction::applyBatch(x, y, count);
+    }
+
+    try
+    {
+        using Register = PDFPostScriptFunctionBytecode::Register;
+
+        // Registers are usually small, so we try to avoid heap allocation
+        constexpr size_t LOCAL_REGISTER_COUNT = 128;
+        const std::vector<Register>& initialRegisters = m_bytecode->getInitialRegisters();
+        std::array<Register, LOCAL_REGISTER_COUNT> localRegisters;
+        std::vector<Register> heapRegisters;
+        Register* registers = localRegisters.data();
+
+        if (initialRegisters.size() > LOCAL_REGISTER_COUNT)
+        {
+            heapRegisters = initialRegisters;
+            registers = heapRegisters.data();
+        }
+        else
+        {
+            std::copy(initialRegisters.cbegin(), initialRegisters.cend(), registers);
+        }
+
+        // Registers need not to be initialized again for next point, because
+        // constants are never overwritten and each temporary register is
+        // written before it is read.
+        const std::vector<PDFPostScriptFunctionBytecode::Output>& outputs = m_bytecode->getOutputs();
+        for (size_t point = 0; point < count; ++point, x += m_m, y += m_n)
+        {
+            // Input values are in the first registers
+            for (uint32_t i = 0; i < m_m; ++i)
+            {
+                registers[i].real = clampInput(i, x[i]);
+            }
+
+            m_bytecode->execute(registers);
+
+            for (uint32_t i = 0; i < m_n; ++i)
+            {
+                const PDFPostScriptFunctionBytecode::Output& output = outputs[i];
+                const Register& value = registers[output.reg];
+                y[i] = clampOutput(i, output.isInteger ? PDFReal(value.integer) : value.real);
+            }
+        }
+    }
+    catch (const PDFPostScriptFunction::PDFPostScriptFunctionException& exception)
+    {
+        return exception.getMessage();
+    }
+
+    return true;
+}
+
+PDFFunctionLookupTable PDFFunctionLookupTable::create(const std::vector<PDFFunctionPtr>& functions, size_t n, PDFReal xMin, PDFReal xMax, PDFReal tolerance)
+{
+    PDFFunctionLookupTable table;
+
+    if (functions.empty() || n == 0 || (functions.size() > 1 && functions.size() != n) || !(xMin <= xMax))
+    {
+        return table;
+    }
+
+    // Evaluates functions in given point, returns false on error
+    auto evaluate = [&functions, n](PDFReal x, PDFReal* y)
+    {
+        if (functions.size() == 1)
+        {
+            return static_cast<bool>(functions.front()->apply(&x, &x + 1, y, y + n));
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (!functions[i]->apply(&x, &x + 1, y + i, y + i + 1))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    table.m_xMin = xMin;
+    table.m_outputCount = n;
+
+    if (qFuzzyCompare(xMin, xMax))
+    {
+        // Domain is a single point, table consists of one sample
+        std::vector<PDFReal> values(n, 0.0);
+        if (evaluate(xMin, values.data()))
+        {
+            table.m_values = qMove(values);
+        }
+        return table;
+    }
+
+    size_t intervalCount = INITIAL_INTERVAL_COUNT;
+    std::vector<PDFReal> values((intervalCount + 1) * n, 0.0);
+    for (size_t i = 0; i <= intervalCount; ++i)
+    {
+        if (!evaluate(interpolate(PDFReal(i), 0.0, PDFReal(intervalCount), xMin, xMax), values.data() + i * n))
+        {
+            return table;
+        }
+    }
+
+    std::vector<PDFReal> midpoint(n, 0.0);
+    while (intervalCount < MAX_INTERVAL_COUNT)
+    {
+        // Evaluate functions in the middle of intervals and compare them
+        // with linear interpolation. Then we refine the table using these
+        // values, so sample count is doubled. Refined table is accepted, if
+        // error was lesser than tolerance (so error of refined table is lesser).
+        std::vector<PDFReal> refinedValues((2 * intervalCount + 1) * n, 0.0);
+        PDFReal error = 0.0;
+
+        for (size_t i = 0; i < intervalCount; ++i)
+        {
+            const PDFReal x = interpolate(PDFReal(2 * i + 1), 0.0, PDFReal(2 * intervalCount), xMin, xMax);
+            if (!evaluate(x, midpoint.data()))
+            {
+                return table;
+            }
+
+            const PDFReal* left = values.data() + i * n;
+            const PDFReal* right = left + n;
+            for (size_t k = 0; k < n; ++k)
+            {
+                error = qMax(error, qAbs(midpoint[k] - 0.5 * (left[k] + right[k])));
+            }
+
+            std::copy(left, right, refinedValues.data() + 2 * i * n);
+            std::copy(midpoint.cbegin(), midpoint.cend(), refinedValues.data() + (2 * i + 1) * n);
+        }
+
+        std::copy(values.cend() - n, values.cend(), refinedValues.end() - n);
+        values = qMove(refinedValues);
+        intervalCount *= 2;
+
+        if (error <= tolerance)
+        {
+            table.m_intervalCount = intervalCount;
+            table.m_scale = PDFReal(intervalCount) / (xMax - xMin);
+            table.m_values = qMove(values);
+            return table;
+        }
+    }
+
+    // Error can't be bounded, function is probably discontinuous
+    return table;
+}
+
+void PDFFunctionLookupTable::evaluate(PDFReal x, PDFReal* y) const
+{
+    Q_ASSERT(isValid());
+
+    if (m_intervalCount == 0)
+    {
+        std::copy(m_values.cbegin(), m_values.cend(), y);
+        return;
+    }
+
+    const PDFReal position = qBound<PDFReal>(0.0, (x - m_xMin) * m_scale, PDFReal(m_intervalCount));
+    const size_t index = qMin(static_cast<size_t>(position), m_intervalCount - 1);
+    const PDFReal fraction = position - PDFReal(index);
+
+    const PDFReal* left = m_values.data() + index * m_outputCount;
+    const PDFReal* right = left + m_outputCount;
+    for (size_t i = 0; i < m_outputCount; ++i)
+    {
+        y[i] = left[i] + (right[i] - left[i]) * fraction;
+    }
+}
+
 }   // namespace pdf
@@ -29,6 +29,7 @@ class PDFObject;
 class PDFFunction;
 class PDFDocument;
 class PDFParsingContext;
+class PDFPostScriptFunctionBytecode;
 
 enum class FunctionType
 {
@@ -86,6 +87,17 @@ public:
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const = 0;
 
+    /// Transforms input values of multiple points to the output values. Input values
+    /// of the points are stored consecutively (m values for each point), output
+    /// values are stored in the same way (n values for each point). Default
+    /// implementation calls \p apply for each point, functions can override it
+    /// to evaluate points more efficiently. If evaluation fails, error of the
+    /// first failed point is returned.
+    /// \param x Input values (m * count values)
+    /// \param y Output values (n * count values)
+    /// \param count Number of points
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const;
+
     /// Creates function from the object. If error occurs, exception is thrown.
     /// \param document Document, owning the pdf object
     /// \param object Object defining the function
@@ -181,6 +193,7 @@ public:
     /// \param y_1 Iterator to the first output value
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const override;
 
     PDFInteger getOrder() const { return m_order; }
 
@@ -243,6 +256,7 @@ public:
     /// \param y_1 Iterator to the first output value
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const override;
 
 private:
     std::vector<PDFReal> m_c0;
@@ -305,14 +319,21 @@ public:
     /// \param y_1 Iterator to the first output value
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const override;
 
 private:
+    /// Returns partial function for given (clamped) input value
+    const PartialFunction& getPartialFunction(PDFReal x) const;
+
     /// Partial function definitions
     std::vector<PartialFunction> m_partialFunctions;
 };
 
 /// Postscript function (Type 4 function)
-/// Implements subset of postscript language
+/// Implements subset of postscript language. Program is compiled
+/// to the register based bytecode, if it is possible (stack depth and types
+/// of the operands can be determined at compile time), otherwise program
+/// is interpreted.
 class PDF4QTLIBCORESHARED_EXPORT PDFPostScriptFunction : public PDFFunction
 {
 public:
@@ -465,14 +486,70 @@ public:
     /// \param y_1 Iterator to the first output value
     /// \param y_n Iterator to the end of the output values (one item after last value)
     virtual FunctionResult apply(const_iterator x_1, const_iterator x_m, iterator y_1, iterator y_n) const override;
+    virtual FunctionResult applyBatch(const_iterator x, iterator y, size_t count) const override;
+
+    /// Returns true, if program was compiled to the bytecode
+    bool isCompiled() const { return m_bytecode != nullptr; }
 
 private:
     Program m_program;
+    std::unique_ptr<const PDFPostScriptFunctionBytecode> m_bytecode;
 
     friend class PDFPostScriptFunctionStack;
     friend class PDFPostScriptFunctionExecutor;
 };
 
+/// Lookup table approximating functions of one input variable by piecewise
+/// linear interpolation of uniformly distributed samples. Table can represent
+/// either single function with n outputs, or n functions with one output
+/// (as color functions of the shadings). Evaluation of the table is much
+/// faster than evaluation of the stitching, sampled or postscript function.
+class PDF4QTLIBCORESHARED_EXPORT PDFFunctionLookupTable
+{
+public:
+    explicit PDFFunctionLookupTable() = default;
+
+    /// Creates lookup table for given functions. Count of samples is doubled until
+    /// approximation error (measured in the middle of the sample intervals) is lesser
+    /// than tolerance. If error can't be bounded (for example, function is discontinuous),
+    /// or function evaluation fails, then invalid table is returned.
+    /// \param functions Single function with n outputs, or n functions with one output
+    /// \param n Number of output variables
+    /// \param xMin Minimal input value
+    /// \param xMax Maximal input value
+    /// \param tolerance Maximal absolute error of the output values
+    static PDFFunctionLookupTable create(const std::vector<PDFFunctionPtr>& functions, size_t n, PDFReal xMin, PDFReal xMax, PDFReal tolerance);
+
+    /// Returns true, if table is valid
+    bool isValid() const { return !m_values.empty(); }
+
+    /// Returns number of output variables
+    size_t getOutputCount() const { return m_outputCount; }
+
+    /// Returns number of sample intervals
+    size_t getIntervalCount() const { return m_intervalCount; }
+
+    /// Evaluates the table, input value is clamped to the table domain.
+    /// Table must be valid.
+    /// \param x Input value
+    /// \param y Output values (array of size \p getOutputCount())
+    void evaluate(PDFReal x, PDFReal* y) const;
+
+private:
+    static constexpr size_t INITIAL_INTERVAL_COUNT = 32;
+    static constexpr size_t MAX_INTERVAL_COUNT = 8192;
+
+    PDFReal m_xMin = 0.0;
+    PDFReal m_scale = 0.0;
+    size_t m_intervalCount = 0;
+    size_t m_outputCount = 0;
+
+    /// Samples, (m_intervalCount + 1) * m_outputCount values
+    std::vector<PDFReal> m_values;
+};
+
+using PDFFunctionLookupTablePointer = std::shared_ptr<const PDFFunctionLookupTable>;
+
 }   // namespace pdf
 
 #endif // PDFFUNCTION_H
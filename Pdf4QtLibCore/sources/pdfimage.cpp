@@ -22,10 +22,14 @@
 #include "pdfutils.h"
 #include "pdfjbig2decoder.h"
 #include "pdfccittfaxdecoder.h"
+#include "pdfexecutionpolicy.h"
+#include "pdftrace.h"
 
 #include <openjpeg.h>
 #include <jpeglib.h>
 
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -54,16 +58,31 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
                                PDFColorSpacePointer colorSpace,
                                bool isSoftMask,
                                RenderingIntent renderingIntent,
-                               PDFRenderErrorReporter* errorReporter)
+                               PDFRenderErrorReporter* errorReporter,
+                               const PDFOperationControl* operationControl,
+                               int resolutionReduction,
+                               QRect decodeArea)
 {
+    PDF_TRACE_SPAN("image", "Decode image");
     PDFImage image;
     image.m_colorSpace = colorSpace;
     image.m_renderingIntent = renderingIntent;
 
     const PDFDictionary* dictionary = stream->getDictionary();
+
+    if (decodeArea.isValid() && !isDecodeAreaSupported(document, stream))
+    {
+        // Mask or soft mask is always decoded whole, so image must be decoded whole too
+        decodeArea = QRect();
+    }
     QByteArray content = document->getDecodedStream(stream);
     PDFDocumentDataLoaderDecorator loader(document);
 
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        return PDFImage();
+    }
+
     if (content.isEmpty())
     {
         throw PDFException(PDFTranslationContext::tr("Image has not data."));
@@ -130,7 +149,7 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
         }
         else if (object.isStream())
         {
-            PDFImage softMaskImage = createImage(document, object.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), false, renderingIntent, errorReporter);
+            PDFImage softMaskImage = createImage(document, object.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), false, renderingIntent, errorReporter, operationControl, resolutionReduction);
 
             if (softMaskImage.m_imageData.getMaskingType() != PDFImageData::MaskingType::ImageMask ||
                 softMaskImage.m_imageData.getColorChannels() != 1 ||
@@ -161,7 +180,7 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
 
         if (softMaskObject.isStream())
         {
-            PDFImage softMaskImage = createImage(document, softMaskObject.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), true, renderingIntent, errorReporter);
+            PDFImage softMaskImage = createImage(document, softMaskObject.getStream(), PDFColorSpacePointer(new PDFDeviceGrayColorSpace()), true, renderingIntent, errorReporter, operationControl, resolutionReduction);
             maskingType = PDFImageData::MaskingType::SoftMask;
             image.m_softMask = qMove(softMaskImage.m_imageData);
         }
@@ -176,6 +195,11 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
         maskingType = PDFImageData::MaskingType::ImageMask;
     }
 
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        return PDFImage();
+    }
+
     // Retrieve filters
     PDFObject filters;
     if (dictionary->hasKey(PDF_STREAM_DICT_FILTER))
@@ -339,6 +363,13 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
                 }
             }
 
+            // Decode image in reduced resolution, libjpeg supports scaling by 1/2, 1/4 and 1/8
+            if (resolutionReduction > 0)
+            {
+                codec.scale_num = 1;
+                codec.scale_denom = 1 << qMin(resolutionReduction, 3);
+            }
+
             jpeg_start_decompress(&codec);
 
             const JDIMENSION rowStride = codec.output_width * codec.output_components;
@@ -352,16 +383,31 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
             QByteArray buffer(rowStride * height, 0);
             JSAMPROW rowData = reinterpret_cast<JSAMPROW>(buffer.data());
 
+            bool isCancelled = false;
             while (scanLineCount)
             {
+                // Decoding is cancelled
+                if (PDFOperationControl::isOperationCancelled(operationControl))
+                {
+                    isCancelled = true;
+                    break;
+                }
+
                 JDIMENSION readCount = jpeg_read_scanlines(&codec, samples, 1);
                 std::memcpy(rowData, samples[0], rowStride);
                 scanLineCount -= readCount;
                 rowData += rowStride;
             }
 
-            jpeg_finish_decompress(&codec);
-            image.m_imageData = PDFImageData(components, bitsPerComponent, width, height, rowStride, maskingType, qMove(buffer), qMove(mask), qMove(decode), qMove(matte));
+            if (!isCancelled)
+            {
+                jpeg_finish_decompress(&codec);
+                image.m_imageData = PDFImageData(components, bitsPerComponent, width, height, rowStride, maskingType, qMove(buffer), qMove(mask), qMove(decode), qMove(matte));
+            }
+            else
+            {
+                jpeg_abort_decompress(&codec);
+            }
         }
 
         jpeg_destroy_decompress(&codec);
@@ -426,11 +472,65 @@ PDFImage PDFImage::createImage(const PDFDocument* document,
             // Setup the decoder
             if (opj_setup_decoder(codec, &decompressParameters))
             {
+#if (OPJ_VERSION_MAJOR > 2) || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 3)
+                // Decode code blocks in parallel, if threads are available (must be
+                // set before the header is read). Thread count is limited by the
+                // number of concurrently processed content streams.
+                const int threadCount = PDFExecutionPolicy::getThreadBudget(PDFExecutionPolicy::Scope::Content);
+                if (threadCount > 1 && opj_has_thread_support())
+                {
+                    opj_codec_set_threads(codec, threadCount);
+                }
+#endif
+
+
                 // Try to read the header
 
                 if (opj_read_header(opjStream, codec, &jpegImage))
                 {
-                    if (opj_set_decode_area(codec, jpegImage, decompressParameters.DA_x0, decompressParameters.DA_y0, decompressParameters.DA_x1, decompressParameters.DA_y1))
+                    // Decode image in reduced resolution, reduction is limited by
+                    // count of resolution levels of the image.
+                    if (resolutionReduction > 0)
+                    {
+                        if (opj_codestream_info_v2_t* codestreamInfo = opj_get_cstr_info(codec))
+                        {
+                            const OPJ_UINT32 resolutionCount = codestreamInfo->m_default_tile_info.tccp_info ? codestreamInfo->m_default_tile_info.tccp_info[0].numresolutions : 1;
+                            const OPJ_UINT32 reduction = qMin(OPJ_UINT32(resolutionReduction), resolutionCount > 0 ? resolutionCount - 1 : 0);
+                            opj_destroy_cstr_info(&codestreamInfo);
+
+                            if (reduction > 0)
+                            {
+                                opj_set_decoded_resolution_factor(codec, reduction);
+                            }
+                        }
+                    }
+
+                    // Decode only requested area of the image (coordinates are
+                    // relative to the image origin on the reference grid)
+                    OPJ_INT32 decodeAreaX0 = decompressParameters.DA_x0;
+                    OPJ_INT32 decodeAreaY0 = decompressParameters.DA_y0;
+                    OPJ_INT32 decodeAreaX1 = decompressParameters.DA_x1;
+                    OPJ_INT32 decodeAreaY1 = decompressParameters.DA_y1;
+
+                    const OPJ_INT32 imageWidth = OPJ_INT32(jpegImage->x1 - jpegImage->x0);
+                    const OPJ_INT32 imageHeight = OPJ_INT32(jpegImage->y1 - jpegImage->y0);
+                    const QRect area = decodeArea.intersected(QRect(0, 0, imageWidth, imageHeight));
+                    if (decodeArea.isValid() && !area.isEmpty() && area != QRect(0, 0, imageWidth, imageHeight))
+                    {
+                        decodeAreaX0 = OPJ_INT32(jpegImage->x0) + area.left();
+                        decodeAreaY0 = OPJ_INT32(jpegImage->y0) + area.top();
+                        decodeAreaX1 = decodeAreaX0 + area.width();
+                        decodeAreaY1 = decodeAreaY0 + area.height();
+
+                        // Image y axis is pointing down, unit square y axis is pointing up
+                        const PDFReal scaleX = PDFReal(area.width()) / imageWidth;
+                        const PDFReal scaleY = PDFReal(area.height()) / imageHeight;
+                        const PDFReal offsetX = PDFReal(area.left()) / imageWidth;
+                        const PDFReal offsetY = 1.0 - PDFReal(area.top() + area.height()) / imageHeight;
+                        image.m_decodedAreaMatrix = QTransform(scaleX, 0.0, 0.0, scaleY, offsetX, offsetY);
+                    }
+
+                    if (opj_set_decode_area(codec, jpegImage, decodeAreaX0, decodeAreaY0, decodeAreaX1, decodeAreaY1))
                     {
                         if (opj_decode(codec, opjStream, jpegImage))
                         {
@@ -750,6 +850,7 @@ QImage PDFImage::getImage(const PDFCMS* cms,
                           PDFRenderErrorReporter* reporter,
                           const PDFOperationControl* operationControl) const
 {
+    PDF_TRACE_SPAN("image", "Convert image colors");
     const bool isImageMask = m_imageData.getMaskingType() == PDFImageData::MaskingType::ImageMask;
     if (m_colorSpace && !isImageMask)
     {
@@ -774,6 +875,11 @@ QImage PDFImage::getImage(const PDFCMS* cms,
 
         for (unsigned int i = 0, rowCount = m_imageData.getHeight(); i < rowCount; ++i)
         {
+            if (PDFOperationControl::isOperationCancelled(operationControl))
+            {
+                return QImage();
+            }
+
             reader.seek(i * m_imageData.getStride());
             unsigned char* outputLine = image.scanLine(i);
 
@@ -870,4 +976,185 @@ PDFAlternateImage PDFAlternateImage::parse(const PDFObjectStorage* storage, PDFO
     return result;
 }
 
+/// Returns name of the last filter of the image stream (which decodes
+/// the image data), or empty byte array, if stream has no filter.
+static QByteArray getImageFilterName(const PDFDocument* document, const PDFStream* stream)
+{
+    const PDFObject& filters = document->getObject(stream->getDictionary()->get(PDF_STREAM_DICT_FILTER));
+    if (filters.isName())
+    {
+        return filters.getString();
+    }
+    else if (filters.isArray())
+    {
+        const PDFArray* filterArray = filters.getArray();
+        const size_t filterCount = filterArray->getCount();
+
+        if (filterCount)
+        {
+            const PDFObject& object = document->getObject(filterArray->getItem(filterCount - 1));
+            if (object.isName())
+            {
+                return object.getString();
+            }
+        }
+    }
+
+    return QByteArray();
+}
+
+bool PDFImage::isDecodeAreaSupported(const PDFDocument* document, const PDFStream* stream)
+{
+    const PDFDictionary* dictionary = stream->getDictionary();
+    if (dictionary->hasKey("Mask") || dictionary->hasKey("SMask"))
+    {
+        return false;
+    }
+
+    return getImageFilterName(document, stream) == "JPXDecode";
+}
+
+bool PDFImage::isResolutionReductionSupported(const PDFDocument* document, const PDFStream* stream)
+{
+    const QByteArray filterName = getImageFilterName(document, stream);
+    return filterName == "DCTDecode" || filterName == "JPXDecode";
+}
+
+PDFImageCache::PDFImageCache() :
+    m_cacheLimit(qint64(DEFAULT_IMAGE_CACHE_LIMIT))
+{
+    PDFCacheManager::getInstance()->registerCache(this);
+}
+
+PDFImageCache::~PDFImageCache()
+{
+    PDFCacheManager::getInstance()->unregisterCache(this);
+}
+
+PDFImageCache* PDFImageCache::getInstance()
+{
+    static PDFImageCache cache;
+    return &cache;
+}
+
+bool PDFImageCache::findImage(const Key& key, PDFImage& image)
+{
+    PDF_TRACE_SPAN("cache", "Image cache lookup");
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end())
+    {
+        it->second.lastAccess = PDFCacheManager::getAccessStamp();
+        image = it->second.image;
+        return true;
+    }
+
+    return false;
+}
+
+void PDFImageCache::insertImage(const Key& key, PDFImage image)
+{
+    const qint64 size = image.getImageData().getData().size() + image.getSoftMaskData().getData().size();
+
+    QMutexLocker lock(&m_mutex);
+
+    if (size > m_cacheLimit || m_entries.count(key))
+    {
+        // Image is too large, or it was decoded by another thread
+        return;
+    }
+
+    Entry& entry = m_entries[key];
+    entry.image = qMove(image);
+    entry.size = size;
+    entry.lastAccess = PDFCacheManager::getAccessStamp();
+    m_cacheSize += size;
+
+    shrink();
+}
+
+void PDFImageCache::removeDocument(quint64 documentId)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (it->first.documentId == documentId)
+        {
+            m_cacheSize -= it->second.size;
+            it = m_entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void PDFImageCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_entries.clear();
+    m_cacheSize = 0;
+}
+
+void PDFImageCache::setCacheLimit(qint64 cacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_cacheLimit = cacheLimit;
+    shrink();
+}
+
+qint64 PDFImageCache::getCacheLimit() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheLimit;
+}
+
+qint64 PDFImageCache::getCacheSize() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheSize;
+}
+
+quint64 PDFImageCache::getLeastRecentAccessStamp() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = std::min_element(m_entries.cbegin(), m_entries.cend(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+    return it != m_entries.cend() ? it->second.lastAccess : 0;
+}
+
+int PDFImageCache::getRecreationCost() const
+{
+    return 4;
+}
+
+qint64 PDFImageCache::evict(qint64 bytes)
+{
+    QMutexLocker lock(&m_mutex);
+
+    qint64 freed = 0;
+    while (freed < bytes && !m_entries.empty())
+    {
+        auto it = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+        freed += it->second.size;
+        m_cacheSize -= it->second.size;
+        m_entries.erase(it);
+    }
+
+    return freed;
+}
+
+void PDFImageCache::shrink()
+{
+    while (m_cacheSize > m_cacheLimit && !m_entries.empty())
+    {
+        auto it = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+        m_cacheSize -= it->second.size;
+        m_entries.erase(it);
+    }
+}
+
 }   // namespace pdf
@@ -21,8 +21,15 @@
 #include "pdfobject.h"
 #include "pdfcolorspaces.h"
 #include "pdfoperationcontrol.h"
+#include "pdfcachemanager.h"
 
+#include <QRect>
+#include <QMutex>
 #include <QByteArray>
+#include <QTransform>
+
+#include <map>
+#include <tuple>
 
 class QByteArray;
 
@@ -30,6 +37,7 @@ namespace pdf
 {
 class PDFStream;
 class PDFDocument;
+class PDFDictionary;
 class PDFObjectStorage;
 class PDFRenderErrorReporter;
 
@@ -67,12 +75,39 @@ public:
     /// \param isSoftMask Is it a soft mask image?
     /// \param renderingIntent Default rendering intent of the image
     /// \param errorReporter Error reporter for reporting errors (or warnings)
+    /// \param operationControl Operation control (if operation is cancelled, empty image is returned)
+    /// \param resolutionReduction Image can be decoded in resolution reduced by factor up to 2^resolutionReduction
+    ///        in each direction (used, when image is painted small, for example, in thumbnails). Reduction
+    ///        is supported only by some decoders (JPEG, JPEG 2000), other images are decoded in full resolution.
+    /// \param decodeArea Area of the image (in pixels), which should be decoded. If it is invalid, whole image
+    ///        is decoded. Decoding of the area is supported only by some decoders (see \p isDecodeAreaSupported),
+    ///        use \p getDecodedAreaMatrix to determine, which part of the image was decoded.
     static PDFImage createImage(const PDFDocument* document,
                                 const PDFStream* stream,
                                 PDFColorSpacePointer colorSpace,
                                 bool isSoftMask,
                                 RenderingIntent renderingIntent,
-                                PDFRenderErrorReporter* errorReporter);
+                                PDFRenderErrorReporter* errorReporter,
+                                const PDFOperationControl* operationControl = nullptr,
+                                int resolutionReduction = 0,
+                                QRect decodeArea = QRect());
+
+    /// Returns true, if image decoder of the image stream supports decoding
+    /// of only part of the image (currently only JPEG 2000 images without
+    /// mask or soft mask).
+    /// \param document Document
+    /// \param stream Image stream
+    static bool isDecodeAreaSupported(const PDFDocument* document, const PDFStream* stream);
+
+    /// Returns true, if image decoder of the image stream supports decoding
+    /// in reduced resolution (see \p resolutionReduction parameter of \p createImage),
+    /// i.e. image is decoded faster in reduced resolution (JPEG and JPEG 2000 images).
+    /// \param document Document
+    /// \param stream Image stream
+    static bool isResolutionReductionSupported(const PDFDocument* document, const PDFStream* stream);
+
+    /// Maximal supported resolution reduction (see \p createImage)
+    static constexpr int MAX_RESOLUTION_REDUCTION = 5;
 
     /// Returns image transformed from image data and color space
     QImage getImage(const PDFCMS* cms,
@@ -112,9 +147,17 @@ public:
     const PDFImageData& getImageData() const { return m_imageData; }
     const PDFImageData& getSoftMaskData() const { return m_softMask; }
 
+    /// Returns matrix, which maps unit square of the decoded image data to the
+    /// unit square of the whole image. If whole image was decoded, identity is returned.
+    const QTransform& getDecodedAreaMatrix() const { return m_decodedAreaMatrix; }
+
+    /// Returns true, if only part of the image was decoded
+    bool isPartiallyDecoded() const { return !m_decodedAreaMatrix.isIdentity(); }
+
 private:
     PDFImageData m_imageData;
     PDFImageData m_softMask;
+    QTransform m_decodedAreaMatrix;
     PDFColorSpacePointer m_colorSpace;
     RenderingIntent m_renderingIntent = RenderingIntent::Perceptual;
     bool m_interpolate = false;
@@ -130,6 +173,91 @@ private:
     PDFObject m_pointData;
 };
 
+/// Process-wide cache of decoded images. Decoding of images (especially JPEG,
+/// JPEG 2000, JBIG2 or CCITT compressed images) is expensive, so decoded images
+/// are shared between pages and between page compilations. Cache is bounded
+/// by memory consumption of the decoded image data, least recently used images
+/// are removed first. Images are identified by unique identifier of the document
+/// (see PDFDocumentId) and by reference of the image stream. When identifier
+/// of the document is released (document is destroyed or assigned to), images
+/// of the document are removed from the cache. Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFImageCache : public PDFManagedCache
+{
+public:
+    struct Key
+    {
+        quint64 documentId = 0;
+        PDFObjectReference stream;
+        const PDFDictionary* colorSpaceDictionary = nullptr; ///< Color space dictionary used to create color space of the image (owned by the document)
+        RenderingIntent renderingIntent = RenderingIntent::Perceptual;
+        bool isSoftMask = false;
+        int resolutionReduction = 0;
+        QRect decodeArea;
+
+        bool operator<(const Key& other) const
+        {
+            return std::make_tuple(documentId, stream, colorSpaceDictionary, renderingIntent, isSoftMask, resolutionReduction, decodeArea.left(), decodeArea.top(), decodeArea.right(), decodeArea.bottom()) <
+                   std::make_tuple(other.documentId, other.stream, other.colorSpaceDictionary, other.renderingIntent, other.isSoftMask, other.resolutionReduction, other.decodeArea.left(), other.decodeArea.top(), other.decodeArea.right(), other.decodeArea.bottom());
+        }
+    };
+
+    /// Returns instance of the image cache
+    static PDFImageCache* getInstance();
+
+    /// Finds image in the cache. If image is found, then true is returned
+    /// and image is stored in \p image, otherwise false is returned.
+    /// \param key Image key
+    /// \param[out] image Cached image
+    bool findImage(const Key& key, PDFImage& image);
+
+    /// Inserts decoded image into the cache. If image is too large,
+    /// it is not inserted.
+    /// \param key Image key
+    /// \param image Decoded image
+    void insertImage(const Key& key, PDFImage image);
+
+    /// Removes all images of the document from the cache
+    /// \param documentId Unique identifier of the document
+    void removeDocument(quint64 documentId);
+
+    /// Removes all images from the cache
+    void clear();
+
+    /// Sets memory limit of the cache (in bytes)
+    void setCacheLimit(qint64 cacheLimit);
+
+    /// Returns memory limit of the cache (in bytes)
+    qint64 getCacheLimit() const;
+
+    /// Returns memory consumed by cached images (in bytes)
+    qint64 getCacheSize() const;
+
+    virtual qint64 getManagedCacheSize() const override { return getCacheSize(); }
+    virtual quint64 getLeastRecentAccessStamp() const override;
+    virtual int getRecreationCost() const override;
+    virtual qint64 evict(qint64 bytes) override;
+
+private:
+    explicit PDFImageCache();
+    virtual ~PDFImageCache() override;
+
+    struct Entry
+    {
+        PDFImage image;
+        qint64 size = 0;
+        quint64 lastAccess = 0;
+    };
+
+    /// Removes least recently used images, until cache size is within the limit.
+    /// Mutex must be locked.
+    void shrink();
+
+    mutable QMutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    qint64 m_cacheLimit;
+    qint64 m_cacheSize = 0;
+};
+
 }   // namespace pdf
 
 #endif // PDFIMAGE_H
@@ -2,6 +2,7 @@
 #include "pdfdbgheap.h"
 
 #include <cmath>
+#include <vector>
 
 namespace pdf
 {
@@ -35,8 +36,10 @@ bool PDFImageConversion::convert()
         return false;
     }
 
-    QImage bitonal(m_image.width(), m_image.height(), QImage::Format_Mono);
-    bitonal.fill(0);
+    const QImage image = m_image.convertToFormat(QImage::Format_ARGB32);
+    const int width = image.width();
+    const int height = image.height();
+    std::vector<uint8_t> lightness(width, 0);
 
     // Thresholding
     int threshold = DEFAULT_THRESHOLD;
@@ -44,9 +47,23 @@ bool PDFImageConversion::convert()
     switch (m_conversionMethod)
     {
         case pdf::PDFImageConversion::ConversionMethod::Automatic:
-            m_automaticThreshold = calculateOtsu1DThreshold();
+        {
+            // Histogram of lightness occurences
+            std::array<int, 256> histogram = { };
+
+            for (int y = 0; y < height; ++y)
+            {
+                calculateLightness(reinterpret_cast<const QRgb*>(image.constScanLine(y)), lightness.data(), width);
+                for (uint8_t value : lightness)
+                {
+                    ++histogram[value];
+                }
+            }
+
+            m_automaticThreshold = calculateOtsu1DThreshold(histogram, width * height);
             threshold = m_automaticThreshold;
             break;
+        }
 
         case pdf::PDFImageConversion::ConversionMethod::Manual:
             threshold = m_manualThreshold;
@@ -57,14 +74,39 @@ bool PDFImageConversion::convert()
             break;
     }
 
-    for (int y = 0; y < m_image.height(); ++y)
+    // Monochrome image has default color table, where index 0 is black
+    // and index 1 is white, pixels are stored from the most significant bit.
+    QImage bitonal(width, height, QImage::Format_Mono);
+    bitonal.fill(0);
+
+    const int thresholdValue = qBound(0, threshold, 256);
+
+    for (int y = 0; y < height; ++y)
     {
-        for (int x = 0; x < m_image.width(); ++x)
+        uchar* bitonalLine = bitonal.scanLine(y);
+        calculateLightness(reinterpret_cast<const QRgb*>(image.constScanLine(y)), lightness.data(), width);
+
+        // Pack eight pixels into one byte, this loop is simple
+        // enough to be vectorized by the compiler.
+        const int fullBytes = width / 8;
+        const uint8_t* lightnessLine = lightness.data();
+        for (int i = 0; i < fullBytes; ++i)
+        {
+            const uint8_t* values = lightnessLine + i * 8;
+            uchar byte = 0;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                byte |= uchar(int(values[bit]) >= thresholdValue) << (7 - bit);
+            }
+            bitonalLine[i] = byte;
+        }
+
+        for (int x = fullBytes * 8; x < width; ++x)
         {
-            QColor pixelColor = m_image.pixelColor(x, y);
-            int pixelValue = pixelColor.lightness();
-            bool bit = (pixelValue >= threshold);
-            bitonal.setPixel(x, y, bit);
+            if (int(lightnessLine[x]) >= thresholdValue)
+            {
+                bitonalLine[x / 8] |= uchar(0x80 >> (x % 8));
+            }
         }
     }
 
@@ -72,6 +114,22 @@ bool PDFImageConversion::convert()
     return true;
 }
 
+void PDFImageConversion::calculateLightness(const QRgb* pixels, uint8_t* lightness, int count)
+{
+    // Lightness is computed in the same way as QColor::lightness(),
+    // i.e. average of maximal and minimal color component.
+    for (int i = 0; i < count; ++i)
+    {
+        const QRgb pixel = pixels[i];
+        const int red = qRed(pixel);
+        const int green = qGreen(pixel);
+        const int blue = qBlue(pixel);
+        const int maximum = qMax(red, qMax(green, blue));
+        const int minimum = qMin(red, qMin(green, blue));
+        lightness[i] = uint8_t((maximum + minimum + 1) / 2);
+    }
+}
+
 int PDFImageConversion::getThreshold() const
 {
     switch (m_conversionMethod)
@@ -95,29 +153,14 @@ QImage PDFImageConversion::getConvertedImage() const
     return m_convertedImage;
 }
 
-int PDFImageConversion::calculateOtsu1DThreshold() const
+int PDFImageConversion::calculateOtsu1DThreshold(const std::array<int, 256>& histogram, int pixelCount)
 {
-    if (m_image.isNull())
+    if (pixelCount <= 0)
     {
-        return 128;
-    }
-
-    // Histogram of lightness occurences
-    std::array<int, 256> histogram = { };
-
-    for (int x = 0; x < m_image.width(); ++x)
-    {
-        for (int y = 0; y < m_image.height(); ++y)
-        {
-            int lightness = m_image.pixelColor(x, y).lightness();
-            Q_ASSERT(lightness >= 0 && lightness <= 255);
-
-            int clampedLightness = qBound(0, lightness, 255);
-            histogram[clampedLightness] += 1;
-        }
+        return DEFAULT_THRESHOLD;
     }
 
-    float factor = 1.0f / float(m_image.width() * m_image.height());
+    float factor = 1.0f / float(pixelCount);
 
     std::array<float, 256> normalizedHistogram = { };
     std::array<float, 256> cumulativeProbabilities = { };
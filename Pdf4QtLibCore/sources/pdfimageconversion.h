@@ -22,6 +22,8 @@
 
 #include <QImage>
 
+#include <array>
+
 namespace pdf
 {
 
@@ -81,7 +83,11 @@ public:
     QImage getConvertedImage() const;
 
 private:
-    int calculateOtsu1DThreshold() const;
+    /// Calculates threshold using Otsu's 1D algorithm from the lightness histogram
+    static int calculateOtsu1DThreshold(const std::array<int, 256>& histogram, int pixelCount);
+
+    /// Calculates lightness (in the same way as QColor) of the pixels
+    static void calculateLightness(const QRgb* pixels, uint8_t* lightness, int count);
 
     static constexpr int DEFAULT_THRESHOLD = 128;
 
@@ -200,7 +200,186 @@ PDFJavaScriptScanner::Entries PDFJavaScriptScanner::scan(const std::vector<PDFIn
 
 bool PDFJavaScriptScanner::hasJavaScript() const
 {
-    return !scan({ }, Options(AllPages | FindFirstOnly | ScanDocument | ScanNamed | ScanForm | ScanPage)).empty();
+    // Document actions and named java scripts are parsed with the catalog
+    if (!scan({ }, Options(FindFirstOnly | ScanDocument | ScanNamed)).empty())
+    {
+        return true;
+    }
+
+    const PDFObjectStorage* storage = &m_document->getStorage();
+    const PDFCatalog* catalog = m_document->getCatalog();
+
+    if (const PDFDictionary* formDictionary = storage->getDictionaryFromObject(catalog->getFormObject()))
+    {
+        std::set<PDFObjectReference> usedReferences;
+        if (hasFormFieldJavaScript(formDictionary->get("Fields"), usedReferences))
+        {
+            return true;
+        }
+    }
+
+    PDFDocumentDataLoaderDecorator loader(storage);
+    const size_t pageCount = catalog->getPageCount();
+    for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex)
+    {
+        const PDFPage* page = catalog->getPage(pageIndex);
+        if (hasJavaScriptAction(page->getAdditionalActions(storage), PDFObject()))
+        {
+            return true;
+        }
+
+        for (PDFObjectReference annotationReference : page->getAnnotations())
+        {
+            const PDFDictionary* annotationDictionary = storage->getDictionaryFromObject(storage->getObjectByReference(annotationReference));
+            if (!annotationDictionary)
+            {
+                continue;
+            }
+
+            // Only annotations with actions are examined, in the same way, as in the scan function
+            const QByteArray subtype = loader.readNameFromDictionary(annotationDictionary, "Subtype");
+            if (subtype == "Link")
+            {
+                std::set<PDFObjectReference> usedReferences;
+                if (isJavaScriptAction(annotationDictionary->get("A"), usedReferences))
+                {
+                    return true;
+                }
+            }
+            else if (subtype == "Screen" || subtype == "Widget")
+            {
+                if (hasJavaScriptAction(annotationDictionary->get("AA"), annotationDictionary->get("A")))
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+bool PDFJavaScriptScanner::isJavaScriptAction(const PDFObject& object, std::set<PDFObjectReference>& usedReferences) const
+{
+    const PDFObjectStorage* storage = &m_document->getStorage();
+
+    PDFObject actionObject = object;
+    if (object.isReference())
+    {
+        const PDFObjectReference reference = object.getReference();
+        if (!usedReferences.insert(reference).second)
+        {
+            // Cycle in the action chain
+            return false;
+        }
+
+        actionObject = storage->getObjectByReference(reference);
+    }
+
+    // Next actions can be stored in the array
+    if (const PDFArray* actionArray = actionObject.isArray() ? actionObject.getArray() : nullptr)
+    {
+        for (size_t i = 0; i < actionArray->getCount(); ++i)
+        {
+            if (isJavaScriptAction(actionArray->getItem(i), usedReferences))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const PDFDictionary* actionDictionary = storage->getDictionaryFromObject(actionObject);
+    if (!actionDictionary)
+    {
+        return false;
+    }
+
+    PDFDocumentDataLoaderDecorator loader(storage);
+    const QByteArray type = loader.readNameFromDictionary(actionDictionary, "S");
+    if (type == "JavaScript")
+    {
+        return true;
+    }
+
+    if (type == "Rendition")
+    {
+        // Rendition action is java script action only, if it has nonempty script
+        const PDFObject& javaScriptObject = storage->getObject(actionDictionary->get("JS"));
+        if ((javaScriptObject.isString() && !javaScriptObject.getString().isEmpty()) ||
+            (javaScriptObject.isStream() && !javaScriptObject.getStream()->getContent()->isEmpty()))
+        {
+            return true;
+        }
+    }
+
+    return isJavaScriptAction(actionDictionary->get("Next"), usedReferences);
+}
+
+bool PDFJavaScriptScanner::hasJavaScriptAction(const PDFObject& additionalActionsObject, const PDFObject& actionObject) const
+{
+    std::set<PDFObjectReference> usedReferences;
+    if (isJavaScriptAction(actionObject, usedReferences))
+    {
+        return true;
+    }
+
+    const PDFObjectStorage* storage = &m_document->getStorage();
+    if (const PDFDictionary* additionalActionsDictionary = storage->getDictionaryFromObject(additionalActionsObject))
+    {
+        for (size_t i = 0; i < additionalActionsDictionary->getCount(); ++i)
+        {
+            usedReferences.clear();
+            if (isJavaScriptAction(additionalActionsDictionary->getValue(i), usedReferences))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool PDFJavaScriptScanner::hasFormFieldJavaScript(const PDFObject& object, std::set<PDFObjectReference>& usedReferences) const
+{
+    const PDFObjectStorage* storage = &m_document->getStorage();
+
+    PDFObject fieldObject = object;
+    if (object.isReference())
+    {
+        const PDFObjectReference reference = object.getReference();
+        if (!usedReferences.insert(reference).second)
+        {
+            // Cycle in the field tree
+            return false;
+        }
+
+        fieldObject = storage->getObjectByReference(reference);
+    }
+
+    // Array of fields (Fields entry of the form, or Kids entry of the field)
+    if (const PDFArray* fieldArray = fieldObject.isArray() ? fieldObject.getArray() : nullptr)
+    {
+        for (size_t i = 0; i < fieldArray->getCount(); ++i)
+        {
+            if (hasFormFieldJavaScript(fieldArray->getItem(i), usedReferences))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const PDFDictionary* fieldDictionary = storage->getDictionaryFromObject(fieldObject);
+    if (!fieldDictionary)
+    {
+        return false;
+    }
+
+    return hasJavaScriptAction(fieldDictionary->get("AA"), fieldDictionary->get("A")) ||
+           hasFormFieldJavaScript(fieldDictionary->get("Kids"), usedReferences);
 }
 
 }   // namespace pdf
@@ -81,11 +81,30 @@ public:
     /// Scans document for javascript actions using flags
     Entries scan(const std::vector<PDFInteger>& pages, Options options)  const;
 
-    /// Returns true, if document has any java script action. Calling
-    /// this function can be slow.
+    /// Returns true, if document has any java script action. Unlike \p scan,
+    /// this function doesn't parse forms and annotations, it just examines
+    /// action dictionaries (without decoding of scripts), and stops, when first
+    /// java script action is found. So only objects on the path to the actions
+    /// (fields, annotation dictionaries and actions) are dereferenced.
     bool hasJavaScript() const;
 
 private:
+    /// Returns true, if action (or some of its next actions) is java script action.
+    /// \param object Action object (dictionary, reference or array of actions)
+    /// \param usedReferences Visited references (to avoid cycles in next actions)
+    bool isJavaScriptAction(const PDFObject& object, std::set<PDFObjectReference>& usedReferences) const;
+
+    /// Returns true, if some of additional actions (or action, if \p actionObject
+    /// is not null) is java script action.
+    /// \param additionalActionsObject Dictionary of additional actions
+    /// \param actionObject Action object
+    bool hasJavaScriptAction(const PDFObject& additionalActionsObject, const PDFObject& actionObject) const;
+
+    /// Returns true, if form field (or some of its kids) has java script action
+    /// \param object Form field object
+    /// \param usedReferences Visited references (to avoid cycles in the field tree)
+    bool hasFormFieldJavaScript(const PDFObject& object, std::set<PDFObjectReference>& usedReferences) const;
+
     const PDFDocument* m_document;
 };
 
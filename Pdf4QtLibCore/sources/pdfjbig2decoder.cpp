@@ -1119,21 +1119,21 @@ PDFImageData PDFJBIG2Decoder::decode(PDFImageData::MaskingType maskingType)
 
     if (m_pageBitmap.isValid())
     {
-        PDFBitWriter writer(1);
-
         const int columns = m_pageBitmap.getWidth();
         const int rows = m_pageBitmap.getHeight();
+        const int stride = m_pageBitmap.getStride();
 
+        // Bitmap has set bit for black pixels, image data have zero for black
+        // pixels, so we just invert packed rows of the bitmap.
+        QByteArray data(stride * rows, Qt::Uninitialized);
+        uint8_t* output = reinterpret_cast<uint8_t*>(data.data());
         for (int row = 0; row < rows; ++row)
         {
-            for (int column = 0; column < columns; ++column)
-            {
-                writer.write(!m_pageBitmap.getPixel(column, row));
-            }
-            writer.finishLine();
+            const uint8_t* input = m_pageBitmap.getRow(row);
+            std::transform(input, input + stride, output + row * stride, [](uint8_t value) { return static_cast<uint8_t>(~value); });
         }
 
-        return PDFImageData(1, 1, static_cast<uint32_t>(columns), static_cast<uint32_t>(rows), static_cast<uint32_t>((columns + 7) / 8), maskingType, writer.takeByteArray(), { }, { }, { });
+        return PDFImageData(1, 1, static_cast<uint32_t>(columns), static_cast<uint32_t>(rows), static_cast<uint32_t>(stride), maskingType, qMove(data), { }, { }, { });
     }
 
     return PDFImageData();
@@ -2864,16 +2864,18 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::readBitmap(PDFJBIG2BitmapDecodingParameters& par
 
         PDFJBIG2Bitmap bitmap(data.getWidth(), data.getHeight(), m_pageDefaultPixelValue);
 
-        // Copy the data
-        PDFBitReader reader(&data.getData(), data.getBitsPerComponent());
-        for (unsigned int row = 0; row < data.getHeight(); ++row)
-        {
-            for (unsigned int column = 0; column < data.getWidth(); ++column)
-            {
-                bitmap.setPixel(column, row, (reader.read()) ? 0x00 : 0xFF);
-            }
+        // Copy the data. Decoder produces packed rows with the same layout as
+        // the bitmap, but with zero for black pixels, so we invert them.
+        const QByteArray& decodedData = data.getData();
+        const int stride = bitmap.getStride();
+        Q_ASSERT(data.getStride() == static_cast<unsigned int>(stride));
 
-            reader.alignToBytes();
+        const uint8_t* input = reinterpret_cast<const uint8_t*>(decodedData.constData());
+        const int rows = qMin(bitmap.getHeight(), static_cast<int>(decodedData.size() / qMax(stride, 1)));
+        for (int row = 0; row < rows; ++row)
+        {
+            const uint8_t* inputRow = input + row * stride;
+            std::transform(inputRow, inputRow + stride, bitmap.getRow(row), [](uint8_t value) { return static_cast<uint8_t>(~value); });
         }
 
         return bitmap;
@@ -2983,6 +2985,157 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::readBitmap(PDFJBIG2BitmapDecodingParameters& par
         Q_ASSERT(parameters.arithmeticDecoder);
         PDFJBIG2ArithmeticDecoder& decoder = *parameters.arithmeticDecoder;
 
+        // Pixel context is composed from pixels of the current row, two previous rows
+        // and adaptive template pixels. Templates are following (bit 0 is the lowest
+        // bit of the context, A is adaptive template pixel, X is decoded pixel):
+        //
+        //  Template 0 (16-bit context):   Template 1 (13-bit context):
+        //          ┌───┬───┬───┬───┬───┐          ┌───┬───┬───┬───┐
+        //          │A15│ 14│ 13│ 12│A11│          │ 12│ 11│ 10│ 9 │
+        //      ┌───┼───┼───┼───┼───┼───┼───┐  ┌───┼───┼───┼───┼───┼───┐
+        //      │A10│ 9 │ 8 │ 7 │ 6 │ 5 │A4 │  │ 8 │ 7 │ 6 │ 5 │ 4 │A3 │
+        //  ┌───┼───┼───┼───┼───┼───┴───┴───┘  ├───┼───┼───┼───┴───┴───┘
+        //  │ 3 │ 2 │ 1 │ 0 │ X │              │ 2 │ 1 │ 0 │ X │
+        //  └───┴───┴───┴───┴───┘              └───┴───┴───┴───┘
+        //
+        //  Template 2 (10-bit context):   Template 3 (10-bit context):
+        //          ┌───┬───┬───┐              ┌───┬───┬───┬───┬───┬───┐
+        //          │ 9 │ 8 │ 7 │              │ 9 │ 8 │ 7 │ 6 │ 5 │A4 │
+        //      ┌───┼───┼───┼───┼───┐      ┌───┼───┼───┼───┼───┼───┴───┘
+        //      │ 6 │ 5 │ 4 │ 3 │A2 │      │ 3 │ 2 │ 1 │ 0 │ X │
+        //      ├───┼───┼───┼───┴───┘      └───┴───┴───┴───┴───┘
+        //      │ 1 │ 0 │ X │
+        //      └───┴───┴───┘
+        //
+        // Pixels of each row are shifted into the register (lowest bit is the rightmost
+        // pixel), so context of the next pixel is obtained by shifting the registers
+        // by one pixel, instead of reading all context pixels from the bitmap.
+        struct ContextRow
+        {
+            int offsetY = 0;            ///< Vertical offset of the row
+            int lastPixelOffset = 0;    ///< Horizontal offset of the rightmost template pixel
+            int pixelCount = 0;         ///< Count of template pixels in the row
+            int contextShift = 0;       ///< Position of the row pixels in the context
+            int lookahead = -1;         ///< Horizontal offset of the pixel in the lowest bit of the register
+            uint32_t pixels = 0;        ///< Register with pixels of the row
+        };
+
+        struct ContextATPixel
+        {
+            int offsetX = 0;            ///< Horizontal offset of the pixel
+            int offsetY = 0;            ///< Vertical offset of the pixel
+            int contextShift = 0;       ///< Position of the pixel in the context
+            int rowIndex = -1;          ///< Index of the row, whose register contains the pixel (or -1)
+            int registerShift = 0;      ///< Position of the pixel in the register of the row
+        };
+
+        std::array<ContextRow, 3> rows;
+        std::array<ContextATPixel, 4> atPixels;
+        size_t atPixelCount = 0;
+
+        rows[0].offsetY = 0;
+        rows[1].offsetY = -1;
+        rows[2].offsetY = -2;
+
+        auto setRow = [&rows](size_t index, int lastPixelOffset, int pixelCount, int contextShift)
+        {
+            rows[index].lastPixelOffset = lastPixelOffset;
+            rows[index].pixelCount = pixelCount;
+            rows[index].contextShift = contextShift;
+        };
+
+        auto addATPixel = [&](size_t index, int contextShift)
+        {
+            ContextATPixel& atPixel = atPixels[atPixelCount++];
+            atPixel.offsetX = parameters.GBAT[index].x;
+            atPixel.offsetY = parameters.GBAT[index].y;
+            atPixel.contextShift = contextShift;
+        };
+
+        switch (parameters.GBTEMPLATE)
+        {
+            case 0:
+                setRow(0, -1, 4, 0);
+                setRow(1, 2, 5, 5);
+                setRow(2, 1, 3, 12);
+                addATPixel(0, 4);
+                addATPixel(1, 10);
+                addATPixel(2, 11);
+                addATPixel(3, 15);
+                break;
+
+            case 1:
+                setRow(0, -1, 3, 0);
+                setRow(1, 2, 5, 4);
+                setRow(2, 2, 4, 9);
+                addATPixel(0, 3);
+                break;
+
+            case 2:
+                setRow(0, -1, 2, 0);
+                setRow(1, 1, 4, 3);
+                setRow(2, 1, 3, 7);
+                addATPixel(0, 2);
+                break;
+
+            case 3:
+                setRow(0, -1, 4, 0);
+                setRow(1, 1, 5, 5);
+                setRow(2, 0, 0, 0);
+                addATPixel(0, 4);
+                break;
+
+            default:
+                Q_ASSERT(false);
+                break;
+        }
+
+        // Previous rows have lookahead at least to the rightmost template pixel. If adaptive
+        // template pixel lies a little bit right of it, we extend the lookahead, so adaptive
+        // template pixel can also be taken from the register.
+        constexpr int MAX_LOOKAHEAD = 16;
+        constexpr int REGISTER_BITS = 32;
+
+        for (size_t i = 1; i < rows.size(); ++i)
+        {
+            rows[i].lookahead = rows[i].lastPixelOffset;
+        }
+
+        for (size_t i = 0; i < atPixelCount; ++i)
+        {
+            const ContextATPixel& atPixel = atPixels[i];
+            if (atPixel.offsetY < 0 && atPixel.offsetY >= -2 && atPixel.offsetX <= MAX_LOOKAHEAD)
+            {
+                ContextRow& row = rows[-atPixel.offsetY];
+                row.lookahead = qMax(row.lookahead, int(atPixel.offsetX));
+            }
+        }
+
+        for (size_t i = 0; i < atPixelCount; ++i)
+        {
+            ContextATPixel& atPixel = atPixels[i];
+            if (atPixel.offsetY <= 0 && atPixel.offsetY >= -2)
+            {
+                const ContextRow& row = rows[-atPixel.offsetY];
+                const int registerShift = row.lookahead - atPixel.offsetX;
+                if (registerShift >= 0 && registerShift < REGISTER_BITS)
+                {
+                    atPixel.rowIndex = -atPixel.offsetY;
+                    atPixel.registerShift = registerShift;
+                }
+            }
+        }
+
+        // Previous rows, from which pixels are read (current row is filled by decoded pixels)
+        size_t previousRowCount = (rows[2].pixelCount > 0) ? 2 : 1;
+        for (size_t i = 0; i < atPixelCount; ++i)
+        {
+            if (atPixels[i].rowIndex == 2)
+            {
+                previousRowCount = 2;
+            }
+        }
+
         PDFJBIG2Bitmap bitmap(parameters.GBW, parameters.GBH, 0x00);
         for (int y = 0; y < parameters.GBH; ++y)
         {
@@ -3000,147 +3153,64 @@ PDFJBIG2Bitmap PDFJBIG2Decoder::readBitmap(PDFJBIG2BitmapDecodingParameters& par
                 }
             }
 
+            // Fill registers with pixels left of the lookahead pixel
+            // of the first pixel of the row (pixels outside bitmap are zero).
+            rows[0].pixels = 0;
+            for (size_t i = 1; i <= previousRowCount; ++i)
+            {
+                ContextRow& row = rows[i];
+                row.pixels = 0;
+                for (int x = 0; x < row.lookahead; ++x)
+                {
+                    row.pixels = (row.pixels << 1) | (bitmap.getPixelSafe(x, y + row.offsetY) ? 1 : 0);
+                }
+            }
+
             for (int x = 0; x < parameters.GBW; ++x)
             {
+                for (size_t i = 1; i <= previousRowCount; ++i)
+                {
+                    ContextRow& row = rows[i];
+                    row.pixels = (row.pixels << 1) | (bitmap.getPixelSafe(x + row.lookahead, y + row.offsetY) ? 1 : 0);
+                }
+
                 // Check, if we have to skip pixel. Pixel should be set to 0, but it is done
                 // in the initialization of the bitmap.
                 if (parameters.SKIP && parameters.SKIP->getPixelSafe(x, y))
                 {
+                    rows[0].pixels = rows[0].pixels << 1;
                     continue;
                 }
 
-                uint16_t pixelContext = 0;
-                uint16_t pixelContextShift = 0;
-                auto createContextBit = [&](int offsetX, int offsetY)
-                {
-                    uint16_t bit = bitmap.getPixelSafe(offsetX, offsetY) ? 1 : 0;
-                    bit = bit << pixelContextShift;
-                    pixelContext |= bit;
-                    ++pixelContextShift;
-                };
-
-                // Create pixel context based on used template
-                switch (parameters.GBTEMPLATE)
+                uint32_t pixelContext = 0;
+                for (const ContextRow& row : rows)
                 {
-                    case 0:
-                    {
-                        //  Figure 8. Reused context for coding the SLTP value
-                        //
-                        //          ┌───┬───┬───┬───┬───┐
-                        //          │A15│ 14│ 13│ 12│A11│
-                        //      ┌───┼───┼───┼───┼───┼───┼───┐
-                        //      │A10│ 9 │ 8 │ 7 │ 6 │ 5 │A4 │
-                        //  ┌───┼───┼───┼───┼───┼───┴───┴───┘
-                        //  │ 3 │ 2 │ 1 │ 0 │ X │
-                        //  └───┴───┴───┴───┴───┘
-
-                        // 16-bit context
-                        createContextBit(x - 1, y);
-                        createContextBit(x - 2, y);
-                        createContextBit(x - 3, y);
-                        createContextBit(x - 4, y);
-                        createContextBit(x + parameters.GBAT[0].x, y + parameters.GBAT[0].y);
-                        createContextBit(x + 2, y - 1);
-                        createContextBit(x + 1, y - 1);
-                        createContextBit(x + 0, y - 1);
-                        createContextBit(x - 1, y - 1);
-                        createContextBit(x - 2, y - 1);
-                        createContextBit(x + parameters.GBAT[1].x, y + parameters.GBAT[1].y);
-                        createContextBit(x + parameters.GBAT[2].x, y + parameters.GBAT[2].y);
-                        createContextBit(x + 1, y - 2);
-                        createContextBit(x + 0, y - 2);
-                        createContextBit(x - 1, y - 2);
-                        createContextBit(x + parameters.GBAT[3].x, y + parameters.GBAT[3].y);
-                        break;
-                    }
+                    const uint32_t rowPixels = (row.pixels >> (row.lookahead - row.lastPixelOffset)) & ((1u << row.pixelCount) - 1);
+                    pixelContext |= rowPixels << row.contextShift;
+                }
 
-                    case 1:
+                for (size_t i = 0; i < atPixelCount; ++i)
+                {
+                    const ContextATPixel& atPixel = atPixels[i];
+                    uint32_t bit = 0;
+                    if (atPixel.rowIndex >= 0)
                     {
-                        //  Figure 9. Reused context for coding the SLTP value
-                        //
-                        //          ┌───┬───┬───┬───┐
-                        //          │ 12│ 11│ 10│ 9 │
-                        //      ┌───┼───┼───┼───┼───┼───┐
-                        //      │ 8 │ 7 │ 6 │ 5 │ 4 │A3 │
-                        //  ┌───┼───┼───┼───┼───┴───┴───┘
-                        //  │ 2 │ 1 │ 0 │ x │
-                        //  └───┴───┴───┴───┘
-
-                        // 13-bit context
-                        createContextBit(x - 1, y);
-                        createContextBit(x - 2, y);
-                        createContextBit(x - 3, y);
-                        createContextBit(x + parameters.GBAT[0].x, y + parameters.GBAT[0].y);
-                        createContextBit(x + 2, y - 1);
-                        createContextBit(x + 1, y - 1);
-                        createContextBit(x + 0, y - 1);
-                        createContextBit(x - 1, y - 1);
-                        createContextBit(x - 2, y - 1);
-                        createContextBit(x + 2, y - 2);
-                        createContextBit(x + 1, y - 2);
-                        createContextBit(x + 0, y - 2);
-                        createContextBit(x - 1, y - 2);
-                        break;
+                        bit = (rows[atPixel.rowIndex].pixels >> atPixel.registerShift) & 1;
                     }
-
-                    case 2:
+                    else
                     {
-                        //  Figure 10. Reused context for coding the SLTP value
-                        //
-                        //          ┌───┬───┬───┐
-                        //          │ 9 │ 8 │ 7 │
-                        //      ┌───┼───┼───┼───┼───┐
-                        //      │ 6 │ 5 │ 4 │ 3 │A2 │
-                        //      ├───┼───┼───┼───┴───┘
-                        //      │ 1 │ 0 │ x │
-                        //      └───┴───┴───┘
-
-                        // 10-bit context
-                        createContextBit(x - 1, y);
-                        createContextBit(x - 2, y);
-                        createContextBit(x + parameters.GBAT[0].x, y + parameters.GBAT[0].y);
-                        createContextBit(x + 1, y - 1);
-                        createContextBit(x + 0, y - 1);
-                        createContextBit(x - 1, y - 1);
-                        createContextBit(x - 2, y - 1);
-                        createContextBit(x + 1, y - 2);
-                        createContextBit(x + 0, y - 2);
-                        createContextBit(x - 1, y - 2);
-                        break;
+                        bit = bitmap.getPixelSafe(x + atPixel.offsetX, y + atPixel.offsetY) ? 1 : 0;
                     }
+                    pixelContext |= bit << atPixel.contextShift;
+                }
 
-                    case 3:
-                    {
-                        //  Figure 11. Reused context for coding the SLTP value
-                        //
-                        //          ┌───┬───┬───┬───┬───┬───┐
-                        //          │ 9 │ 8 │ 7 │ 6 │ 5 │A4 │
-                        //      ┌───┼───┼───┼───┼───┼───┴───┘
-                        //      │ 3 │ 2 │ 1 │ 0 │ x │
-                        //      └───┴───┴───┴───┴───┘
-
-                        // 10-bit context
-                        createContextBit(x - 1, y);
-                        createContextBit(x - 2, y);
-                        createContextBit(x - 3, y);
-                        createContextBit(x - 4, y);
-                        createContextBit(x + parameters.GBAT[0].x, y + parameters.GBAT[0].y);
-                        createContextBit(x + 1, y - 1);
-                        createContextBit(x + 0, y - 1);
-                        createContextBit(x - 1, y - 1);
-                        createContextBit(x - 2, y - 1);
-                        createContextBit(x - 3, y - 1);
-                        break;
-                    }
+                const uint32_t bit = decoder.readBit(pixelContext, parameters.arithmeticDecoderState);
+                rows[0].pixels = (rows[0].pixels << 1) | bit;
 
-                    default:
-                    {
-                        Q_ASSERT(false);
-                        break;
-                    }
+                if (bit)
+                {
+                    bitmap.setPixel(x, y, 0xFF);
                 }
-
-                bitmap.setPixel(x, y, (decoder.readBit(pixelContext, parameters.arithmeticDecoderState)) ? 0xFF : 0x00);
             }
         }
 
@@ -3636,23 +3706,26 @@ int32_t PDFJBIG2Decoder::checkInteger(std::optional<int32_t> value)
 
 PDFJBIG2Bitmap::PDFJBIG2Bitmap() :
     m_width(0),
-    m_height(0)
+    m_height(0),
+    m_stride(0)
 {
 
 }
 
 PDFJBIG2Bitmap::PDFJBIG2Bitmap(int width, int height) :
     m_width(width),
-    m_height(height)
+    m_height(height),
+    m_stride((width + 7) / 8)
 {
-    m_data.resize(width * height, 0);
+    m_data.resize(m_stride * height, 0);
 }
 
 PDFJBIG2Bitmap::PDFJBIG2Bitmap(int width, int height, uint8_t fill) :
     m_width(width),
-    m_height(height)
+    m_height(height),
+    m_stride((width + 7) / 8)
 {
-    m_data.resize(width * height, fill);
+    m_data.resize(m_stride * height, fill ? 0xFF : 0x00);
 }
 
 PDFJBIG2Bitmap::~PDFJBIG2Bitmap()
@@ -3663,16 +3736,32 @@ PDFJBIG2Bitmap::~PDFJBIG2Bitmap()
 PDFJBIG2Bitmap PDFJBIG2Bitmap::getSubbitmap(int offsetX, int offsetY, int width, int height) const
 {
     PDFJBIG2Bitmap result(width, height, 0x00);
+    result.paint(*this, -offsetX, -offsetY, PDFJBIG2BitOperation::Replace, false, 0x00);
+    return result;
+}
 
-    for (int y = 0; y < height; ++y)
+uint8_t PDFJBIG2Bitmap::readByte(const uint8_t* row, int x) const
+{
+    if (x < 0)
     {
-        for (int x = 0; x < width; ++x)
-        {
-            result.setPixel(x, y, getPixelSafe(x + offsetX, y + offsetY));
-        }
+        Q_ASSERT(x > -8);
+        return row[0] >> (-x);
     }
 
-    return result;
+    const int index = x >> 3;
+    const int shift = x & 7;
+
+    if (index >= m_stride)
+    {
+        return 0;
+    }
+
+    uint8_t value = row[index] << shift;
+    if (shift > 0 && index + 1 < m_stride)
+    {
+        value |= row[index + 1] >> (8 - shift);
+    }
+    return value;
 }
 
 void PDFJBIG2Bitmap::paint(const PDFJBIG2Bitmap& bitmap, int offsetX, int offsetY, PDFJBIG2BitOperation operation, bool expandY, const uint8_t expandPixel)
@@ -3686,56 +3775,79 @@ void PDFJBIG2Bitmap::paint(const PDFJBIG2Bitmap& bitmap, int offsetX, int offset
     if (expandY && offsetY + bitmap.getHeight() > m_height)
     {
         m_height = offsetY + bitmap.getHeight();
-        m_data.resize(getPixelCount(), expandPixel);
+        m_data.resize(m_stride * m_height, expandPixel ? 0xFF : 0x00);
     }
 
-    // Check out pathological cases
-    if (offsetX >= m_width || offsetY >= m_height)
+    switch (operation)
     {
-        return;
+        case PDFJBIG2BitOperation::Or:
+        case PDFJBIG2BitOperation::And:
+        case PDFJBIG2BitOperation::Xor:
+        case PDFJBIG2BitOperation::NotXor:
+        case PDFJBIG2BitOperation::Replace:
+            break;
+
+        default:
+            throw PDFException(PDFTranslationContext::tr("JBIG2 - invalid bitmap paint operation."));
     }
 
-    const int targetStartX = offsetX;
+    const int targetStartX = qMax(offsetX, 0);
     const int targetEndX = qMin(offsetX + bitmap.getWidth(), m_width);
-    const int targetStartY = offsetY;
+    const int targetStartY = qMax(offsetY, 0);
     const int targetEndY = qMin(offsetY + bitmap.getHeight(), m_height);
 
+    // Check out pathological cases
+    if (targetStartX >= targetEndX || targetStartY >= targetEndY)
+    {
+        return;
+    }
+
+    // Pixels are combined by whole bytes (8 pixels at once). Source pixels are
+    // aligned to the target bytes, boundary bytes are masked, so pixels outside
+    // of the paint area are not changed.
+    const int startByte = targetStartX >> 3;
+    const int endByte = (targetEndX - 1) >> 3;
+
     for (int targetY = targetStartY; targetY < targetEndY; ++targetY)
     {
-        for (int targetX = targetStartX; targetX < targetEndX; ++targetX)
+        const uint8_t* sourceRow = bitmap.getRow(targetY - offsetY);
+        uint8_t* targetRow = getRow(targetY);
+
+        for (int byteIndex = startByte; byteIndex <= endByte; ++byteIndex)
         {
-            const int sourceX = targetX - targetStartX;
-            const int sourceY = targetY - targetStartY;
+            const int byteStartX = byteIndex * 8;
+            const int maskStartX = qMax(byteStartX, targetStartX) - byteStartX;
+            const int maskEndX = byteStartX + 8 - qMin(byteStartX + 8, targetEndX);
+            const uint8_t mask = (0xFF >> maskStartX) & static_cast<uint8_t>(0xFF << maskEndX);
 
-            if (targetX < 0 || targetX >= m_width || targetY < 0 || targetY >= m_height)
-            {
-                continue;
-            }
+            const uint8_t source = bitmap.readByte(sourceRow, byteStartX - offsetX);
+            uint8_t& target = targetRow[byteIndex];
 
             switch (operation)
             {
                 case PDFJBIG2BitOperation::Or:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) | bitmap.getPixel(sourceX, sourceY));
+                    target |= source & mask;
                     break;
 
                 case PDFJBIG2BitOperation::And:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) & bitmap.getPixel(sourceX, sourceY));
+                    target &= source | ~mask;
                     break;
 
                 case PDFJBIG2BitOperation::Xor:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) ^ bitmap.getPixel(sourceX, sourceY));
+                    target ^= source & mask;
                     break;
 
                 case PDFJBIG2BitOperation::NotXor:
-                    setPixel(targetX, targetY, getPixel(targetX, targetY) ^ (~bitmap.getPixel(sourceX, sourceY)));
+                    target ^= ~source & mask;
                     break;
 
                 case PDFJBIG2BitOperation::Replace:
-                    setPixel(targetX, targetY, bitmap.getPixel(sourceX, sourceY));
+                    target = static_cast<uint8_t>((target & ~mask) | (source & mask));
                     break;
 
                 default:
-                    throw PDFException(PDFTranslationContext::tr("JBIG2 - invalid bitmap paint operation."));
+                    Q_ASSERT(false);
+                    break;
             }
         }
     }
@@ -3748,10 +3860,8 @@ void PDFJBIG2Bitmap::copyRow(int target, int source)
         throw PDFException(PDFTranslationContext::tr("JBIG2 - invalid bitmap copy row operation."));
     }
 
-    auto itSource = std::next(m_data.cbegin(), source * m_width);
-    auto itSourceEnd = std::next(itSource, m_width);
-    auto itTarget = std::next(m_data.begin(), target * m_width);
-    std::copy(itSource, itSourceEnd, itTarget);
+    const uint8_t* sourceRow = getRow(source);
+    std::copy(sourceRow, sourceRow + m_stride, getRow(target));
 }
 
 PDFJBIG2HuffmanCodeTable::PDFJBIG2HuffmanCodeTable(std::vector<PDFJBIG2HuffmanTableEntry>&& entries) :
@@ -337,8 +337,22 @@ public:
     inline int getWidth() const { return m_width; }
     inline int getHeight() const { return m_height; }
     inline int getPixelCount() const { return m_width * m_height; }
-    inline uint8_t getPixel(int x, int y) const { return m_data[y * m_width + x]; }
-    inline void setPixel(int x, int y, uint8_t value) { m_data[y * m_width + x] = value; }
+    inline uint8_t getPixel(int x, int y) const { return (m_data[y * m_stride + (x >> 3)] & (0x80 >> (x & 7))) ? 0xFF : 0x00; }
+
+    inline void setPixel(int x, int y, uint8_t value)
+    {
+        uint8_t& data = m_data[y * m_stride + (x >> 3)];
+        const uint8_t mask = 0x80 >> (x & 7);
+
+        if (value)
+        {
+            data |= mask;
+        }
+        else
+        {
+            data &= ~mask;
+        }
+    }
 
     inline uint8_t getPixelSafe(int x, int y) const
     {
@@ -350,12 +364,22 @@ public:
         return getPixel(x, y);
     }
 
-    inline void fill(uint8_t value) { std::fill(m_data.begin(), m_data.end(), value); }
+    inline void fill(uint8_t value) { std::fill(m_data.begin(), m_data.end(), value ? 0xFF : 0x00); }
     inline void fillZero() { fill(0); }
     inline void fillOne() { fill(0xFF); }
 
     inline bool isValid() const { return getPixelCount() > 0; }
 
+    /// Returns count of bytes of one row of the bitmap. Pixels are packed,
+    /// one bit per pixel, most significant bit is the leftmost pixel and
+    /// set bit means black pixel (so rows have the same layout as rows
+    /// of QImage::Format_Mono image). Rows are aligned to bytes.
+    inline int getStride() const { return m_stride; }
+
+    /// Returns packed data of the bitmap row (see \ref getStride)
+    inline const uint8_t* getRow(int y) const { return m_data.data() + y * m_stride; }
+    inline uint8_t* getRow(int y) { return m_data.data() + y * m_stride; }
+
     /// Returns subbitmap of this bitmap. If some pixels of subbitmap are outside
     /// of current bitmap, then they are reset to zero.
     /// \param offsetX Horizontal offset of subbitmap
@@ -381,8 +405,15 @@ public:
     void copyRow(int target, int source);
 
 private:
+    /// Reads 8 pixels of the row starting at given pixel. Pixels outside
+    /// of the row are zero. Pixel can be at most 7 pixels left of the row.
+    /// \param row Row data
+    /// \param x Horizontal position of the first pixel
+    inline uint8_t readByte(const uint8_t* row, int x) const;
+
     int m_width;
     int m_height;
+    int m_stride;
     std::vector<uint8_t> m_data;
 };
 
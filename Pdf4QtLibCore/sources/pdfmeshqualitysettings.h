@@ -55,6 +55,10 @@ struct PDFMeshQualitySettings
     /// Color tolerance - 1% by default
     PDFReal tolerance = 0.01;
 
+    /// Approximate color functions of axial and radial shadings by lookup table.
+    /// Error of the approximation is lesser than color tolerance.
+    bool approximateShadingFunctions = true;
+
     /// Test points to determine maximal curvature of the tensor product patch meshes
     PDFInteger patchTestPoints = 64;
 
@@ -68,6 +72,12 @@ struct PDFMeshQualitySettings
 
     /// Highter value of the surface curvature meshing resolution mapping. \sa patchResolutionMappingRatioLow
     PDFReal patchResolutionMappingRatioHigh = 0.9;
+
+    /// Maximal distance (in device space pixels) between the surface of the tensor product
+    /// patch and the mesh triangle, for which the triangle is considered flat. Flat triangles
+    /// with nearly constant color are not subdivided to the preferred mesh resolution.
+    /// Zero value turns off this adaptive subdivision.
+    PDFReal patchFlatnessTolerance = 0.5;
 };
 
 }   // namespace pdf
@@ -48,7 +48,106 @@ public:
         return result;
     }
 
+    /// Finds the value of the item with given key in the name tree. Tree is not
+    /// loaded, only nodes, whose limits (entry /Limits) contain the key, are visited,
+    /// and item is found in the leaf node using binary search. If key is not found,
+    /// then null object is returned.
+    /// \param storage Object storage
+    /// \param root Root of the name tree
+    /// \param key Key of the item
+    static PDFObject find(const PDFObjectStorage* storage, const PDFObject& root, const QByteArray& key)
+    {
+        return findImpl(storage, root, key, 0);
+    }
+
 private:
+    /// Maximal depth of the name tree (to avoid infinite recursion in cyclic trees)
+    static constexpr int MAX_DEPTH = 64;
+
+    static PDFObject findImpl(const PDFObjectStorage* storage, const PDFObject& root, const QByteArray& key, int depth)
+    {
+        const PDFDictionary* dictionary = storage->getDictionaryFromObject(root);
+        if (!dictionary || depth > MAX_DEPTH)
+        {
+            return PDFObject();
+        }
+
+        // Skip the node, if key is not in limits of the node
+        const PDFObject& limits = storage->getObject(dictionary->get("Limits"));
+        if (limits.isArray() && limits.getArray()->getCount() == 2)
+        {
+            const PDFObject& lowerLimit = storage->getObject(limits.getArray()->getItem(0));
+            const PDFObject& upperLimit = storage->getObject(limits.getArray()->getItem(1));
+
+            if (lowerLimit.isString() && upperLimit.isString() &&
+                (key < lowerLimit.getString() || upperLimit.getString() < key))
+            {
+                return PDFObject();
+            }
+        }
+
+        const PDFObject& namedItems = storage->getObject(dictionary->get("Names"));
+        if (namedItems.isArray())
+        {
+            const PDFArray* namedItemsArray = namedItems.getArray();
+            const size_t count = namedItemsArray->getCount() / 2;
+
+            auto getName = [storage, namedItemsArray](size_t index) -> QByteArray
+            {
+                const PDFObject& name = storage->getObject(namedItemsArray->getItem(2 * index));
+                return name.isString() ? name.getString() : QByteArray();
+            };
+
+            // Names should be sorted, so try binary search first
+            size_t low = 0;
+            size_t high = count;
+            while (low < high)
+            {
+                const size_t middle = low + (high - low) / 2;
+                if (getName(middle) < key)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+
+            if (low < count && getName(low) == key)
+            {
+                return namedItemsArray->getItem(2 * low + 1);
+            }
+
+            // Jakub Melka: Some producers do not sort the names,
+            // so if binary search fails, use linear search.
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (getName(i) == key)
+                {
+                    return namedItemsArray->getItem(2 * i + 1);
+                }
+            }
+        }
+
+        const PDFObject& kids = storage->getObject(dictionary->get("Kids"));
+        if (kids.isArray())
+        {
+            const PDFArray* kidsArray = kids.getArray();
+            const size_t count = kidsArray->getCount();
+            for (size_t i = 0; i < count; ++i)
+            {
+                PDFObject object = findImpl(storage, kidsArray->getItem(i), key, depth + 1);
+                if (!object.isNull())
+                {
+                    return object;
+                }
+            }
+        }
+
+        return PDFObject();
+    }
+
     static void parseImpl(MappedObjects& objects, const PDFObjectStorage* storage, const PDFObject& root, const LoadMethod& loadMethod)
     {
         if (const PDFDictionary* dictionary = storage->getDictionaryFromObject(root))
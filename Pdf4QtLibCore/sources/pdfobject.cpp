@@ -17,6 +17,13 @@
 
 #include "pdfobject.h"
 #include "pdfvisitor.h"
+
+#include <QHash>
+
+#include <bit>
+#include <deque>
+#include <utility>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -298,6 +305,7 @@ void PDFDictionary::removeEntry(const char* key)
     if (it != m_dictionary.end())
     {
         m_dictionary.erase(it);
+        rebuildIndex();
     }
 }
 
@@ -318,6 +326,7 @@ void PDFDictionary::removeNullObjects()
 {
     m_dictionary.erase(std::remove_if(m_dictionary.begin(), m_dictionary.end(), [](const DictionaryEntry& entry) { return entry.second.isNull(); }), m_dictionary.end());
     m_dictionary.shrink_to_fit();
+    rebuildIndex();
 }
 
 void PDFDictionary::optimize()
@@ -325,34 +334,132 @@ void PDFDictionary::optimize()
     m_dictionary.shrink_to_fit();
 }
 
+void PDFDictionary::rebuildIndex()
+{
+    m_index.clear();
+
+    if (m_dictionary.size() < INDEX_THRESHOLD)
+    {
+        m_index.shrink_to_fit();
+        return;
+    }
+
+    // Load factor of the table is at most 0.5, so probe sequences are short
+    m_index.resize(std::bit_ceil(m_dictionary.size() * 2), 0);
+    for (size_t i = 0; i < m_dictionary.size(); ++i)
+    {
+        insertToIndex(i);
+    }
+}
+
+void PDFDictionary::indexLastEntry()
+{
+    if (m_dictionary.size() < INDEX_THRESHOLD)
+    {
+        return;
+    }
+
+    if (m_index.size() < m_dictionary.size() * 2)
+    {
+        // Table is too small (or doesn't exist yet), new entry is indexed as well
+        rebuildIndex();
+    }
+    else
+    {
+        insertToIndex(m_dictionary.size() - 1);
+    }
+}
+
+void PDFDictionary::insertToIndex(size_t entryIndex)
+{
+    Q_ASSERT(!m_index.empty());
+
+    const PDFInplaceOrMemoryString& key = m_dictionary[entryIndex].first;
+    const size_t mask = m_index.size() - 1;
+
+    for (size_t slot = key.getHash() & mask;; slot = (slot + 1) & mask)
+    {
+        const uint32_t value = m_index[slot];
+
+        if (!value)
+        {
+            m_index[slot] = static_cast<uint32_t>(entryIndex + 1);
+            break;
+        }
+
+        if (m_dictionary[value - 1].first == key)
+        {
+            // Dictionary contains duplicate key, first entry is used
+            break;
+        }
+    }
+}
+
+template<typename Predicate>
+size_t PDFDictionary::findInIndex(size_t hash, Predicate predicate) const
+{
+    Q_ASSERT(!m_index.empty());
+
+    const size_t mask = m_index.size() - 1;
+    for (size_t slot = hash & mask; m_index[slot]; slot = (slot + 1) & mask)
+    {
+        const size_t entryIndex = m_index[slot] - 1;
+        if (predicate(m_dictionary[entryIndex].first))
+        {
+            return entryIndex;
+        }
+    }
+
+    return m_dictionary.size();
+}
+
 std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::find(const QByteArray& key) const
 {
+    if (isIndexed())
+    {
+        auto predicate = [&key](const PDFInplaceOrMemoryString& entryKey) { return entryKey == key; };
+        return std::next(m_dictionary.cbegin(), findInIndex(qHash(QByteArrayView(key)), predicate));
+    }
+
     return std::find_if(m_dictionary.cbegin(), m_dictionary.cend(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::iterator PDFDictionary::find(const QByteArray& key)
 {
-    return std::find_if(m_dictionary.begin(), m_dictionary.end(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
+    return std::next(m_dictionary.begin(), std::distance(m_dictionary.cbegin(), std::as_const(*this).find(key)));
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::find(const char* key) const
 {
+    if (isIndexed())
+    {
+        const size_t length = std::strlen(key);
+        auto predicate = [key, length](const PDFInplaceOrMemoryString& entryKey) { return entryKey.equals(key, length); };
+        return std::next(m_dictionary.cbegin(), findInIndex(qHash(QByteArrayView(key, length)), predicate));
+    }
+
     return std::find_if(m_dictionary.cbegin(), m_dictionary.cend(), [key](const DictionaryEntry& entry) { return entry.first == key; });
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::const_iterator PDFDictionary::find(const PDFInplaceOrMemoryString& key) const
 {
+    if (isIndexed())
+    {
+        auto predicate = [&key](const PDFInplaceOrMemoryString& entryKey) { return entryKey == key; };
+        return std::next(m_dictionary.cbegin(), findInIndex(key.getHash(), predicate));
+    }
+
     return std::find_if(m_dictionary.cbegin(), m_dictionary.cend(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::iterator PDFDictionary::find(const PDFInplaceOrMemoryString& key)
 {
-    return std::find_if(m_dictionary.begin(), m_dictionary.end(), [&key](const DictionaryEntry& entry) { return entry.first == key; });
+    return std::next(m_dictionary.begin(), std::distance(m_dictionary.cbegin(), std::as_const(*this).find(key)));
 }
 
 std::vector<PDFDictionary::DictionaryEntry>::iterator PDFDictionary::find(const char* key)
 {
-    return std::find_if(m_dictionary.begin(), m_dictionary.end(), [key](const DictionaryEntry& entry) { return entry.first == key; });
+    return std::next(m_dictionary.begin(), std::distance(m_dictionary.cbegin(), std::as_const(*this).find(key)));
 }
 
 bool PDFStream::equals(const PDFObjectContent* other) const
@@ -514,29 +621,97 @@ QByteArray PDFStringRef::getString() const
     return QByteArray();
 }
 
+/// Shard of the interned name table. Table is divided into shards by hash
+/// of the name, so threads interning names do not contend on a single mutex.
+struct PDFInternedNameTableShard
+{
+    static constexpr const size_t SHARD_COUNT = 16;
+
+    QMutex mutex;
+    QHash<QByteArray, const PDFInternedName*> index;
+    std::deque<PDFInternedName> names;
+};
+
+const PDFInternedName* PDFInternedNameTable::intern(const char* data, int length)
+{
+    if (length > MAX_NAME_LENGTH)
+    {
+        return nullptr;
+    }
+
+    // Table is intentionally never destroyed, so interned names
+    // remain valid even during destruction of static objects.
+    using Shards = std::array<PDFInternedNameTableShard, PDFInternedNameTableShard::SHARD_COUNT>;
+    static Shards* shards = new Shards();
+
+    const size_t hash = qHash(QByteArrayView(data, length));
+    PDFInternedNameTableShard& shard = (*shards)[hash % shards->size()];
+
+    // Raw data doesn't copy the name, so lookup doesn't allocate memory
+    const QByteArray key = QByteArray::fromRawData(data, length);
+
+    QMutexLocker lock(&shard.mutex);
+    auto it = shard.index.constFind(key);
+    if (it != shard.index.cend())
+    {
+        return it.value();
+    }
+
+    if (shard.names.size() >= MAX_NAME_COUNT / shards->size())
+    {
+        // Table is full
+        return nullptr;
+    }
+
+    PDFInternedName& name = shard.names.emplace_back();
+    name.string = QByteArray(data, length);
+    name.hash = hash;
+    shard.index.insert(name.string, &name);
+    return &name;
+}
+
 PDFInplaceOrMemoryString::PDFInplaceOrMemoryString(const char* string)
 {
     const int size = static_cast<int>(qMin(std::strlen(string), size_t(std::numeric_limits<int>::max())));
+    setString(string, size);
+}
+
+PDFInplaceOrMemoryString::PDFInplaceOrMemoryString(QByteArray string)
+{
+    const int size = string.size();
     if (size > PDFInplaceString::MAX_STRING_SIZE)
     {
-        m_value = QByteArray(string, size);
+        if (const PDFInternedName* name = PDFInternedNameTable::intern(string.constData(), size))
+        {
+            m_value = name;
+        }
+        else
+        {
+            m_value = qMove(string);
+        }
     }
     else
     {
-        m_value = PDFInplaceString(string, size);
+        m_value = PDFInplaceString(qMove(string));
     }
 }
 
-PDFInplaceOrMemoryString::PDFInplaceOrMemoryString(QByteArray string)
+void PDFInplaceOrMemoryString::setString(const char* data, int size)
 {
-    const int size = string.size();
     if (size > PDFInplaceString::MAX_STRING_SIZE)
     {
-        m_value = qMove(string);
+        if (const PDFInternedName* name = PDFInternedNameTable::intern(data, size))
+        {
+            m_value = name;
+        }
+        else
+        {
+            m_value = QByteArray(data, size);
+        }
     }
     else
     {
-        m_value = PDFInplaceString(qMove(string));
+        m_value = PDFInplaceString(data, size);
     }
 }
 
@@ -548,6 +723,12 @@ bool PDFInplaceOrMemoryString::equals(const char* value, size_t length) const
         return std::equal(string.string.data(), string.string.data() + string.size, value, value + length);
     }
 
+    if (std::holds_alternative<const PDFInternedName*>(m_value))
+    {
+        const QByteArray& string = std::get<const PDFInternedName*>(m_value)->string;
+        return std::equal(string.constData(), string.constData() + string.size(), value, value + length);
+    }
+
     if (std::holds_alternative<QByteArray>(m_value))
     {
         const QByteArray& string = std::get<QByteArray>(m_value);
@@ -557,6 +738,28 @@ bool PDFInplaceOrMemoryString::equals(const char* value, size_t length) const
     return length == 0;
 }
 
+bool PDFInplaceOrMemoryString::operator==(const PDFInplaceOrMemoryString& other) const
+{
+    // Interned names are stored only once, so they are compared by pointers
+    const bool isInternedName = std::holds_alternative<const PDFInternedName*>(m_value);
+    const bool isOtherInternedName = std::holds_alternative<const PDFInternedName*>(other.m_value);
+
+    if (isInternedName == isOtherInternedName)
+    {
+        return m_value == other.m_value;
+    }
+
+    // Long name, which was not interned (for example, when table was full),
+    // must be equal to the interned name with the same content.
+    if (std::holds_alternative<QByteArray>(m_value) || std::holds_alternative<QByteArray>(other.m_value))
+    {
+        const QByteArrayView view = other.getView();
+        return equals(view.data(), view.size());
+    }
+
+    return false;
+}
+
 bool PDFInplaceOrMemoryString::isInplace() const
 {
     return std::holds_alternative<PDFInplaceString>(m_value);
@@ -569,6 +772,11 @@ QByteArray PDFInplaceOrMemoryString::getString() const
         return std::get<PDFInplaceString>(m_value).getString();
     }
 
+    if (std::holds_alternative<const PDFInternedName*>(m_value))
+    {
+        return std::get<const PDFInternedName*>(m_value)->string;
+    }
+
     if (std::holds_alternative<QByteArray>(m_value))
     {
         return std::get<QByteArray>(m_value);
@@ -577,4 +785,35 @@ QByteArray PDFInplaceOrMemoryString::getString() const
     return QByteArray();
 }
 
+QByteArrayView PDFInplaceOrMemoryString::getView() const
+{
+    if (std::holds_alternative<PDFInplaceString>(m_value))
+    {
+        const PDFInplaceString& string = std::get<PDFInplaceString>(m_value);
+        return QByteArrayView(string.string.data(), string.size);
+    }
+
+    if (std::holds_alternative<const PDFInternedName*>(m_value))
+    {
+        return QByteArrayView(std::get<const PDFInternedName*>(m_value)->string);
+    }
+
+    if (std::holds_alternative<QByteArray>(m_value))
+    {
+        return QByteArrayView(std::get<QByteArray>(m_value));
+    }
+
+    return QByteArrayView();
+}
+
+size_t PDFInplaceOrMemoryString::getHash() const
+{
+    if (std::holds_alternative<const PDFInternedName*>(m_value))
+    {
+        return std::get<const PDFInternedName*>(m_value)->hash;
+    }
+
+    return qHash(getView());
+}
+
 }   // namespace pdf
@@ -22,6 +22,8 @@
 #include "pdfglobal.h"
 
 #include <QByteArray>
+#include <QByteArrayView>
+#include <QMutex>
 
 #include <memory>
 #include <vector>
@@ -120,8 +122,38 @@ struct PDF4QTLIBCORESHARED_EXPORT PDFStringRef
     QByteArray getString() const;
 };
 
+/// Interned name stored in the global name table. Each name is stored
+/// in the table only once, so interned names can be compared by pointers.
+/// Interned names are never destroyed.
+struct PDFInternedName
+{
+    QByteArray string;
+    size_t hash = 0;
+};
+
+/// Global table of interned names. Names used as dictionary keys repeat in
+/// the document many times (for example, /Resources, /MediaBox, /FontDescriptor),
+/// so each of them is stored only once. Table is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFInternedNameTable
+{
+public:
+    /// Maximal length of the name, which can be interned
+    static constexpr const int MAX_NAME_LENGTH = 64;
+
+    /// Maximal count of names in the table. Table is protected
+    /// against unlimited growth caused by malicious documents.
+    static constexpr const size_t MAX_NAME_COUNT = 65536;
+
+    /// Returns interned name. If name can't be interned (it is too long,
+    /// or table is full), then nullptr is returned.
+    /// \param data Name data
+    /// \param length Name length
+    static const PDFInternedName* intern(const char* data, int length);
+};
+
 /// This class represents string, which can be inplace string (no memory allocation),
-/// or classic byte array string, if not enough space for embedded string.
+/// interned name (see \p PDFInternedNameTable), or classic byte array string,
+/// if not enough space for embedded string and string can't be interned.
 class PDF4QTLIBCORESHARED_EXPORT PDFInplaceOrMemoryString
 {
 public:
@@ -142,8 +174,8 @@ public:
 
     bool equals(const char* value, size_t length) const;
 
-    inline bool operator==(const PDFInplaceOrMemoryString&) const = default;
-    inline bool operator!=(const PDFInplaceOrMemoryString&) const = default;
+    bool operator==(const PDFInplaceOrMemoryString& other) const;
+    inline bool operator!=(const PDFInplaceOrMemoryString& other) const { return !(*this == other); }
 
     inline bool operator==(const QByteArray& value) const { return equals(value.constData(), value.size()); }
     inline bool operator==(const char* value) const { return equals(value, std::strlen(value)); }
@@ -151,11 +183,23 @@ public:
     /// Returns true, if string is inplace (i.e. doesn't allocate memory)
     bool isInplace() const;
 
+    /// Returns true, if string is interned name
+    bool isInterned() const { return std::holds_alternative<const PDFInternedName*>(m_value); }
+
     /// Returns string. If string is inplace, byte array is constructed.
     QByteArray getString() const;
 
+    /// Returns view of the string data. View is valid as long
+    /// as this object exists and is not modified.
+    QByteArrayView getView() const;
+
+    /// Returns hash of the string. Hash of interned names is precomputed.
+    size_t getHash() const;
+
 private:
-    std::variant<typename std::monostate, PDFInplaceString, QByteArray> m_value;
+    void setString(const char* data, int size);
+
+    std::variant<typename std::monostate, PDFInplaceString, QByteArray, const PDFInternedName*> m_value;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFObject
@@ -359,7 +403,7 @@ public:
     using DictionaryEntry = std::pair<PDFInplaceOrMemoryString, PDFObject>;
 
     inline PDFDictionary() = default;
-    inline PDFDictionary(std::vector<DictionaryEntry>&& dictionary) : m_dictionary(qMove(dictionary)) { }
+    inline PDFDictionary(std::vector<DictionaryEntry>&& dictionary) : m_dictionary(qMove(dictionary)) { rebuildIndex(); }
     virtual ~PDFDictionary() override = default;
 
     virtual bool equals(const PDFObjectContent* other) const override;
@@ -395,12 +439,12 @@ public:
     /// Adds a new entry to the dictionary.
     /// \param key Key
     /// \param value Value
-    void addEntry(PDFInplaceOrMemoryString&& key, PDFObject&& value) { m_dictionary.emplace_back(std::move(key), std::move(value)); }
+    void addEntry(PDFInplaceOrMemoryString&& key, PDFObject&& value) { m_dictionary.emplace_back(std::move(key), std::move(value)); indexLastEntry(); }
 
     /// Adds a new entry to the dictionary.
     /// \param key Key
     /// \param value Value
-    void addEntry(const PDFInplaceOrMemoryString& key, PDFObject&& value) { m_dictionary.emplace_back(key, std::move(value)); }
+    void addEntry(const PDFInplaceOrMemoryString& key, PDFObject&& value) { m_dictionary.emplace_back(key, std::move(value)); indexLastEntry(); }
 
     /// Sets entry value. If entry with given key doesn't exist,
     /// then it is created.
@@ -428,7 +472,33 @@ public:
     /// Optimizes the dictionary for memory consumption
     virtual void optimize() override;
 
+    /// Returns true, if dictionary uses hash index for searching keys
+    bool isIndexed() const { return !m_index.empty(); }
+
 private:
+    /// Dictionaries having at least this count of entries use hash index
+    /// for searching keys, smaller dictionaries are searched linearly.
+    static constexpr const size_t INDEX_THRESHOLD = 32;
+
+    /// Rebuilds hash index of the dictionary. If dictionary is
+    /// small, then index is removed.
+    void rebuildIndex();
+
+    /// Inserts last entry of the dictionary to the hash index
+    void indexLastEntry();
+
+    /// Inserts entry to the hash index. If entry with the same key is
+    /// already in the index, then nothing happens (first entry wins).
+    /// \param entryIndex Index of the entry
+    void insertToIndex(size_t entryIndex);
+
+    /// Finds entry using hash index, index must exist. If entry is not
+    /// found, then count of the entries is returned.
+    /// \param hash Hash of the key
+    /// \param predicate Predicate, which tests the key of the entry
+    template<typename Predicate>
+    size_t findInIndex(size_t hash, Predicate predicate) const;
+
     /// Finds an item in the dictionary array, if the item is not in the dictionary,
     /// then end iterator is returned.
     /// \param key Key to be found
@@ -460,6 +530,11 @@ private:
     std::vector<DictionaryEntry>::iterator find(const PDFInplaceOrMemoryString& key);
 
     std::vector<DictionaryEntry> m_dictionary;
+
+    /// Hash table with open addressing, size of the table is power of two.
+    /// Each slot contains index of the entry incremented by one, zero
+    /// value marks empty slot. Table is empty for small dictionaries.
+    std::vector<uint32_t> m_index;
 };
 
 /// Represents a stream object in the PDF file. Stream consists of dictionary
@@ -19,6 +19,7 @@
 #include "pdfvisitor.h"
 #include "pdfexecutionpolicy.h"
 #include "pdfdocumentwriter.h"
+#include "pdfdocument.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -62,6 +63,56 @@ void PDFCollectReferencesVisitor::visitReference(const PDFObjectReference refere
     m_references.insert(reference);
 }
 
+/// Collects references of the objects, on which the page depends. References
+/// of parent objects (page tree nodes, parent fields) are not collected, because
+/// they would lead to other pages.
+class PDFCollectPageDependenciesVisitor : public PDFAbstractVisitor
+{
+public:
+    explicit PDFCollectPageDependenciesVisitor(std::vector<PDFObjectReference>& references) :
+        m_references(references)
+    {
+
+    }
+
+    virtual void visitArray(const PDFArray* array) override;
+    virtual void visitDictionary(const PDFDictionary* dictionary) override;
+    virtual void visitStream(const PDFStream* stream) override;
+    virtual void visitReference(const PDFObjectReference reference) override;
+
+private:
+    std::vector<PDFObjectReference>& m_references;
+};
+
+void PDFCollectPageDependenciesVisitor::visitArray(const PDFArray* array)
+{
+    acceptArray(array);
+}
+
+void PDFCollectPageDependenciesVisitor::visitDictionary(const PDFDictionary* dictionary)
+{
+    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    {
+        const PDFInplaceOrMemoryString& key = dictionary->getKey(i);
+        if (key == "Parent" || key == "P")
+        {
+            continue;
+        }
+
+        dictionary->getValue(i).accept(this);
+    }
+}
+
+void PDFCollectPageDependenciesVisitor::visitStream(const PDFStream* stream)
+{
+    visitDictionary(stream->getDictionary());
+}
+
+void PDFCollectPageDependenciesVisitor::visitReference(const PDFObjectReference reference)
+{
+    m_references.push_back(reference);
+}
+
 class PDFReplaceReferencesVisitor : public PDFAbstractVisitor
 {
 public:
@@ -222,6 +273,87 @@ std::set<PDFObjectReference> PDFObjectUtils::getDirectReferences(const PDFObject
     return references;
 }
 
+std::optional<std::vector<PDFInteger>> PDFObjectUtils::getDependentPages(const PDFDocument* document, const std::set<PDFObjectReference>& objects)
+{
+    const PDFObjectStorage& storage = document->getStorage();
+    const PDFCatalog* catalog = document->getCatalog();
+
+    if (objects.empty())
+    {
+        return std::vector<PDFInteger>();
+    }
+
+    // Catalog and page tree nodes can change all pages (inherited attributes)
+    PDFDocumentDataLoaderDecorator loader(&storage);
+    if (const PDFDictionary* trailerDictionary = storage.getDictionaryFromObject(storage.getTrailerDictionary()))
+    {
+        const PDFObject& catalogObject = trailerDictionary->get("Root");
+        if (catalogObject.isReference() && objects.count(catalogObject.getReference()))
+        {
+            return std::nullopt;
+        }
+    }
+
+    for (const PDFObjectReference& reference : objects)
+    {
+        const PDFDictionary* dictionary = storage.getDictionaryFromObject(storage.getObject(reference));
+        if (dictionary && loader.readNameFromDictionary(dictionary, "Type") == "Pages")
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::set<PDFObjectReference> pageReferences;
+    for (size_t i = 0, pageCount = catalog->getPageCount(); i < pageCount; ++i)
+    {
+        pageReferences.insert(catalog->getPage(i)->getPageReference());
+    }
+
+    QMutex mutex;
+    std::vector<PDFInteger> pages;
+
+    auto processPage = [&](PDFInteger pageIndex)
+    {
+        const PDFObjectReference pageReference = catalog->getPage(pageIndex)->getPageReference();
+
+        std::set<PDFObjectReference> visited = { pageReference };
+        std::vector<PDFObjectReference> workList = { pageReference };
+        std::vector<PDFObjectReference> references;
+        PDFCollectPageDependenciesVisitor visitor(references);
+
+        while (!workList.empty())
+        {
+            const PDFObjectReference reference = workList.back();
+            workList.pop_back();
+
+            if (objects.count(reference))
+            {
+                QMutexLocker lock(&mutex);
+                pages.push_back(pageIndex);
+                return;
+            }
+
+            references.clear();
+            storage.getObject(reference).accept(&visitor);
+
+            for (const PDFObjectReference& childReference : references)
+            {
+                // Other pages are not followed (for example, link destinations)
+                if (!pageReferences.count(childReference) && visited.insert(childReference).second)
+                {
+                    workList.push_back(childReference);
+                }
+            }
+        }
+    };
+
+    PDFIntegerRange<PDFInteger> indices(0, PDFInteger(catalog->getPageCount()));
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), processPage);
+
+    std::sort(pages.begin(), pages.end());
+    return pages;
+}
+
 PDFObject PDFObjectUtils::replaceReferences(const PDFObject& object, const std::map<PDFObjectReference, PDFObjectReference>& referenceMapping)
 {
     PDFReplaceReferencesVisitor replaceReferencesVisitor(referenceMapping);
@@ -293,31 +425,38 @@ void PDFObjectClassifier::classify(const PDFDocument* document)
         m_classification[i].reference = reference;
     }
 
-    // First, iterate trough pages of the document
+    // First, iterate trough pages of the document. Pages are processed in parallel,
+    // objects are marked afterwards in page order (marking is not thread safe).
     const PDFCatalog* catalog = document->getCatalog();
     const size_t pageCount = catalog->getPageCount();
-    for (size_t i = 0; i < pageCount; ++i)
+    std::vector<Marks> pageMarks(pageCount);
+
+    auto classifyPage = [&, this](size_t pageIndex)
     {
-        const PDFPage* page = catalog->getPage(i);
+        const PDFPage* page = catalog->getPage(pageIndex);
 
         if (!page)
         {
-            continue;
+            return;
         }
 
-        // Handle page itself
-        if (hasObject(page->getPageReference()))
+        PDFDocumentDataLoaderDecorator pageLoader(document);
+        Marks& marks = pageMarks[pageIndex];
+        auto markLater = [this, &marks](PDFObjectReference reference, Type type)
         {
-            mark(page->getPageReference(), Page);
-        }
+            if (hasObject(reference))
+            {
+                marks.emplace_back(reference, type);
+            }
+        };
+
+        // Handle page itself
+        markLater(page->getPageReference(), Page);
 
         // Handle annotations
         for (const PDFObjectReference& reference : page->getAnnotations())
         {
-            if (hasObject(reference))
-            {
-                mark(reference, Annotation);
-            }
+            markLater(reference, Annotation);
         }
 
         // Handle contents
@@ -328,17 +467,17 @@ void PDFObjectClassifier::classify(const PDFDocument* document)
         const PDFObject& contentsObject = dictionary->get("Contents");
         if (contentsObject.isReference())
         {
-            mark(contentsObject.getReference(), ContentStream);
+            markLater(contentsObject.getReference(), ContentStream);
         }
 
         // Handle resources
         if (const PDFDictionary* resourcesDictionary = document->getDictionaryFromObject(dictionary->get("Resources")))
         {
-            markDictionary(document, resourcesDictionary->get("ExtGState"), GraphicState);
-            markDictionary(document, resourcesDictionary->get("ColorSpace"), ColorSpace);
-            markDictionary(document, resourcesDictionary->get("Pattern"), Pattern);
-            markDictionary(document, resourcesDictionary->get("Shading"), Shading);
-            markDictionary(document, resourcesDictionary->get("Font"), Font);
+            markDictionary(document, resourcesDictionary->get("ExtGState"), GraphicState, marks);
+            markDictionary(document, resourcesDictionary->get("ColorSpace"), ColorSpace, marks);
+            markDictionary(document, resourcesDictionary->get("Pattern"), Pattern, marks);
+            markDictionary(document, resourcesDictionary->get("Shading"), Shading, marks);
+            markDictionary(document, resourcesDictionary->get("Font"), Font, marks);
 
             if (const PDFDictionary* xobjectDictionary = document->getDictionaryFromObject(resourcesDictionary->get("XObject")))
             {
@@ -350,24 +489,35 @@ void PDFObjectClassifier::classify(const PDFDocument* document)
                     {
                         if (const PDFDictionary* xobjectItemDictionary = document->getDictionaryFromObject(item))
                         {
-                            QByteArray subtype = loader.readNameFromDictionary(xobjectItemDictionary, "Subtype");
+                            QByteArray subtype = pageLoader.readNameFromDictionary(xobjectItemDictionary, "Subtype");
 
                             if (subtype == "Image")
                             {
-                                mark(item.getReference(), Image);
+                                markLater(item.getReference(), Image);
                             }
                             else if (subtype == "Form")
                             {
-                                mark(item.getReference(), Form);
+                                markLater(item.getReference(), Form);
                             }
                         }
                     }
                 }
             }
         }
+    };
+
+    auto pageRange = PDFIntegerRange<size_t>(0, pageCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), classifyPage);
+
+    for (const Marks& marks : pageMarks)
+    {
+        for (const auto& item : marks)
+        {
+            mark(item.first, item.second);
+        }
     }
 
-    for (Classification& classification : m_classification)
+    auto classifyAction = [document, &loader](Classification& classification)
     {
         if (const PDFDictionary* dictionary = document->getDictionaryFromObject(document->getObjectByReference(classification.reference)))
         {
@@ -377,7 +527,9 @@ void PDFObjectClassifier::classify(const PDFDocument* document)
                 classification.types.setFlag(Action);
             }
         }
-    }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, m_classification.begin(), m_classification.end(), classifyAction);
 
     for (const Classification& classification : m_classification)
     {
@@ -466,7 +618,7 @@ void PDFObjectClassifier::mark(PDFObjectReference reference, Type type)
     m_classification[reference.objectNumber].types.setFlag(type, true);
 }
 
-void PDFObjectClassifier::markDictionary(const PDFDocument* document, PDFObject object, Type type)
+void PDFObjectClassifier::markDictionary(const PDFDocument* document, PDFObject object, Type type, Marks& marks) const
 {
     if (const PDFDictionary* dictionary = document->getDictionaryFromObject(object))
     {
@@ -476,7 +628,7 @@ void PDFObjectClassifier::markDictionary(const PDFDocument* document, PDFObject
             const PDFObject& item = dictionary->getValue(i);
             if (item.isReference() && hasObject(item.getReference()))
             {
-                mark(item.getReference(), type);
+                marks.emplace_back(item.getReference(), type);
             }
         }
     }
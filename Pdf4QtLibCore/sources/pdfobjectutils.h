@@ -23,6 +23,7 @@
 #include <set>
 #include <vector>
 #include <atomic>
+#include <optional>
 
 namespace pdf
 {
@@ -43,6 +44,16 @@ public:
     /// Returns a list of references directly referenced from object. References itself are not followed.
     static std::set<PDFObjectReference> getDirectReferences(const PDFObject& object);
 
+    /// Returns sorted indices of pages, which depend on some of given objects, i.e. some of
+    /// the objects is reachable from the page dictionary (page content streams, resources,
+    /// annotations and their appearance streams...). Parent objects (page tree nodes, parent
+    /// fields of widget annotations) and other pages are not followed. If objects contain
+    /// document catalog or page tree node (any page can depend on them), then std::nullopt
+    /// is returned.
+    /// \param document Document
+    /// \param objects Objects
+    static std::optional<std::vector<PDFInteger>> getDependentPages(const PDFDocument* document, const std::set<PDFObjectReference>& objects);
+
     static PDFObject replaceReferences(const PDFObject& object, const std::map<PDFObjectReference, PDFObjectReference>& referenceMapping);
 
     /// Returns name for object type
@@ -183,11 +194,14 @@ private:
         Types types = None;
     };
 
+    /// Objects to be marked with given types
+    using Marks = std::vector<std::pair<PDFObjectReference, Type>>;
+
     /// Marks object with a given type
     void mark(PDFObjectReference reference, Type type);
 
-    /// Marks objects in dictionary with a given type
-    void markDictionary(const PDFDocument* document, PDFObject object, Type type);
+    /// Adds objects in dictionary to be marked with a given type
+    void markDictionary(const PDFDocument* document, PDFObject object, Type type, Marks& marks) const;
 
     std::vector<Classification> m_classification;
     Types m_allTypesUsed;
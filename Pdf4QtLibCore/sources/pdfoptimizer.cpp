@@ -23,8 +23,22 @@
 #include "pdfconstants.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfstreamfilters.h"
-#include "pdfdbgheap.h"
 #include "pdfdocumentwriter.h"
+#include "pdfpagecontentprocessor.h"
+#include "pdfimage.h"
+#include "pdfcms.h"
+#include "pdffont.h"
+#include "pdfdbgheap.h"
+
+#include <QBuffer>
+#include <QMutex>
+#include <QImageWriter>
+#include <QtEndian>
+#include <QCryptographicHash>
+#include <QTransform>
+
+#include <bit>
+#include <optional>
 
 namespace pdf
 {
@@ -108,291 +122,1476 @@ void PDFRemoveNullDictionaryEntriesVisitor::visitDictionary(const PDFDictionary*
     m_objectStack.push_back(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(entries))));
 }
 
-PDFOptimizer::PDFOptimizer(OptimizationFlags flags, QObject* parent) :
-    QObject(parent),
-    m_flags(flags)
+/// Computes structural 128-bit hash of the object. References are hashed
+/// as references to their merged representatives (if they are present in
+/// the replacement map), so identical objects referencing identical
+/// (already merged) objects have the same hash.
+class PDFStructuralHashVisitor : public PDFAbstractVisitor
 {
+public:
+    using Hash = std::pair<quint64, quint64>;
 
-}
+    explicit inline PDFStructuralHashVisitor(const std::map<PDFObjectReference, PDFObjectReference>* replacementMap) :
+        m_replacementMap(replacementMap)
+    {
 
-void PDFOptimizer::optimize()
-{
-    // Jakub Melka: We divide optimization into stages, each
-    // stage can consist from multiple passes.
-    constexpr OptimizationFlags stages[] = { OptimizationFlags(DereferenceSimpleObjects),
-                                             OptimizationFlags(RemoveNullObjects),
-                                             OptimizationFlags(RemoveUnusedObjects | MergeIdenticalObjects),
-                                             OptimizationFlags(ShrinkObjectStorage),
-                                             OptimizationFlags(RecompressFlateStreams) };
+    }
 
-    int stage = 1;
+    virtual void visitNull() override;
+    virtual void visitBool(bool value) override;
+    virtual void visitInt(PDFInteger value) override;
+    virtual void visitReal(PDFReal value) override;
+    virtual void visitString(PDFStringRef string) override;
+    virtual void visitName(PDFStringRef name) override;
+    virtual void visitArray(const PDFArray* array) override;
+    virtual void visitDictionary(const PDFDictionary* dictionary) override;
+    virtual void visitStream(const PDFStream* stream) override;
+    virtual void visitReference(const PDFObjectReference reference) override;
 
-    Q_EMIT optimizationStarted();
-    for (OptimizationFlags flags : stages)
-    {
-        Q_EMIT optimizationProgress(tr("Stage %1").arg(stage++));
-        OptimizationFlags currentSteps = flags & m_flags;
+    Hash getHash() const { return Hash(m_first, m_second); }
 
-        int passIndex = 1;
+private:
+    void addValue(quint64 value);
+    void addData(QByteArrayView data);
 
-        bool pass = true;
-        while (pass)
-        {
-            Q_EMIT optimizationProgress(tr("Pass %1").arg(passIndex++));
-            pass = false;
+    const std::map<PDFObjectReference, PDFObjectReference>* m_replacementMap;
+    quint64 m_first = 0xCBF29CE484222325ULL;
+    quint64 m_second = 0x84222325CBF29CE4ULL;
+};
 
-            if (currentSteps.testFlag(DereferenceSimpleObjects))
-            {
-                pass = performDereferenceSimpleObjects() || pass;
-            }
-            if (currentSteps.testFlag(RemoveNullObjects))
-            {
-                pass = performRemoveNullObjects() || pass;
-            }
-            if (currentSteps.testFlag(RemoveUnusedObjects))
-            {
-                pass = performRemoveUnusedObjects() || pass;
-            }
-            if (currentSteps.testFlag(MergeIdenticalObjects))
-            {
-                pass = performMergeIdenticalObjects() || pass;
-            }
-            if (currentSteps.testFlag(ShrinkObjectStorage))
-            {
-                pass = performShrinkObjectStorage() || pass;
-            }
-            if (currentSteps.testFlag(RecompressFlateStreams))
-            {
-                pass = performRecompressFlateStreams() || pass;
-            }
-        }
-    }
-    Q_EMIT optimizationFinished();
+void PDFStructuralHashVisitor::addValue(quint64 value)
+{
+    // Two independent lanes give us 128-bit hash
+    m_first = (m_first ^ value) * 0x9E3779B97F4A7C15ULL;
+    m_first ^= m_first >> 32;
+    m_second = (m_second + value) * 0xC2B2AE3D27D4EB4FULL;
+    m_second ^= m_second >> 29;
 }
 
-PDFOptimizer::OptimizationFlags PDFOptimizer::getFlags() const
+void PDFStructuralHashVisitor::addData(QByteArrayView data)
 {
-    return m_flags;
+    addValue(data.size());
+    addValue(qHashBits(data.data(), data.size(), 0x5BD1E995));
+    addValue(qHashBits(data.data(), data.size(), 0x1B873593));
 }
 
-void PDFOptimizer::setFlags(OptimizationFlags flags)
+void PDFStructuralHashVisitor::visitNull()
 {
-    m_flags = flags;
+    addValue(quint64(PDFObject::Type::Null));
 }
 
-bool PDFOptimizer::performDereferenceSimpleObjects()
+void PDFStructuralHashVisitor::visitBool(bool value)
 {
-    std::atomic<PDFInteger> counter = 0;
+    addValue(quint64(PDFObject::Type::Bool));
+    addValue(value ? 1 : 0);
+}
 
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
-    {
-        PDFRemoveSimpleObjectsVisitor visitor(&m_storage, &counter);
-        entry.object.accept(&visitor);
-        entry.object = visitor.getObject();
-    };
+void PDFStructuralHashVisitor::visitInt(PDFInteger value)
+{
+    addValue(quint64(PDFObject::Type::Int));
+    addValue(quint64(value));
+}
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Simple objects dereferenced and embedded: %1").arg(counter));
+void PDFStructuralHashVisitor::visitReal(PDFReal value)
+{
+    addValue(quint64(PDFObject::Type::Real));
+    addValue(std::bit_cast<quint64>(value));
+}
 
-    return false;
+void PDFStructuralHashVisitor::visitString(PDFStringRef string)
+{
+    addValue(quint64(PDFObject::Type::String));
+    addData(string.getString());
 }
 
-bool PDFOptimizer::performRemoveNullObjects()
+void PDFStructuralHashVisitor::visitName(PDFStringRef name)
 {
-    std::atomic<PDFInteger> counter = 0;
+    addValue(quint64(PDFObject::Type::Name));
+    addData(name.getString());
+}
 
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
-    {
-        PDFRemoveNullDictionaryEntriesVisitor visitor(&m_storage, &counter);
-        entry.object.accept(&visitor);
-        entry.object = visitor.getObject();
-    };
+void PDFStructuralHashVisitor::visitArray(const PDFArray* array)
+{
+    addValue(quint64(PDFObject::Type::Array));
+    addValue(array->getCount());
+    acceptArray(array);
+}
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Null objects entries from dictionaries removed: %1").arg(counter));
+void PDFStructuralHashVisitor::visitDictionary(const PDFDictionary* dictionary)
+{
+    addValue(quint64(PDFObject::Type::Dictionary));
+    addValue(dictionary->getCount());
 
-    return false;
+    for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
+    {
+        addData(dictionary->getKey(i).getView());
+        dictionary->getValue(i).accept(this);
+    }
 }
 
-bool PDFOptimizer::performRemoveUnusedObjects()
+void PDFStructuralHashVisitor::visitStream(const PDFStream* stream)
 {
-    std::atomic<PDFInteger> counter = 0;
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    std::set<PDFObjectReference> references = PDFObjectUtils::getReferences({ m_storage.getTrailerDictionary() }, m_storage);
+    addValue(quint64(PDFObject::Type::Stream));
+    visitDictionary(stream->getDictionary());
+    addData(*stream->getContent());
+}
 
-    PDFIntegerRange<size_t> range(0, objects.size());
-    auto processEntry = [&counter, &objects, &references](size_t index)
-    {
-        PDFObjectStorage::Entry& entry = objects[index];
-        PDFObjectReference reference(PDFInteger(index), entry.generation);
-        if (!references.count(reference) && !entry.object.isNull())
-        {
-            entry.object = PDFObject();
-            ++counter;
-        }
-    };
+void PDFStructuralHashVisitor::visitReference(const PDFObjectReference reference)
+{
+    PDFObjectReference representative = reference;
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processEntry);
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Unused objects removed: %1").arg(counter));
+    auto it = m_replacementMap->find(reference);
+    if (it != m_replacementMap->cend())
+    {
+        representative = it->second;
+    }
 
-    return counter > 0;
+    addValue(quint64(PDFObject::Type::Reference));
+    addValue(quint64(representative.objectNumber));
+    addValue(quint64(representative.generation));
 }
 
-bool PDFOptimizer::performMergeIdenticalObjects()
+/// Returns levels of objects in the reference graph. Level of the object is
+/// greater than levels of all objects it references (with exception of references
+/// closing a cycle), so objects can be processed bottom-up level by level.
+/// Indices of objects in each level are sorted.
+static std::vector<std::vector<size_t>> getReferenceGraphLevels(const PDFObjectStorage::PDFObjects& objects)
 {
-    std::atomic<PDFInteger> counter = 0;
-    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
-    std::map<QByteArray, PDFObjectReference> serializedObjectToReference;
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    std::vector<QByteArray> serializedObjects(objects.size());
+    constexpr int UNVISITED = -1;
+    constexpr int IN_PROGRESS = -2;
 
+    std::vector<std::vector<size_t>> children(objects.size());
     PDFIntegerRange<size_t> range(0, objects.size());
-    auto serializeEntry = [&objects, &serializedObjects](size_t index)
+    auto collectChildren = [&objects, &children](size_t index)
     {
-        const PDFObjectStorage::Entry& entry = objects[index];
-
-        if (!entry.object.isNull())
+        for (const PDFObjectReference& reference : PDFObjectUtils::getDirectReferences(objects[index].object))
         {
-            serializedObjects[index] = PDFDocumentWriter::getSerializedObject(entry.object);
+            if (reference.objectNumber >= 0 &&
+                reference.objectNumber < PDFInteger(objects.size()) &&
+                objects[reference.objectNumber].generation == reference.generation)
+            {
+                children[index].push_back(reference.objectNumber);
+            }
         }
     };
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), serializeEntry);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), collectChildren);
 
-    // Find same object
-    for (PDFInteger index : range)
+    // Jakub Melka: iterative depth first search, object level is determined,
+    // when all its children are processed. Children, which are in progress,
+    // are closing a cycle, and they are ignored.
+    std::vector<int> levels(objects.size(), UNVISITED);
+    std::vector<std::pair<size_t, size_t>> stack;
+    int maximalLevel = -1;
+
+    for (size_t root = 0; root < objects.size(); ++root)
     {
-        const PDFObjectStorage::Entry& entry = objects[index];
+        if (levels[root] != UNVISITED)
+        {
+            continue;
+        }
+
+        levels[root] = IN_PROGRESS;
+        stack.emplace_back(root, 0);
 
-        if (!entry.object.isNull())
+        while (!stack.empty())
         {
-            // We do not merge special objects, such as pages
-            if (const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(entry.object))
+            const size_t index = stack.back().first;
+            const size_t childIndex = stack.back().second;
+
+            if (childIndex < children[index].size())
             {
-                PDFObject nameObject = m_storage.getObject(dictionary->get("Type"));
-                if (nameObject.isName())
+                ++stack.back().second;
+
+                const size_t child = children[index][childIndex];
+                if (levels[child] == UNVISITED)
                 {
-                    if (nameObject.getString() == "Page")
-                    {
-                        continue;
-                    }
+                    levels[child] = IN_PROGRESS;
+                    stack.emplace_back(child, 0);
                 }
+                continue;
             }
 
-            PDFObjectReference currentReference(PDFInteger(index), objects[index].generation);
-            const QByteArray& serializedObject = serializedObjects[index];
-            if (!serializedObjectToReference.count(serializedObject))
-            {
-                serializedObjectToReference[serializedObject] = currentReference;
-            }
-            else
+            int level = 0;
+            for (const size_t child : children[index])
             {
-                PDFObjectReference oldReference = currentReference;
-                PDFObjectReference newReference = serializedObjectToReference.at(serializedObject);
-                replacementMap[oldReference] = newReference;
-                ++counter;
+                if (levels[child] >= 0)
+                {
+                    level = qMax(level, levels[child] + 1);
+                }
             }
+
+            levels[index] = level;
+            maximalLevel = qMax(maximalLevel, level);
+            stack.pop_back();
         }
     }
 
-    // Replace objects
-    if (!replacementMap.empty())
+    std::vector<std::vector<size_t>> result(maximalLevel + 1);
+    for (size_t i = 0; i < levels.size(); ++i)
     {
-        for (size_t i = 0; i < objects.size(); ++i)
-        {
-            objects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
-        }
-        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
-        m_storage.setTrailerDictionary(trailerDictionary);
+        result[levels[i]].push_back(i);
     }
 
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Identical objects merged: %1").arg(counter));
-
-    return counter > 0;
+    return result;
 }
 
-bool PDFOptimizer::performShrinkObjectStorage()
+/// Content processor, which collects maximal effective resolution (in DPI)
+/// of images painted on the page. Images are not decoded.
+class PDFImageResolutionProcessor : public PDFPageContentProcessor
 {
-    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    using BaseClass = PDFPageContentProcessor;
 
-    auto isFree = [](const PDFObjectStorage::Entry& entry)
-    {
-        return entry.object.isNull() && entry.generation < PDF_MAX_OBJECT_GENERATION;
-    };
-    auto isOccupied = [](const PDFObjectStorage::Entry& entry)
+public:
+    explicit PDFImageResolutionProcessor(const PDFPage* page,
+                                         const PDFDocument* document,
+                                         const PDFFontCache* fontCache,
+                                         const PDFCMS* cms,
+                                         const std::map<const PDFStream*, size_t>* streamToIndex,
+                                         std::vector<PDFReal>* resolutions,
+                                         QMutex* mutex) :
+        BaseClass(page, document, fontCache, cms, nullptr, QTransform(), PDFMeshQualitySettings()),
+        m_streamToIndex(streamToIndex),
+        m_resolutions(resolutions),
+        m_mutex(mutex)
     {
-        return !entry.object.isNull();
-    };
 
-    // Make list of free usable indices
-    std::vector<size_t> freeIndices;
-    freeIndices.reserve(objects.size() / 8);
+    }
 
-    const size_t objectCount = objects.size();
-    for (size_t sourceIndex = 1; sourceIndex < objectCount; ++sourceIndex)
+protected:
+    virtual bool isContentKindSuppressed(ContentKind kind) const override;
+    virtual bool performImageStreamPainting(const PDFStream* stream) override;
+
+private:
+    const std::map<const PDFStream*, size_t>* m_streamToIndex;
+    std::vector<PDFReal>* m_resolutions;
+    QMutex* m_mutex;
+};
+
+bool PDFImageResolutionProcessor::isContentKindSuppressed(ContentKind kind) const
+{
+    switch (kind)
     {
-        if (isFree(objects[sourceIndex]))
+        case ContentKind::Shapes:
+        case ContentKind::Text:
+        case ContentKind::Shading:
+            return true;
+
+        case ContentKind::Tiling:
+        case ContentKind::Images:
+            return false; // Tiling can have images
+
+        default:
         {
-            freeIndices.push_back(sourceIndex);
+            Q_ASSERT(false);
+            break;
         }
     }
-    std::reverse(freeIndices.begin(), freeIndices.end());
 
-    // Move objects to free entries
-    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
+    return false;
+}
+
+bool PDFImageResolutionProcessor::performImageStreamPainting(const PDFStream* stream)
+{
+    auto it = m_streamToIndex->find(stream);
+    if (it != m_streamToIndex->cend())
     {
-        if (freeIndices.empty())
+        PDFDocumentDataLoaderDecorator loader(getDocument());
+        const PDFDictionary* dictionary = stream->getDictionary();
+        const PDFReal width = loader.readIntegerFromDictionary(dictionary, "Width", 0);
+        const PDFReal height = loader.readIntegerFromDictionary(dictionary, "Height", 0);
+
+        // Image is painted into the unit square, page space is in points (1/72 inch)
+        const QTransform matrix = getCurrentWorldMatrix();
+        const PDFReal paintedWidth = QLineF(matrix.map(QPointF(0, 0)), matrix.map(QPointF(1, 0))).length() / 72.0;
+        const PDFReal paintedHeight = QLineF(matrix.map(QPointF(0, 0)), matrix.map(QPointF(0, 1))).length() / 72.0;
+
+        if (paintedWidth > 0.0 && paintedHeight > 0.0)
         {
-            // Jakub Melka: We have run out of free indices
-            break;
+            const PDFReal resolution = qMin(width / paintedWidth, height / paintedHeight);
+
+            QMutexLocker lock(m_mutex);
+            PDFReal& currentResolution = (*m_resolutions)[it->second];
+            currentResolution = qMax(currentResolution, resolution);
         }
+    }
 
-        PDFObjectStorage::Entry& sourceEntry = objects[sourceIndex];
-        if (isOccupied(sourceEntry))
+    // We do not need to decode the image
+    return true;
+}
+
+/// Error reporter, which only remembers, that some error occured
+class PDFImageOptimizationErrorReporter : public PDFRenderErrorReporter
+{
+public:
+    virtual void reportRenderError(RenderErrorType type, QString message) override
+    {
+        Q_UNUSED(message);
+
+        if (type != RenderErrorType::Information)
         {
-            size_t targetIndex = freeIndices.back();
-            freeIndices.pop_back();
+            m_hasErrors = true;
+        }
+    }
 
-            if (targetIndex >= sourceIndex)
-            {
-                break;
-            }
+    virtual void reportRenderErrorOnce(RenderErrorType type, QString message) override
+    {
+        reportRenderError(type, qMove(message));
+    }
 
-            PDFObjectStorage::Entry& targetEntry = objects[targetIndex];
-            Q_ASSERT(isFree(targetEntry));
+    bool hasErrors() const { return m_hasErrors; }
 
-            ++targetEntry.generation;
-            targetEntry.object = qMove(sourceEntry.object);
-            sourceEntry.object = PDFObject();
+private:
+    bool m_hasErrors = false;
+};
 
-            replacementMap[PDFObjectReference(PDFInteger(sourceIndex), sourceEntry.generation)] = PDFObjectReference(PDFInteger(targetIndex), targetEntry.generation);
-        }
+/// Converts image samples to 8-bit gray or RGB image without any color
+/// conversion. Returns null image, if image data are not supported.
+/// \param imageData Image data
+static QImage getImageSamples(const PDFImageData& imageData)
+{
+    const unsigned int components = imageData.getComponents();
+    const unsigned int bitsPerComponent = imageData.getBitsPerComponent();
+    const unsigned int width = imageData.getWidth();
+    const unsigned int height = imageData.getHeight();
+
+    if (!imageData.isValid() ||
+        (components != 1 && components != 3) ||
+        (bitsPerComponent != 1 && bitsPerComponent != 2 && bitsPerComponent != 4 && bitsPerComponent != 8) ||
+        imageData.getData().size() < qsizetype(imageData.getStride()) * height)
+    {
+        return QImage();
     }
 
-    // Shrink objects array
-    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
+    QImage image(width, height, components == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+    if (image.isNull())
     {
-        if (isOccupied(objects[sourceIndex]))
-        {
-            objects.resize(sourceIndex + 1);
-            break;
-        }
+        return QImage();
     }
 
-    // Update objects
-    if (!replacementMap.empty())
+    const unsigned int maximalValue = (1 << bitsPerComponent) - 1;
+    const unsigned int sampleCount = width * components;
+
+    for (unsigned int y = 0; y < height; ++y)
     {
-        for (size_t i = 0; i < objects.size(); ++i)
+        const unsigned char* row = imageData.getRow(y);
+        uchar* targetRow = image.scanLine(y);
+
+        if (bitsPerComponent == 8)
         {
-            objects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
+            std::copy(row, row + sampleCount, targetRow);
+            continue;
         }
-        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+
+        for (unsigned int i = 0; i < sampleCount; ++i)
+        {
+            const unsigned int bitOffset = i * bitsPerComponent;
+            const unsigned int value = (row[bitOffset / 8] >> (8 - bitsPerComponent - bitOffset % 8)) & maximalValue;
+            targetRow[i] = uchar(value * 255 / maximalValue);
+        }
+    }
+
+    return image;
+}
+
+/// Returns true, if image samples contain only black and white pixels
+/// \param image Image samples (see getImageSamples)
+static bool isBilevelImage(const QImage& image)
+{
+    const bool isGray = image.format() == QImage::Format_Grayscale8;
+    const int width = image.width();
+
+    for (int y = 0; y < image.height(); ++y)
+    {
+        const uchar* row = image.constScanLine(y);
+        for (int x = 0; x < width; ++x)
+        {
+            const uchar* pixel = isGray ? row + x : row + 3 * x;
+            if ((pixel[0] != 0 && pixel[0] != 255) || (!isGray && (pixel[1] != pixel[0] || pixel[2] != pixel[0])))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/// Rewrites content stream more compactly. Content stream is tokenized into
+/// operators, then peephole optimizations are performed on operators (redundant
+/// save/restore pairs and overwritten state changes are removed, consecutive
+/// text showing operators are merged, invisible content outside the crop box
+/// is removed) and operators are written with minimal whitespace and shortest
+/// number formatting. Content streams with inline images are not optimized.
+class PDFContentStreamOptimizer
+{
+public:
+    /// Constructs content stream optimizer
+    /// \param cropBox Crop box of the page, if it is invalid, then content outside the crop box is not removed
+    /// \param imageNames Names of image XObjects in the page resources
+    explicit PDFContentStreamOptimizer(QRectF cropBox, std::set<QByteArray> imageNames) :
+        m_cropBox(cropBox),
+        m_imageNames(qMove(imageNames))
+    {
+
+    }
+
+    /// Returns optimized content stream, or empty byte array, if content
+    /// stream can't be optimized (it contains syntax errors or inline images).
+    /// \param content Decoded content stream data
+    QByteArray optimize(const QByteArray& content);
+
+private:
+    using Token = PDFLexicalAnalyzer::Token;
+    using TokenType = PDFLexicalAnalyzer::TokenType;
+
+    struct Operation
+    {
+        std::vector<Token> operands;
+        QByteArray command;
+        bool removed = false;
+    };
+
+    bool parse(const QByteArray& content);
+    void removeContentOutsideCropBox();
+    bool removeRedundantSaveRestore();
+    bool removeRedundantStateChanges();
+    void mergeTextRuns();
+    QByteArray write() const;
+
+    /// Returns index of first not removed operation (or count of operations, if it doesn't exist)
+    size_t getFirstOperation() const { return getNextOperation(std::numeric_limits<size_t>::max()); }
+
+    /// Returns index of next not removed operation (or count of operations, if it doesn't exist)
+    size_t getNextOperation(size_t index) const;
+
+    /// Returns index of previous not removed operation (or count of operations, if it doesn't exist)
+    size_t getPreviousOperation(size_t index) const;
+
+    /// Returns group of graphic state parameter set by the operation, or 0, if operation
+    /// doesn't set single graphic state parameter (or operands are invalid).
+    static int getStateParameterGroup(const Operation& operation);
+
+    /// Returns true, if operation doesn't read graphic state (so it
+    /// can't depend on state parameters set before the operation).
+    static bool isStateIndependent(const Operation& operation);
+
+    /// Reads numeric operands of the operation. Returns false, if count
+    /// of operands doesn't match or some operand is not a number.
+    static bool readNumbers(const Operation& operation, PDFReal* numbers, size_t count);
+
+    /// Returns text elements (strings and numbers) of text showing operation, or
+    /// empty array, if operation is not text showing operation (Tj or TJ).
+    static std::vector<Token> getTextElements(const Operation& operation);
+
+    static bool isNumber(const Token& token) { return token.type == TokenType::Integer || token.type == TokenType::Real; }
+    static void writeToken(QByteArray& output, const Token& token);
+
+    std::vector<Operation> m_operations;
+    QRectF m_cropBox;
+    std::set<QByteArray> m_imageNames;
+};
+
+QByteArray PDFContentStreamOptimizer::optimize(const QByteArray& content)
+{
+    if (!parse(content))
+    {
+        return QByteArray();
+    }
+
+    removeContentOutsideCropBox();
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        changed = removeRedundantSaveRestore() || changed;
+        changed = removeRedundantStateChanges() || changed;
+    }
+
+    mergeTextRuns();
+    return write();
+}
+
+bool PDFContentStreamOptimizer::parse(const QByteArray& content)
+{
+    try
+    {
+        PDFLexicalAnalyzer parser(content.constData(), content.constData() + content.size());
+        Operation operation;
+
+        while (true)
+        {
+            Token token = parser.fetch();
+
+            switch (token.type)
+            {
+                case TokenType::EndOfFile:
+                    // Operands without operator are treated as invalid content
+                    return operation.operands.empty();
+
+                case TokenType::Command:
+                {
+                    operation.command = token.data.toByteArray();
+
+                    if (operation.command == "BI")
+                    {
+                        // Jakub Melka: inline image data are not tokenizable, and their end
+                        // is determined heuristically by the content processor, so we
+                        // do not risk changing them.
+                        return false;
+                    }
+
+                    m_operations.push_back(qMove(operation));
+                    operation = Operation();
+                    break;
+                }
+
+                default:
+                    operation.operands.push_back(qMove(token));
+                    break;
+            }
+        }
+    }
+    catch (const PDFException&)
+    {
+        return false;
+    }
+
+    return false;
+}
+
+void PDFContentStreamOptimizer::removeContentOutsideCropBox()
+{
+    if (!m_cropBox.isValid())
+    {
+        return;
+    }
+
+    auto isOutside = [this](const QRectF& rect)
+    {
+        return rect.right() < m_cropBox.left() || rect.left() > m_cropBox.right() ||
+               rect.bottom() < m_cropBox.top() || rect.top() > m_cropBox.bottom();
+    };
+
+    auto isPathConstruction = [](const QByteArray& command)
+    {
+        return command == "m" || command == "l" || command == "c" || command == "v" || command == "y" ||
+               command == "h" || command == "re" || command == "W" || command == "W*";
+    };
+
+    QTransform matrix;
+    std::vector<QTransform> stack;
+
+    for (size_t i = getFirstOperation(); i < m_operations.size(); i = getNextOperation(i))
+    {
+        Operation& operation = m_operations[i];
+
+        if (operation.command == "q")
+        {
+            stack.push_back(matrix);
+        }
+        else if (operation.command == "Q")
+        {
+            if (stack.empty())
+            {
+                // Unbalanced save/restore, we do not know the transformation matrix
+                return;
+            }
+
+            matrix = stack.back();
+            stack.pop_back();
+        }
+        else if (operation.command == "cm")
+        {
+            PDFReal numbers[6] = { };
+            if (!readNumbers(operation, numbers, std::size(numbers)))
+            {
+                return;
+            }
+
+            matrix = QTransform(numbers[0], numbers[1], numbers[2], numbers[3], numbers[4], numbers[5]) * matrix;
+        }
+        else if (operation.command == "re")
+        {
+            // Path must consist of single rectangle, which is filled
+            const size_t previous = getPreviousOperation(i);
+            const size_t next = getNextOperation(i);
+            PDFReal numbers[4] = { };
+
+            if (next < m_operations.size() &&
+                (m_operations[next].command == "f" || m_operations[next].command == "F" || m_operations[next].command == "f*") &&
+                (previous == m_operations.size() || !isPathConstruction(m_operations[previous].command)) &&
+                readNumbers(operation, numbers, std::size(numbers)) &&
+                isOutside(matrix.mapRect(QRectF(numbers[0], numbers[1], numbers[2], numbers[3]).normalized())))
+            {
+                operation.removed = true;
+                m_operations[next].removed = true;
+            }
+        }
+        else if (operation.command == "Do")
+        {
+            if (operation.operands.size() == 1 &&
+                operation.operands.front().type == TokenType::Name &&
+                m_imageNames.count(operation.operands.front().data.toByteArray()) &&
+                isOutside(matrix.mapRect(QRectF(0.0, 0.0, 1.0, 1.0))))
+            {
+                operation.removed = true;
+            }
+        }
+    }
+}
+
+bool PDFContentStreamOptimizer::removeRedundantSaveRestore()
+{
+    const size_t count = m_operations.size();
+
+    // Find matching save/restore pairs
+    std::vector<size_t> restoreIndices(count, count);
+    std::vector<size_t> stack;
+    for (size_t i = getFirstOperation(); i < count; i = getNextOperation(i))
+    {
+        if (m_operations[i].command == "q")
+        {
+            stack.push_back(i);
+        }
+        else if (m_operations[i].command == "Q" && !stack.empty())
+        {
+            restoreIndices[stack.back()] = i;
+            stack.pop_back();
+        }
+    }
+
+    bool changed = false;
+    for (size_t i = getFirstOperation(); i < count; i = getNextOperation(i))
+    {
+        const size_t restoreIndex = restoreIndices[i];
+        if (m_operations[i].removed || restoreIndex == count)
+        {
+            continue;
+        }
+
+        const size_t next = getNextOperation(i);
+        if (next == restoreIndex)
+        {
+            // Empty pair q Q
+            m_operations[i].removed = true;
+            m_operations[restoreIndex].removed = true;
+            changed = true;
+        }
+        else if (next < count && restoreIndices[next] != count && getNextOperation(restoreIndices[next]) == restoreIndex)
+        {
+            // Nested pairs q q ... Q Q, inner pair is redundant
+            m_operations[next].removed = true;
+            m_operations[restoreIndices[next]].removed = true;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+bool PDFContentStreamOptimizer::removeRedundantStateChanges()
+{
+    const size_t count = m_operations.size();
+    bool changed = false;
+    size_t stackDepth = 0;
+
+    for (size_t i = getFirstOperation(); i < count; i = getNextOperation(i))
+    {
+        Operation& operation = m_operations[i];
+
+        if (operation.command == "q")
+        {
+            ++stackDepth;
+            continue;
+        }
+
+        if (operation.command == "cm")
+        {
+            PDFReal numbers[6] = { };
+            if (readNumbers(operation, numbers, std::size(numbers)) &&
+                numbers[0] == 1.0 && numbers[1] == 0.0 && numbers[2] == 0.0 &&
+                numbers[3] == 1.0 && numbers[4] == 0.0 && numbers[5] == 0.0)
+            {
+                // Identity transformation
+                operation.removed = true;
+                changed = true;
+            }
+            continue;
+        }
+
+        const bool isRestore = operation.command == "Q" && stackDepth > 0;
+        const int group = getStateParameterGroup(operation);
+
+        if (isRestore)
+        {
+            --stackDepth;
+        }
+        else if (group == 0)
+        {
+            continue;
+        }
+
+        // State parameters set before restoring graphic state (or set before
+        // the operation setting the same parameter) are never used.
+        for (size_t j = getPreviousOperation(i); j < count && isStateIndependent(m_operations[j]); j = getPreviousOperation(j))
+        {
+            if (isRestore || getStateParameterGroup(m_operations[j]) == group)
+            {
+                m_operations[j].removed = true;
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+void PDFContentStreamOptimizer::mergeTextRuns()
+{
+    const size_t count = m_operations.size();
+
+    for (size_t i = getFirstOperation(); i < count; i = getNextOperation(i))
+    {
+        std::vector<Token> elements = getTextElements(m_operations[i]);
+        if (elements.empty())
+        {
+            continue;
+        }
+
+        // Merge consecutive text showing operators
+        for (size_t next = getNextOperation(i); next < count; next = getNextOperation(next))
+        {
+            std::vector<Token> nextElements = getTextElements(m_operations[next]);
+            if (nextElements.empty())
+            {
+                break;
+            }
+
+            elements.insert(elements.end(), std::make_move_iterator(nextElements.begin()), std::make_move_iterator(nextElements.end()));
+            m_operations[next].removed = true;
+        }
+
+        // Concatenate adjacent strings, zero adjustments are skipped
+        std::vector<Token> mergedElements;
+        for (Token& element : elements)
+        {
+            if (isNumber(element) && element.data.toDouble() == 0.0)
+            {
+                continue;
+            }
+
+            if (!mergedElements.empty() && element.type == TokenType::String && mergedElements.back().type == TokenType::String)
+            {
+                mergedElements.back().data = mergedElements.back().data.toByteArray() + element.data.toByteArray();
+            }
+            else
+            {
+                mergedElements.push_back(qMove(element));
+            }
+        }
+
+        Operation& operation = m_operations[i];
+        operation.operands.clear();
+
+        if (mergedElements.size() == 1 && mergedElements.front().type == TokenType::String)
+        {
+            operation.command = "Tj";
+            operation.operands = qMove(mergedElements);
+        }
+        else
+        {
+            operation.command = "TJ";
+            operation.operands.emplace_back(TokenType::ArrayStart);
+            operation.operands.insert(operation.operands.end(), std::make_move_iterator(mergedElements.begin()), std::make_move_iterator(mergedElements.end()));
+            operation.operands.emplace_back(TokenType::ArrayEnd);
+        }
+    }
+}
+
+QByteArray PDFContentStreamOptimizer::write() const
+{
+    QByteArray output;
+
+    for (const Operation& operation : m_operations)
+    {
+        if (operation.removed)
+        {
+            continue;
+        }
+
+        for (const Token& token : operation.operands)
+        {
+            writeToken(output, token);
+        }
+
+        writeToken(output, Token(TokenType::Command, operation.command));
+        output.append('\n');
+    }
+
+    return output;
+}
+
+size_t PDFContentStreamOptimizer::getNextOperation(size_t index) const
+{
+    const size_t count = m_operations.size();
+
+    size_t next = index + 1;
+    while (next < count && m_operations[next].removed)
+    {
+        ++next;
+    }
+
+    return qMin(next, count);
+}
+
+size_t PDFContentStreamOptimizer::getPreviousOperation(size_t index) const
+{
+    for (size_t previous = index; previous > 0; --previous)
+    {
+        if (!m_operations[previous - 1].removed)
+        {
+            return previous - 1;
+        }
+    }
+
+    return m_operations.size();
+}
+
+int PDFContentStreamOptimizer::getStateParameterGroup(const Operation& operation)
+{
+    // Operand types: 'n' - number, '/' - name, 'a' - array of numbers
+    struct StateOperator
+    {
+        const char* command;
+        int group;
+        const char* operands;
+    };
+
+    static constexpr StateOperator stateOperators[] =
+    {
+        { "w", 1, "n" },
+        { "J", 2, "n" },
+        { "j", 3, "n" },
+        { "M", 4, "n" },
+        { "d", 5, "an" },
+        { "ri", 6, "/" },
+        { "i", 7, "n" },
+        { "Tc", 8, "n" },
+        { "Tw", 9, "n" },
+        { "Tz", 10, "n" },
+        { "TL", 11, "n" },
+        { "Ts", 12, "n" },
+        { "Tr", 13, "n" },
+        { "Tf", 14, "/n" },
+        { "G", 15, "n" },
+        { "RG", 15, "nnn" },
+        { "K", 15, "nnnn" },
+        { "g", 16, "n" },
+        { "rg", 16, "nnn" },
+        { "k", 16, "nnnn" }
+    };
+
+    for (const StateOperator& stateOperator : stateOperators)
+    {
+        if (operation.command != stateOperator.command)
+        {
+            continue;
+        }
+
+        // Check operands, operation with invalid operands doesn't change the state
+        auto it = operation.operands.cbegin();
+        auto itEnd = operation.operands.cend();
+        for (const char* type = stateOperator.operands; *type; ++type)
+        {
+            if (it == itEnd)
+            {
+                return 0;
+            }
+
+            switch (*type)
+            {
+                case 'n':
+                    if (!isNumber(*it++))
+                    {
+                        return 0;
+                    }
+                    break;
+
+                case '/':
+                    if ((it++)->type != TokenType::Name)
+                    {
+                        return 0;
+                    }
+                    break;
+
+                case 'a':
+                {
+                    if ((it++)->type != TokenType::ArrayStart)
+                    {
+                        return 0;
+                    }
+
+                    while (it != itEnd && isNumber(*it))
+                    {
+                        ++it;
+                    }
+
+                    if (it == itEnd || (it++)->type != TokenType::ArrayEnd)
+                    {
+                        return 0;
+                    }
+                    break;
+                }
+
+                default:
+                    Q_ASSERT(false);
+                    break;
+            }
+        }
+
+        return it == itEnd ? stateOperator.group : 0;
+    }
+
+    return 0;
+}
+
+bool PDFContentStreamOptimizer::isStateIndependent(const Operation& operation)
+{
+    return getStateParameterGroup(operation) != 0 || operation.command == "gs" || operation.command == "cs" || operation.command == "CS";
+}
+
+bool PDFContentStreamOptimizer::readNumbers(const Operation& operation, PDFReal* numbers, size_t count)
+{
+    if (operation.operands.size() != count)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Token& token = operation.operands[i];
+        if (!isNumber(token))
+        {
+            return false;
+        }
+
+        numbers[i] = token.data.toDouble();
+    }
+
+    return true;
+}
+
+std::vector<PDFLexicalAnalyzer::Token> PDFContentStreamOptimizer::getTextElements(const Operation& operation)
+{
+    const std::vector<Token>& operands = operation.operands;
+
+    if (operation.command == "Tj" && operands.size() == 1 && operands.front().type == TokenType::String)
+    {
+        return operands;
+    }
+
+    if (operation.command == "TJ" && operands.size() >= 2 && operands.front().type == TokenType::ArrayStart && operands.back().type == TokenType::ArrayEnd)
+    {
+        std::vector<Token> elements(std::next(operands.cbegin()), std::prev(operands.cend()));
+        for (const Token& element : elements)
+        {
+            if (element.type != TokenType::String && !isNumber(element))
+            {
+                return std::vector<Token>();
+            }
+        }
+
+        // Jakub Melka: empty TJ array is kept as it is, because empty
+        // element array means, that operation is not merged.
+        if (!elements.empty())
+        {
+            return elements;
+        }
+    }
+
+    return std::vector<Token>();
+}
+
+void PDFContentStreamOptimizer::writeToken(QByteArray& output, const Token& token)
+{
+    QByteArray text;
+
+    switch (token.type)
+    {
+        case TokenType::Boolean:
+            text = token.data.toBool() ? BOOL_OBJECT_TRUE_STRING : BOOL_OBJECT_FALSE_STRING;
+            break;
+
+        case TokenType::Integer:
+            text = QByteArray::number(token.data.toLongLong());
+            break;
+
+        case TokenType::Real:
+        {
+            // Keep at least six significant digits of small numbers
+            const PDFReal value = token.data.toDouble();
+            const PDFReal absoluteValue = qAbs(value);
+            int precision = 5;
+            if (absoluteValue > 0.0 && absoluteValue < 1.0)
+            {
+                precision = qBound(5, 5 - int(std::floor(std::log10(absoluteValue))), 12);
+            }
+
+            text = QByteArray::number(value, 'f', precision);
+            while (text.endsWith('0'))
+            {
+                text.chop(1);
+            }
+            if (text.endsWith('.'))
+            {
+                text.chop(1);
+            }
+
+            if (text == "-0")
+            {
+                text = "0";
+            }
+            else if (text.startsWith("0."))
+            {
+                text.remove(0, 1);
+            }
+            else if (text.startsWith("-0."))
+            {
+                text.remove(1, 1);
+            }
+            break;
+        }
+
+        case TokenType::String:
+        {
+            // Literal string is never longer than hexadecimal string
+            const QByteArray string = token.data.toByteArray();
+            text.reserve(string.size() + 2);
+            text.append('(');
+            for (const char character : string)
+            {
+                switch (character)
+                {
+                    case '(':
+                    case ')':
+                    case '\\':
+                        text.append('\\');
+                        text.append(character);
+                        break;
+
+                    case '\r':
+                        // End of line in literal string is normalized, so we must escape it
+                        text.append("\\r");
+                        break;
+
+                    default:
+                        text.append(character);
+                        break;
+                }
+            }
+            text.append(')');
+            break;
+        }
+
+        case TokenType::Name:
+        {
+            text.append('/');
+            for (const char character : token.data.toByteArray())
+            {
+                if (PDFLexicalAnalyzer::isRegular(character) && character != CHAR_MARK && character > 0x20 && character < 0x7F)
+                {
+                    text.append(character);
+                }
+                else
+                {
+                    text.append(CHAR_MARK);
+                    text.append(QByteArray(1, character).toHex());
+                }
+            }
+            break;
+        }
+
+        case TokenType::ArrayStart:
+            text = "[";
+            break;
+
+        case TokenType::ArrayEnd:
+            text = "]";
+            break;
+
+        case TokenType::DictionaryStart:
+            text = "<<";
+            break;
+
+        case TokenType::DictionaryEnd:
+            text = ">>";
+            break;
+
+        case TokenType::Null:
+            text = NULL_OBJECT_STRING;
+            break;
+
+        case TokenType::Command:
+            text = token.data.toByteArray();
+            break;
+
+        case TokenType::EndOfFile:
+            Q_ASSERT(false);
+            break;
+    }
+
+    // Tokens must be separated by whitespace only, if both characters are regular
+    if (!output.isEmpty() && !text.isEmpty() && PDFLexicalAnalyzer::isRegular(output.back()) && PDFLexicalAnalyzer::isRegular(text.front()))
+    {
+        output.append(' ');
+    }
+
+    output.append(text);
+}
+
+PDFOptimizer::PDFOptimizer(OptimizationFlags flags, QObject* parent) :
+    QObject(parent),
+    m_flags(flags)
+{
+
+}
+
+void PDFOptimizer::optimize()
+{
+    // Jakub Melka: We divide optimization into stages, each
+    // stage can consist from multiple passes.
+    constexpr OptimizationFlags stages[] = { OptimizationFlags(DereferenceSimpleObjects),
+                                             OptimizationFlags(RemoveNullObjects),
+                                             OptimizationFlags(DownsampleImages | RecompressImages | ConvertMonochromeImages | MergeIdenticalImages | MergeIdenticalFonts | OptimizeContentStreams),
+                                             OptimizationFlags(RemoveUnusedObjects | MergeIdenticalObjects),
+                                             OptimizationFlags(ShrinkObjectStorage),
+                                             OptimizationFlags(RecompressFlateStreams) };
+
+    int stage = 1;
+
+    Q_EMIT optimizationStarted();
+    for (OptimizationFlags flags : stages)
+    {
+        Q_EMIT optimizationProgress(tr("Stage %1").arg(stage++));
+        OptimizationFlags currentSteps = flags & m_flags;
+
+        int passIndex = 1;
+
+        bool pass = true;
+        while (pass)
+        {
+            Q_EMIT optimizationProgress(tr("Pass %1").arg(passIndex++));
+            pass = false;
+
+            if (currentSteps.testFlag(DereferenceSimpleObjects))
+            {
+                pass = performDereferenceSimpleObjects() || pass;
+            }
+            if (currentSteps.testFlag(RemoveNullObjects))
+            {
+                pass = performRemoveNullObjects() || pass;
+            }
+            if (currentSteps & OptimizationFlags(DownsampleImages | RecompressImages | ConvertMonochromeImages | MergeIdenticalImages))
+            {
+                pass = performOptimizeImages() || pass;
+            }
+            if (currentSteps.testFlag(MergeIdenticalFonts))
+            {
+                pass = performMergeIdenticalFonts() || pass;
+            }
+            if (currentSteps.testFlag(OptimizeContentStreams))
+            {
+                pass = performOptimizeContentStreams() || pass;
+            }
+            if (currentSteps.testFlag(RemoveUnusedObjects))
+            {
+                pass = performRemoveUnusedObjects() || pass;
+            }
+            if (currentSteps.testFlag(MergeIdenticalObjects))
+            {
+                pass = performMergeIdenticalObjects() || pass;
+            }
+            if (currentSteps.testFlag(ShrinkObjectStorage))
+            {
+                pass = performShrinkObjectStorage() || pass;
+            }
+            if (currentSteps.testFlag(RecompressFlateStreams))
+            {
+                pass = performRecompressFlateStreams() || pass;
+            }
+        }
+    }
+    Q_EMIT optimizationFinished();
+}
+
+PDFOptimizer::OptimizationFlags PDFOptimizer::getFlags() const
+{
+    return m_flags;
+}
+
+void PDFOptimizer::setFlags(OptimizationFlags flags)
+{
+    m_flags = flags;
+}
+
+bool PDFOptimizer::performDereferenceSimpleObjects()
+{
+    std::atomic<PDFInteger> counter = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
+    {
+        PDFRemoveSimpleObjectsVisitor visitor(&m_storage, &counter);
+        entry.object.accept(&visitor);
+        entry.object = visitor.getObject();
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Simple objects dereferenced and embedded: %1").arg(counter));
+
+    return false;
+}
+
+bool PDFOptimizer::performRemoveNullObjects()
+{
+    std::atomic<PDFInteger> counter = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    auto processEntry = [this, &counter](PDFObjectStorage::Entry& entry)
+    {
+        PDFRemoveNullDictionaryEntriesVisitor visitor(&m_storage, &counter);
+        entry.object.accept(&visitor);
+        entry.object = visitor.getObject();
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Null objects entries from dictionaries removed: %1").arg(counter));
+
+    return false;
+}
+
+bool PDFOptimizer::performRemoveUnusedObjects()
+{
+    std::atomic<PDFInteger> counter = 0;
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    objects.detach(); // Chunks are modified from multiple threads, detaching is not thread safe
+    std::set<PDFObjectReference> references = PDFObjectUtils::getReferences({ m_storage.getTrailerDictionary() }, m_storage);
+
+    PDFIntegerRange<size_t> range(0, objects.size());
+    auto processEntry = [&counter, &objects, &references](size_t index)
+    {
+        PDFObjectStorage::Entry& entry = objects[index];
+        PDFObjectReference reference(PDFInteger(index), entry.generation);
+        if (!references.count(reference) && !entry.object.isNull())
+        {
+            entry.object = PDFObject();
+            ++counter;
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processEntry);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Unused objects removed: %1").arg(counter));
+
+    return counter > 0;
+}
+
+bool PDFOptimizer::performMergeIdenticalObjects()
+{
+    PDFInteger counter = 0;
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    objects.detach(); // Chunks are modified from multiple threads, detaching is not thread safe
+
+    // Jakub Melka: objects are processed bottom-up over the reference graph,
+    // so children are merged before their parents are hashed. References are
+    // hashed as references to merged objects, so whole identical subgraphs
+    // are merged in a single pass. Objects with the same hash are candidates,
+    // which are confirmed by comparing serialized objects.
+    std::vector<std::vector<size_t>> levels = getReferenceGraphLevels(objects);
+    std::vector<PDFStructuralHashVisitor::Hash> hashes(objects.size());
+    std::multimap<PDFStructuralHashVisitor::Hash, PDFObjectReference> hashToReference;
+    std::map<PDFObjectReference, QByteArray> serializedRepresentatives;
+
+    auto getSerializedObject = [&objects, &replacementMap](PDFObjectReference reference)
+    {
+        return PDFDocumentWriter::getSerializedObject(PDFObjectUtils::replaceReferences(objects[reference.objectNumber].object, replacementMap));
+    };
+
+    for (const std::vector<size_t>& level : levels)
+    {
+        auto hashEntry = [&objects, &hashes, &replacementMap](size_t index)
+        {
+            const PDFObjectStorage::Entry& entry = objects[index];
+
+            if (!entry.object.isNull())
+            {
+                PDFStructuralHashVisitor visitor(&replacementMap);
+                entry.object.accept(&visitor);
+                hashes[index] = visitor.getHash();
+            }
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, level.cbegin(), level.cend(), hashEntry);
+
+        // Find same object
+        for (const size_t index : level)
+        {
+            const PDFObjectStorage::Entry& entry = objects[index];
+
+            if (entry.object.isNull())
+            {
+                continue;
+            }
+
+            // We do not merge special objects, such as pages
+            if (const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(entry.object))
+            {
+                PDFObject nameObject = m_storage.getObject(dictionary->get("Type"));
+                if (nameObject.isName())
+                {
+                    if (nameObject.getString() == "Page")
+                    {
+                        continue;
+                    }
+                }
+            }
+
+            PDFObjectReference currentReference(PDFInteger(index), entry.generation);
+            const PDFStructuralHashVisitor::Hash& hash = hashes[index];
+            bool isMerged = false;
+
+            auto range = hashToReference.equal_range(hash);
+            if (range.first != range.second)
+            {
+                QByteArray serializedObject = getSerializedObject(currentReference);
+
+                for (auto it = range.first; it != range.second; ++it)
+                {
+                    const PDFObjectReference candidateReference = it->second;
+
+                    auto serializedIt = serializedRepresentatives.find(candidateReference);
+                    if (serializedIt == serializedRepresentatives.cend())
+                    {
+                        serializedIt = serializedRepresentatives.emplace(candidateReference, getSerializedObject(candidateReference)).first;
+                    }
+
+                    if (serializedIt->second == serializedObject)
+                    {
+                        replacementMap[currentReference] = candidateReference;
+                        isMerged = true;
+                        ++counter;
+                        break;
+                    }
+                }
+            }
+
+            if (!isMerged)
+            {
+                hashToReference.emplace(hash, currentReference);
+            }
+        }
+    }
+
+    // Replace objects
+    if (!replacementMap.empty())
+    {
+        PDFIntegerRange<size_t> range(0, objects.size());
+        auto replaceEntry = [&objects, &replacementMap](size_t index)
+        {
+            objects[index].object = PDFObjectUtils::replaceReferences(objects[index].object, replacementMap);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), replaceEntry);
+
+        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+        m_storage.setTrailerDictionary(trailerDictionary);
+    }
+
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Identical objects merged: %1").arg(counter));
+
+    return counter > 0;
+}
+
+bool PDFOptimizer::performShrinkObjectStorage()
+{
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+
+    auto isFree = [](const PDFObjectStorage::Entry& entry)
+    {
+        return entry.object.isNull() && entry.generation < PDF_MAX_OBJECT_GENERATION;
+    };
+    auto isOccupied = [](const PDFObjectStorage::Entry& entry)
+    {
+        return !entry.object.isNull();
+    };
+
+    // Make list of free usable indices
+    std::vector<size_t> freeIndices;
+    freeIndices.reserve(objects.size() / 8);
+
+    const size_t objectCount = objects.size();
+    for (size_t sourceIndex = 1; sourceIndex < objectCount; ++sourceIndex)
+    {
+        if (isFree(objects[sourceIndex]))
+        {
+            freeIndices.push_back(sourceIndex);
+        }
+    }
+    std::reverse(freeIndices.begin(), freeIndices.end());
+
+    // Move objects to free entries
+    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
+    {
+        if (freeIndices.empty())
+        {
+            // Jakub Melka: We have run out of free indices
+            break;
+        }
+
+        PDFObjectStorage::Entry& sourceEntry = objects[sourceIndex];
+        if (isOccupied(sourceEntry))
+        {
+            size_t targetIndex = freeIndices.back();
+            freeIndices.pop_back();
+
+            if (targetIndex >= sourceIndex)
+            {
+                break;
+            }
+
+            PDFObjectStorage::Entry& targetEntry = objects[targetIndex];
+            Q_ASSERT(isFree(targetEntry));
+
+            ++targetEntry.generation;
+            targetEntry.object = qMove(sourceEntry.object);
+            sourceEntry.object = PDFObject();
+
+            replacementMap[PDFObjectReference(PDFInteger(sourceIndex), sourceEntry.generation)] = PDFObjectReference(PDFInteger(targetIndex), targetEntry.generation);
+        }
+    }
+
+    // Shrink objects array
+    for (size_t sourceIndex = objectCount - 1; sourceIndex > 0; --sourceIndex)
+    {
+        if (isOccupied(objects[sourceIndex]))
+        {
+            objects.resize(sourceIndex + 1);
+            break;
+        }
+    }
+
+    // Update objects
+    if (!replacementMap.empty())
+    {
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            objects[i].object = PDFObjectUtils::replaceReferences(objects[i].object, replacementMap);
+        }
+        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
 
         PDFObjectFactory factory;
         factory.beginDictionary();
@@ -401,63 +1600,1320 @@ bool PDFOptimizer::performShrinkObjectStorage()
         factory.endDictionaryItem();
         factory.endDictionary();
 
-        trailerDictionary = PDFObjectManipulator::merge(trailerDictionary, factory.takeObject(), PDFObjectManipulator::NoFlag);
-        m_storage.setTrailerDictionary(trailerDictionary);
+        trailerDictionary = PDFObjectManipulator::merge(trailerDictionary, factory.takeObject(), PDFObjectManipulator::NoFlag);
+        m_storage.setTrailerDictionary(trailerDictionary);
+    }
+
+    const size_t newObjectCount = objects.size();
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Object list shrinked by: %1").arg(objectCount - newObjectCount));
+
+    return false;
+}
+
+bool PDFOptimizer::performRecompressFlateStreams()
+{
+    std::atomic<PDFInteger> bytesSaved = 0;
+
+    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
+    auto processEntry = [this, &bytesSaved](PDFObjectStorage::Entry& entry)
+    {
+        if (entry.object.isStream())
+        {
+            const PDFStream* stream = entry.object.getStream();
+            const PDFDictionary* dictionary = stream->getDictionary();
+
+            if (dictionary->hasKey("F"))
+            {
+                // External file stream, we do not recompress it
+                return;
+            }
+
+            PDFStreamFilterStorage::StreamFilters streamFilters = PDFStreamFilterStorage::getStreamFilters(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), &m_storage, std::placeholders::_1));
+
+            if (streamFilters.filterObjects.empty())
+            {
+                // No filters
+                return;
+            }
+
+            const PDFStreamFilter* streamFilter = streamFilters.filterObjects.back();
+            if (dynamic_cast<const PDFFlateDecodeFilter*>(streamFilter))
+            {
+                // Try to recompress. If we end with less data, then we use recompressed stream
+                QByteArray recompressedData = PDFFlateDecodeFilter::recompress(*stream->getContent(), m_compressionLevel);
+                const PDFInteger currentBytesSaved = stream->getContent()->size() - recompressedData.size();
+                if (currentBytesSaved > 0)
+                {
+                    bytesSaved += currentBytesSaved;
+                    PDFDictionary updatedDictionary = *dictionary;
+                    updatedDictionary.setEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(recompressedData.size()));
+                    entry.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(recompressedData)));
+                }
+            }
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Bytes saved by recompressing stream: %1").arg(bytesSaved));
+
+    return false;
+}
+
+bool PDFOptimizer::performOptimizeImages()
+{
+    std::atomic<PDFInteger> bytesSaved = 0;
+    std::atomic<PDFInteger> downsampledImages = 0;
+    std::atomic<PDFInteger> monochromeImages = 0;
+    PDFInteger mergedImages = 0;
+
+    PDFObjectStorage::PDFObjects objects = m_storage.getObjects();
+    objects.detach(); // Chunks are modified from multiple threads, detaching is not thread safe
+    std::optional<PDFDocument> document;
+
+    try
+    {
+        document.emplace(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+    }
+    catch (const PDFException&)
+    {
+        Q_EMIT optimizationProgress(tr("Images can't be optimized, document is invalid."));
+        return false;
+    }
+
+    // Find image streams
+    std::vector<size_t> imageIndices;
+    std::map<const PDFStream*, size_t> streamToIndex;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const PDFObject& object = objects[i].object;
+        if (object.isStream())
+        {
+            const PDFObject& subtype = m_storage.getObject(object.getStream()->getDictionary()->get("Subtype"));
+            if (subtype.isName() && subtype.getString() == "Image")
+            {
+                imageIndices.push_back(i);
+                streamToIndex[object.getStream()] = i;
+            }
+        }
+    }
+
+    // Jakub Melka: compute effective resolution of images. Resolution is known
+    // only for images painted on pages, images used only elsewhere (for example,
+    // in annotation appearance streams) are not downsampled.
+    std::vector<PDFReal> resolutions(objects.size(), 0.0);
+    if (m_flags.testFlag(DownsampleImages) && !imageIndices.empty())
+    {
+        QMutex mutex;
+        PDFCMSGeneric cms;
+        PDFFontCache fontCache(DEFAULT_FONT_CACHE_LIMIT, DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+        PDFModifiedDocument modifiedDocument(&document.value(), nullptr);
+        fontCache.setDocument(modifiedDocument);
+        fontCache.setCacheShrinkEnabled(nullptr, false);
+
+        PDFIntegerRange<size_t> pageRange(0, document->getCatalog()->getPageCount());
+        auto processPage = [&](size_t pageIndex)
+        {
+            const PDFPage* page = document->getCatalog()->getPage(pageIndex);
+            PDFImageResolutionProcessor processor(page, &document.value(), &fontCache, &cms, &streamToIndex, &resolutions, &mutex);
+            processor.processContents();
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), processPage);
+        fontCache.setCacheShrinkEnabled(nullptr, true);
+    }
+
+    std::vector<QByteArray> imageHashes(objects.size());
+    auto processImage = [&, this](size_t index)
+    {
+        PDFObjectStorage::Entry& entry = objects[index];
+        const PDFStream* stream = entry.object.getStream();
+        const PDFDictionary* dictionary = stream->getDictionary();
+        PDFDocumentDataLoaderDecorator loader(&document.value());
+
+        // Images, which samples are not directly color values, are not optimized.
+        // Color key masks are also not supported, because they depend on exact
+        // values of the samples.
+        if (dictionary->hasKey("F") ||
+            dictionary->hasKey("Decode") ||
+            loader.readBooleanFromDictionary(dictionary, "ImageMask", false) ||
+            loader.readIntegerFromDictionary(dictionary, "SMaskInData", 0) != 0 ||
+            m_storage.getObject(dictionary->get("Mask")).isArray())
+        {
+            return;
+        }
+
+        // Only gray and RGB images are supported
+        const PDFObject& colorSpaceObject = m_storage.getObject(dictionary->get("ColorSpace"));
+        PDFInteger colorComponents = 0;
+        bool isDeviceColorSpace = false;
+        if (colorSpaceObject.isName())
+        {
+            const QByteArray colorSpaceName = colorSpaceObject.getString();
+            isDeviceColorSpace = colorSpaceName == "DeviceGray" || colorSpaceName == "DeviceRGB";
+            colorComponents = (colorSpaceName == "DeviceGray") ? 1 : ((colorSpaceName == "DeviceRGB") ? 3 : 0);
+        }
+        else if (colorSpaceObject.isArray() && colorSpaceObject.getArray()->getCount() == 2)
+        {
+            const PDFArray* colorSpaceArray = colorSpaceObject.getArray();
+            const PDFObject& colorSpaceName = m_storage.getObject(colorSpaceArray->getItem(0));
+            const PDFObject& profile = m_storage.getObject(colorSpaceArray->getItem(1));
+            if (colorSpaceName.isName() && colorSpaceName.getString() == "ICCBased" && profile.isStream())
+            {
+                colorComponents = loader.readIntegerFromDictionary(profile.getStream()->getDictionary(), "N", 0);
+            }
+        }
+
+        if (colorComponents != 1 && colorComponents != 3)
+        {
+            return;
+        }
+
+        QImage samples;
+        try
+        {
+            PDFImageOptimizationErrorReporter errorReporter;
+            PDFColorSpacePointer colorSpace = PDFAbstractColorSpace::createColorSpace(nullptr, &document.value(), colorSpaceObject);
+            PDFImage image = PDFImage::createImage(&document.value(), stream, qMove(colorSpace), false, RenderingIntent::Perceptual, &errorReporter);
+
+            if (errorReporter.hasErrors() || image.getImageData().getComponents() != unsigned(colorComponents))
+            {
+                return;
+            }
+
+            samples = getImageSamples(image.getImageData());
+        }
+        catch (const PDFException&)
+        {
+            return;
+        }
+        catch (const PDFRendererException&)
+        {
+            return;
+        }
+
+        if (samples.isNull())
+        {
+            return;
+        }
+
+        if (m_flags.testFlag(MergeIdenticalImages))
+        {
+            // Hash of decoded pixels together with dictionary entries, which are not
+            // related to the encoding of the image (such as masks, intent, ...)
+            PDFDictionary hashedDictionary = *dictionary;
+            hashedDictionary.removeEntry(PDF_STREAM_DICT_FILTER);
+            hashedDictionary.removeEntry(PDF_STREAM_DICT_DECODE_PARMS);
+            hashedDictionary.removeEntry(PDF_STREAM_DICT_LENGTH);
+            hashedDictionary.removeEntry("BitsPerComponent");
+
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            hash.addData(PDFDocumentWriter::getSerializedObject(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(hashedDictionary)))));
+
+            const qsizetype bytesPerLine = qsizetype(samples.width()) * (samples.format() == QImage::Format_Grayscale8 ? 1 : 3);
+            for (int y = 0; y < samples.height(); ++y)
+            {
+                hash.addData(QByteArrayView(reinterpret_cast<const char*>(samples.constScanLine(y)), bytesPerLine));
+            }
+
+            imageHashes[index] = hash.result();
+        }
+
+        const bool isBilevel = m_flags.testFlag(ConvertMonochromeImages) && (colorComponents == 1 || isDeviceColorSpace) && isBilevelImage(samples);
+
+        // Determine, if image was encoded by JPEG (then we will use JPEG again)
+        PDFObject filters = m_storage.getObject(dictionary->get(PDF_STREAM_DICT_FILTER));
+        if (filters.isArray() && filters.getArray()->getCount() > 0)
+        {
+            filters = m_storage.getObject(filters.getArray()->getItem(filters.getArray()->getCount() - 1));
+        }
+        const bool isJPEG = filters.isName() && (filters.getString() == "DCTDecode" || filters.getString() == "DCT");
+
+        // Downsample the image. Bilevel images are not downsampled,
+        // they would lose sharpness (they are usually scanned text).
+        bool isDownsampled = false;
+        const PDFReal resolution = resolutions[index];
+        if (m_flags.testFlag(DownsampleImages) && !isBilevel && m_imageTargetResolution > 0.0 && resolution > m_imageTargetResolution)
+        {
+            const PDFReal factor = m_imageTargetResolution / resolution;
+            const int width = qMax(1, qRound(samples.width() * factor));
+            const int height = qMax(1, qRound(samples.height() * factor));
+
+            if (width < samples.width() || height < samples.height())
+            {
+                samples = samples.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(samples.format());
+                isDownsampled = true;
+            }
+        }
+
+        const bool useJPEG = !isBilevel && (m_flags.testFlag(RecompressImages) || isJPEG);
+        if (!isBilevel && !isDownsampled && !m_flags.testFlag(RecompressImages))
+        {
+            // Nothing to do with the image
+            return;
+        }
+
+        QByteArray data;
+        QByteArray filter;
+        int bitsPerComponent = 8;
+
+        if (useJPEG)
+        {
+            QBuffer buffer(&data);
+            buffer.open(QBuffer::WriteOnly);
+
+            QImageWriter writer(&buffer, "jpg");
+            writer.setQuality(m_imageQuality);
+            if (writer.write(samples))
+            {
+                filter = "DCTDecode";
+            }
+            else
+            {
+                data.clear();
+            }
+        }
+
+        if (filter.isEmpty())
+        {
+            QByteArray decodedData;
+
+            if (isBilevel)
+            {
+                // Pack the pixels into bits (1 is white), samples are gray or RGB
+                bitsPerComponent = 1;
+                const int pixelSize = (samples.format() == QImage::Format_Grayscale8) ? 1 : 3;
+                const int stride = (samples.width() + 7) / 8;
+                decodedData.resize(qsizetype(stride) * samples.height(), 0);
+
+                for (int y = 0; y < samples.height(); ++y)
+                {
+                    const uchar* row = samples.constScanLine(y);
+                    uchar* targetRow = reinterpret_cast<uchar*>(decodedData.data()) + qsizetype(stride) * y;
+
+                    for (int x = 0; x < samples.width(); ++x)
+                    {
+                        if (row[x * pixelSize])
+                        {
+                            targetRow[x / 8] |= uchar(0x80 >> (x % 8));
+                        }
+                    }
+                }
+            }
+            else
+            {
+                const qsizetype bytesPerLine = qsizetype(samples.width()) * colorComponents;
+                decodedData.reserve(bytesPerLine * samples.height());
+
+                for (int y = 0; y < samples.height(); ++y)
+                {
+                    decodedData.append(reinterpret_cast<const char*>(samples.constScanLine(y)), bytesPerLine);
+                }
+            }
+
+            data = PDFFlateDecodeFilter::compress(decodedData, m_compressionLevel);
+            filter = "FlateDecode";
+        }
+
+        const PDFInteger currentBytesSaved = stream->getContent()->size() - data.size();
+        if (currentBytesSaved > 0)
+        {
+            bytesSaved += currentBytesSaved;
+
+            if (isDownsampled)
+            {
+                ++downsampledImages;
+            }
+
+            PDFDictionary updatedDictionary = *dictionary;
+            updatedDictionary.removeEntry(PDF_STREAM_DICT_DECODE_PARMS);
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_FILTER), PDFObject::createName(filter));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString("Width"), PDFObject::createInteger(samples.width()));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString("Height"), PDFObject::createInteger(samples.height()));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString("BitsPerComponent"), PDFObject::createInteger(bitsPerComponent));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_LENGTH), PDFObject::createInteger(data.size()));
+
+            if (isBilevel)
+            {
+                ++monochromeImages;
+
+                if (colorComponents == 3)
+                {
+                    updatedDictionary.setEntry(PDFInplaceOrMemoryString("ColorSpace"), PDFObject::createName("DeviceGray"));
+                }
+            }
+
+            entry.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(data)));
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, imageIndices.cbegin(), imageIndices.cend(), processImage);
+
+    // Merge identical images
+    if (m_flags.testFlag(MergeIdenticalImages))
+    {
+        std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+        std::map<QByteArray, PDFObjectReference> hashToReference;
+
+        for (const size_t index : imageIndices)
+        {
+            const QByteArray& hash = imageHashes[index];
+            if (hash.isEmpty())
+            {
+                continue;
+            }
+
+            PDFObjectReference currentReference(PDFInteger(index), objects[index].generation);
+            auto it = hashToReference.find(hash);
+            if (it == hashToReference.cend())
+            {
+                hashToReference[hash] = currentReference;
+            }
+            else
+            {
+                replacementMap[currentReference] = it->second;
+                ++mergedImages;
+            }
+        }
+
+        if (!replacementMap.empty())
+        {
+            PDFIntegerRange<size_t> range(0, objects.size());
+            auto replaceEntry = [&objects, &replacementMap](size_t index)
+            {
+                objects[index].object = PDFObjectUtils::replaceReferences(objects[index].object, replacementMap);
+            };
+            PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), replaceEntry);
+
+            PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+            m_storage.setTrailerDictionary(trailerDictionary);
+        }
+    }
+
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Images downsampled: %1, converted to monochrome: %2, merged: %3").arg(downsampledImages).arg(monochromeImages).arg(mergedImages));
+    Q_EMIT optimizationProgress(tr("Bytes saved by optimizing images: %1").arg(bytesSaved));
+
+    return false;
+}
+
+/// TrueType font program split into tables and glyphs. It is used to merge
+/// subsets of the same font into one font program, which contains union
+/// of glyphs of the subsets. Only subsets, which retain glyph indices of the
+/// original font, can be merged, because font dictionaries (and content
+/// streams) referring to the glyphs are not changed.
+class PDFTrueTypeFontProgram
+{
+public:
+    /// Parses the font program. Returns false, if font program
+    /// is not a valid TrueType font program (for example, it is
+    /// a font collection, or it contains CFF data).
+    /// \param data Decoded font program
+    bool parse(const QByteArray& data);
+
+    /// Returns true, if other font program can be merged into this font
+    /// program, i.e. both are subsets of the same font with the same glyph
+    /// indices, and glyphs present in both subsets are identical.
+    /// \param other Other font program
+    /// \param isCharacterMapIgnored Character maps and glyph names can differ (if
+    ///        font is used only as CIDFontType2 font, they are not used)
+    bool isMergeable(const PDFTrueTypeFontProgram& other, bool isCharacterMapIgnored) const;
+
+    /// Adds glyphs of other font program, which are missing in this
+    /// font program. Other font program must be mergeable.
+    /// \param other Other font program
+    void merge(const PDFTrueTypeFontProgram& other);
+
+    /// Writes the font program (tables are written sorted by the tag,
+    /// checksums are recomputed)
+    QByteArray write() const;
+
+private:
+    struct Metric
+    {
+        quint16 advance = 0;
+        qint16 leftSideBearing = 0;
+
+        bool operator==(const Metric&) const = default;
+    };
+
+    static constexpr quint32 makeTag(const char (&tag)[5]) { return (quint32(quint8(tag[0])) << 24) | (quint32(quint8(tag[1])) << 16) | (quint32(quint8(tag[2])) << 8) | quint32(quint8(tag[3])); }
+
+    static quint16 readUInt16(const QByteArray& data, qsizetype offset) { return qFromBigEndian<quint16>(data.constData() + offset); }
+    static quint32 readUInt32(const QByteArray& data, qsizetype offset) { return qFromBigEndian<quint32>(data.constData() + offset); }
+    static void writeUInt16(QByteArray& data, qsizetype offset, quint16 value) { qToBigEndian<quint16>(value, data.data() + offset); }
+    static void writeUInt32(QByteArray& data, qsizetype offset, quint32 value) { qToBigEndian<quint32>(value, data.data() + offset); }
+    static void appendUInt16(QByteArray& data, quint16 value) { data.append(char(value >> 8)).append(char(value & 0xFF)); }
+    static void appendUInt32(QByteArray& data, quint32 value) { appendUInt16(data, quint16(value >> 16)); appendUInt16(data, quint16(value & 0xFFFF)); }
+
+    /// Computes checksum of the table (table is padded by zeroes to multiple of 4 bytes)
+    static quint32 getChecksum(const QByteArray& data);
+
+    /// Compares tables, bytes in the given ranges are not compared
+    /// \param first First table
+    /// \param second Second table
+    /// \param ignoredRanges Ranges of bytes (offset, length), which are ignored
+    static bool isEqual(QByteArray first, QByteArray second, std::initializer_list<std::pair<qsizetype, qsizetype>> ignoredRanges);
+
+    quint32 m_version = 0;
+    quint16 m_numberOfHMetrics = 0;
+
+    /// Tables of the font program, except tables containing glyphs
+    /// and glyph metrics (glyf, loca and hmtx), which are rebuilt
+    std::map<quint32, QByteArray> m_tables;
+    std::vector<QByteArray> m_glyphs;
+    std::vector<Metric> m_metrics;
+};
+
+bool PDFTrueTypeFontProgram::parse(const QByteArray& data)
+{
+    if (data.size() < 12)
+    {
+        return false;
+    }
+
+    m_version = readUInt32(data, 0);
+    if (m_version != 0x00010000 && m_version != makeTag("true"))
+    {
+        return false;
+    }
+
+    const quint16 tableCount = readUInt16(data, 4);
+    if (data.size() < 12 + 16 * qsizetype(tableCount))
+    {
+        return false;
+    }
+
+    for (quint16 i = 0; i < tableCount; ++i)
+    {
+        const qsizetype recordOffset = 12 + 16 * qsizetype(i);
+        const quint32 tag = readUInt32(data, recordOffset);
+        const qsizetype offset = readUInt32(data, recordOffset + 8);
+        const qsizetype length = readUInt32(data, recordOffset + 12);
+
+        if (offset + length > data.size())
+        {
+            return false;
+        }
+
+        // Digital signature is not valid after the font is modified
+        if (tag != makeTag("DSIG"))
+        {
+            m_tables[tag] = data.mid(offset, length);
+        }
+    }
+
+    auto getTable = [this](quint32 tag, qsizetype minimalLength) -> const QByteArray*
+    {
+        auto it = m_tables.find(tag);
+        return (it != m_tables.cend() && it->second.size() >= minimalLength) ? &it->second : nullptr;
+    };
+
+    const QByteArray* head = getTable(makeTag("head"), 54);
+    const QByteArray* maxp = getTable(makeTag("maxp"), 6);
+    const QByteArray* hhea = getTable(makeTag("hhea"), 36);
+    const QByteArray* loca = getTable(makeTag("loca"), 0);
+    const QByteArray* glyf = getTable(makeTag("glyf"), 0);
+    const QByteArray* hmtx = getTable(makeTag("hmtx"), 0);
+    if (!head || !maxp || !hhea || !loca || !glyf || !hmtx)
+    {
+        return false;
+    }
+
+    const bool isLongLocationFormat = readUInt16(*head, 50) != 0;
+    const quint16 glyphCount = readUInt16(*maxp, 4);
+    m_numberOfHMetrics = readUInt16(*hhea, 34);
+    if (glyphCount == 0 ||
+        m_numberOfHMetrics == 0 ||
+        m_numberOfHMetrics > glyphCount ||
+        loca->size() < (qsizetype(glyphCount) + 1) * (isLongLocationFormat ? 4 : 2) ||
+        hmtx->size() < 4 * qsizetype(m_numberOfHMetrics) + 2 * qsizetype(glyphCount - m_numberOfHMetrics))
+    {
+        return false;
+    }
+
+    auto getGlyphOffset = [loca, isLongLocationFormat](quint16 index) -> qsizetype
+    {
+        return isLongLocationFormat ? qsizetype(readUInt32(*loca, 4 * qsizetype(index))) : 2 * qsizetype(readUInt16(*loca, 2 * qsizetype(index)));
+    };
+
+    m_glyphs.reserve(glyphCount);
+    m_metrics.reserve(glyphCount);
+    for (quint16 i = 0; i < glyphCount; ++i)
+    {
+        const qsizetype startOffset = getGlyphOffset(i);
+        const qsizetype endOffset = getGlyphOffset(i + 1);
+        if (startOffset > endOffset || endOffset > glyf->size() || (endOffset > startOffset && endOffset - startOffset < 10))
+        {
+            return false;
+        }
+        m_glyphs.push_back(glyf->mid(startOffset, endOffset - startOffset));
+
+        Metric metric;
+        if (i < m_numberOfHMetrics)
+        {
+            metric.advance = readUInt16(*hmtx, 4 * qsizetype(i));
+            metric.leftSideBearing = qint16(readUInt16(*hmtx, 4 * qsizetype(i) + 2));
+        }
+        else
+        {
+            metric.advance = m_metrics[m_numberOfHMetrics - 1].advance;
+            metric.leftSideBearing = qint16(readUInt16(*hmtx, 4 * qsizetype(m_numberOfHMetrics) + 2 * qsizetype(i - m_numberOfHMetrics)));
+        }
+        m_metrics.push_back(metric);
+    }
+
+    m_tables.erase(makeTag("glyf"));
+    m_tables.erase(makeTag("loca"));
+    m_tables.erase(makeTag("hmtx"));
+    return true;
+}
+
+bool PDFTrueTypeFontProgram::isMergeable(const PDFTrueTypeFontProgram& other, bool isCharacterMapIgnored) const
+{
+    if (m_version != other.m_version ||
+        m_numberOfHMetrics != other.m_numberOfHMetrics ||
+        m_glyphs.size() != other.m_glyphs.size() ||
+        m_tables.size() != other.m_tables.size())
+    {
+        return false;
+    }
+
+    for (const auto& [tag, table] : m_tables)
+    {
+        auto it = other.m_tables.find(tag);
+        if (it == other.m_tables.cend())
+        {
+            return false;
+        }
+
+        const QByteArray& otherTable = it->second;
+        switch (tag)
+        {
+            case makeTag("head"):
+                // Checksum adjustment, modification date, bounding box and format of the glyph locations
+                if (!isEqual(table, otherTable, { { 8, 4 }, { 28, 8 }, { 36, 8 }, { 50, 2 } }))
+                {
+                    return false;
+                }
+                break;
+
+            case makeTag("hhea"):
+                // Extremes of the metrics (advanceWidthMax, minLeftSideBearing, minRightSideBearing, xMaxExtent)
+                if (!isEqual(table, otherTable, { { 10, 8 } }))
+                {
+                    return false;
+                }
+                break;
+
+            case makeTag("maxp"):
+                // Maximal values of the glyph statistics (all values after glyph count)
+                if (!isEqual(table.left(6), otherTable.left(6), { }))
+                {
+                    return false;
+                }
+                break;
+
+            case makeTag("OS/2"):
+            case makeTag("name"):
+                // These tables are not used when font is rendered
+                break;
+
+            case makeTag("cmap"):
+            case makeTag("post"):
+                if (!isCharacterMapIgnored && table != otherTable)
+                {
+                    return false;
+                }
+                break;
+
+            default:
+                if (table != otherTable)
+                {
+                    return false;
+                }
+                break;
+        }
+    }
+
+    // Glyphs beyond the count of horizontal metrics share
+    // advance of the last metric, so it must be the same.
+    if (m_numberOfHMetrics < m_metrics.size() &&
+        m_metrics[m_numberOfHMetrics - 1].advance != other.m_metrics[m_numberOfHMetrics - 1].advance)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < m_glyphs.size(); ++i)
+    {
+        const bool isPresent = !m_glyphs[i].isEmpty();
+        const bool isOtherPresent = !other.m_glyphs[i].isEmpty();
+
+        if (isPresent && isOtherPresent && (m_glyphs[i] != other.m_glyphs[i] || m_metrics[i] != other.m_metrics[i]))
+        {
+            return false;
+        }
+
+        // Empty glyphs (for example, space) can be used by both subsets, their advances
+        // must be the same. Subsetter can set metrics of removed glyphs to zero.
+        if (!isPresent && !isOtherPresent && m_metrics[i].advance != 0 && other.m_metrics[i].advance != 0 && m_metrics[i] != other.m_metrics[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PDFTrueTypeFontProgram::merge(const PDFTrueTypeFontProgram& other)
+{
+    Q_ASSERT(m_glyphs.size() == other.m_glyphs.size());
+
+    for (size_t i = 0; i < m_glyphs.size(); ++i)
+    {
+        if (m_glyphs[i].isEmpty() && (!other.m_glyphs[i].isEmpty() || m_metrics[i].advance == 0))
+        {
+            m_glyphs[i] = other.m_glyphs[i];
+            m_metrics[i] = other.m_metrics[i];
+        }
+    }
+
+    // Glyph statistics are maximal values, so we take maximum of both fonts
+    QByteArray& maxp = m_tables[makeTag("maxp")];
+    const QByteArray& otherMaxp = other.m_tables.at(makeTag("maxp"));
+    for (qsizetype offset = 6; offset + 2 <= qMin(maxp.size(), otherMaxp.size()); offset += 2)
+    {
+        writeUInt16(maxp, offset, qMax(readUInt16(maxp, offset), readUInt16(otherMaxp, offset)));
+    }
+}
+
+QByteArray PDFTrueTypeFontProgram::write() const
+{
+    std::map<quint32, QByteArray> tables = m_tables;
+
+    // Glyphs are aligned to 4 bytes, so both formats of glyph locations can be used
+    QByteArray glyf;
+    std::vector<qsizetype> glyphOffsets;
+    glyphOffsets.reserve(m_glyphs.size() + 1);
+    for (const QByteArray& glyph : m_glyphs)
+    {
+        glyphOffsets.push_back(glyf.size());
+        glyf.append(glyph);
+        glyf.append((4 - glyf.size() % 4) % 4, '\0');
     }
+    glyphOffsets.push_back(glyf.size());
 
-    const size_t newObjectCount = objects.size();
-    m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Object list shrinked by: %1").arg(objectCount - newObjectCount));
+    const bool isLongLocationFormat = glyf.size() > 0x1FFFE;
+    QByteArray loca;
+    for (qsizetype offset : glyphOffsets)
+    {
+        if (isLongLocationFormat)
+        {
+            appendUInt32(loca, quint32(offset));
+        }
+        else
+        {
+            appendUInt16(loca, quint16(offset / 2));
+        }
+    }
 
-    return false;
+    QByteArray hmtx;
+    for (size_t i = 0; i < m_metrics.size(); ++i)
+    {
+        if (i < m_numberOfHMetrics)
+        {
+            appendUInt16(hmtx, m_metrics[i].advance);
+        }
+        appendUInt16(hmtx, quint16(m_metrics[i].leftSideBearing));
+    }
+
+    // Recompute bounding box and extremes of the metrics
+    QByteArray& head = tables[makeTag("head")];
+    QByteArray& hhea = tables[makeTag("hhea")];
+
+    bool isBoundingBoxValid = false;
+    qint16 xMin = 0;
+    qint16 yMin = 0;
+    qint16 xMax = 0;
+    qint16 yMax = 0;
+    qint16 minLeftSideBearing = 0;
+    qint16 minRightSideBearing = 0;
+    qint16 maxExtent = 0;
+    quint16 maxAdvance = 0;
+    for (size_t i = 0; i < m_glyphs.size(); ++i)
+    {
+        const Metric& metric = m_metrics[i];
+        maxAdvance = qMax(maxAdvance, metric.advance);
+
+        const QByteArray& glyph = m_glyphs[i];
+        if (glyph.isEmpty())
+        {
+            continue;
+        }
+
+        const qint16 glyphXMin = qint16(readUInt16(glyph, 2));
+        const qint16 glyphYMin = qint16(readUInt16(glyph, 4));
+        const qint16 glyphXMax = qint16(readUInt16(glyph, 6));
+        const qint16 glyphYMax = qint16(readUInt16(glyph, 8));
+        const qint16 extent = qint16(metric.leftSideBearing + (glyphXMax - glyphXMin));
+        const qint16 rightSideBearing = qint16(metric.advance - extent);
+
+        if (!isBoundingBoxValid)
+        {
+            xMin = glyphXMin;
+            yMin = glyphYMin;
+            xMax = glyphXMax;
+            yMax = glyphYMax;
+            minLeftSideBearing = metric.leftSideBearing;
+            minRightSideBearing = rightSideBearing;
+            maxExtent = extent;
+            isBoundingBoxValid = true;
+        }
+        else
+        {
+            xMin = qMin(xMin, glyphXMin);
+            yMin = qMin(yMin, glyphYMin);
+            xMax = qMax(xMax, glyphXMax);
+            yMax = qMax(yMax, glyphYMax);
+            minLeftSideBearing = qMin(minLeftSideBearing, metric.leftSideBearing);
+            minRightSideBearing = qMin(minRightSideBearing, rightSideBearing);
+            maxExtent = qMax(maxExtent, extent);
+        }
+    }
+
+    if (isBoundingBoxValid)
+    {
+        writeUInt16(head, 36, quint16(xMin));
+        writeUInt16(head, 38, quint16(yMin));
+        writeUInt16(head, 40, quint16(xMax));
+        writeUInt16(head, 42, quint16(yMax));
+        writeUInt16(hhea, 12, quint16(minLeftSideBearing));
+        writeUInt16(hhea, 14, quint16(minRightSideBearing));
+        writeUInt16(hhea, 16, quint16(maxExtent));
+    }
+    writeUInt16(hhea, 10, maxAdvance);
+    writeUInt16(head, 50, isLongLocationFormat ? 1 : 0);
+    writeUInt32(head, 8, 0);
+
+    tables[makeTag("glyf")] = qMove(glyf);
+    tables[makeTag("loca")] = qMove(loca);
+    tables[makeTag("hmtx")] = qMove(hmtx);
+
+    // Table directory
+    const quint16 tableCount = quint16(tables.size());
+    quint16 entrySelector = 0;
+    while ((2 << entrySelector) <= tableCount)
+    {
+        ++entrySelector;
+    }
+    const quint16 searchRange = quint16((1 << entrySelector) * 16);
+
+    QByteArray data;
+    appendUInt32(data, m_version);
+    appendUInt16(data, tableCount);
+    appendUInt16(data, searchRange);
+    appendUInt16(data, entrySelector);
+    appendUInt16(data, quint16(tableCount * 16 - searchRange));
+
+    qsizetype offset = 12 + 16 * qsizetype(tableCount);
+    for (const auto& [tag, table] : tables)
+    {
+        appendUInt32(data, tag);
+        appendUInt32(data, getChecksum(table));
+        appendUInt32(data, quint32(offset));
+        appendUInt32(data, quint32(table.size()));
+        offset += (table.size() + 3) & ~qsizetype(3);
+    }
+
+    qsizetype headOffset = -1;
+    for (const auto& [tag, table] : tables)
+    {
+        if (tag == makeTag("head"))
+        {
+            headOffset = data.size();
+        }
+
+        data.append(table);
+        data.append((4 - data.size() % 4) % 4, '\0');
+    }
+
+    Q_ASSERT(headOffset != -1);
+    writeUInt32(data, headOffset + 8, 0xB1B0AFBA - getChecksum(data));
+    return data;
 }
 
-bool PDFOptimizer::performRecompressFlateStreams()
+quint32 PDFTrueTypeFontProgram::getChecksum(const QByteArray& data)
 {
-    std::atomic<PDFInteger> bytesSaved = 0;
+    quint32 checksum = 0;
+    const qsizetype size = data.size();
+    for (qsizetype i = 0; i < size; i += 4)
+    {
+        quint32 value = 0;
+        for (qsizetype j = 0; j < 4; ++j)
+        {
+            value = (value << 8) | ((i + j < size) ? quint8(data[i + j]) : 0);
+        }
+        checksum += value;
+    }
+    return checksum;
+}
 
-    PDFObjectStorage::PDFObjects objects =  m_storage.getObjects();
-    auto processEntry = [this, &bytesSaved](PDFObjectStorage::Entry& entry)
+bool PDFTrueTypeFontProgram::isEqual(QByteArray first, QByteArray second, std::initializer_list<std::pair<qsizetype, qsizetype>> ignoredRanges)
+{
+    if (first.size() != second.size())
     {
-        if (entry.object.isStream())
+        return false;
+    }
+
+    for (const auto& [offset, length] : ignoredRanges)
+    {
+        if (offset + length <= first.size())
         {
-            const PDFStream* stream = entry.object.getStream();
-            const PDFDictionary* dictionary = stream->getDictionary();
+            std::fill_n(first.begin() + offset, length, '\0');
+            std::fill_n(second.begin() + offset, length, '\0');
+        }
+    }
 
-            if (dictionary->hasKey("F"))
+    return first == second;
+}
+
+bool PDFOptimizer::performMergeIdenticalFonts()
+{
+    PDFInteger counter = 0;
+    PDFInteger subsetCounter = 0;
+    PDFObjectStorage::PDFObjects objects = m_storage.getObjects();
+
+    // Objects are read through const reference, so chunks of the objects are not
+    // detached (non-const access detaches the chunk and it is not thread safe).
+    const PDFObjectStorage::PDFObjects& sourceObjects = objects;
+
+    auto isValidStream = [&sourceObjects](PDFObjectReference reference)
+    {
+        return reference.objectNumber >= 0 &&
+               reference.objectNumber < PDFInteger(sourceObjects.size()) &&
+               sourceObjects[reference.objectNumber].generation == reference.generation &&
+               sourceObjects[reference.objectNumber].object.isStream();
+    };
+
+    // Find embedded font programs. For TrueType font programs, we also remember
+    // font name (without subset tag) and font descriptors, so subsets of the same
+    // font can be merged.
+    std::set<PDFObjectReference> fontProgramReferences;
+    std::map<PDFObjectReference, QByteArray> trueTypeFontNames;
+    std::map<PDFObjectReference, PDFObjectReference> trueTypeFontDescriptors;
+    std::set<PDFObjectReference> nonCIDFontDescriptors;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const PDFObjectStorage::Entry& entry = sourceObjects[i];
+        const PDFDictionary* dictionary = m_storage.getDictionaryFromObject(entry.object);
+        if (!dictionary)
+        {
+            continue;
+        }
+
+        PDFObject typeObject = m_storage.getObject(dictionary->get("Type"));
+        if (typeObject.isName() && typeObject.getString() == "Font")
+        {
+            // Character maps of the TrueType font programs are not used by the CIDFontType2 fonts
+            PDFObject subtypeObject = m_storage.getObject(dictionary->get("Subtype"));
+            const PDFObject& fontDescriptorObject = dictionary->get("FontDescriptor");
+            if (fontDescriptorObject.isReference() && (!subtypeObject.isName() || subtypeObject.getString() != "CIDFontType2"))
             {
-                // External file stream, we do not recompress it
-                return;
+                nonCIDFontDescriptors.insert(fontDescriptorObject.getReference());
             }
+            continue;
+        }
 
-            PDFStreamFilterStorage::StreamFilters streamFilters = PDFStreamFilterStorage::getStreamFilters(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), &m_storage, std::placeholders::_1));
+        if (!typeObject.isName() || typeObject.getString() != "FontDescriptor")
+        {
+            continue;
+        }
 
-            if (streamFilters.filterObjects.empty())
+        for (const char* key : { "FontFile", "FontFile2", "FontFile3" })
+        {
+            const PDFObject& fontFileObject = dictionary->get(key);
+            if (fontFileObject.isReference())
+            {
+                const PDFObjectReference reference = fontFileObject.getReference();
+                if (isValidStream(reference))
+                {
+                    fontProgramReferences.insert(reference);
+                }
+            }
+        }
+
+        const PDFObject& trueTypeFontFileObject = dictionary->get("FontFile2");
+        PDFObject fontNameObject = m_storage.getObject(dictionary->get("FontName"));
+        if (trueTypeFontFileObject.isReference() && isValidStream(trueTypeFontFileObject.getReference()) && fontNameObject.isName())
+        {
+            // Subset tag consists of six uppercase letters followed by plus sign
+            QByteArray fontName = fontNameObject.getString();
+            if (fontName.size() > 7 && fontName[6] == '+' && std::all_of(fontName.cbegin(), std::next(fontName.cbegin(), 6), [](char c) { return c >= 'A' && c <= 'Z'; }))
+            {
+                fontName.remove(0, 7);
+            }
+
+            const PDFObjectReference trueTypeFontFileReference = trueTypeFontFileObject.getReference();
+            const PDFObjectReference fontDescriptorReference(PDFInteger(i), entry.generation);
+            if (trueTypeFontDescriptors.count(trueTypeFontFileReference))
+            {
+                // Font program shared by multiple font descriptors, we do not
+                // attempt to merge it with other subsets.
+                trueTypeFontNames.erase(trueTypeFontFileReference);
+            }
+            else
+            {
+                trueTypeFontNames[trueTypeFontFileReference] = qMove(fontName);
+            }
+            trueTypeFontDescriptors[trueTypeFontFileReference] = fontDescriptorReference;
+        }
+    }
+
+    // Jakub Melka: font programs can be encoded differently (or can have
+    // different compression level), so we compare decoded data together
+    // with dictionary entries not related to the encoding.
+    std::vector<PDFObjectReference> references(fontProgramReferences.cbegin(), fontProgramReferences.cend());
+    std::vector<QByteArray> hashes(references.size());
+    std::vector<PDFTrueTypeFontProgram> trueTypeFontPrograms(references.size());
+    std::vector<char> isTrueTypeFontProgramParsed(references.size(), 0);
+    PDFIntegerRange<size_t> range(0, references.size());
+    auto hashFontProgram = [&, this](size_t index)
+    {
+        const PDFStream* stream = sourceObjects[references[index].objectNumber].object.getStream();
+
+        try
+        {
+            QByteArray decodedData = PDFStreamFilterStorage::getDecodedStream(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), &m_storage, std::placeholders::_1), m_storage.getSecurityHandler());
+            if (decodedData.isEmpty())
             {
-                // No filters
                 return;
             }
 
-            const PDFStreamFilter* streamFilter = streamFilters.filterObjects.back();
-            if (dynamic_cast<const PDFFlateDecodeFilter*>(streamFilter))
+            PDFDictionary hashedDictionary = *stream->getDictionary();
+            hashedDictionary.removeEntry(PDF_STREAM_DICT_FILTER);
+            hashedDictionary.removeEntry(PDF_STREAM_DICT_DECODE_PARMS);
+            hashedDictionary.removeEntry(PDF_STREAM_DICT_LENGTH);
+
+            QCryptographicHash hash(QCryptographicHash::Sha256);
+            hash.addData(PDFDocumentWriter::getSerializedObject(PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(hashedDictionary)))));
+            hash.addData(decodedData);
+            hashes[index] = hash.result();
+
+            if (trueTypeFontNames.count(references[index]))
             {
-                // Try to recompress. If we end with less data, then we use recompressed stream
-                QByteArray recompressedData = PDFFlateDecodeFilter::recompress(*stream->getContent());
-                const PDFInteger currentBytesSaved = stream->getContent()->size() - recompressedData.size();
-                if (currentBytesSaved > 0)
+                isTrueTypeFontProgramParsed[index] = trueTypeFontPrograms[index].parse(decodedData) ? 1 : 0;
+            }
+        }
+        catch (const PDFException&)
+        {
+            // Font program can't be decoded, we will not merge it
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), hashFontProgram);
+
+    std::map<PDFObjectReference, PDFObjectReference> replacementMap;
+    std::map<QByteArray, PDFObjectReference> hashToReference;
+    for (size_t i = 0; i < references.size(); ++i)
+    {
+        const QByteArray& hash = hashes[i];
+        if (hash.isEmpty())
+        {
+            continue;
+        }
+
+        auto it = hashToReference.find(hash);
+        if (it == hashToReference.cend())
+        {
+            hashToReference[hash] = references[i];
+        }
+        else
+        {
+            replacementMap[references[i]] = it->second;
+            ++counter;
+        }
+    }
+
+    // Subsets of the same TrueType font are merged into one font program with
+    // union of the glyphs. Programs are merged, only if they retain glyph indices
+    // of the original font, so font dictionaries need not to be changed.
+    std::map<QByteArray, std::vector<size_t>> subsets;
+    for (size_t i = 0; i < references.size(); ++i)
+    {
+        if (isTrueTypeFontProgramParsed[i] && !replacementMap.count(references[i]))
+        {
+            subsets[trueTypeFontNames.at(references[i])].push_back(i);
+        }
+    }
+
+    auto isCharacterMapIgnored = [&](size_t index)
+    {
+        return !nonCIDFontDescriptors.count(trueTypeFontDescriptors.at(references[index]));
+    };
+
+    std::set<PDFObjectReference> mergedFontPrograms;
+    for (const auto& subsetItem : subsets)
+    {
+        const std::vector<size_t>& indices = subsetItem.second;
+        if (indices.size() < 2)
+        {
+            continue;
+        }
+
+        std::vector<size_t> unions;
+        std::map<size_t, std::vector<size_t>> unionSubsets;
+        for (size_t index : indices)
+        {
+            const bool isCurrentCharacterMapIgnored = isCharacterMapIgnored(index);
+            auto it = std::find_if(unions.cbegin(), unions.cend(), [&](size_t unionIndex)
+            {
+                return isCharacterMapIgnored(unionIndex) == isCurrentCharacterMapIgnored &&
+                       trueTypeFontPrograms[unionIndex].isMergeable(trueTypeFontPrograms[index], isCurrentCharacterMapIgnored);
+            });
+
+            if (it == unions.cend())
+            {
+                unions.push_back(index);
+            }
+            else
+            {
+                trueTypeFontPrograms[*it].merge(trueTypeFontPrograms[index]);
+                unionSubsets[*it].push_back(index);
+            }
+        }
+
+        for (const auto& [unionIndex, subsetIndices] : unionSubsets)
+        {
+            const PDFObjectReference unionReference = references[unionIndex];
+            const PDFStream* stream = sourceObjects[unionReference.objectNumber].object.getStream();
+
+            QByteArray data = trueTypeFontPrograms[unionIndex].write();
+            QByteArray compressedData = PDFFlateDecodeFilter::compress(data, m_compressionLevel);
+
+            PDFDictionary updatedDictionary = *stream->getDictionary();
+            updatedDictionary.removeEntry(PDF_STREAM_DICT_DECODE_PARMS);
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_FILTER), PDFObject::createName("FlateDecode"));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_LENGTH), PDFObject::createInteger(compressedData.size()));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString("Length1"), PDFObject::createInteger(data.size()));
+            objects[unionReference.objectNumber].object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(compressedData)));
+            mergedFontPrograms.insert(unionReference);
+
+            for (size_t subsetIndex : subsetIndices)
+            {
+                replacementMap[references[subsetIndex]] = unionReference;
+                ++subsetCounter;
+            }
+        }
+    }
+
+    // Identical font program can be replaced by the program, which was merged into union
+    for (auto& replacementItem : replacementMap)
+    {
+        auto it = replacementMap.find(replacementItem.second);
+        if (it != replacementMap.cend())
+        {
+            replacementItem.second = it->second;
+        }
+    }
+
+    // Set of CIDs present in the font program is not valid for the union
+    for (const auto& [fontProgramReference, fontDescriptorReference] : trueTypeFontDescriptors)
+    {
+        auto it = replacementMap.find(fontProgramReference);
+        const PDFObjectReference mergedFontProgramReference = it != replacementMap.cend() ? it->second : fontProgramReference;
+        const PDFObject& fontDescriptorObject = sourceObjects[fontDescriptorReference.objectNumber].object;
+        const PDFDictionary* fontDescriptorDictionary = fontDescriptorObject.isDictionary() ? fontDescriptorObject.getDictionary() : nullptr;
+        if (mergedFontPrograms.count(mergedFontProgramReference) && fontDescriptorDictionary && fontDescriptorDictionary->hasKey("CIDSet"))
+        {
+            PDFDictionary updatedDictionary = *fontDescriptorDictionary;
+            updatedDictionary.removeEntry("CIDSet");
+            objects[fontDescriptorReference.objectNumber].object = PDFObject::createDictionary(std::make_shared<PDFDictionary>(qMove(updatedDictionary)));
+        }
+    }
+
+    // Replace objects (chunks are detached in advance, because
+    // detaching of the chunk is not thread safe)
+    if (!replacementMap.empty())
+    {
+        objects.detach();
+        PDFIntegerRange<size_t> objectRange(0, objects.size());
+        auto replaceEntry = [&objects, &replacementMap](size_t index)
+        {
+            objects[index].object = PDFObjectUtils::replaceReferences(objects[index].object, replacementMap);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objectRange.begin(), objectRange.end(), replaceEntry);
+
+        PDFObject trailerDictionary = PDFObjectUtils::replaceReferences(m_storage.getTrailerDictionary(), replacementMap);
+        m_storage.setTrailerDictionary(trailerDictionary);
+    }
+
+    m_storage.setObjects(qMove(objects));
+    Q_EMIT optimizationProgress(tr("Identical font programs merged: %1").arg(counter));
+    Q_EMIT optimizationProgress(tr("Font subsets merged: %1").arg(subsetCounter));
+
+    return false;
+}
+
+bool PDFOptimizer::performOptimizeContentStreams()
+{
+    std::atomic<PDFInteger> bytesSaved = 0;
+    std::atomic<PDFInteger> optimizedStreams = 0;
+
+    PDFObjectStorage::PDFObjects objects = m_storage.getObjects();
+    objects.detach(); // Chunks are modified from multiple threads, detaching is not thread safe
+    std::optional<PDFDocument> document;
+
+    try
+    {
+        document.emplace(PDFObjectStorage(m_storage), PDFVersion(2, 0), QByteArray());
+    }
+    catch (const PDFException&)
+    {
+        Q_EMIT optimizationProgress(tr("Content streams can't be optimized, document is invalid."));
+        return false;
+    }
+
+    struct ContentStreamInfo
+    {
+        PDFObjectReference reference;
+        QRectF cropBox;
+        std::set<QByteArray> imageNames;
+        size_t pageCount = 0;
+        bool isSingleContentStream = true;
+    };
+
+    // Jakub Melka: collect content streams of pages. Invisible content outside the crop
+    // box can be removed only from content streams, which are used by single page as
+    // its only content stream, because content streams of the page can share graphic
+    // state and shared content stream can be visible on other page.
+    std::vector<ContentStreamInfo> contentStreams;
+    std::map<PDFObjectReference, size_t> referenceToIndex;
+    const PDFCatalog* catalog = document->getCatalog();
+    for (size_t pageIndex = 0, pageCount = catalog->getPageCount(); pageIndex < pageCount; ++pageIndex)
+    {
+        const PDFPage* page = catalog->getPage(pageIndex);
+        const PDFObject& pageObject = m_storage.getObject(page->getPageReference());
+        if (!pageObject.isDictionary())
+        {
+            continue;
+        }
+
+        std::vector<PDFObjectReference> references;
+        PDFObject contents = pageObject.getDictionary()->get("Contents");
+        if (contents.isReference() && m_storage.getObject(contents).isStream())
+        {
+            references.push_back(contents.getReference());
+        }
+        else if (const PDFObject& contentsArray = m_storage.getObject(contents); contentsArray.isArray())
+        {
+            for (const PDFObject& item : *contentsArray.getArray())
+            {
+                if (item.isReference())
                 {
-                    bytesSaved += currentBytesSaved;
-                    PDFDictionary updatedDictionary = *dictionary;
-                    updatedDictionary.setEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(recompressedData.size()));
-                    entry.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(recompressedData)));
+                    references.push_back(item.getReference());
+                }
+            }
+        }
+
+        std::set<QByteArray> imageNames;
+        const PDFObject& resources = m_storage.getObject(page->getResources());
+        if (resources.isDictionary())
+        {
+            const PDFObject& xobjects = m_storage.getObject(resources.getDictionary()->get("XObject"));
+            if (xobjects.isDictionary())
+            {
+                const PDFDictionary* xobjectDictionary = xobjects.getDictionary();
+                for (size_t i = 0, count = xobjectDictionary->getCount(); i < count; ++i)
+                {
+                    const PDFObject& xobject = m_storage.getObject(xobjectDictionary->getValue(i));
+                    if (xobject.isStream())
+                    {
+                        const PDFObject& subtype = m_storage.getObject(xobject.getStream()->getDictionary()->get("Subtype"));
+                        if (subtype.isName() && subtype.getString() == "Image")
+                        {
+                            imageNames.insert(xobjectDictionary->getKey(i).getString());
+                        }
+                    }
                 }
             }
         }
+
+        for (const PDFObjectReference& reference : references)
+        {
+            auto it = referenceToIndex.find(reference);
+            if (it == referenceToIndex.cend())
+            {
+                it = referenceToIndex.insert(std::make_pair(reference, contentStreams.size())).first;
+                contentStreams.emplace_back();
+                contentStreams.back().reference = reference;
+            }
+
+            ContentStreamInfo& info = contentStreams[it->second];
+            info.cropBox = page->getCropBox();
+            info.imageNames = imageNames;
+            info.isSingleContentStream = info.isSingleContentStream && references.size() == 1;
+            ++info.pageCount;
+        }
+    }
+
+    auto processContentStream = [&, this](const ContentStreamInfo& info)
+    {
+        const PDFObjectReference reference = info.reference;
+        if (reference.objectNumber < 0 || reference.objectNumber >= PDFInteger(objects.size()))
+        {
+            return;
+        }
+
+        PDFObjectStorage::Entry& entry = objects[reference.objectNumber];
+        if (entry.generation != reference.generation || !entry.object.isStream())
+        {
+            return;
+        }
+
+        const PDFStream* stream = entry.object.getStream();
+        const PDFDictionary* dictionary = stream->getDictionary();
+        if (dictionary->hasKey("F"))
+        {
+            // External file stream, we do not optimize it
+            return;
+        }
+
+        QByteArray decodedData;
+        try
+        {
+            decodedData = PDFStreamFilterStorage::getDecodedStream(stream, std::bind(QOverload<const PDFObject&>::of(&PDFObjectStorage::getObject), &m_storage, std::placeholders::_1), m_storage.getSecurityHandler());
+        }
+        catch (const PDFException&)
+        {
+            // Content stream can't be decoded, we will not optimize it
+            return;
+        }
+
+        const bool removeInvisibleContent = info.pageCount == 1 && info.isSingleContentStream;
+        PDFContentStreamOptimizer optimizer(removeInvisibleContent ? info.cropBox : QRectF(), info.imageNames);
+        QByteArray optimizedData = optimizer.optimize(decodedData);
+        if (optimizedData.isEmpty())
+        {
+            return;
+        }
+
+        QByteArray data = PDFFlateDecodeFilter::compress(optimizedData, m_compressionLevel);
+        const PDFInteger currentBytesSaved = stream->getContent()->size() - data.size();
+        if (currentBytesSaved > 0)
+        {
+            bytesSaved += currentBytesSaved;
+            ++optimizedStreams;
+
+            PDFDictionary updatedDictionary = *dictionary;
+            updatedDictionary.removeEntry(PDF_STREAM_DICT_DECODE_PARMS);
+            updatedDictionary.removeEntry("DL");
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_FILTER), PDFObject::createName("FlateDecode"));
+            updatedDictionary.setEntry(PDFInplaceOrMemoryString(PDF_STREAM_DICT_LENGTH), PDFObject::createInteger(data.size()));
+            entry.object = PDFObject::createStream(std::make_shared<PDFStream>(qMove(updatedDictionary), qMove(data)));
+        }
     };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, contentStreams.cbegin(), contentStreams.cend(), processContentStream);
 
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, objects.begin(), objects.end(), processEntry);
     m_storage.setObjects(qMove(objects));
-    Q_EMIT optimizationProgress(tr("Bytes saved by recompressing stream: %1").arg(bytesSaved));
+    Q_EMIT optimizationProgress(tr("Content streams optimized: %1, bytes saved: %2").arg(optimizedStreams).arg(bytesSaved));
 
     return false;
 }
@@ -19,6 +19,7 @@
 #define PDFOPTIMIZER_H
 
 #include "pdfdocument.h"
+#include "pdfstreamfilters.h"
 
 #include <QObject>
 
@@ -43,7 +44,14 @@ public:
         RemoveUnusedObjects         = 0x0004, ///< Remove not referenced objects
         MergeIdenticalObjects       = 0x0008, ///< Merge identical objects
         ShrinkObjectStorage         = 0x0010, ///< Shrink object storage, so unused objects are filled with used (and generation number increased)
-        RecompressFlateStreams      = 0x0020, ///< Flate streams are recompressed with maximal compression
+        RecompressFlateStreams      = 0x0020, ///< Flate streams are recompressed (with maximal compression by default)
+        DownsampleImages            = 0x0040, ///< Images with effective resolution (on pages) above target resolution are downsampled (lossy)
+        RecompressImages            = 0x0080, ///< Continuous tone images are recompressed by JPEG with given quality (lossy)
+        ConvertMonochromeImages     = 0x0100, ///< Images containing only black and white pixels are converted to 1 bit per pixel images
+        MergeIdenticalImages        = 0x0200, ///< Images with identical decoded pixels are merged
+        MergeIdenticalFonts         = 0x0400, ///< Embedded font programs with identical decoded data are merged, subsets of the same TrueType font are merged into one font program
+        OptimizeContentStreams      = 0x0800, ///< Content streams of pages are rewritten more compactly, invisible content outside the crop box is removed
+        AllLossless                 = 0x0F3F, ///< All optimizations, which do not change appearance of the document, turned on
         All                         = 0xFFFF, ///< All optimizations turned on
     };
     Q_DECLARE_FLAGS(OptimizationFlags, OptimizationFlag)
@@ -75,6 +83,30 @@ public:
     OptimizationFlags getFlags() const;
     void setFlags(OptimizationFlags flags);
 
+    /// Returns compression level used, when flate streams are recompressed
+    PDFFlateDecodeFilter::CompressionLevel getCompressionLevel() const { return m_compressionLevel; }
+
+    /// Sets compression level used, when flate streams are recompressed. Stream
+    /// is replaced only if recompressed data are smaller than original data.
+    /// \param compressionLevel Compression level
+    void setCompressionLevel(PDFFlateDecodeFilter::CompressionLevel compressionLevel) { m_compressionLevel = compressionLevel; }
+
+    /// Returns target resolution (in DPI) of downsampled images
+    PDFReal getImageTargetResolution() const { return m_imageTargetResolution; }
+
+    /// Sets target resolution (in DPI) of downsampled images. Image is downsampled,
+    /// if its maximal effective resolution on pages is above target resolution.
+    /// \param imageTargetResolution Target resolution
+    void setImageTargetResolution(PDFReal imageTargetResolution) { m_imageTargetResolution = imageTargetResolution; }
+
+    /// Returns quality (0-100) of recompressed JPEG images
+    int getImageQuality() const { return m_imageQuality; }
+
+    /// Sets quality (0-100) of recompressed JPEG images. Image is replaced
+    /// only if recompressed data are smaller than original data.
+    /// \param imageQuality Image quality
+    void setImageQuality(int imageQuality) { m_imageQuality = imageQuality; }
+
 signals:
     void optimizationStarted();
     void optimizationProgress(QString progressText);
@@ -87,8 +119,14 @@ private:
     bool performMergeIdenticalObjects();
     bool performShrinkObjectStorage();
     bool performRecompressFlateStreams();
+    bool performOptimizeImages();
+    bool performMergeIdenticalFonts();
+    bool performOptimizeContentStreams();
 
     OptimizationFlags m_flags;
+    PDFFlateDecodeFilter::CompressionLevel m_compressionLevel = PDFFlateDecodeFilter::CompressionLevel::Maximum;
+    PDFReal m_imageTargetResolution = 150.0;
+    int m_imageQuality = 75;
     PDFObjectStorage m_storage;
 };
 
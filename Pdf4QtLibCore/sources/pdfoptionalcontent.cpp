@@ -382,6 +382,7 @@ void PDFOptionalContentActivity::setDocument(const PDFDocument* document)
         Q_ASSERT(document);
         m_document = document;
         m_properties = document->getCatalog()->getOptionalContentProperties();
+        ++m_stateRevision;
     }
 }
 
@@ -407,12 +408,15 @@ void PDFOptionalContentActivity::setState(PDFObjectReference ocg, OCState state,
         }
 
         it->second = state;
+        ++m_stateRevision;
         Q_EMIT optionalContentGroupStateChanged(ocg, state);
     }
 }
 
 void PDFOptionalContentActivity::applyConfiguration(const PDFOptionalContentConfiguration& configuration)
 {
+    ++m_stateRevision;
+
     // Step 1: Apply base state to all states
     if (configuration.getBaseState() != PDFOptionalContentConfiguration::BaseState::Unchanged)
     {
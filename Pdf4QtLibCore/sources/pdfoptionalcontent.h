@@ -190,6 +190,11 @@ public:
     /// Returns the properties of optional content
     const PDFOptionalContentProperties* getProperties() const { return m_properties; }
 
+    /// Returns revision of the states of optional content groups. Revision
+    /// is changed each time, when some state is changed, so objects created
+    /// using the states can find out, that they are not valid anymore.
+    quint64 getStateRevision() const { return m_stateRevision; }
+
 signals:
     void optionalContentGroupStateChanged(PDFObjectReference ocg, OCState state);
 
@@ -198,6 +203,7 @@ private:
     const PDFOptionalContentProperties* m_properties;
     OCUsage m_usage;
     std::map<PDFObjectReference, OCState> m_states;
+    quint64 m_stateRevision = 0;
 };
 
 /// Configuration of optional content configuration.
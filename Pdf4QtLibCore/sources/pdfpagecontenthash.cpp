@@ -0,0 +1,390 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfpagecontenthash.h"
+#include "pdfdocument.h"
+#include "pdfcms.h"
+#include "pdfoptionalcontent.h"
+#include "pdfmeshqualitysettings.h"
+
+#include <QtEndian>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+#include <map>
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+/// Feeds objects in canonical form into the hash. Referenced objects are
+/// hashed only, when they are visited for the first time, repeated references
+/// (and cycles) are hashed as ordinal number of the first visit.
+class PDFPageContentHasher
+{
+public:
+    explicit PDFPageContentHasher(const PDFDocument* document) :
+        m_document(document),
+        m_hash(QCryptographicHash::Sha256)
+    {
+
+    }
+
+    void addTag(char tag) { m_hash.addData(QByteArrayView(&tag, 1)); }
+    void addInteger(qint64 value);
+    void addReal(PDFReal value);
+    void addBytes(const QByteArray& value);
+    void addRect(const QRectF& rect);
+    void addObject(const PDFObject& object);
+    void addDictionary(const PDFDictionary* dictionary);
+
+    QByteArray getResult() const { return m_hash.result(); }
+
+    /// Returns optional content groups referenced by hashed objects, in order
+    /// of their ordinal numbers (i.e. in order of the first visit).
+    std::vector<PDFObjectReference> getOptionalContentGroups() const { return m_optionalContentGroups; }
+
+private:
+    /// Entries of dictionaries, which don't affect page content, but can
+    /// reference other parts of the document (for example, page tree).
+    /// \param key Key of the entry
+    /// \param value Value of the entry
+    /// \param isPageTreeNode Dictionary is a page, or a page tree node
+    /// \param isFieldNode Dictionary is a form field
+    static bool isIgnoredEntry(const QByteArray& key, const PDFObject& value, bool isPageTreeNode, bool isFieldNode);
+
+    const PDFDocument* m_document;
+    QCryptographicHash m_hash;
+    std::map<PDFObjectReference, qint64> m_visitedReferences;
+    std::vector<PDFObjectReference> m_optionalContentGroups;
+};
+
+void PDFPageContentHasher::addInteger(qint64 value)
+{
+    const qint64 littleEndianValue = qToLittleEndian(value);
+    m_hash.addData(QByteArrayView(reinterpret_cast<const char*>(&littleEndianValue), sizeof(littleEndianValue)));
+}
+
+void PDFPageContentHasher::addReal(PDFReal value)
+{
+    qint64 bits = 0;
+    static_assert(sizeof(bits) == sizeof(value));
+    std::memcpy(&bits, &value, sizeof(value));
+    addInteger(bits);
+}
+
+void PDFPageContentHasher::addBytes(const QByteArray& value)
+{
+    addInteger(value.size());
+    m_hash.addData(value);
+}
+
+void PDFPageContentHasher::addRect(const QRectF& rect)
+{
+    addReal(rect.left());
+    addReal(rect.top());
+    addReal(rect.width());
+    addReal(rect.height());
+}
+
+void PDFPageContentHasher::addObject(const PDFObject& object)
+{
+    switch (object.getType())
+    {
+        case PDFObject::Type::Null:
+            addTag('N');
+            break;
+
+        case PDFObject::Type::Bool:
+            addTag(object.getBool() ? 'T' : 'F');
+            break;
+
+        case PDFObject::Type::Int:
+            addTag('I');
+            addInteger(object.getInteger());
+            break;
+
+        case PDFObject::Type::Real:
+            addTag('D');
+            addReal(object.getReal());
+            break;
+
+        case PDFObject::Type::String:
+            addTag('S');
+            addBytes(object.getString());
+            break;
+
+        case PDFObject::Type::Name:
+            addTag('/');
+            addBytes(object.getString());
+            break;
+
+        case PDFObject::Type::Array:
+        {
+            const PDFArray* array = object.getArray();
+            const size_t count = array->getCount();
+
+            addTag('[');
+            addInteger(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                addObject(array->getItem(i));
+            }
+            break;
+        }
+
+        case PDFObject::Type::Dictionary:
+            addDictionary(object.getDictionary());
+            break;
+
+        case PDFObject::Type::Stream:
+        {
+            // Raw (encoded) data are hashed, so we do not need
+            // to decode the streams, filters are part of the dictionary.
+            const PDFStream* stream = object.getStream();
+            addTag('X');
+            addDictionary(stream->getDictionary());
+            addBytes(*stream->getContent());
+            break;
+        }
+
+        case PDFObject::Type::Reference:
+        {
+            const PDFObjectReference reference = object.getReference();
+            auto it = m_visitedReferences.find(reference);
+            if (it != m_visitedReferences.cend())
+            {
+                addTag('R');
+                addInteger(it->second);
+            }
+            else
+            {
+                const qint64 ordinal = qint64(m_visitedReferences.size());
+                m_visitedReferences[reference] = ordinal;
+                addTag('O');
+                addInteger(ordinal);
+
+                const PDFObject& referencedObject = m_document->getObjectByReference(reference);
+                if (referencedObject.isDictionary())
+                {
+                    const PDFObject& type = referencedObject.getDictionary()->get("Type");
+                    if (type.isName() && type.getString() == "OCG")
+                    {
+                        m_optionalContentGroups.push_back(reference);
+                    }
+                }
+                addObject(referencedObject);
+            }
+            break;
+        }
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+}
+
+void PDFPageContentHasher::addDictionary(const PDFDictionary* dictionary)
+{
+    // Parent of the page (or of the page tree node) is the page tree, which
+    // doesn't affect the content. But parent of the form field contains
+    // inherited attributes (for example, value or default appearance), which
+    // affect appearance of the widget annotation, so it must be hashed.
+    // Children of the form field don't affect its appearance.
+    const PDFObject& type = dictionary->get("Type");
+    const bool isPageTreeNode = type.isName() && (type.getString() == "Page" || type.getString() == "Pages");
+    const bool isFieldNode = !isPageTreeNode && (dictionary->hasKey("FT") || dictionary->hasKey("T"));
+
+    // Dictionary entries are hashed sorted by the key, so the
+    // order of the entries in the file doesn't matter.
+    std::vector<std::pair<QByteArray, size_t>> entries;
+    entries.reserve(dictionary->getCount());
+    for (size_t i = 0; i < dictionary->getCount(); ++i)
+    {
+        QByteArray key = dictionary->getKey(i).getString();
+        if (!isIgnoredEntry(key, dictionary->getValue(i), isPageTreeNode, isFieldNode))
+        {
+            entries.emplace_back(qMove(key), i);
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+
+    addTag('<');
+    addInteger(entries.size());
+    for (const auto& entry : entries)
+    {
+        addBytes(entry.first);
+        addObject(dictionary->getValue(entry.second));
+    }
+    addTag('>');
+}
+
+bool PDFPageContentHasher::isIgnoredEntry(const QByteArray& key, const PDFObject& value, bool isPageTreeNode, bool isFieldNode)
+{
+    if (key == "Parent")
+    {
+        return isPageTreeNode;
+    }
+
+    if (key == "Kids")
+    {
+        return isPageTreeNode || isFieldNode;
+    }
+
+    // Entry 'P' of the annotation references its page, but entry 'P'
+    // of the optional content membership dictionary is visibility policy.
+    if (key == "P")
+    {
+        return value.isReference();
+    }
+
+    static const std::array<const char*, 5> ignoredKeys = { "StructParent", "StructParents", "Metadata", "PieceInfo", "LastModified" };
+    return std::any_of(ignoredKeys.cbegin(), ignoredKeys.cend(), [&key](const char* ignoredKey) { return key == ignoredKey; });
+}
+
+QByteArray PDFPageContentHash::compute(const PDFDocument* document,
+                                       PDFInteger pageIndex,
+                                       Options options,
+                                       std::vector<PDFObjectReference>* optionalContentGroups)
+{
+    const PDFPage* page = document ? document->getCatalog()->getPage(pageIndex) : nullptr;
+    if (!page)
+    {
+        return QByteArray();
+    }
+
+    try
+    {
+        PDFPageContentHasher hasher(document);
+
+        // Page geometry
+        hasher.addRect(page->getMediaBox());
+        hasher.addRect(page->getCropBox());
+        hasher.addRect(page->getBleedBox());
+        hasher.addRect(page->getTrimBox());
+        hasher.addRect(page->getArtBox());
+        hasher.addInteger(int(page->getPageRotation()));
+        hasher.addReal(page->getUserUnit());
+
+        // Content and resources (resources can be inherited from the page tree)
+        hasher.addObject(page->getContents());
+        hasher.addObject(page->getResources());
+
+        if (const PDFDictionary* pageDictionary = document->getDictionaryFromObject(document->getObjectByReference(page->getPageReference())))
+        {
+            hasher.addObject(pageDictionary->get("Group"));
+        }
+
+        // Output intents are used by color management
+        const PDFDictionary* trailerDictionary = document->getTrailerDictionary();
+        const PDFDictionary* catalogDictionary = trailerDictionary ? document->getDictionaryFromObject(trailerDictionary->get("Root")) : nullptr;
+        if (catalogDictionary)
+        {
+            hasher.addObject(catalogDictionary->get("OutputIntents"));
+        }
+
+        if (options.testFlag(Annotations))
+        {
+            hasher.addTag('A');
+            hasher.addInteger(page->getAnnotations().size());
+            for (const PDFObjectReference& annotationReference : page->getAnnotations())
+            {
+                hasher.addObject(PDFObject::createReference(annotationReference));
+            }
+
+            // Appearance of the form fields can be regenerated using default resources
+            if (catalogDictionary)
+            {
+                if (const PDFDictionary* formDictionary = document->getDictionaryFromObject(catalogDictionary->get("AcroForm")))
+                {
+                    hasher.addObject(formDictionary->get("NeedAppearances"));
+                    hasher.addObject(formDictionary->get("DR"));
+                    hasher.addObject(formDictionary->get("DA"));
+                }
+            }
+        }
+
+        if (options.testFlag(Thumbnail))
+        {
+            hasher.addTag('T');
+            hasher.addObject(page->getThumbnailReference().isValid() ? PDFObject::createReference(page->getThumbnailReference()) : PDFObject());
+        }
+
+        if (optionalContentGroups)
+        {
+            *optionalContentGroups = hasher.getOptionalContentGroups();
+        }
+
+        return hasher.getResult();
+    }
+    catch (const PDFException&)
+    {
+        return QByteArray();
+    }
+}
+
+QByteArray PDFPageContentHash::createSettingsFingerprint(const QByteArray& parameters,
+                                                         PDFRenderer::Features features,
+                                                         const PDFMeshQualitySettings& meshQualitySettings,
+                                                         const PDFCMSSettings& cmsSettings,
+                                                         const PDFOptionalContentActivity* optionalContentActivity,
+                                                         const std::vector<PDFObjectReference>& optionalContentGroups)
+{
+    QByteArray settings;
+
+    {
+        QDataStream stream(&settings, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+
+        stream << parameters;
+        stream << int(features);
+        stream << meshQualitySettings.preferredMeshResolutionRatio;
+        stream << meshQualitySettings.minimalMeshResolutionRatio;
+        stream << meshQualitySettings.tolerance;
+
+        stream << int(cmsSettings.system) << int(cmsSettings.accuracy);
+        stream << int(cmsSettings.intent) << int(cmsSettings.proofingIntent);
+        stream << int(cmsSettings.colorAdaptationXYZ);
+        stream << cmsSettings.isBlackPointCompensationActive << cmsSettings.isWhitePaperColorTransformed;
+        stream << cmsSettings.isGamutChecking << cmsSettings.isSoftProofing << cmsSettings.isConsiderOutputIntent;
+        stream << cmsSettings.isColorLookupTableUsed;
+        stream << cmsSettings.outOfGamutColor << cmsSettings.outputCS;
+        stream << cmsSettings.deviceGray << cmsSettings.deviceRGB << cmsSettings.deviceCMYK;
+        stream << cmsSettings.softProofingProfile << cmsSettings.profileDirectory;
+        stream << cmsSettings.foregroundColor << cmsSettings.backgroundColor;
+        stream << cmsSettings.bitonalThreshold << cmsSettings.sigmoidSlopeFactor;
+
+        // States are keyed by the order of the groups, not by their references,
+        // because references differ, when identical page is in other document.
+        if (optionalContentActivity)
+        {
+            stream << quint64(optionalContentGroups.size());
+            for (const PDFObjectReference& ocg : optionalContentGroups)
+            {
+                stream << int(optionalContentActivity->getState(ocg));
+            }
+        }
+    }
+
+    return settings;
+}
+
+}   // namespace pdf
@@ -0,0 +1,87 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFPAGECONTENTHASH_H
+#define PDFPAGECONTENTHASH_H
+
+#include "pdfglobal.h"
+#include "pdfrenderer.h"
+
+#include <QByteArray>
+
+#include <vector>
+
+namespace pdf
+{
+class PDFDocument;
+class PDFOptionalContentActivity;
+struct PDFCMSSettings;
+
+/// Canonical hash of the page content. Hash covers page geometry, content
+/// streams and all resources transitively referenced from the page, but it
+/// doesn't depend on the object numbers, or on the order of the dictionary
+/// entries. So identical pages in different documents (for example, repeated
+/// letterheads or terms and conditions) have the same hash, and results
+/// computed for the page can be reused across documents (see PDFDiskCache).
+class PDF4QTLIBCORESHARED_EXPORT PDFPageContentHash
+{
+public:
+
+    enum Option
+    {
+        None        = 0x0000,
+        Annotations = 0x0001,   ///< Hash also annotations of the page (use, when annotations are rendered)
+        Thumbnail   = 0x0002,   ///< Hash also embedded thumbnail image of the page
+    };
+    Q_DECLARE_FLAGS(Options, Option)
+
+    /// Computes canonical hash of the page. If page doesn't exist,
+    /// or error occurs, empty byte array is returned.
+    /// \param document Document
+    /// \param pageIndex Page index
+    /// \param options Options
+    /// \param optionalContentGroups If not nullptr, optional content groups referenced
+    ///        by the page are stored here (in canonical order, which is the same for
+    ///        pages with the same hash)
+    static QByteArray compute(const PDFDocument* document,
+                              PDFInteger pageIndex,
+                              Options options = None,
+                              std::vector<PDFObjectReference>* optionalContentGroups = nullptr);
+
+    /// Creates fingerprint of the settings, which affect rendered
+    /// (or compiled) page. Fingerprint should be passed as parameters
+    /// of the disk cache key.
+    /// \param parameters Additional parameters (for example, image size)
+    /// \param features Renderer features
+    /// \param meshQualitySettings Mesh quality settings
+    /// \param cmsSettings Color management settings
+    /// \param optionalContentActivity Optional content activity (can be nullptr)
+    /// \param optionalContentGroups Optional content groups, whose states are part of
+    ///        the fingerprint (for page keys, groups returned by \p compute function)
+    static QByteArray createSettingsFingerprint(const QByteArray& parameters,
+                                                PDFRenderer::Features features,
+                                                const PDFMeshQualitySettings& meshQualitySettings,
+                                                const PDFCMSSettings& cmsSettings,
+                                                const PDFOptionalContentActivity* optionalContentActivity,
+                                                const std::vector<PDFObjectReference>& optionalContentGroups);
+};
+
+}   // namespace pdf
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(pdf::PDFPageContentHash::Options)
+
+#endif // PDFPAGECONTENTHASH_H
@@ -22,10 +22,19 @@
 #include "pdfpattern.h"
 #include "pdfexecutionpolicy.h"
 #include "pdfstreamfilters.h"
+#include "pdfconstants.h"
 
 #include <QPainterPathStroker>
+#include <QElapsedTimer>
 #include <QtMath>
 
+#include <optional>
+#include <utility>
+#include <array>
+#include <string>
+#include <set>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -159,6 +168,36 @@ static constexpr const std::pair<const char*, PDFPageContentProcessor::Operator>
     { "EX", PDFPageContentProcessor::Operator::CompatibilityEnd }
 };
 
+/// Returns key of the operator formed by its characters. All operators have at most
+/// three characters, so operators can be found by comparing integers. Zero is returned
+/// for commands, which can't be operators.
+static constexpr quint32 getOperatorKey(const char* command, size_t length)
+{
+    if (length == 0 || length > 3)
+    {
+        return 0;
+    }
+
+    quint32 key = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        key = (key << 8) | static_cast<unsigned char>(command[i]);
+    }
+    return key;
+}
+
+/// Operators sorted by their keys, table is created in compile time
+static constexpr auto operatorTable = []()
+{
+    std::array<std::pair<quint32, PDFPageContentProcessor::Operator>, std::size(operators)> table{};
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        table[i] = std::make_pair(getOperatorKey(operators[i].first, std::char_traits<char>::length(operators[i].first)), operators[i].second);
+    }
+    std::sort(table.begin(), table.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+    return table;
+}();
+
 void PDFPageContentProcessor::initDictionaries(const PDFObject& resourcesObject)
 {
     const PDFObject& resources = m_document->getObject(resourcesObject);
@@ -222,6 +261,86 @@ void PDFPageContentProcessor::initDictionaries(const PDFObject& resourcesObject)
     }
 }
 
+void PDFPageContentProcessorStatistics::merge(const PDFPageContentProcessorStatistics& other)
+{
+    for (size_t i = 0; i < CATEGORY_COUNT; ++i)
+    {
+        operators[i].merge(other.operators[i]);
+    }
+
+    for (const auto& item : other.imageDecoding)
+    {
+        imageDecoding[item.first].merge(item.second);
+    }
+
+    imageColorConversion.merge(other.imageColorConversion);
+    colorConversion.merge(other.colorConversion);
+    imageCacheHits += other.imageCacheHits;
+    imageCacheMisses += other.imageCacheMisses;
+    contentStreamCacheHits += other.contentStreamCacheHits;
+    contentStreamCacheMisses += other.contentStreamCacheMisses;
+    colorCacheHits += other.colorCacheHits;
+    colorCacheMisses += other.colorCacheMisses;
+
+    for (const auto& item : other.xobjects)
+    {
+        XObjectEntry& xobject = xobjects[item.first];
+        if (xobject.name.isEmpty())
+        {
+            xobject.name = item.second.name;
+            xobject.isImage = item.second.isImage;
+        }
+        xobject.entry.merge(item.second.entry);
+    }
+
+    for (const auto& item : other.operatorCounts)
+    {
+        operatorCounts[item.first] += item.second;
+    }
+
+    meshes.merge(other.meshes);
+    meshTriangles += other.meshTriangles;
+}
+
+QString PDFPageContentProcessorStatistics::getCategoryName(Category category)
+{
+    switch (category)
+    {
+        case Category::GraphicState:
+            return PDFTranslationContext::tr("Graphic state");
+
+        case Category::Path:
+            return PDFTranslationContext::tr("Path");
+
+        case Category::Text:
+            return PDFTranslationContext::tr("Text");
+
+        case Category::Color:
+            return PDFTranslationContext::tr("Color");
+
+        case Category::Shading:
+            return PDFTranslationContext::tr("Shading");
+
+        case Category::Image:
+            return PDFTranslationContext::tr("Image");
+
+        case Category::XObject:
+            return PDFTranslationContext::tr("XObject");
+
+        case Category::MarkedContent:
+            return PDFTranslationContext::tr("Marked content");
+
+        case Category::Other:
+            return PDFTranslationContext::tr("Other");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
 PDFPageContentProcessor::PDFPageContentProcessor(const PDFPage* page,
                                                  const PDFDocument* document,
                                                  const PDFFontCache* fontCache,
@@ -249,7 +368,9 @@ PDFPageContentProcessor::PDFPageContentProcessor(const PDFPage* page,
     m_patternBaseMatrix(pagePointToDevicePointMatrix),
     m_pagePointToDevicePointMatrix(pagePointToDevicePointMatrix),
     m_meshQualitySettings(meshQualitySettings),
-    m_structuralParentKey(0)
+    m_structuralParentKey(0),
+    m_pageContentStreamIndex(-1),
+    m_contentNestingLevel(0)
 {
     Q_ASSERT(page);
     Q_ASSERT(document);
@@ -306,6 +427,7 @@ QList<PDFRenderError> PDFPageContentProcessor::processContents()
 
     // Initialize stream processor
     initializeProcessor();
+    performPageContentsBegin();
 
     if (contents.isArray())
     {
@@ -323,6 +445,7 @@ QList<PDFRenderError> PDFPageContentProcessor::processContents()
             const PDFObject& streamObject = m_document->getObject(array->getItem(i));
             if (streamObject.isStream())
             {
+                PDFTemporaryValueChange streamIndexGuard(&m_pageContentStreamIndex, PDFInteger(i));
                 processContentStream(streamObject.getStream());
             }
             else
@@ -333,6 +456,7 @@ QList<PDFRenderError> PDFPageContentProcessor::processContents()
     }
     else if (contents.isStream())
     {
+        PDFTemporaryValueChange streamIndexGuard(&m_pageContentStreamIndex, PDFInteger(0));
         processContentStream(contents.getStream());
     }
     else
@@ -355,6 +479,92 @@ QList<PDFRenderError> PDFPageContentProcessor::processContents()
     return m_errorList;
 }
 
+QList<PDFRenderError> PDFPageContentProcessor::processTilingPatternCell(const PDFTilingPattern* tilingPattern,
+                                                                        PDFColorSpacePointer uncoloredPatternColorSpace,
+                                                                        PDFColor uncoloredPatternColor)
+{
+    // Initialize stream processor
+    initializeProcessor();
+
+    try
+    {
+        const PDFObject& resources = tilingPattern->getResources();
+        if (!resources.isNull())
+        {
+            initDictionaries(resources);
+        }
+
+        const int uncoloredTilingPatternFlag = initializeTilingPatternColors(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor) ? 1 : 0;
+        updateGraphicState();
+
+        PDFTemporaryValueChange guard(&m_drawingUncoloredTilingPatternState, m_drawingUncoloredTilingPatternState + uncoloredTilingPatternFlag);
+
+        QPainterPath boundingPath;
+        boundingPath.addRect(tilingPattern->getBoundingBox());
+        performClipping(boundingPath, boundingPath.fillRule());
+        processContent(tilingPattern->getContent());
+    }
+    catch (const PDFException& exception)
+    {
+        m_errorList.append(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+    }
+    catch (const PDFRendererException& exception)
+    {
+        m_errorList.append(exception.getError());
+    }
+
+    if (!m_stack.empty())
+    {
+        // Stack is not empty. There was more saves than restores. This is error.
+        m_errorList.append(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Graphic state stack was saved more times, than was restored.")));
+
+        while (!m_stack.empty())
+        {
+            operatorRestoreGraphicState();
+        }
+    }
+
+    finishMarkedContent();
+    return m_errorList;
+}
+
+QList<PDFRenderError> PDFPageContentProcessor::processFormXObject(const PDFStream* formStream, const PDFPageContentProcessorState& state)
+{
+    // Initialize stream processor
+    initializeProcessor();
+
+    try
+    {
+        m_graphicState = state;
+        m_graphicState.setStateFlags(PDFPageContentProcessorState::StateAll);
+        updateGraphicState();
+
+        processForm(formStream);
+    }
+    catch (const PDFException& exception)
+    {
+        m_errorList.append(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+    }
+    catch (const PDFRendererException& exception)
+    {
+        m_errorList.append(exception.getError());
+    }
+
+    if (!m_stack.empty())
+    {
+        // Stack is not empty. There was more saves than restores. This is error.
+        m_errorList.append(PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Graphic state stack was saved more times, than was restored.")));
+
+        while (!m_stack.empty())
+        {
+            operatorRestoreGraphicState();
+        }
+    }
+
+    finishMarkedContent();
+    return m_errorList;
+}
+
 void PDFPageContentProcessor::reportRenderError(RenderErrorType type, QString message)
 {
     m_errorList.append(PDFRenderError(type, qMove(message)));
@@ -396,6 +606,12 @@ bool PDFPageContentProcessor::performOriginalImagePainting(const PDFImage& image
     return false;
 }
 
+bool PDFPageContentProcessor::performImageStreamPainting(const PDFStream* stream)
+{
+    Q_UNUSED(stream);
+    return false;
+}
+
 void PDFPageContentProcessor::performImagePainting(const QImage& image)
 {
     Q_UNUSED(image);
@@ -470,11 +686,36 @@ void PDFPageContentProcessor::performEndTransparencyGroup(ProcessOrder order, co
     Q_UNUSED(transparencyGroup);
 }
 
+bool PDFPageContentProcessor::performPaintFormInstance(const PDFStream* formStream)
+{
+    Q_UNUSED(formStream);
+    return false;
+}
+
+void PDFPageContentProcessor::performFormProcessed(const PDFStream* formStream)
+{
+    Q_UNUSED(formStream);
+}
+
 void PDFPageContentProcessor::performOutputCharacter(const PDFTextCharacterInfo& info)
 {
     Q_UNUSED(info);
 }
 
+bool PDFPageContentProcessor::performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                                           const QPainterPath& path,
+                                                           const QPointF& tilingOrigin,
+                                                           PDFColorSpacePointer uncoloredPatternColorSpace,
+                                                           PDFColor uncoloredPatternColor)
+{
+    Q_UNUSED(tilingPattern);
+    Q_UNUSED(path);
+    Q_UNUSED(tilingOrigin);
+    Q_UNUSED(uncoloredPatternColorSpace);
+    Q_UNUSED(uncoloredPatternColor);
+    return false;
+}
+
 void PDFPageContentProcessor::performTextBegin(ProcessOrder order)
 {
     Q_UNUSED(order);
@@ -485,12 +726,30 @@ void PDFPageContentProcessor::performTextEnd(ProcessOrder order)
     Q_UNUSED(order);
 }
 
+void PDFPageContentProcessor::performPageContentOperator(PDFInteger streamIndex, PDFInteger operatorStart, PDFInteger operatorEnd, const QByteArray& command)
+{
+    Q_UNUSED(streamIndex);
+    Q_UNUSED(operatorStart);
+    Q_UNUSED(operatorEnd);
+    Q_UNUSED(command);
+}
+
+void PDFPageContentProcessor::performPageContentsBegin()
+{
+
+}
+
 bool PDFPageContentProcessor::isContentKindSuppressed(ContentKind kind) const
 {
     Q_UNUSED(kind);
     return false;
 }
 
+bool PDFPageContentProcessor::isTextOnlyProcessing() const
+{
+    return false;
+}
+
 void PDFPageContentProcessor::setGraphicsState(const PDFPageContentProcessorState& state)
 {
     m_graphicState = state;
@@ -528,27 +787,152 @@ PDFPageContentProcessor::PDFTransparencyGroup PDFPageContentProcessor::parseTran
     return group;
 }
 
+template<typename Function>
+void PDFPageContentProcessor::processWithStatistics(PDFPageContentProcessorStatistics::Category category, Function function)
+{
+    if (!m_statistics)
+    {
+        function();
+        return;
+    }
+
+    // Jakub Melka: Operators can be nested (for example, content stream of the form
+    // XObject is processed in the Do operator). We measure exclusive time of
+    // each operator, so time of the nested operators is subtracted. Category can be
+    // changed during processing of the operator (Do operator painting an image).
+    QElapsedTimer timer;
+    timer.start();
+
+    const qint64 outerNestedTime = std::exchange(m_statisticsNestedTime, 0);
+    const PDFPageContentProcessorStatistics::Category outerCategory = std::exchange(m_statisticsCategory, category);
+
+    auto finish = [&]()
+    {
+        const qint64 elapsed = timer.nsecsElapsed();
+        m_statistics->operators[static_cast<size_t>(m_statisticsCategory)].add(elapsed - m_statisticsNestedTime);
+        m_statisticsNestedTime = outerNestedTime + elapsed;
+        m_statisticsCategory = outerCategory;
+    };
+
+    try
+    {
+        function();
+    }
+    catch (...)
+    {
+        finish();
+        throw;
+    }
+
+    finish();
+}
+
+PDFPageContentProcessorStatistics::Category PDFPageContentProcessor::getStatisticsCategory(Operator op)
+{
+    using Category = PDFPageContentProcessorStatistics::Category;
+
+    if (op <= Operator::AdjustCurrentTransformationMatrix)
+    {
+        return Category::GraphicState;
+    }
+    if (op <= Operator::ClipEvenOdd)
+    {
+        return Category::Path;
+    }
+    if (op <= Operator::Type3FontSetOffsetAndBB)
+    {
+        return Category::Text;
+    }
+    if (op <= Operator::ColorSetDeviceCMYKFilling)
+    {
+        return Category::Color;
+    }
+    if (op == Operator::ShadingPaintShape)
+    {
+        return Category::Shading;
+    }
+    if (op <= Operator::InlineImageEnd)
+    {
+        return Category::Image;
+    }
+    if (op == Operator::PaintXObject)
+    {
+        return Category::XObject;
+    }
+    if (op <= Operator::MarkedContentEnd)
+    {
+        return Category::MarkedContent;
+    }
+
+    return Category::Other;
+}
+
 void PDFPageContentProcessor::processContent(const QByteArray& content)
 {
-    PDFLexicalAnalyzer parser(content.constBegin(), content.constEnd());
+    ContentStreamProgramPointer program = parseContent(content);
+    processContentStreamProgram(*program);
+}
+
+PDFPageContentProcessor::ContentStreamProgramPointer PDFPageContentProcessor::parseContent(const QByteArray& content)
+{
+    using InstructionType = ContentStreamProgram::InstructionType;
 
-    while (!parser.isAtEnd() && !isProcessingCancelled())
+    std::shared_ptr<ContentStreamProgram> program = std::make_shared<ContentStreamProgram>();
+    program->content = content;
+
+    // Names of the operators are pointing into the content of the program
+    const QByteArray& programContent = program->content;
+    PDFLexicalAnalyzer parser(programContent.constBegin(), programContent.constEnd());
+
+    PDFInteger operatorStartPosition = -1;
+    size_t operandIndex = 0;
+
+    auto addInstruction = [&](InstructionType type, Operator op, QByteArrayView command, PDFInteger endPosition, size_t dataIndex)
+    {
+        ContentStreamProgram::Instruction instruction;
+        instruction.type = type;
+        instruction.op = op;
+        instruction.command = command;
+        instruction.startPosition = operatorStartPosition;
+        instruction.endPosition = endPosition;
+        instruction.operandIndex = operandIndex;
+        instruction.operandCount = program->operands.size() - operandIndex;
+        instruction.dataIndex = dataIndex;
+        program->instructions.push_back(instruction);
+
+        operandIndex = program->operands.size();
+        operatorStartPosition = -1;
+    };
+
+    while (!parser.isAtEnd())
     {
+        if (isProcessingCancelled())
+        {
+            program->isComplete = false;
+            break;
+        }
+
         bool tokenFetched = false;
         PDFInteger oldParserPosition = parser.pos();
 
         try
         {
-            PDFLexicalAnalyzer::Token token = parser.fetch();
+            QByteArrayView command;
+            PDFLexicalAnalyzer::Token token = parser.fetchContentStreamToken(command);
             tokenFetched = true;
 
             switch (token.type)
             {
                 case PDFLexicalAnalyzer::TokenType::Command:
                 {
-                    QByteArray command = token.data.toByteArray();
+                    const Operator op = getOperator(command);
 
-                    if (command == "BI")
+                    if (operatorStartPosition == -1)
+                    {
+                        operatorStartPosition = oldParserPosition;
+                    }
+
+                    if (op == Operator::InlineImageBegin)
                     {
                         // Strategy: We will try to find position of BI/ID/EI in the stream. If we can determine
                         // length of the stream explicitly, then we use explicit length. We also create a PDFObject
@@ -566,11 +950,11 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                             throw PDFException(PDFTranslationContext::tr("Invalid inline image dictionary, ID operator is missing."));
                         }
 
-                        Q_ASSERT(operatorBIPosition < content.size());
-                        Q_ASSERT(operatorIDPosition < content.size());
+                        Q_ASSERT(operatorBIPosition < programContent.size());
+                        Q_ASSERT(operatorIDPosition < programContent.size());
                         Q_ASSERT(operatorBIPosition <= operatorIDPosition);
 
-                        PDFLexicalAnalyzer inlineImageLexicalAnalyzer(content.constBegin() + operatorBIPosition, content.constBegin() + operatorIDPosition);
+                        PDFLexicalAnalyzer inlineImageLexicalAnalyzer(programContent.constBegin() + operatorBIPosition, programContent.constBegin() + operatorIDPosition);
                         PDFParser inlineImageParser([&inlineImageLexicalAnalyzer]{ return inlineImageLexicalAnalyzer.fetch(); });
 
                         constexpr std::pair<const char*, const char*> replacements[] =
@@ -590,8 +974,7 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                             { "CMYK", "DeviceCMYK" }
                         };
 
-                        std::shared_ptr<PDFDictionary> dictionarySharedPointer = std::make_shared<PDFDictionary>();
-                        PDFDictionary* dictionary = dictionarySharedPointer.get();
+                        PDFDictionary dictionary;
 
                         while (inlineImageParser.lookahead().type != PDFLexicalAnalyzer::TokenType::EndOfFile)
                         {
@@ -614,25 +997,25 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                                 }
                             }
 
-                            dictionary->addEntry(PDFInplaceOrMemoryString(qMove(name)), qMove(valueObject));
+                            dictionary.addEntry(PDFInplaceOrMemoryString(qMove(name)), qMove(valueObject));
                         }
 
                         PDFDocumentDataLoaderDecorator loader(m_document);
                         PDFInteger dataLength = 0;
 
-                        if (dictionary->hasKey("Length"))
+                        if (dictionary.hasKey("Length"))
                         {
-                            dataLength = loader.readIntegerFromDictionary(dictionary, "Length", 0);
+                            dataLength = loader.readIntegerFromDictionary(&dictionary, "Length", 0);
                         }
-                        else if (dictionary->hasKey("Filter"))
+                        else if (dictionary.hasKey("Filter"))
                         {
                             dataLength = -1;
 
                             // We will try to use stream filter hint
-                            QByteArray filterName = loader.readNameFromDictionary(dictionary, "Filter");
+                            QByteArray filterName = loader.readNameFromDictionary(&dictionary, "Filter");
                             if (!filterName.isEmpty())
                             {
-                                dataLength = PDFStreamFilterStorage::getStreamDataLength(content, filterName, startDataPosition);
+                                dataLength = PDFStreamFilterStorage::getStreamDataLength(programContent, filterName, startDataPosition);
                             }
 
                             if (dataLength == -1)
@@ -644,9 +1027,9 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                         else
                         {
                             // We will calculate stream size from the with/height and bit per component
-                            const PDFInteger width = loader.readIntegerFromDictionary(dictionary, "Width", 0);
-                            const PDFInteger height = loader.readIntegerFromDictionary(dictionary, "Height", 0);
-                            const PDFInteger bpc = loader.readIntegerFromDictionary(dictionary, "BitsPerComponent", 8);
+                            const PDFInteger width = loader.readIntegerFromDictionary(&dictionary, "Width", 0);
+                            const PDFInteger height = loader.readIntegerFromDictionary(&dictionary, "Height", 0);
+                            const PDFInteger bpc = loader.readIntegerFromDictionary(&dictionary, "BitsPerComponent", 8);
 
                             if (width <= 0 || height <= 0 || bpc <= 0)
                             {
@@ -664,21 +1047,16 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                             throw PDFException(PDFTranslationContext::tr("Invalid inline image stream."));
                         }
 
-                        // We must seek after EI operator. Then we will paint the image. Because painting of image can throw exception,
-                        // then we will paint the image AFTER we seek the position.
+                        // We must seek after EI operator, image is painted, when program is replayed
                         parser.seek(operatorEIPosition + 2);
 
-                        QByteArray buffer = content.mid(startDataPosition, dataLength);
-                        PDFStream imageStream(std::move(*dictionary), std::move(buffer));
-                        paintXObjectImage(&imageStream);
+                        program->inlineImages.emplace_back(qMove(dictionary), programContent.mid(startDataPosition, dataLength));
+                        addInstruction(InstructionType::InlineImage, op, command, parser.pos(), program->inlineImages.size() - 1);
                     }
                     else
                     {
-                        // Process the command, then clear the operand stack
-                        processCommand(command);
+                        addInstruction(InstructionType::Operator, op, command, parser.pos(), 0);
                     }
-
-                    m_operands.clear();
                     break;
                 }
 
@@ -690,8 +1068,13 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
 
                 default:
                 {
+                    if (operatorStartPosition == -1)
+                    {
+                        operatorStartPosition = oldParserPosition;
+                    }
+
                     // Push the operand onto the operand stack
-                    m_operands.push_back(std::move(token));
+                    program->operands.push_back(std::move(token));
                     break;
                 }
             }
@@ -705,6 +1088,140 @@ void PDFPageContentProcessor::processContent(const QByteArray& content)
                 parser.seek(parser.pos() + 1);
             }
 
+            // Operands are cleared, when error is reported
+            program->operands.resize(operandIndex);
+            program->errors.push_back(exception.getMessage());
+            addInstruction(InstructionType::Error, Operator::Invalid, QByteArrayView(), parser.pos(), program->errors.size() - 1);
+        }
+    }
+
+    if (operandIndex < program->operands.size())
+    {
+        // Operands are left on the operand stack
+        addInstruction(InstructionType::Operands, Operator::Invalid, QByteArrayView(), parser.pos(), 0);
+    }
+
+    return program;
+}
+
+PDFPageContentProcessor::ContentStreamProgramPointer PDFPageContentProcessor::getContentStreamProgram(const PDFStream* stream)
+{
+    PDFContentStreamCache* cache = PDFContentStreamCache::getInstance();
+    PDFContentStreamCache::Key key;
+    key.documentId = m_document->getUniqueId();
+    key.stream = m_document->getStorage().getStreamReference(stream);
+
+    // Only content streams stored in the document can be cached
+    ContentStreamProgramPointer program = key.stream.isValid() ? cache->findProgram(key) : nullptr;
+    if (m_statistics)
+    {
+        ++(program ? m_statistics->contentStreamCacheHits : m_statistics->contentStreamCacheMisses);
+    }
+
+    if (!program)
+    {
+        program = parseContent(m_document->getDecodedStream(stream));
+
+        if (key.stream.isValid())
+        {
+            cache->insertProgram(key, program, nullptr);
+        }
+    }
+
+    return program;
+}
+
+PDFPageContentProcessor::ContentStreamProgramPointer PDFPageContentProcessor::getContentStreamProgram(const PDFFontPointer& font, const QByteArray* content)
+{
+    PDFContentStreamCache* cache = PDFContentStreamCache::getInstance();
+    PDFContentStreamCache::Key key;
+    key.documentId = m_document->getUniqueId();
+    key.glyph = content;
+
+    ContentStreamProgramPointer program = cache->findProgram(key);
+    if (m_statistics)
+    {
+        ++(program ? m_statistics->contentStreamCacheHits : m_statistics->contentStreamCacheMisses);
+    }
+
+    if (!program)
+    {
+        program = parseContent(*content);
+        cache->insertProgram(key, program, font);
+    }
+
+    return program;
+}
+
+void PDFPageContentProcessor::processContentStreamProgram(const ContentStreamProgram& program)
+{
+    using InstructionType = ContentStreamProgram::InstructionType;
+
+    PDFTemporaryValueChange nestingLevelGuard(&m_contentNestingLevel, m_contentNestingLevel + 1);
+
+    // Operators are reported only for page content streams (nested
+    // content, such as forms, is processed at higher levels).
+    const bool reportOperators = m_contentNestingLevel == 1 && m_pageContentStreamIndex != -1;
+
+    for (const ContentStreamProgram::Instruction& instruction : program.instructions)
+    {
+        if (isProcessingCancelled())
+        {
+            break;
+        }
+
+        try
+        {
+            for (size_t i = 0; i < instruction.operandCount; ++i)
+            {
+                m_operands.push_back(program.operands[instruction.operandIndex + i]);
+            }
+
+            switch (instruction.type)
+            {
+                case InstructionType::Operator:
+                {
+                    if (reportOperators)
+                    {
+                        performPageContentOperator(m_pageContentStreamIndex, instruction.startPosition, instruction.endPosition, instruction.command.toByteArray());
+                    }
+
+                    // Process the command, then clear the operand stack
+                    processCommand(instruction.op, instruction.command);
+                    m_operands.clear();
+                    break;
+                }
+
+                case InstructionType::InlineImage:
+                {
+                    if (reportOperators)
+                    {
+                        performPageContentOperator(m_pageContentStreamIndex, instruction.startPosition, instruction.endPosition, instruction.command.toByteArray());
+                    }
+
+                    PDFTemporaryValueChange inlineImageGuard(&m_isPaintingInlineImage, true);
+                    const PDFStream* imageStream = &program.inlineImages[instruction.dataIndex];
+                    processWithStatistics(PDFPageContentProcessorStatistics::Category::Image, [this, imageStream]() { paintXObjectImage(imageStream); });
+                    m_operands.clear();
+                    break;
+                }
+
+                case InstructionType::Error:
+                {
+                    m_operands.clear();
+                    m_errorList.append(PDFRenderError(RenderErrorType::Error, program.errors[instruction.dataIndex]));
+                    break;
+                }
+
+                case InstructionType::Operands:
+                {
+                    // Operands are kept on the operand stack
+                    break;
+                }
+            }
+        }
+        catch (const PDFException& exception)
+        {
             m_operands.clear();
             m_errorList.append(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
         }
@@ -720,9 +1237,8 @@ void PDFPageContentProcessor::processContentStream(const PDFStream* stream)
 {
     try
     {
-        QByteArray content = m_document->getDecodedStream(stream);
-
-        processContent(content);
+        ContentStreamProgramPointer program = getContentStreamProgram(stream);
+        processContentStreamProgram(*program);
     }
     catch (const PDFException& exception)
     {
@@ -737,6 +1253,17 @@ void PDFPageContentProcessor::processForm(const QTransform& matrix,
                                           const PDFObject& transparencyGroup,
                                           const QByteArray& content,
                                           PDFInteger formStructuralParent)
+{
+    ContentStreamProgramPointer program = parseContent(content);
+    processForm(matrix, boundingBox, resources, transparencyGroup, *program, formStructuralParent);
+}
+
+void PDFPageContentProcessor::processForm(const QTransform& matrix,
+                                          const QRectF& boundingBox,
+                                          const PDFObject& resources,
+                                          const PDFObject& transparencyGroup,
+                                          const ContentStreamProgram& program,
+                                          PDFInteger formStructuralParent)
 {
     PDFPageContentProcessorStateGuard guard(this);
     PDFTemporaryValueChange structuralParentChangeGuard(&m_structuralParentKey, formStructuralParent);
@@ -787,7 +1314,7 @@ void PDFPageContentProcessor::processForm(const QTransform& matrix,
         initDictionaries(resources);
     }
 
-    processContent(content);
+    processContentStreamProgram(program);
 }
 
 void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule)
@@ -852,7 +1379,7 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
 
                         if (!performPathPaintingUsingShading(path, false, true, shadingPattern))
                         {
-                            PDFMesh mesh = shadingPattern->createMesh(settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
+                            PDFMesh mesh = createShadingMesh(shadingPattern, settings);
 
                             // Now, merge the current path to the mesh clipping path
                             QPainterPath boundingPath = mesh.getBoundingPath();
@@ -967,7 +1494,7 @@ void PDFPageContentProcessor::processPathPainting(const QPainterPath& path, bool
 
                         if (!performPathPaintingUsingShading(strokedPath, true, false, shadingPattern))
                         {
-                            PDFMesh mesh = shadingPattern->createMesh(settings, m_CMS, m_graphicState.getRenderingIntent(), this, m_operationControl);
+                            PDFMesh mesh = createShadingMesh(shadingPattern, settings);
 
                             QPainterPath boundingPath = mesh.getBoundingPath();
                             if (boundingPath.isEmpty())
@@ -1034,50 +1561,31 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     QTransform pathTransformationMatrix = m_graphicState.getCurrentTransformationMatrix() * matrix.inverted();
     m_graphicState.setCurrentTransformationMatrix(matrix);
 
-    int uncoloredTilingPatternFlag = 0;
-
-    // Initialize colors for uncolored color space pattern
-    if (tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored)
-    {
-        if (!uncoloredPatternColorSpace)
-        {
-            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Uncolored tiling pattern has not underlying color space."));
-        }
-
-        uncoloredTilingPatternFlag = 1;
-
-        m_graphicState.setStrokeColorSpace(uncoloredPatternColorSpace);
-        m_graphicState.setFillColorSpace(uncoloredPatternColorSpace);
-
-        QColor color = uncoloredPatternColorSpace->getCheckedColor(uncoloredPatternColor, m_CMS, m_graphicState.getRenderingIntent(), this);
-        m_graphicState.setStrokeColor(color, uncoloredPatternColor);
-        m_graphicState.setFillColor(color, uncoloredPatternColor);
-    }
-    else
-    {
-        // Jakub Melka: According the specification, we set default color space and default color
-        m_graphicState.setStrokeColorSpace(m_deviceGrayColorSpace);
-        m_graphicState.setFillColorSpace(m_deviceGrayColorSpace);
-
-        QColor color = m_deviceGrayColorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this);
-        m_graphicState.setStrokeColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
-        m_graphicState.setFillColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
-    }
-
+    const int uncoloredTilingPatternFlag = initializeTilingPatternColors(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor) ? 1 : 0;
     updateGraphicState();
 
     // Mark uncolored flag, if we drawing uncolored color pattern
     PDFTemporaryValueChange guard2(&m_drawingUncoloredTilingPatternState, m_drawingUncoloredTilingPatternState + uncoloredTilingPatternFlag);
 
     // Tiling parameters
-    const QRectF tilingArea = pathTransformationMatrix.map(path).boundingRect();
+    const QPainterPath patternPath = pathTransformationMatrix.map(path);
+    const QRectF tilingArea = patternPath.boundingRect();
+
+    if (performTilingPatternPainting(tilingPattern, patternPath, tilingArea.topLeft(), uncoloredPatternColorSpace, uncoloredPatternColor))
+    {
+        // Pattern was painted without processing of the pattern cells
+        return;
+    }
+
     const QRectF boundingBox = tilingPattern->getBoundingBox();
     const PDFReal xStep = qAbs(tilingPattern->getXStep());
     const PDFReal yStep = qAbs(tilingPattern->getYStep());
-    const QByteArray& content = tilingPattern->getContent();
     QPainterPath boundingPath;
     boundingPath.addRect(boundingBox);
 
+    // Content of the cell is parsed only once, then it is replayed for each cell
+    ContentStreamProgramPointer program = parseContent(tilingPattern->getContent());
+
     // Draw the tiling
     const PDFInteger columns = qMax<PDFInteger>(qCeil(tilingArea.width() / xStep), 1);
     const PDFInteger rows = qMax<PDFInteger>(qCeil(tilingArea.height() / yStep), 1);
@@ -1100,7 +1608,7 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
             updateGraphicState();
 
             performClipping(boundingPath, boundingPath.fillRule());
-            processContent(content);
+            processContentStreamProgram(*program);
 
             if (isProcessingCancelled())
             {
@@ -1115,20 +1623,61 @@ void PDFPageContentProcessor::processTillingPatternPainting(const PDFTilingPatte
     }
 }
 
-void PDFPageContentProcessor::processCommand(const QByteArray& command)
+bool PDFPageContentProcessor::initializeTilingPatternColors(const PDFTilingPattern* tilingPattern,
+                                                            PDFColorSpacePointer uncoloredPatternColorSpace,
+                                                            PDFColor uncoloredPatternColor)
 {
-    Operator op = Operator::Invalid;
-
-    // Find the command in the command array
-    for (const std::pair<const char*, PDFPageContentProcessor::Operator>& operatorDescriptor : operators)
+    // Initialize colors for uncolored color space pattern
+    if (tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored)
     {
-        if (command == operatorDescriptor.first)
+        if (!uncoloredPatternColorSpace)
         {
-            op = operatorDescriptor.second;
-            break;
+            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Uncolored tiling pattern has not underlying color space."));
         }
+
+        m_graphicState.setStrokeColorSpace(uncoloredPatternColorSpace);
+        m_graphicState.setFillColorSpace(uncoloredPatternColorSpace);
+
+        QColor color = uncoloredPatternColorSpace->getCheckedColor(uncoloredPatternColor, m_CMS, m_graphicState.getRenderingIntent(), this);
+        m_graphicState.setStrokeColor(color, uncoloredPatternColor);
+        m_graphicState.setFillColor(color, uncoloredPatternColor);
+        return true;
     }
 
+    // Jakub Melka: According the specification, we set default color space and default color
+    m_graphicState.setStrokeColorSpace(m_deviceGrayColorSpace);
+    m_graphicState.setFillColorSpace(m_deviceGrayColorSpace);
+
+    QColor color = m_deviceGrayColorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this);
+    m_graphicState.setStrokeColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
+    m_graphicState.setFillColor(color, m_deviceGrayColorSpace->getDefaultColorOriginal());
+    return false;
+}
+
+void PDFPageContentProcessor::processCommand(Operator op, QByteArrayView command)
+{
+    if (m_statistics)
+    {
+        ++m_statistics->operatorCounts[command.toByteArray()];
+    }
+
+    processWithStatistics(getStatisticsCategory(op), [this, op, command]() { processOperator(op, command); });
+}
+
+PDFPageContentProcessor::Operator PDFPageContentProcessor::getOperator(QByteArrayView command)
+{
+    const quint32 key = getOperatorKey(command.data(), size_t(command.size()));
+    auto it = std::lower_bound(operatorTable.cbegin(), operatorTable.cend(), key, [](const auto& item, quint32 value) { return item.first < value; });
+    if (key != 0 && it != operatorTable.cend() && it->first == key)
+    {
+        return it->second;
+    }
+
+    return Operator::Invalid;
+}
+
+void PDFPageContentProcessor::processOperator(Operator op, QByteArrayView command)
+{
     switch (op)
     {
         case Operator::SetLineWidth:
@@ -1600,11 +2149,9 @@ void PDFPageContentProcessor::processCommand(const QByteArray& command)
 
 QPointF PDFPageContentProcessor::getCurrentPoint() const
 {
-    const int elementCount = m_currentPath.elementCount();
-    if (elementCount > 0)
+    if (m_currentPath.hasCurrentPoint())
     {
-        QPainterPath::Element element = m_currentPath.elementAt(elementCount - 1);
-        return QPointF(element.x, element.y);
+        return m_currentPath.getCurrentPoint();
     }
     else
     {
@@ -1612,6 +2159,72 @@ QPointF PDFPageContentProcessor::getCurrentPoint() const
     }
 }
 
+QColor PDFPageContentProcessor::convertColor(const PDFColorSpacePointer& colorSpace, const PDFColor& color, RenderingIntent renderingIntent)
+{
+    if (!m_statistics)
+    {
+        return colorSpace->getColor(color, m_CMS, renderingIntent, this, true);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QColor convertedColor = colorSpace->getColor(color, m_CMS, renderingIntent, this, true);
+    m_statistics->colorConversion.add(timer.nsecsElapsed());
+    return convertedColor;
+}
+
+QColor PDFPageContentProcessor::getMemoizedColor(const PDFColorSpacePointer& colorSpace, const PDFColor& color)
+{
+    const RenderingIntent renderingIntent = m_graphicState.getRenderingIntent();
+
+    if (color.size() > 4)
+    {
+        // Colors with many components are not memoized
+        return convertColor(colorSpace, color, renderingIntent);
+    }
+
+    std::array<PDFColorComponent, 4> components = { };
+    for (size_t i = 0; i < color.size(); ++i)
+    {
+        components[i] = color[i];
+    }
+
+    ColorCacheKey key(colorSpace.data(), renderingIntent, color.size(), components);
+    auto it = m_colorCache.find(key);
+    if (it != m_colorCache.cend())
+    {
+        if (m_statistics)
+        {
+            ++m_statistics->colorCacheHits;
+        }
+
+        return it->second.first;
+    }
+
+    if (m_statistics)
+    {
+        ++m_statistics->colorCacheMisses;
+    }
+
+    const qsizetype errorCount = m_errorList.size();
+    const size_t onceReportedErrorCount = m_onceReportedErrors.size();
+    QColor convertedColor = convertColor(colorSpace, color, renderingIntent);
+
+    // Colors, for which conversion reported an error, are not memoized,
+    // so error is reported again, if color is used again.
+    if (errorCount == m_errorList.size() && onceReportedErrorCount == m_onceReportedErrors.size())
+    {
+        if (m_colorCache.size() >= COLOR_CACHE_MAX_SIZE)
+        {
+            m_colorCache.clear();
+        }
+
+        m_colorCache.emplace(qMove(key), ColorCacheValue(convertedColor, colorSpace));
+    }
+
+    return convertedColor;
+}
+
 void PDFPageContentProcessor::updateGraphicState()
 {
     if (m_graphicState.getStateFlags())
@@ -2197,37 +2810,78 @@ PDFPageContentProcessor::PDFOperandString PDFPageContentProcessor::readOperand<P
 
 void PDFPageContentProcessor::operatorMoveCurrentPoint(PDFReal x, PDFReal y)
 {
-    m_currentPath.moveTo(x, y);;
+    if (isTextOnlyProcessing())
+    {
+        // Paths are not needed in text-only mode
+        return;
+    }
+
+    m_currentPath.moveTo(QPointF(x, y));
 }
 
 void PDFPageContentProcessor::operatorLineTo(PDFReal x, PDFReal y)
 {
-    m_currentPath.lineTo(x, y);
+    if (isTextOnlyProcessing())
+    {
+        // Paths are not needed in text-only mode
+        return;
+    }
+
+    m_currentPath.lineTo(QPointF(x, y));
 }
 
 void PDFPageContentProcessor::operatorBezier123To(PDFReal x1, PDFReal y1, PDFReal x2, PDFReal y2, PDFReal x3, PDFReal y3)
 {
-    m_currentPath.cubicTo(x1, y1, x2, y2, x3, y3);
+    if (isTextOnlyProcessing())
+    {
+        // Paths are not needed in text-only mode
+        return;
+    }
+
+    m_currentPath.cubicTo(QPointF(x1, y1), QPointF(x2, y2), QPointF(x3, y3));
 }
 
 void PDFPageContentProcessor::operatorBezier23To(PDFReal x2, PDFReal y2, PDFReal x3, PDFReal y3)
 {
-    QPointF currentPoint = getCurrentPoint();
-    m_currentPath.cubicTo(currentPoint.x(), currentPoint.y(), x2, y2, x3, y3);
+    if (isTextOnlyProcessing())
+    {
+        // Paths are not needed in text-only mode
+        return;
+    }
+
+    m_currentPath.cubicTo(getCurrentPoint(), QPointF(x2, y2), QPointF(x3, y3));
 }
 
 void PDFPageContentProcessor::operatorBezier13To(PDFReal x1, PDFReal y1, PDFReal x3, PDFReal y3)
 {
-    m_currentPath.cubicTo(x1, y1, x3, y3, x3, y3);
+    if (isTextOnlyProcessing())
+    {
+        // Paths are not needed in text-only mode
+        return;
+    }
+
+    m_currentPath.cubicTo(QPointF(x1, y1), QPointF(x3, y3), QPointF(x3, y3));
 }
 
 void PDFPageContentProcessor::operatorEndSubpath()
 {
+    if (isTextOnlyProcessing())
+    {
+        // Paths are not needed in text-only mode
+        return;
+    }
+
     m_currentPath.closeSubpath();
 }
 
 void PDFPageContentProcessor::operatorRectangle(PDFReal x, PDFReal y, PDFReal width, PDFReal height)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Paths are not needed in text-only mode
+        return;
+    }
+
     const PDFReal xMin = qMin(x, x + width);
     const PDFReal xMax = qMax(x, x + width);
     const PDFReal yMin = qMin(y, y + height);
@@ -2243,9 +2897,8 @@ void PDFPageContentProcessor::operatorPathStroke()
     // Do not close the path
     if (!m_currentPath.isEmpty())
     {
-        m_currentPath.setFillRule(Qt::WindingFill);
-        processPathPainting(m_currentPath, true, false, false, Qt::WindingFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::WindingFill), true, false, false, Qt::WindingFill);
+        m_currentPath.clear();
     }
 }
 
@@ -2255,9 +2908,8 @@ void PDFPageContentProcessor::operatorPathCloseStroke()
     if (!m_currentPath.isEmpty())
     {
         m_currentPath.closeSubpath();
-        m_currentPath.setFillRule(Qt::WindingFill);
-        processPathPainting(m_currentPath, true, false, false, Qt::WindingFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::WindingFill), true, false, false, Qt::WindingFill);
+        m_currentPath.clear();
     }
 }
 
@@ -2265,9 +2917,8 @@ void PDFPageContentProcessor::operatorPathFillWinding()
 {
     if (!m_currentPath.isEmpty())
     {
-        m_currentPath.setFillRule(Qt::WindingFill);
-        processPathPainting(m_currentPath, false, true, false, Qt::WindingFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::WindingFill), false, true, false, Qt::WindingFill);
+        m_currentPath.clear();
     }
 }
 
@@ -2275,9 +2926,8 @@ void PDFPageContentProcessor::operatorPathFillEvenOdd()
 {
     if (!m_currentPath.isEmpty())
     {
-        m_currentPath.setFillRule(Qt::OddEvenFill);
-        processPathPainting(m_currentPath, false, true, false, Qt::OddEvenFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::OddEvenFill), false, true, false, Qt::OddEvenFill);
+        m_currentPath.clear();
     }
 }
 
@@ -2285,9 +2935,8 @@ void PDFPageContentProcessor::operatorPathFillStrokeWinding()
 {
     if (!m_currentPath.isEmpty())
     {
-        m_currentPath.setFillRule(Qt::WindingFill);
-        processPathPainting(m_currentPath, true, true, false, Qt::WindingFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::WindingFill), true, true, false, Qt::WindingFill);
+        m_currentPath.clear();
     }
 }
 
@@ -2295,9 +2944,8 @@ void PDFPageContentProcessor::operatorPathFillStrokeEvenOdd()
 {
     if (!m_currentPath.isEmpty())
     {
-        m_currentPath.setFillRule(Qt::OddEvenFill);
-        processPathPainting(m_currentPath, true, true, false, Qt::OddEvenFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::OddEvenFill), true, true, false, Qt::OddEvenFill);
+        m_currentPath.clear();
     }
 }
 
@@ -2306,9 +2954,8 @@ void PDFPageContentProcessor::operatorPathCloseFillStrokeWinding()
     if (!m_currentPath.isEmpty())
     {
         m_currentPath.closeSubpath();
-        m_currentPath.setFillRule(Qt::WindingFill);
-        processPathPainting(m_currentPath, true, true, false, Qt::WindingFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::WindingFill), true, true, false, Qt::WindingFill);
+        m_currentPath.clear();
     }
 }
 
@@ -2317,23 +2964,21 @@ void PDFPageContentProcessor::operatorPathCloseFillStrokeEvenOdd()
     if (!m_currentPath.isEmpty())
     {
         m_currentPath.closeSubpath();
-        m_currentPath.setFillRule(Qt::OddEvenFill);
-        processPathPainting(m_currentPath, true, true, false, Qt::OddEvenFill);
-        m_currentPath = QPainterPath();
+        processPathPainting(m_currentPath.toPainterPath(Qt::OddEvenFill), true, true, false, Qt::OddEvenFill);
+        m_currentPath.clear();
     }
 }
 
 void PDFPageContentProcessor::operatorPathClear()
 {
-    m_currentPath = QPainterPath();
+    m_currentPath.clear();
 }
 
 void PDFPageContentProcessor::operatorClipWinding()
 {
     if (!m_currentPath.isEmpty())
     {
-        m_currentPath.setFillRule(Qt::WindingFill);
-        performClipping(m_currentPath, Qt::WindingFill);
+        performClipping(m_currentPath.toPainterPath(Qt::WindingFill), Qt::WindingFill);
     }
 }
 
@@ -2341,8 +2986,7 @@ void PDFPageContentProcessor::operatorClipEvenOdd()
 {
     if (!m_currentPath.isEmpty())
     {
-        m_currentPath.setFillRule(Qt::OddEvenFill);
-        performClipping(m_currentPath, Qt::OddEvenFill);
+        performClipping(m_currentPath.toPainterPath(Qt::OddEvenFill), Qt::OddEvenFill);
     }
 }
 
@@ -2358,6 +3002,12 @@ void PDFPageContentProcessor::operatorType3FontSetOffsetAndBB(PDFReal wx, PDFRea
 
 void PDFPageContentProcessor::operatorColorSetStrokingColorSpace(PDFPageContentProcessor::PDFOperandName name)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2369,7 +3019,7 @@ void PDFPageContentProcessor::operatorColorSetStrokingColorSpace(PDFPageContentP
     {
         // We must also set default color (it can depend on the color space)
         m_graphicState.setStrokeColorSpace(colorSpace);
-        m_graphicState.setStrokeColor(colorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this), colorSpace->getDefaultColorOriginal());
+        m_graphicState.setStrokeColor(getMemoizedColor(colorSpace, colorSpace->getDefaultColorOriginal()), colorSpace->getDefaultColorOriginal());
         updateGraphicState();
         checkStrokingColor();
     }
@@ -2381,6 +3031,12 @@ void PDFPageContentProcessor::operatorColorSetStrokingColorSpace(PDFPageContentP
 
 void PDFPageContentProcessor::operatorColorSetFillingColorSpace(PDFOperandName name)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2392,7 +3048,7 @@ void PDFPageContentProcessor::operatorColorSetFillingColorSpace(PDFOperandName n
     {
         // We must also set default color (it can depend on the color space)
         m_graphicState.setFillColorSpace(colorSpace);
-        m_graphicState.setFillColor(colorSpace->getDefaultColor(m_CMS, m_graphicState.getRenderingIntent(), this), colorSpace->getDefaultColorOriginal());
+        m_graphicState.setFillColor(getMemoizedColor(colorSpace, colorSpace->getDefaultColorOriginal()), colorSpace->getDefaultColorOriginal());
         updateGraphicState();
         checkFillingColor();
     }
@@ -2404,6 +3060,12 @@ void PDFPageContentProcessor::operatorColorSetFillingColorSpace(PDFOperandName n
 
 void PDFPageContentProcessor::operatorColorSetStrokingColor()
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2421,7 +3083,7 @@ void PDFPageContentProcessor::operatorColorSetStrokingColor()
         {
             color.push_back(readOperand<PDFReal>(i));
         }
-        m_graphicState.setStrokeColor(colorSpace->getColor(color, m_CMS, m_graphicState.getRenderingIntent(), this, true), color);
+        m_graphicState.setStrokeColor(getMemoizedColor(m_graphicState.getStrokeColorSpacePointer(), color), color);
         updateGraphicState();
         checkStrokingColor();
     }
@@ -2433,6 +3095,12 @@ void PDFPageContentProcessor::operatorColorSetStrokingColor()
 
 void PDFPageContentProcessor::operatorColorSetStrokingColorN()
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2482,6 +3150,12 @@ void PDFPageContentProcessor::operatorColorSetStrokingColorN()
 
 void PDFPageContentProcessor::operatorColorSetFillingColor()
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2499,7 +3173,7 @@ void PDFPageContentProcessor::operatorColorSetFillingColor()
         {
             color.push_back(readOperand<PDFReal>(i));
         }
-        m_graphicState.setFillColor(colorSpace->getColor(color, m_CMS, m_graphicState.getRenderingIntent(), this, true), color);
+        m_graphicState.setFillColor(getMemoizedColor(m_graphicState.getFillColorSpacePointer(), color), color);
         updateGraphicState();
         checkFillingColor();
     }
@@ -2511,6 +3185,12 @@ void PDFPageContentProcessor::operatorColorSetFillingColor()
 
 void PDFPageContentProcessor::operatorColorSetFillingColorN()
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2560,6 +3240,12 @@ void PDFPageContentProcessor::operatorColorSetFillingColorN()
 
 void PDFPageContentProcessor::operatorColorSetDeviceGrayStroking(PDFReal gray)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2567,13 +3253,19 @@ void PDFPageContentProcessor::operatorColorSetDeviceGrayStroking(PDFReal gray)
     }
 
     m_graphicState.setStrokeColorSpace(m_deviceGrayColorSpace);
-    m_graphicState.setStrokeColor(getColorFromColorSpace(m_graphicState.getStrokeColorSpace(), gray), PDFColor(PDFColorComponent(gray)));
+    m_graphicState.setStrokeColor(getColorFromColorSpace(m_graphicState.getStrokeColorSpacePointer(), gray), PDFColor(PDFColorComponent(gray)));
     updateGraphicState();
     checkStrokingColor();
 }
 
 void PDFPageContentProcessor::operatorColorSetDeviceGrayFilling(PDFReal gray)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2581,13 +3273,19 @@ void PDFPageContentProcessor::operatorColorSetDeviceGrayFilling(PDFReal gray)
     }
 
     m_graphicState.setFillColorSpace(m_deviceGrayColorSpace);
-    m_graphicState.setFillColor(getColorFromColorSpace(m_graphicState.getFillColorSpace(), gray), PDFColor(PDFColorComponent(gray)));
+    m_graphicState.setFillColor(getColorFromColorSpace(m_graphicState.getFillColorSpacePointer(), gray), PDFColor(PDFColorComponent(gray)));
     updateGraphicState();
     checkFillingColor();
 }
 
 void PDFPageContentProcessor::operatorColorSetDeviceRGBStroking(PDFReal r, PDFReal g, PDFReal b)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2595,13 +3293,19 @@ void PDFPageContentProcessor::operatorColorSetDeviceRGBStroking(PDFReal r, PDFRe
     }
 
     m_graphicState.setStrokeColorSpace(m_deviceRGBColorSpace);
-    m_graphicState.setStrokeColor(getColorFromColorSpace(m_graphicState.getStrokeColorSpace(), r, g, b), PDFColor(PDFColorComponent(r), PDFColorComponent(g), PDFColorComponent(b)));
+    m_graphicState.setStrokeColor(getColorFromColorSpace(m_graphicState.getStrokeColorSpacePointer(), r, g, b), PDFColor(PDFColorComponent(r), PDFColorComponent(g), PDFColorComponent(b)));
     updateGraphicState();
     checkStrokingColor();
 }
 
 void PDFPageContentProcessor::operatorColorSetDeviceRGBFilling(PDFReal r, PDFReal g, PDFReal b)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2609,13 +3313,19 @@ void PDFPageContentProcessor::operatorColorSetDeviceRGBFilling(PDFReal r, PDFRea
     }
 
     m_graphicState.setFillColorSpace(m_deviceRGBColorSpace);
-    m_graphicState.setFillColor(getColorFromColorSpace(m_graphicState.getFillColorSpace(), r, g, b), PDFColor(PDFColorComponent(r), PDFColorComponent(g), PDFColorComponent(b)));
+    m_graphicState.setFillColor(getColorFromColorSpace(m_graphicState.getFillColorSpacePointer(), r, g, b), PDFColor(PDFColorComponent(r), PDFColorComponent(g), PDFColorComponent(b)));
     updateGraphicState();
     checkFillingColor();
 }
 
 void PDFPageContentProcessor::operatorColorSetDeviceCMYKStroking(PDFReal c, PDFReal m, PDFReal y, PDFReal k)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2623,13 +3333,19 @@ void PDFPageContentProcessor::operatorColorSetDeviceCMYKStroking(PDFReal c, PDFR
     }
 
     m_graphicState.setStrokeColorSpace(m_deviceCMYKColorSpace);
-    m_graphicState.setStrokeColor(getColorFromColorSpace(m_graphicState.getStrokeColorSpace(), c, m, y, k), PDFColor(PDFColorComponent(c), PDFColorComponent(m), PDFColorComponent(y), PDFColorComponent(k)));
+    m_graphicState.setStrokeColor(getColorFromColorSpace(m_graphicState.getStrokeColorSpacePointer(), c, m, y, k), PDFColor(PDFColorComponent(c), PDFColorComponent(m), PDFColorComponent(y), PDFColorComponent(k)));
     updateGraphicState();
     checkStrokingColor();
 }
 
 void PDFPageContentProcessor::operatorColorSetDeviceCMYKFilling(PDFReal c, PDFReal m, PDFReal y, PDFReal k)
 {
+    if (isTextOnlyProcessing())
+    {
+        // Colors are not needed in text-only mode
+        return;
+    }
+
     if (m_drawingUncoloredTilingPatternState)
     {
         reportWarningAboutColorOperatorsInUTP();
@@ -2637,7 +3353,7 @@ void PDFPageContentProcessor::operatorColorSetDeviceCMYKFilling(PDFReal c, PDFRe
     }
 
     m_graphicState.setFillColorSpace(m_deviceCMYKColorSpace);
-    m_graphicState.setFillColor(getColorFromColorSpace(m_graphicState.getFillColorSpace(), c, m, y, k), PDFColor(PDFColorComponent(c), PDFColorComponent(m), PDFColorComponent(y), PDFColorComponent(k)));
+    m_graphicState.setFillColor(getColorFromColorSpace(m_graphicState.getFillColorSpacePointer(), c, m, y, k), PDFColor(PDFColorComponent(c), PDFColorComponent(m), PDFColorComponent(y), PDFColorComponent(k)));
     updateGraphicState();
     checkFillingColor();
 }
@@ -2949,34 +3665,138 @@ void PDFPageContentProcessor::operatorShadingPaintShape(PDFPageContentProcessor:
 
 void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
 {
+    // Image XObjects are painted by the Do operator
+    m_statisticsCategory = PDFPageContentProcessorStatistics::Category::Image;
+
     if (isContentKindSuppressed(ContentKind::Images))
     {
         // Images are suppressed
         return;
     }
 
-    PDFColorSpacePointer colorSpace;
+    if (performImageStreamPainting(stream))
+    {
+        // Image stream was processed without decoding
+        return;
+    }
+
+    const PDFDictionary* streamDictionary = stream->getDictionary();
+    const bool hasColorSpace = streamDictionary->hasKey("ColorSpace");
+
+    // Decoded images are shared between pages and compilations. Color space
+    // of the image can depend on the resources, so color space dictionary
+    // is a part of the key. Only image streams stored in the document
+    // can be cached, because they are identified by the reference.
+    PDFImageCache* imageCache = PDFImageCache::getInstance();
+    PDFImageCache::Key imageKey;
+    imageKey.documentId = m_document->getUniqueId();
+    imageKey.stream = !m_isPaintingInlineImage ? m_document->getStorage().getStreamReference(stream) : PDFObjectReference();
+    imageKey.colorSpaceDictionary = hasColorSpace ? m_colorSpaceDictionary : nullptr;
+    imageKey.renderingIntent = m_graphicState.getRenderingIntent();
+    imageKey.isSoftMask = false;
+    imageKey.resolutionReduction = getImageResolutionReduction(streamDictionary);
+    imageKey.decodeArea = getImageDecodeArea(stream);
+
+    PDFImage pdfImage;
+    const bool isImageCacheUsed = imageKey.stream.isValid();
+    bool isImageFound = isImageCacheUsed && imageCache->findImage(imageKey, pdfImage);
+
+    // If full quality image isn't decoded yet, we can use its preview
+    if (!isImageFound && isImageCacheUsed && imageKey.resolutionReduction < PDFImage::MAX_RESOLUTION_REDUCTION && isImagePreviewUsed(stream))
+    {
+        imageKey.resolutionReduction = PDFImage::MAX_RESOLUTION_REDUCTION;
+        isImageFound = imageCache->findImage(imageKey, pdfImage);
+        ++m_previewImageCount;
+    }
+
+    if (m_statistics)
+    {
+        ++(isImageFound ? m_statistics->imageCacheHits : m_statistics->imageCacheMisses);
+    }
+
+    if (!isImageFound)
+    {
+        PDFColorSpacePointer colorSpace;
+
+        if (hasColorSpace)
+        {
+            const PDFObject& colorSpaceObject = m_document->getObject(streamDictionary->get("ColorSpace"));
+            if (colorSpaceObject.isName() || colorSpaceObject.isArray())
+            {
+                colorSpace = PDFAbstractColorSpace::createColorSpace(m_colorSpaceDictionary, m_document, colorSpaceObject);
+            }
+            else if (!colorSpaceObject.isNull())
+            {
+                throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Invalid color space of the image."));
+            }
+        }
+
+        const qsizetype errorCount = m_errorList.size();
+        const size_t onceReportedErrorCount = m_onceReportedErrors.size();
+
+        QElapsedTimer decodeTimer;
+        decodeTimer.start();
+
+        pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, m_graphicState.getRenderingIntent(), this, m_operationControl, imageKey.resolutionReduction, imageKey.decodeArea);
+
+        if (m_statistics)
+        {
+            // Image data are decoded by the last filter
+            QByteArray filterName;
+            const PDFObject& filterObject = m_document->getObject(streamDictionary->get("Filter"));
+            if (filterObject.isName())
+            {
+                filterName = filterObject.getString();
+            }
+            else if (filterObject.isArray() && filterObject.getArray()->getCount() > 0)
+            {
+                const PDFArray* filterArray = filterObject.getArray();
+                const PDFObject& lastFilterObject = m_document->getObject(filterArray->getItem(filterArray->getCount() - 1));
+                if (lastFilterObject.isName())
+                {
+                    filterName = lastFilterObject.getString();
+                }
+            }
+
+            m_statistics->imageDecoding[filterName].add(decodeTimer.nsecsElapsed());
+        }
 
-    const PDFDictionary* streamDictionary = stream->getDictionary();
-    if (streamDictionary->hasKey("ColorSpace"))
-    {
-        const PDFObject& colorSpaceObject = m_document->getObject(streamDictionary->get("ColorSpace"));
-        if (colorSpaceObject.isName() || colorSpaceObject.isArray())
+        if (isProcessingCancelled())
         {
-            colorSpace = PDFAbstractColorSpace::createColorSpace(m_colorSpaceDictionary, m_document, colorSpaceObject);
+            return;
         }
-        else if (!colorSpaceObject.isNull())
+
+        // Images decoded with errors are not cached, so errors
+        // are reported each time the image is painted.
+        if (isImageCacheUsed && errorCount == m_errorList.size() && onceReportedErrorCount == m_onceReportedErrors.size())
         {
-            throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Invalid color space of the image."));
+            imageCache->insertImage(imageKey, pdfImage);
         }
     }
 
-    PDFImage pdfImage = PDFImage::createImage(m_document, stream, qMove(colorSpace), false, m_graphicState.getRenderingIntent(), this);
+    // If only part of the image was decoded, then it is painted
+    // onto the corresponding part of the image unit square.
+    std::optional<PDFPageContentProcessorGraphicStateSaveRestoreGuard> decodedAreaGuard;
+    if (pdfImage.isPartiallyDecoded())
+    {
+        const QTransform& matrix = pdfImage.getDecodedAreaMatrix();
+        decodedAreaGuard.emplace(this);
+        operatorAdjustCurrentTransformationMatrix(matrix.m11(), matrix.m12(), matrix.m21(), matrix.m22(), matrix.dx(), matrix.dy());
+        ++m_partiallyDecodedImageCount;
+    }
 
     if (!performOriginalImagePainting(pdfImage))
     {
+        QElapsedTimer conversionTimer;
+        conversionTimer.start();
+
         QImage image = pdfImage.getImage(m_CMS, this, m_operationControl);
 
+        if (m_statistics)
+        {
+            m_statistics->imageColorConversion.add(conversionTimer.nsecsElapsed());
+        }
+
         if (!isProcessingCancelled())
         {
             if (image.format() == QImage::Format_Alpha8)
@@ -3000,6 +3820,126 @@ void PDFPageContentProcessor::paintXObjectImage(const PDFStream* stream)
     }
 }
 
+QRect PDFPageContentProcessor::getImageDecodeArea(const PDFStream* stream) const
+{
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* imageDictionary = stream->getDictionary();
+    const PDFInteger width = loader.readIntegerFromDictionary(imageDictionary, "Width", 0);
+    const PDFInteger height = loader.readIntegerFromDictionary(imageDictionary, "Height", 0);
+
+    if (width * height < DECODE_AREA_MIN_IMAGE_PIXELS || !PDFImage::isDecodeAreaSupported(m_document, stream))
+    {
+        return QRect();
+    }
+
+    const QTransform worldMatrix = getCurrentWorldMatrix();
+    if (!worldMatrix.isInvertible())
+    {
+        return QRect();
+    }
+
+    // Determine part of the image unit square, which is visible on the page
+    const QRectF visibleRect = worldMatrix.inverted().mapRect(m_pageBoundingRectDeviceSpace).intersected(QRectF(0.0, 0.0, 1.0, 1.0));
+    if (visibleRect.isEmpty())
+    {
+        return QRect();
+    }
+
+    // Convert visible rectangle to image pixels (image y axis is pointing down),
+    // area is enlarged by few pixels to avoid artifacts on the area boundary.
+    constexpr int margin = 2;
+    const int left = qFloor(visibleRect.left() * width) - margin;
+    const int right = qCeil(visibleRect.right() * width) + margin;
+    const int top = qFloor((1.0 - visibleRect.bottom()) * height) - margin;
+    const int bottom = qCeil((1.0 - visibleRect.top()) * height) + margin;
+    const QRect area = QRect(left, top, right - left, bottom - top).intersected(QRect(0, 0, int(width), int(height)));
+
+    // Decode only significantly smaller area, otherwise decode the whole image
+    if (PDFReal(area.width()) * area.height() > DECODE_AREA_MAX_RATIO * width * height)
+    {
+        return QRect();
+    }
+
+    return area;
+}
+
+bool PDFPageContentProcessor::isImagePreviewUsed(const PDFStream* stream) const
+{
+    if (!m_imagePreviewsEnabled)
+    {
+        return false;
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFDictionary* imageDictionary = stream->getDictionary();
+    const PDFInteger width = loader.readIntegerFromDictionary(imageDictionary, "Width", 0);
+    const PDFInteger height = loader.readIntegerFromDictionary(imageDictionary, "Height", 0);
+
+    return width * height >= IMAGE_PREVIEW_MIN_PIXELS && PDFImage::isResolutionReductionSupported(m_document, stream);
+}
+
+PDFMesh PDFPageContentProcessor::createShadingMesh(const PDFShadingPattern* shadingPattern, const PDFMeshQualitySettings& settings)
+{
+    PDFMeshCache* meshCache = PDFMeshCache::getInstance();
+    const RenderingIntent renderingIntent = m_graphicState.getRenderingIntent();
+    const PDFMeshCache::Key key = PDFMeshCache::createKey(m_document, shadingPattern, m_colorSpaceDictionary, settings, m_CMS, renderingIntent);
+    const QTransform patternSpaceToDeviceSpaceMatrix = shadingPattern->getPatternSpaceToDeviceSpaceMatrix(settings);
+
+    QElapsedTimer timer;
+    if (m_statistics)
+    {
+        timer.start();
+    }
+
+    PDFMesh mesh;
+    if (!meshCache->findMesh(key, patternSpaceToDeviceSpaceMatrix, settings.deviceSpaceMeshingArea, mesh))
+    {
+        mesh = shadingPattern->createMesh(settings, m_CMS, renderingIntent, this, m_operationControl);
+
+        // Do not cache incomplete mesh, if meshing was cancelled
+        if (!PDFOperationControl::isOperationCancelled(m_operationControl))
+        {
+            meshCache->insertMesh(key, patternSpaceToDeviceSpaceMatrix, settings.deviceSpaceMeshingArea, mesh);
+        }
+    }
+
+    if (m_statistics)
+    {
+        m_statistics->meshes.add(timer.nsecsElapsed());
+        m_statistics->meshTriangles += qint64(mesh.getTriangleCount());
+    }
+
+    return mesh;
+}
+
+int PDFPageContentProcessor::getImageResolutionReduction(const PDFDictionary* imageDictionary) const
+{
+    if (m_imageResolutionHint <= 0.0)
+    {
+        return 0;
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    const PDFInteger width = loader.readIntegerFromDictionary(imageDictionary, "Width", 0);
+    const PDFInteger height = loader.readIntegerFromDictionary(imageDictionary, "Height", 0);
+
+    // Image is painted onto unit square, compute its size in device pixels
+    const QTransform& matrix = m_graphicState.getCurrentTransformationMatrix();
+    const QPointF origin = matrix.map(QPointF(0.0, 0.0));
+    const PDFReal targetWidth = QLineF(origin, matrix.map(QPointF(1.0, 0.0))).length() * m_imageResolutionHint;
+    const PDFReal targetHeight = QLineF(origin, matrix.map(QPointF(0.0, 1.0))).length() * m_imageResolutionHint;
+
+    int reduction = 0;
+    while (reduction < PDFImage::MAX_RESOLUTION_REDUCTION &&
+           (width >> (reduction + 1)) >= qMax(targetWidth, 1.0) &&
+           (height >> (reduction + 1)) >= qMax(targetHeight, 1.0))
+    {
+        ++reduction;
+    }
+
+    return reduction;
+}
+
 void PDFPageContentProcessor::reportWarningAboutColorOperatorsInUTP()
 {
     reportRenderErrorOnce(RenderErrorType::Warning, PDFTranslationContext::tr("Color operators are not allowed in uncolored tilling pattern."));
@@ -3007,6 +3947,14 @@ void PDFPageContentProcessor::reportWarningAboutColorOperatorsInUTP()
 
 void PDFPageContentProcessor::processForm(const PDFStream* stream)
 {
+    // Colors set in the form are ignored, when uncolored tiling pattern is
+    // being drawn, so such forms are not painted as instances.
+    const bool isInstance = m_drawingUncoloredTilingPatternState == 0;
+    if (isInstance && performPaintFormInstance(stream))
+    {
+        return;
+    }
+
     PDFDocumentDataLoaderDecorator loader(getDocument());
     const PDFDictionary* streamDictionary = stream->getDictionary();
 
@@ -3016,8 +3964,8 @@ void PDFPageContentProcessor::processForm(const PDFStream* stream)
     // Read the transformation matrix, if it is present
     QTransform transformationMatrix = loader.readMatrixFromDictionary(streamDictionary, "Matrix", QTransform());
 
-    // Read the dictionary content
-    QByteArray content = m_document->getDecodedStream(stream);
+    // Read the content (program of the content is shared between all paintings of the form)
+    ContentStreamProgramPointer program = getContentStreamProgram(stream);
 
     // Read resources
     PDFObject resources = m_document->getObject(streamDictionary->get("Resources"));
@@ -3028,7 +3976,131 @@ void PDFPageContentProcessor::processForm(const PDFStream* stream)
     // Form structural parent key
     const PDFInteger formStructuralParentKey = loader.readIntegerFromDictionary(streamDictionary, "StructParent", m_structuralParentKey);
 
-    processForm(transformationMatrix, boundingBox, resources, transparencyGroup, content, formStructuralParentKey);
+    processForm(transformationMatrix, boundingBox, resources, transparencyGroup, *program, formStructuralParentKey);
+
+    if (isInstance)
+    {
+        performFormProcessed(stream);
+    }
+}
+
+std::vector<PDFPageContentProcessor::FormInvocation> PDFPageContentProcessor::getPageFormInvocations()
+{
+    std::vector<FormInvocation> invocations;
+
+    if (!m_xobjectDictionary)
+    {
+        return invocations;
+    }
+
+    std::vector<const PDFStream*> streams;
+    const PDFObject& contents = m_page->getContents();
+    if (contents.isArray())
+    {
+        const PDFArray* array = contents.getArray();
+        for (size_t i = 0, count = array->getCount(); i < count; ++i)
+        {
+            const PDFObject& streamObject = m_document->getObject(array->getItem(i));
+            if (streamObject.isStream())
+            {
+                streams.push_back(streamObject.getStream());
+            }
+        }
+    }
+    else if (contents.isStream())
+    {
+        streams.push_back(contents.getStream());
+    }
+
+    PDFDocumentDataLoaderDecorator loader(m_document);
+    std::set<const PDFStream*> forms;
+    std::vector<QTransform> matrixStack;
+    QTransform matrix = m_graphicState.getCurrentTransformationMatrix();
+
+    for (const PDFStream* stream : streams)
+    {
+        // Programs are cached, so page contents are not parsed again, when they are processed
+        ContentStreamProgramPointer program;
+        try
+        {
+            program = getContentStreamProgram(stream);
+        }
+        catch (const PDFException&)
+        {
+            // Error is reported, when page contents are processed
+            continue;
+        }
+
+        for (const ContentStreamProgram::Instruction& instruction : program->instructions)
+        {
+            if (instruction.type != ContentStreamProgram::InstructionType::Operator)
+            {
+                continue;
+            }
+
+            const PDFLexicalAnalyzer::Token* operands = program->operands.data() + instruction.operandIndex;
+            switch (instruction.op)
+            {
+                case Operator::SaveGraphicState:
+                    matrixStack.push_back(matrix);
+                    break;
+
+                case Operator::RestoreGraphicState:
+                {
+                    if (!matrixStack.empty())
+                    {
+                        matrix = matrixStack.back();
+                        matrixStack.pop_back();
+                    }
+                    break;
+                }
+
+                case Operator::AdjustCurrentTransformationMatrix:
+                {
+                    auto isNumber = [](const PDFLexicalAnalyzer::Token& token) { return token.type == PDFLexicalAnalyzer::TokenType::Integer || token.type == PDFLexicalAnalyzer::TokenType::Real; };
+                    if (instruction.operandCount == 6 && std::all_of(operands, operands + 6, isNumber))
+                    {
+                        const QTransform adjustMatrix(operands[0].data.value<PDFReal>(), operands[1].data.value<PDFReal>(),
+                                                      operands[2].data.value<PDFReal>(), operands[3].data.value<PDFReal>(),
+                                                      operands[4].data.value<PDFReal>(), operands[5].data.value<PDFReal>());
+                        matrix = adjustMatrix * matrix;
+                    }
+                    break;
+                }
+
+                case Operator::PaintXObject:
+                {
+                    if (instruction.operandCount != 1 || operands[0].type != PDFLexicalAnalyzer::TokenType::Name)
+                    {
+                        break;
+                    }
+
+                    const PDFObject& object = m_document->getObject(m_xobjectDictionary->get(operands[0].data.toByteArray()));
+                    if (!object.isStream())
+                    {
+                        break;
+                    }
+
+                    // Forms with optional content are skipped, their visibility is decided during processing
+                    const PDFStream* formStream = object.getStream();
+                    const PDFDictionary* formDictionary = formStream->getDictionary();
+                    if (!formDictionary->hasKey("OC") &&
+                        loader.readNameFromDictionary(formDictionary, "Subtype") == "Form" &&
+                        loader.readIntegerFromDictionary(formDictionary, "FormType", 1) == 1 &&
+                        forms.insert(formStream).second)
+                    {
+                        invocations.push_back(FormInvocation{ formStream, matrix });
+                    }
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    return invocations;
 }
 
 void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
@@ -3036,9 +4108,52 @@ void PDFPageContentProcessor::operatorPaintXObject(PDFOperandName name)
     // We want to have empty operands, when we are invoking forms
     m_operands.clear();
 
+    const PDFObject xobject = m_xobjectDictionary ? m_xobjectDictionary->get(name.name) : PDFObject();
+    if (!m_statistics || !xobject.isReference())
+    {
+        paintXObject(name.name);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const PDFObjectReference reference = xobject.getReference();
+    auto finish = [&]()
+    {
+        PDFPageContentProcessorStatistics::XObjectEntry& entry = m_statistics->xobjects[reference];
+        if (entry.name.isEmpty())
+        {
+            entry.name = name.name;
+
+            const PDFObject& object = m_document->getObjectByReference(reference);
+            if (object.isStream())
+            {
+                PDFDocumentDataLoaderDecorator loader(m_document);
+                entry.isImage = loader.readNameFromDictionary(object.getStream()->getDictionary(), "Subtype") == "Image";
+            }
+        }
+        entry.entry.add(timer.nsecsElapsed());
+    };
+
+    try
+    {
+        paintXObject(name.name);
+    }
+    catch (...)
+    {
+        finish();
+        throw;
+    }
+
+    finish();
+}
+
+void PDFPageContentProcessor::paintXObject(const QByteArray& name)
+{
     if (m_xobjectDictionary)
     {
-        const PDFObject& object = m_document->getObject(m_xobjectDictionary->get(name.name));
+        const PDFObject& object = m_document->getObject(m_xobjectDictionary->get(name));
         if (object.isStream())
         {
             const PDFStream* stream = object.getStream();
@@ -3178,6 +4293,7 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
         const bool fill = isTextRenderingModeFilled(textRenderingMode);
         const bool stroke = isTextRenderingModeStroked(textRenderingMode);
         const bool clipped = isTextRenderingModeClipped(textRenderingMode);
+        const bool isTextOnly = isTextOnlyProcessing();
 
         // Detect horizontal writing system
         const bool isHorizontalWritingSystem = font->isHorizontalWritingSystem();
@@ -3189,6 +4305,12 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
 
         if (!isType3Font)
         {
+            // Font is realized at canonical size, so glyphs and their advances
+            // must be scaled by the font size.
+            const PDFReal fontScale = qAbs(fontSize) / PDFRealizedFont::CANONICAL_FONT_SIZE;
+            const QTransform fontScaleMatrix(fontScale, 0.0, 0.0, fontScale, 0.0, 0.0);
+            const QTransform glyphAdjustMatrix = fontScaleMatrix * adjustMatrix;
+
             for (const TextSequenceItem& item : textSequence.items)
             {
                 PDFReal displacementX = 0.0;
@@ -3197,7 +4319,8 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                 if (item.isCharacter())
                 {
                     QChar character = item.character;
-                    QPointF advance = isHorizontalWritingSystem ? QPointF(item.advance, 0) : QPointF(0, item.advance);
+                    const PDFReal glyphAdvance = item.advance * fontScale;
+                    QPointF advance = isHorizontalWritingSystem ? QPointF(glyphAdvance, 0) : QPointF(0, glyphAdvance);
 
                     // First, compute the advance
                     const PDFReal additionalAdvance = (character == QChar(QChar::Space)) ? wordSpacing + characterSpacing : characterSpacing;
@@ -3216,13 +4339,18 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                     {
                         const QPainterPath& glyphPath = *item.glyph;
 
-                        QTransform textRenderingMatrix = adjustMatrix * textMatrix;
+                        QTransform textRenderingMatrix = glyphAdjustMatrix * textMatrix;
                         QTransform toDeviceSpaceTransform = textRenderingMatrix * m_graphicState.getCurrentTransformationMatrix();
 
-                        if (!glyphPath.isEmpty())
+                        if (!glyphPath.isEmpty() && !isTextOnly)
                         {
                             QPainterPath transformedGlyph = textRenderingMatrix.map(glyphPath);
-                            processPathPainting(transformedGlyph, stroke, fill, true, transformedGlyph.fillRule());
+
+                            {
+                                PDFTemporaryValueChange paintedGlyphGuard(&m_paintedGlyph, &glyphPath);
+                                PDFTemporaryValueChange paintedGlyphMatrixGuard(&m_paintedGlyphMatrix, textRenderingMatrix);
+                                processPathPainting(transformedGlyph, stroke, fill, true, transformedGlyph.fillRule());
+                            }
 
                             if (clipped)
                             {
@@ -3238,7 +4366,7 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                             info.character = item.character;
                             info.isVerticalWritingSystem = !isHorizontalWritingSystem;
                             info.advance = item.advance;
-                            info.fontSize = fontSize;
+                            info.fontSize = PDFRealizedFont::CANONICAL_FONT_SIZE;
                             info.outline = glyphPath;
                             info.matrix = toDeviceSpaceTransform;
                             performOutputCharacter(info);
@@ -3268,7 +4396,8 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
             // Type 3 Font
 
             Q_ASSERT(dynamic_cast<const PDFType3Font*>(m_graphicState.getTextFont().get()));
-            const PDFType3Font* parentFont = static_cast<const PDFType3Font*>(m_graphicState.getTextFont().get());
+            const PDFFontPointer parentFontPointer = m_graphicState.getTextFont();
+            const PDFType3Font* parentFont = static_cast<const PDFType3Font*>(parentFontPointer.get());
 
             QTransform fontMatrix = parentFont->getFontMatrix();
             if (!fontMatrix.isInvertible())
@@ -3314,7 +4443,12 @@ void PDFPageContentProcessor::drawText(const TextSequence& textSequence)
                     m_graphicState.setCurrentTransformationMatrix(worldMatrix);
                     updateGraphicState();
 
-                    processContent(*item.characterContentStream);
+                    if (!isTextOnly)
+                    {
+                        // Glyph procedure paints only the glyph, it is not needed in text-only mode
+                        ContentStreamProgramPointer program = getContentStreamProgram(parentFontPointer, item.characterContentStream);
+                        processContentStreamProgram(*program);
+                    }
 
                     if (!item.character.isNull())
                     {
@@ -3346,7 +4480,12 @@ PDFRealizedFontPointer PDFPageContentProcessor::getRealizedFontImpl()
 {
     if (m_graphicState.getTextFont())
     {
-        return m_fontCache->getRealizedFont(m_graphicState.getTextFont(), m_graphicState.getTextFontSize(), this);
+        if (m_graphicState.getTextFont()->getFontType() == FontType::Type3)
+        {
+            return m_fontCache->getRealizedFont(m_graphicState.getTextFont(), m_graphicState.getTextFontSize(), this);
+        }
+
+        return m_fontCache->getRealizedFont(m_graphicState.getTextFont(), PDFRealizedFont::CANONICAL_FONT_SIZE, this);
     }
 
     return PDFRealizedFontPointer();
@@ -4032,4 +5171,164 @@ PDFPageContentProcessor::PDFSoftMaskDefinition PDFPageContentProcessor::PDFSoftM
     return result;
 }
 
+qint64 PDFPageContentProcessor::ContentStreamProgram::getMemoryConsumptionEstimate() const
+{
+    qint64 size = sizeof(*this);
+    size += content.size();
+    size += instructions.capacity() * sizeof(Instruction);
+    size += operands.capacity() * sizeof(PDFLexicalAnalyzer::Token);
+    size += inlineImages.capacity() * sizeof(PDFStream);
+    size += errors.capacity() * sizeof(QString);
+
+    for (const PDFStream& inlineImage : inlineImages)
+    {
+        size += inlineImage.getContent()->size();
+    }
+
+    return size;
+}
+
+PDFContentStreamCache::PDFContentStreamCache() :
+    m_cacheLimit(qint64(DEFAULT_CONTENT_STREAM_CACHE_LIMIT))
+{
+    PDFCacheManager::getInstance()->registerCache(this);
+}
+
+PDFContentStreamCache::~PDFContentStreamCache()
+{
+    PDFCacheManager::getInstance()->unregisterCache(this);
+}
+
+PDFContentStreamCache* PDFContentStreamCache::getInstance()
+{
+    static PDFContentStreamCache cache;
+    return &cache;
+}
+
+PDFContentStreamCache::ProgramPointer PDFContentStreamCache::findProgram(const Key& key)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end())
+    {
+        it->second.lastAccess = PDFCacheManager::getAccessStamp();
+        return it->second.program;
+    }
+
+    return nullptr;
+}
+
+void PDFContentStreamCache::insertProgram(const Key& key, ProgramPointer program, PDFFontPointer font)
+{
+    if (!program || !program->isComplete)
+    {
+        return;
+    }
+
+    const qint64 size = program->getMemoryConsumptionEstimate();
+
+    QMutexLocker lock(&m_mutex);
+
+    if (size > m_cacheLimit || m_entries.count(key))
+    {
+        // Program is too large, or it was parsed by another thread
+        return;
+    }
+
+    Entry& entry = m_entries[key];
+    entry.program = qMove(program);
+    entry.font = qMove(font);
+    entry.size = size;
+    entry.lastAccess = PDFCacheManager::getAccessStamp();
+    m_cacheSize += size;
+
+    shrink();
+}
+
+void PDFContentStreamCache::removeDocument(quint64 documentId)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (it->first.documentId == documentId)
+        {
+            m_cacheSize -= it->second.size;
+            it = m_entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void PDFContentStreamCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_entries.clear();
+    m_cacheSize = 0;
+}
+
+void PDFContentStreamCache::setCacheLimit(qint64 cacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_cacheLimit = cacheLimit;
+    shrink();
+}
+
+qint64 PDFContentStreamCache::getCacheLimit() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheLimit;
+}
+
+qint64 PDFContentStreamCache::getCacheSize() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheSize;
+}
+
+quint64 PDFContentStreamCache::getLeastRecentAccessStamp() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = std::min_element(m_entries.cbegin(), m_entries.cend(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+    return it != m_entries.cend() ? it->second.lastAccess : 0;
+}
+
+int PDFContentStreamCache::getRecreationCost() const
+{
+    // Programs are cheap to recreate, if decoded content stream is still
+    // available, so they are evicted before meshes and images.
+    return 1;
+}
+
+qint64 PDFContentStreamCache::evict(qint64 bytes)
+{
+    QMutexLocker lock(&m_mutex);
+
+    qint64 freed = 0;
+    while (freed < bytes && !m_entries.empty())
+    {
+        auto it = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+        freed += it->second.size;
+        m_cacheSize -= it->second.size;
+        m_entries.erase(it);
+    }
+
+    return freed;
+}
+
+void PDFContentStreamCache::shrink()
+{
+    while (m_cacheSize > m_cacheLimit && !m_entries.empty())
+    {
+        auto it = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+        m_cacheSize -= it->second.size;
+        m_entries.erase(it);
+    }
+}
+
 }   // namespace pdf
@@ -27,12 +27,16 @@
 #include "pdfblendfunction.h"
 #include "pdftextlayout.h"
 #include "pdfoperationcontrol.h"
+#include "pdfcachemanager.h"
+#include "pdfpathbuilder.h"
 
 #include <QVector>
 #include <QTransform>
 #include <QPainterPath>
 #include <QSharedPointer>
+#include <QMutex>
 
+#include <map>
 #include <stack>
 #include <tuple>
 #include <type_traits>
@@ -79,6 +83,90 @@ private:
     PDFReal m_dashOffset = 0.0;
 };
 
+/// Statistics of the content stream processing, used to find out, which parts
+/// of the content are expensive (for example, in benchmarks). Statistics are not
+/// collected by default, see PDFPageContentProcessor::setStatistics. All times
+/// are in nanoseconds.
+struct PDF4QTLIBCORESHARED_EXPORT PDFPageContentProcessorStatistics
+{
+    /// Category of the content stream operators
+    enum class Category
+    {
+        GraphicState,   ///< Graphic state operators (w, J, j, M, d, ri, i, gs, q, Q, cm)
+        Path,           ///< Path construction, painting and clipping operators
+        Text,           ///< Text object, text state, positioning and showing operators, type 3 font operators
+        Color,          ///< Color operators
+        Shading,        ///< Shading operator (sh)
+        Image,          ///< Inline images and image XObjects
+        XObject,        ///< Form XObjects and other XObjects (time of the nested operators is excluded)
+        MarkedContent,  ///< Marked content operators
+        Other,          ///< Compatibility and unknown operators
+        LastCategory
+    };
+
+    static constexpr size_t CATEGORY_COUNT = static_cast<size_t>(Category::LastCategory);
+
+    struct Entry
+    {
+        qint64 count = 0;
+        qint64 time = 0;
+
+        void add(qint64 addedTime) { ++count; time += addedTime; }
+        void merge(const Entry& other) { count += other.count; time += other.time; }
+    };
+
+    /// Merges statistics from other statistics object
+    /// \param other Other statistics
+    void merge(const PDFPageContentProcessorStatistics& other);
+
+    /// Returns translated name of the category
+    /// \param category Category
+    static QString getCategoryName(Category category);
+
+    /// Exclusive times of the operators (i.e. without nested operators) by category
+    std::array<Entry, CATEGORY_COUNT> operators = { };
+
+    /// Image decoding times by image filter (last filter of the image stream is used,
+    /// empty filter name means, that image data are not compressed)
+    std::map<QByteArray, Entry> imageDecoding;
+
+    /// Conversion of decoded images to the device color space (using color management system)
+    Entry imageColorConversion;
+
+    /// Conversion of colors to the device color space (using color management system),
+    /// memoized colors are not counted.
+    Entry colorConversion;
+
+    qint64 imageCacheHits = 0;
+    qint64 imageCacheMisses = 0;
+    qint64 contentStreamCacheHits = 0;
+    qint64 contentStreamCacheMisses = 0;
+    qint64 colorCacheHits = 0;
+    qint64 colorCacheMisses = 0;
+
+    /// Statistics of the XObject painted by the Do operator. Time is inclusive,
+    /// i.e. it contains time of the nested operators of form XObject, or
+    /// time of the image decoding.
+    struct XObjectEntry
+    {
+        QByteArray name;        ///< Resource name, under which XObject was painted first time
+        bool isImage = false;   ///< XObject is an image (otherwise it is a form)
+        Entry entry;
+    };
+
+    /// Painted XObjects, which are indirect objects (stored by their reference)
+    std::map<PDFObjectReference, XObjectEntry> xobjects;
+
+    /// Counts of the operators by their names (including unknown operators)
+    std::map<QByteArray, qint64> operatorCounts;
+
+    /// Creation of the shading meshes (or retrieving them from the mesh cache)
+    Entry meshes;
+
+    /// Total count of the triangles of the shading meshes
+    qint64 meshTriangles = 0;
+};
+
 /// Process the contents of the page.
 class PDF4QTLIBCORESHARED_EXPORT PDFPageContentProcessor : public PDFRenderErrorReporter
 {
@@ -213,9 +301,68 @@ public:
     };
     Q_DECLARE_FLAGS(ProcedureSets, ProcedureSet)
 
+    /// Pre-parsed content stream. Content stream is lexed only once, then its
+    /// instructions (operators with operands) can be replayed without lexing,
+    /// for example, when form XObject is painted many times, or glyph procedure
+    /// of the Type 3 font is painted for each character. Program refers to the
+    /// content (names of operators), so content is kept alive by the program.
+    /// Program is immutable, so it can be shared between threads.
+    struct ContentStreamProgram
+    {
+        enum class InstructionType
+        {
+            Operator,       ///< Operator with its operands
+            InlineImage,    ///< Inline image (BI ... ID ... EI)
+            Error,          ///< Content stream is malformed at this position
+            Operands        ///< Operands at the end of the content, not followed by an operator
+        };
+
+        struct Instruction
+        {
+            InstructionType type = InstructionType::Operator;
+            Operator op = Operator::Invalid;
+            QByteArrayView command;         ///< Name of the operator (points into the content)
+            PDFInteger startPosition = -1;  ///< Position of the first operand (or of the operator)
+            PDFInteger endPosition = -1;    ///< Position after the operator
+            size_t operandIndex = 0;        ///< Index of the first operand
+            size_t operandCount = 0;        ///< Count of the operands
+            size_t dataIndex = 0;           ///< Index of the inline image, or of the error message
+        };
+
+        /// Returns estimate of memory consumed by the program (in bytes)
+        qint64 getMemoryConsumptionEstimate() const;
+
+        QByteArray content;
+        std::vector<Instruction> instructions;
+        std::vector<PDFLexicalAnalyzer::Token> operands;
+        std::vector<PDFStream> inlineImages;
+        std::vector<QString> errors;
+        bool isComplete = true; ///< Content was parsed completely (parsing wasn't cancelled)
+    };
+
+    using ContentStreamProgramPointer = std::shared_ptr<const ContentStreamProgram>;
+
     /// Process the contents of the page
     QList<PDFRenderError> processContents();
 
+    /// Processes content of the single cell of the tiling pattern instead of the page
+    /// contents. Pattern space is used as page space, so page point to device point
+    /// matrix of the processor should map the pattern space to the device space.
+    /// Cell content is clipped to the bounding box of the pattern.
+    /// \param tilingPattern Tiling pattern
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    QList<PDFRenderError> processTilingPatternCell(const PDFTilingPattern* tilingPattern,
+                                                   PDFColorSpacePointer uncoloredPatternColorSpace,
+                                                   PDFColor uncoloredPatternColor);
+
+    /// Processes single form XObject instead of the page contents. Form is painted
+    /// in the graphic state \p state, resources of the page are used as default
+    /// resources of the form.
+    /// \param formStream Stream of the form XObject
+    /// \param state Graphic state, in which form is painted
+    QList<PDFRenderError> processFormXObject(const PDFStream* formStream, const PDFPageContentProcessorState& state);
+
     virtual void reportRenderError(RenderErrorType type, QString message) override;
 
     /// Reports render error, but only once - if same error was already reported,
@@ -250,6 +397,37 @@ public:
     /// \param newOperationControl Operation control object
     void setOperationControl(const PDFOperationControl* newOperationControl);
 
+    /// Returns operation control object (can be nullptr)
+    const PDFOperationControl* getOperationControl() const { return m_operationControl; }
+
+    /// Sets statistics object, into which statistics of the content processing
+    /// are accumulated. If statistics object is nullptr (default), then
+    /// statistics are not collected. Statistics object must outlive processing
+    /// of the contents.
+    /// \param statistics Statistics
+    void setStatistics(PDFPageContentProcessorStatistics* statistics) { m_statistics = statistics; }
+
+    /// Sets image resolution hint - count of target device pixels per unit
+    /// of the device space. If hint is positive, then images can be decoded
+    /// in reduced resolution, which is still sufficient for this device
+    /// resolution. Zero means, that images are always decoded in full resolution.
+    /// \param imageResolutionHint Image resolution hint
+    void setImageResolutionHint(PDFReal imageResolutionHint) { m_imageResolutionHint = imageResolutionHint; }
+
+    /// Returns image resolution hint (see \p setImageResolutionHint)
+    PDFReal getImageResolutionHint() const { return m_imageResolutionHint; }
+
+    /// Enables image previews. If enabled, then large images, which aren't decoded
+    /// yet, are decoded in the lowest resolution supported by the image decoder,
+    /// so page can be displayed quickly. Page should be processed again with
+    /// image previews disabled to obtain full quality images (see \p getPreviewImageCount).
+    /// \param enabled Enable image previews
+    void setImagePreviewsEnabled(bool enabled) { m_imagePreviewsEnabled = enabled; }
+
+    /// Returns count of painted images, which were decoded as previews
+    /// in reduced resolution (see \p setImagePreviewsEnabled).
+    size_t getPreviewImageCount() const { return m_previewImageCount; }
+
     /// Returns true, if page content processing is being cancelled
     bool isProcessingCancelled() const;
 
@@ -376,9 +554,11 @@ protected:
         void setCurrentTransformationMatrix(const QTransform& currentTransformationMatrix);
 
         const PDFAbstractColorSpace* getStrokeColorSpace() const { return m_strokeColorSpace.data(); }
+        const PDFColorSpacePointer& getStrokeColorSpacePointer() const { return m_strokeColorSpace; }
         void setStrokeColorSpace(const QSharedPointer<PDFAbstractColorSpace>& strokeColorSpace);
 
         const PDFAbstractColorSpace* getFillColorSpace() const { return m_fillColorSpace.data(); }
+        const PDFColorSpacePointer& getFillColorSpacePointer() const { return m_fillColorSpace; }
         void setFillColorSpace(const QSharedPointer<PDFAbstractColorSpace>& fillColorSpace);
 
         const QColor& getStrokeColor() const { return m_strokeColor; }
@@ -578,6 +758,13 @@ protected:
     /// \returns true, if image is successfully processed
     virtual bool performOriginalImagePainting(const PDFImage& image);
 
+    /// Performs image processing on encoded image stream, before the image
+    /// is decoded. If processor processes the image stream, it should return
+    /// true, so image isn't decoded at all.
+    /// \param stream Image stream
+    /// \returns true, if image stream is successfully processed
+    virtual bool performImageStreamPainting(const PDFStream* stream);
+
     /// This function has to be implemented in the client drawing implementation, it should
     /// draw the image.
     /// \param image Image to be painted
@@ -639,12 +826,59 @@ protected:
     /// Implement to react on character printing
     virtual void performOutputCharacter(const PDFTextCharacterInfo& info);
 
+    /// Implement to paint instance of the form XObject without processing its
+    /// content (for example, by replaying output recorded, when the same form
+    /// was painted before). Function is called before the form is processed, if
+    /// it returns true, then form content is not processed. Current graphic
+    /// state is the state, in which form is painted.
+    /// \param formStream Stream of the form XObject
+    virtual bool performPaintFormInstance(const PDFStream* formStream);
+
+    /// Implement to react on end of the form XObject processing, it is called
+    /// after form content was processed (only for forms, for which function
+    /// \p performPaintFormInstance was called and returned false).
+    /// \param formStream Stream of the form XObject
+    virtual void performFormProcessed(const PDFStream* formStream);
+
+    /// Implement to fill the path using tiling pattern without processing the content
+    /// of each pattern cell (for example, by filling the path using repeated image
+    /// of the pattern cell). Function is called, when graphic state is initialized
+    /// for the painting of the pattern cells, i.e. current transformation matrix maps
+    /// pattern space to the user space. If it returns true, then pattern cells
+    /// are not processed.
+    /// \param tilingPattern Tiling pattern
+    /// \param path Path to be filled (in pattern space)
+    /// \param tilingOrigin Origin of the first pattern cell (in pattern space)
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    virtual bool performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QPainterPath& path,
+                                              const QPointF& tilingOrigin,
+                                              PDFColorSpacePointer uncoloredPatternColorSpace,
+                                              PDFColor uncoloredPatternColor);
+
     /// Implement to respond to text begin operator
     virtual void performTextBegin(ProcessOrder order);
 
     /// Implement to respond to text end operator
     virtual void performTextEnd(ProcessOrder order);
 
+    /// Implement to react on operator of the page content stream. Function is called
+    /// before the operator is processed, and only for operators of the page content
+    /// streams (operators of forms, patterns, Type 3 glyphs and appearance streams
+    /// are not reported). Positions are in the decoded content stream, range contains
+    /// operands of the operator (for inline image, whole BI/ID/EI sequence).
+    /// \param streamIndex Index of the content stream in the page contents
+    /// \param operatorStart Start position of the operator (including its operands)
+    /// \param operatorEnd End position of the operator (position after the operator)
+    /// \param command Operator
+    virtual void performPageContentOperator(PDFInteger streamIndex, PDFInteger operatorStart, PDFInteger operatorEnd, const QByteArray& command);
+
+    /// Implement to react on begin of the page contents processing. Function is
+    /// called, when processor is initialized (see \p initializeProcessor),
+    /// before the page content streams are processed.
+    virtual void performPageContentsBegin();
+
     enum class ContentKind
     {
         Shapes,     ///< General shapes (they can be also shaded / tiled)
@@ -658,6 +892,13 @@ protected:
     /// shading, images, ...)
     virtual bool isContentKindSuppressed(ContentKind kind) const;
 
+    /// Override this function to enable text-only processing. In this mode,
+    /// only text state and marked content are tracked - paths are not
+    /// constructed, clipping is not performed and colors are not converted.
+    /// Processors, which are interested only in characters (for example,
+    /// text extraction), can process content streams much faster this way.
+    virtual bool isTextOnlyProcessing() const;
+
     /// Sets current graphic state and updates data
     /// \param state New graphic state
     void setGraphicsState(const PDFPageContentProcessorState& state);
@@ -681,6 +922,42 @@ protected:
     /// Returns base matrix for patterns
     const QTransform& getPatternBaseMatrix() const { return m_patternBaseMatrix; }
 
+    /// Returns allowed resolution reduction of the image painted in current
+    /// graphic state (see PDFImage::createImage), according to image resolution hint.
+    /// \param imageDictionary Image dictionary
+    int getImageResolutionReduction(const PDFDictionary* imageDictionary) const;
+
+    /// Returns area of the image (in image pixels), which is visible on the page,
+    /// if only this area should be decoded. Decoding of the area is used only for
+    /// large images, which are partially outside of the page. If whole image
+    /// should be decoded, invalid rectangle is returned.
+    /// \param stream Image stream
+    QRect getImageDecodeArea(const PDFStream* stream) const;
+
+    /// Returns true, if preview of the image should be decoded instead
+    /// of full quality image (see \p setImagePreviewsEnabled).
+    /// \param stream Image stream
+    bool isImagePreviewUsed(const PDFStream* stream) const;
+
+    /// Creates mesh of the shading pattern in the device space. Meshes are shared
+    /// using the mesh cache, so mesh is generated only, if it isn't found in the cache.
+    /// \param shadingPattern Shading pattern
+    /// \param settings Meshing settings
+    PDFMesh createShadingMesh(const PDFShadingPattern* shadingPattern, const PDFMeshQualitySettings& settings);
+
+    /// Returns count of painted images, which were decoded only partially
+    /// (only visible part of the image on the page was decoded). Such images
+    /// are valid only for current transformation.
+    size_t getPartiallyDecodedImageCount() const { return m_partiallyDecodedImageCount; }
+
+    /// Returns outline of the glyph (in glyph space), which is being painted,
+    /// or nullptr, if no glyph is being painted. Glyph is valid only when
+    /// text path is being painted (glyph outline mapped by glyph matrix).
+    const QPainterPath* getPaintedGlyph() const { return m_paintedGlyph; }
+
+    /// Returns matrix mapping outline of the painted glyph to the user space
+    const QTransform& getPaintedGlyphMatrix() const { return m_paintedGlyphMatrix; }
+
     /// Returns current world matrix (translating actual point to the device point)
     QTransform getCurrentWorldMatrix() const { return getGraphicState()->getCurrentTransformationMatrix() * m_pagePointToDevicePointMatrix; }
 
@@ -706,6 +983,30 @@ protected:
     /// Returns optional content activity
     const PDFOptionalContentActivity* getOptionalContentActivity() const { return m_optionalContentActivity; }
 
+    /// Returns mesh quality settings
+    const PDFMeshQualitySettings& getMeshQualitySettings() const { return m_meshQualitySettings; }
+
+    /// Returns statistics object (can be nullptr, see \p setStatistics)
+    PDFPageContentProcessorStatistics* getStatistics() const { return m_statistics; }
+
+    /// Returns true, if image previews are enabled (see \p setImagePreviewsEnabled)
+    bool isImagePreviewsEnabled() const { return m_imagePreviewsEnabled; }
+
+    /// Form XObject painted directly by the page content stream
+    struct FormInvocation
+    {
+        const PDFStream* formStream = nullptr;
+        QTransform currentTransformationMatrix; ///< Matrix, in which form is painted (first time)
+    };
+
+    /// Returns form XObjects painted directly by the page content streams (forms
+    /// painted by other forms are not returned), each form is returned only once,
+    /// for its first painting. Only operators changing the current transformation
+    /// matrix are interpreted, so the matrix is exact only for regular contents
+    /// (for example, forms painted inside text objects can be painted with another
+    /// matrix). Processor must be initialized (see \p initializeProcessor).
+    std::vector<FormInvocation> getPageFormInvocations();
+
     class PDF4QTLIBCORESHARED_EXPORT PDFTransparencyGroupGuard
     {
     public:
@@ -729,8 +1030,60 @@ private:
     /// Process the content
     void processContent(const QByteArray& content);
 
+    /// Parses the content into the program, which can be replayed
+    /// (see processContentStreamProgram). Program is not cached.
+    /// \param content Content
+    ContentStreamProgramPointer parseContent(const QByteArray& content);
+
+    /// Returns program of the content stream stored in the document. Programs
+    /// are shared using the content stream cache, stream is decoded and
+    /// parsed only, if its program isn't cached.
+    /// \param stream Content stream
+    ContentStreamProgramPointer getContentStreamProgram(const PDFStream* stream);
+
+    /// Returns program of the glyph procedure of the Type 3 font. Programs
+    /// are shared using the content stream cache, font is kept alive
+    /// by the cache, while program of its glyph is cached.
+    /// \param font Type 3 font
+    /// \param content Glyph procedure (owned by the font)
+    ContentStreamProgramPointer getContentStreamProgram(const PDFFontPointer& font, const QByteArray* content);
+
+    /// Replays the content stream program, as if the content was processed
+    /// \param program Program
+    void processContentStreamProgram(const ContentStreamProgram& program);
+
+    /// Processes form using the program of its content stream. Parameters are
+    /// the same as in processForm, which is processing the content directly.
+    void processForm(const QTransform& matrix,
+                     const QRectF& boundingBox,
+                     const PDFObject& resources,
+                     const PDFObject& transparencyGroup,
+                     const ContentStreamProgram& program,
+                     PDFInteger formStructuralParent);
+
     /// Processes single command
-    void processCommand(const QByteArray& command);
+    /// \param op Operator of the command
+    /// \param command Command (name of the operator)
+    void processCommand(Operator op, QByteArrayView command);
+
+    /// Processes single operator
+    /// \param op Operator
+    /// \param command Command (name of the operator)
+    void processOperator(Operator op, QByteArrayView command);
+
+    /// Returns operator of the command, or invalid operator, if command is unknown
+    /// \param command Command (name of the operator)
+    static Operator getOperator(QByteArrayView command);
+
+    /// Calls the function and, if statistics are collected, accumulates
+    /// exclusive time of the function into the statistics under given category.
+    /// \param category Category
+    /// \param function Function
+    template<typename Function>
+    void processWithStatistics(PDFPageContentProcessorStatistics::Category category, Function function);
+
+    /// Returns statistics category of the operator
+    static PDFPageContentProcessorStatistics::Category getStatisticsCategory(Operator op);
 
     /// Performs path painting
     /// \param path Path, which should be drawn (can be emtpy - in that case nothing happens)
@@ -750,6 +1103,15 @@ private:
                                        PDFColorSpacePointer uncoloredPatternColorSpace,
                                        PDFColor uncoloredPatternColor);
 
+    /// Sets colors and color spaces of the current graphic state for painting
+    /// of the tiling pattern cell. Returns true, if pattern is uncolored.
+    /// \param tilingPattern Tiling pattern
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    bool initializeTilingPatternColors(const PDFTilingPattern* tilingPattern,
+                                       PDFColorSpacePointer uncoloredPatternColorSpace,
+                                       PDFColor uncoloredPatternColor);
+
     /// Applies graphic state dictionary
     /// \param graphicStateDictionary Dictionary to be applied to the current graphic state
     void processApplyGraphicState(const PDFDictionary* graphicStateDictionary);
@@ -854,16 +1216,28 @@ private:
     /// Notifies the updated graphic state. If nothing changed in graphic state, then nothing happens.
     void updateGraphicState();
 
-    template<typename... Operands>
-    inline QColor getColorFromColorSpace(const PDFAbstractColorSpace* colorSpace, Operands... operands)
-    {
+    /// Converts color using the color space. Converted colors are memoized,
+    /// because content streams often set the same color many times (for example,
+    /// content streams generated by plotting tools).
+    /// \param colorSpace Color space
+    /// \param color Color in the color space
+    QColor getMemoizedColor(const PDFColorSpacePointer& colorSpace, const PDFColor& color);
 
+    /// Converts color using the color space (without memoization). If statistics
+    /// are collected, then time of the color conversion is recorded.
+    /// \param colorSpace Color space
+    /// \param color Color in the color space
+    /// \param renderingIntent Rendering intent
+    QColor convertColor(const PDFColorSpacePointer& colorSpace, const PDFColor& color, RenderingIntent renderingIntent);
 
+    template<typename... Operands>
+    inline QColor getColorFromColorSpace(const PDFColorSpacePointer& colorSpace, Operands... operands)
+    {
         constexpr const size_t operandCount = sizeof...(Operands);
         const size_t colorSpaceComponentCount = colorSpace->getColorComponentCount();
         if (operandCount == colorSpaceComponentCount)
         {
-            return colorSpace->getColor(PDFColor(static_cast<PDFColorComponent>(operands)...), m_CMS, m_graphicState.getRenderingIntent(), this, true);
+            return getMemoizedColor(colorSpace, PDFColor(static_cast<PDFColorComponent>(operands)...));
         }
         else
         {
@@ -977,6 +1351,9 @@ private:
     // XObject:                    Do
     void operatorPaintXObject(PDFOperandName name); ///< Do, paint the X Object (image, form, ...)
 
+    /// Paints XObject of given resource name (implementation of the Do operator)
+    void paintXObject(const QByteArray& name);
+
     // Marked content:             MP, DP, BMC, BDC, EMC
     void operatorMarkedContentPoint(PDFOperandName name);                                       ///< MP, marked content point
     void operatorMarkedContentPointWithProperties(PDFOperandName name, PDFObject properties);   ///< DP, marked content point with properties
@@ -1056,8 +1433,8 @@ private:
     /// List of errors
     QList<PDFRenderError> m_errorList;
 
-    /// Current painter path
-    QPainterPath m_currentPath;
+    /// Current path (converted to painter path, when it is painted)
+    PDFPathBuilder m_currentPath;
 
     /// Nesting level of the begin/end of text object
     int m_textBeginEndState;
@@ -1068,6 +1445,31 @@ private:
     /// Is drawing uncolored tiling pattern?
     int m_drawingUncoloredTilingPatternState;
 
+    /// Image resolution hint (see setImageResolutionHint)
+    PDFReal m_imageResolutionHint = 0.0;
+
+    /// Count of painted partially decoded images
+    size_t m_partiallyDecodedImageCount = 0;
+
+    /// Are image previews enabled (see setImagePreviewsEnabled)?
+    bool m_imagePreviewsEnabled = false;
+
+    /// Count of painted image previews
+    size_t m_previewImageCount = 0;
+
+    /// Minimal count of image pixels, for which preview is decoded
+    static constexpr PDFInteger IMAGE_PREVIEW_MIN_PIXELS = 2048 * 2048;
+
+    /// Minimal count of image pixels, for which only the visible area is decoded
+    static constexpr PDFInteger DECODE_AREA_MIN_IMAGE_PIXELS = 4096 * 4096;
+
+    /// Maximal ratio of visible area to the image area, for which only visible area is decoded
+    static constexpr PDFReal DECODE_AREA_MAX_RATIO = 0.75;
+
+    /// Glyph, which is being painted, and its matrix (see getPaintedGlyph)
+    const QPainterPath* m_paintedGlyph = nullptr;
+    QTransform m_paintedGlyphMatrix;
+
     /// Actually realized physical font
     PDFCachedItem<PDFRealizedFontPointer> m_realizedFont;
 
@@ -1092,8 +1494,125 @@ private:
     /// Set with rendering errors, which were reported (and should be reported once)
     std::set<QString> m_onceReportedErrors;
 
+    /// Key of the memoized color (color space, rendering intent, color component count, color components)
+    using ColorCacheKey = std::tuple<const PDFAbstractColorSpace*, RenderingIntent, size_t, std::array<PDFColorComponent, 4>>;
+
+    /// Memoized color, color space is stored to keep it alive, so memory
+    /// of the color space is not reused for another color space.
+    using ColorCacheValue = std::pair<QColor, PDFColorSpacePointer>;
+
+    /// Maximal count of memoized colors, if it is exceeded, memoized colors are cleared
+    static constexpr size_t COLOR_CACHE_MAX_SIZE = 4096;
+
+    /// Memoized converted colors (see getMemoizedColor)
+    std::map<ColorCacheKey, ColorCacheValue> m_colorCache;
+
     /// Active structural parent key
     PDFInteger m_structuralParentKey;
+
+    /// Index of the currently processed page content stream (or -1, if
+    /// page content stream is not being processed)
+    PDFInteger m_pageContentStreamIndex;
+
+    /// Nesting level of the processed content, page content streams
+    /// are processed at level 1
+    int m_contentNestingLevel;
+
+    /// Statistics (or nullptr, if statistics are not collected)
+    PDFPageContentProcessorStatistics* m_statistics = nullptr;
+
+    /// Category of the currently processed operator
+    PDFPageContentProcessorStatistics::Category m_statisticsCategory = PDFPageContentProcessorStatistics::Category::Other;
+
+    /// Time of the operators nested in the currently processed operator
+    qint64 m_statisticsNestedTime = 0;
+
+    /// Inline image is being painted (inline images are not stored
+    /// in the image cache, because they are not objects of the document)
+    bool m_isPaintingInlineImage = false;
+};
+
+/// Process-wide cache of the pre-parsed content streams (see
+/// PDFPageContentProcessor::ContentStreamProgram). Content streams are identified
+/// by unique identifier of the document (see PDFDocumentId) and by the source
+/// of the content (reference of the content stream of the document, or glyph
+/// procedure of the Type 3 font, in this case, font is kept alive by the cache).
+/// Cache is bounded by memory consumption of the programs, least recently
+/// used programs are removed first. Programs of the document are removed from
+/// the cache, when identifier of the document is released. Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFContentStreamCache : public PDFManagedCache
+{
+public:
+    using ProgramPointer = PDFPageContentProcessor::ContentStreamProgramPointer;
+
+    struct Key
+    {
+        quint64 documentId = 0;
+        PDFObjectReference stream;          ///< Content stream
+        const QByteArray* glyph = nullptr;  ///< Glyph procedure of the Type 3 font
+
+        bool operator<(const Key& other) const
+        {
+            return std::tie(documentId, stream, glyph) < std::tie(other.documentId, other.stream, other.glyph);
+        }
+    };
+
+    /// Returns instance of the content stream cache
+    static PDFContentStreamCache* getInstance();
+
+    /// Finds program in the cache. If program is not found,
+    /// then nullptr is returned.
+    /// \param key Program key
+    ProgramPointer findProgram(const Key& key);
+
+    /// Inserts program into the cache. If program is too large,
+    /// or it is incomplete, it is not inserted.
+    /// \param key Program key
+    /// \param program Program
+    /// \param font Font owning the content of the program (can be nullptr)
+    void insertProgram(const Key& key, ProgramPointer program, PDFFontPointer font);
+
+    /// Removes all programs of the document from the cache
+    /// \param documentId Unique identifier of the document
+    void removeDocument(quint64 documentId);
+
+    /// Removes all programs from the cache
+    void clear();
+
+    /// Sets memory limit of the cache (in bytes)
+    void setCacheLimit(qint64 cacheLimit);
+
+    /// Returns memory limit of the cache (in bytes)
+    qint64 getCacheLimit() const;
+
+    /// Returns memory consumed by cached programs (in bytes)
+    qint64 getCacheSize() const;
+
+    virtual qint64 getManagedCacheSize() const override { return getCacheSize(); }
+    virtual quint64 getLeastRecentAccessStamp() const override;
+    virtual int getRecreationCost() const override;
+    virtual qint64 evict(qint64 bytes) override;
+
+private:
+    explicit PDFContentStreamCache();
+    virtual ~PDFContentStreamCache() override;
+
+    struct Entry
+    {
+        ProgramPointer program;
+        PDFFontPointer font;
+        qint64 size = 0;
+        quint64 lastAccess = 0;
+    };
+
+    /// Removes least recently used programs, until cache size is within the limit.
+    /// Mutex must be locked.
+    void shrink();
+
+    mutable QMutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    qint64 m_cacheLimit;
+    qint64 m_cacheSize = 0;
 };
 
 template<>
@@ -18,12 +18,21 @@
 #include "pdfpainter.h"
 #include "pdfpattern.h"
 #include "pdfcms.h"
+#include "pdfconstants.h"
 #include "pdfpainterutils.h"
+#include "pdfexecutionpolicy.h"
 
 #include <QPainter>
+#include <QDataStream>
+#include <QPaintEngine>
 #include <QCryptographicHash>
 #include <QtMath>
 
+#include <map>
+#include <numeric>
+#include <optional>
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -216,6 +225,60 @@ bool PDFPainterBase::canSetBlendMode(BlendMode mode) const
     return std::all_of(m_transparencyGroupDataStack.cbegin(), m_transparencyGroupDataStack.cend(), [](const PDFTransparencyGroupPainterData& group) { return group.blendMode == BlendMode::Normal || group.blendMode == BlendMode::Compatible; });
 }
 
+bool PDFPainterBase::isOverprintSimulated(bool stroke, bool fill) const
+{
+    if (!hasFeature(PDFRenderer::OverprintSimulation) || (!stroke && !fill))
+    {
+        return false;
+    }
+
+    const PDFPageContentProcessorState* graphicState = getGraphicState();
+    const BlendMode blendMode = graphicState->getBlendMode();
+
+    // Overprinting objects are painted using multiply composition, which
+    // can be used only, if we are painting with normal blend mode.
+    if ((blendMode != BlendMode::Normal && blendMode != BlendMode::Compatible) || !canSetBlendMode(BlendMode::Multiply))
+    {
+        return false;
+    }
+
+    const PDFOverprintMode overprintMode = graphicState->getOverprintMode();
+    auto isOverprinted = [&overprintMode](bool overprint, const PDFAbstractColorSpace* colorSpace)
+    {
+        if (!overprint || !colorSpace)
+        {
+            return false;
+        }
+
+        switch (colorSpace->getColorSpace())
+        {
+            case PDFAbstractColorSpace::ColorSpace::DeviceCMYK:
+                // Zero components leave inks unchanged only in nonzero overprint mode,
+                // otherwise all four process inks are painted (knocked out).
+                return overprintMode.overprintMode == 1;
+
+            case PDFAbstractColorSpace::ColorSpace::Separation:
+            case PDFAbstractColorSpace::ColorSpace::DeviceN:
+                return true;
+
+            default:
+                return false;
+        }
+    };
+
+    if (stroke && !isOverprinted(overprintMode.overprintStroking, graphicState->getStrokeColorSpace()))
+    {
+        return false;
+    }
+
+    if (fill && !isOverprinted(overprintMode.overprintFilling, graphicState->getFillColorSpace()))
+    {
+        return false;
+    }
+
+    return true;
+}
+
 void PDFPainterBase::performBeginTransparencyGroup(ProcessOrder order, const PDFTransparencyGroup& transparencyGroup)
 {
     if (order == ProcessOrder::BeforeOperation)
@@ -239,6 +302,137 @@ void PDFPainterBase::performEndTransparencyGroup(ProcessOrder order, const PDFTr
     }
 }
 
+bool PDFPainterBase::createTilingPatternBrush(const PDFTilingPattern* tilingPattern,
+                                              const QPainterPath& path,
+                                              const QPointF& tilingOrigin,
+                                              PDFReal devicePixelsPerUnit,
+                                              PDFColorSpacePointer uncoloredPatternColorSpace,
+                                              PDFColor uncoloredPatternColor,
+                                              QBrush& brush)
+{
+    const PDFPageContentProcessorState* graphicState = getGraphicState();
+
+    // Cell image is painted in the default graphic state of the pattern using
+    // resources of the pattern, so pattern cells, which do not have their own
+    // resources, or transparency, must be painted as vector graphics.
+    const PDFObject& resources = tilingPattern->getResources();
+    if (devicePixelsPerUnit <= 0.0 ||
+        isContentSuppressed() ||
+        resources.isNull() ||
+        !qFuzzyCompare(getEffectiveFillingAlpha(), 1.0) ||
+        graphicState->getSoftMask() ||
+        (graphicState->getBlendMode() != BlendMode::Normal && graphicState->getBlendMode() != BlendMode::Compatible))
+    {
+        return false;
+    }
+
+    // Cells must not overlap, otherwise they can't be painted using repeated image
+    const QRectF boundingBox = tilingPattern->getBoundingBox();
+    const PDFReal xStep = qAbs(tilingPattern->getXStep());
+    const PDFReal yStep = qAbs(tilingPattern->getYStep());
+    if (boundingBox.width() > xStep + PDF_EPSILON || boundingBox.height() > yStep + PDF_EPSILON)
+    {
+        return false;
+    }
+
+    // Pattern space axes must be mapped to the device space axes, so pixels
+    // of the cell image are aligned with the device pixels.
+    const QTransform worldMatrix = getCurrentWorldMatrix();
+    const bool isAxisAligned = (qFuzzyIsNull(worldMatrix.m12()) && qFuzzyIsNull(worldMatrix.m21())) ||
+                               (qFuzzyIsNull(worldMatrix.m11()) && qFuzzyIsNull(worldMatrix.m22()));
+    if (!worldMatrix.isAffine() || !worldMatrix.isInvertible() || !isAxisAligned)
+    {
+        return false;
+    }
+
+    const QPointF origin = worldMatrix.map(QPointF(0.0, 0.0));
+    const PDFReal xScale = QLineF(origin, worldMatrix.map(QPointF(1.0, 0.0))).length() * devicePixelsPerUnit;
+    const PDFReal yScale = QLineF(origin, worldMatrix.map(QPointF(0.0, 1.0))).length() * devicePixelsPerUnit;
+    const PDFReal cellWidth = qCeil(xStep * xScale);
+    const PDFReal cellHeight = qCeil(yStep * yScale);
+    if (cellWidth < 1.0 || cellHeight < 1.0 || cellWidth * cellHeight > TILING_PATTERN_CELL_IMAGE_MAX_PIXELS)
+    {
+        return false;
+    }
+
+    TilingPatternCellKey key;
+    key.content = tilingPattern->getContent();
+    key.resourcesReference = resources.isReference() ? resources.getReference() : PDFObjectReference();
+    key.resourcesDictionary = resources.isDictionary() ? resources.getDictionary() : nullptr;
+    key.left = boundingBox.left();
+    key.top = boundingBox.top();
+    key.right = boundingBox.right();
+    key.bottom = boundingBox.bottom();
+    key.xStep = xStep;
+    key.yStep = yStep;
+    key.width = static_cast<int>(cellWidth);
+    key.height = static_cast<int>(cellHeight);
+    key.renderingIntent = graphicState->getRenderingIntent();
+
+    if (tilingPattern->getPaintingType() == PDFTilingPattern::PaintType::Uncolored)
+    {
+        if (!uncoloredPatternColorSpace)
+        {
+            return false;
+        }
+
+        key.uncoloredColor = uncoloredPatternColorSpace->getCheckedColor(uncoloredPatternColor, getCMS(), key.renderingIntent, this).rgba();
+    }
+
+    // Map pattern space of the cell to the pixels of the cell image (y-axis is flipped)
+    const PDFReal xPixelsPerUnit = cellWidth / xStep;
+    const PDFReal yPixelsPerUnit = cellHeight / yStep;
+    const QTransform cellMatrix(xPixelsPerUnit, 0.0, 0.0, -yPixelsPerUnit, -boundingBox.left() * xPixelsPerUnit, (boundingBox.top() + yStep) * yPixelsPerUnit);
+
+    auto it = m_tilingPatternCellImages.find(key);
+    if (it == m_tilingPatternCellImages.end())
+    {
+        // Painting of single cell image isn't faster than painting of the cell
+        const QRectF tilingArea = path.boundingRect();
+        if (tilingArea.width() <= xStep && tilingArea.height() <= yStep)
+        {
+            return false;
+        }
+
+        QImage cellImage(key.width, key.height, QImage::Format_ARGB32_Premultiplied);
+        cellImage.fill(Qt::transparent);
+
+        PDFRenderer::Features cellFeatures = m_features;
+        cellFeatures.setFlag(PDFRenderer::ClipToCropBox, false);
+
+        QPainter cellPainter(&cellImage);
+        QList<PDFRenderError> errors;
+        {
+            PDFPainter cellProcessor(&cellPainter, cellFeatures, cellMatrix, getPage(), getDocument(), getFontCache(), getCMS(), getOptionalContentActivity(), getMeshQualitySettings());
+            cellProcessor.setOperationControl(getOperationControl());
+            cellProcessor.setImageResolutionHint(1.0);
+            errors = cellProcessor.processTilingPatternCell(tilingPattern, uncoloredPatternColorSpace, uncoloredPatternColor);
+        }
+        cellPainter.end();
+
+        for (const PDFRenderError& error : errors)
+        {
+            reportRenderErrorOnce(error.type, error.message);
+        }
+
+        if (isProcessingCancelled())
+        {
+            // Do not use incomplete cell image
+            return false;
+        }
+
+        it = m_tilingPatternCellImages.emplace(qMove(key), qMove(cellImage)).first;
+    }
+
+    // Cell image is repeated by the brush, first cell is placed at the tiling origin
+    QTransform brushMatrix = cellMatrix.inverted();
+    brushMatrix *= QTransform::fromTranslate(tilingOrigin.x(), tilingOrigin.y());
+
+    brush = QBrush(it->second);
+    brush.setTransform(brushMatrix);
+    return true;
+}
+
 PDFPainter::PDFPainter(QPainter* painter,
                        PDFRenderer::Features features,
                        QTransform pagePointToDevicePointMatrix,
@@ -280,6 +474,14 @@ void PDFPainter::performPathPainting(const QPainterPath& path, bool stroke, bool
 {
     Q_ASSERT(stroke || fill);
 
+    if (stroke && fill && isOverprintSimulated(true, false) != isOverprintSimulated(false, true))
+    {
+        // Only one of stroke/fill is overprinted, paint them separately
+        performPathPainting(path, false, true, text, fillRule);
+        performPathPainting(path, true, false, text, fillRule);
+        return;
+    }
+
     // Set antialiasing
     const bool antialiasing = (text && hasFeature(PDFRenderer::TextAntialiasing)) || (!text && hasFeature(PDFRenderer::Antialiasing));
     m_painter->setRenderHint(QPainter::Antialiasing, antialiasing);
@@ -303,7 +505,19 @@ void PDFPainter::performPathPainting(const QPainterPath& path, bool stroke, bool
     }
 
     Q_ASSERT(path.fillRule() == fillRule);
+
+    const bool isOverprinted = isOverprintSimulated(stroke, fill);
+    if (isOverprinted)
+    {
+        m_painter->setCompositionMode(QPainter::CompositionMode_Multiply);
+    }
+
     m_painter->drawPath(path);
+
+    if (isOverprinted)
+    {
+        m_painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+    }
 }
 
 void PDFPainter::performClipping(const QPainterPath& path, Qt::FillRule fillRule)
@@ -400,6 +614,28 @@ void PDFPainter::setCompositionMode(QPainter::CompositionMode mode)
     m_painter->setCompositionMode(mode);
 }
 
+bool PDFPainter::performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QPainterPath& path,
+                                              const QPointF& tilingOrigin,
+                                              PDFColorSpacePointer uncoloredPatternColorSpace,
+                                              PDFColor uncoloredPatternColor)
+{
+    // World matrix maps directly to the device pixels
+    QBrush brush;
+    if (!createTilingPatternBrush(tilingPattern, path, tilingOrigin, 1.0, uncoloredPatternColorSpace, uncoloredPatternColor, brush))
+    {
+        return false;
+    }
+
+    m_painter->save();
+    m_painter->setRenderHint(QPainter::Antialiasing, hasFeature(PDFRenderer::Antialiasing));
+    m_painter->setPen(Qt::NoPen);
+    m_painter->setBrush(brush);
+    m_painter->drawPath(path);
+    m_painter->restore();
+    return true;
+}
+
 PDFPrecompiledPageGenerator::PDFPrecompiledPageGenerator(PDFPrecompiledPage* precompiledPage,
                                                          PDFRenderer::Features features,
                                                          const PDFPage* page,
@@ -420,9 +656,55 @@ void PDFPrecompiledPageGenerator::performPathPainting(const QPainterPath& path,
     Q_ASSERT(stroke || fill);
     Q_ASSERT(path.fillRule() == fillRule);
 
+    if (stroke && fill && isOverprintSimulated(true, false) != isOverprintSimulated(false, true))
+    {
+        // Only one of stroke/fill is overprinted, paint them separately
+        performPathPainting(path, false, true, text, fillRule);
+        performPathPainting(path, true, false, text, fillRule);
+        return;
+    }
+
     QPen pen = stroke ? getCurrentPen() : QPen(Qt::NoPen);
     QBrush brush = fill ? getCurrentBrush() : QBrush(Qt::NoBrush);
-    m_precompiledPage->addPath(qMove(pen), qMove(brush), path, text);
+
+    const bool isOverprinted = isOverprintSimulated(stroke, fill);
+    if (isOverprinted)
+    {
+        m_precompiledPage->addSetCompositionMode(QPainter::CompositionMode_Multiply);
+    }
+
+    // Filled glyphs are stored together with glyph outline, so they
+    // can be drawn using rasterized glyph images.
+    const QPainterPath* glyph = getPaintedGlyph();
+    if (text && glyph && !stroke && brush.style() == Qt::SolidPattern)
+    {
+        m_precompiledPage->addGlyphPath(qMove(pen), qMove(brush), path, getGlyphIndex(glyph), getPaintedGlyphMatrix());
+    }
+    else
+    {
+        m_precompiledPage->addPath(qMove(pen), qMove(brush), path, text);
+    }
+
+    if (isOverprinted)
+    {
+        m_precompiledPage->addSetCompositionMode(QPainter::CompositionMode_SourceOver);
+    }
+}
+
+int PDFPrecompiledPageGenerator::getGlyphIndex(const QPainterPath* glyph)
+{
+    // Glyph outlines are owned by realized fonts. Address of the outline can
+    // be reused by another glyph, if realized font was destroyed, so we must
+    // also compare the outlines.
+    auto it = m_glyphIndices.find(glyph);
+    if (it != m_glyphIndices.cend() && m_precompiledPage->getGlyph(it->second) == *glyph)
+    {
+        return it->second;
+    }
+
+    const int glyphIndex = m_precompiledPage->addGlyph(*glyph);
+    m_glyphIndices[glyph] = glyphIndex;
+    return glyphIndex;
 }
 
 void PDFPrecompiledPageGenerator::performClipping(const QPainterPath& path, Qt::FillRule fillRule)
@@ -505,140 +787,598 @@ void PDFPrecompiledPageGenerator::setCompositionMode(QPainter::CompositionMode m
     m_precompiledPage->addSetCompositionMode(mode);
 }
 
-void PDFPrecompiledPage::draw(QPainter* painter,
-                              const QRectF& cropBox,
-                              const QTransform& pagePointToDevicePointMatrix,
-                              PDFRenderer::Features features,
-                              PDFReal opacity) const
+bool PDFPrecompiledPageGenerator::performPaintFormInstance(const PDFStream* formStream)
 {
-    Q_ASSERT(painter);
-    Q_ASSERT(pagePointToDevicePointMatrix.isInvertible());
-
-    painter->save();
-    painter->setWorldTransform(QTransform());
-    painter->setOpacity(opacity);
-
-    if (features.testFlag(PDFRenderer::ClipToCropBox))
-    {
-        if (cropBox.isValid())
-        {
-            QPainterPath path;
-            path.addPolygon(pagePointToDevicePointMatrix.map(cropBox));
-            painter->setClipPath(path, Qt::IntersectClip);
-        }
-    }
-
-    painter->setRenderHint(QPainter::SmoothPixmapTransform, features.testFlag(PDFRenderer::SmoothImages));
+    const QTransform worldMatrix = getCurrentWorldMatrix();
+    const PDFPageContentProcessorState* state = getGraphicState();
+    PDFSnapInfo* snapInfo = m_precompiledPage->getSnapInfo();
 
-    // Process all instructions
-    for (const Instruction& instruction : m_instructions)
+    auto it = m_formInstances.find(formStream);
+    if (it != m_formInstances.cend())
     {
-        switch (instruction.type)
+        for (const FormInstance& instance : it->second)
         {
-            case InstructionType::DrawPath:
+            if (!isFormInstanceCompatible(instance, *state))
             {
-                const PathPaintData& data = m_paths[instruction.dataIndex];
-
-                // Set antialiasing
-                const bool antialiasing = (data.isText && features.testFlag(PDFRenderer::TextAntialiasing)) || (!data.isText && features.testFlag(PDFRenderer::Antialiasing));
-                painter->setRenderHint(QPainter::Antialiasing, antialiasing);
-                painter->setPen(data.pen);
-                painter->setBrush(data.brush);
-                painter->drawPath(data.path);
-                break;
+                continue;
             }
 
-            case InstructionType::DrawImage:
+            // Replay recorded instructions, only world matrices differ
+            const QTransform matrix = instance.worldMatrix.inverted() * worldMatrix;
+            if (!canPaintFormInstance(m_precompiledPage, instance, matrix))
             {
-                const ImageData& data = m_images[instruction.dataIndex];
-                const QImage& image = data.image;
-
-                painter->save();
+                continue;
+            }
 
-                QTransform imageTransform(1.0 / image.width(), 0, 0, 1.0 / image.height(), 0, 0);
-                QTransform worldTransform = imageTransform * painter->worldTransform();
+            m_precompiledPage->addInstructions(instance.firstInstruction, instance.lastInstruction, matrix);
+            addSnapImages(snapInfo, instance, matrix);
+            return true;
+        }
+    }
 
-                // Jakub Melka: Because Qt uses opposite axis direction than PDF, then we must transform the y-axis
-                // to the opposite (so the image is then unchanged)
-                worldTransform.translate(0, image.height());
-                worldTransform.scale(1, -1);
+    auto precompiledFormIt = m_precompiledForms.find(formStream);
+    if (precompiledFormIt != m_precompiledForms.end() && isFormInstanceCompatible(precompiledFormIt->second.instance, *state))
+    {
+        PrecompiledForm& precompiledForm = precompiledFormIt->second;
+        const FormInstance& instance = precompiledForm.instance;
+        const QTransform matrix = instance.worldMatrix.inverted() * worldMatrix;
+        if (canPaintFormInstance(&precompiledForm.page, instance, matrix))
+        {
+            m_precompiledPage->addInstructions(precompiledForm.page, instance.firstInstruction, instance.lastInstruction, matrix, precompiledForm.glyphIndices);
+            addSnapImages(precompiledForm.page.getSnapInfo(), instance, matrix);
 
-                painter->setWorldTransform(worldTransform);
-                painter->drawImage(0, 0, image);
-                painter->restore();
-                break;
+            if (instance.hasTilingPatternImages)
+            {
+                ++m_tilingPatternImageCount;
             }
 
-            case InstructionType::DrawMesh:
-            {
-                const MeshPaintData& data = m_meshes[instruction.dataIndex];
+            return true;
+        }
+    }
 
-                painter->save();
-                painter->setWorldTransform(QTransform(pagePointToDevicePointMatrix));
-                data.mesh.paint(painter, data.alpha);
-                painter->restore();
-                break;
-            }
+    // Form is processed as usual, start recording of the form instance
+    FormInstance instance;
+    instance.formStream = formStream;
+    instance.graphicState = *state;
+    instance.worldMatrix = worldMatrix;
+    instance.strokingAlpha = getEffectiveStrokingAlpha();
+    instance.fillingAlpha = getEffectiveFillingAlpha();
+    instance.isContentSuppressed = isContentSuppressed();
+    instance.firstInstruction = m_precompiledPage->getInstructionCount();
+    instance.firstSnapImage = snapInfo->getSnapImages().size();
+    instance.partiallyDecodedImageCount = getPartiallyDecodedImageCount();
+    instance.tilingPatternImageCount = m_tilingPatternImageCount;
+    m_processedForms.push_back(qMove(instance));
+
+    return false;
+}
 
-            case InstructionType::Clip:
-            {
-                painter->setClipPath(m_clips[instruction.dataIndex].clipPath, Qt::IntersectClip);
-                break;
-            }
+void PDFPrecompiledPageGenerator::performFormProcessed(const PDFStream* formStream)
+{
+    // Processing of nested forms can be interrupted by an error, such
+    // forms are not finished and they are not recorded.
+    while (!m_processedForms.empty() && m_processedForms.back().formStream != formStream)
+    {
+        m_processedForms.pop_back();
+    }
 
-            case InstructionType::SaveGraphicState:
-            {
-                painter->save();
-                break;
-            }
+    if (m_processedForms.empty())
+    {
+        return;
+    }
 
-            case InstructionType::RestoreGraphicState:
-            {
-                painter->restore();
-                break;
-            }
+    FormInstance instance = qMove(m_processedForms.back());
+    m_processedForms.pop_back();
 
-            case InstructionType::SetWorldMatrix:
-            {
-                painter->setWorldTransform(QTransform(m_matrices[instruction.dataIndex] * pagePointToDevicePointMatrix));
-                break;
-            }
+    instance.lastInstruction = m_precompiledPage->getInstructionCount();
+    instance.lastSnapImage = m_precompiledPage->getSnapInfo()->getSnapImages().size();
+    instance.hasTilingPatternImages = instance.tilingPatternImageCount != m_tilingPatternImageCount;
 
-            case InstructionType::SetCompositionMode:
-            {
-                painter->setCompositionMode(m_compositionModes[instruction.dataIndex]);
-                break;
-            }
+    // Shading meshes are stored in page coordinates, so they can't be transformed. Partially
+    // decoded images contain only part of the image visible for this transformation.
+    if (!instance.worldMatrix.isInvertible() ||
+        instance.firstInstruction == instance.lastInstruction ||
+        instance.partiallyDecodedImageCount != getPartiallyDecodedImageCount() ||
+        m_precompiledPage->hasInstruction(instance.firstInstruction, instance.lastInstruction, PDFPrecompiledPage::InstructionType::DrawMesh))
+    {
+        return;
+    }
 
-            default:
-            {
-                Q_ASSERT(false);
-                break;
-            }
-        }
+    std::vector<FormInstance>& instances = m_formInstances[formStream];
+    if (instances.size() < MAX_FORM_INSTANCES)
+    {
+        instances.push_back(qMove(instance));
     }
+}
 
-    painter->restore();
+bool PDFPrecompiledPageGenerator::performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                                               const QPainterPath& path,
+                                                               const QPointF& tilingOrigin,
+                                                               PDFColorSpacePointer uncoloredPatternColorSpace,
+                                                               PDFColor uncoloredPatternColor)
+{
+    // Resolution of the target device is known only from the image resolution hint
+    QBrush brush;
+    if (!createTilingPatternBrush(tilingPattern, path, tilingOrigin, getImageResolutionHint(), uncoloredPatternColorSpace, uncoloredPatternColor, brush))
+    {
+        return false;
+    }
+
+    m_precompiledPage->addPath(QPen(Qt::NoPen), qMove(brush), path, false);
+    ++m_tilingPatternImageCount;
+    return true;
 }
 
-void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matrix, QColor color)
+void PDFPrecompiledPageGenerator::performPageContentsBegin()
 {
-    if (redactPath.isEmpty())
+    precompileForms();
+}
+
+void PDFPrecompiledPageGenerator::precompileForms()
+{
+    if (!PDFExecutionPolicy::isParallelizing(PDFExecutionPolicy::Scope::Content))
     {
-        // Nothing to be redacted
         return;
     }
 
-    std::stack<QTransform> worldMatrixStack;
-    worldMatrixStack.push(matrix);
-
-    if (color.isValid())
+    const std::vector<FormInvocation> invocations = getPageFormInvocations();
+    if (invocations.size() < MIN_PRECOMPILED_FORMS || isProcessingCancelled())
     {
-        m_instructions.insert(m_instructions.begin(), Instruction(InstructionType::SaveGraphicState, 0));
+        return;
     }
 
-    // Process all instructions
-    for (const Instruction& instruction : m_instructions)
+    // Graphic state is shared by all forms (including color spaces), so
+    // compiled forms are compatible with forms painted in the initial state.
+    const PDFPageContentProcessorState initialState = *getGraphicState();
+    PDFPageContentProcessorStatistics* statistics = getStatistics();
+
+    std::vector<PrecompiledForm> precompiledForms(invocations.size());
+    std::vector<PDFPageContentProcessorStatistics> formStatistics(statistics ? invocations.size() : 0);
+    std::vector<size_t> indices(invocations.size(), 0);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    auto compileForm = [&](size_t index)
+    {
+        const FormInvocation& invocation = invocations[index];
+        PrecompiledForm& precompiledForm = precompiledForms[index];
+
+        PDFPageContentProcessorState state = initialState;
+        state.setCurrentTransformationMatrix(invocation.currentTransformationMatrix);
+
+        PDFPrecompiledPageGenerator generator(&precompiledForm.page, getFeatures(), getPage(), getDocument(), getFontCache(), getCMS(), getOptionalContentActivity(), getMeshQualitySettings());
+        generator.setOperationControl(getOperationControl());
+        generator.setImageResolutionHint(getImageResolutionHint());
+        generator.setImagePreviewsEnabled(isImagePreviewsEnabled());
+        generator.setStatistics(statistics ? &formStatistics[index] : nullptr);
+        QList<PDFRenderError> errors = generator.processFormXObject(invocation.formStream, state);
+
+        // Forms with errors (or with image previews) are processed as usual,
+        // so errors are reported and preview images are counted.
+        auto it = generator.m_formInstances.find(invocation.formStream);
+        if (errors.isEmpty() &&
+            generator.getPreviewImageCount() == 0 &&
+            !generator.isProcessingCancelled() &&
+            it != generator.m_formInstances.end() &&
+            !it->second.empty())
+        {
+            precompiledForm.instance = it->second.front();
+            precompiledForm.isValid = true;
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, indices.cbegin(), indices.cend(), compileForm);
+
+    for (size_t i = 0; i < invocations.size(); ++i)
+    {
+        if (statistics)
+        {
+            statistics->merge(formStatistics[i]);
+        }
+
+        if (precompiledForms[i].isValid)
+        {
+            m_precompiledForms[invocations[i].formStream] = qMove(precompiledForms[i]);
+        }
+    }
+}
+
+void PDFPrecompiledPageGenerator::addSnapImages(const PDFSnapInfo* snapInfo, const FormInstance& instance, const QTransform& matrix)
+{
+    PDFSnapInfo* targetSnapInfo = m_precompiledPage->getSnapInfo();
+    for (size_t i = instance.firstSnapImage; i < instance.lastSnapImage; ++i)
+    {
+        // Snap image is copied, because snap images can be reallocated
+        const PDFSnapInfo::SnapImage snapImage = snapInfo->getSnapImages()[i];
+        const QPointF p0 = matrix.map(QPointF(snapImage.imagePath.elementAt(0)));
+        const QPointF p1 = matrix.map(QPointF(snapImage.imagePath.elementAt(1)));
+        const QPointF p2 = matrix.map(QPointF(snapImage.imagePath.elementAt(2)));
+        const QPointF p3 = matrix.map(QPointF(snapImage.imagePath.elementAt(3)));
+        targetSnapInfo->addImage({ p0, p1, p2, p3, (p0 + p2) * 0.5 }, snapImage.image);
+    }
+}
+
+bool PDFPrecompiledPageGenerator::canPaintFormInstance(const PDFPrecompiledPage* page, const FormInstance& instance, const QTransform& matrix) const
+{
+    return getImageResolutionHint() <= 0.0 ||
+           std::abs(matrix.determinant()) <= 1.0 + PDF_EPSILON ||
+           (!instance.hasTilingPatternImages && !page->hasInstruction(instance.firstInstruction, instance.lastInstruction, PDFPrecompiledPage::InstructionType::DrawImage));
+}
+
+bool PDFPrecompiledPageGenerator::isFormInstanceCompatible(const FormInstance& instance, const PDFPageContentProcessorState& state) const
+{
+    const PDFPageContentProcessorState& recordedState = instance.graphicState;
+
+    // Form inherits all parameters of the graphic state except transformation
+    // matrices, so all parameters affecting the painting must be equal.
+    return instance.isContentSuppressed == isContentSuppressed() &&
+           instance.strokingAlpha == getEffectiveStrokingAlpha() &&
+           instance.fillingAlpha == getEffectiveFillingAlpha() &&
+           recordedState.getStrokeColorSpace() == state.getStrokeColorSpace() &&
+           recordedState.getFillColorSpace() == state.getFillColorSpace() &&
+           recordedState.getStrokeColor() == state.getStrokeColor() &&
+           recordedState.getStrokeColorOriginal() == state.getStrokeColorOriginal() &&
+           recordedState.getFillColor() == state.getFillColor() &&
+           recordedState.getFillColorOriginal() == state.getFillColorOriginal() &&
+           recordedState.getLineWidth() == state.getLineWidth() &&
+           recordedState.getLineCapStyle() == state.getLineCapStyle() &&
+           recordedState.getLineJoinStyle() == state.getLineJoinStyle() &&
+           recordedState.getMitterLimit() == state.getMitterLimit() &&
+           recordedState.getLineDashPattern() == state.getLineDashPattern() &&
+           recordedState.getRenderingIntent() == state.getRenderingIntent() &&
+           recordedState.getFlatness() == state.getFlatness() &&
+           recordedState.getSmoothness() == state.getSmoothness() &&
+           recordedState.getTextCharacterSpacing() == state.getTextCharacterSpacing() &&
+           recordedState.getTextWordSpacing() == state.getTextWordSpacing() &&
+           recordedState.getTextHorizontalScaling() == state.getTextHorizontalScaling() &&
+           recordedState.getTextLeading() == state.getTextLeading() &&
+           recordedState.getTextFont() == state.getTextFont() &&
+           recordedState.getTextFontSize() == state.getTextFontSize() &&
+           recordedState.getTextRenderingMode() == state.getTextRenderingMode() &&
+           recordedState.getTextRise() == state.getTextRise() &&
+           recordedState.getTextKnockout() == state.getTextKnockout() &&
+           recordedState.getAlphaStroking() == state.getAlphaStroking() &&
+           recordedState.getAlphaFilling() == state.getAlphaFilling() &&
+           recordedState.getBlendMode() == state.getBlendMode() &&
+           recordedState.getOverprintMode() == state.getOverprintMode() &&
+           recordedState.getAlphaIsShape() == state.getAlphaIsShape() &&
+           recordedState.getStrokeAdjustment() == state.getStrokeAdjustment() &&
+           recordedState.getSoftMask() == state.getSoftMask();
+}
+
+/// Cache of rasterized glyphs, which is used during drawing of the precompiled
+/// page. Glyphs painted axis-aligned with small size are rasterized only once
+/// for each scale, subpixel position and color, and then the rasterized image
+/// is just blitted onto the painter. Rotated or large glyphs are not cached.
+class PDFGlyphImageCache
+{
+public:
+    explicit inline PDFGlyphImageCache() = default;
+
+    /// Draws glyph using cached glyph image. If glyph can't be drawn
+    /// using the cache (for example, it is rotated, or it is too large),
+    /// then nothing is drawn and false is returned.
+    /// \param painter Painter (current world matrix maps user space to the device space)
+    /// \param glyph Glyph outline
+    /// \param glyphIndex Index of the glyph outline
+    /// \param glyphMatrix Matrix mapping glyph outline to the user space
+    /// \param color Glyph color
+    /// \param antialiasing Draw antialiased glyph
+    bool drawGlyph(QPainter* painter,
+                   const QPainterPath& glyph,
+                   int glyphIndex,
+                   const QTransform& glyphMatrix,
+                   QColor color,
+                   bool antialiasing);
+
+private:
+    struct Key
+    {
+        int glyphIndex = -1;
+        PDFReal scaleX = 0.0;
+        PDFReal scaleY = 0.0;
+        int subpixelX = 0;
+        int subpixelY = 0;
+        QRgb color = 0;
+        bool antialiasing = false;
+
+        bool operator<(const Key& other) const
+        {
+            return std::tie(glyphIndex, scaleX, scaleY, subpixelX, subpixelY, color, antialiasing) <
+                   std::tie(other.glyphIndex, other.scaleX, other.scaleY, other.subpixelX, other.subpixelY, other.color, other.antialiasing);
+        }
+    };
+
+    struct GlyphImage
+    {
+        QImage image;
+        QPoint offset;  ///< Offset of the image from the glyph origin (in device pixels)
+    };
+
+    /// Number of subpixel positions in one pixel (in each direction)
+    static constexpr int SUBPIXEL_POSITIONS = 4;
+
+    /// Maximal size of the cached glyph in device pixels
+    static constexpr PDFReal MAX_GLYPH_SIZE = 64.0;
+
+    /// Maximal number of cached glyph images
+    static constexpr size_t MAX_GLYPH_IMAGES = 4096;
+
+    std::map<Key, GlyphImage> m_glyphImages;
+};
+
+bool PDFGlyphImageCache::drawGlyph(QPainter* painter,
+                                   const QPainterPath& glyph,
+                                   int glyphIndex,
+                                   const QTransform& glyphMatrix,
+                                   QColor color,
+                                   bool antialiasing)
+{
+    const QTransform worldTransform = painter->worldTransform();
+    const QTransform matrix = glyphMatrix * worldTransform;
+
+    // Only axis-aligned glyphs are cached
+    if (matrix.type() > QTransform::TxScale)
+    {
+        return false;
+    }
+
+    const QRectF glyphRect = matrix.mapRect(glyph.controlPointRect());
+    if (glyphRect.width() > MAX_GLYPH_SIZE || glyphRect.height() > MAX_GLYPH_SIZE)
+    {
+        return false;
+    }
+
+    // Split glyph origin into integer pixel position and subpixel position
+    auto splitCoordinate = [](PDFReal coordinate, int& pixel, int& subpixel)
+    {
+        const PDFReal pixelCoordinate = std::floor(coordinate);
+        pixel = int(pixelCoordinate);
+        subpixel = qRound((coordinate - pixelCoordinate) * SUBPIXEL_POSITIONS);
+
+        if (subpixel == SUBPIXEL_POSITIONS)
+        {
+            subpixel = 0;
+            ++pixel;
+        }
+    };
+
+    Key key;
+    key.glyphIndex = glyphIndex;
+    key.scaleX = matrix.m11();
+    key.scaleY = matrix.m22();
+    key.color = color.rgba();
+    key.antialiasing = antialiasing;
+
+    QPoint origin;
+    splitCoordinate(matrix.dx(), origin.rx(), key.subpixelX);
+    splitCoordinate(matrix.dy(), origin.ry(), key.subpixelY);
+
+    auto it = m_glyphImages.find(key);
+    if (it == m_glyphImages.end())
+    {
+        if (m_glyphImages.size() >= MAX_GLYPH_IMAGES)
+        {
+            return false;
+        }
+
+        const QTransform rasterMatrix(key.scaleX, 0.0, 0.0, key.scaleY,
+                                      PDFReal(key.subpixelX) / SUBPIXEL_POSITIONS,
+                                      PDFReal(key.subpixelY) / SUBPIXEL_POSITIONS);
+        const QRect rasterRect = rasterMatrix.mapRect(glyph.controlPointRect()).toAlignedRect().adjusted(-1, -1, 1, 1);
+
+        GlyphImage glyphImage;
+        glyphImage.offset = rasterRect.topLeft();
+        glyphImage.image = QImage(rasterRect.size(), QImage::Format_ARGB32_Premultiplied);
+        glyphImage.image.fill(Qt::transparent);
+
+        QPainter glyphPainter(&glyphImage.image);
+        glyphPainter.setRenderHint(QPainter::Antialiasing, antialiasing);
+        glyphPainter.setPen(Qt::NoPen);
+        glyphPainter.setBrush(color);
+        glyphPainter.setWorldTransform(rasterMatrix * QTransform::fromTranslate(-rasterRect.left(), -rasterRect.top()));
+        glyphPainter.drawPath(glyph);
+        glyphPainter.end();
+
+        it = m_glyphImages.emplace(key, qMove(glyphImage)).first;
+    }
+
+    painter->setWorldTransform(QTransform());
+    painter->drawImage(origin + it->second.offset, it->second.image);
+    painter->setWorldTransform(worldTransform);
+    return true;
+}
+
+void PDFPrecompiledPage::draw(QPainter* painter,
+                              const QRectF& cropBox,
+                              const QTransform& pagePointToDevicePointMatrix,
+                              PDFRenderer::Features features,
+                              PDFReal opacity) const
+{
+    Q_ASSERT(painter);
+    Q_ASSERT(pagePointToDevicePointMatrix.isInvertible());
+
+    painter->save();
+    painter->setWorldTransform(QTransform());
+    painter->setOpacity(opacity);
+
+    if (features.testFlag(PDFRenderer::ClipToCropBox))
+    {
+        if (cropBox.isValid())
+        {
+            QPainterPath path;
+            path.addPolygon(pagePointToDevicePointMatrix.map(cropBox));
+            painter->setClipPath(path, Qt::IntersectClip);
+        }
+    }
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, features.testFlag(PDFRenderer::SmoothImages));
+
+    // Determine visible draw instructions using spatial index. Visible area
+    // is enlarged by few pixels to cover cosmetic pens and antialiasing.
+    std::vector<bool> visibleInstructions;
+    if (m_spatialIndex.isValid())
+    {
+        QRectF deviceRect = painter->window();
+        if (painter->hasClipping())
+        {
+            deviceRect = deviceRect.intersected(painter->clipBoundingRect());
+        }
+
+        constexpr PDFReal deviceMargin = 2.0;
+        deviceRect.adjust(-deviceMargin, -deviceMargin, deviceMargin, deviceMargin);
+
+        const QRectF pageRect = pagePointToDevicePointMatrix.inverted().mapRect(deviceRect);
+        if (!pageRect.contains(m_spatialIndex.bounds))
+        {
+            visibleInstructions = m_spatialIndex.query(pageRect, m_instructions.size());
+        }
+    }
+
+    PDFGlyphImageCache glyphImageCache;
+    const bool useGlyphImageCache = painter->paintEngine() && painter->paintEngine()->type() == QPaintEngine::Raster;
+
+    // Process all instructions
+    for (size_t i = 0; i < m_instructions.size(); ++i)
+    {
+        const Instruction& instruction = m_instructions[i];
+
+        if (!visibleInstructions.empty() && !visibleInstructions[i])
+        {
+            switch (instruction.type)
+            {
+                case InstructionType::DrawPath:
+                case InstructionType::DrawImage:
+                case InstructionType::DrawMesh:
+                    // Instruction is outside of visible area, skip it
+                    continue;
+
+                default:
+                    break;
+            }
+        }
+
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+            {
+                const PathPaintData& data = m_paths[instruction.dataIndex];
+
+                // Set antialiasing
+                const bool antialiasing = (data.isText && features.testFlag(PDFRenderer::TextAntialiasing)) || (!data.isText && features.testFlag(PDFRenderer::Antialiasing));
+
+                // Small axis-aligned glyphs are blitted from the glyph image cache.
+                // Images are used only with raster engine, where blitting of the
+                // image is much faster, than filling of the glyph outline.
+                if (data.glyphIndex >= 0 &&
+                    useGlyphImageCache &&
+                    data.pen.style() == Qt::NoPen &&
+                    data.brush.style() == Qt::SolidPattern &&
+                    painter->compositionMode() == QPainter::CompositionMode_SourceOver &&
+                    glyphImageCache.drawGlyph(painter, m_glyphs[data.glyphIndex], data.glyphIndex, data.glyphMatrix, data.brush.color(), antialiasing))
+                {
+                    break;
+                }
+
+                painter->setRenderHint(QPainter::Antialiasing, antialiasing);
+                painter->setPen(data.pen);
+                painter->setBrush(data.brush);
+                painter->drawPath(data.path);
+                break;
+            }
+
+            case InstructionType::DrawImage:
+            {
+                const ImageData& data = m_images[instruction.dataIndex];
+                const QImage& image = data.image;
+
+                painter->save();
+
+                QTransform imageTransform(1.0 / image.width(), 0, 0, 1.0 / image.height(), 0, 0);
+                QTransform worldTransform = imageTransform * painter->worldTransform();
+
+                // Jakub Melka: Because Qt uses opposite axis direction than PDF, then we must transform the y-axis
+                // to the opposite (so the image is then unchanged)
+                worldTransform.translate(0, image.height());
+                worldTransform.scale(1, -1);
+
+                painter->setWorldTransform(worldTransform);
+                painter->drawImage(0, 0, image);
+                painter->restore();
+                break;
+            }
+
+            case InstructionType::DrawMesh:
+            {
+                const MeshPaintData& data = m_meshes[instruction.dataIndex];
+
+                painter->save();
+                painter->setWorldTransform(QTransform(pagePointToDevicePointMatrix));
+                data.mesh.paint(painter, data.alpha);
+                painter->restore();
+                break;
+            }
+
+            case InstructionType::Clip:
+            {
+                painter->setClipPath(m_clips[instruction.dataIndex].clipPath, Qt::IntersectClip);
+                break;
+            }
+
+            case InstructionType::SaveGraphicState:
+            {
+                painter->save();
+                break;
+            }
+
+            case InstructionType::RestoreGraphicState:
+            {
+                painter->restore();
+                break;
+            }
+
+            case InstructionType::SetWorldMatrix:
+            {
+                painter->setWorldTransform(QTransform(m_matrices[instruction.dataIndex] * pagePointToDevicePointMatrix));
+                break;
+            }
+
+            case InstructionType::SetCompositionMode:
+            {
+                painter->setCompositionMode(m_compositionModes[instruction.dataIndex]);
+                break;
+            }
+
+            default:
+            {
+                Q_ASSERT(false);
+                break;
+            }
+        }
+    }
+
+    painter->restore();
+}
+
+void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matrix, QColor color)
+{
+    if (redactPath.isEmpty())
+    {
+        // Nothing to be redacted
+        return;
+    }
+
+    // Repeated graphics share data, but they are redacted separately
+    detachSharedData();
+
+    std::stack<QTransform> worldMatrixStack;
+    worldMatrixStack.push(matrix);
+
+    if (color.isValid())
+    {
+        m_instructions.insert(m_instructions.begin(), Instruction(InstructionType::SaveGraphicState, 0));
+    }
+
+    // Process all instructions
+    for (const Instruction& instruction : m_instructions)
     {
         switch (instruction.type)
         {
@@ -648,6 +1388,7 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
                 QPainterPath mappedRedactPath = currentMatrix.map(redactPath);
                 PathPaintData& path = m_paths[instruction.dataIndex];
                 path.path = path.path.subtracted(mappedRedactPath);
+                path.glyphIndex = -1;
                 break;
             }
 
@@ -711,6 +1452,9 @@ void PDFPrecompiledPage::redact(QPainterPath redactPath, const QTransform& matri
         addRestoreGraphicState();
         addPath(Qt::NoPen, QBrush(color), matrix.map(redactPath), false);
     }
+
+    // Instructions were changed, so we must rebuild the spatial index
+    buildSpatialIndex();
 }
 
 void PDFPrecompiledPage::addPath(QPen pen, QBrush brush, QPainterPath path, bool isText)
@@ -719,6 +1463,22 @@ void PDFPrecompiledPage::addPath(QPen pen, QBrush brush, QPainterPath path, bool
     m_paths.emplace_back(qMove(pen), qMove(brush), qMove(path), isText);
 }
 
+void PDFPrecompiledPage::addGlyphPath(QPen pen, QBrush brush, QPainterPath path, int glyphIndex, const QTransform& glyphMatrix)
+{
+    Q_ASSERT(glyphIndex >= 0 && glyphIndex < int(m_glyphs.size()));
+
+    m_instructions.emplace_back(InstructionType::DrawPath, m_paths.size());
+    PathPaintData& data = m_paths.emplace_back(qMove(pen), qMove(brush), qMove(path), true);
+    data.glyphIndex = glyphIndex;
+    data.glyphMatrix = glyphMatrix;
+}
+
+int PDFPrecompiledPage::addGlyph(QPainterPath glyph)
+{
+    m_glyphs.emplace_back(qMove(glyph));
+    return int(m_glyphs.size()) - 1;
+}
+
 void PDFPrecompiledPage::addClip(QPainterPath path)
 {
     m_instructions.emplace_back(InstructionType::Clip, m_clips.size());
@@ -756,42 +1516,747 @@ void PDFPrecompiledPage::addSetCompositionMode(QPainter::CompositionMode composi
     m_compositionModes.push_back(compositionMode);
 }
 
-void PDFPrecompiledPage::optimize()
-{
-    m_instructions.shrink_to_fit();
-    m_paths.shrink_to_fit();
-    m_clips.shrink_to_fit();
-    m_images.shrink_to_fit();
-    m_meshes.shrink_to_fit();
-    m_matrices.shrink_to_fit();
-    m_compositionModes.shrink_to_fit();
-}
-
-void PDFPrecompiledPage::convertColors(const PDFColorConvertor& colorConvertor)
+void PDFPrecompiledPage::addInstructions(size_t firstInstruction, size_t lastInstruction, const QTransform& matrix)
 {
-    // Jakub Melka: we must apply color convertor in following areas:
-    //     - painter paths
-    //     - images
-    //     - meshes
+    Q_ASSERT(firstInstruction <= lastInstruction && lastInstruction <= m_instructions.size());
 
-    if (!colorConvertor.isActive())
+    for (size_t i = firstInstruction; i < lastInstruction; ++i)
     {
-        return;
-    }
+        // Instruction is copied, because instructions can be reallocated
+        const Instruction instruction = m_instructions[i];
 
-    for (PathPaintData& pathData : m_paths)
-    {
-        if (pathData.pen.style() != Qt::NoPen)
+        if (instruction.type == InstructionType::SetWorldMatrix)
         {
-            pathData.pen.setColor(colorConvertor.convert(pathData.pen.color(), false, pathData.isText));
+            addSetWorldMatrix(m_matrices[instruction.dataIndex] * matrix);
         }
-        if (pathData.brush.style() == Qt::SolidPattern)
+        else
         {
-            pathData.brush.setColor(colorConvertor.convert(pathData.brush.color(), false, pathData.isText));
+            m_instructions.push_back(instruction);
         }
     }
+}
 
-    for (ImageData& imageData : m_images)
+void PDFPrecompiledPage::addInstructions(const PDFPrecompiledPage& page,
+                                         size_t firstInstruction,
+                                         size_t lastInstruction,
+                                         const QTransform& matrix,
+                                         std::vector<int>& glyphIndices)
+{
+    Q_ASSERT(&page != this);
+    Q_ASSERT(firstInstruction <= lastInstruction && lastInstruction <= page.m_instructions.size());
+
+    glyphIndices.resize(page.m_glyphs.size(), -1);
+
+    for (size_t i = firstInstruction; i < lastInstruction; ++i)
+    {
+        const Instruction& instruction = page.m_instructions[i];
+
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+            {
+                PathPaintData data = page.m_paths[instruction.dataIndex];
+                if (data.glyphIndex != -1)
+                {
+                    int& glyphIndex = glyphIndices[data.glyphIndex];
+                    if (glyphIndex == -1)
+                    {
+                        glyphIndex = addGlyph(page.m_glyphs[data.glyphIndex]);
+                    }
+                    data.glyphIndex = glyphIndex;
+                }
+
+                m_instructions.emplace_back(InstructionType::DrawPath, m_paths.size());
+                m_paths.push_back(qMove(data));
+                break;
+            }
+
+            case InstructionType::DrawImage:
+                m_instructions.emplace_back(InstructionType::DrawImage, m_images.size());
+                m_images.push_back(page.m_images[instruction.dataIndex]);
+                break;
+
+            case InstructionType::DrawMesh:
+                m_instructions.emplace_back(InstructionType::DrawMesh, m_meshes.size());
+                m_meshes.push_back(page.m_meshes[instruction.dataIndex]);
+                break;
+
+            case InstructionType::Clip:
+                m_instructions.emplace_back(InstructionType::Clip, m_clips.size());
+                m_clips.push_back(page.m_clips[instruction.dataIndex]);
+                break;
+
+            case InstructionType::SaveGraphicState:
+            case InstructionType::RestoreGraphicState:
+                m_instructions.push_back(instruction);
+                break;
+
+            case InstructionType::SetWorldMatrix:
+                addSetWorldMatrix(page.m_matrices[instruction.dataIndex] * matrix);
+                break;
+
+            case InstructionType::SetCompositionMode:
+                addSetCompositionMode(page.m_compositionModes[instruction.dataIndex]);
+                break;
+
+            default:
+                Q_ASSERT(false);
+                break;
+        }
+    }
+}
+
+bool PDFPrecompiledPage::hasInstruction(size_t firstInstruction, size_t lastInstruction, InstructionType type) const
+{
+    Q_ASSERT(firstInstruction <= lastInstruction && lastInstruction <= m_instructions.size());
+
+    auto isType = [type](const Instruction& instruction) { return instruction.type == type; };
+    return std::any_of(std::next(m_instructions.cbegin(), firstInstruction), std::next(m_instructions.cbegin(), lastInstruction), isType);
+}
+
+void PDFPrecompiledPage::detachSharedData()
+{
+    std::vector<bool> isPathUsed(m_paths.size(), false);
+    std::vector<bool> isClipUsed(m_clips.size(), false);
+    std::vector<bool> isImageUsed(m_images.size(), false);
+
+    auto detach = [](auto& data, std::vector<bool>& isUsed, Instruction& instruction)
+    {
+        if (isUsed[instruction.dataIndex])
+        {
+            // Data are implicitly shared, so copy is cheap until it is modified
+            auto copy = data[instruction.dataIndex];
+            instruction.dataIndex = static_cast<uint32_t>(data.size());
+            data.push_back(qMove(copy));
+        }
+        else
+        {
+            isUsed[instruction.dataIndex] = true;
+        }
+    };
+
+    for (Instruction& instruction : m_instructions)
+    {
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+                detach(m_paths, isPathUsed, instruction);
+                break;
+
+            case InstructionType::Clip:
+                detach(m_clips, isClipUsed, instruction);
+                break;
+
+            case InstructionType::DrawImage:
+                detach(m_images, isImageUsed, instruction);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+void PDFPrecompiledPage::optimize()
+{
+    sharePensAndBrushes();
+
+    m_instructions.shrink_to_fit();
+    m_paths.shrink_to_fit();
+    m_glyphs.shrink_to_fit();
+    m_clips.shrink_to_fit();
+    m_images.shrink_to_fit();
+    m_meshes.shrink_to_fit();
+    m_matrices.shrink_to_fit();
+    m_compositionModes.shrink_to_fit();
+}
+
+void PDFPrecompiledPage::sharePensAndBrushes()
+{
+    // Recently used pens and brushes are kept in most recently used order
+    auto share = [](auto& value, auto& recentValues)
+    {
+        auto it = std::find(recentValues.begin(), recentValues.end(), value);
+        if (it != recentValues.end())
+        {
+            value = *it;
+            std::rotate(recentValues.begin(), it, std::next(it));
+        }
+        else
+        {
+            if (recentValues.size() == SHARED_PEN_AND_BRUSH_LOOKUP_COUNT)
+            {
+                recentValues.pop_back();
+            }
+            recentValues.insert(recentValues.begin(), value);
+        }
+    };
+
+    std::vector<QPen> pens;
+    std::vector<QBrush> brushes;
+    for (PathPaintData& path : m_paths)
+    {
+        share(path.pen, pens);
+        share(path.brush, brushes);
+    }
+}
+
+size_t PDFPrecompiledPage::getDistinctPenAndBrushCount() const
+{
+    size_t count = 0;
+
+    auto add = [&count](const auto& value, auto& recentValues)
+    {
+        auto it = std::find(recentValues.begin(), recentValues.end(), value);
+        if (it != recentValues.end())
+        {
+            std::rotate(recentValues.begin(), it, std::next(it));
+        }
+        else
+        {
+            if (recentValues.size() == SHARED_PEN_AND_BRUSH_LOOKUP_COUNT)
+            {
+                recentValues.pop_back();
+            }
+            recentValues.insert(recentValues.begin(), value);
+            ++count;
+        }
+    };
+
+    std::vector<QPen> pens;
+    std::vector<QBrush> brushes;
+    for (const PathPaintData& path : m_paths)
+    {
+        add(path.pen, pens);
+        add(path.brush, brushes);
+    }
+
+    return count;
+}
+
+QByteArray PDFPrecompiledPage::serialize() const
+{
+    QByteArray result;
+
+    {
+        QDataStream stream(&result, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        serialize(stream);
+    }
+
+    return qCompress(result);
+}
+
+PDFPrecompiledPage PDFPrecompiledPage::deserialize(const QByteArray& data)
+{
+    PDFPrecompiledPage result;
+    QByteArray decompressed = qUncompress(data);
+
+    QDataStream stream(&decompressed, QIODevice::ReadOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    if (!result.deserialize(stream))
+    {
+        return PDFPrecompiledPage();
+    }
+
+    return result;
+}
+
+void PDFPrecompiledPage::serialize(QDataStream& stream) const
+{
+    // Images are often shared between instructions and snap info,
+    // so each image is stored only once in the image table.
+    std::vector<QImage> imageTable;
+    std::map<qint64, quint32> imageIndices;
+    auto getImageIndex = [&imageTable, &imageIndices](const QImage& image)
+    {
+        auto it = imageIndices.find(image.cacheKey());
+        if (it == imageIndices.cend())
+        {
+            it = imageIndices.emplace(image.cacheKey(), static_cast<quint32>(imageTable.size())).first;
+            imageTable.push_back(image);
+        }
+        return it->second;
+    };
+
+    std::vector<quint32> instructionImageIndices;
+    instructionImageIndices.reserve(m_images.size());
+    for (const ImageData& data : m_images)
+    {
+        instructionImageIndices.push_back(getImageIndex(data.image));
+    }
+
+    std::vector<quint32> snapImageIndices;
+    snapImageIndices.reserve(m_snapInfo.m_snapImages.size());
+    for (const PDFSnapInfo::SnapImage& snapImage : m_snapInfo.m_snapImages)
+    {
+        snapImageIndices.push_back(getImageIndex(snapImage.image));
+    }
+
+    stream << SERIALIZATION_MAGIC;
+    stream << SERIALIZATION_VERSION;
+    stream << m_compilingTimeNS;
+    stream << m_paperColor;
+
+    // Image table - raw image data are stored, they are compressed together
+    // with the rest of the data.
+    stream << quint32(imageTable.size());
+    for (const QImage& image : imageTable)
+    {
+        stream << qint32(image.width());
+        stream << qint32(image.height());
+        stream << qint32(image.format());
+        stream << QByteArray::fromRawData(reinterpret_cast<const char*>(image.constBits()), image.sizeInBytes());
+    }
+
+    stream << quint32(m_instructions.size());
+    for (const Instruction& instruction : m_instructions)
+    {
+        stream << quint8(instruction.type);
+        stream << quint32(instruction.dataIndex);
+    }
+
+    stream << quint32(m_glyphs.size());
+    for (const QPainterPath& glyph : m_glyphs)
+    {
+        stream << glyph;
+    }
+
+    stream << quint32(m_paths.size());
+    for (const PathPaintData& data : m_paths)
+    {
+        stream << data.pen;
+        stream << data.brush;
+        stream << data.path;
+        stream << data.isText;
+        stream << qint32(data.glyphIndex);
+        stream << data.glyphMatrix;
+    }
+
+    stream << quint32(m_clips.size());
+    for (const ClipData& data : m_clips)
+    {
+        stream << data.clipPath;
+    }
+
+    stream << quint32(instructionImageIndices.size());
+    for (quint32 imageIndex : instructionImageIndices)
+    {
+        stream << imageIndex;
+    }
+
+    stream << quint32(m_meshes.size());
+    for (const MeshPaintData& data : m_meshes)
+    {
+        const PDFMesh& mesh = data.mesh;
+
+        stream << data.alpha;
+        stream << quint32(mesh.m_vertices.size());
+        for (const QPointF& vertex : mesh.m_vertices)
+        {
+            stream << vertex;
+        }
+        stream << quint32(mesh.m_triangles.size());
+        for (const PDFMesh::Triangle& triangle : mesh.m_triangles)
+        {
+            stream << triangle.v1 << triangle.v2 << triangle.v3 << triangle.color;
+        }
+        stream << mesh.m_boundingPath;
+        stream << mesh.m_backgroundPath;
+        stream << mesh.m_backgroundColor;
+    }
+
+    stream << quint32(m_matrices.size());
+    for (const QTransform& matrix : m_matrices)
+    {
+        stream << matrix;
+    }
+
+    stream << quint32(m_compositionModes.size());
+    for (QPainter::CompositionMode compositionMode : m_compositionModes)
+    {
+        stream << qint32(compositionMode);
+    }
+
+    stream << quint32(m_errors.size());
+    for (const PDFRenderError& error : m_errors)
+    {
+        stream << qint32(error.type);
+        stream << error.message;
+    }
+
+    stream << quint32(m_snapInfo.getSnapPoints().size());
+    for (const PDFSnapInfo::SnapPoint& snapPoint : m_snapInfo.getSnapPoints())
+    {
+        stream << qint32(snapPoint.type);
+        stream << snapPoint.point;
+    }
+
+    stream << quint32(m_snapInfo.getLines().size());
+    for (const QLineF& line : m_snapInfo.getLines())
+    {
+        stream << line;
+    }
+
+    stream << quint32(m_snapInfo.m_snapImages.size());
+    for (size_t i = 0; i < m_snapInfo.m_snapImages.size(); ++i)
+    {
+        stream << m_snapInfo.m_snapImages[i].imagePath;
+        stream << snapImageIndices[i];
+    }
+}
+
+bool PDFPrecompiledPage::deserialize(QDataStream& stream)
+{
+    auto isValid = [&stream]()
+    {
+        return stream.status() == QDataStream::Ok;
+    };
+
+    // Reads item count. Each item occupies at least one byte, so count
+    // can't be greater than remaining data size (protects from huge
+    // allocations in case of corrupted data).
+    auto readCount = [&stream, &isValid]() -> std::optional<quint32>
+    {
+        quint32 count = 0;
+        stream >> count;
+
+        if (!isValid() || count > stream.device()->bytesAvailable())
+        {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            return std::nullopt;
+        }
+
+        return count;
+    };
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic;
+    stream >> version;
+
+    if (!isValid() || magic != SERIALIZATION_MAGIC || version != SERIALIZATION_VERSION)
+    {
+        return false;
+    }
+
+    qint64 compilingTimeNS = 0;
+    stream >> compilingTimeNS;
+    stream >> m_paperColor;
+
+    std::vector<QImage> imageTable;
+    std::optional<quint32> count = readCount();
+    if (!count)
+    {
+        return false;
+    }
+    imageTable.reserve(*count);
+    for (quint32 i = 0; i < *count; ++i)
+    {
+        qint32 width = 0;
+        qint32 height = 0;
+        qint32 format = 0;
+        QByteArray imageData;
+        stream >> width >> height >> format >> imageData;
+
+        if (!isValid() || format <= QImage::Format_Invalid || format >= QImage::NImageFormats)
+        {
+            return false;
+        }
+
+        QImage image(width, height, static_cast<QImage::Format>(format));
+        if (image.sizeInBytes() != imageData.size())
+        {
+            return false;
+        }
+
+        if (!imageData.isEmpty())
+        {
+            std::copy(imageData.cbegin(), imageData.cend(), reinterpret_cast<char*>(image.bits()));
+        }
+
+        imageTable.push_back(qMove(image));
+    }
+
+    auto getImage = [&imageTable](quint32 index, QImage& image)
+    {
+        if (index >= imageTable.size())
+        {
+            return false;
+        }
+
+        image = imageTable[index];
+        return true;
+    };
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_instructions.reserve(*count);
+    for (quint32 i = 0; i < *count; ++i)
+    {
+        quint8 type = 0;
+        quint32 dataIndex = 0;
+        stream >> type >> dataIndex;
+        m_instructions.emplace_back(static_cast<InstructionType>(type), dataIndex);
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_glyphs.resize(*count);
+    for (QPainterPath& glyph : m_glyphs)
+    {
+        stream >> glyph;
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_paths.resize(*count);
+    for (PathPaintData& data : m_paths)
+    {
+        qint32 glyphIndex = -1;
+        stream >> data.pen >> data.brush >> data.path >> data.isText >> glyphIndex >> data.glyphMatrix;
+
+        if (glyphIndex < -1 || glyphIndex >= qint32(m_glyphs.size()))
+        {
+            return false;
+        }
+        data.glyphIndex = glyphIndex;
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_clips.resize(*count);
+    for (ClipData& data : m_clips)
+    {
+        stream >> data.clipPath;
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_images.resize(*count);
+    for (ImageData& data : m_images)
+    {
+        quint32 imageIndex = 0;
+        stream >> imageIndex;
+
+        if (!getImage(imageIndex, data.image))
+        {
+            return false;
+        }
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_meshes.resize(*count);
+    for (MeshPaintData& data : m_meshes)
+    {
+        PDFMesh& mesh = data.mesh;
+        stream >> data.alpha;
+
+        std::optional<quint32> vertexCount = readCount();
+        if (!vertexCount)
+        {
+            return false;
+        }
+        mesh.m_vertices.resize(*vertexCount);
+        for (QPointF& vertex : mesh.m_vertices)
+        {
+            stream >> vertex;
+        }
+
+        std::optional<quint32> triangleCount = readCount();
+        if (!triangleCount)
+        {
+            return false;
+        }
+        mesh.m_triangles.resize(*triangleCount);
+        for (PDFMesh::Triangle& triangle : mesh.m_triangles)
+        {
+            stream >> triangle.v1 >> triangle.v2 >> triangle.v3 >> triangle.color;
+
+            if (triangle.v1 >= mesh.m_vertices.size() || triangle.v2 >= mesh.m_vertices.size() || triangle.v3 >= mesh.m_vertices.size())
+            {
+                return false;
+            }
+        }
+
+        stream >> mesh.m_boundingPath;
+        stream >> mesh.m_backgroundPath;
+        stream >> mesh.m_backgroundColor;
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_matrices.resize(*count);
+    for (QTransform& matrix : m_matrices)
+    {
+        stream >> matrix;
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_compositionModes.reserve(*count);
+    for (quint32 i = 0; i < *count; ++i)
+    {
+        qint32 compositionMode = 0;
+        stream >> compositionMode;
+        m_compositionModes.push_back(static_cast<QPainter::CompositionMode>(compositionMode));
+    }
+
+    QList<PDFRenderError> errors;
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    for (quint32 i = 0; i < *count; ++i)
+    {
+        qint32 type = 0;
+        QString message;
+        stream >> type >> message;
+        errors.push_back(PDFRenderError(static_cast<RenderErrorType>(type), qMove(message)));
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_snapInfo.m_snapPoints.reserve(*count);
+    for (quint32 i = 0; i < *count; ++i)
+    {
+        qint32 type = 0;
+        QPointF point;
+        stream >> type >> point;
+        m_snapInfo.m_snapPoints.emplace_back(static_cast<SnapType>(type), point);
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_snapInfo.m_snapLines.resize(*count);
+    for (QLineF& line : m_snapInfo.m_snapLines)
+    {
+        stream >> line;
+    }
+
+    if (!(count = readCount()))
+    {
+        return false;
+    }
+    m_snapInfo.m_snapImages.resize(*count);
+    for (PDFSnapInfo::SnapImage& snapImage : m_snapInfo.m_snapImages)
+    {
+        quint32 imageIndex = 0;
+        stream >> snapImage.imagePath >> imageIndex;
+
+        if (!getImage(imageIndex, snapImage.image))
+        {
+            return false;
+        }
+    }
+
+    if (!isValid())
+    {
+        return false;
+    }
+
+    // Validate instructions, so corrupted data can't cause out of bounds access
+    for (const Instruction& instruction : m_instructions)
+    {
+        size_t dataSize = 0;
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+                dataSize = m_paths.size();
+                break;
+
+            case InstructionType::DrawImage:
+                dataSize = m_images.size();
+                break;
+
+            case InstructionType::DrawMesh:
+                dataSize = m_meshes.size();
+                break;
+
+            case InstructionType::Clip:
+                dataSize = m_clips.size();
+                break;
+
+            case InstructionType::SaveGraphicState:
+            case InstructionType::RestoreGraphicState:
+                dataSize = std::numeric_limits<size_t>::max();
+                break;
+
+            case InstructionType::SetWorldMatrix:
+                dataSize = m_matrices.size();
+                break;
+
+            case InstructionType::SetCompositionMode:
+                dataSize = m_compositionModes.size();
+                break;
+
+            default:
+                return false;
+        }
+
+        if (instruction.dataIndex >= dataSize)
+        {
+            return false;
+        }
+    }
+
+    optimize();
+    finalize(compilingTimeNS, qMove(errors));
+    return true;
+}
+
+void PDFPrecompiledPage::convertColors(const PDFColorConvertor& colorConvertor)
+{
+    // Jakub Melka: we must apply color convertor in following areas:
+    //     - painter paths
+    //     - images
+    //     - meshes
+
+    if (!colorConvertor.isActive())
+    {
+        return;
+    }
+
+    for (PathPaintData& pathData : m_paths)
+    {
+        if (pathData.pen.style() != Qt::NoPen)
+        {
+            pathData.pen.setColor(colorConvertor.convert(pathData.pen.color(), false, pathData.isText));
+        }
+        if (pathData.brush.style() == Qt::SolidPattern)
+        {
+            pathData.brush.setColor(colorConvertor.convert(pathData.brush.color(), false, pathData.isText));
+        }
+        else if (pathData.brush.style() == Qt::TexturePattern)
+        {
+            const QTransform brushMatrix = pathData.brush.transform();
+            pathData.brush.setTextureImage(colorConvertor.convert(pathData.brush.textureImage()));
+            pathData.brush.setTransform(brushMatrix);
+        }
+    }
+
+    for (ImageData& imageData : m_images)
     {
         imageData.image = colorConvertor.convert(imageData.image);
     }
@@ -809,16 +2274,23 @@ void PDFPrecompiledPage::finalize(qint64 compilingTimeNS, QList<PDFRenderError>
     m_compilingTimeNS = compilingTimeNS;
     m_errors = qMove(errors);
 
+    buildSpatialIndex();
+    m_snapInfo.buildIndex();
+
     // Determine memory consumption
     m_memoryConsumptionEstimate = sizeof(*this);
     m_memoryConsumptionEstimate += sizeof(Instruction) * m_instructions.capacity();
     m_memoryConsumptionEstimate += sizeof(PathPaintData) * m_paths.capacity();
+    m_memoryConsumptionEstimate += sizeof(QPainterPath) * m_glyphs.capacity();
     m_memoryConsumptionEstimate += sizeof(ClipData) * m_clips.capacity();
     m_memoryConsumptionEstimate += sizeof(ImageData) * m_images.capacity();
     m_memoryConsumptionEstimate += sizeof(MeshPaintData) * m_meshes.capacity();
     m_memoryConsumptionEstimate += sizeof(QTransform) * m_matrices.capacity();
     m_memoryConsumptionEstimate += sizeof(QPainter::CompositionMode) * m_compositionModes.capacity();
     m_memoryConsumptionEstimate += sizeof(PDFRenderError) * m_errors.size();
+    m_memoryConsumptionEstimate += sizeof(uint32_t) * (m_spatialIndex.cellOffsets.capacity() + m_spatialIndex.cellItems.capacity() + m_spatialIndex.alwaysVisible.capacity());
+    m_memoryConsumptionEstimate += m_snapInfo.getMemoryConsumptionEstimate() - sizeof(m_snapInfo);
+    m_memoryConsumptionEstimate += PEN_AND_BRUSH_MEMORY_ESTIMATE * getDistinctPenAndBrushCount();
 
     auto calculateQPathMemoryConsumption = [](const QPainterPath& path)
     {
@@ -828,6 +2300,10 @@ void PDFPrecompiledPage::finalize(qint64 compilingTimeNS, QList<PDFRenderError>
     {
         m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.path);
     }
+    for (const QPainterPath& glyph : m_glyphs)
+    {
+        m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(glyph);
+    }
     for (const ClipData& data : m_clips)
     {
         m_memoryConsumptionEstimate += calculateQPathMemoryConsumption(data.clipPath);
@@ -842,6 +2318,230 @@ void PDFPrecompiledPage::finalize(qint64 compilingTimeNS, QList<PDFRenderError>
     }
 }
 
+void PDFPrecompiledPage::buildSpatialIndex()
+{
+    m_spatialIndex = SpatialIndex();
+
+    const size_t drawInstructionCount = m_paths.size() + m_images.size() + m_meshes.size();
+    if (drawInstructionCount < SPATIAL_INDEX_MIN_DRAW_INSTRUCTIONS || m_instructions.size() > std::numeric_limits<uint32_t>::max())
+    {
+        return;
+    }
+
+    // Calculate bounding boxes of draw instructions in page coordinates. Invalid
+    // bounding box means, that instruction bounds are unknown.
+    std::vector<std::pair<uint32_t, QRectF>> boundingBoxes;
+    boundingBoxes.reserve(drawInstructionCount);
+
+    std::stack<QTransform> worldMatrixStack;
+    worldMatrixStack.push(QTransform());
+
+    // Maps rectangle to page coordinates. Degenerate rectangles (for example,
+    // bounding box of horizontal line) are enlarged, so they remain valid.
+    auto getPageBoundingBox = [&worldMatrixStack](const QRectF& rect)
+    {
+        constexpr PDFReal epsilon = 0.001;
+        QRectF boundingBox = worldMatrixStack.top().mapRect(rect);
+        boundingBox.adjust(-epsilon, -epsilon, epsilon, epsilon);
+        return boundingBox;
+    };
+
+    for (size_t i = 0; i < m_instructions.size(); ++i)
+    {
+        const Instruction& instruction = m_instructions[i];
+        const uint32_t instructionIndex = static_cast<uint32_t>(i);
+
+        switch (instruction.type)
+        {
+            case InstructionType::DrawPath:
+            {
+                const PathPaintData& data = m_paths[instruction.dataIndex];
+                bool isBoundingBoxKnown = !data.path.isEmpty();
+                PDFReal margin = 0.0;
+
+                if (data.pen.style() != Qt::NoPen)
+                {
+                    if (data.pen.isCosmetic())
+                    {
+                        // Width of cosmetic pen is in device pixels, thin pens
+                        // are covered by the margin of visible area.
+                        isBoundingBoxKnown = isBoundingBoxKnown && data.pen.widthF() <= 1.0;
+                    }
+                    else
+                    {
+                        // Miter joins and square caps can exceed the half of the pen width
+                        margin = data.pen.widthF() * 0.5 * qMax(data.pen.miterLimit(), M_SQRT2);
+                    }
+                }
+
+                QRectF boundingBox;
+                if (isBoundingBoxKnown)
+                {
+                    boundingBox = getPageBoundingBox(data.path.controlPointRect().adjusted(-margin, -margin, margin, margin));
+                }
+                boundingBoxes.emplace_back(instructionIndex, boundingBox);
+                break;
+            }
+
+            case InstructionType::DrawImage:
+            {
+                // Image is drawn into unit square of the current coordinate system
+                boundingBoxes.emplace_back(instructionIndex, getPageBoundingBox(QRectF(0.0, 0.0, 1.0, 1.0)));
+                break;
+            }
+
+            case InstructionType::DrawMesh:
+            {
+                // Mesh is drawn in page coordinates, clipped by its bounding path
+                const MeshPaintData& data = m_meshes[instruction.dataIndex];
+                boundingBoxes.emplace_back(instructionIndex, data.mesh.getBoundingPath().isEmpty() ? QRectF() : data.mesh.getBoundingPath().controlPointRect());
+                break;
+            }
+
+            case InstructionType::SaveGraphicState:
+                worldMatrixStack.push(worldMatrixStack.top());
+                break;
+
+            case InstructionType::RestoreGraphicState:
+                if (worldMatrixStack.size() > 1)
+                {
+                    worldMatrixStack.pop();
+                }
+                break;
+
+            case InstructionType::SetWorldMatrix:
+                worldMatrixStack.top() = m_matrices[instruction.dataIndex];
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    QRectF bounds;
+    for (const auto& item : boundingBoxes)
+    {
+        if (item.second.isValid())
+        {
+            bounds = bounds.united(item.second);
+        }
+    }
+
+    if (!bounds.isValid())
+    {
+        return;
+    }
+
+    const int gridSize = qBound(1, static_cast<int>(std::sqrt(PDFReal(drawInstructionCount) / 4.0)), 256);
+    const PDFReal cellWidth = bounds.width() / gridSize;
+    const PDFReal cellHeight = bounds.height() / gridSize;
+    const int maximalCellCount = qMax(gridSize * gridSize / 4, 1);
+
+    auto getCellRange = [&](const QRectF& rect, int& left, int& top, int& right, int& bottom)
+    {
+        left = qBound(0, static_cast<int>((rect.left() - bounds.left()) / cellWidth), gridSize - 1);
+        right = qBound(0, static_cast<int>((rect.right() - bounds.left()) / cellWidth), gridSize - 1);
+        top = qBound(0, static_cast<int>((rect.top() - bounds.top()) / cellHeight), gridSize - 1);
+        bottom = qBound(0, static_cast<int>((rect.bottom() - bounds.top()) / cellHeight), gridSize - 1);
+    };
+
+    SpatialIndex index;
+    index.bounds = bounds;
+    index.columns = gridSize;
+    index.rows = gridSize;
+
+    // First pass - classify instructions and count cell items
+    std::vector<uint32_t> cellCounts(gridSize * gridSize, 0);
+    std::vector<std::pair<uint32_t, QRectF>> indexedItems;
+    indexedItems.reserve(boundingBoxes.size());
+
+    for (const auto& item : boundingBoxes)
+    {
+        int left = 0, top = 0, right = 0, bottom = 0;
+        if (item.second.isValid())
+        {
+            getCellRange(item.second, left, top, right, bottom);
+        }
+
+        if (!item.second.isValid() || (right - left + 1) * (bottom - top + 1) > maximalCellCount)
+        {
+            index.alwaysVisible.push_back(item.first);
+            continue;
+        }
+
+        for (int row = top; row <= bottom; ++row)
+        {
+            for (int column = left; column <= right; ++column)
+            {
+                ++cellCounts[row * gridSize + column];
+            }
+        }
+        indexedItems.push_back(item);
+    }
+
+    index.cellOffsets.resize(cellCounts.size() + 1, 0);
+    for (size_t i = 0; i < cellCounts.size(); ++i)
+    {
+        index.cellOffsets[i + 1] = index.cellOffsets[i] + cellCounts[i];
+    }
+
+    // Second pass - fill the cells
+    index.cellItems.resize(index.cellOffsets.back());
+    std::vector<uint32_t> cellPositions(index.cellOffsets.cbegin(), std::prev(index.cellOffsets.cend()));
+    for (const auto& item : indexedItems)
+    {
+        int left = 0, top = 0, right = 0, bottom = 0;
+        getCellRange(item.second, left, top, right, bottom);
+
+        for (int row = top; row <= bottom; ++row)
+        {
+            for (int column = left; column <= right; ++column)
+            {
+                index.cellItems[cellPositions[row * gridSize + column]++] = item.first;
+            }
+        }
+    }
+
+    m_spatialIndex = qMove(index);
+}
+
+std::vector<bool> PDFPrecompiledPage::SpatialIndex::query(const QRectF& rect, size_t instructionCount) const
+{
+    std::vector<bool> result(instructionCount, false);
+
+    for (uint32_t instructionIndex : alwaysVisible)
+    {
+        result[instructionIndex] = true;
+    }
+
+    const QRectF queryRect = rect.intersected(bounds);
+    if (queryRect.isEmpty())
+    {
+        return result;
+    }
+
+    const PDFReal cellWidth = bounds.width() / columns;
+    const PDFReal cellHeight = bounds.height() / rows;
+    const int left = qBound(0, static_cast<int>((queryRect.left() - bounds.left()) / cellWidth), columns - 1);
+    const int right = qBound(0, static_cast<int>((queryRect.right() - bounds.left()) / cellWidth), columns - 1);
+    const int top = qBound(0, static_cast<int>((queryRect.top() - bounds.top()) / cellHeight), rows - 1);
+    const int bottom = qBound(0, static_cast<int>((queryRect.bottom() - bounds.top()) / cellHeight), rows - 1);
+
+    for (int row = top; row <= bottom; ++row)
+    {
+        for (int column = left; column <= right; ++column)
+        {
+            const size_t cell = row * columns + column;
+            for (uint32_t i = cellOffsets[cell]; i < cellOffsets[cell + 1]; ++i)
+            {
+                result[cellItems[i]] = true;
+            }
+        }
+    }
+
+    return result;
+}
+
 PDFPrecompiledPage::GraphicPieceInfos PDFPrecompiledPage::calculateGraphicPieceInfos(QRectF mediaBox,
                                                                                      PDFReal epsilon) const
 {
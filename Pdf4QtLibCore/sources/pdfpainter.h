@@ -25,11 +25,15 @@
 #include "pdftextlayout.h"
 #include "pdfcolorconvertor.h"
 #include "pdfsnapper.h"
+#include "pdfcachemanager.h"
 
 #include <QPen>
 #include <QBrush>
 #include <QElapsedTimer>
 
+#include <map>
+#include <limits>
+
 namespace pdf
 {
 
@@ -76,9 +80,39 @@ protected:
     /// Returns, if feature is turned on
     bool hasFeature(PDFRenderer::Feature feature) const { return m_features.testFlag(feature); }
 
+    /// Returns features of the painter
+    PDFRenderer::Features getFeatures() const { return m_features; }
+
     /// Is transparency group active?
     bool isTransparencyGroupActive() const { return !m_transparencyGroupDataStack.empty(); }
 
+    /// Returns true, if overprint of the painted path must be simulated (feature
+    /// OverprintSimulation is turned on and all painted parts of the path are
+    /// overprinted). Overprinted inks are then combined with inks already painted,
+    /// which is approximated by multiply composition in the device RGB space.
+    /// \param stroke Path is stroked
+    /// \param fill Path is filled
+    bool isOverprintSimulated(bool stroke, bool fill) const;
+
+    /// Creates brush, which fills the path by repeated image of the tiling pattern
+    /// cell. Cell images are cached, so each pattern cell is painted only once for
+    /// given resolution. Returns false, if pattern can't be painted exactly using
+    /// the cell image, so pattern cells must be painted as vector graphics.
+    /// \param tilingPattern Tiling pattern
+    /// \param path Path to be filled (in pattern space)
+    /// \param tilingOrigin Origin of the first pattern cell (in pattern space)
+    /// \param devicePixelsPerUnit Count of device pixels per unit of the device space
+    /// \param uncoloredPatternColorSpace Color space for uncolored color patterns
+    /// \param uncoloredPatternColor Uncolored color pattern color
+    /// \param[out] brush Brush, which fills the path in pattern space
+    bool createTilingPatternBrush(const PDFTilingPattern* tilingPattern,
+                                  const QPainterPath& path,
+                                  const QPointF& tilingOrigin,
+                                  PDFReal devicePixelsPerUnit,
+                                  PDFColorSpacePointer uncoloredPatternColorSpace,
+                                  PDFColor uncoloredPatternColor,
+                                  QBrush& brush);
+
 private:
     /// Returns current pen (implementation)
     QPen getCurrentPenImpl() const;
@@ -94,10 +128,36 @@ private:
         BlendMode blendMode = BlendMode::Normal;
     };
 
+    struct TilingPatternCellKey
+    {
+        QByteArray content;
+        PDFObjectReference resourcesReference;
+        const PDFDictionary* resourcesDictionary = nullptr;
+        PDFReal left = 0.0;
+        PDFReal top = 0.0;
+        PDFReal right = 0.0;
+        PDFReal bottom = 0.0;
+        PDFReal xStep = 0.0;
+        PDFReal yStep = 0.0;
+        int width = 0;
+        int height = 0;
+        QRgb uncoloredColor = 0;
+        RenderingIntent renderingIntent = RenderingIntent::Auto;
+
+        bool operator<(const TilingPatternCellKey& other) const
+        {
+            return std::tie(resourcesReference, resourcesDictionary, left, top, right, bottom, xStep, yStep, width, height, uncoloredColor, renderingIntent, content) <
+                   std::tie(other.resourcesReference, other.resourcesDictionary, other.left, other.top, other.right, other.bottom, other.xStep, other.yStep, other.width, other.height, other.uncoloredColor, other.renderingIntent, other.content);
+        }
+    };
+
     PDFRenderer::Features m_features;
     PDFCachedItem<QPen> m_currentPen;
     PDFCachedItem<QBrush> m_currentBrush;
     std::vector<PDFTransparencyGroupPainterData> m_transparencyGroupDataStack;
+
+    /// Images of the tiling pattern cells
+    std::map<TilingPatternCellKey, QImage> m_tilingPatternCellImages;
 };
 
 /// Processor, which processes PDF's page commands on the QPainter. It works with QPainter
@@ -139,6 +199,11 @@ protected:
     virtual void performRestoreGraphicState(ProcessOrder order) override;
     virtual void setWorldMatrix(const QTransform& matrix) override;
     virtual void setCompositionMode(QPainter::CompositionMode mode) override;
+    virtual bool performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QPainterPath& path,
+                                              const QPointF& tilingOrigin,
+                                              PDFColorSpacePointer uncoloredPatternColorSpace,
+                                              PDFColor uncoloredPatternColor) override;
 
 private:
     QPainter* m_painter;
@@ -157,7 +222,7 @@ public:
     inline PDFPrecompiledPage& operator=(const PDFPrecompiledPage&) = default;
     inline PDFPrecompiledPage& operator=(PDFPrecompiledPage&&) = default;
 
-    enum class InstructionType
+    enum class InstructionType : uint8_t
     {
         Invalid,
         DrawPath,
@@ -175,13 +240,13 @@ public:
         inline Instruction() = default;
         inline Instruction(InstructionType type, size_t dataIndex) :
             type(type),
-            dataIndex(dataIndex)
+            dataIndex(static_cast<uint32_t>(dataIndex))
         {
-
+            Q_ASSERT(dataIndex <= std::numeric_limits<uint32_t>::max());
         }
 
         InstructionType type = InstructionType::Invalid;
-        size_t dataIndex = 0;
+        uint32_t dataIndex = 0;
     };
 
     /// Paints page onto the painter using matrix
@@ -203,6 +268,25 @@ public:
     void redact(QPainterPath redactPath, const QTransform& matrix, QColor color);
 
     void addPath(QPen pen, QBrush brush, QPainterPath path, bool isText);
+
+    /// Adds text path of the glyph. Glyph outline is stored in the page only once
+    /// (see \p addGlyph), so small axis-aligned glyphs can be drawn using
+    /// rasterized glyph images instead of filling the path.
+    /// \param pen Pen
+    /// \param brush Brush
+    /// \param path Glyph outline mapped to the user space by \p glyphMatrix
+    /// \param glyphIndex Index of the glyph outline
+    /// \param glyphMatrix Matrix mapping glyph outline to the user space
+    void addGlyphPath(QPen pen, QBrush brush, QPainterPath path, int glyphIndex, const QTransform& glyphMatrix);
+
+    /// Adds glyph outline (in glyph space) and returns its index
+    /// \param glyph Glyph outline
+    int addGlyph(QPainterPath glyph);
+
+    /// Returns glyph outline
+    /// \param glyphIndex Index of the glyph outline
+    const QPainterPath& getGlyph(int glyphIndex) const { return m_glyphs.at(glyphIndex); }
+
     void addClip(QPainterPath path);
     void addImage(QImage image);
     void addMesh(PDFMesh mesh, PDFReal alpha);
@@ -211,9 +295,58 @@ public:
     void addSetWorldMatrix(const QTransform& matrix);
     void addSetCompositionMode(QPainter::CompositionMode compositionMode);
 
-    /// Optimizes page memory allocation to contain less space
+    /// Appends copy of instructions in range [firstInstruction, lastInstruction)
+    /// to the end of instruction list. Data of copied instructions (paths, clips,
+    /// images) are shared with the original instructions, world matrices are
+    /// transformed by \p matrix. It is used to paint instances of repeated
+    /// graphics (form XObjects), which differ only by transformation.
+    /// \param firstInstruction First instruction of the range
+    /// \param lastInstruction End of the range (one past last instruction)
+    /// \param matrix Matrix applied to the world matrices of the range
+    void addInstructions(size_t firstInstruction, size_t lastInstruction, const QTransform& matrix);
+
+    /// Appends copy of instructions in range [firstInstruction, lastInstruction)
+    /// of another precompiled page to the end of instruction list. Data of copied
+    /// instructions are copied too (they are implicitly shared), world matrices are
+    /// transformed by \p matrix. Glyph outlines are added to this page only once,
+    /// \p glyphIndices maps glyph indices of \p page to the glyph indices of this page
+    /// and it should be kept between calls with the same \p page.
+    /// \param page Precompiled page, from which instructions are copied
+    /// \param firstInstruction First instruction of the range
+    /// \param lastInstruction End of the range (one past last instruction)
+    /// \param matrix Matrix applied to the world matrices of the range
+    /// \param glyphIndices Map of glyph indices (-1 means glyph was not added yet)
+    void addInstructions(const PDFPrecompiledPage& page,
+                         size_t firstInstruction,
+                         size_t lastInstruction,
+                         const QTransform& matrix,
+                         std::vector<int>& glyphIndices);
+
+    /// Returns instruction count
+    size_t getInstructionCount() const { return m_instructions.size(); }
+
+    /// Returns true, if instruction range [firstInstruction, lastInstruction)
+    /// contains instruction of given type.
+    /// \param firstInstruction First instruction of the range
+    /// \param lastInstruction End of the range (one past last instruction)
+    /// \param type Instruction type
+    bool hasInstruction(size_t firstInstruction, size_t lastInstruction, InstructionType type) const;
+
+    /// Optimizes page memory allocation to contain less space. Equal pens
+    /// and brushes of the paths are shared (they are implicitly shared).
     void optimize();
 
+    /// Serializes precompiled page (instructions, paths, images, meshes,
+    /// snap info and errors) into compact binary format, so it can be stored
+    /// and restored later without compiling the page again.
+    QByteArray serialize() const;
+
+    /// Deserializes precompiled page from data created by \p serialize.
+    /// If data are corrupted, or they were created by incompatible version,
+    /// then invalid page is returned.
+    /// \param data Serialized page data
+    static PDFPrecompiledPage deserialize(const QByteArray& data);
+
     /// Converts all colors
     void convertColors(const PDFColorConvertor& colorConvertor);
 
@@ -234,6 +367,12 @@ public:
     /// Returns memory consumption estimate
     qint64 getMemoryConsumptionEstimate() const { return m_memoryConsumptionEstimate; }
 
+    /// Returns true, if page contains image previews instead of full quality
+    /// images (see PDFPageContentProcessor::setImagePreviewsEnabled), so page
+    /// should be compiled again to display full quality images.
+    bool hasPreviewImages() const { return m_previewImageCount > 0; }
+    void setPreviewImageCount(size_t previewImageCount) { m_previewImageCount = previewImageCount; }
+
     /// Returns paper color
     QColor getPaperColor() const { return m_paperColor; }
     void setPaperColor(QColor paperColor) { m_paperColor = paperColor; }
@@ -242,7 +381,10 @@ public:
     const PDFSnapInfo* getSnapInfo() const { return &m_snapInfo; }
 
     /// Mark this precompiled page as accessed at a current time
-    void markAccessed() { m_expirationTimer.start(); }
+    void markAccessed() { m_expirationTimer.start(); m_accessStamp = PDFCacheManager::getAccessStamp(); }
+
+    /// Returns access stamp of the last access (see PDFCacheManager::getAccessStamp)
+    quint64 getAccessStamp() const { return m_accessStamp; }
 
     /// Has page content expired with given timeout? This function
     /// is used together with function \p markAccessed to control
@@ -291,6 +433,8 @@ public:
                                                  PDFReal epsilon) const;
 
 private:
+    friend class PDFBLPageRenderer;
+
     struct PathPaintData
     {
         inline PathPaintData() = default;
@@ -307,6 +451,8 @@ private:
         QBrush brush;
         QPainterPath path;
         bool isText = false;
+        int glyphIndex = -1;        ///< Index of the glyph outline, or -1, if path is not a glyph
+        QTransform glyphMatrix;     ///< Matrix mapping glyph outline to the user space
     };
 
     struct ClipData
@@ -347,11 +493,70 @@ private:
         PDFReal alpha = 1.0;
     };
 
+    /// Spatial index of draw instructions (paths, images and meshes). Page area
+    /// is divided into uniform grid of cells, each cell contains indices of draw
+    /// instructions, whose bounding box (in page coordinates) intersects the cell.
+    /// Draw instructions, whose bounding box is unknown, or which covers large
+    /// part of the grid, are always drawn.
+    struct SpatialIndex
+    {
+        bool isValid() const { return !cellOffsets.empty(); }
+
+        /// Returns flags of draw instructions, which can be visible in the given
+        /// rectangle (in page coordinates). Flags of other instructions are false.
+        /// \param rect Rectangle in page coordinates
+        /// \param instructionCount Instruction count
+        std::vector<bool> query(const QRectF& rect, size_t instructionCount) const;
+
+        QRectF bounds;
+        int columns = 0;
+        int rows = 0;
+        std::vector<uint32_t> cellOffsets;  ///< Offsets into cellItems, one per cell plus end offset
+        std::vector<uint32_t> cellItems;    ///< Instruction indices of the cells
+        std::vector<uint32_t> alwaysVisible;
+    };
+
+    /// Builds spatial index of draw instructions, if page contains
+    /// large number of draw instructions.
+    void buildSpatialIndex();
+
+    /// Shares data of equal pens and brushes of the paths, so each distinct
+    /// pen and brush is stored only once (most paths use one of few pens
+    /// and brushes, for example, glyphs of the text).
+    void sharePensAndBrushes();
+
+    /// Returns count of distinct pens and brushes of the paths. Equal pens and
+    /// brushes are expected to be shared (see \p sharePensAndBrushes).
+    size_t getDistinctPenAndBrushCount() const;
+
+    /// Creates copies of data shared by more instructions (see \p addInstructions),
+    /// so each instruction has its own data, which can be modified.
+    void detachSharedData();
+
+    /// Identifier and version of the serialized data format
+    static constexpr quint32 SERIALIZATION_MAGIC = 0x50444C31; // "PDL1"
+    static constexpr quint32 SERIALIZATION_VERSION = 2;
+
+    void serialize(QDataStream& stream) const;
+    bool deserialize(QDataStream& stream);
+
+    /// Count of recently used distinct pens (and brushes), in which
+    /// equal pen (or brush) is searched, when pens and brushes are shared
+    static constexpr size_t SHARED_PEN_AND_BRUSH_LOOKUP_COUNT = 16;
+
+    /// Estimate of memory consumed by the data of one distinct pen or brush
+    static constexpr qint64 PEN_AND_BRUSH_MEMORY_ESTIMATE = 64;
+
+    /// Minimal count of draw instructions, for which spatial index is built
+    static constexpr size_t SPATIAL_INDEX_MIN_DRAW_INSTRUCTIONS = 256;
+
     qint64 m_compilingTimeNS = 0;
     qint64 m_memoryConsumptionEstimate = 0;
+    size_t m_previewImageCount = 0;
     QColor m_paperColor = QColor(Qt::white);
     std::vector<Instruction> m_instructions;
     std::vector<PathPaintData> m_paths;
+    std::vector<QPainterPath> m_glyphs;
     std::vector<ClipData> m_clips;
     std::vector<ImageData> m_images;
     std::vector<MeshPaintData> m_meshes;
@@ -359,7 +564,9 @@ private:
     std::vector<QPainter::CompositionMode> m_compositionModes;
     QList<PDFRenderError> m_errors;
     PDFSnapInfo m_snapInfo;
+    SpatialIndex m_spatialIndex;
     QElapsedTimer m_expirationTimer;
+    quint64 m_accessStamp = 0;
 };
 
 /// Processor, which processes PDF's page commands and writes them to the precompiled page.
@@ -387,9 +594,101 @@ protected:
     virtual void performRestoreGraphicState(ProcessOrder order) override;
     virtual void setWorldMatrix(const QTransform& matrix) override;
     virtual void setCompositionMode(QPainter::CompositionMode mode) override;
+    virtual bool performPaintFormInstance(const PDFStream* formStream) override;
+    virtual void performFormProcessed(const PDFStream* formStream) override;
+    virtual bool performTilingPatternPainting(const PDFTilingPattern* tilingPattern,
+                                              const QPainterPath& path,
+                                              const QPointF& tilingOrigin,
+                                              PDFColorSpacePointer uncoloredPatternColorSpace,
+                                              PDFColor uncoloredPatternColor) override;
+    virtual void performPageContentsBegin() override;
 
 private:
+    /// Recorded instructions of painted form XObject. When the same form is
+    /// painted again in equal graphic state (except transformation), recorded
+    /// instructions are replayed instead of processing form content again.
+    struct FormInstance
+    {
+        const PDFStream* formStream = nullptr;
+        PDFPageContentProcessorState graphicState;
+        QTransform worldMatrix;
+        PDFReal strokingAlpha = 1.0;
+        PDFReal fillingAlpha = 1.0;
+        bool isContentSuppressed = false;
+        size_t firstInstruction = 0;
+        size_t lastInstruction = 0;
+        size_t firstSnapImage = 0;
+        size_t lastSnapImage = 0;
+        size_t partiallyDecodedImageCount = 0;
+        size_t tilingPatternImageCount = 0;
+        bool hasTilingPatternImages = false;
+    };
+
+    /// Form compiled in parallel (see \p precompileForms)
+    struct PrecompiledForm
+    {
+        PDFPrecompiledPage page;
+        FormInstance instance;
+        std::vector<int> glyphIndices; ///< Indices of glyph outlines of the page in the generated page
+        bool isValid = false;
+    };
+
+    /// Returns true, if form painted in graphic state \p state and with current
+    /// transparency settings is same as recorded form instance \p instance
+    /// (up to the transformation).
+    bool isFormInstanceCompatible(const FormInstance& instance, const PDFPageContentProcessorState& state) const;
+
+    /// Returns index of the glyph outline in the precompiled page,
+    /// glyph outline is added to the page, if it is not present.
+    /// \param glyph Glyph outline
+    int getGlyphIndex(const QPainterPath* glyph);
+
+    /// Compiles forms painted directly by the page content streams in parallel.
+    /// Each form is compiled speculatively in the initial graphic state of the page
+    /// with transformation, in which it is painted first time. When form is then
+    /// painted in compatible graphic state (same as for form instances), compiled
+    /// instructions are copied to the page, otherwise form is processed as usual.
+    /// Nothing is done, if content processing is not parallelized, or page paints
+    /// only few forms.
+    void precompileForms();
+
+    /// Adds transformed snap images of the recorded form instance
+    /// \param snapInfo Snap info, in which form instance was recorded
+    /// \param instance Form instance
+    /// \param matrix Matrix applied to the snap images
+    void addSnapImages(const PDFSnapInfo* snapInfo, const FormInstance& instance, const QTransform& matrix);
+
+    /// Returns true, if instance can be painted with matrix \p matrix applied to the
+    /// recorded world matrix. Images (and images of tiling pattern cells) can be decoded
+    /// in reduced resolution sufficient only for the recorded instance, so enlarged
+    /// instances with images are processed as usual.
+    /// \param page Page, in which form instance was recorded
+    /// \param instance Form instance
+    /// \param matrix Matrix applied to the recorded world matrix
+    bool canPaintFormInstance(const PDFPrecompiledPage* page, const FormInstance& instance, const QTransform& matrix) const;
+
+    /// Minimal count of forms painted by the page, for which forms are compiled in parallel
+    static constexpr size_t MIN_PRECOMPILED_FORMS = 4;
+
+    /// Maximal number of recorded instances (in different graphic states) of one form
+    static constexpr size_t MAX_FORM_INSTANCES = 4;
+
     PDFPrecompiledPage* m_precompiledPage;
+
+    /// Forms, which are being processed (innermost form is last)
+    std::vector<FormInstance> m_processedForms;
+
+    /// Recorded form instances
+    std::map<const PDFStream*, std::vector<FormInstance>> m_formInstances;
+
+    /// Forms compiled in parallel before processing of the page contents
+    std::map<const PDFStream*, PrecompiledForm> m_precompiledForms;
+
+    /// Indices of glyph outlines added to the precompiled page
+    std::map<const QPainterPath*, int> m_glyphIndices;
+
+    /// Count of paths filled by images of the tiling pattern cells
+    size_t m_tilingPatternImageCount = 0;
 };
 
 }   // namespace pdf
@@ -28,10 +28,154 @@
 
 #include <cctype>
 #include <memory>
+#include <bit>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDF4QT_LEXER_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PDF4QT_LEXER_USE_NEON
+#include <arm_neon.h>
+#endif
 
 namespace pdf
 {
 
+// Vectorized scanning of characters. Lexical analyzer spends most of the time
+// by skipping whitespaces and by scanning names and commands. These functions
+// scan the input by 16 bytes at once, remaining bytes are scanned by scalar code.
+
+#if defined(PDF4QT_LEXER_USE_SSE2)
+using PDFLexerVector = __m128i;
+
+static inline PDFLexerVector lexerLoad(const char* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+static inline PDFLexerVector lexerEquals(PDFLexerVector data, char character) { return _mm_cmpeq_epi8(data, _mm_set1_epi8(character)); }
+static inline PDFLexerVector lexerOr(PDFLexerVector a, PDFLexerVector b) { return _mm_or_si128(a, b); }
+static inline uint32_t lexerMask(PDFLexerVector data) { return static_cast<uint32_t>(_mm_movemask_epi8(data)); }
+static inline int lexerFirstSet(PDFLexerVector data) { const uint32_t mask = lexerMask(data); return mask ? std::countr_zero(mask) : -1; }
+static inline int lexerFirstUnset(PDFLexerVector data) { const uint32_t mask = lexerMask(data) ^ 0xFFFFu; return mask ? std::countr_zero(mask) : -1; }
+#elif defined(PDF4QT_LEXER_USE_NEON)
+using PDFLexerVector = uint8x16_t;
+
+static inline PDFLexerVector lexerLoad(const char* data) { return vld1q_u8(reinterpret_cast<const uint8_t*>(data)); }
+static inline PDFLexerVector lexerEquals(PDFLexerVector data, char character) { return vceqq_u8(data, vdupq_n_u8(static_cast<uint8_t>(character))); }
+static inline PDFLexerVector lexerOr(PDFLexerVector a, PDFLexerVector b) { return vorrq_u8(a, b); }
+
+// NEON doesn't have movemask instruction, so we narrow each byte of the mask into 4 bits
+static inline uint64_t lexerMask(PDFLexerVector data) { return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(data), 4)), 0); }
+static inline int lexerFirstSet(PDFLexerVector data) { const uint64_t mask = lexerMask(data); return mask ? std::countr_zero(mask) / 4 : -1; }
+static inline int lexerFirstUnset(PDFLexerVector data) { return lexerFirstSet(vmvnq_u8(data)); }
+#endif
+
+#if defined(PDF4QT_LEXER_USE_SSE2) || defined(PDF4QT_LEXER_USE_NEON)
+#define PDF4QT_LEXER_USE_SIMD
+
+static constexpr const int LEXER_VECTOR_SIZE = 16;
+
+static inline PDFLexerVector lexerWhitespaceMask(PDFLexerVector data)
+{
+    PDFLexerVector mask = lexerOr(lexerEquals(data, CHAR_SPACE), lexerEquals(data, CHAR_LINE_FEED));
+    mask = lexerOr(mask, lexerOr(lexerEquals(data, CHAR_CARRIAGE_RETURN), lexerEquals(data, CHAR_TAB)));
+    return lexerOr(mask, lexerOr(lexerEquals(data, CHAR_NULL), lexerEquals(data, CHAR_FORM_FEED)));
+}
+
+static inline PDFLexerVector lexerDelimiterMask(PDFLexerVector data)
+{
+    PDFLexerVector mask = lexerOr(lexerEquals(data, CHAR_LEFT_BRACKET), lexerEquals(data, CHAR_RIGHT_BRACKET));
+    mask = lexerOr(mask, lexerOr(lexerEquals(data, CHAR_LEFT_ANGLE), lexerEquals(data, CHAR_RIGHT_ANGLE)));
+    mask = lexerOr(mask, lexerOr(lexerEquals(data, CHAR_ARRAY_START), lexerEquals(data, CHAR_ARRAY_END)));
+    mask = lexerOr(mask, lexerOr(lexerEquals(data, CHAR_LEFT_CURLY_BRACKET), lexerEquals(data, CHAR_RIGHT_CURLY_BRACKET)));
+    return lexerOr(mask, lexerOr(lexerEquals(data, CHAR_SLASH), lexerEquals(data, CHAR_PERCENT)));
+}
+#endif
+
+/// Skips whitespace characters, returns pointer to first non-whitespace
+/// character, or end pointer, if no such character exists.
+static inline const char* lexerSkipWhitespace(const char* current, const char* end)
+{
+#if defined(PDF4QT_LEXER_USE_SIMD)
+    while (std::distance(current, end) >= LEXER_VECTOR_SIZE)
+    {
+        const int index = lexerFirstUnset(lexerWhitespaceMask(lexerLoad(current)));
+        if (index != -1)
+        {
+            return current + index;
+        }
+
+        current += LEXER_VECTOR_SIZE;
+    }
+#endif
+
+    while (current != end && PDFLexicalAnalyzer::isWhitespace(*current))
+    {
+        ++current;
+    }
+
+    return current;
+}
+
+/// Finds end of line character (carriage return or line feed), returns
+/// pointer to it, or end pointer, if no such character exists.
+static inline const char* lexerFindEndOfLine(const char* current, const char* end)
+{
+#if defined(PDF4QT_LEXER_USE_SIMD)
+    while (std::distance(current, end) >= LEXER_VECTOR_SIZE)
+    {
+        const PDFLexerVector data = lexerLoad(current);
+        const int index = lexerFirstSet(lexerOr(lexerEquals(data, CHAR_CARRIAGE_RETURN), lexerEquals(data, CHAR_LINE_FEED)));
+        if (index != -1)
+        {
+            return current + index;
+        }
+
+        current += LEXER_VECTOR_SIZE;
+    }
+#endif
+
+    while (current != end && *current != CHAR_CARRIAGE_RETURN && *current != CHAR_LINE_FEED)
+    {
+        ++current;
+    }
+
+    return current;
+}
+
+/// Finds end of sequence of regular characters, returns pointer to first
+/// non-regular character, or end pointer, if no such character exists.
+/// \param current Current position
+/// \param end End of the buffer
+/// \param stopAtMark Treat '#' character as end of sequence too
+static inline const char* lexerFindEndOfRegular(const char* current, const char* end, bool stopAtMark)
+{
+#if defined(PDF4QT_LEXER_USE_SIMD)
+    while (std::distance(current, end) >= LEXER_VECTOR_SIZE)
+    {
+        const PDFLexerVector data = lexerLoad(current);
+        PDFLexerVector mask = lexerOr(lexerWhitespaceMask(data), lexerDelimiterMask(data));
+        if (stopAtMark)
+        {
+            mask = lexerOr(mask, lexerEquals(data, CHAR_MARK));
+        }
+
+        const int index = lexerFirstSet(mask);
+        if (index != -1)
+        {
+            return current + index;
+        }
+
+        current += LEXER_VECTOR_SIZE;
+    }
+#endif
+
+    while (current != end && PDFLexicalAnalyzer::isRegular(*current) && !(stopAtMark && *current == CHAR_MARK))
+    {
+        ++current;
+    }
+
+    return current;
+}
+
 PDFLexicalAnalyzer::PDFLexicalAnalyzer(const char* begin, const char* end) :
     m_begin(begin),
     m_current(begin),
@@ -311,6 +455,15 @@ PDFLexicalAnalyzer::Token PDFLexicalAnalyzer::fetch()
 
             while (!isAtEnd())
             {
+                // Append whole sequence of regular characters at once
+                const char* regularEnd = lexerFindEndOfRegular(m_current, m_end, true);
+                if (regularEnd != m_current)
+                {
+                    name.append(m_current, std::distance(m_current, regularEnd));
+                    m_current = regularEnd;
+                    continue;
+                }
+
                 if (fetchChar(CHAR_MARK))
                 {
                     const char hexHighCharacter = fetchChar();
@@ -438,13 +591,9 @@ PDFLexicalAnalyzer::Token PDFLexicalAnalyzer::fetch()
             if (isRegular(lookChar()))
             {
                 // It should be sequence of regular characters - command, true, false, null...
-                QByteArray command;
-                command.reserve(COMMAND_BUFFER_RESERVE);
-
-                while (!isAtEnd() && isRegular(lookChar()))
-                {
-                    command += fetchChar();
-                }
+                const char* commandEnd = lexerFindEndOfRegular(m_current, m_end, false);
+                QByteArray command(m_current, std::distance(m_current, commandEnd));
+                m_current = commandEnd;
 
                 if (command == BOOL_OBJECT_TRUE_STRING)
                 {
@@ -484,6 +633,45 @@ PDFLexicalAnalyzer::Token PDFLexicalAnalyzer::fetch()
     return Token(TokenType::EndOfFile);
 }
 
+PDFLexicalAnalyzer::Token PDFLexicalAnalyzer::fetchContentStreamToken(QByteArrayView& command)
+{
+    // Commands are by far the most common tokens in the content streams, so we
+    // scan them here without creating a byte array, other tokens are scanned
+    // as usual. Numbers start with regular characters too, so we skip them.
+    skipWhitespaceAndComments();
+
+    if (!isAtEnd() && !m_tokenizingPostScriptFunction)
+    {
+        const char currentChar = lookChar();
+        const bool isNumber = std::isdigit(static_cast<unsigned char>(currentChar)) || currentChar == '+' || currentChar == '-' || currentChar == '.';
+
+        if (!isNumber && isRegular(currentChar))
+        {
+            const char* commandEnd = lexerFindEndOfRegular(m_current, m_end, false);
+            QByteArrayView regular(m_current, std::distance(m_current, commandEnd));
+            m_current = commandEnd;
+
+            if (regular == BOOL_OBJECT_TRUE_STRING)
+            {
+                return Token(TokenType::Boolean, true);
+            }
+            else if (regular == BOOL_OBJECT_FALSE_STRING)
+            {
+                return Token(TokenType::Boolean, false);
+            }
+            else if (regular == NULL_OBJECT_STRING)
+            {
+                return Token(TokenType::Null);
+            }
+
+            command = regular;
+            return Token(TokenType::Command);
+        }
+    }
+
+    return fetch();
+}
+
 void PDFLexicalAnalyzer::seek(PDFInteger offset)
 {
     const PDFInteger limit = std::distance(m_begin, m_end);
@@ -499,29 +687,19 @@ void PDFLexicalAnalyzer::seek(PDFInteger offset)
 
 void PDFLexicalAnalyzer::skipWhitespaceAndComments()
 {
-    bool isComment = false;
-
     while (m_current != m_end)
     {
-        if (isComment)
+        m_current = lexerSkipWhitespace(m_current, m_end);
+
+        if (m_current != m_end && *m_current == CHAR_PERCENT)
         {
-            // Comment ends at end of line
-            if (*m_current == CHAR_CARRIAGE_RETURN || *m_current == CHAR_LINE_FEED)
+            // Comment ends at end of line, end of line character is also skipped
+            m_current = lexerFindEndOfLine(m_current + 1, m_end);
+
+            if (m_current != m_end)
             {
-                isComment = false;
+                ++m_current;
             }
-
-            // Commented character - step to the next character
-            ++m_current;
-        }
-        else if (*m_current == CHAR_PERCENT)
-        {
-            isComment = true;
-            ++m_current;
-        }
-        else if (isWhitespace(*m_current))
-        {
-            ++m_current;
         }
         else
         {
@@ -561,16 +739,14 @@ PDFInteger PDFLexicalAnalyzer::findSubstring(const char* str, PDFInteger positio
         return -1;
     }
 
-    const PDFInteger substringLength = qstrlen(str);
-    const PDFInteger startPos = position;
-    const PDFInteger endPos = length - substringLength;
-    for (PDFInteger i = startPos; i <= endPos; ++i)
+    // String view search uses memchr to find candidates, which is vectorized
+    // in standard libraries, so it is much faster than naive comparison.
+    std::string_view data(m_begin, length);
+    const size_t index = data.find(str, position);
+
+    if (index != std::string_view::npos)
     {
-        Q_ASSERT(std::distance(m_begin + i + substringLength - 1, m_end) >= 0);
-        if (memcmp(m_begin + i, str, substringLength) == 0)
-        {
-            return i;
-        }
+        return static_cast<PDFInteger>(index);
     }
 
     return -1;
@@ -980,7 +1156,18 @@ void PDFParser::shift()
 
 PDFLexicalAnalyzer::Token PDFParser::fetch()
 {
-    return m_tokenFetcher ? m_tokenFetcher() : m_lexicalAnalyzer.fetch();
+    if (m_tokenFetcher)
+    {
+        return m_tokenFetcher();
+    }
+
+    // Jakub Melka: fetched token always becomes the second lookahead token, and
+    // the previous second lookahead token becomes the first one (lookahead tokens
+    // are always fetched in this order), so we shift the positions accordingly.
+    PDFLexicalAnalyzer::Token token = m_lexicalAnalyzer.fetch();
+    m_lookAhead1EndPosition = m_lookAhead2EndPosition;
+    m_lookAhead2EndPosition = m_lexicalAnalyzer.pos();
+    return token;
 }
 
 }   // namespace pdf
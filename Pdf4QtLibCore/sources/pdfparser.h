@@ -25,6 +25,7 @@
 
 #include <QVariant>
 #include <QByteArray>
+#include <QByteArrayView>
 
 #include <set>
 #include <functional>
@@ -125,6 +126,13 @@ public:
     /// stream, then EndOfFile token is returned.
     Token fetch();
 
+    /// Fetches a new token from the content stream. It is the same as function
+    /// \p fetch, but command token doesn't carry data, command is returned
+    /// in \p command as a view of the source buffer instead, so no memory is
+    /// allocated for commands. View is valid as long as the source buffer.
+    /// \param[out] command Command, if command token is fetched
+    Token fetchContentStreamToken(QByteArrayView& command);
+
     /// Seeks stream from the start. If stream cannot be seeked (position is invalid),
     /// then exception is thrown.
     void seek(PDFInteger offset);
@@ -319,6 +327,10 @@ public:
     /// Returns currently scanned token
     const PDFLexicalAnalyzer::Token& lookahead() const { return m_lookAhead1; }
 
+    /// Returns position in the data just after the currently scanned token. If parser
+    /// uses token fetcher, then position is unknown and -1 is returned.
+    PDFInteger lookaheadEndPosition() const { return m_lookAhead1EndPosition; }
+
     /// If current token is a command with same string, then eat this command
     /// and return true. Otherwise do nothing and return false.
     /// \param command Command to be fetched
@@ -343,6 +355,10 @@ private:
 
     PDFLexicalAnalyzer::Token m_lookAhead1;
     PDFLexicalAnalyzer::Token m_lookAhead2;
+
+    /// Positions in the data just after the lookahead tokens
+    PDFInteger m_lookAhead1EndPosition = -1;
+    PDFInteger m_lookAhead2EndPosition = -1;
 };
 
 // Implementation
@@ -0,0 +1,160 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdfpathbuilder.h"
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+void PDFPathBuilder::moveTo(const QPointF& point)
+{
+    m_commands.push_back(Command::MoveTo);
+    m_points.push_back(point);
+    m_elementCount += 1;
+    m_currentPoint = point;
+    m_subpathStartPoint = point;
+    m_hasCurrentPoint = true;
+    m_isSubpathFinished = false;
+}
+
+void PDFPathBuilder::lineTo(const QPointF& point)
+{
+    // Painter path starts in (0, 0), if path is empty, and new subpath
+    // starts in the current point, if previous subpath was finished.
+    if (!m_hasCurrentPoint)
+    {
+        m_subpathStartPoint = QPointF();
+    }
+    else if (m_isSubpathFinished)
+    {
+        m_subpathStartPoint = m_currentPoint;
+    }
+
+    m_commands.push_back(Command::LineTo);
+    m_points.push_back(point);
+    m_elementCount += 2;
+    ++m_drawCommandCount;
+    m_currentPoint = point;
+    m_hasCurrentPoint = true;
+    m_isSubpathFinished = false;
+}
+
+void PDFPathBuilder::cubicTo(const QPointF& controlPoint1, const QPointF& controlPoint2, const QPointF& endPoint)
+{
+    if (!m_hasCurrentPoint)
+    {
+        m_subpathStartPoint = QPointF();
+    }
+    else if (m_isSubpathFinished)
+    {
+        m_subpathStartPoint = m_currentPoint;
+    }
+
+    m_commands.push_back(Command::CubicTo);
+    m_points.push_back(controlPoint1);
+    m_points.push_back(controlPoint2);
+    m_points.push_back(endPoint);
+    m_elementCount += 4;
+    ++m_drawCommandCount;
+    m_currentPoint = endPoint;
+    m_hasCurrentPoint = true;
+    m_isSubpathFinished = false;
+}
+
+void PDFPathBuilder::addRect(const QRectF& rect)
+{
+    m_commands.push_back(Command::Rectangle);
+    m_points.push_back(rect.topLeft());
+    m_points.push_back(QPointF(rect.width(), rect.height()));
+    m_elementCount += 5;
+    ++m_drawCommandCount;
+    m_currentPoint = rect.topLeft();
+    m_subpathStartPoint = rect.topLeft();
+    m_hasCurrentPoint = true;
+    m_isSubpathFinished = true;
+}
+
+void PDFPathBuilder::closeSubpath()
+{
+    if (isEmpty())
+    {
+        return;
+    }
+
+    m_commands.push_back(Command::CloseSubpath);
+    m_elementCount += 1;
+    m_currentPoint = m_subpathStartPoint;
+    m_isSubpathFinished = true;
+}
+
+void PDFPathBuilder::clear()
+{
+    m_commands.clear();
+    m_points.clear();
+    m_drawCommandCount = 0;
+    m_elementCount = 0;
+    m_currentPoint = QPointF();
+    m_subpathStartPoint = QPointF();
+    m_hasCurrentPoint = false;
+    m_isSubpathFinished = false;
+}
+
+QPainterPath PDFPathBuilder::toPainterPath(Qt::FillRule fillRule) const
+{
+    QPainterPath path;
+    path.reserve(m_elementCount);
+    path.setFillRule(fillRule);
+
+    const QPointF* point = m_points.data();
+    for (const Command command : m_commands)
+    {
+        switch (command)
+        {
+            case Command::MoveTo:
+                path.moveTo(point[0]);
+                point += 1;
+                break;
+
+            case Command::LineTo:
+                path.lineTo(point[0]);
+                point += 1;
+                break;
+
+            case Command::CubicTo:
+                path.cubicTo(point[0], point[1], point[2]);
+                point += 3;
+                break;
+
+            case Command::Rectangle:
+                path.addRect(QRectF(point[0], QSizeF(point[1].x(), point[1].y())));
+                point += 2;
+                break;
+
+            case Command::CloseSubpath:
+                path.closeSubpath();
+                break;
+        }
+    }
+
+    Q_ASSERT(point == m_points.data() + m_points.size());
+    return path;
+}
+
+}   // namespace pdf
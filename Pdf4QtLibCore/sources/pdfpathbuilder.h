@@ -0,0 +1,88 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFPATHBUILDER_H
+#define PDFPATHBUILDER_H
+
+#include "pdfglobal.h"
+
+#include <QPainterPath>
+
+#include <vector>
+
+namespace pdf
+{
+
+/// Builds path from the path construction operators of the content stream.
+/// Path is stored in flat arrays of commands and points, which are reused for
+/// all paths built by the builder, so constructing of the path doesn't allocate
+/// memory. Path is converted to QPainterPath only when it is painted (or used as
+/// clipping path), then QPainterPath is allocated at once with exact size. Path
+/// created by the builder is same as path created by the same sequence of calls
+/// of QPainterPath functions.
+class PDF4QTLIBCORESHARED_EXPORT PDFPathBuilder
+{
+public:
+    explicit inline PDFPathBuilder() = default;
+
+    void moveTo(const QPointF& point);
+    void lineTo(const QPointF& point);
+    void cubicTo(const QPointF& controlPoint1, const QPointF& controlPoint2, const QPointF& endPoint);
+    void addRect(const QRectF& rect);
+    void closeSubpath();
+
+    /// Clears the path, allocated memory is kept for next paths
+    void clear();
+
+    /// Returns true, if path is empty. As in QPainterPath, path
+    /// containing only move to commands is also empty.
+    bool isEmpty() const { return m_drawCommandCount == 0; }
+
+    /// Returns true, if current point is set
+    bool hasCurrentPoint() const { return m_hasCurrentPoint; }
+
+    /// Returns current point (last point of the path, see \p hasCurrentPoint)
+    const QPointF& getCurrentPoint() const { return m_currentPoint; }
+
+    /// Creates painter path from the path
+    /// \param fillRule Fill rule of the path
+    QPainterPath toPainterPath(Qt::FillRule fillRule) const;
+
+private:
+    enum class Command : uint8_t
+    {
+        MoveTo,         ///< One point
+        LineTo,         ///< One point
+        CubicTo,        ///< Three points (two control points, end point)
+        Rectangle,      ///< Two points (top left corner, width and height)
+        CloseSubpath    ///< No point
+    };
+
+    std::vector<Command> m_commands;
+    std::vector<QPointF> m_points;
+    size_t m_drawCommandCount = 0;  ///< Count of commands, which are not move to commands
+    int m_elementCount = 0;         ///< Count of elements of the created painter path (upper bound)
+    QPointF m_currentPoint;
+    QPointF m_subpathStartPoint;
+    bool m_hasCurrentPoint = false;
+    bool m_isSubpathFinished = false; ///< Subpath was closed, next draw command starts new subpath
+};
+
+}   // namespace pdf
+
+#endif // PDFPATHBUILDER_H
@@ -20,6 +20,7 @@
 #include "pdfexception.h"
 #include "pdfutils.h"
 #include "pdfcolorspaces.h"
+#include "pdfcms.h"
 #include "pdfexecutionpolicy.h"
 #include "pdfconstants.h"
 #include "pdfpainterutils.h"
@@ -61,6 +62,29 @@ PDFShadingSampler* PDFShadingPattern::createSampler(QTransform userSpaceToDevice
     return nullptr;
 }
 
+PDFFunctionLookupTablePointer PDFSingleDimensionShading::getFunctionLookupTable(PDFReal tolerance) const
+{
+    QMutexLocker lock(&m_functionLookupTableMutex);
+
+    if (m_functionLookupTableTolerance != tolerance)
+    {
+        m_functionLookupTableTolerance = tolerance;
+        m_functionLookupTable.reset();
+
+        const size_t colorComponentCount = m_colorSpace ? m_colorSpace->getColorComponentCount() : 0;
+        const PDFReal tMin = qMin(m_domainStart, m_domainEnd);
+        const PDFReal tMax = qMax(m_domainStart, m_domainEnd);
+        PDFFunctionLookupTable table = PDFFunctionLookupTable::create(m_functions, colorComponentCount, tMin, tMax, tolerance);
+
+        if (table.isValid())
+        {
+            m_functionLookupTable = std::make_shared<const PDFFunctionLookupTable>(qMove(table));
+        }
+    }
+
+    return m_functionLookupTable;
+}
+
 ShadingType PDFAxialShading::getShadingType() const
 {
     return ShadingType::Axial;
@@ -170,6 +194,7 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
     PDFDocumentDataLoaderDecorator loader(document);
     const PDFDictionary* shadingDictionary = nullptr;
     const PDFStream* stream = nullptr;
+    const PDFObjectReference shadingReference = shadingObject.isReference() ? shadingObject.getReference() : PDFObjectReference();
 
     if (dereferencedShadingObject.isDictionary())
     {
@@ -274,6 +299,8 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             functionShading->m_functions = qMove(functions);
             functionShading->m_matrix = matrix;
             functionShading->m_patternGraphicState = patternGraphicState;
+            functionShading->m_shadingDictionary = shadingDictionary;
+            functionShading->m_shadingReference = shadingReference;
 
             return result;
         }
@@ -320,6 +347,8 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             axialShading->m_functions = qMove(functions);
             axialShading->m_matrix = matrix;
             axialShading->m_patternGraphicState = patternGraphicState;
+            axialShading->m_shadingDictionary = shadingDictionary;
+            axialShading->m_shadingReference = shadingReference;
 
             return result;
         }
@@ -373,6 +402,8 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             radialShading->m_functions = qMove(functions);
             radialShading->m_matrix = matrix;
             radialShading->m_patternGraphicState = patternGraphicState;
+            radialShading->m_shadingDictionary = shadingDictionary;
+            radialShading->m_shadingReference = shadingReference;
 
             return result;
         }
@@ -455,6 +486,8 @@ PDFPatternPtr PDFPattern::createShadingPattern(const PDFDictionary* colorSpaceDi
             type4567Shading->m_colorSpace = colorSpace;
             type4567Shading->m_matrix = matrix;
             type4567Shading->m_patternGraphicState = patternGraphicState;
+            type4567Shading->m_shadingDictionary = shadingDictionary;
+            type4567Shading->m_shadingReference = shadingReference;
             type4567Shading->m_bitsPerCoordinate = static_cast<uint8_t>(bitsPerCoordinate);
             type4567Shading->m_bitsPerComponent = static_cast<uint8_t>(bitsPerComponent);
             type4567Shading->m_xmin = decode[0];
@@ -613,8 +646,6 @@ PDFMesh PDFFunctionShading::createMesh(const PDFMeshQualitySettings& settings,
 {
     PDFMesh mesh;
 
-    Q_UNUSED(operationControl);
-
     QTransform patternSpaceToDeviceSpaceMatrix = getPatternSpaceToDeviceSpaceMatrix(settings);
     QTransform domainToDeviceSpaceMatrix = m_domainToTargetTransform * patternSpaceToDeviceSpaceMatrix;
     QLineF topLine(m_domain.topLeft(), m_domain.topRight());
@@ -636,6 +667,12 @@ PDFMesh PDFFunctionShading::createMesh(const PDFMeshQualitySettings& settings,
 
     for (PDFReal resolution : resolutions)
     {
+        // Mesh generation is cancelled
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return PDFMesh();
+        }
+
         const PDFReal xSteps = qMax(std::floor(topLineDS.length() / resolution), 2.0);
         const PDFReal ySteps = qMax(std::floor(leftLineDS.length() / resolution), 2.0);
         const PDFReal xStep = 1.0 / xSteps;
@@ -703,51 +740,75 @@ PDFMesh PDFFunctionShading::createMesh(const PDFMeshQualitySettings& settings,
         QMutex functionErrorMutex;
         PDFFunction::FunctionResult functionError(true);
 
-        auto setColor = [&](size_t index)
+        std::vector<size_t> rowIndices;
+        rowIndices.resize(rowCount, 0);
+        std::iota(rowIndices.begin(), rowIndices.end(), 0);
+
+        // Colors are evaluated for whole row at once, so functions
+        // can evaluate all points of the row in one batch.
+        auto setRowColors = [&](size_t row)
         {
-            auto [row, column] = indexToRowColumn(index);
-            QPointF nodeDS = topLineDS.pointAt(xOrdinates[column]) + leftLineDS.pointAt(yOrdinates[row]) - topLineDS.p1();
-            QPointF node = deviceSpaceToDomainMatrix.map(nodeDS);
-            const size_t colorComponentIndex = rowColumnToFirstColorComponent(row, column);
-            Q_ASSERT(colorComponentIndex <= sourceColorBuffer.size());
+            if (PDFOperationControl::isOperationCancelled(operationControl))
+            {
+                return;
+            }
 
-            gridPoints[index] = nodeDS;
+            std::vector<PDFReal> uvs(columnCount * 2, 0.0);
+            for (size_t column = 0; column < columnCount; ++column)
+            {
+                QPointF nodeDS = topLineDS.pointAt(xOrdinates[column]) + leftLineDS.pointAt(yOrdinates[row]) - topLineDS.p1();
+                QPointF node = deviceSpaceToDomainMatrix.map(nodeDS);
+                gridPoints[rowColumnToIndex(row, column)] = nodeDS;
+                uvs[2 * column] = node.x();
+                uvs[2 * column + 1] = node.y();
+            }
 
+            const size_t colorComponentIndex = rowColumnToFirstColorComponent(row, 0);
+            Q_ASSERT(colorComponentIndex + stride <= sourceColorBuffer.size());
             PDFReal* sourceColorBegin = sourceColorBuffer.data() + colorComponentIndex;
-            PDFReal* sourceColorEnd = sourceColorBegin + colorComponents;
 
-            std::array<PDFReal, 2> uv = { node.x(), node.y() };
+            auto reportError = [&](const PDFFunction::FunctionResult& result)
+            {
+                QMutexLocker lock(&functionErrorMutex);
+                if (!functionError)
+                {
+                    functionError = result;
+                }
+            };
 
             if (isSingleFunction)
             {
-                PDFFunction::FunctionResult result = m_functions.front()->apply(uv.data(), uv.data() + uv.size(), sourceColorBegin, sourceColorEnd);
+                PDFFunction::FunctionResult result = m_functions.front()->applyBatch(uvs.data(), sourceColorBegin, columnCount);
                 if (!result)
                 {
-                    QMutexLocker lock(&functionErrorMutex);
-                    if (!functionError)
-                    {
-                        functionError = result;
-                    }
+                    reportError(result);
                 }
             }
             else
             {
+                std::vector<PDFReal> values(columnCount, 0.0);
                 for (size_t i = 0, count = colorComponents; i < count; ++i)
                 {
-                    PDFFunction::FunctionResult result = m_functions[i]->apply(uv.data(), uv.data() + uv.size(), sourceColorBegin + i, sourceColorBegin + i + 1);
+                    PDFFunction::FunctionResult result = m_functions[i]->applyBatch(uvs.data(), values.data(), columnCount);
                     if (!result)
                     {
-                        QMutexLocker lock(&functionErrorMutex);
-                        if (!functionError)
-                        {
-                            functionError = result;
-                        }
+                        reportError(result);
+                    }
+
+                    for (size_t column = 0; column < columnCount; ++column)
+                    {
+                        sourceColorBegin[column * colorComponents + i] = values[column];
                     }
                 }
             }
         };
 
-        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, indices.cbegin(), indices.cend(), setColor);
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, rowIndices.cbegin(), rowIndices.cend(), setRowColors);
+
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return PDFMesh();
+        }
 
         if (!functionError)
         {
@@ -809,6 +870,11 @@ PDFMesh PDFFunctionShading::createMesh(const PDFMeshQualitySettings& settings,
 
         auto generateTriangle = [&](size_t index)
         {
+            if (PDFOperationControl::isOperationCancelled(operationControl))
+            {
+                return;
+            }
+
             auto [row, column] = indexToRowColumn(index);
                     if (row == 0 || column == 0)
             {
@@ -880,6 +946,12 @@ PDFMesh PDFFunctionShading::createMesh(const PDFMeshQualitySettings& settings,
             triangles[triangleIndex2] = triangle2;
         };
         PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, indices.cbegin(), indices.cend(), generateTriangle);
+
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return PDFMesh();
+        }
+
         mesh.setTriangles(qMove(triangles));
 
         if (!functionError)
@@ -993,9 +1065,14 @@ PDFMesh PDFAxialShading::createMesh(const PDFMeshQualitySettings& settings,
 
     const bool isSingleFunction = m_functions.size() == 1;
     std::vector<PDFReal> colorBuffer(m_colorSpace->getColorComponentCount(), 0.0);
-    auto getColor = [this, isSingleFunction, &colorBuffer](PDFReal t) -> PDFColor
+    PDFFunctionLookupTablePointer functionLookupTable = settings.approximateShadingFunctions ? getFunctionLookupTable(settings.tolerance) : nullptr;
+    auto getColor = [this, isSingleFunction, &colorBuffer, &functionLookupTable](PDFReal t) -> PDFColor
     {
-        if (isSingleFunction)
+        if (functionLookupTable)
+        {
+            functionLookupTable->evaluate(t, colorBuffer.data());
+        }
+        else if (isSingleFunction)
         {
             PDFFunction::FunctionResult result = m_functions.front()->apply(&t, &t + 1, colorBuffer.data(), colorBuffer.data() + colorBuffer.size());
             if (!result)
@@ -1094,7 +1171,16 @@ PDFMesh PDFAxialShading::createMesh(const PDFMeshQualitySettings& settings,
         }
         mesh.reserve(vertexCount, triangleCount);
 
-        PDFColor previousColor = filteredCoordinates.front().second;
+        // Convert colors of all quads at once
+        std::vector<PDFColor> mixedColors;
+        mixedColors.reserve(filteredCoordinates.size() - 1);
+        for (auto it = std::next(filteredCoordinates.cbegin()); it != filteredCoordinates.cend(); ++it)
+        {
+            mixedColors.push_back(PDFAbstractColorSpace::mixColors(std::prev(it)->second, it->second, 0.5));
+        }
+        const std::vector<QRgb> colors = m_colorSpace->getRgbColors(mixedColors, cms, intent, reporter);
+        auto itColor = colors.cbegin();
+
         uint32_t topLeft = mesh.addVertex(QPointF(filteredCoordinates.front().first, yt));
         uint32_t bottomLeft = mesh.addVertex(QPointF(filteredCoordinates.front().first, yb));
         for (auto it = std::next(filteredCoordinates.cbegin()); it != filteredCoordinates.cend(); ++it)
@@ -1104,13 +1190,10 @@ PDFMesh PDFAxialShading::createMesh(const PDFMeshQualitySettings& settings,
             uint32_t topRight = mesh.addVertex(QPointF(item.first, yt));
             uint32_t bottomRight = mesh.addVertex(QPointF(item.first, yb));
 
-            PDFColor mixedColor = PDFAbstractColorSpace::mixColors(previousColor, item.second, 0.5);
-            QColor color = m_colorSpace->getColor(mixedColor, cms, intent, reporter, true);
-            mesh.addQuad(topLeft, topRight, bottomRight, bottomLeft, color.rgb());
+            mesh.addQuad(topLeft, topRight, bottomRight, bottomLeft, *itColor++);
 
             topLeft = topRight;
             bottomLeft = bottomRight;
-            previousColor = item.second;
         }
     }
 
@@ -1197,6 +1280,9 @@ public:
         m_tMin = qMin(m_tAtStart, m_tAtEnd);
         m_tMax = qMax(m_tAtStart, m_tAtEnd);
 
+        // Sampler doesn't have mesh quality settings, so default color tolerance is used
+        m_functionLookupTable = axialShadingPattern->getFunctionLookupTable(PDFMeshQualitySettings().tolerance);
+
         m_p1p2GCS = p1p2GCS;
     }
 
@@ -1258,7 +1344,11 @@ public:
             return false;
         }
 
-        if (functions.size() == 1)
+        if (m_functionLookupTable && m_functionLookupTable->getOutputCount() == outputBuffer.size())
+        {
+            m_functionLookupTable->evaluate(t, colorBuffer.data());
+        }
+        else if (functions.size() == 1)
         {
             Q_ASSERT(outputBuffer.size() <= colorBuffer.size());
             PDFFunction::FunctionResult result = functions.front()->apply(&t, &t + 1, colorBuffer.data(), colorBuffer.data() + outputBuffer.size());
@@ -1307,6 +1397,7 @@ private:
     PDFReal m_tAtEnd;
     PDFReal m_tMin;
     PDFReal m_tMax;
+    PDFFunctionLookupTablePointer m_functionLookupTable;
 };
 
 PDFShadingSampler* PDFAxialShading::createSampler(QTransform userSpaceToDeviceSpaceMatrix) const
@@ -1567,9 +1658,14 @@ PDFMesh PDFRadialShading::createMesh(const PDFMeshQualitySettings& settings,
 
     const bool isSingleFunction = m_functions.size() == 1;
     std::vector<PDFReal> colorBuffer(m_colorSpace->getColorComponentCount(), 0.0);
-    auto getColor = [this, isSingleFunction, &colorBuffer](PDFReal t) -> PDFColor
+    PDFFunctionLookupTablePointer functionLookupTable = settings.approximateShadingFunctions ? getFunctionLookupTable(settings.tolerance) : nullptr;
+    auto getColor = [this, isSingleFunction, &colorBuffer, &functionLookupTable](PDFReal t) -> PDFColor
     {
-        if (isSingleFunction)
+        if (functionLookupTable)
+        {
+            functionLookupTable->evaluate(t, colorBuffer.data());
+        }
+        else if (isSingleFunction)
         {
             PDFFunction::FunctionResult result = m_functions.front()->apply(&t, &t + 1, colorBuffer.data(), colorBuffer.data() + colorBuffer.size());
             if (!result)
@@ -1680,6 +1776,7 @@ PDFMesh PDFRadialShading::createMesh(const PDFMeshQualitySettings& settings,
             const PDFReal x0 = leftItem.first;
             const PDFReal x1 = rightItem.first;
             const PDFColor mixedColor = PDFAbstractColorSpace::mixColors(leftItem.second, rightItem.second, 0.5);
+            const QRgb color = m_colorSpace->getColor(mixedColor, cms, intent, reporter, true).rgb();
             const PDFReal angleStep = 2 * M_PI / SLICES;
             const PDFReal cr0 = rLine.pointAt((x0 - p1m.x()) / rlength).y();
             const PDFReal cr1 = rLine.pointAt((x1 - p1m.x()) / rlength).y();
@@ -1703,8 +1800,7 @@ PDFMesh PDFRadialShading::createMesh(const PDFMeshQualitySettings& settings,
                 uint32_t v3 = mesh.addVertex(cp3);
                 uint32_t v4 = mesh.addVertex(cp4);
 
-                QColor color = m_colorSpace->getColor(mixedColor, cms, intent, reporter, true);
-                mesh.addQuad(v1, v2, v3, v4, color.rgb());
+                mesh.addQuad(v1, v2, v3, v4, color);
 
                 angle0 = angle1;
             }
@@ -1779,6 +1875,9 @@ public:
         m_tMin = qMin(m_tAtStart, m_tAtEnd);
         m_tMax = qMax(m_tAtStart, m_tAtEnd);
 
+        // Sampler doesn't have mesh quality settings, so default color tolerance is used
+        m_functionLookupTable = radialShadingPattern->getFunctionLookupTable(PDFMeshQualitySettings().tolerance);
+
         m_r0 = r0;
         m_r1 = r1;
 
@@ -1933,7 +2032,11 @@ public:
             return false;
         }
 
-        if (functions.size() == 1)
+        if (m_functionLookupTable && m_functionLookupTable->getOutputCount() == outputBuffer.size())
+        {
+            m_functionLookupTable->evaluate(t, colorBuffer.data());
+        }
+        else if (functions.size() == 1)
         {
             Q_ASSERT(outputBuffer.size() <= colorBuffer.size());
             PDFFunction::FunctionResult result = functions.front()->apply(&t, &t + 1, colorBuffer.data(), colorBuffer.data() + outputBuffer.size());
@@ -1982,6 +2085,7 @@ private:
     PDFReal m_tAtEnd;
     PDFReal m_tMin;
     PDFReal m_tMax;
+    PDFFunctionLookupTablePointer m_functionLookupTable;
     PDFReal m_r0;
     PDFReal m_r1;
 };
@@ -2264,10 +2368,13 @@ PDFMesh PDFFreeFormGouradTriangleShading::createMesh(const PDFMeshQualitySetting
 {
     PDFMesh mesh;
 
-    Q_UNUSED(operationControl);
-
-    auto addTriangle = [this, &settings, &mesh, cms, intent, reporter](const VertexData* va, const VertexData* vb, const VertexData* vc)
+    auto addTriangle = [this, &settings, &mesh, cms, intent, reporter, operationControl](const VertexData* va, const VertexData* vb, const VertexData* vc)
     {
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return;
+        }
+
         const uint32_t via = va->index;
         const uint32_t vib = vb->index;
         const uint32_t vic = vc->index;
@@ -2286,6 +2393,12 @@ PDFMesh PDFFreeFormGouradTriangleShading::createMesh(const PDFMeshQualitySetting
         throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Invalid free form gourad triangle data stream."));
     }
 
+    // Mesh generation is cancelled
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        return PDFMesh();
+    }
+
     if (m_backgroundColor.isValid())
     {
         QPainterPath path;
@@ -2432,10 +2545,13 @@ PDFMesh PDFLatticeFormGouradTriangleShading::createMesh(const PDFMeshQualitySett
 {
     PDFMesh mesh;
 
-    Q_UNUSED(operationControl);
-
-    auto addTriangle = [this, &settings, &mesh, cms, intent, reporter](const VertexData* va, const VertexData* vb, const VertexData* vc)
+    auto addTriangle = [this, &settings, &mesh, cms, intent, reporter, operationControl](const VertexData* va, const VertexData* vb, const VertexData* vc)
     {
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return;
+        }
+
         const uint32_t via = va->index;
         const uint32_t vib = vb->index;
         const uint32_t vic = vc->index;
@@ -2454,6 +2570,12 @@ PDFMesh PDFLatticeFormGouradTriangleShading::createMesh(const PDFMeshQualitySett
         throw PDFRendererException(RenderErrorType::Error, PDFTranslationContext::tr("Invalid lattice form gourad triangle data stream."));
     }
 
+    // Mesh generation is cancelled
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        return PDFMesh();
+    }
+
     if (m_backgroundColor.isValid())
     {
         QPainterPath path;
@@ -3160,6 +3282,34 @@ struct PDFTensorProductPatchShadingBase::Triangle
     }
 };
 
+/// Error reporter, which can be used from multiple threads. Errors are
+/// reported to the underlying reporter under the lock.
+class PDFSynchronizedRenderErrorReporter : public PDFRenderErrorReporter
+{
+public:
+    explicit PDFSynchronizedRenderErrorReporter(PDFRenderErrorReporter* reporter) :
+        m_reporter(reporter)
+    {
+
+    }
+
+    virtual void reportRenderError(RenderErrorType type, QString message) override
+    {
+        QMutexLocker lock(&m_mutex);
+        m_reporter->reportRenderError(type, qMove(message));
+    }
+
+    virtual void reportRenderErrorOnce(RenderErrorType type, QString message) override
+    {
+        QMutexLocker lock(&m_mutex);
+        m_reporter->reportRenderErrorOnce(type, qMove(message));
+    }
+
+private:
+    QMutex m_mutex;
+    PDFRenderErrorReporter* m_reporter;
+};
+
 class PDFTensorPatchesSample : public PDFShadingSampler
 {
 public:
@@ -3378,30 +3528,46 @@ void PDFTensorProductPatchShadingBase::fillMesh(PDFMesh& mesh,
             targetLength = interpolate(curvatureRatio, settings.patchResolutionMappingRatioLow, settings.patchResolutionMappingRatioHigh, settings.preferredMeshResolution, settings.minimalMeshResolution);
         }
 
-        const PDFColor c0 = getColorForUV(triangle.uvCoordinates[0].x(), triangle.uvCoordinates[0].y());
-        const PDFColor c1 = getColorForUV(triangle.uvCoordinates[1].x(), triangle.uvCoordinates[1].y());
-        const PDFColor c2 = getColorForUV(triangle.uvCoordinates[2].x(), triangle.uvCoordinates[2].y());
+        QPointF v0 = triangle.uvCoordinates[0];
+        QPointF v1 = triangle.uvCoordinates[1];
+        QPointF v2 = triangle.uvCoordinates[2];
+
+        QPointF v12 = QLineF(v1, v2).center();
+        QPointF v02 = QLineF(v0, v2).center();
+        QPointF v01 = QLineF(v0, v1).center();
+
+        auto isUVColorEqual = [&](const PDFColor& color, const QPointF& uv)
+        {
+            return PDFAbstractColorSpace::isColorEqual(color, getColorForUV(uv.x(), uv.y()), settings.tolerance);
+        };
+
+        // Color is bilinear in the patch, so it can vary inside the triangle,
+        // even if colors in the vertices are equal. So we also check colors
+        // in the middle of the edges and in the center of the triangle.
+        const PDFColor c0 = getColorForUV(v0.x(), v0.y());
+        const PDFColor c1 = getColorForUV(v1.x(), v1.y());
+        const PDFColor c2 = getColorForUV(v2.x(), v2.y());
 
         const bool isColorEqual = PDFAbstractColorSpace::isColorEqual(c0, c1, settings.tolerance) &&
                                   PDFAbstractColorSpace::isColorEqual(c0, c2, settings.tolerance) &&
-                                  PDFAbstractColorSpace::isColorEqual(c1, c2, settings.tolerance);
+                                  PDFAbstractColorSpace::isColorEqual(c1, c2, settings.tolerance) &&
+                                  isUVColorEqual(c0, v01) &&
+                                  isUVColorEqual(c0, v02) &&
+                                  isUVColorEqual(c0, v12) &&
+                                  isUVColorEqual(c0, triangle.getCenter());
         const bool canSubdivide = maxLength >= settings.minimalMeshResolution * 2.0; // If we subdivide, we will have length at least settings.minimalMeshResolution
-        const bool shouldSubdivide = maxLength >= targetLength;
+        bool shouldSubdivide = !isColorEqual;
 
-        if ((!isColorEqual || shouldSubdivide) && canSubdivide)
+        if (!shouldSubdivide && canSubdivide && maxLength >= targetLength)
         {
-            QPointF v0 = triangle.uvCoordinates[0];
-            QPointF v1 = triangle.uvCoordinates[1];
-            QPointF v2 = triangle.uvCoordinates[2];
-
-            QLineF v12uv(v1, v2);
-            QLineF v02uv(v0, v2);
-            QLineF v01uv(v0, v1);
-
-            QPointF v12 = v12uv.center();
-            QPointF v02 = v02uv.center();
-            QPointF v01 = v01uv.center();
+            // Triangle is larger than target length, but color is almost constant. Subdivide
+            // it only, if it doesn't approximate the patch surface well in the device space.
+            // So flat areas of the patch are meshed by fewer triangles.
+            shouldSubdivide = !isFlat(patch, triangle, settings.patchFlatnessTolerance);
+        }
 
+        if (shouldSubdivide && canSubdivide)
+        {
             addTriangle(unfinishedTriangles, patch, { v0, v01, v02 });
             addTriangle(unfinishedTriangles, patch, { v1, v01, v12 });
             addTriangle(unfinishedTriangles, patch, { v2, v02, v12 });
@@ -3430,6 +3596,17 @@ void PDFTensorProductPatchShadingBase::fillMesh(PDFMesh& mesh,
     vertices.reserve(finishedTriangles.size() * 3);
     triangles.reserve(finishedTriangles.size());
 
+    // Convert colors of all triangles at once
+    std::vector<PDFColor> triangleColors;
+    triangleColors.reserve(finishedTriangles.size());
+    for (const Triangle& triangle : finishedTriangles)
+    {
+        QPointF center = triangle.getCenter();
+        triangleColors.push_back(getColorForUV(center.x(), center.y()));
+    }
+    const std::vector<QRgb> rgbColors = m_colorSpace->getRgbColors(triangleColors, cms, intent, reporter);
+    auto itRgbColor = rgbColors.cbegin();
+
     size_t vertexIndex = 0;
     for (const Triangle& triangle : finishedTriangles)
     {
@@ -3437,9 +3614,7 @@ void PDFTensorProductPatchShadingBase::fillMesh(PDFMesh& mesh,
         vertices.push_back(triangle.devicePoints[1]);
         vertices.push_back(triangle.devicePoints[2]);
 
-        QPointF center = triangle.getCenter();
-        PDFColor color = getColorForUV(center.x(), center.y());
-        QRgb rgbColor = m_colorSpace->getColor(color, cms, intent, reporter, true).rgb();
+        const QRgb rgbColor = *itRgbColor++;
 
         PDFMesh::Triangle meshTriangle;
         meshTriangle.v1 = static_cast<uint32_t>(vertexIndex++);
@@ -3462,9 +3637,56 @@ void PDFTensorProductPatchShadingBase::fillMesh(PDFMesh& mesh,
                                                 const PDFOperationControl* operationControl) const
 {
     const bool fastAlgorithm = patches.size() > 16;
-    for (const auto& patch : patches)
+
+    // Patches are meshed concurrently, each patch into its own mesh. Meshes
+    // are then merged in the order of the patches, because later patches
+    // are painted over the previous ones.
+    std::vector<PDFMesh> patchMeshes(patches.size());
+    std::vector<size_t> indices(patches.size(), 0);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    PDFSynchronizedRenderErrorReporter synchronizedReporter(reporter);
+    QMutex exceptionMutex;
+    std::exception_ptr exception;
+
+    auto fillPatchMesh = [&](size_t index)
     {
-        fillMesh(mesh, settings, patch, cms, intent, reporter, fastAlgorithm, operationControl);
+        // Mesh generation is cancelled
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return;
+        }
+
+        try
+        {
+            fillMesh(patchMeshes[index], settings, patches[index], cms, intent, &synchronizedReporter, fastAlgorithm, operationControl);
+        }
+        catch (...)
+        {
+            QMutexLocker lock(&exceptionMutex);
+            if (!exception)
+            {
+                exception = std::current_exception();
+            }
+        }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, indices.cbegin(), indices.cend(), fillPatchMesh);
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+
+    // Mesh generation is cancelled
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        mesh = PDFMesh();
+        return;
+    }
+
+    for (PDFMesh& patchMesh : patchMeshes)
+    {
+        mesh.addMesh(qMove(patchMesh));
     }
 
     // Create bounding path
@@ -3495,6 +3717,31 @@ void PDFTensorProductPatchShadingBase::addTriangle(std::vector<Triangle>& triang
     triangles.push_back(triangle);
 }
 
+bool PDFTensorProductPatchShadingBase::isFlat(const PDFTensorPatch& patch, const Triangle& triangle, PDFReal tolerance)
+{
+    if (tolerance <= 0.0)
+    {
+        return false;
+    }
+
+    // Compare points of the patch surface with points of the triangle
+    // with same uv coordinates - in the middle of the edges and in the center.
+    auto isPointNear = [&](const QPointF& uv, const QPointF& devicePoint)
+    {
+        const QPointF difference = patch.getValue(uv.x(), uv.y()) - devicePoint;
+        return qAbs(difference.x()) <= tolerance && qAbs(difference.y()) <= tolerance;
+    };
+
+    const std::array<QPointF, 3>& uv = triangle.uvCoordinates;
+    const std::array<QPointF, 3>& points = triangle.devicePoints;
+    constexpr PDFReal coefficient = 1.0 / 3.0;
+
+    return isPointNear((uv[0] + uv[1]) * 0.5, (points[0] + points[1]) * 0.5) &&
+           isPointNear((uv[0] + uv[2]) * 0.5, (points[0] + points[2]) * 0.5) &&
+           isPointNear((uv[1] + uv[2]) * 0.5, (points[1] + points[2]) * 0.5) &&
+           isPointNear(triangle.getCenter(), (points[0] + points[1] + points[2]) * coefficient);
+}
+
 ShadingType PDFCoonsPatchShading::getShadingType() const
 {
     return ShadingType::CoonsPatchMesh;
@@ -3732,4 +3979,218 @@ bool PDFShadingSampler::fillBackgroundColor(PDFColorBuffer outputBuffer) const
     return false;
 }
 
+PDFMeshCache::PDFMeshCache() :
+    m_cacheLimit(qint64(DEFAULT_MESH_CACHE_LIMIT))
+{
+    PDFCacheManager::getInstance()->registerCache(this);
+}
+
+PDFMeshCache::~PDFMeshCache()
+{
+    PDFCacheManager::getInstance()->unregisterCache(this);
+}
+
+PDFMeshCache* PDFMeshCache::getInstance()
+{
+    static PDFMeshCache cache;
+    return &cache;
+}
+
+PDFMeshCache::Key PDFMeshCache::createKey(const PDFDocument* document,
+                                          const PDFShadingPattern* shadingPattern,
+                                          const PDFDictionary* colorSpaceDictionary,
+                                          const PDFMeshQualitySettings& settings,
+                                          const PDFCMS* cms,
+                                          RenderingIntent intent)
+{
+    Key key;
+
+    const QTransform patternSpaceToDeviceSpaceMatrix = shadingPattern->getPatternSpaceToDeviceSpaceMatrix(settings);
+    const PDFReal scale = std::sqrt(std::fabs(patternSpaceToDeviceSpaceMatrix.determinant()));
+    if (!cms || !patternSpaceToDeviceSpaceMatrix.isInvertible() || !std::isfinite(scale) || scale <= 0.0)
+    {
+        // Mesh can't be cached
+        return key;
+    }
+
+    const QColor& backgroundColor = shadingPattern->getBackgroundColor();
+
+    key.documentId = document->getUniqueId();
+    key.shading = shadingPattern->getShadingReference();
+    key.colorSpaceDictionary = colorSpaceDictionary;
+    key.cmsId = cms->getId();
+    key.renderingIntent = intent;
+    key.backgroundColor = backgroundColor.isValid() ? backgroundColor.rgba() : 0;
+    key.hasBackgroundColor = backgroundColor.isValid();
+    key.scaleBucket = qRound(std::log2(scale) * MESH_CACHE_SCALE_BUCKETS_PER_OCTAVE);
+    key.minimalMeshResolutionRatio = settings.minimalMeshResolutionRatio;
+    key.preferredMeshResolutionRatio = settings.preferredMeshResolutionRatio;
+    key.tolerance = settings.tolerance;
+    key.approximateShadingFunctions = settings.approximateShadingFunctions;
+    key.patchTestPoints = settings.patchTestPoints;
+    key.patchResolutionMappingRatioLow = settings.patchResolutionMappingRatioLow;
+    key.patchResolutionMappingRatioHigh = settings.patchResolutionMappingRatioHigh;
+    key.patchFlatnessTolerance = settings.patchFlatnessTolerance;
+    return key;
+}
+
+bool PDFMeshCache::findMesh(const Key& key, const QTransform& patternSpaceToDeviceSpaceMatrix, const QRectF& deviceSpaceMeshingArea, PDFMesh& mesh)
+{
+    if (!key.shading.isValid())
+    {
+        return false;
+    }
+
+    QTransform transform;
+
+    {
+        QMutexLocker lock(&m_mutex);
+
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
+        {
+            return false;
+        }
+
+        // Cached mesh is in the device space of the cached matrix, so
+        // we must transform it into the current device space.
+        Entry& entry = it->second;
+        transform = entry.patternSpaceToDeviceSpaceMatrix.inverted() * patternSpaceToDeviceSpaceMatrix;
+        if (!transform.isInvertible())
+        {
+            return false;
+        }
+
+        // Current meshing area must be covered by the cached mesh
+        const QRectF meshingArea = transform.inverted().mapRect(deviceSpaceMeshingArea);
+        const PDFReal tolerance = qMax(entry.deviceSpaceMeshingArea.width(), entry.deviceSpaceMeshingArea.height()) * MESH_CACHE_AREA_TOLERANCE;
+        if (!entry.deviceSpaceMeshingArea.adjusted(-tolerance, -tolerance, tolerance, tolerance).contains(meshingArea))
+        {
+            return false;
+        }
+
+        entry.lastAccess = PDFCacheManager::getAccessStamp();
+        mesh = entry.mesh;
+    }
+
+    if (!transform.isIdentity())
+    {
+        mesh.transform(transform);
+    }
+
+    return true;
+}
+
+void PDFMeshCache::insertMesh(const Key& key, const QTransform& patternSpaceToDeviceSpaceMatrix, const QRectF& deviceSpaceMeshingArea, PDFMesh mesh)
+{
+    if (!key.shading.isValid())
+    {
+        return;
+    }
+
+    const qint64 size = mesh.getMemoryConsumptionEstimate();
+
+    QMutexLocker lock(&m_mutex);
+
+    if (size > m_cacheLimit)
+    {
+        // Mesh is too large
+        return;
+    }
+
+    Entry& entry = m_entries[key];
+    m_cacheSize -= entry.size;
+    entry.mesh = qMove(mesh);
+    entry.patternSpaceToDeviceSpaceMatrix = patternSpaceToDeviceSpaceMatrix;
+    entry.deviceSpaceMeshingArea = deviceSpaceMeshingArea;
+    entry.size = size;
+    entry.lastAccess = PDFCacheManager::getAccessStamp();
+    m_cacheSize += size;
+
+    shrink();
+}
+
+void PDFMeshCache::removeDocument(quint64 documentId)
+{
+    QMutexLocker lock(&m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (it->first.documentId == documentId)
+        {
+            m_cacheSize -= it->second.size;
+            it = m_entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void PDFMeshCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_entries.clear();
+    m_cacheSize = 0;
+}
+
+void PDFMeshCache::setCacheLimit(qint64 cacheLimit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_cacheLimit = cacheLimit;
+    shrink();
+}
+
+qint64 PDFMeshCache::getCacheLimit() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheLimit;
+}
+
+qint64 PDFMeshCache::getCacheSize() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_cacheSize;
+}
+
+quint64 PDFMeshCache::getLeastRecentAccessStamp() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = std::min_element(m_entries.cbegin(), m_entries.cend(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+    return it != m_entries.cend() ? it->second.lastAccess : 0;
+}
+
+int PDFMeshCache::getRecreationCost() const
+{
+    return 2;
+}
+
+qint64 PDFMeshCache::evict(qint64 bytes)
+{
+    QMutexLocker lock(&m_mutex);
+
+    qint64 freed = 0;
+    while (freed < bytes && !m_entries.empty())
+    {
+        auto it = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+        freed += it->second.size;
+        m_cacheSize -= it->second.size;
+        m_entries.erase(it);
+    }
+
+    return freed;
+}
+
+void PDFMeshCache::shrink()
+{
+    while (m_cacheSize > m_cacheLimit && !m_entries.empty())
+    {
+        auto it = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& l, const auto& r) { return l.second.lastAccess < r.second.lastAccess; });
+        m_cacheSize -= it->second.size;
+        m_entries.erase(it);
+    }
+}
+
 }   // namespace pdf
@@ -23,10 +23,14 @@
 #include "pdfcolorspaces.h"
 #include "pdfmeshqualitysettings.h"
 #include "pdfcolorconvertor.h"
+#include "pdfcachemanager.h"
 
+#include <QMutex>
 #include <QTransform>
 #include <QPainterPath>
 
+#include <map>
+#include <tuple>
 #include <memory>
 
 namespace pdf
@@ -121,6 +125,10 @@ public:
     /// \param triangles Added triangle array
     void addMesh(std::vector<QPointF>&& vertices, std::vector<Triangle>&& triangles);
 
+    /// Merges the vertices/triangles of the other mesh to this mesh.
+    /// \param mesh Added mesh
+    void addMesh(PDFMesh&& mesh) { addMesh(qMove(mesh.m_vertices), qMove(mesh.m_triangles)); }
+
     /// Returns vertex at given index
     /// \param index Index of the vertex
     const QPointF& getVertex(size_t index) const { return m_vertices[index]; }
@@ -142,6 +150,9 @@ public:
     /// Returns true, if mesh is empty
     bool isEmpty() const { return m_vertices.empty(); }
 
+    /// Returns count of triangles of the mesh
+    size_t getTriangleCount() const { return m_triangles.size(); }
+
     /// Returns estimate of number of bytes, which this mesh occupies in memory
     qint64 getMemoryConsumptionEstimate() const;
 
@@ -149,6 +160,8 @@ public:
     void convertColors(const PDFColorConvertor& colorConvertor);
 
 private:
+    friend class PDFPrecompiledPage;
+
     std::vector<QPointF> m_vertices;
     std::vector<Triangle> m_triangles;
     QPainterPath m_boundingPath;
@@ -338,6 +351,13 @@ public:
     /// Returns true, if shading pattern should be anti-aliased
     bool isAntialiasing() const { return m_antiAlias; }
 
+    /// Returns dictionary of the shading, from which the pattern was created
+    const PDFDictionary* getShadingDictionary() const { return m_shadingDictionary; }
+
+    /// Returns reference of the shading, from which the pattern was created. If shading
+    /// is a direct object, then invalid reference is returned.
+    PDFObjectReference getShadingReference() const { return m_shadingReference; }
+
     /// Returns matrix transforming pattern space to device space
     QTransform getPatternSpaceToDeviceSpaceMatrix(const PDFMeshQualitySettings& settings) const;
 
@@ -358,6 +378,8 @@ protected:
     QColor m_backgroundColor;
     PDFColor m_originalBackgroundColor;
     bool m_antiAlias = false;
+    const PDFDictionary* m_shadingDictionary = nullptr;
+    PDFObjectReference m_shadingReference;
 };
 
 class PDFSingleDimensionShading : public PDFShadingPattern
@@ -373,6 +395,12 @@ public:
     bool isExtendStart() const { return m_extendStart; }
     bool isExtendEnd() const { return m_extendEnd; }
 
+    /// Returns lookup table approximating color functions on the shading domain
+    /// with given tolerance. Table is created on demand and it is cached. If color
+    /// functions can't be approximated, then nullptr is returned.
+    /// \param tolerance Color tolerance
+    PDFFunctionLookupTablePointer getFunctionLookupTable(PDFReal tolerance) const;
+
 protected:
     friend class PDFPattern;
 
@@ -383,6 +411,11 @@ protected:
     PDFReal m_domainEnd = 1.0;
     bool m_extendStart = false;
     bool m_extendEnd = false;
+
+private:
+    mutable QMutex m_functionLookupTableMutex;
+    mutable PDFReal m_functionLookupTableTolerance = -1.0;
+    mutable PDFFunctionLookupTablePointer m_functionLookupTable;
 };
 
 class PDFFunctionShading : public PDFShadingPattern
@@ -704,6 +737,10 @@ protected:
     void fillMesh(PDFMesh& mesh, const QTransform& patternSpaceToDeviceSpaceMatrix, const PDFMeshQualitySettings& settings, const PDFTensorPatches& patches, const PDFCMS* cms, RenderingIntent intent, PDFRenderErrorReporter* reporter, const PDFOperationControl* operationControl) const;
     static void addTriangle(std::vector<Triangle>& triangles, const PDFTensorPatch& patch, std::array<QPointF, 3> uvCoordinates);
 
+    /// Returns true, if triangle approximates the patch surface in the device space
+    /// within given tolerance (zero tolerance means that triangle is never flat).
+    static bool isFlat(const PDFTensorPatch& patch, const Triangle& triangle, PDFReal tolerance);
+
 private:
     friend class PDFPattern;
 };
@@ -742,6 +779,128 @@ private:
     friend class PDFPattern;
 };
 
+/// Process-wide cache of shading meshes. Mesh generation is expensive, so meshes
+/// are shared between page compilations and between small changes of the zoom.
+/// Mesh is stored together with pattern space to device space matrix and meshing
+/// area, for which it was generated. It is reused for another matrix, if scale of
+/// the matrix falls into the same bucket and meshing area is covered by the cached
+/// mesh (cached mesh is then transformed to the new device space). Cache is bounded
+/// by memory consumption of the meshes, least recently used meshes are removed
+/// first. Meshes are identified by unique identifier of the document (see
+/// PDFDocumentId) and by reference of the shading, they are removed from the cache,
+/// when identifier of the document is released. Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFMeshCache : public PDFManagedCache
+{
+public:
+    struct Key
+    {
+        quint64 documentId = 0;
+        PDFObjectReference shading;
+        const PDFDictionary* colorSpaceDictionary = nullptr; ///< Color space dictionary used to create color space of the shading (owned by the document)
+        quint64 cmsId = 0;
+        RenderingIntent renderingIntent = RenderingIntent::Perceptual;
+        QRgb backgroundColor = 0;
+        bool hasBackgroundColor = false;
+        int scaleBucket = 0;
+        PDFReal minimalMeshResolutionRatio = 0.0;
+        PDFReal preferredMeshResolutionRatio = 0.0;
+        PDFReal tolerance = 0.0;
+        bool approximateShadingFunctions = false;
+        PDFInteger patchTestPoints = 0;
+        PDFReal patchResolutionMappingRatioLow = 0.0;
+        PDFReal patchResolutionMappingRatioHigh = 0.0;
+        PDFReal patchFlatnessTolerance = 0.0;
+
+        bool operator<(const Key& other) const
+        {
+            return std::tie(documentId, shading, colorSpaceDictionary, cmsId, renderingIntent, backgroundColor, hasBackgroundColor, scaleBucket,
+                            minimalMeshResolutionRatio, preferredMeshResolutionRatio, tolerance, approximateShadingFunctions, patchTestPoints,
+                            patchResolutionMappingRatioLow, patchResolutionMappingRatioHigh, patchFlatnessTolerance) <
+                   std::tie(other.documentId, other.shading, other.colorSpaceDictionary, other.cmsId, other.renderingIntent, other.backgroundColor, other.hasBackgroundColor, other.scaleBucket,
+                            other.minimalMeshResolutionRatio, other.preferredMeshResolutionRatio, other.tolerance, other.approximateShadingFunctions, other.patchTestPoints,
+                            other.patchResolutionMappingRatioLow, other.patchResolutionMappingRatioHigh, other.patchFlatnessTolerance);
+        }
+    };
+
+    /// Returns instance of the mesh cache
+    static PDFMeshCache* getInstance();
+
+    /// Creates key of the mesh of the shading pattern. If mesh of the shading
+    /// pattern can't be cached (for example, shading is a direct object), then
+    /// key with invalid shading reference is returned.
+    /// \param document Document
+    /// \param shadingPattern Shading pattern
+    /// \param colorSpaceDictionary Color space dictionary used to create color space of the shading
+    /// \param settings Meshing settings
+    /// \param cms Color management system
+    /// \param intent Rendering intent
+    static Key createKey(const PDFDocument* document,
+                         const PDFShadingPattern* shadingPattern,
+                         const PDFDictionary* colorSpaceDictionary,
+                         const PDFMeshQualitySettings& settings,
+                         const PDFCMS* cms,
+                         RenderingIntent intent);
+
+    /// Finds mesh in the cache. If mesh is found, then true is returned
+    /// and mesh, transformed to the device space, is stored in \p mesh,
+    /// otherwise false is returned.
+    /// \param key Mesh key
+    /// \param patternSpaceToDeviceSpaceMatrix Pattern space to device space matrix
+    /// \param deviceSpaceMeshingArea Meshing area in device space
+    /// \param[out] mesh Cached mesh
+    bool findMesh(const Key& key, const QTransform& patternSpaceToDeviceSpaceMatrix, const QRectF& deviceSpaceMeshingArea, PDFMesh& mesh);
+
+    /// Inserts mesh into the cache. If mesh is too large, it is not inserted.
+    /// \param key Mesh key
+    /// \param patternSpaceToDeviceSpaceMatrix Pattern space to device space matrix, for which mesh was generated
+    /// \param deviceSpaceMeshingArea Meshing area in device space, for which mesh was generated
+    /// \param mesh Mesh
+    void insertMesh(const Key& key, const QTransform& patternSpaceToDeviceSpaceMatrix, const QRectF& deviceSpaceMeshingArea, PDFMesh mesh);
+
+    /// Removes all meshes of the document from the cache
+    /// \param documentId Unique identifier of the document
+    void removeDocument(quint64 documentId);
+
+    /// Removes all meshes from the cache
+    void clear();
+
+    /// Sets memory limit of the cache (in bytes)
+    void setCacheLimit(qint64 cacheLimit);
+
+    /// Returns memory limit of the cache (in bytes)
+    qint64 getCacheLimit() const;
+
+    /// Returns memory consumed by cached meshes (in bytes)
+    qint64 getCacheSize() const;
+
+    virtual qint64 getManagedCacheSize() const override { return getCacheSize(); }
+    virtual quint64 getLeastRecentAccessStamp() const override;
+    virtual int getRecreationCost() const override;
+    virtual qint64 evict(qint64 bytes) override;
+
+private:
+    explicit PDFMeshCache();
+    virtual ~PDFMeshCache() override;
+
+    struct Entry
+    {
+        PDFMesh mesh;
+        QTransform patternSpaceToDeviceSpaceMatrix;
+        QRectF deviceSpaceMeshingArea;
+        qint64 size = 0;
+        quint64 lastAccess = 0;
+    };
+
+    /// Removes least recently used meshes, until cache size is within the limit.
+    /// Mutex must be locked.
+    void shrink();
+
+    mutable QMutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    qint64 m_cacheLimit;
+    qint64 m_cacheSize = 0;
+};
+
 }   // namespace pdf
 
 #endif // PDFPATTERN_H
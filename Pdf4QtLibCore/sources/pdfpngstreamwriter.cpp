@@ -0,0 +1,442 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfpngstreamwriter.h"
+#include "pdfexecutionpolicy.h"
+
+#include <zlib.h>
+
+#include <vector>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+struct PDFPNGStreamWriter::ZStream
+{
+    z_stream stream = { };
+    bool initialized = false;
+};
+
+static void appendUInt32(QByteArray& data, quint32 value)
+{
+    data.append(char((value >> 24) & 0xFF));
+    data.append(char((value >> 16) & 0xFF));
+    data.append(char((value >> 8) & 0xFF));
+    data.append(char(value & 0xFF));
+}
+
+PDFPNGStreamWriter::PDFPNGStreamWriter(QString fileName, QSize size, int compressionLevel) :
+    m_file(fileName),
+    m_size(size),
+    m_compressionLevel(qBound(-1, compressionLevel, 9)),
+    m_stream(std::make_unique<ZStream>())
+{
+    if (m_size.isEmpty())
+    {
+        setError(PDFTranslationContext::tr("Invalid image size."));
+    }
+    else if (!m_file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        setError(PDFTranslationContext::tr("Can't open file '%1' for writing (%2).").arg(fileName, m_file.errorString()));
+    }
+}
+
+PDFPNGStreamWriter::~PDFPNGStreamWriter()
+{
+    if (m_stream->initialized)
+    {
+        deflateEnd(&m_stream->stream);
+    }
+}
+
+PDFOperationResult PDFPNGStreamWriter::write(QString fileName, const QImage& image, int compressionLevel, bool multithreadedCompression)
+{
+    PDFPNGStreamWriter writer(qMove(fileName), image.size(), compressionLevel);
+    writer.setMultithreadedCompression(multithreadedCompression);
+
+    if (!writer.writeBand(image) || !writer.finish())
+    {
+        return writer.getErrorMessage();
+    }
+
+    return true;
+}
+
+bool PDFPNGStreamWriter::writeBand(const QImage& band)
+{
+    if (hasError())
+    {
+        return false;
+    }
+
+    if (m_finished || band.width() != m_size.width() || m_writtenRows + band.height() > m_size.height())
+    {
+        setError(PDFTranslationContext::tr("Invalid image band."));
+        return false;
+    }
+
+    if (!m_headerWritten && !writeHeader(band.dotsPerMeterX(), band.dotsPerMeterY()))
+    {
+        return false;
+    }
+
+    if (m_multithreadedCompression)
+    {
+        if (!compressBandMultithreaded(band))
+        {
+            return false;
+        }
+
+        m_writtenRows += band.height();
+        return true;
+    }
+
+    // PNG stores non-premultiplied RGBA samples in byte order
+    QImage rgbaBand = band.convertToFormat(QImage::Format_RGBA8888);
+    const size_t rowSize = size_t(m_size.width()) * 4;
+    const uchar filterType = 0;
+
+    for (int y = 0; y < rgbaBand.height(); ++y)
+    {
+        if (!compress(&filterType, 1, false) || !compress(rgbaBand.constScanLine(y), rowSize, false))
+        {
+            return false;
+        }
+    }
+
+    m_writtenRows += rgbaBand.height();
+    return true;
+}
+
+bool PDFPNGStreamWriter::finish()
+{
+    if (hasError())
+    {
+        return false;
+    }
+
+    if (m_finished || m_writtenRows != m_size.height())
+    {
+        setError(PDFTranslationContext::tr("Image is not complete, %1 of %2 rows were written.").arg(m_writtenRows).arg(m_size.height()));
+        return false;
+    }
+
+    if (m_multithreadedCompression)
+    {
+        // Compressed chunks end with non-final blocks, so stream is terminated
+        // by empty final block with fixed codes, then Adler-32 checksum follows.
+        QByteArray trailer;
+        trailer.append(char(0x03));
+        trailer.append(char(0x00));
+        appendUInt32(trailer, m_adler32);
+
+        if (!writeCompressedData(trailer, true))
+        {
+            return false;
+        }
+    }
+    else if (!compress(nullptr, 0, true))
+    {
+        return false;
+    }
+
+    if (!writeChunk("IEND", QByteArray()))
+    {
+        return false;
+    }
+
+    m_finished = true;
+    m_file.close();
+    return !hasError();
+}
+
+bool PDFPNGStreamWriter::writeHeader(int dotsPerMeterX, int dotsPerMeterY)
+{
+    m_headerWritten = true;
+
+    if (m_multithreadedCompression)
+    {
+        // Header of the zlib stream is written by us, compression level
+        // is stored only as information for the decompressor.
+        int levelFlags = 0x9C;
+        if (m_compressionLevel >= 0 && m_compressionLevel <= 1)
+        {
+            levelFlags = 0x01;
+        }
+        else if (m_compressionLevel >= 2 && m_compressionLevel <= 5)
+        {
+            levelFlags = 0x5E;
+        }
+        else if (m_compressionLevel >= 7)
+        {
+            levelFlags = 0xDA;
+        }
+
+        m_buffer.clear();
+        m_buffer.append(char(0x78));
+        m_buffer.append(char(levelFlags));
+        m_adler32 = quint32(adler32(0L, Z_NULL, 0));
+    }
+    else
+    {
+        if (deflateInit(&m_stream->stream, m_compressionLevel) != Z_OK)
+        {
+            setError(PDFTranslationContext::tr("Can't initialize zlib compression."));
+            return false;
+        }
+
+        m_stream->initialized = true;
+        m_buffer.resize(CHUNK_SIZE);
+        m_stream->stream.next_out = reinterpret_cast<Bytef*>(m_buffer.data());
+        m_stream->stream.avail_out = CHUNK_SIZE;
+    }
+
+    static constexpr const char signature[] = { char(0x89), 'P', 'N', 'G', '\r', '\n', char(0x1A), '\n' };
+    if (m_file.write(signature, sizeof(signature)) != qint64(sizeof(signature)))
+    {
+        setError(PDFTranslationContext::tr("Can't write to file '%1' (%2).").arg(m_file.fileName(), m_file.errorString()));
+        return false;
+    }
+
+    // Header - 8 bits per sample, truecolor with alpha, no interlacing
+    QByteArray header;
+    appendUInt32(header, quint32(m_size.width()));
+    appendUInt32(header, quint32(m_size.height()));
+    header.append(char(8));
+    header.append(char(6));
+    header.append(char(0));
+    header.append(char(0));
+    header.append(char(0));
+
+    if (!writeChunk("IHDR", header))
+    {
+        return false;
+    }
+
+    if (dotsPerMeterX > 0 && dotsPerMeterY > 0)
+    {
+        QByteArray physicalDimensions;
+        appendUInt32(physicalDimensions, quint32(dotsPerMeterX));
+        appendUInt32(physicalDimensions, quint32(dotsPerMeterY));
+        physicalDimensions.append(char(1));
+
+        if (!writeChunk("pHYs", physicalDimensions))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PDFPNGStreamWriter::compress(const uchar* data, size_t size, bool finish)
+{
+    z_stream& stream = m_stream->stream;
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = uInt(size);
+
+    const int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+    int error = Z_OK;
+
+    do
+    {
+        error = deflate(&stream, flush);
+
+        if (error == Z_STREAM_ERROR)
+        {
+            setError(PDFTranslationContext::tr("zlib code: %1").arg(error));
+            return false;
+        }
+
+        const bool isStreamEnd = error == Z_STREAM_END;
+        if (stream.avail_out == 0 || (isStreamEnd && stream.avail_out < uInt(CHUNK_SIZE)))
+        {
+            if (!writeChunk("IDAT", m_buffer.left(CHUNK_SIZE - stream.avail_out)))
+            {
+                return false;
+            }
+
+            stream.next_out = reinterpret_cast<Bytef*>(m_buffer.data());
+            stream.avail_out = CHUNK_SIZE;
+        }
+    }
+    while (stream.avail_in > 0 || (finish && error != Z_STREAM_END));
+
+    return true;
+}
+
+bool PDFPNGStreamWriter::compressBandMultithreaded(const QImage& band)
+{
+    struct Chunk
+    {
+        int top = 0;
+        int rowCount = 0;
+        size_t size = 0;
+        quint32 adler32 = 1;
+        bool isCompressed = false;
+        QByteArray data;
+    };
+
+    const size_t rowSize = size_t(m_size.width()) * 4;
+    const int chunkRowCount = int(qMax(PARALLEL_COMPRESSION_MIN_SIZE / (rowSize + 1), size_t(1)));
+
+    std::vector<Chunk> chunks;
+    for (int top = 0; top < band.height(); top += chunkRowCount)
+    {
+        Chunk chunk;
+        chunk.top = top;
+        chunk.rowCount = qMin(chunkRowCount, band.height() - top);
+        chunk.size = size_t(chunk.rowCount) * (rowSize + 1);
+        chunks.push_back(qMove(chunk));
+    }
+
+    // Each chunk is compressed as raw deflate data ending with sync flush,
+    // so compressed chunks can be concatenated into one zlib stream.
+    auto compressChunk = [&, this](Chunk& chunk)
+    {
+        // PNG stores non-premultiplied RGBA samples in byte order
+        const QImage chunkImage(band.constScanLine(chunk.top), band.width(), chunk.rowCount, band.bytesPerLine(), band.format());
+        const QImage rgbaChunk = chunkImage.convertToFormat(QImage::Format_RGBA8888);
+
+        z_stream stream = { };
+        if (deflateInit2(&stream, m_compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            return;
+        }
+
+        qsizetype compressedSize = 0;
+        chunk.data.resize(qsizetype(deflateBound(&stream, uLong(chunk.size))) + 64);
+
+        auto deflateData = [&](const uchar* data, size_t size, int flush)
+        {
+            stream.next_in = const_cast<Bytef*>(data);
+            stream.avail_in = uInt(size);
+
+            do
+            {
+                if (compressedSize == chunk.data.size())
+                {
+                    chunk.data.resize(chunk.data.size() * 2);
+                }
+
+                stream.next_out = reinterpret_cast<Bytef*>(chunk.data.data() + compressedSize);
+                stream.avail_out = uInt(chunk.data.size() - compressedSize);
+
+                const int error = deflate(&stream, flush);
+                compressedSize = chunk.data.size() - stream.avail_out;
+
+                if (error == Z_STREAM_ERROR)
+                {
+                    return false;
+                }
+            }
+            while (stream.avail_in > 0 || stream.avail_out == 0);
+
+            return true;
+        };
+
+        const uchar filterType = 0;
+        uLong adler = adler32(0L, Z_NULL, 0);
+        bool isCompressed = true;
+
+        for (int y = 0; y < rgbaChunk.height() && isCompressed; ++y)
+        {
+            const uchar* row = rgbaChunk.constScanLine(y);
+            adler = adler32(adler, &filterType, 1);
+            adler = adler32(adler, row, uInt(rowSize));
+            isCompressed = deflateData(&filterType, 1, Z_NO_FLUSH) && deflateData(row, rowSize, Z_NO_FLUSH);
+        }
+
+        isCompressed = isCompressed && deflateData(nullptr, 0, Z_SYNC_FLUSH);
+        deflateEnd(&stream);
+
+        chunk.data.resize(compressedSize);
+        chunk.adler32 = quint32(adler);
+        chunk.isCompressed = isCompressed;
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, chunks.begin(), chunks.end(), compressChunk);
+
+    for (const Chunk& chunk : chunks)
+    {
+        if (!chunk.isCompressed)
+        {
+            setError(PDFTranslationContext::tr("Can't compress image data using zlib."));
+            return false;
+        }
+
+        m_adler32 = quint32(adler32_combine(m_adler32, chunk.adler32, z_off_t(chunk.size)));
+
+        if (!writeCompressedData(chunk.data, false))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PDFPNGStreamWriter::writeCompressedData(const QByteArray& data, bool finish)
+{
+    m_buffer.append(data);
+
+    qsizetype offset = 0;
+    while (m_buffer.size() - offset >= CHUNK_SIZE || (finish && offset < m_buffer.size()))
+    {
+        const qsizetype size = qMin(qsizetype(CHUNK_SIZE), m_buffer.size() - offset);
+        if (!writeChunk("IDAT", m_buffer.mid(offset, size)))
+        {
+            return false;
+        }
+        offset += size;
+    }
+
+    m_buffer.remove(0, offset);
+    return true;
+}
+
+bool PDFPNGStreamWriter::writeChunk(const char* type, const QByteArray& data)
+{
+    QByteArray chunk;
+    chunk.reserve(data.size() + 12);
+    appendUInt32(chunk, quint32(data.size()));
+    chunk.append(type, 4);
+    chunk.append(data);
+
+    // CRC is computed from chunk type and chunk data
+    const uLong crc = crc32(0, reinterpret_cast<const Bytef*>(chunk.constData() + 4), uInt(chunk.size() - 4));
+    appendUInt32(chunk, quint32(crc));
+
+    if (m_file.write(chunk) != chunk.size())
+    {
+        setError(PDFTranslationContext::tr("Can't write to file '%1' (%2).").arg(m_file.fileName(), m_file.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+void PDFPNGStreamWriter::setError(QString errorMessage)
+{
+    if (m_errorMessage.isEmpty())
+    {
+        m_errorMessage = qMove(errorMessage);
+    }
+}
+
+}   // namespace pdf
@@ -0,0 +1,137 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFPNGSTREAMWRITER_H
+#define PDFPNGSTREAMWRITER_H
+
+#include "pdfglobal.h"
+#include "pdfutils.h"
+
+#include <QFile>
+#include <QSize>
+#include <QImage>
+#include <QString>
+#include <QByteArray>
+
+#include <memory>
+
+namespace pdf
+{
+
+/// Writes PNG image to the file incrementally, images are passed to the writer
+/// as horizontal bands (from top to bottom). So, whole image is never held in
+/// the memory, only the current band. Image is stored as 8-bit RGBA image,
+/// rows are compressed using zlib as they arrive. If multithreaded compression
+/// is enabled, rows of each band are divided into chunks, which are compressed
+/// in parallel as separate deflate blocks of one zlib stream.
+class PDF4QTLIBCORESHARED_EXPORT PDFPNGStreamWriter
+{
+public:
+    /// Creates writer of the image of given size
+    /// \param fileName File name of the target image
+    /// \param size Size of the whole image
+    /// \param compressionLevel Compression level (0-9, -1 is default compression)
+    explicit PDFPNGStreamWriter(QString fileName, QSize size, int compressionLevel = -1);
+    ~PDFPNGStreamWriter();
+
+    PDFPNGStreamWriter(const PDFPNGStreamWriter&) = delete;
+    PDFPNGStreamWriter& operator=(const PDFPNGStreamWriter&) = delete;
+
+    /// Enables multithreaded compression of the image rows. Chunks of rows are
+    /// compressed independently (without sharing the compression dictionary),
+    /// so the compressed image can be slightly larger. It must be set before
+    /// the first band is written.
+    /// \param multithreadedCompression Enable multithreaded compression
+    void setMultithreadedCompression(bool multithreadedCompression) { m_multithreadedCompression = multithreadedCompression; }
+
+    /// Writes whole image to the PNG file. Image is written as one band,
+    /// so this function is suitable for images, which are already in the memory.
+    /// \param fileName File name of the target image
+    /// \param image Image
+    /// \param compressionLevel Compression level (0-9, -1 is default compression)
+    /// \param multithreadedCompression Compress rows of the image in parallel
+    static PDFOperationResult write(QString fileName, const QImage& image, int compressionLevel, bool multithreadedCompression);
+
+    /// Writes band of the image. Band must have the same width as the image.
+    /// Resolution (dots per meter) of the first band is stored as resolution
+    /// of the image. Returns false, if error occurs.
+    /// \param band Band of the image
+    bool writeBand(const QImage& band);
+
+    /// Finishes writing of the image, all rows of the image must be
+    /// written. Returns false, if error occurs.
+    bool finish();
+
+    /// Returns true, if error occured
+    bool hasError() const { return !m_errorMessage.isEmpty(); }
+
+    const QString& getErrorMessage() const { return m_errorMessage; }
+
+private:
+    struct ZStream;
+
+    /// Writes PNG signature and header chunks with given resolution
+    bool writeHeader(int dotsPerMeterX, int dotsPerMeterY);
+
+    /// Compresses data and writes compressed data as IDAT chunks
+    /// \param data Data
+    /// \param size Size of the data
+    /// \param finish Finish the compressed stream
+    bool compress(const uchar* data, size_t size, bool finish);
+
+    /// Compresses rows of the band in parallel and writes compressed
+    /// data as IDAT chunks (multithreaded compression only)
+    /// \param band Band of the image
+    bool compressBandMultithreaded(const QImage& band);
+
+    /// Appends compressed data and writes full IDAT chunks, if \p finish
+    /// is true, then all remaining data are written (multithreaded compression only)
+    /// \param data Compressed data
+    /// \param finish Write all remaining data
+    bool writeCompressedData(const QByteArray& data, bool finish);
+
+    /// Writes PNG chunk to the file
+    /// \param type Chunk type
+    /// \param data Chunk data
+    bool writeChunk(const char* type, const QByteArray& data);
+
+    void setError(QString errorMessage);
+
+    /// Size of the compressed data buffer (IDAT chunk size)
+    static constexpr int CHUNK_SIZE = 256 * 1024;
+
+    /// Minimal size of the uncompressed data compressed by one
+    /// thread (multithreaded compression only)
+    static constexpr size_t PARALLEL_COMPRESSION_MIN_SIZE = 1024 * 1024;
+
+    QFile m_file;
+    QSize m_size;
+    int m_compressionLevel;
+    int m_writtenRows = 0;
+    bool m_headerWritten = false;
+    bool m_finished = false;
+    bool m_multithreadedCompression = false;
+    quint32 m_adler32 = 1;
+    QByteArray m_row;
+    QByteArray m_buffer;
+    std::unique_ptr<ZStream> m_stream;
+    QString m_errorMessage;
+};
+
+}   // namespace pdf
+
+#endif // PDFPNGSTREAMWRITER_H
@@ -0,0 +1,292 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfrandomaccesssource.h"
+
+#include <QIODevice>
+
+#include <cstring>
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+bool PDFRandomAccessSource::fetchRange(qint64 offset, qint64 length, QByteArray& data)
+{
+    QMutex mutex;
+    QWaitCondition waitCondition;
+    bool finished = false;
+    bool result = false;
+
+    auto callback = [&](bool ok, QByteArray fetchedData)
+    {
+        QMutexLocker lock(&mutex);
+        result = ok;
+        data = qMove(fetchedData);
+        finished = true;
+        waitCondition.wakeAll();
+    };
+    requestRange(offset, length, callback);
+
+    QMutexLocker lock(&mutex);
+    while (!finished)
+    {
+        waitCondition.wait(&mutex);
+    }
+
+    return result;
+}
+
+PDFDeviceRandomAccessSource::PDFDeviceRandomAccessSource(QIODevice* device) :
+    m_device(device)
+{
+
+}
+
+qint64 PDFDeviceRandomAccessSource::getSize()
+{
+    QMutexLocker lock(&m_mutex);
+    return m_device->size();
+}
+
+void PDFDeviceRandomAccessSource::requestRange(qint64 offset, qint64 length, Callback callback)
+{
+    QByteArray data;
+    bool ok = false;
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (offset >= 0 && length >= 0 && offset + length <= m_device->size() && m_device->seek(offset))
+        {
+            data = m_device->read(length);
+            ok = data.size() == length;
+            m_bytesRead += data.size();
+        }
+    }
+
+    callback(ok, qMove(data));
+}
+
+qint64 PDFDeviceRandomAccessSource::getBytesRead() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_bytesRead;
+}
+
+PDFRandomAccessSourceCache::PDFRandomAccessSourceCache(PDFRandomAccessSourcePointer source, qint64 size) :
+    m_source(qMove(source)),
+    m_data(nullptr),
+    m_size(qMax(size, qint64(0)))
+{
+    // Resized file is not filled with data, memory is then used only
+    // by the pages of the mapped file, which are actually written.
+    if (m_size > 0 && m_file.open() && m_file.resize(m_size))
+    {
+        m_data = reinterpret_cast<char*>(m_file.map(0, m_size));
+    }
+
+    if (!m_data)
+    {
+        m_size = 0;
+    }
+
+    m_blocks.resize((m_size + BLOCK_SIZE - 1) / BLOCK_SIZE, BlockState::Missing);
+}
+
+PDFRandomAccessSourceCache::~PDFRandomAccessSourceCache()
+{
+    // Pending requests hold only weak reference to the cache, so
+    // they can't write into the data after the cache is destroyed.
+    if (m_data)
+    {
+        m_file.unmap(reinterpret_cast<uchar*>(m_data));
+    }
+}
+
+QByteArray PDFRandomAccessSourceCache::getData() const
+{
+    return QByteArray::fromRawData(m_data, m_size);
+}
+
+qint64 PDFRandomAccessSourceCache::getFetchedBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_fetchedBytes;
+}
+
+bool PDFRandomAccessSourceCache::isRangeAvailable(qint64 offset, qint64 length) const
+{
+    QMutexLocker lock(&m_mutex);
+    return isRangesInState({ Range(offset, length) }, BlockState::Fetched, false);
+}
+
+bool PDFRandomAccessSourceCache::ensureRanges(const std::vector<Range>& ranges)
+{
+    // Each missing block is requested at most twice, if second request
+    // also fails, then we give up and report the failure.
+    constexpr int MAX_ATTEMPTS = 2;
+    int attempt = 0;
+
+    QMutexLocker lock(&m_mutex);
+    while (!isRangesInState(ranges, BlockState::Fetched, false))
+    {
+        if (isRangesInState(ranges, BlockState::Missing, true))
+        {
+            if (attempt++ == MAX_ATTEMPTS)
+            {
+                return false;
+            }
+
+            std::vector<Range> requests = createRequests(ranges);
+            lock.unlock();
+            sendRequests(requests);
+            lock.relock();
+            continue;
+        }
+
+        m_blocksChanged.wait(&m_mutex);
+    }
+
+    return true;
+}
+
+void PDFRandomAccessSourceCache::prefetchRanges(const std::vector<Range>& ranges)
+{
+    QMutexLocker lock(&m_mutex);
+    std::vector<Range> requests = createRequests(ranges);
+    lock.unlock();
+    sendRequests(requests);
+}
+
+std::vector<PDFRandomAccessSourceCache::Range> PDFRandomAccessSourceCache::createRequests(const std::vector<Range>& ranges)
+{
+    std::vector<Range> requests;
+
+    for (const Range& range : ranges)
+    {
+        const qint64 offset = qBound(qint64(0), range.first, m_size);
+        const qint64 end = qBound(offset, range.first + range.second, m_size);
+        if (offset == end)
+        {
+            continue;
+        }
+
+        const qint64 firstBlock = offset / BLOCK_SIZE;
+        const qint64 lastBlock = (end - 1) / BLOCK_SIZE;
+
+        // Consecutive missing blocks are merged into one request
+        qint64 requestFirstBlock = -1;
+        for (qint64 block = firstBlock; block <= lastBlock + 1; ++block)
+        {
+            const bool isMissing = block <= lastBlock && m_blocks[block] == BlockState::Missing;
+            if (isMissing)
+            {
+                m_blocks[block] = BlockState::Pending;
+
+                if (requestFirstBlock == -1)
+                {
+                    requestFirstBlock = block;
+                }
+            }
+            else if (requestFirstBlock != -1)
+            {
+                const qint64 requestOffset = requestFirstBlock * BLOCK_SIZE;
+                const qint64 requestEnd = qMin(block * BLOCK_SIZE, m_size);
+                requests.emplace_back(requestOffset, requestEnd - requestOffset);
+                requestFirstBlock = -1;
+            }
+        }
+    }
+
+    return requests;
+}
+
+void PDFRandomAccessSourceCache::sendRequests(const std::vector<Range>& requests)
+{
+    std::weak_ptr<PDFRandomAccessSourceCache> weakThis = weak_from_this();
+    Q_ASSERT(!weakThis.expired());
+
+    for (const Range& request : requests)
+    {
+        const qint64 offset = request.first;
+        const qint64 length = request.second;
+        m_source->requestRange(offset, length, [weakThis, offset, length](bool ok, QByteArray data)
+        {
+            if (std::shared_ptr<PDFRandomAccessSourceCache> cache = weakThis.lock())
+            {
+                cache->onRangeFetched(offset, length, ok, data);
+            }
+        });
+    }
+}
+
+bool PDFRandomAccessSourceCache::isRangesInState(const std::vector<Range>& ranges, BlockState state, bool anyBlock) const
+{
+    for (const Range& range : ranges)
+    {
+        const qint64 offset = qBound(qint64(0), range.first, m_size);
+        const qint64 end = qBound(offset, range.first + range.second, m_size);
+        if (offset == end)
+        {
+            continue;
+        }
+
+        const qint64 firstBlock = offset / BLOCK_SIZE;
+        const qint64 lastBlock = (end - 1) / BLOCK_SIZE;
+        for (qint64 block = firstBlock; block <= lastBlock; ++block)
+        {
+            const bool isInState = m_blocks[block] == state;
+            if (anyBlock && isInState)
+            {
+                return true;
+            }
+            if (!anyBlock && !isInState)
+            {
+                return false;
+            }
+        }
+    }
+
+    return !anyBlock;
+}
+
+void PDFRandomAccessSourceCache::onRangeFetched(qint64 offset, qint64 length, bool ok, const QByteArray& data)
+{
+    Q_ASSERT(offset % BLOCK_SIZE == 0);
+
+    QMutexLocker lock(&m_mutex);
+
+    ok = ok && data.size() == length && offset + length <= m_size;
+    if (ok)
+    {
+        std::memcpy(m_data + offset, data.constData(), length);
+        m_fetchedBytes += length;
+    }
+
+    const qint64 firstBlock = offset / BLOCK_SIZE;
+    const qint64 lastBlock = (offset + length - 1) / BLOCK_SIZE;
+    for (qint64 block = firstBlock; block <= lastBlock && block < qint64(m_blocks.size()); ++block)
+    {
+        m_blocks[block] = ok ? BlockState::Fetched : BlockState::Missing;
+    }
+
+    m_blocksChanged.wakeAll();
+}
+
+}   // namespace pdf
@@ -0,0 +1,192 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFRANDOMACCESSSOURCE_H
+#define PDFRANDOMACCESSSOURCE_H
+
+#include "pdfglobal.h"
+
+#include <QMutex>
+#include <QByteArray>
+#include <QWaitCondition>
+#include <QTemporaryFile>
+
+#include <memory>
+#include <vector>
+#include <functional>
+
+class QIODevice;
+
+namespace pdf
+{
+
+/// Random access source of document data. Ranges of data are requested
+/// asynchronously, so more ranges can be fetched concurrently (for example,
+/// by HTTP range requests). Implementations must be thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFRandomAccessSource
+{
+public:
+    explicit PDFRandomAccessSource() = default;
+    virtual ~PDFRandomAccessSource() = default;
+
+    /// Callback, which is called, when range is fetched. If fetching
+    /// of the range failed, then \p ok is false. Callback can be called
+    /// from arbitrary thread, even before requestRange returns.
+    using Callback = std::function<void(bool ok, QByteArray data)>;
+
+    /// Returns total size of the source data in bytes. Function blocks,
+    /// until size is determined. If size can't be determined, -1 is returned.
+    virtual qint64 getSize() = 0;
+
+    /// Returns identity of the source data (for example, entity tag of the
+    /// HTTP resource), which changes, when source data are changed. It is used
+    /// to identify the document in persistent caches, because source data are
+    /// not available completely. If identity can't be determined, empty byte
+    /// array is returned, and document is then not cached persistently.
+    virtual QByteArray getIdentity() { return QByteArray(); }
+
+    /// Requests range of the source data asynchronously.
+    /// \param offset Offset of the range
+    /// \param length Length of the range
+    /// \param callback Callback called, when range is fetched
+    virtual void requestRange(qint64 offset, qint64 length, Callback callback) = 0;
+
+    /// Fetches range of the source data, function blocks, until
+    /// data are fetched. Returns false, if data can't be fetched.
+    /// \param offset Offset of the range
+    /// \param length Length of the range
+    /// \param[out] data Fetched data
+    bool fetchRange(qint64 offset, qint64 length, QByteArray& data);
+};
+
+using PDFRandomAccessSourcePointer = std::shared_ptr<PDFRandomAccessSource>;
+
+/// Random access source reading data from the device (file, buffer, ...).
+/// Device must be opened for reading and remain valid during the
+/// lifetime of the source.
+class PDF4QTLIBCORESHARED_EXPORT PDFDeviceRandomAccessSource : public PDFRandomAccessSource
+{
+public:
+    explicit PDFDeviceRandomAccessSource(QIODevice* device);
+
+    virtual qint64 getSize() override;
+    virtual void requestRange(qint64 offset, qint64 length, Callback callback) override;
+
+    /// Returns count of bytes read from the device
+    qint64 getBytesRead() const;
+
+private:
+    mutable QMutex m_mutex;
+    QIODevice* m_device;
+    qint64 m_bytesRead = 0;
+};
+
+/// Cache of the random access source data. Blocks of data are fetched from
+/// the source on demand. Data are stored in the memory mapped temporary file
+/// of the size of the source data, so memory is consumed only by fetched
+/// blocks (data, which were not fetched, are holes in the file, which are
+/// read as zeros), and operating system can page out fetched blocks. Data can
+/// be accessed as a contiguous byte array, so they can be parsed as usual.
+/// Class is thread safe. Cache must be created using std::make_shared,
+/// because pending requests hold weak reference to the cache.
+class PDF4QTLIBCORESHARED_EXPORT PDFRandomAccessSourceCache : public std::enable_shared_from_this<PDFRandomAccessSourceCache>
+{
+public:
+    explicit PDFRandomAccessSourceCache(PDFRandomAccessSourcePointer source, qint64 size);
+    ~PDFRandomAccessSourceCache();
+
+    PDFRandomAccessSourceCache(const PDFRandomAccessSourceCache&) = delete;
+    PDFRandomAccessSourceCache& operator=(const PDFRandomAccessSourceCache&) = delete;
+
+    using Range = std::pair<qint64, qint64>;
+
+    /// Returns source data. Data, which were not fetched yet,
+    /// are zero. Data are valid during the lifetime of the cache.
+    QByteArray getData() const;
+
+    /// Returns size of the source data. If temporary file for source
+    /// data can't be created, then size is zero.
+    qint64 getSize() const { return m_size; }
+
+    /// Returns identity of the source data (see PDFRandomAccessSource::getIdentity)
+    QByteArray getIdentity() const { return m_source->getIdentity(); }
+
+    /// Returns count of bytes fetched from the source
+    qint64 getFetchedBytes() const;
+
+    /// Returns true, if given range is already fetched
+    /// \param offset Offset of the range
+    /// \param length Length of the range
+    bool isRangeAvailable(qint64 offset, qint64 length) const;
+
+    /// Ensures, that given range is fetched. Function blocks, until range is
+    /// fetched. Returns false, if range can't be fetched.
+    /// \param offset Offset of the range
+    /// \param length Length of the range
+    bool ensureRange(qint64 offset, qint64 length) { return ensureRanges({ Range(offset, length) }); }
+
+    /// Ensures, that given ranges are fetched. Missing ranges are requested
+    /// concurrently, function blocks, until all ranges are fetched. Returns
+    /// false, if some range can't be fetched.
+    /// \param ranges Ranges (offset, length)
+    bool ensureRanges(const std::vector<Range>& ranges);
+
+    /// Requests given ranges, but doesn't wait, until they are fetched
+    /// \param ranges Ranges (offset, length)
+    void prefetchRanges(const std::vector<Range>& ranges);
+
+private:
+    /// Block is a minimal unit fetched from the source
+    static constexpr qint64 BLOCK_SIZE = 4096;
+
+    enum class BlockState : uint8_t
+    {
+        Missing,
+        Pending,
+        Fetched
+    };
+
+    /// Marks missing blocks of ranges as pending and returns list of requests
+    /// (offset, length), for which requests must be sent. Mutex must be locked.
+    std::vector<Range> createRequests(const std::vector<Range>& ranges);
+
+    /// Sends requests to the source. Mutex must not be locked.
+    void sendRequests(const std::vector<Range>& requests);
+
+    /// Returns true, if all blocks (or any block, if \p anyBlock is true)
+    /// of the ranges are in given state. Mutex must be locked.
+    bool isRangesInState(const std::vector<Range>& ranges, BlockState state, bool anyBlock) const;
+
+    /// Processes fetched range, called from the source callback
+    void onRangeFetched(qint64 offset, qint64 length, bool ok, const QByteArray& data);
+
+    PDFRandomAccessSourcePointer m_source;
+    QTemporaryFile m_file;
+    char* m_data;
+    qint64 m_size;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_blocksChanged;
+    std::vector<BlockState> m_blocks;
+    qint64 m_fetchedBytes = 0;
+};
+
+using PDFRandomAccessSourceCachePointer = std::shared_ptr<PDFRandomAccessSourceCache>;
+
+}   // namespace pdf
+
+#endif // PDFRANDOMACCESSSOURCE_H
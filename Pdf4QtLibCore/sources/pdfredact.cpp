@@ -19,11 +19,533 @@
 #include "pdfpainter.h"
 #include "pdfdocumentbuilder.h"
 #include "pdfoptimizer.h"
+#include "pdfstreamfilters.h"
+#include "pdfpagecontentprocessor.h"
+#include "pdffont.h"
+#include "pdfparser.h"
 #include "pdfdbgheap.h"
 
+#include <algorithm>
+
 namespace pdf
 {
 
+/// Formats number for the content stream
+static QByteArray formatNumber(PDFReal value)
+{
+    return QString::number(value, 'f', 5).toLatin1();
+}
+
+/// Content processor, which finds operators of the page content streams, whose
+/// painting intersects the redaction region, and creates edits of these operators.
+/// Path painting operators are replaced by 'n' operator, images and shadings are
+/// removed and glyphs are removed from text showing operators. If content intersecting
+/// the redaction region can't be removed this way (for example, it is painted by
+/// form XObject, or by Type 3 font), then editing fails.
+class PDFRedactContentStreamEditor : public PDFPageContentProcessor
+{
+    using BaseClass = PDFPageContentProcessor;
+
+public:
+    explicit PDFRedactContentStreamEditor(const PDFPage* page,
+                                          const PDFDocument* document,
+                                          const PDFFontCache* fontCache,
+                                          const PDFCMS* cms,
+                                          const PDFMeshQualitySettings* meshQualitySettings,
+                                          const std::vector<QByteArray>* contentStreams,
+                                          QPainterPath redactPath) :
+        // Jakub Melka: optional content activity is not used, because hidden
+        // content intersecting the redaction region must be removed too.
+        BaseClass(page, document, fontCache, cms, nullptr, QTransform(), *meshQualitySettings),
+        m_contentStreams(contentStreams),
+        m_redactPath(qMove(redactPath)),
+        m_redactBoundingRect(m_redactPath.boundingRect())
+    {
+
+    }
+
+    /// Processes page content streams and creates edits. Returns false,
+    /// if content streams can't be edited.
+    bool process();
+
+    /// Returns edited page content (all page content streams are joined)
+    QByteArray getEditedContent() const;
+
+protected:
+    virtual void performPageContentOperator(PDFInteger streamIndex, PDFInteger operatorStart, PDFInteger operatorEnd, const QByteArray& command) override;
+    virtual void performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule) override;
+    virtual bool performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern) override;
+    virtual void performClipping(const QPainterPath& path, Qt::FillRule fillRule) override;
+    virtual bool performImageStreamPainting(const PDFStream* stream) override;
+    virtual void performSaveGraphicState(ProcessOrder order) override;
+    virtual void performRestoreGraphicState(ProcessOrder order) override;
+    virtual bool performPaintFormInstance(const PDFStream* formStream) override;
+    virtual void performFormProcessed(const PDFStream* formStream) override;
+
+private:
+    struct Edit
+    {
+        PDFInteger streamIndex = 0;
+        PDFInteger start = 0;
+        PDFInteger end = 0;
+        QByteArray replacement;
+    };
+
+    struct ClipState
+    {
+        bool isClipped = false;
+        QRectF clipRect;
+    };
+
+    /// Marks current operator as painted, if painted area (in user space
+    /// of the current graphic state) intersects the redaction region.
+    /// \param path Painted path
+    /// \param stroke Is path stroked?
+    void addPaintedArea(const QPainterPath& path, bool stroke);
+
+    /// Creates edit of the current operator, if its painting intersects
+    /// the redaction region. If operator can't be edited, then editing fails.
+    void finishOperator();
+
+    /// Removes glyphs intersecting the redaction region from the text showing
+    /// operator. Returns false, if glyph positions can't be determined (then
+    /// operator is treated as generic painting operator).
+    /// \param command Text showing operator
+    /// \param operands Operands of the operator
+    /// \param[out] replacement Replacement of the operator (empty, if no glyph is removed)
+    bool editTextOperator(const QByteArray& command, const std::vector<PDFLexicalAnalyzer::Token>& operands, QByteArray& replacement) const;
+
+    const std::vector<QByteArray>* m_contentStreams;
+    QPainterPath m_redactPath;
+    QRectF m_redactBoundingRect;
+    std::vector<Edit> m_edits;
+    bool m_failed = false;
+
+    // Currently processed operator of the page content stream
+    PDFInteger m_streamIndex = -1;
+    PDFInteger m_operatorStart = 0;
+    PDFInteger m_operatorEnd = 0;
+    QByteArray m_command;
+    bool m_isTextEdited = false;
+    bool m_isPainted = false;
+    bool m_isPaintedInForm = false;
+
+    int m_formNestingLevel = 0;
+    ClipState m_clipState;
+    std::vector<ClipState> m_clipStateStack;
+};
+
+bool PDFRedactContentStreamEditor::process()
+{
+    QList<PDFRenderError> errors = processContents();
+    finishOperator();
+
+    // Content, which was not processed due to errors, can't be checked
+    // against the redaction region, so we do not edit such page.
+    for (const PDFRenderError& error : errors)
+    {
+        if (error.type == RenderErrorType::Error)
+        {
+            return false;
+        }
+    }
+
+    return !m_failed;
+}
+
+QByteArray PDFRedactContentStreamEditor::getEditedContent() const
+{
+    QByteArray result;
+
+    auto it = m_edits.cbegin();
+    for (PDFInteger i = 0, count = PDFInteger(m_contentStreams->size()); i < count; ++i)
+    {
+        const QByteArray& content = (*m_contentStreams)[i];
+        PDFInteger position = 0;
+
+        for (; it != m_edits.cend() && it->streamIndex == i; ++it)
+        {
+            result.append(content.mid(position, it->start - position));
+            result.append(' ');
+            result.append(it->replacement);
+            result.append(' ');
+            position = it->end;
+        }
+
+        result.append(content.mid(position));
+        result.append('\n');
+    }
+
+    return result;
+}
+
+void PDFRedactContentStreamEditor::performPageContentOperator(PDFInteger streamIndex, PDFInteger operatorStart, PDFInteger operatorEnd, const QByteArray& command)
+{
+    finishOperator();
+
+    m_streamIndex = streamIndex;
+    m_operatorStart = operatorStart;
+    m_operatorEnd = operatorEnd;
+    m_command = command;
+
+    if ((command == "Tj" || command == "TJ" || command == "'" || command == "\"") && streamIndex < PDFInteger(m_contentStreams->size()))
+    {
+        std::vector<PDFLexicalAnalyzer::Token> operands;
+
+        try
+        {
+            const QByteArray& content = (*m_contentStreams)[streamIndex];
+            PDFLexicalAnalyzer parser(content.constBegin() + operatorStart, content.constBegin() + operatorEnd);
+
+            PDFLexicalAnalyzer::Token token = parser.fetch();
+            while (token.type != PDFLexicalAnalyzer::TokenType::Command && token.type != PDFLexicalAnalyzer::TokenType::EndOfFile)
+            {
+                operands.push_back(qMove(token));
+                token = parser.fetch();
+            }
+        }
+        catch (const PDFException&)
+        {
+            return;
+        }
+
+        QByteArray replacement;
+        m_isTextEdited = editTextOperator(command, operands, replacement);
+
+        if (m_isTextEdited && !replacement.isEmpty())
+        {
+            m_edits.push_back(Edit{ streamIndex, operatorStart, operatorEnd, qMove(replacement) });
+        }
+    }
+}
+
+void PDFRedactContentStreamEditor::performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule)
+{
+    Q_UNUSED(fill);
+    Q_UNUSED(text);
+    Q_UNUSED(fillRule);
+
+    addPaintedArea(path, stroke);
+}
+
+bool PDFRedactContentStreamEditor::performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern)
+{
+    Q_UNUSED(fill);
+    Q_UNUSED(shadingPattern);
+
+    addPaintedArea(path, stroke);
+
+    // We do not need to create the mesh
+    return true;
+}
+
+void PDFRedactContentStreamEditor::performClipping(const QPainterPath& path, Qt::FillRule fillRule)
+{
+    Q_UNUSED(fillRule);
+
+    const QRectF clipRect = getCurrentWorldMatrix().mapRect(path.boundingRect());
+    m_clipState.clipRect = m_clipState.isClipped ? m_clipState.clipRect.intersected(clipRect) : clipRect;
+    m_clipState.isClipped = true;
+}
+
+bool PDFRedactContentStreamEditor::performImageStreamPainting(const PDFStream* stream)
+{
+    Q_UNUSED(stream);
+
+    // Image is painted into the unit square
+    QPainterPath path;
+    path.addRect(QRectF(0.0, 0.0, 1.0, 1.0));
+    addPaintedArea(path, false);
+
+    // We do not need to decode the image
+    return true;
+}
+
+void PDFRedactContentStreamEditor::performSaveGraphicState(ProcessOrder order)
+{
+    if (order == ProcessOrder::BeforeOperation)
+    {
+        m_clipStateStack.push_back(m_clipState);
+    }
+}
+
+void PDFRedactContentStreamEditor::performRestoreGraphicState(ProcessOrder order)
+{
+    if (order == ProcessOrder::AfterOperation && !m_clipStateStack.empty())
+    {
+        m_clipState = m_clipStateStack.back();
+        m_clipStateStack.pop_back();
+    }
+}
+
+bool PDFRedactContentStreamEditor::performPaintFormInstance(const PDFStream* formStream)
+{
+    Q_UNUSED(formStream);
+
+    ++m_formNestingLevel;
+    return false;
+}
+
+void PDFRedactContentStreamEditor::performFormProcessed(const PDFStream* formStream)
+{
+    Q_UNUSED(formStream);
+
+    --m_formNestingLevel;
+}
+
+void PDFRedactContentStreamEditor::addPaintedArea(const QPainterPath& path, bool stroke)
+{
+    if (m_isTextEdited || (m_isPainted && (m_isPaintedInForm || m_formNestingLevel == 0)))
+    {
+        // Glyphs are already processed, or operator is already marked as painted
+        return;
+    }
+
+    QRectF boundingRect = path.boundingRect();
+    if (stroke)
+    {
+        const PDFReal halfLineWidth = qMax(getGraphicState()->getLineWidth(), 1.0) * 0.5;
+        boundingRect.adjust(-halfLineWidth, -halfLineWidth, halfLineWidth, halfLineWidth);
+    }
+
+    QRectF deviceBoundingRect = getCurrentWorldMatrix().mapRect(boundingRect);
+    if (m_clipState.isClipped)
+    {
+        deviceBoundingRect = deviceBoundingRect.intersected(m_clipState.clipRect);
+    }
+
+    if (deviceBoundingRect.isValid() && deviceBoundingRect.intersects(m_redactBoundingRect) && m_redactPath.intersects(deviceBoundingRect))
+    {
+        m_isPainted = true;
+        m_isPaintedInForm = m_isPaintedInForm || m_formNestingLevel > 0;
+    }
+}
+
+void PDFRedactContentStreamEditor::finishOperator()
+{
+    if (m_streamIndex != -1 && m_isPainted)
+    {
+        static constexpr const char* pathPaintingOperators[] = { "S", "s", "f", "F", "f*", "B", "B*", "b", "b*" };
+
+        Edit edit{ m_streamIndex, m_operatorStart, m_operatorEnd, QByteArray() };
+        if (std::find(std::begin(pathPaintingOperators), std::end(pathPaintingOperators), m_command) != std::end(pathPaintingOperators))
+        {
+            // Path is not painted, but it is still ended
+            edit.replacement = "n";
+            m_edits.push_back(qMove(edit));
+        }
+        else if ((m_command == "Do" && !m_isPaintedInForm) || m_command == "BI" || m_command == "sh")
+        {
+            // Image or shading is removed
+            m_edits.push_back(qMove(edit));
+        }
+        else
+        {
+            m_failed = true;
+        }
+    }
+
+    m_streamIndex = -1;
+    m_command.clear();
+    m_isTextEdited = false;
+    m_isPainted = false;
+    m_isPaintedInForm = false;
+}
+
+bool PDFRedactContentStreamEditor::editTextOperator(const QByteArray& command, const std::vector<PDFLexicalAnalyzer::Token>& operands, QByteArray& replacement) const
+{
+    const PDFPageContentProcessorState* state = getGraphicState();
+    const PDFFont* font = state->getTextFont().data();
+    const PDFReal fontSize = state->getTextFontSize();
+    const PDFReal horizontalScaling = state->getTextHorizontalScaling() * 0.01; // Horizontal scaling is in percents
+
+    if (!font || qFuzzyIsNull(fontSize * horizontalScaling))
+    {
+        return false;
+    }
+
+    // Glyph advances are known only for simple fonts and composite
+    // fonts with horizontal writing mode (Type 3 font glyphs are content
+    // streams, they are processed as generic content).
+    const PDFSimpleFont* simpleFont = dynamic_cast<const PDFSimpleFont*>(font);
+    const PDFType0Font* type0Font = dynamic_cast<const PDFType0Font*>(font);
+    const PDFFontCMap* cmap = type0Font ? type0Font->getCMap() : nullptr;
+    if (!simpleFont && !(cmap && cmap->isValid() && !cmap->isVertical()))
+    {
+        return false;
+    }
+
+    auto isString = [&operands](size_t index) { return index < operands.size() && operands[index].type == PDFLexicalAnalyzer::TokenType::String; };
+    auto isNumber = [&operands](size_t index) { return index < operands.size() && (operands[index].type == PDFLexicalAnalyzer::TokenType::Integer || operands[index].type == PDFLexicalAnalyzer::TokenType::Real); };
+
+    PDFReal characterSpacing = state->getTextCharacterSpacing();
+    PDFReal wordSpacing = state->getTextWordSpacing();
+    QTransform textMatrix = state->getTextMatrix();
+    const QTransform nextLineTextMatrix = QTransform(1.0, 0.0, 0.0, 1.0, 0.0, -state->getTextLeading()) * state->getTextLineMatrix();
+
+    QByteArray prefix;
+    std::vector<PDFLexicalAnalyzer::Token> items;
+
+    if (command == "Tj" && operands.size() == 1 && isString(0))
+    {
+        items = operands;
+    }
+    else if (command == "'" && operands.size() == 1 && isString(0))
+    {
+        textMatrix = nextLineTextMatrix;
+        prefix = "T* ";
+        items = operands;
+    }
+    else if (command == "\"" && operands.size() == 3 && isNumber(0) && isNumber(1) && isString(2))
+    {
+        wordSpacing = operands[0].data.toDouble();
+        characterSpacing = operands[1].data.toDouble();
+        textMatrix = nextLineTextMatrix;
+        prefix = formatNumber(wordSpacing) + " Tw " + formatNumber(characterSpacing) + " Tc T* ";
+        items.push_back(operands[2]);
+    }
+    else if (command == "TJ" && operands.size() >= 2 &&
+             operands.front().type == PDFLexicalAnalyzer::TokenType::ArrayStart &&
+             operands.back().type == PDFLexicalAnalyzer::TokenType::ArrayEnd)
+    {
+        for (size_t i = 1; i + 1 < operands.size(); ++i)
+        {
+            if (!isString(i) && !isNumber(i))
+            {
+                return false;
+            }
+        }
+
+        items.assign(std::next(operands.cbegin()), std::prev(operands.cend()));
+    }
+    else
+    {
+        return false;
+    }
+
+    // Glyph box in glyph space - advance is used as glyph width, and font
+    // descriptor metrics as glyph height (or some reasonable defaults).
+    const FontDescriptor* fontDescriptor = font->getFontDescriptor();
+    PDFReal descent = fontDescriptor->descent < 0.0 ? fontDescriptor->descent * 0.001 : -0.25;
+    PDFReal ascent = fontDescriptor->ascent > 0.0 ? fontDescriptor->ascent * 0.001 : 1.0;
+    const QRectF fontBoundingBox = fontDescriptor->boundingBox.normalized();
+    if (!fontBoundingBox.isEmpty())
+    {
+        descent = qMin(descent, fontBoundingBox.top() * 0.001);
+        ascent = qMax(ascent, fontBoundingBox.bottom() * 0.001);
+    }
+
+    const QTransform glyphMatrix(fontSize * horizontalScaling, 0.0, 0.0, fontSize, 0.0, state->getTextRise());
+    const QTransform worldMatrix = getCurrentWorldMatrix();
+
+    QByteArray array;
+    QByteArray currentString;
+    PDFReal adjustment = 0.0;
+    bool isRedacted = false;
+
+    auto flush = [&]()
+    {
+        if (!currentString.isEmpty())
+        {
+            array.append('<');
+            array.append(currentString.toHex());
+            array.append('>');
+            currentString.clear();
+        }
+
+        if (!qFuzzyIsNull(adjustment))
+        {
+            array.append(' ');
+            array.append(formatNumber(adjustment));
+            array.append(' ');
+        }
+        adjustment = 0.0;
+    };
+
+    for (const PDFLexicalAnalyzer::Token& item : items)
+    {
+        if (item.type != PDFLexicalAnalyzer::TokenType::String)
+        {
+            const PDFReal value = item.data.toDouble();
+            textMatrix = QTransform(1.0, 0.0, 0.0, 1.0, -value * 0.001 * fontSize * horizontalScaling, 0.0) * textMatrix;
+            adjustment += value;
+            continue;
+        }
+
+        // Split string to character codes with their advances
+        const QByteArray string = item.data.toByteArray();
+        std::vector<std::pair<QByteArray, PDFReal>> codes;
+
+        if (simpleFont)
+        {
+            codes.reserve(string.size());
+            for (const char character : string)
+            {
+                codes.emplace_back(QByteArray(1, character), simpleFont->getGlyphAdvance(static_cast<unsigned char>(character)));
+            }
+        }
+        else
+        {
+            for (auto& [code, cid] : cmap->interpretCodes(string))
+            {
+                codes.emplace_back(qMove(code), type0Font->getGlyphAdvance(cid));
+            }
+        }
+
+        for (const auto& [code, advance] : codes)
+        {
+            if (qFuzzyIsNull(advance))
+            {
+                // We can't determine the glyph position
+                return false;
+            }
+
+            const PDFReal glyphWidth = advance * 0.001;
+            const QPolygonF glyphBox = (glyphMatrix * textMatrix * worldMatrix).map(QPolygonF(QRectF(0.0, descent, glyphWidth, ascent - descent)));
+
+            bool isGlyphRedacted = false;
+            if (glyphBox.boundingRect().intersects(m_redactBoundingRect))
+            {
+                QPainterPath glyphBoxPath;
+                glyphBoxPath.addPolygon(glyphBox);
+                isGlyphRedacted = m_redactPath.intersects(glyphBoxPath);
+            }
+
+            const bool isSpace = code.size() == 1 && code.front() == ' ';
+            const PDFReal displacement = (glyphWidth * fontSize + characterSpacing + (isSpace ? wordSpacing : 0.0)) * horizontalScaling;
+            textMatrix = QTransform(1.0, 0.0, 0.0, 1.0, displacement, 0.0) * textMatrix;
+
+            if (isGlyphRedacted)
+            {
+                // Glyph is replaced by the adjustment, so positions of following glyphs are kept
+                adjustment -= displacement * 1000.0 / (fontSize * horizontalScaling);
+                isRedacted = true;
+            }
+            else
+            {
+                if (!qFuzzyIsNull(adjustment))
+                {
+                    flush();
+                }
+                currentString.append(code);
+            }
+        }
+    }
+
+    flush();
+
+    if (isRedacted)
+    {
+        replacement = prefix + "[" + array + "] TJ";
+    }
+    else
+    {
+        replacement.clear();
+    }
+
+    return true;
+}
+
 PDFRedact::PDFRedact(const PDFDocument* document,
                      const PDFFontCache* fontCache,
                      const PDFCMS* cms,
@@ -54,13 +576,17 @@ PDFDocument PDFRedact::perform(Options options)
 
     std::map<PDFObjectReference, PDFObjectReference> mapOldPageRefToNewPageRef;
 
+    // Pages with edited content streams. Their resources (and contents of pages
+    // without redactions) are copied at once, so objects shared between pages
+    // (for example, fonts) are copied only once.
+    std::vector<PDFObjectReference> editedPageReferences;
+    std::vector<PDFObject> editedPageContents;
+    std::vector<PDFObject> editedPageObjects;
+
     for (size_t i = 0; i < m_document->getCatalog()->getPageCount(); ++i)
     {
         const PDFPage* page = m_document->getCatalog()->getPage(i);
 
-        PDFPrecompiledPage compiledPage;
-        renderer.compile(&compiledPage, i);
-
         PDFObjectReference newPageReference = builder.appendPage(page->getMediaBox());
         mapOldPageRefToNewPageRef[page->getPageReference()] = newPageReference;
 
@@ -82,8 +608,6 @@ PDFDocument PDFRedact::perform(Options options)
         }
         builder.setPageRotation(newPageReference, page->getPageRotation());
 
-        PDFPageContentStreamBuilder contentStreamBuilder(&builder);
-
         QPainterPath redactPath;
 
         for (const PDFObjectReference& annotationReference : page->getAnnotations())
@@ -101,6 +625,47 @@ PDFDocument PDFRedact::perform(Options options)
             redactPath = redactPath.united(redactAnnotation->getRedactionRegion().getPath());
         }
 
+        if (options.testFlag(EditContentStreams))
+        {
+            if (redactPath.isEmpty())
+            {
+                // Nothing is redacted on this page, content is copied as it is
+                editedPageReferences.push_back(newPageReference);
+                editedPageContents.push_back(PDFObject());
+                editedPageObjects.push_back(page->getResources());
+                editedPageObjects.push_back(page->getContents());
+                continue;
+            }
+
+            QByteArray content;
+            if (editPageContentStreams(page, redactPath, content))
+            {
+                QByteArray compressedContent = PDFFlateDecodeFilter::compress(content);
+
+                PDFArray filters;
+                filters.appendItem(PDFObject::createName("FlateDecode"));
+
+                PDFDictionary contentDictionary;
+                contentDictionary.addEntry(PDFInplaceOrMemoryString("Length"), PDFObject::createInteger(compressedContent.size()));
+                contentDictionary.addEntry(PDFInplaceOrMemoryString("Filter"), PDFObject::createArray(std::make_shared<PDFArray>(qMove(filters))));
+
+                PDFObjectReference contentReference = builder.addObject(PDFObject::createStream(std::make_shared<PDFStream>(qMove(contentDictionary), qMove(compressedContent))));
+
+                editedPageReferences.push_back(newPageReference);
+                editedPageContents.push_back(PDFObject::createReference(contentReference));
+                editedPageObjects.push_back(page->getResources());
+                editedPageObjects.push_back(PDFObject());
+                continue;
+            }
+
+            // Content streams can't be edited, we must redraw the page
+        }
+
+        PDFPrecompiledPage compiledPage;
+        renderer.compile(&compiledPage, i);
+
+        PDFPageContentStreamBuilder contentStreamBuilder(&builder);
+
         QTransform matrix;
         matrix.translate(0, page->getMediaBox().height());
         matrix.scale(1.0, -1.0);
@@ -111,6 +676,33 @@ PDFDocument PDFRedact::perform(Options options)
         contentStreamBuilder.end(painter);
     }
 
+    if (!editedPageReferences.empty())
+    {
+        std::vector<PDFObject> copiedObjects = builder.copyFrom(editedPageObjects, m_document->getStorage(), false);
+
+        for (size_t i = 0; i < editedPageReferences.size(); ++i)
+        {
+            const PDFObject& resources = copiedObjects[2 * i];
+            const PDFObject& contents = editedPageContents[i].isNull() ? copiedObjects[2 * i + 1] : editedPageContents[i];
+
+            PDFObjectFactory pageUpdateFactory;
+
+            pageUpdateFactory.beginDictionary();
+
+            pageUpdateFactory.beginDictionaryItem("Contents");
+            pageUpdateFactory << contents;
+            pageUpdateFactory.endDictionaryItem();
+
+            pageUpdateFactory.beginDictionaryItem("Resources");
+            pageUpdateFactory << resources;
+            pageUpdateFactory.endDictionaryItem();
+
+            pageUpdateFactory.endDictionary();
+
+            builder.mergeTo(editedPageReferences[i], pageUpdateFactory.takeObject());
+        }
+    }
+
     if (options.testFlag(CopyTitle))
     {
         builder.setDocumentTitle(m_document->getInfo()->title);
@@ -147,7 +739,7 @@ PDFDocument PDFRedact::perform(Options options)
                         {
                             if (action->getDestination().isNamedDestination())
                             {
-                                const PDFDestination* destination = m_document->getCatalog()->getNamedDestination(action->getDestination().getName());
+                                std::optional<PDFDestination> destination = m_document->getCatalog()->getNamedDestination(action->getDestination().getName(), &m_document->getStorage());
                                 if (destination)
                                 {
                                     action->setDestination(*destination);
@@ -172,10 +764,79 @@ PDFDocument PDFRedact::perform(Options options)
     }
 
     PDFDocument redactedDocument = builder.build();
-    PDFOptimizer optimizer(PDFOptimizer::All, nullptr);
+
+    // Edited content streams are not rewritten and images are not recompressed,
+    // so content, which is not redacted, remains intact.
+    PDFOptimizer::OptimizationFlags optimizationFlags = PDFOptimizer::All;
+    if (options.testFlag(EditContentStreams))
+    {
+        optimizationFlags = PDFOptimizer::AllLossless;
+        optimizationFlags.setFlag(PDFOptimizer::OptimizeContentStreams, false);
+    }
+
+    PDFOptimizer optimizer(optimizationFlags, nullptr);
     optimizer.setDocument(&redactedDocument);
     optimizer.optimize();
     return optimizer.takeOptimizedDocument();
 }
 
+bool PDFRedact::editPageContentStreams(const PDFPage* page, const QPainterPath& redactPath, QByteArray& content) const
+{
+    std::vector<QByteArray> contentStreams;
+
+    try
+    {
+        const PDFObject& contents = m_document->getObject(page->getContents());
+        if (contents.isArray())
+        {
+            const PDFArray* array = contents.getArray();
+            for (size_t i = 0, count = array->getCount(); i < count; ++i)
+            {
+                const PDFObject& streamObject = m_document->getObject(array->getItem(i));
+                contentStreams.push_back(streamObject.isStream() ? m_document->getDecodedStream(streamObject.getStream()) : QByteArray());
+            }
+        }
+        else if (contents.isStream())
+        {
+            contentStreams.push_back(m_document->getDecodedStream(contents.getStream()));
+        }
+    }
+    catch (const PDFException&)
+    {
+        return false;
+    }
+
+    PDFRedactContentStreamEditor editor(page, m_document, m_fontCache, m_cms, m_meshQualitySettings, &contentStreams, redactPath);
+    if (!editor.process())
+    {
+        return false;
+    }
+
+    // Edited content is enclosed in save/restore graphic state operators,
+    // redaction region is then filled using redaction fill color.
+    content = "q\n";
+    content.append(editor.getEditedContent());
+    content.append("Q\n");
+
+    if (m_redactFillColor.isValid())
+    {
+        content.append("q\n");
+        content.append(formatNumber(m_redactFillColor.redF()) + " " + formatNumber(m_redactFillColor.greenF()) + " " + formatNumber(m_redactFillColor.blueF()) + " rg\n");
+
+        for (const QPolygonF& polygon : redactPath.toFillPolygons())
+        {
+            for (int i = 0; i < polygon.size(); ++i)
+            {
+                const QPointF& point = polygon[i];
+                content.append(formatNumber(point.x()) + " " + formatNumber(point.y()) + (i == 0 ? " m\n" : " l\n"));
+            }
+            content.append("h\n");
+        }
+
+        content.append("f\nQ\n");
+    }
+
+    return true;
+}
+
 }   // namespace pdf
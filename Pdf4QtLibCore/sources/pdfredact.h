@@ -39,10 +39,11 @@ public:
 
     enum Option
     {
-        None            = 0x0000,
-        CopyTitle       = 0x0001,
-        CopyMetadata    = 0x0002,
-        CopyOutline     = 0x0004
+        None                = 0x0000,
+        CopyTitle           = 0x0001,
+        CopyMetadata        = 0x0002,
+        CopyOutline         = 0x0004,
+        EditContentStreams  = 0x0008    ///< Edit page content streams (only intersecting operators and glyphs are removed), instead of redrawing the pages
     };
     Q_DECLARE_FLAGS(Options, Option)
 
@@ -50,6 +51,15 @@ public:
     pdf::PDFDocument perform(Options options);
 
 private:
+    /// Edits content streams of the page, so only operators (and glyphs) intersecting
+    /// the redaction region are removed. Returns false, if some content intersecting
+    /// the redaction region can't be removed by editing of the page content streams
+    /// (for example, it is content of the form XObject).
+    /// \param page Page
+    /// \param redactPath Redaction region (in page space)
+    /// \param[out] content Edited content stream of the page
+    bool editPageContentStreams(const PDFPage* page, const QPainterPath& redactPath, QByteArray& content) const;
+
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
     const PDFCMS* m_cms;
@@ -22,11 +22,19 @@
 #include "pdfprogress.h"
 #include "pdfannotation.h"
 #include "pdfblpainter.h"
+#include "pdftrace.h"
+#include "pdfcms.h"
+#include "pdfdiskcache.h"
+#include "pdfpagecontenthash.h"
 
 #include <QDir>
+#include <QDataStream>
+#include <QSysInfo>
 #include <QElapsedTimer>
 #include <QtMath>
 
+#include <atomic>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -143,6 +151,40 @@ void PDFRenderer::applyFeaturesToColorConvertor(const Features& features, PDFCol
     }
 }
 
+bool PDFRenderer::isPostRasterColorAdjustment(Features features)
+{
+    if (!features.testFlag(ColorAdjust_PostRaster))
+    {
+        return false;
+    }
+
+    PDFColorConvertor colorConvertor;
+    applyFeaturesToColorConvertor(features, colorConvertor);
+    return colorConvertor.isActive() && colorConvertor.isRasterConversionEquivalent();
+}
+
+PDFRenderer::Features PDFRenderer::getCompileFeatures(Features features)
+{
+    if (isPostRasterColorAdjustment(features))
+    {
+        features &= ~getColorFeatures();
+    }
+
+    return features;
+}
+
+void PDFRenderer::applyPostRasterColorAdjustment(Features features, QImage& image)
+{
+    if (isPostRasterColorAdjustment(features))
+    {
+        // Modes with equivalent raster conversion don't depend
+        // on the color settings, so default convertor is used.
+        PDFColorConvertor colorConvertor;
+        applyFeaturesToColorConvertor(features, colorConvertor);
+        colorConvertor.convertRasterImage(image);
+    }
+}
+
 const PDFOperationControl* PDFRenderer::getOperationControl() const
 {
     return m_operationControl;
@@ -153,6 +195,49 @@ void PDFRenderer::setOperationControl(const PDFOperationControl* newOperationCon
     m_operationControl = newOperationControl;
 }
 
+PDFReal PDFRenderer::getImageResolutionHint() const
+{
+    return m_imageResolutionHint;
+}
+
+void PDFRenderer::setImageResolutionHint(PDFReal imageResolutionHint)
+{
+    m_imageResolutionHint = imageResolutionHint;
+}
+
+bool PDFRenderer::isImagePreviewsEnabled() const
+{
+    return m_imagePreviewsEnabled;
+}
+
+void PDFRenderer::setImagePreviewsEnabled(bool imagePreviewsEnabled)
+{
+    m_imagePreviewsEnabled = imagePreviewsEnabled;
+}
+
+PDFPageContentProcessorStatistics* PDFRenderer::getStatistics() const
+{
+    return m_statistics;
+}
+
+void PDFRenderer::setStatistics(PDFPageContentProcessorStatistics* statistics)
+{
+    m_statistics = statistics;
+}
+
+PDFReal PDFRenderer::calculateImageResolutionHint(const PDFPage* page, QSize imageSize)
+{
+    const QRectF mediaBox = page->getMediaBox();
+    const PDFReal pageSize = qMin(mediaBox.width(), mediaBox.height());
+
+    if (pageSize <= 0.0 || imageSize.isEmpty())
+    {
+        return 0.0;
+    }
+
+    return qMax(imageSize.width(), imageSize.height()) / pageSize;
+}
+
 QList<PDFRenderError> PDFRenderer::render(QPainter* painter, const QRectF& rectangle, size_t pageIndex) const
 {
     const PDFCatalog* catalog = m_document->getCatalog();
@@ -191,6 +276,7 @@ QList<PDFRenderError> PDFRenderer::render(QPainter* painter, const QTransform& m
 
 void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex) const
 {
+    PDF_TRACE_SPAN_ARG("render", "Compile page", "page", PDFInteger(pageIndex));
     const PDFCatalog* catalog = m_document->getCatalog();
     if (pageIndex >= catalog->getPageCount() || !catalog->getPage(pageIndex))
     {
@@ -207,10 +293,14 @@ void PDFRenderer::compile(PDFPrecompiledPage* precompiledPage, size_t pageIndex)
 
     PDFPrecompiledPageGenerator generator(precompiledPage, m_features, page, m_document, m_fontCache, m_cms, m_optionalContentActivity, m_meshQualitySettings);
     generator.setOperationControl(m_operationControl);
+    generator.setImageResolutionHint(m_imageResolutionHint);
+    generator.setImagePreviewsEnabled(m_imagePreviewsEnabled);
+    generator.setStatistics(m_statistics);
     QList<PDFRenderError> errors = generator.processContents();
+    precompiledPage->setPreviewImageCount(generator.getPreviewImageCount());
 
     PDFColorConvertor colorConvertor = m_cms->getColorConvertor();
-    PDFRenderer::applyFeaturesToColorConvertor(m_features, colorConvertor);
+    PDFRenderer::applyFeaturesToColorConvertor(getCompileFeatures(m_features), colorConvertor);
     precompiledPage->convertColors(colorConvertor);
 
     precompiledPage->optimize();
@@ -241,52 +331,426 @@ QImage PDFRasterizer::render(PDFInteger pageIndex,
                              QSize size,
                              PDFRenderer::Features features,
                              const PDFAnnotationManager* annotationManager,
-                             PageRotation extraRotation)
+                             PageRotation extraRotation,
+                             QImage imageBuffer)
 {
-    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    PDF_TRACE_SPAN_ARG("render", "Rasterize page", "page", pageIndex);
+    // Image contents are always cleared by the renderer, so buffer can be
+    // reused without zero-filling it.
+    QImage image;
+    if (imageBuffer.size() == size && imageBuffer.format() == QImage::Format_ARGB32_Premultiplied && imageBuffer.isDetached())
+    {
+        image = qMove(imageBuffer);
+    }
+    else
+    {
+        image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    }
 
-    QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), size), extraRotation);
+    renderPageImage(image, pageIndex, page, compiledPage, features, annotationManager, extraRotation);
+    setImageResolution(image, page, size);
+    return image;
+}
 
-    if (m_rendererEngine == RendererEngine::Blend2D_MultiThread ||
-        m_rendererEngine == RendererEngine::Blend2D_SingleThread)
+bool PDFRasterizer::render(PDFInteger pageIndex,
+                           const PDFPage* page,
+                           const PDFPrecompiledPage* compiledPage,
+                           uchar* buffer,
+                           QSize size,
+                           qsizetype bytesPerLine,
+                           BufferFormat format,
+                           PDFRenderer::Features features,
+                           const PDFAnnotationManager* annotationManager,
+                           PageRotation extraRotation)
+{
+    PDF_TRACE_SPAN_ARG("render", "Rasterize page to buffer", "page", pageIndex);
+
+    if (!buffer || size.isEmpty() || bytesPerLine < qsizetype(size.width()) * getBytesPerPixel(format))
     {
-        PDFBLPaintDevice blPaintDevice(image, false);
+        return false;
+    }
 
-        QPainter painter(&blPaintDevice);
-        compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0);
+    if (format == BufferFormat::BGRA8888 && QSysInfo::ByteOrder == QSysInfo::LittleEndian)
+    {
+        // Memory layout of the ARGB32 image is BGRA on little endian machines, so
+        // we can render directly into the buffer. Image doesn't own the buffer
+        // and it isn't shared, so it is never detached.
+        QImage image(buffer, size.width(), size.height(), bytesPerLine, QImage::Format_ARGB32_Premultiplied);
+        renderPageImage(image, pageIndex, page, compiledPage, features, annotationManager, extraRotation);
+        Q_ASSERT(image.constBits() == buffer);
+        return true;
+    }
 
-        if (annotationManager)
+    if (m_conversionImage.size() != size)
+    {
+        m_conversionImage = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    }
+
+    renderPageImage(m_conversionImage, pageIndex, page, compiledPage, features, annotationManager, extraRotation);
+
+    // Alpha channel is dropped in formats without alpha, as in QImage conversions.
+    // Page images are opaque, because they are drawn over white paper.
+    auto convertRow = [&, this](int row)
+    {
+        const QRgb* sourceRow = reinterpret_cast<const QRgb*>(m_conversionImage.constScanLine(row));
+        uchar* targetRow = buffer + row * bytesPerLine;
+
+        switch (format)
         {
-            QList<PDFRenderError> errors;
-            PDFTextLayoutGetter textLayoutGetter(nullptr, pageIndex);
-            annotationManager->drawPage(&painter, pageIndex, compiledPage, textLayoutGetter, matrix, errors);
+            case BufferFormat::BGRA8888:
+            {
+                for (int x = 0; x < size.width(); ++x)
+                {
+                    const QRgb pixel = sourceRow[x];
+                    uchar* targetPixel = targetRow + 4 * x;
+                    targetPixel[0] = qBlue(pixel);
+                    targetPixel[1] = qGreen(pixel);
+                    targetPixel[2] = qRed(pixel);
+                    targetPixel[3] = qAlpha(pixel);
+                }
+                break;
+            }
+
+            case BufferFormat::RGB565:
+            {
+                quint16* targetPixels = reinterpret_cast<quint16*>(targetRow);
+                for (int x = 0; x < size.width(); ++x)
+                {
+                    const QRgb pixel = sourceRow[x];
+                    targetPixels[x] = quint16(((qRed(pixel) & 0xF8) << 8) | ((qGreen(pixel) & 0xFC) << 3) | (qBlue(pixel) >> 3));
+                }
+                break;
+            }
+
+            case BufferFormat::Gray8:
+            {
+                for (int x = 0; x < size.width(); ++x)
+                {
+                    targetRow[x] = uchar(qGray(sourceRow[x]));
+                }
+                break;
+            }
         }
+    };
+
+    std::vector<int> rows(size.height(), 0);
+    std::iota(rows.begin(), rows.end(), 0);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, rows.cbegin(), rows.cend(), convertRow);
+    return true;
+}
+
+int PDFRasterizer::getBytesPerPixel(BufferFormat format)
+{
+    switch (format)
+    {
+        case BufferFormat::BGRA8888:
+            return 4;
+
+        case BufferFormat::RGB565:
+            return 2;
+
+        case BufferFormat::Gray8:
+            return 1;
+    }
+
+    Q_ASSERT(false);
+    return 4;
+}
+
+void PDFRasterizer::renderPageImage(QImage& image,
+                                    PDFInteger pageIndex,
+                                    const PDFPage* page,
+                                    const PDFPrecompiledPage* compiledPage,
+                                    PDFRenderer::Features features,
+                                    const PDFAnnotationManager* annotationManager,
+                                    PageRotation extraRotation) const
+{
+    Q_ASSERT(image.format() == QImage::Format_ARGB32_Premultiplied);
+
+    const QSize size = image.size();
+    QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), size), extraRotation);
+
+    // Large images are divided into horizontal bands, each band is rendered
+    // in parallel directly into the image memory.
+    const qint64 pixelCount = qint64(size.width()) * qint64(size.height());
+    const int bandCount = pixelCount >= PARALLEL_RENDERING_MIN_PIXELS ? qBound(1, size.height() / MIN_BAND_HEIGHT, QThread::idealThreadCount()) : 1;
+
+    if (bandCount > 1 && PDFExecutionPolicy::isParallelizing(PDFExecutionPolicy::Scope::Content))
+    {
+        struct Band
+        {
+            int top = 0;
+            int height = 0;
+        };
+
+        std::vector<Band> bands;
+        bands.reserve(bandCount);
+        for (int i = 0; i < bandCount; ++i)
+        {
+            const int top = size.height() * i / bandCount;
+            const int bottom = size.height() * (i + 1) / bandCount;
+            bands.push_back({ top, bottom - top });
+        }
+
+        uchar* bits = image.bits();
+        const qsizetype bytesPerLine = image.bytesPerLine();
+
+        auto renderBand = [&, this](const Band& band)
+        {
+            QImage bandImage(bits + band.top * bytesPerLine, size.width(), band.height, bytesPerLine, image.format());
+            QTransform bandMatrix = matrix * QTransform::fromTranslate(0, -band.top);
+            renderImage(bandImage, pageIndex, page, compiledPage, bandMatrix, features, annotationManager);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bands.cbegin(), bands.cend(), renderBand);
     }
     else
     {
-        // Use standard software rasterizer.
-        image.fill(Qt::white);
+        renderImage(image, pageIndex, page, compiledPage, matrix, features, annotationManager);
+    }
+}
 
-        QPainter painter(&image);
-        compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0);
+bool PDFRasterizer::renderBands(PDFInteger pageIndex,
+                                const PDFPage* page,
+                                const PDFPrecompiledPage* compiledPage,
+                                QSize size,
+                                PDFRenderer::Features features,
+                                const PDFAnnotationManager* annotationManager,
+                                PageRotation extraRotation,
+                                int bandHeight,
+                                const BandConsumer& processBand)
+{
+    PDF_TRACE_SPAN_ARG("render", "Rasterize page in bands", "page", pageIndex);
+    Q_ASSERT(processBand);
 
-        if (annotationManager)
+    if (size.isEmpty())
+    {
+        return false;
+    }
+
+    bandHeight = qBound(1, bandHeight, size.height());
+    QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), size), extraRotation);
+
+    // Group of consecutive bands is rendered in parallel, then bands are
+    // passed to the processing function in order. Band images are reused
+    // for next groups, so memory usage doesn't depend on page image size.
+    const bool isParallel = PDFExecutionPolicy::isParallelizing(PDFExecutionPolicy::Scope::Content);
+    const int bandCount = (size.height() + bandHeight - 1) / bandHeight;
+    const int groupSize = isParallel ? qBound(1, QThread::idealThreadCount(), bandCount) : 1;
+
+    struct Band
+    {
+        int top = 0;
+        QImage image;
+    };
+
+    std::vector<Band> bands(groupSize);
+
+    for (int firstBand = 0; firstBand < bandCount; firstBand += groupSize)
+    {
+        const int currentGroupSize = qMin(groupSize, bandCount - firstBand);
+        for (int i = 0; i < currentGroupSize; ++i)
         {
-            QList<PDFRenderError> errors;
-            PDFTextLayoutGetter textLayoutGetter(nullptr, pageIndex);
-            annotationManager->drawPage(&painter, pageIndex, compiledPage, textLayoutGetter, matrix, errors);
+            Band& band = bands[i];
+            band.top = (firstBand + i) * bandHeight;
+
+            const QSize bandSize(size.width(), qMin(bandHeight, size.height() - band.top));
+            if (band.image.size() != bandSize)
+            {
+                band.image = QImage(bandSize, QImage::Format_ARGB32_Premultiplied);
+                setImageResolution(band.image, page, size);
+            }
+        }
+
+        auto renderBand = [&, this](Band& band)
+        {
+            QTransform bandMatrix = matrix * QTransform::fromTranslate(0, -band.top);
+            renderImage(band.image, pageIndex, page, compiledPage, bandMatrix, features, annotationManager);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, bands.begin(), std::next(bands.begin(), currentGroupSize), renderBand);
+
+        for (int i = 0; i < currentGroupSize; ++i)
+        {
+            if (!processBand(bands[i].image))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool PDFRasterizer::renderTilePyramid(PDFInteger pageIndex,
+                                      const PDFPage* page,
+                                      const PDFPrecompiledPage* compiledPage,
+                                      QSize size,
+                                      PDFRenderer::Features features,
+                                      const PDFAnnotationManager* annotationManager,
+                                      PageRotation extraRotation,
+                                      int tileSize,
+                                      const TileConsumer& processTile) const
+{
+    PDF_TRACE_SPAN_ARG("render", "Rasterize tile pyramid", "page", pageIndex);
+    Q_ASSERT(processTile);
+
+    if (size.isEmpty() || tileSize <= 0)
+    {
+        return false;
+    }
+
+    struct TileInfo
+    {
+        int level = 0;
+        int column = 0;
+        int row = 0;
+    };
+
+    // Levels are enumerated from the finest one, which has most of
+    // the tiles, coarse levels have only few small tiles.
+    std::vector<TileInfo> tiles;
+    const int levelCount = getTilePyramidLevelCount(size);
+    for (int level = levelCount - 1; level >= 0; --level)
+    {
+        const QSize levelSize = getTilePyramidLevelSize(size, level);
+        const int columnCount = (levelSize.width() + tileSize - 1) / tileSize;
+        const int rowCount = (levelSize.height() + tileSize - 1) / tileSize;
+
+        for (int row = 0; row < rowCount; ++row)
+        {
+            for (int column = 0; column < columnCount; ++column)
+            {
+                tiles.push_back({ level, column, row });
+            }
+        }
+    }
+
+    std::atomic_bool isCanceled = false;
+    auto renderTile = [&, this](const TileInfo& info)
+    {
+        if (isCanceled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        const QSize levelSize = getTilePyramidLevelSize(size, info.level);
+        const QRect levelRect(QPoint(0, 0), levelSize);
+        const QRect tileRect = levelRect.intersected(QRect(info.column * tileSize, info.row * tileSize, tileSize, tileSize));
+        QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, levelRect, extraRotation) * QTransform::fromTranslate(-tileRect.left(), -tileRect.top());
+
+        Tile tile;
+        tile.level = info.level;
+        tile.column = info.column;
+        tile.row = info.row;
+        tile.image = QImage(tileRect.size(), QImage::Format_ARGB32_Premultiplied);
+        setImageResolution(tile.image, page, levelSize);
+        renderImage(tile.image, pageIndex, page, compiledPage, matrix, features, annotationManager);
+
+        if (!processTile(tile))
+        {
+            isCanceled.store(true, std::memory_order_relaxed);
         }
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, tiles.cbegin(), tiles.cend(), renderTile);
+
+    return !isCanceled.load(std::memory_order_relaxed);
+}
+
+int PDFRasterizer::getTilePyramidLevelCount(QSize size)
+{
+    // Level 0 is 1x1 image, each next level has double size,
+    // until the last level, which has size of the whole image.
+    const qint64 maximalDimension = qMax(size.width(), size.height());
+
+    int maximalLevel = 0;
+    while ((qint64(1) << maximalLevel) < maximalDimension)
+    {
+        ++maximalLevel;
     }
 
+    return maximalLevel + 1;
+}
+
+QSize PDFRasterizer::getTilePyramidLevelSize(QSize size, int level)
+{
+    const int maximalLevel = getTilePyramidLevelCount(size) - 1;
+    const qint64 scale = qint64(1) << qBound(0, maximalLevel - level, maximalLevel);
+
+    // Size is rounded up, as in the Deep Zoom image format
+    const qint64 width = (qint64(size.width()) + scale - 1) / scale;
+    const qint64 height = (qint64(size.height()) + scale - 1) / scale;
+    return QSize(int(width), int(height));
+}
+
+void PDFRasterizer::setImageResolution(QImage& image, const PDFPage* page, QSize size)
+{
     // Calculate image DPI
     QSizeF rotatedSizeInMeters = page->getRotatedMediaBoxMM().size() / 1000.0;
-    QSizeF rotatedSizeInPixels = image.size();
+    QSizeF rotatedSizeInPixels = size;
     qreal dpiX = rotatedSizeInPixels.width() / rotatedSizeInMeters.width();
     qreal dpiY = rotatedSizeInPixels.height() / rotatedSizeInMeters.height();
     image.setDotsPerMeterX(qCeil(dpiX));
     image.setDotsPerMeterY(qCeil(dpiY));
+}
 
-    return image;
+void PDFRasterizer::renderImage(QImage& image,
+                                PDFInteger pageIndex,
+                                const PDFPage* page,
+                                const PDFPrecompiledPage* compiledPage,
+                                const QTransform& matrix,
+                                PDFRenderer::Features features,
+                                const PDFAnnotationManager* annotationManager) const
+{
+    // Post-raster color adjustment is applied to the page contents only,
+    // annotations have their colors converted, when they are compiled.
+    auto drawAnnotations = [&](QPaintDevice* paintDevice)
+    {
+        if (annotationManager)
+        {
+            QPainter painter(paintDevice);
+            QList<PDFRenderError> errors;
+            PDFTextLayoutGetter textLayoutGetter(nullptr, pageIndex);
+            annotationManager->drawPage(&painter, pageIndex, compiledPage, textLayoutGetter, matrix, errors);
+        }
+    };
+
+    if (m_rendererEngine == RendererEngine::Blend2D_MultiThread ||
+        m_rendererEngine == RendererEngine::Blend2D_SingleThread)
+    {
+        // Page contents are rendered directly by Blend2D, if it is possible,
+        // annotations are then drawn over the page using standard painter.
+        const bool isMultithreaded = m_rendererEngine == RendererEngine::Blend2D_MultiThread;
+        if (PDFBLPageRenderer::render(image, isMultithreaded, compiledPage, page->getCropBox(), matrix, features, 1.0))
+        {
+            PDFRenderer::applyPostRasterColorAdjustment(features, image);
+            drawAnnotations(&image);
+            return;
+        }
+
+        PDFBLPaintDevice blPaintDevice(image, false);
+
+        {
+            QPainter painter(&blPaintDevice);
+            compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0);
+        }
+
+        // Blend2D paint device clears the image, when painting is started,
+        // so annotations are drawn using standard painter (as above).
+        PDFRenderer::applyPostRasterColorAdjustment(features, image);
+        drawAnnotations(&image);
+    }
+    else
+    {
+        // Use standard software rasterizer.
+        image.fill(Qt::white);
+
+        {
+            QPainter painter(&image);
+            compiledPage->draw(&painter, page->getCropBox(), matrix, features, 1.0);
+        }
+
+        PDFRenderer::applyPostRasterColorAdjustment(features, image);
+        drawAnnotations(&image);
+    }
 }
 
 PDFRasterizer* PDFRasterizerPool::acquire()
@@ -315,13 +779,24 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
                                const PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
                                const PDFRasterizerPool::ProcessImageMethod& processImage,
                                PDFProgress* progress)
+{
+    Q_ASSERT(imageSizeGetter);
+
+    auto imageSizesGetter = [&imageSizeGetter](const PDFPage* page) { return std::vector<QSize>({ imageSizeGetter(page) }); };
+    renderSizes(pageIndices, imageSizesGetter, processImage, progress);
+}
+
+void PDFRasterizerPool::renderSizes(const std::vector<PDFInteger>& pageIndices,
+                                    const PDFRasterizerPool::PageImageSizesGetter& imageSizesGetter,
+                                    const PDFRasterizerPool::ProcessImageMethod& processImage,
+                                    PDFProgress* progress)
 {
     if (pageIndices.empty())
     {
         return;
     }
 
-    Q_ASSERT(imageSizeGetter);
+    Q_ASSERT(imageSizesGetter);
     Q_ASSERT(processImage);
 
     QElapsedTimer timer;
@@ -336,7 +811,7 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         info.text = PDFTranslationContext::tr("Rendering document into images.");
         progress->start(pageIndices.size(), qMove(info));
     }
-    auto processPage = [this, progress, &imageSizeGetter, &processImage](const PDFInteger pageIndex)
+    auto processPage = [this, progress, &imageSizesGetter, &processImage](const PDFInteger pageIndex)
     {
         const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
 
@@ -356,10 +831,57 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         QElapsedTimer pageTimer;
         pageTimer.start();
 
-        // Precompile the page
+        const std::vector<QSize> imageSizes = imageSizesGetter(page);
+
+        // Try to load the page images from the disk cache first,
+        // only images, which are not in the cache, are rendered.
+        std::vector<QByteArray> diskCacheKeys(imageSizes.size());
+        std::vector<size_t> renderedSizeIndices;
+        for (size_t sizeIndex = 0; sizeIndex < imageSizes.size(); ++sizeIndex)
+        {
+            const QSize imageSize = imageSizes[sizeIndex];
+            diskCacheKeys[sizeIndex] = getDiskCacheKey(pageIndex, imageSize);
+
+            QImage image = readDiskCache(diskCacheKeys[sizeIndex], imageSize);
+            if (!image.isNull())
+            {
+                PDFRenderedPageImage renderedPageImage;
+                renderedPageImage.pageIndex = pageIndex;
+                renderedPageImage.sizeIndex = int(sizeIndex);
+                renderedPageImage.pageImage = qMove(image);
+                renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
+                processImage(renderedPageImage);
+            }
+            else
+            {
+                renderedSizeIndices.push_back(sizeIndex);
+            }
+        }
+
+        if (renderedSizeIndices.empty())
+        {
+            if (progress)
+            {
+                progress->step();
+            }
+            return;
+        }
+
+        // Precompile the page only once for all sizes, images are decoded
+        // only in resolution needed for the largest page image.
+        PDFReal imageResolutionHint = 0.0;
+        for (size_t sizeIndex : renderedSizeIndices)
+        {
+            imageResolutionHint = qMax(imageResolutionHint, PDFRenderer::calculateImageResolutionHint(page, imageSizes[sizeIndex]));
+        }
+
+        pageTimer.restart();
         PDFPrecompiledPage precompiledPage;
         PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
+        std::shared_ptr<PDFPageContentProcessorStatistics> statistics = m_isStatisticsEnabled ? std::make_shared<PDFPageContentProcessorStatistics>() : nullptr;
         PDFRenderer renderer(m_document, m_fontCache, cms.data(), m_optionalContentActivity, m_features, m_meshQualitySettings);
+        renderer.setImageResolutionHint(imageResolutionHint);
+        renderer.setStatistics(statistics.get());
         renderer.compile(&precompiledPage, pageIndex);
 
         qint64 pageCompileTime = pageTimer.restart();
@@ -377,23 +899,38 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
         PDFAnnotationManager annotationManager(m_fontCache, m_cmsManager, m_optionalContentActivity, m_meshQualitySettings, m_features, PDFAnnotationManager::Target::Print, nullptr);
         annotationManager.setDocument(modifiedDocument);
 
-        // Render page to image
-        pageTimer.restart();
-        PDFRasterizer* rasterizer = acquire();
-        qint64 pageWaitTime = pageTimer.restart();
-        QImage image = rasterizer->render(pageIndex, page, &precompiledPage, imageSizeGetter(page), m_features, &annotationManager, PageRotation::None);
-        qint64 pageRenderTime = pageTimer.elapsed();
-        release(rasterizer);
-
-        // Now, process the image
-        PDFRenderedPageImage renderedPageImage;
-        renderedPageImage.pageIndex = pageIndex;
-        renderedPageImage.pageImage = qMove(image);
-        renderedPageImage.pageCompileTime = pageCompileTime;
-        renderedPageImage.pageWaitTime = pageWaitTime;
-        renderedPageImage.pageRenderTime = pageRenderTime;
-        renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
-        processImage(renderedPageImage);
+        for (size_t sizeIndex : renderedSizeIndices)
+        {
+            const QSize imageSize = imageSizes[sizeIndex];
+
+            // Render page to image
+            pageTimer.restart();
+            PDFRasterizer* rasterizer = acquire();
+            qint64 pageWaitTime = pageTimer.restart();
+            QImage image = rasterizer->render(pageIndex, page, &precompiledPage, imageSize, m_features, &annotationManager, PageRotation::None, acquireImageBuffer(imageSize));
+            qint64 pageRenderTime = pageTimer.elapsed();
+            release(rasterizer);
+
+            writeDiskCache(diskCacheKeys[sizeIndex], image);
+
+            // Now, process the image. Compile time and statistics are
+            // reported only with the first rendered image of the page.
+            PDFRenderedPageImage renderedPageImage;
+            renderedPageImage.pageIndex = pageIndex;
+            renderedPageImage.sizeIndex = int(sizeIndex);
+            renderedPageImage.pageImage = qMove(image);
+            renderedPageImage.pageCompileTime = pageCompileTime;
+            renderedPageImage.pageWaitTime = pageWaitTime;
+            renderedPageImage.pageRenderTime = pageRenderTime;
+            renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
+            renderedPageImage.statistics = qMove(statistics);
+            processImage(renderedPageImage);
+            releaseImageBuffer(qMove(renderedPageImage.pageImage));
+
+            pageCompileTime = 0;
+            statistics.reset();
+            totalPageTimer.restart();
+        }
 
         if (progress)
         {
@@ -402,6 +939,12 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
     };
     PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageIndices.cbegin(), pageIndices.cend(), processPage);
 
+    // Free memory of image buffers
+    {
+        QMutexLocker guard(&m_mutex);
+        m_imageBuffers.clear();
+    }
+
     if (progress)
     {
         progress->finish();
@@ -411,6 +954,246 @@ void PDFRasterizerPool::render(const std::vector<PDFInteger>& pageIndices,
     Q_EMIT renderError(PDFCatalog::INVALID_PAGE_INDEX, PDFRenderError(RenderErrorType::Information, PDFTranslationContext::tr("%1 miliseconds elapsed to render %2 pages...").arg(timer.nsecsElapsed() / 1000000).arg(pageIndices.size())));
 }
 
+QImage PDFRasterizerPool::readDiskCache(const QByteArray& diskCacheKey, QSize imageSize) const
+{
+    if (diskCacheKey.isEmpty())
+    {
+        return QImage();
+    }
+
+    QByteArray data = m_diskCache->read(diskCacheKey);
+    if (data.isEmpty())
+    {
+        return QImage();
+    }
+
+    int format = QImage::Format_Invalid;
+    QImage image;
+
+    QDataStream stream(&data, QIODevice::ReadOnly);
+    stream >> format >> image;
+
+    if (stream.status() != QDataStream::Ok || image.size() != imageSize)
+    {
+        return QImage();
+    }
+
+    image.convertTo(QImage::Format(format));
+    return image;
+}
+
+void PDFRasterizerPool::writeDiskCache(const QByteArray& diskCacheKey, const QImage& image) const
+{
+    if (diskCacheKey.isEmpty() || image.isNull())
+    {
+        return;
+    }
+
+    QByteArray data;
+
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << int(image.format()) << image;
+    }
+
+    m_diskCache->write(diskCacheKey, data);
+}
+
+QByteArray PDFRasterizerPool::getDiskCacheKey(PDFInteger pageIndex, QSize imageSize) const
+{
+    if (!m_diskCache)
+    {
+        return QByteArray();
+    }
+
+    // Annotations are rendered into the page image
+    std::vector<PDFObjectReference> optionalContentGroups;
+    const QByteArray pageContentHash = PDFPageContentHash::compute(m_document, pageIndex, PDFPageContentHash::Annotations, &optionalContentGroups);
+    if (pageContentHash.isEmpty())
+    {
+        return QByteArray();
+    }
+
+    QByteArray parameters;
+
+    {
+        QDataStream stream(&parameters, QIODevice::WriteOnly);
+        stream << imageSize << int(m_rendererEngine);
+    }
+
+    const QByteArray settings = PDFPageContentHash::createSettingsFingerprint(parameters, m_features, m_meshQualitySettings, m_cmsManager->getSettings(), m_optionalContentActivity, optionalContentGroups);
+    return PDFDiskCache::createPageKey(pageContentHash, "image", settings);
+}
+
+PDFRenderedPageImage PDFRasterizerPool::renderBands(PDFInteger pageIndex,
+                                                    const PageImageSizeGetter& imageSizeGetter,
+                                                    int bandHeight,
+                                                    const PDFRasterizer::BandConsumer& processBand)
+{
+    Q_ASSERT(imageSizeGetter);
+    Q_ASSERT(processBand);
+
+    PDFRenderedPageImage renderedPageImage;
+    renderedPageImage.pageIndex = pageIndex;
+
+    const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        Q_EMIT renderError(pageIndex, PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Page %1 not found.").arg(pageIndex)));
+        return renderedPageImage;
+    }
+
+    QElapsedTimer totalPageTimer;
+    totalPageTimer.start();
+
+    QElapsedTimer pageTimer;
+    pageTimer.start();
+
+    // Precompile the page
+    PDFPrecompiledPage precompiledPage;
+    PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
+    if (m_isStatisticsEnabled)
+    {
+        renderedPageImage.statistics = std::make_shared<PDFPageContentProcessorStatistics>();
+    }
+
+    PDFRenderer renderer(m_document, m_fontCache, cms.data(), m_optionalContentActivity, m_features, m_meshQualitySettings);
+    renderer.setStatistics(renderedPageImage.statistics.get());
+    renderer.compile(&precompiledPage, pageIndex);
+
+    renderedPageImage.pageCompileTime = pageTimer.restart();
+
+    for (const PDFRenderError& error : precompiledPage.getErrors())
+    {
+        Q_EMIT renderError(pageIndex, error);
+    }
+
+    // We can const-cast here, because we do not modify the document in annotation manager.
+    // Annotations are just rendered to the target picture.
+    PDFModifiedDocument modifiedDocument(const_cast<PDFDocument*>(m_document), const_cast<PDFOptionalContentActivity*>(m_optionalContentActivity));
+
+    // Annotation manager
+    PDFAnnotationManager annotationManager(m_fontCache, m_cmsManager, m_optionalContentActivity, m_meshQualitySettings, m_features, PDFAnnotationManager::Target::Print, nullptr);
+    annotationManager.setDocument(modifiedDocument);
+
+    // Render page in bands
+    pageTimer.restart();
+    const QSize imageSize = imageSizeGetter(page);
+    PDFRasterizer* rasterizer = acquire();
+    renderedPageImage.pageWaitTime = pageTimer.restart();
+    const bool isRendered = rasterizer->renderBands(pageIndex, page, &precompiledPage, imageSize, m_features, &annotationManager, PageRotation::None, bandHeight, processBand);
+    renderedPageImage.pageRenderTime = pageTimer.elapsed();
+    renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
+    release(rasterizer);
+
+    if (!isRendered)
+    {
+        Q_EMIT renderError(pageIndex, PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Page %1 can't be rendered in bands.").arg(pageIndex + 1)));
+    }
+
+    return renderedPageImage;
+}
+
+PDFRenderedPageImage PDFRasterizerPool::renderTilePyramid(PDFInteger pageIndex,
+                                                          const PageImageSizeGetter& imageSizeGetter,
+                                                          int tileSize,
+                                                          const PDFRasterizer::TileConsumer& processTile)
+{
+    Q_ASSERT(imageSizeGetter);
+    Q_ASSERT(processTile);
+
+    PDFRenderedPageImage renderedPageImage;
+    renderedPageImage.pageIndex = pageIndex;
+
+    const PDFPage* page = m_document->getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        Q_EMIT renderError(pageIndex, PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Page %1 not found.").arg(pageIndex)));
+        return renderedPageImage;
+    }
+
+    QElapsedTimer totalPageTimer;
+    totalPageTimer.start();
+
+    QElapsedTimer pageTimer;
+    pageTimer.start();
+
+    // Precompile the page only once, images are decoded in resolution
+    // needed for the finest level and are reused by the coarser levels.
+    const QSize imageSize = imageSizeGetter(page);
+    PDFPrecompiledPage precompiledPage;
+    PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
+    if (m_isStatisticsEnabled)
+    {
+        renderedPageImage.statistics = std::make_shared<PDFPageContentProcessorStatistics>();
+    }
+
+    PDFRenderer renderer(m_document, m_fontCache, cms.data(), m_optionalContentActivity, m_features, m_meshQualitySettings);
+    renderer.setImageResolutionHint(PDFRenderer::calculateImageResolutionHint(page, imageSize));
+    renderer.setStatistics(renderedPageImage.statistics.get());
+    renderer.compile(&precompiledPage, pageIndex);
+
+    renderedPageImage.pageCompileTime = pageTimer.restart();
+
+    for (const PDFRenderError& error : precompiledPage.getErrors())
+    {
+        Q_EMIT renderError(pageIndex, error);
+    }
+
+    // We can const-cast here, because we do not modify the document in annotation manager.
+    // Annotations are just rendered to the target picture.
+    PDFModifiedDocument modifiedDocument(const_cast<PDFDocument*>(m_document), const_cast<PDFOptionalContentActivity*>(m_optionalContentActivity));
+
+    // Annotation manager
+    PDFAnnotationManager annotationManager(m_fontCache, m_cmsManager, m_optionalContentActivity, m_meshQualitySettings, m_features, PDFAnnotationManager::Target::Print, nullptr);
+    annotationManager.setDocument(modifiedDocument);
+
+    // Render tiles of all levels
+    pageTimer.restart();
+    PDFRasterizer* rasterizer = acquire();
+    renderedPageImage.pageWaitTime = pageTimer.restart();
+    const bool isRendered = rasterizer->renderTilePyramid(pageIndex, page, &precompiledPage, imageSize, m_features, &annotationManager, PageRotation::None, tileSize, processTile);
+    renderedPageImage.pageRenderTime = pageTimer.elapsed();
+    renderedPageImage.pageTotalTime = totalPageTimer.elapsed();
+    release(rasterizer);
+
+    if (!isRendered)
+    {
+        Q_EMIT renderError(pageIndex, PDFRenderError(RenderErrorType::Error, PDFTranslationContext::tr("Tile pyramid of page %1 can't be rendered.").arg(pageIndex + 1)));
+    }
+
+    return renderedPageImage;
+}
+
+QImage PDFRasterizerPool::acquireImageBuffer(QSize size)
+{
+    QMutexLocker guard(&m_mutex);
+    auto it = std::find_if(m_imageBuffers.begin(), m_imageBuffers.end(), [size](const QImage& image) { return image.size() == size; });
+    if (it != m_imageBuffers.end())
+    {
+        QImage image = qMove(*it);
+        m_imageBuffers.erase(it);
+        return image;
+    }
+
+    return QImage();
+}
+
+void PDFRasterizerPool::releaseImageBuffer(QImage image)
+{
+    if (image.isNull() || !image.isDetached())
+    {
+        // Image is still used by the processing function
+        return;
+    }
+
+    QMutexLocker guard(&m_mutex);
+    if (m_imageBuffers.size() < m_imageBufferLimit)
+    {
+        m_imageBuffers.push_back(qMove(image));
+    }
+}
+
 int PDFRasterizerPool::getDefaultRasterizerCount()
 {
     int hint = QThread::idealThreadCount() / 2;
@@ -472,7 +1255,7 @@ void PDFImageWriterSettings::selectFormat(const QByteArray& format)
         {
             m_compression = 1;
         }
-        else if (format == "webp")
+        else if (format == "webp" || format == "avif")
         {
             m_quality = 75;
         }
@@ -815,7 +1598,9 @@ PDFRasterizerPool::PDFRasterizerPool(const PDFDocument* document,
     m_optionalContentActivity(optionalContentActivity),
     m_features(features),
     m_meshQualitySettings(meshQualitySettings),
-    m_semaphore(rasterizerCount)
+    m_rendererEngine(rendererEngine),
+    m_semaphore(rasterizerCount),
+    m_imageBufferLimit(2 * rasterizerCount)
 {
     m_rasterizers.reserve(rasterizerCount);
     for (int i = 0; i < rasterizerCount; ++i)
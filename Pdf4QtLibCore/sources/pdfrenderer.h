@@ -37,10 +37,12 @@ namespace pdf
 class PDFCMS;
 class PDFProgress;
 class PDFFontCache;
+class PDFDiskCache;
 class PDFCMSManager;
 class PDFPrecompiledPage;
 class PDFAnnotationManager;
 class PDFOptionalContentActivity;
+struct PDFPageContentProcessorStatistics;
 
 /// Renders the PDF page on the painter, or onto an image.
 class PDF4QTLIBCORESHARED_EXPORT PDFRenderer
@@ -67,6 +69,9 @@ public:
         ColorAdjust_HighContrast    = 0x2000,   ///< Convert colors to high constrast colors
         ColorAdjust_Bitonal         = 0x4000,   ///< Convert colors to bitonal (monochromatic)
         ColorAdjust_CustomColors    = 0x8000,   ///< Convert colors to custom color settings
+
+        OverprintSimulation         = 0x10000,  ///< Simulate overprint of subtractive colors (CMYK, separations), lightweight approximation of output preview
+        ColorAdjust_PostRaster      = 0x20000,  ///< Apply color adjustment to the rasterized page, if it gives the same result, so compiled pages don't depend on it
     };
 
     Q_DECLARE_FLAGS(Features, Feature)
@@ -124,9 +129,61 @@ public:
     /// Returns color transformation features
     static constexpr Features getColorFeatures() { return Features(ColorAdjust_Invert | ColorAdjust_Grayscale | ColorAdjust_HighContrast | ColorAdjust_Bitonal | ColorAdjust_CustomColors); }
 
+    /// Returns true, if color adjustment is applied to the rasterized
+    /// page instead of to the compiled page (see ColorAdjust_PostRaster).
+    /// \param features Features
+    static bool isPostRasterColorAdjustment(Features features);
+
+    /// Returns features, with which pages are compiled. If color adjustment
+    /// is applied to the rasterized page, color features are removed, so
+    /// compiled pages can be shared by all color adjustment modes.
+    /// \param features Features
+    static Features getCompileFeatures(Features features);
+
+    /// Applies post-raster color adjustment to the rasterized page, if
+    /// it is enabled by the features, otherwise image is unchanged.
+    /// \param features Features
+    /// \param image Rasterized page image
+    static void applyPostRasterColorAdjustment(Features features, QImage& image);
+
+    /// Calculates image resolution hint (count of device pixels per page point)
+    /// for the page rendered to the image of given size. Hint is computed
+    /// regardless of page rotation, so it can be used for rotated pages too.
+    /// \param page Page
+    /// \param imageSize Size of the page image in pixels
+    static PDFReal calculateImageResolutionHint(const PDFPage* page, QSize imageSize);
+
     const PDFOperationControl* getOperationControl() const;
     void setOperationControl(const PDFOperationControl* newOperationControl);
 
+    /// Returns image resolution hint (see \p setImageResolutionHint)
+    PDFReal getImageResolutionHint() const;
+
+    /// Sets image resolution hint used, when page is compiled. If compiled page
+    /// will be painted only in small resolution (for example, as thumbnail),
+    /// images can be decoded in reduced resolution. Zero means full resolution.
+    /// \param imageResolutionHint Count of device pixels per page point
+    void setImageResolutionHint(PDFReal imageResolutionHint);
+
+    /// Returns true, if image previews are enabled (see \p setImagePreviewsEnabled)
+    bool isImagePreviewsEnabled() const;
+
+    /// Enables image previews used, when page is compiled. Large images, which
+    /// aren't decoded yet, are then decoded quickly in low resolution, and compiled
+    /// page has to be compiled again to obtain full quality images
+    /// (see PDFPrecompiledPage::hasPreviewImages).
+    /// \param imagePreviewsEnabled Enable image previews
+    void setImagePreviewsEnabled(bool imagePreviewsEnabled);
+
+    /// Returns statistics object (see \p setStatistics)
+    PDFPageContentProcessorStatistics* getStatistics() const;
+
+    /// Sets statistics object, into which statistics of the page content
+    /// processing are accumulated, when page is compiled. If it is nullptr,
+    /// statistics are not collected.
+    /// \param statistics Statistics
+    void setStatistics(PDFPageContentProcessorStatistics* statistics);
+
 private:
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
@@ -135,10 +192,17 @@ private:
     const PDFOperationControl* m_operationControl;
     Features m_features;
     PDFMeshQualitySettings m_meshQualitySettings;
+    PDFReal m_imageResolutionHint = 0.0;
+    bool m_imagePreviewsEnabled = false;
+    PDFPageContentProcessorStatistics* m_statistics = nullptr;
 };
 
-/// Renders PDF pages to bitmap images (QImage).
-/// \note Construct this object only in main GUI thread
+/// Renders PDF pages to bitmap images (QImage). Pages are rendered into offscreen
+/// images only, so rasterizer doesn't need QGuiApplication (or a platform plugin)
+/// and it can be constructed and used in any thread. Rasterizer can be used
+/// by one thread at a time, use PDFRasterizerPool to render in many threads.
+/// If QGuiApplication doesn't exist, annotations without appearance streams,
+/// which are drawn using system fonts, are not drawn (see PDFAnnotation::isSystemFontAvailable).
 class PDF4QTLIBCORESHARED_EXPORT PDFRasterizer : public QObject
 {
     Q_OBJECT
@@ -165,16 +229,175 @@ public:
     /// \param features Renderer features
     /// \param annotationManager Annotation manager (can be nullptr)
     /// \param extraRotation Extra page rotation
+    /// \param imageBuffer Image buffer, which is reused for the result, if it has
+    ///        requested size and format and is not shared (otherwise new image is allocated)
     QImage render(PDFInteger pageIndex,
                   const PDFPage* page,
                   const PDFPrecompiledPage* compiledPage,
                   QSize size,
                   PDFRenderer::Features features,
                   const PDFAnnotationManager* annotationManager,
-                  PageRotation extraRotation);
+                  PageRotation extraRotation,
+                  QImage imageBuffer = QImage());
+
+    /// Pixel format of the caller provided buffer
+    enum class BufferFormat
+    {
+        BGRA8888,   ///< 32 bits per pixel, premultiplied alpha, bytes in order blue, green, red, alpha
+        RGB565,     ///< 16 bits per pixel (native byte order), 5 bits red, 6 bits green, 5 bits blue
+        Gray8       ///< 8 bits per pixel, gray
+    };
+
+    /// Renders page into the buffer provided by the caller, no image is allocated
+    /// for the result. On little endian machines, BGRA8888 buffer is rendered directly,
+    /// other formats are converted from the internal image of the rasterizer,
+    /// which is reused by subsequent calls with the same size. Warning: this function
+    /// can modify this object, so it is not const and is not thread safe.
+    /// Returns false, if buffer is invalid.
+    /// \param pageIndex Page index
+    /// \param page Page
+    /// \param compiledPage Compiled page contents
+    /// \param buffer Target buffer
+    /// \param size Size of the target image
+    /// \param bytesPerLine Stride of the target buffer in bytes
+    /// \param format Pixel format of the target buffer
+    /// \param features Renderer features
+    /// \param annotationManager Annotation manager (can be nullptr)
+    /// \param extraRotation Extra page rotation
+    bool render(PDFInteger pageIndex,
+                const PDFPage* page,
+                const PDFPrecompiledPage* compiledPage,
+                uchar* buffer,
+                QSize size,
+                qsizetype bytesPerLine,
+                BufferFormat format,
+                PDFRenderer::Features features,
+                const PDFAnnotationManager* annotationManager,
+                PageRotation extraRotation);
+
+    /// Returns size of the pixel of the buffer format in bytes
+    static int getBytesPerPixel(BufferFormat format);
+
+    /// Function processing rendered bands of the page image. Bands are passed
+    /// in order from top to bottom of the image. If function returns false,
+    /// then rendering is stopped.
+    using BandConsumer = std::function<bool(const QImage&)>;
+
+    /// Renders page to the image of given size in horizontal bands, each band
+    /// is passed to the \p processBand function after it is rendered. So, whole
+    /// page image is never held in the memory, peak memory usage is bounded
+    /// by band size. Bands can be rendered in parallel. Returns false, if
+    /// band processing function failed.
+    /// \param pageIndex Page index
+    /// \param page Page
+    /// \param compiledPage Compiled page contents
+    /// \param size Size of the whole image
+    /// \param features Renderer features
+    /// \param annotationManager Annotation manager (can be nullptr)
+    /// \param extraRotation Extra page rotation
+    /// \param bandHeight Height of the band in pixels
+    /// \param processBand Band processing function
+    bool renderBands(PDFInteger pageIndex,
+                     const PDFPage* page,
+                     const PDFPrecompiledPage* compiledPage,
+                     QSize size,
+                     PDFRenderer::Features features,
+                     const PDFAnnotationManager* annotationManager,
+                     PageRotation extraRotation,
+                     int bandHeight,
+                     const BandConsumer& processBand);
+
+    /// Tile of the tile pyramid of the page image
+    struct Tile
+    {
+        int level = 0;      ///< Level of the pyramid, level 0 is 1x1 image, last level is the whole image
+        int column = 0;     ///< Column of the tile in the level
+        int row = 0;        ///< Row of the tile in the level
+        QImage image;       ///< Tile image (tiles at right and bottom edge of the level can be smaller)
+    };
+
+    /// Function processing rendered tiles of the tile pyramid. Function is called
+    /// from multiple threads at once, so it must be thread safe. If function
+    /// returns false, then rendering is stopped.
+    using TileConsumer = std::function<bool(const Tile&)>;
+
+    /// Renders multi-resolution tile pyramid of the page image (levels as in the
+    /// Deep Zoom image format - each level has half the size of the next one).
+    /// All levels are rendered from the compiled page (not downsampled from the
+    /// finer levels), and tiles of all levels are rendered in parallel. Returns
+    /// false, if tile processing function failed. This function is thread safe.
+    /// \param pageIndex Page index
+    /// \param page Page
+    /// \param compiledPage Compiled page contents
+    /// \param size Size of the whole image (the finest level)
+    /// \param features Renderer features
+    /// \param annotationManager Annotation manager (can be nullptr)
+    /// \param extraRotation Extra page rotation
+    /// \param tileSize Size of the tile in pixels
+    /// \param processTile Tile processing function
+    bool renderTilePyramid(PDFInteger pageIndex,
+                           const PDFPage* page,
+                           const PDFPrecompiledPage* compiledPage,
+                           QSize size,
+                           PDFRenderer::Features features,
+                           const PDFAnnotationManager* annotationManager,
+                           PageRotation extraRotation,
+                           int tileSize,
+                           const TileConsumer& processTile) const;
+
+    /// Returns number of levels of the tile pyramid of the image of given size
+    /// \param size Size of the whole image
+    static int getTilePyramidLevelCount(QSize size);
+
+    /// Returns size of the image of given level of the tile pyramid
+    /// \param size Size of the whole image
+    /// \param level Level of the pyramid
+    static QSize getTilePyramidLevelSize(QSize size, int level);
 
 private:
+    /// Sets resolution of the image of page of given size in pixels
+    static void setImageResolution(QImage& image, const PDFPage* page, QSize size);
+
+    /// Renders page into the whole image (image must have ARGB32 premultiplied
+    /// format), large images are rendered in parallel bands.
+    void renderPageImage(QImage& image,
+                         PDFInteger pageIndex,
+                         const PDFPage* page,
+                         const PDFPrecompiledPage* compiledPage,
+                         PDFRenderer::Features features,
+                         const PDFAnnotationManager* annotationManager,
+                         PageRotation extraRotation) const;
+
+    /// Images with at least this number of pixels are divided into horizontal
+    /// bands, which are rendered in parallel.
+    static constexpr qint64 PARALLEL_RENDERING_MIN_PIXELS = 2048 * 2048;
+
+    /// Minimal height of the band in pixels
+    static constexpr int MIN_BAND_HEIGHT = 256;
+
+    /// Renders page contents (and annotations) to the image using current
+    /// renderer engine. This function is thread safe, so it can be used to
+    /// render multiple parts of the page image in parallel.
+    /// \param image Target image
+    /// \param pageIndex Page index
+    /// \param page Page
+    /// \param compiledPage Compiled page contents
+    /// \param matrix Page point to image point matrix
+    /// \param features Renderer features
+    /// \param annotationManager Annotation manager (can be nullptr)
+    void renderImage(QImage& image,
+                     PDFInteger pageIndex,
+                     const PDFPage* page,
+                     const PDFPrecompiledPage* compiledPage,
+                     const QTransform& matrix,
+                     PDFRenderer::Features features,
+                     const PDFAnnotationManager* annotationManager) const;
+
     RendererEngine m_rendererEngine;
+
+    /// Image, into which pages are rendered, if they are
+    /// rendered into the buffer with other pixel format
+    QImage m_conversionImage;
 };
 
 /// Simple structure for storing rendered page images
@@ -185,7 +408,12 @@ struct PDFRenderedPageImage
     qint64 pageRenderTime = 0;
     qint64 pageTotalTime = 0;
     PDFInteger pageIndex;
+    int sizeIndex = 0; ///< Index of the image size, if page is rendered in multiple sizes
     QImage pageImage;
+
+    /// Statistics of the page content processing (only if statistics
+    /// are enabled in the rasterizer pool, otherwise nullptr)
+    std::shared_ptr<PDFPageContentProcessorStatistics> statistics;
 };
 
 /// Pool of page image renderers. It can use predefined number of renderers to
@@ -203,6 +431,7 @@ public:
 
 
     using PageImageSizeGetter = std::function<QSize(const PDFPage*)>;
+    using PageImageSizesGetter = std::function<std::vector<QSize>(const PDFPage*)>;
     using ProcessImageMethod = std::function<void(PDFRenderedPageImage&)>;
 
     /// Creates new rasterizer pool
@@ -245,6 +474,51 @@ public:
                 const ProcessImageMethod& processImage,
                 PDFProgress* progress);
 
+    /// Renders pages asynchronously to images in multiple sizes (for example,
+    /// thumbnail, preview and print-size image). Each page is compiled only once,
+    /// images on the page are decoded in resolution needed for the largest image,
+    /// then page is rasterized in each requested size. Process image function is
+    /// called for each image, index of the size is stored in the rendered page image.
+    /// \param pageIndices Page indices for rendered pages
+    /// \param imageSizesGetter Getter, which computes image sizes from page index
+    /// \param processImage Method, which processes rendered page images
+    /// \param progress Progress indicator
+    void renderSizes(const std::vector<PDFInteger>& pageIndices,
+                     const PageImageSizesGetter& imageSizesGetter,
+                     const ProcessImageMethod& processImage,
+                     PDFProgress* progress);
+
+    /// Renders page in horizontal bands, rendered bands are passed to the
+    /// band processing function (for example, to stream them directly
+    /// to the file), so whole page image is never held in the memory.
+    /// Returned structure contains rendering statistics, image is null. If page
+    /// can't be rendered, or band processing fails, then render error is emitted.
+    /// \param pageIndex Page index
+    /// \param imageSizeGetter Getter, which computes image size from page index
+    /// \param bandHeight Height of the band in pixels
+    /// \param processBand Band processing function
+    PDFRenderedPageImage renderBands(PDFInteger pageIndex,
+                                     const PageImageSizeGetter& imageSizeGetter,
+                                     int bandHeight,
+                                     const PDFRasterizer::BandConsumer& processBand);
+
+    /// Renders tile pyramid of the page image (see PDFRasterizer::renderTilePyramid).
+    /// Page is compiled only once, then tiles of all levels are rendered from
+    /// the compiled page in parallel. Returned structure contains rendering
+    /// statistics, image is null. If page can't be rendered, or tile processing
+    /// fails, then render error is emitted. This function can be called
+    /// for multiple pages in parallel.
+    /// \param pageIndex Page index
+    /// \param imageSizeGetter Getter, which computes size of the finest level from page index
+    /// \param tileSize Size of the tile in pixels
+    /// \param processTile Tile processing function (called from multiple threads)
+    PDFRenderedPageImage renderTilePyramid(PDFInteger pageIndex,
+                                           const PageImageSizeGetter& imageSizeGetter,
+                                           int tileSize,
+                                           const PDFRasterizer::TileConsumer& processTile);
+
+    const PDFDocument* getDocument() const { return m_document; }
+
     /// Returns default rasterizer count
     static int getDefaultRasterizerCount();
 
@@ -255,6 +529,25 @@ public:
     /// \returns Corrected number of rasterizers
     static int getCorrectedRasterizerCount(int rasterizerCount);
 
+    /// Returns true, if statistics of the page content processing are collected
+    bool isStatisticsEnabled() const { return m_isStatisticsEnabled; }
+
+    /// Enables collecting of statistics of the page content processing. Statistics
+    /// are then stored in the rendered page images (see PDFRenderedPageImage::statistics).
+    /// \param statisticsEnabled Enable statistics
+    void setStatisticsEnabled(bool statisticsEnabled) { m_isStatisticsEnabled = statisticsEnabled; }
+
+    /// Returns disk cache of rendered page images (can be nullptr)
+    PDFDiskCache* getDiskCache() const { return m_diskCache; }
+
+    /// Sets disk cache of rendered page images. Images are keyed by the canonical
+    /// hash of the page content (see PDFPageContentHash) and by rendering settings,
+    /// so identical pages of different documents are rendered only once. Render
+    /// errors are reported only, when page is actually rendered. Disk cache isn't
+    /// used by band rendering. Cache must outlive the rasterizer pool.
+    /// \param diskCache Disk cache (can be nullptr, then cache isn't used)
+    void setDiskCache(PDFDiskCache* diskCache) { m_diskCache = diskCache; }
+
 signals:
     void renderError(PDFInteger pageIndex, PDFRenderError error);
 
@@ -265,10 +558,47 @@ private:
     const PDFOptionalContentActivity* m_optionalContentActivity;
     PDFRenderer::Features m_features;
     const PDFMeshQualitySettings& m_meshQualitySettings;
+    RendererEngine m_rendererEngine;
+
+    /// Returns key of the rendered page image in the disk cache, or
+    /// empty key, if disk cache isn't used.
+    /// \param pageIndex Page index
+    /// \param imageSize Image size
+    QByteArray getDiskCacheKey(PDFInteger pageIndex, QSize imageSize) const;
+
+    /// Reads page image from the disk cache. If image isn't in the cache,
+    /// or disk cache isn't used, null image is returned.
+    /// \param diskCacheKey Key of the page image (see \p getDiskCacheKey)
+    /// \param imageSize Image size
+    QImage readDiskCache(const QByteArray& diskCacheKey, QSize imageSize) const;
+
+    /// Writes page image to the disk cache, if disk cache is used
+    /// \param diskCacheKey Key of the page image (see \p getDiskCacheKey)
+    /// \param image Page image
+    void writeDiskCache(const QByteArray& diskCacheKey, const QImage& image) const;
+
+    /// Acquires image buffer of given size from the pool of buffers
+    /// returned by previously rendered pages. If there is no such buffer,
+    /// null image is returned. This function is thread safe.
+    /// \param size Image size
+    QImage acquireImageBuffer(QSize size);
+
+    /// Returns image buffer back to the pool, so it can be reused for
+    /// rendering of next page. Buffer is returned only, if it is not
+    /// shared (processing function didn't keep the image). This function
+    /// is thread safe.
+    /// \param image Image buffer
+    void releaseImageBuffer(QImage image);
 
     QSemaphore m_semaphore;
     QMutex m_mutex;
     std::vector<PDFRasterizer*> m_rasterizers;
+
+    /// Image buffers of rendered pages, which can be reused (protected by mutex)
+    std::vector<QImage> m_imageBuffers;
+    size_t m_imageBufferLimit;
+    bool m_isStatisticsEnabled = false;
+    PDFDiskCache* m_diskCache = nullptr;
 };
 
 /// Settings object for image writer
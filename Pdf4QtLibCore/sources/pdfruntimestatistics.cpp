@@ -0,0 +1,153 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfruntimestatistics.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfcachemanager.h"
+
+#include <QLocale>
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+void PDFRuntimeStatisticsCollector::addCounter(QString name, quint64 value, PDFRuntimeStatistic::Unit unit)
+{
+    PDFRuntimeStatistic statistic;
+    statistic.group = m_group;
+    statistic.name = qMove(name);
+    statistic.type = PDFRuntimeStatistic::Type::Counter;
+    statistic.unit = unit;
+    statistic.value = PDFReal(value);
+    m_statistics.push_back(qMove(statistic));
+}
+
+void PDFRuntimeStatisticsCollector::addGauge(QString name, PDFReal value, PDFRuntimeStatistic::Unit unit)
+{
+    PDFRuntimeStatistic statistic;
+    statistic.group = m_group;
+    statistic.name = qMove(name);
+    statistic.type = PDFRuntimeStatistic::Type::Gauge;
+    statistic.unit = unit;
+    statistic.value = value;
+    m_statistics.push_back(qMove(statistic));
+}
+
+void PDFRuntimeStatisticsCollector::addHitRate(const QString& name, quint64 hits, quint64 misses)
+{
+    const quint64 lookups = hits + misses;
+    addCounter(QString("%1 hits").arg(name), hits);
+    addCounter(QString("%1 misses").arg(name), misses);
+    addGauge(QString("%1 hit rate").arg(name), lookups > 0 ? 100.0 * PDFReal(hits) / PDFReal(lookups) : 0.0, PDFRuntimeStatistic::Unit::Percent);
+}
+
+PDFRuntimeStatisticsManager* PDFRuntimeStatisticsManager::getInstance()
+{
+    static PDFRuntimeStatisticsManager manager;
+    return &manager;
+}
+
+void PDFRuntimeStatisticsManager::registerProvider(const PDFRuntimeStatisticsProvider* provider, QString group)
+{
+    QMutexLocker lock(&m_mutex);
+
+    auto it = std::find_if(m_providers.begin(), m_providers.end(), [provider](const Provider& item) { return item.provider == provider; });
+    if (it == m_providers.end())
+    {
+        m_providers.push_back(Provider{ provider, qMove(group) });
+    }
+}
+
+void PDFRuntimeStatisticsManager::unregisterProvider(const PDFRuntimeStatisticsProvider* provider)
+{
+    QMutexLocker lock(&m_mutex);
+    m_providers.erase(std::remove_if(m_providers.begin(), m_providers.end(), [provider](const Provider& item) { return item.provider == provider; }), m_providers.end());
+}
+
+PDFRuntimeStatistics PDFRuntimeStatisticsManager::collect() const
+{
+    PDFRuntimeStatisticsCollector collector;
+    collectBuiltinStatistics(&collector);
+
+    // Providers are called with locked mutex, so provider
+    // can't be unregistered (and destroyed) meanwhile.
+    QMutexLocker lock(&m_mutex);
+    for (const Provider& provider : m_providers)
+    {
+        collector.setGroup(provider.group);
+        provider.provider->collectRuntimeStatistics(&collector);
+    }
+
+    return collector.takeStatistics();
+}
+
+QString PDFRuntimeStatisticsManager::toText(const PDFRuntimeStatistics& statistics)
+{
+    QString text;
+    for (const PDFRuntimeStatistic& statistic : statistics)
+    {
+        text += QString("%1 / %2: %3\n").arg(statistic.group, statistic.name, getFormattedValue(statistic));
+    }
+    return text;
+}
+
+QString PDFRuntimeStatisticsManager::getFormattedValue(const PDFRuntimeStatistic& statistic)
+{
+    QLocale locale;
+
+    switch (statistic.unit)
+    {
+        case PDFRuntimeStatistic::Unit::None:
+            return locale.toString(qint64(statistic.value));
+
+        case PDFRuntimeStatistic::Unit::Bytes:
+            return locale.formattedDataSize(qint64(statistic.value));
+
+        case PDFRuntimeStatistic::Unit::Percent:
+            return QString("%1 %").arg(locale.toString(statistic.value, 'f', 1));
+    }
+
+    Q_ASSERT(false);
+    return QString();
+}
+
+void PDFRuntimeStatisticsManager::collectBuiltinStatistics(PDFRuntimeStatisticsCollector* collector)
+{
+    auto addThreadPool = [collector](PDFExecutionPolicy::Scope scope, QString group)
+    {
+        collector->setGroup(qMove(group));
+        collector->addGauge(PDFTranslationContext::tr("Active threads"), PDFExecutionPolicy::getActiveThreadCount(scope));
+        collector->addGauge(PDFTranslationContext::tr("Maximal threads"), PDFExecutionPolicy::getMaxThreadCount(scope));
+        collector->addGauge(PDFTranslationContext::tr("Queued tasks"), PDFExecutionPolicy::getQueuedTaskCount(scope));
+    };
+
+    addThreadPool(PDFExecutionPolicy::Scope::Page, PDFTranslationContext::tr("Thread pool (pages)"));
+    addThreadPool(PDFExecutionPolicy::Scope::Content, PDFTranslationContext::tr("Thread pool (content)"));
+    collector->addGauge(PDFTranslationContext::tr("Processed content streams"), PDFExecutionPolicy::getContentStreamCount());
+
+    PDFCacheManager* cacheManager = PDFCacheManager::getInstance();
+    collector->setGroup(PDFTranslationContext::tr("Cache manager"));
+    collector->addGauge(PDFTranslationContext::tr("Total cache size"), cacheManager->getTotalCacheSize(), PDFRuntimeStatistic::Unit::Bytes);
+    collector->addGauge(PDFTranslationContext::tr("Memory budget"), cacheManager->getMemoryBudget(), PDFRuntimeStatistic::Unit::Bytes);
+    collector->addGauge(PDFTranslationContext::tr("Effective memory budget"), cacheManager->getEffectiveMemoryBudget(), PDFRuntimeStatistic::Unit::Bytes);
+    collector->addGauge(PDFTranslationContext::tr("Under memory pressure"), cacheManager->isUnderMemoryPressure() ? 1 : 0);
+}
+
+}   // namespace pdf
@@ -0,0 +1,162 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFRUNTIMESTATISTICS_H
+#define PDFRUNTIMESTATISTICS_H
+
+#include "pdfglobal.h"
+
+#include <QMutex>
+#include <QString>
+
+#include <vector>
+
+namespace pdf
+{
+
+/// Single value of the runtime statistics. Counters are monotonically
+/// increasing values (for example, cache hits), gauges are current
+/// values (for example, memory consumed by the cache).
+struct PDFRuntimeStatistic
+{
+    enum class Type
+    {
+        Counter,
+        Gauge
+    };
+
+    enum class Unit
+    {
+        None,
+        Bytes,
+        Percent
+    };
+
+    QString group;
+    QString name;
+    Type type = Type::Gauge;
+    Unit unit = Unit::None;
+    PDFReal value = 0.0;
+};
+
+using PDFRuntimeStatistics = std::vector<PDFRuntimeStatistic>;
+
+/// Collects statistics from the providers. Statistics are added
+/// to the current group, which is set before the provider is called.
+class PDF4QTLIBCORESHARED_EXPORT PDFRuntimeStatisticsCollector
+{
+public:
+    explicit PDFRuntimeStatisticsCollector() = default;
+
+    /// Sets group of subsequently added statistics
+    void setGroup(QString group) { m_group = qMove(group); }
+
+    /// Adds counter
+    /// \param name Name of the counter
+    /// \param value Value
+    /// \param unit Unit
+    void addCounter(QString name, quint64 value, PDFRuntimeStatistic::Unit unit = PDFRuntimeStatistic::Unit::None);
+
+    /// Adds gauge
+    /// \param name Name of the gauge
+    /// \param value Value
+    /// \param unit Unit
+    void addGauge(QString name, PDFReal value, PDFRuntimeStatistic::Unit unit = PDFRuntimeStatistic::Unit::None);
+
+    /// Adds hit and miss counters and hit rate gauge (in percents)
+    /// \param name Name of the cache (or lookup) prefixing the statistics
+    /// \param hits Hit count
+    /// \param misses Miss count
+    void addHitRate(const QString& name, quint64 hits, quint64 misses);
+
+    /// Returns collected statistics
+    const PDFRuntimeStatistics& getStatistics() const { return m_statistics; }
+
+    /// Takes collected statistics
+    PDFRuntimeStatistics takeStatistics() { return qMove(m_statistics); }
+
+private:
+    QString m_group;
+    PDFRuntimeStatistics m_statistics;
+};
+
+/// Object, which provides runtime statistics (counters and gauges),
+/// for example, cache. Function \p collectRuntimeStatistics is called
+/// from the main thread, but object can be used in other threads
+/// at the same time, so it must be implemented in thread safe manner.
+class PDF4QTLIBCORESHARED_EXPORT PDFRuntimeStatisticsProvider
+{
+public:
+    virtual ~PDFRuntimeStatisticsProvider() = default;
+
+    /// Adds statistics of the object to the collector
+    /// \param collector Collector
+    virtual void collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const = 0;
+};
+
+/// Process-wide registry of runtime statistics providers. Statistics of all
+/// registered providers can be collected at once, together with statistics of
+/// the thread pools (see PDFExecutionPolicy) and of the cache manager. It is
+/// used for tuning of cache limits, so statistics should be cheap to collect.
+/// Class is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFRuntimeStatisticsManager
+{
+public:
+    /// Returns instance of the runtime statistics manager
+    static PDFRuntimeStatisticsManager* getInstance();
+
+    /// Registers provider to the manager
+    /// \param provider Provider
+    /// \param group Group name of the statistics of the provider
+    void registerProvider(const PDFRuntimeStatisticsProvider* provider, QString group);
+
+    /// Unregisters provider from the manager. Call this function
+    /// before the provider is destroyed.
+    /// \param provider Provider
+    void unregisterProvider(const PDFRuntimeStatisticsProvider* provider);
+
+    /// Collects statistics of all registered providers, thread pools
+    /// and cache manager.
+    PDFRuntimeStatistics collect() const;
+
+    /// Returns statistics formatted as text, one value per line
+    /// \param statistics Statistics
+    static QString toText(const PDFRuntimeStatistics& statistics);
+
+    /// Returns formatted value of the statistic (with unit)
+    /// \param statistic Statistic
+    static QString getFormattedValue(const PDFRuntimeStatistic& statistic);
+
+private:
+    explicit PDFRuntimeStatisticsManager() = default;
+
+    struct Provider
+    {
+        const PDFRuntimeStatisticsProvider* provider = nullptr;
+        QString group;
+    };
+
+    /// Adds statistics of the thread pools and of the cache manager
+    static void collectBuiltinStatistics(PDFRuntimeStatisticsCollector* collector);
+
+    mutable QMutex m_mutex;
+    std::vector<Provider> m_providers;
+};
+
+}   // namespace pdf
+
+#endif // PDFRUNTIMESTATISTICS_H
@@ -60,6 +60,146 @@ void sk_x509_free_impl(STACK_OF(X509)* ptr)
     sk_X509_free(ptr);
 }
 
+/// Cipher context for AES in CBC mode, each thread has its own context, so
+/// context is allocated only once per thread. Key schedule is computed only,
+/// when key (or direction) is changed, so for AESV3, where every object is
+/// encrypted using the same file encryption key, it is computed only once.
+/// EVP interface uses hardware acceleration (AES-NI), if it is available.
+class PDFAES_CBC_Context
+{
+public:
+    explicit PDFAES_CBC_Context() : m_context(EVP_CIPHER_CTX_new()) { }
+    ~PDFAES_CBC_Context() { EVP_CIPHER_CTX_free(m_context); }
+
+    PDFAES_CBC_Context(const PDFAES_CBC_Context&) = delete;
+    PDFAES_CBC_Context& operator=(const PDFAES_CBC_Context&) = delete;
+
+    /// Returns cipher context of the current thread
+    static PDFAES_CBC_Context* getThreadContext()
+    {
+        thread_local PDFAES_CBC_Context context;
+        return &context;
+    }
+
+    /// Encrypts or decrypts data, padding is not used, so size of the data
+    /// must be multiple of AES block size. Throws exception on error.
+    /// \param key Key (16 or 32 bytes long)
+    /// \param keySize Size of the key in bytes
+    /// \param initializationVector Initialization vector (AES_BLOCK_SIZE bytes long)
+    /// \param input Input data
+    /// \param output Output data (must be at least as long as input data)
+    /// \param size Size of the data
+    /// \param encrypt Encrypt (true), or decrypt (false) the data
+    void process(const uint8_t* key,
+                 int keySize,
+                 const uint8_t* initializationVector,
+                 const uint8_t* input,
+                 uint8_t* output,
+                 int size,
+                 bool encrypt)
+    {
+        Q_ASSERT(size % AES_BLOCK_SIZE == 0);
+
+        bool isInitialized = false;
+        if (m_context && m_keySize == keySize && m_encrypt == encrypt && std::equal(key, key + keySize, m_key.cbegin()))
+        {
+            // Key schedule is kept, only initialization vector is changed
+            isInitialized = EVP_CipherInit_ex(m_context, nullptr, nullptr, nullptr, initializationVector, encrypt ? 1 : 0) == 1;
+        }
+        else if (m_context && keySize > 0 && keySize <= static_cast<int>(m_key.size()))
+        {
+            const EVP_CIPHER* cipher = (keySize == 32) ? EVP_aes_256_cbc() : ((keySize == 24) ? EVP_aes_192_cbc() : EVP_aes_128_cbc());
+            isInitialized = EVP_CipherInit_ex(m_context, cipher, nullptr, key, initializationVector, encrypt ? 1 : 0) == 1;
+
+            if (isInitialized)
+            {
+                std::copy(key, key + keySize, m_key.begin());
+                m_keySize = keySize;
+                m_encrypt = encrypt;
+            }
+            else
+            {
+                m_keySize = 0;
+            }
+        }
+
+        int outputSize = 0;
+        int finalSize = 0;
+        if (!isInitialized ||
+            EVP_CIPHER_CTX_set_padding(m_context, 0) != 1 ||
+            EVP_CipherUpdate(m_context, output, &outputSize, input, size) != 1 ||
+            EVP_CipherFinal_ex(m_context, output + outputSize, &finalSize) != 1)
+        {
+            m_keySize = 0;
+            throw PDFException(PDFTranslationContext::tr("AES cipher failed."));
+        }
+    }
+
+private:
+    EVP_CIPHER_CTX* m_context;
+    std::array<uint8_t, 32> m_key = { };
+    int m_keySize = 0;
+    bool m_encrypt = false;
+};
+
+/// Decrypts data using AES in CBC mode, initialization vector is stored
+/// in the first block of the data and padding is removed from the result.
+/// \param key Key
+/// \param keySize Size of the key in bytes
+/// \param data Encrypted data
+static QByteArray decryptAES_CBC(const uint8_t* key, int keySize, const QByteArray& data)
+{
+    // This is an error, but to handle it, we pad the
+    // initialization vector with zeroes.
+    std::array<uint8_t, AES_BLOCK_SIZE> initializationVector = { };
+    std::copy_n(convertByteArrayToUcharPtr(data), qMin<int>(data.size(), AES_BLOCK_SIZE), initializationVector.begin());
+
+    // Remove errorneous data - we must have a data of multiple of AES_BLOCK_SIZE
+    int size = data.size() - AES_BLOCK_SIZE;
+    size -= size % AES_BLOCK_SIZE;
+
+    if (size <= 0)
+    {
+        return QByteArray();
+    }
+
+    QByteArray decryptedData(size, Qt::Uninitialized);
+    PDFAES_CBC_Context::getThreadContext()->process(key, keySize, initializationVector.data(), convertByteArrayToUcharPtr(data) + AES_BLOCK_SIZE, convertByteArrayToUcharPtr(decryptedData), size, false);
+
+    // If padding doesnt fit from 1 to AES_BLOCK_SIZE, then it is
+    // an error, but just clamp the value.
+    const int padding = static_cast<uint8_t>(decryptedData.back());
+    const int clampedPadding = qBound(1, padding, AES_BLOCK_SIZE);
+    decryptedData.chop(clampedPadding);
+
+    return decryptedData;
+}
+
+/// Encrypts data using AES in CBC mode, data are padded according to the
+/// PDF specification and random initialization vector is prepended.
+/// \param key Key
+/// \param keySize Size of the key in bytes
+/// \param data Data to be encrypted
+static QByteArray encryptAES_CBC(const uint8_t* key, int keySize, const QByteArray& data)
+{
+    QRandomGenerator randomNumberGenerator = QRandomGenerator::securelySeeded();
+
+    // Add padding remainder according to the specification
+    const int paddingRemainder = AES_BLOCK_SIZE - (data.size() % AES_BLOCK_SIZE);
+    QByteArray paddedData = data;
+    paddedData.append(paddingRemainder, char(paddingRemainder));
+
+    QByteArray encryptedData(AES_BLOCK_SIZE + paddedData.size(), Qt::Uninitialized);
+    uint8_t* initializationVector = convertByteArrayToUcharPtr(encryptedData);
+    for (int i = 0; i < AES_BLOCK_SIZE; ++i)
+    {
+        initializationVector[i] = uint8_t(randomNumberGenerator.generate());
+    }
+
+    PDFAES_CBC_Context::getThreadContext()->process(key, keySize, initializationVector, convertByteArrayToUcharPtr(paddedData), initializationVector + AES_BLOCK_SIZE, paddedData.size(), true);
+    return encryptedData;
+}
+
 // Padding password
 static constexpr std::array<uint8_t, 32> PDFPasswordPadding = {
     0x28, 0xBF, 0x4E, 0x5E, 0x4E, 0x75, 0x8A, 0x41,
@@ -848,52 +988,6 @@ QByteArray PDFStandardOrPublicSecurityHandler::decryptUsingFilter(const QByteArr
 
     Q_ASSERT(m_authorizationData.isAuthorized());
 
-    struct AES_data
-    {
-        QByteArray initializationVector;
-        QByteArray paddedData;
-    };
-
-    auto prepareAES_data = [](const QByteArray& data)
-    {
-        AES_data result;
-
-        result.initializationVector = data.left(AES_BLOCK_SIZE);
-
-        // This is an error. But to handle it, we resize the vector
-        // with arbitrary data.
-        if (result.initializationVector.size() < AES_BLOCK_SIZE)
-        {
-            result.initializationVector.resize(AES_BLOCK_SIZE);
-        }
-
-        result.paddedData = data.mid(AES_BLOCK_SIZE);
-
-        // Remove errorneous data - we must have a data of multiple of AES_BLOCK_SIZE
-        const int remainder = result.paddedData.size() % AES_BLOCK_SIZE;
-        if (remainder != 0)
-        {
-            result.paddedData = result.paddedData.left(result.paddedData.size() - remainder);
-        }
-
-        return result;
-    };
-
-    auto removeAES_padding = [](const QByteArray& data)
-    {
-        if (data.isEmpty())
-        {
-            return data;
-        }
-
-        // If padding doesnt fit from 1 to AES_BLOCK_SIZE, then it is
-        // an error, but just clamp the value.
-        const int padding = data.back();
-        const int clampedPadding = qBound(1, padding, AES_BLOCK_SIZE);
-
-        return data.left(data.size() - clampedPadding);
-    };
-
     switch (filter.type)
     {
         case CryptFilterType::None:       // The application shall decrypt the data using the security handler
@@ -921,17 +1015,7 @@ QByteArray PDFStandardOrPublicSecurityHandler::decryptUsingFilter(const QByteArr
             std::vector<uint8_t> objectEncryptionKey = createAESV2_ObjectEncryptionKey(reference);
 
             // For AES algorithm, always use 16 bytes key (128 bit encryption mode)
-
-            AES_KEY key = { };
-            AES_set_decrypt_key(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                decryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(decryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_DECRYPT);
-                decryptedData = removeAES_padding(decryptedData);
-            }
+            decryptedData = decryptAES_CBC(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()), data);
 
             break;
         }
@@ -939,16 +1023,7 @@ QByteArray PDFStandardOrPublicSecurityHandler::decryptUsingFilter(const QByteArr
         case CryptFilterType::AESV3:      // Use file encryption key for AES 256 bit algorithm
         {
             Q_ASSERT(m_authorizationData.fileEncryptionKey.size() == 32);
-            AES_KEY key = { };
-            AES_set_decrypt_key(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                decryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(decryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_DECRYPT);
-                decryptedData = removeAES_padding(decryptedData);
-            }
+            decryptedData = decryptAES_CBC(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()), data);
 
             break;
         }
@@ -969,39 +1044,6 @@ QByteArray PDFStandardOrPublicSecurityHandler::encryptUsingFilter(const QByteArr
 
     Q_ASSERT(m_authorizationData.isAuthorized());
 
-    struct AES_data
-    {
-        QByteArray initializationVector;
-        QByteArray paddedData;
-    };
-
-    auto prepareAES_data = [](const QByteArray& data)
-    {
-        AES_data result;
-
-        QRandomGenerator randomNumberGenerator = QRandomGenerator::securelySeeded();
-
-        result.initializationVector.resize(AES_BLOCK_SIZE);
-        for (int i = 0; i < AES_BLOCK_SIZE; ++i)
-        {
-            result.initializationVector[i] = uint8_t(randomNumberGenerator.generate());
-        }
-
-        result.paddedData = data;
-
-        // Add padding remainder according to the specification
-        int size = data.size();
-        const int paddingRemainder = AES_BLOCK_SIZE - (size % AES_BLOCK_SIZE);
-
-        result.initializationVector.reserve(result.initializationVector.size() + paddingRemainder);
-        for (int i = 0; i < paddingRemainder; ++i)
-        {
-            result.paddedData.push_back(paddingRemainder);
-        }
-
-        return result;
-    };
-
     switch (filter.type)
     {
         case CryptFilterType::None:       // The application shall encrypt the data using the security handler
@@ -1030,18 +1072,7 @@ QByteArray PDFStandardOrPublicSecurityHandler::encryptUsingFilter(const QByteArr
             std::vector<uint8_t> objectEncryptionKey = createAESV2_ObjectEncryptionKey(reference);
 
             // For AES algorithm, always use 16 bytes key (128 bit encryption mode)
-
-            AES_KEY key = { };
-            AES_set_encrypt_key(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                QByteArray initializationVectorCopy = aes_data.initializationVector;
-                encryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(encryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_ENCRYPT);
-                encryptedData.prepend(initializationVectorCopy);
-            }
+            encryptedData = encryptAES_CBC(objectEncryptionKey.data(), static_cast<int>(objectEncryptionKey.size()), data);
 
             break;
         }
@@ -1049,17 +1080,7 @@ QByteArray PDFStandardOrPublicSecurityHandler::encryptUsingFilter(const QByteArr
         case CryptFilterType::AESV3:      // Use file encryption key for AES 256 bit algorithm
         {
             Q_ASSERT(m_authorizationData.fileEncryptionKey.size() == 32);
-            AES_KEY key = { };
-            AES_set_encrypt_key(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()) * 8, &key);
-
-            AES_data aes_data = prepareAES_data(data);
-            if (!aes_data.paddedData.isEmpty())
-            {
-                QByteArray initializationVectorCopy = aes_data.initializationVector;
-                encryptedData.resize(aes_data.paddedData.size());
-                AES_cbc_encrypt(convertByteArrayToUcharPtr(aes_data.paddedData), convertByteArrayToUcharPtr(encryptedData), aes_data.paddedData.length(), &key, convertByteArrayToUcharPtr(aes_data.initializationVector), AES_ENCRYPT);
-                encryptedData.prepend(initializationVectorCopy);
-            }
+            encryptedData = encryptAES_CBC(convertByteArrayToUcharPtr(m_authorizationData.fileEncryptionKey), static_cast<int>(m_authorizationData.fileEncryptionKey.size()), data);
 
             break;
         }
@@ -20,6 +20,7 @@
 #include "pdfencoding.h"
 #include "pdfform.h"
 #include "pdfutils.h"
+#include "pdfexecutionpolicy.h"
 #include "pdfsignaturehandler_impl.h"
 
 #if defined(PDF4QT_COMPILER_MINGW) || defined(PDF4QT_COMPILER_GCC)
@@ -45,6 +46,7 @@
 #include <QLockFile>
 #include <QDataStream>
 #include <QMutexLocker>
+#include <QCryptographicHash>
 #include <QStandardPaths>
 
 #include "pdfdbgheap.h"
@@ -200,13 +202,16 @@ std::vector<PDFSignatureVerificationResult> PDFSignatureHandler::verifySignature
             }
         };
         form.apply(getSignatureFields);
-        result.reserve(signatureFields.size());
+        result.resize(signatureFields.size());
 
-        for (const PDFFormFieldSignature* signatureField : signatureFields)
+        // Jakub Melka: signatures are independent, so we verify them in parallel.
+        // Each signature stores its result at its own index, so order is preserved.
+        auto verifySignatureField = [&](size_t i)
         {
+            const PDFFormFieldSignature* signatureField = signatureFields[i];
             if (const PDFSignatureHandler* signatureHandler = createHandler(signatureField, sourceData, parameters))
             {
-                result.emplace_back(signatureHandler->verify());
+                result[i] = signatureHandler->verify();
                 delete signatureHandler;
             }
             else
@@ -215,9 +220,12 @@ std::vector<PDFSignatureVerificationResult> PDFSignatureHandler::verifySignature
                 QString qualifiedName = signatureField->getName(PDFFormField::NameType::FullyQualified);
                 PDFSignatureVerificationResult verificationResult(signatureField->getSignature().getType(), signatureFieldReference, qMove(qualifiedName));
                 verificationResult.addNoHandlerError(signatureField->getSignature().getSubfilter());
-                result.emplace_back(qMove(verificationResult));
+                result[i] = qMove(verificationResult);
             }
-        }
+        };
+
+        PDFIntegerRange<size_t> indices(0, signatureFields.size());
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), verifySignatureField);
     }
 
     return result;
@@ -531,16 +539,15 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
     const unsigned char* data = convertByteArrayToUcharPtr(content);
     if (PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size()))
     {
-        X509_STORE* store = X509_STORE_new();
+        // Store of trusted certificates is created only when needed, because
+        // validation results of already validated chains are cached.
+        X509_STORE* store = nullptr;
         X509_STORE_CTX* context = X509_STORE_CTX_new();
 
-        // Above functions can fail only if not enough memory. But in this
+        // Above function can fail only if not enough memory. But in this
         // case, this library will crash anyway.
-        Q_ASSERT(store);
         Q_ASSERT(context);
 
-        addTrustedCertificates(store);
-
         STACK_OF(PKCS7_SIGNER_INFO)* signerInfo = PKCS7_get_signer_info(pkcs7);
         const int signerInfoCount = sk_PKCS7_SIGNER_INFO_num(signerInfo);
         STACK_OF(X509)* certificates = getCertificates(pkcs7);
@@ -558,30 +565,77 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
                     break;
                 }
 
-                if (!X509_STORE_CTX_init(context, store, signer, certificates))
+                unsigned long flags = X509_V_FLAG_TRUSTED_FIRST;
+                if (m_parameters.ignoreExpirationDate)
                 {
-                    result.addCertificateGenericError();
-                    break;
+                    flags |= X509_V_FLAG_NO_CHECK_TIME;
                 }
 
-                if (!X509_STORE_CTX_set_purpose(context, X509_PURPOSE_SMIME_SIGN))
+                QByteArray fingerprint;
+                std::optional<PDFCertificateStore::ValidationResult> validationResult;
+                if (m_parameters.store)
                 {
-                    result.addCertificateGenericError();
-                    break;
+                    fingerprint = getValidationFingerprint(signer, certificates, X509_PURPOSE_SMIME_SIGN, flags);
+                    validationResult = m_parameters.store->getCachedValidationResult(fingerprint);
                 }
 
-                unsigned long flags = X509_V_FLAG_TRUSTED_FIRST;
-                if (m_parameters.ignoreExpirationDate)
+                if (!validationResult)
                 {
-                    flags |= X509_V_FLAG_NO_CHECK_TIME;
+                    if (!store)
+                    {
+                        store = X509_STORE_new();
+                        Q_ASSERT(store);
+                        addTrustedCertificates(store);
+                    }
+
+                    if (!X509_STORE_CTX_init(context, store, signer, certificates))
+                    {
+                        result.addCertificateGenericError();
+                        break;
+                    }
+
+                    if (!X509_STORE_CTX_set_purpose(context, X509_PURPOSE_SMIME_SIGN))
+                    {
+                        result.addCertificateGenericError();
+                        break;
+                    }
+
+                    X509_STORE_CTX_set_flags(context, flags);
+
+                    PDFCertificateStore::ValidationResult newValidationResult;
+                    newValidationResult.isValid = X509_verify_cert(context) > 0;
+                    if (!newValidationResult.isValid)
+                    {
+                        newValidationResult.error = X509_STORE_CTX_get_error(context);
+
+                        // We will add certificate info for all certificates
+                        const int count = sk_X509_num(certificates);
+                        for (int ii = 0; ii < count; ++ii)
+                        {
+                            newValidationResult.certificates.push_back(getCertificateInfo(sk_X509_value(certificates, ii)));
+                        }
+                    }
+                    else
+                    {
+                        STACK_OF(X509)* validChain = X509_STORE_CTX_get0_chain(context);
+                        const int count = sk_X509_num(validChain);
+                        for (int ii = 0; ii < count; ++ii)
+                        {
+                            newValidationResult.certificates.push_back(getCertificateInfo(sk_X509_value(validChain, ii)));
+                        }
+                    }
+                    X509_STORE_CTX_cleanup(context);
+
+                    if (m_parameters.store)
+                    {
+                        m_parameters.store->setCachedValidationResult(fingerprint, newValidationResult);
+                    }
+                    validationResult = qMove(newValidationResult);
                 }
-                X509_STORE_CTX_set_flags(context, flags);
 
-                int verificationResult = X509_verify_cert(context);
-                if (verificationResult <= 0)
+                if (!validationResult->isValid)
                 {
-                    int error = X509_STORE_CTX_get_error(context);
-                    switch (error)
+                    switch (validationResult->error)
                     {
                         case X509_V_OK:
                             // Strange, this should not occur... when X509_verify_cert fails
@@ -609,27 +663,15 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
                             break;
 
                         default:
-                            result.addCertificateOtherError(error);
+                            result.addCertificateOtherError(validationResult->error);
                             break;
                     }
-
-                    // We will add certificate info for all certificates
-                    const int count = sk_X509_num(certificates);
-                    for (int ii = 0; ii < count; ++ii)
-                    {
-                        result.addCertificateInfo(getCertificateInfo(sk_X509_value(certificates, ii)));
-                    }
                 }
-                else
+
+                for (const PDFCertificateInfo& certificateInfo : validationResult->certificates)
                 {
-                    STACK_OF(X509)* validChain = X509_STORE_CTX_get0_chain(context);
-                    const int count = sk_X509_num(validChain);
-                    for (int ii = 0; ii < count; ++ii)
-                    {
-                        result.addCertificateInfo(getCertificateInfo(sk_X509_value(validChain, ii)));
-                    }
+                    result.addCertificateInfo(certificateInfo);
                 }
-                X509_STORE_CTX_cleanup(context);
             }
         }
         else
@@ -638,7 +680,10 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
         }
 
         X509_STORE_CTX_free(context);
-        X509_STORE_free(store);
+        if (store)
+        {
+            X509_STORE_free(store);
+        }
 
         PKCS7_free(pkcs7);
     }
@@ -653,7 +698,48 @@ void PDFPublicKeySignatureHandler::verifyCertificate(PDFSignatureVerificationRes
     }
 }
 
-BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const
+QByteArray PDFPublicKeySignatureHandler::getValidationFingerprint(X509* signer, STACK_OF(X509)* certificates, int purpose, unsigned long flags) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+
+    auto addCertificate = [&hash](X509* certificate)
+    {
+        const int length = i2d_X509(certificate, nullptr);
+        if (length > 0)
+        {
+            QByteArray certificateData(length, 0);
+            unsigned char* certificateDataBuffer = convertByteArrayToUcharPtr(certificateData);
+            i2d_X509(certificate, &certificateDataBuffer);
+            hash.addData(certificateData);
+        }
+    };
+
+    addCertificate(signer);
+    for (int i = 0, count = sk_X509_num(certificates); i < count; ++i)
+    {
+        addCertificate(sk_X509_value(certificates, i));
+    }
+
+    // Result of the validation depends also on verification settings and,
+    // if expiration date is checked, on the date of the verification.
+    QByteArray settings;
+    {
+        QDataStream stream(&settings, QIODevice::WriteOnly);
+        stream << purpose;
+        stream << quint64(flags);
+        stream << m_parameters.useSystemCertificateStore;
+
+        if (!(flags & X509_V_FLAG_NO_CHECK_TIME))
+        {
+            stream << QDate::currentDate().toJulianDay();
+        }
+    }
+    hash.addData(settings);
+
+    return hash.result();
+}
+
+bool PDFPublicKeySignatureHandler::getSignedData(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const
 {
     const PDFSignature& signature = m_signatureField->getSignature();
     const QByteArray& contents = signature.getContents();
@@ -670,7 +756,7 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
     if (size > sourceData.size())
     {
         result.addSignatureDataCoveredBySignatureMissingError();
-        return nullptr;
+        return false;
     }
 
     PDFClosedIntervalSet bytesCoveredBySignature;
@@ -690,7 +776,7 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
         if (startOffset > endOffset || startOffset < 0 || endOffset < 0 || startOffset >= m_sourceData.size() || endOffset > m_sourceData.size())
         {
             result.addSignatureDataCoveredBySignatureMissingError();
-            return nullptr;
+            return false;
         }
 
         const int length = endOffset - startOffset;
@@ -700,12 +786,38 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
 
     // Jakub Melka: We must find byte string, which corresponds to signature.
     // We find only first occurence, because second one should not exist - because
-    // it will mean that signature must be covered by itself.
+    // it will mean that signature must be covered by itself. Signature is usually
+    // stored in the gap between byte ranges, so we search gaps first, and whole
+    // source data only if signature is not found there (source can be large).
     QByteArray hexContents = contents.toHex();
-    int index = sourceData.indexOf(hexContents);
+    QByteArray hexContentsUpper = hexContents.toUpper();
+    int index = -1;
+    for (size_t i = 1; i < byteRanges.size() && index == -1; ++i)
+    {
+        const PDFInteger gapStart = byteRanges[i - 1].offset + byteRanges[i - 1].size;
+        const PDFInteger gapEnd = byteRanges[i].offset;
+
+        if (gapStart >= 0 && gapStart < gapEnd && gapEnd <= sourceData.size())
+        {
+            const QByteArray gap = QByteArray::fromRawData(sourceData.constData() + gapStart, int(gapEnd - gapStart));
+            int gapIndex = gap.indexOf(hexContents);
+            if (gapIndex == -1)
+            {
+                gapIndex = gap.indexOf(hexContentsUpper);
+            }
+            if (gapIndex != -1)
+            {
+                index = int(gapStart) + gapIndex;
+            }
+        }
+    }
+    if (index == -1)
+    {
+        index = sourceData.indexOf(hexContents);
+    }
     if (index == -1)
     {
-        index = sourceData.indexOf(hexContents.toUpper());
+        index = sourceData.indexOf(hexContentsUpper);
     }
     if (index != -1)
     {
@@ -732,7 +844,17 @@ BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(pdf::PDFSignatureVerifica
 
     result.setBytesCoveredBySignature(qMove(bytesCoveredBySignature));
 
-    return BIO_new_mem_buf(outputBuffer.data(), outputBuffer.length());
+    return true;
+}
+
+BIO* PDFPublicKeySignatureHandler::getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const
+{
+    if (getSignedData(result, outputBuffer))
+    {
+        return BIO_new_mem_buf(outputBuffer.data(), outputBuffer.length());
+    }
+
+    return nullptr;
 }
 
 void PDFPublicKeySignatureHandler::verifySignature(PDFSignatureVerificationResult& result) const
@@ -749,8 +871,14 @@ void PDFPublicKeySignatureHandler::verifySignature(PDFSignatureVerificationResul
     const unsigned char* data = convertByteArrayToUcharPtr(content);
     if (PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size()))
     {
+        // Jakub Melka: signed data can be large, so we prepare them without
+        // holding the global lock, so other signatures can be verified meanwhile.
         QByteArray buffer;
-        if (BIO* inputBuffer = getSignedDataBuffer(result, buffer))
+        lock.unlock();
+        const bool isSignedDataValid = getSignedData(result, buffer);
+        lock.relock();
+
+        if (BIO* inputBuffer = isSignedDataValid ? BIO_new_mem_buf(buffer.data(), buffer.length()) : nullptr)
         {
             if (BIO* dataBio = PKCS7_dataInit(pkcs7, inputBuffer))
             {
@@ -817,7 +945,7 @@ void PDFPublicKeySignatureHandler::verifySignature(PDFSignatureVerificationResul
         }
         else
         {
-            // There is no need for adding error, error is in this case added by getSignedDataBuffer function
+            // There is no need for adding error, error is in this case added by getSignedData function
         }
 
         PKCS7_free(pkcs7);
@@ -877,8 +1005,14 @@ void PDFSignatureHandler_ETSI_RFC3161::verifySignatureTimestamp(PDFSignatureVeri
     const unsigned char* data = convertByteArrayToUcharPtr(content);
     if (PKCS7* pkcs7 = d2i_PKCS7(nullptr, &data, content.size()))
     {
+        // Jakub Melka: signed data can be large, so we prepare them without
+        // holding the global lock, so other signatures can be verified meanwhile.
         QByteArray buffer;
-        if (BIO* inputBuffer = getSignedDataBuffer(result, buffer))
+        lock.unlock();
+        const bool isSignedDataValid = getSignedData(result, buffer);
+        lock.relock();
+
+        if (BIO* inputBuffer = isSignedDataValid ? BIO_new_mem_buf(buffer.data(), buffer.length()) : nullptr)
         {
             X509_STORE* store = X509_STORE_new();
 
@@ -956,7 +1090,7 @@ void PDFSignatureHandler_ETSI_RFC3161::verifySignatureTimestamp(PDFSignatureVeri
         }
         else
         {
-            // There is no need for adding error, error is in this case added by getSignedDataBuffer function
+            // There is no need for adding error, error is in this case added by getSignedData function
         }
 
         PKCS7_free(pkcs7);
@@ -1239,8 +1373,12 @@ PDFSignatureVerificationResult PDFSignatureHandler_adbe_pkcs7_rsa_sha1::verify()
     PDFSignatureVerificationResult result;
     initializeResult(result);
 
-    verifyRSACertificate(result);
-    verifyRSASignature(result);
+    {
+        // Signatures are verified in parallel, so we must lock OpenSSL
+        PDFOpenSSLGlobalLock lock;
+        verifyRSACertificate(result);
+        verifyRSASignature(result);
+    }
 
     result.validate();
     return result;
@@ -1538,20 +1676,18 @@ PDFSignatureVerificationResult PDFSignatureHandler_adbe_pkcs7_sha1::verify() con
     return result;
 }
 
-BIO* PDFSignatureHandler_adbe_pkcs7_sha1::getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const
+bool PDFSignatureHandler_adbe_pkcs7_sha1::getSignedData(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const
 {
     QByteArray temporaryBuffer;
-    if (BIO* bio = PDFPublicKeySignatureHandler::getSignedDataBuffer(result, temporaryBuffer))
+    if (PDFPublicKeySignatureHandler::getSignedData(result, temporaryBuffer))
     {
         // Calculate SHA1
         outputBuffer.resize(SHA_DIGEST_LENGTH);
         SHA1(convertByteArrayToUcharPtr(temporaryBuffer), temporaryBuffer.length(), convertByteArrayToUcharPtr(outputBuffer));
-        BIO_free(bio);
-
-        return BIO_new_mem_buf(outputBuffer.data(), outputBuffer.length());
+        return true;
     }
 
-    return nullptr;
+    return false;
 }
 
 PDFCertificateInfo PDFPublicKeySignatureHandler::getCertificateInfo(X509* certificate)
@@ -44,7 +44,24 @@ protected:
     void verifySignature(PDFSignatureVerificationResult& result) const;
     void addTrustedCertificates(X509_STORE* store) const;
 
-    virtual BIO* getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const;
+    /// Fills data signed by the signature to the output buffer. This function
+    /// doesn't use shared OpenSSL objects, so it can be called without a global lock.
+    /// Returns false, if signed data are invalid (error is added to the result).
+    /// \param result Verification result
+    /// \param outputBuffer Output buffer
+    virtual bool getSignedData(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const;
+
+    /// Fills signed data using \p getSignedData and creates memory BIO
+    /// over output buffer. If signed data are invalid, nullptr is returned.
+    BIO* getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const;
+
+    /// Returns fingerprint of the certificate chain validation, under which
+    /// validation result is cached in the certificate store.
+    /// \param signer Signer certificate
+    /// \param certificates Untrusted certificates used to build the chain
+    /// \param purpose Purpose of the verification
+    /// \param flags Verification flags
+    QByteArray getValidationFingerprint(X509* signer, STACK_OF(X509)* certificates, int purpose, unsigned long flags) const;
 
 public:
     /// Return a list of certificates from PKCS7 object
@@ -127,7 +144,7 @@ public:
     virtual PDFSignatureVerificationResult verify() const override;
 
 protected:
-    virtual BIO* getSignedDataBuffer(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const override;
+    virtual bool getSignedData(PDFSignatureVerificationResult& result, QByteArray& outputBuffer) const override;
 };
 
 class PDFSignatureHandler_ETSI_base : public PDFPublicKeySignatureHandler
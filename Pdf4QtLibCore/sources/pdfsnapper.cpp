@@ -22,6 +22,8 @@
 
 #include <QPainter>
 
+#include <numeric>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -29,6 +31,8 @@ namespace pdf
 
 void PDFSnapInfo::addPageMediaBox(const QRectF& mediaBox)
 {
+    releaseIndex();
+
     QPointF tl = mediaBox.topLeft();
     QPointF tr = mediaBox.topRight();
     QPointF bl = mediaBox.bottomLeft();
@@ -51,6 +55,8 @@ void PDFSnapInfo::addPageMediaBox(const QRectF& mediaBox)
 
 void PDFSnapInfo::addImage(const std::array<QPointF, 5>& points, const QImage& image)
 {
+    releaseIndex();
+
     m_snapPoints.insert(m_snapPoints.cend(), {
                             SnapPoint(SnapType::ImageCorner, points[0]),
                             SnapPoint(SnapType::ImageCorner, points[1]),
@@ -76,11 +82,286 @@ void PDFSnapInfo::addImage(const std::array<QPointF, 5>& points, const QImage& i
 
 void PDFSnapInfo::addLine(const QPointF& start, const QPointF& end)
 {
+    releaseIndex();
+
     QLineF line(start, end);
     m_snapPoints.emplace_back(SnapType::LineCenter, line.center());
     m_snapLines.emplace_back(line);
 }
 
+const std::vector<PDFSnapInfo::SnapPoint>& PDFSnapInfo::getSnapPoints() const
+{
+    return m_index ? m_index->getSnapPoints() : m_snapPoints;
+}
+
+const std::vector<QLineF>& PDFSnapInfo::getLines() const
+{
+    return m_index ? m_index->getLines() : m_snapLines;
+}
+
+void PDFSnapInfo::buildIndex()
+{
+    releaseIndex();
+
+    m_index = std::make_shared<PDFSnapIndex>(qMove(m_snapPoints), qMove(m_snapLines));
+    m_snapPoints = std::vector<SnapPoint>();
+    m_snapLines = std::vector<QLineF>();
+}
+
+void PDFSnapInfo::releaseIndex()
+{
+    if (m_index)
+    {
+        m_snapPoints = m_index->getSnapPoints();
+        m_snapLines = m_index->getLines();
+        m_index.reset();
+    }
+}
+
+qint64 PDFSnapInfo::getMemoryConsumptionEstimate() const
+{
+    qint64 memoryConsumption = sizeof(*this);
+    memoryConsumption += sizeof(SnapPoint) * m_snapPoints.capacity();
+    memoryConsumption += sizeof(QLineF) * m_snapLines.capacity();
+    memoryConsumption += sizeof(SnapImage) * m_snapImages.capacity();
+
+    if (m_index)
+    {
+        memoryConsumption += m_index->getMemoryConsumptionEstimate();
+    }
+
+    return memoryConsumption;
+}
+
+int PDFSnapIndex::getColumn(PDFReal x) const
+{
+    return qBound(0, static_cast<int>((x - m_bounds.left()) / m_cellWidth), m_gridSize - 1);
+}
+
+int PDFSnapIndex::getRow(PDFReal y) const
+{
+    return qBound(0, static_cast<int>((y - m_bounds.top()) / m_cellHeight), m_gridSize - 1);
+}
+
+template<typename Function>
+void PDFSnapIndex::forEachLineCell(const QLineF& line, Function function) const
+{
+    const QPointF p1 = line.p1();
+    const QPointF p2 = line.p2();
+    const PDFReal dx = p2.x() - p1.x();
+    const PDFReal dy = p2.y() - p1.y();
+    const PDFReal minX = qMin(p1.x(), p2.x());
+    const PDFReal maxX = qMax(p1.x(), p2.x());
+
+    // Small margin, so lines lying at the cell boundary are in both cells
+    const PDFReal epsilon = m_cellHeight * 0.001;
+
+    // Walk through the columns, which line crosses, and for each
+    // column, determine the range of rows, which line crosses.
+    const int firstColumn = getColumn(minX);
+    const int lastColumn = getColumn(maxX);
+    for (int column = firstColumn; column <= lastColumn; ++column)
+    {
+        PDFReal y1 = 0.0;
+        PDFReal y2 = 0.0;
+
+        if (qFuzzyIsNull(dx))
+        {
+            y1 = p1.y();
+            y2 = p2.y();
+        }
+        else
+        {
+            const PDFReal x1 = qMax(minX, m_bounds.left() + column * m_cellWidth);
+            const PDFReal x2 = qMin(maxX, m_bounds.left() + (column + 1) * m_cellWidth);
+            y1 = p1.y() + (x1 - p1.x()) / dx * dy;
+            y2 = p1.y() + (x2 - p1.x()) / dx * dy;
+        }
+
+        const int firstRow = getRow(qMin(y1, y2) - epsilon);
+        const int lastRow = getRow(qMax(y1, y2) + epsilon);
+        for (int row = firstRow; row <= lastRow; ++row)
+        {
+            function(size_t(row) * m_gridSize + column);
+        }
+    }
+}
+
+template<typename Function>
+void PDFSnapIndex::forEachItem(const Grid& grid, const QRectF& rect, Function function) const
+{
+    if (m_gridSize == 0 || !rect.intersects(m_bounds))
+    {
+        return;
+    }
+
+    const int left = getColumn(rect.left());
+    const int right = getColumn(rect.right());
+    const int top = getRow(rect.top());
+    const int bottom = getRow(rect.bottom());
+
+    for (int row = top; row <= bottom; ++row)
+    {
+        for (int column = left; column <= right; ++column)
+        {
+            const size_t cell = size_t(row) * m_gridSize + column;
+            for (uint32_t i = grid.cellOffsets[cell]; i < grid.cellOffsets[cell + 1]; ++i)
+            {
+                function(grid.cellItems[i]);
+            }
+        }
+    }
+}
+
+template<typename Function>
+PDFSnapIndex::Grid PDFSnapIndex::buildGrid(size_t itemCount, Function forEachCell) const
+{
+    const size_t cellCount = size_t(m_gridSize) * m_gridSize;
+
+    Grid grid;
+    grid.cellOffsets.resize(cellCount + 1, 0);
+
+    // First pass - count items of the cells
+    for (size_t i = 0; i < itemCount; ++i)
+    {
+        forEachCell(i, [&grid](size_t cell) { ++grid.cellOffsets[cell + 1]; });
+    }
+    std::partial_sum(grid.cellOffsets.begin(), grid.cellOffsets.end(), grid.cellOffsets.begin());
+
+    // Second pass - fill the cells
+    grid.cellItems.resize(grid.cellOffsets.back());
+    std::vector<uint32_t> cellPositions(grid.cellOffsets.cbegin(), std::prev(grid.cellOffsets.cend()));
+    for (size_t i = 0; i < itemCount; ++i)
+    {
+        forEachCell(i, [&grid, &cellPositions, i](size_t cell) { grid.cellItems[cellPositions[cell]++] = static_cast<uint32_t>(i); });
+    }
+
+    return grid;
+}
+
+PDFSnapIndex::PDFSnapIndex(std::vector<PDFSnapInfo::SnapPoint> snapPoints, std::vector<QLineF> lines) :
+    m_snapPoints(qMove(snapPoints)),
+    m_lines(qMove(lines))
+{
+    const size_t itemCount = m_snapPoints.size() + m_lines.size();
+    if (itemCount == 0 || itemCount > std::numeric_limits<uint32_t>::max())
+    {
+        return;
+    }
+
+    PDFReal minX = std::numeric_limits<PDFReal>::infinity();
+    PDFReal minY = std::numeric_limits<PDFReal>::infinity();
+    PDFReal maxX = -std::numeric_limits<PDFReal>::infinity();
+    PDFReal maxY = -std::numeric_limits<PDFReal>::infinity();
+
+    auto addPoint = [&](const QPointF& point)
+    {
+        minX = qMin(minX, point.x());
+        minY = qMin(minY, point.y());
+        maxX = qMax(maxX, point.x());
+        maxY = qMax(maxY, point.y());
+    };
+
+    for (const PDFSnapInfo::SnapPoint& snapPoint : m_snapPoints)
+    {
+        addPoint(snapPoint.point);
+    }
+
+    for (const QLineF& line : m_lines)
+    {
+        addPoint(line.p1());
+        addPoint(line.p2());
+    }
+
+    if (!std::isfinite(minX) || !std::isfinite(minY) || !std::isfinite(maxX) || !std::isfinite(maxY))
+    {
+        return;
+    }
+
+    // Enlarge the bounds, so they are valid even if all points lie on a line
+    m_bounds = QRectF(QPointF(minX, minY), QPointF(maxX, maxY)).adjusted(-1.0, -1.0, 1.0, 1.0);
+    m_gridSize = qBound(1, static_cast<int>(std::sqrt(PDFReal(itemCount) / 2.0)), MAXIMAL_GRID_SIZE);
+    m_cellWidth = m_bounds.width() / m_gridSize;
+    m_cellHeight = m_bounds.height() / m_gridSize;
+
+    m_pointGrid = buildGrid(m_snapPoints.size(), [this](size_t index, auto addToCell)
+    {
+        const QPointF& point = m_snapPoints[index].point;
+        addToCell(size_t(getRow(point.y())) * m_gridSize + getColumn(point.x()));
+    });
+
+    m_lineGrid = buildGrid(m_lines.size(), [this](size_t index, auto addToCell)
+    {
+        forEachLineCell(m_lines[index], addToCell);
+    });
+}
+
+std::optional<size_t> PDFSnapIndex::findNearestSnapPoint(const QPointF& point, PDFReal tolerance) const
+{
+    std::optional<size_t> result;
+
+    PDFReal nearestDistanceSquared = tolerance * tolerance;
+    auto testSnapPoint = [&](uint32_t index)
+    {
+        const QPointF difference = m_snapPoints[index].point - point;
+        const PDFReal distanceSquared = QPointF::dotProduct(difference, difference);
+
+        // Prefer snap point with lower index, if distances are equal, so result
+        // doesn't depend on the order of the items in the cells.
+        if (distanceSquared < nearestDistanceSquared || (result && distanceSquared == nearestDistanceSquared && index < *result))
+        {
+            nearestDistanceSquared = distanceSquared;
+            result = index;
+        }
+    };
+
+    forEachItem(m_pointGrid, QRectF(point.x() - tolerance, point.y() - tolerance, 2.0 * tolerance, 2.0 * tolerance), testSnapPoint);
+    return result;
+}
+
+std::vector<size_t> PDFSnapIndex::findNearestLines(const QPointF& point, PDFReal tolerance) const
+{
+    std::vector<std::pair<PDFReal, size_t>> lines;
+
+    const PDFReal toleranceSquared = tolerance * tolerance;
+    auto testLine = [&](uint32_t index)
+    {
+        // Calculate squared distance of the point from the line segment
+        const QLineF& line = m_lines[index];
+        const QPointF vector = line.p2() - line.p1();
+        const PDFReal lengthSquared = QPointF::dotProduct(vector, vector);
+        const PDFReal t = lengthSquared > 0.0 ? qBound(0.0, QPointF::dotProduct(point - line.p1(), vector) / lengthSquared, 1.0) : 0.0;
+        const QPointF difference = point - (line.p1() + vector * t);
+        const PDFReal distanceSquared = QPointF::dotProduct(difference, difference);
+
+        if (distanceSquared < toleranceSquared)
+        {
+            lines.emplace_back(distanceSquared, index);
+        }
+    };
+
+    forEachItem(m_lineGrid, QRectF(point.x() - tolerance, point.y() - tolerance, 2.0 * tolerance, 2.0 * tolerance), testLine);
+
+    // Line passing through multiple cells can be found multiple times
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+    std::vector<size_t> result;
+    result.reserve(lines.size());
+    std::transform(lines.cbegin(), lines.cend(), std::back_inserter(result), [](const auto& item) { return item.second; });
+    return result;
+}
+
+qint64 PDFSnapIndex::getMemoryConsumptionEstimate() const
+{
+    qint64 memoryConsumption = sizeof(*this);
+    memoryConsumption += sizeof(PDFSnapInfo::SnapPoint) * m_snapPoints.capacity();
+    memoryConsumption += sizeof(QLineF) * m_lines.capacity();
+    memoryConsumption += sizeof(uint32_t) * (m_pointGrid.cellOffsets.capacity() + m_pointGrid.cellItems.capacity());
+    memoryConsumption += sizeof(uint32_t) * (m_lineGrid.cellOffsets.capacity() + m_lineGrid.cellItems.capacity());
+    return memoryConsumption;
+}
+
 PDFSnapper::PDFSnapper()
 {
 
@@ -97,17 +378,11 @@ void PDFSnapper::drawSnapPoints(QPainter* painter) const
     pen.setCapStyle(Qt::RoundCap);
     pen.setWidth(m_snapPointPixelSize);
 
-    for (const ViewportSnapPoint& snapPoint : m_snapPoints)
+    auto drawSnapPoint = [painter, &pen](SnapType type, const QPointF& viewportPoint)
     {
-        if (!isSnappingAllowed(snapPoint.pageIndex))
-        {
-            // We are drawing only snap points, which are on current page
-            continue;
-        }
-
         QColor color = pen.color();
         QColor newColor = color;
-        switch (snapPoint.type)
+        switch (type)
         {
             case SnapType::PageCorner:
                 newColor = Qt::blue;
@@ -132,8 +407,43 @@ void PDFSnapper::drawSnapPoints(QPainter* painter) const
             painter->setPen(pen);
         }
 
-        QPoint point = snapPoint.viewportPoint.toPoint();
+        QPoint point = viewportPoint.toPoint();
         painter->drawPoint(point);
+    };
+
+    for (const PageSnapData& page : m_pages)
+    {
+        if (!isSnappingAllowed(page.pageIndex))
+        {
+            // We are drawing only snap points, which are on current page
+            continue;
+        }
+
+        for (const PDFSnapInfo::SnapPoint& snapPoint : page.index->getSnapPoints())
+        {
+            drawSnapPoint(snapPoint.type, page.pageToDeviceMatrix.map(snapPoint.point));
+        }
+
+        if (m_currentPage == page.pageIndex)
+        {
+            for (const QPointF& customSnapPoint : m_customSnapPoints)
+            {
+                drawSnapPoint(SnapType::Custom, page.pageToDeviceMatrix.map(customSnapPoint));
+            }
+
+            // Draw line projections snap points
+            if (m_referencePoint.has_value())
+            {
+                for (const QLineF& line : page.index->getLines())
+                {
+                    std::optional<QPointF> projectedPoint = getProjectedPoint(line, *m_referencePoint);
+                    if (projectedPoint && !isProjectedPointAtSnapPoint(page, line, *projectedPoint))
+                    {
+                        drawSnapPoint(SnapType::GeneratedLineProjection, page.pageToDeviceMatrix.map(*projectedPoint));
+                    }
+                }
+            }
+        }
     }
 
     if (isSnapped())
@@ -158,19 +468,88 @@ void PDFSnapper::updateSnappedPoint(const QPointF& mousePoint)
     m_snappedImage = std::nullopt;
     m_mousePoint = mousePoint;
 
-    // Iterate trough all points, check, if some satisfies condition
+    // Line projections are generated only, when no other snap point is
+    // near the mouse cursor, so we search for them separately.
+    std::optional<ViewportSnapPoint> projectionSnappedPoint;
+
     const PDFReal toleranceSquared = m_snapPointTolerance * m_snapPointTolerance;
-    for (const ViewportSnapPoint& snapPoint : m_snapPoints)
+    PDFReal nearestDistanceSquared = toleranceSquared;
+    PDFReal nearestProjectionDistanceSquared = toleranceSquared;
+
+    auto getDistanceSquared = [&mousePoint](const ViewportSnapPoint& snapPoint)
     {
         QPointF difference = mousePoint - snapPoint.viewportPoint;
-        PDFReal distanceSquared = QPointF::dotProduct(difference, difference);
-        if (distanceSquared < toleranceSquared && isSnappingAllowed(snapPoint.pageIndex))
+        return QPointF::dotProduct(difference, difference);
+    };
+
+    for (const PageSnapData& page : m_pages)
+    {
+        if (!isSnappingAllowed(page.pageIndex))
         {
-            m_snappedPoint = snapPoint;
-            break;
+            continue;
+        }
+
+        // Search snap points in the page coordinates using the spatial index
+        const QPointF pagePoint = page.deviceToPageMatrix.map(mousePoint);
+        const PDFReal pageTolerance = m_snapPointTolerance * page.deviceToPageScale;
+
+        if (std::optional<size_t> index = page.index->findNearestSnapPoint(pagePoint, pageTolerance))
+        {
+            const PDFSnapInfo::SnapPoint& snapPoint = page.index->getSnapPoints()[*index];
+            ViewportSnapPoint viewportSnapPoint = createViewportSnapPoint(page, snapPoint.type, snapPoint.point);
+            const PDFReal distanceSquared = getDistanceSquared(viewportSnapPoint);
+            if (distanceSquared < nearestDistanceSquared)
+            {
+                nearestDistanceSquared = distanceSquared;
+                m_snappedPoint = qMove(viewportSnapPoint);
+            }
+        }
+
+        if (m_currentPage != page.pageIndex)
+        {
+            continue;
+        }
+
+        for (const QPointF& customSnapPoint : m_customSnapPoints)
+        {
+            ViewportSnapPoint viewportSnapPoint = createViewportSnapPoint(page, SnapType::Custom, customSnapPoint);
+            const PDFReal distanceSquared = getDistanceSquared(viewportSnapPoint);
+            if (distanceSquared < nearestDistanceSquared)
+            {
+                nearestDistanceSquared = distanceSquared;
+                m_snappedPoint = qMove(viewportSnapPoint);
+            }
+        }
+
+        // Projection of the reference point onto the line lies on the line, so
+        // if it is near the mouse cursor, then the line is near the mouse cursor too.
+        if (m_referencePoint.has_value())
+        {
+            for (size_t lineIndex : page.index->findNearestLines(pagePoint, pageTolerance))
+            {
+                const QLineF& line = page.index->getLines()[lineIndex];
+                std::optional<QPointF> projectedPoint = getProjectedPoint(line, *m_referencePoint);
+                if (!projectedPoint || isProjectedPointAtSnapPoint(page, line, *projectedPoint))
+                {
+                    continue;
+                }
+
+                ViewportSnapPoint viewportSnapPoint = createViewportSnapPoint(page, SnapType::GeneratedLineProjection, *projectedPoint);
+                const PDFReal distanceSquared = getDistanceSquared(viewportSnapPoint);
+                if (distanceSquared < nearestProjectionDistanceSquared)
+                {
+                    nearestProjectionDistanceSquared = distanceSquared;
+                    projectionSnappedPoint = qMove(viewportSnapPoint);
+                }
+            }
         }
     }
 
+    if (!m_snappedPoint)
+    {
+        m_snappedPoint = qMove(projectionSnappedPoint);
+    }
+
     // Iterate trough all images, check, if some is under mouse cursor
     for (const ViewportSnapImage& snapImage : m_snapImages)
     {
@@ -185,9 +564,10 @@ void PDFSnapper::updateSnappedPoint(const QPointF& mousePoint)
 void PDFSnapper::buildSnapPoints(const PDFWidgetSnapshot& snapshot)
 {
     // First, clear all snap points
-    m_snapPoints.clear();
+    m_pages.clear();
 
-    // Second, create snapping points from snapshot
+    // Second, collect snap data of the pages from snapshot. Snap points
+    // and lines of the page are indexed, when page is compiled.
     for (const PDFWidgetSnapshot::SnapshotItem& item : snapshot.items)
     {
         if (!item.compiledPage)
@@ -195,71 +575,71 @@ void PDFSnapper::buildSnapPoints(const PDFWidgetSnapshot& snapshot)
             continue;
         }
 
-        const PDFSnapInfo* info = item.compiledPage->getSnapInfo();
-        for (const PDFSnapInfo::SnapPoint& snapPoint : info->getSnapPoints())
-        {
-            ViewportSnapPoint viewportSnapPoint;
-            viewportSnapPoint.type = snapPoint.type;
-            viewportSnapPoint.point = snapPoint.point;
-            viewportSnapPoint.pageIndex = item.pageIndex;
-            viewportSnapPoint.viewportPoint = item.pageToDeviceMatrix.map(snapPoint.point);
-            m_snapPoints.push_back(qMove(viewportSnapPoint));
-        }
+        bool isInvertible = false;
+        PageSnapData page;
+        page.pageIndex = item.pageIndex;
+        page.pageToDeviceMatrix = item.pageToDeviceMatrix;
+        page.deviceToPageMatrix = item.pageToDeviceMatrix.inverted(&isInvertible);
 
-        // Add custom snap points
-        if (m_currentPage == item.pageIndex)
+        if (!isInvertible)
         {
-            for (const QPointF& customSnapPoint : m_customSnapPoints)
-            {
-                ViewportSnapPoint viewportSnapPoint;
-                viewportSnapPoint.type = SnapType::Custom;
-                viewportSnapPoint.point = customSnapPoint;
-                viewportSnapPoint.pageIndex = item.pageIndex;
-                viewportSnapPoint.viewportPoint = item.pageToDeviceMatrix.map(customSnapPoint);
-                m_snapPoints.push_back(qMove(viewportSnapPoint));
-            }
+            continue;
         }
 
-        // Fill line projections snap points
-        if (m_currentPage == item.pageIndex && m_referencePoint.has_value())
-        {
-            QPointF referencePoint = *m_referencePoint;
-            for (const QLineF& line : info->getLines())
-            {
-                // Project point onto line.
-                const qreal lineLength = line.length();
-                QPointF vector = referencePoint - line.p1();
-                QPointF tangentVector = (line.p2() - line.p1()) / lineLength;
-                const qreal absoluteParameter = QPointF::dotProduct(vector, tangentVector);
-                if (absoluteParameter >= 0 && absoluteParameter <= lineLength)
-                {
-                    QPointF projectedSnapPoint = line.pointAt(absoluteParameter / lineLength);
-                    const PDFReal tolerance = lineLength * 0.01;
-                    const PDFReal squaredTolerance = tolerance * tolerance;
+        // Page to device matrix has the same scale in both axes
+        page.deviceToPageScale = 1.0 / std::sqrt(std::abs(item.pageToDeviceMatrix.determinant()));
 
-                    // Test, if projected snap point is not already present in snap points
-                    auto testSamePoints = [projectedSnapPoint, squaredTolerance](const ViewportSnapPoint& testedSnapPoint)
-                    {
-                        return isFuzzyComparedPointsSame(projectedSnapPoint, testedSnapPoint.point, squaredTolerance);
-                    };
-                    if (m_snapPoints.cend() == std::find_if(m_snapPoints.cbegin(), m_snapPoints.cend(), testSamePoints))
-                    {
-                        ViewportSnapPoint viewportSnapPoint;
-                        viewportSnapPoint.type = SnapType::GeneratedLineProjection;
-                        viewportSnapPoint.point = projectedSnapPoint;
-                        viewportSnapPoint.pageIndex = item.pageIndex;
-                        viewportSnapPoint.viewportPoint = item.pageToDeviceMatrix.map(projectedSnapPoint);
-                        m_snapPoints.push_back(qMove(viewportSnapPoint));
-                    }
-                }
-            }
+        const PDFSnapInfo* info = item.compiledPage->getSnapInfo();
+        page.index = info->getIndex();
+
+        if (!page.index)
+        {
+            page.index = std::make_shared<PDFSnapIndex>(info->getSnapPoints(), info->getLines());
         }
+
+        m_pages.emplace_back(qMove(page));
     }
 
     // Third, update snap shot position
     updateSnappedPoint(m_mousePoint);
 }
 
+PDFSnapper::ViewportSnapPoint PDFSnapper::createViewportSnapPoint(const PageSnapData& page, SnapType type, const QPointF& point)
+{
+    ViewportSnapPoint viewportSnapPoint;
+    viewportSnapPoint.type = type;
+    viewportSnapPoint.point = point;
+    viewportSnapPoint.pageIndex = page.pageIndex;
+    viewportSnapPoint.viewportPoint = page.pageToDeviceMatrix.map(point);
+    return viewportSnapPoint;
+}
+
+std::optional<QPointF> PDFSnapper::getProjectedPoint(const QLineF& line, const QPointF& point)
+{
+    const qreal lineLength = line.length();
+    if (qFuzzyIsNull(lineLength))
+    {
+        return std::nullopt;
+    }
+
+    // Project point onto line.
+    QPointF vector = point - line.p1();
+    QPointF tangentVector = (line.p2() - line.p1()) / lineLength;
+    const qreal absoluteParameter = QPointF::dotProduct(vector, tangentVector);
+    if (absoluteParameter >= 0 && absoluteParameter <= lineLength)
+    {
+        return line.pointAt(absoluteParameter / lineLength);
+    }
+
+    return std::nullopt;
+}
+
+bool PDFSnapper::isProjectedPointAtSnapPoint(const PageSnapData& page, const QLineF& line, const QPointF& projectedPoint)
+{
+    const PDFReal tolerance = line.length() * 0.01;
+    return page.index->findNearestSnapPoint(projectedPoint, tolerance).has_value();
+}
+
 void PDFSnapper::buildSnapImages(const PDFWidgetSnapshot& snapshot)
 {
     // First, clear all snap images
@@ -340,7 +720,7 @@ void PDFSnapper::clear()
     clearReferencePoint();
 
     m_customSnapPoints.clear();
-    m_snapPoints.clear();
+    m_pages.clear();
     m_snapImages.clear();
     m_snappedPoint = std::nullopt;
     m_snappedImage = std::nullopt;
@@ -21,9 +21,11 @@
 #include "pdfglobal.h"
 
 #include <QImage>
+#include <QTransform>
 #include <QPainterPath>
 
 #include <array>
+#include <memory>
 #include <optional>
 
 class QPainter;
@@ -31,6 +33,7 @@ class QPainter;
 namespace pdf
 {
 class PDFPrecompiledPage;
+class PDFSnapIndex;
 struct PDFWidgetSnapshot;
 
 enum class SnapType
@@ -48,7 +51,7 @@ enum class SnapType
 /// Contain informations for snap points in the pdf page. Snap points
 /// can be for example image centers, rectangle corners, line start/end
 /// points, page boundary boxes etc. All coordinates are in page coordinates.
-class PDFSnapInfo
+class PDF4QTLIBCORESHARED_EXPORT PDFSnapInfo
 {
 public:
     explicit inline PDFSnapInfo() = default;
@@ -90,19 +93,109 @@ public:
     void addLine(const QPointF& start, const QPointF& end);
 
     /// Returns snap points
-    const std::vector<SnapPoint>& getSnapPoints() const { return m_snapPoints; }
+    const std::vector<SnapPoint>& getSnapPoints() const;
 
     /// Returns lines
-    const std::vector<QLineF>& getLines() const { return m_snapLines; }
+    const std::vector<QLineF>& getLines() const;
 
     /// Returns snap images (together with painter path in page coordinates,
     /// in which image is painted).
     const std::vector<SnapImage>& getSnapImages() const { return m_snapImages; }
 
+    /// Builds spatial index of snap points and lines. Snap points and lines
+    /// are moved into the index. This function should be called, when all
+    /// snap points and lines are added (when page is compiled).
+    void buildIndex();
+
+    /// Returns spatial index of snap points and lines. If index
+    /// was not built, nullptr is returned.
+    std::shared_ptr<const PDFSnapIndex> getIndex() const { return m_index; }
+
+    /// Returns estimate of memory consumed by snap points, lines and index (in bytes)
+    qint64 getMemoryConsumptionEstimate() const;
+
 private:
+    friend class PDFPrecompiledPage;
+
+    /// Moves snap points and lines from the index back, so
+    /// new snap points and lines can be added.
+    void releaseIndex();
+
     std::vector<SnapPoint> m_snapPoints;
     std::vector<QLineF> m_snapLines;
     std::vector<SnapImage> m_snapImages;
+    std::shared_ptr<const PDFSnapIndex> m_index;
+};
+
+/// Spatial index of snap points and lines of the page. Bounding rectangle of
+/// points and lines is divided into uniform grid of cells. Each cell contains
+/// indices of snap points lying in the cell and indices of lines passing
+/// through the cell, so nearest point/line queries visit only a few cells,
+/// instead of all points and lines of the page. Index is immutable, so it can be
+/// shared by the compiled page and the snapper. All coordinates are in page coordinates.
+class PDF4QTLIBCORESHARED_EXPORT PDFSnapIndex
+{
+public:
+    explicit PDFSnapIndex(std::vector<PDFSnapInfo::SnapPoint> snapPoints, std::vector<QLineF> lines);
+
+    /// Returns snap points
+    const std::vector<PDFSnapInfo::SnapPoint>& getSnapPoints() const { return m_snapPoints; }
+
+    /// Returns lines
+    const std::vector<QLineF>& getLines() const { return m_lines; }
+
+    /// Returns index of the snap point nearest to the given point, whose distance
+    /// from the point is less than tolerance. If no such point exists, std::nullopt
+    /// is returned.
+    /// \param point Point
+    /// \param tolerance Tolerance
+    std::optional<size_t> findNearestSnapPoint(const QPointF& point, PDFReal tolerance) const;
+
+    /// Returns indices of lines, whose distance from the given point is
+    /// less than tolerance, sorted by the distance (nearest line is first).
+    /// \param point Point
+    /// \param tolerance Tolerance
+    std::vector<size_t> findNearestLines(const QPointF& point, PDFReal tolerance) const;
+
+    /// Returns estimate of memory consumed by the index (in bytes)
+    qint64 getMemoryConsumptionEstimate() const;
+
+private:
+    /// Maximal count of grid columns (and rows)
+    static constexpr int MAXIMAL_GRID_SIZE = 512;
+
+    /// Cells of the grid. Item indices of the cell i are stored in
+    /// cellItems in range [cellOffsets[i], cellOffsets[i + 1]).
+    struct Grid
+    {
+        std::vector<uint32_t> cellOffsets;
+        std::vector<uint32_t> cellItems;
+    };
+
+    int getColumn(PDFReal x) const;
+    int getRow(PDFReal y) const;
+
+    /// Calls function for each cell, through which line passes
+    template<typename Function>
+    void forEachLineCell(const QLineF& line, Function function) const;
+
+    /// Calls function for each item of the cells, which intersects the rectangle.
+    /// Function can be called for the same item multiple times.
+    template<typename Function>
+    void forEachItem(const Grid& grid, const QRectF& rect, Function function) const;
+
+    /// Builds grid, cells of the item are enumerated by \p forEachCell
+    template<typename Function>
+    Grid buildGrid(size_t itemCount, Function forEachCell) const;
+
+    std::vector<PDFSnapInfo::SnapPoint> m_snapPoints;
+    std::vector<QLineF> m_lines;
+    QRectF m_bounds;
+    int m_gridSize = 0;
+    PDFReal m_cellWidth = 0.0;
+    PDFReal m_cellHeight = 0.0;
+    Grid m_pointGrid;
+    Grid m_lineGrid;
 };
 
 /// Snap engine, which handles snapping of points on the page.
@@ -131,7 +224,7 @@ public:
     int getSnapPointPixelSize() const { return m_snapPointPixelSize; }
 
     /// Draws snapping points onto the painter. This function needs valid snap points,
-    /// so \p m_snapPoints must be valid before this function is called.
+    /// so \p buildSnapPoints must be called before this function is called.
     /// \param painter Painter
     void drawSnapPoints(QPainter* painter) const;
 
@@ -194,13 +287,29 @@ public:
     void setCustomSnapPoints(const std::vector<QPointF>& customSnapPoints);
 
 private:
-    struct SnappedPoint
+    /// Snap data of the page. Snap points are transformed to the viewport
+    /// coordinates on demand, so we do not need to rebuild them.
+    struct PageSnapData
     {
         PDFInteger pageIndex = -1;
-        QPointF snappedPoint;
+        QTransform pageToDeviceMatrix;
+        QTransform deviceToPageMatrix;
+        PDFReal deviceToPageScale = 1.0;
+        std::shared_ptr<const PDFSnapIndex> index;
     };
 
-    std::vector<ViewportSnapPoint> m_snapPoints;
+    /// Creates viewport snap point from the snap point of the page
+    static ViewportSnapPoint createViewportSnapPoint(const PageSnapData& page, SnapType type, const QPointF& point);
+
+    /// Returns projection of the point onto the line. If projection
+    /// doesn't lie on the line, std::nullopt is returned.
+    static std::optional<QPointF> getProjectedPoint(const QLineF& line, const QPointF& point);
+
+    /// Returns true, if projected point lies at some snap point of the page
+    /// (and thus is not needed as generated snap point).
+    static bool isProjectedPointAtSnapPoint(const PageSnapData& page, const QLineF& line, const QPointF& projectedPoint);
+
+    std::vector<PageSnapData> m_pages;
     std::vector<ViewportSnapImage> m_snapImages;
     std::vector<QPointF> m_customSnapPoints;
     std::optional<ViewportSnapPoint> m_snappedPoint;
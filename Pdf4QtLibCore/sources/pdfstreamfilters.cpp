@@ -26,11 +26,255 @@
 
 #include <QtEndian>
 
+#include <algorithm>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
 {
 
+QByteArray PDFStreamFilterSource::readAll(qint64 sizeHint)
+{
+    QByteArray result;
+    result.resize(qMax(sizeHint, CHUNK_SIZE));
+
+    qint64 size = 0;
+    while (true)
+    {
+        if (size == result.size())
+        {
+            // Buffer is full. If size hint was exact, then no more data are
+            // available, so check it before the buffer is enlarged.
+            char byte = 0;
+            if (read(&byte, 1) == 0)
+            {
+                break;
+            }
+
+            result.resize(result.size() * 2);
+            result[size++] = byte;
+            continue;
+        }
+
+        const qint64 bytesRead = read(result.data() + size, result.size() - size);
+        if (bytesRead == 0)
+        {
+            break;
+        }
+
+        size += bytesRead;
+    }
+
+    result.resize(size);
+
+    // Release memory only, if too much memory is wasted
+    if (result.capacity() > 2 * size + CHUNK_SIZE)
+    {
+        result.squeeze();
+    }
+
+    return result;
+}
+
+qint64 PDFByteArrayStreamFilterSource::read(char* buffer, qint64 maxSize)
+{
+    const qint64 bytesRead = qMin(maxSize, m_data.size() - m_position);
+    std::copy(m_data.cbegin() + m_position, m_data.cbegin() + m_position + bytesRead, buffer);
+    m_position += bytesRead;
+    return bytesRead;
+}
+
+/// Base class of streaming decoders of stream filters. Input data are read
+/// from the input source by chunks, output data are decoded by blocks into
+/// the output buffer, from which they are read.
+class PDFStreamFilterDecoder : public PDFStreamFilterSource
+{
+public:
+    explicit PDFStreamFilterDecoder(PDFStreamFilterSourcePointer input) :
+        m_input(qMove(input)),
+        m_inputBuffer(CHUNK_SIZE, 0)
+    {
+
+    }
+
+    virtual qint64 read(char* buffer, qint64 maxSize) override;
+
+protected:
+    /// Decodes next block of data into the output buffer (which is empty on the input).
+    /// Returns false, if end of data was reached (output buffer can contain data yet).
+    /// \param output Output buffer
+    virtual bool decode(QByteArray& output) = 0;
+
+    /// Returns next byte of input data, or -1, if end of input data was reached
+    inline int getByte()
+    {
+        if (m_inputPosition == m_inputSize && !fillInputBuffer())
+        {
+            return -1;
+        }
+
+        return static_cast<unsigned char>(m_inputBuffer[m_inputPosition++]);
+    }
+
+    /// Reads \p size bytes of input data into the buffer. Returns count
+    /// of bytes read, it is less than \p size only at the end of input data.
+    qint64 readInput(char* buffer, qint64 size);
+
+    /// Fills input buffer, if it is empty. Returns false, if end of input data was reached.
+    bool fillInputBuffer();
+
+    PDFStreamFilterSourcePointer m_input;
+    std::vector<char> m_inputBuffer;
+    qint64 m_inputPosition = 0;
+    qint64 m_inputSize = 0;
+    bool m_inputEnd = false;
+
+private:
+    QByteArray m_output;
+    qint64 m_outputPosition = 0;
+    bool m_outputEnd = false;
+};
+
+qint64 PDFStreamFilterDecoder::read(char* buffer, qint64 maxSize)
+{
+    qint64 bytesRead = 0;
+    while (bytesRead < maxSize)
+    {
+        if (m_outputPosition == m_output.size())
+        {
+            if (m_outputEnd)
+            {
+                break;
+            }
+
+            // Resizing to zero preserves capacity of the output buffer
+            m_output.resize(0);
+            m_outputPosition = 0;
+            m_outputEnd = !decode(m_output);
+            continue;
+        }
+
+        const qint64 count = qMin(maxSize - bytesRead, m_output.size() - m_outputPosition);
+        std::copy(m_output.cbegin() + m_outputPosition, m_output.cbegin() + m_outputPosition + count, buffer + bytesRead);
+        m_outputPosition += count;
+        bytesRead += count;
+    }
+
+    return bytesRead;
+}
+
+qint64 PDFStreamFilterDecoder::readInput(char* buffer, qint64 size)
+{
+    qint64 bytesRead = 0;
+    while (bytesRead < size && fillInputBuffer())
+    {
+        const qint64 count = qMin(size - bytesRead, m_inputSize - m_inputPosition);
+        std::copy(m_inputBuffer.cbegin() + m_inputPosition, m_inputBuffer.cbegin() + m_inputPosition + count, buffer + bytesRead);
+        m_inputPosition += count;
+        bytesRead += count;
+    }
+
+    return bytesRead;
+}
+
+bool PDFStreamFilterDecoder::fillInputBuffer()
+{
+    if (m_inputPosition < m_inputSize)
+    {
+        return true;
+    }
+
+    if (m_inputEnd)
+    {
+        return false;
+    }
+
+    m_inputPosition = 0;
+    m_inputSize = m_input->read(m_inputBuffer.data(), static_cast<qint64>(m_inputBuffer.size()));
+    m_inputEnd = m_inputSize == 0;
+    return !m_inputEnd;
+}
+
+class PDFAsciiHexStreamDecoder : public PDFStreamFilterDecoder
+{
+public:
+    explicit PDFAsciiHexStreamDecoder(PDFStreamFilterSourcePointer input) :
+        PDFStreamFilterDecoder(qMove(input))
+    {
+
+    }
+
+protected:
+    virtual bool decode(QByteArray& output) override;
+
+private:
+    int m_nibble = -1;
+};
+
+bool PDFAsciiHexStreamDecoder::decode(QByteArray& output)
+{
+    output.reserve(CHUNK_SIZE);
+
+    while (output.size() < CHUNK_SIZE)
+    {
+        const int character = getByte();
+        if (character == -1 || character == '>')
+        {
+            // Odd number of digits, last digit is treated as if followed by zero
+            if (m_nibble != -1)
+            {
+                output.push_back(static_cast<char>(m_nibble << 4));
+                m_nibble = -1;
+            }
+
+            return false;
+        }
+
+        int value = -1;
+        if (character >= '0' && character <= '9')
+        {
+            value = character - '0';
+        }
+        else if (character >= 'a' && character <= 'f')
+        {
+            value = character - 'a' + 10;
+        }
+        else if (character >= 'A' && character <= 'F')
+        {
+            value = character - 'A' + 10;
+        }
+        else
+        {
+            // Whitespaces and invalid characters are skipped
+            continue;
+        }
+
+        if (m_nibble == -1)
+        {
+            m_nibble = value;
+        }
+        else
+        {
+            output.push_back(static_cast<char>((m_nibble << 4) | value));
+            m_nibble = -1;
+        }
+    }
+
+    return true;
+}
+
+PDFStreamFilterSourcePointer PDFAsciiHexDecodeFilter::createDecoder(PDFStreamFilterSourcePointer source,
+                                                                    const PDFObjectFetcher& objectFetcher,
+                                                                    const PDFObject& parameters,
+                                                                    const PDFSecurityHandler* securityHandler) const
+{
+    Q_UNUSED(objectFetcher);
+    Q_UNUSED(parameters);
+    Q_UNUSED(securityHandler);
+
+    return std::make_unique<PDFAsciiHexStreamDecoder>(qMove(source));
+}
+
 QByteArray PDFAsciiHexDecodeFilter::apply(const QByteArray& data,
                                           const PDFObjectFetcher& objectFetcher,
                                           const PDFObject& parameters,
@@ -151,6 +395,120 @@ QByteArray PDFAscii85DecodeFilter::apply(const QByteArray& data,
     return result;
 }
 
+class PDFAscii85StreamDecoder : public PDFStreamFilterDecoder
+{
+public:
+    explicit PDFAscii85StreamDecoder(PDFStreamFilterSourcePointer input) :
+        PDFStreamFilterDecoder(qMove(input))
+    {
+
+    }
+
+protected:
+    virtual bool decode(QByteArray& output) override;
+
+private:
+    static constexpr const uint32_t STREAM_END = 0xFFFFFFFF;
+
+    /// Returns next character, which is not whitespace, or STREAM_END
+    uint32_t getChar();
+
+    bool m_end = false;
+};
+
+uint32_t PDFAscii85StreamDecoder::getChar()
+{
+    if (m_end)
+    {
+        return STREAM_END;
+    }
+
+    // Skip whitespace characters
+    int character = getByte();
+    while (character != -1 && PDFLexicalAnalyzer::isWhitespace(static_cast<char>(character)))
+    {
+        character = getByte();
+    }
+
+    if (character == -1 || character == '~')
+    {
+        m_end = true;
+        return STREAM_END;
+    }
+
+    return static_cast<uint32_t>(character);
+}
+
+bool PDFAscii85StreamDecoder::decode(QByteArray& output)
+{
+    output.reserve(CHUNK_SIZE + 4);
+
+    while (output.size() < CHUNK_SIZE)
+    {
+        const uint32_t scannedChar = getChar();
+        if (scannedChar == STREAM_END)
+        {
+            return false;
+        }
+        else if (scannedChar == 'z')
+        {
+            output.append(4, static_cast<char>(0));
+        }
+        else
+        {
+            // Scan all 5 characters, some of then can be equal to STREAM_END constant. We will
+            // treat all these characters as last character.
+            std::array<uint32_t, 5> scannedChars;
+            scannedChars.fill(84);
+            scannedChars[0] = scannedChar - 33;
+            std::size_t validBytes = 0;
+            for (auto it = std::next(scannedChars.begin()); it != scannedChars.end(); ++it)
+            {
+                uint32_t character = getChar();
+                if (character == STREAM_END)
+                {
+                    break;
+                }
+                *it = character - 33;
+                ++validBytes;
+            }
+
+            // Decode bytes using 85 base
+            uint32_t decodedBytesPacked = 0;
+            for (const uint32_t value : scannedChars)
+            {
+                decodedBytesPacked = decodedBytesPacked * 85 + value;
+            }
+
+            // Decode bytes into byte array
+            std::array<char, 4> decodedBytesUnpacked;
+            decodedBytesUnpacked.fill(0);
+            for (auto byteIt = decodedBytesUnpacked.rbegin(); byteIt != decodedBytesUnpacked.rend(); ++byteIt)
+            {
+                *byteIt = static_cast<char>(decodedBytesPacked & 0xFF);
+                decodedBytesPacked = decodedBytesPacked >> 8;
+            }
+
+            Q_ASSERT(validBytes <= decodedBytesUnpacked.size());
+            output.append(decodedBytesUnpacked.data(), static_cast<qsizetype>(validBytes));
+        }
+    }
+
+    return true;
+}
+
+PDFStreamFilterSourcePointer PDFAscii85DecodeFilter::createDecoder(PDFStreamFilterSourcePointer source,
+                                                                   const PDFObjectFetcher& objectFetcher,
+                                                                   const PDFObject& parameters,
+                                                                   const PDFSecurityHandler* securityHandler) const
+{
+    Q_UNUSED(objectFetcher);
+    Q_UNUSED(parameters);
+    Q_UNUSED(securityHandler);
+
+    return std::make_unique<PDFAscii85StreamDecoder>(qMove(source));
+}
+
 class PDFLzwStreamDecoder
 {
 public:
@@ -174,45 +532,45 @@ private:
     /// Returns a newly scanned code
     uint32_t getCode();
 
+    /// Item of the code table. Sequence of the code is the sequence
+    /// of the previous code followed by the character.
     struct TableItem
     {
-        uint32_t previous = TABLE_SIZE;
-        char character = 0;
+        uint16_t previous = TABLE_SIZE;
+        uint16_t length = 1;        ///< Length of the sequence
+        char character = 0;         ///< Last character of the sequence
+        char firstCharacter = 0;    ///< First character of the sequence
     };
 
     std::array<TableItem, TABLE_SIZE> m_table;
-    std::array<char, TABLE_SIZE> m_sequence;
 
     uint32_t m_nextCode;        ///< Next code value (to be written into the table)
     uint32_t m_nextBits;        ///< Number of bits of the next code
     uint32_t m_early;           ///< Early (see PDF 1.7 Specification, this constant is 0 or 1, based on the dictionary value)
     uint32_t m_inputBuffer;     ///< Input buffer, containing bits, which were read from the input byte array
     uint32_t m_inputBits;       ///< Number of bits in the input buffer.
-    std::array<char, TABLE_SIZE>::iterator m_currentSequenceEnd;
     bool m_first;               ///< Are we reading from stream for first time after the reset
-    char m_newCharacter;        ///< New character to be written
     int m_position;             ///< Position in the input array
     const QByteArray& m_inputByteArray;
 };
 
 PDFLzwStreamDecoder::PDFLzwStreamDecoder(const QByteArray& inputByteArray, uint32_t early) :
     m_table(),
-    m_sequence(),
     m_nextCode(0),
     m_nextBits(0),
     m_early(early),
     m_inputBuffer(0),
     m_inputBits(0),
-    m_currentSequenceEnd(m_sequence.begin()),
     m_first(false),
-    m_newCharacter(0),
     m_position(0),
     m_inputByteArray(inputByteArray)
 {
     for (size_t i = 0; i < 256; ++i)
     {
         m_table[i].character = static_cast<char>(i);
+        m_table[i].firstCharacter = static_cast<char>(i);
         m_table[i].previous = TABLE_SIZE;
+        m_table[i].length = 1;
     }
 
     clearTable();
@@ -222,8 +580,10 @@ QByteArray PDFLzwStreamDecoder::decompress()
 {
     QByteArray result;
 
-    // Guess output byte array size - assume compress ratio is 2:1
-    result.reserve(m_inputByteArray.size() * 2);
+    // Guess output byte array size - assume compress ratio is 2:1. Output
+    // is enlarged by doubling, if the guess is too low.
+    result.resize(qMax(m_inputByteArray.size() * 2, qsizetype(TABLE_SIZE)));
+    qsizetype size = 0;
 
     uint32_t previousCode = TABLE_SIZE;
     while (true)
@@ -242,32 +602,48 @@ QByteArray PDFLzwStreamDecoder::decompress()
             continue;
         }
 
-        // Normal operation code
-        if (code < m_nextCode)
+        // Code equal to the next code is a special case, sequence is the sequence
+        // of the previous code followed by its first character.
+        const bool isNextCode = (code == m_nextCode);
+        if (code > m_nextCode || (isNextCode && previousCode == TABLE_SIZE))
         {
-            m_currentSequenceEnd = m_sequence.begin();
+            // Unknown code
+            throw PDFException(PDFTranslationContext::tr("Invalid code in the LZW stream."));
+        }
 
-            for (uint32_t currentCode = code; currentCode != TABLE_SIZE; currentCode = m_table[currentCode].previous)
-            {
-                *m_currentSequenceEnd++ = m_table[currentCode].character;
-            }
+        const uint32_t sequenceCode = isNextCode ? previousCode : code;
+        const TableItem& sequenceItem = m_table[sequenceCode];
+        const qsizetype length = sequenceItem.length + (isNextCode ? 1 : 0);
 
-            // We must reverse the sequence, because we stored it in the
-            // linked list, which we traversed from last to first item.
-            std::reverse(m_sequence.begin(), m_currentSequenceEnd);
+        if (size + length > result.size())
+        {
+            result.resize(qMax(result.size() * 2, size + length));
         }
-        else if (code == m_nextCode)
+
+        // Write the sequence, we traverse it from the last to the first
+        // character, so we write it from the end to the start.
+        char* const sequenceStart = result.data() + size;
+        char* sequenceEnd = sequenceStart + sequenceItem.length;
+        if (isNextCode)
         {
-            // We use the buffer from previous run, just add a new
-            // character to the end.
-            *m_currentSequenceEnd++ = m_newCharacter;
+            *sequenceEnd = sequenceItem.firstCharacter;
         }
-        else
+
+        uint32_t currentCode = sequenceCode;
+        while (sequenceEnd != sequenceStart)
         {
-            // Unknown code
-            throw PDFException(PDFTranslationContext::tr("Invalid code in the LZW stream."));
+            if (currentCode >= TABLE_SIZE)
+            {
+                throw PDFException(PDFTranslationContext::tr("Invalid code in the LZW stream."));
+            }
+
+            const TableItem& item = m_table[currentCode];
+            *--sequenceEnd = item.character;
+            currentCode = item.previous;
         }
-        m_newCharacter = m_sequence.front();
+        size += length;
+
+        const char newCharacter = sequenceItem.firstCharacter;
 
         if (m_first)
         {
@@ -278,8 +654,12 @@ QByteArray PDFLzwStreamDecoder::decompress()
             // Add a new word in the dictionary, if we have it
             if (m_nextCode < TABLE_SIZE)
             {
-                m_table[m_nextCode].character = m_newCharacter;
-                m_table[m_nextCode].previous = previousCode;
+                TableItem& item = m_table[m_nextCode];
+                const TableItem& previousItem = m_table[previousCode];
+                item.character = newCharacter;
+                item.firstCharacter = previousItem.firstCharacter;
+                item.previous = previousCode;
+                item.length = previousItem.length + 1;
                 ++m_nextCode;
             }
 
@@ -304,24 +684,27 @@ QByteArray PDFLzwStreamDecoder::decompress()
         }
 
         previousCode = code;
+    }
+
+    result.resize(size);
 
-        // Copy the input array to the buffer
-        std::copy(m_sequence.begin(), m_currentSequenceEnd, std::back_inserter(result));
+    // Release memory only, if too much memory is wasted
+    if (result.capacity() > 2 * size + qsizetype(TABLE_SIZE))
+    {
+        result.squeeze();
     }
 
-    result.shrink_to_fit();
     return result;
 }
 
 void PDFLzwStreamDecoder::clearTable()
 {
     // We do not clear the m_table array here. It is for performance reasons, we assume
-    // the input is correct. We also do not clear the sequence buffer here.
+    // the input is correct.
 
     m_nextCode = 258;
     m_nextBits = 9;
     m_first = true;
-    m_newCharacter = 0;
 }
 
 uint32_t PDFLzwStreamDecoder::getCode()
@@ -384,7 +767,99 @@ QByteArray PDFFlateDecodeFilter::apply(const QByteArray& data,
     return predictor.apply(uncompress(data));
 }
 
-QByteArray PDFFlateDecodeFilter::compress(const QByteArray& decompressedData)
+class PDFFlateStreamDecoder : public PDFStreamFilterDecoder
+{
+public:
+    explicit PDFFlateStreamDecoder(PDFStreamFilterSourcePointer input);
+    virtual ~PDFFlateStreamDecoder() override;
+
+protected:
+    virtual bool decode(QByteArray& output) override;
+
+private:
+    z_stream m_stream = { };
+};
+
+PDFFlateStreamDecoder::PDFFlateStreamDecoder(PDFStreamFilterSourcePointer input) :
+    PDFStreamFilterDecoder(qMove(input))
+{
+    if (inflateInit(&m_stream) != Z_OK)
+    {
+        throw PDFException(PDFTranslationContext::tr("Failed to initialize flate decompression stream."));
+    }
+}
+
+PDFFlateStreamDecoder::~PDFFlateStreamDecoder()
+{
+    inflateEnd(&m_stream);
+}
+
+bool PDFFlateStreamDecoder::decode(QByteArray& output)
+{
+    output.resize(CHUNK_SIZE);
+    m_stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    m_stream.avail_out = static_cast<uInt>(output.size());
+
+    bool finished = false;
+    while (m_stream.avail_out > 0)
+    {
+        if (m_stream.avail_in == 0 && fillInputBuffer())
+        {
+            // Whole input buffer is passed to the zlib
+            m_stream.next_in = reinterpret_cast<Bytef*>(m_inputBuffer.data() + m_inputPosition);
+            m_stream.avail_in = static_cast<uInt>(m_inputSize - m_inputPosition);
+            m_inputPosition = m_inputSize;
+        }
+
+        const int error = inflate(&m_stream, Z_NO_FLUSH);
+        if (error == Z_OK)
+        {
+            continue;
+        }
+
+        if (error == Z_STREAM_END)
+        {
+            finished = true;
+            break;
+        }
+
+        QString errorMessage;
+        if (m_stream.msg)
+        {
+            errorMessage = QString::fromLatin1(m_stream.msg);
+        }
+
+        if (error == Z_DATA_ERROR && errorMessage == "incorrect data check")
+        {
+            // Data are decoded, only checksum is invalid, we ignore this error
+            finished = true;
+            break;
+        }
+
+        if (errorMessage.isEmpty())
+        {
+            errorMessage = PDFTranslationContext::tr("zlib code: %1").arg(error);
+        }
+
+        throw PDFException(PDFTranslationContext::tr("Error decompressing by flate method: %1").arg(errorMessage));
+    }
+
+    output.resize(output.size() - m_stream.avail_out);
+    return !finished;
+}
+
+PDFStreamFilterSourcePointer PDFFlateDecodeFilter::createDecoder(PDFStreamFilterSourcePointer source,
+                                                                 const PDFObjectFetcher& objectFetcher,
+                                                                 const PDFObject& parameters,
+                                                                 const PDFSecurityHandler* securityHandler) const
+{
+    Q_UNUSED(securityHandler);
+
+    PDFStreamPredictor predictor = PDFStreamPredictor::createPredictor(objectFetcher, parameters);
+    return predictor.createDecoder(std::make_unique<PDFFlateStreamDecoder>(qMove(source)));
+}
+
+QByteArray PDFFlateDecodeFilter::compress(const QByteArray& decompressedData, CompressionLevel level)
 {
     QByteArray result;
 
@@ -392,25 +867,48 @@ QByteArray PDFFlateDecodeFilter::compress(const QByteArray& decompressedData)
     stream.next_in = const_cast<Bytef*>(convertByteArrayToUcharPtr(decompressedData));
     stream.avail_in = decompressedData.size();
 
-    std::array<Bytef, 1024> outputBuffer = { };
+    int zlibLevel = Z_BEST_COMPRESSION;
+    switch (level)
+    {
+        case CompressionLevel::Fast:
+            zlibLevel = Z_BEST_SPEED;
+            break;
 
-    int error = deflateInit(&stream, Z_BEST_COMPRESSION);
+        case CompressionLevel::Default:
+            zlibLevel = Z_DEFAULT_COMPRESSION;
+            break;
+
+        case CompressionLevel::Maximum:
+            zlibLevel = Z_BEST_COMPRESSION;
+            break;
+    }
+
+    int error = deflateInit(&stream, zlibLevel);
     if (error != Z_OK)
     {
         throw PDFException(PDFTranslationContext::tr("Failed to initialize flate compression stream."));
     }
 
+    // Output buffer is allocated to upper bound of compressed size, so we
+    // usually compress whole data in one step, without repeated reallocations.
+    result.resize(static_cast<qsizetype>(deflateBound(&stream, stream.avail_in)));
+
     do
     {
-        stream.next_out = outputBuffer.data();
-        stream.avail_out = static_cast<uInt>(outputBuffer.size());
+        const qsizetype bytesWritten = static_cast<qsizetype>(stream.total_out);
+        if (bytesWritten == result.size())
+        {
+            result.resize(result.size() * 2 + 1024);
+        }
 
-        error = deflate(&stream, Z_FINISH);
+        stream.next_out = reinterpret_cast<Bytef*>(result.data()) + bytesWritten;
+        stream.avail_out = static_cast<uInt>(result.size() - bytesWritten);
 
-        int bytesWritten = int(outputBuffer.size()) - stream.avail_out;
-        result.append(reinterpret_cast<const char*>(outputBuffer.data()), bytesWritten);
+        error = deflate(&stream, Z_FINISH);
     } while (error == Z_OK);
 
+    result.resize(static_cast<qsizetype>(stream.total_out));
+
     QString errorMessage;
     if (stream.msg)
     {
@@ -438,10 +936,10 @@ QByteArray PDFFlateDecodeFilter::compress(const QByteArray& decompressedData)
     return result;
 }
 
-QByteArray PDFFlateDecodeFilter::recompress(const QByteArray& data)
+QByteArray PDFFlateDecodeFilter::recompress(const QByteArray& data, CompressionLevel level)
 {
     QByteArray decompressedData = uncompress(data);
-    return compress(decompressedData);
+    return compress(decompressedData, level);
 }
 
 PDFInteger PDFFlateDecodeFilter::getStreamDataLength(const QByteArray& data, PDFInteger offset) const
@@ -581,6 +1079,72 @@ QByteArray PDFRunLengthDecodeFilter::apply(const QByteArray& data,
     return result;
 }
 
+class PDFRunLengthStreamDecoder : public PDFStreamFilterDecoder
+{
+public:
+    explicit PDFRunLengthStreamDecoder(PDFStreamFilterSourcePointer input) :
+        PDFStreamFilterDecoder(qMove(input))
+    {
+
+    }
+
+protected:
+    virtual bool decode(QByteArray& output) override;
+};
+
+bool PDFRunLengthStreamDecoder::decode(QByteArray& output)
+{
+    output.reserve(CHUNK_SIZE + 128);
+
+    while (output.size() < CHUNK_SIZE)
+    {
+        const int current = getByte();
+        if (current == -1 || current == 128)
+        {
+            // End of stream marker
+            return false;
+        }
+        else if (current < 128)
+        {
+            // Copy n + 1 characters from the input array literally
+            const int count = current + 1;
+            const qsizetype size = output.size();
+            output.resize(size + count);
+            const qint64 bytesRead = readInput(output.data() + size, count);
+            if (bytesRead < count)
+            {
+                output.resize(size + bytesRead);
+                return false;
+            }
+        }
+        else
+        {
+            // Copy 257 - n copies of single character
+            const int count = 257 - current;
+            const int toBeCopied = getByte();
+            if (toBeCopied == -1)
+            {
+                return false;
+            }
+            output.append(count, static_cast<char>(toBeCopied));
+        }
+    }
+
+    return true;
+}
+
+PDFStreamFilterSourcePointer PDFRunLengthDecodeFilter::createDecoder(PDFStreamFilterSourcePointer source,
+                                                                     const PDFObjectFetcher& objectFetcher,
+                                                                     const PDFObject& parameters,
+                                                                     const PDFSecurityHandler* securityHandler) const
+{
+    Q_UNUSED(objectFetcher);
+    Q_UNUSED(parameters);
+    Q_UNUSED(securityHandler);
+
+    return std::make_unique<PDFRunLengthStreamDecoder>(qMove(source));
+}
+
 const PDFStreamFilter* PDFStreamFilterStorage::getFilter(const QByteArray& filterName)
 {
     const PDFStreamFilterStorage* instance = getInstance();
@@ -676,7 +1240,6 @@ PDFStreamFilterStorage::StreamFilters PDFStreamFilterStorage::getStreamFilters(c
 QByteArray PDFStreamFilterStorage::getDecodedStream(const PDFStream* stream, const PDFObjectFetcher& objectFetcher, const PDFSecurityHandler* securityHandler)
 {
     StreamFilters streamFilters = getStreamFilters(stream, objectFetcher);
-    QByteArray result = *stream->getContent();
 
     if (!streamFilters.valid)
     {
@@ -684,6 +1247,47 @@ QByteArray PDFStreamFilterStorage::getDecodedStream(const PDFStream* stream, con
         return QByteArray();
     }
 
+    auto isFilter = [](const PDFStreamFilter* filter) { return filter != nullptr; };
+    if (std::none_of(streamFilters.filterObjects.cbegin(), streamFilters.filterObjects.cend(), isFilter))
+    {
+        // Nothing to decode, we can avoid copying of the data
+        return *stream->getContent();
+    }
+
+    // Filters are chained, so only the decoded data are allocated as a whole,
+    // intermediate results are passed between the filters in chunks.
+    // Use decoded length as a size hint, if it is present. We limit the size hint
+    // by the maximal compression ratio, so invalid value can't allocate a lot of memory.
+    qint64 sizeHint = stream->getContent()->size();
+    const PDFObject& decodedLengthObject = objectFetcher(stream->getDictionary()->get(PDF_STREAM_DICT_DECODED_LENGTH));
+    if (decodedLengthObject.isInt() && decodedLengthObject.getInteger() > 0)
+    {
+        constexpr qint64 MAX_COMPRESSION_RATIO = 1024;
+        sizeHint = qMin(qint64(decodedLengthObject.getInteger()), qMax(sizeHint, qint64(1)) * MAX_COMPRESSION_RATIO);
+    }
+
+    PDFStreamFilterSourcePointer source = createDecoders(std::make_unique<PDFByteArrayStreamFilterSource>(*stream->getContent()), streamFilters, objectFetcher, securityHandler);
+    return source->readAll(sizeHint);
+}
+
+PDFStreamFilterSourcePointer PDFStreamFilterStorage::createDecodedStreamSource(const PDFStream* stream, const PDFObjectFetcher& objectFetcher, const PDFSecurityHandler* securityHandler)
+{
+    StreamFilters streamFilters = getStreamFilters(stream, objectFetcher);
+
+    if (!streamFilters.valid)
+    {
+        // Stream filters are invalid
+        return nullptr;
+    }
+
+    return createDecoders(std::make_unique<PDFByteArrayStreamFilterSource>(*stream->getContent()), streamFilters, objectFetcher, securityHandler);
+}
+
+PDFStreamFilterSourcePointer PDFStreamFilterStorage::createDecoders(PDFStreamFilterSourcePointer source,
+                                                                    const StreamFilters& streamFilters,
+                                                                    const PDFObjectFetcher& objectFetcher,
+                                                                    const PDFSecurityHandler* securityHandler)
+{
     for (size_t i = 0, count = streamFilters.filterObjects.size(); i < count; ++i)
     {
         const PDFStreamFilter* streamFilter = streamFilters.filterObjects[i];
@@ -691,11 +1295,11 @@ QByteArray PDFStreamFilterStorage::getDecodedStream(const PDFStream* stream, con
 
         if (streamFilter)
         {
-            result = streamFilter->apply(result, objectFetcher, streamFilterParameters, securityHandler);
+            source = streamFilter->createDecoder(qMove(source), objectFetcher, streamFilterParameters, securityHandler);
         }
     }
 
-    return result;
+    return source;
 }
 
 QByteArray PDFStreamFilterStorage::getDecodedStream(const PDFStream* stream, const PDFSecurityHandler* securityHandler)
@@ -738,6 +1342,125 @@ const PDFStreamFilterStorage* PDFStreamFilterStorage::getInstance()
     return &instance;
 }
 
+/// Streaming decoder of the predictor. Rows are decoded in place, only
+/// current and previous row are held in the memory.
+class PDFStreamPredictorDecoder : public PDFStreamFilterDecoder
+{
+public:
+    explicit PDFStreamPredictorDecoder(PDFStreamFilterSourcePointer input, PDFStreamPredictor predictor);
+
+protected:
+    virtual bool decode(QByteArray& output) override;
+
+private:
+    /// Decodes next row of PNG predictor, returns false, if end of data was reached
+    bool decodePNGRow(QByteArray& output);
+
+    /// Decodes next row of TIFF predictor, returns false, if end of data was reached
+    bool decodeTIFFRow(QByteArray& output);
+
+    PDFStreamPredictor m_predictor;
+    int m_pixelBytes;
+    std::vector<uint8_t> m_line;
+    std::vector<uint8_t> m_lineOld;
+};
+
+PDFStreamPredictorDecoder::PDFStreamPredictorDecoder(PDFStreamFilterSourcePointer input, PDFStreamPredictor predictor) :
+    PDFStreamFilterDecoder(qMove(input)),
+    m_predictor(predictor),
+    m_pixelBytes((predictor.m_components * predictor.m_bitsPerComponent + 7) / 8)
+{
+    // Idea: to avoid using if for many cases, we use larger buffer filled with zeros
+    m_line.resize(m_predictor.m_stride + m_pixelBytes, 0);
+    m_lineOld.resize(m_predictor.m_stride + m_pixelBytes, 0);
+}
+
+bool PDFStreamPredictorDecoder::decode(QByteArray& output)
+{
+    output.reserve(CHUNK_SIZE + m_predictor.m_stride);
+
+    while (output.size() < CHUNK_SIZE)
+    {
+        const bool hasData = (m_predictor.m_predictor == PDFStreamPredictor::TIFF) ? decodeTIFFRow(output) : decodePNGRow(output);
+        if (!hasData)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PDFStreamPredictorDecoder::decodePNGRow(QByteArray& output)
+{
+    // First, read the predictor data for current line
+    const int predictorByte = getByte();
+    if (predictorByte == -1)
+    {
+        return false;
+    }
+
+    const int stride = m_predictor.m_stride;
+    uint8_t* line = m_line.data() + m_pixelBytes;
+    const qint64 bytesRead = readInput(reinterpret_cast<char*>(line), stride);
+
+    // According to the PDF specification, incomplete line is completed. For this
+    // reason, we behave as we have zero data in the buffer.
+    std::fill(line + bytesRead, line + stride, 0);
+
+    m_predictor.decodePNGRow(m_line.data(), m_lineOld.data(), m_pixelBytes, static_cast<PDFStreamPredictor::Predictor>(predictorByte + 10));
+    output.append(reinterpret_cast<const char*>(line), stride);
+
+    // Swap the buffers
+    std::swap(m_line, m_lineOld);
+    return true;
+}
+
+bool PDFStreamPredictorDecoder::decodeTIFFRow(QByteArray& output)
+{
+    const int stride = m_predictor.m_stride;
+    const int components = m_predictor.m_components;
+    uint8_t* line = m_line.data() + m_pixelBytes;
+    const qint64 bytesRead = readInput(reinterpret_cast<char*>(line), stride);
+    if (bytesRead == 0)
+    {
+        return false;
+    }
+    std::fill(line + bytesRead, line + stride, 0);
+
+    if (m_predictor.m_bitsPerComponent == 8)
+    {
+        // Each component is predicted from the same component of the left pixel
+        for (int i = components; i < stride; ++i)
+        {
+            line[i] += line[i - components];
+        }
+        output.append(reinterpret_cast<const char*>(line), stride);
+    }
+    else
+    {
+        const QByteArray lineData = QByteArray::fromRawData(reinterpret_cast<const char*>(line), stride);
+        PDFBitReader reader(&lineData, m_predictor.m_bitsPerComponent);
+        PDFBitWriter writer(m_predictor.m_bitsPerComponent);
+        writer.reserve(stride);
+        std::vector<uint32_t> leftValues(components, 0);
+
+        for (int i = 0; i < m_predictor.m_columns; ++i)
+        {
+            for (int componentIndex = 0; componentIndex < components; ++componentIndex)
+            {
+                leftValues[componentIndex] = (leftValues[componentIndex] + reader.read()) & reader.max();
+                writer.write(leftValues[componentIndex]);
+            }
+        }
+
+        writer.finishLine();
+        output.append(writer.takeByteArray());
+    }
+
+    return true;
+}
+
 PDFStreamPredictor PDFStreamPredictor::createPredictor(const PDFObjectFetcher& objectFetcher, const PDFObject& parameters)
 {
     const PDFObject& dereferencedParameters = objectFetcher(parameters);
@@ -779,20 +1502,30 @@ PDFStreamPredictor PDFStreamPredictor::createPredictor(const PDFObjectFetcher& o
 }
 
 QByteArray PDFStreamPredictor::apply(const QByteArray& data) const
+{
+    if (m_predictor == NoPredictor)
+    {
+        return data;
+    }
+
+    return createDecoder(std::make_unique<PDFByteArrayStreamFilterSource>(data))->readAll(data.size());
+}
+
+PDFStreamFilterSourcePointer PDFStreamPredictor::createDecoder(PDFStreamFilterSourcePointer source) const
 {
     switch (m_predictor)
     {
         case NoPredictor:
-            return data;
+            return source;
 
         case TIFF:
-            return applyTIFFPredictor(data);
+            return std::make_unique<PDFStreamPredictorDecoder>(qMove(source), *this);
 
         default:
         {
             if (m_predictor >= 10)
             {
-                return applyPNGPredictor(data);
+                return std::make_unique<PDFStreamPredictorDecoder>(qMove(source), *this);
             }
             break;
         }
@@ -801,137 +1534,67 @@ QByteArray PDFStreamPredictor::apply(const QByteArray& data) const
     throw PDFException(PDFTranslationContext::tr("Invalid predictor algorithm."));
 }
 
-QByteArray PDFStreamPredictor::applyPNGPredictor(const QByteArray& data) const
+void PDFStreamPredictor::decodePNGRow(uint8_t* line, const uint8_t* lineOld, int pixelBytes, Predictor predictor) const
 {
-    QByteArray outputData;
-    outputData.reserve(data.size());
-
-    auto it = data.cbegin();
-    auto itEnd = data.cend();
-
-    int pixelBytes = (m_components * m_bitsPerComponent + 7) / 8;
-
-    auto readByte = [&it, &itEnd]() -> uint8_t
+    // Row is decoded from left to right, so left neighbours are
+    // already decoded, when current byte is being decoded.
+    for (int i = 0; i < m_stride; ++i)
     {
-        if (it != itEnd)
-        {
-            return static_cast<uint8_t>(*it++);
-        }
-
-        // According to the PDF specification, incomplete line is completed. For this
-        // reason, we behave as we have zero data in the buffer.
-        return 0;
-    };
+        const int lineIndex = i + pixelBytes;
+        const uint8_t currentByte = line[lineIndex];
 
-    // Idea: to avoid using if for many cases, we use larger buffer filled with zeros
-    const int totalBytes = m_stride + pixelBytes;
-    std::vector<uint8_t> line(totalBytes, 0);
-    std::vector<uint8_t> lineOld(totalBytes, 0);
-
-    Predictor currentPredictor = m_predictor;
-    while (it != itEnd)
-    {
-        // First, read the predictor data for current line
-        currentPredictor = static_cast<Predictor>(readByte() + 10);
-
-        for (int i = 0; i < m_stride; ++i)
+        switch (predictor)
         {
-            uint8_t currentByte = readByte();
+            case PNG_Sub:
+            {
+                line[lineIndex] = line[i] + currentByte;
+                break;
+            }
 
-            int lineIndex = i + pixelBytes;
-            switch (currentPredictor)
+            case PNG_Up:
             {
-                case PNG_Sub:
-                {
-                    line[lineIndex] = line[i] + currentByte;
-                    break;
-                }
+                line[lineIndex] = lineOld[lineIndex] + currentByte;
+                break;
+            }
 
-                case PNG_Up:
-                {
-                    line[lineIndex] = lineOld[lineIndex] + currentByte;
-                    break;
-                }
+            case PNG_Average:
+            {
+                line[lineIndex] = (lineOld[lineIndex] + line[i]) / 2 + currentByte;
+                break;
+            }
 
-                case PNG_Average:
+            case PNG_Paeth:
+            {
+                // a = left,
+                // b = upper,
+                // c = upper left
+                const int a = line[i];
+                const int b = lineOld[lineIndex];
+                const int c = lineOld[i];
+                const int p = a + b - c;
+                const int pa = std::abs(p - a);
+                const int pb = std::abs(p - b);
+                const int pc = std::abs(p - c);
+                if (pa <= pb && pa <= pc)
                 {
-                    line[lineIndex] = (lineOld[lineIndex] + line[i]) / 2 + currentByte;
-                    break;
+                    line[lineIndex] = a + currentByte;
                 }
-
-                case PNG_Paeth:
+                else if (pb <= pc)
                 {
-                    // a = left,
-                    // b = upper,
-                    // c = upper left
-                    const int a = line[i];
-                    const int b = lineOld[lineIndex];
-                    const int c = lineOld[i];
-                    const int p = a + b - c;
-                    const int pa = std::abs(p - a);
-                    const int pb = std::abs(p - b);
-                    const int pc = std::abs(p - c);
-                    if (pa <= pb && pa <= pc)
-                    {
-                        line[lineIndex] = a + currentByte;
-                    }
-                    else if (pb <= pc)
-                    {
-                        line[lineIndex] = b + currentByte;
-                    }
-                    else
-                    {
-                        line[lineIndex] = c + currentByte;
-                    }
-                    break;
+                    line[lineIndex] = b + currentByte;
                 }
-
-                case PNG_None:
-                default:
+                else
                 {
-                    line[lineIndex] = currentByte;
-                    break;
+                    line[lineIndex] = c + currentByte;
                 }
+                break;
             }
 
-            // Fill the output buffer
-            outputData.push_back(static_cast<char>(line[lineIndex]));
-        }
-
-        // Swap the buffers
-        std::swap(line, lineOld);
-    }
-
-    return outputData;
-}
-
-QByteArray PDFStreamPredictor::applyTIFFPredictor(const QByteArray& data) const
-{
-    Q_UNUSED(data);
-
-    PDFBitWriter writer(m_bitsPerComponent);
-    PDFBitReader reader(&data, m_bitsPerComponent);
-
-    writer.reserve(data.size());
-    std::vector<uint32_t> leftValues(m_components, 0);
-
-    while (!reader.isAtEnd())
-    {
-        for (int i = 0; i < m_columns; ++i)
-        {
-            for (int componentIndex = 0; componentIndex < m_components; ++componentIndex)
-            {
-                leftValues[componentIndex] = (leftValues[componentIndex] + reader.read()) & reader.max();
-                writer.write(leftValues[componentIndex]);
-            }
+            case PNG_None:
+            default:
+                break;
         }
-
-        std::fill(leftValues.begin(), leftValues.end(), 0);
-        reader.alignToBytes();
-        writer.finishLine();
     }
-
-    return writer.takeByteArray();
 }
 
 QByteArray PDFCryptFilter::apply(const QByteArray& data,
@@ -974,4 +1637,14 @@ PDFInteger PDFStreamFilter::getStreamDataLength(const QByteArray& data, PDFInteg
     return -1;
 }
 
+PDFStreamFilterSourcePointer PDFStreamFilter::createDecoder(PDFStreamFilterSourcePointer source,
+                                                            const PDFObjectFetcher& objectFetcher,
+                                                            const PDFObject& parameters,
+                                                            const PDFSecurityHandler* securityHandler) const
+{
+    // Filter doesn't support streaming decoding, so we decode all data at once
+    QByteArray data = source->readAll();
+    return std::make_unique<PDFByteArrayStreamFilterSource>(apply(data, objectFetcher, parameters, securityHandler));
+}
+
 }   // namespace pdf
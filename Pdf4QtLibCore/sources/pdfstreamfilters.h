@@ -32,6 +32,43 @@ class PDFSecurityHandler;
 
 using PDFObjectFetcher = std::function<const PDFObject&(const PDFObject&)>;
 
+/// Pull-based source of stream data. Data are read in chunks, so stream filters
+/// can be chained without allocating whole intermediate result for each filter.
+class PDF4QTLIBCORESHARED_EXPORT PDFStreamFilterSource
+{
+public:
+    explicit PDFStreamFilterSource() = default;
+    virtual ~PDFStreamFilterSource() = default;
+
+    /// Size of the chunks of data, which are processed by filters at once
+    static constexpr qint64 CHUNK_SIZE = 64 * 1024;
+
+    /// Reads at most \p maxSize bytes into the buffer. Returns count of bytes
+    /// read, zero is returned only, if end of data was reached. Can throw exception.
+    /// \param buffer Buffer
+    /// \param maxSize Maximal count of bytes to be read
+    virtual qint64 read(char* buffer, qint64 maxSize) = 0;
+
+    /// Reads all remaining data. Can throw exception.
+    /// \param sizeHint Expected size of the data
+    QByteArray readAll(qint64 sizeHint = 0);
+};
+
+using PDFStreamFilterSourcePointer = std::unique_ptr<PDFStreamFilterSource>;
+
+/// Source reading data from the byte array (data are not copied)
+class PDF4QTLIBCORESHARED_EXPORT PDFByteArrayStreamFilterSource : public PDFStreamFilterSource
+{
+public:
+    explicit PDFByteArrayStreamFilterSource(QByteArray data) : m_data(qMove(data)) { }
+
+    virtual qint64 read(char* buffer, qint64 maxSize) override;
+
+private:
+    QByteArray m_data;
+    qint64 m_position = 0;
+};
+
 /// Storage for stream filters. Can retrieve stream filters by name. Using singleton
 /// design pattern. Use static methods to retrieve filters.
 class PDFStreamFilterStorage
@@ -54,6 +91,14 @@ public:
     /// \param securityHandler Security handler for Crypt filters
     static QByteArray getDecodedStream(const PDFStream* stream, const PDFSecurityHandler* securityHandler);
 
+    /// Creates source of decoded data of the stream. Filters are chained and data
+    /// are decoded in chunks, when they are read from the source. If stream filters
+    /// are invalid, then nullptr is returned. Can throw exception.
+    /// \param stream Stream containing the data (must be valid during the lifetime of the source)
+    /// \param objectFetcher Function which retrieves objects (for example, reads objects from reference)
+    /// \param securityHandler Security handler for Crypt filters
+    static PDFStreamFilterSourcePointer createDecodedStreamSource(const PDFStream* stream, const PDFObjectFetcher& objectFetcher, const PDFSecurityHandler* securityHandler);
+
     /// Tries to find stream data length using given filter. Stream will
     /// start at given \p offset in \p data. If stream length cannot be determined,
     /// then -1 is returned.
@@ -77,6 +122,12 @@ public:
 private:
     explicit PDFStreamFilterStorage();
 
+    /// Chains decoders of stream filters to the source
+    static PDFStreamFilterSourcePointer createDecoders(PDFStreamFilterSourcePointer source,
+                                                       const StreamFilters& streamFilters,
+                                                       const PDFObjectFetcher& objectFetcher,
+                                                       const PDFSecurityHandler* securityHandler);
+
     static const PDFStreamFilterStorage* getInstance();
 
     /// Maps names to the instances of the stream filters
@@ -99,7 +150,14 @@ public:
     /// \param data Data to be decoded using predictor
     QByteArray apply(const QByteArray& data) const;
 
+    /// Creates decoder, which applies the predictor to the data read from
+    /// the source. Rows are decoded in place, one at a time. If no predictor
+    /// is used, then source is returned. If error occurs, exception is thrown.
+    /// \param source Source of the data
+    PDFStreamFilterSourcePointer createDecoder(PDFStreamFilterSourcePointer source) const;
+
 private:
+    friend class PDFStreamPredictorDecoder;
 
     enum Predictor
     {
@@ -124,11 +182,13 @@ private:
         m_stride = (m_columns * m_components * m_bitsPerComponent + 7) / 8;
     }
 
-    /// Applies PNG predictor
-    QByteArray applyPNGPredictor(const QByteArray& data) const;
-
-    /// Applies TIFF predictor
-    QByteArray applyTIFFPredictor(const QByteArray& data) const;
+    /// Decodes row of PNG predictor in place. Both rows are prefixed by
+    /// zero bytes of one pixel, so left neighbour always exists.
+    /// \param line Row to be decoded (raw data on input, decoded data on output)
+    /// \param lineOld Previous decoded row
+    /// \param pixelBytes Count of bytes of one pixel
+    /// \param predictor Predictor of the row
+    void decodePNGRow(uint8_t* line, const uint8_t* lineOld, int pixelBytes, Predictor predictor) const;
 
     Predictor m_predictor = NoPredictor;
     int m_components = 0;
@@ -162,6 +222,19 @@ public:
     /// \param data Buffer data
     /// \param offset Offset to buffer, at which stream data starts
     virtual PDFInteger getStreamDataLength(const QByteArray& data, PDFInteger offset) const;
+
+    /// Creates decoder, which decodes data read from the source in chunks. Default
+    /// implementation reads all data from the source and applies the filter to them,
+    /// filters supporting streaming decoding reimplement this function.
+    /// Can throw exception.
+    /// \param source Source of the data to be decoded
+    /// \param objectFetcher Function which retrieves objects (for example, reads objects from reference)
+    /// \param parameters Stream parameters
+    /// \param securityHandler Security handler for Crypt filters
+    virtual PDFStreamFilterSourcePointer createDecoder(PDFStreamFilterSourcePointer source,
+                                                       const PDFObjectFetcher& objectFetcher,
+                                                       const PDFObject& parameters,
+                                                       const PDFSecurityHandler* securityHandler) const;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFAsciiHexDecodeFilter : public PDFStreamFilter
@@ -174,6 +247,11 @@ public:
                              const PDFObjectFetcher& objectFetcher,
                              const PDFObject& parameters,
                              const PDFSecurityHandler* securityHandler) const override;
+
+    virtual PDFStreamFilterSourcePointer createDecoder(PDFStreamFilterSourcePointer source,
+                                                       const PDFObjectFetcher& objectFetcher,
+                                                       const PDFObject& parameters,
+                                                       const PDFSecurityHandler* securityHandler) const override;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFAscii85DecodeFilter : public PDFStreamFilter
@@ -186,6 +264,11 @@ public:
                              const PDFObjectFetcher& objectFetcher,
                              const PDFObject& parameters,
                              const PDFSecurityHandler* securityHandler) const override;
+
+    virtual PDFStreamFilterSourcePointer createDecoder(PDFStreamFilterSourcePointer source,
+                                                       const PDFObjectFetcher& objectFetcher,
+                                                       const PDFObject& parameters,
+                                                       const PDFSecurityHandler* securityHandler) const override;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFLzwDecodeFilter : public PDFStreamFilter
@@ -213,14 +296,30 @@ public:
 
     virtual PDFInteger getStreamDataLength(const QByteArray& data, PDFInteger offset) const override;
 
-    /// Recompresses data. So, first, data are decompressed, and then
-    /// recompressed again with maximal compress ratio possible.
+    virtual PDFStreamFilterSourcePointer createDecoder(PDFStreamFilterSourcePointer source,
+                                                       const PDFObjectFetcher& objectFetcher,
+                                                       const PDFObject& parameters,
+                                                       const PDFSecurityHandler* securityHandler) const override;
+
+    /// Compression level trade-off between speed and compression ratio
+    enum class CompressionLevel
+    {
+        Fast,       ///< Fastest compression, worst compression ratio
+        Default,    ///< Default zlib compression level
+        Maximum     ///< Maximal compress ratio possible, slowest compression
+    };
+
+    /// Compress data with given compression level. Default is maximal
+    /// compress ratio possible.
     /// \param data Uncompressed data to be compressed
-    static QByteArray compress(const QByteArray& decompressedData);
+    /// \param level Compression level
+    static QByteArray compress(const QByteArray& decompressedData, CompressionLevel level = CompressionLevel::Maximum);
 
-    /// Compress data with maximal compress ratio possible.
+    /// Recompresses data. So, first, data are decompressed, and then
+    /// recompressed again with given compression level.
     /// \param data Compressed data to be recompressed
-    static QByteArray recompress(const QByteArray& data);
+    /// \param level Compression level
+    static QByteArray recompress(const QByteArray& data, CompressionLevel level = CompressionLevel::Maximum);
 
 private:
     static QByteArray uncompress(const QByteArray& data);
@@ -236,6 +335,11 @@ public:
                              const PDFObjectFetcher& objectFetcher,
                              const PDFObject& parameters,
                              const PDFSecurityHandler* securityHandler) const override;
+
+    virtual PDFStreamFilterSourcePointer createDecoder(PDFStreamFilterSourcePointer source,
+                                                       const PDFObjectFetcher& objectFetcher,
+                                                       const PDFObject& parameters,
+                                                       const PDFSecurityHandler* securityHandler) const override;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFCryptFilter : public PDFStreamFilter
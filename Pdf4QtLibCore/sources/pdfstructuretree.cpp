@@ -519,6 +519,12 @@ PDFObjectReference PDFStructureTree::getParent(PDFInteger id, PDFInteger index)
     return PDFObjectReference();
 }
 
+PDFObjectReference PDFStructureTree::getElementReference(const QByteArray& id, const PDFObjectStorage* storage) const
+{
+    PDFObject object = PDFNameTreeLoader<PDFObjectReference>::find(storage, m_idTree, id);
+    return object.isReference() ? object.getReference() : PDFObjectReference();
+}
+
 PDFStructureItem::Type PDFStructureTree::getTypeFromRole(const QByteArray& role) const
 {
     auto it = m_roleMap.find(role);
@@ -553,10 +559,8 @@ PDFStructureTree PDFStructureTree::parse(const PDFObjectStorage* storage, PDFObj
         PDFMarkedObjectsContext context;
         parseKids(storage, &tree, dictionary, &context);
 
-        if (dictionary->hasKey("IDTree"))
-        {
-            tree.m_idTreeMap = PDFNameTreeLoader<PDFObjectReference>::parse(storage, dictionary->get("IDTree"), [](const PDFObjectStorage*, const PDFObject& object) { return object.isReference() ? object.getReference() : PDFObjectReference(); });
-        }
+        // ID tree is resolved on demand
+        tree.m_idTree = dictionary->get("IDTree");
 
         if (dictionary->hasKey("ParentTree"))
         {
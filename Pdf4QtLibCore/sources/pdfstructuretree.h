@@ -391,6 +391,14 @@ public:
     /// \param index Index into the subarray
     PDFObjectReference getParent(PDFInteger id, PDFInteger index) const;
 
+    /// Returns reference to the structure element with given element identifier
+    /// (entry /ID of the structure element). Element is looked up in the ID tree
+    /// on demand, the ID tree is not loaded (it can have millions of entries).
+    /// If element is not found, then invalid reference is returned.
+    /// \param id Element identifier
+    /// \param storage Storage
+    PDFObjectReference getElementReference(const QByteArray& id, const PDFObjectStorage* storage) const;
+
     /// Returns type from role. Role can be an entry in RoleMap dictionary,
     /// or one of the standard roles.
     /// \param role Role
@@ -438,7 +446,7 @@ public:
 private:
     using ParentTreeEntries = std::vector<ParentTreeEntry>;
 
-    std::map<QByteArray, PDFObjectReference> m_idTreeMap;
+    PDFObject m_idTree;
     ParentTreeEntries m_parentTreeEntries;
     PDFInteger m_parentNextKey = 0;
     std::map<QByteArray, Type> m_roleMap;
@@ -23,9 +23,13 @@
 #include <QMutex>
 #include <QPainter>
 #include <QIODevice>
+#include <QThread>
 #include <QMutexLocker>
 #include <QRegularExpression>
 
+#include <numeric>
+#include <unordered_map>
+
 #include "pdfdbgheap.h"
 
 #include <execution>
@@ -286,11 +290,17 @@ void PDFTextLayout::addCharacter(const PDFTextCharacterInfo& info)
     m_angles.insert(character.angle);
 }
 
-void PDFTextLayout::perform()
+void PDFTextLayout::perform(const PDFOperationControl* operationControl)
 {
     for (PDFReal angle : m_angles)
     {
-        performDoLayout(angle);
+        performDoLayout(angle, operationControl);
+    }
+
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        // Layout is incomplete, do not provide partial results
+        m_blocks.clear();
     }
 }
 
@@ -602,8 +612,13 @@ struct NearestCharacterInfo
     inline bool operator<(const NearestCharacterInfo& other) const { return distance < other.distance; }
 };
 
-void PDFTextLayout::performDoLayout(PDFReal angle)
+void PDFTextLayout::performDoLayout(PDFReal angle, const PDFOperationControl* operationControl)
 {
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        return;
+    }
+
     // We will implement variation of 'docstrum' algorithm, we have divided characters by angles,
     // for each angle we get characters for that particular angle, and run 'docstrum' algorithm.
     // We will do following steps:
@@ -686,6 +701,11 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
     auto range = PDFIntegerRange<size_t>(0, characterCount);
     PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Content, range.begin(), range.end(), findNearestCharacters);
 
+    if (PDFOperationControl::isOperationCancelled(operationControl))
+    {
+        return;
+    }
+
     // Step 3) - detect lines
     PDFUnionFindAlgorithm<size_t> textLinesUF(characterCount);
     for (size_t i = 0; i < characterCount; ++i)
@@ -734,13 +754,45 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
 
     // Step 4) - detect text blocks
     const size_t lineCount = lines.size();
+    std::vector<QRectF> lineBoundingRects;
+    lineBoundingRects.reserve(lineCount);
+    PDFReal maximalLineHeight = 0.0;
+    for (const PDFTextLine& line : lines)
+    {
+        lineBoundingRects.push_back(line.getBoundingBox().boundingRect());
+        maximalLineHeight = qMax(maximalLineHeight, lineBoundingRects.back().height());
+    }
+
+    // Lines are swept in order of their top coordinate. Two lines can be joined
+    // only if height of their union is small, so for each line, only lines with
+    // top coordinate in a limited range below it are candidates. If line b is
+    // below line a, then union height is at least (b.top - a.top + b.height), which
+    // exceeds the limit, if (b.top - a.top) >= (a.height + maximalLineHeight) * sensitivity.
+    std::vector<size_t> linesByTop(lineCount, 0);
+    std::iota(linesByTop.begin(), linesByTop.end(), 0);
+    std::sort(linesByTop.begin(), linesByTop.end(), [&lineBoundingRects](size_t l, size_t r) { return lineBoundingRects[l].top() < lineBoundingRects[r].top(); });
+
     PDFUnionFindAlgorithm<size_t> textBlocksUF(lineCount);
-    for (size_t i = 0; i < lineCount; ++i)
+    for (size_t k = 0; k < lineCount; ++k)
     {
-        for (size_t j = i + 1; j < lineCount; ++j)
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return;
+        }
+
+        const size_t i = linesByTop[k];
+        const QRectF& bb1 = lineBoundingRects[i];
+        const PDFReal topLimit = bb1.top() + (bb1.height() + maximalLineHeight) * m_settings.blockVerticalSensitivity;
+
+        for (size_t l = k + 1; l < lineCount; ++l)
         {
-            QRectF bb1 = lines[i].getBoundingBox().boundingRect();
-            QRectF bb2 = lines[j].getBoundingBox().boundingRect();
+            const size_t j = linesByTop[l];
+            const QRectF& bb2 = lineBoundingRects[j];
+
+            if (bb2.top() >= topLimit)
+            {
+                break;
+            }
 
             // Jakub Melka: we will join two blocks, if these two conditions both holds:
             //     1) bounding boxes overlap horizontally by large portion
@@ -784,32 +836,39 @@ void PDFTextLayout::performDoLayout(PDFReal angle)
     //    - there doesn't exist block c, which is between a,b in y-axis
     //      and moreover, overlaps both a and b in x-axis.
 
-    auto isBeforeByRule1 = [&blocks](const size_t aIndex, const size_t bIndex)
+    std::vector<QRectF> blockBoundingRects;
+    blockBoundingRects.reserve(blocks.size());
+    for (const PDFTextBlock& block : blocks)
+    {
+        blockBoundingRects.push_back(block.getBoundingBox().boundingRect());
+    }
+
+    auto isBeforeByRule1 = [&blockBoundingRects](const size_t aIndex, const size_t bIndex)
     {
-        QRectF aBB = blocks[aIndex].getBoundingBox().boundingRect();
-        QRectF bBB = blocks[bIndex].getBoundingBox().boundingRect();
+        const QRectF& aBB = blockBoundingRects[aIndex];
+        const QRectF& bBB = blockBoundingRects[bIndex];
 
         const bool isOverlappedOnHorizontalAxis = isRectangleHorizontallyOverlapped(aBB, bBB);
         const bool isAoverB = aBB.bottom() > bBB.top();
         return isOverlappedOnHorizontalAxis && isAoverB;
     };
-    auto isBeforeByRule2 = [&blocks](const size_t aIndex, const size_t bIndex)
+    auto isBeforeByRule2 = [&blockBoundingRects](const size_t aIndex, const size_t bIndex)
     {
-        QRectF aBB = blocks[aIndex].getBoundingBox().boundingRect();
-        QRectF bBB = blocks[bIndex].getBoundingBox().boundingRect();
+        const QRectF& aBB = blockBoundingRects[aIndex];
+        const QRectF& bBB = blockBoundingRects[bIndex];
         QRectF abBB = aBB.united(bBB);
 
         if (aBB.right() < bBB.left())
         {
             // Check, if 'c' block doesn't exist
-            for (size_t i = 0, count = blocks.size(); i < count; ++i)
+            for (size_t i = 0, count = blockBoundingRects.size(); i < count; ++i)
             {
                 if (i == aIndex || i == bIndex)
                 {
                     continue;
                 }
 
-                QRectF cBB = blocks[i].getBoundingBox().boundingRect();
+                const QRectF& cBB = blockBoundingRects[i];
                 if (cBB.top() >= abBB.top() && cBB.bottom() <= abBB.bottom())
                 {
                     const bool isAOverlappedOnHorizontalAxis = isRectangleHorizontallyOverlapped(aBB, cBB);
@@ -1119,19 +1178,365 @@ void PDFTextLayoutStorage::setTextLayout(PDFInteger pageIndex, const PDFTextLayo
         QDataStream stream(&result, QIODevice::WriteOnly);
         stream << layout;
     }
-    result = qCompress(result, 9);
+    result = qCompress(result, COMPRESSION_LEVEL);
+    QString searchText = createSearchText(layout);
 
     QMutexLocker lock(mutex);
     m_offsets[pageIndex] = m_textLayouts.size();
+    m_searchTexts[pageIndex] = qMove(searchText);
 
     QDataStream layoutStream(&m_textLayouts, QIODevice::Append | QIODevice::WriteOnly);
     layoutStream << result;
 }
 
+QString PDFTextLayoutStorage::createSearchText(const PDFTextLayout& layout)
+{
+    QString searchText;
+
+    for (const PDFTextBlock& textBlock : layout.getTextBlocks())
+    {
+        for (const PDFTextLine& textLine : textBlock.getLines())
+        {
+            for (const TextCharacter& character : textLine.getCharacters())
+            {
+                if (!character.character.isSpace() && character.character != QChar(QChar::SoftHyphen))
+                {
+                    searchText += character.character;
+                }
+            }
+        }
+    }
+
+    return searchText;
+}
+
+QString PDFTextLayoutStorage::createSearchText(const QString& text)
+{
+    QString searchText;
+    searchText.reserve(text.size());
+
+    for (const QChar character : text)
+    {
+        if (!character.isSpace() && character != QChar(QChar::SoftHyphen))
+        {
+            searchText += character;
+        }
+    }
+
+    return searchText;
+}
+
+bool PDFTextLayoutStorage::isSearchTextCandidate(size_t pageIndex, const QString& searchText, Qt::CaseSensitivity caseSensitivity) const
+{
+    if (searchText.isEmpty() || pageIndex >= m_searchTexts.size())
+    {
+        // We can't decide, page must be searched
+        return true;
+    }
+
+    return m_searchTexts[pageIndex].contains(searchText, caseSensitivity);
+}
+
+quint64 PDFTextLayoutStorage::getTrigram(const QString& text, qsizetype index)
+{
+    return (quint64(text[index].unicode()) << 32) | (quint64(text[index + 1].unicode()) << 16) | quint64(text[index + 2].unicode());
+}
+
+qint64 PDFTextLayoutStorage::getMemoryConsumptionEstimate() const
+{
+    qint64 estimate = sizeof(*this);
+    estimate += sizeof(decltype(m_offsets)::value_type) * m_offsets.capacity();
+    estimate += m_textLayouts.capacity();
+    estimate += sizeof(QString) * m_searchTexts.capacity();
+    for (const QString& searchText : m_searchTexts)
+    {
+        estimate += searchText.capacity() * sizeof(QChar);
+    }
+    estimate += sizeof(decltype(m_trigrams)::value_type) * m_trigrams.capacity();
+    estimate += sizeof(decltype(m_trigramPages)::value_type) * m_trigramPages.capacity();
+    for (const std::vector<quint32>& pages : m_trigramPages)
+    {
+        estimate += sizeof(quint32) * pages.capacity();
+    }
+    return estimate;
+}
+
+void PDFTextLayoutStorage::buildSearchIndex()
+{
+    // Collect unique trigrams of each page in parallel
+    std::vector<std::vector<quint64>> pageTrigrams(m_searchTexts.size());
+    auto collectTrigrams = [this, &pageTrigrams](size_t pageIndex)
+    {
+        const QString text = m_searchTexts[pageIndex].toCaseFolded();
+        std::vector<quint64>& trigrams = pageTrigrams[pageIndex];
+
+        if (text.size() >= 3)
+        {
+            trigrams.reserve(text.size() - 2);
+            for (qsizetype i = 0; i + 2 < text.size(); ++i)
+            {
+                trigrams.push_back(getTrigram(text, i));
+            }
+
+            std::sort(trigrams.begin(), trigrams.end());
+            trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        }
+    };
+
+    auto range = PDFIntegerRange<size_t>(0, m_searchTexts.size());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), collectTrigrams);
+
+    // Create posting lists, pages are processed in ascending order,
+    // so page indices in posting lists are sorted.
+    std::unordered_map<quint64, std::vector<quint32>> postingLists;
+    for (size_t pageIndex = 0; pageIndex < pageTrigrams.size(); ++pageIndex)
+    {
+        for (quint64 trigram : pageTrigrams[pageIndex])
+        {
+            postingLists[trigram].push_back(quint32(pageIndex));
+        }
+        pageTrigrams[pageIndex] = std::vector<quint64>();
+    }
+
+    m_trigrams.clear();
+    m_trigrams.reserve(postingLists.size());
+    for (const auto& item : postingLists)
+    {
+        m_trigrams.push_back(item.first);
+    }
+    std::sort(m_trigrams.begin(), m_trigrams.end());
+
+    m_trigramPages.clear();
+    m_trigramPages.reserve(m_trigrams.size());
+    for (quint64 trigram : m_trigrams)
+    {
+        m_trigramPages.emplace_back(qMove(postingLists[trigram]));
+    }
+
+    m_isSearchIndexBuilt = true;
+}
+
+std::vector<size_t> PDFTextLayoutStorage::getCandidatePages(const QStringList& literals, Qt::CaseSensitivity caseSensitivity) const
+{
+    std::vector<size_t> pages;
+
+    // Intersect posting lists of all trigrams of all literals
+    bool isIntersected = false;
+    if (m_isSearchIndexBuilt)
+    {
+        std::vector<quint32> candidates;
+        for (const QString& literal : literals)
+        {
+            const QString text = literal.toCaseFolded();
+            for (qsizetype i = 0; i + 2 < text.size(); ++i)
+            {
+                auto it = std::lower_bound(m_trigrams.cbegin(), m_trigrams.cend(), getTrigram(text, i));
+                if (it == m_trigrams.cend() || *it != getTrigram(text, i))
+                {
+                    // Trigram is not present in any page
+                    return pages;
+                }
+
+                const std::vector<quint32>& trigramPages = m_trigramPages[std::distance(m_trigrams.cbegin(), it)];
+                if (!isIntersected)
+                {
+                    candidates = trigramPages;
+                    isIntersected = true;
+                }
+                else
+                {
+                    std::vector<quint32> intersection;
+                    std::set_intersection(candidates.cbegin(), candidates.cend(), trigramPages.cbegin(), trigramPages.cend(), std::back_inserter(intersection));
+                    candidates = qMove(intersection);
+                }
+
+                if (candidates.empty())
+                {
+                    return pages;
+                }
+            }
+        }
+
+        pages.assign(candidates.cbegin(), candidates.cend());
+    }
+
+    if (!isIntersected)
+    {
+        pages.resize(m_offsets.size());
+        std::iota(pages.begin(), pages.end(), size_t(0));
+    }
+
+    // Trigrams don't preserve the order, so we must check the literals
+    auto it = std::remove_if(pages.begin(), pages.end(), [this, &literals, caseSensitivity](size_t pageIndex)
+    {
+        return !std::all_of(literals.cbegin(), literals.cend(), [this, pageIndex, caseSensitivity](const QString& literal) { return isSearchTextCandidate(pageIndex, literal, caseSensitivity); });
+    });
+    pages.erase(it, pages.end());
+
+    return pages;
+}
+
+QStringList PDFTextLayoutStorage::getRequiredLiterals(const QRegularExpression& expression)
+{
+    QStringList literals;
+
+    const QString pattern = expression.pattern();
+    if (pattern.contains(QChar('|')) || pattern.contains(QChar('#')) ||
+        expression.patternOptions().testFlag(QRegularExpression::ExtendedPatternSyntaxOption))
+    {
+        // Alternatives (or comments in extended syntax), we can't
+        // determine literals, which are always present.
+        return literals;
+    }
+
+    QString literal;
+    auto flush = [&literals, &literal]()
+    {
+        if (!literal.isEmpty())
+        {
+            literals << literal;
+            literal.clear();
+        }
+    };
+
+    // Only letters and numbers outside of groups are taken as literals,
+    // everything else terminates the literal.
+    int depth = 0;
+    const qsizetype size = pattern.size();
+    for (qsizetype i = 0; i < size; ++i)
+    {
+        const QChar character = pattern[i];
+
+        if (character == QChar('\\'))
+        {
+            // Escape sequence (character class, backreference, ...)
+            flush();
+            ++i;
+        }
+        else if (character == QChar('['))
+        {
+            // Skip character class
+            flush();
+            ++i;
+            if (i < size && pattern[i] == QChar('^'))
+            {
+                ++i;
+            }
+            if (i < size && pattern[i] == QChar(']'))
+            {
+                ++i;
+            }
+            while (i < size && pattern[i] != QChar(']'))
+            {
+                if (pattern[i] == QChar('\\'))
+                {
+                    ++i;
+                }
+                ++i;
+            }
+        }
+        else if (character == QChar('('))
+        {
+            flush();
+            ++depth;
+        }
+        else if (character == QChar(')'))
+        {
+            flush();
+            --depth;
+        }
+        else if (character == QChar('?') || character == QChar('*') || character == QChar('{'))
+        {
+            // Previous character is optional
+            if (!literal.isEmpty())
+            {
+                literal.chop(1);
+            }
+            flush();
+
+            if (character == QChar('{'))
+            {
+                while (i < size && pattern[i] != QChar('}'))
+                {
+                    ++i;
+                }
+            }
+        }
+        else if (depth == 0 && character.isLetterOrNumber())
+        {
+            literal += character;
+        }
+        else
+        {
+            flush();
+        }
+    }
+    flush();
+
+    return literals;
+}
+
+QByteArray PDFTextLayoutStorage::serialize() const
+{
+    QByteArray result;
+
+    {
+        QDataStream stream(&result, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << SERIALIZATION_MAGIC;
+        stream << SERIALIZATION_VERSION;
+        stream << m_offsets;
+        stream << m_textLayouts;
+        stream << m_searchTexts;
+        stream << m_isSearchIndexBuilt;
+        stream << m_trigrams;
+        stream << m_trigramPages;
+    }
+
+    return result;
+}
+
+PDFTextLayoutStorage PDFTextLayoutStorage::deserialize(const QByteArray& data)
+{
+    PDFTextLayoutStorage result;
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic;
+    stream >> version;
+
+    if (magic != SERIALIZATION_MAGIC || version != SERIALIZATION_VERSION)
+    {
+        return PDFTextLayoutStorage();
+    }
+
+    stream >> result.m_offsets;
+    stream >> result.m_textLayouts;
+    stream >> result.m_searchTexts;
+    stream >> result.m_isSearchIndexBuilt;
+    stream >> result.m_trigrams;
+    stream >> result.m_trigramPages;
+
+    if (stream.status() != QDataStream::Ok ||
+        result.m_searchTexts.size() != result.m_offsets.size() ||
+        result.m_trigramPages.size() != result.m_trigrams.size())
+    {
+        return PDFTextLayoutStorage();
+    }
+
+    return result;
+}
+
 PDFFindResults PDFTextLayoutStorage::find(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags) const
 {
     PDFFindResults results;
 
+    const QString searchText = createSearchText(text);
+    const std::vector<size_t> pages = getCandidatePages(searchText.isEmpty() ? QStringList() : QStringList(searchText), caseSensitivity);
+
     QMutex resultsMutex;
     auto findImpl = [this, flowFlags, caseSensitivity, &results, &resultsMutex, &text](size_t pageIndex)
     {
@@ -1150,8 +1555,7 @@ PDFFindResults PDFTextLayoutStorage::find(const QString& text, Qt::CaseSensitivi
         }
     };
 
-    auto range = PDFIntegerRange<size_t>(0, m_offsets.size());
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), findImpl);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pages.cbegin(), pages.cend(), findImpl);
 
     std::sort(results.begin(), results.end());
     return results;
@@ -1161,9 +1565,33 @@ PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression,
 {
     PDFFindResults results;
 
+    auto appendResults = [&results](PDFFindResults batchResults)
+    {
+        results.insert(results.end(), std::make_move_iterator(batchResults.begin()), std::make_move_iterator(batchResults.end()));
+    };
+    find(expression, flowFlags, appendResults, nullptr);
+
+    return results;
+}
+
+void PDFTextLayoutStorage::find(const QRegularExpression& expression,
+                                PDFTextFlow::FlowFlags flowFlags,
+                                const FindCallback& callback,
+                                const PDFOperationControl* operationControl) const
+{
+    // Case sensitivity can be changed in the pattern, so we
+    // check the required literals with case insensitive match.
+    const std::vector<size_t> pages = getCandidatePages(getRequiredLiterals(expression), Qt::CaseInsensitive);
+
+    PDFFindResults results;
     QMutex resultsMutex;
-    auto findImpl = [this, flowFlags, &results, &resultsMutex, &expression](size_t pageIndex)
+    auto findImpl = [this, flowFlags, operationControl, &results, &resultsMutex, &expression](size_t pageIndex)
     {
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            return;
+        }
+
         PDFTextLayout textLayout = getTextLayout(pageIndex);
         PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, flowFlags, pageIndex);
         for (const PDFTextFlow& textFlow : textFlows)
@@ -1179,11 +1607,27 @@ PDFFindResults PDFTextLayoutStorage::find(const QRegularExpression& expression,
         }
     };
 
-    auto range = PDFIntegerRange<size_t>(0, m_offsets.size());
-    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), findImpl);
+    // Batch is large enough to keep all threads busy, but small enough
+    // to deliver first results (and react to cancellation) quickly.
+    const size_t batchSize = std::max(QThread::idealThreadCount(), 1) * 4;
+    for (auto it = pages.cbegin(); it != pages.cend();)
+    {
+        if (PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            break;
+        }
 
-    std::sort(results.begin(), results.end());
-    return results;
+        auto itEnd = std::next(it, std::min<std::ptrdiff_t>(batchSize, std::distance(it, pages.cend())));
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, it, itEnd, findImpl);
+        it = itEnd;
+
+        if (!results.empty() && !PDFOperationControl::isOperationCancelled(operationControl))
+        {
+            std::sort(results.begin(), results.end());
+            callback(qMove(results));
+            results = PDFFindResults();
+        }
+    }
 }
 
 QDataStream& operator<<(QDataStream& stream, const PDFTextLayoutSettings& settings)
@@ -1690,9 +2134,14 @@ const PDFTextLayout& PDFTextLayoutCache::getTextLayout(PDFInteger pageIndex)
 {
     if (m_pageIndex != pageIndex)
     {
+        ++m_missCount;
         m_pageIndex = pageIndex;
         m_layout = m_textLayoutGetter(pageIndex);
     }
+    else
+    {
+        ++m_hitCount;
+    }
 
     return m_layout;
 }
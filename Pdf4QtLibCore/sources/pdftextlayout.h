@@ -20,12 +20,15 @@
 
 #include "pdfglobal.h"
 #include "pdfutils.h"
+#include "pdfoperationcontrol.h"
 
 #include <QColor>
 #include <QDataStream>
+#include <QStringList>
 #include <QPainterPath>
 
 #include <set>
+#include <functional>
 #include <compare>
 
 class QMutex;
@@ -361,8 +364,10 @@ public:
     /// Adds character to the layout
     void addCharacter(const PDFTextCharacterInfo& info);
 
-    /// Performs text layout algorithm
-    void perform();
+    /// Performs text layout algorithm. If operation is cancelled,
+    /// layout is left without text blocks.
+    /// \param operationControl Operation control
+    void perform(const PDFOperationControl* operationControl = nullptr);
 
     /// Optimizes layout memory allocation to contain less space
     void optimize();
@@ -419,7 +424,7 @@ public:
 
 private:
     /// Makes layout for particular angle
-    void performDoLayout(PDFReal angle);
+    void performDoLayout(PDFReal angle, const PDFOperationControl* operationControl);
 
     /// Returns a list of characters for particular angle. Exact match is used
     /// for angle, even if angle is floating point number.
@@ -452,10 +457,18 @@ public:
     /// \param pageIndex Page index
     const PDFTextLayout& getTextLayout(PDFInteger pageIndex);
 
+    /// Returns count of requests, for which cached layout was returned
+    quint64 getHitCount() const { return m_hitCount; }
+
+    /// Returns count of requests, for which layout must have been created
+    quint64 getMissCount() const { return m_missCount; }
+
 private:
     std::function<PDFTextLayout(PDFInteger)> m_textLayoutGetter;
     PDFInteger m_pageIndex;
     PDFTextLayout m_layout;
+    quint64 m_hitCount = 0;
+    quint64 m_missCount = 0;
 };
 
 class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutGetter
@@ -547,7 +560,8 @@ class PDF4QTLIBCORESHARED_EXPORT PDFTextLayoutStorage
 public:
     explicit inline PDFTextLayoutStorage() = default;
     explicit inline PDFTextLayoutStorage(PDFInteger pageCount) :
-        m_offsets(pageCount, 0)
+        m_offsets(pageCount, 0),
+        m_searchTexts(pageCount)
     {
 
     }
@@ -582,12 +596,105 @@ public:
     /// \param flowFlags Text flow flags
     PDFFindResults find(const QRegularExpression& expression, PDFTextFlow::FlowFlags flowFlags) const;
 
+    /// Callback, which receives sorted results of the processed batch of pages
+    using FindCallback = std::function<void(PDFFindResults)>;
+
+    /// Finds regular expression matches incrementally. Pages are processed in batches
+    /// in page order, pages of the batch are searched concurrently. When batch is
+    /// processed, its results are passed to the callback (in the calling thread),
+    /// so results are delivered in page order. Search can be cancelled
+    /// by operation control, cancellation is checked before each page.
+    /// \param expression Regular expression to be matched
+    /// \param flowFlags Text flow flags
+    /// \param callback Callback receiving results of each batch
+    /// \param operationControl Operation control (can be nullptr)
+    void find(const QRegularExpression& expression,
+              PDFTextFlow::FlowFlags flowFlags,
+              const FindCallback& callback,
+              const PDFOperationControl* operationControl) const;
+
     /// Returns number of pages
     size_t getCount() const { return m_offsets.size(); }
 
+    /// Returns memory consumption estimate of the storage in bytes
+    qint64 getMemoryConsumptionEstimate() const;
+
+    /// Builds trigram index of the search texts of the pages. Index is optional,
+    /// when it is built, find functions search only pages containing all
+    /// trigrams of the searched text (or literals required by the regular
+    /// expression). Index must be built after all text layouts are set.
+    void buildSearchIndex();
+
+    /// Returns true, if trigram index is built
+    bool hasSearchIndex() const { return m_isSearchIndexBuilt; }
+
+    /// Serializes the storage (including search index) to the byte array
+    QByteArray serialize() const;
+
+    /// Deserializes the storage from data created by \p serialize. If data
+    /// are invalid, then empty storage is returned.
+    /// \param data Serialized data
+    static PDFTextLayoutStorage deserialize(const QByteArray& data);
+
+    /// Returns literals, which must be present in each match of the regular
+    /// expression (whitespaces are never part of the literal). If no such
+    /// literals can be determined, empty list is returned.
+    /// \param expression Regular expression
+    static QStringList getRequiredLiterals(const QRegularExpression& expression);
+
+    /// Creates search text of the layout. Search text contains all characters
+    /// of the layout in reading order, except whitespaces and soft hyphens.
+    /// If some text flow of the layout contains a text, then search text
+    /// of the layout contains search text of that text.
+    /// \param layout Text layout
+    static QString createSearchText(const PDFTextLayout& layout);
+
+    /// Creates search text of the text (removes whitespaces and soft hyphens)
+    /// \param text Text
+    static QString createSearchText(const QString& text);
+
 private:
+    /// Returns true, if page can contain given search text. Pages, which
+    /// can't contain the text, are skipped without decompressing their layout.
+    /// \param pageIndex Page index
+    /// \param searchText Search text (see createSearchText)
+    /// \param caseSensitivity Case sensitivity
+    bool isSearchTextCandidate(size_t pageIndex, const QString& searchText, Qt::CaseSensitivity caseSensitivity) const;
+
+    /// Returns pages, which can contain match of the text containing all
+    /// given literals (literals must be search texts, see createSearchText).
+    /// \param literals Literals
+    /// \param caseSensitivity Case sensitivity
+    std::vector<size_t> getCandidatePages(const QStringList& literals, Qt::CaseSensitivity caseSensitivity) const;
+
+    /// Returns trigram key of the three characters starting at given position
+    /// \param text Text (case folded)
+    /// \param index Position of the first character
+    static quint64 getTrigram(const QString& text, qsizetype index);
+
+    /// Identifier and version of the serialized data format
+    static constexpr quint32 SERIALIZATION_MAGIC = 0x50445431; // "PDT1"
+    static constexpr quint32 SERIALIZATION_VERSION = 1;
+
+    /// Compression level of the stored text layouts. Layouts are compressed
+    /// in the page threads, when text layout of the whole document is created,
+    /// so default zlib level is used, because maximal level is several times
+    /// slower and the storage is only slightly smaller.
+    static constexpr int COMPRESSION_LEVEL = -1;
+
     std::vector<int> m_offsets;
     QByteArray m_textLayouts;
+
+    /// Uncompressed search texts of the pages (see createSearchText)
+    std::vector<QString> m_searchTexts;
+
+    /// Sorted trigrams of the case folded search texts
+    std::vector<quint64> m_trigrams;
+
+    /// Sorted indices of pages containing the trigram (for each trigram)
+    std::vector<std::vector<quint32>> m_trigramPages;
+
+    bool m_isSearchIndexBuilt = false;
 };
 
 }   // namespace pdf
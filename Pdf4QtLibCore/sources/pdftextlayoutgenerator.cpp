@@ -16,6 +16,7 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdftextlayoutgenerator.h"
+#include "pdftrace.h"
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -23,7 +24,14 @@ namespace pdf
 
 PDFTextLayout PDFTextLayoutGenerator::createTextLayout()
 {
-    m_textLayout.perform();
+    PDF_TRACE_SPAN("text", "Create text layout");
+    if (isProcessingCancelled())
+    {
+        // Page contents were not processed completely
+        return PDFTextLayout();
+    }
+
+    m_textLayout.perform(getOperationControl());
     m_textLayout.optimize();
     return qMove(m_textLayout);
 }
@@ -65,7 +73,14 @@ void PDFTextLayoutGenerator::performOutputCharacter(const PDFTextCharacterInfo&
 {
     if (!isContentSuppressed() && !info.character.isSpace())
     {
-        m_textLayout.addCharacter(info);
+        if (m_isRawTextOnly)
+        {
+            m_rawText.push_back(info.character);
+        }
+        else
+        {
+            m_textLayout.addCharacter(info);
+        }
     }
 }
 
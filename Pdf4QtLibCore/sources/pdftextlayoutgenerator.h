@@ -42,6 +42,18 @@ public:
     /// Creates text layout from the text
     PDFTextLayout createTextLayout();
 
+    /// Sets, if only raw text should be collected. In this mode, characters
+    /// are not stored in the text layout, so text layout is empty, only
+    /// raw text (see \p getRawText) is available.
+    /// \param rawTextOnly Collect raw text only
+    void setRawTextOnly(bool rawTextOnly) { m_isRawTextOnly = rawTextOnly; }
+
+    /// Returns raw text of the page, i.e. non-whitespace characters in content
+    /// stream order. Raw text is collected only in raw text mode. Text layout
+    /// analysis is not performed, so order of the characters can differ
+    /// from the reading order.
+    const QString& getRawText() const { return m_rawText; }
+
 protected:
     virtual bool isContentSuppressedByOC(PDFObjectReference ocgOrOcmd) override;
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
@@ -50,6 +62,8 @@ protected:
 private:
     PDFRenderer::Features m_features;
     PDFTextLayout m_textLayout;
+    QString m_rawText;
+    bool m_isRawTextOnly = false;
 };
 
 }   // namespace pdf
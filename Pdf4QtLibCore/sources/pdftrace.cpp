@@ -0,0 +1,183 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftrace.h"
+#include "pdfconstants.h"
+
+#include <QFile>
+#include <QCoreApplication>
+
+#include <set>
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+std::atomic_bool PDFTracer::s_enabled = false;
+
+PDFTracer* PDFTracer::getInstance()
+{
+    static PDFTracer tracer;
+    return &tracer;
+}
+
+void PDFTracer::start()
+{
+    QMutexLocker lock(&m_mutex);
+    m_events.clear();
+    m_droppedEventCount = 0;
+    m_timer.start();
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+void PDFTracer::stop()
+{
+    s_enabled.store(false, std::memory_order_relaxed);
+}
+
+void PDFTracer::addEvent(const Event& event)
+{
+    Event threadEvent = event;
+    threadEvent.threadIndex = getCurrentThreadIndex();
+
+    QMutexLocker lock(&m_mutex);
+    if (m_events.size() < MAX_EVENT_COUNT)
+    {
+        m_events.push_back(threadEvent);
+    }
+    else
+    {
+        ++m_droppedEventCount;
+    }
+}
+
+std::vector<PDFTracer::Event> PDFTracer::getEvents() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_events;
+}
+
+size_t PDFTracer::getDroppedEventCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_droppedEventCount;
+}
+
+QByteArray PDFTracer::toChromeTraceJson() const
+{
+    std::vector<Event> events = getEvents();
+    std::stable_sort(events.begin(), events.end(), [](const Event& l, const Event& r) { return l.start < r.start; });
+
+    // Times in the Chrome trace format are in microseconds
+    auto toMicroseconds = [](qint64 nsec) { return QByteArray::number(double(nsec) / 1000.0, 'f', 3); };
+
+    QByteArray json;
+    json.reserve(int(events.size()) * 100 + 512);
+    json.append("{\"traceEvents\":[\n");
+
+    // Name threads, so they are easy to identify in the viewer
+    std::set<int> threadIndices;
+    for (const Event& event : events)
+    {
+        threadIndices.insert(event.threadIndex);
+    }
+
+    bool isFirst = true;
+    for (int threadIndex : threadIndices)
+    {
+        if (!isFirst)
+        {
+            json.append(",\n");
+        }
+        isFirst = false;
+
+        json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+        json.append(QByteArray::number(threadIndex));
+        json.append(",\"args\":{\"name\":\"Thread ");
+        json.append(QByteArray::number(threadIndex));
+        json.append("\"}}");
+    }
+
+    for (const Event& event : events)
+    {
+        if (!isFirst)
+        {
+            json.append(",\n");
+        }
+        isFirst = false;
+
+        json.append("{\"name\":\"");
+        json.append(event.name);
+        json.append("\",\"cat\":\"");
+        json.append(event.category);
+        json.append("\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+        json.append(QByteArray::number(event.threadIndex));
+        json.append(",\"ts\":");
+        json.append(toMicroseconds(event.start));
+        json.append(",\"dur\":");
+        json.append(toMicroseconds(event.duration));
+
+        if (event.argumentName)
+        {
+            json.append(",\"args\":{\"");
+            json.append(event.argumentName);
+            json.append("\":");
+            json.append(QByteArray::number(event.argument));
+            json.append("}");
+        }
+
+        json.append("}");
+    }
+
+    json.append("\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"generator\":\"");
+    json.append(QCoreApplication::applicationName().toUtf8());
+    json.append(" ");
+    json.append(PDF_LIBRARY_VERSION);
+    json.append("\",\"droppedEvents\":");
+    json.append(QByteArray::number(qulonglong(getDroppedEventCount())));
+    json.append("}}\n");
+    return json;
+}
+
+PDFOperationResult PDFTracer::writeChromeTrace(const QString& fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return PDFTranslationContext::tr("Can't open file '%1' for writing.").arg(fileName);
+    }
+
+    const QByteArray json = toChromeTraceJson();
+    if (file.write(json) != json.size())
+    {
+        return PDFTranslationContext::tr("Can't write trace to the file '%1'.").arg(fileName);
+    }
+
+    file.close();
+    return true;
+}
+
+int PDFTracer::getCurrentThreadIndex()
+{
+    static std::atomic_int s_threadCount = 0;
+    thread_local int t_threadIndex = ++s_threadCount;
+    return t_threadIndex;
+}
+
+}   // namespace pdf
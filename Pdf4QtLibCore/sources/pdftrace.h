@@ -0,0 +1,145 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFTRACE_H
+#define PDFTRACE_H
+
+#include "pdfglobal.h"
+#include "pdfutils.h"
+
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <vector>
+
+namespace pdf
+{
+
+/// Collects trace spans (named time intervals measured on some thread), which
+/// can be exported in Chrome trace event format (it can be also opened
+/// in Perfetto UI). Tracing is disabled by default, in this case, trace
+/// span costs only one relaxed atomic load. Tracer is thread safe.
+class PDF4QTLIBCORESHARED_EXPORT PDFTracer
+{
+public:
+    /// Trace span. Category, name and argument name must be string
+    /// literals (or other strings with static storage duration).
+    struct Event
+    {
+        const char* category = nullptr;
+        const char* name = nullptr;
+        const char* argumentName = nullptr;
+        PDFInteger argument = 0;
+        qint64 start = 0;       ///< Start time since tracing was started [nsec]
+        qint64 duration = 0;    ///< Duration [nsec]
+        int threadIndex = 0;
+    };
+
+    /// Returns global tracer instance
+    static PDFTracer* getInstance();
+
+    /// Returns true, if tracing is enabled
+    static inline bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /// Clears all recorded events and starts tracing
+    void start();
+
+    /// Stops tracing, recorded events are kept
+    void stop();
+
+    /// Returns time since tracing was started [nsec]
+    qint64 getTimestamp() const { return m_timer.nsecsElapsed(); }
+
+    /// Adds event. If maximal count of events is reached, event is dropped.
+    void addEvent(const Event& event);
+
+    /// Returns recorded events
+    std::vector<Event> getEvents() const;
+
+    /// Returns count of events, which were dropped due to the event limit
+    size_t getDroppedEventCount() const;
+
+    /// Returns recorded events in Chrome trace event JSON format
+    QByteArray toChromeTraceJson() const;
+
+    /// Writes recorded events in Chrome trace event JSON format to the file
+    PDFOperationResult writeChromeTrace(const QString& fileName) const;
+
+    /// Returns index of the current thread (threads are numbered
+    /// in order, in which they are using the tracer)
+    static int getCurrentThreadIndex();
+
+private:
+    explicit PDFTracer() = default;
+
+    /// Maximal count of recorded events (to limit memory consumption)
+    static constexpr size_t MAX_EVENT_COUNT = 2000000;
+
+    static std::atomic_bool s_enabled;
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_timer;
+    std::vector<Event> m_events;
+    size_t m_droppedEventCount = 0;
+};
+
+/// Scoped trace span, measures time from its construction to its destruction.
+/// Use macros \p PDF_TRACE_SPAN and \p PDF_TRACE_SPAN_ARG.
+class PDFTraceSpan
+{
+public:
+    inline explicit PDFTraceSpan(const char* category, const char* name, const char* argumentName = nullptr, PDFInteger argument = 0)
+    {
+        if (PDFTracer::isEnabled())
+        {
+            m_event.category = category;
+            m_event.name = name;
+            m_event.argumentName = argumentName;
+            m_event.argument = argument;
+            m_event.start = PDFTracer::getInstance()->getTimestamp();
+        }
+    }
+
+    inline ~PDFTraceSpan()
+    {
+        if (m_event.name)
+        {
+            PDFTracer* tracer = PDFTracer::getInstance();
+            m_event.duration = tracer->getTimestamp() - m_event.start;
+            tracer->addEvent(m_event);
+        }
+    }
+
+private:
+    Q_DISABLE_COPY_MOVE(PDFTraceSpan)
+
+    PDFTracer::Event m_event;
+};
+
+#define PDF_TRACE_SPAN_CONCAT_IMPL(a, b) a##b
+#define PDF_TRACE_SPAN_CONCAT(a, b) PDF_TRACE_SPAN_CONCAT_IMPL(a, b)
+
+/// Traces current scope. Category and name must be string literals.
+#define PDF_TRACE_SPAN(category, name) pdf::PDFTraceSpan PDF_TRACE_SPAN_CONCAT(pdfTraceSpan, __LINE__)(category, name)
+
+/// Traces current scope with integer argument (for example, page index)
+#define PDF_TRACE_SPAN_ARG(category, name, argumentName, argument) pdf::PDFTraceSpan PDF_TRACE_SPAN_CONCAT(pdfTraceSpan, __LINE__)(category, name, argumentName, argument)
+
+}   // namespace pdf
+
+#endif // PDFTRACE_H
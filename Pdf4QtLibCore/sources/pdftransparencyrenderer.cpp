@@ -25,6 +25,7 @@
 
 #include <QtMath>
 #include <iterator>
+#include <algorithm>
 
 namespace pdf
 {
@@ -225,6 +226,58 @@ QImage PDFFloatBitmap::getChannelImage(uint8_t channelIndex) const
     return image;
 }
 
+std::vector<QImage> PDFFloatBitmap::getSeparationImages() const
+{
+    std::vector<QImage> images;
+
+    const uint8_t colorChannelIndexStart = m_format.getColorChannelIndexStart();
+    const uint8_t colorChannelIndexEnd = m_format.getColorChannelIndexEnd();
+
+    if (colorChannelIndexStart == PDFPixelFormat::INVALID_CHANNEL_INDEX)
+    {
+        return images;
+    }
+
+    images.reserve(colorChannelIndexEnd - colorChannelIndexStart);
+    for (uint8_t i = colorChannelIndexStart; i < colorChannelIndexEnd; ++i)
+    {
+        images.emplace_back(int(getWidth()), int(getHeight()), QImage::Format_Grayscale8);
+    }
+
+    // Jakub Melka: we must detach images before we write them in parallel,
+    // scanLine function of non-const image would detach it otherwise.
+    std::vector<uchar*> imageData;
+    imageData.reserve(images.size());
+    for (QImage& image : images)
+    {
+        imageData.push_back(image.bits());
+    }
+
+    auto processRow = [&](int y)
+    {
+        std::vector<uchar*> lines;
+        lines.reserve(images.size());
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            lines.push_back(imageData[i] + y * images[i].bytesPerLine());
+        }
+
+        for (size_t x = 0; x < getWidth(); ++x)
+        {
+            PDFConstColorBuffer buffer = getPixel(x, y);
+            for (size_t i = 0; i < lines.size(); ++i)
+            {
+                lines[i][x] = static_cast<uchar>(255 - qRound(qBound(0.0f, buffer[colorChannelIndexStart + i], 1.0f) * 255));
+            }
+        }
+    };
+
+    PDFIntegerRange<int> range(0, int(getHeight()));
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Unknown, range.begin(), range.end(), processRow);
+
+    return images;
+}
+
 PDFFloatBitmap PDFFloatBitmap::extractProcessColors() const
 {
     PDFPixelFormat format = PDFPixelFormat::createFormat(m_format.getProcessColorChannelCount(), 0, false, m_format.hasProcessColorsSubtractive(), false);
@@ -399,6 +452,58 @@ void PDFFloatBitmap::copyChannel(const PDFFloatBitmap& sourceBitmap, uint8_t cha
     }
 }
 
+void PDFFloatBitmap::copyBitmap(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y)
+{
+    Q_ASSERT(getPixelFormat() == sourceBitmap.getPixelFormat());
+    Q_ASSERT(x + sourceBitmap.getWidth() <= getWidth());
+    Q_ASSERT(y + sourceBitmap.getHeight() <= getHeight());
+
+    const size_t rowLength = sourceBitmap.getWidth() * m_pixelSize;
+    for (size_t row = 0; row < sourceBitmap.getHeight(); ++row)
+    {
+        auto sourceIt = std::next(sourceBitmap.m_data.cbegin(), sourceBitmap.getPixelIndex(0, row));
+        auto targetIt = std::next(m_data.begin(), getPixelIndex(x, y + row));
+        std::copy(sourceIt, std::next(sourceIt, rowLength), targetIt);
+
+        if (hasActiveColorMask() && sourceBitmap.hasActiveColorMask())
+        {
+            auto sourceMaskIt = std::next(sourceBitmap.m_activeColorMask.cbegin(), row * sourceBitmap.getWidth());
+            auto targetMaskIt = std::next(m_activeColorMask.begin(), (y + row) * getWidth() + x);
+            std::copy(sourceMaskIt, std::next(sourceMaskIt, sourceBitmap.getWidth()), targetMaskIt);
+        }
+    }
+}
+
+void PDFFloatBitmap::extractPlanarRow(size_t x, size_t y, size_t count, PDFColorComponent* buffer) const
+{
+    Q_ASSERT(x + count <= getWidth());
+    Q_ASSERT(y < getHeight());
+
+    const PDFColorComponent* pixel = m_data.data() + getPixelIndex(x, y);
+    for (size_t i = 0; i < count; ++i, pixel += m_pixelSize)
+    {
+        for (size_t channel = 0; channel < m_pixelSize; ++channel)
+        {
+            buffer[channel * count + i] = pixel[channel];
+        }
+    }
+}
+
+void PDFFloatBitmap::storePlanarRow(size_t x, size_t y, size_t count, const PDFColorComponent* buffer)
+{
+    Q_ASSERT(x + count <= getWidth());
+    Q_ASSERT(y < getHeight());
+
+    PDFColorComponent* pixel = m_data.data() + getPixelIndex(x, y);
+    for (size_t i = 0; i < count; ++i, pixel += m_pixelSize)
+    {
+        for (size_t channel = 0; channel < m_pixelSize; ++channel)
+        {
+            pixel[channel] = buffer[channel * count + i];
+        }
+    }
+}
+
 PDFFloatBitmap PDFFloatBitmap::resize(size_t width, size_t height, Qt::TransformationMode mode) const
 {
     if (width == 0 || height == 0)
@@ -530,6 +635,13 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
     Q_ASSERT(static_cast<std::size_t>( blendRegion.right() ) < source.getWidth());
     Q_ASSERT(static_cast< std::size_t >( blendRegion.bottom() ) < source.getHeight());
 
+    if (overprintMode == OverprintMode::NoOveprint && PDFBlendModeInfo::isSeparable(mode))
+    {
+        // Blend mode is the same for all pixels, so we can blend whole rows at once
+        blendSeparable(source, target, backdrop, initialBackdrop, blendSoftMask, alphaIsShape, constantAlpha, mode, knockoutGroup, blendRegion);
+        return;
+    }
+
     const PDFPixelFormat pixelFormat = source.getPixelFormat();
     const uint8_t shapeChannel = pixelFormat.getShapeChannelIndex();
     const uint8_t opacityChannel = pixelFormat.getOpacityChannelIndex();
@@ -629,9 +741,9 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
         return channelBlendModes[channel];
     };
 
-    for (int x = blendRegion.left(); x <= blendRegion.right(); ++x)
+    for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
     {
-        for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
+        for (int x = blendRegion.left(); x <= blendRegion.right(); ++x)
         {
             PDFConstColorBuffer sourceColor = source.getPixel(x, y);
             PDFColorBuffer targetColor = target.getPixel(x, y);
@@ -835,6 +947,138 @@ void PDFFloatBitmap::blend(const PDFFloatBitmap& source,
     }
 }
 
+void PDFFloatBitmap::blendSeparable(const PDFFloatBitmap& source,
+                                    PDFFloatBitmap& target,
+                                    const PDFFloatBitmap& backdrop,
+                                    const PDFFloatBitmap& initialBackdrop,
+                                    const PDFFloatBitmap& blendSoftMask,
+                                    bool alphaIsShape,
+                                    PDFColorComponent constantAlpha,
+                                    BlendMode mode,
+                                    bool knockoutGroup,
+                                    QRect blendRegion)
+{
+    const PDFPixelFormat pixelFormat = source.getPixelFormat();
+    const size_t pixelSize = source.getPixelSize();
+    const uint8_t shapeChannel = pixelFormat.getShapeChannelIndex();
+    const uint8_t opacityChannel = pixelFormat.getOpacityChannelIndex();
+    const uint8_t processColorChannelStart = pixelFormat.getProcessColorChannelIndexStart();
+    const uint8_t processColorChannelEnd = pixelFormat.getProcessColorChannelIndexEnd();
+    const uint8_t spotColorChannelStart = pixelFormat.getSpotColorChannelIndexStart();
+    const uint8_t spotColorChannelEnd = pixelFormat.getSpotColorChannelIndexEnd();
+    const size_t x0 = blendRegion.left();
+    const size_t count = blendRegion.width();
+
+    // For blending spot colors, only white preserving blend modes are possible.
+    // If this is not the case, revert spot color blend mode to normal blending.
+    // See 11.7.4.2 of PDF 2.0 specification.
+    const BlendMode spotColorBlendMode = PDFBlendModeInfo::isWhitePreserving(mode) ? mode : BlendMode::Normal;
+
+    // Rows of bitmaps in planar layout
+    std::vector<PDFColorComponent> sourceRow(pixelSize * count, 0.0f);
+    std::vector<PDFColorComponent> targetRow(pixelSize * count, 0.0f);
+    std::vector<PDFColorComponent> backdropRow(pixelSize * count, 0.0f);
+    std::vector<PDFColorComponent> blendedRow(count, 0.0f);
+
+    // Compositing formula from 11.4.8 of PDF 2.0 specification is rewritten as weighted
+    // sum of immediate color (C_i_1), backdrop color (C_b), source color (C_s) and blended
+    // color (B). Weights depend only on shape and alpha, so they are same for all channels.
+    std::vector<PDFColorComponent> weights(4 * count, 0.0f);
+    const PDFColorComponent* weightArrays[4] = { weights.data(), weights.data() + count, weights.data() + 2 * count, weights.data() + 3 * count };
+    PDFColorComponent* w_C_i_1 = weights.data();
+    PDFColorComponent* w_C_b = w_C_i_1 + count;
+    PDFColorComponent* w_C_s = w_C_b + count;
+    PDFColorComponent* w_B = w_C_s + count;
+
+    for (int y = blendRegion.top(); y <= blendRegion.bottom(); ++y)
+    {
+        source.extractPlanarRow(x0, y, count, sourceRow.data());
+        target.extractPlanarRow(x0, y, count, targetRow.data());
+        backdrop.extractPlanarRow(x0, y, count, backdropRow.data());
+
+        const PDFColorComponent* sourceShape = sourceRow.data() + shapeChannel * count;
+        const PDFColorComponent* sourceOpacity = sourceRow.data() + opacityChannel * count;
+        PDFColorComponent* targetShape = targetRow.data() + shapeChannel * count;
+        PDFColorComponent* targetOpacity = targetRow.data() + opacityChannel * count;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t x = x0 + i;
+
+            const PDFColorComponent softMaskValue = blendSoftMask.getPixel(x, y)[0];
+            const PDFColorComponent f_j_i = sourceShape[i];
+            const PDFColorComponent f_m_i = alphaIsShape ? softMaskValue : 1.0f;
+            const PDFColorComponent f_k_i = alphaIsShape ? constantAlpha : 1.0f;
+            const PDFColorComponent q_m_i = !alphaIsShape ? softMaskValue : 1.0f;
+            const PDFColorComponent q_k_i = !alphaIsShape ? constantAlpha : 1.0f;
+            const PDFColorComponent f_s_i = f_j_i * f_m_i * f_k_i;
+            const PDFColorComponent alpha_j_i = sourceOpacity[i];
+            const PDFColorComponent alpha_s_i = alpha_j_i * (f_m_i * q_m_i) * (f_k_i * q_k_i);
+
+            const PDFColorComponent alpha_g_i_1 = targetOpacity[i];
+            const PDFColorComponent alpha_g_b = knockoutGroup ? 0.0f : alpha_g_i_1;
+            const PDFColorComponent alpha_0 = initialBackdrop.getPixel(x, y)[opacityChannel];
+            const PDFColorComponent f_g_i_1 = targetShape[i];
+
+            const PDFColorComponent f_g_i = PDFBlendFunction::blend_Union(f_g_i_1, f_s_i);
+            const PDFColorComponent alpha_g_i = (1.0f - f_s_i) * alpha_g_i_1 + (f_s_i - alpha_s_i) * alpha_g_b + alpha_s_i;
+            const PDFColorComponent alpha_i_1 = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i_1);
+            const PDFColorComponent alpha_i = PDFBlendFunction::blend_Union(alpha_0, alpha_g_i);
+            const PDFColorComponent alpha_b = knockoutGroup ? alpha_0 : alpha_i_1;
+
+            targetShape[i] = f_g_i;
+            targetOpacity[i] = alpha_g_i;
+
+            if (qFuzzyIsNull(alpha_g_i))
+            {
+                // If alpha_i is zero, then color is undefined, keep the immediate color
+                w_C_i_1[i] = 1.0f;
+                w_C_b[i] = 0.0f;
+                w_C_s[i] = 0.0f;
+                w_B[i] = 0.0f;
+                continue;
+            }
+
+            if (target.hasActiveColorMask())
+            {
+                const uint32_t activeColorChannels = source.hasActiveColorMask() ? source.getPixelActiveColorMask(x, y) : PDFPixelFormat::getAllColorsMask();
+                target.markPixelActiveColorMask(x, y, activeColorChannels);
+            }
+
+            const PDFColorComponent alpha_i_inverted = 1.0f / alpha_i;
+            w_C_i_1[i] = (1.0f - f_s_i) * alpha_i_1 * alpha_i_inverted;
+            w_C_b[i] = (f_s_i - alpha_s_i) * alpha_b * alpha_i_inverted;
+            w_C_s[i] = alpha_s_i * (1.0f - alpha_b) * alpha_i_inverted;
+            w_B[i] = alpha_s_i * alpha_b * alpha_i_inverted;
+        }
+
+        auto blendChannels = [&](uint8_t channelStart, uint8_t channelEnd, BlendMode channelBlendMode, bool subtractive)
+        {
+            for (uint8_t channel = channelStart; channel < channelEnd; ++channel)
+            {
+                const PDFColorComponent* C_s = sourceRow.data() + channel * count;
+                const PDFColorComponent* C_b = backdropRow.data() + channel * count;
+                PDFColorComponent* C_i = targetRow.data() + channel * count;
+
+                PDFBlendFunction::blend(channelBlendMode, C_b, C_s, blendedRow.data(), count, subtractive);
+                PDFBlendFunction::composite(C_i, C_b, C_s, blendedRow.data(), weightArrays, C_i, count);
+            }
+        };
+
+        if (pixelFormat.hasProcessColors())
+        {
+            blendChannels(processColorChannelStart, processColorChannelEnd, mode, pixelFormat.hasProcessColorsSubtractive());
+        }
+
+        if (pixelFormat.hasSpotColors())
+        {
+            blendChannels(spotColorChannelStart, spotColorChannelEnd, spotColorBlendMode, pixelFormat.hasSpotColorsSubtractive());
+        }
+
+        target.storePlanarRow(x0, y, count, targetRow.data());
+    }
+}
+
 void PDFFloatBitmap::blendConvertedSpots(const PDFFloatBitmap& convertedSpotColors)
 {
     Q_ASSERT(convertedSpotColors.getPixelFormat().getProcessColorChannelCount() == m_format.getProcessColorChannelCount());
@@ -980,6 +1224,98 @@ void PDFFloatBitmapWithColorSpace::convertToColorSpace(const PDFCMS* cms,
     *this = qMove(temporary);
 }
 
+PDFUnorm16Bitmap::PDFUnorm16Bitmap() :
+    m_width(0),
+    m_height(0),
+    m_pixelSize(0)
+{
+
+}
+
+PDFUnorm16Bitmap::PDFUnorm16Bitmap(size_t width, size_t height, PDFPixelFormat format, PDFColorSpacePointer colorSpace) :
+    m_format(format),
+    m_width(width),
+    m_height(height),
+    m_pixelSize(format.getChannelCount()),
+    m_colorSpace(qMove(colorSpace))
+{
+    Q_ASSERT(format.isValid());
+
+    m_data.resize(format.calculateBitmapDataLength(width, height), 0);
+
+    if (m_format.hasActiveColorMask())
+    {
+        m_activeColorMask.resize(width * height, 0);
+    }
+}
+
+void PDFUnorm16Bitmap::getPixel(size_t x, size_t y, PDFColorBuffer buffer) const
+{
+    Q_ASSERT(x < m_width);
+    Q_ASSERT(y < m_height);
+    Q_ASSERT(buffer.size() == m_pixelSize);
+
+    const uint16_t* pixel = m_data.data() + (y * m_width + x) * m_pixelSize;
+    for (size_t i = 0; i < m_pixelSize; ++i)
+    {
+        buffer[i] = decode(pixel[i]);
+    }
+}
+
+void PDFUnorm16Bitmap::copyBitmap(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y)
+{
+    Q_ASSERT(getPixelFormat() == sourceBitmap.getPixelFormat());
+    Q_ASSERT(x + sourceBitmap.getWidth() <= getWidth());
+    Q_ASSERT(y + sourceBitmap.getHeight() <= getHeight());
+
+    const size_t rowLength = sourceBitmap.getWidth() * m_pixelSize;
+    for (size_t row = 0; row < sourceBitmap.getHeight(); ++row)
+    {
+        const PDFColorComponent* sourceData = sourceBitmap.begin() + sourceBitmap.getPixelIndex(0, row);
+        uint16_t* targetData = m_data.data() + ((y + row) * m_width + x) * m_pixelSize;
+        std::transform(sourceData, sourceData + rowLength, targetData, &PDFUnorm16Bitmap::encode);
+
+        if (!m_activeColorMask.empty() && sourceBitmap.hasActiveColorMask())
+        {
+            for (size_t column = 0; column < sourceBitmap.getWidth(); ++column)
+            {
+                m_activeColorMask[(y + row) * m_width + x + column] = sourceBitmap.getPixelActiveColorMask(column, row);
+            }
+        }
+    }
+}
+
+PDFFloatBitmapWithColorSpace PDFUnorm16Bitmap::toFloatBitmap(QRect rect) const
+{
+    if (!m_format.isValid() || rect.isEmpty())
+    {
+        return PDFFloatBitmapWithColorSpace();
+    }
+
+    Q_ASSERT(rect.left() >= 0 && rect.top() >= 0);
+    Q_ASSERT(size_t(rect.right()) < m_width && size_t(rect.bottom()) < m_height);
+
+    PDFFloatBitmapWithColorSpace bitmap(rect.width(), rect.height(), m_format, m_colorSpace);
+    const size_t rowLength = rect.width() * m_pixelSize;
+    for (int row = 0; row < rect.height(); ++row)
+    {
+        const size_t y = rect.top() + row;
+        const uint16_t* sourceData = m_data.data() + (y * m_width + rect.left()) * m_pixelSize;
+        PDFColorComponent* targetData = bitmap.begin() + bitmap.getPixelIndex(0, row);
+        std::transform(sourceData, sourceData + rowLength, targetData, &PDFUnorm16Bitmap::decode);
+
+        if (!m_activeColorMask.empty())
+        {
+            for (int column = 0; column < rect.width(); ++column)
+            {
+                bitmap.setPixelActiveColorMask(column, row, m_activeColorMask[y * m_width + rect.left() + column]);
+            }
+        }
+    }
+
+    return bitmap;
+}
+
 PDFTransparencyRenderer::PDFTransparencyRenderer(const PDFPage* page,
                                                  const PDFDocument* document,
                                                  const PDFFontCache* fontCache,
@@ -1026,6 +1362,7 @@ void PDFTransparencyRenderer::beginPaint(QSize pixelSize)
 
     m_originalProcessBitmap = PDFFloatBitmapWithColorSpace();
     m_transparencyGroupDataStack.clear();
+    m_softMaskCache.clear();
     m_painterStateStack.push(PDFTransparencyPainterState());
 
     // Initialize initial opaque soft mask
@@ -1083,7 +1420,7 @@ const PDFFloatBitmap& PDFTransparencyRenderer::endPaint()
     return *getImmediateBackdrop();
 }
 
-QImage PDFTransparencyRenderer::toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit) const
+QImage PDFTransparencyRenderer::toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit)
 {
     QImage image;
 
@@ -1152,13 +1489,21 @@ QImage PDFTransparencyRenderer::toImageImpl(const PDFFloatBitmapWithColorSpace&
 }
 
 QImage PDFTransparencyRenderer::toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const
+{
+    if (m_transparencyGroupDataStack.size() == 1) // We have finished the painting
+    {
+        return createImage(*getImmediateBackdrop(), use16Bit, usePaper, paperColor);
+    }
+
+    return QImage();
+}
+
+QImage PDFTransparencyRenderer::createImage(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit, bool usePaper, const PDFRGB& paperColor)
 {
     QImage image;
 
-    if (m_transparencyGroupDataStack.size() == 1 && // We have finished the painting
-        getImmediateBackdrop()->getPixelFormat().getProcessColorChannelCount() == 3) // We have exactly three process colors (RGB)
+    if (floatImage.getPixelFormat().getProcessColorChannelCount() == 3) // We have exactly three process colors (RGB)
     {
-        const PDFFloatBitmapWithColorSpace& floatImage = *getImmediateBackdrop();
         Q_ASSERT(floatImage.getPixelFormat().hasOpacityChannel());
 
         if (!usePaper)
@@ -2000,6 +2345,21 @@ void PDFTransparencyRenderer::processSoftMask(const PDFDictionary* softMask)
     }
     else
     {
+        // Soft mask can be applied to many objects (each object sets the same
+        // graphic state), so try to find already rendered soft mask first.
+        PDFSoftMaskCacheKey cacheKey;
+        cacheKey.softMask = softMask;
+        cacheKey.matrix = getGraphicState()->getCurrentTransformationMatrix();
+        cacheKey.size = QSize(int(m_drawBuffer.getWidth()), int(m_drawBuffer.getHeight()));
+
+        auto it = std::find_if(m_softMaskCache.begin(), m_softMaskCache.end(), [&cacheKey](const auto& item) { return item.first == cacheKey; });
+        if (it != m_softMaskCache.end())
+        {
+            std::rotate(m_softMaskCache.begin(), it, std::next(it));
+            getPainterState()->softMask = m_softMaskCache.front().second;
+            return;
+        }
+
         PDFSoftMaskDefinition softMaskDefinition = PDFSoftMaskDefinition::parse(softMask, this);
 
         if (!softMaskDefinition.getFormStream())
@@ -2082,6 +2442,12 @@ void PDFTransparencyRenderer::processSoftMask(const PDFDictionary* softMask)
         }
 
         getPainterState()->softMask = PDFTransparencySoftMask(false, qMove(createdSoftMask));
+
+        if (m_softMaskCache.size() == SOFT_MASK_CACHE_SIZE)
+        {
+            m_softMaskCache.pop_back();
+        }
+        m_softMaskCache.emplace(m_softMaskCache.begin(), cacheKey, getPainterState()->softMask);
     }
 }
 
@@ -2519,10 +2885,8 @@ void PDFTransparencyRenderer::performBeginTransparencyGroup(ProcessOrder order,
         // in the immediate backdrop, so we will make it transparent.
         data.makeImmediateBackdropTransparent();
 
-        // Create draw buffer
-        m_drawBuffer = PDFDrawBuffer(data.immediateBackdrop.getWidth(), data.immediateBackdrop.getHeight(), data.immediateBackdrop.getPixelFormat());
-
         m_transparencyGroupDataStack.emplace_back(qMove(data));
+        prepareDrawBuffer();
         invalidateCachedItems();
     }
 }
@@ -2585,13 +2949,17 @@ void PDFTransparencyRenderer::performEndTransparencyGroup(ProcessOrder order, co
                                                                      : PDFFloatBitmap::OverprintMode::Overprint_Mode_1;
         }
 
-        PDFFloatBitmap::blend(sourceData.immediateBackdrop, targetData.immediateBackdrop, *getBackdrop(), *getInitialBackdrop(), *sourceData.softMask.getSoftMask(),
-                              sourceData.alphaIsShape, sourceData.alphaFill, sourceData.blendMode, sourceData.group.knockout, selectedOverprintMode, getPaintRect());
-
-        // Create draw buffer
-        PDFFloatBitmapWithColorSpace* backdrop = getImmediateBackdrop();
-        m_drawBuffer = PDFDrawBuffer(backdrop->getWidth(), backdrop->getHeight(), backdrop->getPixelFormat());
+        // Pixels of the group outside of the painted area are transparent (both shape
+        // and opacity are zero), so blending them doesn't change the target.
+        const QRect blendRegion = sourceData.dirtyRect.intersected(getPaintRect());
+        if (blendRegion.isValid())
+        {
+            PDFFloatBitmap::blend(sourceData.immediateBackdrop, targetData.immediateBackdrop, *getBackdrop(), *getInitialBackdrop(), *sourceData.softMask.getSoftMask(),
+                                  sourceData.alphaIsShape, sourceData.alphaFill, sourceData.blendMode, sourceData.group.knockout, selectedOverprintMode, blendRegion);
+            targetData.dirtyRect = targetData.dirtyRect.united(blendRegion);
+        }
 
+        prepareDrawBuffer();
         invalidateCachedItems();
     }
 }
@@ -2787,9 +3155,16 @@ void PDFTransparencyRenderer::removeInitialBackdrop()
     Q_ASSERT(colorChannelIndexStart != PDFPixelFormat::INVALID_CHANNEL_INDEX);
     Q_ASSERT(colorChannelIndexEnd != PDFPixelFormat::INVALID_CHANNEL_INDEX);
 
-    for (size_t x = 0; x < immediateBackdrop->getWidth(); ++x)
+    // Only painted pixels have nonzero alpha_g_n
+    const QRect dirtyRect = m_transparencyGroupDataStack.back().dirtyRect;
+    if (!dirtyRect.isValid())
+    {
+        return;
+    }
+
+    for (int y = dirtyRect.top(); y <= dirtyRect.bottom(); ++y)
     {
-        for (size_t y = 0; y < immediateBackdrop->getHeight(); ++y)
+        for (int x = dirtyRect.left(); x <= dirtyRect.right(); ++x)
         {
             PDFColorBuffer initialBackdropColorBuffer = initialBackdrop->getPixel(x, y);
             PDFColorBuffer immediateBackdropColorBuffer = immediateBackdrop->getPixel(x, y);
@@ -3025,9 +3400,28 @@ void PDFTransparencyRenderer::flushDrawBuffer()
                               getGraphicState()->getAlphaIsShape(), 1.0f, getGraphicState()->getBlendMode(), isTransparencyGroupKnockout(),
                               selectedOverprintMode, m_drawBuffer.getModifiedRect());
 
+        PDFTransparencyGroupPainterData& groupData = m_transparencyGroupDataStack.back();
+        groupData.dirtyRect = groupData.dirtyRect.united(m_drawBuffer.getModifiedRect());
+
+        m_drawBuffer.clear();
+    }
+}
+
+void PDFTransparencyRenderer::prepareDrawBuffer()
+{
+    const PDFFloatBitmapWithColorSpace* backdrop = getImmediateBackdrop();
 
+    if (m_drawBuffer.getWidth() == backdrop->getWidth() &&
+        m_drawBuffer.getHeight() == backdrop->getHeight() &&
+        m_drawBuffer.getPixelFormat() == backdrop->getPixelFormat())
+    {
+        // Clears only the modified area, rest of the buffer is already empty
         m_drawBuffer.clear();
     }
+    else
+    {
+        m_drawBuffer = PDFDrawBuffer(backdrop->getWidth(), backdrop->getHeight(), backdrop->getPixelFormat());
+    }
 }
 
 bool PDFTransparencyRenderer::isMultithreadedPathSamplingUsed(QRect fillRect) const
@@ -3211,98 +3605,56 @@ void PDFInkMapper::createSpotColors(bool activate)
     PDFRenderErrorReporterDummy renderErrorReporter;
     PDFCMSPointer cms = m_cmsManager ? m_cmsManager->getCurrentCMS() : nullptr;
 
-    const PDFCatalog* catalog = m_document->getCatalog();
-    const size_t pageCount = catalog->getPageCount();
-    for (size_t i = 0; i < pageCount; ++i)
+    auto addSpotColor = [&, this](const QByteArray& colorName, const PDFColorSpacePointer& colorSpacePointer, uint32_t colorSpaceIndex)
     {
-        const PDFPage* page = catalog->getPage(i);
-        PDFObject resources = m_document->getObject(page->getResources());
-
-        if (resources.isDictionary() && resources.getDictionary()->hasKey("ColorSpace"))
+        if (!containsSpotColor(colorName) && !containsProcessColor(colorName))
         {
-            const PDFDictionary* colorSpaceDictionary = m_document->getDictionaryFromObject(resources.getDictionary()->get("ColorSpace"));
-            if (colorSpaceDictionary)
-            {
-                std::size_t colorSpaces = colorSpaceDictionary->getCount();
-                for (size_t csIndex = 0; csIndex < colorSpaces; ++ csIndex)
-                {
-                    PDFColorSpacePointer colorSpacePointer;
-                    try
-                    {
-                        colorSpacePointer = PDFAbstractColorSpace::createColorSpace(colorSpaceDictionary, m_document, m_document->getObject(colorSpaceDictionary->getValue(csIndex)));
-                    }
-                    catch (const PDFException&)
-                    {
-                        // Ignore invalid color spaces
-                        continue;
-                    }
-
-                    if (!colorSpacePointer)
-                    {
-                        continue;
-                    }
-
-                    switch (colorSpacePointer->getColorSpace())
-                    {
-                        case PDFAbstractColorSpace::ColorSpace::Separation:
-                        {
-                            const PDFSeparationColorSpace* separationColorSpace = dynamic_cast<const PDFSeparationColorSpace*>(colorSpacePointer.data());
-
-                            if (!separationColorSpace->isNone() && !separationColorSpace->isAll() && !separationColorSpace->getColorName().isEmpty())
-                            {
-                                // Try to add spot color
-                                const QByteArray& colorName = separationColorSpace->getColorName();
-                                if (!containsSpotColor(colorName) && !containsProcessColor(colorName))
-                                {
-                                    ColorInfo info;
-                                    info.name = colorName;
-                                    info.textName = PDFEncoding::convertTextString(info.name);
-                                    info.colorSpace = colorSpacePointer;
-                                    info.spotColorIndex = uint32_t(m_spotColors.size());
-                                    info.color = cms ? separationColorSpace->getColor(pdf::PDFColor(1.0f), cms.get(), pdf::RenderingIntent::Perceptual, &renderErrorReporter, true) : nullptr;
-                                    m_spotColors.emplace_back(qMove(info));
-                                }
-                            }
+            PDFColor color;
+            color.resize(colorSpacePointer->getColorComponentCount());
+            color[colorSpaceIndex] = 1.0f;
+
+            ColorInfo info;
+            info.name = colorName;
+            info.textName = PDFEncoding::convertTextString(info.name);
+            info.colorSpaceIndex = colorSpaceIndex;
+            info.colorSpace = colorSpacePointer;
+            info.spotColorIndex = uint32_t(m_spotColors.size());
+            info.color = cms ? colorSpacePointer->getColor(color, cms.get(), pdf::RenderingIntent::Perceptual, &renderErrorReporter, true) : nullptr;
+            m_spotColors.emplace_back(qMove(info));
+        }
+    };
 
-                            break;
-                        }
+    struct Colorant
+    {
+        QByteArray colorName;
+        PDFColorSpacePointer colorSpace;
+        uint32_t colorSpaceIndex = 0;
+    };
 
-                        case PDFAbstractColorSpace::ColorSpace::DeviceN:
-                        {
-                            const PDFDeviceNColorSpace* deviceNColorSpace = dynamic_cast<const PDFDeviceNColorSpace*>(colorSpacePointer.data());
+    // Jakub Melka: Color spaces of the pages are created in parallel, but spot
+    // colors are added in page order, so their order (and thus which spot colors
+    // can be active) doesn't depend on thread scheduling.
+    const PDFCatalog* catalog = m_document->getCatalog();
+    const size_t pageCount = catalog->getPageCount();
+    std::vector<std::vector<Colorant>> pageColorants(pageCount);
 
-                            if (!deviceNColorSpace->isNone())
-                            {
-                                const PDFDeviceNColorSpace::Colorants& colorants = deviceNColorSpace->getColorants();
-                                for (size_t ii = 0; ii < colorants.size(); ++ii)
-                                {
-                                    const PDFDeviceNColorSpace::ColorantInfo& colorantInfo = colorants[ii];
-                                    if (!containsSpotColor(colorantInfo.name) && !containsProcessColor(colorantInfo.name))
-                                    {
-                                        PDFColor color;
-                                        color.resize(deviceNColorSpace->getColorComponentCount());
-                                        color[ii] = 1.0f;
-
-                                        ColorInfo info;
-                                        info.name = colorantInfo.name;
-                                        info.textName = PDFEncoding::convertTextString(info.name);
-                                        info.colorSpaceIndex = uint32_t(ii);
-                                        info.colorSpace = colorSpacePointer;
-                                        info.spotColorIndex = uint32_t(m_spotColors.size());
-                                        info.color = cms ? deviceNColorSpace->getColor(color, cms.get(), pdf::RenderingIntent::Perceptual, &renderErrorReporter, true) : nullptr;
-                                        m_spotColors.emplace_back(qMove(info));
-                                    }
-                                }
-                            }
+    auto collectColorants = [&, this](size_t pageIndex)
+    {
+        std::vector<Colorant>& colorants = pageColorants[pageIndex];
+        forEachPageSpotColorant(catalog->getPage(pageIndex), [&colorants](const QByteArray& colorName, const PDFColorSpacePointer& colorSpace, uint32_t colorSpaceIndex)
+        {
+            colorants.push_back(Colorant{ colorName, colorSpace, colorSpaceIndex });
+        });
+    };
 
-                            break;
-                        }
+    auto pageRange = PDFIntegerRange<size_t>(0, pageCount);
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), collectColorants);
 
-                        default:
-                            break;
-                    }
-                }
-            }
+    for (const std::vector<Colorant>& colorants : pageColorants)
+    {
+        for (const Colorant& colorant : colorants)
+        {
+            addSpotColor(colorant.colorName, colorant.colorSpace, colorant.colorSpaceIndex);
         }
     }
 
@@ -3315,14 +3667,140 @@ void PDFInkMapper::createSpotColors(bool activate)
     setSpotColorsActive(activate);
 }
 
-bool PDFInkMapper::containsSpotColor(const QByteArray& colorName) const
+PDFInkMapper PDFInkMapper::createPageInkMapper(const PDFPage* page) const
 {
-    return getSpotColor(colorName) != nullptr;
-}
+    std::vector<QByteArray> usedColorNames;
+    forEachPageSpotColorant(page, [&usedColorNames](const QByteArray& colorName, const PDFColorSpacePointer&, uint32_t)
+    {
+        if (std::find(usedColorNames.cbegin(), usedColorNames.cend(), colorName) == usedColorNames.cend())
+        {
+            usedColorNames.push_back(colorName);
+        }
+    });
 
-bool PDFInkMapper::containsProcessColor(const QByteArray& colorName) const
-{
-    return getProcessColor(colorName) != nullptr;
+    // Spot colors are kept in the same order, as in this mapper, so spot
+    // colors, which can be active, still precede spot colors, which can't be.
+    PDFInkMapper pageInkMapper = *this;
+    pageInkMapper.m_spotColors.clear();
+    pageInkMapper.m_activeSpotColors = 0;
+
+    for (const ColorInfo& info : m_spotColors)
+    {
+        if (std::find(usedColorNames.cbegin(), usedColorNames.cend(), info.name) != usedColorNames.cend())
+        {
+            ColorInfo pageInfo = info;
+            pageInfo.spotColorIndex = uint32_t(pageInkMapper.m_spotColors.size());
+
+            if (pageInfo.active)
+            {
+                ++pageInkMapper.m_activeSpotColors;
+            }
+
+            pageInkMapper.m_spotColors.emplace_back(qMove(pageInfo));
+        }
+    }
+
+    return pageInkMapper;
+}
+
+uint32_t PDFInkMapper::mapActiveColorMask(const PDFInkMapper& documentInkMapper, uint32_t processColorCount, uint32_t activeColorMask) const
+{
+    // Process colors remain on the same channels, spot colors, which are
+    // not used on the page, don't have channels, so they are left active.
+    const uint32_t processColorMask = (static_cast<uint32_t>(1) << processColorCount) - 1;
+    uint32_t mappedActiveColorMask = (activeColorMask & (processColorMask | ~PDFPixelFormat::getAllColorsMask())) | (PDFPixelFormat::getAllColorsMask() & ~processColorMask);
+
+    for (const ColorInfo& info : m_spotColors)
+    {
+        const ColorInfo* documentInfo = documentInkMapper.getSpotColor(info.name);
+        if (documentInfo && documentInfo->active && info.active && !(activeColorMask & (static_cast<uint32_t>(1) << (processColorCount + documentInfo->spotColorIndex))))
+        {
+            mappedActiveColorMask &= ~(static_cast<uint32_t>(1) << (processColorCount + info.spotColorIndex));
+        }
+    }
+
+    return mappedActiveColorMask;
+}
+
+void PDFInkMapper::forEachPageSpotColorant(const PDFPage* page, const std::function<void(const QByteArray&, const PDFColorSpacePointer&, uint32_t)>& callback) const
+{
+    if (!page)
+    {
+        return;
+    }
+
+    PDFObject resources = m_document->getObject(page->getResources());
+
+    if (resources.isDictionary() && resources.getDictionary()->hasKey("ColorSpace"))
+    {
+        const PDFDictionary* colorSpaceDictionary = m_document->getDictionaryFromObject(resources.getDictionary()->get("ColorSpace"));
+        if (colorSpaceDictionary)
+        {
+            std::size_t colorSpaces = colorSpaceDictionary->getCount();
+            for (size_t csIndex = 0; csIndex < colorSpaces; ++ csIndex)
+            {
+                PDFColorSpacePointer colorSpacePointer;
+                try
+                {
+                    colorSpacePointer = PDFAbstractColorSpace::createColorSpace(colorSpaceDictionary, m_document, m_document->getObject(colorSpaceDictionary->getValue(csIndex)));
+                }
+                catch (const PDFException&)
+                {
+                    // Ignore invalid color spaces
+                    continue;
+                }
+
+                if (!colorSpacePointer)
+                {
+                    continue;
+                }
+
+                switch (colorSpacePointer->getColorSpace())
+                {
+                    case PDFAbstractColorSpace::ColorSpace::Separation:
+                    {
+                        const PDFSeparationColorSpace* separationColorSpace = dynamic_cast<const PDFSeparationColorSpace*>(colorSpacePointer.data());
+
+                        if (!separationColorSpace->isNone() && !separationColorSpace->isAll() && !separationColorSpace->getColorName().isEmpty())
+                        {
+                            callback(separationColorSpace->getColorName(), colorSpacePointer, 0);
+                        }
+
+                        break;
+                    }
+
+                    case PDFAbstractColorSpace::ColorSpace::DeviceN:
+                    {
+                        const PDFDeviceNColorSpace* deviceNColorSpace = dynamic_cast<const PDFDeviceNColorSpace*>(colorSpacePointer.data());
+
+                        if (!deviceNColorSpace->isNone())
+                        {
+                            const PDFDeviceNColorSpace::Colorants& colorants = deviceNColorSpace->getColorants();
+                            for (size_t ii = 0; ii < colorants.size(); ++ii)
+                            {
+                                callback(colorants[ii].name, colorSpacePointer, uint32_t(ii));
+                            }
+                        }
+
+                        break;
+                    }
+
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+}
+
+bool PDFInkMapper::containsSpotColor(const QByteArray& colorName) const
+{
+    return getSpotColor(colorName) != nullptr;
+}
+
+bool PDFInkMapper::containsProcessColor(const QByteArray& colorName) const
+{
+    return getProcessColor(colorName) != nullptr;
 }
 
 const PDFInkMapper::ColorInfo* PDFInkMapper::getSpotColor(const QByteArray& colorName) const
@@ -3518,8 +3996,7 @@ PDFPainterPathSampler::PDFPainterPathSampler(QPainterPath path, int samplesCount
 {
     if (!precise)
     {
-        m_fillPolygon = m_path.toFillPolygon();
-        prepareScanLines();
+        prepareCoverage();
     }
 }
 
@@ -3530,9 +4007,9 @@ PDFColorComponent PDFPainterPathSampler::sample(QPoint point) const
         return m_defaultShape;
     }
 
-    if (!m_scanLineInfo.empty())
+    if (!m_precise)
     {
-        return sampleByScanLine(point);
+        return sampleByCoverage(point);
     }
 
     const qreal coordX1 = point.x();
@@ -3551,33 +4028,14 @@ PDFColorComponent PDFPainterPathSampler::sample(QPoint point) const
     if (m_samplesCount <= 1)
     {
         // Jakub Melka: Just one sample
-        if (m_precise)
-        {
-            return m_path.contains(QPointF(centerX, centerY)) ? 1.0f : 0.0f;
-        }
-        else
-        {
-            return m_fillPolygon.contains(QPointF(centerX, centerY)) ? 1.0f : 0.0f;
-        }
+        return m_path.contains(QPointF(centerX, centerY)) ? 1.0f : 0.0f;
     }
 
     int cornerHits = 0;
-    Qt::FillRule fillRule = m_path.fillRule();
-
-    if (m_precise)
-    {
-        cornerHits += m_path.contains(topLeft) ? 1 : 0;
-        cornerHits += m_path.contains(topRight) ? 1 : 0;
-        cornerHits += m_path.contains(bottomLeft) ? 1 : 0;
-        cornerHits += m_path.contains(bottomRight) ? 1 : 0;
-    }
-    else
-    {
-        cornerHits += m_fillPolygon.containsPoint(topLeft, fillRule) ? 1 : 0;
-        cornerHits += m_fillPolygon.containsPoint(topRight, fillRule) ? 1 : 0;
-        cornerHits += m_fillPolygon.containsPoint(bottomLeft, fillRule) ? 1 : 0;
-        cornerHits += m_fillPolygon.containsPoint(bottomRight, fillRule) ? 1 : 0;
-    }
+    cornerHits += m_path.contains(topLeft) ? 1 : 0;
+    cornerHits += m_path.contains(topRight) ? 1 : 0;
+    cornerHits += m_path.contains(bottomLeft) ? 1 : 0;
+    cornerHits += m_path.contains(bottomRight) ? 1 : 0;
 
     if (cornerHits == 4)
     {
@@ -3603,19 +4061,9 @@ PDFColorComponent PDFPainterPathSampler::sample(QPoint point) const
         {
             const qreal y = offset * (iy + 1) + coordY1;
 
-            if (m_precise)
+            if (m_path.contains(QPointF(x, y)))
             {
-                if (m_path.contains(QPointF(x, y)))
-                {
-                    sampleValue += sampleGain;
-                }
-            }
-            else
-            {
-                if (m_fillPolygon.containsPoint(QPointF(x, y), fillRule))
-                {
-                    sampleValue += sampleGain;
-                }
+                sampleValue += sampleGain;
             }
         }
     }
@@ -3623,181 +4071,216 @@ PDFColorComponent PDFPainterPathSampler::sample(QPoint point) const
     return sampleValue;
 }
 
-PDFColorComponent PDFPainterPathSampler::sampleByScanLine(QPoint point) const
+PDFColorComponent PDFPainterPathSampler::sampleByCoverage(QPoint point) const
 {
-    int scanLinePosition = point.y() - m_fillRect.y();
-
-    size_t scanLineCountPerPixel = getScanLineCountPerPixel();
-    size_t scanLineTopRow = scanLinePosition * scanLineCountPerPixel;
-    size_t scanLineBottomRow = scanLineTopRow + scanLineCountPerPixel - 1;
-    size_t scanLineGridRowTop = scanLineTopRow + 1;
-
-    Qt::FillRule fillRule = m_path.fillRule();
-
-    auto performSampling = [&](size_t scanLineIndex, PDFReal firstOrdinate, int sampleCount, PDFReal step, PDFReal gain)
+    if (m_scanLineInfo.empty())
     {
-        ScanLineInfo info = m_scanLineInfo[scanLineIndex];
-        auto it = std::next(m_scanLineSamples.cbegin(), info.indexStart);
-
-        PDFReal ordinate = firstOrdinate;
-        PDFColorComponent value = 0.0;
-        auto ordinateIt = it;
-        for (int i = 0; i < sampleCount; ++i)
-        {
-            while (std::next(ordinateIt)->x < ordinate)
-            {
-                ++ordinateIt;
-            }
-
-            int windingNumber = ordinateIt->windingNumber;
+        return 0.0f;
+    }
 
-            const bool inside = (fillRule == Qt::WindingFill) ? windingNumber != 0 : windingNumber % 2 != 0;
-            if (inside)
-            {
-                value += gain;
-            }
+    const ScanLineInfo& info = m_scanLineInfo[point.y() - m_fillRect.top()];
+    const int x = point.x() - m_fillRect.left();
 
-            ordinate += step;
-        }
+    // Find last cell with x coordinate less or equal to pixel x coordinate,
+    // its accumulated value is the coverage of the pixel.
+    auto it = std::next(m_coverageCells.cbegin(), info.indexStart);
+    auto itEnd = std::next(m_coverageCells.cbegin(), info.indexEnd);
+    auto itCell = std::upper_bound(it, itEnd, x, [](int value, const CoverageCell& cell) { return value < cell.x; });
 
-        return value;
-    };
+    if (itCell == it)
+    {
+        return 0.0f;
+    }
 
-    const qreal coordX1 = point.x();
-    const PDFReal cornerValue = performSampling(scanLineTopRow, coordX1, 2, 1.0, 1.0) + performSampling(scanLineBottomRow, coordX1, 2, 1.0, 1.0);
+    const PDFReal accumulatedCoverage = qAbs(std::prev(itCell)->value);
+    PDFReal coverage = 0.0;
 
-    if (qFuzzyIsNull(4.0 - cornerValue))
+    if (m_path.fillRule() == Qt::WindingFill)
     {
-        // Whole inside
-        return 1.0;
+        coverage = qMin(accumulatedCoverage, 1.0);
     }
-
-    if (qFuzzyIsNull(cornerValue))
+    else
     {
-        // Whole outside
-        return 0.0;
+        coverage = std::fmod(accumulatedCoverage, 2.0);
+        if (coverage > 1.0)
+        {
+            coverage = 2.0 - coverage;
+        }
     }
 
-    const qreal offset = 1.0f / PDFColorComponent(m_samplesCount + 1);
-    PDFColorComponent sampleValue = 0.0f;
-    const PDFColorComponent sampleGain = 1.0f / PDFColorComponent(m_samplesCount * m_samplesCount);
-
-    for (int i = 0; i < m_samplesCount; ++i)
+    if (m_samplesCount <= 1)
     {
-        sampleValue += performSampling(scanLineGridRowTop++, coordX1 + offset, m_samplesCount, offset, sampleGain);
+        // Jakub Melka: Just one sample, antialiasing is turned off
+        return coverage >= 0.5 ? 1.0f : 0.0f;
     }
 
-    return sampleValue;
-}
-
-size_t PDFPainterPathSampler::getScanLineCountPerPixel() const
-{
-    return m_samplesCount + 2;
+    return coverage;
 }
 
-void PDFPainterPathSampler::prepareScanLines()
+void PDFPainterPathSampler::prepareCoverage()
 {
-    if (m_fillPolygon.isEmpty())
+    if (m_path.isEmpty() || !m_fillRect.isValid())
     {
         return;
     }
 
-    for (int yOffset = m_fillRect.top(); yOffset <= m_fillRect.bottom(); ++yOffset)
-    {
-        const qreal coordY1 = yOffset;
-        const qreal coordY2 = coordY1 + 1.0;
+    std::vector<CoverageCell> cells;
+    const QPointF offset = m_fillRect.topLeft();
 
-        // Top pixel line
-        if (m_scanLineInfo.empty())
+    // Each subpath is implicitly closed (we are filling the path)
+    const QList<QPolygonF> polygons = m_path.toSubpathPolygons();
+    for (const QPolygonF& polygon : polygons)
+    {
+        if (polygon.size() < 2)
         {
-            m_scanLineInfo.emplace_back(createScanLine(coordY1));
+            continue;
         }
-        else
+
+        for (int i = 1; i < polygon.size(); ++i)
         {
-            m_scanLineInfo.emplace_back(m_scanLineInfo.back());
+            accumulateLine(polygon[i - 1] - offset, polygon[i] - offset, cells);
         }
 
-        // Sample grid
-        const qreal offset = 1.0f / PDFColorComponent(m_samplesCount + 1);
-        for (int iy = 0; iy < m_samplesCount; ++iy)
+        if (polygon.front() != polygon.back())
         {
-            const qreal y = offset * (iy + 1) + coordY1;
-            m_scanLineInfo.emplace_back(createScanLine(y));
+            accumulateLine(polygon.back() - offset, polygon.front() - offset, cells);
         }
-
-        // Bottom pixel line
-        m_scanLineInfo.emplace_back(createScanLine(coordY2));
     }
-}
 
-PDFPainterPathSampler::ScanLineInfo PDFPainterPathSampler::createScanLine(qreal y)
-{
-    ScanLineInfo result;
-    result.indexStart = m_scanLineSamples.size();
-
-    // Add start item
-    m_scanLineSamples.emplace_back(-std::numeric_limits<PDFReal>::infinity(), 0);
+    std::sort(cells.begin(), cells.end());
 
-    // Traverse polygon, add sample for each polygon line, we must
-    // also implicitly close last edge (if polygon is not closed)
-    for (int i = 1; i < m_fillPolygon.size(); ++i)
-    {
-        createScanLineSample(m_fillPolygon[i - 1], m_fillPolygon[i], y);
-    }
+    // Merge cells with same coordinates and accumulate coverage in scanlines
+    m_scanLineInfo.resize(m_fillRect.height());
+    m_coverageCells.reserve(cells.size());
 
-    if (m_fillPolygon.front() != m_fillPolygon.back())
+    auto it = cells.cbegin();
+    auto itEnd = cells.cend();
+    for (int row = 0; row < m_fillRect.height(); ++row)
     {
-        createScanLineSample(m_fillPolygon.back(), m_fillPolygon.front(), y);
-    }
-
-    // Add end item
-    m_scanLineSamples.emplace_back(+std::numeric_limits<PDFReal>::infinity(), 0);
-
-    result.indexEnd = m_scanLineSamples.size();
+        ScanLineInfo& info = m_scanLineInfo[row];
+        info.indexStart = m_coverageCells.size();
 
-    auto it = std::next(m_scanLineSamples.begin(), result.indexStart);
-    auto itEnd = std::next(m_scanLineSamples.begin(), result.indexEnd);
+        PDFReal accumulatedCoverage = 0.0;
+        for (; it != itEnd && it->row == row; ++it)
+        {
+            accumulatedCoverage += it->value;
 
-    // Jakub Melka: now, sort the line samples and compute properly the winding number
-    std::sort(it, itEnd);
+            if (m_coverageCells.size() > info.indexStart && m_coverageCells.back().x == it->x)
+            {
+                m_coverageCells.back().value = accumulatedCoverage;
+            }
+            else
+            {
+                m_coverageCells.emplace_back(row, it->x, accumulatedCoverage);
+            }
+        }
 
-    int currentWindingNumber = 0;
-    for (; it != itEnd; ++it)
-    {
-        currentWindingNumber += it->windingNumber;
-        it->windingNumber = currentWindingNumber;
+        info.indexEnd = m_coverageCells.size();
     }
-
-    return result;
 }
 
-void PDFPainterPathSampler::createScanLineSample(const QPointF& p1, const QPointF& p2, qreal y)
+void PDFPainterPathSampler::accumulateLine(QPointF p1, QPointF p2, std::vector<CoverageCell>& cells) const
 {
     PDFReal y1 = p1.y();
     PDFReal y2 = p2.y();
 
     if (qFuzzyIsNull(y2 - y1))
     {
-        // Ignore horizontal lines
+        // Horizontal lines doesn't contribute to the coverage
         return;
     }
 
     PDFReal x1 = p1.x();
     PDFReal x2 = p2.x();
 
-    int windingNumber = 1;
+    PDFReal direction = 1.0;
     if (y2 < y1)
     {
         std::swap(y1, y2);
         std::swap(x1, x2);
-        windingNumber = -1;
+        direction = -1.0;
     }
 
-    // Do we have intercept?
-    if (y1 <= y && y < y2)
+    const int width = m_fillRect.width();
+    const int height = m_fillRect.height();
+
+    if (y2 <= 0.0 || y1 >= height)
     {
-        const PDFReal x = interpolate(y, y1, y2, x1, x2);
-        m_scanLineSamples.emplace_back(x, windingNumber);
+        return;
+    }
+
+    const PDFReal dxdy = (x2 - x1) / (y2 - y1);
+
+    // Adds coverage delta to the cell. Cells left of the fill rectangle
+    // affect only prefix sums, so they are merged into the first cell.
+    auto addCell = [&cells, width](int row, int x, PDFReal value)
+    {
+        if (x < width)
+        {
+            cells.emplace_back(row, qMax(x, 0), value);
+        }
+    };
+
+    // Adds coverage of the line segment lying in one cell. Signed area right
+    // of the segment belongs to the cell, the rest of the height covers
+    // following cells of the scanline.
+    auto addCellSegment = [&addCell](int row, int x, PDFReal xStart, PDFReal xEnd, PDFReal dy)
+    {
+        const PDFReal fraction = (xStart + xEnd) * 0.5 - x;
+        addCell(row, x, dy * (1.0 - fraction));
+        addCell(row, x + 1, dy * fraction);
+    };
+
+    const PDFReal yStart = qMax(y1, 0.0);
+    const PDFReal yEnd = qMin(y2, PDFReal(height));
+
+    for (int row = qFloor(yStart); row < height && row < yEnd; ++row)
+    {
+        const PDFReal ya = qMax(yStart, PDFReal(row));
+        const PDFReal yb = qMin(yEnd, PDFReal(row + 1));
+
+        if (yb <= ya)
+        {
+            continue;
+        }
+
+        const PDFReal dy = (yb - ya) * direction;
+        const PDFReal xa = x1 + (ya - y1) * dxdy;
+        const PDFReal xb = x1 + (yb - y1) * dxdy;
+        const PDFReal xLeft = qMin(xa, xb);
+        const PDFReal xRight = qMax(xa, xb);
+        const PDFReal length = xRight - xLeft;
+
+        if (length < 1e-9)
+        {
+            // Vertical segment, it lies in one cell
+            const int x = qFloor(xLeft);
+            addCellSegment(row, qMax(x, -1), qMax(xLeft, -1.0), qMax(xLeft, -1.0), dy);
+            continue;
+        }
+
+        // Split the segment by cell boundaries
+        PDFReal x = xLeft;
+        if (x < 0.0)
+        {
+            const PDFReal xNext = qMin(xRight, 0.0);
+            addCell(row, 0, dy * (xNext - x) / length);
+            x = xNext;
+        }
+
+        while (x < xRight && x < width)
+        {
+            const int cellX = qFloor(x);
+            const PDFReal xNext = qMin(xRight, PDFReal(cellX + 1));
+
+            if (xNext <= x)
+            {
+                break;
+            }
+
+            addCellSegment(row, cellX, x, xNext, dy * (xNext - x) / length);
+            x = xNext;
+        }
     }
 }
 
@@ -3808,12 +4291,14 @@ void PDFDrawBuffer::clear()
         return;
     }
 
-    for (int x = m_modifiedRect.left(); x <= m_modifiedRect.right(); ++x)
+    for (int y = m_modifiedRect.top(); y <= m_modifiedRect.bottom(); ++y)
     {
-        for (int y = m_modifiedRect.top(); y <= m_modifiedRect.bottom(); ++y)
+        PDFColorComponent* rowBegin = begin() + getPixelIndex(m_modifiedRect.left(), y);
+        PDFColorComponent* rowEnd = begin() + getPixelIndex(m_modifiedRect.right(), y) + getPixelSize();
+        std::fill(rowBegin, rowEnd, 0.0f);
+
+        for (int x = m_modifiedRect.left(); x <= m_modifiedRect.right(); ++x)
         {
-            PDFColorBuffer buffer = getPixel(x, y);
-            std::fill(buffer.begin(), buffer.end(), 0.0f);
             setPixelActiveColorMask(x, y, 0);
         }
     }
@@ -3850,6 +4335,183 @@ void PDFTransparencyRenderer::PDFTransparencySoftMask::makeOpaque()
     }
 }
 
+PDFTiledTransparencyRenderer::PDFTiledTransparencyRenderer(const PDFPage* page,
+                                                           const PDFDocument* document,
+                                                           const PDFFontCache* fontCache,
+                                                           const PDFCMS* cms,
+                                                           const PDFOptionalContentActivity* optionalContentActivity,
+                                                           const PDFInkMapper* inkMapper,
+                                                           PDFTransparencyRendererSettings settings,
+                                                           QTransform pagePointToDevicePointMatrix) :
+    m_page(page),
+    m_document(document),
+    m_fontCache(fontCache),
+    m_cms(cms),
+    m_optionalContentActivity(optionalContentActivity),
+    m_inkMapper(inkMapper),
+    m_settings(settings),
+    m_pagePointToDevicePointMatrix(pagePointToDevicePointMatrix)
+{
+
+}
+
+QList<PDFRenderError> PDFTiledTransparencyRenderer::render(QSize pixelSize)
+{
+    Q_ASSERT(pixelSize.isValid());
+
+    m_resultBitmap = PDFFloatBitmapWithColorSpace();
+    m_originalProcessBitmap = PDFFloatBitmapWithColorSpace();
+    m_compactResultBitmap = PDFUnorm16Bitmap();
+    m_compactOriginalProcessBitmap = PDFUnorm16Bitmap();
+
+    struct Tile
+    {
+        QRect rect;
+        QList<PDFRenderError> errors;
+    };
+
+    const int tileSize = qMax(m_settings.tileSize, 1);
+    std::vector<Tile> tiles;
+    for (int y = 0; y < pixelSize.height(); y += tileSize)
+    {
+        for (int x = 0; x < pixelSize.width(); x += tileSize)
+        {
+            Tile tile;
+            tile.rect = QRect(x, y, qMin(tileSize, pixelSize.width() - x), qMin(tileSize, pixelSize.height() - y));
+            tiles.emplace_back(qMove(tile));
+        }
+    }
+
+    const bool use16BitStorage = m_settings.flags.testFlag(PDFTransparencyRendererSettings::Use16BitStorage);
+
+    // Result bitmaps are created, when first tile is finished (pixel format
+    // is known after rendering). Each tile is copied into its own region
+    // of result bitmaps immediately, so bitmaps of tiles are not kept in memory.
+    QMutex mutex;
+    auto copyTileBitmap = [&](const QRect& rect, auto& targetBitmap, const PDFFloatBitmapWithColorSpace& sourceBitmap)
+    {
+        if (!sourceBitmap.getPixelFormat().isValid() ||
+            sourceBitmap.getWidth() != size_t(rect.width()) ||
+            sourceBitmap.getHeight() != size_t(rect.height()))
+        {
+            return;
+        }
+
+        {
+            QMutexLocker lock(&mutex);
+            if (!targetBitmap.getPixelFormat().isValid())
+            {
+                using BitmapType = std::decay_t<decltype(targetBitmap)>;
+                targetBitmap = BitmapType(pixelSize.width(), pixelSize.height(), sourceBitmap.getPixelFormat(), sourceBitmap.getColorSpace());
+            }
+        }
+
+        if (targetBitmap.getPixelFormat() == sourceBitmap.getPixelFormat())
+        {
+            targetBitmap.copyBitmap(sourceBitmap, rect.left(), rect.top());
+        }
+    };
+
+    // Each tile is rendered by its own renderer, device space of the renderer
+    // is translated, so top left corner of the tile is the origin.
+    auto renderTile = [&](Tile& tile)
+    {
+        try
+        {
+            const QTransform tileMatrix = m_pagePointToDevicePointMatrix * QTransform::fromTranslate(-tile.rect.left(), -tile.rect.top());
+            PDFTransparencyRenderer renderer(m_page, m_document, m_fontCache, m_cms, m_optionalContentActivity, m_inkMapper, m_settings, tileMatrix);
+
+            if (m_deviceColorSpace)
+            {
+                renderer.setDeviceColorSpace(m_deviceColorSpace);
+            }
+            if (m_processColorSpace)
+            {
+                renderer.setProcessColorSpace(m_processColorSpace);
+            }
+
+            renderer.beginPaint(tile.rect.size());
+            tile.errors = renderer.processContents();
+            renderer.endPaint();
+
+            if (use16BitStorage)
+            {
+                copyTileBitmap(tile.rect, m_compactResultBitmap, renderer.getResultBitmap());
+                copyTileBitmap(tile.rect, m_compactOriginalProcessBitmap, renderer.getOriginalProcessBitmap());
+            }
+            else
+            {
+                copyTileBitmap(tile.rect, m_resultBitmap, renderer.getResultBitmap());
+                copyTileBitmap(tile.rect, m_originalProcessBitmap, renderer.getOriginalProcessBitmap());
+            }
+        }
+        catch (const PDFException& exception)
+        {
+            tile.errors.append(PDFRenderError(RenderErrorType::Error, exception.getMessage()));
+        }
+    };
+
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, tiles.begin(), tiles.end(), renderTile);
+
+    QList<PDFRenderError> errors;
+    for (const Tile& tile : tiles)
+    {
+        for (const PDFRenderError& error : tile.errors)
+        {
+            // Same error is usually reported by all tiles
+            auto isSameError = [&error](const PDFRenderError& other) { return other.type == error.type && other.message == error.message; };
+            if (std::none_of(errors.cbegin(), errors.cend(), isSameError))
+            {
+                errors.append(error);
+            }
+        }
+    }
+
+    return errors;
+}
+
+QImage PDFTiledTransparencyRenderer::toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const
+{
+    if (m_compactResultBitmap.getPixelFormat().isValid())
+    {
+        // Convert the bitmap by stripes, so whole float bitmap is never allocated
+        const int width = int(m_compactResultBitmap.getWidth());
+        const int height = int(m_compactResultBitmap.getHeight());
+        const int stripeHeight = qMax(m_settings.tileSize, 1);
+
+        QImage image;
+        for (int y = 0; y < height; y += stripeHeight)
+        {
+            const QRect stripeRect(0, y, width, qMin(stripeHeight, height - y));
+            QImage stripeImage = PDFTransparencyRenderer::createImage(m_compactResultBitmap.toFloatBitmap(stripeRect), use16Bit, usePaper, paperColor);
+
+            if (stripeImage.isNull())
+            {
+                return QImage();
+            }
+
+            if (image.isNull())
+            {
+                image = QImage(width, height, stripeImage.format());
+            }
+
+            for (int row = 0; row < stripeImage.height(); ++row)
+            {
+                std::copy_n(stripeImage.constScanLine(row), stripeImage.bytesPerLine(), image.scanLine(y + row));
+            }
+        }
+
+        return image;
+    }
+
+    if (!m_resultBitmap.getPixelFormat().isValid())
+    {
+        return QImage();
+    }
+
+    return PDFTransparencyRenderer::createImage(m_resultBitmap, use16Bit, usePaper, paperColor);
+}
+
 PDFInkCoverageCalculator::PDFInkCoverageCalculator(const PDFDocument* document,
                                                    const PDFFontCache* fontCache,
                                                    const PDFCMSManager* cmsManager,
@@ -3901,6 +4563,12 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
         QRectF pageRect = page->getRotatedMediaBox();
         QSizeF pageSize = pageRect.size();
         pageSize.scale(size.width(), size.height(), Qt::KeepAspectRatio);
+
+        if (m_fastEstimate)
+        {
+            pageSize /= FAST_ESTIMATE_RESOLUTION_DIVISOR;
+        }
+
         QSize imageSize = pageSize.toSize();
 
         if (!imageSize.isValid())
@@ -3920,48 +4588,64 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
         settings.flags.setFlag(PDFTransparencyRendererSettings::SeparationSimulation, true);
         settings.activeColorMask = PDFPixelFormat::getAllColorsMask();
 
+        // Coverage is summed over all pixels, 16-bit precision is sufficient
+        settings.flags.setFlag(PDFTransparencyRendererSettings::Use16BitStorage, true);
+
         QTransform pagePointToDevicePoint = pdf::PDFRenderer::createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), imageSize));
         pdf::PDFCMSPointer cms = m_cmsManager->getCurrentCMS();
-        pdf::PDFTransparencyRenderer renderer(page, m_document, m_fontCache, cms.data(), m_optionalContentActivity,
-                                              m_inkMapper, settings, pagePointToDevicePoint);
 
-        renderer.beginPaint(imageSize);
-        renderer.processContents();
-        renderer.endPaint();
+        // Allocate only spot color channels used on the page
+        PDFInkMapper pageInkMapper = m_inkMapper->createPageInkMapper(page);
+        pdf::PDFTiledTransparencyRenderer renderer(page, m_document, m_fontCache, cms.data(), m_optionalContentActivity,
+                                                   &pageInkMapper, settings, pagePointToDevicePoint);
+        renderer.render(imageSize);
 
-        PDFFloatBitmapWithColorSpace originalProcessImage = renderer.getOriginalProcessBitmap();
+        const PDFUnorm16Bitmap& originalProcessImage = renderer.getCompactOriginalProcessBitmap();
         QSizeF pageSizeMM = page->getRotatedMediaBoxMM().size();
 
         pdf::PDFPixelFormat pixelFormat = originalProcessImage.getPixelFormat();
-        pdf::PDFColorComponent totalArea = pageSizeMM.width() * pageSizeMM.height();
-        pdf::PDFColorComponent pixelArea = totalArea / pdf::PDFColorComponent(originalProcessImage.getWidth() * originalProcessImage.getHeight());
+        const PDFReal totalArea = pageSizeMM.width() * pageSizeMM.height();
 
-        std::vector<PDFColorComponent> pageCoverage;
         const uint8_t colorChannelCount = pixelFormat.getColorChannelCount();
-        pageCoverage.resize(colorChannelCount, 0.0f);
+        const size_t width = originalProcessImage.getWidth();
+
+        // Sums are accumulated in double precision, because page has millions of pixels
+        std::vector<PDFReal> pageCoverage(colorChannelCount, 0.0);
+        std::vector<PDFReal> pageCoverageError(colorChannelCount, 0.0);
 
+        // Covered values of the previous row, used to estimate the error. Value of the
+        // pixel lies (approximately) between values of its neighbours, so error of the
+        // pixel is bounded by half of the maximal difference from its neighbours.
+        std::vector<PDFColorComponent> previousRow(m_fastEstimate ? width * colorChannelCount : 0, 0.0f);
+
+        std::vector<PDFColorComponent> pixel(originalProcessImage.getPixelSize(), 0.0f);
+        pdf::PDFColorBuffer buffer(pixel.data(), pixel.size());
         for (size_t y = 0; y < originalProcessImage.getHeight(); ++y)
         {
-            for (size_t x = 0; x < originalProcessImage.getWidth(); ++x)
+            for (size_t x = 0; x < width; ++x)
             {
-                const pdf::PDFColorBuffer buffer = originalProcessImage.getPixel(x, y);
+                originalProcessImage.getPixel(x, y, buffer);
                 const pdf::PDFColorComponent alpha = pixelFormat.hasOpacityChannel() ? buffer[pixelFormat.getOpacityChannelIndex()] : 1.0f;
 
                 for (uint8_t i = 0; i < colorChannelCount; ++i)
                 {
-                    pageCoverage[i] += buffer[i] * alpha;
+                    const PDFColorComponent value = buffer[i] * alpha;
+                    pageCoverage[i] += value;
+
+                    if (m_fastEstimate)
+                    {
+                        PDFColorComponent* previousValue = previousRow.data() + x * colorChannelCount + i;
+                        const PDFColorComponent topDifference = y > 0 ? qAbs(value - *previousValue) : 0.0f;
+                        const PDFColorComponent leftDifference = x > 0 ? qAbs(value - *(previousValue - colorChannelCount)) : 0.0f;
+                        pageCoverageError[i] += 0.5f * qMax(topDifference, leftDifference);
+                        *previousValue = value;
+                    }
                 }
             }
         }
 
-        std::vector<PDFColorComponent> pageRatioCoverage = pageCoverage;
-        for (uint8_t i = 0; i < colorChannelCount; ++i)
-        {
-            pageCoverage[i] *= pixelArea;
-            pageRatioCoverage[i] *= pixelArea / totalArea;
-        }
-
-        std::vector<PDFInkMapper::ColorInfo> separations = m_inkMapper->getSeparations(pixelFormat.getProcessColorChannelCount());
+        const PDFReal pixelArea = totalArea / PDFReal(width * originalProcessImage.getHeight());
+        std::vector<PDFInkMapper::ColorInfo> separations = pageInkMapper.getSeparations(pixelFormat.getProcessColorChannelCount());
         Q_ASSERT(pixelFormat.getColorChannelCount() == separations.size());
 
         std::vector<InkCoverageChannelInfo> results;
@@ -3976,8 +4660,10 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
             info.name = colorInfo.name;
             info.textName = colorInfo.textName;
             info.isSpot = colorInfo.isSpot;
-            info.coveredArea = pageCoverage[i];
-            info.ratio = pageRatioCoverage[i];
+            info.coveredArea = pageCoverage[i] * pixelArea;
+            info.ratio = pageCoverage[i] * pixelArea / totalArea;
+            info.coveredAreaError = pageCoverageError[i] * pixelArea;
+            info.ratioError = pageCoverageError[i] * pixelArea / totalArea;
             results.emplace_back(qMove(info));
         }
 
@@ -3986,6 +4672,11 @@ void PDFInkCoverageCalculator::perform(QSize size, const std::vector<PDFInteger>
             m_progress->step();
         }
 
+        if (m_pageCoverageCallback)
+        {
+            m_pageCoverageCallback(pageIndex, results);
+        }
+
         QMutexLocker lock(&m_mutex);
         m_inkCoverageResults[pageIndex] = qMove(results);
     };
@@ -233,6 +233,12 @@ public:
     /// \param channelIndex Channel index
     QImage getChannelImage(uint8_t channelIndex) const;
 
+    /// Returns separation images (plates) of all color channels, i.e. process
+    /// colors followed by spot colors. Each plate is a gray image, where black
+    /// corresponds to the full ink coverage and white to no ink. All plates
+    /// are created in a single pass over the bitmap, rows are processed in parallel.
+    std::vector<QImage> getSeparationImages() const;
+
     /// Extract process colors into another bitmap
     PDFFloatBitmap extractProcessColors() const;
 
@@ -255,6 +261,30 @@ public:
     /// \param channelTo Target channel
     void copyChannel(const PDFFloatBitmap& sourceBitmap, uint8_t channelFrom, uint8_t channelTo);
 
+    /// Copies source bitmap into this bitmap, so top left corner of the source
+    /// bitmap is placed at the given pixel. Pixel formats of both bitmaps must
+    /// be the same and source bitmap must fit into this bitmap.
+    /// \param sourceBitmap Source bitmap
+    /// \param x Horizontal coordinate of the target pixel
+    /// \param y Vertical coordinate of the target pixel
+    void copyBitmap(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y);
+
+    /// Extracts row of pixels into buffer in planar layout, i.e. each channel
+    /// is stored separately, n-th channel of the row starts at index n * \p count.
+    /// Buffer must have at least pixel size * count values.
+    /// \param x Horizontal coordinate of the first pixel
+    /// \param y Vertical coordinate of the row
+    /// \param count Count of pixels
+    /// \param[out] buffer Buffer with planar channels
+    void extractPlanarRow(size_t x, size_t y, size_t count, PDFColorComponent* buffer) const;
+
+    /// Stores row of pixels from the buffer in planar layout (see \p extractPlanarRow).
+    /// \param x Horizontal coordinate of the first pixel
+    /// \param y Vertical coordinate of the row
+    /// \param count Count of pixels
+    /// \param buffer Buffer with planar channels
+    void storePlanarRow(size_t x, size_t y, size_t count, const PDFColorComponent* buffer);
+
     /// Resize the bitmap using given transformation mode. Fast transformation mode
     /// uses nearest neighbour mapping, smooth transformation mode uses weighted
     /// averaging algorithm.
@@ -310,6 +340,20 @@ public:
     static PDFFloatBitmap createOpaqueSoftMask(size_t width, size_t height);
 
 private:
+    /// Performs bitmap blending using separable blend mode without overprint.
+    /// Rows of bitmaps are processed in planar layout by vectorized kernels.
+    /// Parameters are the same as in \p blend function.
+    static void blendSeparable(const PDFFloatBitmap& source,
+                               PDFFloatBitmap& target,
+                               const PDFFloatBitmap& backdrop,
+                               const PDFFloatBitmap& initialBackdrop,
+                               const PDFFloatBitmap& softMask,
+                               bool alphaIsShape,
+                               PDFColorComponent constantAlpha,
+                               BlendMode mode,
+                               bool knockoutGroup,
+                               QRect blendRegion);
+
     PDFPixelFormat m_format;
     std::size_t m_width;
     std::size_t m_height;
@@ -341,6 +385,57 @@ private:
     PDFColorSpacePointer m_colorSpace;
 };
 
+/// Bitmap storing channels as 16-bit fixed point numbers (unsigned normalized
+/// values, 0 corresponds to 0.0 and 65535 corresponds to 1.0). It uses half
+/// of the memory of the float bitmap, values are converted to floats, when
+/// pixels are accessed. Values outside of interval [0, 1] are clamped.
+class PDF4QTLIBCORESHARED_EXPORT PDFUnorm16Bitmap
+{
+public:
+    explicit PDFUnorm16Bitmap();
+    explicit PDFUnorm16Bitmap(size_t width, size_t height, PDFPixelFormat format, PDFColorSpacePointer colorSpace);
+
+    size_t getWidth() const { return m_width; }
+    size_t getHeight() const { return m_height; }
+    size_t getPixelSize() const { return m_pixelSize; }
+    PDFPixelFormat getPixelFormat() const { return m_format; }
+    PDFColorSpacePointer getColorSpace() const { return m_colorSpace; }
+
+    /// Converts pixel to float values
+    /// \param x Horizontal coordinate of the pixel
+    /// \param y Vertical coordinate of the pixel
+    /// \param[out] buffer Buffer, must have size of the pixel
+    void getPixel(size_t x, size_t y, PDFColorBuffer buffer) const;
+
+    /// Copies source bitmap into this bitmap, so top left corner of the source
+    /// bitmap is placed at the given pixel. Pixel formats of both bitmaps must
+    /// be the same and source bitmap must fit into this bitmap.
+    /// \param sourceBitmap Source bitmap
+    /// \param x Horizontal coordinate of the target pixel
+    /// \param y Vertical coordinate of the target pixel
+    void copyBitmap(const PDFFloatBitmap& sourceBitmap, size_t x, size_t y);
+
+    /// Converts rectangle of this bitmap to the float bitmap. Rectangle
+    /// must lie in this bitmap.
+    /// \param rect Rectangle
+    PDFFloatBitmapWithColorSpace toFloatBitmap(QRect rect) const;
+
+    /// Converts whole bitmap to the float bitmap
+    PDFFloatBitmapWithColorSpace toFloatBitmap() const { return toFloatBitmap(QRect(0, 0, int(m_width), int(m_height))); }
+
+    static inline uint16_t encode(PDFColorComponent value) { return static_cast<uint16_t>(qBound(0.0f, value, 1.0f) * 65535.0f + 0.5f); }
+    static inline PDFColorComponent decode(uint16_t value) { return value * (1.0f / 65535.0f); }
+
+private:
+    PDFPixelFormat m_format;
+    std::size_t m_width;
+    std::size_t m_height;
+    std::size_t m_pixelSize;
+    std::vector<uint16_t> m_data;
+    std::vector<uint32_t> m_activeColorMask;
+    PDFColorSpacePointer m_colorSpace;
+};
+
 /// Ink mapping
 struct PDFInkMapping
 {
@@ -433,6 +528,19 @@ public:
     /// \param active Make spot colors active?
     void setSpotColorsActive(bool active);
 
+    /// Creates ink mapper, which contains only spot colors of this mapper used
+    /// on the given page (activity of spot colors is preserved). Bitmaps rendered
+    /// using page ink mapper contain only spot color channels used on the page.
+    /// \param page Page
+    PDFInkMapper createPageInkMapper(const PDFPage* page) const;
+
+    /// Maps active color mask of bitmaps rendered using document ink mapper
+    /// to the active color mask of bitmaps rendered using this (page) ink mapper.
+    /// \param documentInkMapper Ink mapper, from which this ink mapper was created
+    /// \param processColorCount Process color count
+    /// \param activeColorMask Active color mask for document ink mapper
+    uint32_t mapActiveColorMask(const PDFInkMapper& documentInkMapper, uint32_t processColorCount, uint32_t activeColorMask) const;
+
     /// Creates color mapping from source color space to the target color space.
     /// If mapping  cannot be created, then invalid mapping is returned. Target
     /// color space must be blending color space and must correspond to active
@@ -445,6 +553,12 @@ public:
                                 PDFPixelFormat targetPixelFormat) const;
 
 private:
+    /// Calls callback for each colorant of separation and DeviceN
+    /// color spaces defined in the resources of the page.
+    /// \param page Page
+    /// \param callback Callback (colorant name, color space, colorant index)
+    void forEachPageSpotColorant(const PDFPage* page, const std::function<void(const QByteArray&, const PDFColorSpacePointer&, uint32_t)>& callback) const;
+
     const PDFCMSManager* m_cmsManager;
     const PDFDocument* m_document;
     std::vector<ColorInfo> m_spotColors;
@@ -452,14 +566,17 @@ private:
     size_t m_activeSpotColors = 0;
 };
 
-/// Painter path sampler. Returns shape value of pixel. This sampler
-/// uses MSAA with regular grid.
+/// Painter path sampler. Returns shape value of pixel. Unless precise
+/// sampling is requested, coverage of pixels is computed analytically by
+/// scanline rasterizer with sparse cell accumulation (similar to FreeType),
+/// so only cells crossed by the path boundary are stored. Precise sampler
+/// uses MSAA with regular grid on the painter path.
 class PDFPainterPathSampler
 {
 public:
     /// Creates new painter path sampler, using given painter path,
     /// sample count (in one direction) and default shape used, when painter path is empty.
-    /// Fill rectangle is used to precompute winding numbers for samples. Points outside
+    /// Fill rectangle is used to precompute pixel coverage. Points outside
     /// of fill rectangle are considered as outside and defaultShape is returned.
     /// \param path Sampled path
     /// \param samplesCount Samples count in one direction
@@ -476,21 +593,25 @@ public:
     PDFColorComponent sample(QPoint point) const;
 
 private:
-    struct ScanLineSample
+    /// Accumulation cell of the scanline. After the cells of the scanline
+    /// are sorted and merged, value is the accumulated (signed) coverage
+    /// of the pixels from cell x coordinate to the next cell.
+    struct CoverageCell
     {
-        inline constexpr ScanLineSample() = default;
-        inline constexpr ScanLineSample(PDFReal x, int windingNumber) :
+        inline constexpr CoverageCell() = default;
+        inline constexpr CoverageCell(int row, int x, PDFReal value) :
+            row(row),
             x(x),
-            windingNumber(windingNumber)
+            value(value)
         {
 
         }
 
-        bool operator<(const ScanLineSample& other) const { return x < other.x; }
-        bool operator<(PDFReal ordinate) const { return x < ordinate; }
+        bool operator<(const CoverageCell& other) const { return row < other.row || (row == other.row && x < other.x); }
 
-        PDFReal x = 0.0;
-        int windingNumber = 0;
+        int row = 0;
+        int x = 0;
+        PDFReal value = 0.0;
     };
 
     struct ScanLineInfo
@@ -499,33 +620,24 @@ private:
         size_t indexEnd = 0;
     };
 
-    /// Compute sample by using scan lines
-    PDFColorComponent sampleByScanLine(QPoint point) const;
-
-    /// Returns number of scan lines per pixel
-    size_t getScanLineCountPerPixel() const;
+    /// Compute sample by using accumulated coverage cells
+    PDFColorComponent sampleByCoverage(QPoint point) const;
 
-    /// Creates scan lines using fill rectangle
-    void prepareScanLines();
+    /// Rasterizes the path into coverage cells using fill rectangle
+    void prepareCoverage();
 
-    /// Creates scan line for given y coordinate and
-    /// returns info about this scan line
-    /// \param y Vertical coordinate of the sample line
-    ScanLineInfo createScanLine(qreal y);
-
-    /// Creates scan line sample (if horizontal line of y coordinate
-    /// is intersecting boundary line segment p1-p2.
+    /// Accumulates coverage of oriented boundary line segment p1-p2 into the
+    /// cells. Points are in coordinates relative to the fill rectangle.
     /// \param p1 First point of the oriented boundary line segment
     /// \param p2 Second point of the oriented boundary line segment
-    /// \param y Vertical coordinate of the sample line
-    void createScanLineSample(const QPointF& p1, const QPointF& p2, qreal y);
+    /// \param cells Unsorted accumulation cells
+    void accumulateLine(QPointF p1, QPointF p2, std::vector<CoverageCell>& cells) const;
 
     PDFColorComponent m_defaultShape = 0.0;
     int m_samplesCount = 0; ///< Samples count in one direction
     QPainterPath m_path;
-    QPolygonF m_fillPolygon;
     QRect m_fillRect;
-    std::vector<ScanLineSample> m_scanLineSamples;
+    std::vector<CoverageCell> m_coverageCells;
     std::vector<ScanLineInfo> m_scanLineInfo;
     bool m_precise;
 };
@@ -573,6 +685,10 @@ struct PDFTransparencyRendererSettings
     /// used when some shadings are being sampled.
     int shadingAlgorithmLimit = 64;
 
+    /// Size of the tile (in pixels) used by tiled transparency
+    /// renderer, page is divided into tiles of this size.
+    int tileSize = 256;
+
     enum Flag
     {
         None               = 0x0000,
@@ -617,6 +733,10 @@ struct PDFTransparencyRendererSettings
         /// and before separation simulation is applied. Active color mask
         /// is still applied to this image.
         SaveOriginalProcessImage    = 0x0400,
+
+        /// Tiled renderer stores result bitmaps using 16-bit fixed point
+        /// channels instead of floats, so they use half of the memory.
+        Use16BitStorage             = 0x0800,
     };
 
     Q_DECLARE_FLAGS(Flags, Flag)
@@ -691,6 +811,18 @@ public:
     /// applied to this image.
     PDFFloatBitmapWithColorSpace getOriginalProcessBitmap() const { return m_originalProcessBitmap; }
 
+    /// Returns result bitmap in device color space. This function should be
+    /// called only after call to \p endPaint.
+    const PDFFloatBitmapWithColorSpace& getResultBitmap() const { return *getImmediateBackdrop(); }
+
+    /// Converts float image to QImage, the same way as \p toImage does.
+    /// Float image must be RGB image, otherwise empty image is returned.
+    /// \param floatImage Float image
+    /// \param use16bit Produce 16-bit image instead of standard 8-bit
+    /// \param usePaper Blend image with opaque paper, with color \p paperColor
+    /// \param paperColor Paper color
+    static QImage createImage(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit, bool usePaper, const PDFRGB& paperColor);
+
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
     virtual void performPathPainting(const QPainterPath& path, bool stroke, bool fill, bool text, Qt::FillRule fillRule) override;
     virtual bool performPathPaintingUsingShading(const QPainterPath& path, bool stroke, bool fill, const PDFShadingPattern* shadingPattern) override;
@@ -743,6 +875,25 @@ private:
         QSharedDataPointer<PDFTransparencySoftMaskImpl> m_data;
     };
 
+    /// Key of the rendered soft mask. Soft mask is rendered using current
+    /// transformation matrix, which is set, when soft mask is activated,
+    /// into bitmap of the draw buffer size.
+    struct PDFSoftMaskCacheKey
+    {
+        const PDFDictionary* softMask = nullptr;
+        QTransform matrix;
+        QSize size;
+
+        bool operator==(const PDFSoftMaskCacheKey& other) const
+        {
+            return softMask == other.softMask && matrix == other.matrix && size == other.size;
+        }
+    };
+
+    /// Maximal number of cached soft masks (cache is used to avoid
+    /// rendering of the same soft mask for each object it applies to)
+    static constexpr size_t SOFT_MASK_CACHE_SIZE = 8;
+
     struct PDFTransparencyGroupPainterData
     {
         void makeInitialBackdropTransparent();
@@ -763,6 +914,7 @@ private:
         uint32_t activeColorMask = PDFPixelFormat::getAllColorsMask();
         bool transformSpotsToDevice = false;
         bool saveOriginalImage = false;
+        QRect dirtyRect; ///< Area of immediate backdrop, which was painted in this group
     };
 
     struct PDFTransparencyPainterState
@@ -795,7 +947,7 @@ private:
     PDFFloatBitmapWithColorSpace convertImageToBlendSpace(const PDFFloatBitmapWithColorSpace& image);
 
     /// Converts RGB bitmap to the image.
-    QImage toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit) const;
+    static QImage toImageImpl(const PDFFloatBitmapWithColorSpace& floatImage, bool use16Bit);
 
     PDFFloatBitmapWithColorSpace* getInitialBackdrop();
     PDFFloatBitmapWithColorSpace* getImmediateBackdrop();
@@ -827,6 +979,11 @@ private:
     /// Flushes draw buffer
     void flushDrawBuffer();
 
+    /// Prepares empty draw buffer for the current transparency group. If draw
+    /// buffer has the same size and pixel format, it is reused, otherwise
+    /// new draw buffer is allocated.
+    void prepareDrawBuffer();
+
     /// Returns true, if multithreaded painter path sampling should be used
     /// for a given fill rectangle.
     /// \param fillRect Fill rectangle
@@ -923,6 +1080,75 @@ private:
     PDFTransparencyRendererSettings m_settings;
     PDFDrawBuffer m_drawBuffer;
     PDFFloatBitmapWithColorSpace m_originalProcessBitmap;
+
+    /// Rendered soft masks, most recently used are first
+    std::vector<std::pair<PDFSoftMaskCacheKey, PDFTransparencySoftMask>> m_softMaskCache;
+};
+
+/// Renders PDF pages with transparency, using transparency renderer. Page is
+/// divided into tiles, which are rendered independently - each tile has its own
+/// transparency group stack and its own soft masks. So tiles can be rendered
+/// in parallel, and result bitmap is composed from the rendered tiles.
+class PDF4QTLIBCORESHARED_EXPORT PDFTiledTransparencyRenderer
+{
+public:
+    explicit PDFTiledTransparencyRenderer(const PDFPage* page,
+                                          const PDFDocument* document,
+                                          const PDFFontCache* fontCache,
+                                          const PDFCMS* cms,
+                                          const PDFOptionalContentActivity* optionalContentActivity,
+                                          const PDFInkMapper* inkMapper,
+                                          PDFTransparencyRendererSettings settings,
+                                          QTransform pagePointToDevicePointMatrix);
+
+    /// Sets device color space (see PDFTransparencyRenderer::setDeviceColorSpace)
+    /// \param colorSpace Color space
+    void setDeviceColorSpace(PDFColorSpacePointer colorSpace) { m_deviceColorSpace = qMove(colorSpace); }
+
+    /// Sets process color space (see PDFTransparencyRenderer::setProcessColorSpace)
+    /// \param colorSpace Color space
+    void setProcessColorSpace(PDFColorSpacePointer colorSpace) { m_processColorSpace = qMove(colorSpace); }
+
+    /// Renders page content onto the bitmap of given size. Returns
+    /// list of rendering errors of all tiles.
+    /// \param pixelSize Size of the result bitmap in pixels
+    QList<PDFRenderError> render(QSize pixelSize);
+
+    /// Returns result bitmap in device color space. If 16-bit storage
+    /// is used, then this bitmap is empty, use \p getCompactResultBitmap.
+    const PDFFloatBitmapWithColorSpace& getResultBitmap() const { return m_resultBitmap; }
+
+    /// Returns original process bitmap (see PDFTransparencyRenderer::getOriginalProcessBitmap).
+    /// If 16-bit storage is used, then this bitmap is empty, use \p getCompactOriginalProcessBitmap.
+    const PDFFloatBitmapWithColorSpace& getOriginalProcessBitmap() const { return m_originalProcessBitmap; }
+
+    /// Returns result bitmap in device color space, if 16-bit storage is used
+    const PDFUnorm16Bitmap& getCompactResultBitmap() const { return m_compactResultBitmap; }
+
+    /// Returns original process bitmap, if 16-bit storage is used
+    const PDFUnorm16Bitmap& getCompactOriginalProcessBitmap() const { return m_compactOriginalProcessBitmap; }
+
+    /// Converts result bitmap to QImage (see PDFTransparencyRenderer::toImage)
+    /// \param use16bit Produce 16-bit image instead of standard 8-bit
+    /// \param usePaper Blend image with opaque paper, with color \p paperColor
+    /// \param paperColor Paper color
+    QImage toImage(bool use16Bit, bool usePaper, const PDFRGB& paperColor) const;
+
+private:
+    const PDFPage* m_page;
+    const PDFDocument* m_document;
+    const PDFFontCache* m_fontCache;
+    const PDFCMS* m_cms;
+    const PDFOptionalContentActivity* m_optionalContentActivity;
+    const PDFInkMapper* m_inkMapper;
+    PDFTransparencyRendererSettings m_settings;
+    QTransform m_pagePointToDevicePointMatrix;
+    PDFColorSpacePointer m_deviceColorSpace;
+    PDFColorSpacePointer m_processColorSpace;
+    PDFFloatBitmapWithColorSpace m_resultBitmap;
+    PDFFloatBitmapWithColorSpace m_originalProcessBitmap;
+    PDFUnorm16Bitmap m_compactResultBitmap;
+    PDFUnorm16Bitmap m_compactOriginalProcessBitmap;
 };
 
 /// Ink coverage calculator. Calculates ink coverage for a given
@@ -946,8 +1172,28 @@ public:
         QColor color;
         PDFColorComponent coveredArea = 0.0f;
         PDFColorComponent ratio = 0.0f;
+
+        /// Estimated absolute error of covered area (nonzero only for fast estimate)
+        PDFColorComponent coveredAreaError = 0.0f;
+
+        /// Estimated absolute error of ratio (nonzero only for fast estimate)
+        PDFColorComponent ratioError = 0.0f;
     };
 
+    /// Callback, which is called, when ink coverage of the page is calculated.
+    /// Callback can be called from arbitrary thread.
+    using PageCoverageCallback = std::function<void(PDFInteger, const std::vector<InkCoverageChannelInfo>&)>;
+
+    /// Sets callback, which is called, when ink coverage of some page is calculated,
+    /// so results can be displayed before all pages are finished.
+    /// \param callback Callback
+    void setPageCoverageCallback(PageCoverageCallback callback) { m_pageCoverageCallback = qMove(callback); }
+
+    /// Enables or disables fast estimate. When fast estimate is enabled, pages are
+    /// rendered in reduced resolution and error of coverage is estimated.
+    /// \param fastEstimate Fast estimate
+    void setFastEstimate(bool fastEstimate) { m_fastEstimate = fastEstimate; }
+
     /// Perform ink coverage calculations on given pages. Results are stored
     /// in this object. Page images are rendered using \p size resolution,
     /// and in this resolution, ink coverage is calculated.
@@ -978,6 +1224,9 @@ public:
     static InkCoverageChannelInfo* findCoverageInfoByName(std::vector<InkCoverageChannelInfo>& infos, const QByteArray& name);
 
 private:
+    /// Resolution divisor of page images in fast estimate mode
+    static constexpr int FAST_ESTIMATE_RESOLUTION_DIVISOR = 4;
+
     const PDFDocument* m_document;
     const PDFFontCache* m_fontCache;
     const PDFCMSManager* m_cmsManager;
@@ -985,6 +1234,8 @@ private:
     const PDFInkMapper* m_inkMapper;
     PDFProgress* m_progress;
     PDFTransparencyRendererSettings m_settings;
+    PageCoverageCallback m_pageCoverageCallback;
+    bool m_fastEstimate = false;
 
     QMutex m_mutex;
     std::map<pdf::PDFInteger, std::vector<InkCoverageChannelInfo>> m_inkCoverageResults;
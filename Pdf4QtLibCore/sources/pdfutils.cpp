@@ -21,6 +21,7 @@
 
 #include <QtGlobal>
 #include <QtMath>
+#include <QtEndian>
 #include "pdfdbgheap.h"
 
 #include <jpeglib.h>
@@ -76,15 +77,11 @@ PDFBitReader::PDFBitReader(const QByteArray* stream, Value bitsPerComponent) :
 
 PDFBitReader::Value PDFBitReader::read(PDFBitReader::Value bits)
 {
-    while (m_bitsInBuffer < bits)
+    if (m_bitsInBuffer < bits)
     {
-        if (m_position < m_stream->size())
-        {
-            uint8_t currentByte = static_cast<uint8_t>((*m_stream)[m_position++]);
-            m_buffer = (m_buffer << 8) | currentByte;
-            m_bitsInBuffer += 8;
-        }
-        else
+        refill();
+
+        if (m_bitsInBuffer < bits)
         {
             throw PDFException(PDFTranslationContext::tr("Not enough data to read %1-bit value.").arg(bits));
         }
@@ -98,22 +95,65 @@ PDFBitReader::Value PDFBitReader::read(PDFBitReader::Value bits)
 
 PDFBitReader::Value PDFBitReader::look(Value bits) const
 {
-    PDFBitReader temp(*this);
+    Q_ASSERT(bits <= 56);
+
+    Value buffer = m_buffer;
+    Value bitsInBuffer = m_bitsInBuffer;
+    int position = m_position;
+
+    // Bits after the end of the stream are zero
+    while (bitsInBuffer < bits)
+    {
+        const uint8_t currentByte = (position < m_stream->size()) ? static_cast<uint8_t>((*m_stream)[position++]) : 0;
+        buffer = (buffer << 8) | currentByte;
+        bitsInBuffer += 8;
+    }
+
+    return (buffer >> (bitsInBuffer - bits)) & ((static_cast<Value>(1) << bits) - static_cast<Value>(1));
+}
+
+void PDFBitReader::refill()
+{
+    const int size = m_stream->size();
 
-    Value result = 0;
-    for (Value i = 0; i < bits; ++i)
+    if (m_position + 8 <= size)
     {
-        if (!temp.isAtEnd())
+        // Load whole 8 bytes at once and take as many bytes as fit into the buffer
+        const quint64 data = qFromBigEndian<quint64>(m_stream->constData() + m_position);
+
+        if (m_bitsInBuffer == 0)
         {
-            result = (result << 1) | temp.read(1);
+            m_buffer = data;
+            m_bitsInBuffer = 64;
+            m_position += 8;
         }
         else
         {
-            result = (result << 1);
+            const Value bytes = (64 - m_bitsInBuffer) / 8;
+            if (bytes > 0)
+            {
+                m_buffer = (m_buffer << (bytes * 8)) | (data >> (64 - bytes * 8));
+                m_bitsInBuffer += bytes * 8;
+                m_position += static_cast<int>(bytes);
+            }
         }
     }
+    else
+    {
+        while (m_bitsInBuffer <= 56 && m_position < size)
+        {
+            const uint8_t currentByte = static_cast<uint8_t>((*m_stream)[m_position++]);
+            m_buffer = (m_buffer << 8) | currentByte;
+            m_bitsInBuffer += 8;
+        }
+    }
+}
 
-    return result;
+void PDFBitReader::returnBufferedBytes()
+{
+    const Value bytes = m_bitsInBuffer / 8;
+    m_position -= static_cast<int>(bytes);
+    m_bitsInBuffer -= bytes * 8;
 }
 
 void PDFBitReader::seek(qint64 position)
@@ -133,8 +173,9 @@ void PDFBitReader::seek(qint64 position)
 void PDFBitReader::skipBytes(Value bytes)
 {
     // Jakub Melka: if we are lucky, then we just seek to the new position
-    if (m_bitsInBuffer == 0)
+    if (m_bitsInBuffer % 8 == 0)
     {
+        returnBufferedBytes();
         seek(m_position + bytes);
     }
     else
@@ -179,6 +220,8 @@ int8_t PDFBitReader::readSignedByte()
 
 QByteArray PDFBitReader::readSubstream(int length)
 {
+    returnBufferedBytes();
+
     if (m_bitsInBuffer)
     {
         throw PDFException(PDFTranslationContext::tr("Can't get substream - remaining %1 bits in buffer.").arg(m_bitsInBuffer));
@@ -214,6 +257,17 @@ void PDFBitWriter::write(Value value)
     flush(false);
 }
 
+void PDFBitWriter::write(Value value, Value bits)
+{
+    Q_ASSERT(bits <= 56);
+
+    const Value mask = (static_cast<Value>(1) << bits) - static_cast<Value>(1);
+    m_buffer = (m_buffer << bits) | (value & mask);
+    m_bitsInBuffer += bits;
+
+    flush(false);
+}
+
 void PDFBitWriter::flush(bool alignToByteBoundary)
 {
     if (m_bitsInBuffer >= 8)
@@ -26,8 +26,10 @@
 #include <QDataStream>
 
 #include <set>
+#include <memory>
 #include <vector>
 #include <iterator>
+#include <algorithm>
 #include <functional>
 #include <type_traits>
 
@@ -138,6 +140,41 @@ public:
     /// bits are reverted back.
     Value look(Value bits) const;
 
+    /// Returns next n bits (at most 56 bits) of the stream without consuming them.
+    /// Bits after the end of the stream are zero. Unlike \ref look, the bit buffer
+    /// is refilled, so subsequent peeks and reads are served from the buffer.
+    /// \param bits Count of bits
+    inline Value peek(Value bits)
+    {
+        Q_ASSERT(bits <= 56);
+
+        if (m_bitsInBuffer < bits)
+        {
+            refill();
+
+            if (m_bitsInBuffer < bits)
+            {
+                return (m_buffer << (bits - m_bitsInBuffer)) & ((static_cast<Value>(1) << bits) - static_cast<Value>(1));
+            }
+        }
+
+        return (m_buffer >> (m_bitsInBuffer - bits)) & ((static_cast<Value>(1) << bits) - static_cast<Value>(1));
+    }
+
+    /// Skips n bits (at most 56 bits), which were previously peeked. If stream
+    /// hasn't enough data, then exception is thrown.
+    /// \param bits Count of bits
+    inline void skip(Value bits)
+    {
+        if (m_bitsInBuffer < bits)
+        {
+            read(bits);
+            return;
+        }
+
+        m_bitsInBuffer -= bits;
+    }
+
     /// Seeks the desired position in the data stream. If position can't be seeked,
     /// then exception is thrown.
     void seek(qint64 position);
@@ -153,7 +190,7 @@ public:
 
     /// Returns position in the data stream (byte position, not bit position, so
     /// result of this function is sometimes inaccurate)
-    int getPosition() const { return m_position; }
+    int getPosition() const { return m_position - static_cast<int>(m_bitsInBuffer / 8); }
 
     /// Reads signed 32-bit integer from the stream
     int32_t readSignedInt();
@@ -179,6 +216,13 @@ public:
     QByteArray readSubstream(int length);
 
 private:
+    /// Fills the bit buffer, so it contains at least 57 bits, or all remaining
+    /// bits of the stream. Whole 8 bytes are loaded at once, if possible.
+    void refill();
+
+    /// Returns whole unread bytes from the bit buffer back to the stream
+    void returnBufferedBytes();
+
     const QByteArray* m_stream;
     int m_position;
 
@@ -200,6 +244,12 @@ public:
     /// Writes value to the output stream
     void write(Value value);
 
+    /// Writes value to the output stream using given count of bits
+    /// instead of bits per component. Zero bits writes nothing.
+    /// \param value Value
+    /// \param bits Count of bits (must be at most 56)
+    void write(Value value, Value bits);
+
     /// Finish line - align to byte boundary
     void finishLine() { flush(true); }
 
@@ -311,6 +361,235 @@ private:
     T m_end;
 };
 
+/// Vector with copy-on-write semantics. Items are stored in chunks of fixed
+/// size, copies of the vector share the chunks, and chunk is copied, when it is
+/// modified for the first time (either by non-const access to the item, or by
+/// non-const iterator). So copy of the vector is cheap and memory of copies grows
+/// with the count of modified chunks, not with the size of the vector. Interface
+/// mimics the std::vector. Const functions are thread safe. Non-const access to
+/// different items can be done from multiple threads only, if chunks are not
+/// shared with other vectors (for example, after call of \p detach function).
+template<typename T, size_t ChunkSizeLog2 = 10>
+class PDFChunkedVector
+{
+private:
+    using Chunk = std::vector<T>;
+    using ChunkPointer = std::shared_ptr<Chunk>;
+
+public:
+    static constexpr size_t CHUNK_SIZE = size_t(1) << ChunkSizeLog2;
+    static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+    template<bool IsConst>
+    class IteratorImpl
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = ptrdiff_t;
+        using value_type        = T;
+        using pointer           = std::conditional_t<IsConst, const T*, T*>;
+        using reference         = std::conditional_t<IsConst, const T&, T&>;
+
+        inline IteratorImpl() = default;
+        inline IteratorImpl(const std::vector<ChunkPointer>* chunks, size_t index) : m_chunks(chunks), m_index(index) { }
+
+        /// Non-const iterator can be converted to const iterator
+        template<bool OtherIsConst, typename = std::enable_if_t<IsConst && !OtherIsConst>>
+        inline IteratorImpl(const IteratorImpl<OtherIsConst>& other) : m_chunks(other.m_chunks), m_index(other.m_index) { }
+
+        inline reference operator*() const { return (*(*m_chunks)[m_index >> ChunkSizeLog2])[m_index & CHUNK_MASK]; }
+        inline pointer operator->() const { return &**this; }
+        inline reference operator[](difference_type offset) const { return *(*this + offset); }
+
+        inline bool operator==(const IteratorImpl& other) const { return m_index == other.m_index; }
+        inline bool operator!=(const IteratorImpl& other) const { return m_index != other.m_index; }
+        inline bool operator<(const IteratorImpl& other) const { return m_index < other.m_index; }
+        inline bool operator>(const IteratorImpl& other) const { return m_index > other.m_index; }
+        inline bool operator<=(const IteratorImpl& other) const { return m_index <= other.m_index; }
+        inline bool operator>=(const IteratorImpl& other) const { return m_index >= other.m_index; }
+
+        inline IteratorImpl& operator+=(difference_type movement) { m_index += movement; return *this; }
+        inline IteratorImpl& operator-=(difference_type movement) { m_index -= movement; return *this; }
+        inline IteratorImpl operator+(difference_type movement) const { return IteratorImpl(m_chunks, m_index + movement); }
+        inline IteratorImpl operator-(difference_type movement) const { return IteratorImpl(m_chunks, m_index - movement); }
+        inline difference_type operator-(const IteratorImpl& other) const { return difference_type(m_index) - difference_type(other.m_index); }
+        friend inline IteratorImpl operator+(difference_type movement, const IteratorImpl& iterator) { return iterator + movement; }
+
+        inline IteratorImpl& operator++() { ++m_index; return *this; }
+        inline IteratorImpl operator++(int) { IteratorImpl copy(*this); ++m_index; return copy; }
+        inline IteratorImpl& operator--() { --m_index; return *this; }
+        inline IteratorImpl operator--(int) { IteratorImpl copy(*this); --m_index; return copy; }
+
+    private:
+        template<bool>
+        friend class IteratorImpl;
+
+        const std::vector<ChunkPointer>* m_chunks = nullptr;
+        size_t m_index = 0;
+    };
+
+    using value_type = T;
+    using size_type = size_t;
+    using iterator = IteratorImpl<false>;
+    using const_iterator = IteratorImpl<true>;
+
+    inline PDFChunkedVector() = default;
+
+    inline PDFChunkedVector(const PDFChunkedVector&) = default;
+    inline PDFChunkedVector(PDFChunkedVector&& other) : m_chunks(std::move(other.m_chunks)), m_size(other.m_size) { other.clear(); }
+
+    inline PDFChunkedVector& operator=(const PDFChunkedVector&) = default;
+    inline PDFChunkedVector& operator=(PDFChunkedVector&& other) { if (this != &other) { m_chunks = std::move(other.m_chunks); m_size = other.m_size; other.clear(); } return *this; }
+
+    bool operator==(const PDFChunkedVector& other) const
+    {
+        if (m_size != other.m_size)
+        {
+            return false;
+        }
+
+        // Both vectors have the same size, so they have the same
+        // chunk layout, and shared chunks need not to be compared.
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            if (m_chunks[i] != other.m_chunks[i] && *m_chunks[i] != *other.m_chunks[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    inline bool operator!=(const PDFChunkedVector& other) const { return !(*this == other); }
+
+    inline size_t size() const { return m_size; }
+    inline bool empty() const { return m_size == 0; }
+    inline void clear() { m_chunks.clear(); m_size = 0; }
+    inline void reserve(size_t size) { m_chunks.reserve(getChunkCount(size)); }
+
+    inline const T& operator[](size_t index) const { return (*m_chunks[index >> ChunkSizeLog2])[index & CHUNK_MASK]; }
+    inline T& operator[](size_t index) { detachChunk(index >> ChunkSizeLog2); return (*m_chunks[index >> ChunkSizeLog2])[index & CHUNK_MASK]; }
+
+    inline const T& back() const { return (*this)[m_size - 1]; }
+    inline T& back() { return (*this)[m_size - 1]; }
+
+    inline const_iterator begin() const { return const_iterator(&m_chunks, 0); }
+    inline const_iterator end() const { return const_iterator(&m_chunks, m_size); }
+    inline const_iterator cbegin() const { return begin(); }
+    inline const_iterator cend() const { return end(); }
+
+    /// Non-const iterators can modify any item, so all chunks are detached
+    inline iterator begin() { detach(); return iterator(&m_chunks, 0); }
+    inline iterator end() { detach(); return iterator(&m_chunks, m_size); }
+
+    /// Returns item without detaching its chunk, so modification of the item is visible
+    /// in all vectors sharing the chunk. It can be used only for modifications, which
+    /// don't change the value of the item (for example, when item is populated on demand).
+    /// \param index Index of the item
+    inline T& getSharedItem(size_t index) const { return (*m_chunks[index >> ChunkSizeLog2])[index & CHUNK_MASK]; }
+
+    /// Returns true, if chunk containing given item is shared with other vector
+    /// \param index Index of the item
+    inline bool isShared(size_t index) const { return m_chunks[index >> ChunkSizeLog2].use_count() > 1; }
+
+    /// Returns true, if chunk containing given item is shared with the other vector,
+    /// so items of the whole chunk are the same in both vectors.
+    /// \param other Other vector
+    /// \param index Index of the item
+    inline bool isSharedWith(const PDFChunkedVector& other, size_t index) const
+    {
+        const size_t chunkIndex = index >> ChunkSizeLog2;
+        return chunkIndex < m_chunks.size() && chunkIndex < other.m_chunks.size() && m_chunks[chunkIndex] == other.m_chunks[chunkIndex];
+    }
+
+    template<typename... Arguments>
+    T& emplace_back(Arguments&&... arguments)
+    {
+        if ((m_size & CHUNK_MASK) == 0)
+        {
+            m_chunks.push_back(createChunk());
+        }
+        else
+        {
+            detachChunk(m_chunks.size() - 1);
+        }
+
+        ++m_size;
+        return m_chunks.back()->emplace_back(std::forward<Arguments>(arguments)...);
+    }
+
+    inline void push_back(const T& item) { emplace_back(item); }
+    inline void push_back(T&& item) { emplace_back(std::move(item)); }
+
+    void resize(size_t size)
+    {
+        if (size < m_size)
+        {
+            m_chunks.resize(getChunkCount(size));
+
+            if ((size & CHUNK_MASK) != 0)
+            {
+                detachChunk(m_chunks.size() - 1);
+                m_chunks.back()->resize(size & CHUNK_MASK);
+            }
+
+            m_size = size;
+        }
+
+        while (m_size < size)
+        {
+            const size_t chunkIndex = m_size >> ChunkSizeLog2;
+            if (chunkIndex == m_chunks.size())
+            {
+                m_chunks.push_back(createChunk());
+            }
+            else
+            {
+                detachChunk(chunkIndex);
+            }
+
+            Chunk& chunk = *m_chunks[chunkIndex];
+            const size_t count = std::min(size - m_size, CHUNK_SIZE - chunk.size());
+            chunk.resize(chunk.size() + count);
+            m_size += count;
+        }
+    }
+
+    /// Makes all chunks unique, so they are not shared with other vectors
+    void detach()
+    {
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            detachChunk(i);
+        }
+    }
+
+private:
+    static inline size_t getChunkCount(size_t size) { return (size + CHUNK_MASK) >> ChunkSizeLog2; }
+
+    static ChunkPointer createChunk()
+    {
+        ChunkPointer chunk = std::make_shared<Chunk>();
+        chunk->reserve(CHUNK_SIZE);
+        return chunk;
+    }
+
+    void detachChunk(size_t chunkIndex)
+    {
+        ChunkPointer& chunk = m_chunks[chunkIndex];
+        if (chunk.use_count() > 1)
+        {
+            ChunkPointer copy = createChunk();
+            copy->insert(copy->end(), chunk->cbegin(), chunk->cend());
+            chunk = std::move(copy);
+        }
+    }
+
+    std::vector<ChunkPointer> m_chunks;
+    size_t m_size = 0;
+};
+
 template<typename T>
 bool contains(T value, std::initializer_list<T> list)
 {
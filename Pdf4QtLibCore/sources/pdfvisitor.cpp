@@ -159,7 +159,8 @@ void PDFStatisticsCollector::collectStatisticsOfDictionary(Statistics& statistic
 
     for (size_t i = 0, count = dictionary->getCount(); i < count; ++i)
     {
-        if (!dictionary->getKey(i).isInplace())
+        // Interned names are shared by all dictionaries, so they do not consume memory of the dictionary
+        if (!dictionary->getKey(i).isInplace() && !dictionary->getKey(i).isInterned())
         {
             QByteArray key = dictionary->getKey(i).getString();
 
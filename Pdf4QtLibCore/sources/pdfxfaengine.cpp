@@ -26,6 +26,9 @@
 #include <QStringList>
 #include <QDateTime>
 #include <QImageReader>
+#include <QMutex>
+#include <QXmlStreamReader>
+#include <QStringDecoder>
 #include <QTextDocument>
 #include <QTextBlock>
 #include <QFontDatabase>
@@ -9853,10 +9856,36 @@ private:
                          QRectF nominalExtentArea,
                          QPainter* painter);
 
+    /// Namespace of the XFA template (followed by version)
+    static constexpr const char* XFA_TEMPLATE_NAMESPACE = "http://www.xfa.org/schema/xfa-template/";
+
+    /// Returns data of the template packet of the XDP document. Document is
+    /// scanned using the stream reader, so other packets (for example, datasets)
+    /// are skipped without building a DOM tree for them. Template packet is
+    /// the child element of the root in the XFA template namespace. Namespaces
+    /// declared by the root are declared by the returned packet too. If template
+    /// packet is not found, then empty byte array is returned.
+    /// \param xdpData Data of the XDP document
+    static QByteArray extractTemplatePacket(const QByteArray& xdpData);
+
+    /// Returns template packet of the XDP document parsed into the DOM, or
+    /// null element, if it is not found (see \p extractTemplatePacket).
+    /// \param xdpElement Root element of the XDP document
+    static QDomElement findTemplatePacket(const QDomElement& xdpElement);
+
+    /// Returns decoded image of the image value. Images are decoded
+    /// only once, because the form is drawn repeatedly (on each repaint
+    /// of the page), and decoded images are cached until the template
+    /// is cleared. Null image is returned, if image can't be decoded.
+    /// \param image Image value
+    QImage getDecodedImage(const xfa::XFA_image* image);
+
     xfa::XFA_Node<xfa::XFA_template> m_template;
     const PDFDocument* m_document;
     Layout m_layout;
     std::map<int, QByteArray> m_fonts;
+    QMutex m_decodedImagesMutex;
+    std::map<const xfa::XFA_image*, QImage> m_decodedImages;
 };
 
 class PDFXFALayoutEngine : public xfa::XFA_AbstractVisitor
@@ -10076,7 +10105,7 @@ private:
             else
             {
                 // Copy paragraph settings
-                LayoutParameters oldParameters = m_engine->m_layoutParameters.top();
+                const LayoutParameters& oldParameters = m_engine->m_layoutParameters.top();
                 LayoutParameters newParameters;
                 newParameters.paragraphSettings = oldParameters.paragraphSettings;
                 m_engine->m_layoutParameters.push(newParameters);
@@ -10410,7 +10439,9 @@ void PDFXFALayoutEngine::layoutFlow(LayoutParameters& layoutParameters, bool bre
                 }
 
                 sourceLayout.resize(QSizeF(width, rowHeights[rowIndex]));
-                finalLayout.items.insert(finalLayout.items.end(), sourceLayout.items.begin(), sourceLayout.items.end());
+                finalLayout.items.insert(finalLayout.items.end(),
+                                         std::make_move_iterator(sourceLayout.items.begin()),
+                                         std::make_move_iterator(sourceLayout.items.end()));
 
                 xOffset += width;
             }
@@ -10493,7 +10524,9 @@ void PDFXFALayoutEngine::layoutFlow(LayoutParameters& layoutParameters, bool bre
                     maxW = qMax(maxW, x);
                     maxH = qMax(maxH, layout.nominalExtent.height());
 
-                    finalLayout.items.insert(finalLayout.items.end(), layout.items.begin(), layout.items.end());
+                    finalLayout.items.insert(finalLayout.items.end(),
+                                             std::make_move_iterator(layout.items.begin()),
+                                             std::make_move_iterator(layout.items.end()));
                 }
 
                 finalizeAndAddLayout(captionMargins, finalLayout, layoutParameters, QSizeF(maxW, y));
@@ -10534,7 +10567,9 @@ void PDFXFALayoutEngine::layoutFlow(LayoutParameters& layoutParameters, bool bre
                     layout.translate(x, y);
 
                     maxH = qMax(maxH, layout.nominalExtent.height());
-                    finalLayout.items.insert(finalLayout.items.end(), layout.items.begin(), layout.items.end());
+                    finalLayout.items.insert(finalLayout.items.end(),
+                                             std::make_move_iterator(layout.items.begin()),
+                                             std::make_move_iterator(layout.items.end()));
                 }
 
                 finalizeAndAddLayout(captionMargins, finalLayout, layoutParameters, QSizeF(size.width(), y));
@@ -10604,7 +10639,9 @@ void PDFXFALayoutEngine::layoutFlow(LayoutParameters& layoutParameters, bool bre
                     }
 
                     layout.translate(x, y);
-                    finalLayout.items.insert(finalLayout.items.end(), layout.items.begin(), layout.items.end());
+                    finalLayout.items.insert(finalLayout.items.end(),
+                                             std::make_move_iterator(layout.items.begin()),
+                                             std::make_move_iterator(layout.items.end()));
                     y += layout.nominalExtent.height();
                     maxW = qMax(maxW, layout.nominalExtent.width());
                 }
@@ -10742,7 +10779,9 @@ bool PDFXFALayoutEngine::layoutPositional(LayoutParameters& sourceLayoutParamete
             }
 
             layout.translate(x, y);
-            finalLayout.items.insert(finalLayout.items.end(), layout.items.begin(), layout.items.end());
+            finalLayout.items.insert(finalLayout.items.end(),
+                                     std::make_move_iterator(layout.items.begin()),
+                                     std::make_move_iterator(layout.items.end()));
         }
 
         if (finalLayout.items.empty())
@@ -11649,7 +11688,9 @@ void PDFXFAEngineImpl::setDocument(const PDFModifiedDocument& document, PDFForm*
                     const PDFObject& xfaObject = m_document->getObject(form->getXFA());
                     updateResources(m_document->getObject(form->getResources()));
 
-                    std::map<QByteArray, QByteArray> xfaData;
+                    // Only template packet is used, other packets (for example,
+                    // datasets, which can be very large) are not decoded at all.
+                    QByteArray templateData;
                     if (xfaObject.isArray())
                     {
                         const PDFArray* xfaArrayData = xfaObject.getArray();
@@ -11660,19 +11701,32 @@ void PDFXFAEngineImpl::setDocument(const PDFModifiedDocument& document, PDFForm*
                             const PDFObject& itemName = m_document->getObject(xfaArrayData->getItem(2 * i + 0));
                             const PDFObject& streamObject = m_document->getObject(xfaArrayData->getItem(2 * i + 1));
 
-                            if (itemName.isString() && streamObject.isStream())
+                            if (itemName.isString() && itemName.getString() == "template" && streamObject.isStream())
                             {
-                                xfaData[itemName.getString()] = m_document->getDecodedStream(streamObject.getStream());
+                                templateData = m_document->getDecodedStream(streamObject.getStream());
                             }
                         }
                     }
                     else if (xfaObject.isStream())
                     {
-                        xfaData["template"] = m_document->getDecodedStream(xfaObject.getStream());
+                        const QByteArray xdpData = m_document->getDecodedStream(xfaObject.getStream());
+
+                        QDomDocument templateDocument;
+                        if (templateDocument.setContent(extractTemplatePacket(xdpData)))
+                        {
+                            m_template = xfa::XFA_template::parse(templateDocument.documentElement());
+                        }
+
+                        // If template packet can't be extracted, whole XDP document is parsed
+                        QDomDocument xdpDocument;
+                        if (!m_template.hasValue() && xdpDocument.setContent(xdpData))
+                        {
+                            m_template = xfa::XFA_template::parse(findTemplatePacket(xdpDocument.documentElement()));
+                        }
                     }
 
                     QDomDocument templateDocument;
-                    if (templateDocument.setContent(xfaData["template"]))
+                    if (!templateData.isEmpty() && templateDocument.setContent(templateData))
                     {
                         m_template = xfa::XFA_template::parse(templateDocument.firstChildElement("template"));
                     }
@@ -11909,26 +11963,12 @@ void PDFXFAEngineImpl::drawItemValue(const xfa::XFA_value* value,
         }
         else if (const xfa::XFA_image* image = value->getImage())
         {
-            QByteArray ba;
-            QString textValue = image->getNodeValue() ? *image->getNodeValue() : QString();
-
-            switch (image->getTransferEncoding())
+            if (image->getTransferEncoding() == pdf::xfa::XFA_BaseNode::TRANSFERENCODING1::Package)
             {
-                case pdf::xfa::XFA_BaseNode::TRANSFERENCODING1::Base64:
-                    ba = QByteArray::fromBase64(textValue.toLatin1());
-                    break;
-                case pdf::xfa::XFA_BaseNode::TRANSFERENCODING1::None:
-                    ba = textValue.toLatin1();
-                    break;
-                case pdf::xfa::XFA_BaseNode::TRANSFERENCODING1::Package:
-                    errors << PDFRenderError(RenderErrorType::NotImplemented, PDFTranslationContext::tr("Image encoded by 'package' mode not decoded."));
-                    break;
+                errors << PDFRenderError(RenderErrorType::NotImplemented, PDFTranslationContext::tr("Image encoded by 'package' mode not decoded."));
             }
 
-            QBuffer buffer(&ba);
-            QImageReader reader(&buffer);
-            reader.setDecideFormatFromContent(true);
-            QImage imageValue = reader.read();
+            QImage imageValue = getDecodedImage(image);
 
             if (!imageValue.isNull())
             {
@@ -13134,12 +13174,178 @@ void PDFXFAEngineImpl::drawItemRectEdges(const std::vector<xfa::XFA_Node<xfa::XF
     drawCorner(drawRect.bottomLeft(), cornerPens[CORNER_BOTTOM_LEFT_INDEX], 270, getCorner(CORNER_BOTTOM_LEFT_INDEX));
 }
 
+QByteArray PDFXFAEngineImpl::extractTemplatePacket(const QByteArray& xdpData)
+{
+    // Data are decoded to the text, so character offsets of the reader
+    // are positions in the text, and packet can be copied as it is.
+    QString encoding;
+    QXmlStreamReader declarationReader(xdpData);
+    if (declarationReader.readNext() == QXmlStreamReader::StartDocument)
+    {
+        encoding = declarationReader.documentEncoding().toString();
+    }
+
+    QStringDecoder decoder(encoding.isEmpty() ? "UTF-8" : encoding.toLatin1().constData());
+    if (!decoder.isValid())
+    {
+        return QByteArray();
+    }
+
+    const QString text = decoder.decode(xdpData);
+    if (decoder.hasError())
+    {
+        return QByteArray();
+    }
+
+    QXmlStreamReader reader(text);
+    QXmlStreamNamespaceDeclarations rootNamespaceDeclarations;
+    int depth = 0;
+
+    while (!reader.atEnd())
+    {
+        const qint64 tokenOffset = reader.characterOffset();
+
+        switch (reader.readNext())
+        {
+            case QXmlStreamReader::StartElement:
+            {
+                if (depth == 0)
+                {
+                    rootNamespaceDeclarations = reader.namespaceDeclarations();
+                    ++depth;
+                    break;
+                }
+
+                if (!reader.namespaceUri().startsWith(QLatin1String(XFA_TEMPLATE_NAMESPACE)))
+                {
+                    // Other packet (for example, datasets, or config, which
+                    // contains template element too), it is skipped.
+                    reader.skipCurrentElement();
+                    break;
+                }
+
+                const QString qualifiedName = reader.qualifiedName().toString();
+                const QXmlStreamNamespaceDeclarations namespaceDeclarations = reader.namespaceDeclarations();
+                reader.skipCurrentElement();
+
+                QString packet = text.mid(tokenOffset, reader.characterOffset() - tokenOffset);
+                if (reader.hasError() || !packet.startsWith(QString("<") + qualifiedName))
+                {
+                    return QByteArray();
+                }
+
+                // Prefixes declared by the root can be used in the packet
+                QString rootNamespaces;
+                for (const QXmlStreamNamespaceDeclaration& declaration : rootNamespaceDeclarations)
+                {
+                    auto isSamePrefix = [&declaration](const QXmlStreamNamespaceDeclaration& item) { return item.prefix() == declaration.prefix(); };
+                    if (std::any_of(namespaceDeclarations.cbegin(), namespaceDeclarations.cend(), isSamePrefix))
+                    {
+                        continue;
+                    }
+
+                    const QString namespaceUri = declaration.namespaceUri().toString().toHtmlEscaped();
+                    if (declaration.prefix().isEmpty())
+                    {
+                        rootNamespaces += QString(" xmlns=\"%1\"").arg(namespaceUri);
+                    }
+                    else
+                    {
+                        rootNamespaces += QString(" xmlns:%1=\"%2\"").arg(declaration.prefix().toString(), namespaceUri);
+                    }
+                }
+
+                packet.insert(1 + qualifiedName.size(), rootNamespaces);
+                return packet.toUtf8();
+            }
+
+            case QXmlStreamReader::EndElement:
+                --depth;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return QByteArray();
+}
+
+QDomElement PDFXFAEngineImpl::findTemplatePacket(const QDomElement& xdpElement)
+{
+    // DOM is built without namespace processing, so namespace
+    // of the element is found by its namespace declaration.
+    auto getNamespaceUri = [&xdpElement](const QDomElement& element)
+    {
+        const QString tagName = element.tagName();
+        const qsizetype colonIndex = tagName.indexOf(QLatin1Char(':'));
+        const QString namespaceAttribute = colonIndex == -1 ? QString("xmlns") : QString("xmlns:") + tagName.left(colonIndex);
+        return element.hasAttribute(namespaceAttribute) ? element.attribute(namespaceAttribute) : xdpElement.attribute(namespaceAttribute);
+    };
+
+    if (getNamespaceUri(xdpElement).startsWith(QLatin1String(XFA_TEMPLATE_NAMESPACE)))
+    {
+        // Template is stored without the XDP document
+        return xdpElement;
+    }
+
+    for (QDomElement element = xdpElement.firstChildElement(); !element.isNull(); element = element.nextSiblingElement())
+    {
+        if (getNamespaceUri(element).startsWith(QLatin1String(XFA_TEMPLATE_NAMESPACE)))
+        {
+            return element;
+        }
+    }
+
+    return QDomElement();
+}
+
+QImage PDFXFAEngineImpl::getDecodedImage(const xfa::XFA_image* image)
+{
+    QMutexLocker lock(&m_decodedImagesMutex);
+
+    auto it = m_decodedImages.find(image);
+    if (it != m_decodedImages.end())
+    {
+        return it->second;
+    }
+
+    QByteArray ba;
+    QString textValue = image->getNodeValue() ? *image->getNodeValue() : QString();
+
+    switch (image->getTransferEncoding())
+    {
+        case pdf::xfa::XFA_BaseNode::TRANSFERENCODING1::Base64:
+            ba = QByteArray::fromBase64(textValue.toLatin1());
+            break;
+        case pdf::xfa::XFA_BaseNode::TRANSFERENCODING1::None:
+            ba = textValue.toLatin1();
+            break;
+        case pdf::xfa::XFA_BaseNode::TRANSFERENCODING1::Package:
+            break;
+    }
+
+    QBuffer buffer(&ba);
+    QImageReader reader(&buffer);
+    reader.setDecideFormatFromContent(true);
+    QImage imageValue = reader.read();
+
+    // Null images are also stored, so we do not try to decode them again
+    m_decodedImages[image] = imageValue;
+    return imageValue;
+}
+
 void PDFXFAEngineImpl::clear()
 {
     // Clear the template
     m_template = xfa::XFA_Node<xfa::XFA_template>();
     m_layout = Layout();
 
+    {
+        QMutexLocker lock(&m_decodedImagesMutex);
+        m_decodedImages.clear();
+    }
+
     for (const auto& font : m_fonts)
     {
         QFontDatabase::removeApplicationFont(font.first);
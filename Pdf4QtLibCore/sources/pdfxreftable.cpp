@@ -27,6 +27,7 @@
 #include "pdfdbgheap.h"
 
 #include <stack>
+#include <limits>
 
 namespace pdf
 {
@@ -35,7 +36,8 @@ void PDFXRefTable::readXRefTable(PDFParsingContext* context, const QByteArray& b
 {
     PDFParser parser(byteArray, context, PDFParser::AllowStreams);
 
-    m_entries.clear();
+    m_values.clear();
+    m_generations.clear();
 
     std::set<PDFInteger> processedOffsets;
     std::stack<PDFInteger> workSet;
@@ -79,10 +81,7 @@ void PDFXRefTable::readXRefTable(PDFParsingContext* context, const QByteArray& b
                 const PDFInteger lastObjectIndex = firstObjectNumber + count - 1;
                 const PDFInteger desiredSize = lastObjectIndex + 1;
 
-                if (static_cast<PDFInteger>(m_entries.size()) < desiredSize)
-                {
-                    m_entries.resize(desiredSize);
-                }
+                ensureSize(desiredSize);
 
                 // Now, read the records
                 for (PDFInteger i = 0; i < count; ++i)
@@ -103,22 +102,14 @@ void PDFXRefTable::readXRefTable(PDFParsingContext* context, const QByteArray& b
                         throw PDFException(tr("Bad format of reference table entry."));
                     }
 
-                    if (static_cast<size_t>(objectNumber) >= m_entries.size())
+                    if (static_cast<size_t>(objectNumber) >= m_values.size())
                     {
                         throw PDFException(tr("Bad format of reference table entry."));
                     }
 
-                    Entry entry;
                     if (occupied)
                     {
-                        entry.reference = PDFObjectReference(objectNumber, generation.getInteger());
-                        entry.offset = offset.getInteger();
-                        entry.type = EntryType::Occupied;
-                    }
-
-                    if (m_entries[objectNumber].type == EntryType::Free)
-                    {
-                        m_entries[objectNumber] = std::move(entry);
+                        setEntry(objectNumber, EntryType::Occupied, offset.getInteger(), generation.getInteger());
                     }
                 }
             }
@@ -192,10 +183,7 @@ void PDFXRefTable::readXRefTable(PDFParsingContext* context, const QByteArray& b
                     }
 
                     const PDFInteger desiredSize = sizeObject.getInteger();
-                    if (static_cast<PDFInteger>(m_entries.size()) < desiredSize)
-                    {
-                        m_entries.resize(desiredSize);
-                    }
+                    ensureSize(desiredSize);
 
                     PDFObject prevObject = crossReferenceStreamDictionary->get("Prev");
                     if (prevObject.isInt())
@@ -290,16 +278,13 @@ void PDFXRefTable::readXRefTable(PDFParsingContext* context, const QByteArray& b
                         const PDFInteger lastObjectIndex = firstObjectNumber + count - 1;
                         const PDFInteger currentDesiredSize = lastObjectIndex + 1;
 
-                        if (static_cast<PDFInteger>(m_entries.size()) < currentDesiredSize)
-                        {
-                            m_entries.resize(currentDesiredSize);
-                        }
+                        ensureSize(currentDesiredSize);
 
                         for (PDFInteger objectNumber = firstObjectNumber; objectNumber <= lastObjectIndex; ++ objectNumber)
                         {
-                            int itemType = readNumber(columnTypeBytes, 1);
-                            int itemObjectNumberOfObjectStreamOrByteOffset = readNumber(columnObjectNumberOrByteOffsetBytes, 0);
-                            int itemGenerationNumberOrObjectIndex = readNumber(columnGenerationNumberOrObjectIndexBytes, 0);
+                            PDFInteger itemType = readNumber(columnTypeBytes, 1);
+                            PDFInteger itemObjectNumberOfObjectStreamOrByteOffset = readNumber(columnObjectNumberOrByteOffsetBytes, 0);
+                            PDFInteger itemGenerationNumberOrObjectIndex = readNumber(columnGenerationNumberOrObjectIndexBytes, 0);
 
                             switch (itemType)
                             {
@@ -308,34 +293,12 @@ void PDFXRefTable::readXRefTable(PDFParsingContext* context, const QByteArray& b
                                     break;
 
                                 case 1:
-                                {
-                                    Entry entry;
-                                    entry.reference = PDFObjectReference(objectNumber, itemGenerationNumberOrObjectIndex);
-                                    entry.offset = itemObjectNumberOfObjectStreamOrByteOffset;
-                                    entry.type = EntryType::Occupied;
-
-                                    if (m_entries[objectNumber].type == EntryType::Free)
-                                    {
-                                        m_entries[objectNumber] = std::move(entry);
-                                    }
+                                    setEntry(objectNumber, EntryType::Occupied, itemObjectNumberOfObjectStreamOrByteOffset, itemGenerationNumberOrObjectIndex);
                                     break;
-                                }
 
                                 case 2:
-                                {
-                                    Entry entry;
-                                    entry.reference = PDFObjectReference(objectNumber, 0);
-                                    entry.objectStream = PDFObjectReference(itemObjectNumberOfObjectStreamOrByteOffset, 0);
-                                    entry.indexInObjectStream = itemGenerationNumberOrObjectIndex;
-                                    entry.type = EntryType::InObjectStream;
-
-                                    if (m_entries[objectNumber].type == EntryType::Free)
-                                    {
-                                        m_entries[objectNumber] = std::move(entry);
-                                    }
-
+                                    setEntry(objectNumber, EntryType::InObjectStream, itemObjectNumberOfObjectStreamOrByteOffset, itemGenerationNumberOrObjectIndex);
                                     break;
-                                }
 
                                 default:
                                     // According to the specification, treat this object as null object
@@ -353,13 +316,56 @@ void PDFXRefTable::readXRefTable(PDFParsingContext* context, const QByteArray& b
     }
 }
 
+PDFXRefTable PDFXRefTable::createFromEntries(const std::vector<Entry>& entries, PDFObject trailerDictionary)
+{
+    PDFXRefTable table;
+    table.m_trailerDictionary = qMove(trailerDictionary);
+
+    PDFInteger desiredSize = 0;
+    for (const Entry& entry : entries)
+    {
+        desiredSize = qMax(desiredSize, entry.reference.objectNumber + 1);
+    }
+    table.ensureSize(desiredSize);
+
+    for (const Entry& entry : entries)
+    {
+        if (entry.reference.objectNumber < 0)
+        {
+            continue;
+        }
+
+        switch (entry.type)
+        {
+            case EntryType::Free:
+                break;
+
+            case EntryType::Occupied:
+                table.setEntry(entry.reference.objectNumber, EntryType::Occupied, entry.offset, entry.reference.generation);
+                break;
+
+            case EntryType::InObjectStream:
+                table.setEntry(entry.reference.objectNumber, EntryType::InObjectStream, entry.objectStream.objectNumber, entry.indexInObjectStream);
+                break;
+        }
+    }
+
+    return table;
+}
+
 std::vector<PDFXRefTable::Entry> PDFXRefTable::getOccupiedEntries() const
 {
     std::vector<PDFXRefTable::Entry> result;
 
     // Suppose majority of items are occupied
-    result.reserve(m_entries.size());
-    std::copy_if(m_entries.cbegin(), m_entries.cend(), std::back_inserter(result), [](const Entry& entry) { return entry.type == EntryType::Occupied; });
+    result.reserve(m_values.size());
+    for (size_t i = 0, count = m_values.size(); i < count; ++i)
+    {
+        if (getEntryType(i) == EntryType::Occupied)
+        {
+            result.push_back(getEntryAt(i));
+        }
+    }
 
     return result;
 }
@@ -369,23 +375,84 @@ std::vector<PDFXRefTable::Entry> PDFXRefTable::getObjectStreamEntries() const
     std::vector<PDFXRefTable::Entry> result;
 
     // Suppose majority of items are occupied
-    result.reserve(m_entries.size());
-    std::copy_if(m_entries.cbegin(), m_entries.cend(), std::back_inserter(result), [](const Entry& entry) { return entry.type == EntryType::InObjectStream; });
+    result.reserve(m_values.size());
+    for (size_t i = 0, count = m_values.size(); i < count; ++i)
+    {
+        if (getEntryType(i) == EntryType::InObjectStream)
+        {
+            result.push_back(getEntryAt(i));
+        }
+    }
 
     return result;
 }
 
-const PDFXRefTable::Entry& PDFXRefTable::getEntry(PDFObjectReference reference) const
+PDFXRefTable::Entry PDFXRefTable::getEntry(PDFObjectReference reference) const
 {
     // We must also check generation number here. For this reason, we compare references of the entry at given position.
-    if (reference.objectNumber >= 0 && reference.objectNumber < static_cast<PDFInteger>(m_entries.size()) && m_entries[reference.objectNumber].reference == reference)
+    if (reference.objectNumber >= 0 && reference.objectNumber < static_cast<PDFInteger>(m_values.size()))
+    {
+        Entry entry = getEntryAt(reference.objectNumber);
+        if (entry.reference == reference)
+        {
+            return entry;
+        }
+    }
+
+    return Entry();
+}
+
+PDFXRefTable::Entry PDFXRefTable::getEntryAt(size_t objectNumber) const
+{
+    Entry entry;
+    entry.type = getEntryType(objectNumber);
+
+    const PDFInteger value = static_cast<PDFInteger>(m_values[objectNumber] & VALUE_MASK);
+    const PDFInteger generationOrIndex = m_generations[objectNumber];
+
+    switch (entry.type)
+    {
+        case EntryType::Free:
+            break;
+
+        case EntryType::Occupied:
+            entry.reference = PDFObjectReference(static_cast<PDFInteger>(objectNumber), generationOrIndex);
+            entry.offset = value;
+            break;
+
+        case EntryType::InObjectStream:
+            entry.reference = PDFObjectReference(static_cast<PDFInteger>(objectNumber), 0);
+            entry.objectStream = PDFObjectReference(value, 0);
+            entry.indexInObjectStream = generationOrIndex;
+            break;
+    }
+
+    return entry;
+}
+
+void PDFXRefTable::setEntry(size_t objectNumber, EntryType type, PDFInteger value, PDFInteger generationOrIndex)
+{
+    if (getEntryType(objectNumber) != EntryType::Free)
+    {
+        return;
+    }
+
+    if (value < 0 || static_cast<quint64>(value) > VALUE_MASK || generationOrIndex < 0 || generationOrIndex > std::numeric_limits<quint32>::max())
     {
-        return m_entries[reference.objectNumber];
+        // Entry can't be represented, object can't be read anyway
+        return;
     }
-    else
+
+    m_values[objectNumber] = (static_cast<quint64>(type) << TYPE_SHIFT) | static_cast<quint64>(value);
+    m_generations[objectNumber] = static_cast<quint32>(generationOrIndex);
+}
+
+void PDFXRefTable::ensureSize(PDFInteger desiredSize)
+{
+    if (static_cast<PDFInteger>(m_values.size()) < desiredSize)
     {
-        static Entry dummy;
-        return dummy;
+        m_values.resize(desiredSize, 0);
+        m_generations.resize(desiredSize, 0);
     }
 }
 
@@ -68,6 +68,14 @@ public:
     /// \param startTableOffset Offset of first reference table
     void readXRefTable(PDFParsingContext* context, const QByteArray& byteArray, PDFInteger startTableOffset);
 
+    /// Creates reference table from entries, which were not read from the reference
+    /// table of the document (for example, reference table rebuilt during restoration
+    /// of damaged document). Free entries and entries, which can't be represented,
+    /// are ignored. If more entries have same object number, first one is used.
+    /// \param entries Entries of the reference table
+    /// \param trailerDictionary Trailer dictionary
+    static PDFXRefTable createFromEntries(const std::vector<Entry>& entries, PDFObject trailerDictionary);
+
     /// Filters only occupied entries and returns them
     std::vector<Entry> getOccupiedEntries() const;
 
@@ -75,18 +83,48 @@ public:
     std::vector<Entry> getObjectStreamEntries() const;
 
     /// Returns size of the reference table
-    std::size_t getSize() const { return m_entries.size(); }
+    std::size_t getSize() const { return m_values.size(); }
 
     /// Gets the entry for given reference. If entry for given reference is not found,
     /// then free entry is returned.
-    const Entry& getEntry(PDFObjectReference reference) const;
+    Entry getEntry(PDFObjectReference reference) const;
 
     /// Returns the trailer dictionary
     const PDFObject& getTrailerDictionary() const { return m_trailerDictionary; }
 
 private:
-    /// Reference table entries
-    std::vector<Entry> m_entries;
+    static constexpr int TYPE_SHIFT = 48;
+    static constexpr quint64 VALUE_MASK = (quint64(1) << TYPE_SHIFT) - 1;
+
+    /// Returns type of the entry at given object number
+    EntryType getEntryType(size_t objectNumber) const { return static_cast<EntryType>(m_values[objectNumber] >> TYPE_SHIFT); }
+
+    /// Returns entry at given object number
+    Entry getEntryAt(size_t objectNumber) const;
+
+    /// Sets the entry at given object number, if the entry is free (entries
+    /// from newer reference tables, which are read first, are not overwritten).
+    /// Entries with values (offsets, object numbers) out of range are ignored.
+    /// \param objectNumber Object number
+    /// \param type Type of the entry
+    /// \param value Offset of the object or object number of the object stream
+    /// \param generationOrIndex Generation number or index in the object stream
+    void setEntry(size_t objectNumber, EntryType type, PDFInteger value, PDFInteger generationOrIndex);
+
+    /// Resizes the table, if it is smaller than the desired size
+    void ensureSize(PDFInteger desiredSize);
+
+    // Jakub Melka: Entries are stored in compact form (struct of arrays), because
+    // tables can have millions of entries. Lower 48 bits of the value contain
+    // offset of the object, or object number of the object stream, upper bits
+    // contain type of the entry. Second array contains generation number, or
+    // object index in the object stream. Whole table scans touch only the arrays.
+
+    /// Types and values of reference table entries
+    std::vector<quint64> m_values;
+
+    /// Generation numbers (or indices in object streams) of entries
+    std::vector<quint32> m_generations;
 
     /// Trailer dictionary
     PDFObject m_trailerDictionary;
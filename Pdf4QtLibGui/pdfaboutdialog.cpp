@@ -53,6 +53,13 @@ PDFAboutDialog::PDFAboutDialog(QWidget* parent) :
         ui->tableWidget->setItem(i, 3, new QTableWidgetItem(info.url));
     }
 
+    ui->startupTraceTableWidget->setColumnCount(2);
+    ui->startupTraceTableWidget->setHorizontalHeaderLabels(QStringList() << tr("Phase") << tr("Time [ms]"));
+    ui->startupTraceTableWidget->setEditTriggers(QTableWidget::NoEditTriggers);
+    ui->startupTraceTableWidget->setSelectionMode(QTableView::SingleSelection);
+    ui->startupTraceTableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    setStartupTrace({ });
+
     pdf::PDFWidgetUtils::scaleWidget(this, QSize(750, 600));
     pdf::PDFWidgetUtils::style(this);
 }
@@ -62,4 +69,30 @@ PDFAboutDialog::~PDFAboutDialog()
     delete ui;
 }
 
+void PDFAboutDialog::setStartupTrace(const std::vector<std::pair<QString, qint64>>& startupTrace)
+{
+    const bool isVisible = !startupTrace.empty();
+    ui->startupTraceLabel->setVisible(isVisible);
+    ui->startupTraceTableWidget->setVisible(isVisible);
+
+    // Last row contains total startup time
+    const int rowCount = isVisible ? int(startupTrace.size()) + 1 : 0;
+    ui->startupTraceTableWidget->setRowCount(rowCount);
+
+    qint64 totalTime = 0;
+    for (int i = 0; i < int(startupTrace.size()); ++i)
+    {
+        const auto& phase = startupTrace[i];
+        ui->startupTraceTableWidget->setItem(i, 0, new QTableWidgetItem(phase.first));
+        ui->startupTraceTableWidget->setItem(i, 1, new QTableWidgetItem(QString::number(phase.second)));
+        totalTime += phase.second;
+    }
+
+    if (isVisible)
+    {
+        ui->startupTraceTableWidget->setItem(rowCount - 1, 0, new QTableWidgetItem(tr("Total")));
+        ui->startupTraceTableWidget->setItem(rowCount - 1, 1, new QTableWidgetItem(QString::number(totalTime)));
+    }
+}
+
 }   // namespace viewer
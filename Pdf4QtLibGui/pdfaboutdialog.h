@@ -20,6 +20,8 @@
 
 #include <QDialog>
 
+#include <vector>
+
 namespace Ui
 {
 class PDFAboutDialog;
@@ -36,6 +38,11 @@ public:
     explicit PDFAboutDialog(QWidget* parent = nullptr);
     virtual ~PDFAboutDialog() override;
 
+    /// Sets startup trace, i.e. durations of the startup phases of the
+    /// application in milliseconds. If trace is empty, it is not displayed.
+    /// \param startupTrace Startup trace
+    void setStartupTrace(const std::vector<std::pair<QString, qint64>>& startupTrace);
+
 private:
     Ui::PDFAboutDialog* ui;
 };
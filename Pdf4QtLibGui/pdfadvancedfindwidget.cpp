@@ -23,6 +23,7 @@
 #include "pdfdrawspacecontroller.h"
 
 #include <QMessageBox>
+#include <QtConcurrent/QtConcurrent>
 
 #include "pdfdbgheap.h"
 
@@ -48,6 +49,7 @@ PDFAdvancedFindWidget::PDFAdvancedFindWidget(pdf::PDFDrawWidgetProxy* proxy, QWi
 
 PDFAdvancedFindWidget::~PDFAdvancedFindWidget()
 {
+    cancelSearch();
     delete ui;
 }
 
@@ -61,6 +63,7 @@ void PDFAdvancedFindWidget::setDocument(const pdf::PDFModifiedDocument& document
         // so, there is no need to clear the results.
         if (document.hasReset() || document.hasPageContentsChanged())
         {
+            cancelSearch();
             m_findResults.clear();
             updateUI();
             updateResultsUI();
@@ -124,6 +127,7 @@ void PDFAdvancedFindWidget::on_searchButton_clicked()
         }
     }
 
+    cancelSearch();
     m_findResults.clear();
     m_textSelection.dirty();
     updateResultsUI();
@@ -141,6 +145,7 @@ void PDFAdvancedFindWidget::on_searchButton_clicked()
 
 void PDFAdvancedFindWidget::on_clearButton_clicked()
 {
+    cancelSearch();
     m_parameters = SearchParameters();
     m_findResults.clear();
     updateResultsUI();
@@ -172,12 +177,12 @@ void PDFAdvancedFindWidget::updateUI()
     ui->regularExpressionSettingsGroupBox->setEnabled(enableRegularExpressionUI);
 }
 
-void PDFAdvancedFindWidget::updateResultsUI()
+void PDFAdvancedFindWidget::updateResultsUI(size_t firstResultIndex)
 {
     ui->tabWidget->setTabText(ui->tabWidget->indexOf(ui->resultsTab), !m_findResults.empty() ? tr("Results (%1)").arg(m_findResults.size()) : tr("Results"));
     ui->resultsTableWidget->setRowCount(static_cast<int>(m_findResults.size()));
 
-    for (int i = 0, rowCount = int(m_findResults.size()); i < rowCount; ++i)
+    for (int i = int(firstResultIndex), rowCount = int(m_findResults.size()); i < rowCount; ++i)
     {
         const pdf::PDFFindResult& findResult = m_findResults[i];
         ui->resultsTableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(findResult.textSelectionItems.front().first.pageIndex + 1)));
@@ -185,7 +190,7 @@ void PDFAdvancedFindWidget::updateResultsUI()
         ui->resultsTableWidget->setItem(i, 2, new QTableWidgetItem(findResult.context));
     }
 
-    if (!m_findResults.empty())
+    if (!m_findResults.empty() && firstResultIndex == 0)
     {
         ui->tabWidget->setCurrentWidget(ui->resultsTab);
     }
@@ -274,7 +279,25 @@ void PDFAdvancedFindWidget::performSearch()
         }
 
         QRegularExpression regularExpression(expression, patternOptions);
-        m_findResults = textLayoutStorage->find(regularExpression, flowFlags);
+
+        // Regular expression search can take a long time on large documents,
+        // so it is performed in the background. Text layout storage is copied,
+        // because compiler can discard its text layouts, while search is running.
+        cancelSearch();
+        m_findResults.clear();
+        m_isSearchCancelled = false;
+
+        const int searchId = ++m_searchId;
+        auto storage = std::make_shared<pdf::PDFTextLayoutStorage>(*textLayoutStorage);
+        auto search = [this, storage, regularExpression, flowFlags, searchId]()
+        {
+            auto onResults = [this, searchId](pdf::PDFFindResults results)
+            {
+                QMetaObject::invokeMethod(this, [this, searchId, results]() { onSearchResultsReady(searchId, results); }, Qt::QueuedConnection);
+            };
+            storage->find(regularExpression, flowFlags, onResults, this);
+        };
+        m_searchFuture = QtConcurrent::run(search);
     }
 
     m_textSelection.dirty();
@@ -283,6 +306,35 @@ void PDFAdvancedFindWidget::performSearch()
     updateResultsUI();
 }
 
+void PDFAdvancedFindWidget::cancelSearch()
+{
+    // Results, which are already queued, are discarded too
+    ++m_searchId;
+    m_isSearchCancelled = true;
+    m_searchFuture.waitForFinished();
+}
+
+bool PDFAdvancedFindWidget::isOperationCancelled() const
+{
+    return m_isSearchCancelled;
+}
+
+void PDFAdvancedFindWidget::onSearchResultsReady(int searchId, pdf::PDFFindResults results)
+{
+    if (searchId != m_searchId || results.empty())
+    {
+        return;
+    }
+
+    const size_t firstResultIndex = m_findResults.size();
+    m_findResults.insert(m_findResults.end(), std::make_move_iterator(results.begin()), std::make_move_iterator(results.end()));
+
+    m_textSelection.dirty();
+    m_proxy->repaintNeeded();
+
+    updateResultsUI(firstResultIndex);
+}
+
 pdf::PDFTextSelection PDFAdvancedFindWidget::getTextSelectionImpl() const
 {
     pdf::PDFTextSelection result;
@@ -21,9 +21,13 @@
 #include "pdfglobal.h"
 #include "pdfdrawspacecontroller.h"
 #include "pdftextlayout.h"
+#include "pdfoperationcontrol.h"
 
+#include <QFuture>
 #include <QWidget>
 
+#include <atomic>
+
 namespace Ui
 {
 class PDFAdvancedFindWidget;
@@ -38,7 +42,7 @@ class PDFDrawWidgetProxy;
 namespace pdfviewer
 {
 
-class PDFAdvancedFindWidget : public QWidget, public pdf::IDocumentDrawInterface
+class PDFAdvancedFindWidget : public QWidget, public pdf::IDocumentDrawInterface, public pdf::PDFOperationControl
 {
     Q_OBJECT
 
@@ -62,6 +66,9 @@ public:
     /// but those, which are selected rows in the result table)
     pdf::PDFTextSelection getSelectedText() const;
 
+    /// Returns true, if running regular expression search is cancelled
+    virtual bool isOperationCancelled() const override;
+
 protected:
     virtual void showEvent(QShowEvent* event) override;
     virtual void hideEvent(QHideEvent* event) override;
@@ -75,9 +82,17 @@ private slots:
 
 private:
     void updateUI();
-    void updateResultsUI();
+    void updateResultsUI(size_t firstResultIndex = 0);
     void performSearch();
 
+    /// Cancels running regular expression search and waits until it is finished
+    void cancelSearch();
+
+    /// Appends results of the running regular expression search
+    /// \param searchId Identifier of the search delivering the results
+    /// \param results Results (in page order)
+    void onSearchResultsReady(int searchId, pdf::PDFFindResults results);
+
     pdf::PDFTextSelection getTextSelection() const { return m_textSelection.get(this, &PDFAdvancedFindWidget::getTextSelectionImpl); }
     pdf::PDFTextSelection getTextSelectionImpl() const;
 
@@ -100,6 +115,13 @@ private:
     SearchParameters m_parameters;
     pdf::PDFFindResults m_findResults;
     mutable pdf::PDFCachedItem<pdf::PDFTextSelection> m_textSelection;
+
+    /// Regular expression search is performed in the background, results
+    /// are delivered incrementally. Results of the cancelled searches
+    /// are discarded using search identifier.
+    QFuture<void> m_searchFuture;
+    std::atomic_bool m_isSearchCancelled = false;
+    int m_searchId = 0;
 };
 
 }   // namespace pdfviewer
@@ -324,7 +324,7 @@ void PDFBookmarkManager::regenerateAutoBookmarks()
                     pdf::PDFDestination destination = typedAction->getDestination();
                     if (destination.getDestinationType() == pdf::DestinationType::Named)
                     {
-                        if (const pdf::PDFDestination* targetDestination = m_document->getCatalog()->getNamedDestination(destination.getName()))
+                        if (std::optional<pdf::PDFDestination> targetDestination = m_document->getCatalog()->getNamedDestination(destination.getName(), &m_document->getStorage()))
                         {
                             destination = *targetDestination;
                         }
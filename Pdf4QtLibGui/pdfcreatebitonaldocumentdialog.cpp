@@ -19,13 +19,7 @@
 #include "ui_pdfcreatebitonaldocumentdialog.h"
 
 #include "pdfwidgetutils.h"
-#include "pdfdocumentwriter.h"
-#include "pdfimage.h"
-#include "pdfexception.h"
-#include "pdfwidgetutils.h"
-#include "pdfimageconversion.h"
-#include "pdfstreamfilters.h"
-#include "pdfutils.h"
+#include "pdfexecutionpolicy.h"
 
 #include <QCheckBox>
 #include <QPushButton>
@@ -38,6 +32,8 @@
 #include <QMouseEvent>
 #include <QToolTip>
 
+#include <numeric>
+
 #include "pdfdbgheap.h"
 
 namespace pdfviewer
@@ -214,6 +210,7 @@ PDFCreateBitonalDocumentDialog::PDFCreateBitonalDocumentDialog(const pdf::PDFDoc
     m_processed(false),
     m_leftPreviewWidget(new PDFCreateBitonalDocumentPreviewWidget(this)),
     m_rightPreviewWidget(new PDFCreateBitonalDocumentPreviewWidget(this)),
+    m_convertor(document),
     m_progress(progress)
 {
     ui->setupUi(this);
@@ -224,8 +221,7 @@ PDFCreateBitonalDocumentDialog::PDFCreateBitonalDocumentDialog(const pdf::PDFDoc
     ui->mainGridLayout->addWidget(m_leftPreviewWidget, 1, 1);
     ui->mainGridLayout->addWidget(m_rightPreviewWidget, 1, 2);
 
-    m_classifier.classify(document);
-    m_imageReferences = m_classifier.getObjectsByType(pdf::PDFObjectClassifier::Image);
+    m_imageReferences = m_convertor.getImageReferences();
 
     m_createBitonalDocumentButton = ui->buttonBox->addButton(tr("Perform"), QDialogButtonBox::ActionRole);
     connect(m_createBitonalDocumentButton, &QPushButton::clicked, this, &PDFCreateBitonalDocumentDialog::onCreateBitonalDocumentButtonClicked);
@@ -266,8 +262,14 @@ void PDFCreateBitonalDocumentDialog::onPerformFinished()
 
 void PDFCreateBitonalDocumentDialog::createBitonalDocument()
 {
-    std::vector<ImageConversionInfo> imagesToBeConverted;
-    std::copy_if(m_imagesToBeConverted.begin(), m_imagesToBeConverted.end(), std::back_inserter(imagesToBeConverted), [](const auto& item) { return item.conversionEnabled; });
+    std::vector<pdf::PDFObjectReference> imagesToBeConverted;
+    for (const ImageConversionInfo& info : m_imagesToBeConverted)
+    {
+        if (info.conversionEnabled)
+        {
+            imagesToBeConverted.push_back(info.imageReference);
+        }
+    }
 
     // Do we have something to be converted?
     if (imagesToBeConverted.empty())
@@ -275,89 +277,7 @@ void PDFCreateBitonalDocumentDialog::createBitonalDocument()
         return;
     }
 
-    pdf::ProgressStartupInfo info;
-    info.showDialog = true;
-    info.text = tr("Converting images...");
-    m_progress->start(imagesToBeConverted.size(),  std::move(info));
-
-    pdf::PDFObjectStorage storage = m_document->getStorage();
-
-    pdf::PDFCMSGeneric genericCms;
-    pdf::PDFRenderErrorReporterDummy errorReporter;
-
-    for (int i = 0; i < imagesToBeConverted.size(); ++i)
-    {
-        pdf::PDFObjectReference reference = imagesToBeConverted[i].imageReference;
-        std::optional<pdf::PDFImage> pdfImage = getImageFromReference(reference);
-
-        QImage image;
-        try
-        {
-            image = pdfImage->getImage(&genericCms, &errorReporter, nullptr);
-        }
-        catch (pdf::PDFException)
-        {
-            // Do nothing
-        }
-
-        // Just for code safety - this should never occur in here.
-        if (image.isNull())
-        {
-            continue;
-        }
-
-        pdf::PDFImageConversion imageConversion;
-        imageConversion.setConversionMethod(m_conversionMethod);
-        imageConversion.setThreshold(m_manualThreshold);
-        imageConversion.setImage(image);
-
-        if (imageConversion.convert())
-        {
-            QImage bitonalImage = imageConversion.getConvertedImage();
-            Q_ASSERT(bitonalImage.format() == QImage::Format_Mono);
-
-            pdf::PDFBitWriter bitWriter(1);
-            bitWriter.reserve(bitonalImage.sizeInBytes());
-            for (int row = 0; row < bitonalImage.height(); ++row)
-            {
-                for (int col = 0; col < bitonalImage.width(); ++col)
-                {
-                    QRgb pixelValue = bitonalImage.pixel(col, row);
-                    QRgb withoutAlphaValue = pixelValue & 0xFFFFFF;
-                    int value = withoutAlphaValue > 0 ? 1 : 0;
-                    bitWriter.write(value);
-                }
-
-                bitWriter.finishLine();
-            }
-
-            QByteArray imageData = bitWriter.takeByteArray();
-            QByteArray compressedData = pdf::PDFFlateDecodeFilter::compress(imageData);
-
-            pdf::PDFArray array;
-            array.appendItem(pdf::PDFObject::createName("FlateDecode"));
-
-            pdf::PDFDictionary dictionary;
-            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Type"), pdf::PDFObject::createName("XObject"));
-            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Subtype"), pdf::PDFObject::createName("Image"));
-            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Width"), pdf::PDFObject::createInteger(image.width()));
-            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Height"), pdf::PDFObject::createInteger(image.height()));
-            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("ColorSpace"), pdf::PDFObject::createName("DeviceGray"));
-            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("BitsPerComponent"), pdf::PDFObject::createInteger(1));
-            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Predictor"), pdf::PDFObject::createInteger(1));
-            dictionary.setEntry(pdf::PDFInplaceOrMemoryString("Length"), pdf::PDFObject::createInteger(compressedData.size()));
-            dictionary.setEntry(pdf::PDFInplaceOrMemoryString("Filter"), pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(qMove(array))));
-
-            pdf::PDFObject imageObject = pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(compressedData)));
-            storage.setObject(reference, std::move(imageObject));
-        }
-
-        m_progress->step();
-    }
-
-    m_bitonalDocument = pdf::PDFDocument(std::move(storage), m_document->getInfo()->version, QByteArray());
-
-    m_progress->finish();
+    m_bitonalDocument = m_convertor.convert(imagesToBeConverted, m_settings, m_progress);
 }
 
 void PDFCreateBitonalDocumentDialog::onCreateBitonalDocumentButtonClicked()
@@ -365,8 +285,8 @@ void PDFCreateBitonalDocumentDialog::onCreateBitonalDocumentButtonClicked()
     Q_ASSERT(!m_conversionInProgress);
     Q_ASSERT(!m_future.isRunning());
 
-    m_conversionMethod = ui->automaticThresholdRadioButton->isChecked() ? pdf::PDFImageConversion::ConversionMethod::Automatic : pdf::PDFImageConversion::ConversionMethod::Manual;
-    m_manualThreshold = ui->thresholdEditBox->value();
+    m_settings.conversionMethod = ui->automaticThresholdRadioButton->isChecked() ? pdf::PDFImageConversion::ConversionMethod::Automatic : pdf::PDFImageConversion::ConversionMethod::Manual;
+    m_settings.threshold = ui->thresholdEditBox->value();
 
     m_conversionInProgress = true;
     m_future = QtConcurrent::run([this]() { createBitonalDocument(); });
@@ -382,41 +302,37 @@ void PDFCreateBitonalDocumentDialog::loadImages()
     ui->imageListWidget->setIconSize(iconSize);
     QSize imageSize = iconSize * ui->imageListWidget->devicePixelRatioF();
 
-    for (pdf::PDFObjectReference reference : m_imageReferences)
-    {
-        std::optional<pdf::PDFImage> pdfImage = getImageFromReference(reference);
-        if (!pdfImage)
-        {
-            continue;
-        }
-
-        pdf::PDFCMSGeneric genericCms;
-        pdf::PDFRenderErrorReporterDummy errorReporter;
-        QImage image;
+    // Decode icons in parallel (in reduced resolution, if possible)
+    std::vector<QImage> images(m_imageReferences.size());
+    std::vector<size_t> indices(m_imageReferences.size(), 0);
+    std::iota(indices.begin(), indices.end(), 0);
 
-        try
-        {
-            image = pdfImage->getImage(&genericCms, &errorReporter, nullptr);
-        }
-        catch (pdf::PDFException)
+    auto loadImage = [&](size_t index)
+    {
+        QImage image = m_convertor.getImage(m_imageReferences[index], imageSize);
+        if (!image.isNull())
         {
-            // Do nothing
+            images[index] = image.scaled(imageSize.width(), imageSize.height(), Qt::KeepAspectRatio, Qt::FastTransformation);
         }
+    };
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, indices.cbegin(), indices.cend(), loadImage);
 
+    for (size_t i = 0; i < m_imageReferences.size(); ++i)
+    {
+        const QImage& image = images[i];
         if (image.isNull())
         {
             continue;
         }
 
         QListWidgetItem* item = new QListWidgetItem(ui->imageListWidget);
-        image = image.scaled(imageSize.width(), imageSize.height(), Qt::KeepAspectRatio, Qt::FastTransformation);
         item->setIcon(QIcon(QPixmap::fromImage(image)));
         Qt::ItemFlags flags = item->flags();
         flags.setFlag(Qt::ItemIsEditable, true);
         item->setFlags(flags);
 
         ImageConversionInfo imageConversionInfo;
-        imageConversionInfo.imageReference = reference;
+        imageConversionInfo.imageReference = m_imageReferences[i];
         imageConversionInfo.conversionEnabled = true;
         m_imagesToBeConverted.push_back(imageConversionInfo);
     }
@@ -442,68 +358,28 @@ void PDFCreateBitonalDocumentDialog::updatePreview()
     {
         const ImageConversionInfo& info = m_imagesToBeConverted.at(index.row());
 
-        std::optional<pdf::PDFImage> pdfImage = getImageFromReference(info.imageReference);
-        Q_ASSERT(pdfImage);
-
-        pdf::PDFCMSGeneric cmsGeneric;
-        pdf::PDFRenderErrorReporterDummy reporter;
-        QImage image = pdfImage->getImage(&cmsGeneric, &reporter, nullptr);
-
-        pdf::PDFImageConversion imageConversion;
-        imageConversion.setConversionMethod(ui->automaticThresholdRadioButton->isChecked() ? pdf::PDFImageConversion::ConversionMethod::Automatic : pdf::PDFImageConversion::ConversionMethod::Manual);
-        imageConversion.setThreshold(ui->thresholdEditBox->value());
-        imageConversion.setImage(image);
-
-        if (imageConversion.convert())
+        // Preview is computed from downsampled image, so it is fast even for large scans
+        const QSize previewSize = m_leftPreviewWidget->size() * m_leftPreviewWidget->devicePixelRatioF();
+        QImage image = m_convertor.getImage(info.imageReference, previewSize);
+        if (!image.isNull() && previewSize.isValid() && (image.width() > previewSize.width() || image.height() > previewSize.height()))
         {
-            m_previewImageLeft = image;
-            m_previewImageRight = imageConversion.getConvertedImage();
+            image = image.scaled(previewSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
         }
-    }
 
-    m_leftPreviewWidget->setImage(m_previewImageLeft);
-    m_rightPreviewWidget->setImage(m_previewImageRight);
-}
-
-std::optional<pdf::PDFImage> PDFCreateBitonalDocumentDialog::getImageFromReference(pdf::PDFObjectReference reference) const
-{
-    std::optional<pdf::PDFImage> pdfImage;
-    pdf::PDFObject imageObject = m_document->getObjectByReference(reference);
-    pdf::PDFRenderErrorReporterDummy errorReporter;
-
-    if (!imageObject.isStream())
-    {
-        // Image is not stream
-        return pdfImage;
-    }
+        pdf::PDFBitonalDocumentConvertor::Settings settings;
+        settings.conversionMethod = ui->automaticThresholdRadioButton->isChecked() ? pdf::PDFImageConversion::ConversionMethod::Automatic : pdf::PDFImageConversion::ConversionMethod::Manual;
+        settings.threshold = ui->thresholdEditBox->value();
 
-    const pdf::PDFStream* stream = imageObject.getStream();
-    try
-    {
-        pdf::PDFColorSpacePointer colorSpace;
-        const pdf::PDFDictionary* streamDictionary = stream->getDictionary();
-        if (streamDictionary->hasKey("ColorSpace"))
+        QImage bitonalImage = pdf::PDFBitonalDocumentConvertor::convertImage(image, settings);
+        if (!bitonalImage.isNull())
         {
-            const pdf::PDFObject& colorSpaceObject = m_document->getObject(streamDictionary->get("ColorSpace"));
-            if (colorSpaceObject.isName() || colorSpaceObject.isArray())
-            {
-                pdf::PDFDictionary dummyDictionary;
-                colorSpace = pdf::PDFAbstractColorSpace::createColorSpace(&dummyDictionary, m_document, colorSpaceObject);
-            }
+            m_previewImageLeft = qMove(image);
+            m_previewImageRight = qMove(bitonalImage);
         }
-        pdfImage.emplace(pdf::PDFImage::createImage(m_document,
-                                                    stream,
-                                                    colorSpace,
-                                                    false,
-                                                    pdf::RenderingIntent::Perceptual,
-                                                    &errorReporter));
-    }
-    catch (pdf::PDFException)
-    {
-        // Do nothing
     }
 
-    return pdfImage;
+    m_leftPreviewWidget->setImage(m_previewImageLeft);
+    m_rightPreviewWidget->setImage(m_previewImageRight);
 }
 
 }   // namespace pdfviewer
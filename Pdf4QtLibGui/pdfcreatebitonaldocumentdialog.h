@@ -20,9 +20,7 @@
 
 #include "pdfcms.h"
 #include "pdfdocument.h"
-#include "pdfobjectutils.h"
-#include "pdfimage.h"
-#include "pdfimageconversion.h"
+#include "pdfbitonaldocumentconvertor.h"
 #include "pdfprogress.h"
 
 #include <QDialog>
@@ -83,8 +81,6 @@ private:
     void updateUi();
     void updatePreview();
 
-    std::optional<pdf::PDFImage> getImageFromReference(pdf::PDFObjectReference reference) const;
-
     Ui::PDFCreateBitonalDocumentDialog* ui;
     const pdf::PDFDocument* m_document;
     const pdf::PDFCMS* m_cms;
@@ -94,7 +90,7 @@ private:
     QFuture<void> m_future;
     std::optional<QFutureWatcher<void>> m_futureWatcher;
     pdf::PDFDocument m_bitonalDocument;
-    pdf::PDFObjectClassifier m_classifier;
+    pdf::PDFBitonalDocumentConvertor m_convertor;
     std::vector<pdf::PDFObjectReference> m_imageReferences;
     std::vector<ImageConversionInfo> m_imagesToBeConverted;
 
@@ -106,8 +102,7 @@ private:
 
     pdf::PDFProgress* m_progress;
 
-    pdf::PDFImageConversion::ConversionMethod m_conversionMethod = pdf::PDFImageConversion::ConversionMethod::Automatic;
-    int m_manualThreshold = 128;
+    pdf::PDFBitonalDocumentConvertor::Settings m_settings;
 };
 
 }   // namespace pdfviewer
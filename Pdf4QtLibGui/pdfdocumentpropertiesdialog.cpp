@@ -295,11 +295,16 @@ void PDFDocumentPropertiesDialog::initializeFonts(const pdf::PDFDocument* docume
     {
         pdf::PDFInteger pageCount = document->getCatalog()->getPageCount();
 
-        QMutex fontTreeItemMutex;
-        QMutex usedFontReferencesMutex;
-        std::set<pdf::PDFObjectReference> usedFontReferences;
+        // Fonts used on the pages are collected in parallel and merged, so each
+        // font object is realized only once, even if it is used on many pages.
+        struct FontUsage
+        {
+            pdf::PDFObject object;
+            QByteArray key;
+        };
 
-        auto processPage = [&](pdf::PDFInteger pageIndex)
+        std::vector<std::vector<FontUsage>> pageFontUsages(pageCount);
+        auto collectPageFonts = [&](pdf::PDFInteger pageIndex)
         {
             try
             {
@@ -308,110 +313,10 @@ void PDFDocumentPropertiesDialog::initializeFonts(const pdf::PDFDocument* docume
                 {
                     if (const pdf::PDFDictionary* fontsDictionary = document->getDictionaryFromObject(resourcesDictionary->get("Font")))
                     {
-                        // Iterate trough each font
                         const size_t fontsCount = fontsDictionary->getCount();
                         for (size_t i = 0; i < fontsCount; ++i)
                         {
-                            pdf::PDFObject object = fontsDictionary->getValue(i);
-                            if (object.isReference())
-                            {
-                                // Check, if we have not processed the object. If we have it processed,
-                                // then do nothing, otherwise insert it into the processed objects.
-                                // We must also use mutex, because we use multithreading.
-                                QMutexLocker lock(&usedFontReferencesMutex);
-                                if (usedFontReferences.count(object.getReference()))
-                                {
-                                    continue;
-                                }
-                                else
-                                {
-                                    usedFontReferences.insert(object.getReference());
-                                }
-                            }
-
-                            try
-                            {
-                                if (pdf::PDFFontPointer font = pdf::PDFFont::createFont(object, document))
-                                {
-                                    pdf::PDFRenderErrorReporterDummy dummyReporter;
-                                    pdf::PDFRealizedFontPointer realizedFont = pdf::PDFRealizedFont::createRealizedFont(font, 8.0, &dummyReporter);
-                                    if (realizedFont)
-                                    {
-                                        const pdf::FontType fontType = font->getFontType();
-                                        const pdf::FontDescriptor* fontDescriptor = font->getFontDescriptor();
-                                        QString fontName = fontDescriptor->fontName;
-
-                                        // Try to remove characters from +, if we have font name 'SDFDSF+ValidFontName'
-                                        int plusPos = fontName.lastIndexOf('+');
-                                        if (plusPos != -1 && plusPos < fontName.size() - 1)
-                                        {
-                                            fontName = fontName.mid(plusPos + 1);
-                                        }
-
-                                        if (fontName.isEmpty())
-                                        {
-                                            fontName = QString::fromLatin1(fontsDictionary->getKey(i).getString());
-                                        }
-
-                                        std::unique_ptr<QTreeWidgetItem> fontRootItemPtr = std::make_unique<QTreeWidgetItem>(QStringList({ fontName }));
-                                        QTreeWidgetItem* fontRootItem = fontRootItemPtr.get();
-
-                                        QString fontTypeString;
-                                        switch (fontType)
-                                        {
-                                            case pdf::FontType::TrueType:
-                                                fontTypeString = tr("TrueType");
-                                                break;
-
-                                            case pdf::FontType::Type0:
-                                                fontTypeString = tr("Type0 (CID keyed)");
-                                                break;
-
-                                            case pdf::FontType::Type1:
-                                                fontTypeString = tr("Type1 (8 bit keyed)");
-                                                break;
-
-                                            case pdf::FontType::MMType1:
-                                                fontTypeString = tr("MMType1 (8 bit keyed)");
-                                                break;
-
-                                            case pdf::FontType::Type3:
-                                                fontTypeString = tr("Type3 (content streams for font glyphs)");
-                                                break;
-
-                                            default:
-                                                Q_ASSERT(false);
-                                                break;
-                                        }
-
-                                        new QTreeWidgetItem(fontRootItem, { tr("Type"), fontTypeString });
-                                        if (!fontDescriptor->fontFamily.isEmpty())
-                                        {
-                                            new QTreeWidgetItem(fontRootItem, { tr("Font family"), fontDescriptor->fontFamily });
-                                        }
-
-                                        new QTreeWidgetItem(fontRootItem, { tr("Embedded subset"), fontDescriptor->getEmbeddedFontData() ? tr("Yes") : tr("No") });
-
-                                        PDFTreeFactory treeFactory1(fontRootItem);
-                                        font->dumpFontToTreeItem(&treeFactory1);
-
-                                        PDFTreeFactory treeFactory2(fontRootItem);
-                                        realizedFont->dumpFontToTreeItem(&treeFactory2);
-
-                                        // Separator item
-                                        new QTreeWidgetItem(fontRootItem, QStringList());
-
-                                        // Finally add the tree item
-                                        QMutexLocker lock(&fontTreeItemMutex);
-                                        m_fontTreeWidgetItems.push_back(fontRootItemPtr.release());
-                                    }
-                                }
-                            }
-                            catch (const pdf::PDFException &)
-                            {
-                                // Do nothing, some error occured, continue with next font
-                                continue;
-                            }
+                            pageFontUsages[pageIndex].push_back(FontUsage{ fontsDictionary->getValue(i), fontsDictionary->getKey(i).getString() });
                         }
                     }
                 }
@@ -423,7 +328,120 @@ void PDFDocumentPropertiesDialog::initializeFonts(const pdf::PDFDocument* docume
         };
 
         pdf::PDFIntegerRange<pdf::PDFInteger> indices(pdf::PDFInteger(0), pageCount);
-        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), processPage);
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), collectPageFonts);
+
+        std::vector<FontUsage> fontUsages;
+        std::set<pdf::PDFObjectReference> usedFontReferences;
+        for (std::vector<FontUsage>& pageFontUsage : pageFontUsages)
+        {
+            for (FontUsage& usage : pageFontUsage)
+            {
+                if (!usage.object.isReference() || usedFontReferences.insert(usage.object.getReference()).second)
+                {
+                    fontUsages.emplace_back(qMove(usage));
+                }
+            }
+        }
+        pageFontUsages.clear();
+
+        std::vector<QTreeWidgetItem*> fontTreeWidgetItems(fontUsages.size(), nullptr);
+        auto processFont = [&](size_t fontIndex)
+        {
+            const FontUsage& usage = fontUsages[fontIndex];
+
+            try
+            {
+                if (pdf::PDFFontPointer font = pdf::PDFFont::createFont(usage.object, document))
+                {
+                    pdf::PDFRenderErrorReporterDummy dummyReporter;
+                    pdf::PDFRealizedFontPointer realizedFont = pdf::PDFRealizedFont::createRealizedFont(font, 8.0, &dummyReporter);
+                    if (realizedFont)
+                    {
+                        const pdf::FontType fontType = font->getFontType();
+                        const pdf::FontDescriptor* fontDescriptor = font->getFontDescriptor();
+                        QString fontName = fontDescriptor->fontName;
+
+                        // Try to remove characters from +, if we have font name 'SDFDSF+ValidFontName'
+                        int plusPos = fontName.lastIndexOf('+');
+                        if (plusPos != -1 && plusPos < fontName.size() - 1)
+                        {
+                            fontName = fontName.mid(plusPos + 1);
+                        }
+
+                        if (fontName.isEmpty())
+                        {
+                            fontName = QString::fromLatin1(usage.key);
+                        }
+
+                        std::unique_ptr<QTreeWidgetItem> fontRootItemPtr = std::make_unique<QTreeWidgetItem>(QStringList({ fontName }));
+                        QTreeWidgetItem* fontRootItem = fontRootItemPtr.get();
+
+                        QString fontTypeString;
+                        switch (fontType)
+                        {
+                            case pdf::FontType::TrueType:
+                                fontTypeString = tr("TrueType");
+                                break;
+
+                            case pdf::FontType::Type0:
+                                fontTypeString = tr("Type0 (CID keyed)");
+                                break;
+
+                            case pdf::FontType::Type1:
+                                fontTypeString = tr("Type1 (8 bit keyed)");
+                                break;
+
+                            case pdf::FontType::MMType1:
+                                fontTypeString = tr("MMType1 (8 bit keyed)");
+                                break;
+
+                            case pdf::FontType::Type3:
+                                fontTypeString = tr("Type3 (content streams for font glyphs)");
+                                break;
+
+                            default:
+                                Q_ASSERT(false);
+                                break;
+                        }
+
+                        new QTreeWidgetItem(fontRootItem, { tr("Type"), fontTypeString });
+                        if (!fontDescriptor->fontFamily.isEmpty())
+                        {
+                            new QTreeWidgetItem(fontRootItem, { tr("Font family"), fontDescriptor->fontFamily });
+                        }
+
+                        new QTreeWidgetItem(fontRootItem, { tr("Embedded subset"), fontDescriptor->getEmbeddedFontData() ? tr("Yes") : tr("No") });
+
+                        PDFTreeFactory treeFactory1(fontRootItem);
+                        font->dumpFontToTreeItem(&treeFactory1);
+
+                        PDFTreeFactory treeFactory2(fontRootItem);
+                        realizedFont->dumpFontToTreeItem(&treeFactory2);
+
+                        // Separator item
+                        new QTreeWidgetItem(fontRootItem, QStringList());
+
+                        // Finally add the tree item, each font has its own slot
+                        fontTreeWidgetItems[fontIndex] = fontRootItemPtr.release();
+                    }
+                }
+            }
+            catch (const pdf::PDFException &)
+            {
+                // Do nothing, some error occured, continue with next font
+            }
+        };
+
+        pdf::PDFIntegerRange<size_t> fontIndices(0, fontUsages.size());
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, fontIndices.begin(), fontIndices.end(), processFont);
+
+        for (QTreeWidgetItem* item : fontTreeWidgetItems)
+        {
+            if (item)
+            {
+                m_fontTreeWidgetItems.push_back(item);
+            }
+        }
     };
     m_future = QtConcurrent::run(createFontInfo);
     connect(&m_futureWatcher, &QFutureWatcher<void>::finished, this, &PDFDocumentPropertiesDialog::onFontsFinished);
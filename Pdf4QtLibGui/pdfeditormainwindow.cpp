@@ -161,6 +161,7 @@ PDFEditorMainWindow::PDFEditorMainWindow(QWidget* parent) :
     m_actionManager->setAction(PDFActionManager::RenderOptionIgnoreOptionalContentSettings, ui->actionRenderOptionIgnoreOptionalContentSettings);
     m_actionManager->setAction(PDFActionManager::RenderOptionDisplayRenderTimes, ui->actionRenderOptionDisplayRenderTimes);
     m_actionManager->setAction(PDFActionManager::RenderOptionDisplayAnnotations, ui->actionRenderOptionDisplayAnnotations);
+    m_actionManager->setAction(PDFActionManager::RenderOptionSimulateOverprint, ui->actionRenderOptionSimulateOverprint);
     m_actionManager->setAction(PDFActionManager::RenderOptionInvertColors, ui->actionColorInvert);
     m_actionManager->setAction(PDFActionManager::RenderOptionGrayscale, ui->actionColorGrayscale);
     m_actionManager->setAction(PDFActionManager::RenderOptionHighContrast, ui->actionColorHighContrast);
@@ -185,6 +186,8 @@ PDFEditorMainWindow::PDFEditorMainWindow(QWidget* parent) :
     m_actionManager->setAction(PDFActionManager::FitWidth, ui->actionFitWidth);
     m_actionManager->setAction(PDFActionManager::FitHeight, ui->actionFitHeight);
     m_actionManager->setAction(PDFActionManager::ShowRenderingErrors, ui->actionRendering_Errors);
+    m_actionManager->setAction(PDFActionManager::RecordPerformanceTrace, ui->actionRecordPerformanceTrace);
+    m_actionManager->setAction(PDFActionManager::ShowRuntimeStatistics, ui->actionRuntimeStatistics);
     m_actionManager->setAction(PDFActionManager::PageLayoutSinglePage, ui->actionPageLayoutSinglePage);
     m_actionManager->setAction(PDFActionManager::PageLayoutContinuous, ui->actionPageLayoutContinuous);
     m_actionManager->setAction(PDFActionManager::PageLayoutTwoPages, ui->actionPageLayoutTwoPages);
@@ -450,7 +453,7 @@ void PDFEditorMainWindow::updateUI(bool fullUpdate)
             // Prefetch pages, if it is enabled
             if (m_programController->getSettings()->isPagePrefetchingEnabled())
             {
-                m_programController->getPdfWidget()->getDrawWidgetProxy()->prefetchPages(currentPages.back());
+                m_programController->getPdfWidget()->getDrawWidgetProxy()->prefetchPages(currentPages.front(), currentPages.back());
             }
         }
 
@@ -500,6 +503,21 @@ void PDFEditorMainWindow::setDocument(const pdf::PDFModifiedDocument& document)
     }
 }
 
+void PDFEditorMainWindow::setSignatures(const std::vector<pdf::PDFSignatureVerificationResult>& signatures)
+{
+    if (m_sidebarWidget)
+    {
+        // Sidebar was hidden, if it was empty, so we show it, if it contains signatures now
+        const bool wasEmpty = m_sidebarWidget->isEmpty();
+        m_sidebarWidget->setSignatures(signatures);
+
+        if (wasEmpty && !m_sidebarWidget->isEmpty())
+        {
+            m_sidebarDockWidget->show();
+        }
+    }
+}
+
 void PDFEditorMainWindow::adjustToolbar(QToolBar* toolbar)
 {
     QSize iconSize = pdf::PDFWidgetUtils::scaleDPI(this, QSize(24, 24));
@@ -0,0 +1,249 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfhttprangesource.h"
+
+#include <QWaitCondition>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QNetworkAccessManager>
+
+#include "pdfdbgheap.h"
+
+namespace pdfviewer
+{
+
+PDFHttpRangeSource::PDFHttpRangeSource(QUrl url) :
+    m_url(qMove(url)),
+    m_networkAccessManager(new QNetworkAccessManager())
+{
+    m_networkAccessManager->moveToThread(&m_thread);
+    QObject::connect(&m_thread, &QThread::finished, m_networkAccessManager, &QObject::deleteLater);
+    m_thread.start();
+}
+
+PDFHttpRangeSource::~PDFHttpRangeSource()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+qint64 PDFHttpRangeSource::getSize()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_sizeDetermined)
+        {
+            return m_size;
+        }
+    }
+
+    QMutex mutex;
+    QWaitCondition waitCondition;
+    bool finished = false;
+    qint64 size = -1;
+    bool rangeRequestsSupported = false;
+    QByteArray identity;
+    QString errorMessage;
+
+    // Size is determined by a HEAD request. Some servers don't report content
+    // length in response to HEAD request, then we try to request first byte
+    // and parse total size from the Content-Range header.
+    auto determineSize = [&, this]()
+    {
+        auto finish = [&]()
+        {
+            QMutexLocker lock(&mutex);
+            finished = true;
+            waitCondition.wakeAll();
+        };
+
+        QNetworkReply* headReply = m_networkAccessManager->head(QNetworkRequest(m_url));
+        QObject::connect(headReply, &QNetworkReply::finished, headReply, [&, this, headReply, finish]()
+        {
+            headReply->deleteLater();
+
+            if (headReply->error() == QNetworkReply::NoError)
+            {
+                size = headReply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+                identity = readIdentity(headReply);
+                rangeRequestsSupported = headReply->rawHeader("Accept-Ranges").trimmed().toLower() == "bytes";
+
+                if (size > 0 && rangeRequestsSupported)
+                {
+                    finish();
+                    return;
+                }
+            }
+
+            QNetworkRequest probeRequest(m_url);
+            probeRequest.setRawHeader("Range", "bytes=0-0");
+            QNetworkReply* probeReply = m_networkAccessManager->get(probeRequest);
+            QObject::connect(probeReply, &QNetworkReply::finished, probeReply, [&, probeReply, finish]()
+            {
+                probeReply->deleteLater();
+
+                if (probeReply->error() == QNetworkReply::NoError)
+                {
+                    if (identity.isEmpty())
+                    {
+                        identity = readIdentity(probeReply);
+                    }
+
+                    const int statusCode = probeReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                    if (statusCode == 206)
+                    {
+                        // Content-Range: bytes 0-0/size
+                        const QByteArray contentRange = probeReply->rawHeader("Content-Range");
+                        const qsizetype slashPosition = contentRange.lastIndexOf('/');
+                        bool ok = false;
+                        const qint64 totalSize = slashPosition != -1 ? contentRange.mid(slashPosition + 1).trimmed().toLongLong(&ok) : -1;
+                        if (ok && totalSize > 0)
+                        {
+                            size = totalSize;
+                            rangeRequestsSupported = true;
+                        }
+                    }
+                    else if (size <= 0)
+                    {
+                        const qint64 contentLength = probeReply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+                        size = contentLength > 0 ? contentLength : probeReply->readAll().size();
+                    }
+                }
+                else
+                {
+                    errorMessage = probeReply->errorString();
+                }
+
+                finish();
+            });
+        });
+    };
+    QMetaObject::invokeMethod(m_networkAccessManager, determineSize, Qt::QueuedConnection);
+
+    {
+        QMutexLocker lock(&mutex);
+        while (!finished)
+        {
+            waitCondition.wait(&mutex);
+        }
+    }
+
+    if (!errorMessage.isEmpty())
+    {
+        setErrorMessage(errorMessage);
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_size = size > 0 ? size : -1;
+    m_rangeRequestsSupported = rangeRequestsSupported;
+    m_identity = qMove(identity);
+    m_sizeDetermined = true;
+    return m_size;
+}
+
+QByteArray PDFHttpRangeSource::getIdentity()
+{
+    getSize();
+
+    QMutexLocker lock(&m_mutex);
+    return m_identity;
+}
+
+QByteArray PDFHttpRangeSource::readIdentity(const QNetworkReply* reply)
+{
+    const QByteArray entityTag = reply->rawHeader("ETag").trimmed();
+    const QByteArray lastModified = reply->rawHeader("Last-Modified").trimmed();
+
+    if (entityTag.isEmpty() && lastModified.isEmpty())
+    {
+        return QByteArray();
+    }
+
+    return reply->url().toEncoded() + "\n" + entityTag + "\n" + lastModified;
+}
+
+void PDFHttpRangeSource::requestRange(qint64 offset, qint64 length, Callback callback)
+{
+    auto sendRequest = [this, offset, length, callback = qMove(callback)]()
+    {
+        QNetworkRequest request(m_url);
+        request.setRawHeader("Range", QString("bytes=%1-%2").arg(offset).arg(offset + length - 1).toLatin1());
+
+        QNetworkReply* reply = m_networkAccessManager->get(request);
+        QObject::connect(reply, &QNetworkReply::finished, reply, [this, reply, offset, length, callback]()
+        {
+            reply->deleteLater();
+
+            if (reply->error() != QNetworkReply::NoError)
+            {
+                setErrorMessage(reply->errorString());
+                callback(false, QByteArray());
+                return;
+            }
+
+            QByteArray data = reply->readAll();
+            const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            switch (statusCode)
+            {
+                case 206:
+                    // Partial content, we have exactly what we have requested
+                    break;
+
+                case 0:
+                case 200:
+                    // Server ignored range request and sent whole document
+                    data = data.mid(offset, length);
+                    break;
+
+                default:
+                    data.clear();
+                    break;
+            }
+
+            if (data.size() != length)
+            {
+                setErrorMessage(pdf::PDFTranslationContext::tr("Invalid response from the server (HTTP status %1).").arg(statusCode));
+                callback(false, QByteArray());
+                return;
+            }
+
+            callback(true, qMove(data));
+        });
+    };
+    QMetaObject::invokeMethod(m_networkAccessManager, qMove(sendRequest), Qt::QueuedConnection);
+}
+
+QString PDFHttpRangeSource::getErrorMessage() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_errorMessage;
+}
+
+bool PDFHttpRangeSource::isRangeRequestsSupported() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_rangeRequestsSupported;
+}
+
+void PDFHttpRangeSource::setErrorMessage(QString errorMessage)
+{
+    QMutexLocker lock(&m_mutex);
+    m_errorMessage = qMove(errorMessage);
+}
+
+}   // namespace pdfviewer
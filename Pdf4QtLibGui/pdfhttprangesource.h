@@ -0,0 +1,79 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFHTTPRANGESOURCE_H
+#define PDFHTTPRANGESOURCE_H
+
+#include "pdfviewerglobal.h"
+#include "pdfrandomaccesssource.h"
+
+#include <QUrl>
+#include <QMutex>
+#include <QThread>
+
+class QNetworkReply;
+class QNetworkAccessManager;
+
+namespace pdfviewer
+{
+
+/// Random access source fetching data from the HTTP(S) server using range
+/// requests. Requests are processed in the separate thread, so they can be
+/// processed concurrently. If server doesn't support range requests, then
+/// whole document is downloaded for each request, so such source should be
+/// used only with servers supporting range requests.
+class PDF4QTLIBGUILIBSHARED_EXPORT PDFHttpRangeSource : public pdf::PDFRandomAccessSource
+{
+public:
+    explicit PDFHttpRangeSource(QUrl url);
+    virtual ~PDFHttpRangeSource() override;
+
+    virtual qint64 getSize() override;
+    virtual QByteArray getIdentity() override;
+    virtual void requestRange(qint64 offset, qint64 length, Callback callback) override;
+
+    /// Returns error message of the last failed request
+    QString getErrorMessage() const;
+
+    /// Returns true, if server announced support of range requests
+    bool isRangeRequestsSupported() const;
+
+private:
+    void setErrorMessage(QString errorMessage);
+
+    /// Returns identity of the resource (entity tag and last modification
+    /// time), or empty byte array, if server doesn't provide them.
+    /// \param reply Network reply
+    static QByteArray readIdentity(const QNetworkReply* reply);
+
+    QUrl m_url;
+    QThread m_thread;
+
+    /// Network access manager, lives in the network thread
+    QNetworkAccessManager* m_networkAccessManager;
+
+    mutable QMutex m_mutex;
+    QString m_errorMessage;
+    QByteArray m_identity;
+    qint64 m_size = -1;
+    bool m_sizeDetermined = false;
+    bool m_rangeRequestsSupported = false;
+};
+
+}   // namespace pdfviewer
+
+#endif // PDFHTTPRANGESOURCE_H
@@ -35,7 +35,7 @@ PDFOptimizeDocumentDialog::PDFOptimizeDocumentDialog(const pdf::PDFDocument* doc
     QDialog(parent),
     ui(new Ui::PDFOptimizeDocumentDialog),
     m_document(document),
-    m_optimizer(pdf::PDFOptimizer::All, nullptr),
+    m_optimizer(pdf::PDFOptimizer::AllLossless, nullptr),
     m_optimizeButton(nullptr),
     m_optimizationInProgress(false),
     m_wasOptimized(false)
@@ -56,6 +56,12 @@ PDFOptimizeDocumentDialog::PDFOptimizeDocumentDialog(const pdf::PDFDocument* doc
     addCheckBox(tr("Merge identical objects"), pdf::PDFOptimizer::MergeIdenticalObjects);
     addCheckBox(tr("Shrink object storage (squeeze free entries)"), pdf::PDFOptimizer::ShrinkObjectStorage);
     addCheckBox(tr("Recompress flate streams by maximal compression"), pdf::PDFOptimizer::RecompressFlateStreams);
+    addCheckBox(tr("Downsample images above 150 DPI (lossy)"), pdf::PDFOptimizer::DownsampleImages);
+    addCheckBox(tr("Recompress images by JPEG (lossy)"), pdf::PDFOptimizer::RecompressImages);
+    addCheckBox(tr("Convert black and white images to 1 bit per pixel"), pdf::PDFOptimizer::ConvertMonochromeImages);
+    addCheckBox(tr("Merge images with identical pixels"), pdf::PDFOptimizer::MergeIdenticalImages);
+    addCheckBox(tr("Merge identical embedded font programs and font subsets"), pdf::PDFOptimizer::MergeIdenticalFonts);
+    addCheckBox(tr("Optimize page content streams"), pdf::PDFOptimizer::OptimizeContentStreams);
 
     m_optimizeButton = ui->buttonBox->addButton(tr("Optimize"), QDialogButtonBox::ActionRole);
 
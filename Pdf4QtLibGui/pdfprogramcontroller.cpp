@@ -37,13 +37,16 @@
 #include "pdfviewersettingsdialog.h"
 #include "pdfaboutdialog.h"
 #include "pdfrenderingerrorswidget.h"
+#include "pdfruntimestatisticsdialog.h"
 #include "pdfsendmail.h"
 #include "pdfrecentfilemanager.h"
 #include "pdftexttospeech.h"
 #include "pdfencryptionsettingsdialog.h"
+#include "pdfhttprangesource.h"
 #include "pdfwidgetannotation.h"
 #include "pdfwidgetformmanager.h"
 #include "pdfactioncombobox.h"
+#include "pdftrace.h"
 
 #include <QMenu>
 #include <QPrinter>
@@ -59,6 +62,8 @@
 #include <QXmlStreamWriter>
 #include <QMenuBar>
 #include <QComboBox>
+#include <QStandardPaths>
+#include <QTimer>
 
 #include "pdfdbgheap.h"
 
@@ -152,6 +157,7 @@ std::vector<QAction*> PDFActionManager::getRenderingOptionActions() const
          RenderOptionIgnoreOptionalContentSettings,
          RenderOptionDisplayRenderTimes,
          RenderOptionDisplayAnnotations,
+         RenderOptionSimulateOverprint,
          RenderOptionInvertColors,
          RenderOptionGrayscale,
          RenderOptionBitonal,
@@ -268,6 +274,7 @@ void PDFActionManager::initActions(QSize iconSize, bool initializeStampActions)
     setUserData(RenderOptionIgnoreOptionalContentSettings, pdf::PDFRenderer::IgnoreOptionalContent);
     setUserData(RenderOptionDisplayRenderTimes, pdf::PDFRenderer::DisplayTimes);
     setUserData(RenderOptionDisplayAnnotations, pdf::PDFRenderer::DisplayAnnotations);
+    setUserData(RenderOptionSimulateOverprint, pdf::PDFRenderer::OverprintSimulation);
     setUserData(RenderOptionInvertColors, pdf::PDFRenderer::ColorAdjust_Invert);
     setUserData(RenderOptionGrayscale, pdf::PDFRenderer::ColorAdjust_Grayscale);
     setUserData(RenderOptionBitonal, pdf::PDFRenderer::ColorAdjust_Bitonal);
@@ -365,16 +372,21 @@ PDFProgramController::PDFProgramController(QObject* parent) :
     m_textToSpeech(nullptr),
     m_isDocumentSetInProgress(false),
     m_futureWatcher(nullptr),
+    m_signatureFutureWatcher(nullptr),
     m_CMSManager(new pdf::PDFCMSManager(this)),
     m_toolManager(nullptr),
     m_annotationManager(nullptr),
     m_formManager(nullptr),
     m_bookmarkManager(nullptr),
     m_actionComboBox(nullptr),
+    m_isCertificateStoreLoaded(false),
     m_isBusy(false),
     m_isFactorySettingsBeingRestored(false),
-    m_progress(nullptr)
+    m_progress(nullptr),
+    m_isPluginLoadingPending(false),
+    m_startupPhaseStart(0)
 {
+    m_startupTimer.start();
     connect(&m_fileWatcher, &QFileSystemWatcher::fileChanged, this, &PDFProgramController::onFileChanged);
 }
 
@@ -532,6 +544,14 @@ void PDFProgramController::initialize(Features features,
     {
         connect(action, &QAction::triggered, this, &PDFProgramController::onActionRenderingErrorsTriggered);
     }
+    if (QAction* action = m_actionManager->getAction(PDFActionManager::RecordPerformanceTrace))
+    {
+        connect(action, &QAction::toggled, this, &PDFProgramController::onActionRecordPerformanceTraceToggled);
+    }
+    if (QAction* action = m_actionManager->getAction(PDFActionManager::ShowRuntimeStatistics))
+    {
+        connect(action, &QAction::triggered, this, &PDFProgramController::onActionRuntimeStatisticsTriggered);
+    }
     if (QAction* action = m_actionManager->getAction(PDFActionManager::PageLayoutSinglePage))
     {
         connect(action, &QAction::triggered, this, &PDFProgramController::onActionPageLayoutSinglePageTriggered);
@@ -623,11 +643,16 @@ void PDFProgramController::initialize(Features features,
         }
     }
 
-    readSettings(Settings(GeneralSettings | PluginsSettings | RecentFileSettings | CertificateSettings));
+    // Jakub Melka: Trusted certificates are not loaded here, they are loaded,
+    // when they are needed for the first time (signature verification, options dialog).
+    readSettings(Settings(GeneralSettings | PluginsSettings | RecentFileSettings));
+    addStartupPhase(tr("Read settings"));
 
     m_pdfWidget = new pdf::PDFWidget(m_CMSManager, m_settings->getRendererEngine(), m_mainWindow);
     m_pdfWidget->setObjectName("pdfWidget");
     m_pdfWidget->updateCacheLimits(m_settings->getCompiledPageCacheLimit() * 1024, m_settings->getThumbnailsCacheLimit(), m_settings->getFontCacheLimit(), m_settings->getInstancedFontCacheLimit());
+    m_pdfWidget->getDrawWidgetProxy()->setDiskCacheLimit(qint64(m_settings->getDiskCacheLimit()) * 1024 * 1024);
+    m_pdfWidget->getDrawWidgetProxy()->setNonBlockingPaintEnabled(m_settings->isNonBlockingPaintEnabled());
     m_pdfWidget->getDrawWidgetProxy()->setProgress(m_progress);
 
     connect(this, &PDFProgramController::queryPasswordRequest, this, &PDFProgramController::onQueryPasswordRequest, Qt::BlockingQueuedConnection);
@@ -636,6 +661,7 @@ void PDFProgramController::initialize(Features features,
     connect(m_pdfWidget, &pdf::PDFWidget::pageRenderingErrorsChanged, this, &PDFProgramController::onPageRenderingErrorsChanged, Qt::QueuedConnection);
     connect(m_settings, &PDFViewerSettings::settingsChanged, this, &PDFProgramController::onViewerSettingsChanged);
     connect(m_CMSManager, &pdf::PDFCMSManager::colorManagementSystemChanged, this, &PDFProgramController::onColorManagementSystemChanged);
+    addStartupPhase(tr("Create document view"));
 
     if (features.testFlag(TextToSpeech))
     {
@@ -668,9 +694,14 @@ void PDFProgramController::initialize(Features features,
         updateUndoRedoSettings();
     }
 
+    addStartupPhase(tr("Initialize managers"));
+
     if (features.testFlag(Plugins))
     {
-        loadPlugins();
+        // Jakub Melka: Plugins are loaded after the main window is shown, so loading
+        // of the plugin libraries doesn't delay displaying of the main window.
+        m_isPluginLoadingPending = true;
+        QTimer::singleShot(0, this, &PDFProgramController::loadDeferredPlugins);
     }
 }
 
@@ -705,6 +736,7 @@ void PDFProgramController::finishInitialization()
     m_mainWindowInterface->updateUI(true);
     onViewerSettingsChanged();
     updateActionsAvailability();
+    addStartupPhase(tr("Finish initialization"));
 }
 
 void PDFProgramController::performPrint()
@@ -825,7 +857,7 @@ void PDFProgramController::onActionTriggered(const pdf::PDFAction* action)
                 pdf::PDFDestination destination = typedAction->getDestination();
                 if (destination.getDestinationType() == pdf::DestinationType::Named)
                 {
-                    if (const pdf::PDFDestination* targetDestination = m_pdfDocument->getCatalog()->getNamedDestination(destination.getName()))
+                    if (std::optional<pdf::PDFDestination> targetDestination = m_pdfDocument->getCatalog()->getNamedDestination(destination.getName(), &m_pdfDocument->getStorage()))
                     {
                         destination = *targetDestination;
                     }
@@ -1172,7 +1204,21 @@ void PDFProgramController::saveDocument(const QString& fileName)
     updateFileWatcher(true);
 
     pdf::PDFDocumentWriter writer(nullptr);
-    pdf::PDFOperationResult result = writer.write(fileName, m_pdfDocument.data(), true);
+    pdf::PDFOperationResult result = false;
+
+    // When document is saved to the file it was loaded from, then only modified
+    // objects are appended to the file. If it fails (for example, file has
+    // damaged cross-reference table), whole document is written.
+    if (fileName == m_fileInfo.originalFileName && !m_pdfDocument->getStorage().isAllObjectsModified())
+    {
+        result = writer.writeIncrementalUpdate(fileName, m_pdfDocument.data());
+    }
+
+    if (!result)
+    {
+        result = writer.write(fileName, m_pdfDocument.data(), true);
+    }
+
     if (result)
     {
         if (m_undoRedoManager)
@@ -1216,6 +1262,11 @@ bool PDFProgramController::canClose() const
     return !(m_futureWatcher && m_futureWatcher->isRunning()) || !m_isBusy;
 }
 
+bool PDFProgramController::isDocumentReadingInProgress() const
+{
+    return m_futureWatcher && m_futureWatcher->isRunning();
+}
+
 bool PDFProgramController::askForSaveDocumentBeforeClose()
 {
     if (!m_pdfDocument)
@@ -1302,6 +1353,7 @@ void PDFProgramController::onActionPropertiesTriggered()
 void PDFProgramController::onActionAboutTriggered()
 {
     PDFAboutDialog dialog(m_mainWindow);
+    dialog.setStartupTrace(m_startupTrace);
     dialog.exec();
 }
 
@@ -1475,6 +1527,36 @@ void PDFProgramController::onActionRenderingErrorsTriggered()
     renderingErrorsDialog.exec();
 }
 
+void PDFProgramController::onActionRuntimeStatisticsTriggered()
+{
+    pdf::PDFRuntimeStatisticsDialog runtimeStatisticsDialog(m_mainWindow);
+    runtimeStatisticsDialog.exec();
+}
+
+void PDFProgramController::onActionRecordPerformanceTraceToggled(bool checked)
+{
+    pdf::PDFTracer* tracer = pdf::PDFTracer::getInstance();
+
+    if (checked)
+    {
+        tracer->start();
+        m_mainWindowInterface->setStatusBarMessage(tr("Recording of performance trace started."), 4000);
+        return;
+    }
+
+    tracer->stop();
+
+    QString fileName = QFileDialog::getSaveFileName(m_mainWindow, tr("Save Performance Trace"), m_settings->getDirectory(), tr("Chrome Trace (*.json)"));
+    if (!fileName.isEmpty())
+    {
+        pdf::PDFOperationResult result = tracer->writeChromeTrace(fileName);
+        if (!result)
+        {
+            QMessageBox::critical(m_mainWindow, tr("Error"), result.getErrorMessage());
+        }
+    }
+}
+
 void PDFProgramController::updateMagnifierToolSettings()
 {
     if (m_toolManager)
@@ -1649,9 +1731,25 @@ void PDFProgramController::readSettings(Settings settingsFlags)
     {
         // Load trusted certificates
         m_certificateStore.loadDefaultUserCertificates();
+        m_isCertificateStoreLoaded = true;
     }
 }
 
+void PDFProgramController::loadCertificateStore()
+{
+    if (!m_isCertificateStoreLoaded)
+    {
+        readSettings(CertificateSettings);
+    }
+}
+
+void PDFProgramController::addStartupPhase(const QString& name)
+{
+    const qint64 elapsed = m_startupTimer.elapsed();
+    m_startupTrace.emplace_back(name, elapsed - m_startupPhaseStart);
+    m_startupPhaseStart = elapsed;
+}
+
 void PDFProgramController::setPageLayout(pdf::PageLayout pageLayout)
 {
     m_pdfWidget->getDrawWidgetProxy()->setPageLayout(pageLayout);
@@ -1700,6 +1798,8 @@ void PDFProgramController::onViewerSettingsChanged()
 {
     m_pdfWidget->updateRenderer(m_settings->getRendererEngine());
     m_pdfWidget->updateCacheLimits(m_settings->getCompiledPageCacheLimit() * 1024, m_settings->getThumbnailsCacheLimit(), m_settings->getFontCacheLimit(), m_settings->getInstancedFontCacheLimit());
+    m_pdfWidget->getDrawWidgetProxy()->setDiskCacheLimit(qint64(m_settings->getDiskCacheLimit()) * 1024 * 1024);
+    m_pdfWidget->getDrawWidgetProxy()->setNonBlockingPaintEnabled(m_settings->isNonBlockingPaintEnabled());
     m_pdfWidget->getDrawWidgetProxy()->setFeatures(m_settings->getFeatures());
     m_pdfWidget->getDrawWidgetProxy()->setPreferredMeshResolutionRatio(m_settings->getPreferredMeshResolutionRatio());
     m_pdfWidget->getDrawWidgetProxy()->setMinimalMeshResolutionRatio(m_settings->getMinimalMeshResolutionRatio());
@@ -1824,24 +1924,29 @@ void PDFProgramController::openDocument(const QString& fileName)
             return result;
         };
 
-        // Try to open a new document
+        // Try to open a new document. Objects are loaded on demand, so large
+        // documents can be displayed without parsing all objects first.
         pdf::PDFDocumentReader reader(m_progress, qMove(queryPassword), true, false);
-        pdf::PDFDocument document = reader.readFromFile(fileName);
+        reader.setLazyLoading(true);
+        reader.setIndexCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/DocumentIndex");
+
+        // Remote documents are not downloaded at once, data are fetched on demand
+        const QUrl url(fileName);
+        const bool isRemoteDocument = url.scheme() == "http" || url.scheme() == "https";
+        pdf::PDFDocument document = isRemoteDocument ? reader.readFromSource(std::make_shared<PDFHttpRangeSource>(url)) : reader.readFromFile(fileName);
 
         result.errorMessage = reader.getErrorMessage();
         result.result = reader.getReadingResult();
         if (result.result == pdf::PDFDocumentReader::Result::OK)
         {
-            // Verify signatures
-            pdf::PDFSignatureHandler::Parameters parameters;
-            parameters.store = &m_certificateStore;
-            parameters.dss = &document.getCatalog()->getDocumentSecurityStore();
-            parameters.enableVerification = m_settings->getSettings().m_signatureVerificationEnabled;
-            parameters.ignoreExpirationDate = m_settings->getSettings().m_signatureIgnoreCertificateValidityTime;
-            parameters.useSystemCertificateStore = m_settings->getSettings().m_signatureUseSystemStore;
-
-            pdf::PDFForm form = pdf::PDFForm::parse(&document, document.getCatalog()->getFormObject());
-            result.signatures = pdf::PDFSignatureHandler::verifySignatures(form, reader.getSource(), parameters);
+            // Signatures are verified after the document is displayed. Source data
+            // of remote document are not complete, so signatures of remote documents
+            // can't be verified.
+            if (!isRemoteDocument)
+            {
+                result.sourceData = reader.getSource();
+            }
+
             result.document.reset(new pdf::PDFDocument(qMove(document)));
         }
 
@@ -1875,7 +1980,7 @@ void PDFProgramController::onDocumentReadingFinished()
             m_recentFileManager->addRecentFile(m_fileInfo.originalFileName);
 
             m_pdfDocument = qMove(result.document);
-            m_signatures = qMove(result.signatures);
+            m_signatures.clear();
             pdf::PDFModifiedDocument document(m_pdfDocument.data(), m_optionalContentActivity);
             setDocument(document, true);
 
@@ -1913,6 +2018,11 @@ void PDFProgramController::onDocumentReadingFinished()
             }
 
             m_mainWindowInterface->setStatusBarMessage(tr("Document '%1' was successfully loaded!").arg(m_fileInfo.fileName), 4000);
+
+            if (!result.sourceData.isEmpty())
+            {
+                startSignatureVerification(qMove(result.sourceData));
+            }
             break;
         }
 
@@ -1928,6 +2038,56 @@ void PDFProgramController::onDocumentReadingFinished()
     updateActionsAvailability();
 }
 
+void PDFProgramController::startSignatureVerification(QByteArray sourceData)
+{
+    stopSignatureVerification();
+    loadCertificateStore();
+
+    pdf::PDFSignatureHandler::Parameters parameters;
+    parameters.enableVerification = m_settings->getSettings().m_signatureVerificationEnabled;
+    parameters.ignoreExpirationDate = m_settings->getSettings().m_signatureIgnoreCertificateValidityTime;
+    parameters.useSystemCertificateStore = m_settings->getSettings().m_signatureUseSystemStore;
+
+    // Verification task holds its own copy of the document and of the certificate
+    // store, so document can be closed (or modified) during the verification.
+    auto verifySignatures = [document = m_pdfDocument, sourceData = qMove(sourceData), certificateStore = m_certificateStore, parameters]() mutable
+    {
+        parameters.store = &certificateStore;
+        parameters.dss = &document->getCatalog()->getDocumentSecurityStore();
+
+        pdf::PDFForm form = pdf::PDFForm::parse(document.data(), document->getCatalog()->getFormObject());
+        return pdf::PDFSignatureHandler::verifySignatures(form, sourceData, parameters);
+    };
+
+    m_signatureFuture = QtConcurrent::run(qMove(verifySignatures));
+    m_signatureFutureWatcher = new QFutureWatcher<std::vector<pdf::PDFSignatureVerificationResult>>(this);
+    connect(m_signatureFutureWatcher, &QFutureWatcher<std::vector<pdf::PDFSignatureVerificationResult>>::finished, this, &PDFProgramController::onSignatureVerificationFinished);
+    m_signatureFutureWatcher->setFuture(m_signatureFuture);
+}
+
+void PDFProgramController::stopSignatureVerification()
+{
+    if (m_signatureFutureWatcher)
+    {
+        // Jakub Melka: Verification can't be interrupted, so we just discard
+        // its result. Task holds copies of all data it uses.
+        m_signatureFutureWatcher->disconnect(this);
+        m_signatureFutureWatcher->deleteLater();
+        m_signatureFutureWatcher = nullptr;
+        m_signatureFuture = QFuture<std::vector<pdf::PDFSignatureVerificationResult>>();
+    }
+}
+
+void PDFProgramController::onSignatureVerificationFinished()
+{
+    m_signatures = m_signatureFuture.result();
+    m_signatureFuture = QFuture<std::vector<pdf::PDFSignatureVerificationResult>>();
+    m_signatureFutureWatcher->deleteLater();
+    m_signatureFutureWatcher = nullptr;
+
+    m_mainWindowInterface->setSignatures(m_signatures);
+}
+
 void PDFProgramController::onDocumentModified(pdf::PDFModifiedDocument document)
 {
     // We will create undo/redo step from old document, with flags from the new,
@@ -2062,6 +2222,7 @@ void PDFProgramController::closeDocument()
         }
     }
 
+    stopSignatureVerification();
     m_signatures.clear();
     setDocument(pdf::PDFModifiedDocument(), true);
     m_pdfDocument.reset();
@@ -2241,6 +2402,59 @@ void PDFProgramController::loadPlugins()
     }
 }
 
+void PDFProgramController::loadDeferredPlugins()
+{
+    if (!m_isPluginLoadingPending)
+    {
+        return;
+    }
+
+    m_isPluginLoadingPending = false;
+    loadPlugins();
+
+    if (m_loadedPlugins.empty())
+    {
+        addStartupPhase(tr("Load plugins"));
+        return;
+    }
+
+    // Window state and shortcuts were restored before plugins were loaded,
+    // so restore them again for plugin toolbars and actions.
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    QByteArray state = settings.value("windowState", QByteArray()).toByteArray();
+    if (!state.isEmpty())
+    {
+        m_mainWindow->restoreState(state);
+    }
+    readSettings(ActionSettings);
+
+    if (m_actionComboBox)
+    {
+        for (const auto& plugin : m_loadedPlugins)
+        {
+            for (QAction* action : plugin.second->getActions())
+            {
+                if (action)
+                {
+                    m_actionComboBox->addQuickFindAction(action);
+                }
+            }
+        }
+    }
+
+    if (m_pdfDocument)
+    {
+        pdf::PDFModifiedDocument document(m_pdfDocument.data(), m_optionalContentActivity, pdf::PDFModifiedDocument::Reset);
+        for (const auto& plugin : m_loadedPlugins)
+        {
+            plugin.second->setDocument(document);
+        }
+    }
+
+    updateActionsAvailability();
+    addStartupPhase(tr("Load plugins"));
+}
+
 void PDFProgramController::writeSettings()
 {
     Q_ASSERT(!m_isFactorySettingsBeingRestored);
@@ -2275,8 +2489,12 @@ void PDFProgramController::writeSettings()
     settings.setValue("EnabledPlugins", m_enabledPlugins);
     settings.endGroup();
 
-    // Save trusted certificates
-    m_certificateStore.saveDefaultUserCertificates();
+    // Save trusted certificates (only if they were loaded, otherwise
+    // they were not changed, and we would overwrite them by empty store)
+    if (m_isCertificateStoreLoaded)
+    {
+        m_certificateStore.saveDefaultUserCertificates();
+    }
 }
 
 void PDFProgramController::resetSettings()
@@ -2301,6 +2519,9 @@ void PDFProgramController::resetSettings()
 
 void PDFProgramController::onActionOptionsTriggered()
 {
+    loadDeferredPlugins();
+    loadCertificateStore();
+
     PDFViewerSettingsDialog::OtherSettings otherSettings;
     otherSettings.maximumRecentFileCount = m_recentFileManager->getRecentFilesLimit();
 
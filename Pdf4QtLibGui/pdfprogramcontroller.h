@@ -31,6 +31,7 @@
 #include <QToolButton>
 #include <QActionGroup>
 #include <QFileSystemWatcher>
+#include <QElapsedTimer>
 
 #include <array>
 
@@ -66,6 +67,7 @@ public:
     virtual QMenu* addToolMenu(QString name) = 0;
     virtual void setStatusBarMessage(QString message, int time) = 0;
     virtual void setDocument(const pdf::PDFModifiedDocument& document) = 0;
+    virtual void setSignatures(const std::vector<pdf::PDFSignatureVerificationResult>& signatures) = 0;
     virtual void adjustToolbar(QToolBar* toolbar) = 0;
     virtual pdf::PDFTextSelection getSelectedText() const = 0;
 };
@@ -163,6 +165,7 @@ public:
         RenderOptionIgnoreOptionalContentSettings,
         RenderOptionDisplayRenderTimes,
         RenderOptionDisplayAnnotations,
+        RenderOptionSimulateOverprint,
         RenderOptionInvertColors,
         RenderOptionGrayscale,
         RenderOptionBitonal,
@@ -186,6 +189,8 @@ public:
         BookmarkExport,
         BookmarkImport,
         BookmarkGenerateAutomatically,
+        RecordPerformanceTrace,
+        ShowRuntimeStatistics,
         LastAction
     };
 
@@ -310,6 +315,9 @@ public:
     void setIsBusy(bool isBusy);
 
     bool canClose() const;
+
+    /// Returns true, if document is being read
+    bool isDocumentReadingInProgress() const;
     bool askForSaveDocumentBeforeClose();
 
     virtual QString getOriginalFileName() const override;
@@ -329,9 +337,18 @@ private:
         pdf::PDFDocumentPointer document;
         QString errorMessage;
         pdf::PDFDocumentReader::Result result = pdf::PDFDocumentReader::Result::Cancelled;
-        std::vector<pdf::PDFSignatureVerificationResult> signatures;
+        QByteArray sourceData; ///< Source data for signature verification (empty, if signatures can't be verified)
     };
 
+    /// Starts verification of the signatures of the current document in
+    /// the background. Document is displayed before signatures are verified,
+    /// the sidebar is updated, when verification is finished.
+    /// \param sourceData Source data of the document
+    void startSignatureVerification(QByteArray sourceData);
+
+    /// Stops signature verification, result of the verification is discarded
+    void stopSignatureVerification();
+
     void initializeToolManager();
     void initializeAnnotationManager();
     void initializeFormManager();
@@ -360,6 +377,8 @@ private:
     void onActionFitWidthTriggered();
     void onActionFitHeightTriggered();
     void onActionRenderingErrorsTriggered();
+    void onActionRecordPerformanceTraceToggled(bool checked);
+    void onActionRuntimeStatisticsTriggered();
     void onActionPageLayoutSinglePageTriggered();
     void onActionPageLayoutContinuousTriggered();
     void onActionPageLayoutTwoPagesTriggered();
@@ -383,6 +402,7 @@ private:
     void onDrawSpaceChanged();
     void onPageLayoutChanged();
     void onDocumentReadingFinished();
+    void onSignatureVerificationFinished();
     void onDocumentUndoRedo(pdf::PDFModifiedDocument document);
     void onQueryPasswordRequest(QString* password, bool* ok);
     void onPageRenderingErrorsChanged(pdf::PDFInteger pageIndex, int errorsCount);
@@ -416,8 +436,15 @@ private:
     Q_DECLARE_FLAGS(Settings, SettingFlag)
 
     void loadPlugins();
+    void loadDeferredPlugins();
+    void loadCertificateStore();
     void readSettings(Settings settings);
 
+    /// Records duration of the startup phase, which has just finished
+    /// (measured from the end of the previous phase).
+    /// \param name Name of the phase
+    void addStartupPhase(const QString& name);
+
     void saveDocument(const QString& fileName);
 
     PDFActionManager* m_actionManager;
@@ -434,6 +461,8 @@ private:
 
     QFuture<AsyncReadingResult> m_future;
     QFutureWatcher<AsyncReadingResult>* m_futureWatcher;
+    QFuture<std::vector<pdf::PDFSignatureVerificationResult>> m_signatureFuture;
+    QFutureWatcher<std::vector<pdf::PDFSignatureVerificationResult>>* m_signatureFutureWatcher;
 
     pdf::PDFCMSManager* m_CMSManager;
     pdf::PDFToolManager* m_toolManager;
@@ -445,6 +474,7 @@ private:
     PDFFileInfo m_fileInfo;
     QFileSystemWatcher m_fileWatcher;
     pdf::PDFCertificateStore m_certificateStore;
+    bool m_isCertificateStoreLoaded;
     std::vector<pdf::PDFSignatureVerificationResult> m_signatures;
 
     bool m_isBusy;
@@ -454,6 +484,11 @@ private:
     QStringList m_enabledPlugins;
     pdf::PDFPluginInfos m_plugins;
     std::vector<std::pair<pdf::PDFPluginInfo, pdf::PDFPlugin*>> m_loadedPlugins;
+    bool m_isPluginLoadingPending;
+
+    QElapsedTimer m_startupTimer;
+    qint64 m_startupPhaseStart;
+    std::vector<std::pair<QString, qint64>> m_startupTrace;
 };
 
 }   // namespace pdfviewer
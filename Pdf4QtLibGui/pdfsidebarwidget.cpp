@@ -280,6 +280,20 @@ void PDFSidebarWidget::setDocument(const pdf::PDFModifiedDocument& document, con
     }
 }
 
+void PDFSidebarWidget::setSignatures(const std::vector<pdf::PDFSignatureVerificationResult>& signatures)
+{
+    const bool wasEmpty = isEmpty();
+
+    m_signatures = signatures;
+    updateSignatures(signatures);
+    updateButtons();
+
+    if (wasEmpty)
+    {
+        updateGUI(Invalid);
+    }
+}
+
 bool PDFSidebarWidget::isEmpty() const
 {
     for (int i = _BEGIN; i < _END; ++i)
@@ -353,6 +367,12 @@ void PDFSidebarWidget::selectPage(Page page)
         }
     }
 
+    if (page == Speech && m_textToSpeech)
+    {
+        // Speech engine is created on first use
+        m_textToSpeech->initializeEngine();
+    }
+
     if (page == Speech && ui->speechVoiceComboBox->count() == 0)
     {
         // Check, if speech engine is properly set
@@ -783,6 +803,12 @@ void PDFSidebarWidget::onOutlineSearchText()
     QString text = ui->outlineSearchLineEdit->text();
     const bool isWildcard = text.contains(QChar('*')) || text.contains(QChar('?'));
 
+    if (!text.isEmpty())
+    {
+        // Items are created lazily, filter must see all of them
+        m_outlineTreeModel->fetchAll();
+    }
+
     if (isWildcard)
     {
         m_outlineSortProxyTreeModel->setFilterWildcard(text);
@@ -1117,7 +1143,7 @@ void PDFSidebarWidget::onOutlineTreeViewContextMenuRequested(const QPoint& pos)
         };
 
         QStringList items;
-        for (const auto& namedDestination : m_document->getCatalog()->getNamedDestinations())
+        for (const auto& namedDestination : m_document->getCatalog()->getNamedDestinations(&m_document->getStorage()))
         {
             items << QString::fromLatin1(namedDestination.first);
         }
@@ -88,6 +88,10 @@ public:
 
     void setDocument(const pdf::PDFModifiedDocument& document, const std::vector<pdf::PDFSignatureVerificationResult>& signatures);
 
+    /// Sets signatures of the current document (signatures are verified
+    /// in the background, after the document is displayed)
+    void setSignatures(const std::vector<pdf::PDFSignatureVerificationResult>& signatures);
+
     /// Returns true, if all items in sidebar are empty
     bool isEmpty() const;
 
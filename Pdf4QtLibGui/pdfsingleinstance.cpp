@@ -0,0 +1,137 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfsingleinstance.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+
+#include "pdfdbgheap.h"
+
+namespace pdfviewer
+{
+
+PDFSingleInstance::PDFSingleInstance(QObject* parent) :
+    BaseClass(parent),
+    m_server(nullptr)
+{
+
+}
+
+bool PDFSingleInstance::forwardToRunningInstance(const QStringList& fileNames)
+{
+    QLocalSocket socket;
+    socket.connectToServer(getServerName());
+
+    if (!socket.waitForConnected(TIMEOUT))
+    {
+        // No running instance
+        return false;
+    }
+
+    QStringList absoluteFileNames;
+    absoluteFileNames.reserve(fileNames.size());
+    for (const QString& fileName : fileNames)
+    {
+        absoluteFileNames << QFileInfo(fileName).absoluteFilePath();
+    }
+
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << absoluteFileNames;
+    }
+
+    socket.write(data);
+    if (!socket.waitForBytesWritten(TIMEOUT))
+    {
+        return false;
+    }
+
+    socket.disconnectFromServer();
+    if (socket.state() != QLocalSocket::UnconnectedState)
+    {
+        socket.waitForDisconnected(TIMEOUT);
+    }
+
+    return true;
+}
+
+bool PDFSingleInstance::listen()
+{
+    if (m_server)
+    {
+        return m_server->isListening();
+    }
+
+    const QString serverName = getServerName();
+
+    // Jakub Melka: We were not able to connect to the running instance,
+    // so the server can be left over by the crashed instance (on Unix,
+    // socket file isn't removed). Remove it, otherwise listen fails.
+    QLocalServer::removeServer(serverName);
+
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &PDFSingleInstance::onNewConnection);
+    return m_server->listen(serverName);
+}
+
+void PDFSingleInstance::onNewConnection()
+{
+    while (QLocalSocket* socket = m_server->nextPendingConnection())
+    {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+
+        if (socket->bytesAvailable() > 0)
+        {
+            onReadyRead(socket);
+        }
+    }
+}
+
+void PDFSingleInstance::onReadyRead(QLocalSocket* socket)
+{
+    QDataStream stream(socket);
+    stream.startTransaction();
+
+    QStringList fileNames;
+    stream >> fileNames;
+
+    if (stream.commitTransaction())
+    {
+        socket->disconnectFromServer();
+        Q_EMIT openDocumentsRequested(fileNames);
+    }
+}
+
+QString PDFSingleInstance::getServerName()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QCoreApplication::organizationName().toUtf8());
+    hash.addData(QCoreApplication::applicationName().toUtf8());
+    hash.addData(QDir::homePath().toUtf8());
+    return QString("pdf4qt-%1").arg(QString::fromLatin1(hash.result().toHex().left(16)));
+}
+
+}   // namespace pdfviewer
@@ -0,0 +1,78 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFSINGLEINSTANCE_H
+#define PDFSINGLEINSTANCE_H
+
+#include "pdfviewerglobal.h"
+
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+
+namespace pdfviewer
+{
+
+/// Single instance of the application. First instance of the application
+/// listens on a local socket, other instances forward file names of documents
+/// to be opened to the running instance and quit. Running instance then opens
+/// documents without the startup of the new process.
+class PDF4QTLIBGUILIBSHARED_EXPORT PDFSingleInstance : public QObject
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    explicit PDFSingleInstance(QObject* parent);
+
+    /// Forwards file names to the running instance of the application. File names
+    /// are converted to absolute paths, because working directory of the running
+    /// instance can differ. Returns true, if file names were forwarded, and this
+    /// instance should quit. If there is no running instance, false is returned.
+    /// \param fileNames File names (can be empty, then running instance is only activated)
+    bool forwardToRunningInstance(const QStringList& fileNames);
+
+    /// Starts listening for requests of other instances of the application.
+    /// Returns true, if listening was started.
+    bool listen();
+
+signals:
+    /// Other instance of the application requested to open documents
+    void openDocumentsRequested(const QStringList& fileNames);
+
+private:
+    /// Timeout of the communication with the running instance [ms]
+    static constexpr int TIMEOUT = 1000;
+
+    void onNewConnection();
+    void onReadyRead(QLocalSocket* socket);
+
+    /// Returns name of the local server. Name is unique for the
+    /// application and the user, so different users don't share
+    /// the instance.
+    static QString getServerName();
+
+    QLocalServer* m_server;
+};
+
+}   // namespace pdfviewer
+
+#endif // PDFSINGLEINSTANCE_H
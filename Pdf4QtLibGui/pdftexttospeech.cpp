@@ -39,8 +39,10 @@ PDFTextToSpeech::PDFTextToSpeech(QObject* parent) :
     m_textToSpeech(nullptr),
     m_document(nullptr),
     m_proxy(nullptr),
+    m_viewerSettings(nullptr),
     m_state(Invalid),
     m_initialized(false),
+    m_engineRequested(false),
     m_speechLocaleComboBox(nullptr),
     m_speechVoiceComboBox(nullptr),
     m_speechRateEdit(nullptr),
@@ -99,20 +101,42 @@ void PDFTextToSpeech::updateVoices()
 void PDFTextToSpeech::setSettings(const PDFViewerSettings* viewerSettings)
 {
     Q_ASSERT(viewerSettings);
+    m_viewerSettings = viewerSettings;
 
-    if (!m_initialized)
+    if (!m_initialized || !m_engineRequested)
     {
-        // This object is not initialized yet
+        // This object is not initialized yet, or engine is not used yet
         return;
     }
 
+    applySettings();
+}
+
+void PDFTextToSpeech::initializeEngine()
+{
+    if (m_engineRequested)
+    {
+        return;
+    }
+
+    m_engineRequested = true;
+    if (m_initialized && m_viewerSettings)
+    {
+        applySettings();
+    }
+}
+
+void PDFTextToSpeech::applySettings()
+{
+    Q_ASSERT(m_viewerSettings);
+
     // First, stop the engine
     stop();
 
     delete m_textToSpeech;
     m_textToSpeech = nullptr;
 
-    const PDFViewerSettings::Settings& settings = viewerSettings->getSettings();
+    const PDFViewerSettings::Settings& settings = m_viewerSettings->getSettings();
     if (!settings.m_speechEngine.isEmpty())
     {
         m_textToSpeech = new QTextToSpeech(settings.m_speechEngine, this);
@@ -69,9 +69,15 @@ public:
     /// Sets active document to text to speech engine
     void setDocument(const pdf::PDFModifiedDocument& document);
 
-    /// Apply settings to the reader
+    /// Apply settings to the reader. Speech engine is not created,
+    /// until it is requested by \p initializeEngine function.
     void setSettings(const PDFViewerSettings* viewerSettings);
 
+    /// Creates speech engine using the current settings, if it was not
+    /// already created. Creating the engine is slow (system speech libraries
+    /// are loaded), so it is postponed until text to speech is used.
+    void initializeEngine();
+
     /// Set draw proxy
     void setProxy(pdf::PDFDrawWidgetProxy* proxy);
 
@@ -91,6 +97,9 @@ public:
                       QTextBrowser* speechActualTextBrowser);
 
 private:
+    /// Creates speech engine and applies the settings to it
+    void applySettings();
+
     /// Updates UI controls depending on the state
     void updateUI();
 
@@ -120,8 +129,10 @@ private:
     QTextToSpeech* m_textToSpeech;
     const pdf::PDFDocument* m_document;
     pdf::PDFDrawWidgetProxy* m_proxy;
+    const PDFViewerSettings* m_viewerSettings;
     State m_state;
     bool m_initialized;
+    bool m_engineRequested;
 
     QComboBox* m_speechLocaleComboBox;
     QComboBox* m_speechVoiceComboBox;
@@ -47,7 +47,7 @@ void PDFUndoRedoManager::doUndo()
     clampUndoRedoSteps();
 
     Q_EMIT undoRedoStateChanged();
-    Q_EMIT documentChangeRequest(pdf::PDFModifiedDocument(item.oldDocument, nullptr, item.flags));
+    Q_EMIT documentChangeRequest(item.createModifiedDocument(item.oldDocument));
 }
 
 void PDFUndoRedoManager::doRedo()
@@ -65,7 +65,7 @@ void PDFUndoRedoManager::doRedo()
     clampUndoRedoSteps();
 
     Q_EMIT undoRedoStateChanged();
-    Q_EMIT documentChangeRequest(pdf::PDFModifiedDocument(item.newDocument, nullptr, item.flags));
+    Q_EMIT documentChangeRequest(item.createModifiedDocument(item.newDocument));
 }
 
 void PDFUndoRedoManager::clear()
@@ -80,7 +80,7 @@ void PDFUndoRedoManager::clear()
 
 void PDFUndoRedoManager::createUndo(pdf::PDFModifiedDocument document, pdf::PDFDocumentPointer oldDocument)
 {
-    m_undoSteps.emplace_back(oldDocument, document, document.getFlags());
+    m_undoSteps.emplace_back(oldDocument, document);
     m_redoSteps.clear();
     m_isCurrentSaved = false;
     clampUndoRedoSteps();
@@ -112,6 +112,19 @@ void PDFUndoRedoManager::clampUndoRedoSteps()
     }
 }
 
+pdf::PDFModifiedDocument PDFUndoRedoManager::UndoRedoItem::createModifiedDocument(pdf::PDFDocumentPointer document) const
+{
+    pdf::PDFModifiedDocument modifiedDocument(qMove(document), nullptr, flags);
+    modifiedDocument.setChangedObjects(changedObjects);
+
+    if (hasAffectedPages)
+    {
+        modifiedDocument.setAffectedPages(affectedPages);
+    }
+
+    return modifiedDocument;
+}
+
 bool PDFUndoRedoManager::isCurrentSaved() const
 {
     return m_isCurrentSaved;
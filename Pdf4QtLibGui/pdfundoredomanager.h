@@ -86,17 +86,28 @@ private:
     struct UndoRedoItem
     {
         explicit inline UndoRedoItem() = default;
-        explicit inline UndoRedoItem(pdf::PDFDocumentPointer oldDocument, pdf::PDFDocumentPointer newDocument, pdf::PDFModifiedDocument::ModificationFlags flags) :
+        explicit inline UndoRedoItem(pdf::PDFDocumentPointer oldDocument, const pdf::PDFModifiedDocument& newDocument) :
             oldDocument(qMove(oldDocument)),
-            newDocument(qMove(newDocument)),
-            flags(flags)
+            newDocument(newDocument),
+            flags(newDocument.getFlags()),
+            changedObjects(newDocument.getChangedObjects()),
+            hasAffectedPages(newDocument.hasAffectedPages()),
+            affectedPages(newDocument.getAffectedPages())
         {
 
         }
 
+        /// Creates modified document for undo/redo step. Both documents have
+        /// the same objects changed and the same pages affected.
+        /// \param document Document to be set (old or new)
+        pdf::PDFModifiedDocument createModifiedDocument(pdf::PDFDocumentPointer document) const;
+
         pdf::PDFDocumentPointer oldDocument;
         pdf::PDFDocumentPointer newDocument;
         pdf::PDFModifiedDocument::ModificationFlags flags = pdf::PDFModifiedDocument::None;
+        std::vector<pdf::PDFObjectReference> changedObjects;
+        bool hasAffectedPages = false;
+        std::vector<pdf::PDFInteger> affectedPages;
     };
 
     size_t m_undoLimit = 0;
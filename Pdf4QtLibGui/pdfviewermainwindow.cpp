@@ -132,6 +132,7 @@ PDFViewerMainWindow::PDFViewerMainWindow(QWidget* parent) :
     m_actionManager->setAction(PDFActionManager::RenderOptionIgnoreOptionalContentSettings, ui->actionRenderOptionIgnoreOptionalContentSettings);
     m_actionManager->setAction(PDFActionManager::RenderOptionDisplayRenderTimes, ui->actionRenderOptionDisplayRenderTimes);
     m_actionManager->setAction(PDFActionManager::RenderOptionDisplayAnnotations, ui->actionRenderOptionDisplayAnnotations);
+    m_actionManager->setAction(PDFActionManager::RenderOptionSimulateOverprint, ui->actionRenderOptionSimulateOverprint);
     m_actionManager->setAction(PDFActionManager::RenderOptionInvertColors, ui->actionColorInvert);
     m_actionManager->setAction(PDFActionManager::RenderOptionGrayscale, ui->actionColorGrayscale);
     m_actionManager->setAction(PDFActionManager::RenderOptionHighContrast, ui->actionColorHighContrast);
@@ -149,6 +150,8 @@ PDFViewerMainWindow::PDFViewerMainWindow(QWidget* parent) :
     m_actionManager->setAction(PDFActionManager::FitWidth, ui->actionFitWidth);
     m_actionManager->setAction(PDFActionManager::FitHeight, ui->actionFitHeight);
     m_actionManager->setAction(PDFActionManager::ShowRenderingErrors, ui->actionRendering_Errors);
+    m_actionManager->setAction(PDFActionManager::RecordPerformanceTrace, ui->actionRecordPerformanceTrace);
+    m_actionManager->setAction(PDFActionManager::ShowRuntimeStatistics, ui->actionRuntimeStatistics);
     m_actionManager->setAction(PDFActionManager::PageLayoutSinglePage, ui->actionPageLayoutSinglePage);
     m_actionManager->setAction(PDFActionManager::PageLayoutContinuous, ui->actionPageLayoutContinuous);
     m_actionManager->setAction(PDFActionManager::PageLayoutTwoPages, ui->actionPageLayoutTwoPages);
@@ -362,7 +365,7 @@ void PDFViewerMainWindow::updateUI(bool fullUpdate)
             // Prefetch pages, if it is enabled
             if (m_programController->getSettings()->isPagePrefetchingEnabled())
             {
-                m_programController->getPdfWidget()->getDrawWidgetProxy()->prefetchPages(currentPages.back());
+                m_programController->getPdfWidget()->getDrawWidgetProxy()->prefetchPages(currentPages.front(), currentPages.back());
             }
         }
 
@@ -402,6 +405,21 @@ void PDFViewerMainWindow::setDocument(const pdf::PDFModifiedDocument& document)
     }
 }
 
+void PDFViewerMainWindow::setSignatures(const std::vector<pdf::PDFSignatureVerificationResult>& signatures)
+{
+    if (m_sidebarWidget)
+    {
+        // Sidebar was hidden, if it was empty, so we show it, if it contains signatures now
+        const bool wasEmpty = m_sidebarWidget->isEmpty();
+        m_sidebarWidget->setSignatures(signatures);
+
+        if (wasEmpty && !m_sidebarWidget->isEmpty())
+        {
+            m_sidebarDockWidget->show();
+        }
+    }
+}
+
 void PDFViewerMainWindow::adjustToolbar(QToolBar* toolbar)
 {
     QSize iconSize = pdf::PDFWidgetUtils::scaleDPI(this, QSize(24, 24));
@@ -83,6 +83,7 @@ public:
     virtual QMenu* addToolMenu(QString name) override;
     virtual void setStatusBarMessage(QString message, int time) override;
     virtual void setDocument(const pdf::PDFModifiedDocument& document) override;
+    virtual void setSignatures(const std::vector<pdf::PDFSignatureVerificationResult>& signatures) override;
     virtual void adjustToolbar(QToolBar* toolbar) override;
     virtual pdf::PDFTextSelection getSelectedText() const override;
 
@@ -19,6 +19,7 @@
 #include "pdfconstants.h"
 
 #include <QSettings>
+#include <QCoreApplication>
 #include <QPixmapCache>
 #include <QStandardPaths>
 
@@ -45,6 +46,7 @@ void PDFViewerSettings::readSettings(QSettings& settings, const pdf::PDFCMSSetti
     m_settings.m_features = static_cast<pdf::PDFRenderer::Features>(settings.value("rendererFeaturesv2", static_cast<int>(pdf::PDFRenderer::getDefaultFeatures())).toInt());
     m_settings.m_rendererEngine = static_cast<pdf::RendererEngine>(settings.value("renderingEngine", static_cast<int>(pdf::RendererEngine::Blend2D_MultiThread)).toInt());
     m_settings.m_prefetchPages = settings.value("prefetchPages", defaultSettings.m_prefetchPages).toBool();
+    m_settings.m_nonBlockingPaint = settings.value("nonBlockingPaint", defaultSettings.m_nonBlockingPaint).toBool();
     m_settings.m_preferredMeshResolutionRatio = settings.value("preferredMeshResolutionRatio", defaultSettings.m_preferredMeshResolutionRatio).toDouble();
     m_settings.m_minimalMeshResolutionRatio = settings.value("minimalMeshResolutionRatio", defaultSettings.m_minimalMeshResolutionRatio).toDouble();
     m_settings.m_colorTolerance = settings.value("colorTolerance", defaultSettings.m_colorTolerance).toDouble();
@@ -52,9 +54,11 @@ void PDFViewerSettings::readSettings(QSettings& settings, const pdf::PDFCMSSetti
     m_settings.m_thumbnailsCacheLimit = settings.value("thumbnailsCacheLimit", defaultSettings.m_thumbnailsCacheLimit).toInt();
     m_settings.m_fontCacheLimit = settings.value("fontCacheLimit", defaultSettings.m_fontCacheLimit).toInt();
     m_settings.m_instancedFontCacheLimit = settings.value("instancedFontCacheLimit", defaultSettings.m_instancedFontCacheLimit).toInt();
+    m_settings.m_diskCacheLimit = settings.value("diskCacheLimit", defaultSettings.m_diskCacheLimit).toInt();
     m_settings.m_allowLaunchApplications = settings.value("allowLaunchApplications", defaultSettings.m_allowLaunchApplications).toBool();
     m_settings.m_allowLaunchURI = settings.value("allowLaunchURI", defaultSettings.m_allowLaunchURI).toBool();
     m_settings.m_allowDeveloperMode = settings.value("allowDeveloperMode", defaultSettings.m_allowDeveloperMode).toBool();
+    m_settings.m_singleInstance = settings.value("singleInstance", defaultSettings.m_singleInstance).toBool();
     m_settings.m_multithreadingStrategy = static_cast<pdf::PDFExecutionPolicy::Strategy>(settings.value("multithreadingStrategy", static_cast<int>(defaultSettings.m_multithreadingStrategy)).toInt());
     m_settings.m_magnifierSize = settings.value("magnifierSize", defaultSettings.m_magnifierSize).toInt();
     m_settings.m_magnifierZoom = settings.value("magnifierZoom", defaultSettings.m_magnifierZoom).toDouble();
@@ -70,6 +74,7 @@ void PDFViewerSettings::readSettings(QSettings& settings, const pdf::PDFCMSSetti
     m_colorManagementSystemSettings.isBlackPointCompensationActive = settings.value("isBlackPointCompensationActive", defaultCMSSettings.isBlackPointCompensationActive).toBool();
     m_colorManagementSystemSettings.isWhitePaperColorTransformed = settings.value("isWhitePaperColorTransformed", defaultCMSSettings.isWhitePaperColorTransformed).toBool();
     m_colorManagementSystemSettings.isConsiderOutputIntent = settings.value("isConsiderOutputIntent", defaultCMSSettings.isConsiderOutputIntent).toBool();
+    m_colorManagementSystemSettings.isColorLookupTableUsed = settings.value("isColorLookupTableUsed", defaultCMSSettings.isColorLookupTableUsed).toBool();
     m_colorManagementSystemSettings.outputCS = settings.value("outputCS", defaultCMSSettings.outputCS).toString();
     m_colorManagementSystemSettings.deviceGray = settings.value("deviceGray", defaultCMSSettings.deviceGray).toString();
     m_colorManagementSystemSettings.deviceRGB = settings.value("deviceRGB", defaultCMSSettings.deviceRGB).toString();
@@ -118,6 +123,7 @@ void PDFViewerSettings::writeSettings(QSettings& settings)
     settings.setValue("rendererFeaturesv2", static_cast<int>(m_settings.m_features));
     settings.setValue("renderingEngine", static_cast<int>(m_settings.m_rendererEngine));
     settings.setValue("prefetchPages", m_settings.m_prefetchPages);
+    settings.setValue("nonBlockingPaint", m_settings.m_nonBlockingPaint);
     settings.setValue("preferredMeshResolutionRatio", m_settings.m_preferredMeshResolutionRatio);
     settings.setValue("minimalMeshResolutionRatio", m_settings.m_minimalMeshResolutionRatio);
     settings.setValue("colorTolerance", m_settings.m_colorTolerance);
@@ -125,9 +131,11 @@ void PDFViewerSettings::writeSettings(QSettings& settings)
     settings.setValue("thumbnailsCacheLimit", m_settings.m_thumbnailsCacheLimit);
     settings.setValue("fontCacheLimit", m_settings.m_fontCacheLimit);
     settings.setValue("instancedFontCacheLimit", m_settings.m_instancedFontCacheLimit);
+    settings.setValue("diskCacheLimit", m_settings.m_diskCacheLimit);
     settings.setValue("allowLaunchApplications", m_settings.m_allowLaunchApplications);
     settings.setValue("allowLaunchURI", m_settings.m_allowLaunchURI);
     settings.setValue("allowDeveloperMode", m_settings.m_allowDeveloperMode);
+    settings.setValue("singleInstance", m_settings.m_singleInstance);
     settings.setValue("multithreadingStrategy", static_cast<int>(m_settings.m_multithreadingStrategy));
     settings.setValue("magnifierSize", m_settings.m_magnifierSize);
     settings.setValue("magnifierZoom", m_settings.m_magnifierZoom);
@@ -143,6 +151,7 @@ void PDFViewerSettings::writeSettings(QSettings& settings)
     settings.setValue("isBlackPointCompensationActive", m_colorManagementSystemSettings.isBlackPointCompensationActive);
     settings.setValue("isWhitePaperColorTransformed", m_colorManagementSystemSettings.isWhitePaperColorTransformed);
     settings.setValue("isConsiderOutputIntent", m_colorManagementSystemSettings.isConsiderOutputIntent);
+    settings.setValue("isColorLookupTableUsed", m_colorManagementSystemSettings.isColorLookupTableUsed);
     settings.setValue("outputCS", m_colorManagementSystemSettings.outputCS);
     settings.setValue("deviceGray", m_colorManagementSystemSettings.deviceGray);
     settings.setValue("deviceRGB", m_colorManagementSystemSettings.deviceRGB);
@@ -251,21 +260,36 @@ void PDFViewerSettings::setColorTolerance(pdf::PDFReal colorTolerance)
     }
 }
 
+bool PDFViewerSettings::readSingleInstanceMode()
+{
+    Settings defaultSettings;
+
+    QSettings settings(QSettings::IniFormat, QSettings::UserScope, QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.beginGroup("ViewerSettings");
+    const bool singleInstance = settings.value("singleInstance", defaultSettings.m_singleInstance).toBool();
+    settings.endGroup();
+
+    return singleInstance;
+}
+
 PDFViewerSettings::Settings::Settings() :
     m_features(pdf::PDFRenderer::getDefaultFeatures()),
     m_rendererEngine(pdf::RendererEngine::Blend2D_MultiThread),
     m_prefetchPages(true),
+    m_nonBlockingPaint(false),
     m_preferredMeshResolutionRatio(0.02),
     m_minimalMeshResolutionRatio(0.005),
     m_colorTolerance(0.01),
     m_allowLaunchApplications(true),
     m_allowLaunchURI(true),
     m_allowDeveloperMode(false),
+    m_singleInstance(false),
     m_multithreadingStrategy(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded),
     m_compiledPageCacheLimit(512 * 1024),
     m_thumbnailsCacheLimit(64 * 1024),
     m_fontCacheLimit(pdf::DEFAULT_FONT_CACHE_LIMIT),
     m_instancedFontCacheLimit(pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT),
+    m_diskCacheLimit(0),
     m_speechRate(0.0),
     m_speechPitch(0.0),
     m_speechVolume(1.0),
@@ -53,12 +53,14 @@ public:
         QString m_directory;
         pdf::RendererEngine m_rendererEngine;
         bool m_prefetchPages;
+        bool m_nonBlockingPaint; ///< Pages are rasterized in background, GUI thread only draws images
         pdf::PDFReal m_preferredMeshResolutionRatio;
         pdf::PDFReal m_minimalMeshResolutionRatio;
         pdf::PDFReal m_colorTolerance;
         bool m_allowLaunchApplications;
         bool m_allowLaunchURI;
         bool m_allowDeveloperMode;
+        bool m_singleInstance; ///< Documents are opened in already running instance of the application
         pdf::PDFExecutionPolicy::Strategy m_multithreadingStrategy;
 
         // Cache settings
@@ -66,6 +68,7 @@ public:
         int m_thumbnailsCacheLimit;
         int m_fontCacheLimit;
         int m_instancedFontCacheLimit;
+        int m_diskCacheLimit; ///< Persistent disk cache limit [MB], zero means disabled
 
         // Speech settings
         QString m_speechEngine;
@@ -102,6 +105,11 @@ public:
     void readSettings(QSettings& settings, const pdf::PDFCMSSettings& defaultCMSSettings);
     void writeSettings(QSettings& settings);
 
+    /// Reads single instance mode setting directly from the application
+    /// settings. It is used before the main window is created, i.e. before
+    /// settings are read.
+    static bool readSingleInstanceMode();
+
     QString getDirectory() const;
     void setDirectory(const QString& directory);
 
@@ -112,6 +120,7 @@ public:
     void setRendererEngine(pdf::RendererEngine rendererEngine);
 
     bool isPagePrefetchingEnabled() const { return m_settings.m_prefetchPages; }
+    bool isNonBlockingPaintEnabled() const { return m_settings.m_nonBlockingPaint; }
 
     pdf::PDFReal getPreferredMeshResolutionRatio() const { return m_settings.m_preferredMeshResolutionRatio; }
     void setPreferredMeshResolutionRatio(pdf::PDFReal preferredMeshResolutionRatio);
@@ -126,6 +135,7 @@ public:
     int getThumbnailsCacheLimit() const { return m_settings.m_thumbnailsCacheLimit; }
     int getFontCacheLimit() const { return m_settings.m_fontCacheLimit; }
     int getInstancedFontCacheLimit() const { return m_settings.m_instancedFontCacheLimit; }
+    int getDiskCacheLimit() const { return m_settings.m_diskCacheLimit; }
 
     const pdf::PDFCMSSettings& getColorManagementSystemSettings() const { return m_colorManagementSystemSettings; }
     void setColorManagementSystemSettings(const pdf::PDFCMSSettings& settings) { m_colorManagementSystemSettings = settings; }
@@ -276,6 +276,7 @@ void PDFViewerSettingsDialog::loadData()
 
     // Engine
     ui->prefetchPagesCheckBox->setChecked(m_settings.m_prefetchPages);
+    ui->nonBlockingPaintCheckBox->setChecked(m_settings.m_nonBlockingPaint);
     ui->multithreadingComboBox->setCurrentIndex(ui->multithreadingComboBox->findData(static_cast<int>(m_settings.m_multithreadingStrategy)));
 
     // Rendering
@@ -309,6 +310,7 @@ void PDFViewerSettingsDialog::loadData()
     ui->maximumUndoStepsEdit->setValue(m_settings.m_maximumUndoSteps);
     ui->maximumRedoStepsEdit->setValue(m_settings.m_maximumRedoSteps);
     ui->developerModeCheckBox->setChecked(m_settings.m_allowDeveloperMode);
+    ui->singleInstanceCheckBox->setChecked(m_settings.m_singleInstance);
     ui->logicalPixelZoomCheckBox->setChecked(m_settings.m_features.testFlag(pdf::PDFRenderer::LogicalSizeZooming));
 
     // CMS
@@ -371,6 +373,7 @@ void PDFViewerSettingsDialog::loadData()
     ui->backgroundColorEdit->setText(m_cmsSettings.backgroundColor.name(QColor::HexRgb));
     ui->sigmoidFunctionSlopeEdit->setValue(m_cmsSettings.sigmoidSlopeFactor);
     ui->bitonalThresholdEdit->setValue(m_cmsSettings.bitonalThreshold);
+    ui->postRasterColorAdjustmentCheckBox->setChecked(m_settings.m_features.testFlag(pdf::PDFRenderer::ColorAdjust_PostRaster));
 
     // Text-to-speech
     ui->speechEnginesComboBox->setCurrentIndex(ui->speechEnginesComboBox->findData(m_settings.m_speechEngine));
@@ -409,6 +412,10 @@ void PDFViewerSettingsDialog::saveData()
     {
         m_settings.m_prefetchPages = ui->prefetchPagesCheckBox->isChecked();
     }
+    else if (sender == ui->nonBlockingPaintCheckBox)
+    {
+        m_settings.m_nonBlockingPaint = ui->nonBlockingPaintCheckBox->isChecked();
+    }
     else if (sender == ui->antialiasingCheckBox)
     {
         m_settings.m_features.setFlag(pdf::PDFRenderer::Antialiasing, ui->antialiasingCheckBox->isChecked());
@@ -461,6 +468,10 @@ void PDFViewerSettingsDialog::saveData()
     {
         m_settings.m_allowDeveloperMode = ui->developerModeCheckBox->isChecked();
     }
+    else if (sender == ui->singleInstanceCheckBox)
+    {
+        m_settings.m_singleInstance = ui->singleInstanceCheckBox->isChecked();
+    }
     else if (sender == ui->compiledPageCacheSizeEdit)
     {
         m_settings.m_compiledPageCacheLimit = ui->compiledPageCacheSizeEdit->value();
@@ -591,6 +602,10 @@ void PDFViewerSettingsDialog::saveData()
     {
         m_cmsSettings.bitonalThreshold = ui->bitonalThresholdEdit->value();
     }
+    else if (sender == ui->postRasterColorAdjustmentCheckBox)
+    {
+        m_settings.m_features.setFlag(pdf::PDFRenderer::ColorAdjust_PostRaster, ui->postRasterColorAdjustmentCheckBox->isChecked());
+    }
     else if (sender == ui->formHighlightFieldsCheckBox)
     {
         m_settings.m_formAppearanceFlags.setFlag(pdf::PDFFormManager::HighlightFields, ui->formHighlightFieldsCheckBox->isChecked());
@@ -89,7 +89,7 @@ void PDFCreateStickyNoteTool::onPointPicked(PDFInteger pageIndex, QPointF pagePo
 
         if (modifier.finalize())
         {
-            Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
         }
 
         setActive(false);
@@ -138,7 +138,7 @@ void PDFCreateHyperlinkTool::onRectanglePicked(PDFInteger pageIndex, QRectF page
 
         if (modifier.finalize())
         {
-            Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
         }
 
         setActive(false);
@@ -173,7 +173,7 @@ void PDFCreateFreeTextTool::onRectanglePicked(PDFInteger pageIndex, QRectF pageR
 
         if (modifier.finalize())
         {
-            Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
         }
 
         setActive(false);
@@ -255,7 +255,7 @@ void PDFCreateLineTypeTool::finishDefinition()
 
                 if (modifier.finalize())
                 {
-                    Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                    Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
                 }
 
                 setActive(false);
@@ -282,7 +282,7 @@ void PDFCreateLineTypeTool::finishDefinition()
 
                 if (modifier.finalize())
                 {
-                    Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                    Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
                 }
 
                 setActive(false);
@@ -315,7 +315,7 @@ void PDFCreateLineTypeTool::finishDefinition()
 
                 if (modifier.finalize())
                 {
-                    Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                    Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
                 }
 
                 setActive(false);
@@ -345,7 +345,7 @@ void PDFCreateLineTypeTool::finishDefinition()
 
                 if (modifier.finalize())
                 {
-                    Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                    Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
                 }
 
                 setActive(false);
@@ -651,7 +651,7 @@ void PDFCreateEllipseTool::onRectanglePicked(PDFInteger pageIndex, QRectF pageRe
 
     if (modifier.finalize())
     {
-        Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+        Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
     }
 
     setActive(false);
@@ -752,7 +752,7 @@ void PDFCreateFreehandCurveTool::mouseReleaseEvent(QWidget* widget, QMouseEvent*
 
                 if (modifier.finalize())
                 {
-                    Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                    Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
                 }
 
                 setActive(false);
@@ -910,7 +910,7 @@ void PDFCreateStampTool::onPointPicked(PDFInteger pageIndex, QPointF pagePoint)
 
     if (modifier.finalize())
     {
-        Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+        Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
     }
 
     setActive(false);
@@ -1023,7 +1023,7 @@ void PDFCreateHighlightTextTool::mouseReleaseEvent(QWidget* widget, QMouseEvent*
 
                     if (modifier.finalize())
                     {
-                        Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                        Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
                     }
                 }
             }
@@ -1154,7 +1154,7 @@ void PDFCreateRedactRectangleTool::onRectanglePicked(PDFInteger pageIndex, QRect
 
     if (modifier.finalize())
     {
-        Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+        Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
     }
 
     setActive(false);
@@ -1238,7 +1238,7 @@ void PDFCreateRedactTextTool::mouseReleaseEvent(QWidget* widget, QMouseEvent* ev
 
                     if (modifier.finalize())
                     {
-                        Q_EMIT m_toolManager->documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                        Q_EMIT m_toolManager->documentModified(modifier.getModifiedDocument());
                     }
                 }
             }
@@ -18,16 +18,25 @@
 #include "pdfcompiler.h"
 #include "pdfcms.h"
 #include "pdfprogress.h"
+#include "pdfdiskcache.h"
 #include "pdfexecutionpolicy.h"
 #include "pdftextlayoutgenerator.h"
 #include "pdfdrawspacecontroller.h"
+#include "pdfimage.h"
+#include "pdfcolorspaces.h"
+#include "pdfannotation.h"
+#include "pdftrace.h"
 
 #include <QCache>
+#include <QtMath>
+#include <QPainter>
+#include <QBuffer>
 #include <QtConcurrent/QtConcurrent>
 
 #include "pdfdbgheap.h"
 
 #include <execution>
+#include <algorithm>
 
 namespace pdf
 {
@@ -50,15 +59,44 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
         {
             while (!isInterruptionRequested())
             {
+                // Select tasks waiting for compilation. Only tasks with the highest
+                // priority are compiled in one batch, and batch size is limited, so
+                // newly requested visible pages don't wait for a large batch of
+                // prefetched pages or thumbnails.
                 std::vector<PDFAsynchronousPageCompiler::CompileTask> tasks;
                 for (auto& task : m_compiler->m_tasks)
                 {
-                    if (!task.second.finished)
+                    if (!task.second.finished && !task.second.running)
                     {
                         tasks.push_back(task.second);
                     }
                 }
 
+                auto comparator = [](const PDFAsynchronousPageCompiler::CompileTask& left, const PDFAsynchronousPageCompiler::CompileTask& right)
+                {
+                    return std::make_pair(left.priority, left.sequenceNumber) < std::make_pair(right.priority, right.sequenceNumber);
+                };
+                std::sort(tasks.begin(), tasks.end(), comparator);
+
+                if (!tasks.empty())
+                {
+                    const bool isParallelizing = PDFExecutionPolicy::isParallelizing(PDFExecutionPolicy::Scope::Page);
+                    const size_t maxBatchSize = isParallelizing ? size_t(qMax(PDFExecutionPolicy::getMaxThreadCount(PDFExecutionPolicy::Scope::Page), 1)) : 1;
+                    const auto priority = tasks.front().priority;
+                    auto it = std::find_if(tasks.begin(), tasks.end(), [priority](const auto& task) { return task.priority != priority; });
+                    tasks.erase(it, tasks.end());
+
+                    if (tasks.size() > maxBatchSize)
+                    {
+                        tasks.resize(maxBatchSize);
+                    }
+
+                    for (const auto& task : tasks)
+                    {
+                        m_compiler->m_tasks[task.pageIndex].running = true;
+                    }
+                }
+
                 if (!tasks.empty())
                 {
                     locker.unlock();
@@ -70,11 +108,33 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
                     auto compilePage = [this, proxy](PDFAsynchronousPageCompiler::CompileTask& task) -> PDFPrecompiledPage
                     {
                         PDFPrecompiledPage compiledPage;
+
+                        // Try to load page from the persistent disk cache first
+                        const QByteArray diskCacheKey = proxy->getDiskCacheKey("page", task.pageIndex);
+                        if (!diskCacheKey.isEmpty())
+                        {
+                            PDFPrecompiledPage cachedPage = PDFPrecompiledPage::deserialize(proxy->getDiskCache()->read(diskCacheKey));
+                            if (cachedPage.isValid())
+                            {
+                                task.precompiledPage = qMove(cachedPage);
+                                task.finished = true;
+                                return compiledPage;
+                            }
+                        }
+
                         PDFCMSPointer cms = proxy->getCMSManager()->getCurrentCMS();
-                        PDFRenderer renderer(proxy->getDocument(), proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(), proxy->getFeatures(), proxy->getMeshQualitySettings());
+                        PDFRenderer renderer(proxy->getDocument(), proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(), proxy->getCompileFeatures(), proxy->getMeshQualitySettings());
                         renderer.setOperationControl(m_compiler);
+                        renderer.setImagePreviewsEnabled(task.isImagePreviewAllowed);
                         renderer.compile(&task.precompiledPage, task.pageIndex);
                         task.finished = true;
+
+                        // Do not store pages, whose compilation was cancelled, they are incomplete. Pages
+                        // with image previews are not stored too, they will be compiled again.
+                        if (!diskCacheKey.isEmpty() && task.precompiledPage.isValid() && !task.precompiledPage.hasPreviewImages() && !m_compiler->isOperationCancelled())
+                        {
+                            proxy->getDiskCache()->write(diskCacheKey, task.precompiledPage.serialize());
+                        }
                         return compiledPage;
                     };
                     PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, tasks.begin(), tasks.end(), compilePage);
@@ -88,6 +148,7 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
                     bool isSomethingWritten = false;
                     for (auto& task : tasks)
                     {
+                        task.running = false;
                         if (task.finished)
                         {
                             isSomethingWritten = true;
@@ -117,17 +178,26 @@ void PDFAsynchronousPageCompilerWorkerThread::run()
 PDFAsynchronousPageCompiler::PDFAsynchronousPageCompiler(PDFDrawWidgetProxy* proxy) :
     BaseClass(proxy),
     m_proxy(proxy),
-    m_cache(new QCache<PDFInteger, PDFPrecompiledPage>())
+    m_cache(new QCache<PDFInteger, PDFPrecompiledPage>()),
+    m_compressedCache(new QCache<PDFInteger, QByteArray>())
 {
     m_cache->setMaxCost(128 * 1024 * 1024);
+    m_compressedCache->setMaxCost(m_cache->maxCost() / 4);
+    PDFCacheManager::getInstance()->registerCache(this);
+    PDFRuntimeStatisticsManager::getInstance()->registerProvider(this, tr("Compiled pages"));
 }
 
 PDFAsynchronousPageCompiler::~PDFAsynchronousPageCompiler()
 {
+    PDFRuntimeStatisticsManager::getInstance()->unregisterProvider(this);
+    PDFCacheManager::getInstance()->unregisterCache(this);
     stop(true);
 
     delete m_cache;
     m_cache = nullptr;
+
+    delete m_compressedCache;
+    m_compressedCache = nullptr;
 }
 
 bool PDFAsynchronousPageCompiler::isOperationCancelled() const
@@ -190,6 +260,7 @@ void PDFAsynchronousPageCompiler::stop(bool clearCache)
             if (clearCache)
             {
                 m_cache->clear();
+                m_compressedCache->clear();
             }
 
             m_state = State::Inactive;
@@ -211,12 +282,35 @@ void PDFAsynchronousPageCompiler::reset()
     start();
 }
 
+void PDFAsynchronousPageCompiler::removeFromCache(const std::vector<PDFInteger>& pages)
+{
+    Q_ASSERT(m_state == State::Inactive);
+
+    for (PDFInteger pageIndex : pages)
+    {
+        m_cache->remove(pageIndex);
+        m_compressedCache->remove(pageIndex);
+    }
+}
+
 void PDFAsynchronousPageCompiler::setCacheLimit(int limit)
 {
     m_cache->setMaxCost(limit);
+    m_compressedCache->setMaxCost(limit / 4);
+}
+
+qint64 PDFAsynchronousPageCompiler::getCacheLimit() const
+{
+    return m_cache->maxCost();
+}
+
+qint64 PDFAsynchronousPageCompiler::getAverageCompiledPageSize() const
+{
+    const qsizetype count = m_cache->count();
+    return count > 0 ? m_cache->totalCost() / count : 0;
 }
 
-const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFInteger pageIndex, bool compile)
+const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFInteger pageIndex, bool compile, Priority priority)
 {
     if (m_state != State::Active || !m_proxy->getDocument())
     {
@@ -225,15 +319,41 @@ const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFIntege
     }
 
     PDFPrecompiledPage* page = m_cache->object(pageIndex);
+    if (!page)
+    {
+        // Page was evicted, restoring it is much faster than compiling it again
+        page = decompressPage(pageIndex);
+    }
+
+    if (page && !page->hasPreviewImages())
+    {
+        m_hitCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_missCount.fetch_add(1, std::memory_order_relaxed);
+    }
 
-    if (!page && compile)
+    // Page with image previews is displayed, until it is compiled
+    // again with full quality images.
+    if ((!page || page->hasPreviewImages()) && compile)
     {
         QMutexLocker locker(&m_mutex);
-        if (!m_tasks.count(pageIndex))
+        auto it = m_tasks.find(pageIndex);
+        if (it == m_tasks.end())
         {
-            m_tasks.insert(std::make_pair(pageIndex, CompileTask(pageIndex)));
+            CompileTask task(pageIndex);
+            task.priority = priority;
+            task.sequenceNumber = m_sequenceNumber++;
+            task.isImagePreviewAllowed = !page && priority == Priority::Visible;
+            m_tasks.insert(std::make_pair(pageIndex, qMove(task)));
             m_waitCondition.wakeOne();
         }
+        else if (priority < it->second.priority && !it->second.running && !it->second.finished)
+        {
+            // Raise priority of the task waiting for compilation
+            it->second.priority = priority;
+        }
     }
 
     if (page)
@@ -244,6 +364,36 @@ const PDFPrecompiledPage* PDFAsynchronousPageCompiler::getCompiledPage(PDFIntege
     return page;
 }
 
+void PDFAsynchronousPageCompiler::removeStaleTasks(const std::vector<PDFInteger>& activePages)
+{
+    if (m_state != State::Active)
+    {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    Q_ASSERT(std::is_sorted(activePages.cbegin(), activePages.cend()));
+
+    for (auto it = m_tasks.begin(); it != m_tasks.end();)
+    {
+        const CompileTask& task = it->second;
+        const bool isStale = !task.running &&
+                             !task.finished &&
+                             task.priority != Priority::Thumbnail &&
+                             !std::binary_search(activePages.cbegin(), activePages.cend(), task.pageIndex);
+
+        if (isStale)
+        {
+            it = m_tasks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 void PDFAsynchronousPageCompiler::smartClearCache(const int milisecondsLimit, const std::vector<PDFInteger>& activePages)
 {
     if (m_state != State::Active)
@@ -268,15 +418,182 @@ void PDFAsynchronousPageCompiler::smartClearCache(const int milisecondsLimit, co
         const PDFPrecompiledPage* page = m_cache->object(pageIndex);
         if (page && page->hasExpired(milisecondsLimit))
         {
-            m_cache->remove(pageIndex);
+            compressPage(pageIndex);
+            m_evictionCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void PDFAsynchronousPageCompiler::compressPage(PDFInteger pageIndex)
+{
+    std::unique_ptr<PDFPrecompiledPage> page(m_cache->take(pageIndex));
+    if (page && page->isValid() && !page->hasPreviewImages())
+    {
+        // Serialized page is compressed. If it doesn't fit into the cache,
+        // it is deleted by the cache.
+        QByteArray* data = new QByteArray(page->serialize());
+        m_compressedCache->insert(pageIndex, data, data->size());
+    }
+}
+
+PDFPrecompiledPage* PDFAsynchronousPageCompiler::decompressPage(PDFInteger pageIndex)
+{
+    std::unique_ptr<QByteArray> data(m_compressedCache->take(pageIndex));
+    if (!data)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<PDFPrecompiledPage> page = std::make_unique<PDFPrecompiledPage>(PDFPrecompiledPage::deserialize(*data));
+    if (!page->isValid())
+    {
+        return nullptr;
+    }
+
+    page->markAccessed();
+    const qint64 memoryConsumptionEstimate = page->getMemoryConsumptionEstimate();
+
+    QMutexLocker locker(&m_mutex);
+    compressLeastRecentPages(m_cache->totalCost() + memoryConsumptionEstimate - m_cache->maxCost(), m_proxy->getActivePages());
+
+    PDFPrecompiledPage* restoredPage = page.release();
+    if (!m_cache->insert(pageIndex, restoredPage, memoryConsumptionEstimate))
+    {
+        // Page was deleted by the cache, it will be compiled again
+        return nullptr;
+    }
+
+    m_restoreCount.fetch_add(1, std::memory_order_relaxed);
+    return restoredPage;
+}
+
+void PDFAsynchronousPageCompiler::compressLeastRecentPages(qint64 bytes, const std::vector<PDFInteger>& activePages)
+{
+    if (bytes <= 0)
+    {
+        return;
+    }
+
+    std::vector<std::pair<quint64, PDFInteger>> candidates;
+    const QList<PDFInteger> pageIndices = m_cache->keys();
+    for (const PDFInteger pageIndex : pageIndices)
+    {
+        if (std::binary_search(activePages.cbegin(), activePages.cend(), pageIndex))
+        {
+            continue;
+        }
+
+        if (const PDFPrecompiledPage* page = m_cache->object(pageIndex))
+        {
+            candidates.emplace_back(page->getAccessStamp(), pageIndex);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    qint64 freed = 0;
+    for (auto it = candidates.cbegin(); it != candidates.cend() && freed < bytes; ++it)
+    {
+        const qint64 totalCost = m_cache->totalCost();
+        compressPage(it->second);
+        freed += totalCost - m_cache->totalCost();
+        m_evictionCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+qint64 PDFAsynchronousPageCompiler::getManagedCacheSize() const
+{
+    return m_cache->totalCost() + m_compressedCache->totalCost();
+}
+
+quint64 PDFAsynchronousPageCompiler::getLeastRecentAccessStamp() const
+{
+    if (m_state != State::Active)
+    {
+        return 0;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    // Active pages are never evicted, otherwise they would be compiled again
+    const std::vector<PDFInteger> activePages = m_proxy->getActivePages();
+
+    quint64 stamp = 0;
+    const QList<PDFInteger> pageIndices = m_cache->keys();
+    for (const PDFInteger pageIndex : pageIndices)
+    {
+        if (std::binary_search(activePages.cbegin(), activePages.cend(), pageIndex))
+        {
+            continue;
+        }
+
+        const PDFPrecompiledPage* page = m_cache->object(pageIndex);
+        if (page && (stamp == 0 || page->getAccessStamp() < stamp))
+        {
+            stamp = page->getAccessStamp();
         }
     }
+
+    return stamp;
+}
+
+int PDFAsynchronousPageCompiler::getRecreationCost() const
+{
+    return 3;
+}
+
+qint64 PDFAsynchronousPageCompiler::evict(qint64 bytes)
+{
+    if (m_state != State::Active)
+    {
+        // Jakub Melka: Cache clearing can be done only in active state
+        return 0;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    // Compressed pages consume part of the freed memory, so more bytes are
+    // requested. If it is still not enough, compressed pages are discarded.
+    const qint64 cacheSize = getManagedCacheSize();
+    compressLeastRecentPages(bytes + bytes / 4, m_proxy->getActivePages());
+
+    const qint64 remainingBytes = bytes - (cacheSize - getManagedCacheSize());
+    if (remainingBytes > 0)
+    {
+        // Decreasing of the maximal cost removes least recently used compressed pages
+        const qsizetype maxCost = m_compressedCache->maxCost();
+        m_compressedCache->setMaxCost(qsizetype(qMax(qint64(m_compressedCache->totalCost()) - remainingBytes, qint64(0))));
+        m_compressedCache->setMaxCost(maxCost);
+    }
+
+    return cacheSize - getManagedCacheSize();
+}
+
+void PDFAsynchronousPageCompiler::collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const
+{
+    size_t taskCount = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        taskCount = m_tasks.size();
+    }
+
+    collector->addGauge(tr("Cached pages"), m_cache->count());
+    collector->addGauge(tr("Cache size"), m_cache->totalCost(), PDFRuntimeStatistic::Unit::Bytes);
+    collector->addGauge(tr("Cache limit"), m_cache->maxCost(), PDFRuntimeStatistic::Unit::Bytes);
+    collector->addGauge(tr("Average page size"), getAverageCompiledPageSize(), PDFRuntimeStatistic::Unit::Bytes);
+    collector->addGauge(tr("Compressed pages"), m_compressedCache->count());
+    collector->addGauge(tr("Compressed cache size"), m_compressedCache->totalCost(), PDFRuntimeStatistic::Unit::Bytes);
+    collector->addHitRate(tr("Page"), m_hitCount.load(std::memory_order_relaxed), m_missCount.load(std::memory_order_relaxed));
+    collector->addCounter(tr("Evicted pages"), m_evictionCount.load(std::memory_order_relaxed));
+    collector->addCounter(tr("Restored pages"), m_restoreCount.load(std::memory_order_relaxed));
+    collector->addGauge(tr("Compile tasks"), taskCount);
 }
 
 void PDFAsynchronousPageCompiler::onPageCompiled()
 {
     std::vector<PDFInteger> compiledPages;
     std::map<PDFInteger, PDFRenderError> errors;
+    const std::vector<PDFInteger> activePages = m_proxy->getActivePages();
 
     {
         QMutexLocker locker(&m_mutex);
@@ -293,8 +610,19 @@ void PDFAsynchronousPageCompiler::onPageCompiled()
                     PDFPrecompiledPage* page = new PDFPrecompiledPage(std::move(task.precompiledPage));
                     page->markAccessed();
                     qint64 memoryConsumptionEstimate = page->getMemoryConsumptionEstimate();
+
+                    // Old version of the page is replaced. Make room for the page by compressing
+                    // least recently accessed pages, otherwise the cache would discard them.
+                    m_cache->remove(it->first);
+                    m_compressedCache->remove(it->first);
+                    compressLeastRecentPages(m_cache->totalCost() + memoryConsumptionEstimate - m_cache->maxCost(), activePages);
+
+                    // Pages removed by the cache to make room for the inserted
+                    // page are counted as evictions (replaced page is not).
+                    const qsizetype expectedCount = m_cache->count() + (m_cache->contains(it->first) ? 0 : 1);
                     if (m_cache->insert(it->first, page, memoryConsumptionEstimate))
                     {
+                        m_evictionCount.fetch_add(quint64(qMax(expectedCount - m_cache->count(), qsizetype(0))), std::memory_order_relaxed);
                         compiledPages.push_back(it->first);
                     }
                     else
@@ -335,6 +663,12 @@ PDFAsynchronousTextLayoutCompiler::PDFAsynchronousTextLayoutCompiler(PDFDrawWidg
     m_cache(std::bind(&PDFAsynchronousTextLayoutCompiler::createTextLayout, this, std::placeholders::_1))
 {
     connect(&m_textLayoutCompileFutureWatcher, &QFutureWatcher<PDFTextLayoutStorage>::finished, this, &PDFAsynchronousTextLayoutCompiler::onTextLayoutCreated);
+    PDFRuntimeStatisticsManager::getInstance()->registerProvider(this, tr("Text layouts"));
+}
+
+PDFAsynchronousTextLayoutCompiler::~PDFAsynchronousTextLayoutCompiler()
+{
+    PDFRuntimeStatisticsManager::getInstance()->unregisterProvider(this);
 }
 
 void PDFAsynchronousTextLayoutCompiler::start()
@@ -368,8 +702,10 @@ void PDFAsynchronousTextLayoutCompiler::stop(bool clearCache)
 
         case State::Active:
         {
-            // Stop the engine
+            // Stop the engine. Running text layout compilation is cancelled,
+            // and its incomplete result is discarded, when it is delivered.
             m_state = State::Stopping;
+            m_isCancelled = m_isRunning;
             m_textLayoutCompileFutureWatcher.waitForFinished();
 
             if (clearCache)
@@ -397,6 +733,45 @@ void PDFAsynchronousTextLayoutCompiler::reset()
     start();
 }
 
+void PDFAsynchronousTextLayoutCompiler::updateTextLayouts(const std::vector<PDFInteger>& pages)
+{
+    Q_ASSERT(m_state == State::Active);
+
+    m_cache.clear();
+
+    if (!m_textLayouts || pages.empty())
+    {
+        return;
+    }
+
+    const PDFCatalog* catalog = m_proxy->getDocument()->getCatalog();
+    if (m_textLayouts->getCount() != catalog->getPageCount())
+    {
+        // Page count has been changed, text layout is not valid anymore
+        m_textLayouts = std::nullopt;
+        return;
+    }
+
+    // Text layout storage is taken away during the update, so text layouts
+    // of changed pages are created from the document, not from the storage.
+    PDFTextLayoutStorage textLayouts = qMove(*m_textLayouts);
+    m_textLayouts = std::nullopt;
+
+    QMutex mutex;
+    auto updateTextLayout = [this, &textLayouts, &mutex](PDFInteger pageIndex)
+    {
+        textLayouts.setTextLayout(pageIndex, createTextLayout(pageIndex), &mutex);
+    };
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pages.cbegin(), pages.cend(), updateTextLayout);
+
+    if (textLayouts.hasSearchIndex())
+    {
+        textLayouts.buildSearchIndex();
+    }
+
+    m_textLayouts = qMove(textLayouts);
+}
+
 PDFTextLayout PDFAsynchronousTextLayoutCompiler::createTextLayout(PDFInteger pageIndex)
 {
     PDFTextLayout result;
@@ -431,8 +806,9 @@ PDFTextLayout PDFAsynchronousTextLayoutCompiler::createTextLayout(PDFInteger pag
         bool guard = false;
         m_proxy->getFontCache()->setCacheShrinkEnabled(&guard, false);
 
+        PDF_TRACE_SPAN_ARG("text", "Text layout", "page", pageIndex);
         PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
-        PDFTextLayoutGenerator generator(m_proxy->getFeatures(), page, m_proxy->getDocument(), m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
+        PDFTextLayoutGenerator generator(m_proxy->getCompileFeatures(), page, m_proxy->getDocument(), m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
         generator.processContents();
         result = generator.createTextLayout();
         m_proxy->getFontCache()->setCacheShrinkEnabled(&guard, true);
@@ -462,6 +838,91 @@ PDFTextLayoutGetter PDFAsynchronousTextLayoutCompiler::getTextLayoutLazy(PDFInte
     return PDFTextLayoutGetter(&m_cache, pageIndex);
 }
 
+PDFFindResults PDFAsynchronousTextLayoutCompiler::findText(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags)
+{
+    if (const PDFTextLayoutStorage* textLayouts = getTextLayoutStorage())
+    {
+        return textLayouts->find(text, caseSensitivity, flowFlags);
+    }
+
+    PDFFindResults results;
+
+    if (m_state != State::Active || !m_proxy->getDocument())
+    {
+        // Engine is not active, do not search
+        return results;
+    }
+
+    // Raw text doesn't contain whitespaces and words can be ordered differently
+    // than in the text layout, so we check each word of the text separately.
+    QStringList words;
+    for (const QString& word : text.simplified().split(QChar(' '), Qt::SkipEmptyParts))
+    {
+        QString searchText = PDFTextLayoutStorage::createSearchText(word);
+        if (!searchText.isEmpty())
+        {
+            words << qMove(searchText);
+        }
+    }
+
+    if (words.isEmpty())
+    {
+        return results;
+    }
+
+    bool guard = false;
+    m_proxy->getFontCache()->setCacheShrinkEnabled(&guard, false);
+
+    const PDFCatalog* catalog = m_proxy->getDocument()->getCatalog();
+    PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
+
+    QMutex resultsMutex;
+    auto findImpl = [this, catalog, cms, &words, &text, caseSensitivity, flowFlags, &results, &resultsMutex](PDFInteger pageIndex)
+    {
+        const PDFPage* page = catalog->getPage(pageIndex);
+        if (!page)
+        {
+            // Invalid page index
+            return;
+        }
+
+        // Quick pre-pass - extract raw text only
+        PDFTextLayoutGenerator rawTextGenerator(m_proxy->getCompileFeatures(), page, m_proxy->getDocument(), m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
+        rawTextGenerator.setRawTextOnly(true);
+        rawTextGenerator.processContents();
+
+        const QString rawText = PDFTextLayoutStorage::createSearchText(rawTextGenerator.getRawText());
+        if (!std::all_of(words.cbegin(), words.cend(), [&rawText, caseSensitivity](const QString& word) { return rawText.contains(word, caseSensitivity); }))
+        {
+            return;
+        }
+
+        PDFTextLayoutGenerator generator(m_proxy->getCompileFeatures(), page, m_proxy->getDocument(), m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
+        generator.processContents();
+        PDFTextLayout textLayout = generator.createTextLayout();
+
+        PDFTextFlows textFlows = PDFTextFlow::createTextFlows(textLayout, flowFlags, pageIndex);
+        for (const PDFTextFlow& textFlow : textFlows)
+        {
+            PDFFindResults flowResults = textFlow.find(text, caseSensitivity);
+
+            if (!flowResults.empty())
+            {
+                QMutexLocker lock(&resultsMutex);
+                results.insert(results.end(), flowResults.begin(), flowResults.end());
+            }
+        }
+    };
+
+    auto pageRange = PDFIntegerRange<PDFInteger>(0, catalog->getPageCount());
+    PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), findImpl);
+
+    m_proxy->getFontCache()->setCacheShrinkEnabled(&guard, true);
+
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
 PDFTextSelection PDFAsynchronousTextLayoutCompiler::getTextSelectionAll(QColor color) const
 {
     PDFTextSelection result;
@@ -548,12 +1009,32 @@ void PDFAsynchronousTextLayoutCompiler::makeTextLayout()
 
     PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
 
-    auto createTextLayout = [this, cms, catalog]() -> PDFTextLayoutStorage
+    // Text layouts with search index are stored in the disk cache, so
+    // they are not created again, when the same document is opened.
+    PDFDiskCache* diskCache = m_proxy->getDiskCache();
+    const QByteArray diskCacheKey = m_proxy->getDiskCacheKey("textlayout", -1);
+
+    auto createTextLayout = [this, cms, catalog, diskCache, diskCacheKey]() -> PDFTextLayoutStorage
     {
+        if (!diskCacheKey.isEmpty())
+        {
+            PDFTextLayoutStorage cachedResult = PDFTextLayoutStorage::deserialize(diskCache->read(diskCacheKey));
+            if (cachedResult.getCount() == catalog->getPageCount() && cachedResult.hasSearchIndex())
+            {
+                return cachedResult;
+            }
+        }
+
         PDFTextLayoutStorage result(catalog->getPageCount());
         QMutex mutex;
         auto generateTextLayout = [this, &result, &mutex, cms, catalog](PDFInteger pageIndex)
         {
+            if (isOperationCancelled())
+            {
+                // Compilation is cancelled, skip remaining pages
+                return;
+            }
+
             if (!catalog->getPage(pageIndex))
             {
                 // Invalid page index
@@ -564,7 +1045,9 @@ void PDFAsynchronousTextLayoutCompiler::makeTextLayout()
             const PDFPage* page = catalog->getPage(pageIndex);
             Q_ASSERT(page);
 
-            PDFTextLayoutGenerator generator(m_proxy->getFeatures(), page, m_proxy->getDocument(), m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
+            PDF_TRACE_SPAN_ARG("text", "Text layout", "page", pageIndex);
+            PDFTextLayoutGenerator generator(m_proxy->getCompileFeatures(), page, m_proxy->getDocument(), m_proxy->getFontCache(), cms.data(), m_proxy->getOptionalContentActivity(), QTransform(), m_proxy->getMeshQualitySettings());
+            generator.setOperationControl(this);
             generator.processContents();
             result.setTextLayout(pageIndex, generator.createTextLayout(), &mutex);
             m_proxy->getProgress()->step();
@@ -572,6 +1055,17 @@ void PDFAsynchronousTextLayoutCompiler::makeTextLayout()
 
         auto pageRange = PDFIntegerRange<PDFInteger>(0, catalog->getPageCount());
         PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, pageRange.begin(), pageRange.end(), generateTextLayout);
+
+        if (!isOperationCancelled())
+        {
+            result.buildSearchIndex();
+
+            if (!diskCacheKey.isEmpty())
+            {
+                diskCache->write(diskCacheKey, result.serialize());
+            }
+        }
+
         return result;
     };
 
@@ -580,15 +1074,776 @@ void PDFAsynchronousTextLayoutCompiler::makeTextLayout()
     m_textLayoutCompileFutureWatcher.setFuture(m_textLayoutCompileFuture);
 }
 
+bool PDFAsynchronousTextLayoutCompiler::isOperationCancelled() const
+{
+    return m_state == State::Stopping;
+}
+
+void PDFAsynchronousTextLayoutCompiler::collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const
+{
+    const PDFTextLayoutStorage* storage = getTextLayoutStorage();
+    collector->addGauge(tr("Pages in storage"), storage ? storage->getCount() : 0);
+    collector->addGauge(tr("Storage size"), storage ? storage->getMemoryConsumptionEstimate() : 0, PDFRuntimeStatistic::Unit::Bytes);
+    collector->addGauge(tr("Search index built"), storage && storage->hasSearchIndex() ? 1 : 0);
+    collector->addHitRate(tr("Layout"), m_cache.getHitCount(), m_cache.getMissCount());
+}
+
 void PDFAsynchronousTextLayoutCompiler::onTextLayoutCreated()
 {
     m_proxy->getFontCache()->setCacheShrinkEnabled(this, true);
     m_proxy->getProgress()->finish();
-    m_cache.clear();
-
-    m_textLayouts = m_textLayoutCompileFuture.result();
     m_isRunning = false;
-    Q_EMIT textLayoutChanged();
+
+    if (m_isCancelled)
+    {
+        // Result is incomplete, compile text layout again, if engine is active
+        m_isCancelled = false;
+        makeTextLayout();
+        return;
+    }
+
+    m_cache.clear();
+    m_textLayouts = m_textLayoutCompileFuture.result();
+    Q_EMIT textLayoutChanged();
+}
+
+PDFAsynchronousTileRenderer::PDFAsynchronousTileRenderer(PDFDrawWidgetProxy* proxy) :
+    BaseClass(proxy),
+    m_proxy(proxy),
+    m_features(PDFRenderer::getDefaultFeatures()),
+    m_tiles(new QCache<TileKey, QImage>(DEFAULT_CACHE_LIMIT))
+{
+    connect(&m_renderFutureWatcher, &QFutureWatcher<std::vector<TileTask>>::finished, this, &PDFAsynchronousTileRenderer::onTilesRendered);
+}
+
+PDFAsynchronousTileRenderer::~PDFAsynchronousTileRenderer()
+{
+    m_renderFuture.waitForFinished();
+    delete m_tiles;
+}
+
+bool PDFAsynchronousTileRenderer::isTiled(const QRect& pageRect, const QRect& viewRect, const QTransform& baseMatrix) const
+{
+    if (!m_enabled || baseMatrix.type() > QTransform::TxTranslate)
+    {
+        return false;
+    }
+
+    if (m_nonBlockingPaint)
+    {
+        return true;
+    }
+
+    const qint64 pageArea = qint64(pageRect.width()) * qint64(pageRect.height());
+    const qint64 viewArea = qint64(viewRect.width()) * qint64(viewRect.height());
+    return pageArea > TILING_AREA_FACTOR * viewArea;
+}
+
+void PDFAsynchronousTileRenderer::drawPage(QPainter* painter,
+                                           PDFInteger pageIndex,
+                                           const PDFPrecompiledPage* compiledPage,
+                                           const QRect& pageRect,
+                                           const QRect& viewRect,
+                                           PDFRenderer::Features features,
+                                           bool drawPaper,
+                                           PDFReal opacity)
+{
+    const PDFPage* page = m_proxy->getDocument()->getCatalog()->getPage(pageIndex);
+    const QRect visibleRect = pageRect.intersected(viewRect).translated(-pageRect.topLeft());
+    if (!page || visibleRect.isEmpty())
+    {
+        return;
+    }
+
+    // Tiles are rendered with given features and device pixel ratio,
+    // if any of them is changed, then all tiles are invalid.
+    const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+    if (m_features != features || !qFuzzyCompare(m_devicePixelRatio, devicePixelRatio))
+    {
+        clear(true, { });
+        m_features = features;
+        m_devicePixelRatio = devicePixelRatio;
+    }
+
+    std::shared_ptr<const PDFPrecompiledPage> snapshot = getPageSnapshot(pageIndex, compiledPage);
+
+    // Pending tasks of this page are replaced by tasks for the currently
+    // visible area, so tiles scrolled out of view are not rendered.
+    m_pendingTasks.erase(std::remove_if(m_pendingTasks.begin(), m_pendingTasks.end(), [pageIndex](const TileTask& task) { return task.key.pageIndex == pageIndex; }), m_pendingTasks.end());
+
+    const QSize pageSize = pageRect.size();
+    const QRect pageTileSpaceRect(QPoint(0, 0), pageSize);
+    const QTransform pageMatrix = m_proxy->createPagePointToDevicePointMatrix(page, pageTileSpaceRect);
+
+    TileTask task;
+    task.key.pageIndex = pageIndex;
+    task.key.rotation = m_proxy->getPageRotation();
+    task.key.drawPaper = drawPaper;
+    task.generation = m_generation;
+    task.cropBox = page->getCropBox();
+    task.backgroundColor = drawPaper ? m_proxy->getRasterPaperColor() : QColor(Qt::transparent);
+    task.features = features;
+    task.page = snapshot;
+
+    // Low resolution preview of the whole page is rendered first, it is used
+    // in place of the tiles, which are not rendered yet.
+    const Preview* preview = nullptr;
+    auto itPreview = m_previews.find(pageIndex);
+    if (itPreview != m_previews.end() && itPreview->second.rotation == task.key.rotation && itPreview->second.drawPaper == drawPaper)
+    {
+        preview = &itPreview->second;
+    }
+    else if (qMax(pageSize.width(), pageSize.height()) > PREVIEW_SIZE)
+    {
+        // Small pages (drawn using tiles in non-blocking paint mode) do not
+        // need a preview, it would take the same time as rendering the tiles.
+        const PDFReal previewScale = qMin(1.0, PDFReal(PREVIEW_SIZE) / qMax(pageSize.width(), pageSize.height()));
+        const QSize previewSize(qMax(qRound(pageSize.width() * previewScale), 1), qMax(qRound(pageSize.height() * previewScale), 1));
+
+        TileTask previewTask = task;
+        previewTask.key.pageSize = previewSize;
+        previewTask.imageSize = previewSize;
+        previewTask.matrix = m_proxy->createPagePointToDevicePointMatrix(page, QRect(QPoint(0, 0), previewSize));
+        requestTile(qMove(previewTask));
+    }
+
+    task.key.pageSize = pageSize;
+
+    auto getTileRect = [pageTileSpaceRect](int x, int y)
+    {
+        return QRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE).intersected(pageTileSpaceRect);
+    };
+
+    auto requestTileAt = [&, this](int x, int y)
+    {
+        const QRect tileRect = getTileRect(x, y);
+
+        TileTask tileTask = task;
+        tileTask.key.x = x;
+        tileTask.key.y = y;
+        tileTask.imageSize = QSize(qCeil(tileRect.width() * devicePixelRatio), qCeil(tileRect.height() * devicePixelRatio));
+        tileTask.matrix = pageMatrix * QTransform::fromTranslate(-tileRect.left(), -tileRect.top()) * QTransform::fromScale(devicePixelRatio, devicePixelRatio);
+        requestTile(qMove(tileTask));
+    };
+
+    const int firstColumn = visibleRect.left() / TILE_SIZE;
+    const int lastColumn = visibleRect.right() / TILE_SIZE;
+    const int firstRow = visibleRect.top() / TILE_SIZE;
+    const int lastRow = visibleRect.bottom() / TILE_SIZE;
+
+    painter->save();
+    painter->setClipRect(visibleRect.translated(pageRect.topLeft()), Qt::IntersectClip);
+    painter->setOpacity(opacity);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+
+    TileKey key = task.key;
+    auto isTileMissing = [&, this](int x, int y)
+    {
+        key.x = x;
+        key.y = y;
+        return !m_tiles->contains(key);
+    };
+
+    bool isAnyTileMissing = false;
+    for (int y = firstRow; y <= lastRow && !isAnyTileMissing; ++y)
+    {
+        for (int x = firstColumn; x <= lastColumn && !isAnyTileMissing; ++x)
+        {
+            isAnyTileMissing = isTileMissing(x, y);
+        }
+    }
+
+    // If some visible tile is missing, we draw the preview first, then the tiles
+    // of the previous zoom level (scaled), and rendered tiles are then drawn over it.
+    // So the user sees stale, but sharp image, until new tiles are rendered.
+    auto itSnapshot = m_pages.find(pageIndex);
+    if (isAnyTileMissing)
+    {
+        if (preview)
+        {
+            const PDFReal scaleX = PDFReal(preview->image.width()) / pageSize.width();
+            const PDFReal scaleY = PDFReal(preview->image.height()) / pageSize.height();
+            const QRectF sourceRect(visibleRect.left() * scaleX, visibleRect.top() * scaleY, visibleRect.width() * scaleX, visibleRect.height() * scaleY);
+            painter->drawImage(QRectF(visibleRect.translated(pageRect.topLeft())), preview->image, sourceRect);
+        }
+
+        const QSize stalePageSize = itSnapshot != m_pages.end() ? itSnapshot->second.completePageSize : QSize();
+        if (stalePageSize.isValid() && stalePageSize != pageSize)
+        {
+            const PDFReal scaleX = PDFReal(stalePageSize.width()) / pageSize.width();
+            const PDFReal scaleY = PDFReal(stalePageSize.height()) / pageSize.height();
+            const QRect stalePageRect(QPoint(0, 0), stalePageSize);
+            const QRect staleVisibleRect = QRectF(visibleRect.left() * scaleX, visibleRect.top() * scaleY, visibleRect.width() * scaleX, visibleRect.height() * scaleY).toAlignedRect().intersected(stalePageRect);
+
+            if (!staleVisibleRect.isEmpty() && qMax(scaleX, scaleY) <= MAX_STALE_TILE_SCALE)
+            {
+                TileKey staleKey = task.key;
+                staleKey.pageSize = stalePageSize;
+
+                for (int y = staleVisibleRect.top() / TILE_SIZE; y <= staleVisibleRect.bottom() / TILE_SIZE; ++y)
+                {
+                    for (int x = staleVisibleRect.left() / TILE_SIZE; x <= staleVisibleRect.right() / TILE_SIZE; ++x)
+                    {
+                        staleKey.x = x;
+                        staleKey.y = y;
+
+                        if (const QImage* image = m_tiles->object(staleKey))
+                        {
+                            const QRect staleTileRect = QRect(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE).intersected(stalePageRect);
+                            const QRectF targetRect(staleTileRect.left() / scaleX, staleTileRect.top() / scaleY, staleTileRect.width() / scaleX, staleTileRect.height() / scaleY);
+                            painter->drawImage(targetRect.translated(pageRect.topLeft()), *image);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    else if (itSnapshot != m_pages.end())
+    {
+        itSnapshot->second.completePageSize = pageSize;
+    }
+
+    for (int y = firstRow; y <= lastRow; ++y)
+    {
+        for (int x = firstColumn; x <= lastColumn; ++x)
+        {
+            key.x = x;
+            key.y = y;
+
+            if (const QImage* image = m_tiles->object(key))
+            {
+                painter->drawImage(getTileRect(x, y).translated(pageRect.topLeft()), *image);
+            }
+            else
+            {
+                requestTileAt(x, y);
+            }
+        }
+    }
+
+    painter->restore();
+
+    // Prefetch tiles around the visible area, so they are ready, when view is scrolled
+    const QRect prefetchRect = visibleRect.adjusted(-TILE_SIZE, -TILE_SIZE, TILE_SIZE, TILE_SIZE).intersected(pageTileSpaceRect);
+    for (int y = prefetchRect.top() / TILE_SIZE; y <= prefetchRect.bottom() / TILE_SIZE; ++y)
+    {
+        for (int x = prefetchRect.left() / TILE_SIZE; x <= prefetchRect.right() / TILE_SIZE; ++x)
+        {
+            const bool isVisible = x >= firstColumn && x <= lastColumn && y >= firstRow && y <= lastRow;
+            if (!isVisible && isTileMissing(x, y))
+            {
+                requestTileAt(x, y);
+            }
+        }
+    }
+
+    startRendering();
+}
+
+void PDFAsynchronousTileRenderer::clear(bool all, const std::vector<PDFInteger>& pages)
+{
+    if (all)
+    {
+        ++m_generation;
+        m_tiles->clear();
+        m_pages.clear();
+        m_previews.clear();
+        m_pendingTasks.clear();
+    }
+    else
+    {
+        for (PDFInteger pageIndex : pages)
+        {
+            removePage(pageIndex);
+        }
+    }
+}
+
+void PDFAsynchronousTileRenderer::setCacheLimit(int limit)
+{
+    m_tiles->setMaxCost(limit);
+}
+
+void PDFAsynchronousTileRenderer::setEnabled(bool enabled)
+{
+    if (m_enabled != enabled)
+    {
+        m_enabled = enabled;
+
+        if (!m_enabled)
+        {
+            clear(true, { });
+        }
+    }
+}
+
+std::shared_ptr<const PDFPrecompiledPage> PDFAsynchronousTileRenderer::getPageSnapshot(PDFInteger pageIndex, const PDFPrecompiledPage* compiledPage)
+{
+    auto it = m_pages.find(pageIndex);
+    if (it != m_pages.end() && it->second.source != compiledPage)
+    {
+        // Page was recompiled, tiles of the old page are invalid
+        removePage(pageIndex);
+        it = m_pages.end();
+    }
+
+    if (it == m_pages.end())
+    {
+        // Snapshots hold copy of the precompiled page, so we limit their count
+        while (m_pages.size() >= MAX_PAGE_SNAPSHOTS)
+        {
+            auto itOldest = std::min_element(m_pages.begin(), m_pages.end(), [](const auto& l, const auto& r) { return l.second.lastUsed < r.second.lastUsed; });
+            if (itOldest->second.lastUsed > m_frameUseCounter)
+            {
+                // All snapshots are used in the current frame
+                break;
+            }
+            removePage(itOldest->first);
+        }
+
+        PageSnapshot snapshot;
+        snapshot.source = compiledPage;
+        snapshot.page = std::make_shared<const PDFPrecompiledPage>(*compiledPage);
+        it = m_pages.emplace(pageIndex, qMove(snapshot)).first;
+    }
+
+    it->second.lastUsed = ++m_useCounter;
+    return it->second.page;
+}
+
+void PDFAsynchronousTileRenderer::requestTile(TileTask task)
+{
+    auto isSameTile = [&task](const TileTask& otherTask) { return otherTask.key == task.key; };
+    if (std::find(m_runningTiles.cbegin(), m_runningTiles.cend(), task.key) != m_runningTiles.cend() ||
+        std::any_of(m_pendingTasks.cbegin(), m_pendingTasks.cend(), isSameTile))
+    {
+        return;
+    }
+
+    m_pendingTasks.push_back(qMove(task));
+}
+
+void PDFAsynchronousTileRenderer::startRendering()
+{
+    if (m_isRunning || m_pendingTasks.empty())
+    {
+        return;
+    }
+
+    // Previews are rendered first, then the tiles in the order, in which
+    // they were requested (visible tiles are requested before prefetched ones).
+    std::stable_partition(m_pendingTasks.begin(), m_pendingTasks.end(), [](const TileTask& task) { return task.key.isPreview(); });
+
+    // Render only a small batch of tiles at once, so pending tiles can be
+    // replaced by other tiles, when view is being scrolled.
+    const size_t batchSize = qMin(m_pendingTasks.size(), size_t(qMax(QThread::idealThreadCount(), 1) * 2));
+    std::vector<TileTask> tasks(std::make_move_iterator(m_pendingTasks.begin()), std::make_move_iterator(std::next(m_pendingTasks.begin(), batchSize)));
+    m_pendingTasks.erase(m_pendingTasks.begin(), std::next(m_pendingTasks.begin(), batchSize));
+
+    m_runningTiles.clear();
+    for (const TileTask& task : tasks)
+    {
+        m_runningTiles.push_back(task.key);
+    }
+
+    auto renderTiles = [tasks]() -> std::vector<TileTask>
+    {
+        std::vector<TileTask> result = tasks;
+
+        auto renderTile = [](TileTask& task)
+        {
+            task.image = QImage(task.imageSize, QImage::Format_ARGB32_Premultiplied);
+            task.image.fill(task.backgroundColor);
+
+            QPainter painter(&task.image);
+            task.page->draw(&painter, task.cropBox, task.matrix, task.features, 1.0);
+            painter.end();
+
+            PDFRenderer::applyPostRasterColorAdjustment(task.features, task.image);
+        };
+        PDFExecutionPolicy::execute(PDFExecutionPolicy::Scope::Page, result.begin(), result.end(), renderTile);
+        return result;
+    };
+
+    m_isRunning = true;
+    m_renderFuture = QtConcurrent::run(renderTiles);
+    m_renderFutureWatcher.setFuture(m_renderFuture);
+}
+
+void PDFAsynchronousTileRenderer::removePage(PDFInteger pageIndex)
+{
+    m_pages.erase(pageIndex);
+    m_previews.erase(pageIndex);
+    m_pendingTasks.erase(std::remove_if(m_pendingTasks.begin(), m_pendingTasks.end(), [pageIndex](const TileTask& task) { return task.key.pageIndex == pageIndex; }), m_pendingTasks.end());
+
+    const QList<TileKey> keys = m_tiles->keys();
+    for (const TileKey& key : keys)
+    {
+        if (key.pageIndex == pageIndex)
+        {
+            m_tiles->remove(key);
+        }
+    }
+}
+
+void PDFAsynchronousTileRenderer::onTilesRendered()
+{
+    std::vector<TileTask> tasks = m_renderFuture.result();
+    m_isRunning = false;
+    m_runningTiles.clear();
+
+    bool isChanged = false;
+    for (TileTask& task : tasks)
+    {
+        // Discard tiles of cleared pages or of the recompiled pages
+        auto it = m_pages.find(task.key.pageIndex);
+        if (task.generation != m_generation || it == m_pages.end() || it->second.page != task.page)
+        {
+            continue;
+        }
+
+        if (task.key.isPreview())
+        {
+            Preview preview;
+            preview.rotation = task.key.rotation;
+            preview.drawPaper = task.key.drawPaper;
+            preview.image = qMove(task.image);
+            m_previews[task.key.pageIndex] = qMove(preview);
+        }
+        else
+        {
+            const qsizetype cost = task.image.sizeInBytes();
+            m_tiles->insert(task.key, new QImage(qMove(task.image)), cost);
+        }
+
+        isChanged = true;
+    }
+
+    startRendering();
+
+    if (isChanged)
+    {
+        Q_EMIT tilesRendered();
+    }
+}
+
+PDFAsynchronousThumbnailRenderer::PDFAsynchronousThumbnailRenderer(PDFDrawWidgetProxy* proxy) :
+    BaseClass(proxy),
+    m_proxy(proxy)
+{
+    // Thumbnails are rendered in their own thread pool with low
+    // priority, so they do not slow down rendering of visible pages.
+    m_threadPool.setMaxThreadCount(qMax(QThread::idealThreadCount() / 2, 1));
+    m_threadPool.setThreadPriority(QThread::LowPriority);
+
+    connect(&m_renderFutureWatcher, &QFutureWatcher<ThumbnailTask>::finished, this, &PDFAsynchronousThumbnailRenderer::onThumbnailsRendered);
+}
+
+PDFAsynchronousThumbnailRenderer::~PDFAsynchronousThumbnailRenderer()
+{
+    stop();
+}
+
+QImage PDFAsynchronousThumbnailRenderer::getThumbnail(PDFInteger pageIndex, int pixelSize)
+{
+    const std::pair<PDFInteger, int> key(pageIndex, pixelSize);
+
+    auto it = m_thumbnails.find(key);
+    if (it != m_thumbnails.end())
+    {
+        QImage image = qMove(it->second);
+        m_thumbnails.erase(it);
+        return image;
+    }
+
+    const PDFDocument* document = m_proxy->getDocument();
+    const PDFPage* page = document ? document->getCatalog()->getPage(pageIndex) : nullptr;
+    if (!page)
+    {
+        return QImage();
+    }
+
+    auto isSameThumbnail = [&key](const ThumbnailTask& task) { return task.pageIndex == key.first && task.pixelSize == key.second; };
+    if (std::find(m_runningTasks.cbegin(), m_runningTasks.cend(), key) != m_runningTasks.cend() ||
+        std::any_of(m_pendingTasks.cbegin(), m_pendingTasks.cend(), isSameThumbnail))
+    {
+        return QImage();
+    }
+
+    QSizeF pageSize = page->getRotatedMediaBox().size();
+    pageSize.scale(pixelSize, pixelSize, Qt::KeepAspectRatio);
+
+    ThumbnailTask task;
+    task.pageIndex = pageIndex;
+    task.pixelSize = pixelSize;
+    task.imageSize = pageSize.toSize();
+    // Thumbnails are rasterized, so they depend also on the post-raster color adjustment
+    task.diskCacheKey = m_proxy->getDiskCacheKey("thumbnail", pageIndex, QByteArray::number(pixelSize) + "/" + QByteArray::number(int(m_proxy->getFeatures())));
+
+    if (task.imageSize.isValid())
+    {
+        m_pendingTasks.push_back(qMove(task));
+        startRendering();
+    }
+
+    return QImage();
+}
+
+void PDFAsynchronousThumbnailRenderer::clear(bool all, const std::vector<PDFInteger>& pages)
+{
+    if (all)
+    {
+        ++m_generation;
+        m_pageRevisions.clear();
+        m_thumbnails.clear();
+        m_pendingTasks.clear();
+    }
+    else
+    {
+        for (PDFInteger pageIndex : pages)
+        {
+            ++m_pageRevisions[pageIndex];
+            m_thumbnails.erase(m_thumbnails.lower_bound(std::make_pair(pageIndex, std::numeric_limits<int>::min())),
+                               m_thumbnails.upper_bound(std::make_pair(pageIndex, std::numeric_limits<int>::max())));
+            m_pendingTasks.erase(std::remove_if(m_pendingTasks.begin(), m_pendingTasks.end(), [pageIndex](const ThumbnailTask& task) { return task.pageIndex == pageIndex; }), m_pendingTasks.end());
+        }
+    }
+}
+
+void PDFAsynchronousThumbnailRenderer::stop()
+{
+    clear(true, { });
+
+    if (m_isRunning)
+    {
+        // Incomplete thumbnails are discarded, when they are delivered
+        m_isCancelled = true;
+        m_renderFuture.waitForFinished();
+        m_isCancelled = false;
+    }
+}
+
+void PDFAsynchronousThumbnailRenderer::setRendererEngine(RendererEngine rendererEngine)
+{
+    // Thumbnails are small, so they are rendered in parallel
+    // by the thread pool, not by the renderer engine.
+    if (rendererEngine == RendererEngine::Blend2D_MultiThread)
+    {
+        rendererEngine = RendererEngine::Blend2D_SingleThread;
+    }
+
+    if (m_rendererEngine != rendererEngine)
+    {
+        m_rendererEngine = rendererEngine;
+        clear(true, { });
+    }
+}
+
+bool PDFAsynchronousThumbnailRenderer::isOperationCancelled() const
+{
+    return m_isCancelled;
+}
+
+void PDFAsynchronousThumbnailRenderer::renderThumbnail(ThumbnailTask& task)
+{
+    // Try to load thumbnail from the persistent disk cache first
+    if (task.diskCache && !task.diskCacheKey.isEmpty())
+    {
+        task.image.loadFromData(task.diskCache->read(task.diskCacheKey), "PNG");
+        if (!task.image.isNull())
+        {
+            return;
+        }
+    }
+
+    const PDFPage* page = task.document->getCatalog()->getPage(task.pageIndex);
+    if (!page)
+    {
+        return;
+    }
+
+    task.image = getEmbeddedThumbnail(task.document, page, task.imageSize, task.cms.data(), task.operationControl);
+
+    if (task.image.isNull())
+    {
+        // Thumbnail is small, so we can use lower quality settings
+        PDFRenderer::Features features = task.features;
+        features.setFlag(PDFRenderer::TextAntialiasing, false);
+
+        PDFMeshQualitySettings meshQualitySettings = task.meshQualitySettings;
+        meshQualitySettings.tolerance *= MESH_QUALITY_REDUCTION;
+        meshQualitySettings.patchFlatnessTolerance *= MESH_QUALITY_REDUCTION;
+        meshQualitySettings.patchTestPoints = qMax(meshQualitySettings.patchTestPoints / PDFInteger(MESH_QUALITY_REDUCTION), PDFInteger(4));
+
+        PDFPrecompiledPage compiledPage;
+        PDFRenderer renderer(task.document, task.fontCache, task.cms.data(), task.optionalContentActivity, features, meshQualitySettings);
+        renderer.setOperationControl(task.operationControl);
+        renderer.setImageResolutionHint(PDFRenderer::calculateImageResolutionHint(page, task.imageSize));
+        renderer.compile(&compiledPage, task.pageIndex);
+
+        if (task.operationControl->isOperationCancelled())
+        {
+            return;
+        }
+
+        // We can const-cast here, because we do not modify the document in annotation manager.
+        // Annotations are just rendered to the thumbnail.
+        PDFModifiedDocument modifiedDocument(const_cast<PDFDocument*>(task.document), const_cast<PDFOptionalContentActivity*>(task.optionalContentActivity));
+        PDFAnnotationManager annotationManager(task.fontCache, task.cmsManager, task.optionalContentActivity, meshQualitySettings, features, PDFAnnotationManager::Target::View, nullptr);
+        annotationManager.setDocument(modifiedDocument);
+
+        PDFRasterizer rasterizer(nullptr);
+        rasterizer.reset(task.rendererEngine);
+        task.image = rasterizer.render(task.pageIndex, page, &compiledPage, task.imageSize, features, &annotationManager, PageRotation::None);
+    }
+
+    if (!task.image.isNull() && task.diskCache && !task.diskCacheKey.isEmpty() && !task.operationControl->isOperationCancelled())
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QBuffer::WriteOnly);
+        task.image.save(&buffer, "PNG");
+        buffer.close();
+        task.diskCache->write(task.diskCacheKey, data);
+    }
+}
+
+QImage PDFAsynchronousThumbnailRenderer::getEmbeddedThumbnail(const PDFDocument* document,
+                                                              const PDFPage* page,
+                                                              QSize imageSize,
+                                                              const PDFCMS* cms,
+                                                              const PDFOperationControl* operationControl)
+{
+    const PDFObject thumbnailObject = document->getObject(page->getThumbnail(&document->getStorage()));
+    if (!thumbnailObject.isStream())
+    {
+        return QImage();
+    }
+
+    const PDFStream* stream = thumbnailObject.getStream();
+    const PDFDictionary* dictionary = stream->getDictionary();
+
+    // Check thumbnail size before the image is decoded, thumbnail must have
+    // the same aspect ratio as the page (it can be stale, or unrotated).
+    PDFDocumentDataLoaderDecorator loader(document);
+    const QSize thumbnailSize(loader.readIntegerFromDictionary(dictionary, "Width", 0), loader.readIntegerFromDictionary(dictionary, "Height", 0));
+    if (thumbnailSize.isEmpty() ||
+        imageSize.isEmpty() ||
+        qMax(thumbnailSize.width(), thumbnailSize.height()) < qMax(imageSize.width(), imageSize.height()) * EMBEDDED_THUMBNAIL_MIN_SCALE ||
+        qAbs(PDFReal(thumbnailSize.width()) / thumbnailSize.height() - PDFReal(imageSize.width()) / imageSize.height()) > 0.05)
+    {
+        return QImage();
+    }
+
+    try
+    {
+        PDFColorSpacePointer colorSpace;
+        const PDFObject& colorSpaceObject = document->getObject(dictionary->get("ColorSpace"));
+        if (colorSpaceObject.isName() || colorSpaceObject.isArray())
+        {
+            PDFDictionary dummyColorSpaceDictionary;
+            colorSpace = PDFAbstractColorSpace::createColorSpace(&dummyColorSpaceDictionary, document, colorSpaceObject);
+        }
+
+        PDFRenderErrorReporterDummy dummyErrorReporter;
+        PDFImage image = PDFImage::createImage(document, stream, qMove(colorSpace), false, RenderingIntent::Perceptual, &dummyErrorReporter, operationControl);
+        QImage thumbnail = image.getImage(cms, &dummyErrorReporter, operationControl);
+
+        if (!thumbnail.isNull())
+        {
+            return thumbnail.scaled(imageSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        }
+    }
+    catch (const PDFException&)
+    {
+        // Invalid embedded thumbnail, page will be rendered
+    }
+    catch (const PDFRendererException&)
+    {
+        // Invalid embedded thumbnail, page will be rendered
+    }
+
+    return QImage();
+}
+
+void PDFAsynchronousThumbnailRenderer::startRendering()
+{
+    const PDFDocument* document = m_proxy->getDocument();
+    if (m_isRunning || m_pendingTasks.empty() || !document)
+    {
+        return;
+    }
+
+    // Render only a small batch of thumbnails at once, so thumbnails, which
+    // were requested lately (for example, when thumbnails are scrolled),
+    // are rendered as soon as possible.
+    const size_t batchSize = qMin(m_pendingTasks.size(), size_t(m_threadPool.maxThreadCount() * 2));
+    std::vector<ThumbnailTask> tasks(std::make_move_iterator(std::prev(m_pendingTasks.end(), batchSize)), std::make_move_iterator(m_pendingTasks.end()));
+    m_pendingTasks.erase(std::prev(m_pendingTasks.end(), batchSize), m_pendingTasks.end());
+
+    PDFCMSPointer cms = m_proxy->getCMSManager()->getCurrentCMS();
+
+    m_runningTasks.clear();
+    for (ThumbnailTask& task : tasks)
+    {
+        task.generation = m_generation;
+        task.pageRevision = m_pageRevisions[task.pageIndex];
+        task.diskCache = m_proxy->getDiskCache();
+        task.document = document;
+        task.fontCache = m_proxy->getFontCache();
+        task.cmsManager = m_proxy->getCMSManager();
+        task.cms = cms;
+        task.optionalContentActivity = m_proxy->getOptionalContentActivity();
+        task.features = m_proxy->getFeatures();
+        task.meshQualitySettings = m_proxy->getMeshQualitySettings();
+        task.rendererEngine = m_rendererEngine;
+        task.operationControl = this;
+        m_runningTasks.emplace_back(task.pageIndex, task.pixelSize);
+    }
+
+    auto renderTask = [](const ThumbnailTask& task) -> ThumbnailTask
+    {
+        ThumbnailTask result = task;
+        renderThumbnail(result);
+        return result;
+    };
+
+    m_proxy->getFontCache()->setCacheShrinkEnabled(this, false);
+    m_isRunning = true;
+    m_renderFuture = QtConcurrent::mapped(&m_threadPool, qMove(tasks), renderTask);
+    m_renderFutureWatcher.setFuture(m_renderFuture);
+}
+
+void PDFAsynchronousThumbnailRenderer::onThumbnailsRendered()
+{
+    QList<ThumbnailTask> tasks = m_renderFuture.results();
+    m_isRunning = false;
+    m_runningTasks.clear();
+    m_proxy->getFontCache()->setCacheShrinkEnabled(this, true);
+
+    std::vector<PDFInteger> pages;
+    for (ThumbnailTask& task : tasks)
+    {
+        // Discard thumbnails of cleared pages
+        auto it = m_pageRevisions.find(task.pageIndex);
+        const quint64 pageRevision = it != m_pageRevisions.end() ? it->second : 0;
+        if (task.generation != m_generation || task.pageRevision != pageRevision || task.image.isNull())
+        {
+            continue;
+        }
+
+        m_thumbnails[std::make_pair(task.pageIndex, task.pixelSize)] = qMove(task.image);
+        pages.push_back(task.pageIndex);
+    }
+
+    startRendering();
+
+    if (!pages.empty())
+    {
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+        Q_EMIT thumbnailsRendered(pages);
+    }
 }
 
 }   // namespace pdf
@@ -23,16 +23,26 @@
 #include "pdfrenderer.h"
 #include "pdfpainter.h"
 #include "pdftextlayout.h"
+#include "pdfpage.h"
+#include "pdfcms.h"
+#include "pdfcachemanager.h"
+#include "pdfruntimestatistics.h"
 
+#include <QImage>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QThreadPool>
 #include <QWaitCondition>
 
+#include <atomic>
+#include <memory>
+
 template <class Key, class T>
 class QCache;
 
 namespace pdf
 {
+class PDFDiskCache;
 class PDFDrawWidgetProxy;
 class PDFAsynchronousPageCompiler;
 
@@ -57,8 +67,12 @@ private:
 
 /// Asynchronous page compiler compiles pages asynchronously, and stores them in the
 /// cache. Cache size can be set. This object is designed to cooperate with
-/// draw widget proxy.
-class PDFAsynchronousPageCompiler : public QObject, public PDFOperationControl
+/// draw widget proxy. Memory of the cache is also managed by the cache manager,
+/// pages, which are not active, can be evicted to fit into the memory budget.
+/// Evicted pages are not discarded, they are serialized (compressed) and stored
+/// in the second tier cache, so they can be restored quickly without compilation,
+/// when they become visible again.
+class PDFAsynchronousPageCompiler : public QObject, public PDFOperationControl, public PDFManagedCache, public PDFRuntimeStatisticsProvider
 {
     Q_OBJECT
 
@@ -85,10 +99,24 @@ public:
     /// Resets the engine - calls stop and then calls start.
     void reset();
 
-    /// Sets cache limit in bytes
+    /// Removes compiled pages from the cache (for example, when content
+    /// of these pages has been changed), other pages are preserved.
+    /// Call this function only if engine is stopped.
+    /// \param pages Pages to be removed
+    void removeFromCache(const std::vector<PDFInteger>& pages);
+
+    /// Sets cache limit in bytes. Limit of the cache of compressed
+    /// pages is set to the quarter of this limit.
     /// \param limit Cache limit [bytes]
     void setCacheLimit(int limit);
 
+    /// Returns cache limit in bytes
+    qint64 getCacheLimit() const;
+
+    /// Returns average memory consumption estimate of the compiled
+    /// pages in the cache in bytes (zero, if cache is empty)
+    qint64 getAverageCompiledPageSize() const;
+
     enum class State
     {
         Inactive,
@@ -99,20 +127,43 @@ public:
     /// Returns current state of compiler
     State getState() const { return m_state; }
 
+    /// Priority of the compile request. Pages with higher priority are
+    /// compiled first (visible pages before prefetched pages, prefetched
+    /// pages before thumbnails).
+    enum class Priority
+    {
+        Visible,
+        Prefetch,
+        Thumbnail
+    };
+
     /// Return proxy
     PDFDrawWidgetProxy* getProxy() const { return m_proxy; }
 
     /// Tries to retrieve precompiled page from the cache. If page is not found,
     /// then nullptr is returned (no exception is thrown). If \p compile is set to true,
     /// and page is not found, and compiler is active, then new asynchronous compile
-    /// task is performed.
+    /// task is performed. If page is already waiting for compilation with lower
+    /// priority, then its priority is raised. Visible pages with large images are
+    /// compiled with image previews first, so they can be displayed quickly. When
+    /// such page is retrieved, it is compiled again with full quality images.
+    /// Pages evicted to the cache of compressed pages are restored synchronously.
     /// \param pageIndex Index of page
     /// \param compile Compile the page, if it is not found in the cache
-    const PDFPrecompiledPage* getCompiledPage(PDFInteger pageIndex, bool compile);
+    /// \param priority Priority of the compile task
+    const PDFPrecompiledPage* getCompiledPage(PDFInteger pageIndex, bool compile, Priority priority = Priority::Visible);
+
+    /// Removes stale compile tasks, i.e. tasks of visible and prefetched pages,
+    /// which were not started yet and which are not in \p activePages. Call this
+    /// function, when viewport is changed, so pages scrolled away do not delay
+    /// compilation of newly visible pages. Thumbnail requests are kept.
+    /// \param activePages Sorted vector of active pages
+    void removeStaleTasks(const std::vector<PDFInteger>& activePages);
 
     /// Performs smart cache clear. Too old pages are removed from the cache,
-    /// but only if these pages are not in active pages. Use this function to
-    /// clear cache to avoid huge memory consumption.
+    /// but only if these pages are not in active pages. Removed pages are moved
+    /// to the cache of compressed pages. Use this function to clear cache to
+    /// avoid huge memory consumption.
     /// \param milisecondsLimit Pages with access time above this limit will be erased
     /// \param activePages Sorted vector of active pages, which should remain in cache
     void smartClearCache(const int milisecondsLimit, const std::vector<PDFInteger>& activePages);
@@ -120,6 +171,17 @@ public:
     /// Is operation being cancelled?
     virtual bool isOperationCancelled() const override;
 
+    // Jakub Melka: Functions of the managed cache access the cache of compiled
+    // pages, which is not thread safe, so cache manager must be trimmed from
+    // the main thread.
+    virtual qint64 getManagedCacheSize() const override;
+    virtual quint64 getLeastRecentAccessStamp() const override;
+    virtual int getRecreationCost() const override;
+    virtual qint64 evict(qint64 bytes) override;
+
+    /// Adds cache size, hit rate and eviction count of compiled pages
+    virtual void collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const override;
+
 signals:
     void pageImageChanged(bool all, const std::vector<pdf::PDFInteger>& pages);
     void renderingError(pdf::PDFInteger pageIndex, const QList<pdf::PDFRenderError>& errors);
@@ -129,30 +191,57 @@ private:
 
     void onPageCompiled();
 
+    /// Moves page from the cache to the cache of compressed pages. Pages with
+    /// image previews are not compressed, they are just removed from the cache.
+    /// \param pageIndex Index of page
+    void compressPage(PDFInteger pageIndex);
+
+    /// Restores page from the cache of compressed pages to the cache. If page
+    /// is not found in the cache of compressed pages, nullptr is returned.
+    /// \param pageIndex Index of page
+    PDFPrecompiledPage* decompressPage(PDFInteger pageIndex);
+
+    /// Moves least recently accessed pages, which are not active, to the cache
+    /// of compressed pages, until at least \p bytes bytes are freed in the cache.
+    /// \param bytes Bytes to be freed
+    /// \param activePages Sorted vector of active pages, which should remain in cache
+    void compressLeastRecentPages(qint64 bytes, const std::vector<PDFInteger>& activePages);
+
     struct CompileTask
     {
         CompileTask() = default;
         CompileTask(PDFInteger pageIndex) : pageIndex(pageIndex) { }
 
         PDFInteger pageIndex = 0;
+        Priority priority = Priority::Visible;
+        quint64 sequenceNumber = 0; ///< Order of the request, older requests are compiled first
+        bool isImagePreviewAllowed = false; ///< Large images can be decoded as previews (page is then compiled again)
+        bool running = false;
         bool finished = false;
         PDFPrecompiledPage precompiledPage;
     };
 
     State m_state = State::Inactive;
-    QMutex m_mutex;
+    mutable QMutex m_mutex;
     QWaitCondition m_waitCondition;
     PDFAsynchronousPageCompilerWorkerThread* m_thread = nullptr;
 
     PDFDrawWidgetProxy* m_proxy;
     QCache<PDFInteger, PDFPrecompiledPage>* m_cache;
+    QCache<PDFInteger, QByteArray>* m_compressedCache;
 
     /// This task is protected by mutex. Every access to this
     /// variable must be done with locked mutex.
     std::map<PDFInteger, CompileTask> m_tasks;
+    quint64 m_sequenceNumber = 0;
+
+    std::atomic<quint64> m_hitCount = 0;
+    std::atomic<quint64> m_missCount = 0;
+    std::atomic<quint64> m_evictionCount = 0;
+    std::atomic<quint64> m_restoreCount = 0;
 };
 
-class PDF4QTLIBWIDGETSSHARED_EXPORT PDFAsynchronousTextLayoutCompiler : public QObject
+class PDF4QTLIBWIDGETSSHARED_EXPORT PDFAsynchronousTextLayoutCompiler : public QObject, public PDFOperationControl, public PDFRuntimeStatisticsProvider
 {
     Q_OBJECT
 
@@ -161,6 +250,7 @@ private:
 
 public:
     explicit PDFAsynchronousTextLayoutCompiler(PDFDrawWidgetProxy* proxy);
+    virtual ~PDFAsynchronousTextLayoutCompiler() override;
 
     /// Starts the engine. Call this function only if the engine
     /// is stopped.
@@ -177,6 +267,13 @@ public:
     /// Resets the engine - calls stop and then calls start.
     void reset();
 
+    /// Updates text layouts of given pages (for example, when content of these
+    /// pages has been changed), text layouts of other pages are preserved, so text
+    /// layout of the whole document need not to be created again. Text layouts
+    /// are created synchronously. Call this function only if engine is active.
+    /// \param pages Pages to be updated
+    void updateTextLayouts(const std::vector<PDFInteger>& pages);
+
     enum class State
     {
         Inactive,
@@ -215,6 +312,22 @@ public:
     /// Returns text layout storage (if it is ready), or nullptr
     const PDFTextLayoutStorage* getTextLayoutStorage() const { return isTextLayoutReady() ? &m_textLayouts.value() : nullptr; }
 
+    /// Finds simple text in all pages. If text layout is ready, then it is used
+    /// for searching. Otherwise, text layout of the document is not created, instead,
+    /// raw text of each page is extracted from its content stream (without text layout
+    /// analysis), and text layout is created only for pages, whose raw text contains
+    /// all words of the searched text. Function is synchronous.
+    /// \param text Text to be found
+    /// \param caseSensitivity Case sensitivity
+    /// \param flowFlags Text flow flags
+    PDFFindResults findText(const QString& text, Qt::CaseSensitivity caseSensitivity, PDFTextFlow::FlowFlags flowFlags);
+
+    /// Is operation being cancelled?
+    virtual bool isOperationCancelled() const override;
+
+    /// Adds size of text layout storage and hit rate of text layout cache
+    virtual void collectRuntimeStatistics(PDFRuntimeStatisticsCollector* collector) const override;
+
 signals:
     void textLayoutChanged();
 
@@ -224,12 +337,300 @@ private:
     PDFDrawWidgetProxy* m_proxy;
     State m_state = State::Inactive;
     bool m_isRunning;
+    bool m_isCancelled = false; ///< Text layout being created was cancelled, result must be discarded
     std::optional<PDFTextLayoutStorage> m_textLayouts;
     QFuture<PDFTextLayoutStorage> m_textLayoutCompileFuture;
     QFutureWatcher<PDFTextLayoutStorage> m_textLayoutCompileFutureWatcher;
     PDFTextLayoutCache m_cache;
 };
 
+/// Asynchronous tile renderer draws pages, which are much larger than the visible
+/// area (for example, large drawings at high zoom), as a grid of fixed-size raster
+/// tiles. Tiles are rendered in the background from a snapshot of the precompiled
+/// page and are stored in the cache, so only newly exposed tiles must be rendered,
+/// when view is scrolled. Until tile is rendered, low resolution preview of the
+/// page and tiles of the previous zoom level (scaled) are displayed in its place.
+/// In non-blocking paint mode, all pages are drawn using tiles, so GUI thread
+/// never rasterizes page content, it only draws finished images.
+class PDF4QTLIBWIDGETSSHARED_EXPORT PDFAsynchronousTileRenderer : public QObject
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    explicit PDFAsynchronousTileRenderer(PDFDrawWidgetProxy* proxy);
+    virtual ~PDFAsynchronousTileRenderer() override;
+
+    /// Size of the tile in pixels
+    static constexpr int TILE_SIZE = 256;
+
+    /// Returns true, if page placed in the rectangle \p pageRect should be drawn
+    /// using tiles. Tiles are used only for pages, which are much larger than
+    /// visible area (or for all pages in non-blocking paint mode), and only
+    /// if painter isn't scaled or rotated.
+    /// \param pageRect Page rectangle in widget space
+    /// \param viewRect Visible rectangle in widget space
+    /// \param baseMatrix Base transformation of the painter
+    bool isTiled(const QRect& pageRect, const QRect& viewRect, const QTransform& baseMatrix) const;
+
+    /// Draws visible tiles of the page. Missing tiles are requested for background
+    /// rendering and their area is filled with low resolution preview of the page,
+    /// if it is available. Signal \p tilesRendered is emitted, when requested tiles
+    /// are rendered.
+    /// \param painter Painter
+    /// \param pageIndex Page index
+    /// \param compiledPage Precompiled page
+    /// \param pageRect Page rectangle in widget space
+    /// \param viewRect Visible rectangle in widget space
+    /// \param features Rendering features
+    /// \param drawPaper Draw background paper
+    /// \param opacity Page graphics opacity
+    void drawPage(QPainter* painter,
+                  PDFInteger pageIndex,
+                  const PDFPrecompiledPage* compiledPage,
+                  const QRect& pageRect,
+                  const QRect& viewRect,
+                  PDFRenderer::Features features,
+                  bool drawPaper,
+                  PDFReal opacity);
+
+    /// Clears tiles of the given pages. If \p all is true, then all tiles
+    /// are cleared. Tiles being rendered are discarded.
+    /// \param all Clear all tiles
+    /// \param pages Pages, whose tiles should be cleared
+    void clear(bool all, const std::vector<PDFInteger>& pages);
+
+    /// Sets cache limit in bytes. Limit of the cache of compressed
+    /// pages is set to the quarter of this limit.
+    /// \param limit Cache limit [bytes]
+    void setCacheLimit(int limit);
+
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+
+    bool isNonBlockingPaintEnabled() const { return m_nonBlockingPaint; }
+    void setNonBlockingPaintEnabled(bool enabled) { m_nonBlockingPaint = enabled; }
+
+    /// Starts new frame. Call this function before pages are drawn. Page
+    /// snapshots used in the current frame are not removed, even if their
+    /// count exceeds the limit, otherwise tiles of the visible pages would
+    /// be discarded and rendered again in each frame.
+    void beginFrame() { m_frameUseCounter = m_useCounter; }
+
+signals:
+    void tilesRendered();
+
+private:
+    /// Pages larger than this multiple of the visible area are drawn using tiles
+    static constexpr qint64 TILING_AREA_FACTOR = 4;
+
+    /// Maximal size of the preview image in pixels
+    static constexpr int PREVIEW_SIZE = 1024;
+
+    /// Maximal number of page snapshots, which are held by the renderer
+    static constexpr size_t MAX_PAGE_SNAPSHOTS = 4;
+
+    /// Tiles of the previous zoom level are used in place of missing tiles
+    /// only, if they are at most this times larger than the current tiles.
+    static constexpr PDFReal MAX_STALE_TILE_SCALE = 4.0;
+
+    /// Default limit of the tile cache in bytes
+    static constexpr int DEFAULT_CACHE_LIMIT = 128 * 1024 * 1024;
+
+    struct TileKey
+    {
+        bool operator==(const TileKey&) const = default;
+
+        PDFInteger pageIndex = -1;
+        QSize pageSize; ///< Size of the page in pixels (determines zoom level)
+        PageRotation rotation = PageRotation::None;
+        bool drawPaper = true;
+        int x = -1;     ///< Tile column, -1 for page preview
+        int y = -1;     ///< Tile row, -1 for page preview
+
+        bool isPreview() const { return x < 0; }
+
+        friend inline size_t qHash(const TileKey& key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.pageIndex, key.pageSize.width(), key.pageSize.height(), int(key.rotation), key.drawPaper, key.x, key.y);
+        }
+    };
+
+    struct TileTask
+    {
+        TileKey key;
+        quint64 generation = 0;
+        QSize imageSize;
+        QRectF cropBox;
+        QTransform matrix;
+        QColor backgroundColor;
+        PDFRenderer::Features features;
+        std::shared_ptr<const PDFPrecompiledPage> page;
+        QImage image;
+    };
+
+    struct PageSnapshot
+    {
+        const PDFPrecompiledPage* source = nullptr;
+        std::shared_ptr<const PDFPrecompiledPage> page;
+        QSize completePageSize; ///< Page size, at which all visible tiles were drawn
+        quint64 lastUsed = 0;
+    };
+
+    struct Preview
+    {
+        PageRotation rotation = PageRotation::None;
+        bool drawPaper = true;
+        QImage image;
+    };
+
+    /// Returns snapshot of the precompiled page. If page was recompiled,
+    /// then tiles of the page are cleared and new snapshot is created.
+    std::shared_ptr<const PDFPrecompiledPage> getPageSnapshot(PDFInteger pageIndex, const PDFPrecompiledPage* compiledPage);
+
+    /// Requests rendering of the tile, if it isn't already requested
+    void requestTile(TileTask task);
+
+    /// Starts rendering of pending tiles, if renderer is idle
+    void startRendering();
+
+    /// Removes all data (tiles, preview, snapshot, pending tasks) of the page
+    void removePage(PDFInteger pageIndex);
+
+    void onTilesRendered();
+
+    PDFDrawWidgetProxy* m_proxy;
+    bool m_enabled = true;
+    bool m_nonBlockingPaint = false;
+    bool m_isRunning = false;
+    quint64 m_generation = 0;
+    quint64 m_useCounter = 0;
+    quint64 m_frameUseCounter = 0;
+    PDFRenderer::Features m_features;
+    qreal m_devicePixelRatio = 1.0;
+    QCache<TileKey, QImage>* m_tiles;
+    std::map<PDFInteger, PageSnapshot> m_pages;
+    std::map<PDFInteger, Preview> m_previews;
+    std::vector<TileTask> m_pendingTasks;
+    std::vector<TileKey> m_runningTiles;
+    QFuture<std::vector<TileTask>> m_renderFuture;
+    QFutureWatcher<std::vector<TileTask>> m_renderFutureWatcher;
+};
+
+/// Asynchronous thumbnail renderer renders small page images (for example, for
+/// thumbnails in the sidebar) independently of the page compiler, so thumbnails
+/// do not compete with pages displayed in the view. Thumbnails are taken from
+/// the persistent disk cache, or embedded thumbnail image of the page is used,
+/// if it is large enough. Otherwise, page is compiled with reduced quality
+/// settings (images decoded in reduced resolution, no text antialiasing, coarse
+/// shading meshes) and rasterized. Rendering is performed in renderer's own
+/// thread pool with low thread priority.
+class PDF4QTLIBWIDGETSSHARED_EXPORT PDFAsynchronousThumbnailRenderer : public QObject, public PDFOperationControl
+{
+    Q_OBJECT
+
+private:
+    using BaseClass = QObject;
+
+public:
+    explicit PDFAsynchronousThumbnailRenderer(PDFDrawWidgetProxy* proxy);
+    virtual ~PDFAsynchronousThumbnailRenderer() override;
+
+    /// Returns rendered thumbnail of the page. Larger of the thumbnail width
+    /// or height equals to pixel size. If thumbnail isn't rendered yet, then
+    /// its rendering is requested and null image is returned. Signal \p thumbnailsRendered
+    /// is emitted, when requested thumbnails are rendered. Rendered thumbnail
+    /// is returned only once, caller is responsible for caching it.
+    /// \param pageIndex Page index
+    /// \param pixelSize Pixel size
+    QImage getThumbnail(PDFInteger pageIndex, int pixelSize);
+
+    /// Clears thumbnails of the given pages. If \p all is true, then all thumbnails
+    /// are cleared. Thumbnails being rendered are discarded.
+    /// \param all Clear all thumbnails
+    /// \param pages Pages, whose thumbnails should be cleared
+    void clear(bool all, const std::vector<PDFInteger>& pages);
+
+    /// Clears all thumbnails and waits, until rendering of the thumbnails
+    /// is finished. Call this function before document is changed.
+    void stop();
+
+    /// Sets renderer engine used for rasterization of the thumbnails
+    void setRendererEngine(RendererEngine rendererEngine);
+
+    /// Is operation being cancelled?
+    virtual bool isOperationCancelled() const override;
+
+    /// Returns embedded thumbnail image of the page scaled to the requested size,
+    /// or null image, if page doesn't have suitable embedded thumbnail (it is too
+    /// small, or it has different aspect ratio, than the page). This function
+    /// is thread safe.
+    /// \param document Document
+    /// \param page Page
+    /// \param imageSize Requested size of the thumbnail
+    /// \param cms Color management system
+    /// \param operationControl Operation control (can be nullptr)
+    static QImage getEmbeddedThumbnail(const PDFDocument* document,
+                                       const PDFPage* page,
+                                       QSize imageSize,
+                                       const PDFCMS* cms,
+                                       const PDFOperationControl* operationControl);
+
+signals:
+    void thumbnailsRendered(const std::vector<pdf::PDFInteger>& pages);
+
+private:
+    /// Embedded thumbnail is used, if it is at least this fraction of the requested size
+    static constexpr PDFReal EMBEDDED_THUMBNAIL_MIN_SCALE = 0.5;
+
+    /// Shading meshes of the thumbnails are created with this times larger tolerances
+    static constexpr PDFReal MESH_QUALITY_REDUCTION = 4.0;
+
+    struct ThumbnailTask
+    {
+        PDFInteger pageIndex = -1;
+        int pixelSize = 0;
+        QSize imageSize;
+        quint64 generation = 0;
+        quint64 pageRevision = 0;
+        QByteArray diskCacheKey;
+        PDFDiskCache* diskCache = nullptr;
+        const PDFDocument* document = nullptr;
+        PDFFontCache* fontCache = nullptr;
+        const PDFCMSManager* cmsManager = nullptr;
+        PDFCMSPointer cms;
+        const PDFOptionalContentActivity* optionalContentActivity = nullptr;
+        PDFRenderer::Features features;
+        PDFMeshQualitySettings meshQualitySettings;
+        RendererEngine rendererEngine = RendererEngine::QPainter;
+        const PDFOperationControl* operationControl = nullptr;
+        QImage image;
+    };
+
+    /// Renders the thumbnail, this function is called in the worker thread
+    static void renderThumbnail(ThumbnailTask& task);
+
+    /// Starts rendering of pending thumbnails, if renderer is idle
+    void startRendering();
+
+    void onThumbnailsRendered();
+
+    PDFDrawWidgetProxy* m_proxy;
+    bool m_isRunning = false;
+    std::atomic_bool m_isCancelled = false;
+    quint64 m_generation = 0;
+    RendererEngine m_rendererEngine = RendererEngine::Blend2D_SingleThread;
+    std::map<PDFInteger, quint64> m_pageRevisions;
+    std::map<std::pair<PDFInteger, int>, QImage> m_thumbnails;
+    std::vector<ThumbnailTask> m_pendingTasks;
+    std::vector<std::pair<PDFInteger, int>> m_runningTasks;
+    QThreadPool m_threadPool;
+    QFuture<ThumbnailTask> m_renderFuture;
+    QFutureWatcher<ThumbnailTask> m_renderFutureWatcher;
+};
+
 }   // namespace pdf
 
 #endif // PDFCOMPILER_H
@@ -25,12 +25,18 @@
 #include "pdfdrawwidget.h"
 #include "pdfwidgetannotation.h"
 #include "pdfpainterutils.h"
+#include "pdfdiskcache.h"
+#include "pdfpagecontenthash.h"
+#include "pdfoptionalcontent.h"
+#include "pdfcachemanager.h"
+#include "pdfruntimestatistics.h"
 
 #include <QTimer>
 #include <QPainter>
 #include <QFontMetrics>
 #include <QScreen>
 #include <QGuiApplication>
+#include <QtMath>
 
 #include "pdfdbgheap.h"
 
@@ -465,9 +471,11 @@ PDFDrawWidgetProxy::PDFDrawWidgetProxy(QObject* parent) :
     m_verticalScrollbar(nullptr),
     m_horizontalScrollbar(nullptr),
     m_features(PDFRenderer::getDefaultFeatures()),
+    m_compileFeatures(PDFRenderer::getCompileFeatures(m_features)),
     m_compiler(new PDFAsynchronousPageCompiler(this)),
     m_textLayoutCompiler(new PDFAsynchronousTextLayoutCompiler(this)),
-    m_rasterizer(new PDFRasterizer(this)),
+    m_tileRenderer(new PDFAsynchronousTileRenderer(this)),
+    m_thumbnailRenderer(new PDFAsynchronousThumbnailRenderer(this)),
     m_progress(nullptr),
     m_cacheClearTimer(new QTimer(this)),
     m_rendererEngine(RendererEngine::Blend2D_MultiThread)
@@ -479,23 +487,50 @@ PDFDrawWidgetProxy::PDFDrawWidgetProxy(QObject* parent) :
     connect(m_compiler, &PDFAsynchronousPageCompiler::renderingError, this, &PDFDrawWidgetProxy::renderingError);
     connect(m_compiler, &PDFAsynchronousPageCompiler::pageImageChanged, this, &PDFDrawWidgetProxy::pageImageChanged);
     connect(m_textLayoutCompiler, &PDFAsynchronousTextLayoutCompiler::textLayoutChanged, this, &PDFDrawWidgetProxy::onTextLayoutChanged);
+    connect(m_tileRenderer, &PDFAsynchronousTileRenderer::tilesRendered, this, &PDFDrawWidgetProxy::repaintNeeded);
+    connect(this, &PDFDrawWidgetProxy::pageImageChanged, m_tileRenderer, &PDFAsynchronousTileRenderer::clear);
+    connect(m_thumbnailRenderer, &PDFAsynchronousThumbnailRenderer::thumbnailsRendered, this, &PDFDrawWidgetProxy::thumbnailsRendered);
+    connect(this, &PDFDrawWidgetProxy::pageImageChanged, m_thumbnailRenderer, [this](bool all) { if (all) { m_thumbnailRenderer->clear(true, { }); } });
     connect(m_cacheClearTimer, &QTimer::timeout, this, &PDFDrawWidgetProxy::performPageCacheClear);
+    PDFRuntimeStatisticsManager::getInstance()->registerProvider(&m_fontCache, tr("Fonts"));
 }
 
 PDFDrawWidgetProxy::~PDFDrawWidgetProxy()
 {
-
+    PDFRuntimeStatisticsManager::getInstance()->unregisterProvider(&m_fontCache);
 }
 
 void PDFDrawWidgetProxy::setDocument(const PDFModifiedDocument& document)
 {
     if (getDocument() != document)
     {
+        // If pages affected by the modification are known, then only
+        // data of these pages are invalidated, other pages are preserved.
+        const bool isPageContentsChanged = document.hasReset() || document.hasPageContentsChanged();
+        const bool isPartialUpdate = isPageContentsChanged && document.hasAffectedPages();
+
         m_cacheClearTimer->stop();
-        m_compiler->stop(document.hasReset() || document.hasPageContentsChanged());
-        m_textLayoutCompiler->stop(document.hasReset() || document.hasPageContentsChanged());
+        m_compiler->stop(isPageContentsChanged && !isPartialUpdate);
+        m_textLayoutCompiler->stop(isPageContentsChanged && !isPartialUpdate);
+        m_tileRenderer->clear(!document.hasAffectedPages(), document.getAffectedPages());
+        m_thumbnailRenderer->stop();
         m_controller->setDocument(document);
 
+        {
+            QMutexLocker lock(&m_pageContentHashMutex);
+            m_pageContentHashes.clear();
+        }
+
+        if (document.hasReset())
+        {
+            m_navigationHistory.clear();
+        }
+
+        if (isPartialUpdate)
+        {
+            m_compiler->removeFromCache(document.getAffectedPages());
+        }
+
         if (PDFOptionalContentActivity* optionalContentActivity = document.getOptionalContentActivity())
         {
             connect(optionalContentActivity, &PDFOptionalContentActivity::optionalContentGroupStateChanged, this, &PDFDrawWidgetProxy::onOptionalContentGroupStateChanged, Qt::UniqueConnection);
@@ -504,6 +539,11 @@ void PDFDrawWidgetProxy::setDocument(const PDFModifiedDocument& document)
         m_compiler->start();
         m_textLayoutCompiler->start();
 
+        if (isPartialUpdate)
+        {
+            m_textLayoutCompiler->updateTextLayouts(document.getAffectedPages());
+        }
+
         if (document)
         {
             m_cacheClearTimer->start(CACHE_CLEAR_TIMEOUT);
@@ -776,10 +816,54 @@ QColor PDFDrawWidgetProxy::getPaperColor()
     return paperColor;
 }
 
+void PDFDrawWidgetProxy::drawPageWithPostRasterColorAdjustment(QPainter* painter,
+                                                                const PDFPrecompiledPage* compiledPage,
+                                                                const PDFPage* page,
+                                                                const QTransform& matrix,
+                                                                QRect deviceRect,
+                                                                PDFRenderer::Features features,
+                                                                bool drawPaper,
+                                                                PDFReal opacity)
+{
+    if (deviceRect.isEmpty())
+    {
+        return;
+    }
+
+    // Visible part of the page is drawn into the image in device space, then
+    // color adjustment is applied to the image and it is drawn on the painter.
+    QImage pageImage(deviceRect.size(), QImage::Format_ARGB32_Premultiplied);
+    pageImage.fill(drawPaper ? getRasterPaperColor() : QColor(Qt::transparent));
+
+    {
+        QPainter pagePainter(&pageImage);
+        compiledPage->draw(&pagePainter, page->getCropBox(), matrix * QTransform::fromTranslate(-deviceRect.left(), -deviceRect.top()), features, 1.0);
+    }
+
+    PDFRenderer::applyPostRasterColorAdjustment(features, pageImage);
+
+    painter->save();
+    painter->setWorldTransform(QTransform());
+    painter->setOpacity(opacity);
+    painter->drawImage(deviceRect.topLeft(), pageImage);
+    painter->restore();
+}
+
+QColor PDFDrawWidgetProxy::getRasterPaperColor()
+{
+    QColor paperColor = getCMSManager()->getCurrentCMS()->getPaperColor();
+    PDFColorConvertor colorConvertor = getCMSManager()->getColorConvertor();
+    PDFRenderer::applyFeaturesToColorConvertor(getCompileFeatures(), colorConvertor);
+
+    paperColor = colorConvertor.convert(paperColor, true, false);
+    return paperColor;
+}
+
 void PDFDrawWidgetProxy::drawPages(QPainter* painter, QRect rect, PDFRenderer::Features features)
 {
     painter->fillRect(rect, Qt::lightGray);
     QTransform baseMatrix = painter->worldTransform();
+    m_tileRenderer->beginFrame();
 
     // Use current paper color (it can be a bit different from white)
     QColor paperColor = getPaperColor();
@@ -809,7 +893,21 @@ void PDFDrawWidgetProxy::drawPages(QPainter* painter, QRect rect, PDFRenderer::F
 
                 const PDFPage* page = m_controller->getDocument()->getCatalog()->getPage(item.pageIndex);
                 QTransform matrix = QTransform(createPagePointToDevicePointMatrix(page, placedRect)) * baseMatrix;
-                compiledPage->draw(painter, page->getCropBox(), matrix, features, groupInfo.transparency);
+
+                // Large pages (at high zoom) are composited from cached tiles
+                if (m_tileRenderer->isTiled(placedRect, rect, baseMatrix))
+                {
+                    m_tileRenderer->drawPage(painter, item.pageIndex, compiledPage, placedRect, rect, features, groupInfo.drawPaper, groupInfo.transparency);
+                }
+                else if (PDFRenderer::isPostRasterColorAdjustment(features))
+                {
+                    drawPageWithPostRasterColorAdjustment(painter, compiledPage, page, matrix, baseMatrix.mapRect(placedRect.intersected(rect)), features, groupInfo.drawPaper, groupInfo.transparency);
+                }
+                else
+                {
+                    compiledPage->draw(painter, page->getCropBox(), matrix, features, groupInfo.transparency);
+                }
+
                 PDFTextLayoutGetter layoutGetter = m_textLayoutCompiler->getTextLayoutLazy(item.pageIndex);
 
                 // Draw text blocks/text lines, if it is enabled
@@ -923,38 +1021,13 @@ void PDFDrawWidgetProxy::drawPages(QPainter* painter, QRect rect, PDFRenderer::F
 
 QImage PDFDrawWidgetProxy::drawThumbnailImage(PDFInteger pageIndex, int pixelSize) const
 {
-    QImage image;
     if (!m_controller->getDocument())
     {
         // No thumbnail - return empty image
-        return image;
+        return QImage();
     }
 
-    if (const PDFPage* page = m_controller->getDocument()->getCatalog()->getPage(pageIndex))
-    {
-        QRectF pageRect = page->getRotatedMediaBox();
-        QSizeF pageSize = pageRect.size();
-        pageSize.scale(pixelSize, pixelSize, Qt::KeepAspectRatio);
-        QSize imageSize = pageSize.toSize();
-
-        if (imageSize.isValid())
-        {
-            const PDFPrecompiledPage* compiledPage = m_compiler->getCompiledPage(pageIndex, true);
-            if (compiledPage && compiledPage->isValid())
-            {
-                // Rasterize the image.
-                image = m_rasterizer->render(pageIndex, page, compiledPage, imageSize, m_features, m_widget->getAnnotationManager(), PageRotation::None);
-            }
-
-            if (image.isNull())
-            {
-                image = QImage(imageSize, QImage::Format_RGBA8888_Premultiplied);
-                image.fill(Qt::white);
-            }
-        }
-    }
-
-    return image;
+    return m_thumbnailRenderer->getThumbnail(pageIndex, pixelSize);
 }
 
 std::vector<PDFInteger> PDFDrawWidgetProxy::getPagesIntersectingRect(QRect rect) const
@@ -985,19 +1058,46 @@ std::vector<PDFInteger> PDFDrawWidgetProxy::getActivePages() const
 {
     std::vector<PDFInteger> activePages = getPagesIntersectingRect(m_widget->rect());
 
-    // Consider page prefetching - at least two pages after last current
-    // pages are treated as active.
+    // Consider page prefetching - pages after last current pages (or before
+    // first current page, when scrolling backward) are treated as active.
+    // At least two pages are used, but when scrolling fast, the count
+    // is increased. Pages from navigation history are also kept active.
     if (!activePages.empty())
     {
         if (const PDFDocument* document = getDocument())
         {
-            const PDFInteger pageIndex = activePages.back();
+            const PDFInteger prefetchCount = qMax(2, getPrefetchPageCount());
             const PDFInteger pageCount = document->getCatalog()->getPageCount();
-            const PDFInteger pageEnd = qMin(pageCount, pageIndex + 3);
-            for (PDFInteger i = pageIndex + 1; i < pageEnd; ++i)
+
+            if (m_isScrollingBackward)
             {
-                activePages.push_back(i);
+                const PDFInteger pageIndex = activePages.front();
+                const PDFInteger pageBegin = qMax(PDFInteger(0), pageIndex - prefetchCount);
+                for (PDFInteger i = pageBegin; i < pageIndex; ++i)
+                {
+                    activePages.push_back(i);
+                }
             }
+            else
+            {
+                const PDFInteger pageIndex = activePages.back();
+                const PDFInteger pageEnd = qMin(pageCount, pageIndex + prefetchCount + 1);
+                for (PDFInteger i = pageIndex + 1; i < pageEnd; ++i)
+                {
+                    activePages.push_back(i);
+                }
+            }
+
+            for (const PDFInteger pageIndex : m_navigationHistory)
+            {
+                if (pageIndex >= 0 && pageIndex < pageCount)
+                {
+                    activePages.push_back(pageIndex);
+                }
+            }
+
+            std::sort(activePages.begin(), activePages.end());
+            activePages.erase(std::unique(activePages.begin(), activePages.end()), activePages.end());
         }
     }
 
@@ -1271,6 +1371,8 @@ void PDFDrawWidgetProxy::goToPage(PDFInteger pageIndex)
 
     if (layoutItem.isValid())
     {
+        rememberNavigation(layoutItem.pageIndex);
+
         // We have found our page, navigate onto it
         if (isBlockMode())
         {
@@ -1290,6 +1392,8 @@ void PDFDrawWidgetProxy::goToPageAndEnsureVisible(PDFInteger pageIndex, QRectF e
 
     if (layoutItem.isValid())
     {
+        rememberNavigation(layoutItem.pageIndex);
+
         // We have found our page, navigate onto it
         if (isBlockMode())
         {
@@ -1374,6 +1478,9 @@ void PDFDrawWidgetProxy::performPageCacheClear()
 {
     std::vector<PDFInteger> activePage = getActivePages();
     m_compiler->smartClearCache(CACHE_PAGE_EXPIRATION_TIMEOUT, activePage);
+
+    // Checks memory pressure and evicts items across all caches, if memory budget is exceeded
+    PDFCacheManager::getInstance()->trim();
 }
 
 void PDFDrawWidgetProxy::onTextLayoutChanged()
@@ -1407,30 +1514,68 @@ bool PDFDrawWidgetProxy::isBlockMode() const
 void PDFDrawWidgetProxy::updateRenderer(RendererEngine rendererEngine)
 {
     m_rendererEngine = rendererEngine;
-    m_rasterizer->reset(m_rendererEngine);
+    m_thumbnailRenderer->setRendererEngine(m_rendererEngine);
+}
+
+void PDFDrawWidgetProxy::prefetchPages(PDFInteger firstPageIndex, PDFInteger lastPageIndex)
+{
+    const PDFInteger prefetchCount = getPrefetchPageCount();
+
+    if (const PDFDocument* document = getDocument())
+    {
+        const PDFInteger pageCount = document->getCatalog()->getPageCount();
+
+        if (m_isScrollingBackward)
+        {
+            const PDFInteger pageBegin = qMax(PDFInteger(0), firstPageIndex - prefetchCount);
+            for (PDFInteger i = firstPageIndex - 1; i >= pageBegin; --i)
+            {
+                m_compiler->getCompiledPage(i, true, PDFAsynchronousPageCompiler::Priority::Prefetch);
+            }
+        }
+        else
+        {
+            const PDFInteger pageEnd = qMin(pageCount, lastPageIndex + prefetchCount + 1);
+            for (PDFInteger i = lastPageIndex + 1; i < pageEnd; ++i)
+            {
+                m_compiler->getCompiledPage(i, true, PDFAsynchronousPageCompiler::Priority::Prefetch);
+            }
+        }
+
+        // Pages, which user visited recently, are likely to be visited again
+        // (for example, when jumping between reference and text), so keep them
+        // in the cache.
+        for (const PDFInteger pageIndex : m_navigationHistory)
+        {
+            if (pageIndex >= 0 && pageIndex < pageCount && (pageIndex < firstPageIndex || pageIndex > lastPageIndex))
+            {
+                m_compiler->getCompiledPage(pageIndex, true, PDFAsynchronousPageCompiler::Priority::Prefetch);
+            }
+        }
+    }
 }
 
-void PDFDrawWidgetProxy::prefetchPages(PDFInteger pageIndex)
+int PDFDrawWidgetProxy::getPrefetchPageCount() const
 {
     // Determine number of pages, which should be prefetched. In case of two or more pages,
     // we need to prefetch more pages (for example, two for two columns/two pages display mode).
-    int prefetchCount = 0;
+    int basePrefetchCount = 0;
     switch (m_controller->getPageLayout())
     {
         case PageLayout::OneColumn:
         case PageLayout::SinglePage:
-            prefetchCount = 1;
+            basePrefetchCount = 1;
             break;
 
         case PageLayout::TwoPagesLeft:
         case PageLayout::TwoPagesRight:
         case PageLayout::TwoColumnLeft:
         case PageLayout::TwoColumnRight:
-            prefetchCount = 2;
+            basePrefetchCount = 2;
             break;
 
         case PageLayout::Custom:
-            prefetchCount = 0;
+            basePrefetchCount = 0;
             break;
 
         default:
@@ -1438,15 +1583,81 @@ void PDFDrawWidgetProxy::prefetchPages(PDFInteger pageIndex)
             break;
     }
 
-    if (const PDFDocument* document = getDocument())
+    if (basePrefetchCount == 0)
     {
-        const PDFInteger pageCount = document->getCatalog()->getPageCount();
-        const PDFInteger pageEnd = qMin(pageCount, pageIndex + prefetchCount + 1);
-        for (PDFInteger i = pageIndex + 1; i < pageEnd; ++i)
-        {
-            m_compiler->getCompiledPage(i, true);
-        }
+        return 0;
+    }
+
+    // Velocity is measured in viewports per second. If user scrolls fast,
+    // we prefetch pages, which will be displayed in the lookahead time.
+    PDFReal velocity = m_scrollVelocity;
+    if (!m_scrollTimer.isValid() || m_scrollTimer.elapsed() > SCROLL_VELOCITY_TIMEOUT)
+    {
+        velocity = 0.0;
+    }
+
+    int prefetchCount = basePrefetchCount * (1 + qCeil(velocity * PREFETCH_LOOKAHEAD_TIME));
+    prefetchCount = qMin(prefetchCount, MAX_PREFETCH_PAGE_COUNT);
+
+    // Do not prefetch more pages, than can fit into half of the cache,
+    // otherwise prefetched pages would evict the visible ones.
+    const qint64 averagePageSize = m_compiler->getAverageCompiledPageSize();
+    if (averagePageSize > 0)
+    {
+        const qint64 maximalPageCount = (m_compiler->getCacheLimit() / 2) / averagePageSize;
+        prefetchCount = qMax(basePrefetchCount, static_cast<int>(qMin<qint64>(prefetchCount, maximalPageCount)));
     }
+
+    return prefetchCount;
+}
+
+void PDFDrawWidgetProxy::updateScrollVelocity(PDFReal distance)
+{
+    if (!m_scrollTimer.isValid())
+    {
+        m_scrollTimer.start();
+        m_scrollVelocity = 0.0;
+        return;
+    }
+
+    const qint64 elapsed = m_scrollTimer.restart();
+    if (elapsed > SCROLL_VELOCITY_TIMEOUT)
+    {
+        // User has stopped scrolling for a while, start measuring again
+        m_scrollVelocity = 0.0;
+    }
+    else
+    {
+        const PDFReal velocity = distance * 1000.0 / qMax(elapsed, qint64(1));
+        m_scrollVelocity = 0.5 * m_scrollVelocity + 0.5 * velocity;
+    }
+}
+
+void PDFDrawWidgetProxy::addToNavigationHistory(PDFInteger pageIndex)
+{
+    auto it = std::find(m_navigationHistory.begin(), m_navigationHistory.end(), pageIndex);
+    if (it != m_navigationHistory.end())
+    {
+        m_navigationHistory.erase(it);
+    }
+
+    m_navigationHistory.push_back(pageIndex);
+
+    while (m_navigationHistory.size() > MAX_NAVIGATION_HISTORY_SIZE)
+    {
+        m_navigationHistory.pop_front();
+    }
+}
+
+void PDFDrawWidgetProxy::rememberNavigation(PDFInteger targetPageIndex)
+{
+    std::vector<PDFInteger> currentPages = getPagesIntersectingRect(m_widget->rect());
+    if (!currentPages.empty())
+    {
+        addToNavigationHistory(currentPages.front());
+    }
+
+    addToNavigationHistory(targetPageIndex);
 }
 
 void PDFDrawWidgetProxy::onHorizontalScrollbarValueChanged(int value)
@@ -1480,6 +1691,7 @@ void PDFDrawWidgetProxy::setHorizontalOffset(int value)
     {
         m_horizontalOffset = horizontalOffset;
         updateHorizontalScrollbarFromOffset();
+        m_compiler->removeStaleTasks(getActivePages());
         Q_EMIT drawSpaceChanged();
     }
 }
@@ -1490,8 +1702,12 @@ void PDFDrawWidgetProxy::setVerticalOffset(int value)
 
     if (m_verticalOffset != verticalOffset)
     {
+        // Offset is decreasing, when scrolling towards the document end
+        m_isScrollingBackward = verticalOffset > m_verticalOffset;
+        updateScrollVelocity(PDFReal(qAbs(verticalOffset - m_verticalOffset)) / qMax(m_widget->height(), 1));
         m_verticalOffset = verticalOffset;
         updateVerticalScrollbarFromOffset();
+        m_compiler->removeStaleTasks(getActivePages());
         Q_EMIT drawSpaceChanged();
     }
 }
@@ -1500,8 +1716,11 @@ void PDFDrawWidgetProxy::setBlockIndex(int index)
 {
     if (m_currentBlock != index)
     {
+        m_isScrollingBackward = static_cast<size_t>(index) < m_currentBlock;
+        updateScrollVelocity(1.0);
         m_currentBlock = static_cast<size_t>(index);
         update();
+        m_compiler->removeStaleTasks(getActivePages());
     }
 }
 
@@ -1553,15 +1772,123 @@ void PDFDrawWidgetProxy::setFeatures(PDFRenderer::Features features)
 {
     if (m_features != features)
     {
-        m_compiler->stop(true);
-        m_textLayoutCompiler->stop(true);
-        m_features = features;
-        m_compiler->start();
-        m_textLayoutCompiler->start();
+        const PDFRenderer::Features compileFeatures = PDFRenderer::getCompileFeatures(features);
+        if (m_compileFeatures != compileFeatures)
+        {
+            m_compiler->stop(true);
+            m_textLayoutCompiler->stop(true);
+            m_features = features;
+            m_compileFeatures = compileFeatures;
+            m_compiler->start();
+            m_textLayoutCompiler->start();
+        }
+        else
+        {
+            // Only color adjustment applied to the rasterized
+            // pages was changed, compiled pages remain valid.
+            m_features = features;
+        }
+
         Q_EMIT pageImageChanged(true, { });
     }
 }
 
+void PDFDrawWidgetProxy::setNonBlockingPaintEnabled(bool enabled)
+{
+    if (m_tileRenderer->isNonBlockingPaintEnabled() != enabled)
+    {
+        m_tileRenderer->setNonBlockingPaintEnabled(enabled);
+        Q_EMIT repaintNeeded();
+    }
+}
+
+void PDFDrawWidgetProxy::setDiskCacheLimit(qint64 sizeLimit)
+{
+    if (sizeLimit <= 0)
+    {
+        if (m_diskCache)
+        {
+            m_thumbnailRenderer->stop();
+            m_compiler->stop(false);
+            m_textLayoutCompiler->stop(false);
+            m_diskCache.reset();
+            m_textLayoutCompiler->start();
+            m_compiler->start();
+        }
+        return;
+    }
+
+    if (m_diskCache && m_diskCache->getSizeLimit() == sizeLimit)
+    {
+        return;
+    }
+
+    // Compilers use disk cache in worker threads, so they must be stopped
+    m_thumbnailRenderer->stop();
+    m_compiler->stop(false);
+    m_textLayoutCompiler->stop(false);
+    m_diskCache = std::make_unique<PDFDiskCache>(PDFDiskCache::getDefaultDirectory(), sizeLimit);
+    m_textLayoutCompiler->start();
+    m_compiler->start();
+}
+
+QByteArray PDFDrawWidgetProxy::getDiskCacheKey(const char* type, PDFInteger pageIndex, const QByteArray& parameters) const
+{
+    const PDFDocument* document = getDocument();
+    if (!m_diskCache || !document)
+    {
+        return QByteArray();
+    }
+
+    if (pageIndex >= 0)
+    {
+        PageContentHash pageContentHash;
+        bool isPageContentHashFound = false;
+
+        {
+            QMutexLocker lock(&m_pageContentHashMutex);
+            auto it = m_pageContentHashes.find(pageIndex);
+            if (it != m_pageContentHashes.cend())
+            {
+                pageContentHash = it->second;
+                isPageContentHashFound = true;
+            }
+        }
+
+        if (!isPageContentHashFound)
+        {
+            // Thumbnails are rendered with annotations, or embedded thumbnail is used,
+            // so we include these in the hash for all page items.
+            pageContentHash.hash = PDFPageContentHash::compute(document, pageIndex, PDFPageContentHash::Annotations | PDFPageContentHash::Thumbnail, &pageContentHash.optionalContentGroups);
+
+            QMutexLocker lock(&m_pageContentHashMutex);
+            m_pageContentHashes[pageIndex] = pageContentHash;
+        }
+
+        if (pageContentHash.hash.isEmpty())
+        {
+            return QByteArray();
+        }
+
+        // Fingerprint of all settings, which affect the compiled page
+        const QByteArray settings = PDFPageContentHash::createSettingsFingerprint(parameters, m_compileFeatures, m_meshQualitySettings, getCMSManager()->getSettings(), getOptionalContentActivity(), pageContentHash.optionalContentGroups);
+        return PDFDiskCache::createPageKey(pageContentHash.hash, type, settings);
+    }
+
+    if (document->getSourceDataHash().isEmpty())
+    {
+        return QByteArray();
+    }
+
+    // Key is specific for the document, so all optional content groups are used
+    const PDFOptionalContentActivity* optionalContentActivity = getOptionalContentActivity();
+    const PDFOptionalContentProperties* optionalContentProperties = optionalContentActivity ? optionalContentActivity->getProperties() : nullptr;
+    const std::vector<PDFObjectReference> optionalContentGroups = optionalContentProperties ? optionalContentProperties->getAllOptionalContentGroups() : std::vector<PDFObjectReference>();
+    const QByteArray settings = PDFPageContentHash::createSettingsFingerprint(parameters, m_compileFeatures, m_meshQualitySettings, getCMSManager()->getSettings(), optionalContentActivity, optionalContentGroups);
+
+    return PDFDiskCache::createKey(document->getSourceDataHash(), type, pageIndex, settings);
+}
+
 void PDFDrawWidgetProxy::setPreferredMeshResolutionRatio(PDFReal ratio)
 {
     if (m_meshQualitySettings.preferredMeshResolutionRatio != ratio)
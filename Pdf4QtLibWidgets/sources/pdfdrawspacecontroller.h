@@ -29,6 +29,11 @@
 #include <QRectF>
 #include <QObject>
 #include <QMarginsF>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <map>
+#include <deque>
 
 class QPainter;
 class QScrollBar;
@@ -38,10 +43,13 @@ namespace pdf
 {
 class PDFProgress;
 class PDFWidget;
+class PDFDiskCache;
 class PDFCMSManager;
 class PDFTextLayoutGetter;
 class PDFWidgetAnnotationManager;
 class PDFAsynchronousPageCompiler;
+class PDFAsynchronousTileRenderer;
+class PDFAsynchronousThumbnailRenderer;
 class PDFAsynchronousTextLayoutCompiler;
 
 /// This class controls draw space - page layout. Pages are divided into blocks
@@ -219,9 +227,12 @@ public:
     /// \param features Rendering features
     void drawPages(QPainter* painter, QRect rect, PDFRenderer::Features features);
 
-    /// Draws thumbnail image of the given size (so larger of the page size
+    /// Returns thumbnail image of the given size (so larger of the page size
     /// width or height equals to pixel size and the latter size is rescaled
-    /// using the aspect ratio)
+    /// using the aspect ratio). Thumbnails are rendered asynchronously, if thumbnail
+    /// isn't rendered yet, then null image is returned and signal \p thumbnailsRendered
+    /// is emitted later, when thumbnail is rendered. Rendered thumbnail is returned
+    /// only once, caller is responsible for caching it.
     /// \param pixelSize Pixel size
     QImage drawThumbnailImage(PDFInteger pageIndex, int pixelSize) const;
 
@@ -320,9 +331,15 @@ public:
     /// \param rendererEngine Renderer engine
     void updateRenderer(RendererEngine rendererEngine);
 
-    /// Prefetches (prerenders) pages after page with pageIndex, i.e., prepares
-    /// for non-flickering scroll operation.
-    void prefetchPages(PDFInteger pageIndex);
+    /// Prefetches (prerenders) pages in the scroll direction, i.e., prepares
+    /// for non-flickering scroll operation. Pages after last current page are
+    /// prefetched when scrolling forward, pages before first current page
+    /// are prefetched when scrolling backward. Count of prefetched pages grows
+    /// with the scroll velocity and is limited by the page cache size. Pages
+    /// from the navigation history (recently visited pages) are prefetched too.
+    /// \param firstPageIndex First currently displayed page
+    /// \param lastPageIndex Last currently displayed page
+    void prefetchPages(PDFInteger firstPageIndex, PDFInteger lastPageIndex);
 
     static constexpr PDFReal ZOOM_STEP = 1.2;
 
@@ -330,17 +347,44 @@ public:
     PDFFontCache* getFontCache() const { return m_controller->getFontCache(); }
     const PDFOptionalContentActivity* getOptionalContentActivity() const { return m_controller->getOptionalContentActivity(); }
     PDFRenderer::Features getFeatures() const;
+    PDFRenderer::Features getCompileFeatures() const { return m_compileFeatures; }
     const PDFMeshQualitySettings& getMeshQualitySettings() const { return m_meshQualitySettings; }
     PDFAsynchronousPageCompiler* getCompiler() const { return m_compiler; }
     const PDFCMSManager* getCMSManager() const;
     PDFProgress* getProgress() const { return m_progress; }
     void setProgress(PDFProgress* progress) { m_progress = progress; }
     PDFAsynchronousTextLayoutCompiler* getTextLayoutCompiler() const { return m_textLayoutCompiler; }
+    PDFAsynchronousTileRenderer* getTileRenderer() const { return m_tileRenderer; }
+    PDFDiskCache* getDiskCache() const { return m_diskCache.get(); }
     PDFWidget* getWidget() const { return m_widget; }
     RendererEngine getRendererEngine() const { return m_rendererEngine; }
     PageRotation getPageRotation() const { return m_controller->getPageRotation(); }
 
     void setFeatures(PDFRenderer::Features features);
+
+    /// Enables or disables non-blocking painting. If enabled, pages are rasterized
+    /// in background threads, and only finished images are drawn on the GUI thread.
+    /// Until page image is rendered, stale image (for example, of previous zoom
+    /// level) is displayed scaled in its place.
+    /// \param enabled Enable or disable non-blocking painting
+    void setNonBlockingPaintEnabled(bool enabled);
+
+    /// Sets size limit of the persistent disk cache of compiled pages
+    /// and thumbnails. If limit is zero, disk cache is disabled.
+    /// \param sizeLimit Size limit [bytes]
+    void setDiskCacheLimit(qint64 sizeLimit);
+
+    /// Returns key of the item in the disk cache for the current document
+    /// and current rendering settings. Page items (with valid page index)
+    /// are keyed by the canonical hash of the page content, so they are
+    /// shared by identical pages of different documents. Document items are
+    /// keyed by the source data hash. If disk cache can't be used (it is disabled,
+    /// or document item is requested and document has no source data hash,
+    /// because it was modified), then empty key is returned.
+    /// \param type Item type
+    /// \param pageIndex Page index
+    /// \param parameters Additional parameters affecting the item
+    QByteArray getDiskCacheKey(const char* type, PDFInteger pageIndex, const QByteArray& parameters = QByteArray()) const;
     void setPreferredMeshResolutionRatio(PDFReal ratio);
     void setMinimalMeshResolutionRatio(PDFReal ratio);
     void setColorTolerance(PDFReal colorTolerance);
@@ -354,6 +398,11 @@ public:
     /// Returns current paper color
     QColor getPaperColor();
 
+    /// Returns paper color, with which pages are rasterized. It differs
+    /// from current paper color, if color adjustment is applied to the
+    /// rasterized page (it is applied to the paper too).
+    QColor getRasterPaperColor();
+
     /// Transforms pixels to device space
     /// \param pixel Value in pixels
     PDFReal transformPixelToDeviceSpace(PDFReal pixel) const { return pixel * m_pixelToDeviceSpaceUnit; }
@@ -380,6 +429,7 @@ signals:
     void renderingError(pdf::PDFInteger pageIndex, const QList<pdf::PDFRenderError>& errors);
     void repaintNeeded();
     void pageImageChanged(bool all, const std::vector<PDFInteger>& pages);
+    void thumbnailsRendered(const std::vector<PDFInteger>& pages);
     void textLayoutChanged();
 
 private:
@@ -426,9 +476,55 @@ private:
     static constexpr qint64 CACHE_CLEAR_TIMEOUT = 5000;
     static constexpr qint64 CACHE_PAGE_EXPIRATION_TIMEOUT = 30000;
 
+    /// Scroll velocity is reset, if there is no scroll for this time [ms]
+    static constexpr qint64 SCROLL_VELOCITY_TIMEOUT = 500;
+
+    /// Time [s], for which pages are prefetched in advance, when scrolling
+    static constexpr PDFReal PREFETCH_LOOKAHEAD_TIME = 1.0;
+
+    /// Maximal count of pages prefetched in the scroll direction
+    static constexpr int MAX_PREFETCH_PAGE_COUNT = 16;
+
+    /// Maximal count of pages in the navigation history
+    static constexpr size_t MAX_NAVIGATION_HISTORY_SIZE = 8;
+
+    /// Updates scroll velocity estimate using scrolled distance
+    /// \param distance Scrolled distance in viewports (widget heights)
+    void updateScrollVelocity(PDFReal distance);
+
+    /// Returns count of pages, which should be prefetched in the scroll
+    /// direction, with respect to page layout, scroll velocity and cache size.
+    int getPrefetchPageCount() const;
+
+    /// Adds page to the navigation history (recently visited pages)
+    void addToNavigationHistory(PDFInteger pageIndex);
+
+    /// Stores currently displayed page and target page of the navigation
+    /// into the navigation history, so both pages are kept in the cache.
+    void rememberNavigation(PDFInteger targetPageIndex);
+
     /// Converts rectangle from device space to the pixel space
     QRectF fromDeviceSpace(const QRectF& rect) const;
 
+    /// Draws page through offscreen image, to which color adjustment
+    /// is applied (it is used, when color adjustment is post-raster).
+    /// \param painter Painter
+    /// \param compiledPage Compiled page
+    /// \param page Page
+    /// \param matrix Page point to device point matrix
+    /// \param deviceRect Visible page area in device space
+    /// \param features Renderer features
+    /// \param drawPaper Fill page area by paper color
+    /// \param opacity Page opacity
+    void drawPageWithPostRasterColorAdjustment(QPainter* painter,
+                                               const PDFPrecompiledPage* compiledPage,
+                                               const PDFPage* page,
+                                               const QTransform& matrix,
+                                               QRect deviceRect,
+                                               PDFRenderer::Features features,
+                                               bool drawPaper,
+                                               PDFReal opacity);
+
     void performPageCacheClear();
 
     void onTextLayoutChanged();
@@ -493,6 +589,19 @@ private:
     /// Range for horizontal offset
     Range<PDFInteger> m_horizontalOffsetRange;
 
+    /// Is user scrolling backward (towards the document beginning)?
+    bool m_isScrollingBackward = false;
+
+    /// Estimate of scroll velocity in viewports per second
+    PDFReal m_scrollVelocity = 0.0;
+
+    /// Timer measuring time from the last scroll
+    QElapsedTimer m_scrollTimer;
+
+    /// Recently visited pages (by navigation, for example, by outline
+    /// or go to page), most recently visited page is the last one.
+    std::deque<PDFInteger> m_navigationHistory;
+
     /// Draw space controller
     PDFDrawSpaceController* m_controller;
 
@@ -511,6 +620,10 @@ private:
     /// Renderer features
     PDFRenderer::Features m_features;
 
+    /// Renderer features used for page compilation (they are changed
+    /// only when compilers are stopped, so they can be used in worker threads)
+    PDFRenderer::Features m_compileFeatures;
+
     /// Mesh quality settings
     PDFMeshQualitySettings m_meshQualitySettings;
 
@@ -520,8 +633,25 @@ private:
     /// Text layout compiler
     PDFAsynchronousTextLayoutCompiler* m_textLayoutCompiler;
 
-    /// Page image rasterizer for thumbnails
-    PDFRasterizer* m_rasterizer;
+    /// Tile renderer for pages displayed at high zoom
+    PDFAsynchronousTileRenderer* m_tileRenderer;
+
+    /// Persistent cache of compiled pages and thumbnails (can be nullptr)
+    std::unique_ptr<PDFDiskCache> m_diskCache;
+
+    struct PageContentHash
+    {
+        QByteArray hash;
+        std::vector<PDFObjectReference> optionalContentGroups;
+    };
+
+    /// Canonical hashes of the page contents used in disk cache keys,
+    /// they are computed on demand (from compiler threads).
+    mutable QMutex m_pageContentHashMutex;
+    mutable std::map<PDFInteger, PageContentHash> m_pageContentHashes;
+
+    /// Renderer of page thumbnails
+    PDFAsynchronousThumbnailRenderer* m_thumbnailRenderer;
 
     /// Progress
     PDFProgress* m_progress;
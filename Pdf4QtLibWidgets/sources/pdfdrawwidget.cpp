@@ -23,6 +23,9 @@
 #include "pdfwidgetannotation.h"
 #include "pdfwidgetformmanager.h"
 #include "pdfblpainter.h"
+#include "pdfcachemanager.h"
+#include "pdfruntimestatistics.h"
+#include "pdfconstants.h"
 
 #include <QPainter>
 #include <QGridLayout>
@@ -68,11 +71,19 @@ PDFWidget::PDFWidget(const PDFCMSManager* cmsManager, RendererEngine engine, QWi
     connect(m_proxy, &PDFDrawWidgetProxy::renderingError, this, &PDFWidget::onRenderingError);
     connect(m_proxy, &PDFDrawWidgetProxy::repaintNeeded, m_drawWidget->getWidget(), QOverload<>::of(&QWidget::update));
     connect(m_proxy, &PDFDrawWidgetProxy::pageImageChanged, this, &PDFWidget::onPageImageChanged);
+
+    if (m_cmsManager)
+    {
+        PDFRuntimeStatisticsManager::getInstance()->registerProvider(m_cmsManager, tr("Color management"));
+    }
 }
 
 PDFWidget::~PDFWidget()
 {
-
+    if (m_cmsManager)
+    {
+        PDFRuntimeStatisticsManager::getInstance()->unregisterProvider(m_cmsManager);
+    }
 }
 
 bool PDFWidget::focusNextPrevChild(bool next)
@@ -103,6 +114,11 @@ void PDFWidget::updateCacheLimits(int compiledPageCacheLimit, int thumbnailsCach
     m_proxy->getCompiler()->setCacheLimit(compiledPageCacheLimit);
     QPixmapCache::setCacheLimit(qMax(thumbnailsCacheLimit, 16384));
     m_proxy->getFontCache()->setCacheLimits(fontCacheLimit, instancedFontCacheLimit);
+
+    // Each cache has its own limit, but total memory of the caches is also bounded,
+    // so caches together do not consume too much memory. Budget never prevents
+    // compiled page cache from reaching its limit.
+    PDFCacheManager::getInstance()->setMemoryBudget(qMax(qint64(DEFAULT_CACHE_MEMORY_BUDGET), qint64(compiledPageCacheLimit)));
 }
 
 int PDFWidget::getPageRenderingErrorCount() const
@@ -350,12 +350,32 @@ bool PDFOptionalContentTreeItemModel::setData(const QModelIndex& index, const QV
 
 PDFOutlineTreeItem::PDFOutlineTreeItem(PDFOutlineTreeItem* parent, QSharedPointer<PDFOutlineItem> outlineItem) :
     PDFTreeItem(parent),
-    m_outlineItem(qMove(outlineItem))
+    m_outlineItem(qMove(outlineItem)),
+    m_isFetched(m_outlineItem->getChildCount() == 0)
 {
-    size_t childCount = m_outlineItem->getChildCount();
-    for (size_t i = 0; i < childCount; ++i)
+
+}
+
+void PDFOutlineTreeItem::fetchChildren(bool recursive)
+{
+    if (!m_isFetched)
     {
-        addCreatedChild(new PDFOutlineTreeItem(nullptr, m_outlineItem->getChildPtr(i)));
+        m_isFetched = true;
+
+        size_t childCount = m_outlineItem->getChildCount();
+        for (size_t i = 0; i < childCount; ++i)
+        {
+            addCreatedChild(new PDFOutlineTreeItem(nullptr, m_outlineItem->getChildPtr(i)));
+        }
+    }
+
+    if (recursive)
+    {
+        const int childCount = getChildCount();
+        for (int i = 0; i < childCount; ++i)
+        {
+            static_cast<PDFOutlineTreeItem*>(getChild(i))->fetchChildren(true);
+        }
     }
 }
 
@@ -425,7 +445,11 @@ void PDFOutlineTreeItemModel::update()
             outlineRoot = outlineRoot->clone();
         }
 
-        m_rootItem.reset(new PDFOutlineTreeItem(nullptr, qMove(outlineRoot)));
+        // Editing operations work with the whole tree, so editable
+        // model creates all items, read-only model only the top level.
+        PDFOutlineTreeItem* rootItem = new PDFOutlineTreeItem(nullptr, qMove(outlineRoot));
+        rootItem->fetchChildren(m_editable);
+        m_rootItem.reset(rootItem);
     }
     else
     {
@@ -440,9 +464,65 @@ void PDFOutlineTreeItemModel::update()
         }
     }
 
+    m_isFullyFetched = m_editable || !m_rootItem;
+
     endResetModel();
 }
 
+bool PDFOutlineTreeItemModel::hasChildren(const QModelIndex& parent) const
+{
+    const PDFOutlineTreeItem* item = getTreeItem(parent);
+    if (!item)
+    {
+        return false;
+    }
+
+    return item->isFetched() ? item->getChildCount() > 0 : item->getOutlineItem()->getChildCount() > 0;
+}
+
+bool PDFOutlineTreeItemModel::canFetchMore(const QModelIndex& parent) const
+{
+    const PDFOutlineTreeItem* item = getTreeItem(parent);
+    return item && !item->isFetched();
+}
+
+void PDFOutlineTreeItemModel::fetchMore(const QModelIndex& parent)
+{
+    PDFOutlineTreeItem* item = getTreeItem(parent);
+    if (!item || item->isFetched())
+    {
+        return;
+    }
+
+    const int childCount = int(item->getOutlineItem()->getChildCount());
+    beginInsertRows(parent, 0, childCount - 1);
+    item->fetchChildren(false);
+    endInsertRows();
+}
+
+void PDFOutlineTreeItemModel::fetchAll()
+{
+    if (m_isFullyFetched)
+    {
+        return;
+    }
+
+    beginResetModel();
+    static_cast<PDFOutlineTreeItem*>(m_rootItem.get())->fetchChildren(true);
+    m_isFullyFetched = true;
+    endResetModel();
+}
+
+PDFOutlineTreeItem* PDFOutlineTreeItemModel::getTreeItem(const QModelIndex& index) const
+{
+    if (index.isValid())
+    {
+        return static_cast<PDFOutlineTreeItem*>(index.internalPointer());
+    }
+
+    return static_cast<PDFOutlineTreeItem*>(m_rootItem.get());
+}
+
 Qt::ItemFlags PDFOutlineTreeItemModel::flags(const QModelIndex& index) const
 {
     Qt::ItemFlags flags = PDFTreeItemModel::flags(index);
@@ -941,6 +1021,7 @@ PDFThumbnailsItemModel::PDFThumbnailsItemModel(const PDFDrawWidgetProxy* proxy,
     m_document(nullptr)
 {
     connect(proxy, &PDFDrawWidgetProxy::pageImageChanged, this, &PDFThumbnailsItemModel::onPageImageChanged);
+    connect(proxy, &PDFDrawWidgetProxy::thumbnailsRendered, this, &PDFThumbnailsItemModel::onThumbnailsRendered);
 }
 
 bool PDFThumbnailsItemModel::isEmpty() const
@@ -1000,14 +1081,31 @@ QVariant PDFThumbnailsItemModel::data(const QModelIndex& index, int role) const
             QPixmap pixmap;
             if (!m_thumbnailCache.find(key, &pixmap))
             {
+                // Thumbnails are rendered asynchronously, until thumbnail
+                // is rendered, blank page is displayed in its place.
                 const qreal devicePixelRatio = m_proxy->getWidget()->devicePixelRatioF();
-                QImage thumbnail = m_proxy->drawThumbnailImage(index.row(), m_thumbnailSize * devicePixelRatio);
+                const int pixelSize = m_thumbnailSize * devicePixelRatio;
+                QImage thumbnail = m_proxy->drawThumbnailImage(pageIndex, pixelSize);
+
                 if (!thumbnail.isNull())
                 {
                     thumbnail.setDevicePixelRatio(devicePixelRatio);
                     pixmap = QPixmap::fromImage(qMove(thumbnail));
                     m_thumbnailCache.insert(key, pixmap);
                 }
+                else if (const PDFPage* page = m_document->getCatalog()->getPage(pageIndex))
+                {
+                    QSizeF pageSize = page->getRotatedMediaBox().size();
+                    pageSize.scale(pixelSize, pixelSize, Qt::KeepAspectRatio);
+                    QSize imageSize = pageSize.toSize();
+
+                    if (imageSize.isValid())
+                    {
+                        pixmap = QPixmap(imageSize);
+                        pixmap.setDevicePixelRatio(devicePixelRatio);
+                        pixmap.fill(Qt::white);
+                    }
+                }
             }
 
             return pixmap;
@@ -1077,24 +1175,27 @@ PDFInteger PDFThumbnailsItemModel::getPageIndex(const QModelIndex& index) const
 
 void PDFThumbnailsItemModel::onPageImageChanged(bool all, const std::vector<PDFInteger>& pages)
 {
-    Q_UNUSED(all);
     Q_UNUSED(pages);
 
+    // Thumbnails are rendered independently of compiled pages, so only
+    // change of all pages (for example, change of rendering settings)
+    // invalidates them.
     if (all)
     {
         m_thumbnailCache.clear();
         Q_EMIT dataChanged(index(0, 0, QModelIndex()), index(rowCount(QModelIndex()) - 1, 0, QModelIndex()));
     }
-    else
+}
+
+void PDFThumbnailsItemModel::onThumbnailsRendered(const std::vector<PDFInteger>& pages)
+{
+    const int rowCount = this->rowCount(QModelIndex());
+    for (const PDFInteger pageIndex : pages)
     {
-        const int rowCount = this->rowCount(QModelIndex());
-        for (const PDFInteger pageIndex : pages)
+        if (pageIndex < rowCount)
         {
-            if (pageIndex < rowCount)
-            {
-                m_thumbnailCache.remove(getKey(pageIndex));
-                Q_EMIT dataChanged(index(pageIndex, 0, QModelIndex()), index(pageIndex, 0, QModelIndex()));
-            }
+            m_thumbnailCache.remove(getKey(pageIndex));
+            Q_EMIT dataChanged(index(pageIndex, 0, QModelIndex()), index(pageIndex, 0, QModelIndex()));
         }
     }
 }
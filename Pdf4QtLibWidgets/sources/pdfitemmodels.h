@@ -156,6 +156,8 @@ private:
     PDFOptionalContentActivity* m_activity;
 };
 
+/// Tree item of the outline. Tree items for children of the outline item
+/// are created on demand (outline can have tens of thousands of items).
 class PDFOutlineTreeItem : public PDFTreeItem
 {
 public:
@@ -164,8 +166,17 @@ public:
     const PDFOutlineItem* getOutlineItem() const { return m_outlineItem.data(); }
     PDFOutlineItem* getOutlineItem() { return m_outlineItem.data(); }
 
+    /// Returns true, if tree items for children of the outline item were created
+    bool isFetched() const { return m_isFetched; }
+
+    /// Creates tree items for children of the outline item, if they
+    /// were not already created.
+    /// \param recursive Create tree items for whole subtree
+    void fetchChildren(bool recursive);
+
 private:
     QSharedPointer<PDFOutlineItem> m_outlineItem;
+    bool m_isFetched = false;
 };
 
 class PDF4QTLIBWIDGETSSHARED_EXPORT PDFOutlineTreeItemModel : public PDFTreeItemModel
@@ -194,6 +205,15 @@ public:
     virtual QMimeData* mimeData(const QModelIndexList& indexes) const override;
     virtual bool canDropMimeData(const QMimeData* data, Qt::DropAction action, int row, int column, const QModelIndex& parent) const override;
     virtual bool dropMimeData(const QMimeData* data, Qt::DropAction action, int row, int column, const QModelIndex& parent) override;
+    virtual bool hasChildren(const QModelIndex& parent) const override;
+    virtual bool canFetchMore(const QModelIndex& parent) const override;
+    virtual void fetchMore(const QModelIndex& parent) override;
+
+    /// Creates tree items for the whole outline. Items of the read-only
+    /// model are created level by level, when their parent is expanded,
+    /// so this function should be called, when all items are needed
+    /// (for example, when outline is filtered by the search text).
+    void fetchAll();
 
     /// Returns action assigned to the index. If index is invalid, or
     /// points to the invalid item, nullptr is returned.
@@ -217,8 +237,11 @@ public:
     bool isEditable() const { return m_editable; }
 
 private:
+    PDFOutlineTreeItem* getTreeItem(const QModelIndex& index) const;
+
     QIcon m_icon;
     bool m_editable;
+    bool m_isFullyFetched = false;
     mutable QSharedPointer<PDFOutlineItem> m_dragDropItem;
 };
 
@@ -315,6 +338,7 @@ public:
 
 private:
     void onPageImageChanged(bool all, const std::vector<PDFInteger>& pages);
+    void onThumbnailsRendered(const std::vector<PDFInteger>& pages);
 
     /// Returns generated key for page index
     QString getKey(int pageIndex) const;
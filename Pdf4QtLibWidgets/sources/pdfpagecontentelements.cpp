@@ -23,10 +23,12 @@
 #include "pdfutils.h"
 
 #include <QBuffer>
+#include <QtMath>
 #include <QPainter>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QSvgRenderer>
+#include <QPaintEngine>
 #include <QApplication>
 #include <QImageReader>
 
@@ -87,6 +89,26 @@ Qt::CursorShape PDFPageContentElement::getCursorShapeForManipulationMode(uint mo
     return Qt::ArrowCursor;
 }
 
+bool PDFPageContentElement::isRasterPaintDevice(const QPainter* painter)
+{
+    const QPaintDevice* device = painter->device();
+    if (!device)
+    {
+        return false;
+    }
+
+    switch (device->devType())
+    {
+        case QInternal::Widget:
+        case QInternal::Image:
+        case QInternal::Pixmap:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
 uint PDFPageContentElement::getRectangleManipulationMode(const QRectF& rectangle,
                                                          const QPointF& point,
                                                          PDFReal snapPointDistanceThreshold) const
@@ -343,8 +365,11 @@ PDFPageContentScene::~PDFPageContentScene()
 
 void PDFPageContentScene::addElement(PDFPageContentElement* element)
 {
+    // Jakub Melka: element ids are increasing, so elements
+    // remain sorted by their ids (see getElementById).
     element->setElementId(m_firstFreeId++);
     m_elements.emplace_back(element);
+    invalidateIndex();
     Q_EMIT sceneChanged(false);
 }
 
@@ -352,20 +377,18 @@ void PDFPageContentScene::replaceElement(PDFPageContentElement* element)
 {
     std::unique_ptr<PDFPageContentElement> elementPtr(element);
 
-    for (size_t i = 0; i < m_elements.size(); ++i)
+    auto it = findElementById(element->getElementId());
+    if (it != m_elements.cend())
     {
-        if (m_elements[i]->getElementId() == element->getElementId())
-        {
-            m_elements[i] = std::move(elementPtr);
-            Q_EMIT sceneChanged(false);
-            break;
-        }
+        m_elements[std::distance(m_elements.cbegin(), it)] = std::move(elementPtr);
+        invalidateIndex();
+        Q_EMIT sceneChanged(false);
     }
 }
 
 PDFPageContentElement* PDFPageContentScene::getElementById(PDFInteger id) const
 {
-    auto it = std::find_if(m_elements.cbegin(), m_elements.cend(), [id](const auto& element) { return element->getElementId() == id; });
+    auto it = findElementById(id);
     if (it != m_elements.cend())
     {
         return it->get();
@@ -374,12 +397,24 @@ PDFPageContentElement* PDFPageContentScene::getElementById(PDFInteger id) const
     return nullptr;
 }
 
+PDFPageContentScene::Elements::const_iterator PDFPageContentScene::findElementById(PDFInteger id) const
+{
+    auto it = std::lower_bound(m_elements.cbegin(), m_elements.cend(), id, [](const auto& element, PDFInteger value) { return element->getElementId() < value; });
+    if (it != m_elements.cend() && (*it)->getElementId() == id)
+    {
+        return it;
+    }
+
+    return m_elements.cend();
+}
+
 void PDFPageContentScene::clear()
 {
     if (!m_elements.empty())
     {
         m_manipulator.reset();
         m_elements.clear();
+        invalidateIndex();
         Q_EMIT sceneChanged(false);
     }
 }
@@ -646,14 +681,18 @@ void PDFPageContentScene::drawElements(QPainter* painter,
                                        const PDFPrecompiledPage* compiledPage,
                                        QList<PDFRenderError>& errors) const
 {
-    for (const auto& element : m_elements)
+    // Elements outside the painted area (for example, outside the area,
+    // which is being repainted) are not drawn at all.
+    const std::optional<QRectF> visibleRect = getVisiblePageRect(painter, pagePointToDevicePointMatrix);
+
+    for (const ElementBoundingBox& item : getPageElements(pageIndex))
     {
-        if (element->getPageIndex() != pageIndex)
+        if (visibleRect && item.isBoundingBoxValid && (!visibleRect->isValid() || !isOverlapping(item.boundingBox, *visibleRect)))
         {
             continue;
         }
 
-        element->drawPage(painter, pageIndex, compiledPage, layoutGetter, pagePointToDevicePointMatrix, errors);
+        item.element->drawPage(painter, pageIndex, compiledPage, layoutGetter, pagePointToDevicePointMatrix, errors);
     }
 }
 
@@ -692,17 +731,23 @@ PDFPageContentScene::MouseEventInfo PDFPageContentScene::getMouseEventInfo(QWidg
     result.timer = m_mouseGrabInfo.info.timer;
     result.pageIndex = m_widget->getDrawWidgetProxy()->getPageUnderPoint(point, &result.pagePos);
 
-    const PDFReal threshold = getSnapPointDistanceThreshold();
-    for (const auto& elementItem : m_elements)
+    if (result.pageIndex == -1)
     {
-        PDFPageContentElement* element = elementItem.get();
+        return result;
+    }
 
-        if (element->getPageIndex() != result.pageIndex)
+    const PDFReal threshold = getSnapPointDistanceThreshold();
+    const QRectF pointRect(result.pagePos.x() - threshold, result.pagePos.y() - threshold, 2.0 * threshold, 2.0 * threshold);
+    for (const ElementBoundingBox& item : getPageElements(result.pageIndex))
+    {
+        // Jakub Melka: Element can be manipulated only in the neighbourhood
+        // of its bounding box, so we can skip elements far from the point.
+        if (item.isBoundingBoxValid && !isOverlapping(item.boundingBox, pointRect))
         {
-            // Different page
             continue;
         }
 
+        PDFPageContentElement* element = item.element;
         if (element->getManipulationMode(result.pagePos, threshold) != 0)
         {
             result.hoveredElementIds.insert(element->getElementId());
@@ -712,6 +757,104 @@ PDFPageContentScene::MouseEventInfo PDFPageContentScene::getMouseEventInfo(QWidg
     return result;
 }
 
+const std::vector<PDFPageContentScene::ElementBoundingBox>& PDFPageContentScene::getPageElements(PDFInteger pageIndex) const
+{
+    if (!m_isPageElementsIndexValid)
+    {
+        m_pageElements.clear();
+
+        for (const auto& elementItem : m_elements)
+        {
+            PDFPageContentElement* element = elementItem.get();
+
+            ElementBoundingBox item;
+            item.element = element;
+            item.boundingBox = element->getBoundingBox().normalized();
+            item.isBoundingBoxValid = !item.boundingBox.isNull();
+
+            // Styled elements are drawn with the pen, which can exceed
+            // the bounding box of the element geometry.
+            if (const PDFPageContentStyledElement* styledElement = dynamic_cast<const PDFPageContentStyledElement*>(element))
+            {
+                const PDFReal penWidth = styledElement->getPen().widthF();
+                item.boundingBox.adjust(-penWidth, -penWidth, penWidth, penWidth);
+            }
+
+            m_pageElements[element->getPageIndex()].push_back(qMove(item));
+        }
+
+        m_isPageElementsIndexValid = true;
+    }
+
+    auto it = m_pageElements.find(pageIndex);
+    if (it != m_pageElements.cend())
+    {
+        return it->second;
+    }
+
+    static const std::vector<ElementBoundingBox> dummy;
+    return dummy;
+}
+
+void PDFPageContentScene::invalidateIndex()
+{
+    m_isPageElementsIndexValid = false;
+    m_pageElements.clear();
+}
+
+bool PDFPageContentScene::isOverlapping(const QRectF& rect1, const QRectF& rect2)
+{
+    // Jakub Melka: We can't use QRectF::intersects, because bounding
+    // boxes of the horizontal or vertical lines have zero width or height.
+    return rect1.left() <= rect2.right() && rect2.left() <= rect1.right() &&
+           rect1.top() <= rect2.bottom() && rect2.top() <= rect1.bottom();
+}
+
+std::optional<QRectF> PDFPageContentScene::getVisiblePageRect(QPainter* painter, const QTransform& pagePointToDevicePointMatrix)
+{
+    // Painted area is known only for raster devices, on other
+    // devices (for example, when content stream is created from
+    // the scene), everything must be drawn.
+    if (!PDFPageContentElement::isRasterPaintDevice(painter))
+    {
+        return std::nullopt;
+    }
+
+    // Few pixels are added to the visible area, so antialiased
+    // edges of the elements are not clipped away.
+    constexpr PDFReal margin = 4.0;
+
+    bool isInvertible = false;
+    const QTransform deviceToPageMatrix = (pagePointToDevicePointMatrix * painter->worldTransform()).inverted(&isInvertible);
+    if (!isInvertible)
+    {
+        return std::nullopt;
+    }
+
+    QRectF visibleRect = deviceToPageMatrix.mapRect(QRectF(painter->window()).adjusted(-margin, -margin, margin, margin));
+
+    if (painter->hasClipping())
+    {
+        visibleRect = visibleRect.intersected(deviceToPageMatrix.mapRect(painter->clipBoundingRect().adjusted(-margin, -margin, margin, margin)));
+    }
+
+    // System clip is set to the area, which is being repainted (in device coordinates)
+    const QPaintEngine* paintEngine = painter->paintEngine();
+    if (paintEngine && !paintEngine->systemClip().isEmpty())
+    {
+        bool isDeviceTransformInvertible = false;
+        const QTransform deviceTransform = (pagePointToDevicePointMatrix * painter->deviceTransform()).inverted(&isDeviceTransformInvertible);
+
+        if (isDeviceTransformInvertible)
+        {
+            const QRectF dirtyRect = QRectF(paintEngine->systemClip().boundingRect()).adjusted(-margin, -margin, margin, margin);
+            visibleRect = visibleRect.intersected(deviceTransform.mapRect(dirtyRect));
+        }
+    }
+
+    return visibleRect;
+}
+
 PDFReal PDFPageContentScene::getSnapPointDistanceThreshold() const
 {
     const PDFReal snapPointDistanceThresholdPixels = PDFWidgetUtils::scaleDPI_x(m_widget, 6.0);
@@ -912,12 +1055,16 @@ void PDFPageContentScene::setSelectedElementIds(const std::set<PDFInteger>& sele
 
 void PDFPageContentScene::removeElementsById(const std::vector<PDFInteger>& selection)
 {
+    std::vector<PDFInteger> sortedSelection = selection;
+    std::sort(sortedSelection.begin(), sortedSelection.end());
+
     const size_t oldSize = m_elements.size();
-    m_elements.erase(std::remove_if(m_elements.begin(), m_elements.end(), [&selection](const auto& element){ return std::find(selection.cbegin(), selection.cend(), element->getElementId()) != selection.cend(); }), m_elements.end());
+    m_elements.erase(std::remove_if(m_elements.begin(), m_elements.end(), [&sortedSelection](const auto& element){ return std::binary_search(sortedSelection.cbegin(), sortedSelection.cend(), element->getElementId()); }), m_elements.end());
     const size_t newSize = m_elements.size();
 
     if (newSize < oldSize)
     {
+        invalidateIndex();
         Q_EMIT sceneChanged(false);
     }
 }
@@ -1128,6 +1275,7 @@ PDFPageContentImageElement* PDFPageContentImageElement::clone() const
     copy->setPageIndex(getPageIndex());
     copy->setRectangle(getRectangle());
     copy->setContent(getContent());
+    copy->m_cachedImage = m_cachedImage;
     return copy;
 }
 
@@ -1169,7 +1317,38 @@ void PDFPageContentImageElement::drawPage(QPainter* painter,
         painter->scale(1.0, -1.0);
         targetRenderBox.moveTopLeft(QPointF(0, 0));
 
-        m_renderer->render(painter, targetRenderBox);
+        // Jakub Melka: Rendering of the SVG image is slow, so on the screen,
+        // we draw the image rasterized in the device resolution. Image
+        // is rasterized again only when the resolution is changed.
+        const qreal scale = qSqrt(qAbs(painter->deviceTransform().determinant()));
+        const QSize imageSize = (targetRenderBox.size() * scale).toSize();
+        const bool useCachedImage = isRasterPaintDevice(painter) &&
+                                    !imageSize.isEmpty() &&
+                                    imageSize.width() <= MAXIMAL_CACHED_IMAGE_SIZE &&
+                                    imageSize.height() <= MAXIMAL_CACHED_IMAGE_SIZE;
+
+        if (useCachedImage)
+        {
+            if (m_cachedImage.size() != imageSize)
+            {
+                QImage image(imageSize, QImage::Format_ARGB32_Premultiplied);
+                image.fill(Qt::transparent);
+
+                QPainter imagePainter(&image);
+                imagePainter.setRenderHint(QPainter::Antialiasing);
+                m_renderer->render(&imagePainter, QRectF(QPointF(0, 0), QSizeF(imageSize)));
+                imagePainter.end();
+
+                m_cachedImage = qMove(image);
+            }
+
+            painter->setRenderHint(QPainter::SmoothPixmapTransform);
+            painter->drawImage(targetRenderBox, m_cachedImage);
+        }
+        else
+        {
+            m_renderer->render(painter, targetRenderBox);
+        }
     }
     else if (!m_image.isNull())
     {
@@ -1224,6 +1403,7 @@ void PDFPageContentImageElement::setContent(const QByteArray& newContent)
     if (m_content != newContent)
     {
         m_content = newContent;
+        m_cachedImage = QImage();
         if (!m_renderer->load(m_content))
         {
             QByteArray imageData = m_content;
@@ -2271,19 +2451,25 @@ void PDFPageContentElementManipulator::drawPage(QPainter* painter,
     // Draw selection
     if (!isSelectionEmpty())
     {
+        // Jakub Melka: Uniting paths one by one is very slow, when many
+        // elements are selected. So we add all rectangles at once
+        // and simplify the path only once.
         QPainterPath selectionPath;
+        selectionPath.setFillRule(Qt::WindingFill);
         for (const PDFInteger id : m_selection)
         {
             if (PDFPageContentElement* element = m_scene->getElementById(id))
             {
-                QPainterPath tempPath;
-                tempPath.addRect(element->getBoundingBox());
-                selectionPath = selectionPath.united(tempPath);
+                if (element->getPageIndex() == pageIndex)
+                {
+                    selectionPath.addRect(element->getBoundingBox());
+                }
             }
         }
 
         if (!selectionPath.isEmpty())
         {
+            selectionPath = selectionPath.simplified();
             PDFPainterStateGuard guard(painter);
             QPen pen(Qt::SolidLine);
             pen.setWidthF(2.0);
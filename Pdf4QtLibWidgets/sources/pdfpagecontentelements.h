@@ -29,6 +29,7 @@
 #include <QElapsedTimer>
 
 #include <set>
+#include <map>
 
 class QSvgRenderer;
 
@@ -86,6 +87,11 @@ public:
     /// \param mode Manipulation mode
     static Qt::CursorShape getCursorShapeForManipulationMode(uint mode);
 
+    /// Returns true, if painter paints into the raster device (widget,
+    /// image or pixmap), i.e., it is not used to create vector output.
+    /// \param painter Painter
+    static bool isRasterPaintDevice(const QPainter* painter);
+
     enum ManipulationModes : uint
     {
         None = 0,
@@ -306,6 +312,12 @@ private:
     QByteArray m_content;
     QImage m_image;
     std::unique_ptr<QSvgRenderer> m_renderer;
+
+    /// Maximal size of the rasterized SVG image (in pixels)
+    static constexpr int MAXIMAL_CACHED_IMAGE_SIZE = 4096;
+
+    /// SVG image rasterized in the device resolution
+    mutable QImage m_cachedImage;
 };
 
 class PDF4QTLIBWIDGETSSHARED_EXPORT PDFPageContentElementTextBox : public PDFPageContentStyledElement
@@ -612,10 +624,48 @@ private:
     /// Reaction on selection changed
     void onSelectionChanged();
 
+    using Elements = std::vector<std::unique_ptr<PDFPageContentElement>>;
+
+    /// Element with its bounding box
+    struct ElementBoundingBox
+    {
+        PDFPageContentElement* element = nullptr;
+        QRectF boundingBox;
+        bool isBoundingBoxValid = false;
+    };
+
+    /// Finds element by its id. Elements are sorted by their ids,
+    /// so binary search is used. If element is not found,
+    /// end iterator is returned.
+    /// \param id Element id
+    Elements::const_iterator findElementById(PDFInteger id) const;
+
+    /// Returns elements on the given page (in drawing order) with their bounding
+    /// boxes. Index of the elements is created on demand and invalidated,
+    /// when elements are changed.
+    /// \param pageIndex Page index
+    const std::vector<ElementBoundingBox>& getPageElements(PDFInteger pageIndex) const;
+
+    /// Invalidates index of the elements
+    void invalidateIndex();
+
+    /// Returns true, if rectangles overlap (rectangles can
+    /// have zero width or height).
+    static bool isOverlapping(const QRectF& rect1, const QRectF& rect2);
+
+    /// Returns rectangle of the page, which is being painted by the painter
+    /// (in page coordinates). If it can't be determined, std::nullopt is returned,
+    /// if nothing from the page is being painted, invalid rectangle is returned.
+    /// \param painter Painter
+    /// \param pagePointToDevicePointMatrix Page to device point matrix
+    static std::optional<QRectF> getVisiblePageRect(QPainter* painter, const QTransform& pagePointToDevicePointMatrix);
+
     PDFInteger m_firstFreeId;
     bool m_isActive;
     PDFWidget* m_widget;
-    std::vector<std::unique_ptr<PDFPageContentElement>> m_elements;
+    Elements m_elements;
+    mutable std::map<PDFInteger, std::vector<ElementBoundingBox>> m_pageElements;
+    mutable bool m_isPageElementsIndexValid = false;
     std::optional<QCursor> m_cursor;
     PDFPageContentElementManipulator m_manipulator;
     MouseGrabInfo m_mouseGrabInfo;
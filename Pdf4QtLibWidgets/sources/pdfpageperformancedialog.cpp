@@ -0,0 +1,249 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfpageperformancedialog.h"
+#include "ui_pdfpageperformancedialog.h"
+
+#include "pdfdrawwidget.h"
+#include "pdfdrawspacecontroller.h"
+#include "pdfrenderer.h"
+#include "pdfpainter.h"
+#include "pdfimage.h"
+#include "pdfpattern.h"
+#include "pdfcms.h"
+#include "pdfwidgetutils.h"
+
+#include <QImage>
+#include <QLocale>
+#include <QPainter>
+#include <QClipboard>
+#include <QPushButton>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+
+#include <algorithm>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFPagePerformanceDialog::PDFPagePerformanceDialog(QWidget* parent, PDFWidget* pdfWidget) :
+    QDialog(parent),
+    ui(new Ui::PDFPagePerformanceDialog),
+    m_pdfWidget(pdfWidget)
+{
+    ui->setupUi(this);
+
+    ui->reportTreeWidget->setColumnCount(4);
+    ui->reportTreeWidget->setHeaderLabels({ tr("Item"), tr("Count"), tr("Time [ms]"), tr("Details") });
+
+    Q_ASSERT(m_pdfWidget);
+    const PDFDocument* document = m_pdfWidget->getDrawWidgetProxy()->getDocument();
+    const int pageCount = document ? int(document->getCatalog()->getPageCount()) : 0;
+    ui->pageSpinBox->setRange(1, qMax(pageCount, 1));
+
+    std::vector<PDFInteger> currentPages = m_pdfWidget->getDrawWidget()->getCurrentPages();
+    if (!currentPages.empty())
+    {
+        ui->pageSpinBox->setValue(int(*std::min_element(currentPages.cbegin(), currentPages.cend())) + 1);
+    }
+
+    QPushButton* measureButton = ui->buttonBox->addButton(tr("Measure"), QDialogButtonBox::ActionRole);
+    QPushButton* copyButton = ui->buttonBox->addButton(tr("Copy to Clipboard"), QDialogButtonBox::ActionRole);
+    measureButton->setEnabled(pageCount > 0);
+    connect(measureButton, &QPushButton::clicked, this, &PDFPagePerformanceDialog::measure);
+    connect(copyButton, &QPushButton::clicked, this, &PDFPagePerformanceDialog::copyToClipboard);
+
+    if (pageCount > 0)
+    {
+        measure();
+    }
+
+    pdf::PDFWidgetUtils::style(this);
+}
+
+PDFPagePerformanceDialog::~PDFPagePerformanceDialog()
+{
+    delete ui;
+}
+
+void PDFPagePerformanceDialog::measure()
+{
+    ui->reportTreeWidget->clear();
+
+    const PDFDrawWidgetProxy* proxy = m_pdfWidget->getDrawWidgetProxy();
+    const PDFDocument* document = proxy->getDocument();
+    const size_t pageIndex = ui->pageSpinBox->value() - 1;
+    const PDFPage* page = document ? document->getCatalog()->getPage(pageIndex) : nullptr;
+
+    if (!page)
+    {
+        return;
+    }
+
+    // Jakub Melka: Decoded images and meshes are cached, so their costs are
+    // visible only on cache misses. This is why caches can be cleared.
+    if (ui->clearCachesCheckBox->isChecked())
+    {
+        PDFImageCache::getInstance()->clear();
+        PDFMeshCache::getInstance()->clear();
+    }
+
+    PDFPageContentProcessorStatistics statistics;
+    PDFPrecompiledPage compiledPage;
+
+    PDFCMSPointer cms = proxy->getCMSManager()->getCurrentCMS();
+    PDFRenderer renderer(document, proxy->getFontCache(), cms.data(), proxy->getOptionalContentActivity(), proxy->getFeatures(), proxy->getMeshQualitySettings());
+    renderer.setStatistics(&statistics);
+    renderer.compile(&compiledPage, pageIndex);
+
+    qint64 drawTime = 0;
+    const QRectF rotatedCropBox = page->getRotatedCropBox();
+    const QSize imageSize = (rotatedCropBox.size() * PDF_POINT_TO_INCH * DRAW_RESOLUTION).toSize();
+    if (imageSize.isValid())
+    {
+        QImage image(imageSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+
+        const QTransform matrix = PDFRenderer::createPagePointToDevicePointMatrix(page, QRectF(QPointF(0, 0), imageSize));
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QPainter painter(&image);
+        compiledPage.draw(&painter, page->getCropBox(), matrix, proxy->getFeatures(), 1.0);
+        painter.end();
+
+        drawTime = timer.nsecsElapsed();
+    }
+
+    QLocale locale;
+    auto formatTime = [&locale](qint64 time) { return locale.toString(PDFReal(time) / 1000000.0, 'f', 3); };
+    auto addItem = [](QTreeWidgetItem* parent, QString name, QString count, QString time, QString details = QString())
+    {
+        QTreeWidgetItem* item = new QTreeWidgetItem(parent, QStringList() << qMove(name) << qMove(count) << qMove(time) << qMove(details));
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        item->setTextAlignment(2, Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    };
+    auto addEntry = [&](QTreeWidgetItem* parent, QString name, const PDFPageContentProcessorStatistics::Entry& entry)
+    {
+        return addItem(parent, qMove(name), locale.toString(entry.count), formatTime(entry.time));
+    };
+    auto addGroup = [this](QString name)
+    {
+        QTreeWidgetItem* item = new QTreeWidgetItem(ui->reportTreeWidget, QStringList() << qMove(name));
+        item->setExpanded(true);
+        return item;
+    };
+
+    // Page
+    QTreeWidgetItem* pageItem = addGroup(tr("Page %1").arg(pageIndex + 1));
+    addItem(pageItem, tr("Compilation"), QString(), formatTime(compiledPage.getCompilingTimeNS()));
+    addItem(pageItem, tr("Drawing"), QString(), formatTime(drawTime), tr("%1 x %2 pixels").arg(imageSize.width()).arg(imageSize.height()));
+    addItem(pageItem, tr("Compiled page memory"), QString(), QString(), locale.formattedDataSize(compiledPage.getMemoryConsumptionEstimate()));
+    addItem(pageItem, tr("Rendering errors"), locale.toString(compiledPage.getErrors().size()), QString());
+
+    // Operators by category
+    QTreeWidgetItem* categoriesItem = addGroup(tr("Operator categories (exclusive time)"));
+    for (size_t i = 0; i < PDFPageContentProcessorStatistics::CATEGORY_COUNT; ++i)
+    {
+        const PDFPageContentProcessorStatistics::Entry& entry = statistics.operators[i];
+        if (entry.count > 0)
+        {
+            addEntry(categoriesItem, PDFPageContentProcessorStatistics::getCategoryName(PDFPageContentProcessorStatistics::Category(i)), entry);
+        }
+    }
+
+    // Operators by name, most frequent first
+    std::vector<std::pair<QByteArray, qint64>> operatorCounts(statistics.operatorCounts.cbegin(), statistics.operatorCounts.cend());
+    std::stable_sort(operatorCounts.begin(), operatorCounts.end(), [](const auto& l, const auto& r) { return l.second > r.second; });
+
+    QTreeWidgetItem* operatorsItem = addGroup(tr("Operators"));
+    operatorsItem->setExpanded(false);
+    for (const auto& operatorCount : operatorCounts)
+    {
+        addItem(operatorsItem, QString::fromLatin1(operatorCount.first), locale.toString(operatorCount.second), QString());
+    }
+
+    // XObjects, most expensive first
+    using XObjectItem = std::pair<PDFObjectReference, PDFPageContentProcessorStatistics::XObjectEntry>;
+    std::vector<XObjectItem> xobjects(statistics.xobjects.cbegin(), statistics.xobjects.cend());
+    std::stable_sort(xobjects.begin(), xobjects.end(), [](const XObjectItem& l, const XObjectItem& r) { return l.second.entry.time > r.second.entry.time; });
+
+    QTreeWidgetItem* xobjectsItem = addGroup(tr("Most expensive XObjects (inclusive time)"));
+    for (size_t i = 0; i < xobjects.size() && i < MAX_XOBJECT_COUNT; ++i)
+    {
+        const XObjectItem& xobject = xobjects[i];
+        const QString details = tr("%1, object %2 %3 R").arg(xobject.second.isImage ? tr("Image") : tr("Form")).arg(xobject.first.objectNumber).arg(xobject.first.generation);
+        addItem(xobjectsItem, QString::fromLatin1(xobject.second.name), locale.toString(xobject.second.entry.count), formatTime(xobject.second.entry.time), details);
+    }
+
+    // Images
+    QTreeWidgetItem* imagesItem = addGroup(tr("Images"));
+    for (const auto& imageDecoding : statistics.imageDecoding)
+    {
+        const QString filter = !imageDecoding.first.isEmpty() ? QString::fromLatin1(imageDecoding.first) : tr("Uncompressed");
+        addEntry(imagesItem, tr("Decoding (%1)").arg(filter), imageDecoding.second);
+    }
+    addEntry(imagesItem, tr("Color conversion"), statistics.imageColorConversion);
+    addItem(imagesItem, tr("Image cache"), QString(), QString(), tr("%1 hits, %2 misses").arg(statistics.imageCacheHits).arg(statistics.imageCacheMisses));
+
+    // Colors
+    QTreeWidgetItem* colorsItem = addGroup(tr("Colors"));
+    addEntry(colorsItem, tr("Color conversion"), statistics.colorConversion);
+    addItem(colorsItem, tr("Color cache"), QString(), QString(), tr("%1 hits, %2 misses").arg(statistics.colorCacheHits).arg(statistics.colorCacheMisses));
+
+    // Shadings
+    QTreeWidgetItem* meshesItem = addGroup(tr("Shading meshes"));
+    addEntry(meshesItem, tr("Meshes"), statistics.meshes);
+    addItem(meshesItem, tr("Triangles"), locale.toString(statistics.meshTriangles), QString());
+
+    for (int i = 0; i < ui->reportTreeWidget->columnCount(); ++i)
+    {
+        ui->reportTreeWidget->resizeColumnToContents(i);
+    }
+}
+
+void PDFPagePerformanceDialog::copyToClipboard()
+{
+    QString text;
+    for (int i = 0; i < ui->reportTreeWidget->topLevelItemCount(); ++i)
+    {
+        QTreeWidgetItem* groupItem = ui->reportTreeWidget->topLevelItem(i);
+        text += groupItem->text(0) + "\n";
+
+        for (int j = 0; j < groupItem->childCount(); ++j)
+        {
+            QTreeWidgetItem* item = groupItem->child(j);
+            QStringList values;
+            for (int column = 1; column < ui->reportTreeWidget->columnCount(); ++column)
+            {
+                if (!item->text(column).isEmpty())
+                {
+                    values << QString("%1 %2").arg(ui->reportTreeWidget->headerItem()->text(column), item->text(column));
+                }
+            }
+            text += QString("    %1: %2\n").arg(item->text(0), values.join(", "));
+        }
+    }
+
+    QGuiApplication::clipboard()->setText(text);
+}
+
+}   // namespace pdf
@@ -0,0 +1,65 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFPAGEPERFORMANCEDIALOG_H
+#define PDFPAGEPERFORMANCEDIALOG_H
+
+#include "pdfwidgetsglobal.h"
+#include "pdfglobal.h"
+
+#include <QDialog>
+
+class QTreeWidgetItem;
+
+namespace Ui
+{
+class PDFPagePerformanceDialog;
+}
+
+namespace pdf
+{
+class PDFWidget;
+
+/// Displays performance report of the single page. Page is compiled
+/// (and drawn) again with statistics enabled, and operator counts,
+/// most expensive XObjects, image decoding costs, shading meshes and
+/// memory consumption of the compiled page are displayed.
+class PDF4QTLIBWIDGETSSHARED_EXPORT PDFPagePerformanceDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit PDFPagePerformanceDialog(QWidget* parent, PDFWidget* pdfWidget);
+    virtual ~PDFPagePerformanceDialog() override;
+
+private:
+    /// Maximal count of displayed XObjects
+    static constexpr size_t MAX_XOBJECT_COUNT = 20;
+
+    /// Resolution of measured drawing of the page [DPI]
+    static constexpr PDFReal DRAW_RESOLUTION = 96.0;
+
+    void measure();
+    void copyToClipboard();
+
+    Ui::PDFPagePerformanceDialog* ui;
+    PDFWidget* m_pdfWidget;
+};
+
+}   // namespace pdf
+
+#endif // PDFPAGEPERFORMANCEDIALOG_H
@@ -17,9 +17,13 @@
 
 #include "pdfrenderingerrorswidget.h"
 #include "pdfdrawwidget.h"
+#include "pdfpageperformancedialog.h"
 #include "ui_pdfrenderingerrorswidget.h"
 
 #include "pdfwidgetutils.h"
+
+#include <QPushButton>
+
 #include "pdfdbgheap.h"
 
 namespace pdf
@@ -100,6 +104,13 @@ PDFRenderingErrorsWidget::PDFRenderingErrorsWidget(QWidget* parent, PDFWidget* p
         ui->renderErrorsTreeWidget->scrollToItem(scrollToItem, QAbstractItemView::EnsureVisible);
     }
 
+    QPushButton* performanceReportButton = ui->buttonBox->addButton(tr("Performance Report..."), QDialogButtonBox::ActionRole);
+    connect(performanceReportButton, &QPushButton::clicked, this, [this, pdfWidget]()
+    {
+        PDFPagePerformanceDialog dialog(this, pdfWidget);
+        dialog.exec();
+    });
+
     pdf::PDFWidgetUtils::style(this);
 }
 
@@ -0,0 +1,121 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfruntimestatisticsdialog.h"
+#include "ui_pdfruntimestatisticsdialog.h"
+
+#include "pdfwidgetutils.h"
+
+#include <QTimer>
+#include <QClipboard>
+#include <QPushButton>
+#include <QGuiApplication>
+
+#include <map>
+
+#include "pdfdbgheap.h"
+
+namespace pdf
+{
+
+PDFRuntimeStatisticsDialog::PDFRuntimeStatisticsDialog(QWidget* parent) :
+    QDialog(parent),
+    ui(new Ui::PDFRuntimeStatisticsDialog),
+    m_timer(new QTimer(this))
+{
+    ui->setupUi(this);
+
+    ui->statisticsTreeWidget->setColumnCount(3);
+    ui->statisticsTreeWidget->setHeaderLabels({ tr("Statistic"), tr("Value"), tr("Type") });
+
+    QPushButton* copyButton = ui->buttonBox->addButton(tr("Copy to Clipboard"), QDialogButtonBox::ActionRole);
+    connect(copyButton, &QPushButton::clicked, this, &PDFRuntimeStatisticsDialog::copyToClipboard);
+
+    connect(m_timer, &QTimer::timeout, this, &PDFRuntimeStatisticsDialog::refresh);
+    m_timer->start(REFRESH_INTERVAL);
+    refresh();
+
+    ui->statisticsTreeWidget->expandAll();
+    ui->statisticsTreeWidget->resizeColumnToContents(0);
+
+    pdf::PDFWidgetUtils::style(this);
+}
+
+PDFRuntimeStatisticsDialog::~PDFRuntimeStatisticsDialog()
+{
+    delete ui;
+}
+
+void PDFRuntimeStatisticsDialog::refresh()
+{
+    m_statistics = PDFRuntimeStatisticsManager::getInstance()->collect();
+
+    // Jakub Melka: Items are reused, if possible, so expanded
+    // state and scroll position are kept between refreshes.
+    std::map<QString, QTreeWidgetItem*> groupItems;
+    for (int i = 0; i < ui->statisticsTreeWidget->topLevelItemCount(); ++i)
+    {
+        QTreeWidgetItem* item = ui->statisticsTreeWidget->topLevelItem(i);
+        groupItems[item->text(0)] = item;
+    }
+
+    std::map<QTreeWidgetItem*, int> childCounts;
+    for (const PDFRuntimeStatistic& statistic : m_statistics)
+    {
+        QTreeWidgetItem*& groupItem = groupItems[statistic.group];
+        if (!groupItem)
+        {
+            groupItem = new QTreeWidgetItem(ui->statisticsTreeWidget, QStringList() << statistic.group);
+            groupItem->setExpanded(true);
+        }
+
+        int& childIndex = childCounts[groupItem];
+        QTreeWidgetItem* item = childIndex < groupItem->childCount() ? groupItem->child(childIndex) : new QTreeWidgetItem(groupItem);
+        ++childIndex;
+
+        item->setText(0, statistic.name);
+        item->setText(1, PDFRuntimeStatisticsManager::getFormattedValue(statistic));
+        item->setText(2, statistic.type == PDFRuntimeStatistic::Type::Counter ? tr("Counter") : tr("Gauge"));
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    // Remove items, which are no longer present (for example,
+    // when provider was unregistered)
+    for (int i = ui->statisticsTreeWidget->topLevelItemCount() - 1; i >= 0; --i)
+    {
+        QTreeWidgetItem* groupItem = ui->statisticsTreeWidget->topLevelItem(i);
+        const int childCount = childCounts.count(groupItem) ? childCounts[groupItem] : 0;
+
+        if (childCount == 0)
+        {
+            delete groupItem;
+            continue;
+        }
+
+        while (groupItem->childCount() > childCount)
+        {
+            delete groupItem->child(groupItem->childCount() - 1);
+        }
+    }
+}
+
+void PDFRuntimeStatisticsDialog::copyToClipboard()
+{
+    QGuiApplication::clipboard()->setText(PDFRuntimeStatisticsManager::toText(m_statistics));
+}
+
+}   // namespace pdf
@@ -0,0 +1,61 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFRUNTIMESTATISTICSDIALOG_H
+#define PDFRUNTIMESTATISTICSDIALOG_H
+
+#include "pdfwidgetsglobal.h"
+#include "pdfruntimestatistics.h"
+
+#include <QDialog>
+
+class QTimer;
+
+namespace Ui
+{
+class PDFRuntimeStatisticsDialog;
+}
+
+namespace pdf
+{
+
+/// Displays runtime statistics of caches and thread pools (see
+/// PDFRuntimeStatisticsManager). Statistics are refreshed periodically,
+/// while the dialog is shown.
+class PDF4QTLIBWIDGETSSHARED_EXPORT PDFRuntimeStatisticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit PDFRuntimeStatisticsDialog(QWidget* parent);
+    virtual ~PDFRuntimeStatisticsDialog() override;
+
+private:
+    /// Refresh interval of the statistics [msec]
+    static constexpr int REFRESH_INTERVAL = 1000;
+
+    void refresh();
+    void copyToClipboard();
+
+    Ui::PDFRuntimeStatisticsDialog* ui;
+    QTimer* m_timer;
+    PDFRuntimeStatistics m_statistics;
+};
+
+}   // namespace pdf
+
+#endif // PDFRUNTIMESTATISTICSDIALOG_H
@@ -57,8 +57,19 @@ void PDFWidgetAnnotationManager::setDocument(const PDFModifiedDocument& document
 
     if (document.hasReset() || document.getFlags().testFlag(PDFModifiedDocument::Annotation))
     {
-        m_editableAnnotation = PDFObjectReference();
-        m_editableAnnotationPage = PDFObjectReference();
+        // Editable annotation is preserved, if its page was not affected
+        bool isEditableAnnotationAffected = true;
+        if (document.hasAffectedPages() && m_editableAnnotationPage.isValid())
+        {
+            const size_t pageIndex = document.getDocument()->getCatalog()->getPageIndexFromPageReference(m_editableAnnotationPage);
+            isEditableAnnotationAffected = pageIndex == PDFCatalog::INVALID_PAGE_INDEX || document.isPageAffected(PDFInteger(pageIndex));
+        }
+
+        if (isEditableAnnotationAffected)
+        {
+            m_editableAnnotation = PDFObjectReference();
+            m_editableAnnotationPage = PDFObjectReference();
+        }
     }
 }
 
@@ -206,8 +217,28 @@ void PDFWidgetAnnotationManager::updateFromMouseEvent(QMouseEvent* event)
     for (const PDFWidgetSnapshot::SnapshotItem& snapshotItem : snapshot.items)
     {
         PageAnnotations& pageAnnotations = getPageAnnotations(snapshotItem.pageIndex);
-        for (PageAnnotation& pageAnnotation : pageAnnotations.annotations)
+
+        // Only annotations found in the spatial index can be under the mouse cursor,
+        // other annotations just get their appearance reset.
+        bool isInvertible = false;
+        const QTransform deviceToPageMatrix = snapshotItem.pageToDeviceMatrix.inverted(&isInvertible);
+        std::vector<size_t> candidates;
+        if (isInvertible)
         {
+            candidates = pageAnnotations.getAnnotationsAtPoint(deviceToPageMatrix.map(QPointF(event->pos())));
+        }
+        auto candidateIt = candidates.cbegin();
+
+        for (size_t i = 0, count = pageAnnotations.annotations.size(); i < count; ++i)
+        {
+            PageAnnotation& pageAnnotation = pageAnnotations.annotations[i];
+
+            const bool isCandidate = candidateIt != candidates.cend() && *candidateIt == i;
+            if (isCandidate)
+            {
+                ++candidateIt;
+            }
+
             if (pageAnnotation.annotation->isReplyTo())
             {
                 // Annotation is reply to another annotation, do not interact with it
@@ -215,13 +246,18 @@ void PDFWidgetAnnotationManager::updateFromMouseEvent(QMouseEvent* event)
             }
 
             const PDFAppeareanceStreams::Appearance oldAppearance = pageAnnotation.appearance;
-            QRectF annotationRect = pageAnnotation.annotation->getRectangle();
-            QTransform matrix = prepareTransformations(snapshotItem.pageToDeviceMatrix, widget, pageAnnotation.annotation->getEffectiveFlags(), m_document->getCatalog()->getPage(snapshotItem.pageIndex), annotationRect);
-            QPainterPath path;
-            path.addRect(annotationRect);
-            path = matrix.map(path);
+            bool isUnderMouse = false;
+            if (isCandidate)
+            {
+                QRectF annotationRect = pageAnnotation.annotation->getRectangle();
+                QTransform matrix = prepareTransformations(snapshotItem.pageToDeviceMatrix, widget, pageAnnotation.annotation->getEffectiveFlags(), m_document->getCatalog()->getPage(snapshotItem.pageIndex), annotationRect);
+                QPainterPath path;
+                path.addRect(annotationRect);
+                path = matrix.map(path);
+                isUnderMouse = path.contains(event->pos());
+            }
 
-            if (path.contains(event->pos()))
+            if (isUnderMouse)
             {
                 pageAnnotation.appearance = hoverAppearance;
                 pageAnnotation.isHovered = true;
@@ -395,7 +431,7 @@ void PDFWidgetAnnotationManager::onCopyAnnotation()
 
         if (modifier.finalize())
         {
-            Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT documentModified(modifier.getModifiedDocument());
         }
     }
 }
@@ -419,7 +455,7 @@ void PDFWidgetAnnotationManager::onEditAnnotation()
 
             if (modifier.finalize())
             {
-                Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+                Q_EMIT documentModified(modifier.getModifiedDocument());
             }
         }
     }
@@ -435,7 +471,7 @@ void PDFWidgetAnnotationManager::onDeleteAnnotation()
 
         if (modifier.finalize())
         {
-            Q_EMIT documentModified(PDFModifiedDocument(modifier.getDocument(), nullptr, modifier.getFlags()));
+            Q_EMIT documentModified(modifier.getModifiedDocument());
         }
     }
 }
@@ -561,8 +561,38 @@ PDFWidgetFormManager::MouseEventInfo PDFWidgetFormManager::getMouseEventInfo(QWi
     for (const PDFWidgetSnapshot::SnapshotItem& snapshotItem : snapshot.items)
     {
         const PDFAnnotationManager::PageAnnotations& pageAnnotations = m_annotationManager->getPageAnnotations(snapshotItem.pageIndex);
-        for (const PDFAnnotationManager::PageAnnotation& pageAnnotation : pageAnnotations.annotations)
+
+        bool isInvertible = false;
+        const QTransform deviceToPageMatrix = snapshotItem.pageToDeviceMatrix.inverted(&isInvertible);
+        if (!isInvertible)
+        {
+            continue;
+        }
+
+        std::vector<size_t> candidates = pageAnnotations.getAnnotationsAtPoint(deviceToPageMatrix.map(QPointF(point)));
+
+        // Active editor (for example, combo box with opened list) can be
+        // outside of the annotation rectangle, so it must be always tested.
+        if (m_focusedEditor && m_focusedEditor->getActiveEditorRectangle().isValid())
+        {
+            const PDFObjectReference focusedWidgetAnnotation = m_focusedEditor->getWidgetAnnotation();
+            for (size_t i = 0, count = pageAnnotations.annotations.size(); i < count; ++i)
+            {
+                if (pageAnnotations.annotations[i].annotation->getSelfReference() == focusedWidgetAnnotation)
+                {
+                    auto it = std::lower_bound(candidates.begin(), candidates.end(), i);
+                    if (it == candidates.end() || *it != i)
+                    {
+                        candidates.insert(it, i);
+                    }
+                    break;
+                }
+            }
+        }
+
+        for (size_t annotationIndex : candidates)
         {
+            const PDFAnnotationManager::PageAnnotation& pageAnnotation = pageAnnotations.annotations[annotationIndex];
             if (pageAnnotation.annotation->isReplyTo())
             {
                 // Annotation is reply to another annotation, do not interact with it
@@ -808,15 +838,19 @@ PDFWidgetFormManager::~PDFWidgetFormManager()
     clearEditors();
 }
 
-void PDFWidgetFormManager::updateFieldValues()
+void PDFWidgetFormManager::updateFieldValues(const std::vector<PDFObjectReference>& changedObjects)
 {
-    BaseClass::updateFieldValues();
+    BaseClass::updateFieldValues(changedObjects);
 
     if (getDocument())
     {
         for (PDFFormFieldWidgetEditor* editor : m_widgetEditors)
         {
-            editor->reloadValue();
+            // Reload only editors of the changed form fields, if changes are known
+            if (changedObjects.empty() || isFormFieldChanged(editor->getFormField(), changedObjects))
+            {
+                editor->reloadValue();
+            }
         }
     }
 }
@@ -145,7 +145,7 @@ public:
     void setAnnotationManager(PDFWidgetAnnotationManager* annotationManager);
 
 protected:
-    virtual void updateFieldValues() override;
+    virtual void updateFieldValues(const std::vector<PDFObjectReference>& changedObjects) override;
     virtual void onDocumentReset() override;
 
 private:
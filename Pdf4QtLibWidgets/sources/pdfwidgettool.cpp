@@ -497,8 +497,9 @@ void PDFFindTextTool::onSearchText()
         return;
     }
 
+    // Simple text can be found without text layout of the whole document
     pdf::PDFAsynchronousTextLayoutCompiler* compiler = getProxy()->getTextLayoutCompiler();
-    if (compiler->isTextLayoutReady())
+    if (compiler->isTextLayoutReady() || !m_parameters.isWholeWordsOnly)
     {
         performSearch();
     }
@@ -573,11 +574,6 @@ void PDFFindTextTool::performSearch()
     }
 
     PDFAsynchronousTextLayoutCompiler* compiler = getProxy()->getTextLayoutCompiler();
-    if (!compiler->isTextLayoutReady())
-    {
-        // Text layout is not ready yet
-        return;
-    }
 
     // Prepare string to search
     QString expression = m_parameters.phrase;
@@ -591,15 +587,23 @@ void PDFFindTextTool::performSearch()
 
     pdf::PDFTextFlow::FlowFlags flowFlags = pdf::PDFTextFlow::SeparateBlocks;
 
-    const pdf::PDFTextLayoutStorage* textLayoutStorage = compiler->getTextLayoutStorage();
     if (!useRegularExpression)
     {
-        // Use simple text search
+        // Use simple text search, text layout is created only for pages with hits,
+        // if text layout of the whole document is not ready.
         Qt::CaseSensitivity caseSensitivity = m_parameters.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-        m_findResults = textLayoutStorage->find(expression, caseSensitivity, flowFlags);
+        m_findResults = compiler->findText(expression, caseSensitivity, flowFlags);
     }
     else
     {
+        const pdf::PDFTextLayoutStorage* textLayoutStorage = compiler->getTextLayoutStorage();
+        if (!textLayoutStorage)
+        {
+            // Text layout is not ready yet
+            m_parameters.isSearchFinished = false;
+            return;
+        }
+
         // Use regular expression search
         QRegularExpression::PatternOptions patternOptions = QRegularExpression::UseUnicodePropertiesOption;
         if (!m_parameters.isCaseSensitive)
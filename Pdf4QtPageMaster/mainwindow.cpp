@@ -41,6 +41,7 @@
 #include <QDropEvent>
 #include <QSettings>
 #include <QMimeData>
+#include <QScrollBar>
 
 namespace pdfpagemaster
 {
@@ -58,6 +59,8 @@ MainWindow::MainWindow(QWidget* parent) :
 
     ui->documentItemsView->setModel(m_model);
     ui->documentItemsView->setItemDelegate(m_delegate);
+    connect(m_delegate, &PageItemDelegate::thumbnailsRendered, ui->documentItemsView->viewport(), QOverload<>::of(&QWidget::update));
+    connect(ui->documentItemsView->verticalScrollBar(), &QScrollBar::valueChanged, m_delegate, &PageItemDelegate::cancelPendingThumbnails);
     connect(ui->documentItemsView, &QListView::customContextMenuRequested, this, &MainWindow::onWorkspaceCustomContextMenuRequested);
 
     setMinimumSize(pdf::PDFWidgetUtils::scaleDPI(this, QSize(800, 600)));
@@ -218,6 +221,7 @@ MainWindow::MainWindow(QWidget* parent) :
 MainWindow::~MainWindow()
 {
     saveSettings();
+    m_delegate->stop();
     delete ui;
 }
 
@@ -515,6 +519,7 @@ void MainWindow::performOperation(Operation operation)
     {
         case Operation::Clear:
         {
+            m_delegate->stop();
             m_model->clear();
             QPixmapCache::clear();
             break;
@@ -23,24 +23,36 @@
 #include "pdfcompiler.h"
 #include "pdfconstants.h"
 
+#include <QThread>
 #include <QPainter>
 #include <QPixmapCache>
 
 namespace pdfpagemaster
 {
 
+PageItemDelegate::DocumentContext::DocumentContext(const pdf::PDFDocument* document) :
+    document(document),
+    fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT),
+    optionalContentActivity(document, pdf::OCUsage::View, nullptr),
+    cmsManager(nullptr)
+{
+    fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(document), &optionalContentActivity));
+    cmsManager.setDocument(document);
+    cms = cmsManager.getCurrentCMS();
+}
+
 PageItemDelegate::PageItemDelegate(PageItemModel* model, QObject* parent) :
     BaseClass(parent),
-    m_model(model),
-    m_rasterizer(nullptr)
+    m_model(model)
 {
-    m_rasterizer = new pdf::PDFRasterizer(this);
-    m_rasterizer->reset(pdf::RendererEngine::Blend2D_SingleThread);
+    // Thumbnails are rendered with low priority, so user interface stays responsive
+    m_threadPool.setMaxThreadCount(qMax(QThread::idealThreadCount() / 2, 1));
+    m_threadPool.setThreadPriority(QThread::LowPriority);
 }
 
 PageItemDelegate::~PageItemDelegate()
 {
-
+    stop();
 }
 
 void PageItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
@@ -134,10 +146,167 @@ void PageItemDelegate::setPageImageSize(QSize pageImageSize)
     if (m_pageImageSize != pageImageSize)
     {
         m_pageImageSize = pageImageSize;
+        cancelPendingThumbnails();
         Q_EMIT sizeHintChanged(QModelIndex());
     }
 }
 
+void PageItemDelegate::cancelPendingThumbnails()
+{
+    for (const ThumbnailTask& task : m_pendingTasks)
+    {
+        m_requestedThumbnails.erase(task.key);
+    }
+    m_pendingTasks.clear();
+}
+
+void PageItemDelegate::stop()
+{
+    ++m_generation;
+    m_pendingTasks.clear();
+    m_requestedThumbnails.clear();
+
+    // Thumbnails being rendered are discarded, when they are delivered
+    m_isCancelled = true;
+    m_threadPool.waitForDone();
+    m_isCancelled = false;
+
+    m_documentContexts.clear();
+}
+
+bool PageItemDelegate::isOperationCancelled() const
+{
+    return m_isCancelled;
+}
+
+void PageItemDelegate::requestThumbnail(ThumbnailTask task)
+{
+    if (m_requestedThumbnails.count(task.key))
+    {
+        return;
+    }
+
+    const auto& documents = m_model->getDocuments();
+    auto it = documents.find(task.documentIndex);
+    if (it == documents.cend() || task.imageSize.isEmpty())
+    {
+        return;
+    }
+
+    const pdf::PDFDocument* document = &it->second.document;
+    if (task.pageIndex < 0 || task.pageIndex >= pdf::PDFInteger(document->getCatalog()->getPageCount()))
+    {
+        return;
+    }
+
+    std::shared_ptr<DocumentContext>& documentContext = m_documentContexts[task.documentIndex];
+    if (!documentContext)
+    {
+        documentContext = std::make_shared<DocumentContext>(document);
+    }
+
+    task.documentContext = documentContext;
+    task.generation = m_generation;
+    task.operationControl = this;
+
+    m_requestedThumbnails.insert(task.key);
+    m_pendingTasks.push_back(qMove(task));
+    startRendering();
+}
+
+void PageItemDelegate::startRendering()
+{
+    // Thumbnails requested lately are rendered first, because their
+    // items were painted lately (for example, when view is scrolled).
+    while (m_runningTaskCount < m_threadPool.maxThreadCount() && !m_pendingTasks.empty())
+    {
+        ThumbnailTask task = qMove(m_pendingTasks.back());
+        m_pendingTasks.pop_back();
+        ++m_runningTaskCount;
+
+        auto renderTask = [this, task]() mutable
+        {
+            renderThumbnail(task);
+            QMetaObject::invokeMethod(this, [this, task = qMove(task)]() { onThumbnailRendered(task); }, Qt::QueuedConnection);
+        };
+        m_threadPool.start(renderTask);
+    }
+}
+
+void PageItemDelegate::renderThumbnail(ThumbnailTask& task)
+{
+    const pdf::PDFDocument* document = task.documentContext->document;
+    const pdf::PDFPage* page = document->getCatalog()->getPage(task.pageIndex);
+    if (!page || pdf::PDFOperationControl::isOperationCancelled(task.operationControl))
+    {
+        return;
+    }
+
+    // Embedded thumbnail is not rotated, so it can be used only for pages without additional rotation
+    if (task.pageAdditionalRotation == pdf::PageRotation::None)
+    {
+        task.image = pdf::PDFAsynchronousThumbnailRenderer::getEmbeddedThumbnail(document, page, task.imageSize, task.documentContext->cms.data(), task.operationControl);
+        if (!task.image.isNull())
+        {
+            return;
+        }
+    }
+
+    // Thumbnail is small, so we can use lower quality settings, images
+    // are decoded only in the resolution needed for the thumbnail.
+    pdf::PDFRenderer::Features features = pdf::PDFRenderer::getDefaultFeatures();
+    features.setFlag(pdf::PDFRenderer::TextAntialiasing, false);
+
+    pdf::PDFMeshQualitySettings meshQualitySettings;
+    meshQualitySettings.tolerance *= MESH_QUALITY_REDUCTION;
+    meshQualitySettings.patchFlatnessTolerance *= MESH_QUALITY_REDUCTION;
+    meshQualitySettings.patchTestPoints = qMax(meshQualitySettings.patchTestPoints / pdf::PDFInteger(MESH_QUALITY_REDUCTION), pdf::PDFInteger(4));
+
+    DocumentContext* documentContext = task.documentContext.get();
+    pdf::PDFPrecompiledPage compiledPage;
+    pdf::PDFRenderer renderer(document, &documentContext->fontCache, documentContext->cms.data(), &documentContext->optionalContentActivity, features, meshQualitySettings);
+    renderer.setOperationControl(task.operationControl);
+    renderer.setImageResolutionHint(pdf::PDFRenderer::calculateImageResolutionHint(page, task.imageSize));
+    renderer.compile(&compiledPage, task.pageIndex);
+
+    if (pdf::PDFOperationControl::isOperationCancelled(task.operationControl))
+    {
+        return;
+    }
+
+    pdf::PDFRasterizer rasterizer(nullptr);
+    rasterizer.reset(pdf::RendererEngine::Blend2D_SingleThread);
+    task.image = rasterizer.render(task.pageIndex, page, &compiledPage, task.imageSize, features, nullptr, task.pageAdditionalRotation);
+}
+
+void PageItemDelegate::onThumbnailRendered(ThumbnailTask task)
+{
+    --m_runningTaskCount;
+
+    // Discard thumbnails, which were requested before the delegate was stopped
+    if (task.generation == m_generation)
+    {
+        m_requestedThumbnails.erase(task.key);
+
+        QPixmap pixmap;
+        if (!task.image.isNull())
+        {
+            pixmap = QPixmap::fromImage(qMove(task.image));
+        }
+        else
+        {
+            // Page can't be rendered, we do not want to render it again
+            pixmap = QPixmap(task.imageSize);
+            pixmap.fill(Qt::transparent);
+        }
+
+        QPixmapCache::insert(task.key, pixmap);
+        Q_EMIT thumbnailsRendered();
+    }
+
+    startRendering();
+}
+
 QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect rect) const
 {
     QPixmap pixmap;
@@ -157,83 +326,69 @@ QPixmap PageItemDelegate::getPageImagePixmap(const PageGroupItem* item, QRect re
     // Jakub Melka: generate key and see, if pixmap is not cached
     QString key = QString("%1#%2#%3#%4#%5@%6x%7").arg(groupItem.documentIndex).arg(groupItem.imageIndex).arg(int(groupItem.pageAdditionalRotation)).arg(groupItem.pageIndex).arg(groupItem.pageType).arg(rect.width()).arg(rect.height());
 
-    if (!QPixmapCache::find(key, &pixmap))
+    if (QPixmapCache::find(key, &pixmap))
     {
-        // We must draw the pixmap
-        pixmap = QPixmap(rect.width(), rect.height());
-        pixmap.fill(Qt::transparent);
+        return pixmap;
+    }
 
-        switch (groupItem.pageType)
-        {
-            case pdfpagemaster::PT_DocumentPage:
-            {
-                const auto& documents = m_model->getDocuments();
-                auto it = documents.find(groupItem.documentIndex);
-                if (it != documents.cend())
-                {
-                    const pdf::PDFDocument& document = it->second.document;
-                    const pdf::PDFInteger pageIndex = groupItem.pageIndex - 1;
-                    if (pageIndex >= 0 && pageIndex < pdf::PDFInteger(document.getCatalog()->getPageCount()))
-                    {
-                        const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
-                        Q_ASSERT(page);
-
-                        pdf::PDFPrecompiledPage compiledPage;
-                        pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-                        pdf::PDFCMSManager cmsManager(nullptr);
-                        pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::View, nullptr);
-
-                        fontCache.setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(&document), &optionalContentActivity));
-                        cmsManager.setDocument(&document);
-
-                        pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
-                        pdf::PDFRenderer renderer(&document, &fontCache, cms.data(), &optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
-                        renderer.compile(&compiledPage, pageIndex);
-
-                        QSize imageSize = rect.size() * m_dpiScaleRatio;
-                        QImage pageImage = m_rasterizer->render(pageIndex, page, &compiledPage, imageSize, pdf::PDFRenderer::getDefaultFeatures(), nullptr, groupItem.pageAdditionalRotation);
-                        pixmap = QPixmap::fromImage(qMove(pageImage));
-                    }
-                }
-                break;
-            }
+    if (groupItem.pageType == PT_DocumentPage)
+    {
+        // Pages are rendered asynchronously, blank page is
+        // painted until thumbnail is rendered.
+        ThumbnailTask task;
+        task.key = key;
+        task.documentIndex = groupItem.documentIndex;
+        task.pageIndex = groupItem.pageIndex - 1;
+        task.pageAdditionalRotation = groupItem.pageAdditionalRotation;
+        task.imageSize = rect.size() * m_dpiScaleRatio;
+
+        // Rendering state is not a part of the painting state of the delegate
+        const_cast<PageItemDelegate*>(this)->requestThumbnail(qMove(task));
+        return pixmap;
+    }
+
+    // We must draw the pixmap
+    pixmap = QPixmap(rect.width(), rect.height());
+    pixmap.fill(Qt::transparent);
 
-            case pdfpagemaster::PT_Image:
+    switch (groupItem.pageType)
+    {
+        case pdfpagemaster::PT_Image:
+        {
+            const auto& images = m_model->getImages();
+            auto it = images.find(groupItem.imageIndex);
+            if (it != images.cend())
             {
-                const auto& images = m_model->getImages();
-                auto it = images.find(groupItem.imageIndex);
-                if (it != images.cend())
+                const QImage& image = it->second.image;
+                if (!image.isNull())
                 {
-                    const QImage& image = it->second.image;
-                    if (!image.isNull())
-                    {
-                        QRect drawRect(QPoint(0, 0), rect.size());
-                        QRect mediaBox(QPoint(0, 0), image.size());
-                        QRectF rotatedMediaBox = pdf::PDFPage::getRotatedBox(mediaBox, groupItem.pageAdditionalRotation);
-                        QTransform matrix = pdf::PDFRenderer::createMediaBoxToDevicePointMatrix(rotatedMediaBox, drawRect, groupItem.pageAdditionalRotation);
-
-                        QPainter painter(&pixmap);
-                        painter.setWorldTransform(QTransform(matrix));
-                        painter.translate(0, image.height());
-                        painter.scale(1.0, -1.0);
-                        painter.drawImage(0, 0, image);
-                    }
+                    QRect drawRect(QPoint(0, 0), rect.size());
+                    QRect mediaBox(QPoint(0, 0), image.size());
+                    QRectF rotatedMediaBox = pdf::PDFPage::getRotatedBox(mediaBox, groupItem.pageAdditionalRotation);
+                    QTransform matrix = pdf::PDFRenderer::createMediaBoxToDevicePointMatrix(rotatedMediaBox, drawRect, groupItem.pageAdditionalRotation);
+
+                    QPainter painter(&pixmap);
+                    painter.setWorldTransform(QTransform(matrix));
+                    painter.translate(0, image.height());
+                    painter.scale(1.0, -1.0);
+                    painter.drawImage(0, 0, image);
                 }
-                break;
             }
-
-            case pdfpagemaster::PT_Empty:
-                Q_ASSERT(false);
-                break;
-
-            default:
-                Q_ASSERT(false);
-                break;
+            break;
         }
 
-        QPixmapCache::insert(key, pixmap);
+        case pdfpagemaster::PT_DocumentPage:
+        case pdfpagemaster::PT_Empty:
+            Q_ASSERT(false);
+            break;
+
+        default:
+            Q_ASSERT(false);
+            break;
     }
 
+    QPixmapCache::insert(key, pixmap);
+
     return pixmap;
 }
 
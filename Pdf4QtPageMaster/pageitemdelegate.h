@@ -20,16 +20,28 @@
 
 #include "pdfrenderer.h"
 #include "pdfcms.h"
+#include "pdffont.h"
+#include "pdfoptionalcontent.h"
 
+#include <QThreadPool>
 #include <QAbstractItemDelegate>
 
+#include <map>
+#include <set>
+#include <memory>
+#include <atomic>
+
 namespace pdfpagemaster
 {
 
 class PageItemModel;
 struct PageGroupItem;
 
-class PageItemDelegate : public QAbstractItemDelegate
+/// Delegate painting page items. Page thumbnails are rendered asynchronously
+/// in the delegate's own thread pool, only when item is painted (so only
+/// for visible items), and rendered thumbnails are stored in the pixmap cache.
+/// Until thumbnail is rendered, blank page is painted.
+class PageItemDelegate : public QAbstractItemDelegate, public pdf::PDFOperationControl
 {
     Q_OBJECT
 
@@ -46,16 +58,84 @@ public:
     QSize getPageImageSize() const;
     void setPageImageSize(QSize pageImageSize);
 
+    /// Discards thumbnails, which were requested, but their rendering
+    /// was not started yet (for example, when view is scrolled, items
+    /// are no longer visible). Thumbnails of visible items are requested
+    /// again, when items are painted.
+    void cancelPendingThumbnails();
+
+    /// Discards all requested thumbnails and waits, until rendering
+    /// of the thumbnails is finished. Call this function before
+    /// documents of the model are removed.
+    void stop();
+
+    /// Is operation being cancelled?
+    virtual bool isOperationCancelled() const override;
+
+signals:
+    /// Emitted, when requested thumbnails were rendered
+    /// and stored in the pixmap cache.
+    void thumbnailsRendered();
+
 private:
     static constexpr int getVerticalSpacing() { return 5; }
     static constexpr int getHorizontalSpacing() { return 5; }
 
+    /// Shading meshes of the thumbnails are created with this times larger tolerances
+    static constexpr pdf::PDFReal MESH_QUALITY_REDUCTION = 4.0;
+
+    /// Objects needed to render pages of the document, they are
+    /// shared by all thumbnails of the document.
+    struct DocumentContext
+    {
+        explicit DocumentContext(const pdf::PDFDocument* document);
+
+        const pdf::PDFDocument* document;
+        pdf::PDFFontCache fontCache;
+        pdf::PDFOptionalContentActivity optionalContentActivity;
+        pdf::PDFCMSManager cmsManager;
+        pdf::PDFCMSPointer cms;
+    };
+
+    struct ThumbnailTask
+    {
+        QString key;
+        int documentIndex = -1;
+        pdf::PDFInteger pageIndex = -1;
+        pdf::PageRotation pageAdditionalRotation = pdf::PageRotation::None;
+        QSize imageSize;
+        quint64 generation = 0;
+        std::shared_ptr<DocumentContext> documentContext;
+        const pdf::PDFOperationControl* operationControl = nullptr;
+        QImage image;
+    };
+
+    /// Returns pixmap of the page from the pixmap cache. If pixmap of the document
+    /// page isn't cached, then its rendering is requested and null pixmap is returned.
     QPixmap getPageImagePixmap(const PageGroupItem* item, QRect rect) const;
 
+    /// Requests rendering of the thumbnail of the document page
+    void requestThumbnail(ThumbnailTask task);
+
+    /// Starts rendering of the pending thumbnails, if some thread is free
+    void startRendering();
+
+    /// Renders the thumbnail, this function is called in the worker thread
+    static void renderThumbnail(ThumbnailTask& task);
+
+    void onThumbnailRendered(ThumbnailTask task);
+
     PageItemModel* m_model;
     QSize m_pageImageSize;
-    pdf::PDFRasterizer* m_rasterizer;
     mutable double m_dpiScaleRatio = 1.0;
+
+    std::map<int, std::shared_ptr<DocumentContext>> m_documentContexts;
+    std::vector<ThumbnailTask> m_pendingTasks;
+    std::set<QString> m_requestedThumbnails;
+    int m_runningTaskCount = 0;
+    QThreadPool m_threadPool;
+    quint64 m_generation = 0;
+    std::atomic_bool m_isCancelled = false;
 };
 
 }   // namespace pdfpagemaster
@@ -40,6 +40,7 @@ SelectOutlineToRegroupDialog::SelectOutlineToRegroupDialog(const pdf::PDFDocumen
     ui->outlineView->header()->hide();
 
     m_model->setDocument(pdf::PDFModifiedDocument(const_cast<pdf::PDFDocument*>(document), nullptr));
+    m_model->fetchAll();
     ui->outlineView->expandToDepth(2);
     ui->outlineView->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(ui->outlineView, &QTreeView::customContextMenuRequested, this, &SelectOutlineToRegroupDialog::onViewContextMenuRequested);
@@ -16,6 +16,7 @@
 //    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pdfviewermainwindow.h"
+#include "pdfsingleinstance.h"
 #include "pdfconstants.h"
 
 #include <QApplication>
@@ -37,12 +38,71 @@ int main(int argc, char *argv[])
     parser.addPositionalArgument("file", "The PDF file to open.");
     parser.process(application);
 
+    pdfviewer::PDFSingleInstance singleInstance(nullptr);
+    if (pdfviewer::PDFViewerSettings::readSingleInstanceMode())
+    {
+        if (singleInstance.forwardToRunningInstance(parser.positionalArguments()))
+        {
+            // Documents will be opened by the running instance
+            return 0;
+        }
+
+        singleInstance.listen();
+    }
+
     QIcon appIcon(":/app-icon.svg");
     QApplication::setWindowIcon(appIcon);
 
     pdfviewer::PDFViewerMainWindow mainWindow;
     mainWindow.show();
 
+    auto openDocuments = [](const QStringList& fileNames)
+    {
+        // Find main window, which can be used to open the document, i.e. window,
+        // which has no document opened. If no such window exists, new window
+        // is created. Caches of the process are shared between windows.
+        auto getFreeWindow = []() -> pdfviewer::PDFViewerMainWindow*
+        {
+            for (QWidget* widget : QApplication::topLevelWidgets())
+            {
+                pdfviewer::PDFViewerMainWindow* window = qobject_cast<pdfviewer::PDFViewerMainWindow*>(widget);
+                if (window && window->isVisible())
+                {
+                    pdfviewer::PDFProgramController* controller = window->getProgramController();
+                    if (!controller->getDocument() && !controller->isDocumentReadingInProgress())
+                    {
+                        return window;
+                    }
+                }
+            }
+
+            pdfviewer::PDFViewerMainWindow* window = new pdfviewer::PDFViewerMainWindow();
+            window->setAttribute(Qt::WA_DeleteOnClose);
+            window->show();
+            return window;
+        };
+
+        auto activateWindow = [](QWidget* window)
+        {
+            window->setWindowState((window->windowState() & ~Qt::WindowMinimized) | Qt::WindowActive);
+            window->raise();
+            window->activateWindow();
+        };
+
+        for (const QString& fileName : fileNames)
+        {
+            pdfviewer::PDFViewerMainWindow* window = getFreeWindow();
+            window->getProgramController()->openDocument(fileName);
+            activateWindow(window);
+        }
+
+        if (fileNames.isEmpty())
+        {
+            activateWindow(getFreeWindow());
+        }
+    };
+    QObject::connect(&singleInstance, &pdfviewer::PDFSingleInstance::openDocumentsRequested, &mainWindow, openDocuments);
+
     QStringList arguments = application.arguments();
     if (arguments.size() > 1)
     {
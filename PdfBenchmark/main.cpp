@@ -0,0 +1,190 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfbenchmarkcorpus.h"
+#include "pdfbenchmarkrunner.h"
+#include "pdfconstants.h"
+#include "pdfdocumentwriter.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QGuiApplication>
+#include <QCommandLineParser>
+
+#include <algorithm>
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication a(argc, argv);
+    QCoreApplication::setOrganizationName("MelkaJ");
+    QCoreApplication::setApplicationName("PdfBenchmark");
+    QCoreApplication::setApplicationVersion(pdf::PDF_LIBRARY_VERSION);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("PdfBenchmark - measures rendering throughput on generated corpus of documents");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption outputOption("output", "Write results to the JSON file.", "file");
+    QCommandLineOption baselineOption("baseline", "Compare results with baseline results (JSON file written by --output).", "file");
+    QCommandLineOption thresholdOption("threshold", "Slowdown in percents, which is reported as regression (default 10).", "percent", "10");
+    QCommandLineOption repetitionsOption("repetitions", "Count of measured repetitions (default 3).", "count", "3");
+    QCommandLineOption dpiOption("dpi", "Resolution of rendered images (default 150).", "dpi", "150");
+    QCommandLineOption engineOption("engine", "Measure only given renderer engine (blend2d-mt, blend2d-st, qpainter). Can be repeated.", "engine");
+    QCommandLineOption strategyOption("strategy", "Measure only given multithreading strategy (single, page, always). Can be repeated.", "strategy");
+    QCommandLineOption documentOption("document", "Measure only given document of the corpus. Can be repeated.", "document");
+    QCommandLineOption generateOption("generate", "Write corpus documents to the directory and exit.", "directory");
+    parser.addOptions({ outputOption, baselineOption, thresholdOption, repetitionsOption, dpiOption, engineOption, strategyOption, documentOption, generateOption });
+    parser.process(a);
+
+    std::vector<pdfbenchmark::PDFBenchmarkCorpus::Document> corpus = pdfbenchmark::PDFBenchmarkCorpus::createCorpus();
+
+    if (parser.isSet(generateOption))
+    {
+        QDir directory(parser.value(generateOption));
+        if (!directory.exists() && !directory.mkpath("."))
+        {
+            err << QString("Cannot create directory '%1'.").arg(directory.path()) << Qt::endl;
+            return 2;
+        }
+
+        pdf::PDFDocumentWriter writer(nullptr);
+        for (const pdfbenchmark::PDFBenchmarkCorpus::Document& document : corpus)
+        {
+            QString fileName = directory.absoluteFilePath(QString("Benchmark_%1.pdf").arg(document.name));
+            pdf::PDFOperationResult result = writer.write(fileName, &document.document, false);
+            if (!result)
+            {
+                err << QString("Cannot write file '%1': %2").arg(fileName, result.getErrorMessage()) << Qt::endl;
+                return 2;
+            }
+            out << fileName << Qt::endl;
+        }
+
+        return 0;
+    }
+
+    pdfbenchmark::PDFBenchmarkRunner::Settings settings;
+    settings.repetitions = qMax(parser.value(repetitionsOption).toInt(), 1);
+    settings.dpi = qBound(1.0, parser.value(dpiOption).toDouble(), 1200.0);
+
+    if (parser.isSet(engineOption))
+    {
+        const QStringList engineNames = parser.values(engineOption);
+        std::vector<pdf::RendererEngine> engines;
+        for (pdf::RendererEngine engine : settings.engines)
+        {
+            if (engineNames.contains(pdfbenchmark::PDFBenchmarkRunner::getEngineName(engine)))
+            {
+                engines.push_back(engine);
+            }
+        }
+        settings.engines = qMove(engines);
+    }
+
+    if (parser.isSet(strategyOption))
+    {
+        const QStringList strategyNames = parser.values(strategyOption);
+        std::vector<pdf::PDFExecutionPolicy::Strategy> strategies;
+        for (pdf::PDFExecutionPolicy::Strategy strategy : settings.strategies)
+        {
+            if (strategyNames.contains(pdfbenchmark::PDFBenchmarkRunner::getStrategyName(strategy)))
+            {
+                strategies.push_back(strategy);
+            }
+        }
+        settings.strategies = qMove(strategies);
+    }
+
+    if (parser.isSet(documentOption))
+    {
+        const QStringList documentNames = parser.values(documentOption);
+        auto isNotSelected = [&documentNames](const pdfbenchmark::PDFBenchmarkCorpus::Document& document) { return !documentNames.contains(document.name); };
+        corpus.erase(std::remove_if(corpus.begin(), corpus.end(), isNotSelected), corpus.end());
+    }
+
+    if (settings.engines.empty() || settings.strategies.empty() || corpus.empty())
+    {
+        err << "Nothing to measure, check --engine, --strategy and --document options." << Qt::endl;
+        return 2;
+    }
+
+    pdfbenchmark::PDFBenchmarkRunner runner(settings);
+    pdfbenchmark::PDFBenchmarkResults results = runner.run(corpus);
+
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QFile::WriteOnly | QFile::Truncate))
+        {
+            err << QString("Cannot write file '%1'.").arg(file.fileName()) << Qt::endl;
+            return 2;
+        }
+
+        file.write(QJsonDocument(runner.toJson(results)).toJson(QJsonDocument::Indented));
+        file.close();
+    }
+
+    if (parser.isSet(baselineOption))
+    {
+        QFile file(parser.value(baselineOption));
+        if (!file.open(QFile::ReadOnly))
+        {
+            err << QString("Cannot read file '%1'.").arg(file.fileName()) << Qt::endl;
+            return 2;
+        }
+
+        QJsonParseError parseError;
+        QJsonDocument baselineDocument = QJsonDocument::fromJson(file.readAll(), &parseError);
+        file.close();
+
+        if (parseError.error != QJsonParseError::NoError)
+        {
+            err << QString("Cannot parse file '%1': %2").arg(file.fileName(), parseError.errorString()) << Qt::endl;
+            return 2;
+        }
+
+        const double threshold = parser.value(thresholdOption).toDouble();
+        pdfbenchmark::PDFBenchmarkResults baseline = pdfbenchmark::PDFBenchmarkRunner::fromJson(baselineDocument.object());
+        std::vector<pdfbenchmark::PDFBenchmarkRunner::Comparison> comparisons = pdfbenchmark::PDFBenchmarkRunner::compare(results, baseline, threshold);
+
+        int regressionCount = 0;
+        out << Qt::endl << "Comparison with baseline:" << Qt::endl;
+        for (const pdfbenchmark::PDFBenchmarkRunner::Comparison& comparison : comparisons)
+        {
+            out << QString("%1 %2 -> %3 pages/sec (%4 %)%5").arg(comparison.key, -40).arg(comparison.baselinePagesPerSecond, 10, 'f', 2).arg(comparison.pagesPerSecond, 10, 'f', 2).arg(comparison.change, 7, 'f', 1).arg(comparison.isRegression ? " REGRESSION" : "") << Qt::endl;
+
+            if (comparison.isRegression)
+            {
+                ++regressionCount;
+            }
+        }
+
+        if (regressionCount > 0)
+        {
+            out << QString("%1 regression(s) found.").arg(regressionCount) << Qt::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,924 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfbenchmarkcorpus.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfstreamfilters.h"
+
+#include <QImage>
+#include <QBuffer>
+#include <QtMath>
+#include <QRandomGenerator>
+#include <QCoreApplication>
+
+#include <map>
+#include <iterator>
+
+namespace pdfbenchmark
+{
+
+namespace
+{
+
+constexpr QRectF PAGE_RECT(0, 0, 595, 842);
+constexpr int IMAGE_SIZE = 1024;
+constexpr int TEXT_PAGE_COUNT = 8;
+constexpr int TEXT_LINE_COUNT = 72;
+constexpr int VECTOR_PAGE_COUNT = 6;
+constexpr int VECTOR_PATH_COUNT = 3000;
+constexpr int TRANSPARENCY_PAGE_COUNT = 6;
+constexpr int TRANSPARENCY_OBJECT_COUNT = 40;
+constexpr int MESH_SIZE = 24;
+constexpr quint32 SEED = 0x50444634;
+
+using Entries = std::initializer_list<std::pair<const char*, pdf::PDFObject>>;
+
+pdf::PDFObject createName(const char* name)
+{
+    return pdf::PDFObject::createName(QByteArray(name));
+}
+
+pdf::PDFObject createReference(pdf::PDFObjectReference reference)
+{
+    return pdf::PDFObject::createReference(reference);
+}
+
+pdf::PDFObject createNumbers(std::initializer_list<pdf::PDFReal> numbers)
+{
+    pdf::PDFArray array;
+    for (pdf::PDFReal number : numbers)
+    {
+        array.appendItem(pdf::PDFObject::createReal(number));
+    }
+    return pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(qMove(array)));
+}
+
+pdf::PDFObject createArray(std::initializer_list<pdf::PDFObject> objects)
+{
+    pdf::PDFArray array;
+    for (const pdf::PDFObject& object : objects)
+    {
+        array.appendItem(object);
+    }
+    return pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(qMove(array)));
+}
+
+pdf::PDFDictionary createDictionaryContent(Entries entries)
+{
+    pdf::PDFDictionary dictionary;
+    for (const auto& entry : entries)
+    {
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString(entry.first), pdf::PDFObject(entry.second));
+    }
+    return dictionary;
+}
+
+pdf::PDFObject createDictionary(Entries entries)
+{
+    return pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(createDictionaryContent(entries)));
+}
+
+pdf::PDFObject createDictionaryFromMap(const std::map<QByteArray, pdf::PDFObject>& entries)
+{
+    pdf::PDFDictionary dictionary;
+    for (const auto& entry : entries)
+    {
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString(entry.first), pdf::PDFObject(entry.second));
+    }
+    return pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(qMove(dictionary)));
+}
+
+pdf::PDFObjectReference addStream(pdf::PDFDocumentBuilder& builder, Entries entries, QByteArray data)
+{
+    pdf::PDFDictionary dictionary = createDictionaryContent(entries);
+    dictionary.setEntry(pdf::PDFInplaceOrMemoryString("Length"), pdf::PDFObject::createInteger(data.size()));
+    return builder.addObject(pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(data))));
+}
+
+void addPage(pdf::PDFDocumentBuilder& builder, const QByteArray& content, pdf::PDFObject resources)
+{
+    pdf::PDFObjectReference pageReference = builder.appendPage(PAGE_RECT);
+    pdf::PDFObjectReference contentsReference = addStream(builder, { { "Filter", createName("FlateDecode") } }, pdf::PDFFlateDecodeFilter::compress(content));
+    builder.mergeTo(pageReference, createDictionary({ { "Contents", createReference(contentsReference) }, { "Resources", qMove(resources) } }));
+}
+
+void initializeBuilder(pdf::PDFDocumentBuilder& builder, QString title)
+{
+    builder.setDocumentTitle(qMove(title));
+    builder.setDocumentAuthor("Jakub Melka");
+    builder.setDocumentCreator(QCoreApplication::applicationName());
+    builder.setDocumentSubject("Rendering benchmark");
+}
+
+QByteArray toByteArray(pdf::PDFReal value)
+{
+    return QByteArray::number(value, 'f', 3);
+}
+
+QByteArray toByteArray(std::initializer_list<pdf::PDFReal> values)
+{
+    QByteArray result;
+    for (pdf::PDFReal value : values)
+    {
+        if (!result.isEmpty())
+        {
+            result += ' ';
+        }
+        result += toByteArray(value);
+    }
+    return result;
+}
+
+pdf::PDFReal getRandom(QRandomGenerator& generator, pdf::PDFReal minimum, pdf::PDFReal maximum)
+{
+    return minimum + generator.generateDouble() * (maximum - minimum);
+}
+
+QByteArray getRandomColor(QRandomGenerator& generator, bool stroking)
+{
+    // Mix of color spaces, so color conversions are also measured
+    switch (generator.bounded(3))
+    {
+        case 0:
+            return toByteArray({ generator.generateDouble() }) + (stroking ? " G\n" : " g\n");
+
+        case 1:
+            return toByteArray({ generator.generateDouble(), generator.generateDouble(), generator.generateDouble() }) + (stroking ? " RG\n" : " rg\n");
+
+        default:
+            return toByteArray({ generator.generateDouble(), generator.generateDouble(), generator.generateDouble(), generator.generateDouble() }) + (stroking ? " K\n" : " k\n");
+    }
+}
+
+/// Creates content of the image with given count of color components
+/// (deterministic pattern of gradients and noise, which is not compressed too well)
+QByteArray createImageData(int components, quint32 seed)
+{
+    QRandomGenerator generator(seed);
+
+    QByteArray data(IMAGE_SIZE * IMAGE_SIZE * components, Qt::Uninitialized);
+    uchar* pixel = reinterpret_cast<uchar*>(data.data());
+    for (int y = 0; y < IMAGE_SIZE; ++y)
+    {
+        for (int x = 0; x < IMAGE_SIZE; ++x)
+        {
+            const int noise = generator.bounded(32);
+            const int pattern = int(127.5 + 127.5 * qSin(x * 0.05) * qCos(y * 0.03));
+            for (int i = 0; i < components; ++i)
+            {
+                const int gradient = (i % 2 == 0) ? (x * 255 / IMAGE_SIZE) : (y * 255 / IMAGE_SIZE);
+                *pixel++ = uchar(qBound(0, (gradient + pattern) / 2 + noise - 16, 255));
+            }
+        }
+    }
+
+    return data;
+}
+
+QByteArray encodeAsciiHex(const QByteArray& data)
+{
+    return data.toHex() + '>';
+}
+
+QByteArray encodeAscii85(const QByteArray& data)
+{
+    QByteArray result;
+    result.reserve(data.size() * 5 / 4 + 8);
+
+    for (qsizetype i = 0; i < data.size(); i += 4)
+    {
+        const qsizetype count = qMin(qsizetype(4), data.size() - i);
+
+        quint32 value = 0;
+        for (qsizetype j = 0; j < 4; ++j)
+        {
+            value = (value << 8) | (j < count ? uchar(data[i + j]) : 0);
+        }
+
+        if (value == 0 && count == 4)
+        {
+            result += 'z';
+            continue;
+        }
+
+        char digits[5] = { };
+        for (int j = 4; j >= 0; --j)
+        {
+            digits[j] = char('!' + value % 85);
+            value /= 85;
+        }
+        result.append(digits, count + 1);
+    }
+
+    result += "~>";
+    return result;
+}
+
+QByteArray encodeRunLength(const QByteArray& data)
+{
+    QByteArray result;
+
+    qsizetype i = 0;
+    while (i < data.size())
+    {
+        // Find run of the same bytes
+        qsizetype runLength = 1;
+        while (i + runLength < data.size() && runLength < 128 && data[i + runLength] == data[i])
+        {
+            ++runLength;
+        }
+
+        if (runLength >= 2)
+        {
+            result += char(257 - runLength);
+            result += data[i];
+            i += runLength;
+            continue;
+        }
+
+        // Literal sequence ends, when run of at least two same bytes follows
+        qsizetype literalLength = 1;
+        while (i + literalLength < data.size() && literalLength < 128 &&
+               !(i + literalLength + 1 < data.size() && data[i + literalLength] == data[i + literalLength + 1]))
+        {
+            ++literalLength;
+        }
+
+        result += char(literalLength - 1);
+        result += data.mid(i, literalLength);
+        i += literalLength;
+    }
+
+    result += char(128);
+    return result;
+}
+
+QByteArray encodeLzw(const QByteArray& data)
+{
+    constexpr quint32 CODE_CLEAR_TABLE = 256;
+    constexpr quint32 CODE_END_OF_STREAM = 257;
+    constexpr quint32 FIRST_CODE = 258;
+    constexpr quint32 LAST_CODE = 4094;
+
+    QByteArray result;
+    quint32 buffer = 0;
+    int bufferBits = 0;
+    int bits = 9;
+    quint32 nextCode = FIRST_CODE;
+    std::map<quint32, quint32> table;
+
+    auto write = [&](quint32 code)
+    {
+        buffer = (buffer << bits) | code;
+        bufferBits += bits;
+        while (bufferBits >= 8)
+        {
+            bufferBits -= 8;
+            result += char((buffer >> bufferBits) & 0xFF);
+        }
+    };
+
+    // Jakub Melka: Decoder adds words to the table one code later than encoder,
+    // and uses early change (code length is increased one code earlier), so code
+    // length is increased, when encoder's next code reaches the power of two.
+    auto addCode = [&]()
+    {
+        ++nextCode;
+        switch (nextCode)
+        {
+            case 512:
+                bits = 10;
+                break;
+
+            case 1024:
+                bits = 11;
+                break;
+
+            case 2048:
+                bits = 12;
+                break;
+
+            default:
+                break;
+        }
+    };
+
+    write(CODE_CLEAR_TABLE);
+
+    qint64 word = -1;
+    for (const char character : data)
+    {
+        const quint32 byte = uchar(character);
+        if (word == -1)
+        {
+            word = byte;
+            continue;
+        }
+
+        const quint32 key = (quint32(word) << 8) | byte;
+        auto it = table.find(key);
+        if (it != table.cend())
+        {
+            word = it->second;
+            continue;
+        }
+
+        write(quint32(word));
+        table[key] = nextCode;
+        addCode();
+        word = byte;
+
+        if (nextCode == LAST_CODE)
+        {
+            write(CODE_CLEAR_TABLE);
+            table.clear();
+            nextCode = FIRST_CODE;
+            bits = 9;
+        }
+    }
+
+    if (word != -1)
+    {
+        write(quint32(word));
+        addCode();
+    }
+
+    write(CODE_END_OF_STREAM);
+
+    if (bufferBits > 0)
+    {
+        result += char((buffer << (8 - bufferBits)) & 0xFF);
+    }
+
+    return result;
+}
+
+/// Encodes image data using PNG predictor "Up" (each row is difference from previous row)
+QByteArray encodePngUpPredictor(const QByteArray& data, int bytesPerRow)
+{
+    QByteArray result;
+    result.reserve(data.size() + data.size() / bytesPerRow);
+
+    for (qsizetype rowStart = 0; rowStart < data.size(); rowStart += bytesPerRow)
+    {
+        result += char(2);
+        for (qsizetype i = rowStart; i < rowStart + bytesPerRow; ++i)
+        {
+            const uchar previous = (i >= bytesPerRow) ? uchar(data[i - bytesPerRow]) : 0;
+            result += char(uchar(data[i]) - previous);
+        }
+    }
+
+    return result;
+}
+
+QByteArray encodeDct(const QByteArray& data, int components)
+{
+    QImage image(reinterpret_cast<const uchar*>(data.constData()), IMAGE_SIZE, IMAGE_SIZE, IMAGE_SIZE * components, components == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+
+    QByteArray result;
+    QBuffer buffer(&result);
+    buffer.open(QBuffer::WriteOnly);
+    image.save(&buffer, "JPG", 85);
+    return result;
+}
+
+void appendBigEndian(QByteArray& data, quint32 value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; --i)
+    {
+        data += char((value >> (8 * i)) & 0xFF);
+    }
+}
+
+void appendCoordinate(QByteArray& data, pdf::PDFReal value)
+{
+    appendBigEndian(data, quint32(qRound(qBound(0.0, value, 1.0) * 65535.0)), 2);
+}
+
+void appendColor(QByteArray& data, QPointF point)
+{
+    data += char(qRound(point.x() * 255.0));
+    data += char(qRound(point.y() * 255.0));
+    data += char(qRound((1.0 - point.x() * point.y()) * 255.0));
+}
+
+/// Slightly distorts the point, so mesh shadings are not just regular grids
+QPointF distortPoint(QPointF point)
+{
+    const pdf::PDFReal dx = 0.02 * qSin(point.y() * 12.0);
+    const pdf::PDFReal dy = 0.02 * qCos(point.x() * 12.0);
+    return QPointF(qBound(0.0, point.x() + dx, 1.0), qBound(0.0, point.y() + dy, 1.0));
+}
+
+/// Appends coons patch (or tensor product patch) boundary points of the grid cell
+void appendPatch(QByteArray& data, int row, int column, bool tensor)
+{
+    const pdf::PDFReal step = 1.0 / MESH_SIZE;
+    const pdf::PDFReal x0 = column * step;
+    const pdf::PDFReal y0 = row * step;
+
+    auto getPoint = [&](int i, int j) { return distortPoint(QPointF(x0 + i * step / 3.0, y0 + j * step / 3.0)); };
+    auto appendPoint = [&](QPointF point) { appendCoordinate(data, point.x()); appendCoordinate(data, point.y()); };
+
+    // Flag: new patch without shared edges
+    data += char(0);
+
+    // Boundary points, in order p00, p01, p02, p03, p13, p23, p33, p32, p31, p30, p20, p10
+    static constexpr int boundary[12][2] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 3 }, { 2, 3 }, { 3, 3 }, { 3, 2 }, { 3, 1 }, { 3, 0 }, { 2, 0 }, { 1, 0 } };
+    for (const auto& index : boundary)
+    {
+        appendPoint(getPoint(index[0], index[1]));
+    }
+
+    if (tensor)
+    {
+        // Internal points, in order p11, p12, p22, p21
+        static constexpr int internal[4][2] = { { 1, 1 }, { 1, 2 }, { 2, 2 }, { 2, 1 } };
+        for (const auto& index : internal)
+        {
+            appendPoint(getPoint(index[0], index[1]));
+        }
+    }
+
+    // Corner colors c00, c03, c33, c30
+    appendColor(data, getPoint(0, 0));
+    appendColor(data, getPoint(0, 3));
+    appendColor(data, getPoint(3, 3));
+    appendColor(data, getPoint(3, 0));
+}
+
+}   // namespace
+
+std::vector<PDFBenchmarkCorpus::Document> PDFBenchmarkCorpus::createCorpus()
+{
+    std::vector<Document> corpus;
+    corpus.push_back({ "text", createTextDocument() });
+    corpus.push_back({ "vector", createVectorDocument() });
+    corpus.push_back({ "image", createImageDocument() });
+    corpus.push_back({ "shading", createShadingDocument() });
+    corpus.push_back({ "transparency", createTransparencyDocument() });
+    return corpus;
+}
+
+pdf::PDFDocument PDFBenchmarkCorpus::createTextDocument()
+{
+    static constexpr const char* words[] = { "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+                                             "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+                                             "magna", "aliqua", "enim", "ad", "minim", "veniam", "quis", "nostrud",
+                                             "exercitation", "ullamco", "laboris", "nisi", "aliquip", "ex", "ea", "commodo" };
+    static constexpr int wordCount = int(std::size(words));
+
+    pdf::PDFDocumentBuilder builder;
+    initializeBuilder(builder, "Benchmark - Text");
+
+    auto createFont = [](const char* baseFont)
+    {
+        return createDictionary({ { "Type", createName("Font") },
+                                  { "Subtype", createName("Type1") },
+                                  { "BaseFont", createName(baseFont) },
+                                  { "Encoding", createName("WinAnsiEncoding") } });
+    };
+
+    pdf::PDFObjectReference fontsReference = builder.addObject(createDictionary({ { "F0", createFont("Helvetica") },
+                                                                                  { "F1", createFont("Times-Roman") },
+                                                                                  { "F2", createFont("Courier") } }));
+
+    for (int pageIndex = 0; pageIndex < TEXT_PAGE_COUNT; ++pageIndex)
+    {
+        QRandomGenerator generator(SEED + pageIndex);
+
+        QByteArray content = "BT\n";
+        pdf::PDFReal y = PAGE_RECT.bottom() - 40.0;
+        for (int line = 0; line < TEXT_LINE_COUNT; ++line)
+        {
+            content += "/F" + QByteArray::number(generator.bounded(3)) + " " + QByteArray::number(7 + generator.bounded(3)) + " Tf\n";
+            content += "1 0 0 1 36 " + toByteArray(y) + " Tm\n";
+            content += getRandomColor(generator, false);
+
+            const bool isKerned = line % 2 == 1;
+            content += isKerned ? "[" : "(";
+            for (int i = 0; i < 16; ++i)
+            {
+                const char* word = words[generator.bounded(wordCount)];
+                if (isKerned)
+                {
+                    content += "(" + QByteArray(word) + " ) " + QByteArray::number(-generator.bounded(80)) + " ";
+                }
+                else
+                {
+                    content += QByteArray(word) + " ";
+                }
+            }
+            content += isKerned ? "] TJ\n" : ") Tj\n";
+
+            y -= 10.5;
+        }
+        content += "ET\n";
+
+        addPage(builder, content, createDictionary({ { "Font", createReference(fontsReference) } }));
+    }
+
+    return builder.build();
+}
+
+pdf::PDFDocument PDFBenchmarkCorpus::createVectorDocument()
+{
+    pdf::PDFDocumentBuilder builder;
+    initializeBuilder(builder, "Benchmark - Vector graphics");
+
+    const pdf::PDFReal width = PAGE_RECT.width();
+    const pdf::PDFReal height = PAGE_RECT.height();
+
+    for (int pageIndex = 0; pageIndex < VECTOR_PAGE_COUNT; ++pageIndex)
+    {
+        QRandomGenerator generator(SEED + 100 + pageIndex);
+
+        auto getPoint = [&]() { return toByteArray({ getRandom(generator, 0.0, width), getRandom(generator, 0.0, height) }); };
+
+        QByteArray content;
+        for (int i = 0; i < VECTOR_PATH_COUNT; ++i)
+        {
+            // Groups of paths are clipped
+            if (i % 500 == 0)
+            {
+                if (i > 0)
+                {
+                    content += "Q\n";
+                }
+
+                const pdf::PDFReal x = getRandom(generator, 0.0, width * 0.25);
+                const pdf::PDFReal y = getRandom(generator, 0.0, height * 0.25);
+                content += "q " + toByteArray({ x, y, width * 0.75, height * 0.75 }) + " re W n\n";
+            }
+
+            content += toByteArray(getRandom(generator, 0.1, 2.0)) + " w\n";
+
+            switch (generator.bounded(5))
+            {
+                case 0:
+                    content += getRandomColor(generator, true);
+                    content += getPoint() + " m " + getPoint() + " l S\n";
+                    break;
+
+                case 1:
+                {
+                    content += getRandomColor(generator, true);
+                    content += getPoint() + " m\n";
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        content += getPoint() + " " + getPoint() + " " + getPoint() + " c\n";
+                    }
+                    content += "S\n";
+                    break;
+                }
+
+                case 2:
+                {
+                    content += getRandomColor(generator, false);
+                    content += getPoint() + " m\n";
+                    const int pointCount = 4 + generator.bounded(5);
+                    for (int j = 0; j < pointCount; ++j)
+                    {
+                        content += getPoint() + " l\n";
+                    }
+                    content += (generator.bounded(2) == 0) ? "h f*\n" : "h f\n";
+                    break;
+                }
+
+                case 3:
+                {
+                    content += getRandomColor(generator, true);
+                    content += getRandomColor(generator, false);
+                    content += toByteArray({ getRandom(generator, 0.0, width), getRandom(generator, 0.0, height), getRandom(generator, 5.0, 80.0), getRandom(generator, 5.0, 80.0) }) + " re B\n";
+                    break;
+                }
+
+                default:
+                {
+                    content += getRandomColor(generator, true);
+                    content += "[" + toByteArray({ getRandom(generator, 1.0, 6.0), getRandom(generator, 1.0, 6.0) }) + "] 0 d\n";
+                    content += getPoint() + " m " + getPoint() + " " + getPoint() + " " + getPoint() + " c S\n";
+                    content += "[] 0 d\n";
+                    break;
+                }
+            }
+        }
+        content += "Q\n";
+
+        addPage(builder, content, createDictionary(Entries{ }));
+    }
+
+    return builder.build();
+}
+
+pdf::PDFDocument PDFBenchmarkCorpus::createImageDocument()
+{
+    pdf::PDFDocumentBuilder builder;
+    initializeBuilder(builder, "Benchmark - Images");
+
+    const QByteArray rgbData = createImageData(3, SEED + 200);
+    const QByteArray grayData = createImageData(1, SEED + 201);
+    const QByteArray cmykData = createImageData(4, SEED + 202);
+
+    auto addImagePage = [&](const char* colorSpace, Entries filterEntries, QByteArray encodedData)
+    {
+        pdf::PDFDictionary dictionary = createDictionaryContent(filterEntries);
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Type"), createName("XObject"));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Subtype"), createName("Image"));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Width"), pdf::PDFObject::createInteger(IMAGE_SIZE));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Height"), pdf::PDFObject::createInteger(IMAGE_SIZE));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("ColorSpace"), createName(colorSpace));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("BitsPerComponent"), pdf::PDFObject::createInteger(8));
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Length"), pdf::PDFObject::createInteger(encodedData.size()));
+        pdf::PDFObjectReference imageReference = builder.addObject(pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(encodedData))));
+
+        QByteArray content = "q 515 0 0 515 40 163 cm /Im0 Do Q\n";
+        addPage(builder, content, createDictionary({ { "XObject", createDictionary({ { "Im0", createReference(imageReference) } }) } }));
+    };
+
+    auto createPredictorParameters = [](int components)
+    {
+        return createDictionary({ { "Predictor", pdf::PDFObject::createInteger(12) },
+                                  { "Colors", pdf::PDFObject::createInteger(components) },
+                                  { "BitsPerComponent", pdf::PDFObject::createInteger(8) },
+                                  { "Columns", pdf::PDFObject::createInteger(IMAGE_SIZE) } });
+    };
+
+    addImagePage("DeviceRGB", { }, rgbData);
+    addImagePage("DeviceRGB", { { "Filter", createName("FlateDecode") } }, pdf::PDFFlateDecodeFilter::compress(rgbData));
+    addImagePage("DeviceRGB", { { "Filter", createName("FlateDecode") }, { "DecodeParms", createPredictorParameters(3) } }, pdf::PDFFlateDecodeFilter::compress(encodePngUpPredictor(rgbData, IMAGE_SIZE * 3)));
+    addImagePage("DeviceRGB", { { "Filter", createName("LZWDecode") } }, encodeLzw(rgbData));
+    addImagePage("DeviceRGB", { { "Filter", createName("RunLengthDecode") } }, encodeRunLength(rgbData));
+    addImagePage("DeviceRGB", { { "Filter", createName("ASCIIHexDecode") } }, encodeAsciiHex(rgbData));
+    addImagePage("DeviceRGB", { { "Filter", createArray({ createName("ASCII85Decode"), createName("FlateDecode") }) } }, encodeAscii85(pdf::PDFFlateDecodeFilter::compress(rgbData)));
+    addImagePage("DeviceRGB", { { "Filter", createName("DCTDecode") } }, encodeDct(rgbData, 3));
+    addImagePage("DeviceGray", { { "Filter", createName("DCTDecode") } }, encodeDct(grayData, 1));
+    addImagePage("DeviceCMYK", { { "Filter", createName("FlateDecode") } }, pdf::PDFFlateDecodeFilter::compress(cmykData));
+
+    return builder.build();
+}
+
+pdf::PDFDocument PDFBenchmarkCorpus::createShadingDocument()
+{
+    pdf::PDFDocumentBuilder builder;
+    initializeBuilder(builder, "Benchmark - Shadings");
+
+    auto createExponentialFunction = [](std::initializer_list<pdf::PDFReal> c0, std::initializer_list<pdf::PDFReal> c1)
+    {
+        return createDictionary({ { "FunctionType", pdf::PDFObject::createInteger(2) },
+                                  { "Domain", createNumbers({ 0.0, 1.0 }) },
+                                  { "C0", createNumbers(c0) },
+                                  { "C1", createNumbers(c1) },
+                                  { "N", pdf::PDFObject::createReal(1.0) } });
+    };
+
+    pdf::PDFObjectReference postScriptFunction = addStream(builder, { { "FunctionType", pdf::PDFObject::createInteger(4) },
+                                                                      { "Domain", createNumbers({ 0.0, 1.0, 0.0, 1.0 }) },
+                                                                      { "Range", createNumbers({ 0.0, 1.0, 0.0, 1.0, 0.0, 1.0 }) } },
+                                                           "{ 2 copy mul }");
+
+    pdf::PDFObject stitchingFunction = createDictionary({ { "FunctionType", pdf::PDFObject::createInteger(3) },
+                                                          { "Domain", createNumbers({ 0.0, 1.0 }) },
+                                                          { "Functions", createArray({ createExponentialFunction({ 1.0, 1.0, 0.0 }, { 1.0, 0.0, 0.0 }),
+                                                                                        createExponentialFunction({ 1.0, 0.0, 0.0 }, { 0.0, 0.0, 1.0 }) }) },
+                                                          { "Bounds", createNumbers({ 0.5 }) },
+                                                          { "Encode", createNumbers({ 0.0, 1.0, 0.0, 1.0 }) } });
+
+    const pdf::PDFObject meshDecode = createNumbers({ 0.0, 1.0, 0.0, 1.0, 0.0, 1.0, 0.0, 1.0, 0.0, 1.0 });
+    const pdf::PDFReal step = 1.0 / MESH_SIZE;
+
+    // Free-form triangle mesh
+    QByteArray triangleData;
+    auto appendVertex = [&triangleData](QPointF point)
+    {
+        triangleData += char(0);
+        appendCoordinate(triangleData, point.x());
+        appendCoordinate(triangleData, point.y());
+        appendColor(triangleData, point);
+    };
+    for (int row = 0; row < MESH_SIZE; ++row)
+    {
+        for (int column = 0; column < MESH_SIZE; ++column)
+        {
+            const QPointF p00 = distortPoint(QPointF(column * step, row * step));
+            const QPointF p10 = distortPoint(QPointF((column + 1) * step, row * step));
+            const QPointF p01 = distortPoint(QPointF(column * step, (row + 1) * step));
+            const QPointF p11 = distortPoint(QPointF((column + 1) * step, (row + 1) * step));
+            appendVertex(p00);
+            appendVertex(p10);
+            appendVertex(p11);
+            appendVertex(p00);
+            appendVertex(p11);
+            appendVertex(p01);
+        }
+    }
+
+    // Lattice-form triangle mesh
+    QByteArray latticeData;
+    for (int row = 0; row <= MESH_SIZE; ++row)
+    {
+        for (int column = 0; column <= MESH_SIZE; ++column)
+        {
+            const QPointF point = distortPoint(QPointF(column * step, row * step));
+            appendCoordinate(latticeData, point.x());
+            appendCoordinate(latticeData, point.y());
+            appendColor(latticeData, point);
+        }
+    }
+
+    // Coons patch mesh and tensor-product patch mesh
+    QByteArray coonsData;
+    QByteArray tensorData;
+    for (int row = 0; row < MESH_SIZE; ++row)
+    {
+        for (int column = 0; column < MESH_SIZE; ++column)
+        {
+            appendPatch(coonsData, row, column, false);
+            appendPatch(tensorData, row, column, true);
+        }
+    }
+
+    std::vector<pdf::PDFObjectReference> shadings;
+    shadings.push_back(builder.addObject(createDictionary({ { "ShadingType", pdf::PDFObject::createInteger(1) },
+                                                            { "ColorSpace", createName("DeviceRGB") },
+                                                            { "Domain", createNumbers({ 0.0, 1.0, 0.0, 1.0 }) },
+                                                            { "Function", createReference(postScriptFunction) } })));
+    shadings.push_back(builder.addObject(createDictionary({ { "ShadingType", pdf::PDFObject::createInteger(2) },
+                                                            { "ColorSpace", createName("DeviceRGB") },
+                                                            { "Coords", createNumbers({ 0.0, 0.0, 1.0, 1.0 }) },
+                                                            { "Function", stitchingFunction },
+                                                            { "Extend", createArray({ pdf::PDFObject::createBool(true), pdf::PDFObject::createBool(true) }) } })));
+    shadings.push_back(builder.addObject(createDictionary({ { "ShadingType", pdf::PDFObject::createInteger(3) },
+                                                            { "ColorSpace", createName("DeviceRGB") },
+                                                            { "Coords", createNumbers({ 0.3, 0.3, 0.05, 0.5, 0.5, 0.6 }) },
+                                                            { "Function", stitchingFunction },
+                                                            { "Extend", createArray({ pdf::PDFObject::createBool(true), pdf::PDFObject::createBool(true) }) } })));
+
+    pdf::PDFDictionary meshDictionary = createDictionaryContent({ { "ColorSpace", createName("DeviceRGB") },
+                                                                  { "BitsPerCoordinate", pdf::PDFObject::createInteger(16) },
+                                                                  { "BitsPerComponent", pdf::PDFObject::createInteger(8) },
+                                                                  { "Decode", meshDecode } });
+    auto addMesh = [&](int shadingType, QByteArray data, bool hasFlag)
+    {
+        pdf::PDFDictionary dictionary = meshDictionary;
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("ShadingType"), pdf::PDFObject::createInteger(shadingType));
+        if (hasFlag)
+        {
+            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("BitsPerFlag"), pdf::PDFObject::createInteger(8));
+        }
+        else
+        {
+            dictionary.addEntry(pdf::PDFInplaceOrMemoryString("VerticesPerRow"), pdf::PDFObject::createInteger(MESH_SIZE + 1));
+        }
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Filter"), createName("FlateDecode"));
+
+        QByteArray compressedData = pdf::PDFFlateDecodeFilter::compress(data);
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Length"), pdf::PDFObject::createInteger(compressedData.size()));
+        shadings.push_back(builder.addObject(pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), qMove(compressedData)))));
+    };
+    addMesh(4, triangleData, true);
+    addMesh(5, latticeData, false);
+    addMesh(6, coonsData, true);
+    addMesh(7, tensorData, true);
+
+    // Each shading is painted in grid of cells, each cell is clipped
+    for (const pdf::PDFObjectReference& shading : shadings)
+    {
+        QByteArray content;
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 3; ++column)
+            {
+                const pdf::PDFReal x = 40.0 + column * 175.0;
+                const pdf::PDFReal y = 60.0 + row * 250.0;
+                content += "q " + toByteArray({ x, y, 165.0, 240.0 }) + " re W n\n";
+                content += toByteArray({ 165.0, 0.0, 0.0, 240.0, x, y }) + " cm /Sh0 sh Q\n";
+            }
+        }
+
+        addPage(builder, content, createDictionary({ { "Shading", createDictionary({ { "Sh0", createReference(shading) } }) } }));
+    }
+
+    return builder.build();
+}
+
+pdf::PDFDocument PDFBenchmarkCorpus::createTransparencyDocument()
+{
+    pdf::PDFDocumentBuilder builder;
+    initializeBuilder(builder, "Benchmark - Transparency");
+
+    static constexpr const char* blendModes[] = { "Normal", "Multiply", "Screen", "Overlay", "Darken", "Lighten", "ColorDodge", "Difference", "Hue", "Luminosity" };
+    static constexpr int blendModeCount = int(std::size(blendModes));
+
+    // Circle approximated by bezier curves in the unit square
+    const QByteArray circle = "1 0.5 m 1 0.776 0.776 1 0.5 1 c 0.224 1 0 0.776 0 0.5 c 0 0.224 0.224 0 0.5 0 c 0.776 0 1 0.224 1 0.5 c h f\n";
+
+    auto createGroup = [](bool isolated, bool knockout)
+    {
+        return createDictionary({ { "S", createName("Transparency") },
+                                  { "CS", createName("DeviceRGB") },
+                                  { "I", pdf::PDFObject::createBool(isolated) },
+                                  { "K", pdf::PDFObject::createBool(knockout) } });
+    };
+
+    // Form with three overlapping semi-transparent circles
+    QByteArray formContent;
+    formContent += "/GSHalf gs 1 0 0 rg q 0.6 0 0 0.6 0 0.4 cm " + circle + "Q\n";
+    formContent += "0 1 0 rg q 0.6 0 0 0.6 0.4 0.4 cm " + circle + "Q\n";
+    formContent += "0 0 1 rg q 0.6 0 0 0.6 0.2 0 cm " + circle + "Q\n";
+    pdf::PDFObject formResources = createDictionary({ { "ExtGState", createDictionary({ { "GSHalf", createDictionary({ { "ca", pdf::PDFObject::createReal(0.6) } }) } }) } });
+
+    std::vector<pdf::PDFObjectReference> forms;
+    for (int i = 0; i < 4; ++i)
+    {
+        forms.push_back(addStream(builder, { { "Type", createName("XObject") },
+                                             { "Subtype", createName("Form") },
+                                             { "BBox", createNumbers({ 0.0, 0.0, 1.0, 1.0 }) },
+                                             { "Group", createGroup(i % 2 == 0, i >= 2) },
+                                             { "Resources", formResources } },
+                                  formContent));
+    }
+
+    // Soft mask - luminosity of the axial gradient
+    pdf::PDFObject maskShading = createDictionary({ { "ShadingType", pdf::PDFObject::createInteger(2) },
+                                                    { "ColorSpace", createName("DeviceGray") },
+                                                    { "Coords", createNumbers({ 0.0, 0.0, 1.0, 0.0 }) },
+                                                    { "Function", createDictionary({ { "FunctionType", pdf::PDFObject::createInteger(2) },
+                                                                                     { "Domain", createNumbers({ 0.0, 1.0 }) },
+                                                                                     { "C0", createNumbers({ 0.0 }) },
+                                                                                     { "C1", createNumbers({ 1.0 }) },
+                                                                                     { "N", pdf::PDFObject::createReal(1.0) } }) } });
+    pdf::PDFObjectReference maskForm = addStream(builder, { { "Type", createName("XObject") },
+                                                            { "Subtype", createName("Form") },
+                                                            { "BBox", createNumbers({ 0.0, 0.0, 1.0, 1.0 }) },
+                                                            { "Group", createGroup(true, false) },
+                                                            { "Resources", createDictionary({ { "Shading", createDictionary({ { "Sh0", maskShading } }) } }) } },
+                                                 "/Sh0 sh\n");
+
+    std::map<QByteArray, pdf::PDFObject> graphicStates;
+    for (int i = 0; i < blendModeCount; ++i)
+    {
+        graphicStates["GS" + QByteArray::number(i)] = createDictionary({ { "BM", createName(blendModes[i]) },
+                                                                          { "ca", pdf::PDFObject::createReal(0.4 + 0.05 * i) },
+                                                                          { "CA", pdf::PDFObject::createReal(0.8) } });
+    }
+    graphicStates["GSMask"] = createDictionary({ { "SMask", createDictionary({ { "Type", createName("Mask") },
+                                                                               { "S", createName("Luminosity") },
+                                                                               { "G", createReference(maskForm) } }) } });
+
+    std::map<QByteArray, pdf::PDFObject> xobjects;
+    for (size_t i = 0; i < forms.size(); ++i)
+    {
+        xobjects["Fm" + QByteArray::number(qint64(i))] = createReference(forms[i]);
+    }
+
+    pdf::PDFObjectReference resourcesReference = builder.addObject(createDictionary({ { "ExtGState", createDictionaryFromMap(graphicStates) },
+                                                                                      { "XObject", createDictionaryFromMap(xobjects) } }));
+
+    for (int pageIndex = 0; pageIndex < TRANSPARENCY_PAGE_COUNT; ++pageIndex)
+    {
+        QRandomGenerator generator(SEED + 300 + pageIndex);
+
+        QByteArray content;
+        for (int i = 0; i < TRANSPARENCY_OBJECT_COUNT; ++i)
+        {
+            const pdf::PDFReal size = getRandom(generator, 60.0, 220.0);
+            const pdf::PDFReal x = getRandom(generator, 0.0, PAGE_RECT.width() - size);
+            const pdf::PDFReal y = getRandom(generator, 0.0, PAGE_RECT.height() - size);
+
+            content += "q /GS" + QByteArray::number(generator.bounded(blendModeCount)) + " gs\n";
+            if (i % 8 == 0)
+            {
+                // Jakub Melka: Soft mask is defined in the form space, so we must set
+                // the transformation before the soft mask is set.
+                content += toByteArray({ size, 0.0, 0.0, size, x, y }) + " cm /GSMask gs\n";
+            }
+            else
+            {
+                content += toByteArray({ size, 0.0, 0.0, size, x, y }) + " cm\n";
+            }
+            content += "/Fm" + QByteArray::number(generator.bounded(int(forms.size()))) + " Do Q\n";
+        }
+
+        addPage(builder, content, createReference(resourcesReference));
+    }
+
+    return builder.build();
+}
+
+}   // namespace pdfbenchmark
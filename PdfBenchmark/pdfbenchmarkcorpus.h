@@ -0,0 +1,64 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFBENCHMARKCORPUS_H
+#define PDFBENCHMARKCORPUS_H
+
+#include "pdfdocument.h"
+
+#include <vector>
+
+namespace pdfbenchmark
+{
+
+/// Generates corpus of synthetic documents used to benchmark rendering. Documents
+/// are generated deterministically (pseudo-random generators use fixed seeds),
+/// so results of different builds are comparable. Each document stresses one
+/// part of the renderer (text, vector graphics, images, shadings, transparency).
+class PDFBenchmarkCorpus
+{
+public:
+    explicit PDFBenchmarkCorpus() = delete;
+
+    struct Document
+    {
+        QString name;
+        pdf::PDFDocument document;
+    };
+
+    /// Creates all documents of the corpus
+    static std::vector<Document> createCorpus();
+
+    /// Pages with heavy text (standard fonts, Tj and TJ operators)
+    static pdf::PDFDocument createTextDocument();
+
+    /// Pages with dense vector graphics (strokes, fills, dashes, clipping)
+    static pdf::PDFDocument createVectorDocument();
+
+    /// Pages with large images, one page per image filter
+    static pdf::PDFDocument createImageDocument();
+
+    /// Pages with shadings, one page per shading type (all 7 types)
+    static pdf::PDFDocument createShadingDocument();
+
+    /// Pages with transparency groups, blend modes and soft masks
+    static pdf::PDFDocument createTransparencyDocument();
+};
+
+}   // namespace pdfbenchmark
+
+#endif // PDFBENCHMARKCORPUS_H
@@ -0,0 +1,274 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdfbenchmarkrunner.h"
+#include "pdfrenderer.h"
+#include "pdffont.h"
+#include "pdfcms.h"
+#include "pdfimage.h"
+#include "pdfconstants.h"
+#include "pdfoptionalcontent.h"
+
+#include <QThread>
+#include <QJsonArray>
+#include <QTextStream>
+#include <QElapsedTimer>
+
+#include <map>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+
+namespace pdfbenchmark
+{
+
+PDFBenchmarkRunner::PDFBenchmarkRunner(Settings settings) :
+    m_settings(qMove(settings))
+{
+
+}
+
+PDFBenchmarkResults PDFBenchmarkRunner::run(const std::vector<PDFBenchmarkCorpus::Document>& corpus) const
+{
+    PDFBenchmarkResults results;
+    QTextStream stream(stdout);
+
+    for (const PDFBenchmarkCorpus::Document& document : corpus)
+    {
+        for (pdf::RendererEngine engine : m_settings.engines)
+        {
+            for (pdf::PDFExecutionPolicy::Strategy strategy : m_settings.strategies)
+            {
+                PDFBenchmarkResult result = runDocument(document, engine, strategy);
+                stream << QString("%1 %2 pages/sec (%3 pages, %4 msec, %5 errors)").arg(result.getKey(), -40).arg(result.getPagesPerSecond(), 10, 'f', 2).arg(result.pageCount).arg(result.time / 1000000).arg(result.errorCount) << Qt::endl;
+                results.push_back(qMove(result));
+            }
+        }
+    }
+
+    return results;
+}
+
+PDFBenchmarkResult PDFBenchmarkRunner::runDocument(const PDFBenchmarkCorpus::Document& document,
+                                                   pdf::RendererEngine engine,
+                                                   pdf::PDFExecutionPolicy::Strategy strategy) const
+{
+    PDFBenchmarkResult result;
+    result.document = document.name;
+    result.engine = getEngineName(engine);
+    result.strategy = getStrategyName(strategy);
+
+    // We can const-cast here, because we do not modify the document,
+    // it is just rendered to the images.
+    pdf::PDFDocument* pdfDocument = const_cast<pdf::PDFDocument*>(&document.document);
+
+    pdf::PDFExecutionPolicy::setStrategy(strategy);
+
+    pdf::PDFOptionalContentActivity optionalContentActivity(pdfDocument, pdf::OCUsage::View, nullptr);
+    pdf::PDFMeshQualitySettings meshQualitySettings;
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    pdf::PDFModifiedDocument modifiedDocument(pdfDocument, &optionalContentActivity);
+    fontCache.setDocument(modifiedDocument);
+    fontCache.setCacheShrinkEnabled(nullptr, false);
+
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(pdfDocument);
+
+    pdf::PDFRasterizerPool rasterizerPool(pdfDocument, &fontCache, &cmsManager, &optionalContentActivity,
+                                          pdf::PDFRenderer::getDefaultFeatures(), meshQualitySettings,
+                                          pdf::PDFRasterizerPool::getDefaultRasterizerCount(), engine, nullptr);
+
+    std::atomic<int> errorCount = 0;
+    auto onRenderError = [&errorCount](pdf::PDFInteger pageIndex, pdf::PDFRenderError error)
+    {
+        if (pageIndex != pdf::PDFCatalog::INVALID_PAGE_INDEX && error.type == pdf::RenderErrorType::Error)
+        {
+            ++errorCount;
+        }
+    };
+    QObject holder;
+    QObject::connect(&rasterizerPool, &pdf::PDFRasterizerPool::renderError, &holder, onRenderError, Qt::DirectConnection);
+
+    const double dpi = m_settings.dpi;
+    auto imageSizeGetter = [dpi](const pdf::PDFPage* page) -> QSize
+    {
+        Q_ASSERT(page);
+        QSizeF size = page->getRotatedMediaBox().size() * pdf::PDF_POINT_TO_INCH * dpi;
+        return size.toSize();
+    };
+    auto processImage = [](pdf::PDFRenderedPageImage& renderedPageImage) { Q_UNUSED(renderedPageImage); };
+
+    std::vector<pdf::PDFInteger> pageIndices(pdfDocument->getCatalog()->getPageCount(), 0);
+    std::iota(pageIndices.begin(), pageIndices.end(), 0);
+    result.pageCount = int(pageIndices.size());
+
+    std::vector<qint64> times;
+    const int totalRepetitions = m_settings.warmupRepetitions + qMax(m_settings.repetitions, 1);
+    for (int repetition = 0; repetition < totalRepetitions; ++repetition)
+    {
+        // Jakub Melka: Decoded images are shared between renderings, we clear them,
+        // so image decoding is measured in each repetition. Fonts stay cached
+        // in the font cache (after warm-up repetition), as they are in the viewer.
+        pdf::PDFImageCache::getInstance()->clear();
+        errorCount = 0;
+
+        QElapsedTimer timer;
+        timer.start();
+        rasterizerPool.render(pageIndices, imageSizeGetter, processImage, nullptr);
+        const qint64 time = timer.nsecsElapsed();
+
+        if (repetition >= m_settings.warmupRepetitions)
+        {
+            times.push_back(time);
+        }
+    }
+
+    pdf::PDFImageCache::getInstance()->clear();
+    fontCache.setCacheShrinkEnabled(nullptr, true);
+
+    std::sort(times.begin(), times.end());
+    result.time = times[times.size() / 2];
+    result.minimalTime = times.front();
+    result.errorCount = errorCount;
+    return result;
+}
+
+std::vector<PDFBenchmarkRunner::Comparison> PDFBenchmarkRunner::compare(const PDFBenchmarkResults& results, const PDFBenchmarkResults& baseline, double threshold)
+{
+    std::map<QString, const PDFBenchmarkResult*> baselineResults;
+    for (const PDFBenchmarkResult& result : baseline)
+    {
+        baselineResults[result.getKey()] = &result;
+    }
+
+    std::vector<Comparison> comparisons;
+    for (const PDFBenchmarkResult& result : results)
+    {
+        auto it = baselineResults.find(result.getKey());
+        if (it == baselineResults.cend() || it->second->pageCount != result.pageCount)
+        {
+            // Configuration is not in the baseline, or corpus was changed
+            continue;
+        }
+
+        Comparison comparison;
+        comparison.key = result.getKey();
+        comparison.baselinePagesPerSecond = it->second->getPagesPerSecond();
+        comparison.pagesPerSecond = result.getPagesPerSecond();
+
+        if (comparison.baselinePagesPerSecond > 0.0)
+        {
+            comparison.change = 100.0 * (comparison.pagesPerSecond - comparison.baselinePagesPerSecond) / comparison.baselinePagesPerSecond;
+        }
+
+        comparison.isRegression = comparison.change < -threshold;
+        comparisons.push_back(qMove(comparison));
+    }
+
+    return comparisons;
+}
+
+QJsonObject PDFBenchmarkRunner::toJson(const PDFBenchmarkResults& results) const
+{
+    QJsonArray resultsArray;
+    for (const PDFBenchmarkResult& result : results)
+    {
+        QJsonObject resultObject;
+        resultObject["document"] = result.document;
+        resultObject["engine"] = result.engine;
+        resultObject["strategy"] = result.strategy;
+        resultObject["pages"] = result.pageCount;
+        resultObject["errors"] = result.errorCount;
+        resultObject["time-ns"] = double(result.time);
+        resultObject["minimal-time-ns"] = double(result.minimalTime);
+        resultObject["pages-per-second"] = result.getPagesPerSecond();
+        resultsArray.append(resultObject);
+    }
+
+    QJsonObject settingsObject;
+    settingsObject["dpi"] = m_settings.dpi;
+    settingsObject["repetitions"] = m_settings.repetitions;
+    settingsObject["warmup-repetitions"] = m_settings.warmupRepetitions;
+    settingsObject["threads"] = QThread::idealThreadCount();
+
+    QJsonObject object;
+    object["version"] = QString(pdf::PDF_LIBRARY_VERSION);
+    object["settings"] = settingsObject;
+    object["results"] = resultsArray;
+    return object;
+}
+
+PDFBenchmarkResults PDFBenchmarkRunner::fromJson(const QJsonObject& object)
+{
+    PDFBenchmarkResults results;
+
+    const QJsonArray resultsArray = object["results"].toArray();
+    for (const QJsonValue& value : resultsArray)
+    {
+        const QJsonObject resultObject = value.toObject();
+
+        PDFBenchmarkResult result;
+        result.document = resultObject["document"].toString();
+        result.engine = resultObject["engine"].toString();
+        result.strategy = resultObject["strategy"].toString();
+        result.pageCount = resultObject["pages"].toInt();
+        result.errorCount = resultObject["errors"].toInt();
+        result.time = qint64(resultObject["time-ns"].toDouble());
+        result.minimalTime = qint64(resultObject["minimal-time-ns"].toDouble());
+        results.push_back(qMove(result));
+    }
+
+    return results;
+}
+
+QString PDFBenchmarkRunner::getEngineName(pdf::RendererEngine engine)
+{
+    switch (engine)
+    {
+        case pdf::RendererEngine::Blend2D_MultiThread:
+            return "blend2d-mt";
+
+        case pdf::RendererEngine::Blend2D_SingleThread:
+            return "blend2d-st";
+
+        case pdf::RendererEngine::QPainter:
+            return "qpainter";
+    }
+
+    Q_ASSERT(false);
+    return QString();
+}
+
+QString PDFBenchmarkRunner::getStrategyName(pdf::PDFExecutionPolicy::Strategy strategy)
+{
+    switch (strategy)
+    {
+        case pdf::PDFExecutionPolicy::Strategy::SingleThreaded:
+            return "single";
+
+        case pdf::PDFExecutionPolicy::Strategy::PageMultithreaded:
+            return "page";
+
+        case pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded:
+            return "always";
+    }
+
+    Q_ASSERT(false);
+    return QString();
+}
+
+}   // namespace pdfbenchmark
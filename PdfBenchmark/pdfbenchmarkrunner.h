@@ -0,0 +1,111 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFBENCHMARKRUNNER_H
+#define PDFBENCHMARKRUNNER_H
+
+#include "pdfbenchmarkcorpus.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QJsonObject>
+
+#include <vector>
+
+namespace pdfbenchmark
+{
+
+/// Result of the benchmark of one document, using one renderer engine
+/// and one multithreading strategy.
+struct PDFBenchmarkResult
+{
+    QString document;
+    QString engine;
+    QString strategy;
+    int pageCount = 0;
+    int errorCount = 0;
+    qint64 time = 0;                    ///< Median time of the repetitions [nsec]
+    qint64 minimalTime = 0;             ///< Minimal time of the repetitions [nsec]
+
+    /// Returns key, which identifies the measured configuration
+    QString getKey() const { return QString("%1/%2/%3").arg(document, engine, strategy); }
+
+    /// Returns rendering throughput (pages per second)
+    double getPagesPerSecond() const { return time > 0 ? double(pageCount) * 1.0e9 / double(time) : 0.0; }
+};
+
+using PDFBenchmarkResults = std::vector<PDFBenchmarkResult>;
+
+/// Renders documents of the benchmark corpus using all combinations of renderer
+/// engines and multithreading strategies and measures throughput. Results can be
+/// stored in JSON format and compared to results of another build (baseline).
+class PDFBenchmarkRunner
+{
+public:
+    struct Settings
+    {
+        int repetitions = 3;            ///< Count of measured repetitions (median is used)
+        int warmupRepetitions = 1;      ///< Count of repetitions, which are not measured
+        double dpi = 150.0;             ///< Resolution of the rendered page images
+        std::vector<pdf::RendererEngine> engines = { pdf::RendererEngine::Blend2D_MultiThread, pdf::RendererEngine::Blend2D_SingleThread, pdf::RendererEngine::QPainter };
+        std::vector<pdf::PDFExecutionPolicy::Strategy> strategies = { pdf::PDFExecutionPolicy::Strategy::SingleThreaded, pdf::PDFExecutionPolicy::Strategy::PageMultithreaded, pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded };
+    };
+
+    /// Result of comparison of one configuration with the baseline
+    struct Comparison
+    {
+        QString key;
+        double baselinePagesPerSecond = 0.0;
+        double pagesPerSecond = 0.0;
+        double change = 0.0;            ///< Relative change of the throughput [%], negative values mean slowdown
+        bool isRegression = false;
+    };
+
+    explicit PDFBenchmarkRunner(Settings settings);
+
+    /// Runs the benchmark of the documents. Progress is written to the standard output.
+    /// \param corpus Documents
+    PDFBenchmarkResults run(const std::vector<PDFBenchmarkCorpus::Document>& corpus) const;
+
+    /// Compares results with the baseline results. Configuration is a regression, if its
+    /// throughput is lower than baseline throughput by more than \p threshold percent.
+    /// Configurations, which are not in the baseline, are skipped.
+    /// \param results Results
+    /// \param baseline Baseline results
+    /// \param threshold Threshold [%]
+    static std::vector<Comparison> compare(const PDFBenchmarkResults& results, const PDFBenchmarkResults& baseline, double threshold);
+
+    /// Converts results to JSON object
+    QJsonObject toJson(const PDFBenchmarkResults& results) const;
+
+    /// Reads results from JSON object
+    static PDFBenchmarkResults fromJson(const QJsonObject& object);
+
+    static QString getEngineName(pdf::RendererEngine engine);
+    static QString getStrategyName(pdf::PDFExecutionPolicy::Strategy strategy);
+
+private:
+    /// Renders all pages of the document and returns the result
+    PDFBenchmarkResult runDocument(const PDFBenchmarkCorpus::Document& document,
+                                   pdf::RendererEngine engine,
+                                   pdf::PDFExecutionPolicy::Strategy strategy) const;
+
+    Settings m_settings;
+};
+
+}   // namespace pdfbenchmark
+
+#endif // PDFBENCHMARKRUNNER_H
@@ -17,8 +17,10 @@
 
 #include "pdftoolabstractapplication.h"
 #include "pdfconstants.h"
+#include "pdftrace.h"
 
 #include <QGuiApplication>
+#include <QTextStream>
 #include <QCommandLineParser>
 
 int main(int argc, char *argv[])
@@ -51,9 +53,33 @@ int main(int argc, char *argv[])
 
     application->initializeCommandLineParser(&parser);
 
+    QCommandLineOption traceOption("trace", "Write performance trace to the file in Chrome trace event format (can be opened in Perfetto UI).", "file");
+    parser.addOption(traceOption);
+
     parser.addHelpOption();
     parser.addVersionOption();
     parser.process(arguments);
 
-    return application->execute(application->getOptions(&parser));
+    const bool isTraceEnabled = parser.isSet(traceOption);
+    if (isTraceEnabled)
+    {
+        pdf::PDFTracer::getInstance()->start();
+    }
+
+    const pdftool::PDFToolOptions options = application->getOptions(&parser);
+    pdftool::PDFToolAbstractApplication::initializeExecutionPolicy(options);
+
+    const int result = application->execute(options);
+
+    if (isTraceEnabled)
+    {
+        pdf::PDFTracer::getInstance()->stop();
+        pdf::PDFOperationResult traceResult = pdf::PDFTracer::getInstance()->writeChromeTrace(parser.value(traceOption));
+        if (!traceResult)
+        {
+            QTextStream(stderr) << traceResult.getErrorMessage() << Qt::endl;
+        }
+    }
+
+    return result;
 }
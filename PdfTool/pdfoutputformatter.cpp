@@ -20,6 +20,9 @@
 #include <QMutex>
 #include <QTextStream>
 #include <QXmlStreamWriter>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
 #include <QCoreApplication>
 #include <QDataStream>
 #include <QStringEncoder>
@@ -57,6 +60,10 @@ public:
     /// Get result string in unicode.
     virtual QString getString() const = 0;
 
+    /// Returns string written since last call of this function and removes
+    /// it from the output, so the output can be written in parts.
+    virtual QString takeString() = 0;
+
     /// Ends current line (for formatters, that support it)
     virtual void endl() { }
 };
@@ -69,6 +76,7 @@ public:
     virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
     virtual void endElement() override;
     virtual QString getString() const override;
+    virtual QString takeString() override;
     virtual void endl() override;
 
 private:
@@ -99,6 +107,7 @@ public:
     virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
     virtual void endElement() override;
     virtual QString getString() const override;
+    virtual QString takeString() override;
 
 private:
     QString m_string;
@@ -117,6 +126,7 @@ public:
     virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
     virtual void endElement() override;
     virtual QString getString() const override;
+    virtual QString takeString() override;
     virtual void endl() override;
 
 private:
@@ -124,9 +134,41 @@ private:
     QXmlStreamWriter m_streamWriter;
     int m_depth;
     int m_headerDepth;
+    bool m_isDocumentTypeWritten = false;
     std::stack<PDFOutputFormatter::Element> m_elementStack;
 };
 
+/// Writes the structure tree as JSON document, so it can be easily processed
+/// by scripts (for example, in continuous integration). Each element is an object
+/// with "type" and "name", child elements are in the "items" array, columns
+/// of the table row are in the "columns" object (column name is the key).
+class PDFJsonOutputFormatterImpl : public PDFOutputFormatterImpl
+{
+public:
+    PDFJsonOutputFormatterImpl() = default;
+
+    virtual void beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference) override;
+    virtual void endElement() override;
+    virtual QString getString() const override;
+    virtual QString takeString() override;
+
+private:
+    struct JsonElement
+    {
+        PDFOutputFormatter::Element type = PDFOutputFormatter::Element::Root;
+        QString name;
+        QString description;
+        QJsonObject object;
+        QJsonArray items;
+        QJsonObject columns;
+    };
+
+    static QString getTypeName(PDFOutputFormatter::Element type);
+
+    std::stack<JsonElement> m_elementStack;
+    QJsonObject m_root;
+};
+
 PDFTextOutputFormatterImpl::PDFTextOutputFormatterImpl() :
     m_string(),
     m_streamWriter(&m_string, QIODevice::WriteOnly),
@@ -285,6 +327,14 @@ QString PDFTextOutputFormatterImpl::getString() const
     return m_string;
 }
 
+QString PDFTextOutputFormatterImpl::takeString()
+{
+    m_streamWriter.flush();
+    QString string = qMove(m_string);
+    m_string.clear();
+    return string;
+}
+
 void PDFTextOutputFormatterImpl::endl()
 {
     m_streamWriter << Qt::endl;
@@ -480,6 +530,22 @@ QString PDFHtmlOutputFormatterImpl::getString() const
     return html;
 }
 
+QString PDFHtmlOutputFormatterImpl::takeString()
+{
+    QString html = qMove(m_string);
+    m_string.clear();
+
+    // Xml declaration is replaced by document type in the first part of the output
+    if (!m_isDocumentTypeWritten && html.contains("?>"))
+    {
+        html.remove(0, html.indexOf("?>") + 2);
+        html.prepend("<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\" \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">");
+        m_isDocumentTypeWritten = true;
+    }
+
+    return html;
+}
+
 void PDFHtmlOutputFormatterImpl::endl()
 {
     m_streamWriter.writeStartElement("br");
@@ -588,6 +654,136 @@ QString PDFXmlOutputFormatterImpl::getString() const
     return m_string;
 }
 
+QString PDFXmlOutputFormatterImpl::takeString()
+{
+    QString string = qMove(m_string);
+    m_string.clear();
+    return string;
+}
+
+void PDFJsonOutputFormatterImpl::beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference)
+{
+    Q_UNUSED(alignment);
+
+    JsonElement element;
+    element.type = type;
+    element.name = name;
+    element.description = description;
+    element.object["type"] = getTypeName(type);
+    element.object["name"] = name;
+
+    switch (type)
+    {
+        case PDFOutputFormatter::Element::Root:
+        {
+            element.object["generator"] = QString("%1 %2").arg(QCoreApplication::applicationName(), QCoreApplication::applicationVersion());
+            element.object["description"] = description;
+            break;
+        }
+
+        case PDFOutputFormatter::Element::Text:
+        {
+            element.object["text"] = description;
+            break;
+        }
+
+        default:
+        {
+            if (!description.isEmpty())
+            {
+                element.object["description"] = description;
+            }
+            break;
+        }
+    }
+
+    if (reference > 0)
+    {
+        element.object["ref"] = reference;
+    }
+
+    m_elementStack.push(qMove(element));
+}
+
+void PDFJsonOutputFormatterImpl::endElement()
+{
+    JsonElement element = qMove(m_elementStack.top());
+    m_elementStack.pop();
+
+    if (!element.items.isEmpty())
+    {
+        element.object["items"] = element.items;
+    }
+
+    if (!element.columns.isEmpty())
+    {
+        element.object["columns"] = element.columns;
+    }
+
+    if (m_elementStack.empty())
+    {
+        m_root = qMove(element.object);
+        return;
+    }
+
+    JsonElement& parent = m_elementStack.top();
+    switch (element.type)
+    {
+        case PDFOutputFormatter::Element::TableColumn:
+        case PDFOutputFormatter::Element::TableHeaderColumn:
+            parent.columns[element.name] = element.description;
+            break;
+
+        default:
+            parent.items.append(element.object);
+            break;
+    }
+}
+
+QString PDFJsonOutputFormatterImpl::getString() const
+{
+    return QString::fromUtf8(QJsonDocument(m_root).toJson(QJsonDocument::Indented));
+}
+
+QString PDFJsonOutputFormatterImpl::takeString()
+{
+    // Json document is a single object, so it can be written only when it is finished
+    if (!m_elementStack.empty() || m_root.isEmpty())
+    {
+        return QString();
+    }
+
+    QString string = getString();
+    m_root = QJsonObject();
+    return string;
+}
+
+QString PDFJsonOutputFormatterImpl::getTypeName(PDFOutputFormatter::Element type)
+{
+    switch (type)
+    {
+        case PDFOutputFormatter::Element::Root:
+            return "document";
+        case PDFOutputFormatter::Element::Header:
+            return "header";
+        case PDFOutputFormatter::Element::Text:
+            return "text";
+        case PDFOutputFormatter::Element::Table:
+            return "table";
+        case PDFOutputFormatter::Element::TableHeaderRow:
+            return "table-header-row";
+        case PDFOutputFormatter::Element::TableHeaderColumn:
+            return "table-header-column";
+        case PDFOutputFormatter::Element::TableRow:
+            return "table-row";
+        case PDFOutputFormatter::Element::TableColumn:
+            return "table-column";
+    }
+
+    Q_ASSERT(false);
+    return QString();
+}
+
 PDFOutputFormatter::PDFOutputFormatter(Style style) :
     m_impl(nullptr)
 {
@@ -604,6 +800,10 @@ PDFOutputFormatter::PDFOutputFormatter(Style style) :
         case Style::Html:
             m_impl = new PDFHtmlOutputFormatterImpl();
             break;
+
+        case Style::Json:
+            m_impl = new PDFJsonOutputFormatterImpl();
+            break;
     }
 
     Q_ASSERT(m_impl);
@@ -617,11 +817,23 @@ PDFOutputFormatter::~PDFOutputFormatter()
 void PDFOutputFormatter::beginElement(PDFOutputFormatter::Element type, QString name, QString description, Qt::Alignment alignment, int reference)
 {
     m_impl->beginElement(type, name, description, alignment, reference);
+    ++m_depth;
 }
 
 void PDFOutputFormatter::endElement()
 {
     m_impl->endElement();
+    --m_depth;
+
+    if (m_isStreamingMode)
+    {
+        m_buffer += m_impl->takeString();
+
+        if (m_depth == 0 || m_buffer.size() >= STREAMING_BUFFER_SIZE)
+        {
+            flush();
+        }
+    }
 }
 
 void PDFOutputFormatter::endl()
@@ -631,9 +843,37 @@ void PDFOutputFormatter::endl()
 
 QString PDFOutputFormatter::getString() const
 {
+    if (m_isStreamingMode)
+    {
+        return QString();
+    }
+
     return m_impl->getString();
 }
 
+void PDFOutputFormatter::setStreamingMode(QStringConverter::Encoding encoding)
+{
+    Q_ASSERT(m_depth == 0);
+
+    m_isStreamingMode = true;
+    m_encoding = encoding;
+}
+
+void PDFOutputFormatter::flush()
+{
+    if (!m_isStreamingMode)
+    {
+        return;
+    }
+
+    m_buffer += m_impl->takeString();
+    if (!m_buffer.isEmpty())
+    {
+        PDFConsole::writeText(qMove(m_buffer), m_encoding);
+        m_buffer.clear();
+    }
+}
+
 void PDFConsole::writeText(QString text, QStringConverter::Encoding encoding)
 {
 #ifdef Q_OS_WIN
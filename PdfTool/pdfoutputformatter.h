@@ -35,7 +35,8 @@ public:
     {
         Text,
         Xml,
-        Html
+        Html,
+        Json
     };
 
     explicit PDFOutputFormatter(Style style);
@@ -86,11 +87,32 @@ public:
     /// Ends current line
     void endl();
 
-    /// Get result string in unicode.
+    /// Get result string in unicode. In streaming mode, output is written
+    /// to the console by the formatter and empty string is returned.
     QString getString() const;
 
+    /// Turns on streaming mode (must be called before the document is started).
+    /// In streaming mode, output is written to the console in parts, when
+    /// elements are closed, so whole output is not held in the memory. Json
+    /// output is an exception, it is written at once, when document is finished.
+    /// \param encoding Encoding of the console output
+    void setStreamingMode(QStringConverter::Encoding encoding);
+
+    /// Returns true, if streaming mode is turned on
+    bool isStreamingMode() const { return m_isStreamingMode; }
+
+    /// Writes pending output to the console (in streaming mode only)
+    void flush();
+
 private:
+    /// Minimal size of the pending output (in characters) written to the console
+    static constexpr const qsizetype STREAMING_BUFFER_SIZE = 64 * 1024;
+
     PDFOutputFormatterImpl* m_impl;
+    bool m_isStreamingMode = false;
+    QStringConverter::Encoding m_encoding = QStringConverter::Utf8;
+    int m_depth = 0;
+    QString m_buffer;
 };
 
 class PDFConsole
@@ -18,6 +18,7 @@
 #include "pdftoolabstractapplication.h"
 #include "pdfdocumentreader.h"
 #include "pdfutils.h"
+#include "pdfexecutionpolicy.h"
 
 #include <QFileInfo>
 #include <QCommandLineParser>
@@ -149,7 +150,7 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
 
     if (optionFlags.testFlag(ConsoleFormat))
     {
-        parser->addOption(QCommandLineOption("console-format", "Console output text format (valid values: text|xml|html).", "format", "text"));
+        parser->addOption(QCommandLineOption("console-format", "Console output text format (valid values: text|xml|html|json).", "format", "text"));
         parser->addOption(QCommandLineOption("text-codec", QString("Text codec used when writing text output to redirected standard output. UTF-8 is default."), "text codec", "UTF-8"));
     }
 
@@ -168,6 +169,7 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
     if (optionFlags.testFlag(Separate))
     {
         parser->addPositionalArgument("pattern", "Page pattern, must contain '%' character if multiple pages are selected.");
+        parser->addOption(QCommandLineOption("fast", "Write pages in parallel, objects shared by pages are serialized only once and keep their object numbers. Only pages are copied, document objects (outline, forms, names, optional content) are not copied."));
     }
 
     if (optionFlags.testFlag(Unite))
@@ -176,10 +178,17 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addPositionalArgument("target", "Merged document filename.");
     }
 
+    if (optionFlags.testFlag(Separate) || optionFlags.testFlag(Unite))
+    {
+        parser->addOption(QCommandLineOption("streaming", "Write objects directly to the target file and load documents lazily, so memory consumption is bounded. Only pages and optional content are copied, other document objects (outline, forms, names) are not merged."));
+    }
+
     if (optionFlags.testFlag(Diff))
     {
         parser->addPositionalArgument("left", "Left (old) document to be compared.");
         parser->addPositionalArgument("right", "Right (new) document to be compared.");
+        parser->addOption(QCommandLineOption("diff-raster", "Compare graphics of modified pages using rendered page images (pixel by pixel)."));
+        parser->addOption(QCommandLineOption("diff-raster-dpi", "Resolution of rendered page images used in raster comparison (in DPI).", "dpi", "100"));
     }
 
     if (optionFlags.testFlag(SignatureVerification))
@@ -189,6 +198,9 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("ver-no-cert-check", "Disable certificate validation."));
         parser->addOption(QCommandLineOption("ver-details", "Print details (including certificate chain, if found)."));
         parser->addOption(QCommandLineOption("ver-ignore-exp-date", "Ignore certificate expiration date."));
+        parser->addOption(QCommandLineOption("ver-batch", "Batch mode, verify all documents and directories specified as positional arguments. Documents are verified in parallel and one report for all documents is written."));
+        parser->addOption(QCommandLineOption("ver-batch-list", "Batch mode, verify also documents listed in the file (one file name per line).", "file"));
+        parser->addOption(QCommandLineOption("ver-batch-no-recursive", "Do not verify documents in subdirectories of directories in batch mode."));
     }
 
     if (optionFlags.testFlag(XmlExport))
@@ -236,6 +248,12 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("text-show-phoneme", "Show phoneme extracted from structure tree."));
     }
 
+    if (optionFlags.testFlag(TextStream))
+    {
+        parser->addOption(QCommandLineOption("text-stream", "Write text of each page as soon as it is extracted. Output is plain text, memory usage doesn't depend on page count. Structure algorithm is not supported, auto algorithm uses layout algorithm."));
+        parser->addOption(QCommandLineOption("text-stream-look-ahead", "Count of pages extracted in parallel ahead of the written page (0 means automatic).", "count", "0"));
+    }
+
     if (optionFlags.testFlag(VoiceSelector))
     {
         parser->addOption(QCommandLineOption("voice-name", "Choose voice name for text-to-speech engine.", "name"));
@@ -276,6 +294,30 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("image-template-fn", "Template file name, must contain '%' character, must not contain suffix.", "template file name", "Image_%"));
     }
 
+    if (optionFlags.testFlag(FetchImages))
+    {
+        parser->addOption(QCommandLineOption("image-passthrough", "Write JPEG and JPEG 2000 images directly as they are stored in the document (without decoding and encoding), if possible."));
+        parser->addOption(QCommandLineOption("image-metadata-only", "List images only (size of the image is the size of stored image data), do not decode and write them."));
+    }
+
+    if (optionFlags.testFlag(TextIndex))
+    {
+        parser->addOption(QCommandLineOption("index-file", "Text index file. When building index of directory, default index file is placed in the indexed directory.", "file"));
+    }
+
+    if (optionFlags.testFlag(TextIndexBuild))
+    {
+        parser->addPositionalArgument("directory", "Directory with documents to be indexed.");
+        parser->addOption(QCommandLineOption("index-no-recursive", "Do not index documents in subdirectories."));
+    }
+
+    if (optionFlags.testFlag(TextIndexSearch))
+    {
+        parser->addPositionalArgument("query", "Searched text.", "text [text ...]");
+        parser->addOption(QCommandLineOption("search-case-sensitive", "Case sensitive search."));
+        parser->addOption(QCommandLineOption("search-max-hits", "Maximal number of reported hits (0 means unlimited).", "count", "0"));
+    }
+
     if (optionFlags.testFlag(ImageExportSettingsResolution))
     {
         parser->addOption(QCommandLineOption("image-res-mode", "Image resolution mode (valid values are dpi|pixel). Dpi is default.", "mode", "dpi"));
@@ -292,6 +334,7 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("cms-black-compensated", "Black point compensation.", "bool", "1"));
         parser->addOption(QCommandLineOption("cms-white-paper-trans", "Transform also color of paper using cms.", "bool", "0"));
         parser->addOption(QCommandLineOption("cms-consider-output-intents", "Consider output rendering intents in the document.", "bool", "1"));
+        parser->addOption(QCommandLineOption("cms-lookup-tables", "Use precomputed color lookup tables for RGB and CMYK color transforms.", "bool", "0"));
         parser->addOption(QCommandLineOption("cms-profile-output", "Output color profile.", "profile"));
         parser->addOption(QCommandLineOption("cms-profile-gray", "Gray color profile for gray device.", "profile"));
         parser->addOption(QCommandLineOption("cms-profile-rgb", "RGB color profile for RGB device.", "profile"));
@@ -313,12 +356,48 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("render-rasterizers", "Number of rasterizer contexts.", "rasterizers", QString::number(pdf::PDFRasterizerPool::getDefaultRasterizerCount())));
     }
 
+    if (optionFlags.testFlag(RenderFlags) && optionFlags.testFlag(OpenDocument))
+    {
+        parser->addOption(QCommandLineOption("render-batch", "Batch mode, render all documents and directories specified as positional arguments. Documents and their pages are rendered in parallel."));
+        parser->addOption(QCommandLineOption("render-batch-list", "Batch mode, render also documents listed in the file (one file name per line).", "file"));
+        parser->addOption(QCommandLineOption("render-batch-no-recursive", "Do not render documents in subdirectories of directories in batch mode."));
+    }
+
+    if (optionFlags.testFlag(RenderFlags) && optionFlags.testFlag(ImageExportSettingsFiles))
+    {
+        parser->addOption(QCommandLineOption("render-tiles", "Render each page into multi-resolution tile pyramid in Deep Zoom (DZI) format, instead of single image. Resolution of the finest level is given by image resolution settings."));
+        parser->addOption(QCommandLineOption("render-tile-size", "Size of the tile of the tile pyramid in pixels.", "size", "256"));
+        parser->addOption(QCommandLineOption("render-fast-png", "Write PNG images using built-in fast encoder (fastest compression, image rows are compressed in parallel). Image compression level is ignored."));
+    }
+
     if (optionFlags.testFlag(Optimize))
     {
         for (const PDFToolOptions::OptimizeFeatureInfo& info : PDFToolOptions::getOptimizeFlagInfos())
         {
             parser->addOption(QCommandLineOption(info.option, info.description));
         }
+
+        parser->addOption(QCommandLineOption("opt-object-streams", "Write objects into compressed object streams and use cross-reference stream (PDF 1.5)."));
+        parser->addOption(QCommandLineOption("opt-linearize", "Write linearized document (fast web view)."));
+        parser->addOption(QCommandLineOption("opt-compression", "Flate compression level (valid values: fast|default|max).", "level", "max"));
+        parser->addOption(QCommandLineOption("opt-image-dpi", "Target resolution of downsampled images (in DPI).", "dpi", "150"));
+        parser->addOption(QCommandLineOption("opt-image-quality", "Quality of recompressed JPEG images (0-100).", "quality", "75"));
+        parser->addOption(QCommandLineOption("opt-bitonal", "Convert all images to bitonal (black and white) images. Images are converted in parallel."));
+        parser->addOption(QCommandLineOption("opt-bitonal-threshold", "Threshold of the bitonal conversion (0-255), automatic threshold is used, if not set.", "threshold"));
+        parser->addOption(QCommandLineOption("opt-bitonal-compression", "Compression of bitonal images (valid values: ccitt|flate).", "compression", "ccitt"));
+    }
+
+    if (optionFlags.testFlag(Sanitize))
+    {
+        for (const PDFToolOptions::SanitizeFeatureInfo& info : PDFToolOptions::getSanitizeFlagInfos())
+        {
+            parser->addOption(QCommandLineOption(info.option, info.description));
+        }
+
+        parser->addOption(QCommandLineOption("san-output-dir", "Write sanitized documents to the output directory. By default, documents are overwritten.", "directory"));
+        parser->addOption(QCommandLineOption("san-batch", "Batch mode, sanitize all documents and directories specified as positional arguments. Documents are sanitized in parallel."));
+        parser->addOption(QCommandLineOption("san-batch-list", "Batch mode, sanitize also documents listed in the file (one file name per line).", "file"));
+        parser->addOption(QCommandLineOption("san-batch-no-recursive", "Do not sanitize documents in subdirectories of directories in batch mode."));
     }
 
     if (optionFlags.testFlag(CertStore))
@@ -340,6 +419,25 @@ void PDFToolAbstractApplication::initializeCommandLineParser(QCommandLineParser*
         parser->addOption(QCommandLineOption("enc-owner-password", "Owner password.", "owner password"));
         parser->addOption(QCommandLineOption("enc-permissions", "Document permissions (flags represented as a number).", "permissions"));
     }
+
+    if (optionFlags.testFlag(Server))
+    {
+        parser->addOption(QCommandLineOption("server-name", "Name of the local socket, on which server listens.", "name", "pdftool"));
+        parser->addOption(QCommandLineOption("server-max-jobs", "Maximal count of jobs processed in parallel (0 means automatic).", "count", "0"));
+        parser->addOption(QCommandLineOption("server-max-documents", "Maximal count of documents kept open by the server.", "count", "16"));
+    }
+
+    ExtendedOptions extendedOptionFlags = getExtendedOptionsFlags();
+    if (extendedOptionFlags.testFlag(FormFill))
+    {
+        parser->addOption(QCommandLineOption("fill-data", "File with data records (csv|json|fdf, determined by file extension). Can be specified multiple times, records of all files are filled.", "file"));
+        parser->addOption(QCommandLineOption("fill-output", "Output file name of filled documents. Character '#' is replaced by the record number.", "file"));
+    }
+
+    // Options common for all commands
+    parser->addOption(QCommandLineOption("threads", "Maximal count of threads used for processing (0 means automatic, 1 disables multithreading).", "count", "0"));
+    parser->addOption(QCommandLineOption("cache-dir", "Directory of the cache of page results (rendered images, text layouts), which can be shared by multiple runs and documents.", "directory"));
+    parser->addOption(QCommandLineOption("cache-limit", "Size limit of the cache of page results in MB.", "size", "1024"));
 }
 
 PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser) const
@@ -364,6 +462,10 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         {
             options.outputStyle = PDFOutputFormatter::Style::Html;
         }
+        else if (consoleFormat == "json")
+        {
+            options.outputStyle = PDFOutputFormatter::Style::Json;
+        }
         else
         {
             if (!consoleFormat.isEmpty())
@@ -421,6 +523,10 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.verificationOmitCertificateCheck = parser->isSet("ver-no-cert-check");
         options.verificationPrintCertificateDetails = parser->isSet("ver-details");
         options.verificationIgnoreExpirationDate = parser->isSet("ver-ignore-exp-date");
+        options.verificationBatchListFile = parser->value("ver-batch-list");
+        options.verificationBatch = parser->isSet("ver-batch") || !options.verificationBatchListFile.isEmpty();
+        options.verificationBatchRecursive = !parser->isSet("ver-batch-no-recursive");
+        options.verificationBatchFiles = options.verificationBatch ? positionalArguments : QStringList();
     }
 
     if (optionFlags.testFlag(XmlExport))
@@ -488,6 +594,19 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.textShowStructPhoneme = parser->isSet("text-show-phoneme");
     }
 
+    if (optionFlags.testFlag(TextStream))
+    {
+        options.textStreaming = parser->isSet("text-stream");
+
+        bool ok = false;
+        options.textStreamingLookAhead = parser->value("text-stream-look-ahead").toInt(&ok);
+        if (!ok || options.textStreamingLookAhead < 0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid look-ahead page count '%1'. Using automatic page count.").arg(parser->value("text-stream-look-ahead")), options.outputCodec);
+            options.textStreamingLookAhead = 0;
+        }
+    }
+
     if (optionFlags.testFlag(VoiceSelector))
     {
         options.textVoiceName = parser->isSet("voice-name") ? parser->value("voice-name") : QString();
@@ -635,6 +754,37 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.imageExportSettings.setFileTemplate(parser->value("image-template-fn"));
     }
 
+    if (optionFlags.testFlag(FetchImages))
+    {
+        options.fetchImagesPassthrough = parser->isSet("image-passthrough");
+        options.fetchImagesMetadataOnly = parser->isSet("image-metadata-only");
+    }
+
+    if (optionFlags.testFlag(TextIndex))
+    {
+        options.textIndexFile = parser->value("index-file");
+    }
+
+    if (optionFlags.testFlag(TextIndexBuild))
+    {
+        options.textIndexDirectory = positionalArguments.isEmpty() ? QString() : positionalArguments.front();
+        options.textIndexRecursive = !parser->isSet("index-no-recursive");
+    }
+
+    if (optionFlags.testFlag(TextIndexSearch))
+    {
+        options.textIndexQuery = positionalArguments.join(' ').simplified();
+        options.textIndexCaseSensitive = parser->isSet("search-case-sensitive");
+
+        bool ok = false;
+        options.textIndexMaxHits = parser->value("search-max-hits").toInt(&ok);
+        if (!ok || options.textIndexMaxHits < 0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid maximal hit count '%1'. Reporting all hits.").arg(parser->value("search-max-hits")), options.outputCodec);
+            options.textIndexMaxHits = 0;
+        }
+    }
+
     if (optionFlags.testFlag(ImageExportSettingsResolution))
     {
         QString resMode = parser->value("image-res-mode").toLower();
@@ -813,6 +963,11 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
             options.cmsSettings.isConsiderOutputIntent = parser->value("cms-consider-output-intents").toInt();
         }
 
+        if (parser->isSet("cms-lookup-tables"))
+        {
+            options.cmsSettings.isColorLookupTableUsed = parser->value("cms-lookup-tables").toInt();
+        }
+
         auto setProfile = [&parser, &options](QString settings, QString& profile)
         {
             if (parser->isSet(settings))
@@ -884,14 +1039,61 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.renderShowPageStatistics = parser->isSet("render-show-page-stat");
     }
 
+    if (optionFlags.testFlag(RenderFlags) && optionFlags.testFlag(OpenDocument))
+    {
+        options.renderBatchListFile = parser->value("render-batch-list");
+        options.renderBatch = parser->isSet("render-batch") || !options.renderBatchListFile.isEmpty();
+        options.renderBatchRecursive = !parser->isSet("render-batch-no-recursive");
+        options.renderBatchFiles = options.renderBatch ? positionalArguments : QStringList();
+
+        if (optionFlags.testFlag(ImageExportSettingsFiles) && parser->isSet("image-output-dir"))
+        {
+            options.renderBatchOutputDirectory = parser->value("image-output-dir");
+        }
+    }
+
+    if (optionFlags.testFlag(RenderFlags) && optionFlags.testFlag(ImageExportSettingsFiles))
+    {
+        options.renderTilePyramid = parser->isSet("render-tiles");
+        options.renderFastPng = parser->isSet("render-fast-png");
+
+        bool ok = false;
+        QString textValue = parser->value("render-tile-size");
+        options.renderTileSize = textValue.toInt(&ok);
+        if (!ok || options.renderTileSize < 16 || options.renderTileSize > 4096)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid tile size '%1' (valid values are 16-4096). 256 pixels are used as default.").arg(textValue), options.outputCodec);
+            options.renderTileSize = 256;
+        }
+    }
+
+    if (optionFlags.testFlag(Separate))
+    {
+        options.separateFast = parser->isSet("fast");
+    }
+
     if (optionFlags.testFlag(Unite))
     {
         options.uniteFiles = positionalArguments;
     }
 
+    if (optionFlags.testFlag(Separate) || optionFlags.testFlag(Unite))
+    {
+        options.assembleStreaming = parser->isSet("streaming");
+    }
+
     if (optionFlags.testFlag(Diff))
     {
         options.diffFiles = positionalArguments;
+        options.diffRaster = parser->isSet("diff-raster");
+
+        bool ok = false;
+        options.diffRasterResolution = parser->value("diff-raster-dpi").toDouble(&ok);
+        if (!ok || options.diffRasterResolution <= 0.0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid raster resolution '%1'. Defaulting to 100 DPI.").arg(parser->value("diff-raster-dpi")), options.outputCodec);
+            options.diffRasterResolution = 100.0;
+        }
     }
 
     if (optionFlags.testFlag(Optimize))
@@ -904,6 +1106,92 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
                 options.optimizeFlags |= info.flag;
             }
         }
+
+        options.optimizeObjectStreams = parser->isSet("opt-object-streams");
+        options.optimizeLinearize = parser->isSet("opt-linearize");
+
+        bool ok = false;
+        options.optimizeImageResolution = parser->value("opt-image-dpi").toDouble(&ok);
+        if (!ok || options.optimizeImageResolution <= 0.0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid image resolution '%1'. Defaulting to 150 DPI.").arg(parser->value("opt-image-dpi")), options.outputCodec);
+            options.optimizeImageResolution = 150.0;
+        }
+
+        options.optimizeImageQuality = parser->value("opt-image-quality").toInt(&ok);
+        if (!ok || options.optimizeImageQuality < 0 || options.optimizeImageQuality > 100)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid image quality '%1'. Defaulting to 75.").arg(parser->value("opt-image-quality")), options.outputCodec);
+            options.optimizeImageQuality = 75;
+        }
+
+        QString compressionLevel = parser->value("opt-compression");
+        if (compressionLevel == "fast")
+        {
+            options.optimizeCompressionLevel = pdf::PDFFlateDecodeFilter::CompressionLevel::Fast;
+        }
+        else if (compressionLevel == "default")
+        {
+            options.optimizeCompressionLevel = pdf::PDFFlateDecodeFilter::CompressionLevel::Default;
+        }
+        else if (compressionLevel == "max")
+        {
+            options.optimizeCompressionLevel = pdf::PDFFlateDecodeFilter::CompressionLevel::Maximum;
+        }
+        else
+        {
+            if (!compressionLevel.isEmpty())
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown compression level '%1'. Defaulting to maximal compression.").arg(compressionLevel), options.outputCodec);
+            }
+
+            options.optimizeCompressionLevel = pdf::PDFFlateDecodeFilter::CompressionLevel::Maximum;
+        }
+
+        options.optimizeBitonal = parser->isSet("opt-bitonal");
+        if (parser->isSet("opt-bitonal-threshold"))
+        {
+            options.optimizeBitonalSettings.conversionMethod = pdf::PDFImageConversion::ConversionMethod::Manual;
+            options.optimizeBitonalSettings.threshold = parser->value("opt-bitonal-threshold").toInt(&ok);
+            if (!ok || options.optimizeBitonalSettings.threshold < 0 || options.optimizeBitonalSettings.threshold > 255)
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid bitonal threshold '%1'. Defaulting to automatic threshold.").arg(parser->value("opt-bitonal-threshold")), options.outputCodec);
+                options.optimizeBitonalSettings.conversionMethod = pdf::PDFImageConversion::ConversionMethod::Automatic;
+            }
+        }
+
+        QString bitonalCompression = parser->value("opt-bitonal-compression");
+        if (bitonalCompression == "ccitt")
+        {
+            options.optimizeBitonalSettings.compression = pdf::PDFBitonalDocumentConvertor::Compression::CCITTGroup4;
+        }
+        else if (bitonalCompression == "flate")
+        {
+            options.optimizeBitonalSettings.compression = pdf::PDFBitonalDocumentConvertor::Compression::Flate;
+        }
+        else
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Unknown bitonal compression '%1'. Defaulting to CCITT Group 4.").arg(bitonalCompression), options.outputCodec);
+            options.optimizeBitonalSettings.compression = pdf::PDFBitonalDocumentConvertor::Compression::CCITTGroup4;
+        }
+    }
+
+    if (optionFlags.testFlag(Sanitize))
+    {
+        options.sanitizeFlags = pdf::PDFDocumentSanitizer::None;
+        for (const PDFToolOptions::SanitizeFeatureInfo& info : PDFToolOptions::getSanitizeFlagInfos())
+        {
+            if (parser->isSet(info.option))
+            {
+                options.sanitizeFlags |= info.flag;
+            }
+        }
+
+        options.sanitizeOutputDirectory = parser->value("san-output-dir");
+        options.sanitizeBatchListFile = parser->value("san-batch-list");
+        options.sanitizeBatch = parser->isSet("san-batch") || !options.sanitizeBatchListFile.isEmpty();
+        options.sanitizeBatchRecursive = !parser->isSet("san-batch-no-recursive");
+        options.sanitizeBatchFiles = options.sanitizeBatch ? positionalArguments : QStringList();
     }
 
     if (optionFlags.testFlag(CertStore))
@@ -970,9 +1258,85 @@ PDFToolOptions PDFToolAbstractApplication::getOptions(QCommandLineParser* parser
         options.encryptionPermissions = parser->value("enc-permissions").toUInt();
     }
 
+    if (optionFlags.testFlag(Server))
+    {
+        options.serverName = parser->value("server-name");
+
+        bool ok = false;
+        options.serverMaxJobs = parser->value("server-max-jobs").toInt(&ok);
+        if (!ok || options.serverMaxJobs < 0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid maximal job count '%1'. Using automatic job count.").arg(parser->value("server-max-jobs")), options.outputCodec);
+            options.serverMaxJobs = 0;
+        }
+
+        options.serverMaxDocuments = parser->value("server-max-documents").toInt(&ok);
+        if (!ok || options.serverMaxDocuments < 1)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid maximal document count '%1'. Using default document count.").arg(parser->value("server-max-documents")), options.outputCodec);
+            options.serverMaxDocuments = 16;
+        }
+    }
+
+    ExtendedOptions extendedOptionFlags = getExtendedOptionsFlags();
+    if (extendedOptionFlags.testFlag(FormFill))
+    {
+        options.fillDataFiles = parser->values("fill-data");
+        options.fillOutputFileName = parser->value("fill-output");
+    }
+
+    if (parser->isSet("threads"))
+    {
+        bool ok = false;
+        options.threadCount = parser->value("threads").toInt(&ok);
+        if (!ok || options.threadCount < 0)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid thread count '%1'. Using automatic thread count.").arg(parser->value("threads")), options.outputCodec);
+            options.threadCount = 0;
+        }
+    }
+
+    options.cacheDirectory = parser->value("cache-dir");
+    if (parser->isSet("cache-limit"))
+    {
+        bool ok = false;
+        options.cacheLimit = parser->value("cache-limit").toInt(&ok);
+        if (!ok || options.cacheLimit < 1)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid cache size limit '%1'. Using default size limit.").arg(parser->value("cache-limit")), options.outputCodec);
+            options.cacheLimit = 1024;
+        }
+    }
+
     return options;
 }
 
+void PDFToolAbstractApplication::initializeExecutionPolicy(const PDFToolOptions& options)
+{
+    if (options.threadCount == 1)
+    {
+        pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::SingleThreaded);
+    }
+    else if (options.threadCount > 1)
+    {
+        // Calling thread also processes the items, so thread
+        // pools have one thread less, than is the thread count.
+        pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+        pdf::PDFExecutionPolicy::setMaxThreadCount(pdf::PDFExecutionPolicy::Scope::Page, options.threadCount - 1);
+        pdf::PDFExecutionPolicy::setMaxThreadCount(pdf::PDFExecutionPolicy::Scope::Content, options.threadCount - 1);
+    }
+}
+
+std::unique_ptr<pdf::PDFDiskCache> PDFToolAbstractApplication::createDiskCache(const PDFToolOptions& options)
+{
+    if (options.cacheDirectory.isEmpty())
+    {
+        return nullptr;
+    }
+
+    return std::make_unique<pdf::PDFDiskCache>(options.cacheDirectory, qint64(options.cacheLimit) * 1024 * 1024);
+}
+
 QString PDFToolAbstractApplication::convertDateTimeToString(const QDateTime& dateTime, PDFToolOptions::DateFormat dateFormat)
 {
     switch (dateFormat)
@@ -1003,6 +1367,9 @@ bool PDFToolAbstractApplication::readDocument(const PDFToolOptions& options, pdf
         return options.password;
     };
     pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, authorizeOwnerOnly);
+    reader.setMemoryMapping(true);
+    reader.setObjectSourceKept(true);
+    reader.setLazyLoading(options.assembleStreaming);
     document = reader.readFromFile(options.document);
 
     switch (reader.getReadingResult())
@@ -1011,7 +1378,9 @@ bool PDFToolAbstractApplication::readDocument(const PDFToolOptions& options, pdf
         {
             if (sourceData)
             {
+                // Source data are memory mapped by the reader, so we must make a deep copy
                 *sourceData = reader.getSource();
+                sourceData->detach();
             }
             break;
         }
@@ -1173,6 +1542,7 @@ std::vector<PDFToolOptions::RenderFeatureInfo> PDFToolOptions::getRenderFeatures
         RenderFeatureInfo{ "render-high-contrast", "Color conversion: high contrast colors", pdf::PDFRenderer::ColorAdjust_HighContrast },
         RenderFeatureInfo{ "render-bitonal", "Color conversion: bitonal page image", pdf::PDFRenderer::ColorAdjust_Bitonal },
         RenderFeatureInfo{ "render-custom-colors", "Color conversion: custom colors", pdf::PDFRenderer::ColorAdjust_CustomColors },
+        RenderFeatureInfo{ "render-post-raster-colors", "Color conversion: apply inversion/grayscale to the rendered image.", pdf::PDFRenderer::ColorAdjust_PostRaster },
         RenderFeatureInfo{ "render-display-annot", "Display annotations.", pdf::PDFRenderer::DisplayAnnotations }
     };
 }
@@ -1186,7 +1556,27 @@ std::vector<PDFToolOptions::OptimizeFeatureInfo> PDFToolOptions::getOptimizeFlag
         OptimizeFeatureInfo{ "opt-merge-identical", "Merge identical objects.", pdf::PDFOptimizer::MergeIdenticalObjects },
         OptimizeFeatureInfo{ "opt-shrink-storage", "Shrink object storage by renumbering objects.", pdf::PDFOptimizer::ShrinkObjectStorage },
         OptimizeFeatureInfo{ "opt-recompress-flate", "Recompress flate streams with maximal compression.", pdf::PDFOptimizer::RecompressFlateStreams },
-        OptimizeFeatureInfo{ "opt-all", "Use all optimization algorithms.", pdf::PDFOptimizer::All }
+        OptimizeFeatureInfo{ "opt-downsample-images", "Downsample images above target resolution (lossy).", pdf::PDFOptimizer::DownsampleImages },
+        OptimizeFeatureInfo{ "opt-recompress-images", "Recompress continuous tone images by JPEG (lossy).", pdf::PDFOptimizer::RecompressImages },
+        OptimizeFeatureInfo{ "opt-monochrome-images", "Convert black and white images to 1 bit per pixel.", pdf::PDFOptimizer::ConvertMonochromeImages },
+        OptimizeFeatureInfo{ "opt-merge-images", "Merge images with identical pixels.", pdf::PDFOptimizer::MergeIdenticalImages },
+        OptimizeFeatureInfo{ "opt-merge-fonts", "Merge identical embedded font programs and subsets of the same TrueType font.", pdf::PDFOptimizer::MergeIdenticalFonts },
+        OptimizeFeatureInfo{ "opt-content-streams", "Rewrite page content streams more compactly.", pdf::PDFOptimizer::OptimizeContentStreams },
+        OptimizeFeatureInfo{ "opt-all", "Use all lossless optimization algorithms.", pdf::PDFOptimizer::AllLossless }
+    };
+}
+
+std::vector<PDFToolOptions::SanitizeFeatureInfo> PDFToolOptions::getSanitizeFlagInfos()
+{
+    return {
+        SanitizeFeatureInfo{ "san-info", "Remove document info.", pdf::PDFDocumentSanitizer::DocumentInfo },
+        SanitizeFeatureInfo{ "san-metadata", "Remove all metadata streams.", pdf::PDFDocumentSanitizer::Metadata },
+        SanitizeFeatureInfo{ "san-outline", "Remove outline.", pdf::PDFDocumentSanitizer::Outline },
+        SanitizeFeatureInfo{ "san-attachments", "Remove file attachments.", pdf::PDFDocumentSanitizer::FileAttachments },
+        SanitizeFeatureInfo{ "san-search-index", "Remove embedded search index.", pdf::PDFDocumentSanitizer::EmbeddedSearchIndex },
+        SanitizeFeatureInfo{ "san-markup", "Remove comments and other markup annotations.", pdf::PDFDocumentSanitizer::MarkupAnnotations },
+        SanitizeFeatureInfo{ "san-thumbnails", "Remove page thumbnails.", pdf::PDFDocumentSanitizer::PageThumbnails },
+        SanitizeFeatureInfo{ "san-all", "Use all sanitization algorithms.", pdf::PDFDocumentSanitizer::All }
     };
 }
 
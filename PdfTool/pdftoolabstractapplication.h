@@ -25,6 +25,9 @@
 #include "pdfrenderer.h"
 #include "pdfcms.h"
 #include "pdfoptimizer.h"
+#include "pdfdocumentsanitizer.h"
+#include "pdfbitonaldocumentconvertor.h"
+#include "pdfdiskcache.h"
 
 #include <QtGlobal>
 #include <QString>
@@ -32,6 +35,7 @@
 #include <QCoreApplication>
 #include <QStringConverter>
 
+#include <memory>
 #include <vector>
 
 class QCommandLineParser;
@@ -72,6 +76,10 @@ struct PDFToolOptions
     bool verificationOmitCertificateCheck = false;
     bool verificationPrintCertificateDetails = false;
     bool verificationIgnoreExpirationDate = false;
+    bool verificationBatch = false;
+    bool verificationBatchRecursive = true;
+    QStringList verificationBatchFiles;
+    QString verificationBatchListFile;
 
     // For option 'XMLExport'
     bool xmlExportStreams = false;
@@ -106,6 +114,10 @@ struct PDFToolOptions
     bool textShowStructActualText = false;
     bool textShowStructPhoneme = false;
 
+    // For option 'TextStream'
+    bool textStreaming = false;
+    int textStreamingLookAhead = 0;
+
     // For option 'VoiceSelector'
     QString textVoiceName;
     QString textVoiceGender;
@@ -130,6 +142,22 @@ struct PDFToolOptions
     // For option 'ImageExportSettings'
     pdf::PDFPageImageExportSettings imageExportSettings;
 
+    // For option 'FetchImages'
+    bool fetchImagesPassthrough = false;
+    bool fetchImagesMetadataOnly = false;
+
+    // For option 'TextIndex'
+    QString textIndexFile;
+
+    // For option 'TextIndexBuild'
+    QString textIndexDirectory;
+    bool textIndexRecursive = true;
+
+    // For option 'TextIndexSearch'
+    QString textIndexQuery;
+    bool textIndexCaseSensitive = false;
+    int textIndexMaxHits = 0;
+
     // For option 'ColorManagementSystem'
     pdf::PDFCMSSettings cmsSettings;
 
@@ -140,17 +168,54 @@ struct PDFToolOptions
     int renderMSAAsamples = 4;
     int renderRasterizerCount = pdf::PDFRasterizerPool::getDefaultRasterizerCount();
 
+    // For options 'RenderFlags' and 'OpenDocument' (batch rendering)
+    bool renderBatch = false;
+    bool renderBatchRecursive = true;
+    QStringList renderBatchFiles;
+    QString renderBatchListFile;
+    QString renderBatchOutputDirectory;
+
+    // For options 'RenderFlags' and 'ImageExportSettingsFiles' (tile pyramid, fast PNG encoder)
+    bool renderTilePyramid = false;
+    int renderTileSize = 256;
+    bool renderFastPng = false;
+
     // For option 'Separate'
     QString separatePagePattern;
+    bool separateFast = false;
 
     // For option 'Unite'
     QStringList uniteFiles;
 
+    // For options 'Separate' and 'Unite'
+    bool assembleStreaming = false;
+
     // For option 'Diff'
     QStringList diffFiles;
+    bool diffRaster = false;
+    pdf::PDFReal diffRasterResolution = 100.0;
 
     // For option 'Optimize'
     pdf::PDFOptimizer::OptimizationFlags optimizeFlags = pdf::PDFOptimizer::None;
+    bool optimizeObjectStreams = false;
+    bool optimizeLinearize = false;
+    pdf::PDFFlateDecodeFilter::CompressionLevel optimizeCompressionLevel = pdf::PDFFlateDecodeFilter::CompressionLevel::Maximum;
+    pdf::PDFReal optimizeImageResolution = 150.0;
+    int optimizeImageQuality = 75;
+    bool optimizeBitonal = false;
+    pdf::PDFBitonalDocumentConvertor::Settings optimizeBitonalSettings;
+
+    // For option 'Sanitize'
+    pdf::PDFDocumentSanitizer::SanitizationFlags sanitizeFlags = pdf::PDFDocumentSanitizer::None;
+    QString sanitizeOutputDirectory;
+    bool sanitizeBatch = false;
+    bool sanitizeBatchRecursive = true;
+    QStringList sanitizeBatchFiles;
+    QString sanitizeBatchListFile;
+
+    // For option 'FormFill'
+    QStringList fillDataFiles;
+    QString fillOutputFileName;
 
     // For option 'CertStore'
     bool certStoreEnumerateSystemCertificates = false;
@@ -166,6 +231,16 @@ struct PDFToolOptions
     QString encryptionOwnerPassword;
     uint32_t encryptionPermissions = 0;
 
+    // For option 'Server'
+    QString serverName = "pdftool";
+    int serverMaxJobs = 0;
+    int serverMaxDocuments = 16;
+
+    // Common for all commands
+    int threadCount = 0;
+    QString cacheDirectory;
+    int cacheLimit = 1024; ///< Size limit of the cache [MB]
+
     /// Returns page range. If page range is invalid, then \p errorMessage is empty.
     /// \param pageCount Page count
     /// \param[out] errorMessage Error message
@@ -191,6 +266,16 @@ struct PDFToolOptions
 
     /// Returns a list of available optimize features
     static std::vector<OptimizeFeatureInfo> getOptimizeFlagInfos();
+
+    struct SanitizeFeatureInfo
+    {
+        QString option;
+        QString description;
+        pdf::PDFDocumentSanitizer::SanitizationFlag flag;
+    };
+
+    /// Returns a list of available sanitize features
+    static std::vector<SanitizeFeatureInfo> getSanitizeFlagInfos();
 };
 
 /// Base class for all applications
@@ -215,7 +300,8 @@ public:
         ErrorNoText,
         ErrorCOM,
         ErrorSAPI,
-        ErrorEncryptionSettings
+        ErrorEncryptionSettings,
+        ErrorServer
     };
 
     enum StandardString
@@ -252,18 +338,46 @@ public:
         CertStoreInstall                = 0x00400000,       ///< Settings for certificate store install certificate tool
         Encrypt                         = 0x00800000,       ///< Encryption settings
         Diff                            = 0x01000000,       ///< Diff settings (compare documents)
+        FetchImages                     = 0x02000000,       ///< Settings for fetch images tool
+        TextIndex                       = 0x04000000,       ///< Text index file settings
+        TextIndexBuild                  = 0x08000000,       ///< Settings for building text index of documents
+        TextIndexSearch                 = 0x10000000,       ///< Settings for searching in the text index
+        TextStream                      = 0x20000000,       ///< Streaming text output settings
+        Sanitize                        = 0x40000000,       ///< Settings for Sanitize tool
+        Server                          = 0x80000000,       ///< Settings for server (jobs processed through the local socket)
     };
     Q_DECLARE_FLAGS(Options, Option)
 
+    /// Options, which doesn't fit into \p Option flags (all bits are used)
+    enum ExtendedOption
+    {
+        NoExtendedOption                = 0x00000000,
+        FormFill                        = 0x00000001,       ///< Settings for form filling tool
+    };
+    Q_DECLARE_FLAGS(ExtendedOptions, ExtendedOption)
+
     virtual QString getStandardString(StandardString standardString) const = 0;
     virtual int execute(const PDFToolOptions& options) = 0;
     virtual Options getOptionsFlags() const = 0;
+    virtual ExtendedOptions getExtendedOptionsFlags() const { return NoExtendedOption; }
 
     void initializeCommandLineParser(QCommandLineParser* parser) const;
     PDFToolOptions getOptions(QCommandLineParser* parser) const;
 
     static QString convertDateTimeToString(const QDateTime& dateTime, PDFToolOptions::DateFormat dateFormat);
 
+    /// Sets thread count of the execution policy (see PDFExecutionPolicy)
+    /// from the options. Thread count is shared by all commands.
+    /// \param options Options
+    static void initializeExecutionPolicy(const PDFToolOptions& options);
+
+    /// Creates disk cache of page results (rendered images, text layouts, etc.)
+    /// from the options. Results are keyed by the page content, so they are
+    /// shared by identical pages of different documents. If cache directory
+    /// isn't set, nullptr is returned.
+    /// \param options Options
+    static std::unique_ptr<pdf::PDFDiskCache> createDiskCache(const PDFToolOptions& options);
+
 protected:
     /// Tries to read the document. If document is successfully read, true is returned,
     /// if error occurs, then false is returned. Optionally, original document content
@@ -320,5 +434,6 @@ private:
 }   // namespace pdftool
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(pdftool::PDFToolAbstractApplication::Options)
+Q_DECLARE_OPERATORS_FOR_FLAGS(pdftool::PDFToolAbstractApplication::ExtendedOptions)
 
 #endif // PDFTOOLABSTRACTAPPLICATION_H
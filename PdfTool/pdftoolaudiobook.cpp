@@ -19,8 +19,14 @@
 
 #ifdef Q_OS_WIN
 
+#include "pdfexecutionpolicy.h"
+#include "pdfexception.h"
+
+#include <QFile>
 #include <QFileInfo>
 
+#include <limits>
+
 #include <windows.h>
 #include <sapi.h>
 
@@ -34,6 +40,128 @@ namespace pdftool
 static PDFToolAudioBook s_audioBookApplication;
 static PDFToolAudioBookVoices s_audioBookVoicesApplication;
 
+/// Maximal length of the text synthesized at once. Text is divided into
+/// chunks on line boundaries, which are synthesized in parallel.
+static constexpr qsizetype MAX_CHUNK_LENGTH = 4096;
+
+/// Audio format of the synthesized speech (mono, 22.05 kHz, 16 bits per sample)
+static WAVEFORMATEX getAudioFormat()
+{
+    WAVEFORMATEX format = { };
+    format.wFormatTag = WAVE_FORMAT_PCM;
+    format.nChannels = 1;
+    format.nSamplesPerSec = 22050;
+    format.wBitsPerSample = 16;
+    format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+    format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+    format.cbSize = 0;
+    return format;
+}
+
+/// Returns header of the wave file with PCM data of given size
+static QByteArray getWaveFileHeader(const WAVEFORMATEX& format, quint32 dataSize)
+{
+    auto appendUInt16 = [](QByteArray& data, quint16 value)
+    {
+        data.append(char(value & 0xFF));
+        data.append(char((value >> 8) & 0xFF));
+    };
+    auto appendUInt32 = [&](QByteArray& data, quint32 value)
+    {
+        appendUInt16(data, quint16(value & 0xFFFF));
+        appendUInt16(data, quint16(value >> 16));
+    };
+
+    QByteArray header;
+    header.append("RIFF");
+    appendUInt32(header, 36 + dataSize);
+    header.append("WAVEfmt ");
+    appendUInt32(header, 16);
+    appendUInt16(header, format.wFormatTag);
+    appendUInt16(header, format.nChannels);
+    appendUInt32(header, format.nSamplesPerSec);
+    appendUInt32(header, format.nAvgBytesPerSec);
+    appendUInt16(header, format.nBlockAlign);
+    appendUInt16(header, format.wBitsPerSample);
+    header.append("data");
+    appendUInt32(header, dataSize);
+    return header;
+}
+
+/// Synthesizes text into PCM data of given format. Function can be called
+/// from any thread, it uses its own COM objects (voice is created from
+/// the token identifier, so token is not shared between threads).
+static QByteArray synthesizeSpeech(const QString& voiceId, const QString& text, WAVEFORMATEX format, QString& errorMessage)
+{
+    QByteArray data;
+
+    const HRESULT comResult = ::CoInitialize(nullptr);
+
+    ISpObjectToken* voiceToken = nullptr;
+    IStream* memoryStream = nullptr;
+    ISpStream* stream = nullptr;
+    ISpVoice* voice = nullptr;
+
+    auto release = [](auto*& object)
+    {
+        if (object)
+        {
+            object->Release();
+            object = nullptr;
+        }
+    };
+
+    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpObjectToken, NULL, CLSCTX_ALL, __uuidof(ISpObjectToken), (LPVOID*)&voiceToken)) ||
+        !SUCCEEDED(voiceToken->SetId(NULL, (LPCWSTR)voiceId.utf16(), FALSE)))
+    {
+        errorMessage = PDFToolTranslationContext::tr("Invalid voice.");
+    }
+    else if (!SUCCEEDED(::CreateStreamOnHGlobal(NULL, TRUE, &memoryStream)) ||
+             !SUCCEEDED(::CoCreateInstance(CLSID_SpStream, NULL, CLSCTX_ALL, __uuidof(ISpStream), (LPVOID*)&stream)) ||
+             !SUCCEEDED(stream->SetBaseStream(memoryStream, SPDFID_WaveFormatEx, &format)))
+    {
+        errorMessage = PDFToolTranslationContext::tr("Cannot create audio stream.");
+    }
+    else if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
+    {
+        errorMessage = PDFToolTranslationContext::tr("Cannot create voice.");
+    }
+    else
+    {
+        voice->SetVoice(voiceToken);
+        voice->SetOutput(stream, FALSE);
+
+        LPCWSTR stringToSpeak = (LPCWSTR)text.utf16();
+        if (SUCCEEDED(voice->Speak(stringToSpeak, SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL)))
+        {
+            LARGE_INTEGER zero = { };
+            ULARGE_INTEGER size = { };
+            ULONG bytesRead = 0;
+            memoryStream->Seek(zero, STREAM_SEEK_END, &size);
+            memoryStream->Seek(zero, STREAM_SEEK_SET, nullptr);
+            data.resize(qsizetype(size.QuadPart));
+            memoryStream->Read(data.data(), ULONG(data.size()), &bytesRead);
+            data.resize(qsizetype(bytesRead));
+        }
+        else
+        {
+            errorMessage = PDFToolTranslationContext::tr("Speech synthesis failed.");
+        }
+    }
+
+    release(voice);
+    release(stream);
+    release(memoryStream);
+    release(voiceToken);
+
+    if (SUCCEEDED(comResult))
+    {
+        ::CoUninitialize();
+    }
+
+    return data;
+}
+
 PDFVoiceInfo::PDFVoiceInfo(std::map<QString, QString> properties, ISpObjectToken* voiceToken) :
     m_properties(qMove(properties)),
     m_voiceToken(voiceToken)
@@ -358,14 +486,21 @@ int PDFToolAudioBook::getDocumentTextFlow(const PDFToolOptions& options, pdf::PD
 
 int PDFToolAudioBook::createAudioBook(const PDFToolOptions& options, pdf::PDFDocumentTextFlow& flow)
 {
-    QString audioString;
-    QTextStream textStream(&audioString);
+    // Divide text into chunks, which can be synthesized independently
+    std::vector<QString> chunks;
+    QString chunk;
+
+    auto addLine = [&](const QString& line)
+    {
+        chunk += line;
+        chunk += QChar('\n');
+    };
 
     for (const pdf::PDFDocumentTextFlow::Item& item : flow.getItems())
     {
         if (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageStart) && options.textSpeechMarkPageNumbers)
         {
-            textStream << QString("<bookmark mark=\"%1\"/>").arg(item.text) << Qt::endl;
+            addLine(QString("<bookmark mark=\"%1\"/>").arg(item.text));
         }
 
         if (!item.text.isEmpty())
@@ -380,9 +515,20 @@ int PDFToolAudioBook::createAudioBook(const PDFToolOptions& options, pdf::PDFDoc
 
             if (showText)
             {
-                textStream << item.text << Qt::endl;
+                addLine(item.text);
             }
         }
+
+        if (chunk.size() >= MAX_CHUNK_LENGTH)
+        {
+            chunks.push_back(qMove(chunk));
+            chunk.clear();
+        }
+    }
+
+    if (!chunk.isEmpty())
+    {
+        chunks.push_back(qMove(chunk));
     }
 
     PDFVoiceInfoList voices;
@@ -395,7 +541,18 @@ int PDFToolAudioBook::createAudioBook(const PDFToolOptions& options, pdf::PDFDoc
         return ErrorSAPI;
     }
 
-    if (!voices.front().getVoiceToken())
+    // Voices are created in the worker threads from the token identifier
+    QString voiceId;
+    LPWSTR voiceIdString = nullptr;
+    ISpObjectToken* voiceToken = voices.front().getVoiceToken();
+    if (voiceToken && SUCCEEDED(voiceToken->GetId(&voiceIdString)))
+    {
+        voiceId = QString::fromWCharArray(voiceIdString);
+        ::CoTaskMemFree(voiceIdString);
+    }
+    voices.clear();
+
+    if (voiceId.isEmpty())
     {
         PDFConsole::writeError(PDFToolTranslationContext::tr("Invalid voice."), options.outputCodec);
         return ErrorSAPI;
@@ -403,45 +560,70 @@ int PDFToolAudioBook::createAudioBook(const PDFToolOptions& options, pdf::PDFDoc
 
     QFileInfo info(options.document);
     QString outputFile = QString("%1/%2.%3").arg(info.path(), info.completeBaseName(), options.textSpeechAudioFormat);
-    BSTR outputFileName = (BSTR)outputFile.utf16();
 
-    ISpeechFileStream* stream = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpFileStream, NULL, CLSCTX_ALL, __uuidof(ISpeechFileStream), (LPVOID*)&stream)))
+    QFile file(outputFile);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
     {
         PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot create output stream '%1'.").arg(outputFile), options.outputCodec);
-        return ErrorSAPI;
+        return ErrorFailedWriteToFile;
     }
 
-    ISpVoice* voice = nullptr;
-    if (!SUCCEEDED(::CoCreateInstance(CLSID_SpVoice, NULL, CLSCTX_ALL, __uuidof(ISpVoice), (LPVOID*)&voice)))
+    // Chunks are synthesized in parallel and written to the file in order. Only
+    // limited number of synthesized chunks waits for writing, so memory consumption
+    // doesn't depend on the length of the book.
+    const WAVEFORMATEX format = getAudioFormat();
+    file.write(getWaveFileHeader(format, 0));
+    quint64 dataSize = 0;
+
+    struct SynthesizedChunk
     {
-        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot create voice."), options.outputCodec);
-        stream->Release();
-        return ErrorSAPI;
-    }
+        QByteArray data;
+        QString errorMessage;
+    };
 
-    if (!SUCCEEDED(stream->Open(outputFileName, SSFMCreateForWrite)))
+    auto synthesizeChunk = [&](size_t index)
     {
-        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot create output stream '%1'.").arg(outputFile), options.outputCodec);
-        voice->Release();
-        stream->Release();
+        SynthesizedChunk result;
+        result.data = synthesizeSpeech(voiceId, chunks[index], format, result.errorMessage);
+        chunks[index].clear();
+        return result;
+    };
+
+    auto writeChunk = [&](size_t, SynthesizedChunk result)
+    {
+        if (!result.errorMessage.isEmpty())
+        {
+            throw pdf::PDFException(result.errorMessage);
+        }
+
+        if (file.write(result.data) != result.data.size())
+        {
+            throw pdf::PDFException(PDFToolTranslationContext::tr("Cannot write to the output stream '%1'.").arg(outputFile));
+        }
+        dataSize += result.data.size();
+    };
+
+    const size_t maxPendingChunks = 2 * pdf::PDFExecutionPolicy::getIdealThreadCount(pdf::PDFExecutionPolicy::Scope::Page);
+
+    try
+    {
+        pdf::PDFExecutionPolicy::executeOrdered(pdf::PDFExecutionPolicy::Scope::Page, chunks.size(), maxPendingChunks, synthesizeChunk, writeChunk);
+    }
+    catch (const pdf::PDFException& exception)
+    {
+        PDFConsole::writeError(exception.getMessage(), options.outputCodec);
         return ErrorSAPI;
     }
 
-    ISpObjectToken* voiceToken = voices.front().getVoiceToken();
-    if (!SUCCEEDED(voice->SetVoice(voiceToken)))
+    if (dataSize > std::numeric_limits<quint32>::max() - 36)
     {
-        PDFConsole::writeError(PDFToolTranslationContext::tr("Failed to set requested voice. Default voice will be used."), options.outputCodec);
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Audio book is too long for the wave format."), options.outputCodec);
+        return ErrorFailedWriteToFile;
     }
-    voices.clear();
-
-    LPCWSTR stringToSpeak = (LPCWSTR)audioString.utf16();
-
-    voice->SetOutput(stream, FALSE);
-    voice->Speak(stringToSpeak, SPF_PURGEBEFORESPEAK | SPF_PARSE_SAPI, NULL);
 
-    voice->Release();
-    stream->Release();
+    file.seek(0);
+    file.write(getWaveFileHeader(format, quint32(dataSize)));
+    file.close();
 
     return ExitSuccess;
 }
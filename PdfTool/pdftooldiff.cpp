@@ -76,12 +76,17 @@ int PDFToolDiff::execute(const PDFToolOptions& options)
     pdf::PDFClosedIntervalSet rightPages;
     rightPages.addInterval(0, rightDocument.getCatalog()->getPageCount() - 1);
 
+    std::unique_ptr<pdf::PDFDiskCache> diskCache = createDiskCache(options);
+
     pdf::PDFDiff diff(nullptr);
     diff.setOption(pdf::PDFDiff::Asynchronous, false);
+    diff.setDiskCache(diskCache.get());
     diff.setLeftDocument(&leftDocument);
     diff.setRightDocument(&rightDocument);
     diff.setPagesForLeftDocument(std::move(leftPages));
     diff.setPagesForRightDocument(std::move(rightPages));
+    diff.setOption(pdf::PDFDiff::RasterCompare, options.diffRaster);
+    diff.setRasterResolution(options.diffRasterResolution);
     diff.start();
 
     QLocale locale;
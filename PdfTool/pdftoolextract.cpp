@@ -0,0 +1,607 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftoolextract.h"
+#include "pdftoolfetchimages.h"
+#include "pdftextlayout.h"
+#include "pdftextlayoutgenerator.h"
+#include "pdftransparencyrenderer.h"
+#include "pdfexecutionpolicy.h"
+#include "pdffont.h"
+#include "pdfconstants.h"
+
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QCryptographicHash>
+
+#include <algorithm>
+
+namespace pdftool
+{
+
+static PDFToolExtractApplication s_extractApplication;
+
+struct PDFExtractedImage
+{
+    pdf::PDFInteger order = 0;
+    QByteArray hash;
+    int width = 0;
+    int height = 0;
+    qint64 size = 0;
+    QImage image;
+    QByteArray encodedData;     ///< Encoded image data (if image is written without decoding)
+    QByteArray encodedFormat;   ///< Format of encoded image data
+};
+
+struct PDFExtractedFont
+{
+    QByteArray resourceName;
+    pdf::PDFObjectReference reference;
+    QString fontName;
+    QString fontTypeName;
+    bool isEmbedded = false;
+    bool isSubset = false;
+    bool isToUnicodePresent = false;
+};
+
+struct PDFExtractedPage
+{
+    pdf::PDFInteger pageIndex = 0;
+    QRectF mediaBox;
+    QRectF cropBox;
+    QRectF bleedBox;
+    QRectF trimBox;
+    QRectF artBox;
+    QStringList texts;
+    std::vector<PDFExtractedImage> images;
+    std::vector<size_t> imageIndices;   ///< Indices of images in the list of unique images
+    std::vector<PDFExtractedFont> fonts;
+    QList<pdf::PDFRenderError> errors;
+};
+
+/// Content processor, which creates text layout of the page and also
+/// collects images, so content stream is processed only once.
+class PDFExtractContentProcessor : public pdf::PDFTextLayoutGenerator
+{
+    using BaseClass = pdf::PDFTextLayoutGenerator;
+
+public:
+    explicit PDFExtractContentProcessor(const pdf::PDFPage* page,
+                                        const pdf::PDFDocument* document,
+                                        const pdf::PDFFontCache* fontCache,
+                                        const pdf::PDFCMS* cms,
+                                        const pdf::PDFOptionalContentActivity* optionalContentActivity,
+                                        const pdf::PDFMeshQualitySettings& meshQualitySettings,
+                                        const PDFToolOptions& options,
+                                        PDFExtractedPage* extractedPage) :
+        BaseClass(pdf::PDFRenderer::IgnoreOptionalContent, page, document, fontCache, cms, optionalContentActivity, QTransform(), meshQualitySettings),
+        m_options(options),
+        m_extractedPage(extractedPage)
+    {
+
+    }
+
+protected:
+    virtual bool isContentKindSuppressed(ContentKind kind) const override;
+    virtual void performImagePainting(const QImage& image) override;
+    virtual bool performImageStreamPainting(const pdf::PDFStream* stream) override;
+
+private:
+    const PDFToolOptions& m_options;
+    PDFExtractedPage* m_extractedPage;
+};
+
+bool PDFExtractContentProcessor::isContentKindSuppressed(ContentKind kind) const
+{
+    if (kind == ContentKind::Images)
+    {
+        return false;
+    }
+
+    return BaseClass::isContentKindSuppressed(kind);
+}
+
+void PDFExtractContentProcessor::performImagePainting(const QImage& image)
+{
+    QCryptographicHash hasher(QCryptographicHash::Sha512);
+    hasher.addData(QByteArrayView(image.bits(), image.sizeInBytes()));
+
+    PDFExtractedImage extractedImage;
+    extractedImage.order = pdf::PDFInteger(m_extractedPage->images.size());
+    extractedImage.hash = hasher.result();
+    extractedImage.width = image.width();
+    extractedImage.height = image.height();
+    extractedImage.size = image.sizeInBytes();
+
+    if (!m_options.fetchImagesMetadataOnly)
+    {
+        extractedImage.image = image;
+    }
+
+    m_extractedPage->images.emplace_back(qMove(extractedImage));
+}
+
+bool PDFExtractContentProcessor::performImageStreamPainting(const pdf::PDFStream* stream)
+{
+    if (!m_options.fetchImagesPassthrough && !m_options.fetchImagesMetadataOnly)
+    {
+        return false;
+    }
+
+    // Images, which are only listed, are not decoded at all
+    const QByteArray format = m_options.fetchImagesPassthrough ? PDFToolFetchImages::getPassthroughFormat(getDocument(), stream) : QByteArray();
+    if (format.isEmpty() && !m_options.fetchImagesMetadataOnly)
+    {
+        return false;
+    }
+
+    pdf::PDFDocumentDataLoaderDecorator loader(getDocument());
+    const pdf::PDFDictionary* dictionary = stream->getDictionary();
+    const QByteArray* content = stream->getContent();
+
+    PDFExtractedImage extractedImage;
+    extractedImage.order = pdf::PDFInteger(m_extractedPage->images.size());
+    extractedImage.hash = QCryptographicHash::hash(*content, QCryptographicHash::Sha512);
+    extractedImage.width = int(loader.readIntegerFromDictionary(dictionary, "Width", 0));
+    extractedImage.height = int(loader.readIntegerFromDictionary(dictionary, "Height", 0));
+    extractedImage.size = content->size();
+
+    if (!m_options.fetchImagesMetadataOnly)
+    {
+        extractedImage.encodedData = *content;
+        extractedImage.encodedFormat = format;
+    }
+
+    m_extractedPage->images.emplace_back(qMove(extractedImage));
+    return true;
+}
+
+static QString getFontTypeName(pdf::FontType fontType)
+{
+    switch (fontType)
+    {
+        case pdf::FontType::Type0:
+            return PDFToolTranslationContext::tr("Type 0 (CID)");
+
+        case pdf::FontType::Type1:
+            return PDFToolTranslationContext::tr("Type 1 (8 bit)");
+
+        case pdf::FontType::MMType1:
+            return PDFToolTranslationContext::tr("MM Type 1 (8 bit)");
+
+        case pdf::FontType::TrueType:
+            return PDFToolTranslationContext::tr("TrueType (8 bit)");
+
+        case pdf::FontType::Type3:
+            return PDFToolTranslationContext::tr("Type 3");
+
+        default:
+            break;
+    }
+
+    return PDFToolTranslationContext::tr("Unknown");
+}
+
+/// Reads fonts from the page resources. Fonts used in the content
+/// stream are already in the font cache, so they are not parsed again.
+static void extractFonts(const pdf::PDFDocument* document, const pdf::PDFFontCache* fontCache, const pdf::PDFPage* page, PDFExtractedPage* extractedPage)
+{
+    const pdf::PDFDictionary* resourcesDictionary = document->getDictionaryFromObject(page->getResources());
+    const pdf::PDFDictionary* fontsDictionary = resourcesDictionary ? document->getDictionaryFromObject(resourcesDictionary->get("Font")) : nullptr;
+
+    if (!fontsDictionary)
+    {
+        return;
+    }
+
+    const size_t fontsCount = fontsDictionary->getCount();
+    for (size_t i = 0; i < fontsCount; ++i)
+    {
+        const pdf::PDFObject& object = fontsDictionary->getValue(i);
+
+        try
+        {
+            pdf::PDFFontPointer font = fontCache->getFont(object);
+            if (!font)
+            {
+                continue;
+            }
+
+            const pdf::FontType fontType = font->getFontType();
+            const pdf::FontDescriptor* fontDescriptor = font->getFontDescriptor();
+            const pdf::PDFFontCMap* toUnicode = font->getToUnicode();
+
+            // Font subsets have special form of name according to chapter 9.9.2 of PDF 2.0
+            // specification. The first 6 letters are uppercase letters, 7'th character is '+' sign.
+            const QString& fontName = fontDescriptor->fontName;
+            const bool isSubset = fontName.size() > 7 && fontName[6] == QChar('+') &&
+                                  std::all_of(fontName.cbegin(), std::next(fontName.cbegin(), 6), [](QChar character) { return character.isLetter() && character.isUpper(); });
+
+            PDFExtractedFont extractedFont;
+            extractedFont.resourceName = fontsDictionary->getKey(i).getString();
+            extractedFont.reference = object.isReference() ? object.getReference() : pdf::PDFObjectReference();
+            extractedFont.fontName = !fontName.isEmpty() ? fontName : QString::fromLatin1(extractedFont.resourceName);
+            extractedFont.fontTypeName = getFontTypeName(fontType);
+            extractedFont.isEmbedded = fontDescriptor->isEmbedded() || fontType == pdf::FontType::Type3;
+            extractedFont.isSubset = isSubset;
+            extractedFont.isToUnicodePresent = toUnicode && toUnicode->isValid();
+            extractedPage->fonts.emplace_back(qMove(extractedFont));
+        }
+        catch (const pdf::PDFException&)
+        {
+            // Invalid font, continue with next font
+            continue;
+        }
+    }
+}
+
+QString PDFToolExtractApplication::getStandardString(StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "extract";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Extract");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Extract text, images, fonts, page boxes and inks of the document in a single pass.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolExtractApplication::execute(const PDFToolOptions& options)
+{
+    pdf::PDFDocument document;
+    QByteArray sourceData;
+    if (!readDocument(options, document, &sourceData, false))
+    {
+        return ErrorDocumentReading;
+    }
+
+    if (!document.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::CopyContent))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Document doesn't allow to copy content."), options.outputCodec);
+        return ErrorPermissions;
+    }
+
+    QString parseError;
+    std::vector<pdf::PDFInteger> pages = options.getPageRange(document.getCatalog()->getPageCount(), parseError, true);
+
+    if (!parseError.isEmpty())
+    {
+        PDFConsole::writeError(parseError, options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QString errorMessage;
+    if (!options.fetchImagesMetadataOnly && !options.imageExportSettings.validate(&errorMessage, false, true, false))
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(&document);
+    cmsManager.setSettings(options.cmsSettings);
+    pdf::PDFCMSPointer cms = cmsManager.getCurrentCMS();
+    pdf::PDFMeshQualitySettings meshQualitySettings;
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    pdf::PDFModifiedDocument md(&document, &optionalContentActivity);
+    fontCache.setDocument(md);
+    fontCache.setCacheShrinkEnabled(nullptr, false);
+
+    // Pages are processed in parallel, each page is stored at its position,
+    // so output is in page order and doesn't depend on thread scheduling.
+    std::vector<PDFExtractedPage> extractedPages(pages.size());
+    auto processPage = [&](size_t index)
+    {
+        const pdf::PDFPage* page = document.getCatalog()->getPage(pages[index]);
+
+        PDFExtractedPage& extractedPage = extractedPages[index];
+        extractedPage.pageIndex = pages[index];
+        extractedPage.mediaBox = page->getMediaBoxMM();
+        extractedPage.cropBox = page->getCropBoxMM();
+        extractedPage.bleedBox = page->getBleedBoxMM();
+        extractedPage.trimBox = page->getTrimBoxMM();
+        extractedPage.artBox = page->getArtBoxMM();
+
+        PDFExtractContentProcessor processor(page, &document, &fontCache, cms.data(), &optionalContentActivity, meshQualitySettings, options, &extractedPage);
+        extractedPage.errors = processor.processContents();
+
+        pdf::PDFTextLayout textLayout = processor.createTextLayout();
+        pdf::PDFTextFlows textFlows = pdf::PDFTextFlow::createTextFlows(textLayout, pdf::PDFTextFlow::FlowFlags(pdf::PDFTextFlow::SeparateBlocks) | pdf::PDFTextFlow::RemoveSoftHyphen, extractedPage.pageIndex);
+        for (const pdf::PDFTextFlow& textFlow : textFlows)
+        {
+            extractedPage.texts << textFlow.getText();
+        }
+
+        extractFonts(&document, &fontCache, page, &extractedPage);
+    };
+
+    auto range = pdf::PDFIntegerRange<size_t>(0, pages.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), processPage);
+    fontCache.setCacheShrinkEnabled(nullptr, true);
+
+    // Images used on more pages are stored only once
+    const QByteArray imageFormat = options.imageWriterSettings.getCurrentFormat();
+    std::vector<PDFExtractedImage*> images;
+    std::vector<QString> imageFileNames;
+    std::map<QByteArray, size_t> imageIndices;
+    for (PDFExtractedPage& extractedPage : extractedPages)
+    {
+        for (PDFExtractedImage& image : extractedPage.images)
+        {
+            auto it = imageIndices.find(image.hash);
+            if (it == imageIndices.end())
+            {
+                it = imageIndices.emplace(image.hash, images.size()).first;
+                images.push_back(&image);
+
+                QString fileName;
+                if (!options.fetchImagesMetadataOnly)
+                {
+                    fileName = options.imageExportSettings.getOutputFileName(pdf::PDFInteger(it->second), !image.encodedData.isEmpty() ? image.encodedFormat : imageFormat);
+                }
+                imageFileNames.push_back(qMove(fileName));
+            }
+
+            extractedPage.imageIndices.push_back(it->second);
+        }
+    }
+
+    // Fonts used on more pages are listed only once
+    struct FontInfo
+    {
+        PDFExtractedFont font;
+        pdf::PDFClosedIntervalSet pages;
+    };
+    std::vector<FontInfo> fonts;
+    std::map<pdf::PDFObjectReference, size_t> fontIndices;
+    for (const PDFExtractedPage& extractedPage : extractedPages)
+    {
+        for (const PDFExtractedFont& font : extractedPage.fonts)
+        {
+            auto it = font.reference.isValid() ? fontIndices.find(font.reference) : fontIndices.end();
+            if (it == fontIndices.end())
+            {
+                if (font.reference.isValid())
+                {
+                    fontIndices[font.reference] = fonts.size();
+                }
+
+                fonts.push_back(FontInfo{ font, pdf::PDFClosedIntervalSet() });
+                fonts.back().pages.addValue(extractedPage.pageIndex + 1);
+            }
+            else
+            {
+                fonts[it->second].pages.addValue(extractedPage.pageIndex + 1);
+            }
+        }
+    }
+
+    QLocale locale;
+    QString yesText = PDFToolTranslationContext::tr("Yes");
+    QString noText = PDFToolTranslationContext::tr("No");
+
+    PDFOutputFormatter formatter(options.outputStyle);
+    formatter.beginDocument("extract", PDFToolTranslationContext::tr("Content extracted from document %1").arg(options.document));
+
+    auto writeBox = [&formatter, &locale](const QString& name, const QString& title, const QRectF& rect)
+    {
+        formatter.beginTableRow(name);
+        formatter.writeTableColumn("title", title);
+
+        if (rect.isValid())
+        {
+            formatter.writeTableColumn("value", QString("[ %1 %2 %3 %4 ]").arg(locale.toString(rect.left()), locale.toString(rect.top()), locale.toString(rect.right()), locale.toString(rect.bottom())));
+        }
+        else
+        {
+            formatter.writeTableColumn("value", "null");
+        }
+
+        formatter.endTableRow();
+    };
+
+    for (const PDFExtractedPage& extractedPage : extractedPages)
+    {
+        const int pageNumber = int(extractedPage.pageIndex + 1);
+
+        formatter.endl();
+        formatter.beginHeader("page", PDFToolTranslationContext::tr("Page %1").arg(pageNumber), pageNumber);
+
+        formatter.beginTable("page-boxes", PDFToolTranslationContext::tr("Page boxes"));
+        formatter.beginTableHeaderRow("header");
+        formatter.writeTableHeaderColumn("box", PDFToolTranslationContext::tr("Box"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("value", PDFToolTranslationContext::tr("Value"), Qt::AlignLeft);
+        formatter.endTableHeaderRow();
+        writeBox("media", PDFToolTranslationContext::tr("Media"), extractedPage.mediaBox);
+        writeBox("crop", PDFToolTranslationContext::tr("Crop"), extractedPage.cropBox);
+        writeBox("bleed", PDFToolTranslationContext::tr("Bleed"), extractedPage.bleedBox);
+        writeBox("trim", PDFToolTranslationContext::tr("Trim"), extractedPage.trimBox);
+        writeBox("art", PDFToolTranslationContext::tr("Art"), extractedPage.artBox);
+        formatter.endTable();
+
+        formatter.endl();
+        formatter.beginHeader("text", PDFToolTranslationContext::tr("Text"));
+        for (const QString& text : extractedPage.texts)
+        {
+            formatter.writeText("text", text);
+        }
+        formatter.endHeader();
+
+        if (!extractedPage.images.empty())
+        {
+            formatter.endl();
+            formatter.beginTable("images", PDFToolTranslationContext::tr("Images"));
+            formatter.beginTableHeaderRow("header");
+            formatter.writeTableHeaderColumn("order", PDFToolTranslationContext::tr("Order"), Qt::AlignLeft);
+            formatter.writeTableHeaderColumn("image-no", PDFToolTranslationContext::tr("Image No."), Qt::AlignLeft);
+            formatter.writeTableHeaderColumn("width", PDFToolTranslationContext::tr("Width [pixels]"), Qt::AlignLeft);
+            formatter.writeTableHeaderColumn("height", PDFToolTranslationContext::tr("Height [pixels]"), Qt::AlignLeft);
+            formatter.writeTableHeaderColumn("size", PDFToolTranslationContext::tr("Size [bytes]"), Qt::AlignLeft);
+            formatter.writeTableHeaderColumn("stored-to", PDFToolTranslationContext::tr("Stored to"), Qt::AlignLeft);
+            formatter.endTableHeaderRow();
+
+            for (size_t i = 0; i < extractedPage.images.size(); ++i)
+            {
+                const PDFExtractedImage& image = extractedPage.images[i];
+                const size_t imageIndex = extractedPage.imageIndices[i];
+
+                formatter.beginTableRow("image", int(i));
+                formatter.writeTableColumn("order", locale.toString(image.order + 1), Qt::AlignRight);
+                formatter.writeTableColumn("image-no", locale.toString(imageIndex + 1), Qt::AlignRight);
+                formatter.writeTableColumn("width", locale.toString(image.width), Qt::AlignRight);
+                formatter.writeTableColumn("height", locale.toString(image.height), Qt::AlignRight);
+                formatter.writeTableColumn("size", locale.toString(image.size), Qt::AlignRight);
+                formatter.writeTableColumn("stored-to", imageFileNames[imageIndex]);
+                formatter.endTableRow();
+            }
+
+            formatter.endTable();
+        }
+
+        formatter.endHeader();
+
+        for (const pdf::PDFRenderError& error : extractedPage.errors)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Page %1: %2").arg(pageNumber).arg(error.message), options.outputCodec);
+        }
+    }
+
+    formatter.endl();
+    formatter.beginTable("fonts", PDFToolTranslationContext::tr("Fonts"));
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("no", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("font-name", PDFToolTranslationContext::tr("Font Name"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("font-type", PDFToolTranslationContext::tr("Font Type"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("pages", PDFToolTranslationContext::tr("Pages"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("is-embedded", PDFToolTranslationContext::tr("Embedded"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("is-subset", PDFToolTranslationContext::tr("Subset"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("is-unicode", PDFToolTranslationContext::tr("Unicode"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("object-no", PDFToolTranslationContext::tr("Object"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("generation-no", PDFToolTranslationContext::tr("Gen."), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (size_t i = 0; i < fonts.size(); ++i)
+    {
+        const FontInfo& info = fonts[i];
+        const bool isReference = info.font.reference.isValid();
+
+        formatter.beginTableRow("font", int(i + 1));
+        formatter.writeTableColumn("no", locale.toString(i + 1), Qt::AlignRight);
+        formatter.writeTableColumn("font-name", info.font.fontName);
+        formatter.writeTableColumn("font-type", info.font.fontTypeName);
+        formatter.writeTableColumn("pages", info.pages.toText(true));
+        formatter.writeTableColumn("is-embedded", info.font.isEmbedded ? yesText : noText);
+        formatter.writeTableColumn("is-subset", info.font.isSubset ? yesText : noText);
+        formatter.writeTableColumn("is-unicode", info.font.isToUnicodePresent ? yesText : noText);
+        formatter.writeTableColumn("object-no", isReference ? locale.toString(info.font.reference.objectNumber) : QString("--"), Qt::AlignRight);
+        formatter.writeTableColumn("generation-no", isReference ? locale.toString(info.font.reference.generation) : QString("--"), Qt::AlignRight);
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+
+    // Inks are determined from the color spaces of the page resources
+    pdf::PDFInkMapper mapper(&cmsManager, &document);
+    mapper.createSpotColors(true);
+    std::vector<pdf::PDFInkMapper::ColorInfo> colorInfos = mapper.getSeparations(4, true);
+
+    formatter.endl();
+    formatter.beginTable("inks", PDFToolTranslationContext::tr("Inks"));
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("index", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("id", PDFToolTranslationContext::tr("Identifier"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("name", PDFToolTranslationContext::tr("Name"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("is-spot", PDFToolTranslationContext::tr("Spot"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("color", PDFToolTranslationContext::tr("Color"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    int colorIndex = 0;
+    for (const pdf::PDFInkMapper::ColorInfo& colorInfo : colorInfos)
+    {
+        formatter.beginTableRow("ink", ++colorIndex);
+        formatter.writeTableColumn("index", locale.toString(colorIndex), Qt::AlignRight);
+        formatter.writeTableColumn("id", colorInfo.name.toPercentEncoding(" "));
+        formatter.writeTableColumn("name", colorInfo.textName);
+        formatter.writeTableColumn("is-spot", colorInfo.isSpot ? yesText : noText, Qt::AlignCenter);
+        formatter.writeTableColumn("color", colorInfo.color.name(), Qt::AlignLeft);
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+
+    formatter.endDocument();
+    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+
+    if (options.fetchImagesMetadataOnly)
+    {
+        return ExitSuccess;
+    }
+
+    // Store images to the disk files
+    auto saveImage = [&](size_t index)
+    {
+        const PDFExtractedImage& image = *images[index];
+        const QString& fileName = imageFileNames[index];
+
+        if (!image.encodedData.isEmpty())
+        {
+            // Encoded image is written as it is
+            QFile file(fileName);
+            if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(image.encodedData) != image.encodedData.size())
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(file.errorString()), options.outputCodec);
+            }
+            return;
+        }
+
+        QImageWriter imageWriter(fileName, imageFormat);
+        imageWriter.setSubType(options.imageWriterSettings.getCurrentSubtype());
+        imageWriter.setCompression(options.imageWriterSettings.getCompression());
+        imageWriter.setQuality(options.imageWriterSettings.getQuality());
+        imageWriter.setOptimizedWrite(options.imageWriterSettings.hasOptimizedWrite());
+        imageWriter.setProgressiveScanWrite(options.imageWriterSettings.hasProgressiveScanWrite());
+
+        if (!imageWriter.write(image.image))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(imageWriter.errorString()), options.outputCodec);
+        }
+    };
+
+    auto imageRange = pdf::PDFIntegerRange<size_t>(0, images.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, imageRange.begin(), imageRange.end(), saveImage);
+
+    return ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolExtractApplication::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument | PageSelector | ImageWriterSettings | ImageExportSettingsFiles | ColorManagementSystem | FetchImages;
+}
+
+}   // namespace pdftool
@@ -20,6 +20,7 @@
 #include "pdfconstants.h"
 #include "pdfexecutionpolicy.h"
 
+#include <QFile>
 #include <QCryptographicHash>
 
 namespace pdftool
@@ -40,10 +41,14 @@ public:
                                                QTransform pagePointToDevicePointMatrix,
                                                const pdf::PDFMeshQualitySettings& meshQualitySettings,
                                                pdf::PDFInteger pageIndex,
+                                               bool passthrough,
+                                               bool metadataOnly,
                                                PDFToolFetchImages* tool) :
         BaseClass(page, document, fontCache, cms, optionalContentActivity, pagePointToDevicePointMatrix, meshQualitySettings),
         m_pageIndex(pageIndex),
         m_order(0),
+        m_passthrough(passthrough),
+        m_metadataOnly(metadataOnly),
         m_tool(tool)
     {
 
@@ -53,10 +58,13 @@ protected:
     virtual bool isContentSuppressedByOC(pdf::PDFObjectReference ocgOrOcmd) override;
     virtual bool isContentKindSuppressed(ContentKind kind) const override;
     virtual void performImagePainting(const QImage& image) override;
+    virtual bool performImageStreamPainting(const pdf::PDFStream* stream) override;
 
 private:
     pdf::PDFInteger m_pageIndex;
     pdf::PDFInteger m_order;
+    bool m_passthrough;
+    bool m_metadataOnly;
     PDFToolFetchImages* m_tool;
 };
 
@@ -95,6 +103,114 @@ void PDFImageContentExtractorProcessor::performImagePainting(const QImage& image
     m_tool->onImageExtracted(m_pageIndex, m_order++, image);
 }
 
+bool PDFImageContentExtractorProcessor::performImageStreamPainting(const pdf::PDFStream* stream)
+{
+    if (!m_passthrough && !m_metadataOnly)
+    {
+        return false;
+    }
+
+    // Images, which are only listed, are not decoded at all
+    const QByteArray format = m_passthrough ? PDFToolFetchImages::getPassthroughFormat(getDocument(), stream) : QByteArray();
+    if (format.isEmpty() && !m_metadataOnly)
+    {
+        return false;
+    }
+
+    pdf::PDFDocumentDataLoaderDecorator loader(getDocument());
+    const pdf::PDFDictionary* dictionary = stream->getDictionary();
+    const int width = int(loader.readIntegerFromDictionary(dictionary, "Width", 0));
+    const int height = int(loader.readIntegerFromDictionary(dictionary, "Height", 0));
+
+    m_tool->onEncodedImageExtracted(m_pageIndex, m_order++, width, height, *stream->getContent(), format);
+    return true;
+}
+
+QByteArray PDFToolFetchImages::getPassthroughFormat(const pdf::PDFDocument* document, const pdf::PDFStream* stream)
+{
+    const pdf::PDFDictionary* dictionary = stream->getDictionary();
+    pdf::PDFDocumentDataLoaderDecorator loader(document);
+
+    if (dictionary->hasKey("Mask") || dictionary->hasKey("SMask") || dictionary->hasKey("Decode") ||
+        loader.readBooleanFromDictionary(dictionary, "ImageMask", false) ||
+        loader.readIntegerFromDictionary(dictionary, "SMaskInData", 0) != 0)
+    {
+        return QByteArray();
+    }
+
+    // Image data must be encoded only by the image filter, other
+    // filters (including the crypt filter) require decoding.
+    QByteArray filterName;
+    const pdf::PDFObject& filters = document->getObject(dictionary->get(pdf::PDF_STREAM_DICT_FILTER));
+    if (filters.isName())
+    {
+        filterName = filters.getString();
+    }
+    else if (filters.isArray() && filters.getArray()->getCount() == 1)
+    {
+        const pdf::PDFObject& filter = document->getObject(filters.getArray()->getItem(0));
+        if (filter.isName())
+        {
+            filterName = filter.getString();
+        }
+    }
+
+    const bool isJPEG = filterName == "DCTDecode" || filterName == "DCT";
+    const bool isJPEG2000 = filterName == "JPXDecode";
+    if (!isJPEG && !isJPEG2000)
+    {
+        return QByteArray();
+    }
+
+    // Determine number of color components of the color space, JPEG 2000
+    // images can have color space specified in the image data.
+    pdf::PDFInteger colorComponents = 0;
+    const pdf::PDFObject& colorSpace = document->getObject(dictionary->get("ColorSpace"));
+    if (colorSpace.isNull())
+    {
+        if (!isJPEG2000)
+        {
+            return QByteArray();
+        }
+    }
+    else if (colorSpace.isName())
+    {
+        const QByteArray colorSpaceName = colorSpace.getString();
+        if (colorSpaceName == "DeviceGray")
+        {
+            colorComponents = 1;
+        }
+        else if (colorSpaceName == "DeviceRGB")
+        {
+            colorComponents = 3;
+        }
+    }
+    else if (colorSpace.isArray() && colorSpace.getArray()->getCount() == 2)
+    {
+        const pdf::PDFArray* colorSpaceArray = colorSpace.getArray();
+        const pdf::PDFObject& colorSpaceName = document->getObject(colorSpaceArray->getItem(0));
+        const pdf::PDFObject& profile = document->getObject(colorSpaceArray->getItem(1));
+        if (colorSpaceName.isName() && colorSpaceName.getString() == "ICCBased" && profile.isStream())
+        {
+            colorComponents = loader.readIntegerFromDictionary(profile.getStream()->getDictionary(), "N", 0);
+        }
+    }
+
+    if (!colorSpace.isNull() && colorComponents != 1 && colorComponents != 3)
+    {
+        return QByteArray();
+    }
+
+    if (isJPEG)
+    {
+        return "jpg";
+    }
+
+    // JPEG 2000 image can be stored as JP2 file or as a raw codestream
+    const QByteArray* content = stream->getContent();
+    return content->startsWith(QByteArray::fromHex("FF4FFF51")) ? "j2k" : "jp2";
+}
+
 QString PDFToolFetchImages::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
 {
     switch (standardString)
@@ -142,7 +258,7 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
 
     QString errorMessage;
     Options optionFlags = getOptionsFlags();
-    if (!options.imageExportSettings.validate(&errorMessage, false, optionFlags.testFlag(ImageExportSettingsFiles), optionFlags.testFlag(ImageExportSettingsResolution)))
+    if (!options.fetchImagesMetadataOnly && !options.imageExportSettings.validate(&errorMessage, false, optionFlags.testFlag(ImageExportSettingsFiles), optionFlags.testFlag(ImageExportSettingsResolution)))
     {
         PDFConsole::writeError(errorMessage, options.outputCodec);
         return ErrorInvalidArguments;
@@ -173,7 +289,7 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
         Q_ASSERT(page);
 
         PDFImageContentExtractorProcessor processor(page, &document, &fontCache, cms.data(), &optionalContentActivity,
-                                                    QTransform(), meshQualitySettings, pageIndex, this);
+                                                    QTransform(), meshQualitySettings, pageIndex, options.fetchImagesPassthrough, options.fetchImagesMetadataOnly, this);
         processor.processContents();
     };
 
@@ -207,15 +323,19 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
     for (size_t i = 0; i < m_images.size(); ++i)
     {
         Image& image = m_images[i];
-        image.fileName = options.imageExportSettings.getOutputFileName(pdf::PDFInteger(i), options.imageWriterSettings.getCurrentFormat());
+        const bool isEncoded = !image.encodedData.isEmpty();
+        if (!options.fetchImagesMetadataOnly)
+        {
+            image.fileName = options.imageExportSettings.getOutputFileName(pdf::PDFInteger(i), isEncoded ? image.encodedFormat : options.imageWriterSettings.getCurrentFormat());
+        }
 
         formatter.beginTableRow("image", int(i));
 
         formatter.writeTableColumn("item-no", locale.toString(i + 1), Qt::AlignRight);
         formatter.writeTableColumn("page-no", locale.toString(image.pageIndex + 1), Qt::AlignRight);
-        formatter.writeTableColumn("width", locale.toString(image.image.width()), Qt::AlignRight);
-        formatter.writeTableColumn("height", locale.toString(image.image.height()), Qt::AlignRight);
-        formatter.writeTableColumn("size", locale.toString(image.image.sizeInBytes()), Qt::AlignRight);
+        formatter.writeTableColumn("width", locale.toString(image.width), Qt::AlignRight);
+        formatter.writeTableColumn("height", locale.toString(image.height), Qt::AlignRight);
+        formatter.writeTableColumn("size", locale.toString(isEncoded ? image.encodedData.size() : image.image.sizeInBytes()), Qt::AlignRight);
         formatter.writeTableColumn("stored-to", image.fileName);
 
         formatter.endTableRow();
@@ -231,6 +351,17 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
     {
         Image& image = m_images[index];
 
+        if (!image.encodedData.isEmpty())
+        {
+            // Encoded image is written as it is
+            QFile file(image.fileName);
+            if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(image.encodedData) != image.encodedData.size())
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(image.fileName).arg(file.errorString()), options.outputCodec);
+            }
+            return;
+        }
+
         QImageWriter imageWriter(image.fileName, options.imageWriterSettings.getCurrentFormat());
         imageWriter.setSubType(options.imageWriterSettings.getCurrentSubtype());
         imageWriter.setCompression(options.imageWriterSettings.getCompression());
@@ -244,15 +375,18 @@ int PDFToolFetchImages::execute(const PDFToolOptions& options)
         }
     };
 
-    auto imageRange = pdf::PDFIntegerRange<size_t>(0, m_images.size());
-    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, imageRange.begin(), imageRange.end(), saveImage);
+    if (!options.fetchImagesMetadataOnly)
+    {
+        auto imageRange = pdf::PDFIntegerRange<size_t>(0, m_images.size());
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, imageRange.begin(), imageRange.end(), saveImage);
+    }
 
     return ExitSuccess;
 }
 
 PDFToolAbstractApplication::Options PDFToolFetchImages::getOptionsFlags() const
 {
-    return ConsoleFormat | OpenDocument | PageSelector | ImageWriterSettings | ImageExportSettingsFiles | ColorManagementSystem;
+    return ConsoleFormat | OpenDocument | PageSelector | ImageWriterSettings | ImageExportSettingsFiles | ColorManagementSystem | FetchImages;
 }
 
 void PDFToolFetchImages::onImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, const QImage& image)
@@ -260,26 +394,45 @@ void PDFToolFetchImages::onImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInt
     QCryptographicHash hasher(QCryptographicHash::Sha512);
     QByteArrayView imageData(image.bits(), image.sizeInBytes());
     hasher.addData(imageData);
-    QByteArray hash = hasher.result();
 
+    Image imageStructure;
+    imageStructure.hash = hasher.result();
+    imageStructure.pageIndex = pageIndex;
+    imageStructure.order = order;
+    imageStructure.width = image.width();
+    imageStructure.height = image.height();
+    imageStructure.image = image;
+    addImage(qMove(imageStructure));
+}
+
+void PDFToolFetchImages::onEncodedImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, int width, int height, const QByteArray& data, const QByteArray& format)
+{
+    Image imageStructure;
+    imageStructure.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha512);
+    imageStructure.pageIndex = pageIndex;
+    imageStructure.order = order;
+    imageStructure.width = width;
+    imageStructure.height = height;
+    imageStructure.encodedData = data;
+    imageStructure.encodedFormat = format;
+    addImage(qMove(imageStructure));
+}
+
+void PDFToolFetchImages::addImage(Image image)
+{
     QMutexLocker lock(&m_mutex);
-    auto it = std::find_if(m_images.begin(), m_images.end(), [&hash](const Image& image) { return image.hash == hash; });
+    auto it = std::find_if(m_images.begin(), m_images.end(), [&image](const Image& currentImage) { return currentImage.hash == image.hash; });
     if (it == m_images.cend())
     {
-        Image imageStructure;
-        imageStructure.hash = hash;
-        imageStructure.pageIndex = pageIndex;
-        imageStructure.order = order;
-        imageStructure.image = image;
-        m_images.emplace_back(qMove(imageStructure));
+        m_images.emplace_back(qMove(image));
     }
     else
     {
         Image& imageStructure = *it;
-        if (imageStructure.pageIndex > pageIndex)
+        if (imageStructure.pageIndex > image.pageIndex)
         {
-            imageStructure.pageIndex = pageIndex;
-            imageStructure.order = order;
+            imageStructure.pageIndex = image.pageIndex;
+            imageStructure.order = image.order;
         }
     }
 }
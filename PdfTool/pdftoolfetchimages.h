@@ -34,17 +34,42 @@ public:
 
     void onImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, const QImage& image);
 
+    /// Adds encoded image, which is written to the file without decoding
+    /// \param pageIndex Page index
+    /// \param order Order of the image on the page
+    /// \param width Width of the image
+    /// \param height Height of the image
+    /// \param data Encoded image data
+    /// \param format Image file format (file suffix)
+    void onEncodedImageExtracted(pdf::PDFInteger pageIndex, pdf::PDFInteger order, int width, int height, const QByteArray& data, const QByteArray& format);
+
+    /// Returns file format (file suffix), to which image stream can be written
+    /// without decoding, or empty byte array, if image stream must be decoded.
+    /// Image is written without decoding only, if its appearance is fully
+    /// determined by the image file, i.e. it has no masks, no decode array, and
+    /// its color space is gray or RGB.
+    /// \param document Document
+    /// \param stream Image stream
+    static QByteArray getPassthroughFormat(const pdf::PDFDocument* document, const pdf::PDFStream* stream);
+
 private:
     struct Image
     {
         QByteArray hash;
         pdf::PDFInteger pageIndex = 0;
         pdf::PDFInteger order = 0;
+        int width = 0;
+        int height = 0;
         QImage image;
+        QByteArray encodedData;     ///< Encoded image data (if image is written without decoding)
+        QByteArray encodedFormat;   ///< Format of encoded image data
         QString fileName;
     };
     using Images = std::vector<Image>;
 
+    /// Adds image, if same image isn't already present
+    void addImage(Image image);
+
     QMutex m_mutex;
     Images m_images;
 };
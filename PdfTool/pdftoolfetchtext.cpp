@@ -18,11 +18,26 @@
 #include "pdftoolfetchtext.h"
 #include "pdfdocumenttextflow.h"
 
+#include <QThread>
+
 namespace pdftool
 {
 
 static PDFToolFetchTextApplication s_fetchTextApplication;
 
+static bool isTextShown(const pdf::PDFDocumentTextFlow::Item& item, const PDFToolOptions& options)
+{
+    return (item.flags.testFlag(pdf::PDFDocumentTextFlow::Text)) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageStart) && options.textShowPageNumbers) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageEnd) && options.textShowPageNumbers) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureTitle) && options.textShowStructTitles) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureLanguage) && options.textShowStructLanguage) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureAlternativeDescription) && options.textShowStructAlternativeDescription) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureExpandedForm) && options.textShowStructExpandedForm) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureActualText) && options.textShowStructActualText) ||
+           (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructurePhoneme) && options.textShowStructPhoneme);
+}
+
 QString PDFToolFetchTextApplication::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
 {
     switch (standardString)
@@ -68,10 +83,25 @@ int PDFToolFetchTextApplication::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
+    if (options.textStreaming)
+    {
+        return executeStreaming(options, document, pages);
+    }
+
+    std::unique_ptr<pdf::PDFDiskCache> diskCache = createDiskCache(options);
+
     pdf::PDFDocumentTextFlowFactory factory;
+    factory.setDiskCache(diskCache.get());
     pdf::PDFDocumentTextFlow documentTextFlow = factory.create(&document, pages, options.textAnalysisAlgorithm);
 
+    for (const pdf::PDFRenderError& error : factory.getErrors())
+    {
+        PDFConsole::writeError(error.message, options.outputCodec);
+    }
+
+    // Text of large documents is written in parts, as it is formatted
     PDFOutputFormatter formatter(options.outputStyle);
+    formatter.setStreamingMode(options.outputCodec);
     formatter.beginDocument("text-extraction", QString());
     formatter.endl();
 
@@ -84,17 +114,7 @@ int PDFToolFetchTextApplication::execute(const PDFToolOptions& options)
 
         if (!item.text.isEmpty())
         {
-            bool showText = (item.flags.testFlag(pdf::PDFDocumentTextFlow::Text)) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageStart) && options.textShowPageNumbers) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageEnd) && options.textShowPageNumbers) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureTitle) && options.textShowStructTitles) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureLanguage) && options.textShowStructLanguage) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureAlternativeDescription) && options.textShowStructAlternativeDescription) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureExpandedForm) && options.textShowStructExpandedForm) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructureActualText) && options.textShowStructActualText) ||
-                            (item.flags.testFlag(pdf::PDFDocumentTextFlow::StructurePhoneme) && options.textShowStructPhoneme);
-
-            if (showText)
+            if (isTextShown(item, options))
             {
                 formatter.writeText("text", item.text);
             }
@@ -112,20 +132,74 @@ int PDFToolFetchTextApplication::execute(const PDFToolOptions& options)
     }
 
     formatter.endDocument();
-
-    for (const pdf::PDFRenderError& error : factory.getErrors())
-    {
-        PDFConsole::writeError(error.message, options.outputCodec);
-    }
-
-    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    formatter.flush();
 
     return ExitSuccess;
 }
 
 PDFToolAbstractApplication::Options PDFToolFetchTextApplication::getOptionsFlags() const
 {
-    return ConsoleFormat | OpenDocument | PageSelector | TextAnalysis | TextShow;
+    return ConsoleFormat | OpenDocument | PageSelector | TextAnalysis | TextShow | TextStream;
+}
+
+int PDFToolFetchTextApplication::executeStreaming(const PDFToolOptions& options, const pdf::PDFDocument& document, const std::vector<pdf::PDFInteger>& pages)
+{
+    pdf::PDFDocumentTextFlowFactory::Algorithm algorithm = options.textAnalysisAlgorithm;
+    switch (algorithm)
+    {
+        case pdf::PDFDocumentTextFlowFactory::Algorithm::Auto:
+            algorithm = pdf::PDFDocumentTextFlowFactory::Algorithm::Layout;
+            break;
+
+        case pdf::PDFDocumentTextFlowFactory::Algorithm::Structure:
+            // Structure tree spans whole document, it can't be processed page by page
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Structure text analysis algorithm can't be used in streaming mode."), options.outputCodec);
+            return ErrorInvalidArguments;
+
+        default:
+            break;
+    }
+
+    // Pages are processed in chunks, pages of each chunk are processed in parallel
+    // by the text flow factory. Text of the chunk is written before next chunk is
+    // processed, so only text of the chunk is held in the memory.
+    const size_t lookAhead = options.textStreamingLookAhead > 0 ? size_t(options.textStreamingLookAhead) : size_t(qMax(QThread::idealThreadCount(), 1) * 4);
+    std::unique_ptr<pdf::PDFDiskCache> diskCache = createDiskCache(options);
+
+    for (auto it = pages.cbegin(); it != pages.cend();)
+    {
+        auto itEnd = std::next(it, std::min<std::ptrdiff_t>(lookAhead, std::distance(it, pages.cend())));
+        std::vector<pdf::PDFInteger> chunkPages(it, itEnd);
+        it = itEnd;
+
+        pdf::PDFDocumentTextFlowFactory factory;
+        factory.setDiskCache(diskCache.get());
+        pdf::PDFDocumentTextFlow documentTextFlow = factory.create(&document, chunkPages, algorithm);
+
+        QString text;
+        for (const pdf::PDFDocumentTextFlow::Item& item : documentTextFlow.getItems())
+        {
+            if (!item.text.isEmpty() && isTextShown(item, options))
+            {
+                text += item.text;
+                text += QChar('\n');
+            }
+
+            if (item.flags.testFlag(pdf::PDFDocumentTextFlow::PageEnd))
+            {
+                text += QChar('\n');
+            }
+        }
+
+        for (const pdf::PDFRenderError& error : factory.getErrors())
+        {
+            PDFConsole::writeError(error.message, options.outputCodec);
+        }
+
+        PDFConsole::writeText(text, options.outputCodec);
+    }
+
+    return ExitSuccess;
 }
 
 }   // namespace pdftool
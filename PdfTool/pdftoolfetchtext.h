@@ -29,6 +29,10 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+
+private:
+    /// Writes text of the pages as soon as text of the pages is extracted
+    int executeStreaming(const PDFToolOptions& options, const pdf::PDFDocument& document, const std::vector<pdf::PDFInteger>& pages);
 };
 
 }   // namespace pdftool
@@ -0,0 +1,182 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdftoolfill.h"
+#include "pdfformfiller.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+
+#include <set>
+
+namespace pdftool
+{
+
+static PDFToolFill s_fillApplication;
+
+QString PDFToolFill::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "fill";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Fill Form");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Fill form of the template document with values of each data record (mail-merge). Records are filled in parallel.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolFill::execute(const PDFToolOptions& options)
+{
+    if (options.fillDataFiles.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No data file specified."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    if (options.fillOutputFileName.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No output file specified."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    pdf::PDFFormFillerRecords records;
+    for (const QString& fileName : options.fillDataFiles)
+    {
+        pdf::PDFOperationResult result = pdf::PDFFormFiller::readRecords(fileName, records);
+        if (!result)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot read data file '%1'. %2").arg(fileName, result.getErrorMessage()), options.outputCodec);
+            return ErrorInvalidArguments;
+        }
+    }
+
+    if (records.size() > 1 && !options.fillOutputFileName.contains('#'))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Output file name must contain character '#', which is replaced by the record number."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    pdf::PDFDocument document;
+    if (!readDocument(options, document, nullptr, false))
+    {
+        return ErrorDocumentReading;
+    }
+
+    auto getFileName = [&options](size_t index)
+    {
+        QString fileName = options.fillOutputFileName;
+        return fileName.replace('#', QString::number(index + 1));
+    };
+
+    // Directories are created upfront, so workers don't create them concurrently
+    std::set<QString> directories;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        directories.insert(QFileInfo(getFileName(i)).absolutePath());
+    }
+
+    for (const QString& directory : directories)
+    {
+        if (!QDir().mkpath(directory))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot create output directory '%1'.").arg(directory), options.outputCodec);
+            return ErrorFailedWriteToFile;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    pdf::PDFFormFiller filler(&document);
+    std::vector<pdf::PDFOperationResult> results = filler.fillAndWrite(records, getFileName);
+
+    const qint64 time = timer.elapsed();
+
+    PDFOutputFormatter formatter(options.outputStyle);
+    formatter.beginDocument("fill", PDFToolTranslationContext::tr("Filling of %1 records").arg(records.size()));
+    formatter.endl();
+
+    int failedCount = 0;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        if (!results[i])
+        {
+            ++failedCount;
+        }
+    }
+
+    // Only failed records are listed, there can be a lot of records
+    if (failedCount > 0)
+    {
+        formatter.beginTable("failed-records", PDFToolTranslationContext::tr("Failed records"));
+
+        formatter.beginTableHeaderRow("header");
+        formatter.writeTableHeaderColumn("no", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("file", PDFToolTranslationContext::tr("File"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("error", PDFToolTranslationContext::tr("Error"), Qt::AlignLeft);
+        formatter.endTableHeaderRow();
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            if (results[i])
+            {
+                continue;
+            }
+
+            formatter.beginTableRow("record", int(i + 1));
+            formatter.writeTableColumn("no", QString::number(i + 1), Qt::AlignRight);
+            formatter.writeTableColumn("file", getFileName(i));
+            formatter.writeTableColumn("error", results[i].getErrorMessage());
+            formatter.endTableRow();
+        }
+
+        formatter.endTable();
+        formatter.endl();
+    }
+
+    formatter.writeText("records", PDFToolTranslationContext::tr("Records: %1").arg(records.size()));
+    formatter.writeText("failed", PDFToolTranslationContext::tr("Failed records: %1").arg(failedCount));
+    formatter.writeText("time", PDFToolTranslationContext::tr("Time: %1 [ms]").arg(time));
+    formatter.endDocument();
+
+    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    return failedCount > 0 ? ErrorUnknown : ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolFill::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument;
+}
+
+PDFToolAbstractApplication::ExtendedOptions PDFToolFill::getExtendedOptionsFlags() const
+{
+    return FormFill;
+}
+
+}   // namespace pdftool
@@ -0,0 +1,603 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftoolindex.h"
+#include "pdfdocumentreader.h"
+#include "pdfexecutionpolicy.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDirIterator>
+#include <QCryptographicHash>
+
+#include <map>
+#include <atomic>
+#include <numeric>
+
+namespace pdftool
+{
+
+static PDFToolIndexApplication s_indexApplication;
+static PDFToolSearchApplication s_searchApplication;
+
+/// Persistent text index of documents in the directory. Text items of each
+/// document are stored together with bounding boxes of characters, so hits
+/// can be located on the page. Each document is identified by the hash
+/// of its file, so unchanged documents (even renamed or moved ones)
+/// are not processed again, when index is rebuilt.
+class PDFToolTextIndex
+{
+public:
+    struct TextItem
+    {
+        pdf::PDFInteger pageIndex = 0;
+        QString text;
+        QRectF boundingRect;
+        std::vector<QRectF> characterBoundingRects;
+    };
+
+    struct Document
+    {
+        QString fileName; ///< File name relative to the indexed directory
+        QByteArray hash;
+        QByteArray compressedItems;
+        std::vector<TextItem> items;
+    };
+
+    static constexpr const char* DEFAULT_INDEX_FILE_NAME = ".pdf4qt-index";
+
+    /// Loads index from the file. If index can't be loaded,
+    /// or it has incompatible version, false is returned.
+    /// \param fileName Index file name
+    bool load(const QString& fileName);
+
+    /// Saves index to the file. Items of documents are compressed
+    /// before saving, if they are not already compressed.
+    /// \param fileName Index file name
+    bool save(const QString& fileName);
+
+    QString directory;
+    std::vector<Document> documents;
+
+private:
+    static constexpr quint32 SERIALIZATION_MAGIC = 0x50444958;
+    static constexpr quint32 SERIALIZATION_VERSION = 1;
+
+    static QByteArray compressItems(const std::vector<TextItem>& items);
+    static std::vector<TextItem> decompressItems(const QByteArray& compressedItems, bool* ok);
+};
+
+QByteArray PDFToolTextIndex::compressItems(const std::vector<TextItem>& items)
+{
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << quint64(items.size());
+
+        for (const TextItem& item : items)
+        {
+            stream << qint64(item.pageIndex);
+            stream << item.text;
+            stream << item.boundingRect;
+            stream << quint64(item.characterBoundingRects.size());
+
+            for (const QRectF& rect : item.characterBoundingRects)
+            {
+                stream << rect;
+            }
+        }
+    }
+
+    return qCompress(data);
+}
+
+std::vector<PDFToolTextIndex::TextItem> PDFToolTextIndex::decompressItems(const QByteArray& compressedItems, bool* ok)
+{
+    std::vector<TextItem> items;
+
+    QByteArray data = qUncompress(compressedItems);
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint64 itemCount = 0;
+    stream >> itemCount;
+
+    for (quint64 i = 0; i < itemCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        TextItem item;
+        qint64 pageIndex = 0;
+        quint64 rectCount = 0;
+        stream >> pageIndex;
+        stream >> item.text;
+        stream >> item.boundingRect;
+        stream >> rectCount;
+
+        for (quint64 j = 0; j < rectCount && stream.status() == QDataStream::Ok; ++j)
+        {
+            QRectF rect;
+            stream >> rect;
+            item.characterBoundingRects.push_back(rect);
+        }
+
+        item.pageIndex = pageIndex;
+        items.push_back(qMove(item));
+    }
+
+    *ok = !data.isEmpty() && stream.status() == QDataStream::Ok;
+    return items;
+}
+
+bool PDFToolTextIndex::load(const QString& fileName)
+{
+    directory.clear();
+    documents.clear();
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic;
+    stream >> version;
+
+    if (magic != SERIALIZATION_MAGIC || version != SERIALIZATION_VERSION)
+    {
+        return false;
+    }
+
+    quint64 documentCount = 0;
+    stream >> directory;
+    stream >> documentCount;
+
+    for (quint64 i = 0; i < documentCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        Document document;
+        stream >> document.fileName;
+        stream >> document.hash;
+        stream >> document.compressedItems;
+        documents.push_back(qMove(document));
+    }
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        documents.clear();
+        return false;
+    }
+
+    // Decompress documents in parallel, documents are independent
+    std::atomic_bool isValid = true;
+    auto decompressDocument = [&isValid](Document& document)
+    {
+        bool ok = false;
+        document.items = decompressItems(document.compressedItems, &ok);
+
+        if (!ok)
+        {
+            isValid = false;
+        }
+    };
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, documents.begin(), documents.end(), decompressDocument);
+
+    if (!isValid)
+    {
+        documents.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool PDFToolTextIndex::save(const QString& fileName)
+{
+    auto compressDocument = [](Document& document)
+    {
+        if (document.compressedItems.isEmpty())
+        {
+            document.compressedItems = compressItems(document.items);
+        }
+    };
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, documents.begin(), documents.end(), compressDocument);
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << SERIALIZATION_MAGIC;
+    stream << SERIALIZATION_VERSION;
+    stream << directory;
+    stream << quint64(documents.size());
+
+    for (const Document& document : documents)
+    {
+        stream << document.fileName;
+        stream << document.hash;
+        stream << document.compressedItems;
+    }
+
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+/// Returns text, in which whitespace sequences are replaced by single space
+/// and soft hyphens are removed. For each character of the returned text,
+/// its position in the original text is stored.
+/// \param text Text
+/// \param[out] positions Positions of characters in the original text
+static QString normalizeText(const QString& text, std::vector<qsizetype>& positions)
+{
+    QString result;
+    result.reserve(text.size());
+    positions.clear();
+    positions.reserve(text.size());
+
+    // Leading whitespace is skipped
+    bool isLastSpace = true;
+    for (qsizetype i = 0; i < text.size(); ++i)
+    {
+        const QChar character = text[i];
+        if (character.isSpace())
+        {
+            if (!isLastSpace)
+            {
+                result.push_back(QChar(' '));
+                positions.push_back(i);
+                isLastSpace = true;
+            }
+        }
+        else if (character != QChar(0x00AD))
+        {
+            result.push_back(character);
+            positions.push_back(i);
+            isLastSpace = false;
+        }
+    }
+
+    return result;
+}
+
+QString PDFToolIndexApplication::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "index";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Index documents");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Create or update text index of documents in directory. Only new or changed documents are processed.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolIndexApplication::execute(const PDFToolOptions& options)
+{
+    QDir directory(options.textIndexDirectory);
+    if (options.textIndexDirectory.isEmpty() || !directory.exists())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Directory '%1' doesn't exist.").arg(options.textIndexDirectory), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    QString indexFileName = options.textIndexFile;
+    if (indexFileName.isEmpty())
+    {
+        indexFileName = directory.filePath(PDFToolTextIndex::DEFAULT_INDEX_FILE_NAME);
+    }
+
+    // Missing or incompatible index is simply rebuilt from scratch
+    PDFToolTextIndex oldIndex;
+    oldIndex.load(indexFileName);
+
+    std::map<QByteArray, const PDFToolTextIndex::Document*> oldDocuments;
+    for (const PDFToolTextIndex::Document& document : oldIndex.documents)
+    {
+        oldDocuments[document.hash] = &document;
+    }
+
+    PDFToolTextIndex index;
+    index.directory = directory.absolutePath();
+
+    QStringList fileNames;
+    QDirIterator::IteratorFlags iteratorFlags = options.textIndexRecursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags;
+    QDirIterator directoryIterator(index.directory, QStringList() << "*.pdf", QDir::Files, iteratorFlags);
+    while (directoryIterator.hasNext())
+    {
+        fileNames << directoryIterator.next();
+    }
+    fileNames.sort();
+
+    int reusedCount = 0;
+    int indexedCount = 0;
+    int failedCount = 0;
+
+    // Documents indexed in this run (same document can be present more than once)
+    std::map<QByteArray, size_t> newDocuments;
+
+    for (const QString& fileName : fileNames)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot read file '%1'.").arg(fileName), options.outputCodec);
+            ++failedCount;
+            continue;
+        }
+
+        QByteArray data = file.readAll();
+        file.close();
+
+        PDFToolTextIndex::Document document;
+        document.fileName = directory.relativeFilePath(fileName);
+        document.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+
+        auto itOld = oldDocuments.find(document.hash);
+        if (itOld != oldDocuments.cend())
+        {
+            document.items = itOld->second->items;
+            document.compressedItems = itOld->second->compressedItems;
+            index.documents.push_back(qMove(document));
+            ++reusedCount;
+            continue;
+        }
+
+        auto itNew = newDocuments.find(document.hash);
+        if (itNew != newDocuments.cend())
+        {
+            document.items = index.documents[itNew->second].items;
+            index.documents.push_back(qMove(document));
+            ++reusedCount;
+            continue;
+        }
+
+        pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, options.permissiveReading, false);
+        pdf::PDFDocument pdfDocument = reader.readFromBuffer(data);
+        if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open document '%1'.").arg(fileName), options.outputCodec);
+            ++failedCount;
+            continue;
+        }
+
+        if (!pdfDocument.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::CopyContent))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Document '%1' doesn't allow to copy content.").arg(fileName), options.outputCodec);
+            ++failedCount;
+            continue;
+        }
+
+        pdf::PDFDocumentTextFlowFactory factory;
+        factory.setCalculateBoundingBoxes(true);
+        pdf::PDFDocumentTextFlow documentTextFlow = factory.create(&pdfDocument, options.textAnalysisAlgorithm);
+
+        for (const pdf::PDFDocumentTextFlow::Item& item : documentTextFlow.getItems())
+        {
+            if (item.isText() && !item.text.isEmpty())
+            {
+                document.items.push_back(PDFToolTextIndex::TextItem{ item.pageIndex, item.text, item.boundingRect, item.characterBoundingRects });
+            }
+        }
+
+        newDocuments[document.hash] = index.documents.size();
+        index.documents.push_back(qMove(document));
+        ++indexedCount;
+    }
+
+    if (!index.save(indexFileName))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot write index file '%1'.").arg(indexFileName), options.outputCodec);
+        return ErrorFailedWriteToFile;
+    }
+
+    const int removedCount = int(oldIndex.documents.size()) - reusedCount;
+
+    PDFOutputFormatter formatter(options.outputStyle);
+    formatter.beginDocument("index", PDFToolTranslationContext::tr("Text index of directory %1").arg(index.directory));
+    formatter.endl();
+    formatter.writeText("index-file", PDFToolTranslationContext::tr("Index file: %1").arg(indexFileName));
+    formatter.writeText("indexed", PDFToolTranslationContext::tr("Indexed documents: %1").arg(indexedCount));
+    formatter.writeText("unchanged", PDFToolTranslationContext::tr("Unchanged documents: %1").arg(reusedCount));
+    formatter.writeText("removed", PDFToolTranslationContext::tr("Removed documents: %1").arg(qMax(removedCount, 0)));
+    formatter.writeText("failed", PDFToolTranslationContext::tr("Failed documents: %1").arg(failedCount));
+    formatter.endDocument();
+
+    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    return ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolIndexApplication::getOptionsFlags() const
+{
+    return ConsoleFormat | TextAnalysis | TextIndex | TextIndexBuild;
+}
+
+QString PDFToolSearchApplication::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "search";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Search documents");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Search text in documents using text index created by index command.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolSearchApplication::execute(const PDFToolOptions& options)
+{
+    if (options.textIndexFile.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Index file must be specified."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    if (options.textIndexQuery.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Searched text must be specified."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    PDFToolTextIndex index;
+    if (!index.load(options.textIndexFile))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot read index file '%1'.").arg(options.textIndexFile), options.outputCodec);
+        return ErrorDocumentReading;
+    }
+
+    struct Hit
+    {
+        pdf::PDFInteger pageIndex = 0;
+        QRectF boundingRect;
+        QString context;
+    };
+
+    constexpr qsizetype CONTEXT_LENGTH = 30;
+    const Qt::CaseSensitivity caseSensitivity = options.textIndexCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const QString& query = options.textIndexQuery;
+
+    std::vector<std::vector<Hit>> documentHits(index.documents.size());
+    std::vector<size_t> documentIndices(index.documents.size(), 0);
+    std::iota(documentIndices.begin(), documentIndices.end(), 0);
+
+    auto searchDocument = [&](size_t documentIndex)
+    {
+        std::vector<Hit>& hits = documentHits[documentIndex];
+        std::vector<qsizetype> positions;
+
+        for (const PDFToolTextIndex::TextItem& item : index.documents[documentIndex].items)
+        {
+            QString text = normalizeText(item.text, positions);
+            const bool hasCharacterBoundingRects = item.characterBoundingRects.size() == size_t(item.text.size());
+
+            qsizetype position = text.indexOf(query, 0, caseSensitivity);
+            while (position != -1)
+            {
+                Hit hit;
+                hit.pageIndex = item.pageIndex;
+
+                if (hasCharacterBoundingRects)
+                {
+                    for (qsizetype i = position; i < position + query.size(); ++i)
+                    {
+                        hit.boundingRect = hit.boundingRect.united(item.characterBoundingRects[positions[i]]);
+                    }
+                }
+
+                if (hit.boundingRect.isNull())
+                {
+                    hit.boundingRect = item.boundingRect;
+                }
+
+                const qsizetype contextStart = qMax(position - CONTEXT_LENGTH, qsizetype(0));
+                hit.context = text.mid(contextStart, position - contextStart + query.size() + CONTEXT_LENGTH).trimmed();
+                hits.push_back(qMove(hit));
+
+                position = text.indexOf(query, position + query.size(), caseSensitivity);
+            }
+        }
+    };
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Unknown, documentIndices.cbegin(), documentIndices.cend(), searchDocument);
+
+    QLocale locale;
+    QDir directory(index.directory);
+
+    PDFOutputFormatter formatter(options.outputStyle);
+    formatter.beginDocument("search", PDFToolTranslationContext::tr("Search results for '%1'").arg(query));
+    formatter.endl();
+
+    formatter.beginTable("hits", PDFToolTranslationContext::tr("Hits"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("no", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("file", PDFToolTranslationContext::tr("File"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("page-number", PDFToolTranslationContext::tr("Page"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("x", PDFToolTranslationContext::tr("X"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("y", PDFToolTranslationContext::tr("Y"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("width", PDFToolTranslationContext::tr("Width"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("height", PDFToolTranslationContext::tr("Height"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("context", PDFToolTranslationContext::tr("Context"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    int hitCount = 0;
+    for (size_t documentIndex = 0; documentIndex < index.documents.size(); ++documentIndex)
+    {
+        const QString fileName = directory.filePath(index.documents[documentIndex].fileName);
+
+        for (const Hit& hit : documentHits[documentIndex])
+        {
+            if (options.textIndexMaxHits > 0 && hitCount >= options.textIndexMaxHits)
+            {
+                break;
+            }
+
+            formatter.beginTableRow("hit", hitCount);
+            formatter.writeTableColumn("no", locale.toString(hitCount + 1), Qt::AlignRight);
+            formatter.writeTableColumn("file", fileName, Qt::AlignLeft);
+            formatter.writeTableColumn("page-number", locale.toString(hit.pageIndex + 1), Qt::AlignRight);
+            formatter.writeTableColumn("x", locale.toString(hit.boundingRect.x(), 'f', 2), Qt::AlignRight);
+            formatter.writeTableColumn("y", locale.toString(hit.boundingRect.y(), 'f', 2), Qt::AlignRight);
+            formatter.writeTableColumn("width", locale.toString(hit.boundingRect.width(), 'f', 2), Qt::AlignRight);
+            formatter.writeTableColumn("height", locale.toString(hit.boundingRect.height(), 'f', 2), Qt::AlignRight);
+            formatter.writeTableColumn("context", hit.context, Qt::AlignLeft);
+            formatter.endTableRow();
+
+            ++hitCount;
+        }
+    }
+
+    formatter.endTable();
+
+    formatter.endl();
+    formatter.writeText("hit-count", PDFToolTranslationContext::tr("Hits found: %1").arg(hitCount));
+    formatter.endDocument();
+
+    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    return ExitSuccess;
+}
+
+PDFToolAbstractApplication::Options PDFToolSearchApplication::getOptionsFlags() const
+{
+    return ConsoleFormat | TextIndex | TextIndexSearch;
+}
+
+}   // namespace pdftool
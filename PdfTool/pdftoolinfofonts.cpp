@@ -21,6 +21,9 @@
 #include "pdffont.h"
 #include "pdfutils.h"
 
+#include <map>
+#include <optional>
+
 namespace pdftool
 {
 
@@ -80,13 +83,22 @@ int PDFToolInfoFonts::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
-    QMutex mutex;
-    std::map<pdf::PDFObjectReference, FontInfo> fontInfoMap;
-    std::vector<FontInfo> directFonts;
-    std::set<pdf::PDFObjectReference> usedFontReferences;
+    // Fonts used on the pages are collected in parallel, then usage of the pages
+    // is merged, so each font object is processed only once (font is realized
+    // and its character map is computed only once), even if it is used on many pages.
+    struct FontUsage
+    {
+        pdf::PDFObject object;
+        pdf::PDFObjectReference reference;
+        QByteArray key;     ///< Key of the font in font dictionary of the first page, where font is used
+        pdf::PDFClosedIntervalSet pages;
+    };
 
-    auto processPage = [&](pdf::PDFInteger pageIndex)
+    std::vector<std::vector<FontUsage>> pageFontUsages(pages.size());
+    auto collectPageFonts = [&](size_t pageRangeIndex)
     {
+        const pdf::PDFInteger pageIndex = pages[pageRangeIndex];
+
         try
         {
             const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
@@ -94,186 +106,210 @@ int PDFToolInfoFonts::execute(const PDFToolOptions& options)
             {
                 if (const pdf::PDFDictionary* fontsDictionary = document.getDictionaryFromObject(resourcesDictionary->get("Font")))
                 {
-                    // Iterate trough each font
                     const size_t fontsCount = fontsDictionary->getCount();
                     for (size_t i = 0; i < fontsCount; ++i)
                     {
-                        pdf::PDFObjectReference fontReference;
-                        pdf::PDFObject object = fontsDictionary->getValue(i);
-                        if (object.isReference())
-                        {
-                            // Check, if we have not processed the object. If we have it processed,
-                            // then do nothing, otherwise insert it into the processed objects.
-                            // We must also use mutex, because we use multithreading.
-                            QMutexLocker lock(&mutex);
-                            if (usedFontReferences.count(object.getReference()))
-                            {
-                                fontInfoMap[object.getReference()].pages.addValue(pageIndex + 1);
-                                continue;
-                            }
-                            else
-                            {
-                                fontReference = object.getReference();
-                                usedFontReferences.insert(fontReference);
-                            }
-                        }
+                        FontUsage usage;
+                        usage.object = fontsDictionary->getValue(i);
+                        usage.reference = usage.object.isReference() ? usage.object.getReference() : pdf::PDFObjectReference();
+                        usage.key = fontsDictionary->getKey(i).getString();
+                        usage.pages.addValue(pageIndex + 1);
+                        pageFontUsages[pageRangeIndex].emplace_back(qMove(usage));
+                    }
+                }
+            }
+        }
+        catch (const pdf::PDFException &)
+        {
+            // Do nothing, some error occured
+        }
+    };
+
+    pdf::PDFIntegerRange<size_t> pageRangeIndices(0, pages.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, pageRangeIndices.begin(), pageRangeIndices.end(), collectPageFonts);
+
+    // Merge usage of the pages in page order, so output doesn't
+    // depend on thread scheduling. Direct fonts are listed first.
+    std::vector<FontUsage> fontUsages;
+    std::map<pdf::PDFObjectReference, FontUsage> referencedFontUsages;
+    for (std::vector<FontUsage>& pageFontUsage : pageFontUsages)
+    {
+        for (FontUsage& usage : pageFontUsage)
+        {
+            if (!usage.reference.isValid())
+            {
+                fontUsages.emplace_back(qMove(usage));
+                continue;
+            }
+
+            auto it = referencedFontUsages.find(usage.reference);
+            if (it != referencedFontUsages.end())
+            {
+                it->second.pages.merge(usage.pages);
+            }
+            else
+            {
+                referencedFontUsages.emplace(usage.reference, qMove(usage));
+            }
+        }
+    }
+    pageFontUsages.clear();
 
-                        try
+    for (auto& item : referencedFontUsages)
+    {
+        fontUsages.emplace_back(qMove(item.second));
+    }
+    referencedFontUsages.clear();
+
+    std::vector<std::optional<FontInfo>> fontInfos(fontUsages.size());
+
+    auto processFont = [&](size_t fontIndex)
+    {
+        const FontUsage& usage = fontUsages[fontIndex];
+
+        try
+        {
+            if (pdf::PDFFontPointer font = pdf::PDFFont::createFont(usage.object, &document))
+            {
+                pdf::PDFRenderErrorReporterDummy dummyReporter;
+                pdf::PDFRealizedFontPointer realizedFont = pdf::PDFRealizedFont::createRealizedFont(font, 8.0, &dummyReporter);
+                if (realizedFont)
+                {
+                    const pdf::FontType fontType = font->getFontType();
+                    const pdf::FontDescriptor* fontDescriptor = font->getFontDescriptor();
+                    QString fontName = fontDescriptor->fontName;
+                    QString fontFullName = fontName;
+                    int plusPos = fontName.lastIndexOf('+');
+
+                    // Jakub Melka: Detect, if font is subset. Font subsets have special form,
+                    // according to chapter 9.9.2 of PDF 2.0 specification. The first 6 letters
+                    // of font name are uppercase alphabet letters, and 7'th character is '+' sign.
+                    bool isSubset = false;
+                    if (plusPos == 6)
+                    {
+                        isSubset = true;
+                        for (int iFontName = 0; iFontName < 6; ++iFontName)
                         {
-                            if (pdf::PDFFontPointer font = pdf::PDFFont::createFont(object, &document))
+                            QChar character = fontName[iFontName];
+                            if (!character.isLetter() || !character.isUpper())
                             {
-                                pdf::PDFRenderErrorReporterDummy dummyReporter;
-                                pdf::PDFRealizedFontPointer realizedFont = pdf::PDFRealizedFont::createRealizedFont(font, 8.0, &dummyReporter);
-                                if (realizedFont)
-                                {
-                                    const pdf::FontType fontType = font->getFontType();
-                                    const pdf::FontDescriptor* fontDescriptor = font->getFontDescriptor();
-                                    QString fontName = fontDescriptor->fontName;
-                                    QString fontFullName = fontName;
-                                    int plusPos = fontName.lastIndexOf('+');
-
-                                    // Jakub Melka: Detect, if font is subset. Font subsets have special form,
-                                    // according to chapter 9.9.2 of PDF 2.0 specification. The first 6 letters
-                                    // of font name are uppercase alphabet letters, and 7'th character is '+' sign.
-                                    bool isSubset = false;
-                                    if (plusPos == 6)
-                                    {
-                                        isSubset = true;
-                                        for (int iFontName = 0; iFontName < 6; ++iFontName)
-                                        {
-                                            QChar character = fontName[iFontName];
-                                            if (!character.isLetter() || !character.isUpper())
-                                            {
-                                                isSubset = false;
-                                                break;
-                                            }
-                                        }
-                                    }
-
-                                    // Try to remove characters from +, if we have font name 'SDFDSF+ValidFontName'
-                                    if (plusPos != -1 && plusPos < fontName.size() - 1)
-                                    {
-                                        fontName = fontName.mid(plusPos + 1);
-                                    }
-
-                                    if (fontName.isEmpty())
-                                    {
-                                        fontName = QString::fromLatin1(fontsDictionary->getKey(i).getString());
-                                    }
-
-                                    QString fontTypeName;
-                                    switch (fontType)
-                                    {
-                                        case pdf::FontType::Type0:
-                                            fontTypeName = PDFToolTranslationContext::tr("Type 0 (CID)");
-                                            break;
-
-                                        case pdf::FontType::Type1:
-                                            fontTypeName = PDFToolTranslationContext::tr("Type 1 (8 bit)");
-                                            break;
-
-                                        case pdf::FontType::MMType1:
-                                            fontTypeName = PDFToolTranslationContext::tr("MM Type 1 (8 bit)");
-                                            break;
-
-                                        case pdf::FontType::TrueType:
-                                            fontTypeName = PDFToolTranslationContext::tr("TrueType (8 bit)");
-                                            break;
-
-                                        case pdf::FontType::Type3:
-                                            fontTypeName = PDFToolTranslationContext::tr("Type 3");
-                                            break;
-
-                                        default:
-                                            Q_ASSERT(false);
-                                            break;
-                                    }
-
-                                    const pdf::PDFFontCMap* toUnicode = font->getToUnicode();
-
-                                    FontInfo info;
-                                    info.fontName = fontName;
-                                    info.fontFullName = fontFullName;
-                                    info.pages.addValue(pageIndex + 1);
-                                    info.fontTypeName = fontTypeName;
-                                    info.isEmbedded = fontDescriptor->isEmbedded() || fontType == pdf::FontType::Type3;
-                                    info.isSubset = isSubset;
-                                    info.isToUnicodePresent = toUnicode && toUnicode->isValid();
-                                    info.reference = fontReference;
-                                    info.substitutedFont = realizedFont->getPostScriptName();
-
-                                    if (options.showCharacterMapsForEmbeddedFonts && info.isEmbedded)
-                                    {
-                                        info.characterInfos = realizedFont->getCharacterInfos();
-                                    }
-
-                                    const pdf::PDFSimpleFont* simpleFont = dynamic_cast<const pdf::PDFSimpleFont*>(font.data());
-                                    if (simpleFont)
-                                    {
-                                        const pdf::PDFEncoding::Encoding encoding = simpleFont->getEncodingType();
-                                        switch (encoding)
-                                        {
-                                            case pdf::PDFEncoding::Encoding::Standard:
-                                                info.encoding = PDFToolTranslationContext::tr("Standard");
-                                                break;
-                                            case pdf::PDFEncoding::Encoding::MacRoman:
-                                                info.encoding = PDFToolTranslationContext::tr("MacRoman");
-                                                break;
-                                            case pdf::PDFEncoding::Encoding::WinAnsi:
-                                                info.encoding = PDFToolTranslationContext::tr("WinAnsi");
-                                                break;
-                                            case pdf::PDFEncoding::Encoding::PDFDoc:
-                                                info.encoding = PDFToolTranslationContext::tr("PDFDoc");
-                                                break;
-                                            case pdf::PDFEncoding::Encoding::MacExpert:
-                                                info.encoding = PDFToolTranslationContext::tr("MacExpert");
-                                                break;
-                                            case pdf::PDFEncoding::Encoding::Symbol:
-                                                info.encoding = PDFToolTranslationContext::tr("Symbol");
-                                                break;
-                                            case pdf::PDFEncoding::Encoding::ZapfDingbats:
-                                                info.encoding = PDFToolTranslationContext::tr("ZapfDingbats");
-                                                break;
-
-                                            default:
-                                                info.encoding = PDFToolTranslationContext::tr("Custom");
-                                                break;
-                                        }
-                                    }
-
-                                    QMutexLocker lock(&mutex);
-                                    if (fontReference.isValid())
-                                    {
-                                        info.pages.merge(fontInfoMap[fontReference].pages);
-                                        fontInfoMap[fontReference] = qMove(info);
-                                    }
-                                    else
-                                    {
-                                        directFonts.emplace_back(qMove(info));
-                                    }
-                                }
+                                isSubset = false;
+                                break;
                             }
                         }
-                        catch (const pdf::PDFException &)
+                    }
+
+                    // Try to remove characters from +, if we have font name 'SDFDSF+ValidFontName'
+                    if (plusPos != -1 && plusPos < fontName.size() - 1)
+                    {
+                        fontName = fontName.mid(plusPos + 1);
+                    }
+
+                    if (fontName.isEmpty())
+                    {
+                        fontName = QString::fromLatin1(usage.key);
+                    }
+
+                    QString fontTypeName;
+                    switch (fontType)
+                    {
+                        case pdf::FontType::Type0:
+                            fontTypeName = PDFToolTranslationContext::tr("Type 0 (CID)");
+                            break;
+
+                        case pdf::FontType::Type1:
+                            fontTypeName = PDFToolTranslationContext::tr("Type 1 (8 bit)");
+                            break;
+
+                        case pdf::FontType::MMType1:
+                            fontTypeName = PDFToolTranslationContext::tr("MM Type 1 (8 bit)");
+                            break;
+
+                        case pdf::FontType::TrueType:
+                            fontTypeName = PDFToolTranslationContext::tr("TrueType (8 bit)");
+                            break;
+
+                        case pdf::FontType::Type3:
+                            fontTypeName = PDFToolTranslationContext::tr("Type 3");
+                            break;
+
+                        default:
+                            Q_ASSERT(false);
+                            break;
+                    }
+
+                    const pdf::PDFFontCMap* toUnicode = font->getToUnicode();
+
+                    FontInfo info;
+                    info.fontName = fontName;
+                    info.fontFullName = fontFullName;
+                    info.pages = usage.pages;
+                    info.fontTypeName = fontTypeName;
+                    info.isEmbedded = fontDescriptor->isEmbedded() || fontType == pdf::FontType::Type3;
+                    info.isSubset = isSubset;
+                    info.isToUnicodePresent = toUnicode && toUnicode->isValid();
+                    info.reference = usage.reference;
+                    info.substitutedFont = realizedFont->getPostScriptName();
+
+                    if (options.showCharacterMapsForEmbeddedFonts && info.isEmbedded)
+                    {
+                        info.characterInfos = realizedFont->getCharacterInfos();
+                    }
+
+                    const pdf::PDFSimpleFont* simpleFont = dynamic_cast<const pdf::PDFSimpleFont*>(font.data());
+                    if (simpleFont)
+                    {
+                        const pdf::PDFEncoding::Encoding encoding = simpleFont->getEncodingType();
+                        switch (encoding)
                         {
-                            // Do nothing, some error occured, continue with next font
-                            continue;
+                            case pdf::PDFEncoding::Encoding::Standard:
+                                info.encoding = PDFToolTranslationContext::tr("Standard");
+                                break;
+                            case pdf::PDFEncoding::Encoding::MacRoman:
+                                info.encoding = PDFToolTranslationContext::tr("MacRoman");
+                                break;
+                            case pdf::PDFEncoding::Encoding::WinAnsi:
+                                info.encoding = PDFToolTranslationContext::tr("WinAnsi");
+                                break;
+                            case pdf::PDFEncoding::Encoding::PDFDoc:
+                                info.encoding = PDFToolTranslationContext::tr("PDFDoc");
+                                break;
+                            case pdf::PDFEncoding::Encoding::MacExpert:
+                                info.encoding = PDFToolTranslationContext::tr("MacExpert");
+                                break;
+                            case pdf::PDFEncoding::Encoding::Symbol:
+                                info.encoding = PDFToolTranslationContext::tr("Symbol");
+                                break;
+                            case pdf::PDFEncoding::Encoding::ZapfDingbats:
+                                info.encoding = PDFToolTranslationContext::tr("ZapfDingbats");
+                                break;
+
+                            default:
+                                info.encoding = PDFToolTranslationContext::tr("Custom");
+                                break;
                         }
                     }
+
+                    fontInfos[fontIndex] = qMove(info);
                 }
             }
         }
         catch (const pdf::PDFException &)
         {
-            // Do nothing, some error occured
+            // Do nothing, some error occured, continue with next font
         }
     };
 
-    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, pages.begin(), pages.end(), processPage);
+    pdf::PDFIntegerRange<size_t> fontIndices(0, fontUsages.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, fontIndices.begin(), fontIndices.end(), processFont);
 
-    for (auto& item : fontInfoMap)
+    std::vector<FontInfo> directFonts;
+    for (std::optional<FontInfo>& info : fontInfos)
     {
-        directFonts.emplace_back(qMove(item.second));
+        if (info.has_value())
+        {
+            directFonts.emplace_back(qMove(*info));
+        }
     }
 
     PDFOutputFormatter formatter(options.outputStyle);
@@ -90,7 +90,7 @@ int PDFToolInfoNamedDestinationsApplication::execute(const PDFToolOptions& optio
     };
     std::vector<DestinationItem> destinationItems;
 
-    for (const auto& destinationItem : document.getCatalog()->getNamedDestinations())
+    for (const auto& destinationItem : document.getCatalog()->getNamedDestinations(&document.getStorage()))
     {
         const QByteArray& name = destinationItem.first;
         const pdf::PDFDestination& destination = destinationItem.second;
@@ -17,6 +17,7 @@
 
 #include "pdftoolinfopageboxes.h"
 #include "pdfutils.h"
+#include "pdfexecutionpolicy.h"
 
 namespace pdftool
 {
@@ -81,17 +82,29 @@ int PDFToolInfoPageBoxesApplication::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
-    std::vector<PDFPageBoxInfo> infos;
-    for (const pdf::PDFInteger pageIndex : pages)
+    // Page boxes are retrieved in parallel, but they are grouped
+    // in page order, so output doesn't depend on thread scheduling.
+    std::vector<PDFPageBoxInfo> pageInfos(pages.size());
+    auto processPage = [&](size_t index)
     {
-        const pdf::PDFPage* page = document.getCatalog()->getPage(pageIndex);
+        const pdf::PDFPage* page = document.getCatalog()->getPage(pages[index]);
 
-        PDFPageBoxInfo info;
+        PDFPageBoxInfo& info = pageInfos[index];
         info.mediaBox = page->getMediaBoxMM();
         info.cropBox = page->getCropBoxMM();
         info.bleedBox = page->getBleedBoxMM();
         info.trimBox = page->getTrimBoxMM();
         info.artBox = page->getArtBoxMM();
+    };
+
+    auto range = pdf::PDFIntegerRange<size_t>(0, pages.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), processPage);
+
+    std::vector<PDFPageBoxInfo> infos;
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        const pdf::PDFInteger pageIndex = pages[i];
+        PDFPageBoxInfo& info = pageInfos[i];
 
         auto it = std::find(infos.begin(), infos.end(), info);
         if (it != infos.end())
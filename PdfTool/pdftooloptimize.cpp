@@ -17,6 +17,7 @@
 
 #include "pdftooloptimize.h"
 #include "pdfdocumentwriter.h"
+#include "pdfbitonaldocumentconvertor.h"
 
 
 namespace pdftool
@@ -47,7 +48,7 @@ QString PDFToolOptimize::getStandardString(PDFToolAbstractApplication::StandardS
 
 int PDFToolOptimize::execute(const PDFToolOptions& options)
 {
-    if (!options.optimizeFlags)
+    if (!options.optimizeFlags && !options.optimizeObjectStreams && !options.optimizeLinearize && !options.optimizeBitonal)
     {
         PDFConsole::writeError(PDFToolTranslationContext::tr("No optimization option has been set."), options.outputCodec);
         return ErrorInvalidArguments;
@@ -60,13 +61,25 @@ int PDFToolOptimize::execute(const PDFToolOptions& options)
         return ErrorDocumentReading;
     }
 
+    if (options.optimizeBitonal)
+    {
+        pdf::PDFBitonalDocumentConvertor convertor(&document);
+        document = convertor.convert(convertor.getImageReferences(), options.optimizeBitonalSettings, nullptr);
+    }
+
     pdf::PDFOptimizer optimizer(options.optimizeFlags, nullptr);
     QObject::connect(&optimizer, &pdf::PDFOptimizer::optimizationProgress, &optimizer, [&options](QString text) { PDFConsole::writeError(text, options.outputCodec); }, Qt::DirectConnection);
+    optimizer.setCompressionLevel(options.optimizeCompressionLevel);
+    optimizer.setImageTargetResolution(options.optimizeImageResolution);
+    optimizer.setImageQuality(options.optimizeImageQuality);
     optimizer.setDocument(&document);
     optimizer.optimize();
     document = optimizer.takeOptimizedDocument();
 
     pdf::PDFDocumentWriter writer(nullptr);
+    writer.setObjectStreamsUsed(options.optimizeObjectStreams);
+    writer.setCompressionLevel(options.optimizeCompressionLevel);
+    writer.setLinearized(options.optimizeLinearize);
     pdf::PDFOperationResult result = writer.write(options.document, &document, true);
     if (!result)
     {
@@ -18,9 +18,34 @@
 #include "pdftoolrender.h"
 #include "pdffont.h"
 #include "pdfconstants.h"
-
+#include "pdfpngstreamwriter.h"
+#include "pdfdocumentreader.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfpagecontentprocessor.h"
+#include "pdfutils.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
 #include <QColorSpace>
+#include <QDirIterator>
 #include <QElapsedTimer>
+#include <QXmlStreamWriter>
+
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+#if defined(Q_OS_WIN)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
 
 namespace pdftool
 {
@@ -57,10 +82,11 @@ PDFToolAbstractApplication::Options PDFToolRender::getOptionsFlags() const
 void PDFToolRender::finish(const PDFToolOptions& options)
 {
     PDFOutputFormatter formatter(options.outputStyle);
-    formatter.beginDocument("render", PDFToolTranslationContext::tr("Render document %1").arg(options.document));
+    formatter.beginDocument("render", getTitle(PDFToolTranslationContext::tr("Render document %1").arg(options.document)));
     formatter.endl();
 
     writeStatistics(formatter);
+    writeDocumentStatistics(formatter);
     if (options.renderShowPageStatistics)
     {
         writePageStatistics(formatter);
@@ -71,14 +97,37 @@ void PDFToolRender::finish(const PDFToolOptions& options)
     PDFConsole::writeText(formatter.getString(), options.outputCodec);
 }
 
-void PDFToolRender::onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage)
+void PDFToolRender::onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage, PageInfo& pageInfo)
 {
-    writePageInfoStatistics(renderedPageImage);
+    writePageInfoStatistics(renderedPageImage, pageInfo);
     QString fileName = options.imageExportSettings.getOutputFileName(renderedPageImage.pageIndex, options.imageWriterSettings.getCurrentFormat());
 
     QElapsedTimer imageWriterTimer;
     imageWriterTimer.start();
 
+    QString errorMessage;
+    if (!writeImage(options, fileName, renderedPageImage.pageImage, errorMessage))
+    {
+        pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(errorMessage)));
+    }
+
+    pageInfo.pageWriteTime = imageWriterTimer.elapsed();
+}
+
+bool PDFToolRender::writeImage(const PDFToolOptions& options, const QString& fileName, const QImage& image, QString& errorMessage)
+{
+    if (isFastPngEncoderUsed(options))
+    {
+        pdf::PDFOperationResult result = pdf::PDFPNGStreamWriter::write(fileName, image, FAST_PNG_COMPRESSION_LEVEL, true);
+        if (!result)
+        {
+            errorMessage = result.getErrorMessage();
+            return false;
+        }
+
+        return true;
+    }
+
     QImageWriter imageWriter(fileName, options.imageWriterSettings.getCurrentFormat());
     imageWriter.setSubType(options.imageWriterSettings.getCurrentSubtype());
     imageWriter.setCompression(options.imageWriterSettings.getCompression());
@@ -86,12 +135,171 @@ void PDFToolRender::onPageRendered(const PDFToolOptions& options, pdf::PDFRender
     imageWriter.setOptimizedWrite(options.imageWriterSettings.hasOptimizedWrite());
     imageWriter.setProgressiveScanWrite(options.imageWriterSettings.hasProgressiveScanWrite());
 
-    if (!imageWriter.write(renderedPageImage.pageImage))
+    if (!imageWriter.write(image))
+    {
+        errorMessage = imageWriter.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool PDFToolRender::isRenderedInBands(const PDFToolOptions& options, QSize imageSize) const
+{
+    // Only PNG images can be written incrementally
+    return options.imageWriterSettings.getCurrentFormat() == "png" &&
+           qint64(imageSize.width()) * qint64(imageSize.height()) >= BANDED_RENDERING_MIN_PIXELS;
+}
+
+void PDFToolRender::renderPageInBands(const PDFToolOptions& options,
+                                      pdf::PDFRasterizerPool& rasterizerPool,
+                                      pdf::PDFInteger pageIndex,
+                                      const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                      PageInfo& pageInfo)
+{
+    const pdf::PDFPage* page = rasterizerPool.getDocument()->getCatalog()->getPage(pageIndex);
+    if (!page)
+    {
+        pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Page %1 not found.").arg(pageIndex)));
+        return;
+    }
+
+    QString fileName = options.imageExportSettings.getOutputFileName(pageIndex, options.imageWriterSettings.getCurrentFormat());
+    const bool isFastPngEncoder = isFastPngEncoderUsed(options);
+    pdf::PDFPNGStreamWriter writer(fileName, imageSizeGetter(page), isFastPngEncoder ? FAST_PNG_COMPRESSION_LEVEL : options.imageWriterSettings.getCompression());
+    writer.setMultithreadedCompression(isFastPngEncoder);
+
+    qint64 pageWriteTime = 0;
+    auto writeBand = [&writer, &pageWriteTime](const QImage& band)
+    {
+        QElapsedTimer imageWriterTimer;
+        imageWriterTimer.start();
+        const bool isWritten = writer.writeBand(band);
+        pageWriteTime += imageWriterTimer.elapsed();
+        return isWritten;
+    };
+
+    pdf::PDFRenderedPageImage renderedPageImage = rasterizerPool.renderBands(pageIndex, imageSizeGetter, BAND_HEIGHT, writeBand);
+    writePageInfoStatistics(renderedPageImage, pageInfo);
+
+    QElapsedTimer imageWriterTimer;
+    imageWriterTimer.start();
+
+    if (!writer.finish())
+    {
+        pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(writer.getErrorMessage())));
+    }
+
+    // Writing of bands is included in the render time, so we do not count it twice
+    pageInfo.pageRenderTime = qMax(pageInfo.pageRenderTime - pageWriteTime, qint64(0));
+    pageInfo.pageTotalTime = qMax(pageInfo.pageTotalTime - pageWriteTime, qint64(0));
+    pageInfo.pageWriteTime = pageWriteTime.load() + imageWriterTimer.elapsed();
+}
+
+bool PDFToolRender::isFastPngEncoderUsed(const PDFToolOptions& options)
+{
+    return options.renderFastPng && options.imageWriterSettings.getCurrentFormat() == "png";
+}
+
+bool PDFToolRender::isRenderedAsTilePyramid(const PDFToolOptions& options) const
+{
+    return options.renderTilePyramid;
+}
+
+void PDFToolRender::renderPageTilePyramid(const PDFToolOptions& options,
+                                          pdf::PDFRasterizerPool& rasterizerPool,
+                                          pdf::PDFInteger pageIndex,
+                                          const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                          PageInfo& pageInfo)
+{
+    const pdf::PDFPage* page = rasterizerPool.getDocument()->getCatalog()->getPage(pageIndex);
+    if (!page)
     {
-        m_pageInfo[renderedPageImage.pageIndex].errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write page image to file '%1', because: %2.").arg(fileName).arg(imageWriter.errorString())));
+        pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Page %1 not found.").arg(pageIndex)));
+        return;
     }
 
-    m_pageInfo[renderedPageImage.pageIndex].pageWriteTime = imageWriterTimer.elapsed();
+    const QSize imageSize = imageSizeGetter(page);
+    if (imageSize.isEmpty())
+    {
+        pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Page %1 has empty image.").arg(pageIndex + 1)));
+        return;
+    }
+
+    // Deep Zoom layout - descriptor 'name.dzi' is written together
+    // with directory 'name_files' containing directory for each level,
+    // in which tiles are stored in files 'column_row.format'.
+    const QByteArray format = options.imageWriterSettings.getCurrentFormat();
+    const QString descriptorFileName = options.imageExportSettings.getOutputFileName(pageIndex, "dzi");
+    const QFileInfo descriptorFileInfo(descriptorFileName);
+    const QDir tileDirectory(descriptorFileInfo.dir().filePath(QString("%1_files").arg(descriptorFileInfo.completeBaseName())));
+
+    // Directories are created before rendering, so tiles can be written in parallel
+    const int levelCount = pdf::PDFRasterizer::getTilePyramidLevelCount(imageSize);
+    for (int level = 0; level < levelCount; ++level)
+    {
+        if (!tileDirectory.mkpath(QString::number(level)))
+        {
+            pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot create directory '%1'.").arg(tileDirectory.filePath(QString::number(level)))));
+            return;
+        }
+    }
+
+    std::atomic<qint64> pageWriteTime = 0;
+    QMutex errorMutex;
+    auto writeTile = [&](const pdf::PDFRasterizer::Tile& tile)
+    {
+        QElapsedTimer imageWriterTimer;
+        imageWriterTimer.start();
+
+        const QString fileName = tileDirectory.filePath(QString("%1/%2_%3.%4").arg(tile.level).arg(tile.column).arg(tile.row).arg(QString::fromLatin1(format)));
+
+        QString errorMessage;
+        const bool isWritten = writeImage(options, fileName, tile.image, errorMessage);
+        pageWriteTime += imageWriterTimer.elapsed();
+
+        if (!isWritten)
+        {
+            QMutexLocker lock(&errorMutex);
+            pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write tile image to file '%1', because: %2.").arg(fileName).arg(errorMessage)));
+        }
+
+        return isWritten;
+    };
+
+    pdf::PDFRenderedPageImage renderedPageImage = rasterizerPool.renderTilePyramid(pageIndex, imageSizeGetter, options.renderTileSize, writeTile);
+    writePageInfoStatistics(renderedPageImage, pageInfo);
+
+    QElapsedTimer imageWriterTimer;
+    imageWriterTimer.start();
+
+    QFile descriptorFile(descriptorFileName);
+    if (descriptorFile.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        QXmlStreamWriter writer(&descriptorFile);
+        writer.setAutoFormatting(true);
+        writer.writeStartDocument();
+        writer.writeStartElement("Image");
+        writer.writeDefaultNamespace("http://schemas.microsoft.com/deepzoom/2008");
+        writer.writeAttribute("Format", QString::fromLatin1(format));
+        writer.writeAttribute("Overlap", "0");
+        writer.writeAttribute("TileSize", QString::number(options.renderTileSize));
+        writer.writeStartElement("Size");
+        writer.writeAttribute("Width", QString::number(imageSize.width()));
+        writer.writeAttribute("Height", QString::number(imageSize.height()));
+        writer.writeEndElement();
+        writer.writeEndElement();
+        writer.writeEndDocument();
+        descriptorFile.close();
+    }
+    else
+    {
+        pageInfo.errors.emplace_back(pdf::PDFRenderError(pdf::RenderErrorType::Error, PDFToolTranslationContext::tr("Cannot write tile pyramid descriptor to file '%1', because: %2.").arg(descriptorFileName).arg(descriptorFile.errorString())));
+    }
+
+    // Tiles are written by rendering threads, so writing time of the tiles (summed
+    // over all threads) is also included in the render time.
+    pageInfo.pageWriteTime = pageWriteTime + imageWriterTimer.elapsed();
 }
 
 QString PDFToolBenchmark::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
@@ -122,11 +330,29 @@ PDFToolAbstractApplication::Options PDFToolBenchmark::getOptionsFlags() const
 
 void PDFToolBenchmark::finish(const PDFToolOptions& options)
 {
+    if (options.outputStyle == PDFOutputFormatter::Style::Json)
+    {
+        // Jakub Melka: JSON output is processed by scripts (for example, to compare
+        // benchmark results in continuous integration), so numbers are written
+        // without group separators.
+        QLocale::setDefault(QLocale::c());
+    }
+
     PDFOutputFormatter formatter(options.outputStyle);
-    formatter.beginDocument("benchmark", PDFToolTranslationContext::tr("Benchmark rendering of document %1").arg(options.document));
+    formatter.beginDocument("benchmark", getTitle(PDFToolTranslationContext::tr("Benchmark rendering of document %1").arg(options.document)));
     formatter.endl();
 
     writeStatistics(formatter);
+    writeContentStatistics(formatter);
+
+    const qint64 peakMemoryUsage = getPeakMemoryUsage();
+    if (peakMemoryUsage >= 0)
+    {
+        formatter.writeText("peak-memory-usage", PDFToolTranslationContext::tr("Peak memory usage: %1 MB").arg(QLocale().toString(double(peakMemoryUsage) / (1024.0 * 1024.0), 'f', 1)));
+        formatter.endl();
+    }
+
+    writeDocumentStatistics(formatter);
     if (options.renderShowPageStatistics)
     {
         writePageStatistics(formatter);
@@ -137,14 +363,44 @@ void PDFToolBenchmark::finish(const PDFToolOptions& options)
     PDFConsole::writeText(formatter.getString(), options.outputCodec);
 }
 
-void PDFToolBenchmark::onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage)
+void PDFToolBenchmark::onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage, PageInfo& pageInfo)
 {
     Q_UNUSED(options);
-    writePageInfoStatistics(renderedPageImage);
+    writePageInfoStatistics(renderedPageImage, pageInfo);
+}
+
+qint64 PDFToolBenchmark::getPeakMemoryUsage()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters = { };
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return qint64(counters.PeakWorkingSetSize);
+    }
+#elif defined(Q_OS_UNIX)
+    struct rusage usage = { };
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#if defined(Q_OS_MACOS)
+        // Value is in bytes on macOS
+        return qint64(usage.ru_maxrss);
+#else
+        // Value is in kilobytes on Linux
+        return qint64(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+
+    return -1;
 }
 
 int PDFToolRenderBase::execute(const PDFToolOptions& options)
 {
+    if (options.renderBatch)
+    {
+        return executeBatch(options);
+    }
+
     pdf::PDFDocument document;
     QByteArray sourceData;
     if (!readDocument(options, document, &sourceData, false))
@@ -170,27 +426,209 @@ int PDFToolRenderBase::execute(const PDFToolOptions& options)
     }
 
     // We are ready to render the document
-    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
     pdf::PDFCMSManager cmsManager(nullptr);
     cmsManager.setDocument(&document);
     cmsManager.setSettings(options.cmsSettings);
+
+    std::unique_ptr<pdf::PDFDiskCache> diskCache = createDiskCache(options);
+
+    m_documentInfo.resize(1);
+    m_documentInfo.front().fileName = options.document;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    renderDocument(options, &document, qMove(pageIndices), &cmsManager, diskCache.get(), m_documentInfo.front());
+
+    m_wallTime = timer.elapsed();
+
+    finish(options);
+    return ExitSuccess;
+}
+
+int PDFToolRenderBase::executeBatch(const PDFToolOptions& options)
+{
+    QStringList arguments = options.renderBatchFiles;
+    if (!options.renderBatchListFile.isEmpty())
+    {
+        QFile listFile(options.renderBatchListFile);
+        if (!listFile.open(QFile::ReadOnly | QFile::Text))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot read file list '%1'.").arg(options.renderBatchListFile), options.outputCodec);
+            return ErrorInvalidArguments;
+        }
+
+        while (!listFile.atEnd())
+        {
+            QString fileName = QString::fromUtf8(listFile.readLine()).trimmed();
+            if (!fileName.isEmpty())
+            {
+                arguments << fileName;
+            }
+        }
+    }
+
+    // Images of documents from directories are written to the output directory
+    // with the same relative path as documents have in the source directory.
+    // Without output directory, images are written next to the documents.
+    QStringList fileNames;
+    QStringList outputDirectories;
+    QDir outputDirectory(options.renderBatchOutputDirectory);
+    QDirIterator::IteratorFlags iteratorFlags = options.renderBatchRecursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags;
+    for (const QString& argument : arguments)
+    {
+        QStringList directoryFileNames;
+        QDir directory;
+
+        if (QFileInfo(argument).isDir())
+        {
+            directory = QDir(argument);
+            QDirIterator directoryIterator(argument, QStringList() << "*.pdf", QDir::Files, iteratorFlags);
+            while (directoryIterator.hasNext())
+            {
+                directoryFileNames << directoryIterator.next();
+            }
+            directoryFileNames.sort();
+        }
+        else
+        {
+            directory = QFileInfo(argument).dir();
+            directoryFileNames << argument;
+        }
+
+        for (const QString& fileName : directoryFileNames)
+        {
+            const QString documentDirectory = QFileInfo(fileName).path();
+            fileNames << fileName;
+            outputDirectories << (options.renderBatchOutputDirectory.isEmpty() ? documentDirectory : outputDirectory.filePath(directory.relativeFilePath(documentDirectory)));
+        }
+    }
+
+    if (fileNames.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No document specified."), options.outputCodec);
+        return ErrorNoDocumentSpecified;
+    }
+
+    // Jakub Melka: Color management system is shared by all documents, so it is
+    // created only once. Output intents of the documents are not used, because
+    // they are different for each document.
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setSettings(options.cmsSettings);
+
+    // Disk cache is also shared, so identical pages of different documents are rendered only once
+    std::unique_ptr<pdf::PDFDiskCache> diskCache = createDiskCache(options);
+
+    m_isBatch = true;
+    m_documentInfo.resize(fileNames.size());
+
+    const Options optionFlags = getOptionsFlags();
+    auto processDocument = [&](size_t i)
+    {
+        DocumentInfo& documentInfo = m_documentInfo[i];
+        documentInfo.fileName = fileNames[int(i)];
+
+        PDFToolOptions documentOptions = options;
+        documentOptions.document = documentInfo.fileName;
+
+        if (optionFlags.testFlag(ImageExportSettingsFiles))
+        {
+            // Images of the documents in the same directory must not have the same names
+            const QString outputDirectoryPath = outputDirectories[int(i)];
+            documentOptions.imageExportSettings.setDirectory(outputDirectoryPath);
+            documentOptions.imageExportSettings.setFileTemplate(QString("%1_%2").arg(QFileInfo(documentInfo.fileName).completeBaseName(), options.imageExportSettings.getFileTemplate()));
+
+            if (!QDir().mkpath(outputDirectoryPath))
+            {
+                documentInfo.errorMessage = PDFToolTranslationContext::tr("Cannot create directory '%1'.").arg(outputDirectoryPath);
+                return;
+            }
+        }
+
+        if (!documentOptions.imageExportSettings.validate(&documentInfo.errorMessage, false, optionFlags.testFlag(ImageExportSettingsFiles), optionFlags.testFlag(ImageExportSettingsResolution)))
+        {
+            return;
+        }
+
+        bool isFirstPasswordAttempt = true;
+        auto passwordCallback = [&options, &isFirstPasswordAttempt](bool* ok) -> QString
+        {
+            *ok = isFirstPasswordAttempt;
+            isFirstPasswordAttempt = false;
+            return options.password;
+        };
+
+        pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, false);
+        reader.setMemoryMapping(true);
+        pdf::PDFDocument document = reader.readFromFile(documentInfo.fileName);
+
+        switch (reader.getReadingResult())
+        {
+            case pdf::PDFDocumentReader::Result::OK:
+                break;
+
+            case pdf::PDFDocumentReader::Result::Cancelled:
+                documentInfo.errorMessage = PDFToolTranslationContext::tr("Invalid password provided.");
+                return;
+
+            default:
+                documentInfo.errorMessage = PDFToolTranslationContext::tr("Error occured during document reading. %1").arg(reader.getErrorMessage());
+                return;
+        }
+
+        QString parseError;
+        std::vector<pdf::PDFInteger> pageIndices = documentOptions.getPageRange(document.getCatalog()->getPageCount(), parseError, true);
+        if (!parseError.isEmpty())
+        {
+            documentInfo.errorMessage = parseError;
+            return;
+        }
+
+        renderDocument(documentOptions, &document, qMove(pageIndices), &cmsManager, diskCache.get(), documentInfo);
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+
+    pdf::PDFIntegerRange<size_t> indices(0, m_documentInfo.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), processDocument);
+
+    m_wallTime = timer.elapsed();
+
+    finish(options);
+
+    const bool hasFailedDocument = std::any_of(m_documentInfo.cbegin(), m_documentInfo.cend(), [](const DocumentInfo& info) { return !info.errorMessage.isEmpty(); });
+    return hasFailedDocument ? ErrorDocumentReading : ExitSuccess;
+}
+
+void PDFToolRenderBase::renderDocument(const PDFToolOptions& options,
+                                       pdf::PDFDocument* document,
+                                       std::vector<pdf::PDFInteger> pageIndices,
+                                       const pdf::PDFCMSManager* cmsManager,
+                                       pdf::PDFDiskCache* diskCache,
+                                       DocumentInfo& documentInfo)
+{
+    pdf::PDFOptionalContentActivity optionalContentActivity(document, pdf::OCUsage::Export, nullptr);
     pdf::PDFMeshQualitySettings meshQualitySettings;
     pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
-    pdf::PDFModifiedDocument md(&document, &optionalContentActivity);
+    pdf::PDFModifiedDocument md(document, &optionalContentActivity);
     fontCache.setDocument(md);
     fontCache.setCacheShrinkEnabled(nullptr, false);
 
-    m_pageInfo.resize(document.getCatalog()->getPageCount());
-    pdf::PDFRasterizerPool rasterizerPool(&document, &fontCache, &cmsManager,
+    std::vector<PageInfo>& pageInfo = documentInfo.pageInfo;
+    pageInfo.resize(document->getCatalog()->getPageCount());
+    pdf::PDFRasterizerPool rasterizerPool(document, &fontCache, cmsManager,
                                           &optionalContentActivity, options.renderFeatures, meshQualitySettings,
                                           pdf::PDFRasterizerPool::getCorrectedRasterizerCount(options.renderRasterizerCount),
                                           options.renderUseSoftwareRendering ? pdf::RendererEngine::QPainter : pdf::RendererEngine::Blend2D_SingleThread, nullptr);
+    rasterizerPool.setStatisticsEnabled(isStatisticsCollected());
+    rasterizerPool.setDiskCache(diskCache);
 
-    auto onRenderError = [this](pdf::PDFInteger pageIndex, pdf::PDFRenderError error)
+    auto onRenderError = [&pageInfo](pdf::PDFInteger pageIndex, pdf::PDFRenderError error)
     {
         if (pageIndex != pdf::PDFCatalog::INVALID_PAGE_INDEX)
         {
-            m_pageInfo[pageIndex].errors.emplace_back(qMove(error));
+            pageInfo[pageIndex].errors.emplace_back(qMove(error));
         }
     };
     QObject holder;
@@ -225,28 +663,110 @@ int PDFToolRenderBase::execute(const PDFToolOptions& options)
         return QSize();
     };
 
-    QElapsedTimer timer;
-    timer.start();
+    if (isRenderedAsTilePyramid(options))
+    {
+        // Each page is compiled only once, then all tiles of all levels of its
+        // tile pyramid are rendered from the compiled page in parallel.
+        auto renderPage = [&, this](pdf::PDFInteger pageIndex)
+        {
+            renderPageTilePyramid(options, rasterizerPool, pageIndex, imageSizeGetter, pageInfo[pageIndex]);
+        };
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, pageIndices.cbegin(), pageIndices.cend(), renderPage);
 
-    rasterizerPool.render(pageIndices, imageSizeGetter, std::bind(&PDFToolRenderBase::onPageRendered, this, options, std::placeholders::_1), nullptr);
+        fontCache.setCacheShrinkEnabled(nullptr, true);
+        return;
+    }
 
-    m_wallTime = timer.elapsed();
+    // Huge pages are rendered in bands one by one, after other pages, so
+    // memory usage is bounded by band size (bands are rendered in parallel).
+    std::vector<pdf::PDFInteger> bandedPageIndices;
+    auto isPageRenderedInBands = [&, this](pdf::PDFInteger pageIndex)
+    {
+        const pdf::PDFPage* page = document->getCatalog()->getPage(pageIndex);
+        return page && isRenderedInBands(options, imageSizeGetter(page));
+    };
+    auto it = std::stable_partition(pageIndices.begin(), pageIndices.end(), std::not_fn(isPageRenderedInBands));
+    bandedPageIndices.assign(it, pageIndices.end());
+    pageIndices.erase(it, pageIndices.end());
+
+    auto processImage = [this, &options, &pageInfo](pdf::PDFRenderedPageImage& renderedPageImage)
+    {
+        onPageRendered(options, renderedPageImage, pageInfo[renderedPageImage.pageIndex]);
+    };
+    rasterizerPool.render(pageIndices, imageSizeGetter, processImage, nullptr);
+
+    for (pdf::PDFInteger pageIndex : bandedPageIndices)
+    {
+        renderPageInBands(options, rasterizerPool, pageIndex, imageSizeGetter, pageInfo[pageIndex]);
+    }
 
     fontCache.setCacheShrinkEnabled(nullptr, true);
+}
 
-    finish(options);
-    return ExitSuccess;
+bool PDFToolRenderBase::isRenderedInBands(const PDFToolOptions& options, QSize imageSize) const
+{
+    Q_UNUSED(options);
+    Q_UNUSED(imageSize);
+
+    return false;
+}
+
+void PDFToolRenderBase::renderPageInBands(const PDFToolOptions& options,
+                                          pdf::PDFRasterizerPool& rasterizerPool,
+                                          pdf::PDFInteger pageIndex,
+                                          const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                          PageInfo& pageInfo)
+{
+    Q_UNUSED(options);
+    Q_UNUSED(rasterizerPool);
+    Q_UNUSED(pageIndex);
+    Q_UNUSED(imageSizeGetter);
+    Q_UNUSED(pageInfo);
+
+    Q_ASSERT(false);
+}
+
+bool PDFToolRenderBase::isRenderedAsTilePyramid(const PDFToolOptions& options) const
+{
+    Q_UNUSED(options);
+
+    return false;
 }
 
-void PDFToolRenderBase::writePageInfoStatistics(const pdf::PDFRenderedPageImage& renderedPageImage)
+void PDFToolRenderBase::renderPageTilePyramid(const PDFToolOptions& options,
+                                              pdf::PDFRasterizerPool& rasterizerPool,
+                                              pdf::PDFInteger pageIndex,
+                                              const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                              PageInfo& pageInfo)
+{
+    Q_UNUSED(options);
+    Q_UNUSED(rasterizerPool);
+    Q_UNUSED(pageIndex);
+    Q_UNUSED(imageSizeGetter);
+    Q_UNUSED(pageInfo);
+
+    Q_ASSERT(false);
+}
+
+QString PDFToolRenderBase::getTitle(const QString& title) const
+{
+    if (m_isBatch)
+    {
+        return PDFToolTranslationContext::tr("Batch of %1 documents").arg(m_documentInfo.size());
+    }
+
+    return title;
+}
+
+void PDFToolRenderBase::writePageInfoStatistics(const pdf::PDFRenderedPageImage& renderedPageImage, PageInfo& info)
 {
-    PageInfo& info = m_pageInfo[renderedPageImage.pageIndex];
     info.isRendered = true;
     info.pageCompileTime = renderedPageImage.pageCompileTime;
     info.pageWaitTime = renderedPageImage.pageWaitTime;
     info.pageRenderTime = renderedPageImage.pageRenderTime;
     info.pageTotalTime = renderedPageImage.pageTotalTime;
     info.pageIndex = renderedPageImage.pageIndex;
+    info.statistics = renderedPageImage.statistics;
 }
 
 void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
@@ -259,19 +779,22 @@ void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
     qint64 pageTotalTime = 0;
     qint64 pageWriteTime = 0;
 
-    for (const PageInfo& info : m_pageInfo)
+    for (const DocumentInfo& documentInfo : m_documentInfo)
     {
-        if (!info.isRendered)
+        for (const PageInfo& info : documentInfo.pageInfo)
         {
-            continue;
-        }
+            if (!info.isRendered)
+            {
+                continue;
+            }
 
-        ++pagesRendered;
-        pageCompileTime += info.pageCompileTime;
-        pageWaitTime += info.pageWaitTime;
-        pageRenderTime += info.pageRenderTime;
-        pageTotalTime += info.pageTotalTime + info.pageWriteTime;
-        pageWriteTime += info.pageWriteTime;
+            ++pagesRendered;
+            pageCompileTime += info.pageCompileTime;
+            pageWaitTime += info.pageWaitTime;
+            pageRenderTime += info.pageRenderTime;
+            pageTotalTime += info.pageTotalTime + info.pageWriteTime;
+            pageWriteTime += info.pageWriteTime;
+        }
     }
 
     if (pagesRendered > 0 && pageTotalTime > 0 && m_wallTime > 0)
@@ -322,11 +845,61 @@ void PDFToolRenderBase::writeStatistics(PDFOutputFormatter& formatter)
     }
 }
 
+void PDFToolRenderBase::writeDocumentStatistics(PDFOutputFormatter& formatter)
+{
+    if (!m_isBatch)
+    {
+        return;
+    }
+
+    formatter.beginTable("document-statistics", PDFToolTranslationContext::tr("Documents"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("no", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("file", PDFToolTranslationContext::tr("File"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("status", PDFToolTranslationContext::tr("Status"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("pages-rendered", PDFToolTranslationContext::tr("Pages Rendered"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    QLocale locale;
+
+    int failedCount = 0;
+    for (size_t i = 0; i < m_documentInfo.size(); ++i)
+    {
+        const DocumentInfo& documentInfo = m_documentInfo[i];
+        const bool isFailed = !documentInfo.errorMessage.isEmpty();
+        const qint64 pagesRendered = std::count_if(documentInfo.pageInfo.cbegin(), documentInfo.pageInfo.cend(), [](const PageInfo& info) { return info.isRendered; });
+
+        if (isFailed)
+        {
+            ++failedCount;
+        }
+
+        formatter.beginTableRow("document", int(i + 1));
+        formatter.writeTableColumn("no", locale.toString(qint64(i + 1)), Qt::AlignRight);
+        formatter.writeTableColumn("file", documentInfo.fileName);
+        formatter.writeTableColumn("status", isFailed ? documentInfo.errorMessage : PDFToolTranslationContext::tr("OK"));
+        formatter.writeTableColumn("pages-rendered", locale.toString(pagesRendered), Qt::AlignRight);
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+
+    formatter.endl();
+    formatter.writeText("documents", PDFToolTranslationContext::tr("Documents: %1").arg(m_documentInfo.size()));
+    formatter.writeText("failed", PDFToolTranslationContext::tr("Failed documents: %1").arg(failedCount));
+    formatter.endl();
+}
+
 void PDFToolRenderBase::writePageStatistics(PDFOutputFormatter& formatter)
 {
     formatter.beginTable("page-statistics", PDFToolTranslationContext::tr("Page Statistics"));
 
     formatter.beginTableHeaderRow("header");
+    if (m_isBatch)
+    {
+        formatter.writeTableHeaderColumn("document-no", PDFToolTranslationContext::tr("Document No."), Qt::AlignLeft);
+    }
     formatter.writeTableHeaderColumn("page-no", PDFToolTranslationContext::tr("Page No."), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("compile-time", PDFToolTranslationContext::tr("Compile Time [msec]"), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("render-time", PDFToolTranslationContext::tr("Render Time [msec]"), Qt::AlignLeft);
@@ -337,25 +910,155 @@ void PDFToolRenderBase::writePageStatistics(PDFOutputFormatter& formatter)
 
     QLocale locale;
 
-    for (const PageInfo& info : m_pageInfo)
+    for (size_t i = 0; i < m_documentInfo.size(); ++i)
     {
-        if (!info.isRendered)
+        for (const PageInfo& info : m_documentInfo[i].pageInfo)
         {
-            continue;
+            if (!info.isRendered)
+            {
+                continue;
+            }
+
+            formatter.beginTableRow("page", info.pageIndex + 1);
+            if (m_isBatch)
+            {
+                formatter.writeTableColumn("document-no", locale.toString(qint64(i + 1)), Qt::AlignRight);
+            }
+            formatter.writeTableColumn("page-no", locale.toString(info.pageIndex + 1), Qt::AlignRight);
+            formatter.writeTableColumn("compile-time", locale.toString(info.pageCompileTime), Qt::AlignRight);
+            formatter.writeTableColumn("render-time", locale.toString(info.pageRenderTime), Qt::AlignRight);
+            formatter.writeTableColumn("wait-time", locale.toString(info.pageWaitTime), Qt::AlignRight);
+            formatter.writeTableColumn("write-time", locale.toString(info.pageWriteTime), Qt::AlignRight);
+            formatter.writeTableColumn("total-time", locale.toString(info.pageTotalTime), Qt::AlignRight);
+            formatter.endTableRow();
         }
+    }
+
+    formatter.endTable();
+    formatter.endl();
+}
 
-        formatter.beginTableRow("page", info.pageIndex + 1);
-        formatter.writeTableColumn("page-no", locale.toString(info.pageIndex + 1), Qt::AlignRight);
-        formatter.writeTableColumn("compile-time", locale.toString(info.pageCompileTime), Qt::AlignRight);
-        formatter.writeTableColumn("render-time", locale.toString(info.pageRenderTime), Qt::AlignRight);
-        formatter.writeTableColumn("wait-time", locale.toString(info.pageWaitTime), Qt::AlignRight);
-        formatter.writeTableColumn("write-time", locale.toString(info.pageWriteTime), Qt::AlignRight);
-        formatter.writeTableColumn("total-time", locale.toString(info.pageTotalTime), Qt::AlignRight);
+void PDFToolRenderBase::writeContentStatistics(PDFOutputFormatter& formatter)
+{
+    using Category = pdf::PDFPageContentProcessorStatistics::Category;
+
+    pdf::PDFPageContentProcessorStatistics statistics;
+    bool hasStatistics = false;
+
+    for (const DocumentInfo& documentInfo : m_documentInfo)
+    {
+        for (const PageInfo& info : documentInfo.pageInfo)
+        {
+            if (info.isRendered && info.statistics)
+            {
+                statistics.merge(*info.statistics);
+                hasStatistics = true;
+            }
+        }
+    }
+
+    if (!hasStatistics)
+    {
+        return;
+    }
+
+    QLocale locale;
+    auto toMsec = [&locale](qint64 nsec) { return locale.toString(double(nsec) / 1000000.0, 'f', 3); };
+    auto toRatio = [&locale](qint64 value, qint64 total) { return total > 0 ? locale.toString(100.0 * double(value) / double(total), 'f', 2) : QString("-"); };
+
+    // Jakub Melka: Time of operators is exclusive, i.e. time of operators of the form
+    // XObject is not included in the time of the Do operator (but image decoding is
+    // included in the time of the image operators).
+    qint64 operatorTotalTime = 0;
+    for (const pdf::PDFPageContentProcessorStatistics::Entry& entry : statistics.operators)
+    {
+        operatorTotalTime += entry.time;
+    }
+
+    formatter.beginTable("operator-statistics", PDFToolTranslationContext::tr("Content Stream Operators"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("category", PDFToolTranslationContext::tr("Category"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("count", PDFToolTranslationContext::tr("Count"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("time", PDFToolTranslationContext::tr("Time [msec]"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("ratio", PDFToolTranslationContext::tr("Ratio [%]"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (size_t i = 0; i < pdf::PDFPageContentProcessorStatistics::CATEGORY_COUNT; ++i)
+    {
+        const pdf::PDFPageContentProcessorStatistics::Entry& entry = statistics.operators[i];
+
+        formatter.beginTableRow("operator-category");
+        formatter.writeTableColumn("category", pdf::PDFPageContentProcessorStatistics::getCategoryName(static_cast<Category>(i)));
+        formatter.writeTableColumn("count", locale.toString(entry.count), Qt::AlignRight);
+        formatter.writeTableColumn("time", toMsec(entry.time), Qt::AlignRight);
+        formatter.writeTableColumn("ratio", toRatio(entry.time, operatorTotalTime), Qt::AlignRight);
         formatter.endTableRow();
     }
 
     formatter.endTable();
     formatter.endl();
+
+    if (!statistics.imageDecoding.empty())
+    {
+        formatter.beginTable("image-decoding-statistics", PDFToolTranslationContext::tr("Image Decoding"));
+
+        formatter.beginTableHeaderRow("header");
+        formatter.writeTableHeaderColumn("filter", PDFToolTranslationContext::tr("Filter"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("count", PDFToolTranslationContext::tr("Count"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("time", PDFToolTranslationContext::tr("Time [msec]"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("average-time", PDFToolTranslationContext::tr("Average Time [msec]"), Qt::AlignLeft);
+        formatter.endTableHeaderRow();
+
+        for (const auto& item : statistics.imageDecoding)
+        {
+            const pdf::PDFPageContentProcessorStatistics::Entry& entry = item.second;
+
+            formatter.beginTableRow("image-filter");
+            formatter.writeTableColumn("filter", !item.first.isEmpty() ? QString::fromLatin1(item.first) : PDFToolTranslationContext::tr("(none)"));
+            formatter.writeTableColumn("count", locale.toString(entry.count), Qt::AlignRight);
+            formatter.writeTableColumn("time", toMsec(entry.time), Qt::AlignRight);
+            formatter.writeTableColumn("average-time", toMsec(entry.count > 0 ? entry.time / entry.count : 0), Qt::AlignRight);
+            formatter.endTableRow();
+        }
+
+        formatter.endTable();
+        formatter.endl();
+    }
+
+    formatter.beginTable("content-statistics", PDFToolTranslationContext::tr("Color Management and Caches"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("description", PDFToolTranslationContext::tr("Description"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("value", PDFToolTranslationContext::tr("Value"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("unit", PDFToolTranslationContext::tr("Unit"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    auto writeValue = [&formatter](QString name, QString description, QString value, QString unit)
+    {
+        formatter.beginTableRow(name);
+        formatter.writeTableColumn("description", description);
+        formatter.writeTableColumn("value", value, Qt::AlignRight);
+        formatter.writeTableColumn("unit", unit);
+        formatter.endTableRow();
+    };
+
+    const qint64 imageCacheAccesses = statistics.imageCacheHits + statistics.imageCacheMisses;
+    const qint64 colorCacheAccesses = statistics.colorCacheHits + statistics.colorCacheMisses;
+    const qint64 contentStreamCacheAccesses = statistics.contentStreamCacheHits + statistics.contentStreamCacheMisses;
+
+    writeValue("image-color-conversion-time", PDFToolTranslationContext::tr("Image color conversion time"), toMsec(statistics.imageColorConversion.time), PDFToolTranslationContext::tr("msec"));
+    writeValue("image-color-conversion-count", PDFToolTranslationContext::tr("Image color conversions"), locale.toString(statistics.imageColorConversion.count), PDFToolTranslationContext::tr("-"));
+    writeValue("color-conversion-time", PDFToolTranslationContext::tr("Color conversion time"), toMsec(statistics.colorConversion.time), PDFToolTranslationContext::tr("msec"));
+    writeValue("color-conversion-count", PDFToolTranslationContext::tr("Color conversions"), locale.toString(statistics.colorConversion.count), PDFToolTranslationContext::tr("-"));
+    writeValue("image-cache-hits", PDFToolTranslationContext::tr("Image cache hits"), locale.toString(statistics.imageCacheHits), PDFToolTranslationContext::tr("-"));
+    writeValue("image-cache-misses", PDFToolTranslationContext::tr("Image cache misses"), locale.toString(statistics.imageCacheMisses), PDFToolTranslationContext::tr("-"));
+    writeValue("image-cache-hit-ratio", PDFToolTranslationContext::tr("Image cache hit ratio"), toRatio(statistics.imageCacheHits, imageCacheAccesses), PDFToolTranslationContext::tr("%"));
+    writeValue("color-cache-hit-ratio", PDFToolTranslationContext::tr("Color cache hit ratio"), toRatio(statistics.colorCacheHits, colorCacheAccesses), PDFToolTranslationContext::tr("%"));
+    writeValue("content-stream-cache-hit-ratio", PDFToolTranslationContext::tr("Content stream cache hit ratio"), toRatio(statistics.contentStreamCacheHits, contentStreamCacheAccesses), PDFToolTranslationContext::tr("%"));
+
+    formatter.endTable();
+    formatter.endl();
 }
 
 void PDFToolRenderBase::writeErrors(PDFOutputFormatter& formatter)
@@ -363,6 +1066,10 @@ void PDFToolRenderBase::writeErrors(PDFOutputFormatter& formatter)
     formatter.beginTable("rendering-errors", PDFToolTranslationContext::tr("Rendering Errors"));
 
     formatter.beginTableHeaderRow("header");
+    if (m_isBatch)
+    {
+        formatter.writeTableHeaderColumn("document-no", PDFToolTranslationContext::tr("Document No."), Qt::AlignLeft);
+    }
     formatter.writeTableHeaderColumn("page-no", PDFToolTranslationContext::tr("Page No."), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("type", PDFToolTranslationContext::tr("Type"), Qt::AlignLeft);
     formatter.writeTableHeaderColumn("message", PDFToolTranslationContext::tr("Message"), Qt::AlignLeft);
@@ -370,48 +1077,55 @@ void PDFToolRenderBase::writeErrors(PDFOutputFormatter& formatter)
 
     QLocale locale;
 
-    for (const PageInfo& info : m_pageInfo)
+    for (size_t i = 0; i < m_documentInfo.size(); ++i)
     {
-        if (!info.isRendered)
-        {
-            continue;
-        }
-
-        for (const pdf::PDFRenderError& error : info.errors)
+        for (const PageInfo& info : m_documentInfo[i].pageInfo)
         {
-            QString type;
-            switch (error.type)
+            if (!info.isRendered)
             {
-                case pdf::RenderErrorType::Error:
-                    type = PDFToolTranslationContext::tr("Error");
-                    break;
-
-                case pdf::RenderErrorType::Warning:
-                    type = PDFToolTranslationContext::tr("Warning");
-                    break;
-
-                case pdf::RenderErrorType::NotImplemented:
-                    type = PDFToolTranslationContext::tr("Not implemented");
-                    break;
-
-                case pdf::RenderErrorType::NotSupported:
-                    type = PDFToolTranslationContext::tr("Not supported");
-                    break;
-
-                case pdf::RenderErrorType::Information:
-                    type = PDFToolTranslationContext::tr("Information");
-                    break;
-
-                default:
-                    Q_ASSERT(false);
-                    break;
+                continue;
             }
 
-            formatter.beginTableRow("page", info.pageIndex + 1);
-            formatter.writeTableColumn("page-no", locale.toString(info.pageIndex + 1), Qt::AlignRight);
-            formatter.writeTableColumn("type", type, Qt::AlignLeft);
-            formatter.writeTableColumn("message", error.message, Qt::AlignLeft);
-            formatter.endTableRow();
+            for (const pdf::PDFRenderError& error : info.errors)
+            {
+                QString type;
+                switch (error.type)
+                {
+                    case pdf::RenderErrorType::Error:
+                        type = PDFToolTranslationContext::tr("Error");
+                        break;
+
+                    case pdf::RenderErrorType::Warning:
+                        type = PDFToolTranslationContext::tr("Warning");
+                        break;
+
+                    case pdf::RenderErrorType::NotImplemented:
+                        type = PDFToolTranslationContext::tr("Not implemented");
+                        break;
+
+                    case pdf::RenderErrorType::NotSupported:
+                        type = PDFToolTranslationContext::tr("Not supported");
+                        break;
+
+                    case pdf::RenderErrorType::Information:
+                        type = PDFToolTranslationContext::tr("Information");
+                        break;
+
+                    default:
+                        Q_ASSERT(false);
+                        break;
+                }
+
+                formatter.beginTableRow("page", info.pageIndex + 1);
+                if (m_isBatch)
+                {
+                    formatter.writeTableColumn("document-no", locale.toString(qint64(i + 1)), Qt::AlignRight);
+                }
+                formatter.writeTableColumn("page-no", locale.toString(info.pageIndex + 1), Qt::AlignRight);
+                formatter.writeTableColumn("type", type, Qt::AlignLeft);
+                formatter.writeTableColumn("message", error.message, Qt::AlignLeft);
+                formatter.endTableRow();
+            }
         }
     }
 
@@ -21,6 +21,8 @@
 #include "pdftoolabstractapplication.h"
 #include "pdfexception.h"
 
+#include <memory>
+
 namespace pdftool
 {
 
@@ -30,15 +32,6 @@ public:
     virtual int execute(const PDFToolOptions& options) override;
 
 protected:
-    virtual void finish(const PDFToolOptions& options) = 0;
-    virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage) = 0;
-
-    void writePageInfoStatistics(const pdf::PDFRenderedPageImage& renderedPageImage);
-
-    void writeStatistics(PDFOutputFormatter& formatter);
-    void writePageStatistics(PDFOutputFormatter& formatter);
-    void writeErrors(PDFOutputFormatter& formatter);
-
     struct PageInfo
     {
         bool isRendered = false;
@@ -49,10 +42,87 @@ protected:
         qint64 pageTotalTime = 0;
         qint64 pageWriteTime = 0;
         std::vector<pdf::PDFRenderError> errors;
+        std::shared_ptr<pdf::PDFPageContentProcessorStatistics> statistics; ///< Statistics of page content processing (can be nullptr)
     };
 
-    std::vector<PageInfo> m_pageInfo;
+    struct DocumentInfo
+    {
+        QString fileName;
+        QString errorMessage; ///< Error message, if document can't be rendered (batch mode only)
+        std::vector<PageInfo> pageInfo;
+    };
+
+    virtual void finish(const PDFToolOptions& options) = 0;
+    virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage, PageInfo& pageInfo) = 0;
+
+    /// Returns true, if statistics of the page content processing are collected
+    /// (time of operators by category, image decoding, color conversion...).
+    /// Collecting of statistics has small overhead, so by default, they are not collected.
+    virtual bool isStatisticsCollected() const { return false; }
+
+    /// Returns true, if page image of given size is rendered in bands and
+    /// streamed directly to the output, instead of rendering whole image
+    /// into the memory.
+    virtual bool isRenderedInBands(const PDFToolOptions& options, QSize imageSize) const;
+
+    /// Renders page in bands, it is called only for pages, for which
+    /// function \p isRenderedInBands returns true.
+    virtual void renderPageInBands(const PDFToolOptions& options,
+                                   pdf::PDFRasterizerPool& rasterizerPool,
+                                   pdf::PDFInteger pageIndex,
+                                   const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                   PageInfo& pageInfo);
+
+    /// Returns true, if pages are rendered into multi-resolution
+    /// tile pyramids, instead of single page images.
+    virtual bool isRenderedAsTilePyramid(const PDFToolOptions& options) const;
+
+    /// Renders tile pyramid of the page, it is called only, if function
+    /// \p isRenderedAsTilePyramid returns true. Function is called for
+    /// multiple pages in parallel.
+    virtual void renderPageTilePyramid(const PDFToolOptions& options,
+                                       pdf::PDFRasterizerPool& rasterizerPool,
+                                       pdf::PDFInteger pageIndex,
+                                       const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                       PageInfo& pageInfo);
+
+    /// Returns title of the output. In batch mode, title describes
+    /// the batch, otherwise \p title is returned.
+    /// \param title Title of the single document output
+    QString getTitle(const QString& title) const;
+
+    void writePageInfoStatistics(const pdf::PDFRenderedPageImage& renderedPageImage, PageInfo& pageInfo);
+
+    void writeStatistics(PDFOutputFormatter& formatter);
+    void writeDocumentStatistics(PDFOutputFormatter& formatter);
+    void writePageStatistics(PDFOutputFormatter& formatter);
+    void writeContentStatistics(PDFOutputFormatter& formatter);
+    void writeErrors(PDFOutputFormatter& formatter);
+
+    std::vector<DocumentInfo> m_documentInfo;
     qint64 m_wallTime = 0;
+    bool m_isBatch = false;
+
+private:
+    /// Renders all documents of the batch. Documents are processed in parallel,
+    /// and pages of each document are also rendered in parallel, so pages
+    /// of different documents are interleaved and all cores are used, even
+    /// if documents have only few pages.
+    int executeBatch(const PDFToolOptions& options);
+
+    /// Renders selected pages of the document
+    /// \param options Options
+    /// \param document Document
+    /// \param pageIndices Rendered pages
+    /// \param cmsManager Color management system manager
+    /// \param diskCache Disk cache of rendered page images (can be nullptr)
+    /// \param documentInfo Document info, where results are stored
+    void renderDocument(const PDFToolOptions& options,
+                        pdf::PDFDocument* document,
+                        std::vector<pdf::PDFInteger> pageIndices,
+                        const pdf::PDFCMSManager* cmsManager,
+                        pdf::PDFDiskCache* diskCache,
+                        DocumentInfo& documentInfo);
 };
 
 class PDFToolRender : public PDFToolRenderBase
@@ -63,7 +133,43 @@ public:
 
 protected:
     virtual void finish(const PDFToolOptions& options) override;
-    virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage) override;
+    virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage, PageInfo& pageInfo) override;
+    virtual bool isRenderedInBands(const PDFToolOptions& options, QSize imageSize) const override;
+    virtual void renderPageInBands(const PDFToolOptions& options,
+                                   pdf::PDFRasterizerPool& rasterizerPool,
+                                   pdf::PDFInteger pageIndex,
+                                   const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                   PageInfo& pageInfo) override;
+    virtual bool isRenderedAsTilePyramid(const PDFToolOptions& options) const override;
+    virtual void renderPageTilePyramid(const PDFToolOptions& options,
+                                       pdf::PDFRasterizerPool& rasterizerPool,
+                                       pdf::PDFInteger pageIndex,
+                                       const pdf::PDFRasterizerPool::PageImageSizeGetter& imageSizeGetter,
+                                       PageInfo& pageInfo) override;
+
+private:
+    /// Writes image to the file using image writer settings. Returns
+    /// false, if image can't be written. This function is thread safe.
+    /// \param options Options
+    /// \param fileName File name
+    /// \param image Image
+    /// \param errorMessage Error message, if image can't be written
+    static bool writeImage(const PDFToolOptions& options, const QString& fileName, const QImage& image, QString& errorMessage);
+
+    /// Returns true, if images are written using built-in fast PNG encoder
+    /// (see PDFPNGStreamWriter), instead of image writer.
+    /// \param options Options
+    static bool isFastPngEncoderUsed(const PDFToolOptions& options);
+
+    /// Compression level of the fast PNG encoder (fastest zlib compression)
+    static constexpr int FAST_PNG_COMPRESSION_LEVEL = 1;
+
+    /// Page images with at least this number of pixels are streamed
+    /// to the file in bands (if image format supports it)
+    static constexpr qint64 BANDED_RENDERING_MIN_PIXELS = 8192 * 8192;
+
+    /// Height of the band in pixels
+    static constexpr int BAND_HEIGHT = 256;
 };
 
 class PDFToolBenchmark : public PDFToolRenderBase
@@ -74,7 +180,13 @@ public:
 
 protected:
     virtual void finish(const PDFToolOptions& options) override;
-    virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage) override;
+    virtual void onPageRendered(const PDFToolOptions& options, pdf::PDFRenderedPageImage& renderedPageImage, PageInfo& pageInfo) override;
+    virtual bool isStatisticsCollected() const override { return true; }
+
+private:
+    /// Returns peak resident memory of the process in bytes. If it can't
+    /// be determined, -1 is returned.
+    static qint64 getPeakMemoryUsage();
 };
 
 }   // namespace pdftool
@@ -0,0 +1,296 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "pdftoolsanitize.h"
+#include "pdfdocumentreader.h"
+#include "pdfdocumentwriter.h"
+#include "pdfdocumentsanitizer.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfexception.h"
+#include "pdfutils.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDirIterator>
+
+namespace pdftool
+{
+
+static PDFToolSanitize s_sanitizeApplication;
+
+QString PDFToolSanitize::getStandardString(PDFToolAbstractApplication::StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "sanitize";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Sanitize");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Remove sensitive content (document info, metadata, attachments, ...) from documents.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolSanitize::execute(const PDFToolOptions& options)
+{
+    if (!options.sanitizeFlags)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No sanitization option has been set."), options.outputCodec);
+        return ErrorInvalidArguments;
+    }
+
+    if (options.sanitizeBatch)
+    {
+        return executeBatch(options);
+    }
+
+    if (options.document.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No document specified."), options.outputCodec);
+        return ErrorNoDocumentSpecified;
+    }
+
+    QString outputFileName = options.document;
+    if (!options.sanitizeOutputDirectory.isEmpty())
+    {
+        outputFileName = QDir(options.sanitizeOutputDirectory).filePath(QFileInfo(options.document).fileName());
+    }
+
+    QStringList messages;
+    QString errorMessage;
+    const int result = sanitizeDocument(options, options.document, outputFileName, messages, errorMessage);
+
+    for (const QString& message : messages)
+    {
+        PDFConsole::writeError(message, options.outputCodec);
+    }
+
+    if (result != ExitSuccess)
+    {
+        PDFConsole::writeError(errorMessage, options.outputCodec);
+    }
+
+    return result;
+}
+
+PDFToolAbstractApplication::Options PDFToolSanitize::getOptionsFlags() const
+{
+    return ConsoleFormat | OpenDocument | Sanitize;
+}
+
+int PDFToolSanitize::executeBatch(const PDFToolOptions& options)
+{
+    QStringList arguments = options.sanitizeBatchFiles;
+    if (!options.sanitizeBatchListFile.isEmpty())
+    {
+        QFile listFile(options.sanitizeBatchListFile);
+        if (!listFile.open(QFile::ReadOnly | QFile::Text))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot read file list '%1'.").arg(options.sanitizeBatchListFile), options.outputCodec);
+            return ErrorInvalidArguments;
+        }
+
+        while (!listFile.atEnd())
+        {
+            QString fileName = QString::fromUtf8(listFile.readLine()).trimmed();
+            if (!fileName.isEmpty())
+            {
+                arguments << fileName;
+            }
+        }
+    }
+
+    // Documents from directories are written to the output directory
+    // with the same relative path as they have in the source directory.
+    QStringList fileNames;
+    QStringList outputFileNames;
+    QDir outputDirectory(options.sanitizeOutputDirectory);
+    QDirIterator::IteratorFlags iteratorFlags = options.sanitizeBatchRecursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags;
+    for (const QString& argument : arguments)
+    {
+        QStringList directoryFileNames;
+        QDir directory;
+
+        if (QFileInfo(argument).isDir())
+        {
+            directory = QDir(argument);
+            QDirIterator directoryIterator(argument, QStringList() << "*.pdf", QDir::Files, iteratorFlags);
+            while (directoryIterator.hasNext())
+            {
+                directoryFileNames << directoryIterator.next();
+            }
+            directoryFileNames.sort();
+        }
+        else
+        {
+            directory = QFileInfo(argument).dir();
+            directoryFileNames << argument;
+        }
+
+        for (const QString& fileName : directoryFileNames)
+        {
+            fileNames << fileName;
+            outputFileNames << (options.sanitizeOutputDirectory.isEmpty() ? fileName : outputDirectory.filePath(directory.relativeFilePath(fileName)));
+        }
+    }
+
+    if (fileNames.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No document specified."), options.outputCodec);
+        return ErrorNoDocumentSpecified;
+    }
+
+    struct DocumentResult
+    {
+        QString errorMessage;
+        QStringList messages;
+    };
+
+    std::vector<DocumentResult> results(fileNames.size());
+    auto processDocument = [&](size_t i)
+    {
+        DocumentResult& documentResult = results[i];
+        sanitizeDocument(options, fileNames[int(i)], outputFileNames[int(i)], documentResult.messages, documentResult.errorMessage);
+    };
+
+    pdf::PDFIntegerRange<size_t> indices(0, results.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), processDocument);
+
+    PDFOutputFormatter formatter(options.outputStyle);
+    formatter.beginDocument("sanitize-batch", PDFToolTranslationContext::tr("Sanitization of %1 documents").arg(fileNames.size()));
+    formatter.endl();
+
+    int failedCount = 0;
+
+    formatter.beginTable("documents", PDFToolTranslationContext::tr("Documents"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("no", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("file", PDFToolTranslationContext::tr("File"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("status", PDFToolTranslationContext::tr("Status"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("changes", PDFToolTranslationContext::tr("Changes"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const DocumentResult& documentResult = results[i];
+        const bool isFailed = !documentResult.errorMessage.isEmpty();
+
+        if (isFailed)
+        {
+            ++failedCount;
+        }
+
+        formatter.beginTableRow("document", int(i + 1));
+        formatter.writeTableColumn("no", QString::number(i + 1), Qt::AlignRight);
+        formatter.writeTableColumn("file", fileNames[int(i)]);
+        formatter.writeTableColumn("status", isFailed ? documentResult.errorMessage : PDFToolTranslationContext::tr("OK"));
+        formatter.writeTableColumn("changes", documentResult.messages.join(" "));
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+
+    formatter.endl();
+    formatter.writeText("documents", PDFToolTranslationContext::tr("Documents: %1").arg(fileNames.size()));
+    formatter.writeText("failed", PDFToolTranslationContext::tr("Failed documents: %1").arg(failedCount));
+    formatter.endDocument();
+
+    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    return failedCount > 0 ? ErrorDocumentReading : ExitSuccess;
+}
+
+int PDFToolSanitize::sanitizeDocument(const PDFToolOptions& options,
+                                      const QString& fileName,
+                                      const QString& outputFileName,
+                                      QStringList& messages,
+                                      QString& errorMessage)
+{
+    bool isFirstPasswordAttempt = true;
+    auto passwordCallback = [&options, &isFirstPasswordAttempt](bool* ok) -> QString
+    {
+        *ok = isFirstPasswordAttempt;
+        isFirstPasswordAttempt = false;
+        return options.password;
+    };
+
+    // Jakub Melka: document is loaded lazily and original data of objects are kept,
+    // so only objects needed for sanitization are parsed, and objects, which are
+    // not modified by sanitization, are written using their original data.
+    pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, false);
+    reader.setMemoryMapping(true);
+    reader.setObjectSourceKept(true);
+    reader.setLazyLoading(true);
+    pdf::PDFDocument document = reader.readFromFile(fileName);
+
+    switch (reader.getReadingResult())
+    {
+        case pdf::PDFDocumentReader::Result::OK:
+            break;
+
+        case pdf::PDFDocumentReader::Result::Cancelled:
+            errorMessage = PDFToolTranslationContext::tr("Invalid password provided.");
+            return ErrorDocumentReading;
+
+        default:
+            errorMessage = PDFToolTranslationContext::tr("Error occured during document reading. %1").arg(reader.getErrorMessage());
+            return ErrorDocumentReading;
+    }
+
+    try
+    {
+        pdf::PDFDocumentSanitizer sanitizer(pdf::PDFDocumentSanitizer::None, nullptr);
+        sanitizer.setFlags(options.sanitizeFlags);
+        QObject::connect(&sanitizer, &pdf::PDFDocumentSanitizer::sanitizationProgress, &sanitizer, [&messages](QString text) { messages << text; }, Qt::DirectConnection);
+        sanitizer.setDocument(&document);
+        sanitizer.sanitize();
+        document = pdf::PDFDocument(sanitizer.takeStorage(), document.getInfo()->version, QByteArray());
+    }
+    catch (const pdf::PDFException& exception)
+    {
+        errorMessage = PDFToolTranslationContext::tr("Failed to sanitize document. %1").arg(exception.getMessage());
+        return ErrorUnknown;
+    }
+
+    if (!QDir().mkpath(QFileInfo(outputFileName).absolutePath()))
+    {
+        errorMessage = PDFToolTranslationContext::tr("Cannot create directory for file '%1'.").arg(outputFileName);
+        return ErrorFailedWriteToFile;
+    }
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    pdf::PDFOperationResult result = writer.write(outputFileName, &document, true);
+    if (!result)
+    {
+        errorMessage = PDFToolTranslationContext::tr("Failed to write sanitized document. %1").arg(result.getErrorMessage());
+        return ErrorFailedWriteToFile;
+    }
+
+    return ExitSuccess;
+}
+
+}   // namespace pdftool
@@ -0,0 +1,54 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#ifndef PDFTOOLSANITIZE_H
+#define PDFTOOLSANITIZE_H
+
+#include "pdftoolabstractapplication.h"
+
+namespace pdftool
+{
+
+class PDFToolSanitize : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+
+private:
+    /// Sanitizes multiple documents in parallel, writes one report
+    int executeBatch(const PDFToolOptions& options);
+
+    /// Sanitizes document and writes it to the output file. Returns
+    /// exit code, if it is not success, then error message is set.
+    /// \param options Options
+    /// \param fileName Document file name
+    /// \param outputFileName Output file name (can be same as \p fileName)
+    /// \param[out] messages Sanitization progress messages
+    /// \param[out] errorMessage Error message
+    static int sanitizeDocument(const PDFToolOptions& options,
+                                const QString& fileName,
+                                const QString& outputFileName,
+                                QStringList& messages,
+                                QString& errorMessage);
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLSANITIZE_H
@@ -20,7 +20,10 @@
 #include "pdfexception.h"
 #include "pdfoptimizer.h"
 #include "pdfdocumentwriter.h"
+#include "pdfdocumentmanipulator.h"
+#include "pdfexecutionpolicy.h"
 
+#include <QFile>
 #include <QFileInfo>
 
 namespace pdftool
@@ -85,8 +88,97 @@ int PDFToolSeparate::execute(const PDFToolOptions& options)
         return ErrorInvalidArguments;
     }
 
+    if (options.separateFast)
+    {
+        pdf::PDFDocumentPageSplitter splitter(&document);
+        pdf::PDFOperationResult result = splitter.prepare(pageIndices);
+        if (!result)
+        {
+            PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+            return ErrorUnknown;
+        }
+
+        // Pages are written in parallel, errors are reported afterwards
+        std::vector<QString> errors(pageIndices.size());
+        auto writePage = [&](size_t index)
+        {
+            const pdf::PDFInteger pageIndex = pageIndices[index];
+            QString fileName = options.separatePagePattern;
+            fileName.replace('%', QString::number(pageIndex + 1));
+
+            if (QFileInfo::exists(fileName))
+            {
+                errors[index] = PDFToolTranslationContext::tr("File '%1' already exists. Page %2 was not extracted.").arg(fileName).arg(pageIndex + 1);
+                return;
+            }
+
+            QFile file(fileName);
+            if (!file.open(QFile::WriteOnly | QFile::Truncate))
+            {
+                errors[index] = PDFToolTranslationContext::tr("File '%1' can't be opened for writing. Page %2 was not extracted.").arg(fileName).arg(pageIndex + 1);
+                return;
+            }
+
+            pdf::PDFOperationResult writeResult = splitter.writePage(pageIndex, &file);
+            file.close();
+
+            if (!writeResult)
+            {
+                errors[index] = writeResult.getErrorMessage();
+                file.remove();
+            }
+        };
+
+        pdf::PDFIntegerRange<size_t> range(0, pageIndices.size());
+        pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, range.begin(), range.end(), writePage);
+
+        for (const QString& error : errors)
+        {
+            if (!error.isEmpty())
+            {
+                PDFConsole::writeError(error, options.outputCodec);
+            }
+        }
+
+        return ExitSuccess;
+    }
+
     for (pdf::PDFInteger pageIndex : pageIndices)
     {
+        if (options.assembleStreaming)
+        {
+            // Only objects of the page are written, document is not copied
+            QString fileName = options.separatePagePattern;
+            fileName.replace('%', QString::number(pageIndex + 1));
+
+            if (QFileInfo::exists(fileName))
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("File '%1' already exists. Page %2 was not extracted.").arg(fileName).arg(pageIndex + 1), options.outputCodec);
+                continue;
+            }
+
+            QFile file(fileName);
+            if (!file.open(QFile::WriteOnly | QFile::Truncate))
+            {
+                PDFConsole::writeError(PDFToolTranslationContext::tr("File '%1' can't be opened for writing. Page %2 was not extracted.").arg(fileName).arg(pageIndex + 1), options.outputCodec);
+                continue;
+            }
+
+            pdf::PDFStreamingDocumentAssembler assembler(&file);
+            pdf::PDFOperationResult result = assembler.addDocument(&document, { pageIndex });
+            if (result)
+            {
+                result = assembler.finish();
+            }
+
+            if (!result)
+            {
+                PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+                file.remove();
+            }
+            continue;
+        }
+
         try
         {
             pdf::PDFDocumentBuilder documentBuilder(&document);
@@ -0,0 +1,689 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "pdftoolserver.h"
+#include "pdfconstants.h"
+#include "pdfdocumentreader.h"
+#include "pdfdocumenttextflow.h"
+#include "pdfrenderer.h"
+#include "pdfutils.h"
+
+#include <QBuffer>
+#include <QThread>
+#include <QPointer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QThreadPool>
+#include <QImageWriter>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonDocument>
+
+#include <map>
+#include <algorithm>
+
+namespace pdftool
+{
+
+static PDFToolServerApplication s_serverApplication;
+
+/// Default resolution of rendered page images, if job doesn't specify it
+static constexpr pdf::PDFReal DEFAULT_RENDER_DPI = 96.0;
+
+/// Maximal width/height of rendered page images in pixels
+static constexpr int MAXIMAL_RENDER_IMAGE_SIZE = 16384;
+
+/// Maximal length of one job (line) in bytes, client sending longer lines is dropped
+static constexpr qint64 MAXIMAL_JOB_LENGTH = 1024 * 1024;
+
+/// Timeout for connecting to an existing server, when server socket is in use
+static constexpr int SERVER_PROBE_TIMEOUT = 1000;
+
+QString PDFToolServerApplication::getStandardString(StandardString standardString) const
+{
+    switch (standardString)
+    {
+        case Command:
+            return "server";
+
+        case Name:
+            return PDFToolTranslationContext::tr("Server");
+
+        case Description:
+            return PDFToolTranslationContext::tr("Run as a server, which processes render, text and info jobs sent as JSON objects (one per line) through the local socket.");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
+int PDFToolServerApplication::execute(const PDFToolOptions& options)
+{
+    m_documentCacheLimit = qMax(options.serverMaxDocuments, 1);
+    m_diskCache = createDiskCache(options);
+
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(options.serverMaxJobs > 0 ? options.serverMaxJobs : QThread::idealThreadCount());
+
+    QLocalServer server;
+    server.setSocketOptions(QLocalServer::UserAccessOption);
+
+    bool isListening = server.listen(options.serverName);
+    if (!isListening && server.serverError() == QAbstractSocket::AddressInUseError)
+    {
+        // Stale socket can remain after the crash of the previous server. Remove it
+        // only, if no server is answering on it, otherwise running server would be
+        // disconnected from its socket.
+        QLocalSocket probeSocket;
+        probeSocket.connectToServer(options.serverName);
+        if (!probeSocket.waitForConnected(SERVER_PROBE_TIMEOUT))
+        {
+            QLocalServer::removeServer(options.serverName);
+            isListening = server.listen(options.serverName);
+        }
+    }
+
+    if (!isListening)
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot start server '%1', because: %2").arg(options.serverName, server.errorString()), options.outputCodec);
+        return ErrorServer;
+    }
+
+    auto writeResponse = [](QLocalSocket* socket, const QJsonObject& response)
+    {
+        socket->write(QJsonDocument(response).toJson(QJsonDocument::Compact));
+        socket->write("\n");
+    };
+
+    auto onReadyRead = [this, &options, &threadPool, writeResponse](QLocalSocket* socket)
+    {
+        auto dropClient = [socket, writeResponse]()
+        {
+            writeResponse(socket, createErrorResponse(QJsonObject(), PDFToolTranslationContext::tr("Job is too long (maximal length is %1 bytes).").arg(MAXIMAL_JOB_LENGTH)));
+            QObject::disconnect(socket, &QLocalSocket::readyRead, nullptr, nullptr);
+            socket->disconnectFromServer();
+        };
+
+        while (socket->canReadLine())
+        {
+            QByteArray line = socket->readLine(MAXIMAL_JOB_LENGTH);
+            if (!line.endsWith('\n'))
+            {
+                dropClient();
+                return;
+            }
+
+            line = line.trimmed();
+            if (line.isEmpty())
+            {
+                continue;
+            }
+
+            QJsonParseError parseError;
+            QJsonDocument jsonDocument = QJsonDocument::fromJson(line, &parseError);
+            if (!jsonDocument.isObject())
+            {
+                writeResponse(socket, createErrorResponse(QJsonObject(), PDFToolTranslationContext::tr("Invalid job. %1").arg(parseError.errorString())));
+                continue;
+            }
+
+            // Jakub Melka: Jobs are processed in the thread pool, response is written
+            // in the main thread, because socket lives in the main thread. Client
+            // can disconnect before the job is finished, so we must check it.
+            QJsonObject job = jsonDocument.object();
+            QPointer<QLocalSocket> socketPointer(socket);
+            threadPool.start([this, &options, job, socketPointer, writeResponse]()
+            {
+                QJsonObject response = processJob(options, job);
+                QMetaObject::invokeMethod(QCoreApplication::instance(), [socketPointer, response, writeResponse]()
+                {
+                    if (socketPointer)
+                    {
+                        writeResponse(socketPointer.data(), response);
+                    }
+                }, Qt::QueuedConnection);
+            });
+        }
+
+        // Unfinished line can't be longer than the limit
+        if (socket->bytesAvailable() > MAXIMAL_JOB_LENGTH)
+        {
+            dropClient();
+        }
+    };
+
+    auto onNewConnection = [&server, onReadyRead]()
+    {
+        while (QLocalSocket* socket = server.nextPendingConnection())
+        {
+            QObject::connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+            QObject::connect(socket, &QLocalSocket::readyRead, socket, [socket, onReadyRead]() { onReadyRead(socket); });
+        }
+    };
+    QObject::connect(&server, &QLocalServer::newConnection, &server, onNewConnection);
+
+    PDFConsole::writeText(PDFToolTranslationContext::tr("Server '%1' is listening.").arg(server.fullServerName()), options.outputCodec);
+    const int exitCode = QCoreApplication::exec();
+
+    threadPool.waitForDone();
+
+    // Cached documents must be destroyed in the main thread
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::MetaCall);
+    m_documents.clear();
+
+    return exitCode;
+}
+
+PDFToolAbstractApplication::Options PDFToolServerApplication::getOptionsFlags() const
+{
+    return ConsoleFormat | ColorManagementSystem | RenderFlags | Server;
+}
+
+PDFToolServerApplication::DocumentEntry::DocumentEntry(pdf::PDFDocument pdfDocument, const PDFToolOptions& options, pdf::PDFDiskCache* diskCache) :
+    document(qMove(pdfDocument)),
+    fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT),
+    diskCache(diskCache)
+{
+    optionalContentActivity = std::make_unique<pdf::PDFOptionalContentActivity>(&document, pdf::OCUsage::Export, nullptr);
+    cmsManager = std::make_unique<pdf::PDFCMSManager>(nullptr);
+    cmsManager->setDocument(&document);
+    cmsManager->setSettings(options.cmsSettings);
+
+    pdf::PDFModifiedDocument modifiedDocument(&document, optionalContentActivity.get());
+    fontCache.setDocument(modifiedDocument);
+
+    rasterizerPool = std::make_unique<pdf::PDFRasterizerPool>(&document, &fontCache, cmsManager.get(),
+                                                              optionalContentActivity.get(), options.renderFeatures, meshQualitySettings,
+                                                              pdf::PDFRasterizerPool::getCorrectedRasterizerCount(options.renderRasterizerCount),
+                                                              options.renderUseSoftwareRendering ? pdf::RendererEngine::QPainter : pdf::RendererEngine::Blend2D_SingleThread, nullptr);
+    rasterizerPool->setDiskCache(diskCache);
+
+    // Entry is created in the worker thread, but it is used by many
+    // threads and it is destroyed in the main thread.
+    QThread* mainThread = QCoreApplication::instance()->thread();
+    optionalContentActivity->moveToThread(mainThread);
+    cmsManager->moveToThread(mainThread);
+    rasterizerPool->moveToThread(mainThread);
+}
+
+QJsonObject PDFToolServerApplication::processJob(const PDFToolOptions& options, const QJsonObject& job)
+{
+    const QString jobType = job.value("job").toString();
+    if (jobType != "render" && jobType != "text" && jobType != "info")
+    {
+        return createErrorResponse(job, PDFToolTranslationContext::tr("Unknown job '%1'.").arg(jobType));
+    }
+
+    const QString fileName = job.value("document").toString();
+    if (fileName.isEmpty())
+    {
+        return createErrorResponse(job, PDFToolTranslationContext::tr("No document specified."));
+    }
+
+    QString errorMessage;
+    DocumentEntryPointer entry = getDocument(options, fileName, job.value("password").toString(), errorMessage);
+    if (!entry)
+    {
+        return createErrorResponse(job, errorMessage);
+    }
+
+    QJsonObject response;
+    if (jobType == "render")
+    {
+        response = processRenderJob(job, entry.get());
+    }
+    else if (jobType == "text")
+    {
+        response = processTextJob(job, entry.get());
+    }
+    else
+    {
+        response = processInfoJob(entry.get());
+    }
+
+    if (!response.contains("status"))
+    {
+        response["status"] = "ok";
+    }
+    response["id"] = job.value("id");
+
+    return response;
+}
+
+QJsonObject PDFToolServerApplication::processRenderJob(const QJsonObject& job, DocumentEntry* entry)
+{
+    QString errorMessage;
+    std::vector<pdf::PDFInteger> pageIndices = getPageIndices(job, entry->document.getCatalog()->getPageCount(), errorMessage);
+    if (!errorMessage.isEmpty())
+    {
+        return createErrorResponse(job, errorMessage);
+    }
+
+    const QByteArray format = job.value("format").toString("png").toLatin1();
+    if (!QImageWriter::supportedImageFormats().contains(format))
+    {
+        return createErrorResponse(job, PDFToolTranslationContext::tr("Unsupported image format '%1'.").arg(QString::fromLatin1(format)));
+    }
+
+    const int quality = job.value("quality").toInt(-1);
+    const int jobPixelResolution = job.value("pixels").toInt(0);
+    const pdf::PDFReal jobDpiResolution = job.value("dpi").toDouble(DEFAULT_RENDER_DPI);
+
+    if (jobPixelResolution <= 0 && jobDpiResolution <= 0.0)
+    {
+        return createErrorResponse(job, PDFToolTranslationContext::tr("Invalid image resolution."));
+    }
+
+    // Resolutions are bounded in the same way as in the render command
+    auto boundPixelResolution = [](int value)
+    {
+        return qBound(pdf::PDFPageImageExportSettings::getMinPixelResolution(), value, pdf::PDFPageImageExportSettings::getMaxPixelResolution());
+    };
+    const int pixelResolution = jobPixelResolution > 0 ? boundPixelResolution(jobPixelResolution) : 0;
+    const pdf::PDFReal dpiResolution = qBound(pdf::PDFReal(pdf::PDFPageImageExportSettings::getMinDPIResolution()), jobDpiResolution, pdf::PDFReal(pdf::PDFPageImageExportSettings::getMaxDPIResolution()));
+
+    // Multiple sizes of each page (for example, thumbnail and preview) can be
+    // requested as pixel resolutions, page is then compiled only once.
+    std::vector<int> pixelResolutions;
+    const bool isMultipleSizes = job.contains("sizes");
+    if (isMultipleSizes)
+    {
+        for (const QJsonValue& value : job.value("sizes").toArray())
+        {
+            const int sizePixelResolution = value.toInt(0);
+            if (sizePixelResolution <= 0)
+            {
+                return createErrorResponse(job, PDFToolTranslationContext::tr("Invalid image size."));
+            }
+            pixelResolutions.push_back(boundPixelResolution(sizePixelResolution));
+        }
+
+        if (pixelResolutions.empty())
+        {
+            return createErrorResponse(job, PDFToolTranslationContext::tr("Invalid image size."));
+        }
+    }
+    else
+    {
+        pixelResolutions.push_back(pixelResolution);
+    }
+
+    // Output file name template, '%' is replaced by page number, '#' is replaced
+    // by image size, if multiple sizes are requested. If it is empty,
+    // page images are sent in the response (encoded as base64).
+    const QString outputTemplate = job.value("output").toString();
+    if (isMultipleSizes && !outputTemplate.isEmpty() && !outputTemplate.contains('#'))
+    {
+        return createErrorResponse(job, PDFToolTranslationContext::tr("Output file name template must contain '#' character, if multiple sizes are requested."));
+    }
+
+    auto imageSizesGetter = [&pixelResolutions, dpiResolution](const pdf::PDFPage* page)
+    {
+        Q_ASSERT(page);
+
+        std::vector<QSize> imageSizes;
+        for (int currentPixelResolution : pixelResolutions)
+        {
+            QSizeF size = page->getRotatedMediaBox().size();
+            if (currentPixelResolution > 0)
+            {
+                size = size.scaled(currentPixelResolution, currentPixelResolution, Qt::KeepAspectRatio);
+            }
+            else
+            {
+                size *= pdf::PDF_POINT_TO_INCH * dpiResolution;
+            }
+
+            if (size.width() > MAXIMAL_RENDER_IMAGE_SIZE || size.height() > MAXIMAL_RENDER_IMAGE_SIZE)
+            {
+                size = size.scaled(MAXIMAL_RENDER_IMAGE_SIZE, MAXIMAL_RENDER_IMAGE_SIZE, Qt::KeepAspectRatio);
+            }
+
+            imageSizes.push_back(size.toSize());
+        }
+
+        return imageSizes;
+    };
+
+    QMutex resultsMutex;
+    std::map<std::pair<pdf::PDFInteger, int>, QJsonObject> pageResults;
+    std::map<pdf::PDFInteger, QJsonArray> pageErrors;
+
+    auto processImage = [&](pdf::PDFRenderedPageImage& renderedPageImage)
+    {
+        QJsonObject pageResult;
+        pageResult["page"] = renderedPageImage.pageIndex + 1;
+        if (isMultipleSizes)
+        {
+            pageResult["size"] = pixelResolutions[renderedPageImage.sizeIndex];
+        }
+        pageResult["width"] = renderedPageImage.pageImage.width();
+        pageResult["height"] = renderedPageImage.pageImage.height();
+        pageResult["render-time"] = renderedPageImage.pageTotalTime;
+
+        QByteArray data;
+        QBuffer buffer(&data);
+        QString fileName;
+        QImageWriter imageWriter;
+
+        if (outputTemplate.isEmpty())
+        {
+            buffer.open(QBuffer::WriteOnly);
+            imageWriter.setDevice(&buffer);
+        }
+        else
+        {
+            fileName = QString(outputTemplate).replace('%', QString::number(renderedPageImage.pageIndex + 1));
+            if (isMultipleSizes)
+            {
+                fileName.replace('#', QString::number(pixelResolutions[renderedPageImage.sizeIndex]));
+            }
+            imageWriter.setFileName(fileName);
+        }
+
+        imageWriter.setFormat(format);
+        imageWriter.setQuality(quality);
+
+        if (!imageWriter.write(renderedPageImage.pageImage))
+        {
+            pageResult["error"] = imageWriter.errorString();
+        }
+        else if (fileName.isEmpty())
+        {
+            pageResult["data"] = QString::fromLatin1(data.toBase64());
+        }
+        else
+        {
+            pageResult["file"] = fileName;
+        }
+
+        QMutexLocker lock(&resultsMutex);
+        pageResults[std::make_pair(renderedPageImage.pageIndex, renderedPageImage.sizeIndex)] = qMove(pageResult);
+    };
+
+    // Rasterizer pool is shared by all jobs of the document, so
+    // we take only errors of pages rendered by this job.
+    auto onRenderError = [&](pdf::PDFInteger pageIndex, pdf::PDFRenderError error)
+    {
+        if (std::binary_search(pageIndices.cbegin(), pageIndices.cend(), pageIndex))
+        {
+            QMutexLocker lock(&resultsMutex);
+            pageErrors[pageIndex].append(error.message);
+        }
+    };
+    QObject holder;
+    QObject::connect(entry->rasterizerPool.get(), &pdf::PDFRasterizerPool::renderError, &holder, onRenderError, Qt::DirectConnection);
+
+    entry->rasterizerPool->renderSizes(pageIndices, imageSizesGetter, processImage, nullptr);
+
+    QJsonArray pages;
+    for (auto& [key, pageResult] : pageResults)
+    {
+        auto it = pageErrors.find(key.first);
+        if (it != pageErrors.cend())
+        {
+            pageResult["render-errors"] = it->second;
+        }
+
+        pages.append(pageResult);
+    }
+
+    QJsonObject response;
+    response["pages"] = pages;
+    return response;
+}
+
+QJsonObject PDFToolServerApplication::processTextJob(const QJsonObject& job, DocumentEntry* entry)
+{
+    if (!entry->document.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::CopyContent))
+    {
+        return createErrorResponse(job, PDFToolTranslationContext::tr("Document doesn't allow to copy content."));
+    }
+
+    QString errorMessage;
+    std::vector<pdf::PDFInteger> pageIndices = getPageIndices(job, entry->document.getCatalog()->getPageCount(), errorMessage);
+    if (!errorMessage.isEmpty())
+    {
+        return createErrorResponse(job, errorMessage);
+    }
+
+    pdf::PDFDocumentTextFlowFactory factory;
+    factory.setDiskCache(entry->diskCache);
+    pdf::PDFDocumentTextFlow documentTextFlow = factory.create(&entry->document, pageIndices, pdf::PDFDocumentTextFlowFactory::Algorithm::Auto);
+
+    std::map<pdf::PDFInteger, QStringList> pageTexts;
+    for (const pdf::PDFDocumentTextFlow::Item& item : documentTextFlow.getItems())
+    {
+        if (item.isText() && !item.text.isEmpty())
+        {
+            pageTexts[item.pageIndex] << item.text;
+        }
+    }
+
+    QJsonArray pages;
+    for (pdf::PDFInteger pageIndex : pageIndices)
+    {
+        QJsonObject pageResult;
+        pageResult["page"] = pageIndex + 1;
+        pageResult["text"] = pageTexts[pageIndex].join('\n');
+        pages.append(pageResult);
+    }
+
+    QJsonObject response;
+    response["pages"] = pages;
+    return response;
+}
+
+QJsonObject PDFToolServerApplication::processInfoJob(DocumentEntry* entry)
+{
+    const pdf::PDFDocument& document = entry->document;
+    const pdf::PDFDocumentInfo* info = document.getInfo();
+    const pdf::PDFCatalog* catalog = document.getCatalog();
+
+    QJsonObject response;
+    response["version"] = QString::fromLatin1(document.getVersion());
+    response["title"] = info->title;
+    response["author"] = info->author;
+    response["subject"] = info->subject;
+    response["keywords"] = info->keywords;
+    response["creator"] = info->creator;
+    response["producer"] = info->producer;
+    response["page-count"] = qint64(catalog->getPageCount());
+
+    QJsonArray pages;
+    for (size_t i = 0, pageCount = catalog->getPageCount(); i < pageCount; ++i)
+    {
+        const pdf::PDFPage* page = catalog->getPage(i);
+        const QSizeF size = page->getRotatedMediaBox().size();
+
+        QJsonObject pageInfo;
+        pageInfo["page"] = qint64(i + 1);
+        pageInfo["width"] = size.width();
+        pageInfo["height"] = size.height();
+        pages.append(pageInfo);
+    }
+    response["pages"] = pages;
+
+    return response;
+}
+
+PDFToolServerApplication::DocumentEntryPointer PDFToolServerApplication::getDocument(const PDFToolOptions& options,
+                                                                                   const QString& fileName,
+                                                                                   const QString& password,
+                                                                                   QString& errorMessage)
+{
+    QFileInfo fileInfo(fileName);
+    if (!fileInfo.isFile())
+    {
+        errorMessage = PDFToolTranslationContext::tr("File '%1' doesn't exist.").arg(fileName);
+        return nullptr;
+    }
+
+    const QString filePath = fileInfo.absoluteFilePath();
+    const QDateTime lastModified = fileInfo.lastModified();
+    const qint64 fileSize = fileInfo.size();
+
+    {
+        QMutexLocker lock(&m_documentsMutex);
+
+        // Document is loaded only once, even if it is requested by many jobs at
+        // the same time. Jobs then share the loaded document (concurrent reading
+        // of the document is thread safe), so we wait, until it is loaded.
+        while (true)
+        {
+            for (auto it = m_documents.begin(); it != m_documents.end(); ++it)
+            {
+                const DocumentEntryPointer& entry = *it;
+                if (entry->fileName != filePath || entry->password != password)
+                {
+                    continue;
+                }
+
+                if (entry->lastModified == lastModified && entry->fileSize == fileSize)
+                {
+                    // Document becomes most recently used document
+                    m_documents.splice(m_documents.begin(), m_documents, it);
+                    return m_documents.front();
+                }
+
+                // File was changed, document must be read again
+                m_documents.erase(it);
+                break;
+            }
+
+            if (!m_loadingDocuments.count(filePath))
+            {
+                m_loadingDocuments.insert(filePath);
+                break;
+            }
+
+            m_documentLoaded.wait(&m_documentsMutex);
+        }
+    }
+
+    auto finishLoading = [this, &filePath](DocumentEntryPointer entry)
+    {
+        QMutexLocker lock(&m_documentsMutex);
+        m_loadingDocuments.erase(filePath);
+
+        if (entry)
+        {
+            m_documents.push_front(entry);
+            while (m_documents.size() > m_documentCacheLimit)
+            {
+                // Jobs, which are using the evicted document, still hold
+                // the pointer, so document is destroyed after they finish.
+                m_documents.pop_back();
+            }
+        }
+
+        m_documentLoaded.wakeAll();
+        return entry;
+    };
+
+    bool isFirstPasswordAttempt = true;
+    auto passwordCallback = [&password, &isFirstPasswordAttempt](bool* ok) -> QString
+    {
+        *ok = isFirstPasswordAttempt;
+        isFirstPasswordAttempt = false;
+        return password;
+    };
+
+    // Jakub Melka: Documents are kept open for a long time and files can be
+    // rewritten in the meantime, so we do not use memory mapping here.
+    pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, false);
+    pdf::PDFDocument document = reader.readFromFile(filePath);
+
+    switch (reader.getReadingResult())
+    {
+        case pdf::PDFDocumentReader::Result::OK:
+            break;
+
+        case pdf::PDFDocumentReader::Result::Cancelled:
+            errorMessage = PDFToolTranslationContext::tr("Invalid password provided.");
+            return finishLoading(nullptr);
+
+        case pdf::PDFDocumentReader::Result::Failed:
+            errorMessage = PDFToolTranslationContext::tr("Error occured during document reading. %1").arg(reader.getErrorMessage());
+            return finishLoading(nullptr);
+
+        default:
+            Q_ASSERT(false);
+            return finishLoading(nullptr);
+    }
+
+    // Objects of the entry live in the main thread, so entry
+    // must be also deleted in the main thread.
+    auto deleteEntry = [](DocumentEntry* entry)
+    {
+        if (QThread::currentThread() == QCoreApplication::instance()->thread())
+        {
+            delete entry;
+        }
+        else
+        {
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [entry]() { delete entry; }, Qt::QueuedConnection);
+        }
+    };
+
+    DocumentEntryPointer entry(new DocumentEntry(qMove(document), options, m_diskCache.get()), deleteEntry);
+    entry->fileName = filePath;
+    entry->password = password;
+    entry->lastModified = lastModified;
+    entry->fileSize = fileSize;
+
+    return finishLoading(qMove(entry));
+}
+
+std::vector<pdf::PDFInteger> PDFToolServerApplication::getPageIndices(const QJsonObject& job, pdf::PDFInteger pageCount, QString& errorMessage)
+{
+    QString pages = "-";
+
+    const QJsonValue pagesValue = job.value("pages");
+    if (pagesValue.isDouble())
+    {
+        pages = QString::number(pagesValue.toInteger());
+    }
+    else if (pagesValue.isString())
+    {
+        pages = pagesValue.toString();
+    }
+
+    std::vector<pdf::PDFInteger> pageIndices = pdf::PDFClosedIntervalSet::parse(1, pageCount, pages, &errorMessage).unfold();
+    std::for_each(pageIndices.begin(), pageIndices.end(), [](auto& index) { --index; });
+
+    if (errorMessage.isEmpty() && pageIndices.empty())
+    {
+        errorMessage = PDFToolTranslationContext::tr("No pages selected.");
+    }
+
+    return pageIndices;
+}
+
+QJsonObject PDFToolServerApplication::createErrorResponse(const QJsonObject& job, const QString& errorMessage)
+{
+    QJsonObject response;
+    response["id"] = job.value("id");
+    response["status"] = "error";
+    response["message"] = errorMessage;
+    return response;
+}
+
+}   // namespace pdftool
@@ -0,0 +1,125 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef PDFTOOLSERVER_H
+#define PDFTOOLSERVER_H
+
+#include "pdftoolabstractapplication.h"
+#include "pdffont.h"
+#include "pdfoptionalcontent.h"
+
+#include <QMutex>
+#include <QDateTime>
+#include <QWaitCondition>
+#include <QJsonObject>
+
+#include <set>
+#include <list>
+#include <memory>
+
+namespace pdftool
+{
+
+/// Long running server, which keeps documents, font caches and color management
+/// systems warm between the requests. Clients connect to the local socket
+/// and send jobs as JSON objects, one object per line. Each job is answered
+/// by one JSON object per line (with the same "id" as the job). Supported
+/// jobs are "render", "text" and "info". Jobs are processed in parallel, count
+/// of jobs processed at once is limited.
+///
+/// Example of the job:
+/// \code
+/// {"id": 1, "job": "render", "document": "/path/to/file.pdf", "pages": "1-3", "dpi": 96, "format": "png"}
+/// \endcode
+///
+/// Render job can request multiple sizes of each page as pixel resolutions,
+/// for example \c "sizes": [128, 1024, 4096], page is then compiled only once.
+class PDFToolServerApplication : public PDFToolAbstractApplication
+{
+public:
+    virtual QString getStandardString(StandardString standardString) const override;
+    virtual int execute(const PDFToolOptions& options) override;
+    virtual Options getOptionsFlags() const override;
+
+private:
+    /// Document kept warm by the server
+    struct DocumentEntry
+    {
+        explicit DocumentEntry(pdf::PDFDocument pdfDocument, const PDFToolOptions& options, pdf::PDFDiskCache* diskCache);
+
+        QString fileName;
+        QString password;
+        QDateTime lastModified;
+        qint64 fileSize = 0;
+
+        pdf::PDFDocument document;
+        pdf::PDFFontCache fontCache;
+        pdf::PDFMeshQualitySettings meshQualitySettings;
+        std::unique_ptr<pdf::PDFOptionalContentActivity> optionalContentActivity;
+        std::unique_ptr<pdf::PDFCMSManager> cmsManager;
+        std::unique_ptr<pdf::PDFRasterizerPool> rasterizerPool;
+        pdf::PDFDiskCache* diskCache = nullptr;
+    };
+
+    using DocumentEntryPointer = std::shared_ptr<DocumentEntry>;
+
+    /// Processes the job and returns the response. This function
+    /// is called from the worker threads.
+    /// \param options Options
+    /// \param job Job
+    QJsonObject processJob(const PDFToolOptions& options, const QJsonObject& job);
+
+    QJsonObject processRenderJob(const QJsonObject& job, DocumentEntry* entry);
+    QJsonObject processTextJob(const QJsonObject& job, DocumentEntry* entry);
+    QJsonObject processInfoJob(DocumentEntry* entry);
+
+    /// Returns document from the document cache. If document is not cached,
+    /// or file was changed, then document is read. If document can't be read,
+    /// nullptr is returned and error message is set. If document is being read
+    /// by other job, then this function waits, until it is read, so document is
+    /// read only once and it is shared by the jobs. This function is thread safe.
+    /// \param options Options
+    /// \param fileName File name
+    /// \param password Password
+    /// \param[out] errorMessage Error message
+    DocumentEntryPointer getDocument(const PDFToolOptions& options, const QString& fileName, const QString& password, QString& errorMessage);
+
+    /// Returns selected page indices (zero based). If pages
+    /// can't be parsed, empty vector is returned and error message is set.
+    /// \param job Job
+    /// \param pageCount Page count
+    /// \param[out] errorMessage Error message
+    static std::vector<pdf::PDFInteger> getPageIndices(const QJsonObject& job, pdf::PDFInteger pageCount, QString& errorMessage);
+
+    /// Creates error response for given job
+    /// \param job Job
+    /// \param errorMessage Error message
+    static QJsonObject createErrorResponse(const QJsonObject& job, const QString& errorMessage);
+
+    QMutex m_documentsMutex;
+    std::list<DocumentEntryPointer> m_documents; ///< Cached documents, most recently used document is first
+    std::set<QString> m_loadingDocuments; ///< File paths of documents, which are being loaded
+    QWaitCondition m_documentLoaded;
+    size_t m_documentCacheLimit = 0;
+
+    /// Cache of page results shared by all documents (can be nullptr)
+    std::unique_ptr<pdf::PDFDiskCache> m_diskCache;
+};
+
+}   // namespace pdftool
+
+#endif // PDFTOOLSERVER_H
@@ -20,7 +20,9 @@
 #include "pdfdocumentreader.h"
 #include "pdfoptimizer.h"
 #include "pdfdocumentwriter.h"
+#include "pdfdocumentmanipulator.h"
 
+#include <QFile>
 #include <QFileInfo>
 
 namespace pdftool
@@ -67,6 +69,11 @@ int PDFToolUnite::execute(const PDFToolOptions& options)
         return ErrorFailedWriteToFile;
     }
 
+    if (options.assembleStreaming)
+    {
+        return executeStreaming(options, files, targetFile);
+    }
+
     try
     {
         pdf::PDFDocumentBuilder documentBuilder;
@@ -222,6 +229,59 @@ int PDFToolUnite::execute(const PDFToolOptions& options)
     return ExitSuccess;
 }
 
+int PDFToolUnite::executeStreaming(const PDFToolOptions& options, const QStringList& files, const QString& targetFile)
+{
+    QFile file(targetFile);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("Target file '%1' can't be opened for writing.").arg(targetFile), options.outputCodec);
+        return ErrorFailedWriteToFile;
+    }
+
+    // Jakub Melka: documents are loaded lazily one by one, objects of their
+    // pages are written directly to the target file, so only one document
+    // is opened at a time and only objects of one page are held in memory.
+    pdf::PDFStreamingDocumentAssembler assembler(&file);
+    for (const QString& fileName : files)
+    {
+        pdf::PDFDocumentReader reader(nullptr, [](bool* ok) { *ok = false; return QString(); }, options.permissiveReading, false);
+        reader.setMemoryMapping(true);
+        reader.setLazyLoading(true);
+        pdf::PDFDocument document = reader.readFromFile(fileName);
+        if (reader.getReadingResult() != pdf::PDFDocumentReader::Result::OK)
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot open document '%1'.").arg(fileName), options.outputCodec);
+            file.remove();
+            return ErrorDocumentReading;
+        }
+
+        if (!document.getStorage().getSecurityHandler()->isAllowed(pdf::PDFSecurityHandler::Permission::Assemble))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Document doesn't allow to assemble pages."), options.outputCodec);
+            file.remove();
+            return ErrorPermissions;
+        }
+
+        pdf::PDFOperationResult result = assembler.addDocument(&document);
+        if (!result)
+        {
+            PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+            file.remove();
+            return ErrorUnknown;
+        }
+    }
+
+    pdf::PDFOperationResult result = assembler.finish();
+    if (!result)
+    {
+        PDFConsole::writeError(result.getErrorMessage(), options.outputCodec);
+        file.remove();
+        return ErrorFailedWriteToFile;
+    }
+
+    return ExitSuccess;
+}
+
 PDFToolAbstractApplication::Options PDFToolUnite::getOptionsFlags() const
 {
     return ConsoleFormat | Unite;
@@ -29,6 +29,11 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+
+private:
+    /// Merges documents using streaming assembler, objects are written
+    /// directly to the target file, without copying of whole documents.
+    int executeStreaming(const PDFToolOptions& options, const QStringList& files, const QString& targetFile);
 };
 
 }   // namespace pdftool
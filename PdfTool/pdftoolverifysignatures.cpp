@@ -19,13 +19,42 @@
 
 #include "pdfdocumentreader.h"
 #include "pdfsignaturehandler.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfutils.h"
 #include "pdfform.h"
 
+#include <QFile>
+#include <QFileInfo>
+#include <QDirIterator>
+
+#include <algorithm>
+
 namespace pdftool
 {
 
 static PDFToolVerifySignaturesApplication s_verifySignaturesApplication;
 
+static QString getSignatureTypeName(const pdf::PDFSignatureVerificationResult& signature)
+{
+    switch (signature.getType())
+    {
+        case pdf::PDFSignature::Type::Invalid:
+            return PDFToolTranslationContext::tr("Invalid");
+
+        case pdf::PDFSignature::Type::Sig:
+            return PDFToolTranslationContext::tr("Signature");
+
+        case pdf::PDFSignature::Type::DocTimeStamp:
+            return PDFToolTranslationContext::tr("Timestamp");
+
+        default:
+            Q_ASSERT(false);
+            break;
+    }
+
+    return QString();
+}
+
 QString PDFToolVerifySignaturesApplication::getStandardString(StandardString standardString) const
 {
     switch (standardString)
@@ -49,6 +78,11 @@ QString PDFToolVerifySignaturesApplication::getStandardString(StandardString sta
 
 int PDFToolVerifySignaturesApplication::execute(const PDFToolOptions& options)
 {
+    if (options.verificationBatch)
+    {
+        return executeBatch(options);
+    }
+
     // No document specified?
     if (options.document.isEmpty())
     {
@@ -111,28 +145,6 @@ int PDFToolVerifySignaturesApplication::execute(const PDFToolOptions& options)
     formatter.beginDocument("signatures", PDFToolTranslationContext::tr("Digital signatures/timestamps verification of %1").arg(options.document));
     formatter.endl();
 
-    auto getTypeName = [](const pdf::PDFSignatureVerificationResult& signature)
-    {
-        switch (signature.getType())
-        {
-            case pdf::PDFSignature::Type::Invalid:
-                return PDFToolTranslationContext::tr("Invalid");
-
-            case pdf::PDFSignature::Type::Sig:
-                return PDFToolTranslationContext::tr("Signature");
-
-            case pdf::PDFSignature::Type::DocTimeStamp:
-                return PDFToolTranslationContext::tr("Timestamp");
-                break;
-
-            default:
-                Q_ASSERT(false);
-                break;
-        }
-
-        return QString();
-    };
-
     if (!signatures.empty())
     {
         formatter.beginTable("overview", PDFToolTranslationContext::tr("Overview"));
@@ -159,7 +171,7 @@ int PDFToolVerifySignaturesApplication::execute(const PDFToolOptions& options)
             formatter.beginTableRow("signature", i);
 
             formatter.writeTableColumn("no", QString::number(i), Qt::AlignRight);
-            formatter.writeTableColumn("type", getTypeName(signature));
+            formatter.writeTableColumn("type", getSignatureTypeName(signature));
 
             QString commonName = certificateInfo ? certificateInfo->getName(pdf::PDFCertificateInfo::CommonName) : PDFToolTranslationContext::tr("Unknown");
             formatter.writeTableColumn("common-name", commonName);
@@ -186,7 +198,7 @@ int PDFToolVerifySignaturesApplication::execute(const PDFToolOptions& options)
             for (const pdf::PDFSignatureVerificationResult& signature : signatures)
             {
                 formatter.endl();
-                formatter.beginHeader("signature", PDFToolTranslationContext::tr("%1 #%2").arg(getTypeName(signature)).arg(ii), ii);
+                formatter.beginHeader("signature", PDFToolTranslationContext::tr("%1 #%2").arg(getSignatureTypeName(signature)).arg(ii), ii);
 
                 const pdf::PDFCertificateInfos& certificateInfos = signature.getCertificateInfos();
                 const pdf::PDFCertificateInfo* certificateInfo = !certificateInfos.empty() ? &certificateInfos.front() : nullptr;
@@ -390,6 +402,222 @@ int PDFToolVerifySignaturesApplication::execute(const PDFToolOptions& options)
     return ExitSuccess;
 }
 
+int PDFToolVerifySignaturesApplication::executeBatch(const PDFToolOptions& options)
+{
+    QStringList arguments = options.verificationBatchFiles;
+    if (!options.verificationBatchListFile.isEmpty())
+    {
+        QFile listFile(options.verificationBatchListFile);
+        if (!listFile.open(QFile::ReadOnly | QFile::Text))
+        {
+            PDFConsole::writeError(PDFToolTranslationContext::tr("Cannot read file list '%1'.").arg(options.verificationBatchListFile), options.outputCodec);
+            return ErrorInvalidArguments;
+        }
+
+        while (!listFile.atEnd())
+        {
+            QString fileName = QString::fromUtf8(listFile.readLine()).trimmed();
+            if (!fileName.isEmpty())
+            {
+                arguments << fileName;
+            }
+        }
+    }
+
+    QStringList fileNames;
+    QDirIterator::IteratorFlags iteratorFlags = options.verificationBatchRecursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags;
+    for (const QString& argument : arguments)
+    {
+        if (QFileInfo(argument).isDir())
+        {
+            QStringList directoryFileNames;
+            QDirIterator directoryIterator(argument, QStringList() << "*.pdf", QDir::Files, iteratorFlags);
+            while (directoryIterator.hasNext())
+            {
+                directoryFileNames << directoryIterator.next();
+            }
+            directoryFileNames.sort();
+            fileNames << directoryFileNames;
+        }
+        else
+        {
+            fileNames << argument;
+        }
+    }
+
+    if (fileNames.isEmpty())
+    {
+        PDFConsole::writeError(PDFToolTranslationContext::tr("No document specified."), options.outputCodec);
+        return ErrorNoDocumentSpecified;
+    }
+
+    // Certificate store is shared by all documents, so user certificates are read
+    // only once, and certificate chains already validated for some document are
+    // not validated again (results are cached in the certificate store).
+    pdf::PDFCertificateStore certificateStore;
+    if (options.verificationUseUserCertificates)
+    {
+        certificateStore.loadDefaultUserCertificates();
+    }
+
+    struct DocumentResult
+    {
+        QString errorMessage;
+        QStringList warnings;
+        std::vector<pdf::PDFSignatureVerificationResult> signatures;
+    };
+
+    std::vector<DocumentResult> results(fileNames.size());
+    auto verifyDocument = [&](size_t i)
+    {
+        DocumentResult& documentResult = results[i];
+
+        bool isFirstPasswordAttempt = true;
+        auto passwordCallback = [&options, &isFirstPasswordAttempt](bool* ok) -> QString
+        {
+            *ok = isFirstPasswordAttempt;
+            isFirstPasswordAttempt = false;
+            return options.password;
+        };
+        pdf::PDFDocumentReader reader(nullptr, passwordCallback, options.permissiveReading, false);
+        pdf::PDFDocument document = reader.readFromFile(fileNames[int(i)]);
+
+        switch (reader.getReadingResult())
+        {
+            case pdf::PDFDocumentReader::Result::OK:
+                break;
+
+            case pdf::PDFDocumentReader::Result::Cancelled:
+                documentResult.errorMessage = PDFToolTranslationContext::tr("Invalid password.");
+                return;
+
+            default:
+                documentResult.errorMessage = PDFToolTranslationContext::tr("Error occured during document reading. %1").arg(reader.getErrorMessage());
+                return;
+        }
+
+        documentResult.warnings = reader.getWarnings();
+
+        pdf::PDFSignatureHandler::Parameters parameters;
+        parameters.store = &certificateStore;
+        parameters.dss = &document.getCatalog()->getDocumentSecurityStore();
+        parameters.enableVerification = true;
+        parameters.ignoreExpirationDate = options.verificationIgnoreExpirationDate;
+        parameters.useSystemCertificateStore = options.verificationUseSystemCertificates;
+
+        pdf::PDFForm form = pdf::PDFForm::parse(&document, document.getCatalog()->getFormObject());
+        documentResult.signatures = pdf::PDFSignatureHandler::verifySignatures(form, reader.getSource(), parameters);
+    };
+
+    pdf::PDFIntegerRange<size_t> indices(0, results.size());
+    pdf::PDFExecutionPolicy::execute(pdf::PDFExecutionPolicy::Scope::Page, indices.begin(), indices.end(), verifyDocument);
+
+    PDFOutputFormatter formatter(options.outputStyle);
+    formatter.beginDocument("signatures-batch", PDFToolTranslationContext::tr("Digital signatures/timestamps verification of %1 documents").arg(fileNames.size()));
+    formatter.endl();
+
+    int failedCount = 0;
+    int signatureCount = 0;
+    int invalidSignatureCount = 0;
+
+    formatter.beginTable("documents", PDFToolTranslationContext::tr("Documents"));
+
+    formatter.beginTableHeaderRow("header");
+    formatter.writeTableHeaderColumn("no", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("file", PDFToolTranslationContext::tr("File"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("status", PDFToolTranslationContext::tr("Status"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("signatures", PDFToolTranslationContext::tr("Signatures"), Qt::AlignLeft);
+    formatter.writeTableHeaderColumn("valid", PDFToolTranslationContext::tr("Valid"), Qt::AlignLeft);
+    formatter.endTableHeaderRow();
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const DocumentResult& documentResult = results[i];
+        const bool isFailed = !documentResult.errorMessage.isEmpty();
+        const int validCount = int(std::count_if(documentResult.signatures.cbegin(), documentResult.signatures.cend(), [](const auto& signature) { return signature.isValid(); }));
+
+        if (isFailed)
+        {
+            ++failedCount;
+        }
+        signatureCount += int(documentResult.signatures.size());
+        invalidSignatureCount += int(documentResult.signatures.size()) - validCount;
+
+        formatter.beginTableRow("document", int(i + 1));
+        formatter.writeTableColumn("no", QString::number(i + 1), Qt::AlignRight);
+        formatter.writeTableColumn("file", fileNames[int(i)]);
+        formatter.writeTableColumn("status", isFailed ? documentResult.errorMessage : PDFToolTranslationContext::tr("OK"));
+        formatter.writeTableColumn("signatures", QString::number(documentResult.signatures.size()), Qt::AlignRight);
+        formatter.writeTableColumn("valid", QString::number(validCount), Qt::AlignRight);
+        formatter.endTableRow();
+    }
+
+    formatter.endTable();
+
+    if (signatureCount > 0)
+    {
+        formatter.endl();
+        formatter.beginTable("signatures", PDFToolTranslationContext::tr("Signatures"));
+
+        formatter.beginTableHeaderRow("header");
+        formatter.writeTableHeaderColumn("document", PDFToolTranslationContext::tr("Document"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("no", PDFToolTranslationContext::tr("No."), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("type", PDFToolTranslationContext::tr("Type"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("common-name", PDFToolTranslationContext::tr("Signed by"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("cert-status", PDFToolTranslationContext::tr("Certificate"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("signature-status", PDFToolTranslationContext::tr("Signature"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("signing-date", PDFToolTranslationContext::tr("Signing date"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("timestamp-date", PDFToolTranslationContext::tr("Timestamp date"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("hash-algorithm", PDFToolTranslationContext::tr("Hash alg."), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("handler", PDFToolTranslationContext::tr("Handler"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("whole-signed", PDFToolTranslationContext::tr("Signed whole"), Qt::AlignLeft);
+        formatter.writeTableHeaderColumn("errors", PDFToolTranslationContext::tr("Errors"), Qt::AlignLeft);
+        formatter.endTableHeaderRow();
+
+        int row = 1;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            int signatureIndex = 1;
+            for (const pdf::PDFSignatureVerificationResult& signature : results[i].signatures)
+            {
+                const pdf::PDFCertificateInfos& certificateInfos = signature.getCertificateInfos();
+                const pdf::PDFCertificateInfo* certificateInfo = !certificateInfos.empty() ? &certificateInfos.front() : nullptr;
+
+                formatter.beginTableRow("signature", row++);
+
+                formatter.writeTableColumn("document", QString::number(i + 1), Qt::AlignRight);
+                formatter.writeTableColumn("no", QString::number(signatureIndex++), Qt::AlignRight);
+                formatter.writeTableColumn("type", getSignatureTypeName(signature));
+
+                QString commonName = certificateInfo ? certificateInfo->getName(pdf::PDFCertificateInfo::CommonName) : PDFToolTranslationContext::tr("Unknown");
+                formatter.writeTableColumn("common-name", commonName);
+                formatter.writeTableColumn("cert-status", options.verificationOmitCertificateCheck ? PDFToolTranslationContext::tr("Skipped") : signature.getCertificateStatusText());
+                formatter.writeTableColumn("signature-status", signature.getSignatureStatusText());
+                formatter.writeTableColumn("signing-date", signature.getSignatureDate().isValid() ? convertDateTimeToString(signature.getSignatureDate().toLocalTime(), options.outputDateFormat) : QString());
+                formatter.writeTableColumn("timestamp-date", signature.getTimestampDate().isValid() ? convertDateTimeToString(signature.getTimestampDate().toLocalTime(), options.outputDateFormat) : QString());
+                formatter.writeTableColumn("hash-algorithm", signature.getHashAlgorithms().join(", ").toUpper());
+                formatter.writeTableColumn("handler", QString::fromLatin1(signature.getSignatureHandler()));
+                formatter.writeTableColumn("whole-signed", signature.hasFlag(pdf::PDFSignatureVerificationResult::Warning_Signature_NotCoveredBytes) ? PDFToolTranslationContext::tr("No") : PDFToolTranslationContext::tr("Yes"));
+                formatter.writeTableColumn("errors", signature.getErrors().join(" "));
+
+                formatter.endTableRow();
+            }
+        }
+
+        formatter.endTable();
+    }
+
+    formatter.endl();
+    formatter.writeText("documents", PDFToolTranslationContext::tr("Documents: %1").arg(fileNames.size()));
+    formatter.writeText("failed", PDFToolTranslationContext::tr("Failed documents: %1").arg(failedCount));
+    formatter.writeText("signatures", PDFToolTranslationContext::tr("Signatures/timestamps: %1").arg(signatureCount));
+    formatter.writeText("invalid", PDFToolTranslationContext::tr("Invalid signatures/timestamps: %1").arg(invalidSignatureCount));
+    formatter.endDocument();
+
+    PDFConsole::writeText(formatter.getString(), options.outputCodec);
+    return failedCount > 0 ? ErrorDocumentReading : ExitSuccess;
+}
+
 PDFToolAbstractApplication::Options PDFToolVerifySignaturesApplication::getOptionsFlags() const
 {
     return PDFToolAbstractApplication::ConsoleFormat | PDFToolAbstractApplication::OpenDocument | PDFToolAbstractApplication::SignatureVerification | PDFToolAbstractApplication::DateFormat;
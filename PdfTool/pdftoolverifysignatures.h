@@ -29,6 +29,10 @@ public:
     virtual QString getStandardString(StandardString standardString) const override;
     virtual int execute(const PDFToolOptions& options) override;
     virtual Options getOptionsFlags() const override;
+
+private:
+    /// Verifies signatures of multiple documents in parallel, writes one report
+    int executeBatch(const PDFToolOptions& options);
 };
 
 }   // namespace pdftool
@@ -27,6 +27,9 @@ namespace pdftool
 
 static PDFToolXmlApplication s_xmlApplication;
 
+/// Minimal size of the xml output (in characters) written to the console at once
+static constexpr const qsizetype XML_STREAMING_BUFFER_SIZE = 64 * 1024;
+
 class PDFXmlExportVisitor : public pdf::PDFAbstractVisitor
 {
 public:
@@ -235,12 +238,20 @@ int PDFToolXmlApplication::execute(const PDFToolOptions& options)
         writer.writeAttribute("gen", QString::number(entry.generation));
         entry.object.accept(&visitor);
         writer.writeEndElement();
+
+        // Write xml in parts, so whole document (streams can be exported)
+        // is not held in the memory. Writer appends to the string.
+        if (xmlString.size() >= XML_STREAMING_BUFFER_SIZE)
+        {
+            PDFConsole::writeText(qMove(xmlString), options.outputCodec);
+            xmlString.clear();
+        }
     }
 
     writer.writeEndElement();
     writer.writeEndDocument();
 
-    PDFConsole::writeText(xmlString, options.outputCodec);
+    PDFConsole::writeText(qMove(xmlString), options.outputCodec);
     return ExitSuccess;
 }
 
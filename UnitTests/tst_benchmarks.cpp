@@ -0,0 +1,865 @@
+//    Copyright (C) 2024 Jakub Melka
+//
+//    This file is part of PDF4QT.
+//
+//    PDF4QT is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    with the written consent of the copyright owner, any later version.
+//
+//    PDF4QT is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with PDF4QT.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <QtTest>
+#include <QBuffer>
+#include <QImage>
+
+#include "pdfparser.h"
+#include "pdfstreamfilters.h"
+#include "pdffunction.h"
+#include "pdfdocument.h"
+#include "pdfexception.h"
+#include "pdfimage.h"
+#include "pdfcolorspaces.h"
+#include "pdfalgorithmlcs.h"
+
+#include <openjpeg.h>
+
+#include <bit>
+#include <cstring>
+#include <map>
+#include <random>
+
+/// Micro-benchmarks of hot components of the library. Input data are generated
+/// deterministically, so numbers of different builds are comparable. Run with
+/// QtTest benchmark options, for example "-tickcounter" or "-iterations 10".
+class BenchmarkTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BenchmarkTest() = default;
+    virtual ~BenchmarkTest() override = default;
+
+private slots:
+    void benchmark_lexical_analyzer();
+    void benchmark_flate_filter();
+    void benchmark_lzw_filter();
+    void benchmark_ascii85_filter();
+    void benchmark_stream_predictor_data();
+    void benchmark_stream_predictor();
+    void benchmark_ccitt_decoder();
+    void benchmark_jbig2_decoder();
+    void benchmark_dct_image();
+    void benchmark_jpx_image();
+    void benchmark_function_data();
+    void benchmark_function();
+    void benchmark_longest_common_subsequence();
+
+private:
+    static constexpr int IMAGE_SIZE = 1024;
+
+    /// Width of one stripe of bilevel images, see \p encodeStripesG4
+    static constexpr int STRIPE_SIZE = 32;
+    static constexpr int STRIPE_COUNT = 31;
+    static constexpr int BILEVEL_IMAGE_WIDTH = 2 * STRIPE_SIZE * (STRIPE_COUNT + 1);
+    static constexpr int BILEVEL_IMAGE_HEIGHT = 2048;
+
+    /// Decodes image using PDFImage, dictionary entries are added to the image dictionary
+    static pdf::PDFImage createImage(const QByteArray& data, const char* filter, bool isImageMask, pdf::PDFObject decodeParameters = pdf::PDFObject());
+
+    static QByteArray createContentStream();
+    static QByteArray createImageData(int components);
+    static QByteArray encodeLzw(const QByteArray& data);
+    static QByteArray encodeAscii85(const QByteArray& data);
+    static QByteArray encodePngPredictor(const QByteArray& data, int bytesPerPixel, int bytesPerRow);
+    static QByteArray encodeTiffPredictor(const QByteArray& data, int bytesPerPixel, int bytesPerRow);
+    static QByteArray encodeJpeg2000(const QByteArray& data, int components);
+    static QByteArray encodeStripesG4();
+    static QByteArray createStripesJBIG2();
+    static bool isStripesImage(const pdf::PDFImageData& imageData);
+};
+
+void BenchmarkTest::benchmark_lexical_analyzer()
+{
+    const QByteArray content = createContentStream();
+
+    int tokenCount = 0;
+    QBENCHMARK
+    {
+        tokenCount = 0;
+        pdf::PDFLexicalAnalyzer analyzer(content.constData(), content.constData() + content.size());
+        while (!analyzer.isAtEnd())
+        {
+            analyzer.fetch();
+            ++tokenCount;
+        }
+    }
+
+    QVERIFY(tokenCount > 0);
+}
+
+void BenchmarkTest::benchmark_flate_filter()
+{
+    const QByteArray data = createImageData(3);
+    const QByteArray encoded = pdf::PDFFlateDecodeFilter::compress(data, pdf::PDFFlateDecodeFilter::CompressionLevel::Default);
+
+    pdf::PDFFlateDecodeFilter filter;
+    QByteArray decoded;
+    QBENCHMARK
+    {
+        decoded = filter.apply(encoded, pdf::PDFObject(), nullptr);
+    }
+
+    QCOMPARE(decoded, data);
+}
+
+void BenchmarkTest::benchmark_lzw_filter()
+{
+    const QByteArray data = createImageData(3);
+    const QByteArray encoded = encodeLzw(data);
+
+    pdf::PDFLzwDecodeFilter filter;
+    QByteArray decoded;
+    QBENCHMARK
+    {
+        decoded = filter.apply(encoded, pdf::PDFObject(), nullptr);
+    }
+
+    QCOMPARE(decoded, data);
+}
+
+void BenchmarkTest::benchmark_ascii85_filter()
+{
+    const QByteArray data = createImageData(3);
+    const QByteArray encoded = encodeAscii85(data);
+
+    pdf::PDFAscii85DecodeFilter filter;
+    QByteArray decoded;
+    QBENCHMARK
+    {
+        decoded = filter.apply(encoded, pdf::PDFObject(), nullptr);
+    }
+
+    QCOMPARE(decoded, data);
+}
+
+void BenchmarkTest::benchmark_stream_predictor_data()
+{
+    QTest::addColumn<int>("predictor");
+
+    QTest::newRow("tiff") << 2;
+    QTest::newRow("png") << 15;
+}
+
+void BenchmarkTest::benchmark_stream_predictor()
+{
+    QFETCH(int, predictor);
+
+    // Jakub Melka: Predictors are applied by the Flate and LZW filters. Data are
+    // compressed with the fastest compression, so decoding time is dominated
+    // by the predictor, compare it with the flate filter benchmark.
+    constexpr int components = 3;
+    constexpr int bytesPerRow = IMAGE_SIZE * components;
+    const QByteArray data = createImageData(components);
+    const QByteArray predicted = (predictor == 2) ? encodeTiffPredictor(data, components, bytesPerRow) : encodePngPredictor(data, components, bytesPerRow);
+    const QByteArray encoded = pdf::PDFFlateDecodeFilter::compress(predicted, pdf::PDFFlateDecodeFilter::CompressionLevel::Fast);
+
+    pdf::PDFDictionary parameters;
+    parameters.addEntry(pdf::PDFInplaceOrMemoryString("Predictor"), pdf::PDFObject::createInteger(predictor));
+    parameters.addEntry(pdf::PDFInplaceOrMemoryString("Colors"), pdf::PDFObject::createInteger(components));
+    parameters.addEntry(pdf::PDFInplaceOrMemoryString("Columns"), pdf::PDFObject::createInteger(IMAGE_SIZE));
+    const pdf::PDFObject parametersObject = pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(qMove(parameters)));
+
+    pdf::PDFFlateDecodeFilter filter;
+    QByteArray decoded;
+    QBENCHMARK
+    {
+        decoded = filter.apply(encoded, parametersObject, nullptr);
+    }
+
+    QCOMPARE(decoded, data);
+}
+
+void BenchmarkTest::benchmark_ccitt_decoder()
+{
+    const QByteArray encoded = encodeStripesG4();
+
+    pdf::PDFDictionary parameters;
+    parameters.addEntry(pdf::PDFInplaceOrMemoryString("K"), pdf::PDFObject::createInteger(-1));
+    parameters.addEntry(pdf::PDFInplaceOrMemoryString("Columns"), pdf::PDFObject::createInteger(BILEVEL_IMAGE_WIDTH));
+    parameters.addEntry(pdf::PDFInplaceOrMemoryString("Rows"), pdf::PDFObject::createInteger(BILEVEL_IMAGE_HEIGHT));
+    parameters.addEntry(pdf::PDFInplaceOrMemoryString("EndOfBlock"), pdf::PDFObject::createBool(false));
+    const pdf::PDFObject parametersObject = pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(qMove(parameters)));
+
+    pdf::PDFImage image;
+    QBENCHMARK
+    {
+        image = createImage(encoded, "CCITTFaxDecode", true, parametersObject);
+    }
+
+    QVERIFY(isStripesImage(image.getImageData()));
+}
+
+void BenchmarkTest::benchmark_jbig2_decoder()
+{
+    const QByteArray encoded = createStripesJBIG2();
+
+    pdf::PDFImage image;
+    QBENCHMARK
+    {
+        image = createImage(encoded, "JBIG2Decode", true);
+    }
+
+    QVERIFY(isStripesImage(image.getImageData()));
+}
+
+void BenchmarkTest::benchmark_dct_image()
+{
+    const QByteArray data = createImageData(3);
+    QImage sourceImage(reinterpret_cast<const uchar*>(data.constData()), IMAGE_SIZE, IMAGE_SIZE, IMAGE_SIZE * 3, QImage::Format_RGB888);
+
+    QByteArray encoded;
+    QBuffer buffer(&encoded);
+    buffer.open(QBuffer::WriteOnly);
+    QVERIFY(sourceImage.save(&buffer, "JPG", 85));
+    buffer.close();
+
+    pdf::PDFImage image;
+    QBENCHMARK
+    {
+        image = createImage(encoded, "DCTDecode", false);
+    }
+
+    QCOMPARE(image.getImageData().getWidth(), uint(IMAGE_SIZE));
+    QCOMPARE(image.getImageData().getHeight(), uint(IMAGE_SIZE));
+}
+
+void BenchmarkTest::benchmark_jpx_image()
+{
+    const QByteArray encoded = encodeJpeg2000(createImageData(3), 3);
+    QVERIFY(!encoded.isEmpty());
+
+    pdf::PDFImage image;
+    QBENCHMARK
+    {
+        image = createImage(encoded, "JPXDecode", false);
+    }
+
+    QCOMPARE(image.getImageData().getWidth(), uint(IMAGE_SIZE));
+    QCOMPARE(image.getImageData().getHeight(), uint(IMAGE_SIZE));
+}
+
+void BenchmarkTest::benchmark_function_data()
+{
+    QTest::addColumn<QByteArray>("function");
+
+    // Sampled function, 2 inputs, 3 outputs, 32 x 32 samples
+    QByteArray samples;
+    for (int i = 0; i < 32 * 32 * 3; ++i)
+    {
+        samples.append(char((i * 37) % 256));
+    }
+
+    QByteArray sampled = QString("<< /FunctionType 0 /Domain [ 0 1 0 1 ] /Range [ 0 1 0 1 0 1 ] /Size [ 32 32 ] /BitsPerSample 8 /Length %1 >> stream\n").arg(samples.size()).toLatin1();
+    sampled.append(samples);
+    sampled.append("\nendstream");
+
+    QByteArray program = "{ 2 copy mul 3 1 roll add 0.5 mul add 0.5 mul }";
+    QByteArray postscript = QString("<< /FunctionType 4 /Domain [ 0 1 0 1 ] /Range [ 0 1 ] /Length %1 >> stream\n").arg(program.size()).toLatin1();
+    postscript.append(program);
+    postscript.append("\nendstream");
+
+    QTest::newRow("sampled") << sampled;
+    QTest::newRow("exponential") << QByteArray("<< /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 0 0 ] /C1 [ 1 0.5 0.25 ] /N 2.2 >>");
+    QTest::newRow("stitching") << QByteArray("<< /FunctionType 3 /Domain [ 0 1 ] /Bounds [ 0.3 0.6 ] /Encode [ 0 1 0 1 0 1 ] /Functions [ "
+                                             "<< /FunctionType 2 /Domain [ 0 1 ] /C0 [ 1 0 0 ] /C1 [ 0 1 0 ] /N 1 >> "
+                                             "<< /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 1 0 ] /C1 [ 0 0 1 ] /N 1 >> "
+                                             "<< /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 0 1 ] /C1 [ 1 1 1 ] /N 1 >> ] >>");
+    QTest::newRow("postscript") << postscript;
+}
+
+void BenchmarkTest::benchmark_function()
+{
+    QFETCH(QByteArray, function);
+
+    pdf::PDFDocument document;
+    pdf::PDFParser parser(function, nullptr, pdf::PDFParser::AllowStreams);
+    pdf::PDFFunctionPtr functionPtr = pdf::PDFFunction::createFunction(&document, parser.getObject());
+    QVERIFY(functionPtr);
+
+    // Evaluate function on the grid of 256 x 256 points
+    constexpr size_t count = 256 * 256;
+    const size_t m = functionPtr->getInputVariableCount();
+    const size_t n = functionPtr->getOutputVariableCount();
+
+    std::vector<pdf::PDFReal> x(count * m, 0.0);
+    std::vector<pdf::PDFReal> y(count * n, 0.0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (size_t j = 0; j < m; ++j)
+        {
+            x[i * m + j] = ((j % 2 == 0) ? (i % 256) : (i / 256)) / 255.0;
+        }
+    }
+
+    bool evaluated = false;
+    QBENCHMARK
+    {
+        evaluated = static_cast<bool>(functionPtr->applyBatch(x.data(), y.data(), count));
+    }
+
+    QVERIFY(evaluated);
+}
+
+void BenchmarkTest::benchmark_longest_common_subsequence()
+{
+    // Two sequences of 20000 items, the second one is the first one with random edits
+    std::mt19937 generator(0x50444634);
+    std::uniform_int_distribution<int> valueDistribution(0, 999);
+    std::uniform_int_distribution<int> editDistribution(0, 99);
+
+    std::vector<int> sequence1(20000);
+    std::generate(sequence1.begin(), sequence1.end(), [&]() { return valueDistribution(generator); });
+
+    std::vector<int> sequence2;
+    sequence2.reserve(sequence1.size());
+    for (int value : sequence1)
+    {
+        const int edit = editDistribution(generator);
+        if (edit < 3)
+        {
+            // Remove the item
+            continue;
+        }
+
+        if (edit < 6)
+        {
+            // Insert a new item
+            sequence2.push_back(valueDistribution(generator));
+        }
+
+        sequence2.push_back(value);
+    }
+
+    using Iterator = std::vector<int>::const_iterator;
+    auto comparator = [](int left, int right) { return left == right; };
+
+    size_t sequenceSize = 0;
+    QBENCHMARK
+    {
+        pdf::PDFAlgorithmLongestCommonSubsequence<Iterator, decltype(comparator)> algorithm(sequence1.cbegin(), sequence1.cend(), sequence2.cbegin(), sequence2.cend(), comparator);
+        algorithm.perform();
+        sequenceSize = algorithm.getSequence().size();
+    }
+
+    QVERIFY(sequenceSize >= qMax(sequence1.size(), sequence2.size()));
+}
+
+pdf::PDFImage BenchmarkTest::createImage(const QByteArray& data, const char* filter, bool isImageMask, pdf::PDFObject decodeParameters)
+{
+    const int width = isImageMask ? BILEVEL_IMAGE_WIDTH : IMAGE_SIZE;
+    const int height = isImageMask ? BILEVEL_IMAGE_HEIGHT : IMAGE_SIZE;
+
+    pdf::PDFDictionary dictionary;
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Type"), pdf::PDFObject::createName("XObject"));
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Subtype"), pdf::PDFObject::createName("Image"));
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Width"), pdf::PDFObject::createInteger(width));
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Height"), pdf::PDFObject::createInteger(height));
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("BitsPerComponent"), pdf::PDFObject::createInteger(isImageMask ? 1 : 8));
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Filter"), pdf::PDFObject::createName(filter));
+
+    if (isImageMask)
+    {
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("ImageMask"), pdf::PDFObject::createBool(true));
+    }
+
+    if (!decodeParameters.isNull())
+    {
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("DecodeParms"), qMove(decodeParameters));
+    }
+
+    pdf::PDFDocument document;
+    pdf::PDFStream stream(qMove(dictionary), QByteArray(data));
+    pdf::PDFColorSpacePointer colorSpace;
+
+    if (!isImageMask)
+    {
+        colorSpace = pdf::PDFAbstractColorSpace::createDeviceColorSpaceByName(nullptr, &document, pdf::COLOR_SPACE_NAME_DEVICE_RGB);
+    }
+
+    pdf::PDFRenderErrorReporterDummy errorReporter;
+    return pdf::PDFImage::createImage(&document, &stream, qMove(colorSpace), false, pdf::RenderingIntent::Perceptual, &errorReporter);
+}
+
+QByteArray BenchmarkTest::createContentStream()
+{
+    // Content stream with typical mix of operators, numbers, names and strings
+    QByteArray content;
+    for (int i = 0; i < 20000; ++i)
+    {
+        const double value = i * 0.37;
+        content.append(QString("q 1 0 0 1 %1 %2 cm 0.5 g /GS%3 gs ").arg(value).arg(i % 700).arg(i % 8).toLatin1());
+        content.append(QString("%1 %2 m %3 %4 l %5 %6 %7 %8 %9 %10 c h f Q ").arg(value).arg(value + 1).arg(value + 2).arg(value + 3).arg(value + 4).arg(value + 5).arg(value + 6).arg(value + 7).arg(value + 8).arg(value + 9).toLatin1());
+        content.append(QString("BT /F%1 12 Tf %2 %3 Td (Hello \\(world\\) %4) Tj [ (A) -120 (B) <4142> ] TJ ET\n").arg(i % 3).arg(i % 500).arg(i % 800).arg(i).toLatin1());
+    }
+    return content;
+}
+
+QByteArray BenchmarkTest::createImageData(int components)
+{
+    // Deterministic pattern of gradients and noise, which is not compressed too well
+    std::mt19937 generator(0x50444634);
+    std::uniform_int_distribution<int> distribution(0, 31);
+
+    QByteArray data(IMAGE_SIZE * IMAGE_SIZE * components, Qt::Uninitialized);
+    uchar* pixel = reinterpret_cast<uchar*>(data.data());
+    for (int y = 0; y < IMAGE_SIZE; ++y)
+    {
+        for (int x = 0; x < IMAGE_SIZE; ++x)
+        {
+            const int noise = distribution(generator);
+            const int pattern = int(127.5 + 127.5 * qSin(x * 0.05) * qCos(y * 0.03));
+            for (int i = 0; i < components; ++i)
+            {
+                const int gradient = (i % 2 == 0) ? (x * 255 / IMAGE_SIZE) : (y * 255 / IMAGE_SIZE);
+                *pixel++ = uchar(qBound(0, (gradient + pattern) / 2 + noise - 16, 255));
+            }
+        }
+    }
+
+    return data;
+}
+
+QByteArray BenchmarkTest::encodeLzw(const QByteArray& data)
+{
+    constexpr quint32 CODE_CLEAR_TABLE = 256;
+    constexpr quint32 CODE_END_OF_STREAM = 257;
+    constexpr quint32 FIRST_CODE = 258;
+    constexpr quint32 LAST_CODE = 4094;
+
+    QByteArray result;
+    quint32 buffer = 0;
+    int bufferBits = 0;
+    int bits = 9;
+    quint32 nextCode = FIRST_CODE;
+    std::map<quint32, quint32> table;
+
+    auto write = [&](quint32 code)
+    {
+        buffer = (buffer << bits) | code;
+        bufferBits += bits;
+        while (bufferBits >= 8)
+        {
+            bufferBits -= 8;
+            result += char((buffer >> bufferBits) & 0xFF);
+        }
+    };
+
+    // Decoder adds words to the table one code later than encoder, and uses
+    // early change, so code length is increased, when encoder's next code
+    // reaches the power of two.
+    auto addCode = [&]()
+    {
+        ++nextCode;
+        if (nextCode == 512 || nextCode == 1024 || nextCode == 2048)
+        {
+            ++bits;
+        }
+    };
+
+    write(CODE_CLEAR_TABLE);
+
+    qint64 word = -1;
+    for (const char character : data)
+    {
+        const quint32 byte = uchar(character);
+        if (word == -1)
+        {
+            word = byte;
+            continue;
+        }
+
+        const quint32 key = (quint32(word) << 8) | byte;
+        auto it = table.find(key);
+        if (it != table.cend())
+        {
+            word = it->second;
+            continue;
+        }
+
+        write(quint32(word));
+        table[key] = nextCode;
+        addCode();
+        word = byte;
+
+        if (nextCode == LAST_CODE)
+        {
+            write(CODE_CLEAR_TABLE);
+            table.clear();
+            nextCode = FIRST_CODE;
+            bits = 9;
+        }
+    }
+
+    if (word != -1)
+    {
+        write(quint32(word));
+        addCode();
+    }
+
+    write(CODE_END_OF_STREAM);
+
+    if (bufferBits > 0)
+    {
+        result += char((buffer << (8 - bufferBits)) & 0xFF);
+    }
+
+    return result;
+}
+
+QByteArray BenchmarkTest::encodeAscii85(const QByteArray& data)
+{
+    QByteArray result;
+    result.reserve(data.size() * 5 / 4 + 8);
+
+    for (qsizetype i = 0; i < data.size(); i += 4)
+    {
+        const qsizetype count = qMin(qsizetype(4), data.size() - i);
+
+        quint32 value = 0;
+        for (qsizetype j = 0; j < 4; ++j)
+        {
+            value = (value << 8) | (j < count ? uchar(data[i + j]) : 0);
+        }
+
+        if (value == 0 && count == 4)
+        {
+            result += 'z';
+            continue;
+        }
+
+        char digits[5] = { };
+        for (int j = 4; j >= 0; --j)
+        {
+            digits[j] = char('!' + value % 85);
+            value /= 85;
+        }
+        result.append(digits, count + 1);
+    }
+
+    result += "~>";
+    return result;
+}
+
+QByteArray BenchmarkTest::encodePngPredictor(const QByteArray& data, int bytesPerPixel, int bytesPerRow)
+{
+    // Rows use all PNG predictor types in turn (none, sub, up, average, paeth)
+    QByteArray result;
+    result.reserve(data.size() + data.size() / bytesPerRow);
+
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    for (qsizetype rowStart = 0, row = 0; rowStart < data.size(); rowStart += bytesPerRow, ++row)
+    {
+        const int type = row % 5;
+        result += char(type);
+
+        for (qsizetype i = rowStart; i < rowStart + bytesPerRow; ++i)
+        {
+            const int left = (i - rowStart >= bytesPerPixel) ? bytes[i - bytesPerPixel] : 0;
+            const int up = (rowStart > 0) ? bytes[i - bytesPerRow] : 0;
+            const int upLeft = (rowStart > 0 && i - rowStart >= bytesPerPixel) ? bytes[i - bytesPerRow - bytesPerPixel] : 0;
+
+            int prediction = 0;
+            switch (type)
+            {
+                case 1:
+                    prediction = left;
+                    break;
+
+                case 2:
+                    prediction = up;
+                    break;
+
+                case 3:
+                    prediction = (left + up) / 2;
+                    break;
+
+                case 4:
+                {
+                    const int p = left + up - upLeft;
+                    const int pLeft = qAbs(p - left);
+                    const int pUp = qAbs(p - up);
+                    const int pUpLeft = qAbs(p - upLeft);
+                    prediction = (pLeft <= pUp && pLeft <= pUpLeft) ? left : ((pUp <= pUpLeft) ? up : upLeft);
+                    break;
+                }
+
+                default:
+                    break;
+            }
+
+            result += char(uchar(bytes[i] - prediction));
+        }
+    }
+
+    return result;
+}
+
+QByteArray BenchmarkTest::encodeTiffPredictor(const QByteArray& data, int bytesPerPixel, int bytesPerRow)
+{
+    QByteArray result(data.size(), Qt::Uninitialized);
+
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    for (qsizetype i = 0; i < data.size(); ++i)
+    {
+        const bool isFirstPixel = (i % bytesPerRow) < bytesPerPixel;
+        result[i] = char(uchar(bytes[i] - (isFirstPixel ? 0 : bytes[i - bytesPerPixel])));
+    }
+
+    return result;
+}
+
+QByteArray BenchmarkTest::encodeJpeg2000(const QByteArray& data, int components)
+{
+    struct MemoryStream
+    {
+        QByteArray data;
+        OPJ_OFF_T position = 0;
+    };
+
+    auto write = [](void* buffer, OPJ_SIZE_T bytes, void* userData) -> OPJ_SIZE_T
+    {
+        MemoryStream* stream = reinterpret_cast<MemoryStream*>(userData);
+        if (stream->position + OPJ_OFF_T(bytes) > stream->data.size())
+        {
+            stream->data.resize(stream->position + bytes);
+        }
+        std::memcpy(stream->data.data() + stream->position, buffer, bytes);
+        stream->position += bytes;
+        return bytes;
+    };
+
+    auto skip = [](OPJ_OFF_T bytes, void* userData) -> OPJ_OFF_T
+    {
+        MemoryStream* stream = reinterpret_cast<MemoryStream*>(userData);
+        stream->position += bytes;
+        if (stream->position > stream->data.size())
+        {
+            stream->data.resize(stream->position);
+        }
+        return bytes;
+    };
+
+    auto seek = [](OPJ_OFF_T position, void* userData) -> OPJ_BOOL
+    {
+        MemoryStream* stream = reinterpret_cast<MemoryStream*>(userData);
+        stream->position = position;
+        if (stream->position > stream->data.size())
+        {
+            stream->data.resize(stream->position);
+        }
+        return OPJ_TRUE;
+    };
+
+    std::vector<opj_image_cmptparm_t> componentParameters(components);
+    for (opj_image_cmptparm_t& parameters : componentParameters)
+    {
+        std::memset(&parameters, 0, sizeof(opj_image_cmptparm_t));
+        parameters.dx = 1;
+        parameters.dy = 1;
+        parameters.w = IMAGE_SIZE;
+        parameters.h = IMAGE_SIZE;
+        parameters.prec = 8;
+        parameters.sgnd = 0;
+    }
+
+    opj_image_t* image = opj_image_create(components, componentParameters.data(), components == 1 ? OPJ_CLRSPC_GRAY : OPJ_CLRSPC_SRGB);
+    image->x0 = 0;
+    image->y0 = 0;
+    image->x1 = IMAGE_SIZE;
+    image->y1 = IMAGE_SIZE;
+
+    const uchar* pixels = reinterpret_cast<const uchar*>(data.constData());
+    for (int i = 0; i < IMAGE_SIZE * IMAGE_SIZE; ++i)
+    {
+        for (int component = 0; component < components; ++component)
+        {
+            image->comps[component].data[i] = pixels[i * components + component];
+        }
+    }
+
+    // Lossy compression with ratio 20:1, as it is typical for scanned documents
+    opj_cparameters_t parameters;
+    opj_set_default_encoder_parameters(&parameters);
+    parameters.tcp_numlayers = 1;
+    parameters.tcp_rates[0] = 20.0f;
+    parameters.cp_disto_alloc = 1;
+    parameters.irreversible = 1;
+    parameters.tcp_mct = (components == 3) ? 1 : 0;
+
+    MemoryStream memoryStream;
+    opj_codec_t* codec = opj_create_compress(OPJ_CODEC_J2K);
+    opj_stream_t* stream = opj_stream_create(OPJ_J2K_STREAM_CHUNK_SIZE, OPJ_FALSE);
+    opj_stream_set_user_data(stream, &memoryStream, nullptr);
+    opj_stream_set_write_function(stream, write);
+    opj_stream_set_skip_function(stream, skip);
+    opj_stream_set_seek_function(stream, seek);
+
+    const bool isEncoded = opj_setup_encoder(codec, &parameters, image) &&
+                           opj_start_compress(codec, image, stream) &&
+                           opj_encode(codec, stream) &&
+                           opj_end_compress(codec, stream);
+
+    opj_stream_destroy(stream);
+    opj_destroy_codec(codec);
+    opj_image_destroy(image);
+
+    return isEncoded ? memoryStream.data : QByteArray();
+}
+
+QByteArray BenchmarkTest::encodeStripesG4()
+{
+    // Jakub Melka: We encode image of vertical black stripes, which are slightly
+    // shifted in each row (by one pixel left or right). First row is encoded
+    // using horizontal mode (all runs have length 32), other rows are encoded
+    // using vertical modes only, so we don't need the whole table of run codes.
+    // Stripes are placed between columns 32 and 64 * STRIPE_COUNT + 7, so there
+    // is always white area at the right side of the image.
+    QByteArray result;
+    uchar currentByte = 0;
+    int currentBits = 0;
+
+    auto write = [&](const char* code)
+    {
+        for (; *code; ++code)
+        {
+            currentByte = (currentByte << 1) | (*code == '1' ? 1 : 0);
+            if (++currentBits == 8)
+            {
+                result += char(currentByte);
+                currentByte = 0;
+                currentBits = 0;
+            }
+        }
+    };
+
+    auto getShift = [](int row) { const int phase = row % 14; return phase < 7 ? phase : 14 - phase; };
+
+    constexpr const char* CODE_HORIZONTAL = "001";
+    constexpr const char* CODE_WHITE_RUN_32 = "00011011";
+    constexpr const char* CODE_BLACK_RUN_32 = "000001101010";
+    constexpr const char* CODE_V0 = "1";
+    constexpr const char* CODE_VR1 = "011";
+    constexpr const char* CODE_VL1 = "010";
+
+    static_assert(STRIPE_SIZE == 32, "Run codes are for runs of length 32");
+
+    for (int row = 0; row < BILEVEL_IMAGE_HEIGHT; ++row)
+    {
+        if (row == 0)
+        {
+            for (int i = 0; i < STRIPE_COUNT; ++i)
+            {
+                write(CODE_HORIZONTAL);
+                write(CODE_WHITE_RUN_32);
+                write(CODE_BLACK_RUN_32);
+            }
+        }
+        else
+        {
+            const int difference = getShift(row) - getShift(row - 1);
+            const char* code = (difference == 0) ? CODE_V0 : ((difference > 0) ? CODE_VR1 : CODE_VL1);
+            for (int i = 0; i < 2 * STRIPE_COUNT; ++i)
+            {
+                write(code);
+            }
+        }
+
+        // Last white run to the end of the row
+        write(CODE_V0);
+    }
+
+    if (currentBits > 0)
+    {
+        result += char(currentByte << (8 - currentBits));
+    }
+
+    return result;
+}
+
+QByteArray BenchmarkTest::createStripesJBIG2()
+{
+    // Embedded JBIG2 stream (without file header), page information
+    // segment and immediate generic region segment using MMR encoding.
+    auto appendUnsignedInt = [](QByteArray& data, quint32 value)
+    {
+        data.append(char((value >> 24) & 0xFF));
+        data.append(char((value >> 16) & 0xFF));
+        data.append(char((value >> 8) & 0xFF));
+        data.append(char(value & 0xFF));
+    };
+
+    auto appendSegmentHeader = [&appendUnsignedInt](QByteArray& data, quint32 segmentNumber, quint8 type, quint32 dataLength)
+    {
+        appendUnsignedInt(data, segmentNumber);
+        data.append(char(type));
+        data.append(char(0));   // No referred segments
+        data.append(char(1));   // Page association
+        appendUnsignedInt(data, dataLength);
+    };
+
+    QByteArray pageInformation;
+    appendUnsignedInt(pageInformation, BILEVEL_IMAGE_WIDTH);
+    appendUnsignedInt(pageInformation, BILEVEL_IMAGE_HEIGHT);
+    appendUnsignedInt(pageInformation, 0);
+    appendUnsignedInt(pageInformation, 0);
+    pageInformation.append(char(0));
+    pageInformation.append(2, char(0));
+
+    QByteArray genericRegion;
+    appendUnsignedInt(genericRegion, BILEVEL_IMAGE_WIDTH);
+    appendUnsignedInt(genericRegion, BILEVEL_IMAGE_HEIGHT);
+    appendUnsignedInt(genericRegion, 0);
+    appendUnsignedInt(genericRegion, 0);
+    genericRegion.append(char(0));  // Combination operator OR
+    genericRegion.append(char(1));  // MMR encoding
+    genericRegion.append(encodeStripesG4());
+
+    QByteArray result;
+    appendSegmentHeader(result, 0, 48, quint32(pageInformation.size()));
+    result.append(pageInformation);
+    appendSegmentHeader(result, 1, 38, quint32(genericRegion.size()));
+    result.append(genericRegion);
+    return result;
+}
+
+bool BenchmarkTest::isStripesImage(const pdf::PDFImageData& imageData)
+{
+    if (imageData.getWidth() != BILEVEL_IMAGE_WIDTH || imageData.getHeight() != BILEVEL_IMAGE_HEIGHT)
+    {
+        return false;
+    }
+
+    // Black pixels are determined by the decode array of the image data,
+    // so we just check, that count of one bits corresponds to the stripes.
+    int count = 0;
+    for (const char byte : imageData.getData())
+    {
+        count += std::popcount(uchar(byte));
+    }
+
+    const int blackPixelCount = STRIPE_SIZE * STRIPE_COUNT * BILEVEL_IMAGE_HEIGHT;
+    const int whitePixelCount = BILEVEL_IMAGE_WIDTH * BILEVEL_IMAGE_HEIGHT - blackPixelCount;
+    return count == blackPixelCount || count == whitePixelCount;
+}
+
+QTEST_GUILESS_MAIN(BenchmarkTest)
+
+#include "tst_benchmarks.moc"
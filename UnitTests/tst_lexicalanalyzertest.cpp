@@ -27,8 +27,36 @@
 #include "pdfdocument.h"
 #include "pdfexception.h"
 #include "pdfjbig2decoder.h"
+#include "pdfdocumentbuilder.h"
+#include "pdfdocumentreader.h"
+#include "pdfdocumentwriter.h"
+#include "pdfpainter.h"
+#include "pdfdiskcache.h"
+#include "pdfpagecontenthash.h"
+#include "pdfexecutionpolicy.h"
+#include "pdfpngstreamwriter.h"
+#include "pdfcms.h"
+#include "pdftransparencyrenderer.h"
+#include "pdftextlayout.h"
+#include "pdffont.h"
+#include "pdfrenderer.h"
+#include "pdfoptionalcontent.h"
+#include "pdfdocumenttextflow.h"
+#include "pdfasyncdocument.h"
+#include "pdfannotation.h"
+#include "pdfpagecontentprocessor.h"
+#include "pdftextlayoutgenerator.h"
+#include "pdfpathbuilder.h"
+#include "pdfbitonaldocumentconvertor.h"
+#include "pdfjavascriptscanner.h"
+#include "pdfformfiller.h"
+#include "pdfimage.h"
 
 #include <regex>
+#include <random>
+#include <numeric>
+#include <thread>
+#include <atomic>
 
 #ifdef PDF4QT_COMPILER_MSVC
 #pragma warning(push)
@@ -51,14 +79,63 @@ private slots:
     void test_bool();
     void test_ad();
     void test_command();
+    void test_content_stream_tokens();
     void test_invalid_input();
     void test_header_regexp();
     void test_flat_map();
+    void test_interned_names();
+    void test_indexed_dictionary();
+    void test_incremental_update();
+    void test_incremental_update_xref_stream();
+    void test_object_streams_write();
+    void test_linearized_write();
+    void test_random_access_source();
+    void test_concurrent_document_access();
+    void test_async_document_processor();
+    void test_headless_rasterizer();
+    void test_render_to_buffer();
+    void test_content_stream_program_cache();
+    void test_parallel_form_compilation();
+    void test_path_builder();
+    void test_precompiled_page_compact_storage();
+    void test_named_destination_lookup();
+    void test_streaming_document_builder();
+    void test_execute_ordered();
+    void test_bitonal_conversion();
+    void test_javascript_presence();
+    void test_render_tile_pyramid();
+    void test_rasterizer_pool_sizes();
+    void test_form_filler();
+    void test_lazy_loading_damaged_xref();
+    void test_damaged_document_index();
+    void test_post_raster_color_adjustment();
     void test_lzw_filter();
+    void test_flate_compression_levels();
+    void test_decoded_stream_cache();
+    void test_document_unique_id();
+    void test_streaming_filter_chain();
+    void test_precompiled_page_spatial_index();
+    void test_precompiled_page_serialization();
+    void test_disk_cache();
+    void test_page_content_hash();
+    void test_parallel_sort();
+    void test_png_stream_writer();
+    void test_color_lookup_table();
+    void test_jbig2_bitmap_paint();
+    void test_bit_reader();
     void test_sampled_function();
     void test_exponential_function();
     void test_stitching_function();
     void test_postscript_function();
+    void test_function_lookup_table();
+    void test_function_batch();
+    void test_float_bitmap_copy();
+    void test_float_bitmap_blend_separable();
+    void test_text_layout_storage_find();
+    void test_text_layout_search_index();
+    void test_cmap_lookup();
+    void test_chunked_vector();
+    void test_snap_index();
     void test_jbig2_arithmetic_decoder();
 
 private:
@@ -213,6 +290,52 @@ void LexicalAnalyzerTest::test_command()
 
     testTokens("command", { Token(Type::Command, QByteArray("command")) });
     testTokens("command1 command2", { Token(Type::Command, QByteArray("command1")), Token(Type::Command, QByteArray("command2")) });
+
+    // Long tokens, whitespaces and comments, which span over multiple scanned blocks
+    testTokens("averyveryverylongcommandname\n\n\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\tcommand2", { Token(Type::Command, QByteArray("averyveryverylongcommandname")), Token(Type::Command, QByteArray("command2")) });
+    testTokens("% a very very very long comment, which is longer than sixteen characters\r\ncommand1 %another long comment without the end", { Token(Type::Command, QByteArray("command1")) });
+    testTokens("/AVeryVeryLongName#20With#23Escapes/AnotherVeryVeryLongNameWithoutEscapes[averyveryverylongcommandname]", { Token(Type::Name, QByteArray("AVeryVeryLongName With#Escapes")), Token(Type::Name, QByteArray("AnotherVeryVeryLongNameWithoutEscapes")), Token(Type::ArrayStart), Token(Type::Command, QByteArray("averyveryverylongcommandname")), Token(Type::ArrayEnd) });
+}
+
+void LexicalAnalyzerTest::test_content_stream_tokens()
+{
+    using Token = pdf::PDFLexicalAnalyzer::Token;
+    using Type = pdf::PDFLexicalAnalyzer::TokenType;
+
+    const QByteArray content = "1 0 .5 RG true null /Name (string) BT\n-2 Td averyveryverylongcommand";
+    pdf::PDFLexicalAnalyzer analyzer(content.constBegin(), content.constEnd());
+
+    std::vector<Token> tokens;
+    std::vector<QByteArray> commands;
+    while (!analyzer.isAtEnd())
+    {
+        QByteArrayView command;
+        Token token = analyzer.fetchContentStreamToken(command);
+        if (token.type == Type::Command)
+        {
+            // Command is a view into the content
+            QVERIFY(command.data() >= content.constBegin() && command.data() + command.size() <= content.constEnd());
+            QVERIFY(!token.data.isValid());
+            commands.push_back(command.toByteArray());
+        }
+        tokens.push_back(qMove(token));
+    }
+
+    std::vector<Token> expectedTokens = { Token(Type::Integer, QVariant(qint64(1))), Token(Type::Integer, QVariant(qint64(0))), Token(Type::Real, 0.5), Token(Type::Command),
+                                          Token(Type::Boolean, true), Token(Type::Null), Token(Type::Name, QByteArray("Name")), Token(Type::String, QByteArray("string")),
+                                          Token(Type::Command), Token(Type::Integer, QVariant(qint64(-2))), Token(Type::Command), Token(Type::Command) };
+    std::vector<QByteArray> expectedCommands = { "RG", "BT", "Td", "averyveryverylongcommand" };
+
+    QCOMPARE(tokens.size(), expectedTokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        QCOMPARE(tokens[i].type, expectedTokens[i].type);
+        if (tokens[i].type != Type::Command)
+        {
+            QCOMPARE(tokens[i].data, expectedTokens[i].data);
+        }
+    }
+    QCOMPARE(commands, expectedCommands);
 }
 
 void LexicalAnalyzerTest::test_invalid_input()
@@ -237,89 +360,2150 @@ void LexicalAnalyzerTest::test_invalid_input()
     QVERIFY_THROWS_EXCEPTION(pdf::PDFException, scanWholeStream(")"));
 }
 
-void LexicalAnalyzerTest::test_header_regexp()
-{
-    std::regex regex(pdf::PDF_FILE_HEADER_REGEXP);
+void LexicalAnalyzerTest::test_header_regexp()
+{
+    std::regex regex(pdf::PDF_FILE_HEADER_REGEXP);
+
+    for (const char* string : { "%PDF-1.4", "   %PDF-1.4abs", "%PDF-1.4", "%test %PDF %PDF-1.4", "%!PS-Adobe-3.0 PDF-1.4"})
+    {
+        std::cmatch cmatch;
+        const bool matched = std::regex_search(string, string + strlen(string), cmatch, regex);
+        QVERIFY(matched);
+
+        if (matched)
+        {
+            QVERIFY(cmatch.size() == 3);
+            QVERIFY(cmatch[1].matched || cmatch[2].matched);
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_flat_map()
+{
+    using Map = pdf::PDFFlatMap<int, 2>;
+
+    struct Item
+    {
+        int order;
+        int number;
+        bool erase;
+
+        bool operator<(const Item& other) const { return order < other.order; }
+    };
+
+    for (int count = 1; count < 5; ++count)
+    {
+        std::vector<Item> items;
+        items.reserve(2 * count);
+
+        int order = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            items.emplace_back(Item{order++, i, false});
+            items.emplace_back(Item{order++, i, true});
+        }
+
+        do
+        {
+            std::set<int> testSet;
+            Map testFlatMap;
+
+            for (const Item& item : items)
+            {
+                if (!item.erase)
+                {
+                    testSet.insert(item.number);
+                    testFlatMap.insert(item.number);
+                }
+                else
+                {
+                    testSet.erase(item.number);
+                    testFlatMap.erase(item.number);
+                }
+
+                QCOMPARE(testSet.size(), testFlatMap.size());
+                QCOMPARE(testSet.empty(), testFlatMap.empty());
+
+                for (const int testInteger : testSet)
+                {
+                    QVERIFY(testFlatMap.search(testInteger));
+                }
+            }
+
+        } while (std::next_permutation(items.begin(), items.end()));
+    }
+}
+
+void LexicalAnalyzerTest::test_interned_names()
+{
+    const pdf::PDFInternedName* name = pdf::PDFInternedNameTable::intern("FontDescriptor", 14);
+    QVERIFY(name);
+    QCOMPARE(name->string, QByteArray("FontDescriptor"));
+    QVERIFY(name == pdf::PDFInternedNameTable::intern(QByteArray("FontDescriptor").constData(), 14));
+    QVERIFY(name != pdf::PDFInternedNameTable::intern("FontDescriptors", 15));
+
+    QByteArray tooLongName(pdf::PDFInternedNameTable::MAX_NAME_LENGTH + 1, 'A');
+    QVERIFY(!pdf::PDFInternedNameTable::intern(tooLongName.constData(), tooLongName.size()));
+
+    pdf::PDFInplaceOrMemoryString key("FontDescriptor");
+    pdf::PDFInplaceOrMemoryString otherKey(QByteArray("FontDescriptor"));
+    pdf::PDFInplaceOrMemoryString longKey(tooLongName);
+    QVERIFY(key.isInterned());
+    QVERIFY(!pdf::PDFInplaceOrMemoryString("Type").isInterned());
+    QVERIFY(!longKey.isInterned());
+    QVERIFY(key == otherKey);
+    QVERIFY(key == "FontDescriptor");
+    QVERIFY(key != longKey);
+    QCOMPARE(key.getString(), QByteArray("FontDescriptor"));
+    QCOMPARE(key.getHash(), qHash(QByteArrayView("FontDescriptor")));
+}
+
+void LexicalAnalyzerTest::test_indexed_dictionary()
+{
+    auto getKey = [](int i) { return QByteArray(i % 2 ? "Im" : "VeryLongImageName") + QByteArray::number(i); };
+
+    pdf::PDFDictionary dictionary;
+    for (int i = 0; i < 200; ++i)
+    {
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString(getKey(i)), pdf::PDFObject::createInteger(i));
+    }
+
+    // Duplicate key, first entry must be found
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString(getKey(5)), pdf::PDFObject::createInteger(-1));
+    QVERIFY(dictionary.isIndexed());
+
+    for (int i = 0; i < 200; ++i)
+    {
+        const QByteArray key = getKey(i);
+        QCOMPARE(dictionary.get(key).getInteger(), i);
+        QCOMPARE(dictionary.get(key.constData()).getInteger(), i);
+        QCOMPARE(dictionary.get(pdf::PDFInplaceOrMemoryString(key)).getInteger(), i);
+    }
+
+    QVERIFY(!dictionary.hasKey("Im200"));
+    QVERIFY(!dictionary.hasKey(QByteArray("VeryLongImageName201")));
+
+    dictionary.removeEntry(getKey(10).constData());
+    QVERIFY(!dictionary.hasKey(getKey(10)));
+    QCOMPARE(dictionary.get(getKey(11)).getInteger(), 11);
+
+    dictionary.setEntry(pdf::PDFInplaceOrMemoryString("Im300"), pdf::PDFObject::createInteger(300));
+    dictionary.setEntry(pdf::PDFInplaceOrMemoryString(getKey(12)), pdf::PDFObject::createInteger(-12));
+    QCOMPARE(dictionary.get("Im300").getInteger(), 300);
+    QCOMPARE(dictionary.get(getKey(12)).getInteger(), -12);
+
+    pdf::PDFDictionary smallDictionary;
+    smallDictionary.addEntry(pdf::PDFInplaceOrMemoryString("Type"), pdf::PDFObject::createName("XObject"));
+    QVERIFY(!smallDictionary.isIndexed());
+    QVERIFY(smallDictionary.hasKey("Type"));
+}
+
+void LexicalAnalyzerTest::test_incremental_update()
+{
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 100, 100));
+    builder.setDocumentTitle("Original");
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    QBuffer originalBuffer;
+    originalBuffer.open(QBuffer::WriteOnly);
+    QVERIFY(writer.write(&originalBuffer, &document));
+    originalBuffer.close();
+    const QByteArray originalData = originalBuffer.data();
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument loadedDocument = reader.readFromBuffer(originalData);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QVERIFY(!loadedDocument.getStorage().isAllObjectsModified());
+    QVERIFY(loadedDocument.getStorage().getModifiedObjects().empty());
+
+    // Objects modified through array of objects are detected too
+    pdf::PDFObjectStorage storage = loadedDocument.getStorage();
+    pdf::PDFObjectStorage::PDFObjects& objects = storage.getObjects();
+    QVERIFY(storage.getModifiedObjects().empty());
+    objects[1].object = pdf::PDFObject::createInteger(42);
+    const std::vector<pdf::PDFObjectReference> modifiedObjects = storage.getModifiedObjects();
+    QCOMPARE(modifiedObjects.size(), size_t(1));
+    QCOMPARE(modifiedObjects.front().objectNumber, pdf::PDFInteger(1));
+    QVERIFY(storage.isObjectModified(1));
+    QVERIFY(!storage.isObjectModified(2));
+
+    pdf::PDFDocumentBuilder modifier(&loadedDocument);
+    modifier.setDocumentTitle("Modified");
+    pdf::PDFDocument modifiedDocument = modifier.build();
+    QVERIFY(!modifiedDocument.getStorage().getModifiedObjects().empty());
+
+    const pdf::PDFInteger previousXRefOffset = pdf::PDFDocumentWriter::findLastXRefOffset(originalData);
+    QVERIFY(previousXRefOffset > 0);
+
+    QBuffer updatedBuffer;
+    updatedBuffer.setData(originalData);
+    updatedBuffer.open(QBuffer::ReadWrite);
+    updatedBuffer.seek(originalData.size());
+    QVERIFY(writer.writeIncrementalUpdate(&updatedBuffer, &modifiedDocument, previousXRefOffset, false));
+    updatedBuffer.close();
+    const QByteArray updatedData = updatedBuffer.data();
+
+    // Original data must remain unchanged, only modified objects are appended
+    QVERIFY(updatedData.startsWith(originalData));
+    QVERIFY(updatedData.size() - originalData.size() < originalData.size());
+
+    pdf::PDFDocument updatedDocument = reader.readFromBuffer(updatedData);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QCOMPARE(updatedDocument.getInfo()->title, QString("Modified"));
+    QCOMPARE(updatedDocument.getCatalog()->getPageCount(), size_t(1));
+}
+
+void LexicalAnalyzerTest::test_incremental_update_xref_stream()
+{
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 100, 100));
+    builder.setDocumentTitle("Original");
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    writer.setObjectStreamsUsed(true);
+    QBuffer originalBuffer;
+    originalBuffer.open(QBuffer::WriteOnly);
+    QVERIFY(writer.write(&originalBuffer, &document));
+    originalBuffer.close();
+    const QByteArray originalData = originalBuffer.data();
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument loadedDocument = reader.readFromBuffer(originalData);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+
+    pdf::PDFDocumentBuilder modifier(&loadedDocument);
+    modifier.setDocumentTitle("Modified");
+    pdf::PDFDocument modifiedDocument = modifier.build();
+
+    const pdf::PDFInteger previousXRefOffset = pdf::PDFDocumentWriter::findLastXRefOffset(originalData);
+    QVERIFY(previousXRefOffset > 0);
+
+    QBuffer updatedBuffer;
+    updatedBuffer.setData(originalData);
+    updatedBuffer.open(QBuffer::ReadWrite);
+    updatedBuffer.seek(originalData.size());
+    QVERIFY(writer.writeIncrementalUpdate(&updatedBuffer, &modifiedDocument, previousXRefOffset, true));
+    updatedBuffer.close();
+    const QByteArray updatedData = updatedBuffer.data();
+
+    // Cross-reference stream must be written, because original document uses it
+    QVERIFY(updatedData.startsWith(originalData));
+    QVERIFY(!updatedData.mid(originalData.size()).contains("trailer"));
+
+    pdf::PDFDocument updatedDocument = reader.readFromBuffer(updatedData);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QCOMPARE(updatedDocument.getInfo()->title, QString("Modified"));
+    QCOMPARE(updatedDocument.getCatalog()->getPageCount(), size_t(1));
+}
+
+void LexicalAnalyzerTest::test_object_streams_write()
+{
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    for (int i = 0; i < 150; ++i)
+    {
+        builder.appendPage(QRectF(0, 0, 100 + i, 100));
+    }
+    builder.setDocumentTitle("Object streams");
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    writer.setObjectStreamsUsed(true);
+
+    QBuffer buffer;
+    buffer.open(QBuffer::WriteOnly);
+    QVERIFY(writer.write(&buffer, &document));
+    buffer.close();
+    const QByteArray data = buffer.data();
+
+    QVERIFY(data.contains("/ObjStm"));
+    QVERIFY(data.contains("/XRef"));
+    QVERIFY(!data.contains("trailer"));
+    QVERIFY(data.size() < pdf::PDFDocumentWriter::getDocumentFileSize(&document));
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument readDocument = reader.readFromBuffer(data);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QCOMPARE(readDocument.getInfo()->title, QString("Object streams"));
+    QCOMPARE(readDocument.getCatalog()->getPageCount(), size_t(150));
+    QCOMPARE(readDocument.getCatalog()->getPage(149)->getMediaBox().width(), 249.0);
+}
+
+void LexicalAnalyzerTest::test_linearized_write()
+{
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    for (int i = 0; i < 20; ++i)
+    {
+        builder.appendPage(QRectF(0, 0, 100 + i, 100));
+    }
+    builder.setDocumentTitle("Linearized");
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    writer.setLinearized(true);
+
+    QBuffer buffer;
+    buffer.open(QBuffer::WriteOnly);
+    QVERIFY(writer.write(&buffer, &document));
+    buffer.close();
+    const QByteArray data = buffer.data();
+
+    // Linearization dictionary must be the first object in the file
+    const int linearizedIndex = data.indexOf("/Linearized");
+    QVERIFY(linearizedIndex != -1 && linearizedIndex < 1024);
+    QVERIFY(data.indexOf(" obj") < linearizedIndex);
+    QVERIFY(data.indexOf(" obj", data.indexOf(" obj") + 1) > linearizedIndex);
+    QVERIFY(data.contains(QByteArray("/L ") + QByteArray::number(data.size()) + " "));
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument readDocument = reader.readFromBuffer(data);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QCOMPARE(readDocument.getInfo()->title, QString("Linearized"));
+    QCOMPARE(readDocument.getCatalog()->getPageCount(), size_t(20));
+    QCOMPARE(readDocument.getCatalog()->getPage(0)->getMediaBox().width(), 100.0);
+    QCOMPARE(readDocument.getCatalog()->getPage(19)->getMediaBox().width(), 119.0);
+}
+
+void LexicalAnalyzerTest::test_random_access_source()
+{
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    for (int i = 0; i < 50; ++i)
+    {
+        pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 100 + i, 100));
+        builder.createAnnotationSquare(page, QRectF(10, 10, 50, 50), 1.0, Qt::red, Qt::black, "Title", "Subject", QString(32768, QChar('a' + i % 26)));
+    }
+    builder.setDocumentTitle("Random access");
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFDocumentWriter writer(nullptr);
+    writer.setLinearized(true);
+
+    QBuffer buffer;
+    buffer.open(QBuffer::WriteOnly);
+    QVERIFY(writer.write(&buffer, &document));
+    buffer.close();
+    buffer.open(QBuffer::ReadOnly);
+
+    std::shared_ptr<pdf::PDFDeviceRandomAccessSource> source = std::make_shared<pdf::PDFDeviceRandomAccessSource>(&buffer);
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument readDocument = reader.readFromSource(source);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QCOMPARE(readDocument.getInfo()->title, QString("Random access"));
+    QCOMPARE(readDocument.getCatalog()->getPageCount(), size_t(50));
+
+    // Annotations of pages are not fetched until they are needed
+    const qint64 bytesReadAfterOpen = source->getBytesRead();
+    QVERIFY(bytesReadAfterOpen < buffer.size() / 2);
+
+    const pdf::PDFPage* lastPage = readDocument.getCatalog()->getPage(49);
+    QCOMPARE(lastPage->getMediaBox().width(), 149.0);
+    QCOMPARE(lastPage->getAnnotations().size(), size_t(1));
+    const pdf::PDFDictionary* annotationDictionary = readDocument.getDictionaryFromObject(readDocument.getObjectByReference(lastPage->getAnnotations().front()));
+    QVERIFY(annotationDictionary);
+    QVERIFY(annotationDictionary->get("Contents").isString());
+    QVERIFY(source->getBytesRead() > bytesReadAfterOpen);
+}
+
+void LexicalAnalyzerTest::test_concurrent_document_access()
+{
+    // Document is written by hand, so objects are loaded on demand,
+    // when they are accessed for the first time from some thread.
+    constexpr int pageCount = 20;
+    constexpr int glyphCount = 10;
+    std::vector<QByteArray> objects;
+
+    QByteArray kids;
+    for (int i = 0; i < pageCount; ++i)
+    {
+        kids.append(QByteArray::number(5 + glyphCount + 2 * i) + " 0 R ");
+    }
+
+    QByteArray charProcs;
+    QByteArray differences;
+    QByteArray widths;
+    for (int i = 0; i < glyphCount; ++i)
+    {
+        const QByteArray glyphName = QByteArray(1, char('A' + i));
+        charProcs.append("/" + glyphName + " " + QByteArray::number(5 + i) + " 0 R ");
+        differences.append("/" + glyphName + " ");
+        widths.append("1000 ");
+    }
+
+    objects.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+    objects.push_back("<< /Type /Pages /Kids [" + kids + "] /Count " + QByteArray::number(pageCount) + " >>");
+    objects.push_back("<< /Type /Font /Subtype /Type3 /FontBBox [0 0 750 750] /FontMatrix [0.001 0 0 0.001 0 0] /CharProcs 4 0 R "
+                      "/Encoding << /Type /Encoding /Differences [65 " + differences + "] >> /FirstChar 65 /LastChar " +
+                      QByteArray::number(65 + glyphCount - 1) + " /Widths [" + widths + "] /Resources << >> >>");
+    objects.push_back("<< " + charProcs + ">>");
+
+    auto createStream = [](const QByteArray& data, bool compress)
+    {
+        QByteArray streamData = compress ? qCompress(data).mid(4) : data;
+        QByteArray filter = compress ? "/Filter /FlateDecode " : "";
+        return "<< " + filter + "/Length " + QByteArray::number(streamData.size()) + " >>\nstream\n" + streamData + "\nendstream";
+    };
+
+    for (int i = 0; i < glyphCount; ++i)
+    {
+        objects.push_back(createStream("1000 0 0 0 750 750 d1 0 0 750 750 re f", false));
+    }
+
+    for (int i = 0; i < pageCount; ++i)
+    {
+        QByteArray text;
+        for (char digit : QByteArray::number(i))
+        {
+            text.append(char('A' + digit - '0'));
+        }
+
+        const QByteArray content = "0 0 1 rg 10 10 " + QByteArray::number(10 + 4 * i) + " 20 re f BT /F1 12 Tf 20 50 Td (" + text + ") Tj ET";
+        objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Resources << /Font << /F1 3 0 R >> >> /Contents " +
+                          QByteArray::number(6 + glyphCount + 2 * i) + " 0 R >>");
+        objects.push_back(createStream(content, true));
+    }
+
+    QByteArray data = "%PDF-1.7\n";
+    std::vector<int> offsets;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        offsets.push_back(int(data.size()));
+        data.append(QByteArray::number(qulonglong(i + 1)) + " 0 obj\n" + objects[i] + "\nendobj\n");
+    }
+
+    const int xrefOffset = int(data.size());
+    data.append("xref\n0 " + QByteArray::number(qulonglong(objects.size() + 1)) + "\n0000000000 65535 f\r\n");
+    for (int offset : offsets)
+    {
+        data.append(QString("%1 00000 n\r\n").arg(offset, 10, 10, QChar('0')).toLatin1());
+    }
+    data.append("trailer\n<< /Size " + QByteArray::number(qulonglong(objects.size() + 1)) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n");
+
+    auto readDocument = [](QBuffer* buffer)
+    {
+        buffer->open(QBuffer::ReadOnly);
+        auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+        pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+        pdf::PDFDocument document = reader.readFromSource(std::make_shared<pdf::PDFDeviceRandomAccessSource>(buffer));
+        return document;
+    };
+
+    auto renderPage = [](const pdf::PDFDocument* document, const pdf::PDFFontCache* fontCache, const pdf::PDFOptionalContentActivity* optionalContentActivity, pdf::PDFInteger pageIndex)
+    {
+        pdf::PDFCMSGeneric cms;
+        pdf::PDFRenderer renderer(document, fontCache, &cms, optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
+        pdf::PDFPrecompiledPage compiledPage;
+        renderer.compile(&compiledPage, pageIndex);
+
+        QImage image(100, 100, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        compiledPage.draw(&painter, QRectF(), QTransform(), pdf::PDFRenderer::getDefaultFeatures(), 1.0);
+        painter.end();
+        return image;
+    };
+
+    auto extractText = [](const pdf::PDFDocument* document, pdf::PDFInteger pageIndex)
+    {
+        pdf::PDFDocumentTextFlowFactory factory;
+        return factory.create(document, { pageIndex }, pdf::PDFDocumentTextFlowFactory::Algorithm::Layout).getText();
+    };
+
+    // Reference results are computed in one thread, then the fresh copy
+    // of the same document (nothing is loaded yet) is accessed from many
+    // threads at the same time.
+    QBuffer referenceBuffer(&data);
+    pdf::PDFDocument referenceDocument = readDocument(&referenceBuffer);
+    QCOMPARE(referenceDocument.getCatalog()->getPageCount(), size_t(pageCount));
+    pdf::PDFOptionalContentActivity referenceOptionalContentActivity(&referenceDocument, pdf::OCUsage::Export, nullptr);
+    pdf::PDFFontCache referenceFontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    referenceFontCache.setDocument(pdf::PDFModifiedDocument(&referenceDocument, &referenceOptionalContentActivity));
+
+    std::vector<QImage> referenceImages;
+    std::vector<QString> referenceTexts;
+    for (int i = 0; i < pageCount; ++i)
+    {
+        referenceImages.push_back(renderPage(&referenceDocument, &referenceFontCache, &referenceOptionalContentActivity, i));
+        referenceTexts.push_back(extractText(&referenceDocument, i));
+    }
+    QVERIFY(referenceImages[0] != referenceImages[1]);
+
+    QBuffer buffer(&data);
+    pdf::PDFDocument document = readDocument(&buffer);
+    QCOMPARE(document.getCatalog()->getPageCount(), size_t(pageCount));
+    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    fontCache.setDocument(pdf::PDFModifiedDocument(&document, &optionalContentActivity));
+
+    constexpr int threadCount = 8;
+    std::atomic_int mismatchCount = 0;
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    {
+        threads.emplace_back([&, threadIndex]()
+        {
+            for (int i = 0; i < pageCount; ++i)
+            {
+                const int pageIndex = (i + threadIndex * 3) % pageCount;
+                if (renderPage(&document, &fontCache, &optionalContentActivity, pageIndex) != referenceImages[pageIndex] ||
+                    extractText(&document, pageIndex) != referenceTexts[pageIndex])
+                {
+                    ++mismatchCount;
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    QCOMPARE(mismatchCount.load(), 0);
+}
+
+void LexicalAnalyzerTest::test_async_document_processor()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 100, 200));
+    builder.appendPage(QRectF(0, 0, 200, 100));
+    pdf::PDFDocument document = builder.build();
+
+    const QString fileName = directory.filePath("async.pdf");
+    pdf::PDFDocumentWriter writer(nullptr);
+    QVERIFY(writer.write(fileName, &document, false));
+
+    pdf::PDFAsyncDocumentProcessor processor(1);
+    pdf::PDFAsyncDocumentSettings settings;
+    settings.rendererEngine = pdf::RendererEngine::QPainter;
+
+    QFuture<pdf::PDFAsyncOpenResult> openFuture = processor.openAsync(directory.filePath("nonexistent.pdf"), settings);
+    QVERIFY(!openFuture.result().document);
+    QCOMPARE(openFuture.result().result, pdf::PDFDocumentReader::Result::Failed);
+
+    openFuture = processor.openAsync(fileName, settings);
+    pdf::PDFAsyncDocumentPointer asyncDocument = openFuture.result().document;
+    QVERIFY(asyncDocument);
+    QCOMPARE(asyncDocument->getDocument()->getCatalog()->getPageCount(), size_t(2));
+
+    QFuture<pdf::PDFAsyncRenderResult> renderFuture = processor.renderPageAsync(asyncDocument, 1, QSize(50, 25));
+    QCOMPARE(renderFuture.result().pageIndex, pdf::PDFInteger(1));
+    QCOMPARE(renderFuture.result().image.size(), QSize(50, 25));
+
+    renderFuture = processor.renderPageAsync(asyncDocument, 5, QSize(50, 25));
+    QVERIFY(renderFuture.result().image.isNull());
+    QVERIFY(!renderFuture.result().errors.isEmpty());
+
+    QFuture<pdf::PDFTextLayout> textFuture = processor.extractTextAsync(asyncDocument, 0);
+    QVERIFY(textFuture.result().getTextBlocks().empty());
+
+    // Queued task, which is cancelled, is never started
+    QSemaphore startedSemaphore;
+    QSemaphore releaseSemaphore;
+    processor.getThreadPool()->start([&]() { startedSemaphore.release(); releaseSemaphore.acquire(); }, int(pdf::PDFAsyncDocumentProcessor::Priority::High));
+    startedSemaphore.acquire();
+
+    renderFuture = processor.renderPageAsync(asyncDocument, 0, QSize(50, 100), pdf::PDFAsyncDocumentProcessor::Priority::Low);
+    renderFuture.cancel();
+    releaseSemaphore.release();
+    renderFuture.waitForFinished();
+    QVERIFY(renderFuture.isCanceled());
+    QCOMPARE(renderFuture.resultCount(), 0);
+}
+
+void LexicalAnalyzerTest::test_headless_rasterizer()
+{
+    // Tests are running without QGuiApplication
+    QVERIFY(!pdf::PDFAnnotation::isSystemFontAvailable());
+
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 100, 100));
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    fontCache.setDocument(pdf::PDFModifiedDocument(&document, &optionalContentActivity));
+    const pdf::PDFPage* page = document.getCatalog()->getPage(0);
+
+    // Rasterizers are constructed and used in threads other than main thread
+    std::atomic_int renderedImageCount = 0;
+    std::vector<std::thread> threads;
+    for (pdf::RendererEngine engine : { pdf::RendererEngine::QPainter, pdf::RendererEngine::Blend2D_SingleThread, pdf::RendererEngine::QPainter, pdf::RendererEngine::Blend2D_SingleThread })
+    {
+        threads.emplace_back([&, engine]()
+        {
+            pdf::PDFCMSGeneric cms;
+            pdf::PDFRenderer renderer(&document, &fontCache, &cms, &optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
+            pdf::PDFPrecompiledPage compiledPage;
+            renderer.compile(&compiledPage, 0);
+
+            pdf::PDFRasterizer rasterizer(nullptr);
+            rasterizer.reset(engine);
+            QImage image = rasterizer.render(0, page, &compiledPage, QSize(64, 64), pdf::PDFRenderer::getDefaultFeatures(), nullptr, pdf::PageRotation::None);
+            if (image.size() == QSize(64, 64))
+            {
+                ++renderedImageCount;
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    QCOMPARE(renderedImageCount.load(), 4);
+}
+
+void LexicalAnalyzerTest::test_render_to_buffer()
+{
+    pdf::PDFPrecompiledPage compiledPage;
+    QPainterPath path;
+    path.addRect(0, 0, 50, 100);
+    compiledPage.addPath(Qt::NoPen, QBrush(Qt::black), path, false);
+    compiledPage.finalize(0, { });
+
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 100, 100));
+    pdf::PDFDocument document = builder.build();
+    const pdf::PDFPage* page = document.getCatalog()->getPage(0);
+
+    const QSize size(20, 10);
+    pdf::PDFRasterizer rasterizer(nullptr);
+    rasterizer.reset(pdf::RendererEngine::QPainter);
+    const QImage image = rasterizer.render(0, page, &compiledPage, size, pdf::PDFRenderer::None, nullptr, pdf::PageRotation::None);
+
+    // Left half of the page is black, right half is white
+    using BufferFormat = pdf::PDFRasterizer::BufferFormat;
+    for (BufferFormat format : { BufferFormat::BGRA8888, BufferFormat::RGB565, BufferFormat::Gray8 })
+    {
+        const int bytesPerPixel = pdf::PDFRasterizer::getBytesPerPixel(format);
+        const qsizetype bytesPerLine = size.width() * bytesPerPixel + 8;
+        QByteArray buffer(bytesPerLine * size.height(), char(0x5A));
+        uchar* bits = reinterpret_cast<uchar*>(buffer.data());
+
+        QVERIFY(rasterizer.render(0, page, &compiledPage, bits, size, bytesPerLine, format, pdf::PDFRenderer::None, nullptr, pdf::PageRotation::None));
+        QVERIFY(!rasterizer.render(0, page, &compiledPage, bits, size, size.width() * bytesPerPixel - 1, format, pdf::PDFRenderer::None, nullptr, pdf::PageRotation::None));
+
+        for (int y = 0; y < size.height(); ++y)
+        {
+            const uchar* row = bits + y * bytesPerLine;
+            const uchar* blackPixel = row + 2 * bytesPerPixel;
+            const uchar* whitePixel = row + (size.width() - 2) * bytesPerPixel;
+
+            for (int i = 0; i < bytesPerPixel; ++i)
+            {
+                const bool isAlpha = format == BufferFormat::BGRA8888 && i == 3;
+                QCOMPARE(blackPixel[i], isAlpha ? uchar(0xFF) : uchar(0x00));
+                QCOMPARE(whitePixel[i], uchar(0xFF));
+            }
+
+            // Padding at the end of the line is not modified
+            QCOMPARE(row[bytesPerLine - 1], uchar(0x5A));
+        }
+
+        if (format == BufferFormat::BGRA8888)
+        {
+            const QImage bufferImage(bits, size.width(), size.height(), bytesPerLine, QImage::Format_ARGB32_Premultiplied);
+            QCOMPARE(bufferImage, image);
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_content_stream_program_cache()
+{
+    constexpr int formCount = 50;
+    pdf::PDFContentStreamCache* cache = pdf::PDFContentStreamCache::getInstance();
+    const qint64 cacheSize = cache->getCacheSize();
+
+    {
+        // Form with an inline image is painted many times, page content contains an error
+        QByteArray pageContent = "0 0 1 rg 0 0 5 5 re f ) ";
+        for (int i = 0; i < formCount; ++i)
+        {
+            pageContent.append("q 1 0 0 1 " + QByteArray::number(i % 10 * 10) + " " + QByteArray::number(i / 10 * 10) + " cm /Fm1 Do Q ");
+        }
+        const QByteArray formContent = "1 0 0 rg 0 0 8 8 re f q 4 0 0 4 0 0 cm BI /W 2 /H 1 /BPC 8 /CS /G ID \x20\xE0 EI Q";
+
+        std::vector<QByteArray> objects;
+        objects.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+        objects.push_back("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+        objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Resources << /XObject << /Fm1 5 0 R >> >> /Contents 4 0 R >>");
+        objects.push_back("<< /Length " + QByteArray::number(pageContent.size()) + " >>\nstream\n" + pageContent + "\nendstream");
+        objects.push_back("<< /Type /XObject /Subtype /Form /BBox [0 0 10 10] /Length " + QByteArray::number(formContent.size()) + " >>\nstream\n" + formContent + "\nendstream");
+
+        QByteArray data = "%PDF-1.7\n";
+        std::vector<int> offsets;
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            offsets.push_back(int(data.size()));
+            data.append(QByteArray::number(qulonglong(i + 1)) + " 0 obj\n" + objects[i] + "\nendobj\n");
+        }
+
+        const int xrefOffset = int(data.size());
+        data.append("xref\n0 " + QByteArray::number(qulonglong(objects.size() + 1)) + "\n0000000000 65535 f\r\n");
+        for (int offset : offsets)
+        {
+            data.append(QString("%1 00000 n\r\n").arg(offset, 10, 10, QChar('0')).toLatin1());
+        }
+        data.append("trailer\n<< /Size " + QByteArray::number(qulonglong(objects.size() + 1)) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n");
+
+        auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+        pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+        pdf::PDFDocument document = reader.readFromBuffer(data);
+        QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+
+        pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+        pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+        fontCache.setDocument(pdf::PDFModifiedDocument(&document, &optionalContentActivity));
+        const pdf::PDFPage* page = document.getCatalog()->getPage(0);
+
+        pdf::PDFCMSGeneric cms;
+        pdf::PDFRasterizer rasterizer(nullptr);
+        rasterizer.reset(pdf::RendererEngine::QPainter);
+
+        auto renderPage = [&](pdf::PDFPageContentProcessorStatistics* statistics, QList<pdf::PDFRenderError>& errors)
+        {
+            pdf::PDFRenderer renderer(&document, &fontCache, &cms, &optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
+            renderer.setStatistics(statistics);
+            pdf::PDFPrecompiledPage compiledPage;
+            renderer.compile(&compiledPage, 0);
+            errors = compiledPage.getErrors();
+            return rasterizer.render(0, page, &compiledPage, QSize(100, 100), pdf::PDFRenderer::getDefaultFeatures(), nullptr, pdf::PageRotation::None);
+        };
+
+        // Page content and form are parsed only once (forms are not instanced by the text layout generator)
+        pdf::PDFPageContentProcessorStatistics statistics;
+        pdf::PDFTextLayoutGenerator generator(pdf::PDFRenderer::getDefaultFeatures(), page, &document, &fontCache, &cms, &optionalContentActivity, QTransform(), pdf::PDFMeshQualitySettings());
+        generator.setStatistics(&statistics);
+        QList<pdf::PDFRenderError> errors = generator.processContents();
+        QCOMPARE(statistics.contentStreamCacheMisses, qint64(2));
+        QCOMPARE(statistics.contentStreamCacheHits, qint64(formCount - 1));
+        QCOMPARE(errors.size(), qsizetype(1));
+        QVERIFY(cache->getCacheSize() > cacheSize);
+
+        // Rendering replays cached programs
+        pdf::PDFPageContentProcessorStatistics cachedStatistics;
+        QList<pdf::PDFRenderError> cachedErrors;
+        const QImage cachedImage = renderPage(&cachedStatistics, cachedErrors);
+        QCOMPARE(cachedStatistics.contentStreamCacheMisses, qint64(0));
+        QVERIFY(cachedStatistics.contentStreamCacheHits >= 2);
+        QCOMPARE(cachedErrors.size(), qsizetype(1));
+        QCOMPARE(cachedErrors.front().message, errors.front().message);
+
+        // Result must be the same as if content streams were parsed
+        const qint64 cacheLimit = cache->getCacheLimit();
+        cache->setCacheLimit(0);
+        pdf::PDFPageContentProcessorStatistics uncachedStatistics;
+        QList<pdf::PDFRenderError> uncachedErrors;
+        const QImage image = renderPage(&uncachedStatistics, uncachedErrors);
+        cache->setCacheLimit(cacheLimit);
+        QCOMPARE(uncachedStatistics.contentStreamCacheHits, qint64(0));
+        QCOMPARE(uncachedErrors.size(), qsizetype(1));
+        QCOMPARE(cachedImage, image);
+
+        // Form and its inline image are painted (ninth form is at (80, 0) in page space)
+        const QRgb formPixel = image.pixel(86, 93);
+        QVERIFY(qRed(formPixel) > 0xC0 && qGreen(formPixel) < 0x40 && qBlue(formPixel) < 0x40);
+        QVERIFY(qGray(image.pixel(81, 98)) < qGray(image.pixel(83, 98)));
+        QCOMPARE(qGray(image.pixel(50, 20)), 0xFF);
+    }
+
+    // Programs are removed from the cache, when document is destroyed
+    QCOMPARE(cache->getCacheSize(), cacheSize);
+}
+
+void LexicalAnalyzerTest::test_parallel_form_compilation()
+{
+    constexpr int formCount = 8;
+
+    // Each form is painted twice in the initial graphic state, first
+    // form is painted again with different fill color (incompatible state).
+    QByteArray pageContent;
+    QByteArray xobjects;
+    for (int i = 0; i < formCount; ++i)
+    {
+        pageContent.append("q 1 0 0 1 " + QByteArray::number(i * 10) + " 0 cm /Fm" + QByteArray::number(i) + " Do Q ");
+        pageContent.append("q 1 0 0 1 " + QByteArray::number(i * 10) + " 20 cm /Fm" + QByteArray::number(i) + " Do Q ");
+        xobjects.append("/Fm" + QByteArray::number(i) + " " + QByteArray::number(5 + i) + " 0 R ");
+    }
+    pageContent.append("0 1 0 rg q 1 0 0 1 0 40 cm /Fm0 Do Q");
+
+    std::vector<QByteArray> objects;
+    objects.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+    objects.push_back("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+    objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Resources << /XObject << " + xobjects + ">> >> /Contents 4 0 R >>");
+    objects.push_back("<< /Length " + QByteArray::number(pageContent.size()) + " >>\nstream\n" + pageContent + "\nendstream");
+    for (int i = 0; i < formCount; ++i)
+    {
+        const QByteArray formContent = QByteArray(i % 2 == 0 ? "1 0 0 rg" : "0 0 1 rg") + " 0 0 8 8 re f";
+        objects.push_back("<< /Type /XObject /Subtype /Form /BBox [0 0 10 10] /Length " + QByteArray::number(formContent.size()) + " >>\nstream\n" + formContent + "\nendstream");
+    }
+
+    QByteArray data = "%PDF-1.7\n";
+    std::vector<int> offsets;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        offsets.push_back(int(data.size()));
+        data.append(QByteArray::number(qulonglong(i + 1)) + " 0 obj\n" + objects[i] + "\nendobj\n");
+    }
+
+    const int xrefOffset = int(data.size());
+    data.append("xref\n0 " + QByteArray::number(qulonglong(objects.size() + 1)) + "\n0000000000 65535 f\r\n");
+    for (int offset : offsets)
+    {
+        data.append(QString("%1 00000 n\r\n").arg(offset, 10, 10, QChar('0')).toLatin1());
+    }
+    data.append("trailer\n<< /Size " + QByteArray::number(qulonglong(objects.size() + 1)) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n");
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument document = reader.readFromBuffer(data);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+
+    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    fontCache.setDocument(pdf::PDFModifiedDocument(&document, &optionalContentActivity));
+    const pdf::PDFPage* page = document.getCatalog()->getPage(0);
+
+    pdf::PDFCMSGeneric cms;
+    pdf::PDFRasterizer rasterizer(nullptr);
+    rasterizer.reset(pdf::RendererEngine::QPainter);
+
+    auto renderPage = [&](pdf::PDFExecutionPolicy::Strategy strategy, pdf::PDFPageContentProcessorStatistics* statistics, QList<pdf::PDFRenderError>& errors)
+    {
+        pdf::PDFExecutionPolicy::setStrategy(strategy);
+        pdf::PDFRenderer renderer(&document, &fontCache, &cms, &optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(), pdf::PDFMeshQualitySettings());
+        renderer.setStatistics(statistics);
+        pdf::PDFPrecompiledPage compiledPage;
+        renderer.compile(&compiledPage, 0);
+        pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+        errors = compiledPage.getErrors();
+        return rasterizer.render(0, page, &compiledPage, QSize(100, 100), pdf::PDFRenderer::getDefaultFeatures(), nullptr, pdf::PageRotation::None);
+    };
+
+    pdf::PDFPageContentProcessorStatistics sequentialStatistics;
+    QList<pdf::PDFRenderError> sequentialErrors;
+    const QImage sequentialImage = renderPage(pdf::PDFExecutionPolicy::Strategy::SingleThreaded, &sequentialStatistics, sequentialErrors);
+
+    pdf::PDFPageContentProcessorStatistics parallelStatistics;
+    QList<pdf::PDFRenderError> parallelErrors;
+    const QImage parallelImage = renderPage(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded, &parallelStatistics, parallelErrors);
+
+    QVERIFY(sequentialErrors.isEmpty());
+    QVERIFY(parallelErrors.isEmpty());
+    QCOMPARE(parallelImage, sequentialImage);
+
+    // Sequentially, page and each form are processed, other paintings are form instances
+    // except the painting in incompatible state. In parallel, page is scanned for forms
+    // and forms are compiled, then only the page and the form painted in incompatible
+    // state are processed.
+    auto getLookupCount = [](const pdf::PDFPageContentProcessorStatistics& statistics) { return statistics.contentStreamCacheHits + statistics.contentStreamCacheMisses; };
+    QCOMPARE(getLookupCount(sequentialStatistics), qint64(1 + formCount + 1));
+    QCOMPARE(getLookupCount(parallelStatistics), qint64(2 + formCount + 1));
+
+    // Second painting of the second form is at (10, 20) in page space
+    const QRgb formPixel = parallelImage.pixel(14, 75);
+    QVERIFY(qBlue(formPixel) > 0xC0 && qRed(formPixel) < 0x40 && qGreen(formPixel) < 0x40);
+    QCOMPARE(qGray(parallelImage.pixel(50, 20)), 0xFF);
+}
+
+void LexicalAnalyzerTest::test_path_builder()
+{
+    pdf::PDFPathBuilder builder;
+    QPainterPath path;
+
+    auto check = [&](Qt::FillRule fillRule)
+    {
+        QCOMPARE(builder.isEmpty(), path.isEmpty());
+        QCOMPARE(builder.hasCurrentPoint(), path.elementCount() > 0);
+        if (builder.hasCurrentPoint())
+        {
+            QCOMPARE(builder.getCurrentPoint(), path.currentPosition());
+        }
+
+        path.setFillRule(fillRule);
+        QCOMPARE(builder.toPainterPath(fillRule), path);
+    };
+
+    check(Qt::WindingFill);
+
+    // Path containing only move to command is empty, closing of empty path does nothing
+    builder.moveTo(QPointF(5, 5));
+    path.moveTo(QPointF(5, 5));
+    builder.closeSubpath();
+    path.closeSubpath();
+    check(Qt::WindingFill);
+
+    builder.lineTo(QPointF(10, 5));
+    path.lineTo(QPointF(10, 5));
+    builder.cubicTo(QPointF(12, 6), QPointF(12, 8), QPointF(10, 10));
+    path.cubicTo(QPointF(12, 6), QPointF(12, 8), QPointF(10, 10));
+    check(Qt::WindingFill);
+
+    // Closing returns to the start of the subpath, next subpath starts there
+    builder.closeSubpath();
+    path.closeSubpath();
+    check(Qt::OddEvenFill);
+    builder.lineTo(QPointF(0, 20));
+    path.lineTo(QPointF(0, 20));
+    check(Qt::OddEvenFill);
+
+    builder.addRect(QRectF(20, 20, 10, 5));
+    path.addRect(QRectF(20, 20, 10, 5));
+    check(Qt::WindingFill);
+    builder.lineTo(QPointF(40, 40));
+    path.lineTo(QPointF(40, 40));
+    check(Qt::WindingFill);
+
+    // Memory of the builder is reused after clearing, path starts in the origin
+    builder.clear();
+    path = QPainterPath();
+    check(Qt::WindingFill);
+    builder.lineTo(QPointF(1, 2));
+    path.lineTo(QPointF(1, 2));
+    builder.closeSubpath();
+    path.closeSubpath();
+    check(Qt::WindingFill);
+}
+
+void LexicalAnalyzerTest::test_precompiled_page_compact_storage()
+{
+    QCOMPARE(sizeof(pdf::PDFPrecompiledPage::Instruction), size_t(8));
+
+    constexpr int pathCount = 1000;
+    auto createPage = [](bool distinctColors)
+    {
+        pdf::PDFPrecompiledPage page;
+        for (int i = 0; i < pathCount; ++i)
+        {
+            QPainterPath path;
+            path.addRect(QRectF(i % 100, i / 100, 1, 1));
+
+            // Pens and brushes are always created, so they don't share data
+            const QColor color = distinctColors ? QColor::fromRgb(i % 256, i / 256, 0) : QColor(Qt::black);
+            page.addPath(QPen(color), QBrush(color), qMove(path), false);
+        }
+
+        page.optimize();
+        page.finalize(0, QList<pdf::PDFRenderError>());
+        return page;
+    };
+
+    const pdf::PDFPrecompiledPage sharedPage = createPage(false);
+    const pdf::PDFPrecompiledPage distinctPage = createPage(true);
+    QVERIFY(sharedPage.getMemoryConsumptionEstimate() + qint64(pathCount) * 64 < distinctPage.getMemoryConsumptionEstimate());
+
+    const pdf::PDFPrecompiledPage deserializedPage = pdf::PDFPrecompiledPage::deserialize(sharedPage.serialize());
+    QCOMPARE(deserializedPage.getInstructionCount(), size_t(pathCount));
+}
+
+void LexicalAnalyzerTest::test_named_destination_lookup()
+{
+    std::vector<QByteArray> objects;
+    objects.push_back("<< /Type /Catalog /Pages 2 0 R /Names << /Dests 4 0 R >> /Dests << /B [3 0 R /Fit] >> >>");
+    objects.push_back("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+    objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] >>");
+    objects.push_back("<< /Kids [5 0 R 6 0 R] >>");
+    objects.push_back("<< /Limits [(A) (C)] /Names [(A) [3 0 R /XYZ 0 0 0] (B) [3 0 R /FitH 10] (C) << /D [3 0 R /FitV 10] >>] >>");
+    objects.push_back("<< /Limits [(D) (F)] /Names [(D) [3 0 R /FitB] (F) [3 0 R /FitR 0 0 10 10]] >>");
+
+    QByteArray data = "%PDF-1.7\n";
+    std::vector<int> offsets;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        offsets.push_back(int(data.size()));
+        data.append(QByteArray::number(qulonglong(i + 1)) + " 0 obj\n" + objects[i] + "\nendobj\n");
+    }
+
+    const int xrefOffset = int(data.size());
+    data.append("xref\n0 " + QByteArray::number(qulonglong(objects.size() + 1)) + "\n0000000000 65535 f\r\n");
+    for (int offset : offsets)
+    {
+        data.append(QString("%1 00000 n\r\n").arg(offset, 10, 10, QChar('0')).toLatin1());
+    }
+    data.append("trailer\n<< /Size " + QByteArray::number(qulonglong(objects.size() + 1)) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n");
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument document = reader.readFromBuffer(data);
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+
+    const pdf::PDFCatalog* catalog = document.getCatalog();
+    const pdf::PDFObjectStorage* storage = &document.getStorage();
+    const pdf::PDFObjectReference pageReference = catalog->getPage(0)->getPageReference();
+
+    auto checkDestination = [&](const QByteArray& key, pdf::DestinationType type)
+    {
+        std::optional<pdf::PDFDestination> destination = catalog->getNamedDestination(key, storage);
+        QVERIFY(destination.has_value());
+        QCOMPARE(destination->getDestinationType(), type);
+        QCOMPARE(destination->getPageReference(), pageReference);
+    };
+
+    checkDestination("A", pdf::DestinationType::XYZ);
+    checkDestination("B", pdf::DestinationType::Fit);
+    checkDestination("C", pdf::DestinationType::FitV);
+    checkDestination("D", pdf::DestinationType::FitB);
+    checkDestination("F", pdf::DestinationType::FitR);
+    QVERIFY(!catalog->getNamedDestination("E", storage).has_value());
+    QVERIFY(!catalog->getNamedDestination("Z", storage).has_value());
+
+    std::map<QByteArray, pdf::PDFDestination> namedDestinations = catalog->getNamedDestinations(storage);
+    QCOMPARE(namedDestinations.size(), size_t(5));
+    QCOMPARE(namedDestinations.at("B").getDestinationType(), pdf::DestinationType::Fit);
+}
+
+void LexicalAnalyzerTest::test_streaming_document_builder()
+{
+    QBuffer buffer;
+    buffer.open(QBuffer::WriteOnly);
+
+    pdf::PDFStreamingDocumentWriter writer(&buffer, pdf::PDFVersion(1, 7));
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.setDocumentTitle("Streaming");
+    builder.beginStreaming(&writer);
+    QVERIFY(builder.isStreaming());
+
+    for (int i = 0; i < 100; ++i)
+    {
+        pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 100 + i, 100));
+        builder.flushPage(page);
+        QVERIFY(builder.getObjectByReference(page).isNull());
+    }
+
+    pdf::PDFOperationResult result = builder.finishStreaming();
+    QVERIFY2(result, qPrintable(result.getErrorMessage()));
+    QVERIFY(!builder.isStreaming());
+    buffer.close();
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+    pdf::PDFDocument readDocument = reader.readFromBuffer(buffer.data());
+    QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QCOMPARE(readDocument.getInfo()->title, QString("Streaming"));
+    QCOMPARE(readDocument.getCatalog()->getPageCount(), size_t(100));
+    QCOMPARE(readDocument.getCatalog()->getPage(99)->getMediaBox().width(), 199.0);
+}
+
+void LexicalAnalyzerTest::test_execute_ordered()
+{
+    constexpr size_t count = 1000;
+    constexpr size_t maxPendingResults = 8;
+
+    std::atomic<size_t> producedCount = 0;
+    std::atomic<size_t> maxAheadCount = 0;
+    std::vector<size_t> consumed;
+
+    auto produce = [&](size_t index)
+    {
+        ++producedCount;
+        return std::vector<size_t>(index % 17 + 1, index);
+    };
+    auto consume = [&](size_t index, std::vector<size_t> result)
+    {
+        QCOMPARE(result.size(), index % 17 + 1);
+        consumed.push_back(result.front());
+
+        const size_t aheadCount = producedCount - consumed.size();
+        maxAheadCount = qMax(maxAheadCount.load(), aheadCount);
+    };
+
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded);
+    pdf::PDFExecutionPolicy::executeOrdered(pdf::PDFExecutionPolicy::Scope::Page, count, maxPendingResults, produce, consume);
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+
+    std::vector<size_t> expected(count, 0);
+    std::iota(expected.begin(), expected.end(), 0);
+    QVERIFY(consumed == expected);
+    QVERIFY(maxAheadCount <= maxPendingResults);
+}
+
+void LexicalAnalyzerTest::test_bitonal_conversion()
+{
+    // Width is not multiple of 8, and runs are longer than 2560 pixels
+    constexpr int width = 2701;
+    constexpr int height = 61;
+
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> distribution(0, 255);
+
+    QImage image(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            QRgb pixel = qRgb(distribution(generator), distribution(generator), distribution(generator));
+            if (y % 10 == 0 || (x > 100 && x < 2690 && y % 10 == 5))
+            {
+                pixel = (y % 20 == 0) ? qRgb(255, 255, 255) : qRgb(0, 0, 0);
+            }
+            image.setPixel(x, y, pixel);
+        }
+    }
+
+    pdf::PDFBitonalDocumentConvertor::Settings settings;
+    settings.conversionMethod = pdf::PDFImageConversion::ConversionMethod::Manual;
+    settings.threshold = 100;
+    const QImage bitonalImage = pdf::PDFBitonalDocumentConvertor::convertImage(image, settings);
+    QCOMPARE(bitonalImage.format(), QImage::Format_Mono);
+
+    // Thresholding must be the same as thresholding of the lightness
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const bool isWhite = image.pixelColor(x, y).lightness() >= settings.threshold;
+            QCOMPARE(bitonalImage.pixelIndex(x, y), isWhite ? 1 : 0);
+        }
+    }
+
+    for (pdf::PDFBitonalDocumentConvertor::Compression compression : { pdf::PDFBitonalDocumentConvertor::Compression::Flate, pdf::PDFBitonalDocumentConvertor::Compression::CCITTGroup4 })
+    {
+        pdf::PDFObject imageObject = pdf::PDFBitonalDocumentConvertor::createImageObject(bitonalImage, compression);
+        QVERIFY(imageObject.isStream());
+
+        pdf::PDFDocument document;
+        pdf::PDFRenderErrorReporterDummy errorReporter;
+        pdf::PDFColorSpacePointer colorSpace = pdf::PDFAbstractColorSpace::createDeviceColorSpaceByName(nullptr, &document, pdf::COLOR_SPACE_NAME_DEVICE_GRAY);
+        pdf::PDFImage pdfImage = pdf::PDFImage::createImage(&document, imageObject.getStream(), qMove(colorSpace), false, pdf::RenderingIntent::Perceptual, &errorReporter);
+
+        pdf::PDFCMSGeneric cms;
+        const QImage decodedImage = pdfImage.getImage(&cms, &errorReporter, nullptr);
+        QCOMPARE(decodedImage.size(), bitonalImage.size());
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                QCOMPARE(qGray(decodedImage.pixel(x, y)) >= 128, bitonalImage.pixelIndex(x, y) == 1);
+            }
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_javascript_presence()
+{
+    auto readDocument = [](const std::vector<QByteArray>& objects)
+    {
+        QByteArray data = "%PDF-1.7\n";
+        std::vector<int> offsets;
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            offsets.push_back(int(data.size()));
+            data.append(QByteArray::number(qulonglong(i + 1)) + " 0 obj\n" + objects[i] + "\nendobj\n");
+        }
+
+        const int xrefOffset = int(data.size());
+        data.append("xref\n0 " + QByteArray::number(qulonglong(objects.size() + 1)) + "\n0000000000 65535 f\r\n");
+        for (int offset : offsets)
+        {
+            data.append(QString("%1 00000 n\r\n").arg(offset, 10, 10, QChar('0')).toLatin1());
+        }
+        data.append("trailer\n<< /Size " + QByteArray::number(qulonglong(objects.size() + 1)) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n");
+
+        auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+        pdf::PDFDocumentReader reader(nullptr, getPassword, false, false);
+        return reader.readFromBuffer(data);
+    };
+
+    auto check = [&](const std::vector<QByteArray>& objects, bool expected)
+    {
+        pdf::PDFDocument document = readDocument(objects);
+        pdf::PDFJavaScriptScanner scanner(&document);
+        QCOMPARE(scanner.hasJavaScript(), expected);
+        QCOMPARE(!scanner.scan({ }, pdf::PDFJavaScriptScanner::AllPages | pdf::PDFJavaScriptScanner::ScanMask).empty(), expected);
+    };
+
+    const QByteArray catalog = "<< /Type /Catalog /Pages 2 0 R >>";
+    const QByteArray pages = "<< /Type /Pages /Kids [3 0 R] /Count 1 >>";
+    const QByteArray page = "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Annots [4 0 R] >>";
+
+    // Link without java script, actions form a cycle
+    check({ catalog, pages, page,
+            "<< /Type /Annot /Subtype /Link /Rect [0 0 10 10] /A 5 0 R >>",
+            "<< /S /URI /URI (https://example.com) /Next [6 0 R] >>",
+            "<< /S /GoTo /D [3 0 R /Fit] /Next 5 0 R >>" }, false);
+
+    // Java script in the next action of the link
+    check({ catalog, pages, page,
+            "<< /Type /Annot /Subtype /Link /Rect [0 0 10 10] /A 5 0 R >>",
+            "<< /S /URI /URI (https://example.com) /Next [6 0 R] >>",
+            "<< /S /JavaScript /JS (app.alert(1);) >>" }, true);
+
+    // Java script in the additional actions of the form field
+    check({ "<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [5 0 R] >> >>", pages, page,
+            "<< /Type /Annot /Subtype /Square /Rect [0 0 10 10] >>",
+            "<< /FT /Tx /T (Parent) /Kids [6 0 R] >>",
+            "<< /Parent 5 0 R /T (Child) /AA << /K << /S /JavaScript /JS (event.rc = true;) >> >> >>" }, true);
+}
+
+void LexicalAnalyzerTest::test_post_raster_color_adjustment()
+{
+    // Width is not multiple of 4, so SIMD and scalar paths are both used
+    constexpr int width = 37;
+    constexpr int height = 5;
+
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> distribution(0, 255);
+
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const int alpha = (y == 0) ? 255 : distribution(generator);
+            image.setPixel(x, y, qPremultiply(qRgba(distribution(generator), distribution(generator), distribution(generator), alpha)));
+        }
+    }
+
+    for (pdf::PDFColorConvertor::Mode mode : { pdf::PDFColorConvertor::Mode::InvertedColors, pdf::PDFColorConvertor::Mode::Grayscale })
+    {
+        pdf::PDFColorConvertor colorConvertor;
+        colorConvertor.setMode(mode);
+        QVERIFY(colorConvertor.isRasterConversionEquivalent());
+
+        QImage convertedImage = image;
+        colorConvertor.convertRasterImage(convertedImage);
+        QCOMPARE(convertedImage.format(), QImage::Format_ARGB32_Premultiplied);
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const QRgb pixel = image.pixel(x, y);
+                const QRgb convertedPixel = reinterpret_cast<const QRgb*>(convertedImage.constScanLine(y))[x];
+                QCOMPARE(qAlpha(convertedPixel), qAlpha(pixel));
+
+                if (y == 0)
+                {
+                    // Opaque pixels must be converted as colors of page contents (color
+                    // convertor works in floating point, so rounding can differ)
+                    const QRgb expectedPixel = colorConvertor.convert(QColor::fromRgb(pixel), false, false).rgba();
+                    QVERIFY(qAbs(qRed(convertedPixel) - qRed(expectedPixel)) <= 1);
+                    QVERIFY(qAbs(qGreen(convertedPixel) - qGreen(expectedPixel)) <= 1);
+                    QVERIFY(qAbs(qBlue(convertedPixel) - qBlue(expectedPixel)) <= 1);
+                }
+                else
+                {
+                    const QRgb sourcePixel = reinterpret_cast<const QRgb*>(image.constScanLine(y))[x];
+                    const int alpha = qAlpha(sourcePixel);
+                    if (mode == pdf::PDFColorConvertor::Mode::InvertedColors)
+                    {
+                        QCOMPARE(qRed(convertedPixel), alpha - qRed(sourcePixel));
+                        QCOMPARE(qGreen(convertedPixel), alpha - qGreen(sourcePixel));
+                        QCOMPARE(qBlue(convertedPixel), alpha - qBlue(sourcePixel));
+                    }
+                    else
+                    {
+                        const int gray = qGray(sourcePixel);
+                        QVERIFY(gray <= alpha);
+                        QCOMPARE(convertedPixel, qRgba(gray, gray, gray, alpha));
+                    }
+                }
+            }
+        }
+    }
+
+    pdf::PDFRenderer::Features features = pdf::PDFRenderer::getDefaultFeatures() | pdf::PDFRenderer::ColorAdjust_Invert;
+    QVERIFY(!pdf::PDFRenderer::isPostRasterColorAdjustment(features));
+    QCOMPARE(pdf::PDFRenderer::getCompileFeatures(features), features);
+
+    features |= pdf::PDFRenderer::ColorAdjust_PostRaster;
+    QVERIFY(pdf::PDFRenderer::isPostRasterColorAdjustment(features));
+    QCOMPARE(pdf::PDFRenderer::getCompileFeatures(features), pdf::PDFRenderer::getDefaultFeatures() | pdf::PDFRenderer::ColorAdjust_PostRaster);
+
+    // High contrast depends on lightness, it can't be applied to the rasterized page
+    features = pdf::PDFRenderer::getDefaultFeatures() | pdf::PDFRenderer::ColorAdjust_HighContrast | pdf::PDFRenderer::ColorAdjust_PostRaster;
+    QVERIFY(!pdf::PDFRenderer::isPostRasterColorAdjustment(features));
+    QCOMPARE(pdf::PDFRenderer::getCompileFeatures(features), features);
+}
+
+void LexicalAnalyzerTest::test_render_tile_pyramid()
+{
+    pdf::PDFPrecompiledPage compiledPage;
+    QPainterPath path;
+    path.addRect(0, 0, 50, 100);
+    compiledPage.addPath(Qt::NoPen, QBrush(Qt::black), path, false);
+    compiledPage.finalize(0, { });
+
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 100, 100));
+    pdf::PDFDocument document = builder.build();
+    const pdf::PDFPage* page = document.getCatalog()->getPage(0);
+
+    // Levels as in the Deep Zoom image format
+    const QSize size(300, 200);
+    QCOMPARE(pdf::PDFRasterizer::getTilePyramidLevelCount(size), 10);
+    QCOMPARE(pdf::PDFRasterizer::getTilePyramidLevelCount(QSize(256, 256)), 9);
+    QCOMPARE(pdf::PDFRasterizer::getTilePyramidLevelSize(size, 9), size);
+    QCOMPARE(pdf::PDFRasterizer::getTilePyramidLevelSize(size, 8), QSize(150, 100));
+    QCOMPARE(pdf::PDFRasterizer::getTilePyramidLevelSize(size, 7), QSize(75, 50));
+    QCOMPARE(pdf::PDFRasterizer::getTilePyramidLevelSize(size, 6), QSize(38, 25));
+    QCOMPARE(pdf::PDFRasterizer::getTilePyramidLevelSize(size, 0), QSize(1, 1));
+
+    pdf::PDFRasterizer rasterizer(nullptr);
+    rasterizer.reset(pdf::RendererEngine::QPainter);
+
+    constexpr int tileSize = 64;
+    QMutex mutex;
+    std::map<int, QImage> levelImages;
+    int tileCount = 0;
+    auto processTile = [&](const pdf::PDFRasterizer::Tile& tile)
+    {
+        QMutexLocker lock(&mutex);
+        QImage& levelImage = levelImages[tile.level];
+        if (levelImage.isNull())
+        {
+            levelImage = QImage(pdf::PDFRasterizer::getTilePyramidLevelSize(size, tile.level), QImage::Format_ARGB32_Premultiplied);
+            levelImage.fill(Qt::red);
+        }
+
+        for (int y = 0; y < tile.image.height(); ++y)
+        {
+            for (int x = 0; x < tile.image.width(); ++x)
+            {
+                levelImage.setPixel(tile.column * tileSize + x, tile.row * tileSize + y, tile.image.pixel(x, y));
+            }
+        }
+
+        ++tileCount;
+        return true;
+    };
+
+    QVERIFY(rasterizer.renderTilePyramid(0, page, &compiledPage, size, pdf::PDFRenderer::None, nullptr, pdf::PageRotation::None, tileSize, processTile));
+
+    // Level 9 has 5x4 tiles, level 8 3x2 tiles, level 7 2x1 tiles, other levels single tile
+    QCOMPARE(int(levelImages.size()), 10);
+    QCOMPARE(tileCount, 20 + 6 + 2 + 7);
+
+    // Tiles of each level are same as the page rendered in the size of the level
+    for (int level : { 9, 8, 7 })
+    {
+        const QSize levelSize = pdf::PDFRasterizer::getTilePyramidLevelSize(size, level);
+        const QImage image = rasterizer.render(0, page, &compiledPage, levelSize, pdf::PDFRenderer::None, nullptr, pdf::PageRotation::None);
+        QCOMPARE(levelImages[level], image.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+    }
+
+    // Rendering is stopped, if tile can't be processed
+    QVERIFY(!rasterizer.renderTilePyramid(0, page, &compiledPage, size, pdf::PDFRenderer::None, nullptr, pdf::PageRotation::None, tileSize, [](const pdf::PDFRasterizer::Tile&) { return false; }));
+}
+
+void LexicalAnalyzerTest::test_rasterizer_pool_sizes()
+{
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    builder.appendPage(QRectF(0, 0, 100, 200));
+    builder.appendPage(QRectF(0, 0, 200, 100));
+    pdf::PDFDocument document = builder.build();
+
+    pdf::PDFOptionalContentActivity optionalContentActivity(&document, pdf::OCUsage::Export, nullptr);
+    pdf::PDFFontCache fontCache(pdf::DEFAULT_FONT_CACHE_LIMIT, pdf::DEFAULT_REALIZED_FONT_CACHE_LIMIT);
+    fontCache.setDocument(pdf::PDFModifiedDocument(&document, &optionalContentActivity));
+    pdf::PDFCMSManager cmsManager(nullptr);
+    cmsManager.setDocument(&document);
+    pdf::PDFMeshQualitySettings meshQualitySettings;
+
+    pdf::PDFRasterizerPool rasterizerPool(&document, &fontCache, &cmsManager, &optionalContentActivity, pdf::PDFRenderer::getDefaultFeatures(),
+                                          meshQualitySettings, 2, pdf::RendererEngine::QPainter, nullptr);
+    rasterizerPool.setStatisticsEnabled(true);
+
+    auto imageSizesGetter = [](const pdf::PDFPage* page)
+    {
+        std::vector<QSize> sizes;
+        for (int pixelResolution : { 16, 128, 64 })
+        {
+            sizes.push_back(page->getRotatedMediaBox().size().scaled(pixelResolution, pixelResolution, Qt::KeepAspectRatio).toSize());
+        }
+        return sizes;
+    };
+
+    QMutex mutex;
+    std::map<std::pair<pdf::PDFInteger, int>, QSize> imageSizes;
+    std::map<pdf::PDFInteger, int> statisticsCount;
+    auto processImage = [&](pdf::PDFRenderedPageImage& renderedPageImage)
+    {
+        QMutexLocker lock(&mutex);
+        imageSizes[std::make_pair(renderedPageImage.pageIndex, renderedPageImage.sizeIndex)] = renderedPageImage.pageImage.size();
+        statisticsCount[renderedPageImage.pageIndex] += renderedPageImage.statistics ? 1 : 0;
+    };
+    rasterizerPool.renderSizes({ 0, 1 }, imageSizesGetter, processImage, nullptr);
+
+    QCOMPARE(int(imageSizes.size()), 6);
+    QCOMPARE(imageSizes[std::make_pair(pdf::PDFInteger(0), 0)], QSize(8, 16));
+    QCOMPARE(imageSizes[std::make_pair(pdf::PDFInteger(0), 1)], QSize(64, 128));
+    QCOMPARE(imageSizes[std::make_pair(pdf::PDFInteger(0), 2)], QSize(32, 64));
+    QCOMPARE(imageSizes[std::make_pair(pdf::PDFInteger(1), 1)], QSize(128, 64));
+
+    // Each page is compiled only once, statistics are reported with the first image
+    QCOMPARE(statisticsCount[0], 1);
+    QCOMPARE(statisticsCount[1], 1);
+}
+
+void LexicalAnalyzerTest::test_form_filler()
+{
+    // Record readers
+    pdf::PDFFormFillerRecords records;
+    QVERIFY(static_cast<bool>(pdf::PDFFormFiller::readCsv("name,note\r\nAlice,\"Hello, \"\"world\"\"\"\n\nBob,\"two\nlines\"\n", records)));
+    QCOMPARE(records.size(), size_t(2));
+    QCOMPARE(records[0].at("name"), QString("Alice"));
+    QCOMPARE(records[0].at("note"), QString("Hello, \"world\""));
+    QCOMPARE(records[1].at("note"), QString("two\nlines"));
+    QVERIFY(!pdf::PDFFormFiller::readCsv("name,note\nAlice\n", records));
+
+    records.clear();
+    QVERIFY(static_cast<bool>(pdf::PDFFormFiller::readJson("[{\"name\":\"Alice\",\"age\":30,\"agree\":true}]", records)));
+    QCOMPARE(records.size(), size_t(1));
+    QCOMPARE(records[0].at("age"), QString("30"));
+    QCOMPARE(records[0].at("agree"), QString("true"));
+
+    records.clear();
+    QVERIFY(static_cast<bool>(pdf::PDFFormFiller::readFdf("%FDF-1.2\n1 0 obj\n<< /FDF << /Fields [ << /T (person) /Kids [ << /T (name) /V (Alice) >> ] >> << /T (agree) /V /Yes >> ] >> >>\nendobj\ntrailer\n<< /Root 1 0 R >>\n%%EOF\n", records)));
+    QCOMPARE(records.size(), size_t(1));
+    QCOMPARE(records[0].at("person.name"), QString("Alice"));
+    QCOMPARE(records[0].at("agree"), QString("Yes"));
+
+    // Filling of the form
+    pdf::PDFDocumentBuilder builder;
+    builder.createDocument();
+    pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 200, 200));
+
+    pdf::PDFObjectFactory factory;
+    factory.beginDictionary();
+    factory.beginDictionaryItem("FT");
+    factory << pdf::WrapName("Tx");
+    factory.endDictionaryItem();
+    factory.beginDictionaryItem("T");
+    factory << QString("name");
+    factory.endDictionaryItem();
+    factory.endDictionary();
+    pdf::PDFObjectReference field = builder.addObject(factory.takeObject());
+    builder.createInvisibleFormFieldWidget(field, page);
+    builder.createAcroForm({ field });
+    pdf::PDFDocument document = builder.build();
+
+    auto getValue = [field](const pdf::PDFDocument& filledDocument)
+    {
+        pdf::PDFDocumentDataLoaderDecorator loader(&filledDocument);
+        const pdf::PDFDictionary* dictionary = filledDocument.getDictionaryFromObject(filledDocument.getObjectByReference(field));
+        return dictionary ? loader.readTextString(dictionary->get("V"), QString()) : QString();
+    };
+
+    pdf::PDFFormFiller filler(&document);
+    QCOMPARE(getValue(filler.fill({ { "name", "Alice" } })), QString("Alice"));
+    QCOMPARE(getValue(filler.fill({ { "name", "Bob" } })), QString("Bob"));
+    QCOMPARE(getValue(document), QString());
+
+    bool isExceptionThrown = false;
+    try
+    {
+        filler.fill({ { "unknown", "Alice" } });
+    }
+    catch (const pdf::PDFException&)
+    {
+        isExceptionThrown = true;
+    }
+    QVERIFY(isExceptionThrown);
+}
+
+void LexicalAnalyzerTest::test_lazy_loading_damaged_xref()
+{
+    std::vector<QByteArray> objects;
+    objects.push_back("<< /Type /Catalog /Pages 2 0 R >>");
+    objects.push_back("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+    objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] /Contents 4 0 R >>");
+    objects.push_back("<< /Length 10 >>\nstream\n0 0 1 1 re\nendstream");
+
+    QByteArray data = "%PDF-1.7\n";
+    std::vector<int> offsets;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        offsets.push_back(int(data.size()));
+        data.append(QByteArray::number(qulonglong(i + 1)) + " 0 obj\n" + objects[i] + "\nendobj\n");
+    }
+
+    // Offset of the content stream points into the middle of the object
+    offsets.back() += 3;
+
+    const int xrefOffset = int(data.size());
+    data.append("xref\n0 " + QByteArray::number(qulonglong(objects.size() + 1)) + "\n0000000000 65535 f\r\n");
+    for (int offset : offsets)
+    {
+        data.append(QString("%1 00000 n\r\n").arg(offset, 10, 10, QChar('0')).toLatin1());
+    }
+    data.append("trailer\n<< /Size " + QByteArray::number(qulonglong(objects.size() + 1)) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n");
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+
+    // Damaged document is detected even if objects are loaded lazily, and it is restored
+    pdf::PDFDocumentReader permissiveReader(nullptr, getPassword, true, false);
+    permissiveReader.setLazyLoading(true);
+    pdf::PDFDocument document = permissiveReader.readFromBuffer(data);
+    QCOMPARE(permissiveReader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+    QCOMPARE(document.getCatalog()->getPageCount(), size_t(1));
+    QVERIFY(document.getObjectByReference(pdf::PDFObjectReference(4, 0)).isStream());
+
+    pdf::PDFDocumentReader strictReader(nullptr, getPassword, false, false);
+    strictReader.setLazyLoading(true);
+    strictReader.readFromBuffer(data);
+    QCOMPARE(strictReader.getReadingResult(), pdf::PDFDocumentReader::Result::Failed);
+}
+
+void LexicalAnalyzerTest::test_damaged_document_index()
+{
+    // Page tree is stored in object stream, page is updated incrementally
+    const QByteArray objectStreamData = "2 0 << /Type /Pages /Kids [3 0 R] /Count 1 >>";
+
+    QByteArray data = "%PDF-1.7\n";
+    data.append("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+    data.append("4 0 obj\n<< /Type /ObjStm /N 1 /First 4 /Length " + QByteArray::number(objectStreamData.size()) + " >>\nstream\n" + objectStreamData + "\nendstream\nendobj\n");
+    data.append("3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 100 100] >>\nendobj\n");
+    data.append("3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 200 200] >>\nendobj\n");
+    data.append("trailer\n<< /Size 5 /Root 1 0 R >>\nstartxref\n999999\n%%EOF\n");
+
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+
+    auto getPassword = [](bool* ok) { *ok = false; return QString(); };
+    auto readDocument = [&](bool lazyLoading)
+    {
+        pdf::PDFDocumentReader reader(nullptr, getPassword, true, false);
+        reader.setLazyLoading(lazyLoading);
+        reader.setIndexCacheDirectory(directory.path());
+        pdf::PDFDocument document = reader.readFromBuffer(data);
+        QCOMPARE(reader.getReadingResult(), pdf::PDFDocumentReader::Result::OK);
+        QCOMPARE(document.getCatalog()->getPageCount(), size_t(1));
+        QCOMPARE(document.getCatalog()->getPage(0)->getMediaBox().width(), 200.0);
+    };
+
+    // Document is restored by scan, then rebuilt reference table is used
+    readDocument(false);
+    QCOMPARE(QDir(directory.path()).entryList(QDir::Files).size(), qsizetype(1));
+    readDocument(false);
+    readDocument(true);
+}
+
+void LexicalAnalyzerTest::test_lzw_filter()
+{
+    // This example is from PDF 1.7 Reference
+    QByteArray byteArray = QByteArray::fromHex("800B6050220C0C8501");
+    pdf::PDFLzwDecodeFilter filter;
+    QByteArray decoded = filter.apply(byteArray, [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; }, pdf::PDFObject(), nullptr);
+    QByteArray valid = "-----A---B";
+
+    QCOMPARE(decoded, valid);
+}
+
+void LexicalAnalyzerTest::test_flate_compression_levels()
+{
+    QByteArray data;
+    for (int i = 0; i < 100000; ++i)
+    {
+        data.append(QByteArray::number(i % 997));
+        data.append(' ');
+    }
+
+    using CompressionLevel = pdf::PDFFlateDecodeFilter::CompressionLevel;
+    pdf::PDFFlateDecodeFilter filter;
+    for (CompressionLevel level : { CompressionLevel::Fast, CompressionLevel::Default, CompressionLevel::Maximum })
+    {
+        QByteArray compressed = pdf::PDFFlateDecodeFilter::compress(data, level);
+        QVERIFY(compressed.size() < data.size());
+
+        QByteArray decoded = filter.apply(compressed, [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; }, pdf::PDFObject(), nullptr);
+        QCOMPARE(decoded, data);
+    }
+
+    QCOMPARE(pdf::PDFFlateDecodeFilter::compress(QByteArray()).isEmpty(), false);
+}
+
+void LexicalAnalyzerTest::test_decoded_stream_cache()
+{
+    QByteArray data(100000, 'x');
+
+    auto createFlateStream = [](const QByteArray& streamData)
+    {
+        pdf::PDFDictionary dictionary;
+        dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Filter"), pdf::PDFObject::createName("FlateDecode"));
+        return pdf::PDFObject::createStream(std::make_shared<pdf::PDFStream>(qMove(dictionary), pdf::PDFFlateDecodeFilter::compress(streamData)));
+    };
+
+    pdf::PDFObjectStorage::PDFObjects objects;
+    objects.resize(2);
+    objects[1] = pdf::PDFObjectStorage::Entry(0, createFlateStream(data));
+    pdf::PDFObjectStorage storage(qMove(objects), pdf::PDFObject(), pdf::PDFSecurityHandlerPointer());
+
+    const pdf::PDFObjectReference reference(1, 0);
+    QCOMPARE(storage.getDecodedStream(storage.getObject(reference).getStream()), data);
+    QCOMPARE(storage.getDecodedStream(storage.getObject(reference).getStream()), data);
+
+    pdf::PDFDecodedStreamCache::Statistics statistics = storage.getDecodedStreamCacheStatistics();
+    QCOMPARE(statistics.missCount, qint64(1));
+    QCOMPARE(statistics.hitCount, qint64(1));
+    QCOMPARE(statistics.size, qint64(data.size()));
+
+    // Replaced stream must not be served from the cache
+    QByteArray otherData(1000, 'y');
+    storage.setObject(reference, createFlateStream(otherData));
+    QCOMPARE(storage.getDecodedStream(storage.getObject(reference).getStream()), otherData);
+
+    // Streams, which are not stored in the storage, are not cached
+    pdf::PDFObject temporaryStream = createFlateStream(data);
+    QCOMPARE(storage.getDecodedStream(temporaryStream.getStream()), data);
+    QCOMPARE(storage.getDecodedStreamCacheStatistics().itemCount, qint64(1));
+
+    // Copy of the storage starts with empty cache, streams are decoded on demand
+    pdf::PDFObjectStorage copiedStorage = storage;
+    QCOMPARE(copiedStorage.getDecodedStreamCacheStatistics().itemCount, qint64(0));
+    QCOMPARE(copiedStorage.getDecodedStream(copiedStorage.getObject(reference).getStream()), otherData);
+    QCOMPARE(copiedStorage.getDecodedStreamCacheStatistics().itemCount, qint64(1));
+
+    // Items exceeding the size limit are removed
+    storage.setDecodedStreamCacheSizeLimit(100);
+    QCOMPARE(storage.getDecodedStreamCacheStatistics().itemCount, qint64(0));
+}
+
+void LexicalAnalyzerTest::test_document_unique_id()
+{
+    pdf::PDFImageCache* cache = pdf::PDFImageCache::getInstance();
+
+    pdf::PDFDocument document;
+    pdf::PDFDocument copiedDocument = document;
+    QVERIFY(document.getUniqueId() != copiedDocument.getUniqueId());
+
+    pdf::PDFImageCache::Key key;
+    key.documentId = copiedDocument.getUniqueId();
+    key.stream = pdf::PDFObjectReference(1, 0);
+    cache->insertImage(key, pdf::PDFImage());
+
+    pdf::PDFImage image;
+    QVERIFY(cache->findImage(key, image));
+
+    // Assigned document gets new identifier, images of the old one are removed
+    copiedDocument = document;
+    QVERIFY(copiedDocument.getUniqueId() != key.documentId);
+    QVERIFY(copiedDocument.getUniqueId() != document.getUniqueId());
+    QVERIFY(!cache->findImage(key, image));
+}
+
+void LexicalAnalyzerTest::test_streaming_filter_chain()
+{
+    // Image rows encoded by PNG Up predictor, compressed by flate
+    // and encoded as hexadecimal string.
+    constexpr int columns = 300;
+    constexpr int rows = 500;
+    QByteArray image;
+    QByteArray predicted;
+    for (int row = 0; row < rows; ++row)
+    {
+        predicted.push_back(char(2));
+        for (int column = 0; column < columns; ++column)
+        {
+            const char value = char((row * 7 + column * 13) % 256);
+            const char above = row > 0 ? image[(row - 1) * columns + column] : char(0);
+            image.push_back(value);
+            predicted.push_back(char(value - above));
+        }
+    }
+    QByteArray encoded = pdf::PDFFlateDecodeFilter::compress(predicted).toHex() + ">";
+
+    pdf::PDFDictionary predictorParameters;
+    predictorParameters.addEntry(pdf::PDFInplaceOrMemoryString("Predictor"), pdf::PDFObject::createInteger(12));
+    predictorParameters.addEntry(pdf::PDFInplaceOrMemoryString("Columns"), pdf::PDFObject::createInteger(columns));
+
+    pdf::PDFDictionary dictionary;
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("Filter"), pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(std::vector<pdf::PDFObject>{ pdf::PDFObject::createName("ASCIIHexDecode"), pdf::PDFObject::createName("FlateDecode") })));
+    dictionary.addEntry(pdf::PDFInplaceOrMemoryString("DecodeParms"), pdf::PDFObject::createArray(std::make_shared<pdf::PDFArray>(std::vector<pdf::PDFObject>{ pdf::PDFObject(), pdf::PDFObject::createDictionary(std::make_shared<pdf::PDFDictionary>(qMove(predictorParameters))) })));
+    pdf::PDFStream stream(qMove(dictionary), qMove(encoded));
+
+    QCOMPARE(pdf::PDFStreamFilterStorage::getDecodedStream(&stream, nullptr), image);
+
+    // Read decoded data in small chunks
+    pdf::PDFStreamFilterSourcePointer source = pdf::PDFStreamFilterStorage::createDecodedStreamSource(&stream, [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; }, nullptr);
+    QVERIFY(source);
+
+    QByteArray decoded;
+    char buffer[777];
+    while (qint64 bytesRead = source->read(buffer, sizeof(buffer)))
+    {
+        decoded.append(buffer, bytesRead);
+    }
+    QCOMPARE(decoded, image);
+}
+
+void LexicalAnalyzerTest::test_precompiled_page_spatial_index()
+{
+    // Grid of 20 x 20 rectangles, upper half is clipped, then one
+    // rectangle is drawn after the graphic state is restored.
+    pdf::PDFPrecompiledPage page;
+    page.addSaveGraphicState();
+
+    QPainterPath clipPath;
+    clipPath.addRect(0, 0, 200, 100);
+    page.addClip(clipPath);
+
+    for (int i = 0; i < 400; ++i)
+    {
+        QPainterPath path;
+        path.addRect((i % 20) * 10, (i / 20) * 10, 10, 10);
+        page.addPath(Qt::NoPen, QBrush(QColor(i % 256, i / 256, 0)), path, false);
+    }
+
+    page.addRestoreGraphicState();
+
+    QPainterPath lastPath;
+    lastPath.addRect(150, 100, 50, 50);
+    page.addPath(Qt::NoPen, QBrush(Qt::blue), lastPath, false);
+    page.finalize(0, { });
+
+    // Draw only small part of the page (page area x = 150..175, y = 90..115)
+    QImage image(100, 100, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    page.draw(&painter, QRectF(), QTransform::fromTranslate(-150, -90) * QTransform::fromScale(4, 4), pdf::PDFRenderer::None, 1.0);
+    painter.end();
+
+    QCOMPARE(image.pixelColor(2, 2), QColor(195, 0, 0));
+    QCOMPARE(image.pixelColor(50, 30), QColor(196, 0, 0));
+    QCOMPARE(image.pixelColor(2, 60), QColor(Qt::blue));
+}
+
+void LexicalAnalyzerTest::test_precompiled_page_serialization()
+{
+    QImage pageImage(16, 16, QImage::Format_ARGB32_Premultiplied);
+    pageImage.fill(Qt::green);
+
+    QPainterPath clipPath;
+    clipPath.addEllipse(10, 10, 180, 180);
+
+    QPainterPath path;
+    path.addRect(20, 20, 100, 60);
+
+    pdf::PDFPrecompiledPage page;
+    page.addSaveGraphicState();
+    page.addClip(clipPath);
+    page.addPath(QPen(Qt::red, 3.0), QBrush(Qt::yellow), path, false);
+    page.addSetWorldMatrix(QTransform(80, 0, 0, 80, 100, 100));
+    page.addImage(pageImage);
+    page.addRestoreGraphicState();
+    page.addSetCompositionMode(QPainter::CompositionMode_Multiply);
+    page.addPath(Qt::NoPen, QBrush(Qt::blue), path.translated(50, 50), true);
+    page.getSnapInfo()->addLine(QPointF(0, 0), QPointF(200, 200));
+    page.finalize(1234, { pdf::PDFRenderError(pdf::RenderErrorType::Warning, "Warning") });
+
+    pdf::PDFPrecompiledPage deserializedPage = pdf::PDFPrecompiledPage::deserialize(page.serialize());
+    QVERIFY(deserializedPage.isValid());
+    QCOMPARE(deserializedPage.getCompilingTimeNS(), qint64(1234));
+    QCOMPARE(deserializedPage.getErrors().size(), qsizetype(1));
+    QCOMPARE(deserializedPage.getErrors().front().message, QString("Warning"));
+    QCOMPARE(deserializedPage.getSnapInfo()->getLines().size(), page.getSnapInfo()->getLines().size());
+
+    auto drawPage = [](const pdf::PDFPrecompiledPage& precompiledPage)
+    {
+        QImage image(200, 200, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+
+        QPainter painter(&image);
+        precompiledPage.draw(&painter, QRectF(), QTransform(), pdf::PDFRenderer::None, 1.0);
+        painter.end();
+        return image;
+    };
+    QCOMPARE(drawPage(deserializedPage), drawPage(page));
+
+    // Corrupted data
+    QByteArray data = qUncompress(page.serialize());
+    data.truncate(data.size() / 2);
+    QVERIFY(!pdf::PDFPrecompiledPage::deserialize(qCompress(data)).isValid());
+    QVERIFY(!pdf::PDFPrecompiledPage::deserialize(QByteArray("garbage")).isValid());
+}
+
+void LexicalAnalyzerTest::test_disk_cache()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+
+    pdf::PDFDiskCache cache(directory.path(), 1024 * 1024);
+    const QByteArray key1 = pdf::PDFDiskCache::createKey("hash", "page", 0, QByteArray());
+    const QByteArray key2 = pdf::PDFDiskCache::createKey("hash", "page", 1, QByteArray());
+    const QByteArray data(4096, 'x');
+
+    QVERIFY(cache.read(key1).isEmpty());
+    cache.write(key1, data);
+    QCOMPARE(cache.read(key1), data);
+    QVERIFY(cache.read(key2).isEmpty());
+
+    // Cache created in the same directory must see stored items
+    pdf::PDFDiskCache otherCache(directory.path(), 1024 * 1024);
+    QCOMPARE(otherCache.read(key1), data);
+
+    cache.clear();
+    QVERIFY(cache.read(key1).isEmpty());
+}
+
+void LexicalAnalyzerTest::test_page_content_hash()
+{
+    pdf::PDFDocumentBuilder builder1;
+    builder1.createDocument();
+    builder1.appendPage(QRectF(0, 0, 100, 100));
+    pdf::PDFObjectReference annotatedPage = builder1.appendPage(QRectF(0, 0, 200, 100));
+    builder1.createAnnotationSquare(annotatedPage, QRectF(10, 10, 50, 50), 1.0, Qt::red, Qt::black, "Title", "Subject", "Contents");
+    pdf::PDFDocument document1 = builder1.build();
+
+    pdf::PDFDocumentBuilder builder2;
+    builder2.createDocument();
+    builder2.appendPage(QRectF(0, 0, 200, 100));
+    pdf::PDFDocument document2 = builder2.build();
+
+    // Identical pages have the same hash, even if object numbers are different
+    const QByteArray hash = pdf::PDFPageContentHash::compute(&document2, 0);
+    QVERIFY(!hash.isEmpty());
+    QCOMPARE(pdf::PDFPageContentHash::compute(&document1, 1), hash);
+    QVERIFY(pdf::PDFPageContentHash::compute(&document1, 0) != hash);
+
+    // Annotations are hashed only if requested
+    QVERIFY(pdf::PDFPageContentHash::compute(&document1, 1, pdf::PDFPageContentHash::Annotations) != pdf::PDFPageContentHash::compute(&document2, 0, pdf::PDFPageContentHash::Annotations));
+
+    QVERIFY(pdf::PDFPageContentHash::compute(&document2, 1).isEmpty());
+    QVERIFY(pdf::PDFDiskCache::createPageKey(hash, "image", QByteArray()) != pdf::PDFDiskCache::createPageKey(hash, "textlayout", QByteArray()));
+
+    // Value inherited by the widget from the parent field affects the hash
+    auto createFormDocument = [](QString value)
+    {
+        pdf::PDFDocumentBuilder builder;
+        builder.createDocument();
+        pdf::PDFObjectReference page = builder.appendPage(QRectF(0, 0, 200, 100));
+
+        pdf::PDFObjectFactory factory;
+        factory.beginDictionary();
+        factory.beginDictionaryItem("FT");
+        factory << pdf::WrapName("Tx");
+        factory.endDictionaryItem();
+        factory.beginDictionaryItem("T");
+        factory << QString("name");
+        factory.endDictionaryItem();
+        factory.beginDictionaryItem("V");
+        factory << value;
+        factory.endDictionaryItem();
+        factory.endDictionary();
+        pdf::PDFObjectReference field = builder.addObject(factory.takeObject());
+
+        factory.beginDictionary();
+        factory.beginDictionaryItem("Parent");
+        factory << field;
+        factory.endDictionaryItem();
+        factory.endDictionary();
+        pdf::PDFObjectReference widget = builder.addObject(factory.takeObject());
+        builder.createInvisibleFormFieldWidget(widget, page);
+        builder.createAcroForm({ field });
+        return builder.build();
+    };
+
+    pdf::PDFDocument formDocument1 = createFormDocument("Alice");
+    pdf::PDFDocument formDocument2 = createFormDocument("Bob");
+    QVERIFY(pdf::PDFPageContentHash::compute(&formDocument1, 0, pdf::PDFPageContentHash::Annotations) != pdf::PDFPageContentHash::compute(&formDocument2, 0, pdf::PDFPageContentHash::Annotations));
+    QCOMPARE(pdf::PDFPageContentHash::compute(&formDocument1, 0), pdf::PDFPageContentHash::compute(&formDocument2, 0));
+}
+
+void LexicalAnalyzerTest::test_parallel_sort()
+{
+    std::vector<int> values(100000, 0);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 1000);
+    std::generate(values.begin(), values.end(), [&]() { return distribution(generator); });
+
+    std::vector<int> expected = values;
+    std::sort(expected.begin(), expected.end(), std::greater<int>());
+
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded);
+    pdf::PDFExecutionPolicy::sort(pdf::PDFExecutionPolicy::Scope::Content, values.begin(), values.end(), std::greater<int>());
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+
+    QVERIFY(values == expected);
+}
+
+void LexicalAnalyzerTest::test_png_stream_writer()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+
+    QImage image(97, 300, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        for (int x = 0; x < image.width(); ++x)
+        {
+            image.setPixel(x, y, qRgba(x * 2, y % 256, (x + y) % 256, 255));
+        }
+    }
+    image.setDotsPerMeterX(11811);
+    image.setDotsPerMeterY(11811);
+
+    const QString fileName = directory.filePath("image.png");
+    pdf::PDFPNGStreamWriter writer(fileName, image.size());
+    for (int top = 0; top < image.height(); top += 128)
+    {
+        QVERIFY(writer.writeBand(image.copy(0, top, image.width(), qMin(128, image.height() - top))));
+    }
+    QVERIFY(writer.finish());
+
+    QImage readImage(fileName);
+    QCOMPARE(readImage.size(), image.size());
+    QCOMPARE(readImage.dotsPerMeterX(), image.dotsPerMeterX());
+    QVERIFY(readImage.convertToFormat(QImage::Format_ARGB32) == image.convertToFormat(QImage::Format_ARGB32));
+
+    // Multithreaded compression, big image is divided into multiple chunks
+    QImage bigImage(1024, 600, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < bigImage.height(); ++y)
+    {
+        for (int x = 0; x < bigImage.width(); ++x)
+        {
+            bigImage.setPixel(x, y, qRgba(x % 256, y % 256, (x * y) % 256, 255));
+        }
+    }
+
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::AlwaysMultithreaded);
+
+    const QString multithreadedFileName = directory.filePath("image-mt.png");
+    QVERIFY(pdf::PDFPNGStreamWriter::write(multithreadedFileName, bigImage, 1, true));
+
+    const QString multithreadedBandsFileName = directory.filePath("image-mt-bands.png");
+    pdf::PDFPNGStreamWriter multithreadedWriter(multithreadedBandsFileName, image.size(), 9);
+    multithreadedWriter.setMultithreadedCompression(true);
+    for (int top = 0; top < image.height(); top += 128)
+    {
+        QVERIFY(multithreadedWriter.writeBand(image.copy(0, top, image.width(), qMin(128, image.height() - top))));
+    }
+    QVERIFY(multithreadedWriter.finish());
+
+    pdf::PDFExecutionPolicy::setStrategy(pdf::PDFExecutionPolicy::Strategy::PageMultithreaded);
+
+    QImage multithreadedImage(multithreadedFileName);
+    QCOMPARE(multithreadedImage.size(), bigImage.size());
+    QVERIFY(multithreadedImage.convertToFormat(QImage::Format_ARGB32) == bigImage.convertToFormat(QImage::Format_ARGB32));
+
+    QImage multithreadedBandsImage(multithreadedBandsFileName);
+    QCOMPARE(multithreadedBandsImage.size(), image.size());
+    QCOMPARE(multithreadedBandsImage.dotsPerMeterX(), image.dotsPerMeterX());
+    QVERIFY(multithreadedBandsImage.convertToFormat(QImage::Format_ARGB32) == image.convertToFormat(QImage::Format_ARGB32));
+}
+
+void LexicalAnalyzerTest::test_color_lookup_table()
+{
+    // Affine transform is interpolated exactly, so results
+    // can differ only by rounding to 8-bit values.
+    auto transform = [](const float* cmyk, float* rgb)
+    {
+        rgb[0] = 1.0f - cmyk[0];
+        rgb[1] = 0.5f * (cmyk[1] + cmyk[2]);
+        rgb[2] = 1.0f - 0.75f * cmyk[3] - 0.25f * cmyk[0];
+    };
+
+    auto sampler = [&transform](const std::vector<float>& input, std::vector<float>& output)
+    {
+        output.resize(input.size() / 4 * 3);
+        for (size_t i = 0; i < input.size() / 4; ++i)
+        {
+            transform(input.data() + i * 4, output.data() + i * 3);
+        }
+    };
 
-    for (const char* string : { "%PDF-1.4", "   %PDF-1.4abs", "%PDF-1.4", "%test %PDF %PDF-1.4", "%!PS-Adobe-3.0 PDF-1.4"})
+    pdf::PDFColorLookupTable lookupTable(4, pdf::PDFColorLookupTable::getGridPointCount(pdf::PDFCMSSettings::Accuracy::Low, 4), sampler);
+    QVERIFY(lookupTable.isValid());
+
+    std::mt19937 generator(38);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::vector<float> colors(4 * 1000, 0.0f);
+    std::generate(colors.begin(), colors.end(), [&]() { return distribution(generator); });
+    colors[0] = colors[1] = colors[2] = colors[3] = 1.0f;
+
+    std::vector<unsigned char> output(3 * 1000, 0);
+    lookupTable.fillRGBBuffer(colors, output.data());
+
+    for (size_t i = 0; i < 1000; ++i)
     {
-        std::cmatch cmatch;
-        const bool matched = std::regex_search(string, string + strlen(string), cmatch, regex);
-        QVERIFY(matched);
+        float rgb[3] = { };
+        transform(colors.data() + i * 4, rgb);
 
-        if (matched)
+        for (size_t j = 0; j < 3; ++j)
         {
-            QVERIFY(cmatch.size() == 3);
-            QVERIFY(cmatch[1].matched || cmatch[2].matched);
+            QVERIFY(qAbs(int(output[i * 3 + j]) - qRound(rgb[j] * 255.0f)) <= 1);
         }
     }
 }
 
-void LexicalAnalyzerTest::test_flat_map()
+void LexicalAnalyzerTest::test_jbig2_bitmap_paint()
 {
-    using Map = pdf::PDFFlatMap<int, 2>;
+    std::mt19937 generator(40);
+    std::uniform_int_distribution<int> pixelDistribution(0, 1);
+    std::uniform_int_distribution<int> sizeDistribution(1, 40);
+    std::uniform_int_distribution<int> offsetDistribution(-20, 50);
 
-    struct Item
+    auto createBitmap = [&](int width, int height)
     {
-        int order;
-        int number;
-        bool erase;
-
-        bool operator<(const Item& other) const { return order < other.order; }
+        pdf::PDFJBIG2Bitmap bitmap(width, height, 0x00);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                bitmap.setPixel(x, y, pixelDistribution(generator) ? 0xFF : 0x00);
+            }
+        }
+        return bitmap;
     };
 
-    for (int count = 1; count < 5; ++count)
-    {
-        std::vector<Item> items;
-        items.reserve(2 * count);
+    const std::array operations = { pdf::PDFJBIG2BitOperation::Or, pdf::PDFJBIG2BitOperation::And, pdf::PDFJBIG2BitOperation::Xor,
+                                     pdf::PDFJBIG2BitOperation::NotXor, pdf::PDFJBIG2BitOperation::Replace };
 
-        int order = 0;
-        for (int i = 0; i < count; ++i)
-        {
-            items.emplace_back(Item{order++, i, false});
-            items.emplace_back(Item{order++, i, true});
-        }
+    for (int i = 0; i < 200; ++i)
+    {
+        const pdf::PDFJBIG2Bitmap target = createBitmap(sizeDistribution(generator), sizeDistribution(generator));
+        const pdf::PDFJBIG2Bitmap source = createBitmap(sizeDistribution(generator), sizeDistribution(generator));
+        const int offsetX = offsetDistribution(generator);
+        const int offsetY = offsetDistribution(generator);
 
-        do
+        for (const pdf::PDFJBIG2BitOperation operation : operations)
         {
-            std::set<int> testSet;
-            Map testFlatMap;
+            pdf::PDFJBIG2Bitmap result = target;
+            result.paint(source, offsetX, offsetY, operation, false, 0x00);
 
-            for (const Item& item : items)
+            for (int y = 0; y < target.getHeight(); ++y)
             {
-                if (!item.erase)
-                {
-                    testSet.insert(item.number);
-                    testFlatMap.insert(item.number);
-                }
-                else
-                {
-                    testSet.erase(item.number);
-                    testFlatMap.erase(item.number);
-                }
-
-                QCOMPARE(testSet.size(), testFlatMap.size());
-                QCOMPARE(testSet.empty(), testFlatMap.empty());
-
-                for (const int testInteger : testSet)
+                for (int x = 0; x < target.getWidth(); ++x)
                 {
-                    QVERIFY(testFlatMap.search(testInteger));
+                    const bool targetPixel = target.getPixel(x, y);
+                    bool expectedPixel = targetPixel;
+
+                    const int sourceX = x - offsetX;
+                    const int sourceY = y - offsetY;
+                    if (sourceX >= 0 && sourceX < source.getWidth() && sourceY >= 0 && sourceY < source.getHeight())
+                    {
+                        const bool sourcePixel = source.getPixel(sourceX, sourceY);
+                        switch (operation)
+                        {
+                            case pdf::PDFJBIG2BitOperation::Or:
+                                expectedPixel = targetPixel || sourcePixel;
+                                break;
+                            case pdf::PDFJBIG2BitOperation::And:
+                                expectedPixel = targetPixel && sourcePixel;
+                                break;
+                            case pdf::PDFJBIG2BitOperation::Xor:
+                                expectedPixel = targetPixel != sourcePixel;
+                                break;
+                            case pdf::PDFJBIG2BitOperation::NotXor:
+                                expectedPixel = targetPixel == sourcePixel;
+                                break;
+                            case pdf::PDFJBIG2BitOperation::Replace:
+                                expectedPixel = sourcePixel;
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+
+                    QCOMPARE(bool(result.getPixel(x, y)), expectedPixel);
                 }
             }
+        }
 
-        } while (std::next_permutation(items.begin(), items.end()));
+        // Subbitmap must contain the same pixels, pixels outside are zero
+        const pdf::PDFJBIG2Bitmap subbitmap = source.getSubbitmap(offsetX, offsetY, 17, 9);
+        for (int y = 0; y < subbitmap.getHeight(); ++y)
+        {
+            for (int x = 0; x < subbitmap.getWidth(); ++x)
+            {
+                QCOMPARE(subbitmap.getPixel(x, y), source.getPixelSafe(x + offsetX, y + offsetY));
+            }
+        }
     }
 }
 
-void LexicalAnalyzerTest::test_lzw_filter()
+void LexicalAnalyzerTest::test_bit_reader()
 {
-    // This example is from PDF 1.7 Reference
-    QByteArray byteArray = QByteArray::fromHex("800B6050220C0C8501");
-    pdf::PDFLzwDecodeFilter filter;
-    QByteArray decoded = filter.apply(byteArray, [](const pdf::PDFObject& object) -> const pdf::PDFObject& { return object; }, pdf::PDFObject(), nullptr);
-    QByteArray valid = "-----A---B";
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> byteDistribution(0, 255);
+    std::uniform_int_distribution<int> bitsDistribution(1, 56);
 
-    QCOMPARE(decoded, valid);
+    QByteArray data;
+    std::vector<bool> bits;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const uint8_t value = byteDistribution(generator);
+        data.push_back(static_cast<char>(value));
+
+        for (int bit = 7; bit >= 0; --bit)
+        {
+            bits.push_back((value >> bit) & 1);
+        }
+    }
+
+    auto getExpectedValue = [&bits](size_t position, size_t count)
+    {
+        pdf::PDFBitReader::Value value = 0;
+        for (size_t i = position; i < position + count; ++i)
+        {
+            value = (value << 1) | ((i < bits.size() && bits[i]) ? 1 : 0);
+        }
+        return value;
+    };
+
+    pdf::PDFBitReader reader(&data, 8);
+    size_t position = 0;
+    while (position < bits.size())
+    {
+        const size_t count = bitsDistribution(generator);
+        QCOMPARE(reader.look(count), getExpectedValue(position, count));
+        QCOMPARE(reader.peek(count), getExpectedValue(position, count));
+
+        if (position + count > bits.size())
+        {
+            QVERIFY_THROWS_EXCEPTION(pdf::PDFException, reader.read(count));
+            break;
+        }
+
+        if (count % 2)
+        {
+            QCOMPARE(reader.read(count), getExpectedValue(position, count));
+        }
+        else
+        {
+            reader.skip(count);
+        }
+
+        position += count;
+        QCOMPARE(reader.getPosition(), int((position + 7) / 8));
+    }
+
+    // Substream must start at the current byte, even if
+    // more bytes were already loaded into the bit buffer
+    reader.seek(0);
+    reader.read(12);
+    reader.alignToBytes();
+    QCOMPARE(reader.getPosition(), 2);
+    QCOMPARE(reader.readSubstream(5), data.mid(2, 5));
+    QCOMPARE(reader.getPosition(), 7);
+    QCOMPARE(reader.readUnsignedByte(), static_cast<uint8_t>(data[7]));
+    reader.skipBytes(10);
+    QCOMPARE(reader.readUnsignedByte(), static_cast<uint8_t>(data[18]));
 }
 
 void LexicalAnalyzerTest::test_sampled_function()
@@ -1061,6 +3245,423 @@ void LexicalAnalyzerTest::test_postscript_function()
     test01("pop 4 3 2 1   3 -1 roll 3 eq { 1 eq { 2 eq { 4 eq { 1.0 } { 0.0 } ifelse } { 0.0 } ifelse } { 0.0 } ifelse } { 0.0 } ifelse", [](double) { return 1.0; }); // we should have 4 2 1 3
     test01("2.0 2 copy div 3 1 roll exp add", [](double x) { return qBound(0.0, 0.5 * x + std::pow(x, 2.0), 1.0); });
     test01("2.0 1 index exch div exch pop", [](double x) { return x / 2.0; });
+    test01("dup 0.3 lt { pop 0.0 } { dup 0.6 lt { 0.5 mul } { pop 1.0 } ifelse } ifelse", [](double x) { return (x < 0.3) ? 0.0 : ((x < 0.6) ? 0.5 * x : 1.0); });
+    test01("dup dup 0.5 gt { 1 } { 0 } ifelse index exch pop exch pop", [](double x) { return x; });
+    test01("dup 0.5 lt { 1 } { 2.0 } ifelse pop", [](double x) { return x; });
+
+    auto test02 = [&](const char* program, bool compiled)
+    {
+        QByteArray data = makeStream(0, 1, 0, 1, program);
+
+        pdf::PDFDocument document;
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::AllowStreams);
+        pdf::PDFFunctionPtr function = pdf::PDFFunction::createFunction(&document, parser.getObject());
+        const pdf::PDFPostScriptFunction* postScriptFunction = dynamic_cast<const pdf::PDFPostScriptFunction*>(function.get());
+
+        QVERIFY(postScriptFunction);
+        QCOMPARE(postScriptFunction->isCompiled(), compiled);
+    };
+
+    test02("dup mul", true);
+    test02("2.0 2 copy div 3 1 roll exp add", true);
+    test02("dup 0.5 gt { 1.0 exch sub } { 2.0 mul } ifelse", true);
+    test02("dup 0.5 gt { 1 } { 0 } ifelse index", false);
+    test02("dup 0.5 lt { 1 } { 2.0 } ifelse pop", false);
+}
+
+void LexicalAnalyzerTest::test_function_lookup_table()
+{
+    auto createFunction = [](const char* data)
+    {
+        pdf::PDFDocument document;
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return pdf::PDFFunction::createFunction(&document, parser.getObject());
+    };
+
+    {
+        // Smooth function with two outputs
+        pdf::PDFFunctionPtr function = createFunction(" << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 1 ] /C1 [ 1 0 ] /N 3.0 >> ");
+        QVERIFY(function);
+
+        const double tolerance = 0.001;
+        pdf::PDFFunctionLookupTable table = pdf::PDFFunctionLookupTable::create({ function }, 2, 0.0, 1.0, tolerance);
+        QVERIFY(table.isValid());
+        QCOMPARE(table.getOutputCount(), size_t(2));
+
+        for (double value = -0.5; value <= 1.5; value += 0.001)
+        {
+            double expected[2] = { };
+            double actual[2] = { };
+            QVERIFY(function->apply(&value, &value + 1, expected, expected + 2));
+            table.evaluate(value, actual);
+
+            QVERIFY(std::abs(expected[0] - actual[0]) <= tolerance);
+            QVERIFY(std::abs(expected[1] - actual[1]) <= tolerance);
+        }
+    }
+
+    {
+        // Discontinuous function can't be approximated
+        pdf::PDFFunctionPtr function = createFunction(" << /FunctionType 3 /Domain [ 0 1 ] /Bounds [ 0.3 ] /Encode [ 0 1 0 1 ] "
+                                                      "    /Functions [ << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 ] /C1 [ 0 ] /N 1.0 >> "
+                                                      "                 << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 1 ] /C1 [ 1 ] /N 1.0 >> ] >> ");
+        QVERIFY(function);
+
+        pdf::PDFFunctionLookupTable table = pdf::PDFFunctionLookupTable::create({ function }, 1, 0.0, 1.0, 0.01);
+        QVERIFY(!table.isValid());
+    }
+}
+
+void LexicalAnalyzerTest::test_function_batch()
+{
+    auto createFunction = [](const char* data)
+    {
+        pdf::PDFDocument document;
+        pdf::PDFParser parser(data, nullptr, pdf::PDFParser::None);
+        return pdf::PDFFunction::createFunction(&document, parser.getObject());
+    };
+
+    auto test = [&](const char* data, size_t n)
+    {
+        pdf::PDFFunctionPtr function = createFunction(data);
+        QVERIFY(function);
+
+        std::vector<double> x;
+        for (double value = -0.5; value <= 1.5; value += 0.01)
+        {
+            x.push_back(value);
+        }
+
+        std::vector<double> expected(x.size() * n, 0.0);
+        std::vector<double> actual(x.size() * n, 0.0);
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            QVERIFY(function->apply(&x[i], &x[i] + 1, expected.data() + i * n, expected.data() + (i + 1) * n));
+        }
+        QVERIFY(function->applyBatch(x.data(), actual.data(), x.size()));
+        QCOMPARE(actual, expected);
+    };
+
+    test(" << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 1 ] /C1 [ 1 0 ] /N 2.5 >> ", 2);
+    test(" << /FunctionType 2 /Domain [ 0 1 ] /Range [ 0.2 0.8 ] /C0 [ 0 ] /C1 [ 1 ] /N 1.0 >> ", 1);
+    test(" << /FunctionType 3 /Domain [ 0 1 ] /Bounds [ 0.3 0.6 ] /Encode [ 0 1 1 0 0 1 ] "
+         "    /Functions [ << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 1 ] /C1 [ 1 0 ] /N 1.0 >> "
+         "                 << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 1 1 ] /C1 [ 0 0 ] /N 2.0 >> "
+         "                 << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0.5 0 ] /C1 [ 1 0.5 ] /N 0.5 >> ] >> ", 2);
+}
+
+void LexicalAnalyzerTest::test_float_bitmap_copy()
+{
+    const pdf::PDFPixelFormat format = pdf::PDFPixelFormat::createFormatDefaultRGB(0);
+    const uint8_t channelCount = format.getChannelCount();
+
+    pdf::PDFFloatBitmap source(2, 3, format);
+    for (size_t y = 0; y < source.getHeight(); ++y)
+    {
+        for (size_t x = 0; x < source.getWidth(); ++x)
+        {
+            pdf::PDFColorBuffer buffer = source.getPixel(x, y);
+            for (uint8_t i = 0; i < channelCount; ++i)
+            {
+                buffer[i] = pdf::PDFColorComponent(1 + x + 10 * y + 100 * i);
+            }
+        }
+    }
+
+    pdf::PDFFloatBitmap target(5, 4, format);
+    target.copyBitmap(source, 3, 1);
+
+    for (size_t y = 0; y < target.getHeight(); ++y)
+    {
+        for (size_t x = 0; x < target.getWidth(); ++x)
+        {
+            const bool isCopied = x >= 3 && y >= 1;
+            pdf::PDFConstColorBuffer buffer = std::as_const(target).getPixel(x, y);
+            for (uint8_t i = 0; i < channelCount; ++i)
+            {
+                const pdf::PDFColorComponent expected = isCopied ? pdf::PDFColorComponent(1 + (x - 3) + 10 * (y - 1) + 100 * i) : 0.0f;
+                QCOMPARE(buffer[i], expected);
+            }
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_float_bitmap_blend_separable()
+{
+    // Overprint mode 0 with all color channels active gives the same result as
+    // blending without overprint, but is computed pixel by pixel, so it can be
+    // used as a reference for the planar blending.
+    for (const pdf::PDFPixelFormat format : { pdf::PDFPixelFormat::createFormatDefaultRGB(0), pdf::PDFPixelFormat::createFormatDefaultCMYK(2) })
+    {
+        for (const pdf::BlendMode mode : { pdf::BlendMode::Normal, pdf::BlendMode::Multiply, pdf::BlendMode::Screen, pdf::BlendMode::Darken, pdf::BlendMode::SoftLight, pdf::BlendMode::Difference })
+        {
+            const size_t width = 11;
+            const size_t height = 3;
+            const uint8_t channelCount = format.getChannelCount();
+
+            pdf::PDFFloatBitmap source(width, height, format);
+            pdf::PDFFloatBitmap backdrop(width, height, format);
+            pdf::PDFFloatBitmap softMask(width, height, pdf::PDFPixelFormat::createOpacityMask());
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    pdf::PDFColorBuffer sourceBuffer = source.getPixel(x, y);
+                    pdf::PDFColorBuffer backdropBuffer = backdrop.getPixel(x, y);
+                    for (uint8_t i = 0; i < channelCount; ++i)
+                    {
+                        sourceBuffer[i] = pdf::PDFColorComponent((x * 7 + y * 3 + i * 5) % 11) / 10.0f;
+                        backdropBuffer[i] = pdf::PDFColorComponent((x * 3 + y * 5 + i * 7) % 13) / 12.0f;
+                    }
+                    softMask.getPixel(x, y)[0] = pdf::PDFColorComponent((x + y) % 4) / 3.0f;
+                }
+            }
+
+            pdf::PDFFloatBitmap target = backdrop;
+            pdf::PDFFloatBitmap referenceTarget = backdrop;
+            const QRect blendRegion(1, 0, int(width) - 2, int(height));
+            pdf::PDFFloatBitmap::blend(source, target, backdrop, backdrop, softMask, false, 0.8f, mode, false, pdf::PDFFloatBitmap::OverprintMode::NoOveprint, blendRegion);
+            pdf::PDFFloatBitmap::blend(source, referenceTarget, backdrop, backdrop, softMask, false, 0.8f, mode, false, pdf::PDFFloatBitmap::OverprintMode::Overprint_Mode_0, blendRegion);
+
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    pdf::PDFConstColorBuffer buffer = std::as_const(target).getPixel(x, y);
+                    pdf::PDFConstColorBuffer referenceBuffer = std::as_const(referenceTarget).getPixel(x, y);
+                    for (uint8_t i = 0; i < channelCount; ++i)
+                    {
+                        QVERIFY(qAbs(buffer[i] - referenceBuffer[i]) < 1.0e-5f);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LexicalAnalyzerTest::test_text_layout_storage_find()
+{
+    auto createLayout = [](const QString& text)
+    {
+        pdf::PDFTextLayout layout;
+
+        for (int i = 0; i < text.size(); ++i)
+        {
+            pdf::PDFTextCharacterInfo info;
+            info.character = text[i];
+            info.advance = 10.0;
+            info.fontSize = 10.0;
+            info.matrix = QTransform::fromTranslate(i * 10.0, 100.0);
+            info.outline.addRect(0.0, 0.0, 8.0, 10.0);
+            layout.addCharacter(info);
+        }
+
+        layout.perform();
+        return layout;
+    };
+
+    QCOMPARE(pdf::PDFTextLayoutStorage::createSearchText(QString("In the\n soft\u00ADhyphen")), QString("Inthesofthyphen"));
+
+    pdf::PDFTextLayoutStorage storage(3);
+    QMutex mutex;
+    storage.setTextLayout(0, createLayout("Lorem ipsum dolor"), &mutex);
+    storage.setTextLayout(1, createLayout("Ipsum lorem"), &mutex);
+    storage.setTextLayout(2, pdf::PDFTextLayout(), &mutex);
+
+    pdf::PDFFindResults results = storage.find(QString("ipsum"), Qt::CaseInsensitive, pdf::PDFTextFlow::None);
+    QCOMPARE(results.size(), size_t(2));
+    QCOMPARE(results.front().textSelectionItems.front().first.pageIndex, pdf::PDFInteger(0));
+    QCOMPARE(results.back().textSelectionItems.front().first.pageIndex, pdf::PDFInteger(1));
+
+    results = storage.find(QString("ipsum"), Qt::CaseSensitive, pdf::PDFTextFlow::None);
+    QCOMPARE(results.size(), size_t(1));
+    QCOMPARE(results.front().matched, QString("ipsum"));
+
+    QVERIFY(storage.find(QString("amet"), Qt::CaseInsensitive, pdf::PDFTextFlow::None).empty());
+}
+
+void LexicalAnalyzerTest::test_text_layout_search_index()
+{
+    auto createLayout = [](const QString& text)
+    {
+        pdf::PDFTextLayout layout;
+
+        for (int i = 0; i < text.size(); ++i)
+        {
+            pdf::PDFTextCharacterInfo info;
+            info.character = text[i];
+            info.advance = 10.0;
+            info.fontSize = 10.0;
+            info.matrix = QTransform::fromTranslate(i * 10.0, 100.0);
+            info.outline.addRect(0.0, 0.0, 8.0, 10.0);
+            layout.addCharacter(info);
+        }
+
+        layout.perform();
+        return layout;
+    };
+
+    QCOMPARE(pdf::PDFTextLayoutStorage::getRequiredLiterals(QRegularExpression("contract\\s+no\\.?\\d+")), QStringList({ "contract", "no" }));
+    QCOMPARE(pdf::PDFTextLayoutStorage::getRequiredLiterals(QRegularExpression("colou?r[s]")), QStringList({ "colo", "r" }));
+    QVERIFY(pdf::PDFTextLayoutStorage::getRequiredLiterals(QRegularExpression("alpha|beta")).isEmpty());
+    QVERIFY(pdf::PDFTextLayoutStorage::getRequiredLiterals(QRegularExpression("(optional)?")).isEmpty());
+
+    pdf::PDFTextLayoutStorage storage(3);
+    QMutex mutex;
+    storage.setTextLayout(0, createLayout("Contract no 42"), &mutex);
+    storage.setTextLayout(1, createLayout("Appendix of the contract"), &mutex);
+    storage.setTextLayout(2, createLayout("Colours"), &mutex);
+    storage.buildSearchIndex();
+    QVERIFY(storage.hasSearchIndex());
+
+    pdf::PDFTextLayoutStorage deserializedStorage = pdf::PDFTextLayoutStorage::deserialize(storage.serialize());
+    QVERIFY(deserializedStorage.hasSearchIndex());
+    QCOMPARE(deserializedStorage.getCount(), size_t(3));
+
+    for (const pdf::PDFTextLayoutStorage* currentStorage : { &storage, &deserializedStorage })
+    {
+        pdf::PDFFindResults results = currentStorage->find(QString("CONTRACT"), Qt::CaseInsensitive, pdf::PDFTextFlow::None);
+        QCOMPARE(results.size(), size_t(2));
+
+        results = currentStorage->find(QRegularExpression("contract\\s+no\\s+\\d+", QRegularExpression::CaseInsensitiveOption), pdf::PDFTextFlow::None);
+        QCOMPARE(results.size(), size_t(1));
+        QCOMPARE(results.front().matched, QString("Contract no 42"));
+
+        results = currentStorage->find(QRegularExpression("colou?rs"), pdf::PDFTextFlow::None);
+        QVERIFY(results.empty());
+
+        results = currentStorage->find(QRegularExpression("Colou?rs"), pdf::PDFTextFlow::None);
+        QCOMPARE(results.size(), size_t(1));
+
+        QVERIFY(currentStorage->find(QString("xyz"), Qt::CaseInsensitive, pdf::PDFTextFlow::None).empty());
+    }
+
+    QCOMPARE(pdf::PDFTextLayoutStorage::deserialize(QByteArray("invalid")).getCount(), size_t(0));
+}
+
+void LexicalAnalyzerTest::test_cmap_lookup()
+{
+    // Range is first, so it takes precedence over overlapping characters
+    QByteArray data = "begincmap\n"
+                      "1 beginbfrange\n<40> <45> <0061>\nendbfrange\n"
+                      "2 beginbfchar\n<41> <0042>\n<50> <0050>\nendbfchar\n"
+                      "1 begincidrange\n<8140> <817E> 633\nendcidrange\n"
+                      "endcmap\n";
+
+    for (int i = 0; i < 2; ++i)
+    {
+        // Second mapping is taken from the cache
+        pdf::PDFFontCMap cmap = pdf::PDFFontCMap::createFromData(data);
+        QVERIFY(cmap.isValid());
+
+        QCOMPARE(cmap.getToUnicode(0x40), QChar('a'));
+        QCOMPARE(cmap.getToUnicode(0x41), QChar('b'));
+        QCOMPARE(cmap.getToUnicode(0x45), QChar('f'));
+        QCOMPARE(cmap.getToUnicode(0x46), QChar());
+        QCOMPARE(cmap.getToUnicode(0x50), QChar('P'));
+
+        std::vector<pdf::CID> cids = cmap.interpret(QByteArray("\x40\x45\x81\x41\x50", 5));
+        QCOMPARE(cids, (std::vector<pdf::CID>{ 0x61, 0x66, 634, 0x50 }));
+    }
+}
+
+void LexicalAnalyzerTest::test_chunked_vector()
+{
+    using Vector = pdf::PDFChunkedVector<int, 2>;
+
+    Vector vector;
+    for (int i = 0; i < 10; ++i)
+    {
+        vector.push_back(i);
+    }
+
+    // Copy shares all chunks, modified chunk is copied
+    Vector copy = vector;
+    QVERIFY(copy == vector);
+    QVERIFY(copy.isShared(0));
+    copy[5] = 50;
+    QCOMPARE(vector[5], 5);
+    QCOMPARE(copy[5], 50);
+    QVERIFY(copy.isShared(0));
+    QVERIFY(!copy.isShared(5));
+    QVERIFY(copy != vector);
+
+    copy.resize(3);
+    QCOMPARE(copy.size(), size_t(3));
+    QCOMPARE(vector.size(), size_t(10));
+    copy.resize(6);
+    QCOMPARE(copy[5], 0);
+    QCOMPARE(vector[2], 2);
+
+    const Vector& constVector = vector;
+    QCOMPARE(std::accumulate(constVector.cbegin(), constVector.cend(), 0), 45);
+}
+
+void LexicalAnalyzerTest::test_snap_index()
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<pdf::PDFReal> distribution(0.0, 1000.0);
+
+    std::vector<pdf::PDFSnapInfo::SnapPoint> snapPoints;
+    std::vector<QLineF> lines;
+    for (int i = 0; i < 2000; ++i)
+    {
+        QLineF line(distribution(generator), distribution(generator), distribution(generator), distribution(generator));
+        snapPoints.emplace_back(pdf::SnapType::LineCenter, line.center());
+        lines.push_back(line);
+    }
+
+    // Horizontal and vertical lines
+    lines.emplace_back(0.0, 500.0, 1000.0, 500.0);
+    lines.emplace_back(250.0, 0.0, 250.0, 1000.0);
+
+    pdf::PDFSnapIndex index(snapPoints, lines);
+
+    auto getLineDistance = [](const QLineF& line, const QPointF& point)
+    {
+        const QPointF vector = line.p2() - line.p1();
+        const pdf::PDFReal t = qBound(0.0, QPointF::dotProduct(point - line.p1(), vector) / QPointF::dotProduct(vector, vector), 1.0);
+        return QLineF(point, line.p1() + vector * t).length();
+    };
+
+    const pdf::PDFReal tolerance = 10.0;
+    for (int i = 0; i < 500; ++i)
+    {
+        const QPointF point(distribution(generator), distribution(generator));
+
+        // Brute force search
+        std::optional<size_t> nearestSnapPoint;
+        pdf::PDFReal nearestDistance = tolerance;
+        for (size_t j = 0; j < snapPoints.size(); ++j)
+        {
+            const pdf::PDFReal distance = QLineF(point, snapPoints[j].point).length();
+            if (distance < nearestDistance)
+            {
+                nearestDistance = distance;
+                nearestSnapPoint = j;
+            }
+        }
+
+        std::vector<size_t> nearestLines;
+        for (size_t j = 0; j < lines.size(); ++j)
+        {
+            if (getLineDistance(lines[j], point) < tolerance)
+            {
+                nearestLines.push_back(j);
+            }
+        }
+
+        QCOMPARE(index.findNearestSnapPoint(point, tolerance), nearestSnapPoint);
+
+        std::vector<size_t> foundLines = index.findNearestLines(point, tolerance);
+        QVERIFY(std::is_sorted(foundLines.cbegin(), foundLines.cend(), [&](size_t l, size_t r) { return getLineDistance(lines[l], point) < getLineDistance(lines[r], point); }));
+        std::sort(foundLines.begin(), foundLines.end());
+        QCOMPARE(foundLines, nearestLines);
+    }
+
+    // Points outside of the index
+    QVERIFY(!index.findNearestSnapPoint(QPointF(-100.0, -100.0), tolerance).has_value());
+    QVERIFY(index.findNearestLines(QPointF(2000.0, 2000.0), tolerance).empty());
 }
 
 void LexicalAnalyzerTest::test_jbig2_arithmetic_decoder()